@@ -112,6 +112,7 @@ option(OSQUERY_BUILD_BPF "Whether to enable and build BPF support" ON)
 option(OSQUERY_BUILD_AWS "Whether to build the aws tables and library, to decrease memory usage and increase speed during build." ON)
 option(OSQUERY_BUILD_DPKG "Whether to build the dpkg tables" ON)
 option(OSQUERY_BUILD_EXPERIMENTS "Whether to build experiments" ON)
+option(OSQUERY_ENABLE_ALLOCATION_HOOKS "Whether osqueryd and osqueryi replace the global operator new and delete to count the heap allocations of tables and queries")
 
 option(OSQUERY_ENABLE_FORMAT_ONLY "Configure CMake to format only, not build")
 
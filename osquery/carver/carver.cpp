@@ -16,6 +16,7 @@
 #include <osquery/carver/carver.h>
 #include <osquery/carver/carver_utils.h>
 #include <osquery/core/flags.h>
+#include <osquery/core/shutdown.h>
 #include <osquery/core/system.h>
 #include <osquery/database/database.h>
 #include <osquery/filesystem/fileops.h>
@@ -24,10 +25,17 @@
 #include <osquery/remote/serializers/json.h>
 #include <osquery/utils/base64.h>
 #include <osquery/utils/conversions/split.h>
+#include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/json/json.h>
 #include <osquery/utils/system/system.h>
 #include <osquery/utils/system/time.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
 #include <boost/algorithm/string.hpp>
 
 namespace fs = boost::filesystem;
@@ -55,12 +63,24 @@ CLI_FLAG(uint32,
          8192,
          "Size of blocks used for POSTing data back to remote endpoints");
 
+/// Number of blocks POSTed at once.
+CLI_FLAG(uint32,
+         carver_parallel_uploads,
+         1,
+         "Number of carve blocks posted at once (default 1)");
+
 /// Boolean if compression should be used.
 CLI_FLAG(bool,
          carver_compression,
          false,
          "Compress archives using zstd prior to upload (default false)");
 
+/// Boolean if the requests posting blocks should be compressed.
+CLI_FLAG(bool,
+         carver_compress_requests,
+         false,
+         "Compress carve block requests, see tls_compression");
+
 /// Time to expire successful carves from the local cache.
 CLI_FLAG(uint32,
          carver_expiry,
@@ -68,7 +88,36 @@ CLI_FLAG(uint32,
          "Seconds to store successful carve result metadata (in carves table)");
 
 DECLARE_bool(disable_carver);
-DECLARE_uint64(read_max);
+
+/// Attempts to post a block before the carve fails.
+const size_t kCarverBlockAttempts = 3;
+
+/// The acknowledged blocks are stored after this many more are acknowledged.
+const size_t kCarverAckInterval = 64;
+
+/// The archive of a carve is spooled to a temporary file with this prefix.
+const std::string kCarverSpoolPrefix = "osquery_carve_";
+
+namespace {
+
+/// Blocks waiting for the upload workers, and the acknowledged blocks.
+struct BlockQueue {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<std::pair<size_t, std::string>> blocks;
+
+  /// Set once every block was queued.
+  bool done{false};
+
+  /// The first block that failed every attempt.
+  Status failure;
+
+  /// Blocks before the prefix, and these blocks, are acknowledged.
+  size_t prefix{0};
+  std::set<size_t> acked;
+};
+
+} // namespace
 
 std::atomic<bool> CarverRunnable::running_{false};
 
@@ -112,7 +161,8 @@ void CarverRunnable::start() {
       }
     }
 
-    if (status != kCarverStatusScheduled) {
+    // An upload interrupted by a restart is resumed.
+    if (status != kCarverStatusScheduled && status != kCarverStatusUploading) {
       continue;
     }
 
@@ -152,81 +202,53 @@ Carver::Carver(const std::set<std::string>& paths,
   requestId_ = requestId;
 }
 
-Status Carver::createPaths() {
-  // TODO: Adding in a manifest file of all carved files might be nice.
-  carveDir_ =
-      fs::temp_directory_path() / fs::path(kCarvePathPrefix + carveGuid_);
-  auto ret = fs::create_directory(carveDir_);
-  if (!ret) {
-    return Status::failure("Failed to create carve file store");
-  }
-
-  // Store the path to our archive for later exfiltration
-  archivePath_ = carveDir_ / fs::path(kCarveNamePrefix + carveGuid_ + ".tar");
-  compressPath_ =
-      carveDir_ / fs::path(kCarveNamePrefix + carveGuid_ + ".tar.zst");
+Carver::~Carver() {}
 
+Status Carver::carve() {
   // Update the DB to reflect that the carve is pending.
   updateCarveValue(carveGuid_, "status", "PENDING");
-  return Status::success();
-};
-
-Carver::~Carver() {
-  fs::remove_all(carveDir_);
-}
-
-Status Carver::carve() {
-  auto s = createPaths();
-  if (!s.ok()) {
-    updateCarveValue(carveGuid_, "status", "CREATE PATHS FAILED");
-    return s;
-  }
 
+  // The archive is read from the files once, the upload reads the spool.
   const auto carvedFiles = carveAll();
-  s = archive(carvedFiles, archivePath_, FLAGS_carver_block_size);
+  const auto spool = spoolPath();
+  uint64_t size = 0;
+  std::string hash;
+  auto s = spoolCarve(carvedFiles, spool, size, hash);
   if (!s.ok()) {
     VLOG(1) << "Failed to create carve archive: " << s.getMessage();
     updateCarveValue(carveGuid_, "status", "ARCHIVE FAILED");
+    removeSpool(spool);
     return s;
   }
 
-  fs::path uploadPath;
-  if (FLAGS_carver_compression) {
-    uploadPath = compressPath_;
-    s = compress(archivePath_, compressPath_);
-    if (!s.ok()) {
-      VLOG(1) << "Failed to compress carve archive: " << s.getMessage();
-      updateCarveValue(carveGuid_, "status", "COMPRESS FAILED");
-      return s;
-    }
-  } else {
-    uploadPath = archivePath_;
+  // The session of an interrupted upload is only kept for the same blocks.
+  if (getCarveValue(carveGuid_, "size") != std::to_string(size) ||
+      getCarveValue(carveGuid_, "sha256") != hash ||
+      getCarveValue(carveGuid_, "block_size") !=
+          std::to_string(FLAGS_carver_block_size)) {
+    updateCarveValue(carveGuid_, "session_id", "");
   }
 
-  PlatformFile uploadFile(uploadPath, PF_OPEN_EXISTING | PF_READ);
-  updateCarveValue(carveGuid_, "size", std::to_string(uploadFile.size()));
+  updateCarveValue(carveGuid_, "size", std::to_string(size));
+  updateCarveValue(carveGuid_, "sha256", hash);
+  updateCarveValue(
+      carveGuid_, "block_size", std::to_string(FLAGS_carver_block_size));
 
-  std::string uploadHash =
-      (uploadFile.size() > FLAGS_read_max)
-          ? "-1"
-          : hashFromFile(HashType::HASH_TYPE_SHA256, uploadPath.string());
-  if (uploadHash == "-1") {
-    VLOG(1)
-        << "Archive file size exceeds read max, skipping integrity computation";
-  }
-  updateCarveValue(carveGuid_, "sha256", uploadHash);
-
-  s = postCarve(uploadPath);
+  s = postCarve(spool, size);
+  removeSpool(spool);
   if (!s.ok()) {
     VLOG(1) << "Failed to post carve: " << s.getMessage();
-    updateCarveValue(carveGuid_, "status", "DATA POST FAILED");
+    // An upload stopped by a shutdown resumes after the restart.
+    if (!shutdownRequested()) {
+      updateCarveValue(carveGuid_, "status", "DATA POST FAILED");
+    }
     return s;
   }
   return Status::success();
 };
 
-std::set<fs::path> Carver::carveAll() {
-  std::set<fs::path> carvedFiles;
+std::vector<ArchiveFile> Carver::carveAll() {
+  std::vector<ArchiveFile> carvedFiles;
   for (const auto& srcPath : carvePaths_) {
     // Ensure the file is a flat file on disk before carving
     PlatformFile src(srcPath, PF_OPEN_EXISTING | PF_READ);
@@ -235,73 +257,242 @@ std::set<fs::path> Carver::carveAll() {
       continue;
     }
 
-    fs::path dstPath;
+    auto name = srcPath.string();
     if (srcPath.has_root_name()) {
-      auto temp = srcPath.string();
-      boost::erase_first(temp, ":");
-      dstPath = carveDir_ / fs::path(temp);
-    } else {
-      dstPath = carveDir_ / srcPath;
+      boost::erase_first(name, ":");
     }
-    if (!fs::exists(dstPath.parent_path())) {
-      auto ret = fs::create_directories(dstPath.parent_path());
-      if (!ret) {
-        VLOG(1) << "Failed to create directories for: "
-                << dstPath.parent_path();
-        continue;
+    carvedFiles.push_back({srcPath, name, src.size()});
+  }
+  return carvedFiles;
+}
+
+Status Carver::streamCarve(const std::vector<ArchiveFile>& files,
+                           const ArchiveSink& sink) {
+  return archive(
+      files, sink, FLAGS_carver_compression, FLAGS_carver_block_size);
+}
+
+fs::path Carver::spoolPath() const {
+  boost::system::error_code ec;
+  auto directory = fs::temp_directory_path(ec);
+  return directory / (kCarverSpoolPrefix + carveGuid_);
+}
+
+void Carver::removeSpool(const fs::path& spool) {
+  boost::system::error_code ec;
+  fs::remove(spool, ec);
+}
+
+Status Carver::spoolCarve(const std::vector<ArchiveFile>& files,
+                          const fs::path& spool,
+                          uint64_t& size,
+                          std::string& hash) {
+  PlatformFile out(spool, PF_CREATE_ALWAYS | PF_WRITE, 0600);
+  if (!out.isValid()) {
+    return Status::failure("Cannot create the carve spool: " + spool.string());
+  }
+
+  Hash hasher(HashType::HASH_TYPE_SHA256);
+  size = 0;
+  auto s = streamCarve(
+      files, [&out, &hasher, &size](const char* data, size_t len) {
+        while (len > 0) {
+          auto written = out.write(data, len);
+          if (written <= 0) {
+            return Status::failure("Cannot write the carve spool");
+          }
+          hasher.update(data, written);
+          size += written;
+          data += written;
+          len -= written;
+        }
+        return Status::success();
+      });
+  if (!s.ok()) {
+    return s;
+  }
+
+  hash = hasher.digest();
+  return Status::success();
+}
+
+Status Carver::postCarve(const fs::path& spool, uint64_t size) {
+  auto blkCount =
+      static_cast<size_t>(ceil(static_cast<double>(size) /
+                               static_cast<double>(FLAGS_carver_block_size)));
+
+  // Blocks acknowledged before a restart are not posted again.
+  size_t firstBlock = 0;
+  auto session_id = getCarveValue(carveGuid_, "session_id");
+  if (!session_id.empty()) {
+    firstBlock = tryTo<size_t>(getCarveValue(carveGuid_, "blocks_acked"))
+                     .takeOr(size_t{0});
+    VLOG(1) << "Resuming carve " << carveGuid_ << " at block " << firstBlock;
+  } else {
+    auto status = startCarve(size, session_id);
+    if (!status.ok()) {
+      return status;
+    }
+    updateCarveValue(carveGuid_, "session_id", session_id);
+    updateCarveValue(carveGuid_, "blocks_acked", "0");
+  }
+  updateCarveValue(carveGuid_, "status", kCarverStatusUploading);
+
+  if (FLAGS_carver_compress_requests) {
+    TLSRequestHelper::loadCompressionDictionary<JSONSerializer>();
+  }
+
+  BlockQueue queue;
+  queue.prefix = firstBlock;
+  size_t persisted = firstBlock;
+  auto worker = [&]() {
+    while (true) {
+      std::pair<size_t, std::string> block;
+      {
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        queue.cv.wait(lock, [&queue]() {
+          return !queue.blocks.empty() || queue.done || !queue.failure.ok();
+        });
+        if (!queue.failure.ok() || queue.blocks.empty()) {
+          return;
+        }
+        block = std::move(queue.blocks.front());
+        queue.blocks.pop_front();
+      }
+      queue.cv.notify_all();
+
+      Status s;
+      for (size_t attempt = 1; attempt <= kCarverBlockAttempts; attempt++) {
+        s = postBlock(block.first, session_id, block.second);
+        if (s.ok()) {
+          break;
+        }
+
+        VLOG(1) << "Post of carved block " << block.first
+                << " failed: " << s.getMessage();
+        if (attempt < kCarverBlockAttempts &&
+            waitTimeoutOrShutdown(
+                std::chrono::milliseconds(attempt * attempt * 1000))) {
+          break;
+        }
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!s.ok()) {
+          if (queue.failure.ok()) {
+            queue.failure = s;
+          }
+        } else {
+          queue.acked.insert(block.first);
+          while (queue.acked.erase(queue.prefix) > 0) {
+            queue.prefix++;
+          }
+          if (queue.prefix >= persisted + kCarverAckInterval) {
+            persisted = queue.prefix;
+            updateCarveValue(
+                carveGuid_, "blocks_acked", std::to_string(persisted));
+          }
+        }
       }
+      queue.cv.notify_all();
     }
+  };
 
-    PlatformFile dst(dstPath, PF_CREATE_NEW | PF_WRITE);
-    if (!dst.isValid()) {
-      VLOG(1) << "Destination temporary file is invalid: " << dstPath;
-      continue;
+  auto workers = std::max<size_t>(1, FLAGS_carver_parallel_uploads);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < workers; i++) {
+    threads.emplace_back(worker);
+  }
+
+  // Full blocks are queued, the stream waits while the workers are busy.
+  size_t blockId = 0;
+  std::string block;
+  block.reserve(FLAGS_carver_block_size);
+  auto queueBlock = [&]() {
+    auto id = blockId++;
+    if (id < firstBlock) {
+      block.clear();
+      return Status::success();
     }
-    Status s = blockwiseCopy(src, dst);
-    if (s.ok()) {
-      carvedFiles.insert(dstPath);
-    } else {
-      VLOG(1) << "Failed to copy file from " << srcPath << " to " << dstPath
-              << " " << s.getMessage();
+
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    queue.cv.wait(lock, [&queue, workers]() {
+      return queue.blocks.size() < workers * 2 || !queue.failure.ok();
+    });
+    if (!queue.failure.ok()) {
+      return queue.failure;
     }
+    queue.blocks.emplace_back(id, std::move(block));
+    lock.unlock();
+    queue.cv.notify_all();
+
+    block.clear();
+    block.reserve(FLAGS_carver_block_size);
+    return Status::success();
+  };
+
+  // The spooled archive is read a block at a time, skipping the blocks that
+  // were acknowledged before a restart.
+  Status status;
+  uint64_t streamed = 0;
+  PlatformFile in(spool, PF_OPEN_EXISTING | PF_READ);
+  if (!in.isValid()) {
+    status = Status::failure("Cannot read the carve spool: " + spool.string());
+  } else if (firstBlock > 0) {
+    streamed = std::min<uint64_t>(
+        size, static_cast<uint64_t>(firstBlock) * FLAGS_carver_block_size);
+    blockId = firstBlock;
+    in.seek(static_cast<off_t>(streamed), PF_SEEK_BEGIN);
   }
-  return carvedFiles;
-}
 
-Status Carver::blockwiseCopy(PlatformFile& src, PlatformFile& dst) {
-  auto blkCount = ceil(static_cast<double>(src.size()) /
-                       static_cast<double>(FLAGS_carver_block_size));
-
-  std::vector<char> inBuff(FLAGS_carver_block_size, 0);
-  for (size_t i = 0; i < blkCount; i++) {
-    auto bytesRead = src.read(inBuff.data(), FLAGS_carver_block_size);
-    if (bytesRead > 0) {
-      auto bytesWritten = dst.write(inBuff.data(), bytesRead);
-      if (bytesWritten < 0) {
-        return Status(1, "Error writing bytes to tmp fs");
-      }
+  while (status.ok() && streamed < size) {
+    block.resize(static_cast<size_t>(
+        std::min<uint64_t>(FLAGS_carver_block_size, size - streamed)));
+    auto count = in.read(&block[0], block.size());
+    if (count <= 0 || static_cast<size_t>(count) != block.size()) {
+      status = Status::failure("Cannot read the carve spool");
+      break;
     }
+    streamed += block.size();
+    status = queueBlock();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.done = true;
+  }
+  queue.cv.notify_all();
+  for (auto& thread : threads) {
+    thread.join();
   }
 
+  if (!status.ok()) {
+    return status;
+  } else if (!queue.failure.ok()) {
+    return queue.failure;
+  }
+
+  updateCarveValue(carveGuid_, "blocks_acked", std::to_string(blkCount));
+  updateCarveValue(carveGuid_, "status", kCarverStatusSuccess);
   return Status::success();
 };
 
-Status Carver::postCarve(const boost::filesystem::path& path) {
+Status Carver::startCarve(uint64_t size, std::string& session_id) {
   // Construct the uri we post our data back to:
   auto startUri = TLSRequestHelper::makeURI(FLAGS_carver_start_endpoint);
   Request<TLSTransport, JSONSerializer> startRequest(startUri);
   startRequest.setOption("hostname", FLAGS_tls_hostname);
 
   // Perform the start request to get the session id
-  PlatformFile pFile(path, PF_OPEN_EXISTING | PF_READ);
   auto blkCount =
-      static_cast<size_t>(ceil(static_cast<double>(pFile.size()) /
+      static_cast<size_t>(ceil(static_cast<double>(size) /
                                static_cast<double>(FLAGS_carver_block_size)));
   JSON startParams;
 
   startParams.add("block_count", blkCount);
   startParams.add("block_size", size_t(FLAGS_carver_block_size));
-  startParams.add("carve_size", pFile.size());
+  startParams.add("carve_size", size);
   startParams.add("carve_id", carveGuid_);
   startParams.add("request_id", requestId_);
   startParams.add("node_key", getNodeKey("tls"));
@@ -326,41 +517,31 @@ Status Carver::postCarve(const boost::filesystem::path& path) {
     return Status(1, "Invalid session_id received from remote endpoint");
   }
 
-  std::string session_id = it->value.GetString();
+  session_id = it->value.GetString();
   if (session_id.empty()) {
     return Status(1, "Empty session_id received from remote endpoint");
   }
+  return Status::success();
+}
 
+Status Carver::postBlock(size_t block_id,
+                         const std::string& session_id,
+                         const std::string& data) {
+  // Each post uses a pooled connection, one per concurrent block.
   auto contUri = TLSRequestHelper::makeURI(FLAGS_carver_continue_endpoint);
   Request<TLSTransport, JSONSerializer> contRequest(contUri);
   contRequest.setOption("hostname", FLAGS_tls_hostname);
-  for (size_t i = 0; i < blkCount; i++) {
-    std::vector<char> block(FLAGS_carver_block_size, 0);
-    auto r = pFile.read(block.data(), FLAGS_carver_block_size);
-
-    if (r != FLAGS_carver_block_size && r > 0) {
-      // resize the buffer to size we read as last block is likely smaller
-      block.resize(r);
-    }
-
-    JSON params;
-    params.add("block_id", i);
-    params.add("session_id", session_id);
-    params.add("request_id", requestId_);
-    params.add("data", base64::encode(std::string(block.begin(), block.end())));
-
-    // TODO: Error sending files.
-    status = contRequest.call(params);
-    if (!status.ok()) {
-      VLOG(1) << "Post of carved block " << i
-              << " failed: " << status.getMessage();
-      continue;
-    }
+  if (FLAGS_carver_compress_requests) {
+    contRequest.setOption("compress", true);
   }
 
-  updateCarveValue(carveGuid_, "status", kCarverStatusSuccess);
-  return Status::success();
-};
+  JSON params;
+  params.add("block_id", block_id);
+  params.add("session_id", session_id);
+  params.add("request_id", requestId_);
+  params.add("data", base64::encode(data));
+  return contRequest.call(params);
+}
 
 void scheduleCarves() {
   if (!FLAGS_disable_carver && kCarverPendingCarves &&
@@ -16,6 +16,7 @@
 #include <atomic>
 #include <set>
 #include <string>
+#include <vector>
 
 namespace osquery {
 
@@ -102,73 +103,83 @@ class Carver {
    */
   Status carve();
 
-  /// Create the archive and compression paths.
-  Status createPaths();
-
  protected:
   /**
-   * @brief A helper function that 'carves' all files from disk.
+   * @brief A helper function that selects all files to carve from disk.
    *
-   * This function copies all source files to a temporary directory and returns
-   * a list of all destination files.
+   * Directories and files that cannot be opened are skipped. The size of
+   * each file is recorded, the archive keeps it even if the file changes.
    */
-  std::set<boost::filesystem::path> carveAll();
+  std::vector<ArchiveFile> carveAll();
 
   /**
-   * @brief A helper function that does a blockwise copy from src to dst.
+   * @brief Stream the carve archive to a sink.
    *
-   * This function copies the source file to the destination file, doing so
-   * by blocks specified with FLAGS_carver_block_size (defaults to 8K).
+   * The files are read, archived, and compressed if carver_compression is
+   * set, a block at a time.
    */
-  Status blockwiseCopy(PlatformFile& src, PlatformFile& dst);
+  Status streamCarve(const std::vector<ArchiveFile>& files,
+                     const ArchiveSink& sink);
+
+  /// The temporary file the archive of this carve is spooled to.
+  boost::filesystem::path spoolPath() const;
+
+  /// Remove the spooled archive, if any.
+  static void removeSpool(const boost::filesystem::path& spool);
 
   /**
-   * @brief Helper function to POST a carve to the graph endpoint.
+   * @brief Write the carve archive to a spool, measuring its size and SHA256.
    *
-   * Once all of the files have been carved and the tgz has been
-   * created, we POST the carved file to an endpoint specified by the
-   * carver_start_endpoint and carver_continue_endpoint.
+   * The carved files are read once. The upload reads the spool, so a file
+   * changing during the upload cannot change the archive the server
+   * receives.
    */
-  virtual Status postCarve(const boost::filesystem::path& path);
-
-  /// Helper function to return the carve directory.
-  boost::filesystem::path getCarveDir() {
-    return carveDir_;
-  }
+  Status spoolCarve(const std::vector<ArchiveFile>& files,
+                    const boost::filesystem::path& spool,
+                    uint64_t& size,
+                    std::string& hash);
 
- protected:
   /**
-   * @brief a variable to keep track of the temp path used in carving.
+   * @brief Helper function to POST a carve to the graph endpoint.
+   *
+   * The spooled archive is read and POSTed block by block to an endpoint
+   * specified by the carver_start_endpoint and carver_continue_endpoint.
+   *
+   * Up to carver_parallel_uploads blocks are posted at once, and each block
+   * is retried. The acknowledged blocks are stored with the carve, so an
+   * upload interrupted by a restart resumes in the same session.
    *
-   * This variable represents the location in which we store all of our carved
-   * files. When a carve has completed all of the desired files, as well
-   * as the tar archive should reside in this directory.
+   * @param spool The spooled archive.
+   * @param size The size of the archive, measured by spoolCarve.
    */
-  boost::filesystem::path carveDir_;
+  virtual Status postCarve(const boost::filesystem::path& spool,
+                           uint64_t size);
 
   /**
-   * @brief a variable tracking all of the paths we attempt to carve.
+   * @brief Request an upload session from the carver_start_endpoint.
    *
-   * This is a globbed set of file paths that we're expecting will be
-   * carved.
+   * @param size The size of the archive.
+   * @param session_id The output session of the block posts.
    */
-  std::set<boost::filesystem::path> carvePaths_;
+  virtual Status startCarve(uint64_t size, std::string& session_id);
 
   /**
-   * @brief a helper variable for keeping track of the posix tar archive.
+   * @brief POST one block to the carver_continue_endpoint, without retries.
    *
-   * This variable is the absolute location of the tar archive created from
-   * tar'ing all of the carved files from the carve temp dir.
+   * Blocks are posted from several threads at once, in any order.
    */
-  boost::filesystem::path archivePath_;
+  virtual Status postBlock(size_t block_id,
+                           const std::string& session_id,
+                           const std::string& data);
 
+ protected:
   /**
-   * @brief a helper variable for keeping track of the compressed tar.
+   * @brief a variable tracking all of the paths we attempt to carve.
    *
-   * This variable is the absolute location of the tar archive created from
-   * zstd of the archive.
+   * This is a globbed set of file paths that we're expecting will be
+   * carved.
    */
-  boost::filesystem::path compressPath_;
+  std::set<boost::filesystem::path> carvePaths_;
 
   /**
    * @brief a unique ID identifying the 'carve'.
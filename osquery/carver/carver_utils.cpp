@@ -61,6 +61,26 @@ void updateCarveValue(const std::string& guid,
   }
 }
 
+std::string getCarveValue(const std::string& guid, const std::string& key) {
+  std::string carve;
+  auto s = getDatabaseValue(kCarves, kCarverDBPrefix + guid, carve);
+  if (!s.ok()) {
+    return "";
+  }
+
+  JSON tree;
+  s = tree.fromString(carve);
+  if (!s.ok() || !tree.doc().IsObject()) {
+    return "";
+  }
+
+  auto it = tree.doc().FindMember(key.c_str());
+  if (it == tree.doc().MemberEnd() || !it->value.IsString()) {
+    return "";
+  }
+  return it->value.GetString();
+}
+
 std::string createCarveGuid() {
   return boost::uuids::to_string(boost::uuids::random_generator()());
 }
@@ -17,12 +17,6 @@
 
 namespace osquery {
 
-/// Prefix used for the temp FS where carved files are stored.
-const std::string kCarvePathPrefix = "osquery_carve_";
-
-/// Prefix applied to the file carve tar archive.
-const std::string kCarveNamePrefix = "carve_";
-
 /// Database prefix used to directly access and manipulate our carver entries.
 const std::string kCarverDBPrefix = "carves.";
 
@@ -32,6 +26,9 @@ const std::string kCarverStatusSuccess = "SUCCESS";
 /// Internal carver 'status' indicating a carve request scheduled.
 const std::string kCarverStatusScheduled = "SCHEDULED";
 
+/// Internal carver 'status' indicating blocks are being uploaded.
+const std::string kCarverStatusUploading = "UPLOADING";
+
 /**
  * @brief This flag is an optimization attempt used by the CarverRunner.
  *
@@ -50,6 +47,9 @@ void updateCarveValue(const std::string& guid,
                       const std::string& key,
                       const std::string& value);
 
+/// Get a string attribute of a given carve GUID, empty if missing.
+std::string getCarveValue(const std::string& guid, const std::string& key);
+
 /// Returns a UUID.
 std::string createCarveGuid();
 
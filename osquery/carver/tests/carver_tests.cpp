@@ -7,12 +7,17 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <functional>
+#include <map>
+#include <mutex>
+
 #include <boost/filesystem.hpp>
 
 #include <gtest/gtest.h>
 
 #include <osquery/carver/carver.h>
 #include <osquery/carver/carver_utils.h>
+#include <osquery/core/flags.h>
 #include <osquery/core/system.h>
 #include <osquery/database/database.h>
 #include <osquery/filesystem/fileops.h>
@@ -22,10 +27,10 @@
 
 namespace osquery {
 
-namespace fs = boost::filesystem;
+DECLARE_uint32(carver_block_size);
+DECLARE_uint32(carver_parallel_uploads);
 
-/// Prefix used for posix tar archive.
-const std::string kTestCarveNamePrefix = "carve_";
+namespace fs = boost::filesystem;
 
 class FakeCarver : public Carver {
  public:
@@ -35,7 +40,14 @@ class FakeCarver : public Carver {
       : Carver(paths, guid, requestId) {}
 
  protected:
-  Status postCarve(const boost::filesystem::path&) override {
+  Status postCarve(const fs::path& spool, uint64_t size) override {
+    // Read the spooled archive the same way it is uploaded.
+    std::string content;
+    auto s = readFile(spool, content);
+    if (!s.ok() || content.size() != size) {
+      return Status::failure("Unexpected carve archive");
+    }
+
     updateCarveValue(carveGuid_, "status", kCarverStatusSuccess);
     return Status::success();
   }
@@ -45,6 +57,54 @@ class FakeCarver : public Carver {
   FRIEND_TEST(CarverTests, test_carve_files_locally);
   FRIEND_TEST(CarverTests, test_carve_start);
   FRIEND_TEST(CarverTests, test_carve_files_not_exists);
+  FRIEND_TEST(CarverTests, test_carve_file_changed);
+};
+
+/// Keeps the posted blocks instead of sending them.
+class UploadCarver : public Carver {
+ public:
+  UploadCarver(const std::set<std::string>& paths,
+               const std::string& guid,
+               const std::string& requestId)
+      : Carver(paths, guid, requestId) {}
+
+ protected:
+  Status startCarve(uint64_t, std::string& session_id) override {
+    starts++;
+    if (on_start != nullptr) {
+      on_start();
+    }
+    session_id = "session";
+    return Status::success();
+  }
+
+  Status postBlock(size_t block_id,
+                   const std::string& session_id,
+                   const std::string& data) override {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (session_id.empty()) {
+      return Status::failure("No session");
+    }
+    if (block_id == fail_block && !failed) {
+      failed = true;
+      return Status::failure("Block failed");
+    }
+    blocks[block_id] = data;
+    return Status::success();
+  }
+
+ public:
+  size_t starts{0};
+  std::function<void()> on_start;
+  size_t fail_block{0};
+  bool failed{true};
+  std::map<size_t, std::string> blocks;
+  std::mutex mutex;
+
+ private:
+  FRIEND_TEST(CarverTests, test_carve_parallel_upload);
+  FRIEND_TEST(CarverTests, test_carve_resume_upload);
+  FRIEND_TEST(CarverTests, test_carve_file_changed_during_upload);
 };
 
 class FakeCarverRunner : public CarverRunner<FakeCarver> {
@@ -114,18 +174,54 @@ TEST_F(CarverTests, test_carve_files_locally) {
   std::string requestId = createCarveGuid();
   FakeCarver carve(getCarvePaths(), guid, requestId);
 
-  ASSERT_TRUE(carve.createPaths());
   const auto carves = carve.carveAll();
   EXPECT_EQ(carves.size(), 3U);
 
-  const auto carveFSPath = carve.getCarveDir();
-  const auto tarPath = carveFSPath / (kTestCarveNamePrefix + guid + ".tar");
-  const auto s = archive(carves, tarPath);
-  EXPECT_TRUE(s.ok());
-
-  PlatformFile tar(tarPath, PF_OPEN_EXISTING | PF_READ);
-  EXPECT_TRUE(tar.isValid());
+  std::string tar;
+  auto s = carve.streamCarve(carves, [&tar](const char* data, size_t len) {
+    tar.append(data, len);
+    return Status::success();
+  });
+  ASSERT_TRUE(s.ok()) << s.getMessage();
   EXPECT_GT(tar.size(), 0U);
+  EXPECT_NE(tar.find("This is a hidden file"), std::string::npos);
+
+  // The spool holds the same archive.
+  auto spool = getWorkingDir() / "spool";
+  uint64_t size = 0;
+  std::string hash;
+  s = carve.spoolCarve(carves, spool, size, hash);
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  EXPECT_EQ(size, tar.size());
+  EXPECT_EQ(hash,
+            hashFromBuffer(HashType::HASH_TYPE_SHA256, tar.data(), tar.size()));
+
+  std::string spooled;
+  ASSERT_TRUE(readFile(spool, spooled).ok());
+  EXPECT_EQ(tar, spooled);
+}
+
+TEST_F(CarverTests, test_carve_file_changed) {
+  auto guid = createCarveGuid();
+  std::string requestId = createCarveGuid();
+  FakeCarver carve(getCarvePaths(), guid, requestId);
+  const auto carves = carve.carveAll();
+
+  auto spool = getWorkingDir() / "spool";
+  uint64_t size = 0;
+  std::string hash;
+  auto s = carve.spoolCarve(carves, spool, size, hash);
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+
+  // A file that grows keeps its archived size, the archive size is stable.
+  writeTextFileToCarve(getFilesToCarveDir() / "secrets.txt",
+                       "This is a much longer message I'd rather no one saw.");
+  uint64_t changed_size = 0;
+  std::string changed_hash;
+  s = carve.spoolCarve(carves, spool, changed_size, changed_hash);
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  EXPECT_EQ(size, changed_size);
+  EXPECT_NE(hash, changed_hash);
 }
 
 TEST_F(CarverTests, test_carve) {
@@ -290,4 +386,111 @@ oqADd9Ckcdtplx3k7bcLU[U04j8WWUtUccmB+4e2KS]i3x7WDKviPY/sWy9xFapv
                    (getWorkingDir() / fs::path("test.data.extract")).string()),
       hashFromFile(HashType::HASH_TYPE_SHA256, test_data_file.string()));
 }
+
+TEST_F(CarverTests, test_carve_parallel_upload) {
+  auto block_size = FLAGS_carver_block_size;
+  auto parallel_uploads = FLAGS_carver_parallel_uploads;
+  FLAGS_carver_block_size = 1024;
+  FLAGS_carver_parallel_uploads = 4;
+
+  std::string guid;
+  auto s = osquery::carvePaths(getCarvePaths(), "request-id", guid);
+  ASSERT_TRUE(s.ok());
+
+  UploadCarver carve(getCarvePaths(), guid, "request-id");
+  // The second block fails once and is retried.
+  carve.fail_block = 1;
+  carve.failed = false;
+  s = carve.carve();
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  EXPECT_EQ(1U, carve.starts);
+  EXPECT_TRUE(carve.failed);
+  EXPECT_EQ(kCarverStatusSuccess, getCarveValue(guid, "status"));
+
+  std::string tar;
+  s = carve.streamCarve(carve.carveAll(),
+                        [&tar](const char* data, size_t len) {
+                          tar.append(data, len);
+                          return Status::success();
+                        });
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+
+  // The blocks were posted out of order, but reassemble the archive.
+  std::string uploaded;
+  size_t expected_id = 0;
+  for (const auto& block : carve.blocks) {
+    EXPECT_EQ(expected_id++, block.first);
+    uploaded += block.second;
+  }
+  EXPECT_GT(carve.blocks.size(), 1U);
+  EXPECT_EQ(tar, uploaded);
+
+  FLAGS_carver_block_size = block_size;
+  FLAGS_carver_parallel_uploads = parallel_uploads;
+}
+
+TEST_F(CarverTests, test_carve_resume_upload) {
+  auto block_size = FLAGS_carver_block_size;
+  FLAGS_carver_block_size = 1024;
+
+  std::string guid;
+  auto s = osquery::carvePaths(getCarvePaths(), "request-id", guid);
+  ASSERT_TRUE(s.ok());
+
+  UploadCarver carve(getCarvePaths(), guid, "request-id");
+  uint64_t size = 0;
+  std::string hash;
+  s = carve.spoolCarve(carve.carveAll(), carve.spoolPath(), size, hash);
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+
+  // A restart interrupted the upload after two acknowledged blocks.
+  updateCarveValue(guid, "status", kCarverStatusUploading);
+  updateCarveValue(guid, "size", std::to_string(size));
+  updateCarveValue(guid, "sha256", hash);
+  updateCarveValue(guid, "block_size", "1024");
+  updateCarveValue(guid, "session_id", "resumed");
+  updateCarveValue(guid, "blocks_acked", "2");
+
+  s = carve.carve();
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  EXPECT_EQ(0U, carve.starts);
+  ASSERT_FALSE(carve.blocks.empty());
+  EXPECT_EQ(2U, carve.blocks.begin()->first);
+  EXPECT_EQ("resumed", getCarveValue(guid, "session_id"));
+  EXPECT_EQ(kCarverStatusSuccess, getCarveValue(guid, "status"));
+
+  FLAGS_carver_block_size = block_size;
+}
+
+TEST_F(CarverTests, test_carve_file_changed_during_upload) {
+  auto block_size = FLAGS_carver_block_size;
+  FLAGS_carver_block_size = 1024;
+
+  std::string guid;
+  auto s = osquery::carvePaths(getCarvePaths(), "request-id", guid);
+  ASSERT_TRUE(s.ok());
+
+  // A file changes after the archive was spooled, before any block is sent.
+  UploadCarver carve(getCarvePaths(), guid, "request-id");
+  carve.on_start = [this]() {
+    writeTextFileToCarve(getFilesToCarveDir() / "secrets.txt",
+                         "This is another message I'd rather no one saw.");
+  };
+  s = carve.carve();
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  EXPECT_EQ(kCarverStatusSuccess, getCarveValue(guid, "status"));
+
+  // The server receives the spooled archive, matching the announced hash.
+  std::string uploaded;
+  for (const auto& block : carve.blocks) {
+    uploaded += block.second;
+  }
+  EXPECT_EQ(getCarveValue(guid, "size"), std::to_string(uploaded.size()));
+  EXPECT_EQ(getCarveValue(guid, "sha256"),
+            hashFromBuffer(
+                HashType::HASH_TYPE_SHA256, uploaded.data(), uploaded.size()));
+  EXPECT_FALSE(fs::exists(carve.spoolPath()));
+
+  FLAGS_carver_block_size = block_size;
+}
 } // namespace osquery
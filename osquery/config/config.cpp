@@ -8,10 +8,13 @@
  */
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <functional>
 #include <map>
+#include <memory>
 #include <queue>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -22,6 +25,7 @@
 #include <osquery/config/packs.h>
 #include <osquery/core/flagalias.h>
 #include <osquery/core/flags.h>
+#include <osquery/core/query_accounting.h>
 #include <osquery/core/shutdown.h>
 #include <osquery/core/system.h>
 #include <osquery/core/tables.h>
@@ -31,10 +35,12 @@
 #include <osquery/events/events.h>
 #include <osquery/hashing/hashing.h>
 #include <osquery/logger/logger.h>
+#include <osquery/profiler/code_profiler.h>
 #include <osquery/registry/registry.h>
 #include <osquery/utils/conversions/split.h>
 #include <osquery/utils/conversions/trim.h>
 #include <osquery/utils/conversions/tryto.h>
+#include <osquery/utils/system/env.h>
 #include <osquery/utils/system/time.h>
 
 namespace rj = rapidjson;
@@ -52,6 +58,15 @@ const int kMaxConfigSize = 1024 * 1024;
 using ConfigMap = std::map<std::string, std::string>;
 
 std::atomic<bool> is_first_time_refresh(true);
+
+/// Hash the serialized content of a JSON value.
+std::string hashValue(const rj::Value& value) {
+  auto content = JSON::valueToString(value);
+
+  Hash hash(HASH_TYPE_SHA1);
+  hash.update(content.c_str(), content.size());
+  return hash.digest();
+}
 }; // namespace
 
 /**
@@ -119,6 +134,9 @@ DECLARE_string(pack_delimiter);
 const std::string kExecutingQuery{"executing_query"};
 const std::string kFailedQueries{"failed_queries"};
 
+/// Seconds a failed query is denylisted.
+const uint64_t kDenylistDuration{86400};
+
 // The config may be accessed and updated asynchronously; use mutexes.
 Mutex config_hash_mutex_;
 Mutex config_refresh_mutex_;
@@ -127,7 +145,9 @@ Mutex config_backup_mutex_;
 /// Several config methods require enumeration via predicate lambdas.
 RecursiveMutex config_schedule_mutex_;
 RecursiveMutex config_files_mutex_;
-RecursiveMutex config_performance_mutex_;
+
+/// Incremented whenever packs are added to or removed from the schedule.
+std::atomic<uint64_t> kScheduleGeneration{0};
 
 using PackRef = std::unique_ptr<Pack>;
 
@@ -170,8 +190,12 @@ class Schedule : private boost::noncopyable {
   /// Remove a pack by name and source.
   void remove(const std::string& pack, const std::string& source);
 
-  /// Remove all packs by source.
-  void removeAll(const std::string& source);
+  /// Remove the packs of a source except some, returns the removed names.
+  std::vector<std::string> removeAllExcept(const std::string& source,
+                                           const std::set<std::string>& keep);
+
+  /// Find a pack by name and source, nullptr if there is none.
+  Pack* find(const std::string& pack, const std::string& source);
 
   /// Boost gives us a nice template for maintaining the state of the iterator
   using iterator = boost::filter_iterator<Step, container::iterator>;
@@ -234,17 +258,30 @@ void Schedule::remove(const std::string& pack, const std::string& source) {
   packs_.erase(new_end, packs_.end());
 }
 
-void Schedule::removeAll(const std::string& source) {
-  auto new_end =
-      std::remove_if(packs_.begin(), packs_.end(), [source](const PackRef& p) {
-        if (p->getSource() == source) {
+std::vector<std::string> Schedule::removeAllExcept(
+    const std::string& source, const std::set<std::string>& keep) {
+  std::vector<std::string> removed;
+  auto new_end = std::remove_if(
+      packs_.begin(), packs_.end(), [&](const PackRef& p) {
+        if (p->getSource() == source && keep.count(p->getName()) == 0) {
           Config::get().removeFiles(source + FLAGS_pack_delimiter +
                                     p->getName());
+          removed.push_back(p->getName());
           return true;
         }
         return false;
       });
   packs_.erase(new_end, packs_.end());
+  return removed;
+}
+
+Pack* Schedule::find(const std::string& pack, const std::string& source) {
+  for (auto& p : packs_) {
+    if (p->getName() == pack && p->getSource() == source) {
+      return p.get();
+    }
+  }
+  return nullptr;
 }
 
 Schedule::iterator Schedule::begin() {
@@ -259,6 +296,75 @@ PackRef& Schedule::last() {
   return packs_.back();
 }
 
+/**
+ * @brief The performance of each scheduled query.
+ *
+ * Each query's statistics are an immutable snapshot, replaced as a whole when
+ * an execution is recorded. Readers copy the current snapshot and use it
+ * without holding a lock, so reading the osquery_schedule table never waits
+ * for the scheduler, and neither uses the schedule lock.
+ */
+class QueryPerformanceStats : private boost::noncopyable {
+ public:
+  using Snapshot = std::shared_ptr<const QueryPerformance>;
+
+  /// Replace the statistics of a query with the result of update.
+  void update(const std::string& name,
+              const std::function<void(QueryPerformance&)>& update) {
+    auto slot = getSlot(name);
+    WriteLock lock(slot->writer);
+    auto current = std::atomic_load(&slot->snapshot);
+    auto next = std::make_shared<QueryPerformance>(*current);
+    update(*next);
+    std::atomic_store(&slot->snapshot, Snapshot(std::move(next)));
+  }
+
+  /// The current statistics of a query, or nullptr if it never executed.
+  Snapshot get(const std::string& name) const {
+    ReadLock lock(mutex_);
+    auto it = slots_.find(name);
+    if (it == slots_.end()) {
+      return nullptr;
+    }
+    return std::atomic_load(&it->second->snapshot);
+  }
+
+  void clear() {
+    WriteLock lock(mutex_);
+    slots_.clear();
+  }
+
+ private:
+  struct Slot {
+    /// Serializes the updates of a query, readers do not take it.
+    Mutex writer;
+    Snapshot snapshot{std::make_shared<const QueryPerformance>()};
+  };
+
+  /// Find or add the slot of a query, slots are only removed by clear.
+  std::shared_ptr<Slot> getSlot(const std::string& name) {
+    {
+      ReadLock lock(mutex_);
+      auto it = slots_.find(name);
+      if (it != slots_.end()) {
+        return it->second;
+      }
+    }
+
+    WriteLock lock(mutex_);
+    auto& slot = slots_[name];
+    if (slot == nullptr) {
+      slot = std::make_shared<Slot>();
+    }
+    return slot;
+  }
+
+ private:
+  /// Protects the set of slots, not their statistics.
+  mutable Mutex mutex_;
+  std::map<std::string, std::shared_ptr<Slot>> slots_;
+};
+
 /**
  * @brief A thread that periodically reloads configuration state.
  *
@@ -322,17 +428,33 @@ Schedule::Schedule() {
 
   // Check if any queries were executing when the tool last stopped.
   getDatabaseValue(kPersistentSettings, kExecutingQuery, failed_query_);
+
+  // The watcher measured the queries running when it stopped the worker, the
+  // executing query is only the last one that started. When the measurement
+  // blamed no query the variable is not set and the executing query is
+  // denylisted.
+  auto culprit = getEnvVar(kWatchdogCulpritEnv);
+  if (culprit.is_initialized() && *culprit != failed_query_) {
+    if (!failed_query_.empty()) {
+      VLOG(1) << "The watchdog did not blame the executing query: "
+              << failed_query_;
+      setDatabaseValue(kPersistentSettings, kExecutingQuery, "");
+    }
+    failed_query_ = *culprit;
+  }
+
   if (!failed_query_.empty()) {
     LOG(WARNING) << "Scheduled query may have failed: " << failed_query_;
     setDatabaseValue(kPersistentSettings, kExecutingQuery, "");
     // Add this query name to the denylist and save the denylist.
-    denylist_[failed_query_] = getUnixTime() + 86400;
+    denylist_[failed_query_] = getUnixTime() + kDenylistDuration;
     saveScheduleDenylist(denylist_);
   }
 }
 
 Config::Config()
     : schedule_(std::make_unique<Schedule>()),
+      performance_(std::make_unique<QueryPerformanceStats>()),
       valid_(false),
       refresh_runner_(std::make_shared<ConfigRefreshRunner>()) {}
 
@@ -348,11 +470,25 @@ void Config::addPack(const std::string& name,
 
   auto addSinglePack = ([this, &source](const std::string pack_name,
                                         const rj::Value& pack_obj) {
+    auto key = source + FLAGS_pack_delimiter + pack_name;
+    auto hash = hashValue(pack_obj);
+
     RecursiveLock wlock(config_schedule_mutex_);
+    added_packs_.insert(pack_name);
     try {
-      schedule_->add(std::make_unique<Pack>(pack_name, source, pack_obj));
+      // An unchanged pack keeps its queries and their state.
+      auto pack = schedule_->find(pack_name, source);
+      auto hash_it = pack_hash_.find(key);
+      if (pack == nullptr || hash_it == pack_hash_.end() ||
+          hash_it->second != hash) {
+        schedule_->add(std::make_unique<Pack>(pack_name, source, pack_obj));
+        kScheduleGeneration++;
+        pack_hash_[key] = hash;
+        forgetParserHashes(key);
+        pack = schedule_->last().get();
+      }
 #ifndef OSQUERY_IS_FUZZING
-      bool should_pack_execute = schedule_->last()->shouldPackExecute();
+      bool should_pack_execute = pack->shouldPackExecute();
 #else
       bool should_pack_execute = true;
 #endif
@@ -383,7 +519,23 @@ void Config::addPack(const std::string& name,
 
 void Config::removePack(const std::string& pack) {
   RecursiveLock wlock(config_schedule_mutex_);
-  return schedule_->remove(pack);
+  schedule_->remove(pack);
+  for (auto it = pack_hash_.begin(); it != pack_hash_.end();) {
+    auto delimiter = it->first.rfind(FLAGS_pack_delimiter + pack);
+    if (delimiter != std::string::npos &&
+        delimiter + FLAGS_pack_delimiter.size() + pack.size() ==
+            it->first.size()) {
+      forgetParserHashes(it->first);
+      it = pack_hash_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  kScheduleGeneration++;
+}
+
+uint64_t Config::getScheduleGeneration() const {
+  return kScheduleGeneration;
 }
 
 void Config::addFile(const std::string& source,
@@ -507,8 +659,9 @@ Status Config::refresh() {
   }
 
   // if there was a response, parse it and update internal state
+  // A plugin returns no sources if the config did not change.
   valid_ = true;
-  if (response.size() > 0) {
+  if (response.size() > 0 && !response[0].empty()) {
     if (FLAGS_config_dump) {
       // If config checking is enabled, debug-write the raw config data.
       for (const auto& content : response[0]) {
@@ -523,6 +676,18 @@ Status Config::refresh() {
       return Status::success();
     }
     status = update(response[0]);
+
+    // External config plugins are not told, they do not cache in the core.
+    auto active = RegistryFactory::get().getActive("config");
+    auto plugin = std::dynamic_pointer_cast<ConfigPlugin>(
+        Registry::get().plugin("config", active));
+    if (plugin != nullptr) {
+      plugin->configApplied(status);
+    }
+  } else if (refreshParsers()) {
+    // The content did not change but the state some parsers derive from the
+    // host did, e.g. the paths selected by a file_paths_query.
+    reconfigure();
   }
 
   is_first_time_refresh = false;
@@ -680,37 +845,43 @@ Status Config::updateSource(const std::string& source,
     return Status(2);
   }
 
-  {
-    RecursiveLock lock(config_schedule_mutex_);
-    // Remove all packs from this source.
-    schedule_->removeAll(source);
-    // Remove all files from this source.
-    removeFiles(source);
-  }
-
-  // load the config (source.second) into a JSON object.
-  auto doc = JSON::newObject();
+  // load the config (source.second) into a JSON object, the clone is parsed
+  // in place and must outlive the document.
   auto clone = json;
   stripConfigComments(clone);
+  auto doc = JSON::newObject();
 
   // Since we use iterative parsing, we limit the size of the JSON
   // string to a sane value to avoid memory exhaustion.
+  Status status;
   if (clone.size() > kMaxConfigSize) {
-    return Status::failure(
+    status = Status::failure(
         "Error parsing the config JSON: the config size exceeds the limit "
         "of " +
         std::to_string(kMaxConfigSize) + " bytes");
+  } else if (!doc.fromStringInsitu(clone) || !doc.doc().IsObject()) {
+    status = Status::failure("Error parsing the config JSON");
+  } else {
+    status = validateConfig(doc);
+    if (!status.ok()) {
+      status = Status::failure("Error validating the config JSON: " +
+                               status.getMessage());
+    }
   }
 
-  if (!doc.fromString(clone, JSON::ParseMode::Iterative) ||
-      !doc.doc().IsObject()) {
-    return Status::failure("Error parsing the config JSON");
+  if (!status.ok()) {
+    // Nothing of an invalid source is kept.
+    RecursiveLock lock(config_schedule_mutex_);
+    schedule_->removeAllExcept(source, {});
+    kScheduleGeneration++;
+    removeFiles(source);
+    forgetSourceHashes(source);
+    return status;
   }
 
-  auto status = validateConfig(doc);
-  if (!status.ok()) {
-    return Status::failure("Error validating the config JSON: " +
-                           status.getMessage());
+  {
+    RecursiveLock lock(config_schedule_mutex_);
+    added_packs_.clear();
   }
 
   // extract the "schedule" key and store it as the main pack
@@ -718,11 +889,11 @@ Status Config::updateSource(const std::string& source,
   if (doc.doc().HasMember("schedule") && !rf.external()) {
     auto& schedule = doc.doc()["schedule"];
     if (schedule.IsObject()) {
-      auto main_doc = JSON::newObject();
-      auto queries_obj = main_doc.getObject();
-      main_doc.copyFrom(schedule, queries_obj);
-      main_doc.add("queries", queries_obj);
-      addPack("main", source, main_doc.doc());
+      // Lend the schedule to the main pack instead of copying it.
+      rj::Value main_obj(rj::kObjectType);
+      main_obj.AddMember("queries", schedule, doc.doc().GetAllocator());
+      addPack("main", source, main_obj);
+      schedule = main_obj["queries"];
     }
   }
 
@@ -742,10 +913,54 @@ Status Config::updateSource(const std::string& source,
     }
   }
 
+  {
+    // Only the packs this source does not have anymore are removed.
+    RecursiveLock lock(config_schedule_mutex_);
+    auto removed = schedule_->removeAllExcept(source, added_packs_);
+    for (const auto& pack : removed) {
+      pack_hash_.erase(source + FLAGS_pack_delimiter + pack);
+      forgetParserHashes(source + FLAGS_pack_delimiter + pack);
+    }
+    if (!removed.empty()) {
+      kScheduleGeneration++;
+    }
+  }
+
   applyParsers(source, doc.doc(), false);
   return Status::success();
 }
 
+void Config::forgetSourceHashes(const std::string& source) {
+  RecursiveLock lock(config_schedule_mutex_);
+  auto prefix = source + FLAGS_pack_delimiter;
+  for (auto it = pack_hash_.begin(); it != pack_hash_.end();) {
+    if (it->first.compare(0, prefix.size(), prefix) == 0) {
+      it = pack_hash_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  for (auto& parser : parser_hash_) {
+    auto& hashes = parser.second;
+    for (auto it = hashes.begin(); it != hashes.end();) {
+      if (it->first == source ||
+          it->first.compare(0, prefix.size(), prefix) == 0) {
+        it = hashes.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
+void Config::forgetParserHashes(const std::string& source) {
+  RecursiveLock lock(config_schedule_mutex_);
+  for (auto& parser : parser_hash_) {
+    parser.second.erase(source);
+  }
+}
+
 Status Config::genPack(const std::string& name,
                        const std::string& source,
                        const std::string& target) {
@@ -783,10 +998,12 @@ void Config::applyParsers(const std::string& source,
   assert(obj.IsObject());
 
   auto applyParser = [=](const std::shared_ptr<ConfigParserPlugin>& parser,
+                         const std::string& name,
                          const std::string& source,
                          const rj::Value& obj) {
     // For each key requested by the parser, add a property tree reference.
     std::map<std::string, JSON> parser_config;
+    Hash hash(HASH_TYPE_SHA1);
     for (const auto& key : parser->keys()) {
       if (obj.HasMember(key) && !obj[key].IsNull()) {
         if (!obj[key].IsArray() && !obj[key].IsObject()) {
@@ -796,13 +1013,29 @@ void Config::applyParsers(const std::string& source,
         }
 
         auto doc = JSON::newFromValue(obj[key]);
+        auto section = key + "=" + hashValue(doc.doc()) + ";";
+        hash.update(section.c_str(), section.size());
         parser_config.emplace(key, std::move(doc));
       }
     }
+
+    // The parser already holds the state of unchanged sections.
+    auto digest = hash.digest();
+    auto& hashes = parser_hash_[name];
+    auto hash_it = hashes.find(source);
+    if (hash_it != hashes.end() && hash_it->second == digest) {
+      return;
+    }
+
     // The config parser plugin will receive a copy of each property tree for
     // each top-level-config key. The parser may choose to update the config's
     // internal state
-    parser->update(source, parser_config);
+    ScopedProfile profile("config_parser", name);
+    if (parser->update(source, parser_config).ok()) {
+      hashes[source] = digest;
+    } else {
+      hashes.erase(source);
+    }
   };
 
   auto getParser = [=](const PluginRef& plugin, const std::string& name) {
@@ -823,7 +1056,7 @@ void Config::applyParsers(const std::string& source,
   if (options_plugin != plugins.end()) {
     auto parser = getParser(options_plugin->second, options_plugin->first);
     if (parser != nullptr && parser.get() != nullptr) {
-      applyParser(parser, source, obj);
+      applyParser(parser, options_plugin->first, source, obj);
     }
   }
 
@@ -834,7 +1067,7 @@ void Config::applyParsers(const std::string& source,
     }
     auto parser = getParser(plugin.second, plugin.first);
     if (parser != nullptr && parser.get() != nullptr) {
-      applyParser(parser, source, obj);
+      applyParser(parser, plugin.first, source, obj);
     }
   }
 }
@@ -885,7 +1118,23 @@ Status Config::update(const ConfigMap& config) {
     needs_reconfigure = true;
   }
 
-  if (loaded_ && needs_reconfigure) {
+  if (refreshParsers()) {
+    needs_reconfigure = true;
+  }
+
+  if (needs_reconfigure) {
+    reconfigure();
+  }
+
+  if (FLAGS_config_enable_backup) {
+    backupConfig(config);
+  }
+
+  return Status::success();
+}
+
+void Config::reconfigure() {
+  if (loaded_) {
     // The config has since been loaded.
     // This update call is most likely a response to an async update request
     // from a config plugin. This request should request all plugins to update.
@@ -902,23 +1151,37 @@ Status Config::update(const ConfigMap& config) {
 
   // This cannot be under the previous if block because on extensions loaded_
   // allways false.
-  if (needs_reconfigure) {
-    std::string loggers = RegistryFactory::get().getActive("logger");
-    for (const auto& logger : osquery::split(loggers, ",")) {
-      LOG(INFO) << "Calling configure for logger " << logger;
-      PluginRef plugin = Registry::get().plugin("logger", logger);
+  std::string loggers = RegistryFactory::get().getActive("logger");
+  for (const auto& logger : osquery::split(loggers, ",")) {
+    LOG(INFO) << "Calling configure for logger " << logger;
+    PluginRef plugin = Registry::get().plugin("logger", logger);
 
-      if (plugin) {
-        plugin->configure();
-      }
+    if (plugin) {
+      plugin->configure();
     }
   }
+}
 
-  if (FLAGS_config_enable_backup) {
-    backupConfig(config);
-  }
+bool Config::refreshParsers() {
+  bool changed = false;
+  RecursiveLock lock(config_schedule_mutex_);
+  for (const auto& plugin : RegistryFactory::get().plugins("config_parser")) {
+    std::shared_ptr<ConfigParserPlugin> parser = nullptr;
+    try {
+      parser = std::dynamic_pointer_cast<ConfigParserPlugin>(plugin.second);
+    } catch (const std::bad_cast& /* e */) {
+      continue;
+    }
+    if (parser == nullptr || parser.get() == nullptr) {
+      continue;
+    }
 
-  return Status::success();
+    ScopedProfile profile("config_parser", plugin.first);
+    if (parser->refresh()) {
+      changed = true;
+    }
+  }
+  return changed;
 }
 
 void Config::purge() {
@@ -938,9 +1201,11 @@ void Config::purge() {
   };
 
   RecursiveLock lock(config_schedule_mutex_);
-  // Iterate over each result set in the database.
+  // Iterate over each result set in the database, the keys holding the SQL,
+  // epoch, counter, digests and buckets of a result set are expired with it.
+  std::set<std::string> keys(saved_queries.begin(), saved_queries.end());
   for (const auto& saved_query : saved_queries) {
-    if (queryExists(saved_query)) {
+    if (queryExists(saved_query) || Query::isQueryDataKey(saved_query, keys)) {
       continue;
     }
 
@@ -969,6 +1234,10 @@ void Config::purge() {
       // Query has not run in the last week, expire results and interval.
       deleteDatabaseValue(kQueries, saved_query);
       deleteDatabaseValue(kQueries, saved_query + "epoch");
+      deleteDatabaseValue(kQueries, saved_query + "counter");
+      deleteDatabaseValue(kQueries, saved_query + "digests");
+      deleteDatabaseValue(kQueries, "query." + saved_query);
+      Query::deleteResultBuckets(saved_query);
       deleteDatabaseValue(kPersistentSettings, "interval." + saved_query);
       deleteDatabaseValue(kPersistentSettings, "timestamp." + saved_query);
       VLOG(1) << "Expiring results for scheduled query: " << saved_query;
@@ -980,9 +1249,16 @@ void Config::reset() {
   setStartTime(getUnixTime());
 
   schedule_ = std::make_unique<Schedule>();
-  std::map<std::string, QueryPerformance>().swap(performance_);
+  kScheduleGeneration++;
+  performance_->clear();
   std::map<std::string, FileCategories>().swap(files_);
   std::map<std::string, std::string>().swap(hash_);
+  {
+    RecursiveLock lock(config_schedule_mutex_);
+    std::map<std::string, std::string>().swap(pack_hash_);
+    std::map<std::string, std::map<std::string, std::string>>().swap(
+        parser_hash_);
+  }
   valid_ = false;
   loaded_ = false;
   is_first_time_refresh = true;
@@ -1022,52 +1298,54 @@ void Config::recordQueryPerformance(const std::string& name,
                                     uint64_t delay_ms,
                                     uint64_t size,
                                     const Row& r0,
-                                    const Row& r1) {
-  RecursiveLock lock(config_performance_mutex_);
-  if (performance_.count(name) == 0) {
-    performance_[name] = QueryPerformance();
-  }
-
-  // Grab access to the non-const schedule item.
-  auto& query = performance_.at(name);
-  if (!r1.at("user_time").empty() && !r0.at("user_time").empty()) {
-    auto ut1 = tryTo<long long>(r1.at("user_time"));
-    auto ut0 = tryTo<long long>(r0.at("user_time"));
-    auto diff = (ut1 && ut0) ? ut1.take() - ut0.take() : 0;
-    if (diff > 0) {
-      query.user_time += diff;
-      query.last_user_time = diff;
+                                    const Row& r1,
+                                    uint64_t allocated_bytes,
+                                    uint64_t peak_bytes) {
+  // The differences are computed before the query's statistics are updated.
+  auto getDiff = [&r0, &r1](const std::string& column) -> long long {
+    if (r1.at(column).empty() || r0.at(column).empty()) {
+      return 0;
+    }
+    auto v1 = tryTo<long long>(r1.at(column));
+    auto v0 = tryTo<long long>(r0.at(column));
+    return (v1 && v0) ? v1.take() - v0.take() : 0;
+  };
+  auto user_diff = getDiff("user_time");
+  auto system_diff = getDiff("system_time");
+  auto memory_diff = getDiff("resident_size");
+  auto now = getUnixTime();
+
+  performance_->update(name, [&](QueryPerformance& query) {
+    if (user_diff > 0) {
+      query.user_time += user_diff;
+      query.last_user_time = user_diff;
     }
-  }
 
-  if (!r1.at("system_time").empty() && !r0.at("system_time").empty()) {
-    auto st1 = tryTo<long long>(r1.at("system_time"));
-    auto st0 = tryTo<long long>(r0.at("system_time"));
-    auto diff = (st1 && st0) ? st1.take() - st0.take() : 0;
-    if (diff > 0) {
-      query.system_time += diff;
-      query.last_system_time = diff;
+    if (system_diff > 0) {
+      query.system_time += system_diff;
+      query.last_system_time = system_diff;
     }
-  }
 
-  if (!r1.at("resident_size").empty() && !r0.at("resident_size").empty()) {
-    auto rs1 = tryTo<long long>(r1.at("resident_size"));
-    auto rs0 = tryTo<long long>(r0.at("resident_size"));
-    auto diff = (rs1 && rs0) ? rs1.take() - rs0.take() : 0;
-    if (diff > 0) {
-      // Memory is stored as an average of RSS changes between query executions.
-      query.average_memory = (query.average_memory * query.executions) + diff;
+    if (memory_diff > 0) {
+      // Memory is stored as an average of RSS changes between executions.
+      query.average_memory =
+          (query.average_memory * query.executions) + memory_diff;
       query.average_memory = (query.average_memory / (query.executions + 1));
-      query.last_memory = diff;
+      query.last_memory = memory_diff;
     }
-  }
 
-  query.last_wall_time_ms = delay_ms;
-  query.wall_time_ms += delay_ms;
-  query.wall_time += (delay_ms / 1000);
-  query.output_size += size;
-  query.executions += 1;
-  query.last_executed = getUnixTime();
+    query.allocated_bytes += allocated_bytes;
+    query.last_allocated_bytes = allocated_bytes;
+    query.peak_bytes = std::max(query.peak_bytes, peak_bytes);
+    query.last_peak_bytes = peak_bytes;
+
+    query.last_wall_time_ms = delay_ms;
+    query.wall_time_ms += delay_ms;
+    query.wall_time += (delay_ms / 1000);
+    query.output_size += size;
+    query.executions += 1;
+    query.last_executed = now;
+  });
 
   /* Clear the executing query only if a resource limit has not been hit.
      This is used by the next worker execution to denylist a query
@@ -1088,12 +1366,22 @@ void Config::recordQueryStart(const std::string& name) {
       kPersistentSettings, "timestamp." + name, std::to_string(getUnixTime()));
 }
 
+void Config::denylistQuery(const std::string& name) {
+  {
+    RecursiveLock lock(config_schedule_mutex_);
+    schedule_->denylist_[name] = getUnixTime() + kDenylistDuration;
+    saveScheduleDenylist(schedule_->denylist_);
+  }
+  kScheduleGeneration++;
+}
+
 void Config::getPerformanceStats(
     const std::string& name,
     std::function<void(const QueryPerformance& query)> predicate) const {
-  if (performance_.count(name) > 0) {
-    RecursiveLock lock(config_performance_mutex_);
-    predicate(performance_.at(name));
+  // The predicate uses a snapshot, no lock is held while it runs.
+  auto query = performance_->get(name);
+  if (query != nullptr) {
+    predicate(*query);
   }
 }
 
@@ -1225,6 +1513,9 @@ Status ConfigParserPlugin::setUp() {
 }
 
 void ConfigRefreshRunner::start() {
+  // The refresh blocks on the config plugin, e.g. a TLS request, and runs the
+  // parsers' queries. It keeps a thread rather than delaying the services
+  // sharing the executor.
   while (!interrupted()) {
     // Cool off and time wait the configured period.
     // Apply this interruption initially as at t=0 the config was read.
@@ -1235,6 +1526,7 @@ void ConfigRefreshRunner::start() {
       return;
     }
 
+    // The refresh may change the rate, e.g. to accelerate after failing.
     VLOG(1) << "Refreshing configuration state";
     Config::get().refresh();
   }
@@ -12,6 +12,8 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <set>
+#include <string>
 #include <vector>
 
 #include <osquery/core/plugins/plugin.h>
@@ -28,6 +30,7 @@ class Status;
 class Config;
 class Pack;
 class Schedule;
+class QueryPerformanceStats;
 class ConfigParserPlugin;
 class ConfigRefreshRunner;
 
@@ -89,12 +92,16 @@ class Config : private boost::noncopyable {
    * @param size Number of characters generated by query
    * @param r0 the process row before the query
    * @param r1 the process row after the query
+   * @param allocated_bytes Heap bytes allocated by the query
+   * @param peak_bytes Most heap bytes held by the query
    */
   void recordQueryPerformance(const std::string& name,
                               uint64_t delay_ms,
                               uint64_t size,
                               const Row& r0,
-                              const Row& r1);
+                              const Row& r1,
+                              uint64_t allocated_bytes = 0,
+                              uint64_t peak_bytes = 0);
 
   /**
    * @brief Record a query 'initialization', meaning the query will run.
@@ -109,6 +116,17 @@ class Config : private boost::noncopyable {
    */
   void recordQueryStart(const std::string& name);
 
+  /**
+   * @brief Denylist a scheduled query that failed within the worker.
+   *
+   * The query is skipped for as long as a query that caused the worker to
+   * fail, unless its options disable denylisting. The schedule generation
+   * changes so the scheduler stops running it immediately.
+   *
+   * @param name The unique name of the scheduled item
+   */
+  void denylistQuery(const std::string& name);
+
   /**
    * @brief Calculate the hash of the osquery config
    *
@@ -186,6 +204,14 @@ class Config : private boost::noncopyable {
           predicate,
       bool denylisted = false) const;
 
+  /**
+   * @brief Return a counter that changes whenever the scheduled packs change.
+   *
+   * Callers keeping their own view of the schedule compare this value to
+   * know when to enumerate the scheduled queries again.
+   */
+  uint64_t getScheduleGeneration() const;
+
   /**
    * @brief Map a function across the set of configured files
    *
@@ -212,7 +238,8 @@ class Config : private boost::noncopyable {
    * @param name is the name of the query which you'd like to retrieve
    * @param predicate is a function which accepts a const reference to a
    * QueryPerformance struct. predicate will be called on name's related
-   * QueryPerformance struct, if it exists.
+   * QueryPerformance struct, if it exists. The struct is a consistent snapshot
+   * of the query's stats, no lock is held while predicate runs.
    *
    * @code{.cpp}
    *   Config::get().getPerformanceStats(
@@ -270,9 +297,20 @@ class Config : private boost::noncopyable {
    */
   Status load();
 
-  /// A step method for Config::update.
+  /**
+   * @brief A step method for Config::update.
+   *
+   * Only the packs and parser sections whose content changed are applied
+   * again, unchanged packs keep their state.
+   */
   Status updateSource(const std::string& source, const std::string& json);
 
+  /// Forget the pack and parser hashes of a source and of its packs.
+  void forgetSourceHashes(const std::string& source);
+
+  /// Forget the parser hashes of a source, its sections are applied again.
+  void forgetParserHashes(const std::string& source);
+
   /**
    * @brief Generate pack content from a resource handled by the Plugin.
    *
@@ -322,6 +360,16 @@ class Config : private boost::noncopyable {
    */
   void purge();
 
+  /**
+   * @brief Request every config parser to refresh host-dependent state.
+   *
+   * @return true if any parser state changed.
+   */
+  bool refreshParsers();
+
+  /// Request the registries and loggers to apply a changed config.
+  void reconfigure();
+
   /**
    * @brief Reset the configuration state, reserved for testing only.
    */
@@ -332,7 +380,7 @@ class Config : private boost::noncopyable {
   std::unique_ptr<Schedule> schedule_;
 
   /// A set of performance stats for each query in the schedule.
-  std::map<std::string, QueryPerformance> performance_;
+  std::unique_ptr<QueryPerformanceStats> performance_;
 
   /// A set of named categories filled with filesystem globbing paths.
   using FileCategories = std::map<std::string, std::vector<std::string>>;
@@ -341,6 +389,15 @@ class Config : private boost::noncopyable {
   /// A set of hashes for each source of the config.
   std::map<std::string, std::string> hash_;
 
+  /// Content hash of each pack, by source and pack name.
+  std::map<std::string, std::string> pack_hash_;
+
+  /// Hash of the sections each parser was updated with, by source.
+  std::map<std::string, std::map<std::string, std::string>> parser_hash_;
+
+  /// Names of the packs added by the source being updated.
+  std::set<std::string> added_packs_;
+
   /// Check if the config received valid/parsable content from a config plugin.
   bool valid_{false};
 
@@ -373,9 +430,11 @@ class Config : private boost::noncopyable {
   FRIEND_TEST(ConfigTests, test_config_backup);
   FRIEND_TEST(ConfigTests, test_config_backup_integrate);
   FRIEND_TEST(ConfigTests, test_config_refresh);
+  FRIEND_TEST(ConfigTests, test_incremental_update);
   FRIEND_TEST(ConfigTests, test_get_scheduled_queries);
   FRIEND_TEST(ConfigTests, test_nondenylist_query);
   FRIEND_TEST(ConfigTests, test_config_cli_flags);
+  FRIEND_TEST(ConfigTests, test_query_performance_snapshots);
   FRIEND_TEST(OptionsConfigParserPluginTests, test_get_option);
   FRIEND_TEST(OptionsConfigParserPluginTests, test_get_option_first);
   FRIEND_TEST(ViewsConfigParserPluginTests, test_add_view);
@@ -427,6 +486,7 @@ class ConfigPlugin : public Plugin {
    * ConfigPlugin which needs to retrieve config data in a custom way.
    *
    * @param config The output ConfigSourceMap, a map of JSON to source names.
+   * It is left empty if the config did not change since the last call.
    *
    * @return A failure status will prevent the source map from merging.
    */
@@ -483,6 +543,17 @@ class ConfigPlugin : public Plugin {
                          const std::string& value,
                          std::string& pack);
 
+  /**
+   * @brief Receive the result of applying the config from genConfig.
+   *
+   * Called by Config::refresh once the generated sources were updated. A
+   * plugin remembering the last config, e.g. to be answered "not modified",
+   * should only do so when it was applied.
+   *
+   * @param status the result of Config::update.
+   */
+  virtual void configApplied(const Status& /* status */) {}
+
   /// Main entrypoint for config plugin requests
   Status call(const PluginRequest& request, PluginResponse& response) override;
 };
@@ -543,6 +614,18 @@ class ConfigParserPlugin : public Plugin {
   virtual Status update(const std::string& source,
                         const ParserConfig& config) = 0;
 
+  /**
+   * @brief Refresh parser state derived from the host rather than the config.
+   *
+   * Called after every config refresh, also when no source content changed
+   * and ConfigParserPlugin::update was not called.
+   *
+   * @return true if the parser state changed and plugins should reconfigure.
+   */
+  virtual bool refresh() {
+    return false;
+  }
+
   /// Allow parsers to perform some setup before the configuration is loaded.
   Status setUp() override;
 
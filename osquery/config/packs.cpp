@@ -8,8 +8,10 @@
  */
 
 #include <algorithm>
+#include <map>
 #include <mutex>
 #include <random>
+#include <set>
 
 #include <osquery/config/packs.h>
 #include <osquery/core/system.h>
@@ -21,6 +23,7 @@
 #include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/info/version.h>
 #include <osquery/utils/json/json.h>
+#include <osquery/utils/mutex.h>
 #include <osquery/utils/system/time.h>
 
 namespace rj = rapidjson;
@@ -43,8 +46,90 @@ FLAG(uint64,
 
 size_t kMaxQueryInterval = 604800;
 
+/// Buckets of a query's results when only a diff_key is set, and the most.
+const size_t kDefaultDiffBuckets{64};
+const size_t kMaxDiffBuckets{4096};
+
 std::once_flag kUseDenylist;
 
+namespace {
+
+/// The time and result of the last run of a discovery query.
+struct DiscoveryResult {
+  uint64_t time{0};
+  bool passed{false};
+};
+
+/// Protects the discovery results, statistics and running queries.
+Mutex kDiscoveryMutex;
+
+/// Signaled when a discovery query finishes running.
+ConditionVariable kDiscoveryDone;
+
+std::map<std::string, DiscoveryResult> kDiscoveryResults;
+std::map<std::string, DiscoveryStats> kDiscoveryStats;
+std::set<std::string> kDiscoveryRunning;
+
+} // namespace
+
+bool checkDiscoveryQuery(const std::string& query, uint64_t now) {
+  WriteLock lock(kDiscoveryMutex);
+
+  // Packs checked concurrently wait for the result of a running query
+  // instead of running the same query.
+  kDiscoveryDone.wait(
+      lock, [&query]() { return kDiscoveryRunning.count(query) == 0; });
+  auto cached = kDiscoveryResults.find(query);
+  if (cached != kDiscoveryResults.end() &&
+      (now - cached->second.time) < FLAGS_pack_refresh_interval) {
+    kDiscoveryStats[query].hits++;
+    return cached->second.passed;
+  }
+
+  // The lock is released while the query runs, it may read the discovery
+  // statistics or check other packs.
+  kDiscoveryRunning.insert(query);
+  lock.unlock();
+
+  SQL results(query);
+  bool passed = true;
+  if (!results.ok()) {
+    LOG(WARNING) << "Discovery query failed (" << query
+                 << "): " << results.getMessageString();
+    passed = false;
+  } else if (results.rows().empty()) {
+    passed = false;
+  }
+
+  lock.lock();
+  kDiscoveryRunning.erase(query);
+  auto& stats = kDiscoveryStats[query];
+  stats.executions++;
+  stats.passed = passed;
+  stats.last_executed = now;
+  kDiscoveryResults[query] = {now, passed};
+  kDiscoveryDone.notify_all();
+  return passed;
+}
+
+void expireDiscoveryQuery(const std::string& query) {
+  WriteLock lock(kDiscoveryMutex);
+  kDiscoveryResults.erase(query);
+}
+
+void getDiscoveryStats(
+    std::function<void(const std::string&, const DiscoveryStats&)> predicate) {
+  std::map<std::string, DiscoveryStats> all_stats;
+  {
+    ReadLock lock(kDiscoveryMutex);
+    all_stats = kDiscoveryStats;
+  }
+
+  for (const auto& stats : all_stats) {
+    predicate(stats.first, stats.second);
+  }
+}
+
 uint64_t splayValue(uint64_t original, uint64_t splayPercent) {
   if (splayPercent == 0 || splayPercent > 100) {
     return original;
@@ -158,6 +243,8 @@ void Pack::initialize(const std::string& name,
     for (const auto& item : obj["discovery"].GetArray()) {
       if (item.IsString()) {
         discovery_queries_.push_back(item.GetString());
+        // A new or changed pack checks its discovery queries again.
+        expireDiscoveryQuery(discovery_queries_.back());
       }
     }
   }
@@ -248,6 +335,15 @@ void Pack::initialize(const std::string& name,
       query.options["denylist"] = JSON::valueToBool(q.value["denylist"]);
     }
 
+    if (q.value.HasMember("diff_key") && q.value["diff_key"].IsString()) {
+      query.diff_key = q.value["diff_key"].GetString();
+      query.diff_buckets = kDefaultDiffBuckets;
+      if (q.value.HasMember("diff_buckets")) {
+        query.diff_buckets = std::min(
+            JSON::valueToSize(q.value["diff_buckets"]), kMaxDiffBuckets);
+      }
+    }
+
     schedule_.emplace(std::make_pair(q.name.GetString(), std::move(query)));
   }
 }
@@ -321,14 +417,7 @@ bool Pack::checkDiscovery() {
   discovery_cache_.first = current;
   discovery_cache_.second = true;
   for (const auto& q : discovery_queries_) {
-    SQL results(q);
-    if (!results.ok()) {
-      LOG(WARNING) << "Discovery query failed (" << q
-                   << "): " << results.getMessageString();
-      discovery_cache_.second = false;
-      break;
-    }
-    if (results.rows().size() == 0) {
+    if (!checkDiscoveryQuery(q, current)) {
       discovery_cache_.second = false;
       break;
     }
@@ -10,6 +10,7 @@
 #pragma once
 
 #include <atomic>
+#include <functional>
 #include <map>
 #include <string>
 #include <vector>
@@ -31,6 +32,38 @@ struct PackStats {
   size_t misses{0};
 };
 
+/// Statistics about a discovery query, shared by every pack using its SQL.
+struct DiscoveryStats {
+  /// Number of times the query was run.
+  size_t executions{0};
+
+  /// Number of times a pack used the result of a previous run.
+  size_t hits{0};
+
+  /// Whether the last run returned rows.
+  bool passed{false};
+
+  /// Time of the last run.
+  uint64_t last_executed{0};
+};
+
+/**
+ * @brief Run a discovery query, or reuse its result.
+ *
+ * Discovery queries are identified by their SQL text, a query used by many
+ * packs is run once per pack_refresh_interval and its result shared.
+ *
+ * @return true if the query succeeded and returned rows.
+ */
+bool checkDiscoveryQuery(const std::string& query, uint64_t now);
+
+/// Forget the result of a discovery query, it is run on the next check.
+void expireDiscoveryQuery(const std::string& query);
+
+/// Visit the statistics of every discovery query that has run.
+void getDiscoveryStats(
+    std::function<void(const std::string&, const DiscoveryStats&)> predicate);
+
 /**
  * @brief The programmatic representation of a query pack
  */
@@ -449,6 +449,70 @@ TEST_F(ConfigTests, test_content_update) {
   EXPECT_EQ(count, 0U);
 }
 
+class CountingConfigParserPlugin : public ConfigParserPlugin {
+ public:
+  std::vector<std::string> keys() const override {
+    return {"counted"};
+  }
+
+  Status update(const std::string& source, const ParserConfig&) override {
+    updates[source]++;
+    return Status::success();
+  }
+
+  std::map<std::string, size_t> updates;
+};
+
+TEST_F(ConfigTests, test_incremental_update) {
+  auto& rf = RegistryFactory::get();
+  auto parser = std::make_shared<CountingConfigParserPlugin>();
+  rf.registry("config_parser")->add("counting", parser);
+
+  auto makeConfig = [](const std::string& interval) {
+    return "{\"counted\": {\"a\": 1}, \"packs\": {"
+           "\"same\": {\"queries\": {\"q\": {\"query\": \"select 1\", "
+           "\"interval\": 60}}}, "
+           "\"changed\": {\"queries\": {\"q\": {\"query\": \"select 1\", "
+           "\"interval\": " +
+           interval + "}}}}}";
+  };
+
+  std::map<std::string, const Pack*> packs;
+  auto collectPacks = [&packs](const Pack& pack) {
+    packs[pack.getName()] = &pack;
+  };
+
+  ASSERT_TRUE(get().update({{"data", makeConfig("60")}}).ok());
+  get().packs(collectPacks);
+  ASSERT_EQ(2U, packs.size());
+  auto same = packs["same"];
+  auto changed = packs["changed"];
+  EXPECT_EQ(1U, parser->updates["data"]);
+
+  // Only the pack that changed is replaced, the parser section is unchanged.
+  auto generation = get().getScheduleGeneration();
+  ASSERT_TRUE(get().update({{"data", makeConfig("120")}}).ok());
+  packs.clear();
+  get().packs(collectPacks);
+  ASSERT_EQ(2U, packs.size());
+  EXPECT_EQ(same, packs["same"]);
+  EXPECT_NE(changed, packs["changed"]);
+  EXPECT_EQ(120U, packs["changed"]->getSchedule().at("q").interval);
+  EXPECT_EQ(generation + 1, get().getScheduleGeneration());
+  EXPECT_EQ(1U, parser->updates["data"]);
+
+  // A removed pack is removed from the schedule.
+  ASSERT_TRUE(
+      get().update({{"data", "{\"counted\": {\"a\": 2}, \"packs\": {}}"}})
+          .ok());
+  packs.clear();
+  get().packs(collectPacks);
+  EXPECT_TRUE(packs.empty());
+  EXPECT_EQ(2U, parser->updates["data"]);
+
+  rf.registry("config_parser")->remove("counting");
+}
+
 TEST_F(ConfigTests, test_get_scheduled_queries) {
   std::vector<std::string> query_names;
   get().addPack("unrestricted_pack", "", getUnrestrictedPack().doc());
@@ -501,6 +565,37 @@ TEST_F(ConfigTests, test_get_scheduled_queries) {
   EXPECT_TRUE(denylisted);
 }
 
+TEST_F(ConfigTests, test_denylist_query) {
+  get().addPack("unrestricted_pack", "", getUnrestrictedPack().doc());
+
+  std::vector<std::string> query_names;
+  get().scheduledQueries(
+      ([&query_names](std::string name, const ScheduledQuery&) {
+        query_names.push_back(std::move(name));
+      }));
+  ASSERT_FALSE(query_names.empty());
+
+  // A query cancelled within the worker is denylisted immediately.
+  auto generation = get().getScheduleGeneration();
+  auto query_name = query_names[0];
+  get().denylistQuery(query_name);
+  EXPECT_NE(generation, get().getScheduleGeneration());
+
+  query_names.clear();
+  get().scheduledQueries(
+      ([&query_names](std::string name, const ScheduledQuery&) {
+        query_names.push_back(std::move(name));
+      }));
+  EXPECT_EQ(std::find(query_names.begin(), query_names.end(), query_name),
+            query_names.end());
+
+  // The denylist is persisted for the next worker.
+  std::map<std::string, uint64_t> denylist;
+  restoreScheduleDenylist(denylist);
+  EXPECT_EQ(denylist.count(query_name), 1U);
+  saveScheduleDenylist({});
+}
+
 TEST_F(ConfigTests, test_nondenylist_query) {
   std::map<std::string, uint64_t> denylist;
 
@@ -813,4 +908,49 @@ TEST_F(ConfigTests, test_config_cli_flags) {
 
   ASSERT_NE(Flag::getValue("disable_watchdog"), "false");
 }
+
+TEST_F(ConfigTests, test_query_performance_snapshots) {
+  get().reset();
+
+  size_t calls = 0;
+  get().getPerformanceStats("perf_query",
+                            [&calls](const QueryPerformance&) { calls++; });
+  EXPECT_EQ(calls, 0U);
+
+  Row r0 = {{"user_time", "10"}, {"system_time", "5"}, {"resident_size", ""}};
+  Row r1 = {{"user_time", "30"}, {"system_time", "6"}, {"resident_size", ""}};
+
+  // Readers see whole executions while a writer records more.
+  std::atomic<bool> consistent{true};
+  std::thread reader([this, &consistent]() {
+    for (size_t i = 0; i < 1000; i++) {
+      get().getPerformanceStats(
+          "perf_query", [&consistent](const QueryPerformance& perf) {
+            if (perf.user_time != perf.executions * 20 ||
+                perf.wall_time_ms != perf.executions * 100) {
+              consistent = false;
+            }
+          });
+    }
+  });
+  for (size_t i = 0; i < 1000; i++) {
+    get().recordQueryPerformance("perf_query", 100, 10, r0, r1);
+  }
+  reader.join();
+  EXPECT_TRUE(consistent);
+
+  QueryPerformance perf;
+  get().getPerformanceStats(
+      "perf_query", [&perf](const QueryPerformance& r) { perf = r; });
+  EXPECT_EQ(perf.executions, 1000U);
+  EXPECT_EQ(perf.last_user_time, 20U);
+  EXPECT_EQ(perf.system_time, 1000U);
+  EXPECT_EQ(perf.output_size, 10000U);
+
+  get().reset();
+  calls = 0;
+  get().getPerformanceStats("perf_query",
+                            [&calls](const QueryPerformance&) { calls++; });
+  EXPECT_EQ(calls, 0U);
+}
 } // namespace osquery
@@ -17,10 +17,14 @@
 #include <osquery/core/system.h>
 #include <osquery/database/database.h>
 #include <osquery/registry/registry.h>
+#include <osquery/sql/dynamic_table_row.h>
+#include <osquery/sql/sqlite_util.h>
+#include <osquery/sql/virtual_table.h>
 
 #include <osquery/filesystem/filesystem.h>
 
 #include <osquery/utils/info/platform_type.h>
+#include <osquery/utils/system/time.h>
 
 #include <gtest/gtest.h>
 
@@ -224,6 +228,82 @@ TEST_F(PacksTests, test_multi_pack) {
   c.addPack("*", "", multi_pack.doc());
 }
 
+TEST_F(PacksTests, test_shared_discovery) {
+  auto get_stats = []() {
+    std::map<std::string, DiscoveryStats> all_stats;
+    getDiscoveryStats(
+        [&all_stats](const std::string& query, const DiscoveryStats& stats) {
+          all_stats[query] = stats;
+        });
+    return all_stats;
+  };
+
+  // Both packs use the same discovery query, it runs once.
+  Pack first("first_pack", getPackWithValidDiscovery().doc());
+  Pack second("second_pack", getPackWithValidDiscovery().doc());
+  ASSERT_EQ(first.getDiscoveryQueries().size(), 1U);
+  const auto& query = first.getDiscoveryQueries()[0];
+  auto before = get_stats()[query];
+
+  EXPECT_TRUE(first.shouldPackExecute());
+  EXPECT_TRUE(second.shouldPackExecute());
+  auto after = get_stats()[query];
+  EXPECT_EQ(after.executions, before.executions + 1);
+  EXPECT_EQ(after.hits, before.hits + 1);
+  EXPECT_TRUE(after.passed);
+
+  // Each pack still counts its own checks.
+  EXPECT_EQ(second.getStats().misses, 1U);
+}
+
+namespace {
+
+/// A table reading the discovery statistics, like osquery_discovery_stats.
+class DiscoveryStatsTablePlugin : public TablePlugin {
+ public:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("query", TEXT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  TableRows generate(QueryContext& /* context */) override {
+    TableRows results;
+    getDiscoveryStats(
+        [&results](const std::string& query, const DiscoveryStats& stats) {
+          auto r = make_table_row();
+          r["query"] = query;
+          results.push_back(std::move(r));
+        });
+    return results;
+  }
+};
+
+} // namespace
+
+TEST_F(PacksTests, test_discovery_reads_stats) {
+  auto table = std::make_shared<DiscoveryStatsTablePlugin>();
+  RegistryFactory::get().registry("table")->add("discovery_stats_test", table);
+  attachTableInternal("discovery_stats_test",
+                      columnDefinition(table->columns()),
+                      SQLiteDBManager::get(),
+                      false);
+
+  // The query runs without the discovery lock, it does not deadlock.
+  auto query = "select * from discovery_stats_test";
+  checkDiscoveryQuery(query, getUnixTime());
+
+  bool found = false;
+  getDiscoveryStats(
+      [&found, &query](const std::string& name, const DiscoveryStats& stats) {
+        if (name == query) {
+          found = true;
+          EXPECT_EQ(stats.executions, 1U);
+        }
+      });
+  EXPECT_TRUE(found);
+}
+
 TEST_F(PacksTests, test_discovery_zero_state) {
   Pack pack("discovery_pack", getPackWithDiscovery().doc());
   auto stats = pack.getStats();
@@ -0,0 +1,401 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <osquery/core/flight_recorder.h>
+#include <osquery/logger/logger.h>
+#include <osquery/utils/system/env.h>
+
+#ifdef __linux__
+#include <osquery/filesystem/linux/proc.h>
+#endif
+
+namespace osquery {
+
+const std::string kFlightRecorderEnv{"OSQUERY_FLIGHT_RECORDER"};
+
+namespace {
+
+/// Records kept in the ring buffer.
+const size_t kFlightRecords{4096};
+
+/// Longer names are truncated.
+const size_t kFlightRecordNameSize{100};
+
+/// Entries listed for each part of a summary.
+const size_t kFlightSummaryEntries{3};
+
+} // namespace
+
+/// A record, the watcher reads it while the worker may write it.
+struct FlightRecorderEntry {
+  /// Odd while the worker writes the entry, then twice its index plus two.
+  std::atomic<std::uint64_t> sequence;
+  std::atomic<std::uint64_t> time_ms;
+  std::atomic<std::uint64_t> value;
+  std::atomic<std::uint32_t> kind;
+
+  char name[kFlightRecordNameSize];
+};
+
+struct FlightRecorderSegment {
+  /// The index of the next record.
+  std::atomic<std::uint64_t> next;
+
+  FlightRecorderEntry entries[kFlightRecords];
+};
+
+namespace {
+
+const size_t kFlightRecorderSize{sizeof(FlightRecorderSegment)};
+
+std::uint64_t nowMs() {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+}
+
+std::string formatBytes(std::uint64_t bytes) {
+  return std::to_string(bytes / (1024 * 1024)) + "MB";
+}
+
+/// List the entries with the largest values, most first.
+std::string formatLargest(std::vector<std::pair<std::string, std::uint64_t>>
+                              entries,
+                          const std::string& unit) {
+  std::sort(entries.begin(), entries.end(), [](const auto& l, const auto& r) {
+    return l.second > r.second;
+  });
+  if (entries.size() > kFlightSummaryEntries) {
+    entries.resize(kFlightSummaryEntries);
+  }
+
+  std::string list;
+  for (const auto& entry : entries) {
+    list += (list.empty() ? "" : ", ") + entry.first + " " +
+            std::to_string(entry.second) + unit;
+  }
+  return list;
+}
+
+} // namespace
+
+FlightRecorder::FlightRecorder(const std::string& name,
+                               FlightRecorderSegment* segment)
+    : name_(name), segment_(segment) {}
+
+Status FlightRecorder::create(std::unique_ptr<FlightRecorder>& recorder) {
+#ifndef __linux__
+  return Status::failure("The flight recorder is not supported on this "
+                         "platform");
+#else
+  auto name = "/osquery.flight." + std::to_string(::getpid());
+
+  // A segment left by a previous watcher with the same pid is replaced.
+  ::shm_unlink(name.c_str());
+  auto fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd == -1) {
+    return Status::failure("Cannot create the shared memory object " + name);
+  }
+
+  void* data = MAP_FAILED;
+  if (::ftruncate(fd, static_cast<off_t>(kFlightRecorderSize)) == 0) {
+    data = ::mmap(nullptr,
+                  kFlightRecorderSize,
+                  PROT_READ | PROT_WRITE,
+                  MAP_SHARED,
+                  fd,
+                  0);
+  }
+  ::close(fd);
+
+  if (data == MAP_FAILED) {
+    ::shm_unlink(name.c_str());
+    return Status::failure("Cannot map the shared memory object " + name);
+  }
+
+  recorder.reset(
+      new FlightRecorder(name, static_cast<FlightRecorderSegment*>(data)));
+  return Status::success();
+#endif
+}
+
+Status FlightRecorder::open(const std::string& name,
+                            std::unique_ptr<FlightRecorder>& recorder) {
+#ifndef __linux__
+  return Status::failure("The flight recorder is not supported on this "
+                         "platform");
+#else
+  if (name.size() < 2 || name.front() != '/') {
+    return Status::failure("Invalid shared memory name");
+  }
+
+  auto fd = ::shm_open(name.c_str(), O_RDWR, 0);
+  if (fd == -1) {
+    return Status::failure("Cannot open the shared memory object " + name);
+  }
+
+  // The watcher owns the segment, it must not be shared with other users.
+  struct stat info;
+  if (::fstat(fd, &info) != 0 || info.st_uid != ::geteuid() ||
+      static_cast<size_t>(info.st_size) != kFlightRecorderSize) {
+    ::close(fd);
+    return Status::failure("The shared memory object cannot be used: " + name);
+  }
+
+  auto data = ::mmap(nullptr,
+                     kFlightRecorderSize,
+                     PROT_READ | PROT_WRITE,
+                     MAP_SHARED,
+                     fd,
+                     0);
+  ::close(fd);
+
+  if (data == MAP_FAILED) {
+    return Status::failure("Cannot map the shared memory object " + name);
+  }
+
+  recorder.reset(
+      new FlightRecorder(name, static_cast<FlightRecorderSegment*>(data)));
+  return Status::success();
+#endif
+}
+
+FlightRecorder* FlightRecorder::worker() {
+  static std::unique_ptr<FlightRecorder> recorder;
+  static std::once_flag once;
+
+  std::call_once(once, []() {
+    auto name = getEnvVar(kFlightRecorderEnv);
+    auto worker = getEnvVar("OSQUERY_WORKER");
+    if (!name.is_initialized() || !worker.is_initialized()) {
+      return;
+    }
+
+#ifdef __linux__
+    // Processes forked by the worker inherit its environment.
+    if (*worker != std::to_string(::getpid())) {
+      return;
+    }
+#endif
+
+    auto status = open(*name, recorder);
+    if (!status.ok()) {
+      VLOG(1) << "Cannot open the flight recorder: " << status.getMessage();
+      return;
+    }
+    recorder->unlink();
+  });
+  return recorder.get();
+}
+
+FlightRecorder::~FlightRecorder() {
+#ifdef __linux__
+  if (segment_ != nullptr) {
+    ::munmap(segment_, kFlightRecorderSize);
+  }
+#endif
+}
+
+void FlightRecorder::unlink() {
+#ifdef __linux__
+  ::shm_unlink(name_.c_str());
+#endif
+}
+
+void FlightRecorder::record(FlightRecordKind kind,
+                            const std::string& name,
+                            std::uint64_t value) {
+  auto index = segment_->next.fetch_add(1, std::memory_order_relaxed);
+  auto& entry = segment_->entries[index % kFlightRecords];
+
+  entry.sequence.store(index * 2 + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  entry.time_ms.store(nowMs(), std::memory_order_relaxed);
+  entry.value.store(value, std::memory_order_relaxed);
+  entry.kind.store(static_cast<std::uint32_t>(kind),
+                   std::memory_order_relaxed);
+  auto length = std::min(name.size(), kFlightRecordNameSize - 1);
+  std::memcpy(entry.name, name.data(), length);
+  entry.name[length] = '\0';
+  entry.sequence.store(index * 2 + 2, std::memory_order_release);
+}
+
+std::vector<FlightRecord> FlightRecorder::getRecords() const {
+  std::vector<std::pair<std::uint64_t, FlightRecord>> indexed;
+  for (size_t i = 0; i < kFlightRecords; ++i) {
+    const auto& entry = segment_->entries[i];
+    auto sequence = entry.sequence.load(std::memory_order_acquire);
+    if (sequence == 0 || (sequence % 2) != 0) {
+      continue;
+    }
+
+    FlightRecord record;
+    record.time_ms = entry.time_ms.load(std::memory_order_relaxed);
+    record.value = entry.value.load(std::memory_order_relaxed);
+    record.kind = static_cast<FlightRecordKind>(
+        entry.kind.load(std::memory_order_relaxed));
+    record.name.assign(entry.name,
+                       ::strnlen(entry.name, kFlightRecordNameSize));
+
+    // The entry was overwritten while it was read.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (entry.sequence.load(std::memory_order_relaxed) != sequence) {
+      continue;
+    }
+    indexed.emplace_back(sequence, std::move(record));
+  }
+
+  std::sort(indexed.begin(), indexed.end(), [](const auto& l, const auto& r) {
+    return l.first < r.first;
+  });
+
+  std::vector<FlightRecord> records;
+  records.reserve(indexed.size());
+  for (auto& record : indexed) {
+    records.push_back(std::move(record.second));
+  }
+  return records;
+}
+
+void recordFlight(FlightRecordKind kind,
+                  const std::string& name,
+                  std::uint64_t value) {
+  auto recorder = FlightRecorder::worker();
+  if (recorder != nullptr) {
+    recorder->record(kind, name, value);
+  }
+}
+
+void recordFlightMemory() {
+#ifdef __linux__
+  auto recorder = FlightRecorder::worker();
+  if (recorder == nullptr) {
+    return;
+  }
+
+  auto rss = getProcRSS("self");
+  if (rss.isValue()) {
+    recorder->record(FlightRecordKind::Memory, "", rss.take());
+  }
+#endif
+}
+
+std::string summarizeFlightRecords(const std::vector<FlightRecord>& records,
+                                   std::uint64_t now_ms,
+                                   std::uint64_t window_ms) {
+  auto since = (now_ms > window_ms) ? now_ms - window_ms : 0;
+
+  // Queries started and not ended, by name, with their start time.
+  std::map<std::string, std::uint64_t> running;
+  std::vector<std::pair<std::string, std::uint64_t>> queries;
+  std::vector<std::pair<std::string, std::uint64_t>> tables;
+  std::map<std::string, std::uint64_t> event_rates;
+  std::uint64_t first_memory = 0;
+  std::uint64_t last_memory = 0;
+  std::uint64_t max_memory = 0;
+
+  for (const auto& record : records) {
+    // Running queries may have started before the window.
+    if (record.kind == FlightRecordKind::QueryStart) {
+      running[record.name] = record.time_ms;
+    } else if (record.kind == FlightRecordKind::QueryEnd) {
+      running.erase(record.name);
+    }
+    if (record.time_ms < since) {
+      continue;
+    }
+
+    switch (record.kind) {
+    case FlightRecordKind::QueryEnd:
+      queries.emplace_back(record.name, record.value);
+      break;
+    case FlightRecordKind::TableGenerate:
+      tables.emplace_back(record.name, record.value / 1000);
+      break;
+    case FlightRecordKind::EventRate:
+      event_rates[record.name] = record.value;
+      break;
+    case FlightRecordKind::Memory:
+      if (first_memory == 0) {
+        first_memory = record.value;
+      }
+      last_memory = record.value;
+      max_memory = std::max(max_memory, record.value);
+      break;
+    default:
+      break;
+    }
+  }
+
+  std::vector<std::pair<std::string, std::uint64_t>> running_ms;
+  for (const auto& query : running) {
+    running_ms.emplace_back(
+        query.first, (now_ms > query.second) ? now_ms - query.second : 0);
+  }
+
+  std::stringstream summary;
+  summary << "last " << window_ms / 1000 << "s";
+  if (!running_ms.empty()) {
+    summary << "; running queries: " << formatLargest(running_ms, "ms");
+  }
+  if (!queries.empty()) {
+    summary << "; slowest queries: " << formatLargest(queries, "ms");
+  }
+  if (!tables.empty()) {
+    summary << "; slowest tables: " << formatLargest(tables, "ms");
+  }
+  if (!event_rates.empty()) {
+    summary << "; events per second:";
+    for (const auto& rate : event_rates) {
+      summary << " " << rate.first << " " << rate.second;
+    }
+  }
+  if (max_memory > 0) {
+    summary << "; resident memory: " << formatBytes(first_memory) << " to "
+            << formatBytes(last_memory) << " (max " << formatBytes(max_memory)
+            << ")";
+  }
+  return summary.str();
+}
+
+ScopedFlightQuery::ScopedFlightQuery(const std::string& name)
+    : recorder_(FlightRecorder::worker()) {
+  if (recorder_ != nullptr) {
+    name_ = name;
+    start_ = std::chrono::steady_clock::now();
+    recorder_->record(FlightRecordKind::QueryStart, name_, 0);
+  }
+}
+
+ScopedFlightQuery::~ScopedFlightQuery() {
+  if (recorder_ != nullptr) {
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start_);
+    recorder_->record(FlightRecordKind::QueryEnd,
+                      name_,
+                      static_cast<std::uint64_t>(duration.count()));
+  }
+}
+
+} // namespace osquery
@@ -0,0 +1,147 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// The environment variable naming the flight recorder segment of a worker.
+extern const std::string kFlightRecorderEnv;
+
+/// What a flight record describes.
+enum class FlightRecordKind : std::uint32_t {
+  /// A scheduled or distributed query started.
+  QueryStart = 1,
+
+  /// A query ended, the value is its duration in milliseconds.
+  QueryEnd = 2,
+
+  /// A table was generated, the value is the generate time in microseconds.
+  TableGenerate = 3,
+
+  /// The events per second fired by a publisher.
+  EventRate = 4,
+
+  /// The resident memory of the worker in bytes.
+  Memory = 5,
+};
+
+/// A record read from the flight recorder.
+struct FlightRecord {
+  /// Milliseconds since the epoch.
+  std::uint64_t time_ms{0};
+  FlightRecordKind kind{FlightRecordKind::QueryStart};
+  std::string name;
+  std::uint64_t value{0};
+};
+
+struct FlightRecorderSegment;
+
+/**
+ * @brief The recent activity of a worker, shared with its watcher.
+ *
+ * Like QueryAccounting, the watcher creates a shared memory segment for each
+ * worker, the worker maps it and removes its name. The worker appends fixed
+ * size records to a ring buffer: query starts and ends, slow table scans,
+ * publisher event rates and resident memory samples. Writing a record is a
+ * few stores into the mapping, without locks or system calls.
+ *
+ * When the worker is stopped for exceeding a limit, or exits abnormally, the
+ * segment outlives it and the watcher logs a summary of the last records.
+ *
+ * Only Linux is supported.
+ */
+class FlightRecorder : private boost::noncopyable {
+ public:
+  /// Create and map a new segment, as the watcher.
+  static Status create(std::unique_ptr<FlightRecorder>& recorder);
+
+  /// Map the segment created by the watcher, as the worker.
+  static Status open(const std::string& name,
+                     std::unique_ptr<FlightRecorder>& recorder);
+
+  /**
+   * @brief The segment of this worker.
+   *
+   * It is opened on the first call, if this process is a worker started with
+   * a segment. Returns nullptr otherwise.
+   */
+  static FlightRecorder* worker();
+
+  /// Unmap the segment.
+  ~FlightRecorder();
+
+  /// Remove the name of the segment, the mappings stay valid.
+  void unlink();
+
+  /// The name of the segment.
+  const std::string& name() const {
+    return name_;
+  }
+
+  /// Append a record, the oldest record is overwritten.
+  void record(FlightRecordKind kind,
+              const std::string& name,
+              std::uint64_t value);
+
+  /// The complete records, oldest first, as the watcher.
+  std::vector<FlightRecord> getRecords() const;
+
+ private:
+  explicit FlightRecorder(const std::string& name,
+                          FlightRecorderSegment* segment);
+
+ private:
+  std::string name_;
+  FlightRecorderSegment* segment_{nullptr};
+};
+
+/// Append a record to the flight recorder of this worker, if any.
+void recordFlight(FlightRecordKind kind,
+                  const std::string& name,
+                  std::uint64_t value = 0);
+
+/// Sample the resident memory of this worker into its flight recorder.
+void recordFlightMemory();
+
+/**
+ * @brief Summarize the records of a worker in a single line.
+ *
+ * The summary has the queries still running at the end, the slowest queries
+ * and table scans, the last event rate of each publisher and the resident
+ * memory samples, from the records of the last window_ms before now_ms.
+ */
+std::string summarizeFlightRecords(const std::vector<FlightRecord>& records,
+                                   std::uint64_t now_ms,
+                                   std::uint64_t window_ms);
+
+/// Record the start and end of a query run by the calling thread.
+class ScopedFlightQuery : private boost::noncopyable {
+ public:
+  explicit ScopedFlightQuery(const std::string& name);
+  ~ScopedFlightQuery();
+
+ private:
+  FlightRecorder* recorder_{nullptr};
+  std::string name_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace osquery
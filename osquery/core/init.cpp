@@ -35,6 +35,7 @@
 #include <osquery/core/core.h>
 #include <osquery/core/flags.h>
 #include <osquery/core/shutdown.h>
+#include <osquery/core/startup_trace.h>
 #include <osquery/core/watcher.h>
 #include <osquery/dispatcher/dispatcher.h>
 #include <osquery/events/eventfactory.h>
@@ -181,6 +182,23 @@ static inline bool hasWorkerVariable() {
   return getEnvVar("OSQUERY_WORKER").is_initialized();
 }
 
+/**
+ * @brief Keep the work of the primary worker out of the other shards.
+ *
+ * Events, distributed queries and extensions only run in the primary worker,
+ * see worker_shards. Config options may enable them again, so this is also
+ * applied after the config loads.
+ */
+void setWorkerShardFlags() {
+  if (!Initializer::isWorker() || getWorkerShard() == 0) {
+    return;
+  }
+
+  FLAGS_disable_events = true;
+  FLAGS_disable_distributed = true;
+  FLAGS_disable_extensions = true;
+}
+
 void initWorkDirectories() {
   if (!FLAGS_disable_database) {
     auto const recursive = true;
@@ -259,6 +277,9 @@ Initializer::Initializer(int& argc,
                          ToolType tool,
                          bool const init_glog)
     : d(new PrivateData), argc_(&argc), argv_(&argv) {
+  // Startup phases are timed from here.
+  StartupTrace::get();
+
   // Initialize random number generated based on time.
   std::srand(static_cast<unsigned int>(
       chrono_clock::now().time_since_epoch().count()));
@@ -351,8 +372,11 @@ Initializer::Initializer(int& argc,
   // Set version string from CMake build
   GFLAGS_NAMESPACE::SetVersionString(kVersion.c_str());
 
-  // Let gflags parse the non-help options/flags.
-  GFLAGS_NAMESPACE::ParseCommandLineFlags(argc_, argv_, isShell());
+  {
+    // Let gflags parse the non-help options/flags.
+    ScopedStartupPhase phase("flags");
+    GFLAGS_NAMESPACE::ParseCommandLineFlags(argc_, argv_, isShell());
+  }
 
   if (isShell()) {
     // Do not set these values before calling ParseCommandLineFlags.
@@ -369,8 +393,11 @@ Initializer::Initializer(int& argc,
     FLAGS_ignore_registry_exceptions = true;
   }
 
-  // Initialize registries and plugins
-  registryAndPluginInit();
+  {
+    // Initialize registries and plugins
+    ScopedStartupPhase phase("registry");
+    registryAndPluginInit();
+  }
 
   if (isShell() || FLAGS_ephemeral) {
     if (Flag::isDefault("database_path") &&
@@ -403,6 +430,19 @@ Initializer::Initializer(int& argc,
     FLAGS_disable_logging = true;
   }
 
+  // Only the primary worker enrolls, the other shards use its node key.
+  if (isWorker() && FLAGS_worker_shards > 1) {
+    Flag::updateValue("enroll_shared_node_key",
+                      FLAGS_database_path + ".node_key");
+  }
+
+  // The backing store has a single writer, each shard worker keeps its own.
+  if (isWorker() && getWorkerShard() != 0) {
+    FLAGS_database_path += ".shard" + std::to_string(getWorkerShard());
+    Flag::updateValue("enroll_from_shared_node_key", "true");
+    setWorkerShardFlags();
+  }
+
   // Initialize the status and results logger.
   initStatusLogger(binary_, init_glog);
   if (getToolType() != ToolType::EXTENSION) {
@@ -683,6 +723,7 @@ void Initializer::start() const {
   }
 
   if (!isWatcher()) {
+    ScopedStartupPhase phase("database");
     setDatabaseAllowOpen();
     auto status = initDatabasePlugin();
     if (!status.ok()) {
@@ -702,7 +743,11 @@ void Initializer::start() const {
   // Bind to an extensions socket and wait for registry additions.
   // After starting the extension manager, osquery MUST shutdown using the
   // internal 'shutdown' method.
-  auto s = osquery::startExtensionManager();
+  Status s;
+  {
+    ScopedStartupPhase phase("extensions");
+    s = osquery::startExtensionManager();
+  }
   if (!s.ok()) {
     auto error_message =
         "An error occurred during extension manager startup: " + s.getMessage();
@@ -720,15 +765,21 @@ void Initializer::start() const {
     return;
   }
 
-  // Then set the config plugin, which uses a single/active plugin.
-  initActivePlugin("config", FLAGS_config_plugin);
+  {
+    // Then set the config plugin, which uses a single/active plugin.
+    ScopedStartupPhase phase("config_plugin");
+    initActivePlugin("config", FLAGS_config_plugin);
+  }
 
   if (shutdownRequested()) {
     return;
   }
 
-  // Run the setup for all lazy registries (tables, SQL).
-  Registry::setUp();
+  {
+    // Run the setup for all lazy registries (tables, SQL).
+    ScopedStartupPhase phase("registry_setup");
+    Registry::setUp();
+  }
 
   if (FLAGS_config_check) {
     // The initiator requested an initialization and config check.
@@ -753,7 +804,10 @@ void Initializer::start() const {
   }
 
   // Load the osquery config using the default/active config plugin.
-  s = Config::get().load();
+  {
+    ScopedStartupPhase phase("config");
+    s = Config::get().load();
+  }
   if (!s.ok()) {
     auto message = "Error reading config: " + s.toString();
     if (isDaemon()) {
@@ -762,6 +816,15 @@ void Initializer::start() const {
       VLOG(1) << message;
     }
   }
+  setWorkerShardFlags();
+
+  // Event publishers are set up while the remaining plugins start. They only
+  // depend on flags, which the config options may have changed. The future
+  // waits for them if the startup ends early.
+  auto publishers = std::async(std::launch::async, []() {
+    ScopedStartupPhase phase("event_publishers");
+    attachEventPublishers();
+  });
 
   // Initialize the status and result plugin logger.
   if (!FLAGS_disable_logging) {
@@ -769,6 +832,7 @@ void Initializer::start() const {
       return;
     }
 
+    ScopedStartupPhase phase("logger");
     initActivePlugin("logger", FLAGS_logger_plugin);
 
     if (shutdownRequested()) {
@@ -784,6 +848,7 @@ void Initializer::start() const {
       return;
     }
 
+    ScopedStartupPhase phase("distributed");
     initActivePlugin("distributed", FLAGS_distributed_plugin);
   }
 
@@ -801,7 +866,11 @@ void Initializer::start() const {
   }
 
   // Start event threads.
-  attachEvents();
+  publishers.get();
+  {
+    ScopedStartupPhase phase("event_subscribers");
+    attachEventSubscribers();
+  }
 
   if (shutdownRequested()) {
     return;
@@ -875,6 +944,8 @@ int Initializer::shutdown(int retcode) const {
   Dispatcher::joinServices();
   // End any event type run loops.
   EventFactory::end(true);
+  // Send the result lines still queued for logger plugins.
+  stopLoggerDispatch();
 
   // Hopefully release memory used by global string constructors in gflags.
   GFLAGS_NAMESPACE::ShutDownCommandLineFlags();
@@ -0,0 +1,212 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <map>
+#include <sstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <osquery/core/linux/worker_cgroup.h>
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/logger/logger.h>
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+namespace {
+
+const std::string kWatcherCgroup{"watcher"};
+const std::string kWorkerCgroup{"worker"};
+
+using CgroupCounters = std::map<std::string, uint64_t>;
+
+/// Write to a cgroup interface file, which must not be created or truncated.
+Status writeCgroupFile(const fs::path& path, const std::string& value) {
+  auto fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return Status::failure("Cannot open " + path.string());
+  }
+
+  auto written = ::write(fd, value.data(), value.size());
+  ::close(fd);
+  if (written != static_cast<ssize_t>(value.size())) {
+    return Status::failure("Cannot write " + value + " to " + path.string());
+  }
+  return Status::success();
+}
+
+/// Read a flat keyed cgroup file such as cpu.stat or memory.events.
+Status readCgroupCounters(const fs::path& path, CgroupCounters& counters) {
+  std::string content;
+  auto status = readFile(path, content, 0, false, false, false, false);
+  if (!status.ok()) {
+    return status;
+  }
+
+  std::istringstream stream(content);
+  std::string key;
+  uint64_t value = 0;
+  while (stream >> key >> value) {
+    counters[key] = value;
+  }
+  return Status::success();
+}
+
+uint64_t getCounter(const CgroupCounters& counters, const std::string& key) {
+  auto it = counters.find(key);
+  return (it == counters.end()) ? 0 : it->second;
+}
+
+uint64_t getDelta(uint64_t value, uint64_t base) {
+  return (value < base) ? 0 : value - base;
+}
+
+} // namespace
+
+WorkerCgroup::WorkerCgroup(const fs::path& base)
+    : worker_path_(base / kWorkerCgroup) {}
+
+Status WorkerCgroup::getCurrentPath(std::string& path) {
+  std::string content;
+  auto status =
+      readFile("/proc/self/cgroup", content, 0, false, false, false, false);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // The cgroup v2 hierarchy has the ID 0 and no controllers.
+  std::istringstream stream(content);
+  std::string line;
+  while (std::getline(stream, line)) {
+    if (line.compare(0, 3, "0::") == 0) {
+      path = line.substr(3);
+      return Status::success();
+    }
+  }
+  return Status::failure("The process is not in a cgroup v2 hierarchy");
+}
+
+Status WorkerCgroup::create(const fs::path& mount,
+                            const std::string& path,
+                            std::unique_ptr<WorkerCgroup>& cgroup) {
+  auto base = mount;
+  auto relative = path.find_first_not_of('/');
+  if (relative != std::string::npos) {
+    base /= path.substr(relative);
+  }
+
+  // A watcher started again in the same service is already in its leaf.
+  if (base.filename() == kWatcherCgroup &&
+      fs::is_directory(base.parent_path() / kWorkerCgroup)) {
+    base = base.parent_path();
+  }
+
+  if (!fs::exists(base / "cgroup.procs")) {
+    return Status::failure("Not a cgroup v2 hierarchy: " + base.string());
+  }
+
+  boost::system::error_code ec;
+  for (const auto& leaf : {kWatcherCgroup, kWorkerCgroup}) {
+    fs::create_directory(base / leaf, ec);
+    if (ec) {
+      return Status::failure("Cannot create the cgroup " +
+                             (base / leaf).string() + ": " + ec.message());
+    }
+  }
+
+  auto status = writeCgroupFile(base / kWatcherCgroup / "cgroup.procs",
+                                std::to_string(::getpid()));
+  if (!status.ok()) {
+    return status;
+  }
+
+  // The CPU times are always accounted, the memory needs its controller.
+  status = writeCgroupFile(base / "cgroup.subtree_control", "+memory");
+  if (!status.ok()) {
+    VLOG(1) << "Cannot enable the memory controller of the worker cgroup: "
+            << status.getMessage();
+  }
+
+  cgroup.reset(new WorkerCgroup(base));
+  return Status::success();
+}
+
+Status WorkerCgroup::addWorker(pid_t pid) {
+  auto status =
+      writeCgroupFile(worker_path_ / "cgroup.procs", std::to_string(pid));
+  if (!status.ok()) {
+    return status;
+  }
+
+  // The cgroup outlives each worker, its counters keep growing.
+  CgroupCounters cpu;
+  status = readCgroupCounters(worker_path_ / "cpu.stat", cpu);
+  if (!status.ok()) {
+    return status;
+  }
+  user_usec_ = getCounter(cpu, "user_usec");
+  system_usec_ = getCounter(cpu, "system_usec");
+
+  CgroupCounters events;
+  if (readCgroupCounters(worker_path_ / "memory.events", events).ok()) {
+    high_events_ = getCounter(events, "high");
+    oom_kill_events_ = getCounter(events, "oom_kill");
+  }
+  return Status::success();
+}
+
+Status WorkerCgroup::setMemoryHigh(uint64_t bytes) {
+  return writeCgroupFile(worker_path_ / "memory.high",
+                         (bytes == 0) ? "max" : std::to_string(bytes));
+}
+
+Status WorkerCgroup::updateRow(Row& row) {
+  CgroupCounters cpu;
+  auto status = readCgroupCounters(worker_path_ / "cpu.stat", cpu);
+  if (!status.ok()) {
+    return status;
+  }
+
+  row["user_time"] =
+      std::to_string(getDelta(getCounter(cpu, "user_usec"), user_usec_) / 1000);
+  row["system_time"] = std::to_string(
+      getDelta(getCounter(cpu, "system_usec"), system_usec_) / 1000);
+
+  // The anonymous memory leaves out the page cache of the files read.
+  CgroupCounters memory;
+  if (readCgroupCounters(worker_path_ / "memory.stat", memory).ok() &&
+      memory.count("anon") > 0) {
+    row["resident_size"] = std::to_string(memory.at("anon"));
+  }
+
+  CgroupCounters events;
+  if (readCgroupCounters(worker_path_ / "memory.events", events).ok()) {
+    auto high = getCounter(events, "high");
+    if (high > high_events_) {
+      VLOG(1) << "osqueryd worker memory was throttled "
+              << (high - high_events_) << " times";
+      high_events_ = high;
+    }
+
+    auto oom_kill = getCounter(events, "oom_kill");
+    if (oom_kill > oom_kill_events_) {
+      LOG(WARNING) << "The kernel OOM killer stopped "
+                   << (oom_kill - oom_kill_events_)
+                   << " osqueryd worker processes";
+      oom_kill_events_ = oom_kill;
+    }
+  }
+  return Status::success();
+}
+
+} // namespace osquery
@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <sys/types.h>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core/sql/query_data.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/**
+ * @brief The cgroup v2 accounting of the worker and its children.
+ *
+ * The watcher moves itself to a "watcher" leaf below its own cgroup and each
+ * worker to a sibling "worker" leaf, the cgroup v2 rules do not allow the
+ * processes and the enabled controllers to share a cgroup. The kernel then
+ * accounts the CPU time and memory of the worker together with every process
+ * it forks, and keeps counting between the watchdog checks.
+ *
+ * Only the CPU time is available if the memory controller cannot be enabled,
+ * for instance if it is not delegated to the osqueryd service.
+ */
+class WorkerCgroup : private boost::noncopyable {
+ public:
+  /**
+   * @brief Create the cgroups and move the current process.
+   *
+   * @param mount The cgroup v2 mount point.
+   * @param path The cgroup of the current process, from the mount point.
+   * @param cgroup The output parameter, the cgroups of the worker.
+   */
+  static Status create(const boost::filesystem::path& mount,
+                       const std::string& path,
+                       std::unique_ptr<WorkerCgroup>& cgroup);
+
+  /// Read the cgroup v2 path of the current process from /proc/self/cgroup.
+  static Status getCurrentPath(std::string& path);
+
+  /// Move a new worker to its cgroup, the CPU times are counted from here.
+  Status addWorker(pid_t pid);
+
+  /// Throttle and reclaim the memory of the worker above this many bytes.
+  Status setMemoryHigh(uint64_t bytes);
+
+  /**
+   * @brief Replace the usage of a worker processes row with the cgroup's.
+   *
+   * The user_time and system_time columns are set to the milliseconds used
+   * since the worker was added, and resident_size to its anonymous memory if
+   * the memory controller is enabled.
+   */
+  Status updateRow(Row& row);
+
+  /// The cgroup of the workers.
+  const boost::filesystem::path& workerPath() const {
+    return worker_path_;
+  }
+
+ private:
+  WorkerCgroup(const boost::filesystem::path& base);
+
+ private:
+  boost::filesystem::path worker_path_;
+
+  /// The CPU times of the cgroup, in microseconds, when the worker was added.
+  uint64_t user_usec_{0};
+  uint64_t system_usec_{0};
+
+  /// The last memory.events counters.
+  uint64_t high_events_{0};
+  uint64_t oom_kill_events_{0};
+};
+
+} // namespace osquery
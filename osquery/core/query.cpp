@@ -8,15 +8,21 @@
  */
 
 #include <algorithm>
+#include <cstring>
+#include <map>
+#include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <osquery/core/flagalias.h>
 #include <osquery/core/flags.h>
 #include <osquery/core/query.h>
+#include <osquery/core/sql/query_data_binary.h>
 #include <osquery/database/database.h>
 #include <osquery/logger/logger.h>
 
+#include <osquery/utils/conversions/castvariant.h>
 #include <osquery/utils/json/json.h>
 
 namespace rj = rapidjson;
@@ -25,6 +31,12 @@ namespace osquery {
 
 DECLARE_bool(decorations_top_level);
 
+/// Key suffix of the sorted row digests saved with a query's results.
+const std::string kQueryDigestsSuffix{"digests"};
+
+/// Key suffix of the layout and digests of results saved in buckets.
+const std::string kQueryBucketsSuffix{"buckets"};
+
 /// Log numeric values as numbers (in JSON syntax)
 FLAG(bool,
      logger_numerics,
@@ -32,6 +44,87 @@ FLAG(bool,
      "Use numeric JSON syntax for numeric values");
 FLAG_ALIAS(bool, log_numerics_as_numbers, logger_numerics);
 
+FLAG(bool,
+     results_compression,
+     true,
+     "Compress the stored results of scheduled queries with zstd");
+
+namespace {
+
+/// The layout of results saved in buckets.
+struct ResultBuckets {
+  /// The column whose value picks the bucket of a row.
+  std::string key;
+
+  /// The digest of each bucket's sorted row digests.
+  RowDigests digests;
+};
+
+std::string bucketRowsKey(const std::string& name, size_t bucket) {
+  return name + "bucket." + std::to_string(bucket);
+}
+
+std::string bucketDigestsKey(const std::string& name, size_t bucket) {
+  return name + "bucketdigests." + std::to_string(bucket);
+}
+
+/// Read the layout of a query's results, false if they are not in buckets.
+bool getResultBuckets(const std::string& name, ResultBuckets& buckets) {
+  std::string raw;
+  auto status = getDatabaseValue(kQueries, name + kQueryBucketsSuffix, raw);
+  if (!status.ok()) {
+    return false;
+  }
+
+  // The key column, a newline, then the digest of each bucket.
+  auto separator = raw.find('\n');
+  if (separator == std::string::npos) {
+    return false;
+  }
+  buckets.key = raw.substr(0, separator);
+  buckets.digests.clear();
+
+  // Bucket digests are in bucket order, they are not sorted.
+  auto encoded = raw.size() - separator - 1;
+  if (encoded == 0 || encoded % 16 != 0) {
+    return false;
+  }
+  for (size_t i = separator + 1; i < raw.size(); i += 16) {
+    RowDigests digest;
+    if (!deserializeRowDigests(raw.substr(i, 16), digest).ok()) {
+      return false;
+    }
+    buckets.digests.push_back(digest.front());
+  }
+  return true;
+}
+
+std::string serializeResultBuckets(const ResultBuckets& buckets) {
+  return buckets.key + '\n' + serializeRowDigests(buckets.digests);
+}
+
+/// A visitor keeping the rows that match a set of sorted digests.
+std::function<void(RowTyped&&)> matchRows(const RowDigests& digests,
+                                          std::vector<bool>& matched,
+                                          QueryDataTyped& rows) {
+  // Equal rows share a digest, mark each digest as it is matched.
+  matched.assign(digests.size(), false);
+  return [&digests, &matched, &rows](RowTyped&& row) {
+    auto digest = digestRow(row);
+    auto range = std::equal_range(digests.begin(), digests.end(), digest);
+    for (auto it = range.first; it != range.second; ++it) {
+      auto index = static_cast<size_t>(it - digests.begin());
+      if (!matched[index]) {
+        matched[index] = true;
+        rows.push_back(std::move(row));
+        break;
+      }
+    }
+  };
+}
+
+} // namespace
+
 uint64_t Query::getPreviousEpoch() const {
   uint64_t epoch = 0;
   std::string raw;
@@ -64,22 +157,109 @@ uint64_t Query::getQueryCounter(bool is_reset,
   return counter;
 }
 
+Status Query::visitPreviousQueryRows(
+    std::function<void(RowTyped&&)> predicate) const {
+  ResultBuckets buckets;
+  if (!getResultBuckets(name_, buckets)) {
+    std::string raw;
+    auto status = getDatabaseValue(kQueries, name_, raw);
+    if (!status.ok()) {
+      return status;
+    }
+    return visitSerializedQueryData(raw, std::move(predicate));
+  }
+
+  for (size_t i = 0; i < buckets.digests.size(); ++i) {
+    std::string raw;
+    auto status = getDatabaseValue(kQueries, bucketRowsKey(name_, i), raw);
+    if (status.ok()) {
+      status = visitSerializedQueryData(raw, predicate);
+    }
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return Status::success();
+}
+
 Status Query::getPreviousQueryResults(QueryDataSet& results) const {
+  return visitPreviousQueryRows(
+      [&results](RowTyped&& row) { results.insert(std::move(row)); });
+}
+
+Status Query::getPreviousQueryDigests(RowDigests& digests) const {
+  ResultBuckets buckets;
+  if (getResultBuckets(name_, buckets)) {
+    digests.clear();
+    for (size_t i = 0; i < buckets.digests.size(); ++i) {
+      std::string raw;
+      RowDigests bucket;
+      auto status =
+          getDatabaseValue(kQueries, bucketDigestsKey(name_, i), raw);
+      if (status.ok()) {
+        status = deserializeRowDigests(raw, bucket);
+      }
+      if (!status.ok()) {
+        return status;
+      }
+      digests.insert(digests.end(), bucket.begin(), bucket.end());
+    }
+    std::sort(digests.begin(), digests.end());
+    return Status::success();
+  }
+
   std::string raw;
-  auto status = getDatabaseValue(kQueries, name_, raw);
+  auto status = getDatabaseValue(kQueries, name_ + kQueryDigestsSuffix, raw);
+  if (status.ok()) {
+    status = deserializeRowDigests(raw, digests);
+    if (status.ok()) {
+      return status;
+    }
+    LOG(WARNING) << "Recomputing invalid row digests for query " << name_
+                 << ": " << status.getMessage();
+  }
+
+  // The results were saved without digests.
+  raw.clear();
+  status = getDatabaseValue(kQueries, name_, raw);
+  if (!status.ok()) {
+    return status;
+  }
+
+  digests.clear();
+  status = visitSerializedQueryData(raw, [&digests](RowTyped&& row) {
+    digests.push_back(digestRow(row));
+  });
   if (!status.ok()) {
     return status;
   }
+  std::sort(digests.begin(), digests.end());
+  return setDatabaseValue(
+      kQueries, name_ + kQueryDigestsSuffix, serializeRowDigests(digests));
+}
+
+Status Query::getPreviousQueryRows(const RowDigests& digests,
+                                   QueryDataTyped& rows) const {
+  if (digests.empty()) {
+    return Status::success();
+  }
 
-  status = deserializeQueryDataJSON(raw, results);
+  std::vector<bool> matched;
+  auto status = visitPreviousQueryRows(matchRows(digests, matched, rows));
   if (!status.ok()) {
     return status;
   }
+
+  std::sort(rows.begin(), rows.end());
   return Status::success();
 }
 
-Status Query::saveQueryResults(const std::string& json, uint64_t epoch) const {
-  auto status = setDatabaseValue(kQueries, name_, json);
+Status Query::saveQueryResults(const std::string& results,
+                               uint64_t epoch) const {
+  // Digests that do not describe the results would corrupt the next diff.
+  deleteDatabaseValue(kQueries, name_ + kQueryDigestsSuffix);
+  deleteResultBuckets(name_);
+  auto status = setDatabaseValue(kQueries, name_, results);
   if (!status.ok()) {
     return status;
   }
@@ -87,12 +267,72 @@ Status Query::saveQueryResults(const std::string& json, uint64_t epoch) const {
   return setDatabaseValue(kQueries, name_ + "epoch", std::to_string(epoch));
 }
 
+Status Query::saveQueryResults(const std::string& results,
+                               const RowDigests& digests,
+                               uint64_t epoch) const {
+  auto status = saveQueryResults(results, epoch);
+  if (!status.ok()) {
+    return status;
+  }
+
+  return setDatabaseValue(
+      kQueries, name_ + kQueryDigestsSuffix, serializeRowDigests(digests));
+}
+
 std::vector<std::string> Query::getStoredQueryNames() {
   std::vector<std::string> results;
   scanDatabaseKeys(kQueries, results);
   return results;
 }
 
+void Query::deleteResultBuckets(const std::string& name) {
+  ResultBuckets buckets;
+  if (!getResultBuckets(name, buckets)) {
+    return;
+  }
+
+  // The layout is removed first, the buckets are not read without it.
+  deleteDatabaseValue(kQueries, name + kQueryBucketsSuffix);
+  for (size_t i = 0; i < buckets.digests.size(); ++i) {
+    deleteDatabaseValue(kQueries, bucketRowsKey(name, i));
+    deleteDatabaseValue(kQueries, bucketDigestsKey(name, i));
+  }
+}
+
+bool Query::isQueryDataKey(const std::string& key,
+                           const std::set<std::string>& keys) {
+  auto derivedFrom = [&key, &keys](size_t name_size) {
+    return name_size > 0 && keys.count(key.substr(0, name_size)) > 0;
+  };
+
+  static const std::vector<std::string> kSuffixes = {
+      "epoch", "counter", kQueryDigestsSuffix, kQueryBucketsSuffix};
+  for (const auto& suffix : kSuffixes) {
+    if (key.size() > suffix.size() &&
+        key.compare(key.size() - suffix.size(), suffix.size(), suffix) == 0 &&
+        derivedFrom(key.size() - suffix.size())) {
+      return true;
+    }
+  }
+
+  // The rows and digests of a bucket end with its index.
+  auto index = key.find_last_not_of("0123456789");
+  if (index != std::string::npos && index + 1 < key.size() &&
+      key[index] == '.') {
+    static const std::vector<std::string> kBucketSuffixes = {"bucket",
+                                                            "bucketdigests"};
+    for (const auto& suffix : kBucketSuffixes) {
+      if (index >= suffix.size() &&
+          key.compare(index - suffix.size(), suffix.size(), suffix) == 0 &&
+          derivedFrom(index - suffix.size())) {
+        return true;
+      }
+    }
+  }
+
+  return key.compare(0, 6, "query.") == 0 && keys.count(key.substr(6)) > 0;
+}
+
 bool Query::isQueryNameInDatabase() const {
   auto names = Query::getStoredQueryNames();
   return std::find(names.begin(), names.end(), name_) != names.end();
@@ -167,43 +407,63 @@ Status Query::addNewResults(QueryDataTyped current_qd,
   bool new_query_epoch = false;
   bool new_query_sql = false;
   getQueryStatus(current_epoch, new_query_epoch, new_query_sql);
+  if (diff_buckets_ > 1) {
+    return addNewBucketedResults(
+        std::move(current_qd), current_epoch, new_query_epoch, counter, dr);
+  }
 
-  // Use a 'target' avoid copying the query data when serializing and saving.
-  // If a differential is requested and needed the target remains the original
-  // query data, otherwise the content is moved to the differential's added set.
-  const auto* target_gd = &current_qd;
+  // The current rows are stored before the added rows are moved out of them
+  // into the differential, so no row is copied.
   bool update_db = true;
+  RowDigests digests;
+  std::vector<size_t> added;
   if (!new_query_epoch) {
-    // Get the rows from the last run of this query name.
-    QueryDataSet previous_qd;
-    auto status = getPreviousQueryResults(previous_qd);
+    // Get the row digests from the last run of this query name.
+    RowDigests previous_digests;
+    auto status = getPreviousQueryDigests(previous_digests);
     if (!status.ok()) {
       return status;
     }
 
     // Calculate the differential between previous and current query results.
-    dr = diff(previous_qd, current_qd);
+    RowDigests removed;
+    added = diffAddedRows(previous_digests, current_qd, digests, removed);
+
+    // Only the removed rows are read from the previous results.
+    status = getPreviousQueryRows(removed, dr.removed);
+    if (!status.ok()) {
+      return status;
+    }
 
-    update_db = (!dr.added.empty() || !dr.removed.empty());
+    update_db = (!added.empty() || !dr.removed.empty());
   } else {
-    dr.added = std::move(current_qd);
-    target_gd = &dr.added;
+    digests = digestQueryData(current_qd);
   }
 
   if (update_db) {
     // Replace the "previous" query data with the current.
-    std::string json;
-    auto status = serializeQueryDataJSON(*target_gd, json, true);
+    std::string encoded;
+    auto status = serializeQueryDataBinary(
+        current_qd, encoded, FLAGS_results_compression);
     if (!status.ok()) {
       return status;
     }
 
-    status = saveQueryResults(json, current_epoch);
+    status = saveQueryResults(encoded, digests, current_epoch);
     if (!status.ok()) {
       return status;
     }
   }
 
+  if (new_query_epoch) {
+    dr.added = std::move(current_qd);
+  } else {
+    dr.added.reserve(added.size());
+    for (auto i : added) {
+      dr.added.push_back(std::move(current_qd[i]));
+    }
+  }
+
   if (update_db || new_query_epoch) {
     auto status = incrementCounter(new_query_epoch, true, counter);
     if (!status.ok()) {
@@ -213,6 +473,148 @@ Status Query::addNewResults(QueryDataTyped current_qd,
   return Status::success();
 }
 
+Status Query::addNewBucketedResults(QueryDataTyped current_qd,
+                                    const uint64_t current_epoch,
+                                    bool new_query_epoch,
+                                    uint64_t& counter,
+                                    DiffResults& dr) const {
+  ResultBuckets previous;
+  bool same_layout = !new_query_epoch && getResultBuckets(name_, previous) &&
+                     previous.key == diff_key_ &&
+                     previous.digests.size() == diff_buckets_;
+
+  // Results saved whole, or in other buckets, are compared whole once.
+  std::vector<bool> is_added(current_qd.size(), new_query_epoch);
+  if (!new_query_epoch && !same_layout) {
+    RowDigests previous_digests;
+    auto status = getPreviousQueryDigests(previous_digests);
+    if (!status.ok()) {
+      return status;
+    }
+
+    RowDigests digests;
+    RowDigests removed;
+    auto indexes =
+        diffAddedRows(previous_digests, current_qd, digests, removed);
+    for (auto i : indexes) {
+      is_added[i] = true;
+    }
+    status = getPreviousQueryRows(removed, dr.removed);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  // Split the rows into buckets, keeping the added rows of the whole diff.
+  std::vector<QueryDataTyped> rows(diff_buckets_);
+  std::vector<std::vector<size_t>> added(diff_buckets_);
+  for (size_t i = 0; i < current_qd.size(); ++i) {
+    auto bucket = rowBucket(current_qd[i], diff_key_, diff_buckets_);
+    if (is_added[i]) {
+      added[bucket].push_back(rows[bucket].size());
+    }
+    rows[bucket].push_back(std::move(current_qd[i]));
+  }
+
+  ResultBuckets current;
+  current.key = diff_key_;
+  std::vector<RowDigests> digests(diff_buckets_);
+  for (size_t i = 0; i < diff_buckets_; ++i) {
+    digests[i] = digestQueryData(rows[i]);
+    current.digests.push_back(digestRowDigests(digests[i]));
+  }
+
+  // A bucket with the same digest holds the same rows, it is not read.
+  std::vector<size_t> changed;
+  for (size_t i = 0; i < diff_buckets_; ++i) {
+    if (!same_layout) {
+      changed.push_back(i);
+      continue;
+    } else if (previous.digests[i] == current.digests[i]) {
+      continue;
+    }
+
+    changed.push_back(i);
+    std::string raw;
+    RowDigests previous_digests;
+    auto status = getDatabaseValue(kQueries, bucketDigestsKey(name_, i), raw);
+    if (status.ok()) {
+      status = deserializeRowDigests(raw, previous_digests);
+    }
+    if (!status.ok()) {
+      return status;
+    }
+
+    RowDigests removed;
+    added[i] = diffAddedRows(previous_digests, rows[i], digests[i], removed);
+    if (removed.empty()) {
+      continue;
+    }
+
+    raw.clear();
+    status = getDatabaseValue(kQueries, bucketRowsKey(name_, i), raw);
+    if (!status.ok()) {
+      return status;
+    }
+    std::vector<bool> matched;
+    status =
+        visitSerializedQueryData(raw, matchRows(removed, matched, dr.removed));
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  std::sort(dr.removed.begin(), dr.removed.end());
+
+  if (!same_layout) {
+    // The whole results are replaced by buckets.
+    std::string encoded;
+    auto status = serializeQueryDataBinary(QueryDataTyped(), encoded, false);
+    if (status.ok()) {
+      status = saveQueryResults(encoded, current_epoch);
+    }
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  if (!changed.empty()) {
+    // The changed buckets and the layout are saved together.
+    DatabaseStringValueList data;
+    for (auto i : changed) {
+      std::string encoded;
+      auto status = serializeQueryDataBinary(
+          rows[i], encoded, FLAGS_results_compression);
+      if (!status.ok()) {
+        return status;
+      }
+      data.emplace_back(bucketRowsKey(name_, i), std::move(encoded));
+      data.emplace_back(bucketDigestsKey(name_, i),
+                        serializeRowDigests(digests[i]));
+    }
+    data.emplace_back(name_ + kQueryBucketsSuffix,
+                      serializeResultBuckets(current));
+
+    auto status = setDatabaseBatch(kQueries, data);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  for (size_t i = 0; i < diff_buckets_; ++i) {
+    for (auto index : added[i]) {
+      dr.added.push_back(std::move(rows[i][index]));
+    }
+  }
+
+  if (!dr.hasNoResults() || new_query_epoch) {
+    auto status = incrementCounter(new_query_epoch, true, counter);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return Status::success();
+}
+
 Status deserializeDiffResults(const rj::Value& doc, DiffResults& dr) {
   if (!doc.IsObject()) {
     return Status(1);
@@ -356,31 +758,600 @@ Status serializeQueryLogItemAsEvents(const QueryLogItem& item, JSON& doc) {
   return Status::success();
 }
 
+namespace {
+
+using JSONWriter = rj::Writer<rj::StringBuffer>;
+
+/// Serialization buffers larger than this are released after use.
+const size_t kMaxRetainedBufferSize = 1024 * 1024;
+
+/// Keys a top-level decoration would replace in a serialized item.
+const std::set<std::string> kQueryLogItemKeys = {"name",
+                                                 "hostIdentifier",
+                                                 "calendarTime",
+                                                 "unixTime",
+                                                 "epoch",
+                                                 "counter",
+                                                 "numerics",
+                                                 "decorations",
+                                                 "diffResults",
+                                                 "snapshot",
+                                                 "action",
+                                                 "columns",
+                                                 "rows",
+                                                 "removed"};
+
+/// Decorations serialized for the last item a thread logged.
+struct SerializedDecorations {
+  std::map<std::string, std::string> decorations;
+  uint64_t generation{0};
+  bool top_level{false};
+  std::string members;
+};
+
+/// Append the members of a complete object, without its braces.
+void appendMembers(const rj::StringBuffer& sb, std::string& out) {
+  if (sb.GetSize() > 2) {
+    out.append(sb.GetString() + 1, sb.GetSize() - 2);
+  }
+}
+
+/// Release a thread's buffer once a large item was serialized with it.
+void releaseIfLarge(rj::StringBuffer& sb) {
+  if (sb.GetSize() > kMaxRetainedBufferSize) {
+    sb.Clear();
+    sb.ShrinkToFit();
+  }
+}
+
+/**
+ * @brief Check if an item can be written without a JSON document.
+ *
+ * A document replaces a member when a top-level decoration has the same key,
+ * those rare items keep the document serialization.
+ */
+bool canWriteQueryLogItem(const QueryLogItem& item) {
+  if (!FLAGS_decorations_top_level) {
+    return true;
+  }
+
+  for (const auto& decoration : item.decorations) {
+    if (kQueryLogItemKeys.count(decoration.first) > 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Get the decorations of an item as object members.
+ *
+ * Decorations only change with the config and at decorator intervals, so
+ * each thread keeps its last serialization while they are unchanged. Items
+ * with a known generation are matched without comparing the decorations.
+ */
+const std::string& getSerializedDecorations(const QueryLogItem& item) {
+  thread_local SerializedDecorations cache;
+  if (cache.top_level == FLAGS_decorations_top_level) {
+    if (item.decorations_generation != 0 &&
+        item.decorations_generation == cache.generation) {
+      return cache.members;
+    }
+    if (cache.decorations == item.decorations) {
+      cache.generation = item.decorations_generation;
+      return cache.members;
+    }
+  }
+
+  rj::StringBuffer sb;
+  JSONWriter writer(sb);
+  writer.StartObject();
+  if (!item.decorations.empty()) {
+    if (!FLAGS_decorations_top_level) {
+      writer.Key("decorations");
+      writer.StartObject();
+    }
+    for (const auto& decoration : item.decorations) {
+      writer.Key(decoration.first.data(),
+                 static_cast<rj::SizeType>(decoration.first.size()));
+      writer.String(decoration.second.data(),
+                    static_cast<rj::SizeType>(decoration.second.size()));
+    }
+    if (!FLAGS_decorations_top_level) {
+      writer.EndObject();
+    }
+  }
+  writer.EndObject();
+
+  cache.decorations = item.decorations;
+  cache.generation = item.decorations_generation;
+  cache.top_level = FLAGS_decorations_top_level;
+  cache.members.clear();
+  appendMembers(sb, cache.members);
+  return cache.members;
+}
+
+/// Append the members addLegacyFieldsAndDecorations adds to a document.
+void appendLegacyFieldsAndDecorations(const QueryLogItem& item,
+                                      std::string& out) {
+  rj::StringBuffer sb;
+  JSONWriter writer(sb);
+  writer.StartObject();
+  writer.Key("name");
+  writer.String(item.name.data(), static_cast<rj::SizeType>(item.name.size()));
+  writer.Key("hostIdentifier");
+  writer.String(item.identifier.data(),
+                static_cast<rj::SizeType>(item.identifier.size()));
+  writer.Key("calendarTime");
+  writer.String(item.calendar_time.data(),
+                static_cast<rj::SizeType>(item.calendar_time.size()));
+  writer.Key("unixTime");
+  writer.Uint64(item.time);
+  writer.Key("epoch");
+  writer.Uint64(item.epoch);
+  writer.Key("counter");
+  writer.Uint64(item.counter);
+  writer.Key("numerics");
+  writer.Bool(FLAGS_logger_numerics);
+  writer.EndObject();
+  appendMembers(sb, out);
+
+  const auto& decorations = getSerializedDecorations(item);
+  if (!decorations.empty()) {
+    out += ',';
+    out += decorations;
+  }
+}
+
+} // namespace
+
+/// Write a typed value to a streaming writer, as serializeRow would.
+static void writeValue(JSONWriter& writer,
+                       const RowDataTyped& value,
+                       bool asNumeric) {
+  if (!asNumeric) {
+    auto text = castVariant(value);
+    writer.String(text.data(), static_cast<rj::SizeType>(text.size()));
+  } else if (auto integer = boost::get<long long>(&value)) {
+    writer.Int64(*integer);
+  } else if (auto number = boost::get<double>(&value)) {
+    writer.Double(*number);
+  } else {
+    const auto& text = boost::get<std::string>(value);
+    writer.String(text.data(), static_cast<rj::SizeType>(text.size()));
+  }
+}
+
+/// Write a typed row to a streaming writer, as serializeRow would.
+static void writeRow(JSONWriter& writer, const RowTyped& row, bool asNumeric) {
+  writer.StartObject();
+  for (const auto& column : row) {
+    writer.Key(column.first.data(),
+               static_cast<rj::SizeType>(column.first.size()));
+    writeValue(writer, column.second, asNumeric);
+  }
+  writer.EndObject();
+}
+
+/// Write typed rows as an array, as serializeQueryData would.
+static void writeRows(JSONWriter& writer,
+                      const QueryDataTyped& rows,
+                      bool asNumeric) {
+  writer.StartArray();
+  for (const auto& row : rows) {
+    writeRow(writer, row, asNumeric);
+  }
+  writer.EndArray();
+}
+
+/**
+ * @brief Serialize an event, as serializeEvent and its action would.
+ *
+ * @param fields The item's legacy fields and decorations.
+ * @param row The event's columns.
+ * @param action The event's action.
+ * @param sb A buffer for the columns.
+ */
+static std::string writeEvent(const std::string& fields,
+                              const RowTyped& row,
+                              const std::string& action,
+                              rj::StringBuffer& sb) {
+  sb.Clear();
+  JSONWriter writer(sb);
+  writeRow(writer, row, FLAGS_logger_numerics);
+
+  std::string event;
+  event.reserve(fields.size() + sb.GetSize() + action.size() + 24);
+  event += '{';
+  event += fields;
+  event += ",\"columns\":";
+  event.append(sb.GetString(), sb.GetSize());
+  event += ",\"action\":\"";
+  event += action;
+  event += "\"}";
+  return event;
+}
+
+/// Serialize snapshot lines through a JSON document, see canWriteQueryLogItem.
+static Status serializeSnapshotQueryLogItemDocument(
+    const QueryLogItem& item,
+    bool events,
+    size_t max_size,
+    const std::function<void(const std::string&)>& emit) {
+  if (events) {
+    // Each row is a complete event, only one is serialized at a time.
+    for (const auto& row : item.snapshot_results) {
+      auto doc = JSON::newObject();
+      auto row_obj = doc.getObject();
+      auto status = serializeRow(row, doc, row_obj, FLAGS_logger_numerics);
+      if (!status.ok()) {
+        return status;
+      }
+
+      auto obj = doc.getObject();
+      serializeEvent(item, row_obj, doc, obj);
+      doc.addCopy("action", "snapshot", obj);
+
+      rj::StringBuffer sb;
+      JSONWriter writer(sb);
+      obj.Accept(writer);
+      emit(sb.GetString());
+    }
+    return Status::success();
+  }
+
+  // The fields besides the rows are shared by every line. They are built as
+  // serializeQueryLogItem builds them, around an empty snapshot array.
+  auto fields = JSON::newObject();
+  auto empty = fields.getArray();
+  fields.add("snapshot", empty);
+  fields.addRef("action", "snapshot");
+  addLegacyFieldsAndDecorations(item, fields, fields.doc());
+
+  rj::StringBuffer rows_sb;
+  JSONWriter rows_writer(rows_sb);
+  rows_writer.StartArray();
+
+  rj::StringBuffer line_sb;
+  auto flush = [&]() {
+    rows_writer.EndArray();
+    line_sb.Clear();
+    JSONWriter writer(line_sb);
+    writer.StartObject();
+    for (const auto& field : fields.doc().GetObject()) {
+      field.name.Accept(writer);
+      if (field.value.IsArray() &&
+          std::strcmp(field.name.GetString(), "snapshot") == 0) {
+        writer.RawValue(
+            rows_sb.GetString(), rows_sb.GetSize(), rj::kArrayType);
+      } else {
+        field.value.Accept(writer);
+      }
+    }
+    writer.EndObject();
+    emit(line_sb.GetString());
+
+    rows_sb.Clear();
+    rows_writer.Reset(rows_sb);
+    rows_writer.StartArray();
+  };
+
+  size_t pending = 0;
+  for (const auto& row : item.snapshot_results) {
+    writeRow(rows_writer, row, FLAGS_logger_numerics);
+    pending++;
+    if (max_size > 0 && rows_sb.GetSize() >= max_size) {
+      flush();
+      pending = 0;
+    }
+  }
+
+  if (pending > 0 || max_size == 0 || item.snapshot_results.empty()) {
+    flush();
+  }
+  return Status::success();
+}
+
+Status serializeSnapshotQueryLogItem(
+    const QueryLogItem& item,
+    bool events,
+    size_t max_size,
+    const std::function<void(const std::string&)>& emit) {
+  if (!canWriteQueryLogItem(item)) {
+    return serializeSnapshotQueryLogItemDocument(item, events, max_size, emit);
+  }
+
+  // The fields besides the rows are shared by every line.
+  std::string fields;
+  appendLegacyFieldsAndDecorations(item, fields);
+
+  thread_local rj::StringBuffer rows_sb;
+  rows_sb.Clear();
+  if (events) {
+    // Each row is a complete event, only one is serialized at a time.
+    for (const auto& row : item.snapshot_results) {
+      emit(writeEvent(fields, row, "snapshot", rows_sb));
+    }
+    releaseIfLarge(rows_sb);
+    return Status::success();
+  }
+
+  JSONWriter rows_writer(rows_sb);
+  rows_writer.StartArray();
+
+  std::string line;
+  auto flush = [&]() {
+    rows_writer.EndArray();
+    line.clear();
+    line += "{\"snapshot\":";
+    line.append(rows_sb.GetString(), rows_sb.GetSize());
+    line += ",\"action\":\"snapshot\",";
+    line += fields;
+    line += '}';
+    emit(line);
+
+    rows_sb.Clear();
+    rows_writer.Reset(rows_sb);
+    rows_writer.StartArray();
+  };
+
+  size_t pending = 0;
+  for (const auto& row : item.snapshot_results) {
+    writeRow(rows_writer, row, FLAGS_logger_numerics);
+    pending++;
+    if (max_size > 0 && rows_sb.GetSize() >= max_size) {
+      flush();
+      pending = 0;
+    }
+  }
+
+  // The last line holds the remaining rows, a snapshot without rows is still
+  // logged once.
+  if (pending > 0 || max_size == 0 || item.snapshot_results.empty()) {
+    flush();
+  }
+  releaseIfLarge(rows_sb);
+  return Status::success();
+}
+
 Status serializeQueryLogItemJSON(const QueryLogItem& item, std::string& json) {
-  auto doc = JSON::newObject();
-  auto status = serializeQueryLogItem(item, doc);
-  if (!status.ok()) {
-    return status;
+  if (!canWriteQueryLogItem(item)) {
+    auto doc = JSON::newObject();
+    auto status = serializeQueryLogItem(item, doc);
+    if (!status.ok()) {
+      return status;
+    }
+    return doc.toString(json);
+  }
+
+  // The results are written first, then the fields are appended after them.
+  thread_local rj::StringBuffer sb;
+  sb.Clear();
+  JSONWriter writer(sb);
+  writer.StartObject();
+  if (!item.isSnapshot) {
+    writer.Key("diffResults");
+    writer.StartObject();
+    writer.Key("removed");
+    writeRows(writer, item.results.removed, FLAGS_logger_numerics);
+    writer.Key("added");
+    writeRows(writer, item.results.added, FLAGS_logger_numerics);
+    writer.EndObject();
+  } else {
+    writer.Key("snapshot");
+    writeRows(writer, item.snapshot_results, FLAGS_logger_numerics);
+    writer.Key("action");
+    writer.String("snapshot");
   }
 
-  return doc.toString(json);
+  json.assign(sb.GetString(), sb.GetSize());
+  json += ',';
+  appendLegacyFieldsAndDecorations(item, json);
+  json += '}';
+  releaseIfLarge(sb);
+  return Status::success();
 }
 
 Status serializeQueryLogItemAsEventsJSON(const QueryLogItem& item,
                                          std::vector<std::string>& items) {
-  auto doc = JSON::newArray();
-  auto status = serializeQueryLogItemAsEvents(item, doc);
-  if (!status.ok()) {
-    return status;
+  if (!canWriteQueryLogItem(item)) {
+    auto doc = JSON::newArray();
+    auto status = serializeQueryLogItemAsEvents(item, doc);
+    if (!status.ok()) {
+      return status;
+    }
+
+    for (auto& event : doc.doc().GetArray()) {
+      rj::StringBuffer sb;
+      JSONWriter writer(sb);
+      event.Accept(writer);
+      items.push_back(sb.GetString());
+    }
+    return Status::success();
   }
 
-  // return doc.toString()
-  for (auto& event : doc.doc().GetArray()) {
-    rj::StringBuffer sb;
-    rj::Writer<rj::StringBuffer> writer(sb);
-    event.Accept(writer);
-    items.push_back(sb.GetString());
+  if (item.isSnapshot ? item.snapshot_results.empty()
+                      : item.results.hasNoResults()) {
+    return Status::success();
   }
+
+  std::string fields;
+  appendLegacyFieldsAndDecorations(item, fields);
+
+  thread_local rj::StringBuffer sb;
+  auto add = [&fields, &items](const QueryDataTyped& rows,
+                               const std::string& action) {
+    for (const auto& row : rows) {
+      items.push_back(writeEvent(fields, row, action, sb));
+    }
+  };
+
+  if (item.isSnapshot) {
+    add(item.snapshot_results, "snapshot");
+  } else {
+    add(item.results.removed, "removed");
+    add(item.results.added, "added");
+  }
+  releaseIfLarge(sb);
+  return Status::success();
+}
+
+/**
+ * @brief Write the values of a column, one per row.
+ *
+ * A column of strings that repeat is written as a dictionary of the distinct
+ * strings and the index of each row's string. Rows without the column have
+ * a null value, or a -1 index.
+ */
+static void writeColumn(JSONWriter& writer,
+                        const std::string& column,
+                        const std::vector<const RowTyped*>& rows,
+                        bool asNumeric) {
+  std::vector<const RowDataTyped*> values;
+  values.reserve(rows.size());
+  bool strings = true;
+  for (const auto* row : rows) {
+    auto it = row->find(column);
+    values.push_back((it == row->end()) ? nullptr : &it->second);
+    if (it != row->end() && asNumeric &&
+        boost::get<std::string>(&it->second) == nullptr) {
+      strings = false;
+    }
+  }
+
+  std::vector<std::string> dictionary;
+  std::vector<int64_t> indexes;
+  if (strings) {
+    std::unordered_map<std::string, int64_t> positions;
+    indexes.reserve(values.size());
+    for (const auto* value : values) {
+      if (value == nullptr) {
+        indexes.push_back(-1);
+        continue;
+      }
+
+      auto text = castVariant(*value);
+      auto position = positions.find(text);
+      if (position == positions.end()) {
+        auto index = static_cast<int64_t>(dictionary.size());
+        position = positions.emplace(text, index).first;
+        dictionary.push_back(std::move(text));
+      }
+      indexes.push_back(position->second);
+    }
+  }
+
+  if (strings && dictionary.size() * 2 <= values.size()) {
+    writer.StartObject();
+    writer.Key("dictionary");
+    writer.StartArray();
+    for (const auto& text : dictionary) {
+      writer.String(text.data(), static_cast<rj::SizeType>(text.size()));
+    }
+    writer.EndArray();
+    writer.Key("indexes");
+    writer.StartArray();
+    for (auto index : indexes) {
+      writer.Int64(index);
+    }
+    writer.EndArray();
+    writer.EndObject();
+    return;
+  }
+
+  writer.StartArray();
+  for (const auto* value : values) {
+    if (value == nullptr) {
+      writer.Null();
+    } else {
+      writeValue(writer, *value, asNumeric);
+    }
+  }
+  writer.EndArray();
+}
+
+Status serializeQueryLogItemColumnarJSON(const QueryLogItem& item,
+                                         std::string& json) {
+  json.clear();
+  if (!item.isSnapshot && item.results.hasNoResults()) {
+    return Status::success();
+  }
+
+  // Removed rows come first, the removed member counts them.
+  std::vector<const RowTyped*> rows;
+  if (item.isSnapshot) {
+    for (const auto& row : item.snapshot_results) {
+      rows.push_back(&row);
+    }
+  } else {
+    for (const auto& row : item.results.removed) {
+      rows.push_back(&row);
+    }
+    for (const auto& row : item.results.added) {
+      rows.push_back(&row);
+    }
+  }
+
+  std::vector<std::string> columns;
+  std::set<std::string> seen;
+  for (const auto* row : rows) {
+    for (const auto& column : *row) {
+      if (seen.insert(column.first).second) {
+        columns.push_back(column.first);
+      }
+    }
+  }
+
+  thread_local rj::StringBuffer sb;
+  sb.Clear();
+  JSONWriter writer(sb);
+  writer.StartObject();
+  for (const auto& column : columns) {
+    writer.Key(column.data(), static_cast<rj::SizeType>(column.size()));
+    writeColumn(writer, column, rows, FLAGS_logger_numerics);
+  }
+  writer.EndObject();
+
+  auto removed = item.isSnapshot ? 0 : item.results.removed.size();
+  if (!canWriteQueryLogItem(item)) {
+    // Decorations may replace fields, as they do within a document.
+    auto fields = JSON::newObject();
+    fields.add("columns", fields.getObject());
+    fields.addCopy("action", item.isSnapshot ? "snapshot" : "diff");
+    fields.add("rows", rows.size());
+    fields.add("removed", removed);
+    addLegacyFieldsAndDecorations(item, fields, fields.doc());
+
+    rj::StringBuffer line_sb;
+    JSONWriter line_writer(line_sb);
+    line_writer.StartObject();
+    for (const auto& field : fields.doc().GetObject()) {
+      field.name.Accept(line_writer);
+      if (field.value.IsObject() &&
+          std::strcmp(field.name.GetString(), "columns") == 0) {
+        line_writer.RawValue(sb.GetString(), sb.GetSize(), rj::kObjectType);
+      } else {
+        field.value.Accept(line_writer);
+      }
+    }
+    line_writer.EndObject();
+    json.assign(line_sb.GetString(), line_sb.GetSize());
+    releaseIfLarge(sb);
+    return Status::success();
+  }
+
+  json += '{';
+  appendLegacyFieldsAndDecorations(item, json);
+  json += ",\"action\":\"";
+  json += item.isSnapshot ? "snapshot" : "diff";
+  json += "\",\"rows\":";
+  json += std::to_string(rows.size());
+  json += ",\"removed\":";
+  json += std::to_string(removed);
+  json += ",\"columns\":";
+  json.append(sb.GetString(), sb.GetSize());
+  json += '}';
+  releaseIfLarge(sb);
   return Status::success();
 }
 
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <functional>
 #include <map>
 #include <set>
 #include <string>
@@ -65,6 +66,9 @@ struct QueryLogItem {
   /// A set of additional fields to emit with the log line.
   std::map<std::string, std::string> decorations;
 
+  /// The generation of the decorations, or 0 if it is unknown.
+  uint64_t decorations_generation{0};
+
   /// equals operator
   bool operator==(const QueryLogItem& comp) const {
     return (comp.results == results) && (comp.name == name);
@@ -119,6 +123,46 @@ Status serializeQueryLogItemAsEvents(const QueryLogItem& item, JSON& json);
 Status serializeQueryLogItemAsEventsJSON(const QueryLogItem& i,
                                          std::vector<std::string>& items);
 
+/**
+ * @brief Serialize a QueryLogItem object into a single columnar JSON string.
+ *
+ * The fields of the item are written once, followed by the values of each
+ * column as an array with one value per row. Columns of repeated strings
+ * are written as a dictionary of the distinct strings and the index of each
+ * row's string. The removed rows of a diff come first, the removed field
+ * counts them. A diff without changes leaves json empty.
+ *
+ * @param item the QueryLogItem to serialize.
+ * @param json [output] the output JSON string.
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status serializeQueryLogItemColumnarJSON(const QueryLogItem& item,
+                                         std::string& json);
+
+/**
+ * @brief Serialize a snapshot log item incrementally into one or more lines.
+ *
+ * Rows are written with a streaming writer rather than into a JSON document,
+ * and each line is passed to emit as soon as it is complete. A line holds the
+ * rows written until they reach max_size bytes, or every row if max_size is
+ * 0. Every line is a complete snapshot with the same fields, matching
+ * serializeQueryLogItemJSON. When events is true each row is a line, matching
+ * serializeQueryLogItemAsEventsJSON.
+ *
+ * @param item the snapshot log item.
+ * @param events true to serialize each row as an event.
+ * @param max_size the approximate size of the rows within a line.
+ * @param emit called with each serialized line.
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status serializeSnapshotQueryLogItem(
+    const QueryLogItem& item,
+    bool events,
+    size_t max_size,
+    const std::function<void(const std::string&)>& emit);
+
 /**
  * @brief Interact with the historical on-disk storage for a given query.
  */
@@ -134,13 +178,17 @@ class Query {
    * @param q a ScheduledQuery struct.
    */
   explicit Query(std::string name, const ScheduledQuery& q)
-      : query_(q.query), name_(std::move(name)) {}
+      : query_(q.query),
+        name_(std::move(name)),
+        diff_key_(q.diff_key),
+        diff_buckets_(q.diff_key.empty() ? 0 : q.diff_buckets) {}
 
   /**
    * @brief Deserialize the data in RocksDB into a useful data structure
    *
    * This method retrieves the data from RocksDB and returns the data in a
-   * std::multiset, in-order to apply binary search in diff function.
+   * std::multiset, in-order to apply binary search in diff function. Both
+   * the binary and the JSON encodings of saved results are read.
    *
    * @param results the output QueryDataSet struct.
    *
@@ -149,17 +197,60 @@ class Query {
   Status getPreviousQueryResults(QueryDataSet& results) const;
 
   /**
-   * @brief Save query results json to the database
+   * @brief Save serialized query results to the database
    *
-   * This method saves updated query results json to the database and
-   * updates the epoch associated with the results.
+   * This method saves updated query results to the database and updates the
+   * epoch associated with the results. Results may be serialized as JSON or
+   * with serializeQueryDataBinary. Results saved in buckets are removed.
    *
-   * @param json  Json serialized results string
+   * @param results  Serialized results string
    * @param epoch  Epoch the results are from
    *
    * @return the success or failure of the operation.
    */
-  Status saveQueryResults(const std::string& json, uint64_t epoch) const;
+  Status saveQueryResults(const std::string& results, uint64_t epoch) const;
+
+  /**
+   * @brief Save serialized query results and their row digests
+   *
+   * The digests let the next differential compare rows without reading the
+   * saved results, see getPreviousQueryDigests.
+   *
+   * @param results  Serialized results string
+   * @param digests  Sorted digests of the results
+   * @param epoch  Epoch the results are from
+   *
+   * @return the success or failure of the operation.
+   */
+  Status saveQueryResults(const std::string& results,
+                          const RowDigests& digests,
+                          uint64_t epoch) const;
+
+  /**
+   * @brief Get the sorted row digests of the previous query results.
+   *
+   * Results saved without digests are read once to compute and save them.
+   * The digests of results saved in buckets are merged.
+   *
+   * @param digests the output sorted row digests.
+   *
+   * @return the success or failure of the operation.
+   */
+  Status getPreviousQueryDigests(RowDigests& digests) const;
+
+  /**
+   * @brief Get the previous query results that match a set of digests.
+   *
+   * The saved results are read one row at a time; only the matching rows are
+   * kept. Each digest matches at most one row.
+   *
+   * @param digests the sorted digests of the rows to return.
+   * @param rows the output rows, in sorted order.
+   *
+   * @return the success or failure of the operation.
+   */
+  Status getPreviousQueryRows(const RowDigests& digests,
+                              QueryDataTyped& rows) const;
 
   /**
    * @brief Get the epoch associated with the previous query results.
@@ -220,6 +311,10 @@ class Query {
    * to the database using addNewResults and get back a data structure
    * indicating what rows in the query's results have changed.
    *
+   * When the query has a diff_key its results are saved in buckets, with a
+   * digest for each bucket. Only the buckets whose digest changed are read,
+   * compared and saved again.
+   *
    * @param qd the QueryDataTyped object containing query results to store.
    * @param epoch the epoch associated with QueryData
    * @param counter the output that holds the query execution counter.
@@ -259,6 +354,34 @@ class Query {
    */
   static std::vector<std::string> getStoredQueryNames();
 
+  /// Remove the buckets of a query's results saved with a diff_key.
+  static void deleteResultBuckets(const std::string& name);
+
+  /**
+   * @brief Check if a key of the queries domain belongs to another query.
+   *
+   * The SQL, epoch, counter, digests and buckets of a query's results are
+   * saved under keys made from its name, next to the results themselves.
+   *
+   * @param key a key of the queries domain.
+   * @param keys every key of the queries domain.
+   * @return true if the key is saved for a query whose results are in keys.
+   */
+  static bool isQueryDataKey(const std::string& key,
+                             const std::set<std::string>& keys);
+
+ private:
+  /// Visit the previous results, saved whole or in buckets.
+  Status visitPreviousQueryRows(
+      std::function<void(RowTyped&&)> predicate) const;
+
+  /// The part of addNewResults for results saved in buckets.
+  Status addNewBucketedResults(QueryDataTyped current_qd,
+                               uint64_t current_epoch,
+                               bool new_query_epoch,
+                               uint64_t& counter,
+                               DiffResults& dr) const;
+
  private:
   /// The scheduled query's query string.
   std::string query_;
@@ -266,6 +389,12 @@ class Query {
   /// The scheduled query name.
   std::string name_;
 
+  /// The column splitting the results into buckets, if any.
+  std::string diff_key_;
+
+  /// The number of buckets of the results, compared whole if 0 or 1.
+  size_t diff_buckets_{0};
+
  private:
   FRIEND_TEST(QueryTests, test_private_members);
   FRIEND_TEST(QueryTests, test_add_and_get_current_results);
@@ -274,6 +403,8 @@ class Query {
   FRIEND_TEST(QueryTests, test_get_executions);
   FRIEND_TEST(QueryTests, test_get_query_results);
   FRIEND_TEST(QueryTests, test_query_name_not_found_in_db);
+  FRIEND_TEST(QueryTests, test_previous_query_digests);
+  FRIEND_TEST(QueryTests, test_bucketed_results);
 };
 
 } // namespace osquery
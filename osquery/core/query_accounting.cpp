@@ -0,0 +1,325 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <sstream>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include <osquery/core/query_accounting.h>
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/logger/logger.h>
+#include <osquery/utils/system/env.h>
+
+#ifdef __linux__
+#include <osquery/filesystem/linux/proc.h>
+#endif
+
+namespace osquery {
+
+const std::string kQueryAccountingEnv{"OSQUERY_QUERY_ACCOUNTING"};
+const std::string kWatchdogCulpritEnv{"OSQUERY_WATCHDOG_CULPRIT"};
+
+namespace {
+
+/// Queries running at once in a worker, others are not accounted.
+const size_t kQueryAccountingSlots{64};
+
+/// Longer query names are truncated.
+const size_t kQueryAccountingNameSize{256};
+
+enum QueryAccountingKind : std::uint32_t {
+  kQueryFree = 0,
+  kQueryScheduled = 1,
+  kQueryOther = 2,
+};
+
+} // namespace
+
+/// A running query, the watcher reads it while the worker may write it.
+struct QueryAccountingSlot {
+  /// Odd while the worker writes the slot.
+  std::atomic<std::uint32_t> sequence;
+  std::atomic<std::uint32_t> kind;
+
+  /// The thread running the query.
+  std::atomic<std::int64_t> thread;
+
+  /// The thread CPU time and process resident memory when it started.
+  std::atomic<std::uint64_t> cpu_start_ns;
+  std::atomic<std::uint64_t> memory_start;
+
+  char name[kQueryAccountingNameSize];
+};
+
+namespace {
+
+const size_t kQueryAccountingSize{sizeof(QueryAccountingSlot) *
+                                  kQueryAccountingSlots};
+
+#ifdef __linux__
+std::uint64_t getThreadCpuNanoseconds() {
+  struct timespec ts;
+  if (::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+    return 0;
+  }
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+std::uint64_t getResidentBytes(const std::string& process) {
+  auto rss = getProcRSS(process);
+  return rss.isValue() ? rss.take() : 0;
+}
+
+/// The CPU time of a thread of another process, the same clock as above.
+bool getThreadCpuNanoseconds(pid_t pid,
+                             std::int64_t thread,
+                             std::uint64_t& nanoseconds) {
+  std::string content;
+  auto path = "/proc/" + std::to_string(pid) + "/task/" +
+              std::to_string(thread) + "/schedstat";
+  if (!readFile(path, content, 0, false, false, false, false).ok()) {
+    return false;
+  }
+
+  std::istringstream stream(content);
+  return static_cast<bool>(stream >> nanoseconds);
+}
+#endif
+
+} // namespace
+
+QueryAccounting::QueryAccounting(const std::string& name,
+                                 QueryAccountingSlot* slots)
+    : name_(name), slots_(slots) {}
+
+Status QueryAccounting::create(std::unique_ptr<QueryAccounting>& accounting) {
+#ifndef __linux__
+  return Status::failure("Query accounting is not supported on this platform");
+#else
+  auto name = "/osquery.accounting." + std::to_string(::getpid());
+
+  // A segment left by a previous watcher with the same pid is replaced.
+  ::shm_unlink(name.c_str());
+  auto fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd == -1) {
+    return Status::failure("Cannot create the shared memory object " + name);
+  }
+
+  void* data = MAP_FAILED;
+  if (::ftruncate(fd, static_cast<off_t>(kQueryAccountingSize)) == 0) {
+    data = ::mmap(nullptr,
+                  kQueryAccountingSize,
+                  PROT_READ | PROT_WRITE,
+                  MAP_SHARED,
+                  fd,
+                  0);
+  }
+  ::close(fd);
+
+  if (data == MAP_FAILED) {
+    ::shm_unlink(name.c_str());
+    return Status::failure("Cannot map the shared memory object " + name);
+  }
+
+  accounting.reset(
+      new QueryAccounting(name, static_cast<QueryAccountingSlot*>(data)));
+  return Status::success();
+#endif
+}
+
+Status QueryAccounting::open(const std::string& name,
+                             std::unique_ptr<QueryAccounting>& accounting) {
+#ifndef __linux__
+  return Status::failure("Query accounting is not supported on this platform");
+#else
+  if (name.size() < 2 || name.front() != '/') {
+    return Status::failure("Invalid shared memory name");
+  }
+
+  auto fd = ::shm_open(name.c_str(), O_RDWR, 0);
+  if (fd == -1) {
+    return Status::failure("Cannot open the shared memory object " + name);
+  }
+
+  // The watcher owns the segment, it must not be shared with other users.
+  struct stat info;
+  if (::fstat(fd, &info) != 0 || info.st_uid != ::geteuid() ||
+      static_cast<size_t>(info.st_size) != kQueryAccountingSize) {
+    ::close(fd);
+    return Status::failure("The shared memory object cannot be used: " + name);
+  }
+
+  auto data = ::mmap(nullptr,
+                     kQueryAccountingSize,
+                     PROT_READ | PROT_WRITE,
+                     MAP_SHARED,
+                     fd,
+                     0);
+  ::close(fd);
+
+  if (data == MAP_FAILED) {
+    return Status::failure("Cannot map the shared memory object " + name);
+  }
+
+  accounting.reset(
+      new QueryAccounting(name, static_cast<QueryAccountingSlot*>(data)));
+  return Status::success();
+#endif
+}
+
+QueryAccounting* QueryAccounting::worker() {
+  static std::unique_ptr<QueryAccounting> accounting;
+  static std::once_flag once;
+
+  std::call_once(once, []() {
+    auto name = getEnvVar(kQueryAccountingEnv);
+    auto worker = getEnvVar("OSQUERY_WORKER");
+    if (!name.is_initialized() || !worker.is_initialized()) {
+      return;
+    }
+
+#ifdef __linux__
+    // Processes forked by the worker inherit its environment.
+    if (*worker != std::to_string(::getpid())) {
+      return;
+    }
+#endif
+
+    auto status = open(*name, accounting);
+    if (!status.ok()) {
+      VLOG(1) << "Cannot account the worker queries: " << status.getMessage();
+      return;
+    }
+    accounting->unlink();
+  });
+  return accounting.get();
+}
+
+QueryAccounting::~QueryAccounting() {
+#ifdef __linux__
+  if (slots_ != nullptr) {
+    ::munmap(slots_, kQueryAccountingSize);
+  }
+#endif
+}
+
+void QueryAccounting::unlink() {
+#ifdef __linux__
+  ::shm_unlink(name_.c_str());
+#endif
+}
+
+bool QueryAccounting::begin(const std::string& name,
+                            bool scheduled,
+                            size_t& slot) {
+#ifndef __linux__
+  return false;
+#else
+  auto thread = static_cast<std::int64_t>(::syscall(SYS_gettid));
+  auto cpu_start = getThreadCpuNanoseconds();
+  auto memory_start = getResidentBytes("self");
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (slot = 0; slot < kQueryAccountingSlots; ++slot) {
+    auto& entry = slots_[slot];
+    if (entry.kind.load(std::memory_order_relaxed) != kQueryFree) {
+      continue;
+    }
+
+    entry.sequence.fetch_add(1, std::memory_order_acq_rel);
+    entry.kind = (scheduled) ? kQueryScheduled : kQueryOther;
+    entry.thread = thread;
+    entry.cpu_start_ns = cpu_start;
+    entry.memory_start = memory_start;
+    auto length = std::min(name.size(), kQueryAccountingNameSize - 1);
+    std::memcpy(entry.name, name.data(), length);
+    entry.name[length] = '\0';
+    entry.sequence.fetch_add(1, std::memory_order_release);
+    return true;
+  }
+  return false;
+#endif
+}
+
+void QueryAccounting::end(size_t slot) {
+  if (slot >= kQueryAccountingSlots) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& entry = slots_[slot];
+  entry.sequence.fetch_add(1, std::memory_order_acq_rel);
+  entry.kind = kQueryFree;
+  entry.sequence.fetch_add(1, std::memory_order_release);
+}
+
+std::vector<QueryUsage> QueryAccounting::getRunningQueries(
+    pid_t worker) const {
+  std::vector<QueryUsage> queries;
+#ifdef __linux__
+  auto resident = getResidentBytes(std::to_string(worker));
+  for (size_t slot = 0; slot < kQueryAccountingSlots; ++slot) {
+    const auto& entry = slots_[slot];
+    auto sequence = entry.sequence.load(std::memory_order_acquire);
+    auto kind = entry.kind.load(std::memory_order_relaxed);
+    if ((sequence % 2) != 0 || kind == kQueryFree) {
+      continue;
+    }
+
+    QueryUsage usage;
+    usage.scheduled = (kind == kQueryScheduled);
+    auto thread = entry.thread.load(std::memory_order_relaxed);
+    auto cpu_start = entry.cpu_start_ns.load(std::memory_order_relaxed);
+    auto memory_start = entry.memory_start.load(std::memory_order_relaxed);
+    usage.name.assign(entry.name,
+                      ::strnlen(entry.name, kQueryAccountingNameSize));
+
+    // The slot was reused while it was read.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (entry.sequence.load(std::memory_order_relaxed) != sequence) {
+      continue;
+    }
+
+    std::uint64_t cpu = 0;
+    if (!getThreadCpuNanoseconds(worker, thread, cpu)) {
+      continue;
+    }
+    usage.cpu_ms = (cpu > cpu_start) ? (cpu - cpu_start) / 1000000 : 0;
+    usage.memory_bytes = (resident > memory_start) ? resident - memory_start : 0;
+    queries.push_back(std::move(usage));
+  }
+#endif
+  return queries;
+}
+
+ScopedQueryAccount::ScopedQueryAccount(const std::string& name,
+                                       bool scheduled)
+    : accounting_(QueryAccounting::worker()) {
+  if (accounting_ != nullptr && !accounting_->begin(name, scheduled, slot_)) {
+    accounting_ = nullptr;
+  }
+}
+
+ScopedQueryAccount::~ScopedQueryAccount() {
+  if (accounting_ != nullptr) {
+    accounting_->end(slot_);
+  }
+}
+
+} // namespace osquery
@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// The environment variable naming the accounting segment of a worker.
+extern const std::string kQueryAccountingEnv;
+
+/**
+ * @brief The environment variable naming the query blamed for the last stop.
+ *
+ * The watcher sets it for the next worker after stopping one for exceeding a
+ * resource limit. An empty value blames no query.
+ */
+extern const std::string kWatchdogCulpritEnv;
+
+struct QueryAccountingSlot;
+
+/// The resources used by a query running in the worker.
+struct QueryUsage {
+  std::string name;
+
+  /// Only scheduled queries may be denylisted.
+  bool scheduled{false};
+
+  /// CPU milliseconds used by the thread running the query.
+  std::uint64_t cpu_ms{0};
+
+  /// Growth of the worker resident memory since the query started.
+  std::uint64_t memory_bytes{0};
+};
+
+/**
+ * @brief The queries running in a worker, shared with its watcher.
+ *
+ * The watcher creates a shared memory segment for each worker, the worker
+ * maps it and removes its name. Each running query takes a slot with its
+ * name, thread, and the thread CPU time and process resident memory when it
+ * started. The worker only writes when queries start and end, the watcher
+ * measures the threads itself when it stops the worker, so the usage is
+ * known even if the worker is stuck in the query.
+ *
+ * Only Linux is supported, the watcher reads the thread CPU time from
+ * /proc/<pid>/task/<tid>/schedstat.
+ */
+class QueryAccounting : private boost::noncopyable {
+ public:
+  /// Create and map a new segment, as the watcher.
+  static Status create(std::unique_ptr<QueryAccounting>& accounting);
+
+  /// Map the segment created by the watcher, as the worker.
+  static Status open(const std::string& name,
+                     std::unique_ptr<QueryAccounting>& accounting);
+
+  /**
+   * @brief The segment of this worker.
+   *
+   * It is opened on the first call, if this process is a worker started with
+   * a segment. Returns nullptr otherwise.
+   */
+  static QueryAccounting* worker();
+
+  /// Unmap the segment.
+  ~QueryAccounting();
+
+  /// Remove the name of the segment, the mappings stay valid.
+  void unlink();
+
+  /// The name of the segment.
+  const std::string& name() const {
+    return name_;
+  }
+
+  /**
+   * @brief Take a slot for a query starting on the calling thread.
+   *
+   * @return false if every slot is taken, the query is not accounted.
+   */
+  bool begin(const std::string& name, bool scheduled, size_t& slot);
+
+  /// Free the slot of a query that ended.
+  void end(size_t slot);
+
+  /// Measure the queries running in a worker, as the watcher.
+  std::vector<QueryUsage> getRunningQueries(pid_t worker) const;
+
+ private:
+  QueryAccounting(const std::string& name, QueryAccountingSlot* slots);
+
+ private:
+  std::string name_;
+  QueryAccountingSlot* slots_{nullptr};
+
+  /// Protection around taking slots, only the worker takes them.
+  std::mutex mutex_;
+};
+
+/// Account the query run by the calling thread in the segment of the worker.
+class ScopedQueryAccount : private boost::noncopyable {
+ public:
+  ScopedQueryAccount(const std::string& name, bool scheduled);
+  ~ScopedQueryAccount();
+
+ private:
+  QueryAccounting* accounting_{nullptr};
+  size_t slot_{0};
+};
+
+} // namespace osquery
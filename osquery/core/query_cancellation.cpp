@@ -0,0 +1,42 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/core/query_cancellation.h>
+
+namespace osquery {
+
+thread_local QueryCancellationRef QueryCancellation::kCurrent{nullptr};
+
+void QueryCancellation::cancel(const std::string& reason) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (cancelled_) {
+    return;
+  }
+
+  reason_ = reason;
+  cancelled_ = true;
+  if (db_ != nullptr) {
+    sqlite3_interrupt(db_);
+  }
+}
+
+std::string QueryCancellation::reason() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return reason_;
+}
+
+void QueryCancellation::setDatabase(sqlite3* db) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  db_ = db;
+  if (db_ != nullptr && cancelled_) {
+    sqlite3_interrupt(db_);
+  }
+}
+
+} // namespace osquery
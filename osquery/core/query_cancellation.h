@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <sqlite3.h>
+
+namespace osquery {
+
+/**
+ * @brief A cancellation request shared by a query and its table generators.
+ *
+ * A query that should be stopped early, for example because it exceeded a
+ * resource budget, is cancelled from any thread. The SQLite database running
+ * its statements is interrupted, and table generators observe the request
+ * through QueryContext::isCancelled so they may stop producing rows.
+ */
+class QueryCancellation {
+ public:
+  /// Cancel the query, only the first reason is kept.
+  void cancel(const std::string& reason);
+
+  /// Check if the query was cancelled.
+  bool cancelled() const {
+    return cancelled_;
+  }
+
+  /// The reason given when the query was cancelled.
+  std::string reason() const;
+
+  /**
+   * @brief Interrupt a database when the query is cancelled.
+   *
+   * The database is interrupted immediately if the query is already
+   * cancelled. Set it back to nullptr before the database is released.
+   */
+  void setDatabase(sqlite3* db);
+
+  /**
+   * @brief The cancellation of the query running on this thread.
+   *
+   * This is set by the owner of a query before it runs and copied by the
+   * threads that generate tables on the query's behalf.
+   */
+  static thread_local std::shared_ptr<QueryCancellation> kCurrent;
+
+ private:
+  std::atomic<bool> cancelled_{false};
+
+  /// Protection around the reason and database.
+  mutable std::mutex mutex_;
+
+  std::string reason_;
+
+  sqlite3* db_{nullptr};
+};
+
+using QueryCancellationRef = std::shared_ptr<QueryCancellation>;
+
+} // namespace osquery
@@ -9,10 +9,211 @@
 
 #include "diff_results.h"
 
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
 namespace rj = rapidjson;
 
 namespace osquery {
 
+namespace {
+
+/// Bytes used to encode a single digest.
+const size_t kRowDigestSize = 16;
+
+inline std::uint64_t rotl64(std::uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+inline std::uint64_t fmix64(std::uint64_t k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+  return k;
+}
+
+inline std::uint64_t loadLittleEndian(const unsigned char* bytes) {
+  std::uint64_t value = 0;
+  for (size_t i = 0; i < 8; ++i) {
+    value |= static_cast<std::uint64_t>(bytes[i]) << (i * 8);
+  }
+  return value;
+}
+
+inline void appendLittleEndian(std::string& out, std::uint64_t value) {
+  for (size_t i = 0; i < 8; ++i) {
+    out.push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+  }
+}
+
+/// MurmurHash3 x64 128-bit, read byte-wise so results match on any platform.
+RowDigest murmurHash3(const std::string& data) {
+  const auto* bytes = reinterpret_cast<const unsigned char*>(data.data());
+  const size_t length = data.size();
+  const size_t blocks = length / 16;
+  const std::uint64_t c1 = 0x87c37b91114253d5ULL;
+  const std::uint64_t c2 = 0x4cf5ad432745937fULL;
+
+  std::uint64_t h1 = 0;
+  std::uint64_t h2 = 0;
+  for (size_t i = 0; i < blocks; ++i) {
+    auto k1 = loadLittleEndian(bytes + i * 16);
+    auto k2 = loadLittleEndian(bytes + i * 16 + 8);
+
+    k1 *= c1;
+    k1 = rotl64(k1, 31);
+    k1 *= c2;
+    h1 ^= k1;
+    h1 = rotl64(h1, 27);
+    h1 += h2;
+    h1 = h1 * 5 + 0x52dce729;
+
+    k2 *= c2;
+    k2 = rotl64(k2, 33);
+    k2 *= c1;
+    h2 ^= k2;
+    h2 = rotl64(h2, 31);
+    h2 += h1;
+    h2 = h2 * 5 + 0x38495ab5;
+  }
+
+  const auto* tail = bytes + blocks * 16;
+  const size_t remaining = length & 15;
+  std::uint64_t k1 = 0;
+  std::uint64_t k2 = 0;
+  for (size_t i = remaining; i > 8; --i) {
+    k2 ^= static_cast<std::uint64_t>(tail[i - 1]) << ((i - 9) * 8);
+  }
+  if (remaining > 8) {
+    k2 *= c2;
+    k2 = rotl64(k2, 33);
+    k2 *= c1;
+    h2 ^= k2;
+  }
+  for (size_t i = std::min<size_t>(remaining, 8); i > 0; --i) {
+    k1 ^= static_cast<std::uint64_t>(tail[i - 1]) << ((i - 1) * 8);
+  }
+  if (remaining > 0) {
+    k1 *= c1;
+    k1 = rotl64(k1, 31);
+    k1 *= c2;
+    h1 ^= k1;
+  }
+
+  h1 ^= length;
+  h2 ^= length;
+  h1 += h2;
+  h2 += h1;
+  h1 = fmix64(h1);
+  h2 = fmix64(h2);
+  h1 += h2;
+  h2 += h1;
+
+  RowDigest digest;
+  digest.high = h1;
+  digest.low = h2;
+  return digest;
+}
+
+/// Append a value with its type to the buffer.
+void encodeValue(const RowDataTyped& value, std::string& buffer) {
+  if (auto integer = boost::get<long long>(&value)) {
+    buffer.push_back('i');
+    appendLittleEndian(buffer, static_cast<std::uint64_t>(*integer));
+  } else if (auto number = boost::get<double>(&value)) {
+    // Positive and negative zero compare equal.
+    double normalized = (*number == 0) ? 0.0 : *number;
+    std::uint64_t bits = 0;
+    std::memcpy(&bits, &normalized, sizeof(bits));
+    buffer.push_back('d');
+    appendLittleEndian(buffer, bits);
+  } else {
+    const auto& text = boost::get<std::string>(value);
+    buffer.push_back('s');
+    appendLittleEndian(buffer, text.size());
+    buffer.append(text);
+  }
+}
+
+/// Encode a row without ambiguity, reusing the buffer's allocation.
+void encodeRow(const RowTyped& row, std::string& buffer) {
+  buffer.clear();
+  for (const auto& column : row) {
+    appendLittleEndian(buffer, column.first.size());
+    buffer.append(column.first);
+    encodeValue(column.second, buffer);
+  }
+}
+
+} // namespace
+
+RowDigest digestRow(const RowTyped& row) {
+  std::string buffer;
+  encodeRow(row, buffer);
+  return murmurHash3(buffer);
+}
+
+RowDigests digestQueryData(const QueryDataTyped& qd) {
+  RowDigests digests;
+  digests.reserve(qd.size());
+  std::string buffer;
+  for (const auto& row : qd) {
+    encodeRow(row, buffer);
+    digests.push_back(murmurHash3(buffer));
+  }
+  std::sort(digests.begin(), digests.end());
+  return digests;
+}
+
+RowDigest digestRowDigests(const RowDigests& digests) {
+  return murmurHash3(serializeRowDigests(digests));
+}
+
+size_t rowBucket(const RowTyped& row, const std::string& column, size_t count) {
+  auto it = row.find(column);
+  if (count <= 1 || it == row.end()) {
+    return 0;
+  }
+
+  std::string buffer;
+  encodeValue(it->second, buffer);
+  return static_cast<size_t>(murmurHash3(buffer).high % count);
+}
+
+std::string serializeRowDigests(const RowDigests& digests) {
+  std::string encoded;
+  encoded.reserve(digests.size() * kRowDigestSize);
+  for (const auto& digest : digests) {
+    appendLittleEndian(encoded, digest.high);
+    appendLittleEndian(encoded, digest.low);
+  }
+  return encoded;
+}
+
+Status deserializeRowDigests(const std::string& encoded, RowDigests& digests) {
+  if (encoded.size() % kRowDigestSize != 0) {
+    return Status::failure("Invalid row digests length");
+  }
+
+  const auto* bytes = reinterpret_cast<const unsigned char*>(encoded.data());
+  digests.clear();
+  digests.reserve(encoded.size() / kRowDigestSize);
+  for (size_t i = 0; i < encoded.size(); i += kRowDigestSize) {
+    RowDigest digest;
+    digest.high = loadLittleEndian(bytes + i);
+    digest.low = loadLittleEndian(bytes + i + 8);
+    digests.push_back(digest);
+  }
+
+  if (!std::is_sorted(digests.begin(), digests.end())) {
+    return Status::failure("Row digests are not sorted");
+  }
+  return Status::success();
+}
+
 Status serializeDiffResults(const DiffResults& d,
                             JSON& doc,
                             rj::Document& obj,
@@ -69,4 +270,58 @@ DiffResults diff(QueryDataSet& old, QueryDataTyped& current) {
   return r;
 }
 
+std::vector<size_t> diffAddedRows(const RowDigests& old,
+                                  const QueryDataTyped& current,
+                                  RowDigests& digests,
+                                  RowDigests& removed) {
+  // Order the current rows by digest. The index breaks ties, so the first of
+  // several equal rows is the one matched with a previous row.
+  std::vector<std::pair<RowDigest, size_t>> order;
+  order.reserve(current.size());
+  std::string buffer;
+  for (size_t i = 0; i < current.size(); ++i) {
+    encodeRow(current[i], buffer);
+    order.emplace_back(murmurHash3(buffer), i);
+  }
+  std::sort(order.begin(), order.end());
+
+  digests.clear();
+  digests.reserve(order.size());
+  removed.clear();
+  std::vector<bool> added(current.size(), false);
+  auto previous = old.begin();
+  for (const auto& row : order) {
+    digests.push_back(row.first);
+    while (previous != old.end() && *previous < row.first) {
+      removed.push_back(*previous++);
+    }
+
+    if (previous != old.end() && *previous == row.first) {
+      ++previous;
+    } else {
+      added[row.second] = true;
+    }
+  }
+  removed.insert(removed.end(), previous, old.end());
+
+  std::vector<size_t> indexes;
+  for (size_t i = 0; i < current.size(); ++i) {
+    if (added[i]) {
+      indexes.push_back(i);
+    }
+  }
+  return indexes;
+}
+
+DiffResults diff(const RowDigests& old,
+                 const QueryDataTyped& current,
+                 RowDigests& digests,
+                 RowDigests& removed) {
+  DiffResults r;
+  for (auto i : diffAddedRows(old, current, digests, removed)) {
+    r.added.push_back(current[i]);
+  }
+  return r;
+}
+
 } // namespace osquery
@@ -9,10 +9,63 @@
 
 #pragma once
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
 #include <osquery/core/sql/query_data.h>
 
 namespace osquery {
 
+/**
+ * @brief A 128-bit digest of a typed row's columns and values.
+ *
+ * Digests are stable across runs and platforms so they may be persisted in
+ * place of the rows they describe. Rows that compare equal have equal digests.
+ */
+struct RowDigest {
+  std::uint64_t high{0};
+  std::uint64_t low{0};
+
+  bool operator<(const RowDigest& other) const {
+    return (high < other.high) || (high == other.high && low < other.low);
+  }
+
+  bool operator==(const RowDigest& other) const {
+    return high == other.high && low == other.low;
+  }
+
+  bool operator!=(const RowDigest& other) const {
+    return !(*this == other);
+  }
+};
+
+/// A sorted list of row digests, one for each row of a result set.
+using RowDigests = std::vector<RowDigest>;
+
+/// Compute the digest of a typed row.
+RowDigest digestRow(const RowTyped& row);
+
+/// Compute the sorted digests for every row of a result set.
+RowDigests digestQueryData(const QueryDataTyped& qd);
+
+/// Compute one digest for a sorted list of digests, such as a result set's.
+RowDigest digestRowDigests(const RowDigests& digests);
+
+/**
+ * @brief Pick one of several buckets for a row from a column's value.
+ *
+ * Like digests, buckets are stable across runs. Rows without the column are
+ * in the first bucket.
+ */
+size_t rowBucket(const RowTyped& row, const std::string& column, size_t count);
+
+/// Encode digests as 16 little-endian bytes each.
+std::string serializeRowDigests(const RowDigests& digests);
+
+/// Inverse of serializeRowDigests.
+Status deserializeRowDigests(const std::string& encoded, RowDigests& digests);
+
 /**
  * @brief Data structure representing the difference between the results of
  * two queries
@@ -96,4 +149,36 @@ Status serializeDiffResultsJSON(const DiffResults& d,
  */
 DiffResults diff(QueryDataSet& old_, QueryDataTyped& new_);
 
+/**
+ * @brief Diff the digests of a previous result set against current results.
+ *
+ * Only the digests of the previous rows are needed, so memory grows with the
+ * number of rows rather than their content. Rows of new_ without a matching
+ * previous digest are added, in their original order. The previous rows that
+ * no longer exist are only known by digest; the caller resolves them into the
+ * "removed" rows.
+ *
+ * @param old_ the sorted digests of the "old" set of results.
+ * @param new_ the "new" set of results.
+ * @param digests [output] the sorted digests of new_.
+ * @param removed [output] the sorted digests of removed rows.
+ *
+ * @return a DiffResults object with only the added rows.
+ */
+DiffResults diff(const RowDigests& old_,
+                 const QueryDataTyped& new_,
+                 RowDigests& digests,
+                 RowDigests& removed);
+
+/**
+ * @brief The indexes of the rows of new_ added since old_, in order.
+ *
+ * Like the digest diff, but the added rows are left in new_. The caller may
+ * store new_ first and then move the added rows out of it.
+ */
+std::vector<size_t> diffAddedRows(const RowDigests& old_,
+                                  const QueryDataTyped& new_,
+                                  RowDigests& digests,
+                                  RowDigests& removed);
+
 } // namespace osquery
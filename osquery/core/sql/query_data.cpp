@@ -9,10 +9,109 @@
 
 #include "query_data.h"
 
+#include <limits>
+
 namespace rj = rapidjson;
 
 namespace osquery {
 
+namespace {
+
+/// Parse events for a JSON array of row objects, yielding complete rows.
+class RowVisitHandler
+    : public rj::BaseReaderHandler<rj::UTF8<>, RowVisitHandler> {
+ public:
+  explicit RowVisitHandler(std::function<void(RowTyped&&)> predicate)
+      : predicate_(std::move(predicate)) {}
+
+  bool StartArray() {
+    // Only the outer array holds rows, nested values are ignored.
+    return (depth_++ != 1);
+  }
+
+  bool EndArray(rj::SizeType) {
+    depth_--;
+    return true;
+  }
+
+  bool StartObject() {
+    if (depth_ == 0) {
+      return false;
+    }
+    if (depth_++ == 1) {
+      row_.clear();
+    }
+    return true;
+  }
+
+  bool EndObject(rj::SizeType) {
+    if (--depth_ == 1) {
+      predicate_(std::move(row_));
+      row_ = RowTyped();
+    }
+    return true;
+  }
+
+  bool Key(const char* str, rj::SizeType length, bool) {
+    if (depth_ == 2) {
+      key_.assign(str, length);
+    }
+    return true;
+  }
+
+  bool String(const char* str, rj::SizeType length, bool) {
+    return add(std::string(str, length));
+  }
+
+  bool Int(int i) {
+    return add(static_cast<long long>(i));
+  }
+
+  bool Uint(unsigned i) {
+    return add(static_cast<long long>(i));
+  }
+
+  bool Int64(int64_t i) {
+    return add(static_cast<long long>(i));
+  }
+
+  bool Uint64(uint64_t i) {
+    if (i > static_cast<uint64_t>(std::numeric_limits<long long>::max())) {
+      // Not representable, deserializeRow drops the column as well.
+      return depth_ >= 2;
+    }
+    return add(static_cast<long long>(i));
+  }
+
+  bool Double(double d) {
+    return add(d);
+  }
+
+  bool Default() {
+    // Booleans and nulls are not row values.
+    return depth_ >= 2;
+  }
+
+ private:
+  bool add(RowDataTyped value) {
+    if (depth_ < 2) {
+      return false;
+    }
+    if (depth_ == 2 && !key_.empty()) {
+      row_[key_] = std::move(value);
+    }
+    return true;
+  }
+
+ private:
+  std::function<void(RowTyped&&)> predicate_;
+  size_t depth_{0};
+  std::string key_;
+  RowTyped row_;
+};
+
+} // namespace
+
 Status serializeQueryData(const QueryData& q,
                           const ColumnNames& cols,
                           JSON& doc,
@@ -146,6 +245,17 @@ Status deserializeQueryDataJSON(const std::string& json, QueryDataSet& qd) {
   return deserializeQueryData(doc, qd);
 }
 
+Status visitQueryDataJSON(const std::string& json,
+                          std::function<void(RowTyped&&)> predicate) {
+  RowVisitHandler handler(std::move(predicate));
+  rj::Reader reader;
+  rj::StringStream stream(json.c_str());
+  if (reader.Parse(stream, handler).IsError()) {
+    return Status(1, "Error serializing JSON");
+  }
+  return Status::success();
+}
+
 bool addUniqueRowToQueryData(QueryDataTyped& q, const RowTyped& r) {
   if (std::find(q.begin(), q.end(), r) != q.end()) {
     return false;
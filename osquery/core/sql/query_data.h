@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <functional>
 #include <set>
 #include <vector>
 
@@ -120,6 +121,15 @@ Status deserializeQueryDataJSON(const std::string& json, QueryData& qd);
 /// Inverse of serializeQueryDataJSON, convert a JSON string to QueryDataSet.
 Status deserializeQueryDataJSON(const std::string& json, QueryDataSet& qd);
 
+/**
+ * @brief Visit each row of a JSON string from serializeQueryDataJSON.
+ *
+ * Rows are parsed one at a time, so the result set is never held in memory.
+ * Values are typed as they are by deserializeQueryData.
+ */
+Status visitQueryDataJSON(const std::string& json,
+                          std::function<void(RowTyped&&)> predicate);
+
 /**
  * @brief Add a Row to a QueryData if the Row hasn't appeared in the QueryData
  * already
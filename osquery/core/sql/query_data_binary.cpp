@@ -0,0 +1,303 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "query_data_binary.h"
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include <zstd.h>
+
+namespace osquery {
+
+namespace {
+
+/// The header that begins the binary encoding, followed by the version.
+const std::string kBinaryMagic{"\0OQR", 4};
+
+/// The current binary encoding version.
+const unsigned char kBinaryVersion{1};
+
+/// Header flag set when the body is a zstd frame.
+const unsigned char kBinaryCompressed{1};
+
+/// Bodies smaller than this are not worth compressing.
+const size_t kMinCompressedSize{1024};
+
+/// Refuse to decompress bodies larger than this.
+const unsigned long long kMaxDecompressedSize{1ULL << 32};
+
+const size_t kHeaderSize{6};
+
+enum ValueTag : unsigned char {
+  kTagMissing = 0,
+  kTagInteger = 1,
+  kTagDouble = 2,
+  kTagString = 3,
+};
+
+void putVarint(std::string& out, std::uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+void putString(std::string& out, const std::string& value) {
+  putVarint(out, value.size());
+  out.append(value);
+}
+
+/// Bounds-checked reads from an encoded body.
+class BinaryReader {
+ public:
+  BinaryReader(const char* data, size_t size) : data_(data), size_(size) {}
+
+  bool varint(std::uint64_t& value) {
+    value = 0;
+    for (size_t shift = 0; shift < 64; shift += 7) {
+      if (offset_ >= size_) {
+        return false;
+      }
+      auto byte = static_cast<unsigned char>(data_[offset_++]);
+      value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool byte(unsigned char& value) {
+    if (offset_ >= size_) {
+      return false;
+    }
+    value = static_cast<unsigned char>(data_[offset_++]);
+    return true;
+  }
+
+  bool string(std::string& value) {
+    std::uint64_t length = 0;
+    if (!varint(length) || length > size_ - offset_) {
+      return false;
+    }
+    value.assign(data_ + offset_, static_cast<size_t>(length));
+    offset_ += static_cast<size_t>(length);
+    return true;
+  }
+
+  bool fixed64(std::uint64_t& value) {
+    if (size_ - offset_ < 8) {
+      return false;
+    }
+    value = 0;
+    for (size_t i = 0; i < 8; ++i) {
+      auto byte = static_cast<unsigned char>(data_[offset_ + i]);
+      value |= static_cast<std::uint64_t>(byte) << (i * 8);
+    }
+    offset_ += 8;
+    return true;
+  }
+
+  size_t remaining() const {
+    return size_ - offset_;
+  }
+
+ private:
+  const char* data_{nullptr};
+  size_t size_{0};
+  size_t offset_{0};
+};
+
+void encodeBody(const QueryDataTyped& q, std::string& body) {
+  // The schema is every column name of every row, in name order.
+  std::map<std::string, size_t> schema;
+  for (const auto& row : q) {
+    for (const auto& column : row) {
+      schema.emplace(column.first, 0);
+    }
+  }
+
+  putVarint(body, schema.size());
+  size_t index = 0;
+  for (auto& column : schema) {
+    column.second = index++;
+    putString(body, column.first);
+  }
+
+  putVarint(body, q.size());
+  for (const auto& row : q) {
+    // Row keys and the schema share an order, so one pass fills each row.
+    auto cell = row.begin();
+    for (const auto& column : schema) {
+      if (cell == row.end() || cell->first != column.first) {
+        body.push_back(static_cast<char>(kTagMissing));
+        continue;
+      }
+
+      const auto& value = cell->second;
+      if (auto integer = boost::get<long long>(&value)) {
+        // Zig-zag keeps small negative numbers small.
+        auto number = static_cast<std::uint64_t>(*integer);
+        body.push_back(static_cast<char>(kTagInteger));
+        putVarint(body, (number << 1) ^ (*integer < 0 ? ~0ULL : 0ULL));
+      } else if (auto real = boost::get<double>(&value)) {
+        std::uint64_t bits = 0;
+        std::memcpy(&bits, real, sizeof(bits));
+        body.push_back(static_cast<char>(kTagDouble));
+        for (size_t i = 0; i < 8; ++i) {
+          body.push_back(static_cast<char>((bits >> (i * 8)) & 0xff));
+        }
+      } else {
+        body.push_back(static_cast<char>(kTagString));
+        putString(body, boost::get<std::string>(value));
+      }
+      ++cell;
+    }
+  }
+}
+
+Status decodeBody(const char* data,
+                  size_t size,
+                  const std::function<void(RowTyped&&)>& predicate) {
+  BinaryReader reader(data, size);
+  std::uint64_t columns = 0;
+  if (!reader.varint(columns) || columns > reader.remaining()) {
+    return Status::failure("Invalid binary results schema");
+  }
+
+  std::vector<std::string> names(static_cast<size_t>(columns));
+  for (auto& name : names) {
+    if (!reader.string(name)) {
+      return Status::failure("Invalid binary results column name");
+    }
+  }
+
+  // Every cell takes at least one byte.
+  std::uint64_t rows = 0;
+  if (!reader.varint(rows) ||
+      (columns > 0 && rows > reader.remaining() / columns)) {
+    return Status::failure("Invalid binary results row count");
+  }
+
+  for (std::uint64_t i = 0; i < rows; ++i) {
+    RowTyped row;
+    for (const auto& name : names) {
+      unsigned char tag = kTagMissing;
+      if (!reader.byte(tag)) {
+        return Status::failure("Truncated binary results row");
+      }
+
+      std::uint64_t value = 0;
+      if (tag == kTagMissing) {
+        continue;
+      } else if (tag == kTagInteger && reader.varint(value)) {
+        auto integer = static_cast<long long>(value >> 1);
+        row[name] = (value & 1) ? ~integer : integer;
+      } else if (tag == kTagDouble && reader.fixed64(value)) {
+        double real = 0;
+        std::memcpy(&real, &value, sizeof(real));
+        row[name] = real;
+      } else if (tag == kTagString) {
+        std::string text;
+        if (!reader.string(text)) {
+          return Status::failure("Truncated binary results value");
+        }
+        row[name] = std::move(text);
+      } else {
+        return Status::failure("Invalid binary results value");
+      }
+    }
+    predicate(std::move(row));
+  }
+
+  if (reader.remaining() != 0) {
+    return Status::failure("Unexpected data after binary results");
+  }
+  return Status::success();
+}
+
+} // namespace
+
+bool isQueryDataBinary(const std::string& encoded) {
+  return encoded.compare(0, kBinaryMagic.size(), kBinaryMagic) == 0;
+}
+
+Status serializeQueryDataBinary(const QueryDataTyped& q,
+                                std::string& encoded,
+                                bool compress) {
+  std::string body;
+  encodeBody(q, body);
+
+  encoded = kBinaryMagic;
+  encoded.push_back(static_cast<char>(kBinaryVersion));
+  if (compress && body.size() >= kMinCompressedSize) {
+    std::string frame(ZSTD_compressBound(body.size()), '\0');
+    auto size =
+        ZSTD_compress(&frame[0], frame.size(), body.data(), body.size(), 1);
+    if (!ZSTD_isError(size) && size < body.size()) {
+      frame.resize(size);
+      encoded.push_back(static_cast<char>(kBinaryCompressed));
+      encoded.append(frame);
+      return Status::success();
+    }
+  }
+
+  encoded.push_back(static_cast<char>(0));
+  encoded.append(body);
+  return Status::success();
+}
+
+Status visitQueryDataBinary(const std::string& encoded,
+                            std::function<void(RowTyped&&)> predicate) {
+  if (encoded.size() < kHeaderSize || !isQueryDataBinary(encoded)) {
+    return Status::failure("Invalid binary results header");
+  }
+
+  auto version = static_cast<unsigned char>(encoded[4]);
+  if (version != kBinaryVersion) {
+    return Status::failure("Unsupported binary results version " +
+                           std::to_string(version));
+  }
+
+  auto flags = static_cast<unsigned char>(encoded[5]);
+  const char* body = encoded.data() + kHeaderSize;
+  auto size = encoded.size() - kHeaderSize;
+  if ((flags & kBinaryCompressed) == 0) {
+    return decodeBody(body, size, predicate);
+  }
+
+  auto content_size = ZSTD_getFrameContentSize(body, size);
+  if (content_size == ZSTD_CONTENTSIZE_ERROR ||
+      content_size == ZSTD_CONTENTSIZE_UNKNOWN ||
+      content_size > kMaxDecompressedSize) {
+    return Status::failure("Invalid compressed binary results");
+  }
+
+  std::string decompressed(static_cast<size_t>(content_size), '\0');
+  auto result = ZSTD_decompress(
+      &decompressed[0], decompressed.size(), body, size);
+  if (ZSTD_isError(result) || result != decompressed.size()) {
+    return Status::failure("Cannot decompress binary results");
+  }
+  return decodeBody(decompressed.data(), decompressed.size(), predicate);
+}
+
+Status visitSerializedQueryData(const std::string& encoded,
+                                std::function<void(RowTyped&&)> predicate) {
+  if (isQueryDataBinary(encoded)) {
+    return visitQueryDataBinary(encoded, std::move(predicate));
+  }
+  return visitQueryDataJSON(encoded, std::move(predicate));
+}
+
+} // namespace osquery
@@ -0,0 +1,53 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include <osquery/core/sql/query_data.h>
+
+namespace osquery {
+
+/**
+ * @brief Check if serialized results use the binary encoding.
+ *
+ * The binary encoding begins with a NUL byte, which never begins JSON, so
+ * results saved as JSON are recognized without a separate marker.
+ */
+bool isQueryDataBinary(const std::string& encoded);
+
+/**
+ * @brief Serialize typed results into a compact, versioned binary encoding.
+ *
+ * The encoding starts with a header naming every column once. Each row then
+ * stores a type tag per column followed by a varint, a fixed-size double, or
+ * a length-prefixed string. Values keep their types, like the numeric JSON
+ * encoding.
+ *
+ * @param q the results to serialize.
+ * @param encoded [output] the encoded results.
+ * @param compress compress the rows with zstd when it reduces their size.
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status serializeQueryDataBinary(const QueryDataTyped& q,
+                                std::string& encoded,
+                                bool compress);
+
+/// Visit each row of results from serializeQueryDataBinary.
+Status visitQueryDataBinary(const std::string& encoded,
+                            std::function<void(RowTyped&&)> predicate);
+
+/// Visit each row of results serialized as either binary or JSON.
+Status visitSerializedQueryData(const std::string& encoded,
+                                std::function<void(RowTyped&&)> predicate);
+
+} // namespace osquery
@@ -53,6 +53,18 @@ struct QueryPerformance {
   /// of the latest execution
   std::uint64_t last_memory{0};
 
+  /// Total heap bytes allocated by the executing thread
+  std::uint64_t allocated_bytes{0};
+
+  /// Heap bytes allocated by the latest execution
+  std::uint64_t last_allocated_bytes{0};
+
+  /// Most heap bytes held by the executing thread in a single execution
+  std::uint64_t peak_bytes{0};
+
+  /// Most heap bytes held during the latest execution
+  std::uint64_t last_peak_bytes{0};
+
   /// Total bytes for the query
   std::uint64_t output_size{0};
 };
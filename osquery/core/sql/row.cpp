@@ -19,8 +19,9 @@ Status serializeRow(const Row& r,
                     JSON& doc,
                     rj::Value& obj) {
   if (cols.empty()) {
+    // The keys of the row are unique, append them without searching.
     for (const auto& i : r) {
-      doc.addRef(i.first, i.second, obj);
+      doc.appendRef(i.first, i.second, obj);
     }
   } else {
     for (const auto& c : cols) {
@@ -36,36 +37,37 @@ Status serializeRow(const Row& r,
 
 class DocAppenderVisitor : public boost::static_visitor<> {
  public:
-  DocAppenderVisitor(JSON& dc, rj::Value& ob) : doc(dc), obj(ob) {}
-  void operator()(const std::string& key, const long long& i) const {
-    doc.add(key, i, obj);
+  DocAppenderVisitor(JSON& dc, rj::Value& ob, const std::string& k)
+      : doc(dc), obj(ob), key(k) {}
+
+  void operator()(const long long& i) const {
+    doc.append(key, i, obj);
   }
 
-  void operator()(const std::string& key, const double& d) const {
-    doc.add(key, d, obj);
+  void operator()(const double& d) const {
+    doc.append(key, d, obj);
   }
 
-  void operator()(const std::string& key, const std::string& str) const {
-    doc.addRef(key, str, obj);
+  void operator()(const std::string& str) const {
+    doc.appendRef(key, str, obj);
   }
 
  private:
   JSON& doc;
   rj::Value& obj;
+  const std::string& key;
 };
 
 Status serializeRow(const RowTyped& r,
                     JSON& doc,
                     rj::Value& obj,
                     bool asNumeric) {
-  DocAppenderVisitor visitor(doc, obj);
+  // The keys of the row are unique, append them without searching.
   for (const auto& i : r) {
-    if (asNumeric) {
-      boost::apply_visitor([&doc, &obj, &key = i.first](
-                               auto value) { doc.add(key, value, obj); },
-                           i.second);
+    if (asNumeric || i.second.type() == typeid(std::string)) {
+      boost::apply_visitor(DocAppenderVisitor(doc, obj, i.first), i.second);
     } else {
-      doc.addRef(i.first, castVariant(i.second), obj);
+      doc.appendCopy(i.first, castVariant(i.second), obj);
     }
   }
   return Status::success();
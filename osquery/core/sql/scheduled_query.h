@@ -53,6 +53,12 @@ struct ScheduledQuery : private only_movable {
   /// Set of query options.
   std::map<std::string, bool> options;
 
+  /// Column whose value splits the results into buckets for differentials.
+  std::string diff_key;
+
+  /// Number of buckets, results are compared as a whole with 0 or 1.
+  size_t diff_buckets{0};
+
   ScheduledQuery(const std::string& pack_name,
                  const std::string& name,
                  const std::string& query)
@@ -7,12 +7,24 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+
 #include "table_rows.h"
 
 namespace rj = rapidjson;
 
 namespace osquery {
 
+namespace {
+
+/// The number of rows inspected when estimating the size of rows.
+const size_t kEstimateSampleRows{32};
+
+/// Approximate per-cell overhead of a string map node.
+const size_t kCellOverhead{64};
+
+} // namespace
+
 Status serializeTableRows(const TableRows& rows, JSON& doc, rj::Document& arr) {
   for (const auto& r : rows) {
     auto row_obj = doc.getObject();
@@ -35,4 +47,33 @@ Status serializeTableRowsJSON(const TableRows& rows, std::string& json) {
   return doc.toString(json);
 }
 
+size_t estimateTableRowBytes(const TableRow& row) {
+  size_t bytes = 0;
+  for (const auto& cell : static_cast<Row>(row)) {
+    bytes += cell.first.size() + cell.second.size() + kCellOverhead;
+  }
+  return bytes;
+}
+
+size_t estimateTableRowsBytes(const TableRows& rows) {
+  if (rows.empty()) {
+    return 0;
+  }
+
+  // Walk an evenly spaced sample of rows and extrapolate to the full set.
+  auto stride = std::max<size_t>(1, rows.size() / kEstimateSampleRows);
+  size_t sampled = 0;
+  size_t sample_bytes = 0;
+  for (size_t i = 0; i < rows.size(); i += stride) {
+    if (rows[i] != nullptr) {
+      sample_bytes += estimateTableRowBytes(*rows[i]);
+      sampled++;
+    }
+  }
+  if (sampled == 0) {
+    return 0;
+  }
+  return (sample_bytes / sampled) * rows.size();
+}
+
 } // namespace osquery
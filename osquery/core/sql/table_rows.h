@@ -47,4 +47,10 @@ Status deserializeTableRows(const rapidjson::Value& arr, TableRows& rows);
 /// Inverse of serializeTableRowsJSON, convert a JSON string to TableRows.
 Status deserializeTableRowsJSON(const std::string& json, TableRows& rows);
 
+/// Estimate the resident size of a row's column names and values.
+size_t estimateTableRowBytes(const TableRow& row);
+
+/// Estimate the resident size of a set of rows from a sample of them.
+size_t estimateTableRowsBytes(const TableRows& rows);
+
 } // namespace osquery
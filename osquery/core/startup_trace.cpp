@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+
+#include <osquery/core/startup_trace.h>
+#include <osquery/logger/logger.h>
+
+namespace osquery {
+
+namespace {
+
+std::uint64_t getMillisecondsSince(std::chrono::steady_clock::time_point start) {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+}
+
+} // namespace
+
+StartupTrace::StartupTrace() : start_(std::chrono::steady_clock::now()) {}
+
+StartupTrace& StartupTrace::get() {
+  static StartupTrace trace;
+  return trace;
+}
+
+void StartupTrace::record(const std::string& phase, std::uint64_t ms) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  phases_.emplace_back(phase, ms);
+}
+
+void StartupTrace::ready() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (ready_ms_ != 0) {
+    return;
+  }
+
+  // A process ready within the first millisecond still records it.
+  ready_ms_ = std::max<std::uint64_t>(getMillisecondsSince(start_), 1);
+
+  std::string phases;
+  for (const auto& phase : phases_) {
+    phases += " " + phase.first + "=" + std::to_string(phase.second) + "ms";
+  }
+  VLOG(1) << "osquery was ready " << ready_ms_ << "ms after it started:"
+          << phases;
+}
+
+std::uint64_t StartupTrace::readyTime() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return ready_ms_;
+}
+
+StartupTrace::Phases StartupTrace::phases() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return phases_;
+}
+
+std::string StartupTrace::toJSON() const {
+  // Phase names are identifiers chosen by the callers, none need escaping.
+  std::string json = "{";
+  for (const auto& phase : phases()) {
+    if (json.size() > 1) {
+      json += ",";
+    }
+    json += "\"" + phase.first + "\":" + std::to_string(phase.second);
+  }
+  return json + "}";
+}
+
+ScopedStartupPhase::ScopedStartupPhase(std::string phase)
+    : phase_(std::move(phase)), start_(std::chrono::steady_clock::now()) {}
+
+ScopedStartupPhase::~ScopedStartupPhase() {
+  StartupTrace::get().record(phase_, getMillisecondsSince(start_));
+}
+
+} // namespace osquery
@@ -0,0 +1,77 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+namespace osquery {
+
+/**
+ * @brief The time spent in each phase of the process startup.
+ *
+ * The Initializer times its phases, such as parsing flags, opening the
+ * database, waiting for extensions, or loading the config, until the first
+ * scheduled query runs. Phases may run in parallel, each keeps its own
+ * duration. The trace is reported by the osquery_info table.
+ */
+class StartupTrace : private boost::noncopyable {
+ public:
+  using Phases = std::vector<std::pair<std::string, std::uint64_t>>;
+
+  static StartupTrace& get();
+
+  /// Record the milliseconds spent in a phase, in the order phases end.
+  void record(const std::string& phase, std::uint64_t ms);
+
+  /// Record the time until the process is ready, only the first call counts.
+  void ready();
+
+  /// Milliseconds from the start until the process was ready, 0 if not yet.
+  std::uint64_t readyTime() const;
+
+  Phases phases() const;
+
+  /// The phases as a JSON object of milliseconds, such as {"config":12}.
+  std::string toJSON() const;
+
+ private:
+  StartupTrace();
+
+ private:
+  /// The trace starts when it is first used, the Initializer does it first.
+  const std::chrono::steady_clock::time_point start_;
+
+  /// Protection around the phases and ready time.
+  mutable std::mutex mutex_;
+
+  Phases phases_;
+
+  std::uint64_t ready_ms_{0};
+};
+
+/// Time a startup phase until the end of the scope.
+class ScopedStartupPhase : private boost::noncopyable {
+ public:
+  explicit ScopedStartupPhase(std::string phase);
+  ~ScopedStartupPhase();
+
+ private:
+  std::string phase_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace osquery
@@ -0,0 +1,114 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/core/flags.h>
+#include <osquery/core/table_results_cache.h>
+
+namespace osquery {
+
+FLAG(uint64,
+     table_cache_max_bytes,
+     20 * 1024 * 1024,
+     "Maximum memory used by cached results of cacheable tables");
+
+TableResultsCache& TableResultsCache::get() {
+  static TableResultsCache cache;
+  return cache;
+}
+
+bool TableResultsCache::set(const std::string& table,
+                            uint64_t step,
+                            uint64_t interval,
+                            const TableRows& rows) {
+  auto size = estimateTableRowsBytes(rows);
+
+  WriteLock lock(mutex_);
+  auto it = entries_.find(table);
+  if (it != entries_.end()) {
+    bytes_ -= it->second.bytes;
+    entries_.erase(it);
+  }
+
+  auto budget = static_cast<size_t>(FLAGS_table_cache_max_bytes);
+  if (size > budget) {
+    return false;
+  }
+  evict(size, budget);
+
+  Entry entry;
+  entry.rows.reserve(rows.size());
+  for (const auto& row : rows) {
+    entry.rows.push_back(row->clone());
+  }
+  entry.bytes = size;
+  entry.step = step;
+  entry.interval = interval;
+  bytes_ += size;
+  entries_[table] = std::move(entry);
+  return true;
+}
+
+bool TableResultsCache::isFresh(const std::string& table,
+                                uint64_t step) const {
+  ReadLock lock(mutex_);
+  auto it = entries_.find(table);
+  if (it == entries_.end()) {
+    return false;
+  }
+  return step < it->second.step + it->second.interval;
+}
+
+bool TableResultsCache::get(const std::string& table, TableRows& rows) const {
+  ReadLock lock(mutex_);
+  auto it = entries_.find(table);
+  if (it == entries_.end()) {
+    return false;
+  }
+
+  rows.reserve(rows.size() + it->second.rows.size());
+  for (const auto& row : it->second.rows) {
+    rows.push_back(row->clone());
+  }
+  return true;
+}
+
+void TableResultsCache::remove(const std::string& table) {
+  WriteLock lock(mutex_);
+  auto it = entries_.find(table);
+  if (it != entries_.end()) {
+    bytes_ -= it->second.bytes;
+    entries_.erase(it);
+  }
+}
+
+void TableResultsCache::clear() {
+  WriteLock lock(mutex_);
+  entries_.clear();
+  bytes_ = 0;
+}
+
+size_t TableResultsCache::bytes() const {
+  ReadLock lock(mutex_);
+  return bytes_;
+}
+
+void TableResultsCache::evict(size_t extra, size_t budget) {
+  while (!entries_.empty() && bytes_ + extra > budget) {
+    auto oldest = entries_.begin();
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+      if (it->second.step < oldest->second.step) {
+        oldest = it;
+      }
+    }
+    bytes_ -= oldest->second.bytes;
+    entries_.erase(oldest);
+  }
+}
+
+} // namespace osquery
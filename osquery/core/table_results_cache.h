@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core/sql/table_rows.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+/**
+ * @brief A process-local cache of CACHEABLE table results.
+ *
+ * Results are kept as TableRowHolder objects, a cache hit clones the rows
+ * without any serialization. Each entry records the schedule step and interval
+ * it was generated for, freshness is evaluated against TablePlugin::kCacheStep.
+ *
+ * The total size of all entries is bounded by --table_cache_max_bytes. When
+ * the budget is exceeded the entries generated at the earliest step are
+ * evicted first.
+ */
+class TableResultsCache : private boost::noncopyable {
+ public:
+  /// The process-wide cache used by TablePlugin.
+  static TableResultsCache& get();
+
+  /**
+   * @brief Store a copy of a table's results.
+   *
+   * @return false if the results alone exceed the byte budget.
+   */
+  bool set(const std::string& table,
+           uint64_t step,
+           uint64_t interval,
+           const TableRows& rows);
+
+  /// Check if fresh results exist for a table at the given step.
+  bool isFresh(const std::string& table, uint64_t step) const;
+
+  /// Copy the cached results for a table, returns false on a miss.
+  bool get(const std::string& table, TableRows& rows) const;
+
+  /// Remove a table's results.
+  void remove(const std::string& table);
+
+  /// Remove all results.
+  void clear();
+
+  /// The estimated size in bytes of all cached results.
+  size_t bytes() const;
+
+ private:
+  TableResultsCache() = default;
+
+  /// Evict entries, earliest step first, until the budget allows extra bytes.
+  void evict(size_t extra, size_t budget);
+
+ private:
+  struct Entry {
+    TableRows rows;
+    size_t bytes{0};
+    uint64_t step{0};
+    uint64_t interval{0};
+  };
+
+  /// Cached results keyed by table name.
+  std::map<std::string, Entry> entries_;
+
+  /// Sum of the entry sizes.
+  size_t bytes_{0};
+
+  mutable Mutex mutex_;
+};
+
+} // namespace osquery
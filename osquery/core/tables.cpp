@@ -10,13 +10,15 @@
 #include <osquery/utils/json/json.h>
 
 #include <osquery/core/flags.h>
+#include <osquery/core/table_results_cache.h>
 #include <osquery/core/tables.h>
-#include <osquery/database/database.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/utils/conversions/tryto.h>
 
+#include <algorithm>
 #include <climits>
+#include <limits>
 
 namespace osquery {
 
@@ -24,8 +26,8 @@ FLAG(bool, disable_caching, false, "Disable scheduled query caching");
 
 CREATE_LAZY_REGISTRY(TablePlugin, "table");
 
-uint64_t TablePlugin::kCacheInterval = 0;
-uint64_t TablePlugin::kCacheStep = 0;
+thread_local uint64_t TablePlugin::kCacheInterval = 0;
+thread_local uint64_t TablePlugin::kCacheStep = 0;
 
 #define kDisableRowId "WITHOUT ROWID"
 
@@ -127,6 +129,13 @@ UsedColumnsBitset TablePlugin::usedColumnsToBitset(
   return result;
 }
 
+TableRows TablePlugin::generateLocal(QueryContext& context) {
+  if (!context.colsUsedBitset && context.colsUsed) {
+    context.colsUsedBitset = usedColumnsToBitset(*context.colsUsed);
+  }
+  return generate(context);
+}
+
 Status TablePlugin::call(const PluginRequest& request,
                          PluginResponse& response) {
   response.clear();
@@ -192,6 +201,20 @@ PluginResponse TablePlugin::routeInfo() const {
   response.push_back(
       {{"id", "attributes"},
        {"attributes", INTEGER(static_cast<size_t>(attributes()))}});
+
+  for (const auto& group : columnGroups()) {
+    for (const auto& column : group.second) {
+      response.push_back(
+          {{"id", "columnGroup"}, {"name", column}, {"group", group.first}});
+    }
+  }
+
+  auto hints = estimates();
+  if (hints.rows > 0 || hints.cost > 0) {
+    response.push_back({{"id", "estimates"},
+                        {"rows", BIGINT(hints.rows)},
+                        {"cost", DOUBLE(hints.cost)}});
+  }
   return response;
 }
 
@@ -218,16 +241,23 @@ bool TablePlugin::isCached(uint64_t step, const QueryContext& ctx) const {
   }
 
   // Perform the step comparison first, because it's easy.
-  return (step < last_cached_ + last_interval_ && cacheAllowed(columns(), ctx));
+  // Results may have been evicted from the cache to stay within its budget.
+  {
+    ReadLock lock(cache_mutex_);
+    if (step >= last_cached_ + last_interval_) {
+      return false;
+    }
+  }
+  if (!cacheAllowed(columns(), ctx)) {
+    return false;
+  }
+  return TableResultsCache::get().isFresh(getName(), step);
 }
 
 TableRows TablePlugin::getCache() const {
   VLOG(1) << "Retrieving results from cache for table: " << getName();
-  // Lookup results from database and deserialize.
-  std::string content;
-  getDatabaseValue(kQueries, "cache." + getName(), content);
   TableRows results;
-  deserializeTableRowsJSON(content, results);
+  TableResultsCache::get().get(getName(), results);
   return results;
 }
 
@@ -239,12 +269,11 @@ void TablePlugin::setCache(uint64_t step,
     return;
   }
 
-  // Serialize QueryData and save to database.
-  std::string content;
-  if (serializeTableRowsJSON(results, content)) {
+  // Keep a copy of the rows in memory, there is no serialization.
+  if (TableResultsCache::get().set(getName(), step, interval, results)) {
+    WriteLock lock(cache_mutex_);
     last_cached_ = step;
     last_interval_ = interval;
-    setDatabaseValue(kQueries, "cache." + getName(), content);
   }
 }
 
@@ -408,6 +437,9 @@ bool ConstraintList::matches(const std::string& expr) const {
 template <typename T>
 bool ConstraintList::literal_matches(const T& base_expr) const {
   bool aggregate = true;
+  // Several EQUALS constraints are alternatives, such as an IN list.
+  bool has_equals = false;
+  bool any_equals = false;
   for (size_t i = 0; i < constraints_.size(); ++i) {
     auto constraint_expr = tryTo<T>(constraints_[i].expr);
     if (!constraint_expr) {
@@ -415,7 +447,9 @@ bool ConstraintList::literal_matches(const T& base_expr) const {
       return false;
     }
     if (constraints_[i].op == EQUALS) {
-      aggregate = aggregate && (base_expr == constraint_expr.take());
+      has_equals = true;
+      any_equals = any_equals || (base_expr == constraint_expr.take());
+      continue;
     } else if (constraints_[i].op == GREATER_THAN) {
       aggregate = aggregate && (base_expr > constraint_expr.take());
     } else if (constraints_[i].op == LESS_THAN) {
@@ -433,7 +467,7 @@ bool ConstraintList::literal_matches(const T& base_expr) const {
       return false;
     }
   }
-  return true;
+  return !has_equals || any_equals;
 }
 
 std::set<std::string> ConstraintList::getAll(ConstraintOperator op) const {
@@ -448,9 +482,12 @@ std::set<std::string> ConstraintList::getAll(ConstraintOperator op) const {
 }
 
 template <typename T>
-std::set<T> ConstraintList::getAll(ConstraintOperator /* op */) const {
+std::set<T> ConstraintList::getAll(ConstraintOperator op) const {
   std::set<T> cs;
   for (const auto& item : constraints_) {
+    if (item.op != op) {
+      continue;
+    }
     auto exp = tryTo<T>(item.expr);
     if (exp) {
       cs.insert(exp.take());
@@ -476,6 +513,79 @@ template std::set<long long> ConstraintList::getAll<long long>(
 template std::set<unsigned long long>
     ConstraintList::getAll<unsigned long long>(ConstraintOperator) const;
 
+std::set<std::string> ConstraintList::getPrefixes() const {
+  std::set<std::string> prefixes;
+  for (const auto& constraint : constraints_) {
+    const char* wildcards = nullptr;
+    char any = 0;
+    if (constraint.op == LIKE) {
+      wildcards = "%_";
+      any = '%';
+    } else if (constraint.op == GLOB) {
+      wildcards = "*?[";
+      any = '*';
+    } else {
+      continue;
+    }
+
+    const auto& expr = constraint.expr;
+    auto pos = expr.find_first_of(wildcards);
+    if (pos == std::string::npos || pos == 0 || pos != expr.size() - 1 ||
+        expr[pos] != any) {
+      // Only a literal followed by a single trailing wildcard is a prefix.
+      continue;
+    }
+    prefixes.insert(expr.substr(0, pos));
+  }
+  return prefixes;
+}
+
+template <typename T>
+bool ConstraintList::getRange(T& lower, T& upper) const {
+  for (const auto& constraint : constraints_) {
+    auto exp = tryTo<T>(constraint.expr);
+    if (!exp) {
+      continue;
+    }
+    auto value = exp.take();
+    if (constraint.op == GREATER_THAN) {
+      if (value == std::numeric_limits<T>::max()) {
+        return false;
+      }
+      lower = std::max(lower, static_cast<T>(value + 1));
+    } else if (constraint.op == GREATER_THAN_OR_EQUALS) {
+      lower = std::max(lower, value);
+    } else if (constraint.op == LESS_THAN) {
+      if (value == std::numeric_limits<T>::min()) {
+        return false;
+      }
+      upper = std::min(upper, static_cast<T>(value - 1));
+    } else if (constraint.op == LESS_THAN_OR_EQUALS) {
+      upper = std::min(upper, value);
+    }
+  }
+
+  // EQUALS constraints are treated as alternatives, they bound the range by
+  // their smallest and largest values.
+  auto equals = getAll<T>(EQUALS);
+  if (!equals.empty()) {
+    lower = std::max(lower, *equals.begin());
+    upper = std::min(upper, *equals.rbegin());
+  }
+  return lower <= upper;
+}
+
+/// Explicit getRange for INTEGER.
+template bool ConstraintList::getRange<int>(int&, int&) const;
+
+/// Explicit getRange for BIGINT.
+template bool ConstraintList::getRange<long long>(long long&,
+                                                  long long&) const;
+
+/// Explicit getRange for UNSIGNED_BIGINT.
+template bool ConstraintList::getRange<unsigned long long>(
+    unsigned long long&, unsigned long long&) const;
+
 void ConstraintList::serialize(JSON& doc, rapidjson::Value& obj) const {
   auto expressions = doc.getArray();
   for (const auto& constraint : constraints_) {
@@ -522,6 +632,18 @@ bool QueryContext::isAnyColumnUsed(
   return false;
 }
 
+bool QueryContext::isColumnGroupUsed(const std::string& group) const {
+  if (!colsUsedBitset || table_ == nullptr) {
+    return true;
+  }
+
+  auto it = table_->columnGroups.find(group);
+  if (it == table_->columnGroups.end()) {
+    return true;
+  }
+  return (*colsUsedBitset & it->second).any();
+}
+
 bool QueryContext::defaultColumnsUsed() const {
   auto mask = bitmask<uint64_t>(table_->columns.size());
   return !colsUsedBitset || *colsUsedBitset == mask;
@@ -535,6 +657,10 @@ bool QueryContext::useCache() const {
   return use_cache_;
 }
 
+bool QueryContext::isCancelled() const {
+  return cancellation_ != nullptr && cancellation_->cancelled();
+}
+
 void QueryContext::setCache(const std::string& index,
                             const TableRowHolder& cache) {
   table_->cache[index] = cache->clone();
@@ -11,6 +11,7 @@
 
 #include <bitset>
 #include <map>
+#include <memory>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
@@ -25,7 +26,9 @@
 #include <osquery/core/core.h>
 #include <osquery/core/plugins/plugin.h>
 #include <osquery/core/query.h>
+#include <osquery/core/query_cancellation.h>
 #include <osquery/core/sql/column.h>
+#include <osquery/utils/mutex.h>
 
 #include <gtest/gtest_prod.h>
 
@@ -173,6 +176,21 @@ struct Constraint {
       : op(_op), expr(std::move(_expr)) {}
 };
 
+/**
+ * @brief Optional planner hints about a Table implementation.
+ *
+ * Hints are declared in a table spec using `estimates(rows=, cost=)` and are
+ * used by xBestIndex to describe a full scan of the table. A zero value means
+ * the hint is not provided.
+ */
+struct TableEstimates {
+  /// The expected number of rows returned by a full scan.
+  uint64_t rows{0};
+
+  /// The relative cost of a full scan, an indexed lookup costs 1.
+  double cost{0};
+};
+
 /**
  * @brief Attributes about a Table implementation.
  */
@@ -194,6 +212,9 @@ enum class TableAttributes {
 
   /// (Deprecated) This table's data requires an osquery kernel module.
   KERNEL_REQUIRED = 16,
+
+  /// The results only change with a reboot or when a device is added.
+  BOOT_STABLE = 32,
 };
 
 /// Treat table attributes as a set of flags.
@@ -217,6 +238,9 @@ using ColumnAliasSet = std::map<std::string, std::set<std::string>>;
 /// Alias for a map of alias to canonical column names
 using AliasColumnMap = std::unordered_map<std::string, std::string>;
 
+/// Alias for a map of column group names to the columns in each group.
+using ColumnGroups = std::map<std::string, std::set<std::string>>;
+
 /// Forward declaration of QueryContext for ConstraintList relationships.
 struct QueryContext;
 
@@ -326,6 +350,31 @@ struct ConstraintList : private boost::noncopyable {
   template <typename T>
   std::set<T> getAll(ConstraintOperator op) const;
 
+  /**
+   * @brief Get the literal prefixes of all prefix-only patterns.
+   *
+   * LIKE 'prefix%' and GLOB 'prefix*' constraints restrict a column to values
+   * starting with a literal. Generators may use the prefix to limit their
+   * search, SQLite still applies the full pattern to the generated rows.
+   *
+   * @return A set of literal prefixes, patterns with other wildcards are
+   * not included.
+   */
+  std::set<std::string> getPrefixes() const;
+
+  /**
+   * @brief Get the inclusive range allowed by the comparison constraints.
+   *
+   * Only the <, <=, >, >= and = operators narrow the range. The bounds are
+   * left untouched if the constraints do not limit that side.
+   *
+   * @param lower [output] the smallest allowed value.
+   * @param upper [output] the largest allowed value.
+   * @return false if the constraints cannot be satisfied.
+   */
+  template <typename T>
+  bool getRange(T& lower, T& upper) const;
+
   /// Constraint list accessor, types and operator.
   const std::vector<struct Constraint>& getAll() const {
     return constraints_;
@@ -380,6 +429,33 @@ using UsedColumns = std::unordered_set<std::string>;
 using UsedColumnsBitset = std::bitset<
     std::numeric_limits<decltype(sqlite3_index_info().colUsed)>::digits>;
 
+/**
+ * @brief A memoized xBestIndex decision.
+ *
+ * SQLite plans the same statement shapes repeatedly, for example when a
+ * scheduled query runs. The decision only depends on the constraint terms and
+ * used columns offered to xBestIndex, so it is computed once per shape.
+ */
+struct BestIndexPlan {
+  /// Constraints passed to xFilter, in argv order.
+  ConstraintSet constraints;
+
+  /// The sqlite3_index_info constraint term for each entry in constraints.
+  std::vector<int> terms;
+
+  /// Used columns, with aliases resolved.
+  UsedColumns colsUsed;
+
+  /// Used columns as a bitset, with aliases resolved.
+  UsedColumnsBitset colsUsedBitset;
+
+  /// The estimated cost of the plan.
+  double cost{0};
+
+  /// The estimated rows, or 0 to keep SQLite's default.
+  long long rows{0};
+};
+
 /**
  * @brief osquery table content descriptor.
  *
@@ -414,15 +490,33 @@ struct VirtualTableContent {
    */
   std::map<std::string, size_t> aliases;
 
+  /// Planner hints, retrieved once via the TablePlugin call API.
+  TableEstimates estimates;
+
+  /// Used-column masks for each group of columns sharing a costly source.
+  std::map<std::string, UsedColumnsBitset> columnGroups;
+
   /// Transient set of virtual table access constraints.
   std::unordered_map<size_t, ConstraintSet> constraints;
 
+  /// Transient set of constraint positions whose argument is an IN list.
+  std::unordered_map<size_t, std::unordered_set<size_t>> inConstraints;
+
   /// Transient set of virtual table used columns
   std::unordered_map<size_t, UsedColumns> colsUsed;
 
   /// Transient set of virtual table used columns (as bitmasks)
   std::unordered_map<size_t, UsedColumnsBitset> colsUsedBitsets;
 
+  /// xBestIndex decisions keyed by constraint and used column shape.
+  std::unordered_map<std::string, BestIndexPlan> bestIndexPlans;
+
+  /// Transient rows generated before the query ran, used by the first scan.
+  std::unique_ptr<TableRows> prefetched;
+
+  /// Time spent generating the prefetched rows.
+  uint64_t prefetchTimeUs{0};
+
   /*
    * @brief A table implementation specific query result cache.
    *
@@ -473,7 +567,8 @@ struct QueryContext {
         colsUsed(std::move(other.colsUsed)),
         enable_cache_(other.enable_cache_),
         use_cache_(other.use_cache_),
-        table_(other.table_) {
+        table_(other.table_),
+        cancellation_(std::move(other.cancellation_)) {
     other.enable_cache_ = false;
     other.table_ = nullptr;
   }
@@ -485,6 +580,7 @@ struct QueryContext {
     std::swap(enable_cache_, other.enable_cache_);
     std::swap(use_cache_, other.use_cache_);
     std::swap(table_, other.table_);
+    std::swap(cancellation_, other.cancellation_);
 
     return *this;
   }
@@ -577,6 +673,16 @@ struct QueryContext {
   /// Check if any of the given columns is used by the query
   bool isAnyColumnUsed(std::initializer_list<std::string> colNames) const;
 
+  /**
+   * @brief Check if any column of a table-defined column group is used.
+   *
+   * Tables declare groups for columns that share an expensive source, such as
+   * a file read per row. Generators may skip the source entirely when no
+   * column in its group is projected or constrained. Unknown groups are
+   * treated as used.
+   */
+  bool isColumnGroupUsed(const std::string& group) const;
+
   /// Check if this is a star-select or similar.
   bool defaultColumnsUsed() const;
 
@@ -631,6 +737,14 @@ struct QueryContext {
   /// Check if the query requested use of the warm query cache.
   bool useCache() const;
 
+  /**
+   * @brief Check if the query running this context was cancelled.
+   *
+   * Generators that loop over many expensive items should check this and
+   * stop early, the query fails and its rows are discarded.
+   */
+  bool isCancelled() const;
+
   /// Set the entire cache for an index.
   void setCache(const std::string& index, const TableRowHolder& _cache);
 
@@ -650,6 +764,9 @@ struct QueryContext {
   /// Persistent table content for table caching.
   std::shared_ptr<VirtualTableContent> table_;
 
+  /// The cancellation of the query on the thread creating the context.
+  QueryCancellationRef cancellation_{QueryCancellation::kCurrent};
+
  private:
   friend class TablePlugin;
 };
@@ -707,6 +824,16 @@ class TablePlugin : public Plugin {
     return TableAttributes::NONE;
   }
 
+  /// Return optional planner hints for a full table scan.
+  virtual TableEstimates estimates() const {
+    return TableEstimates();
+  }
+
+  /// Define groups of columns that are populated from the same costly source.
+  virtual ColumnGroups columnGroups() const {
+    return ColumnGroups();
+  }
+
   /**
    * @brief Generate a complete table representation.
    *
@@ -842,6 +969,9 @@ class TablePlugin : public Plugin {
                 const TableRows& results);
 
  private:
+  /// Guards the cache step and interval, queries may run concurrently.
+  mutable Mutex cache_mutex_;
+
   /// The last time in seconds the table data results were saved to cache.
   uint64_t last_cached_{0};
 
@@ -855,11 +985,14 @@ class TablePlugin : public Plugin {
    * Scheduled queries execute within a pseudo-mutex, and each may communicate
    * their scheduled interval to internal TablePlugin implementations. If the
    * table is cachable then the interval can be used to calculate freshness.
+   *
+   * The value is per-thread because scheduled queries may run concurrently.
+   * Threads generating rows on behalf of a query copy it from the query.
    */
-  static uint64_t kCacheInterval;
+  static thread_local uint64_t kCacheInterval;
 
   /// The schedule step, this is the current position of the schedule.
-  static uint64_t kCacheStep;
+  static thread_local uint64_t kCacheStep;
 
  public:
   /**
@@ -877,6 +1010,14 @@ class TablePlugin : public Plugin {
    */
   Status call(const PluginRequest& request, PluginResponse& response) override;
 
+  /**
+   * @brief Generate the rows for a context built within this process.
+   *
+   * This is the typed form of a "generate" call, the context is not serialized
+   * into a request and the rows are not copied into a response.
+   */
+  TableRows generateLocal(QueryContext& context);
+
  public:
   /// Helper data structure transformation methods.
   static void setRequestFromContext(const QueryContext& context,
@@ -904,6 +1045,7 @@ class TablePlugin : public Plugin {
 
   UsedColumnsBitset usedColumnsToBitset(const UsedColumns usedColumns) const;
   friend class RegistryFactory;
+  friend class ExtensionTableCursor;
   FRIEND_TEST(VirtualTableTests, test_tableplugin_columndefinition);
   FRIEND_TEST(VirtualTableTests, test_extension_tableplugin_columndefinition);
   FRIEND_TEST(VirtualTableTests, test_tableplugin_statement);
@@ -0,0 +1,94 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <gtest/gtest.h>
+
+#include <osquery/core/flight_recorder.h>
+#include <osquery/utils/info/platform_type.h>
+
+namespace osquery {
+
+class FlightRecorderTests : public testing::Test {};
+
+TEST_F(FlightRecorderTests, test_records) {
+  std::unique_ptr<FlightRecorder> watcher;
+  auto status = FlightRecorder::create(watcher);
+  if (!isPlatform(PlatformType::TYPE_LINUX)) {
+    EXPECT_FALSE(status.ok());
+    return;
+  }
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  // The worker maps the segment and removes its name.
+  std::unique_ptr<FlightRecorder> worker;
+  status = FlightRecorder::open(watcher->name(), worker);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  worker->unlink();
+  EXPECT_FALSE(FlightRecorder::open(watcher->name(), worker).ok());
+  EXPECT_TRUE(watcher->getRecords().empty());
+
+  worker->record(FlightRecordKind::QueryStart, "pack_test_query", 0);
+  worker->record(FlightRecordKind::TableGenerate, "processes", 25000);
+  worker->record(FlightRecordKind::QueryEnd, "pack_test_query", 30);
+
+  auto records = watcher->getRecords();
+  ASSERT_EQ(records.size(), 3U);
+  EXPECT_EQ(records[0].kind, FlightRecordKind::QueryStart);
+  EXPECT_EQ(records[1].name, "processes");
+  EXPECT_EQ(records[1].value, 25000U);
+  EXPECT_EQ(records[2].kind, FlightRecordKind::QueryEnd);
+  EXPECT_GT(records[2].time_ms, 0U);
+
+  // The oldest records are overwritten, the order is kept.
+  for (size_t i = 0; i < 5000; ++i) {
+    worker->record(FlightRecordKind::Memory, "", i);
+  }
+  records = watcher->getRecords();
+  ASSERT_FALSE(records.empty());
+  EXPECT_LT(records.size(), 5000U);
+  EXPECT_EQ(records.back().value, 4999U);
+  EXPECT_EQ(records.front().value, 5000U - records.size());
+}
+
+TEST_F(FlightRecorderTests, test_summary) {
+  const std::uint64_t mb = 1024 * 1024;
+  std::vector<FlightRecord> records = {
+      {1000, FlightRecordKind::QueryStart, "pack_old_query", 0},
+      {1000, FlightRecordKind::QueryEnd, "pack_old_query", 90000},
+      {100000, FlightRecordKind::Memory, "", 100 * mb},
+      {100000, FlightRecordKind::QueryStart, "pack_stuck_query", 0},
+      {110000, FlightRecordKind::TableGenerate, "processes", 40000},
+      {110000, FlightRecordKind::TableGenerate, "users", 12000},
+      {115000, FlightRecordKind::EventRate, "auditeventpublisher", 2500},
+      {115000, FlightRecordKind::QueryStart, "pack_fast_query", 0},
+      {115000, FlightRecordKind::QueryEnd, "pack_fast_query", 15},
+      {120000, FlightRecordKind::Memory, "", 400 * mb},
+      {125000, FlightRecordKind::Memory, "", 350 * mb},
+  };
+
+  auto summary = summarizeFlightRecords(records, 130000, 60000);
+  EXPECT_EQ(summary,
+            "last 60s; running queries: pack_stuck_query 30000ms; "
+            "slowest queries: pack_fast_query 15ms; "
+            "slowest tables: processes 40ms, users 12ms; "
+            "events per second: auditeventpublisher 2500; "
+            "resident memory: 100MB to 350MB (max 400MB)");
+
+  EXPECT_EQ(summarizeFlightRecords({}, 130000, 60000), "last 60s");
+}
+
+TEST_F(FlightRecorderTests, test_not_a_worker) {
+  // The tests are not started by a watcher.
+  EXPECT_EQ(FlightRecorder::worker(), nullptr);
+  ScopedFlightQuery query("pack_test_query");
+  recordFlight(FlightRecordKind::EventRate, "inotify", 1);
+  recordFlightMemory();
+}
+
+} // namespace osquery
@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <osquery/core/linux/worker_cgroup.h>
+#include <osquery/filesystem/filesystem.h>
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+class WorkerCgroupTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    mount_ = fs::temp_directory_path() /
+             fs::unique_path("osquery.worker-cgroup-test.%%%%.%%%%");
+
+    // A fake hierarchy, the interface files must exist to be written.
+    auto base = mount_ / "osqueryd.service";
+    for (const auto& dir :
+         {base, base / "watcher", base / "worker", base / "other"}) {
+      fs::create_directories(dir);
+      writeFile(dir / "cgroup.procs", "");
+    }
+    writeFile(base / "cgroup.subtree_control", "");
+    writeFile(base / "worker" / "memory.high", "max");
+  }
+
+  void TearDown() override {
+    fs::remove_all(mount_);
+  }
+
+  void writeFile(const fs::path& path, const std::string& content) {
+    ASSERT_TRUE(writeTextFile(path, content, 0644, PF_CREATE_ALWAYS | PF_WRITE)
+                    .ok());
+  }
+
+  std::string readContent(const fs::path& path) {
+    std::string content;
+    EXPECT_TRUE(readFile(path, content).ok());
+    return content;
+  }
+
+ protected:
+  fs::path mount_;
+};
+
+TEST_F(WorkerCgroupTests, test_create) {
+  std::unique_ptr<WorkerCgroup> cgroup;
+  EXPECT_FALSE(WorkerCgroup::create(mount_, "/missing.service", cgroup).ok());
+
+  auto status = WorkerCgroup::create(mount_, "/osqueryd.service", cgroup);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ(cgroup->workerPath(), mount_ / "osqueryd.service" / "worker");
+
+  auto base = mount_ / "osqueryd.service";
+  EXPECT_EQ(readContent(base / "watcher" / "cgroup.procs"),
+            std::to_string(::getpid()));
+  EXPECT_EQ(readContent(base / "cgroup.subtree_control"), "+memory");
+
+  // A watcher started again in its leaf keeps the same worker cgroup.
+  status = WorkerCgroup::create(mount_, "/osqueryd.service/watcher", cgroup);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ(cgroup->workerPath(), base / "worker");
+}
+
+TEST_F(WorkerCgroupTests, test_update_row) {
+  std::unique_ptr<WorkerCgroup> cgroup;
+  ASSERT_TRUE(WorkerCgroup::create(mount_, "/osqueryd.service", cgroup).ok());
+
+  auto worker = mount_ / "osqueryd.service" / "worker";
+  // The CPU times are required, a worker cannot be added without them.
+  EXPECT_FALSE(cgroup->addWorker(1234).ok());
+
+  writeFile(worker / "cpu.stat",
+            "usage_usec 3000000\nuser_usec 2000000\nsystem_usec 1000000\n");
+  writeFile(worker / "memory.events", "low 0\nhigh 2\nmax 0\noom_kill 0\n");
+  ASSERT_TRUE(cgroup->addWorker(1234).ok());
+  EXPECT_EQ(readContent(worker / "cgroup.procs"), "1234");
+
+  writeFile(worker / "cpu.stat",
+            "usage_usec 4500000\nuser_usec 3000000\nsystem_usec 1500000\n");
+
+  // Without the memory controller the resident size is kept.
+  Row row = {{"parent", "1"}, {"resident_size", "100"}};
+  ASSERT_TRUE(cgroup->updateRow(row).ok());
+  EXPECT_EQ(row["user_time"], "1000");
+  EXPECT_EQ(row["system_time"], "500");
+  EXPECT_EQ(row["resident_size"], "100");
+  EXPECT_EQ(row["parent"], "1");
+
+  writeFile(worker / "memory.stat", "anon 4096\nfile 8192\n");
+  writeFile(worker / "memory.events", "low 0\nhigh 5\nmax 0\noom_kill 1\n");
+  ASSERT_TRUE(cgroup->updateRow(row).ok());
+  EXPECT_EQ(row["resident_size"], "4096");
+
+  ASSERT_TRUE(cgroup->setMemoryHigh(1024 * 1024).ok());
+  EXPECT_EQ(readContent(worker / "memory.high"), "1048576");
+}
+
+} // namespace osquery
@@ -0,0 +1,77 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+#include <osquery/core/query_accounting.h>
+#include <osquery/process/process.h>
+#include <osquery/utils/info/platform_type.h>
+
+namespace osquery {
+
+class QueryAccountingTests : public testing::Test {};
+
+TEST_F(QueryAccountingTests, test_running_queries) {
+  std::unique_ptr<QueryAccounting> watcher;
+  auto status = QueryAccounting::create(watcher);
+  if (!isPlatform(PlatformType::TYPE_LINUX)) {
+    EXPECT_FALSE(status.ok());
+    return;
+  }
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  // The worker maps the segment and removes its name.
+  std::unique_ptr<QueryAccounting> worker;
+  status = QueryAccounting::open(watcher->name(), worker);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  worker->unlink();
+  EXPECT_FALSE(QueryAccounting::open(watcher->name(), worker).ok());
+
+  auto pid = PlatformProcess::getCurrentPid();
+  EXPECT_TRUE(watcher->getRunningQueries(pid).empty());
+
+  size_t scheduled = 0;
+  size_t distributed = 0;
+  ASSERT_TRUE(worker->begin("pack_test_busy", true, scheduled));
+  ASSERT_TRUE(worker->begin("distributed", false, distributed));
+  EXPECT_NE(scheduled, distributed);
+
+  // Use some CPU time on this thread.
+  auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(50);
+  volatile size_t spins = 0;
+  while (std::chrono::steady_clock::now() < end) {
+    spins = spins + 1;
+  }
+
+  auto queries = watcher->getRunningQueries(pid);
+  ASSERT_EQ(queries.size(), 2U);
+  EXPECT_EQ(queries[0].name, "pack_test_busy");
+  EXPECT_TRUE(queries[0].scheduled);
+  EXPECT_GE(queries[0].cpu_ms, 10U);
+  EXPECT_EQ(queries[1].name, "distributed");
+  EXPECT_FALSE(queries[1].scheduled);
+
+  worker->end(scheduled);
+  queries = watcher->getRunningQueries(pid);
+  ASSERT_EQ(queries.size(), 1U);
+  EXPECT_EQ(queries[0].name, "distributed");
+
+  worker->end(distributed);
+  EXPECT_TRUE(watcher->getRunningQueries(pid).empty());
+}
+
+TEST_F(QueryAccountingTests, test_not_a_worker) {
+  // The tests are not started by a watcher.
+  EXPECT_EQ(QueryAccounting::worker(), nullptr);
+  ScopedQueryAccount account("pack_test_query", true);
+}
+
+} // namespace osquery
@@ -10,12 +10,14 @@
 #include <algorithm>
 #include <ctime>
 #include <deque>
+#include <map>
 
 #include <boost/filesystem/operations.hpp>
 
 #include <gtest/gtest.h>
 
 #include <osquery/core/query.h>
+#include <osquery/core/sql/query_data_binary.h>
 #include <osquery/core/sql/scheduled_query.h>
 #include <osquery/core/system.h>
 #include <osquery/sql/tests/sql_test_utils.h>
@@ -170,6 +172,139 @@ TEST_F(QueryTests, test_get_query_results) {
   EXPECT_TRUE(status.ok());
 }
 
+TEST_F(QueryTests, test_previous_query_digests) {
+  // Results saved without digests are digested from the saved rows.
+  auto encoded_qd = getSerializedQueryDataJSON();
+  auto query = getOsqueryScheduledQuery();
+  auto cf = Query("digested_query", query);
+  auto status = cf.saveQueryResults(encoded_qd.first, 0);
+  ASSERT_TRUE(status.ok());
+
+  RowDigests digests;
+  status = cf.getPreviousQueryDigests(digests);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(digests, digestQueryData(encoded_qd.second));
+
+  std::string raw;
+  status = getDatabaseValue(kQueries, "digested_querydigests", raw);
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(raw, serializeRowDigests(digests));
+
+  // Only the rows matching the requested digests are read back.
+  QueryDataTyped rows;
+  RowDigests first = {digestRow(encoded_qd.second.front())};
+  status = cf.getPreviousQueryRows(first, rows);
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(rows.size(), 1U);
+  EXPECT_EQ(rows.front(), encoded_qd.second.front());
+
+  // Saving results without digests drops the stale digests.
+  status = cf.saveQueryResults("[]", 0);
+  ASSERT_TRUE(status.ok());
+  status = cf.getPreviousQueryDigests(digests);
+  ASSERT_TRUE(status.ok());
+  EXPECT_TRUE(digests.empty());
+}
+
+TEST_F(QueryTests, test_migrate_json_results) {
+  // Results saved as JSON are read, then replaced by the binary encoding.
+  auto encoded_qd = getSerializedQueryDataJSON();
+  auto query = getOsqueryScheduledQuery();
+  auto cf = Query("json_results_query", query);
+  uint64_t counter = 0;
+  DiffResults dr;
+  auto status = cf.addNewResults(encoded_qd.second, 0, counter, dr);
+  ASSERT_TRUE(status.ok());
+  status = cf.saveQueryResults(encoded_qd.first, 0);
+  ASSERT_TRUE(status.ok());
+
+  status = cf.addNewResults(encoded_qd.second, 0, counter, dr);
+  ASSERT_TRUE(status.ok());
+  EXPECT_TRUE(dr.hasNoResults());
+
+  auto current = encoded_qd.second;
+  current.pop_back();
+  status = cf.addNewResults(current, 0, counter, dr);
+  ASSERT_TRUE(status.ok());
+  EXPECT_TRUE(dr.added.empty());
+  EXPECT_EQ(dr.removed, QueryDataTyped({encoded_qd.second.back()}));
+
+  std::string raw;
+  getDatabaseValue(kQueries, "json_results_query", raw);
+  EXPECT_TRUE(isQueryDataBinary(raw));
+
+  QueryDataSet previous;
+  status = cf.getPreviousQueryResults(previous);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(previous, QueryDataSet(current.begin(), current.end()));
+}
+
+TEST_F(QueryTests, test_bucketed_results) {
+  auto query = getOsqueryScheduledQuery();
+  query.diff_key = "path";
+  query.diff_buckets = 8;
+  auto cf = Query("bucketed_query", query);
+
+  QueryDataTyped results;
+  for (long long i = 0; i < 100; i++) {
+    results.push_back({{"path", "/usr/bin/" + std::to_string(i)}, {"size", i}});
+  }
+
+  uint64_t counter = 0;
+  DiffResults dr;
+  auto status = cf.addNewResults(results, 0, counter, dr);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(dr.added.size(), 100U);
+  EXPECT_EQ(counter, 0U);
+
+  std::string raw;
+  EXPECT_TRUE(getDatabaseValue(kQueries, "bucketed_querybuckets", raw).ok());
+
+  // Only the bucket of the changed row is read and saved again.
+  auto changed = results;
+  changed[5]["size"] = 1000LL;
+  auto bucket = rowBucket(changed[5], "path", 8);
+  std::map<size_t, std::string> saved;
+  for (size_t i = 0; i < 8; i++) {
+    getDatabaseValue(
+        kQueries, "bucketed_querybucket." + std::to_string(i), saved[i]);
+  }
+
+  dr = DiffResults();
+  status = cf.addNewResults(changed, 0, counter, dr);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(dr.added, QueryDataTyped({changed[5]}));
+  EXPECT_EQ(dr.removed, QueryDataTyped({results[5]}));
+  EXPECT_EQ(counter, 1U);
+  for (size_t i = 0; i < 8; i++) {
+    auto key = "bucketed_querybucket." + std::to_string(i);
+    getDatabaseValue(kQueries, key, raw);
+    EXPECT_EQ(raw == saved[i], i != bucket);
+  }
+
+  dr = DiffResults();
+  status = cf.addNewResults(changed, 0, counter, dr);
+  ASSERT_TRUE(status.ok());
+  EXPECT_TRUE(dr.hasNoResults());
+  EXPECT_EQ(counter, 1U);
+
+  QueryDataSet previous;
+  status = cf.getPreviousQueryResults(previous);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(previous, QueryDataSet(changed.begin(), changed.end()));
+
+  // Changing the buckets, or not using them, compares the whole results.
+  query.diff_buckets = 0;
+  auto whole = Query("bucketed_query", query);
+  changed.pop_back();
+  dr = DiffResults();
+  status = whole.addNewResults(changed, 0, counter, dr);
+  ASSERT_TRUE(status.ok());
+  EXPECT_TRUE(dr.added.empty());
+  EXPECT_EQ(dr.removed, QueryDataTyped({results.back()}));
+  EXPECT_FALSE(getDatabaseValue(kQueries, "bucketed_querybuckets", raw).ok());
+}
+
 TEST_F(QueryTests, test_query_name_not_found_in_db) {
   // Try to retrieve results from a query that has not executed.
   QueryDataSet previous_qd;
@@ -237,6 +372,31 @@ TEST_F(QueryTests, test_get_stored_query_names) {
   EXPECT_NE(in_vector, names.end());
 }
 
+TEST_F(QueryTests, test_is_query_data_key) {
+  std::set<std::string> keys = {"pack_a_query",
+                                "pack_a_queryepoch",
+                                "pack_a_querycounter",
+                                "pack_a_querydigests",
+                                "pack_a_querybuckets",
+                                "pack_a_querybucket.0",
+                                "pack_a_querybucketdigests.12",
+                                "query.pack_a_query",
+                                "pack_b_queryepoch"};
+
+  EXPECT_FALSE(Query::isQueryDataKey("pack_a_query", keys));
+  EXPECT_TRUE(Query::isQueryDataKey("pack_a_queryepoch", keys));
+  EXPECT_TRUE(Query::isQueryDataKey("pack_a_querycounter", keys));
+  EXPECT_TRUE(Query::isQueryDataKey("pack_a_querydigests", keys));
+  EXPECT_TRUE(Query::isQueryDataKey("pack_a_querybuckets", keys));
+  EXPECT_TRUE(Query::isQueryDataKey("pack_a_querybucket.0", keys));
+  EXPECT_TRUE(Query::isQueryDataKey("pack_a_querybucketdigests.12", keys));
+  EXPECT_TRUE(Query::isQueryDataKey("query.pack_a_query", keys));
+
+  // Without the results of the query, the key is a query name.
+  EXPECT_FALSE(Query::isQueryDataKey("pack_b_queryepoch", keys));
+  EXPECT_FALSE(Query::isQueryDataKey("pack_a_querybucket.", keys));
+}
+
 TEST_F(QueryTests, test_is_snapshot_query) {
   auto sq = ScheduledQuery();
 
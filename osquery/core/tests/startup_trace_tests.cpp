@@ -0,0 +1,55 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <chrono>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <osquery/core/startup_trace.h>
+
+namespace osquery {
+
+class StartupTraceTests : public testing::Test {};
+
+TEST_F(StartupTraceTests, test_phases) {
+  auto& trace = StartupTrace::get();
+  trace.record("test_phase", 5);
+  {
+    ScopedStartupPhase phase("test_scoped_phase");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+
+  // Other tests may have recorded phases before.
+  auto phases = trace.phases();
+  ASSERT_GE(phases.size(), 2U);
+  EXPECT_EQ(phases[phases.size() - 2].first, "test_phase");
+  EXPECT_EQ(phases[phases.size() - 2].second, 5U);
+  EXPECT_EQ(phases.back().first, "test_scoped_phase");
+  EXPECT_GE(phases.back().second, 20U);
+
+  auto json = trace.toJSON();
+  EXPECT_EQ(json.front(), '{');
+  EXPECT_EQ(json.back(), '}');
+  EXPECT_NE(json.find("\"test_phase\":5"), std::string::npos);
+}
+
+TEST_F(StartupTraceTests, test_ready) {
+  auto& trace = StartupTrace::get();
+  trace.ready();
+  auto ready = trace.readyTime();
+  EXPECT_GT(ready, 0U);
+
+  // Only the first scheduled query ends the startup.
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  trace.ready();
+  EXPECT_EQ(trace.readyTime(), ready);
+}
+
+} // namespace osquery
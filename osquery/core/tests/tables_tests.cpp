@@ -11,12 +11,16 @@
 #include <gflags/gflags.h>
 
 #include <osquery/core/system.h>
+#include <osquery/core/table_results_cache.h>
 #include <osquery/core/tables.h>
 #include <osquery/database/database.h>
 #include <osquery/registry/registry.h>
+#include <osquery/sql/dynamic_table_row.h>
 
 namespace osquery {
 
+DECLARE_uint64(table_cache_max_bytes);
+
 class TablesTests : public testing::Test {
 protected:
  void SetUp() {
@@ -116,6 +120,57 @@ TEST_F(TablesTests, test_constraint_matching) {
   EXPECT_TRUE(cl3.matches(1));
 }
 
+TEST_F(TablesTests, test_constraint_equals_alternatives) {
+  struct ConstraintList cl;
+  cl.affinity = INTEGER_TYPE;
+  cl.add(Constraint(EQUALS, "1"));
+  cl.add(Constraint(EQUALS, "3"));
+
+  // Multiple EQUALS constraints, such as from an IN list, match any value.
+  EXPECT_TRUE(cl.matches(1));
+  EXPECT_TRUE(cl.matches(3));
+  EXPECT_FALSE(cl.matches(2));
+
+  // Other operators still apply to every value.
+  cl.add(Constraint(GREATER_THAN, "2"));
+  EXPECT_FALSE(cl.matches(1));
+  EXPECT_TRUE(cl.matches(3));
+
+  auto equals = cl.getAll<int>(EQUALS);
+  EXPECT_EQ(equals.size(), 2U);
+}
+
+TEST_F(TablesTests, test_constraint_prefixes) {
+  struct ConstraintList cl;
+  cl.add(Constraint(LIKE, "/usr/%"));
+  cl.add(Constraint(GLOB, "/etc/*"));
+  cl.add(Constraint(LIKE, "/tmp/%/file"));
+  cl.add(Constraint(LIKE, "%"));
+  cl.add(Constraint(LIKE, "/var/_%"));
+  cl.add(Constraint(EQUALS, "/opt/%"));
+
+  auto prefixes = cl.getPrefixes();
+  ASSERT_EQ(prefixes.size(), 2U);
+  EXPECT_EQ(prefixes.count("/usr/"), 1U);
+  EXPECT_EQ(prefixes.count("/etc/"), 1U);
+}
+
+TEST_F(TablesTests, test_constraint_range) {
+  struct ConstraintList cl;
+  cl.affinity = BIGINT_TYPE;
+  cl.add(Constraint(GREATER_THAN, "10"));
+  cl.add(Constraint(LESS_THAN_OR_EQUALS, "20"));
+
+  long long lower = 0;
+  long long upper = 100;
+  EXPECT_TRUE(cl.getRange(lower, upper));
+  EXPECT_EQ(lower, 11);
+  EXPECT_EQ(upper, 20);
+
+  cl.add(Constraint(LESS_THAN, "5"));
+  EXPECT_FALSE(cl.getRange(lower, upper));
+}
+
 TEST_F(TablesTests, test_constraint_map) {
   ConstraintMap cm;
 
@@ -189,4 +244,66 @@ TEST_F(TablesTests, test_caching) {
   EXPECT_TRUE(test.testIsCached(6));
   EXPECT_FALSE(test.testIsCached(7));
 }
+
+TEST_F(TablesTests, test_table_results_cache) {
+  auto& cache = TableResultsCache::get();
+  cache.clear();
+
+  TableRows rows;
+  for (size_t i = 0; i < 10; i++) {
+    auto r = make_table_row();
+    r["name"] = "row" + std::to_string(i);
+    rows.push_back(std::move(r));
+  }
+
+  // Results are fresh for the interval following the step they were set at.
+  EXPECT_TRUE(cache.set("first", 1, 5, rows));
+  EXPECT_TRUE(cache.isFresh("first", 5));
+  EXPECT_FALSE(cache.isFresh("first", 6));
+  EXPECT_FALSE(cache.isFresh("missing", 1));
+
+  // A hit returns copies of the cached rows.
+  TableRows results;
+  EXPECT_TRUE(cache.get("first", results));
+  ASSERT_EQ(results.size(), rows.size());
+  EXPECT_EQ(static_cast<Row>(*results[3])["name"], "row3");
+  EXPECT_EQ(cache.bytes(), estimateTableRowsBytes(rows));
+
+  // Shrink the budget so only one set of results fits.
+  auto max_bytes = FLAGS_table_cache_max_bytes;
+  FLAGS_table_cache_max_bytes = cache.bytes() + cache.bytes() / 2;
+  EXPECT_TRUE(cache.set("second", 2, 5, rows));
+  EXPECT_FALSE(cache.isFresh("first", 2));
+  EXPECT_TRUE(cache.isFresh("second", 2));
+
+  // Results larger than the whole budget are never stored.
+  FLAGS_table_cache_max_bytes = 1;
+  EXPECT_FALSE(cache.set("second", 3, 5, rows));
+  EXPECT_FALSE(cache.isFresh("second", 3));
+  EXPECT_EQ(cache.bytes(), 0U);
+
+  FLAGS_table_cache_max_bytes = max_bytes;
+  cache.clear();
+}
+
+TEST_F(TablesTests, test_query_context_cancellation) {
+  QueryContext ephemeral;
+  EXPECT_FALSE(ephemeral.isCancelled());
+
+  // Contexts share the cancellation of the query on the creating thread.
+  auto cancellation = std::make_shared<QueryCancellation>();
+  QueryCancellation::kCurrent = cancellation;
+  QueryContext context;
+  QueryCancellation::kCurrent = nullptr;
+  EXPECT_FALSE(context.isCancelled());
+
+  cancellation->cancel("budget");
+  cancellation->cancel("ignored");
+  EXPECT_TRUE(context.isCancelled());
+  EXPECT_EQ("budget", cancellation->reason());
+
+  // The cancellation moves with the context.
+  QueryContext moved(std::move(context));
+  EXPECT_TRUE(moved.isCancelled());
+}
 }
@@ -25,6 +25,7 @@ using namespace testing;
 namespace osquery {
 
 DECLARE_uint64(watchdog_delay);
+DECLARE_uint32(worker_shards);
 
 class WatcherTests : public testing::Test {
  protected:
@@ -201,6 +202,9 @@ class MockWithWatchWatcherRunner : public WatcherRunner {
 
   /// The state machine is starting, and is forking the managed 'worker'.
   MOCK_METHOD0(createWorker, void());
+
+  /// The state machine is forking the worker of a schedule shard.
+  MOCK_METHOD1(createShard, void(size_t shard));
 };
 
 TEST_F(WatcherTests, test_watcherrunner_loop) {
@@ -238,6 +242,24 @@ TEST_F(WatcherTests, test_watcherrunner_loop_failure) {
   runner.start();
 }
 
+TEST_F(WatcherTests, test_watcherrunner_loop_shards) {
+  auto watcher = std::make_shared<Watcher>();
+  MockWithWatchWatcherRunner runner(0, nullptr, true, watcher);
+  runner.runOnce();
+
+  // The primary worker is healthy, the other shards have not started.
+  auto worker_shards = FLAGS_worker_shards;
+  FLAGS_worker_shards = 3;
+  EXPECT_CALL(runner, watch(_)).WillOnce(Return(true));
+  EXPECT_CALL(runner, createWorker()).Times(0);
+  EXPECT_CALL(runner, createShard(1)).Times(1);
+  EXPECT_CALL(runner, createShard(2)).Times(1);
+  EXPECT_CALL(runner, isWatcherHealthy(_, _)).WillOnce(Return(Status(0)));
+
+  runner.start();
+  FLAGS_worker_shards = worker_shards;
+}
+
 TEST_F(WatcherTests, test_watcherrunner_loop_disabled) {
   // Now construct without using a worker.
   auto watcher = std::make_shared<Watcher>();
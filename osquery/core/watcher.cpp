@@ -17,10 +17,16 @@
 #include <sys/wait.h>
 #endif
 
+#ifdef __linux__
+#include <osquery/core/linux/worker_cgroup.h>
+#endif
+
 #include <boost/filesystem.hpp>
 #include <boost/thread.hpp>
 
 #include <osquery/config/config.h>
+#include <osquery/core/flight_recorder.h>
+#include <osquery/core/query_accounting.h>
 #include <osquery/core/shutdown.h>
 #include <osquery/core/sql/query_data.h>
 #include <osquery/core/watcher.h>
@@ -35,6 +41,7 @@
 #include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/info/platform_type.h>
 #include <osquery/utils/info/tool_type.h>
+#include <osquery/utils/system/env.h>
 #include <osquery/utils/system/time.h>
 
 namespace fs = boost::filesystem;
@@ -83,6 +90,13 @@ const WatchdogLimitMap kWatchdogLimits = {
 
 /// Set to true if at least one extension is watched.
 std::atomic<bool> kExtensionsWatched{false};
+
+/// The status codes of a child exceeding its CPU or memory limit.
+const int kCyclesLimitExceeded{1};
+const int kMemoryLimitExceeded{2};
+
+/// The flight recorder summary covers the last five minutes of the worker.
+const uint64_t kFlightWindowMs{5 * 60 * 1000};
 } // namespace
 
 CLI_FLAG(int32,
@@ -128,7 +142,48 @@ CLI_FLAG(uint64,
 
 CLI_FLAG(bool, disable_watchdog, false, "Disable userland watchdog process");
 
+CLI_FLAG(bool,
+         watchdog_cgroup,
+         false,
+         "Account the worker and its children in a cgroup v2 (Linux only)");
+
+CLI_FLAG(bool,
+         watchdog_query_accounting,
+         true,
+         "Blame the query that used the most resources when the watchdog "
+         "stops the worker (Linux only)");
+
+CLI_FLAG(bool,
+         watchdog_flight_recorder,
+         true,
+         "Log the recent activity of the worker when it is stopped or exits "
+         "abnormally (Linux only)");
+
+CLI_FLAG(bool,
+         watchdog_cgroup_memory_high,
+         false,
+         "Throttle the worker cgroup memory above the watchdog memory limit");
+
+CLI_FLAG(uint32,
+         worker_shards,
+         1,
+         "Number of worker processes the schedule is partitioned across");
+
 DECLARE_uint64(alarm_timeout);
+DECLARE_uint64(database_memory_limit);
+
+const std::string kWorkerShardEnv{"OSQUERY_WORKER_SHARD"};
+
+size_t getWorkerShard() {
+  static const size_t shard = []() -> size_t {
+    auto value = getEnvVar(kWorkerShardEnv);
+    if (!value.is_initialized()) {
+      return 0;
+    }
+    return tryTo<size_t>(*value).takeOr(size_t{0});
+  }();
+  return shard;
+}
 
 void Watcher::resetWorkerCounters(uint64_t respawn_time) {
   // Reset the monitoring counters for the watcher.
@@ -164,9 +219,13 @@ void Watcher::removeExtensionPath(const std::string& extension) {
 PerformanceState& Watcher::getState(const PlatformProcess& child) {
   if (child == getWorker()) {
     return state_;
-  } else {
-    return extension_states_[getExtensionPath(child)];
   }
+
+  auto shard = getShardIndex(child);
+  if (shard != 0) {
+    return shard_states_[shard];
+  }
+  return extension_states_[getExtensionPath(child)];
 }
 
 PerformanceState& Watcher::getState(const std::string& extension) {
@@ -179,6 +238,34 @@ void Watcher::setExtension(const std::string& extension,
   extensions_[extension] = child;
 }
 
+std::shared_ptr<PlatformProcess> Watcher::getShard(size_t shard) {
+  std::unique_lock<std::mutex> lock(new_processes_mutex_);
+  auto it = shards_.find(shard);
+  return (it != shards_.end()) ? it->second : nullptr;
+}
+
+void Watcher::setShard(size_t shard,
+                       const std::shared_ptr<PlatformProcess>& child) {
+  shards_[shard] = child;
+}
+
+void Watcher::resetShardCounters(size_t shard, uint64_t respawn_time) {
+  auto& state = shard_states_[shard];
+  state.sustained_latency = 0;
+  state.user_time = 0;
+  state.system_time = 0;
+  state.last_respawn_time = respawn_time;
+}
+
+size_t Watcher::getShardIndex(const PlatformProcess& child) const {
+  for (const auto& shard : shards_) {
+    if (*shard.second == child) {
+      return shard.first;
+    }
+  }
+  return 0;
+}
+
 void Watcher::reset(const PlatformProcess& child) {
   std::unique_lock<std::mutex> lock(new_processes_mutex_);
   if (child == getWorker()) {
@@ -187,6 +274,13 @@ void Watcher::reset(const PlatformProcess& child) {
     return;
   }
 
+  auto shard = getShardIndex(child);
+  if (shard != 0) {
+    setShard(shard, std::make_shared<PlatformProcess>());
+    resetShardCounters(shard, 0);
+    return;
+  }
+
   // If it was not the worker pid then find the extension name to reset.
   for (const auto& extension : extensions()) {
     if (*extension.second == child) {
@@ -225,7 +319,27 @@ WatcherRunner::WatcherRunner(int argc,
       argc_(argc),
       argv_(argv),
       use_worker_(use_worker),
-      watcher_(watcher) {}
+      watcher_(watcher) {
+#ifdef __linux__
+  if (!use_worker_ || !FLAGS_watchdog_cgroup) {
+    return;
+  }
+
+  std::string path;
+  std::unique_ptr<WorkerCgroup> cgroup;
+  auto status = WorkerCgroup::getCurrentPath(path);
+  if (status.ok()) {
+    status = WorkerCgroup::create("/sys/fs/cgroup", path, cgroup);
+  }
+
+  if (!status.ok()) {
+    LOG(WARNING) << "Cannot account the worker in a cgroup: "
+                 << status.getMessage();
+    return;
+  }
+  worker_cgroup_ = std::move(cgroup);
+#endif
+}
 
 bool WatcherRunner::ok() const {
   // Inspect the exit code, on success or catastrophic, end the watcher.
@@ -276,6 +390,14 @@ void WatcherRunner::start() {
       }
     }
 
+    // The other schedule shards are respawned on their own.
+    if (use_worker_) {
+      watchShards();
+      if (interrupted() || shutdownRequested()) {
+        break;
+      }
+    }
+
     // After inspecting the worker, check the extensions.
     // Extensions may be active even if a worker/watcher is not used.
     watchExtensions();
@@ -319,11 +441,31 @@ void WatcherRunner::stop() {
         stop_extension, extension.first, extension.second);
   }
 
+  std::vector<std::thread> stop_shards_threads;
+  for (const auto& shard : watcher_->shards_) {
+    if (shard.second->isValid()) {
+      stop_shards_threads.emplace_back(
+          [this](const std::shared_ptr<PlatformProcess> child) {
+            stopChild(*child);
+          },
+          shard.second);
+    }
+  }
+
   auto& worker = watcher_->getWorker();
   if (worker.isValid()) {
     stopChild(worker);
   }
 
+  for (auto& thread : stop_shards_threads) {
+    thread.join();
+  }
+
+  if (query_accounting_ != nullptr) {
+    // A worker that never started left the name of its segment.
+    query_accounting_->unlink();
+  }
+
   for (auto& thread : stop_extensions_threads) {
     thread.join();
   }
@@ -368,6 +510,31 @@ void WatcherRunner::watchExtensions() {
   }
 }
 
+void WatcherRunner::watchShards() {
+  for (size_t shard = 1; shard < FLAGS_worker_shards; ++shard) {
+    auto child = watcher_->getShard(shard);
+    if (child != nullptr && watch(*child)) {
+      continue;
+    }
+
+    if (watcher_->fatesBound()) {
+      return;
+    }
+
+    // A shard stopped by the watchdog only restarts its own queries.
+    if (watcher_->shard_restarts_[shard] ==
+        getWorkerLimit(WatchdogLimitType::RESPAWN_LIMIT)) {
+      requestShutdown(EXIT_FAILURE, "Too many worker shard restarts");
+      return;
+    }
+
+    createShard(shard);
+    if (interrupted() || shutdownRequested()) {
+      return;
+    }
+  }
+}
+
 uint64_t WatcherRunner::delayedTime() const {
   return watcher_->workerStartTime() + FLAGS_watchdog_delay;
 }
@@ -395,6 +562,8 @@ bool WatcherRunner::watch(const PlatformProcess& child) const {
             << ") stopping: " << status.getMessage();
       systemLog(error.str());
       LOG(WARNING) << error.str();
+      blameWorkerQuery(child, status);
+      logWorkerFlightRecorder(child);
       warnWorkerResourceLimitHit(child);
       stopChild(child, true);
       return false;
@@ -403,8 +572,16 @@ bool WatcherRunner::watch(const PlatformProcess& child) const {
   }
 
   if (result == PROCESS_EXITED) {
+    if (!(child == watcher_->getWorker())) {
+      // A shard worker exit does not end the watcher.
+      return false;
+    }
+
     // If the worker process existed, store the exit code.
     watcher_->worker_status_ = process_status;
+    if (process_status != EXIT_SUCCESS) {
+      logWorkerFlightRecorder(child);
+    }
     return false;
   }
 
@@ -517,8 +694,11 @@ static bool exceededMemoryLimit(const PerformanceChange& change) {
     return false;
   }
 
-  return (change.footprint >
-          getWorkerLimit(WatchdogLimitType::MEMORY_LIMIT) * 1024 * 1024);
+  // The backing store caches are capped on their own, see
+  // database_memory_limit, and are not counted against the worker.
+  auto limit = getWorkerLimit(WatchdogLimitType::MEMORY_LIMIT) +
+               FLAGS_database_memory_limit;
+  return (change.footprint > limit * 1024 * 1024);
 }
 
 static bool exceededCyclesLimit(const PerformanceChange& change) {
@@ -571,6 +751,16 @@ Status WatcherRunner::isChildSane(const PlatformProcess& child) const {
     return Status(1, "Cannot find process");
   }
 
+#ifdef __linux__
+  // The cgroup counts the children of the worker and usage between checks.
+  if (worker_cgroup_ != nullptr && child == watcher_->getWorker()) {
+    auto status = worker_cgroup_->updateRow(rows[0]);
+    if (!status.ok()) {
+      VLOG(1) << "Cannot read the worker cgroup: " << status.getMessage();
+    }
+  }
+#endif
+
   PerformanceChange change;
   {
     auto& state = watcher_->getState(child);
@@ -587,20 +777,97 @@ Status WatcherRunner::isChildSane(const PlatformProcess& child) const {
   }
 
   if (exceededCyclesLimit(change)) {
-    return Status(1,
+    return Status(kCyclesLimitExceeded,
                   "Maximum sustainable CPU utilization limit exceeded: " +
                       std::to_string(change.sustained_latency * change.iv));
   }
 
   // Check if the private memory exceeds a memory limit.
   if (exceededMemoryLimit(change)) {
-    return Status(
-        1, "Memory limits exceeded: " + std::to_string(change.footprint));
+    return Status(kMemoryLimitExceeded,
+                  "Memory limits exceeded: " + std::to_string(change.footprint));
   }
 
   return Status(0);
 }
 
+void WatcherRunner::blameWorkerQuery(const PlatformProcess& child,
+                                     const Status& status) const {
+  // The queries of shard workers are not accounted.
+  if (!(child == watcher_->getWorker())) {
+    return;
+  }
+
+  watcher_->worker_culprit_ = boost::none;
+  if (query_accounting_ == nullptr) {
+    return;
+  }
+
+  // A query is only blamed if it could have exceeded the limit on its own:
+  // the sustained CPU utilization on one core, or half of the memory limit.
+  bool memory = (status.getCode() == kMemoryLimitExceeded);
+  uint64_t minimum = 0;
+  if (memory) {
+    minimum = getWorkerLimit(WatchdogLimitType::MEMORY_LIMIT) * 1024 * 1024 / 2;
+  } else {
+    minimum = getWorkerLimit(WatchdogLimitType::UTILIZATION_LIMIT) *
+              getWorkerLimit(WatchdogLimitType::LATENCY_LIMIT) * 10;
+  }
+
+  std::string culprit;
+  uint64_t most = 0;
+  bool scheduled = false;
+  for (const auto& query : query_accounting_->getRunningQueries(child.pid())) {
+    auto used = (memory) ? query.memory_bytes : query.cpu_ms;
+    VLOG(1) << "osqueryd worker query " << query.name << " used "
+            << query.cpu_ms << "ms of CPU and " << query.memory_bytes
+            << " bytes of memory";
+    if (used >= minimum && used > most) {
+      culprit = query.name;
+      most = used;
+      scheduled = query.scheduled;
+    }
+  }
+
+  // CPU used by table helper threads is not accounted to a query. Without a
+  // query over the minimum the worker falls back to the executing query.
+  if (culprit.empty()) {
+    LOG(WARNING) << "osqueryd worker stop not attributed to a query, blaming "
+                    "the executing query";
+    return;
+  }
+
+  // Only scheduled queries are denylisted, a distributed query blames none.
+  if (!scheduled) {
+    culprit.clear();
+  }
+  LOG(WARNING) << "osqueryd worker stop blamed on "
+               << ((culprit.empty()) ? "no scheduled query" : culprit);
+  watcher_->worker_culprit_ = culprit;
+}
+
+void WatcherRunner::logWorkerFlightRecorder(
+    const PlatformProcess& child) const {
+  if (flight_recorder_ == nullptr || !(child == watcher_->getWorker())) {
+    return;
+  }
+
+  auto records = flight_recorder_->getRecords();
+  if (records.empty()) {
+    return;
+  }
+
+  auto now = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+  std::string summary = "osqueryd worker (" + std::to_string(child.pid()) +
+                        ") flight recorder: " +
+                        summarizeFlightRecords(records, now, kFlightWindowMs);
+  systemLog(summary);
+  LOG(WARNING) << summary;
+}
+
 void WatcherRunner::createWorker() {
   std::unique_lock<std::mutex> lock(watcher_->new_processes_mutex_);
 
@@ -627,6 +894,69 @@ void WatcherRunner::createWorker() {
     pause(std::chrono::seconds(delay));
   }
 
+  // Set an environment signaling to potential plugin-dependent workers to wait
+  // for extensions to broadcast.
+  if (Watcher::hasManagedExtensions()) {
+    setEnvVar("OSQUERY_EXTENSIONS", "true");
+  }
+
+  std::string exec_path;
+  if (!getWorkerPath(exec_path)) {
+    return;
+  }
+
+  // Each worker gets a new accounting segment, it removes the name.
+  if (FLAGS_watchdog_query_accounting && isPlatform(PlatformType::TYPE_LINUX)) {
+    std::unique_ptr<QueryAccounting> accounting;
+    auto status = QueryAccounting::create(accounting);
+    if (status.ok()) {
+      setEnvVar(kQueryAccountingEnv, accounting->name());
+    } else {
+      VLOG(1) << "Cannot account the worker queries: " << status.getMessage();
+    }
+    query_accounting_ = std::move(accounting);
+  }
+
+  // Each worker also gets a new flight recorder segment.
+  if (FLAGS_watchdog_flight_recorder &&
+      isPlatform(PlatformType::TYPE_LINUX)) {
+    std::unique_ptr<FlightRecorder> recorder;
+    auto status = FlightRecorder::create(recorder);
+    if (status.ok()) {
+      setEnvVar(kFlightRecorderEnv, recorder->name());
+    } else {
+      VLOG(1) << "Cannot record the worker activity: " << status.getMessage();
+    }
+    flight_recorder_ = std::move(recorder);
+  }
+
+  if (watcher_->worker_culprit_.is_initialized()) {
+    setEnvVar(kWatchdogCulpritEnv, *watcher_->worker_culprit_);
+    watcher_->worker_culprit_ = boost::none;
+  }
+
+  auto worker = PlatformProcess::launchWorker(exec_path, argc_, argv_);
+
+  // Extensions are started with the environment of the watcher.
+  unsetEnvVar(kQueryAccountingEnv);
+  unsetEnvVar(kFlightRecorderEnv);
+  unsetEnvVar(kWatchdogCulpritEnv);
+  if (worker == nullptr) {
+    // Unrecoverable error, cannot create a worker process.
+    LOG(ERROR) << "osqueryd could not create a worker process";
+    requestShutdown(EXIT_FAILURE);
+    return;
+  }
+
+  watcher_->setWorker(worker);
+  watcher_->resetWorkerCounters(getUnixTime());
+  addWorkerToCgroup(*worker);
+  VLOG(1) << "osqueryd watcher (" << PlatformProcess::getCurrentPid()
+          << ") executing worker (" << worker->pid() << ")";
+  watcher_->worker_status_ = -1;
+}
+
+bool WatcherRunner::getWorkerPath(std::string& path) {
   // Get the path of the current process.
   auto qd = SQL::selectFrom({"path"},
                             "processes",
@@ -636,13 +966,7 @@ void WatcherRunner::createWorker() {
   if (qd.size() != 1 || qd[0].count("path") == 0 || qd[0]["path"].size() == 0) {
     requestShutdown(EXIT_FAILURE,
                     "osquery watcher cannot determine process path for worker");
-    return;
-  }
-
-  // Set an environment signaling to potential plugin-dependent workers to wait
-  // for extensions to broadcast.
-  if (Watcher::hasManagedExtensions()) {
-    setEnvVar("OSQUERY_EXTENSIONS", "true");
+    return false;
   }
 
   // Get the complete path of the osquery process binary.
@@ -650,7 +974,7 @@ void WatcherRunner::createWorker() {
   auto exec_path = fs::system_complete(fs::path(qd[0]["path"]), ec);
   if (!pathExists(exec_path).ok()) {
     LOG(WARNING) << "osqueryd doesn't exist in: " << exec_path.string();
-    return;
+    return false;
   }
   if (!safePermissions(
           exec_path.parent_path().string(), exec_path.string(), true)) {
@@ -658,22 +982,74 @@ void WatcherRunner::createWorker() {
     auto message = std::string(RLOG(1382)) +
                    "osqueryd has unsafe permissions: " + exec_path.string();
     requestShutdown(EXIT_FAILURE, message);
+    return false;
+  }
+
+  path = exec_path.string();
+  return true;
+}
+
+void WatcherRunner::createShard(size_t shard) {
+  std::unique_lock<std::mutex> lock(watcher_->new_processes_mutex_);
+  if (interrupted()) {
     return;
   }
 
-  auto worker = PlatformProcess::launchWorker(exec_path.string(), argc_, argv_);
+  auto& restarts = watcher_->shard_restarts_[shard];
+  if (watcher_->shard_states_[shard].last_respawn_time >
+      getUnixTime() - getWorkerLimit(WatchdogLimitType::RESPAWN_LIMIT)) {
+    restarts++;
+    LOG(WARNING) << "osqueryd worker shard " << shard
+                 << " respawning too quickly: " << restarts << " times";
+
+    uint64_t delay = getWorkerLimit(WatchdogLimitType::RESPAWN_DELAY);
+    delay += static_cast<size_t>(pow(2, restarts));
+    delay = std::min(static_cast<uint64_t>(FLAGS_watchdog_max_delay), delay);
+    pause(std::chrono::seconds(delay));
+  }
+
+  std::string exec_path;
+  if (!getWorkerPath(exec_path)) {
+    return;
+  }
+
+  // The shard worker reads its index, the other workers start without it.
+  setEnvVar(kWorkerShardEnv, std::to_string(shard));
+  auto worker = PlatformProcess::launchWorker(exec_path, argc_, argv_);
+  unsetEnvVar(kWorkerShardEnv);
   if (worker == nullptr) {
-    // Unrecoverable error, cannot create a worker process.
-    LOG(ERROR) << "osqueryd could not create a worker process";
+    LOG(ERROR) << "osqueryd could not create worker shard " << shard;
     requestShutdown(EXIT_FAILURE);
     return;
   }
 
-  watcher_->setWorker(worker);
-  watcher_->resetWorkerCounters(getUnixTime());
+  watcher_->setShard(shard, worker);
+  watcher_->resetShardCounters(shard, getUnixTime());
   VLOG(1) << "osqueryd watcher (" << PlatformProcess::getCurrentPid()
-          << ") executing worker (" << worker->pid() << ")";
-  watcher_->worker_status_ = -1;
+          << ") executing worker shard " << shard << " (" << worker->pid()
+          << ")";
+}
+
+void WatcherRunner::addWorkerToCgroup(const PlatformProcess& worker) {
+#ifdef __linux__
+  if (worker_cgroup_ == nullptr) {
+    return;
+  }
+
+  // The worker started in the watcher cgroup, its children follow once moved.
+  auto status = worker_cgroup_->addWorker(worker.pid());
+  if (status.ok() && FLAGS_watchdog_cgroup_memory_high) {
+    auto limit = getWorkerLimit(WatchdogLimitType::MEMORY_LIMIT) +
+                 FLAGS_database_memory_limit;
+    status = worker_cgroup_->setMemoryHigh(limit * 1024 * 1024);
+  }
+
+  if (!status.ok()) {
+    LOG(WARNING) << "Cannot account the worker in its cgroup: "
+                 << status.getMessage();
+    worker_cgroup_.reset();
+  }
+#endif
 }
 
 void WatcherRunner::createExtension(const std::string& extension) {
@@ -737,6 +1113,7 @@ void WatcherWatcherRunner::start() {
       requestShutdown();
       break;
     }
+    recordFlightMemory();
     pause(std::chrono::seconds(getWorkerLimit(WatchdogLimitType::INTERVAL)));
   }
 }
@@ -18,6 +18,7 @@
 #endif
 
 #include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
 
 #include <osquery/core/flags.h>
 #include <osquery/core/sql/query_data.h>
@@ -31,8 +32,25 @@ using ExtensionMap = std::map<std::string, std::shared_ptr<PlatformProcess>>;
 
 DECLARE_bool(disable_watchdog);
 DECLARE_int32(watchdog_level);
+DECLARE_uint32(worker_shards);
 
+/// The environment variable giving a worker shard its index.
+extern const std::string kWorkerShardEnv;
+
+/**
+ * @brief The schedule shard of this worker process.
+ *
+ * The watcher may start several workers, see worker_shards, each running the
+ * scheduled queries hashed to its shard. The primary worker is shard 0, it
+ * also runs the event publishers and distributed queries. Every process that
+ * is not started as a shard worker is shard 0.
+ */
+size_t getWorkerShard();
+
+class FlightRecorder;
+class QueryAccounting;
 class WatcherRunner;
+class WorkerCgroup;
 
 /**
  * @brief Categories of process performance limitations.
@@ -166,7 +184,19 @@ class Watcher : private boost::noncopyable {
   void setExtension(const std::string& extension,
                     const std::shared_ptr<PlatformProcess>& child);
 
-  /// Reset pid and performance counters for a worker or extension process.
+  /// Accessor for the worker of a schedule shard, from 1, if started.
+  std::shared_ptr<PlatformProcess> getShard(size_t shard);
+
+  /// Setter for the worker of a schedule shard.
+  void setShard(size_t shard, const std::shared_ptr<PlatformProcess>& child);
+
+  /// Reset counters after a shard worker exits.
+  void resetShardCounters(size_t shard, uint64_t respawn_time);
+
+  /// Lookup the schedule shard of a worker, 0 if not a shard worker.
+  size_t getShardIndex(const PlatformProcess& child) const;
+
+  /// Reset pid and performance counters for a worker, shard or extension.
   void reset(const PlatformProcess& child);
 
   /// Count the number of worker restarts.
@@ -211,12 +241,24 @@ class Watcher : private boost::noncopyable {
   /// Keep a list of resolved extension paths and their managed pids.
   ExtensionMap extensions_;
 
+  /// The workers of the other schedule shards, by shard from 1.
+  std::map<size_t, std::shared_ptr<PlatformProcess>> shards_;
+
+  /// Performance states for each shard worker.
+  std::map<size_t, PerformanceState> shard_states_;
+
+  /// Number of restarts of each shard worker NOT induced by a watchdog.
+  std::map<size_t, size_t> shard_restarts_;
+
   /// Bind the fate of the watcher to the worker.
   std::atomic<bool> restart_worker_{true};
 
   /// Record the exit status of the most recent worker.
   std::atomic<int> worker_status_{-1};
 
+  /// The query blamed for stopping the last worker, passed to the next one.
+  boost::optional<std::string> worker_culprit_;
+
   /// Used to synchronize a process start with an attempt to stop such process
   std::mutex new_processes_mutex_;
 
@@ -262,6 +304,9 @@ class WatcherRunner : public InternalRunnable {
   /// Enumerate each extension and check sanity.
   virtual void watchExtensions();
 
+  /// Check each schedule shard worker, and respawn those that stopped.
+  void watchShards();
+
   /// Inspect into the memory, CPU, and other worker/extension process states.
   virtual Status isChildSane(const PlatformProcess& child) const;
 
@@ -276,6 +321,15 @@ class WatcherRunner : public InternalRunnable {
   /// Fork and execute a worker process.
   virtual void createWorker();
 
+  /// Fork and execute the worker process of a schedule shard.
+  virtual void createShard(size_t shard);
+
+  /// Get the checked path of the osqueryd binary, or request a shutdown.
+  bool getWorkerPath(std::string& path);
+
+  /// Move a new worker to its cgroup, if enabled.
+  void addWorkerToCgroup(const PlatformProcess& worker);
+
   /// Fork an extension process.
   virtual void createExtension(const std::string& extension);
 
@@ -290,6 +344,13 @@ class WatcherRunner : public InternalRunnable {
 
   virtual void warnWorkerResourceLimitHit(const PlatformProcess& child) const;
 
+  /// Log a summary of the last activity recorded by the worker.
+  void logWorkerFlightRecorder(const PlatformProcess& child) const;
+
+  /// Blame the worker query that used the most of the exceeded limit.
+  void blameWorkerQuery(const PlatformProcess& child,
+                        const Status& status) const;
+
   /// Return the time the watchdog is delayed until (from start of watcher).
   uint64_t delayedTime() const;
 
@@ -318,12 +379,22 @@ class WatcherRunner : public InternalRunnable {
   /// Watcher instance.
   std::shared_ptr<Watcher> watcher_{nullptr};
 
+  /// The cgroup accounting the worker, see watchdog_cgroup, Linux only.
+  std::shared_ptr<WorkerCgroup> worker_cgroup_{nullptr};
+
+  /// The queries running in the worker, see watchdog_query_accounting.
+  std::shared_ptr<QueryAccounting> query_accounting_{nullptr};
+
+  /// The recent activity of the worker, see watchdog_flight_recorder.
+  std::shared_ptr<FlightRecorder> flight_recorder_{nullptr};
+
  private:
   FRIEND_TEST(WatcherTests, test_watcherrunner_watch);
   FRIEND_TEST(WatcherTests, test_watcherrunner_stop);
   FRIEND_TEST(WatcherTests, test_watcherrunner_loop);
   FRIEND_TEST(WatcherTests, test_watcherrunner_loop_failure);
   FRIEND_TEST(WatcherTests, test_watcherrunner_loop_disabled);
+  FRIEND_TEST(WatcherTests, test_watcherrunner_loop_shards);
   FRIEND_TEST(WatcherTests, test_watcherrunner_watcherhealth);
   FRIEND_TEST(WatcherTests, test_watcherrunner_unhealthy_delay);
   FRIEND_TEST(WatcherTests, test_watcherrunner_unhealthy);
@@ -11,6 +11,7 @@
 #include <osquery/utils/system/system.h>
 
 #include <osquery/core/system.h>
+#include <osquery/core/windows/wmi.h>
 
 namespace osquery {
 
@@ -24,6 +25,7 @@ void platformSetup() {
 
 void platformTeardown() {
   // Before we shutdown, we must insure to free the COM libs in windows
+  releaseWmiConnections();
   ::CoUninitialize();
 }
 
@@ -7,15 +7,24 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <locale>
+#include <map>
+#include <mutex>
 #include <string>
 
+#include <osquery/core/flags.h>
 #include <osquery/core/windows/wmi.h>
 #include <osquery/logger/logger.h>
 #include <osquery/utils/conversions/windows/strings.h>
 
 namespace osquery {
 
+FLAG(bool,
+     wmi_cache_results,
+     true,
+     "Reuse recent WMI results in the tables of rarely changing data");
+
 WmiMethodArgs::WmiMethodArgs(WmiMethodArgs&& src) {
   std::swap(arguments, src.arguments);
 }
@@ -360,58 +369,67 @@ Status WmiResultItem::GetVectorOfLongs(const std::string& name,
   return Status::success();
 }
 
-Expected<WmiRequest, WmiError> WmiRequest::CreateWmiRequest(
-    const std::string& query, std::wstring nspace) {
-  std::wstring wql = stringToWstring(query);
+namespace {
+
+/// The number of objects returned by each IEnumWbemClassObject::Next call.
+const ULONG kWmiEnumBatchSize{64};
 
-  HRESULT hr = E_FAIL;
+/// The most query results kept for reuse.
+const size_t kWmiResultCacheMaxEntries{256};
 
-  IWbemLocator* locator = nullptr;
+using WmiServices = std::shared_ptr<IWbemServices>;
+using WmiResults = std::shared_ptr<const std::vector<WmiResultItem>>;
 
-  hr = ::CoCreateInstance(CLSID_WbemLocator,
-                          0,
-                          CLSCTX_INPROC_SERVER,
-                          IID_IWbemLocator,
-                          (LPVOID*)&locator);
+/// Connect to a namespace and set the proxy authentication.
+Expected<WmiServices, WmiError> connectWmiNamespace(
+    const std::wstring& nspace) {
+  IWbemLocator* raw_locator = nullptr;
+  HRESULT hr = ::CoCreateInstance(CLSID_WbemLocator,
+                                  0,
+                                  CLSCTX_INPROC_SERVER,
+                                  IID_IWbemLocator,
+                                  (LPVOID*)&raw_locator);
   if (hr != S_OK) {
     return createError(WmiError::ConstructionError)
            << "WmiRequest creation failed after CoCreateInstance";
   }
-  WmiRequest wmi_request;
-  wmi_request.locator_.reset(locator);
+  std::unique_ptr<IWbemLocator, impl::WmiObjectDeleter> locator(raw_locator);
 
-  IWbemServices* services = nullptr;
   BSTR nspace_str = SysAllocString(nspace.c_str());
   if (nullptr == nspace_str) {
     return createError(WmiError::ConstructionError)
            << "WmiRequest creation failed in nspace_str allocation";
   }
 
-  hr = wmi_request.locator_->ConnectServer(nspace_str,
-                                           nullptr,
-                                           nullptr,
-                                           nullptr,
-                                           WBEM_FLAG_CONNECT_USE_MAX_WAIT,
-                                           nullptr,
-                                           nullptr,
-                                           &services);
+  IWbemServices* raw_services = nullptr;
+  hr = locator->ConnectServer(nspace_str,
+                              nullptr,
+                              nullptr,
+                              nullptr,
+                              WBEM_FLAG_CONNECT_USE_MAX_WAIT,
+                              nullptr,
+                              nullptr,
+                              &raw_services);
   SysFreeString(nspace_str);
 
   if (hr != S_OK) {
     return createError(WmiError::ConstructionError)
            << "WmiRequest creation failed to connect to server";
   }
+  WmiServices services(raw_services, impl::WmiObjectDeleter());
 
   // We need to set specific authentication information on the IWbemServices
   // interface proxy prior making a call on one of this interface. This can
   // be done by using QueryBlanket and SetBlanket() on the IClientSecurity
   // interface.
-  IClientSecurity* pSecurity = NULL;
-  hr = services->QueryInterface(IID_IClientSecurity, (LPVOID*)&pSecurity);
-  if (FAILED(hr) || !pSecurity) {
+  IClientSecurity* raw_security = nullptr;
+  hr = services->QueryInterface(IID_IClientSecurity, (LPVOID*)&raw_security);
+  if (FAILED(hr) || !raw_security) {
     return createError(WmiError::ConstructionError)
            << "WmiRequest creation failed in IClientSecurity interface query";
   }
+  std::unique_ptr<IClientSecurity, impl::WmiObjectDeleter> security(
+      raw_security);
 
   // Querying the current authentication information
   DWORD authnSvc = 0;
@@ -422,76 +440,230 @@ Expected<WmiRequest, WmiError> WmiRequest::CreateWmiRequest(
   RPC_AUTH_IDENTITY_HANDLE authInfo = NULL;
   DWORD ifCapabilites = 0;
 
-  hr = pSecurity->QueryBlanket(services,
-                               &authnSvc,
-                               &authzSvc,
-                               &serverPrincName,
-                               &authnLevel,
-                               &impLevel,
-                               &authInfo,
-                               &ifCapabilites);
+  hr = security->QueryBlanket(services.get(),
+                              &authnSvc,
+                              &authzSvc,
+                              &serverPrincName,
+                              &authnLevel,
+                              &impLevel,
+                              &authInfo,
+                              &ifCapabilites);
   if (FAILED(hr)) {
     return createError(WmiError::ConstructionError)
            << "WmiRequest creation failed in QueryBlanket call";
   }
 
   // Setting authentication information on proxy interface
-  hr = pSecurity->SetBlanket(services,
-                             authnSvc,
-                             authzSvc,
-                             serverPrincName,
-                             RPC_C_AUTHN_LEVEL_DEFAULT,
-                             RPC_C_IMP_LEVEL_IMPERSONATE,
-                             authInfo,
-                             EOAC_NONE);
+  hr = security->SetBlanket(services.get(),
+                            authnSvc,
+                            authzSvc,
+                            serverPrincName,
+                            RPC_C_AUTHN_LEVEL_DEFAULT,
+                            RPC_C_IMP_LEVEL_IMPERSONATE,
+                            authInfo,
+                            EOAC_NONE);
+  if (serverPrincName != NULL) {
+    CoTaskMemFree(serverPrincName);
+  }
 
   if (FAILED(hr)) {
     return createError(WmiError::ConstructionError)
            << "WmiRequest creation failed in SetBlanket call";
   }
+  return services;
+}
+
+/**
+ * @brief Connections to WMI namespaces shared by requests.
+ *
+ * The process joins the multithreaded apartment, so a connection may be
+ * used from any thread. A connection that fails a query is removed and the
+ * next request reconnects, for instance after the WMI service restarts.
+ */
+class WmiConnectionPool {
+ public:
+  static WmiConnectionPool& get() {
+    static WmiConnectionPool pool;
+    return pool;
+  }
+
+  Expected<WmiServices, WmiError> services(const std::wstring& nspace) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = services_.find(nspace);
+    if (it != services_.end()) {
+      return it->second;
+    }
+
+    auto services = connectWmiNamespace(nspace);
+    if (services) {
+      services_[nspace] = *services;
+    }
+    return services;
+  }
+
+  void invalidate(const std::wstring& nspace, const WmiServices& services) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = services_.find(nspace);
+    if (it != services_.end() && it->second == services) {
+      services_.erase(it);
+    }
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    services_.clear();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::map<std::wstring, WmiServices> services_;
+};
+
+/// Recent results of the queries that allow reuse, by namespace and query.
+class WmiResultCache {
+ public:
+  static WmiResultCache& get() {
+    static WmiResultCache cache;
+    return cache;
+  }
 
-  pSecurity->Release();
+  WmiResults find(const std::wstring& key, std::chrono::seconds max_age) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = results_.find(key);
+    if (it == results_.end() ||
+        std::chrono::steady_clock::now() - it->second.first > max_age) {
+      return nullptr;
+    }
+    return it->second.second;
+  }
 
-  wmi_request.services_.reset(services);
+  void add(const std::wstring& key, WmiResults results) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (results_.size() >= kWmiResultCacheMaxEntries) {
+      auto oldest = std::min_element(
+          results_.begin(), results_.end(), [](const auto& a, const auto& b) {
+            return a.second.first < b.second.first;
+          });
+      results_.erase(oldest);
+    }
+    results_[key] = std::make_pair(std::chrono::steady_clock::now(),
+                                   std::move(results));
+  }
 
-  IEnumWbemClassObject* wbem_enum = nullptr;
+  void clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    results_.clear();
+  }
 
+ private:
+  std::mutex mutex_;
+  std::map<std::wstring,
+           std::pair<std::chrono::steady_clock::time_point, WmiResults>>
+      results_;
+};
+
+/// Run a query and read its objects in batches.
+HRESULT execWmiQuery(IWbemServices* services,
+                     const std::wstring& wql,
+                     std::vector<WmiResultItem>& results) {
   BSTR language_str = SysAllocString(L"WQL");
   if (nullptr == language_str) {
-    return createError(WmiError::ConstructionError)
-           << "WmiRequest creation failed in language_str allocation";
+    return E_OUTOFMEMORY;
   }
 
   BSTR wql_str = SysAllocString(wql.c_str());
   if (nullptr == wql_str) {
     SysFreeString(language_str);
-    return createError(WmiError::ConstructionError)
-           << "WmiRequest creation failed in wql_str allocation";
+    return E_OUTOFMEMORY;
   }
 
-  hr = wmi_request.services_->ExecQuery(
-      language_str, wql_str, WBEM_FLAG_FORWARD_ONLY, nullptr, &wbem_enum);
+  // Semisynchronous calls return immediately, the objects are read while
+  // WMI produces them.
+  IEnumWbemClassObject* raw_enum = nullptr;
+  HRESULT hr = services->ExecQuery(
+      language_str,
+      wql_str,
+      WBEM_FLAG_FORWARD_ONLY | WBEM_FLAG_RETURN_IMMEDIATELY,
+      nullptr,
+      &raw_enum);
 
   SysFreeString(wql_str);
   SysFreeString(language_str);
   if (hr != S_OK) {
-    return createError(WmiError::ConstructionError)
-           << "WmiRequest creation failed in ExecQuery";
+    return hr;
   }
+  std::unique_ptr<IEnumWbemClassObject, impl::WmiObjectDeleter> wbem_enum(
+      raw_enum);
+
+  IWbemClassObject* objects[kWmiEnumBatchSize];
+  do {
+    ULONG count = 0;
+    hr = wbem_enum->Next(WBEM_INFINITE, kWmiEnumBatchSize, objects, &count);
+    for (ULONG i = 0; i < count; ++i) {
+      results.emplace_back(objects[i]);
+    }
+  } while (hr == WBEM_S_NO_ERROR);
 
-  wmi_request.enum_.reset(wbem_enum);
+  // A query error is only known when reading its first objects.
+  return (FAILED(hr) && results.empty()) ? hr : S_OK;
+}
+
+} // namespace
 
-  hr = WBEM_S_NO_ERROR;
-  while (hr == WBEM_S_NO_ERROR) {
-    IWbemClassObject* result = nullptr;
-    ULONG result_count = 0;
+void releaseWmiConnections() {
+  WmiResultCache::get().clear();
+  WmiConnectionPool::get().clear();
+}
 
-    hr = wmi_request.enum_->Next(WBEM_INFINITE, 1, &result, &result_count);
-    if (SUCCEEDED(hr) && result_count > 0) {
-      wmi_request.results_.emplace_back(result);
+Expected<WmiRequest, WmiError> WmiRequest::CreateWmiRequest(
+    const std::string& query,
+    std::wstring nspace,
+    std::chrono::seconds max_age) {
+  std::wstring wql = stringToWstring(query);
+
+  auto services = WmiConnectionPool::get().services(nspace);
+  if (!services) {
+    return services.takeError();
+  }
+
+  WmiRequest wmi_request;
+  wmi_request.services_ = *services;
+
+  auto use_cache = FLAGS_wmi_cache_results && max_age.count() > 0;
+  auto key = nspace + L"\n" + wql;
+  if (use_cache) {
+    auto cached = WmiResultCache::get().find(key, max_age);
+    if (cached != nullptr) {
+      wmi_request.results_ = std::move(cached);
+      wmi_request.status_ = Status(0);
+      return wmi_request;
     }
   }
 
+  std::vector<WmiResultItem> results;
+  HRESULT hr = execWmiQuery(wmi_request.services_.get(), wql, results);
+  if (FAILED(hr)) {
+    // The shared connection may be broken, retry once with a new one.
+    WmiConnectionPool::get().invalidate(nspace, wmi_request.services_);
+    services = WmiConnectionPool::get().services(nspace);
+    if (!services) {
+      return services.takeError();
+    }
+    wmi_request.services_ = *services;
+    hr = execWmiQuery(wmi_request.services_.get(), wql, results);
+  }
+
+  if (FAILED(hr)) {
+    return createError(WmiError::ConstructionError)
+           << "WmiRequest creation failed in ExecQuery";
+  }
+
+  wmi_request.results_ =
+      std::make_shared<const std::vector<WmiResultItem>>(std::move(results));
+  if (use_cache) {
+    WmiResultCache::get().add(key, wmi_request.results_);
+  }
+
   wmi_request.status_ = Status(0);
   return wmi_request;
 }
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <functional>
 #include <iostream>
 #include <memory>
@@ -227,15 +228,28 @@ enum class WmiError {
  *
  * This class abstracts away the WMI querying logic and
  * will return WMI results given a query string.
+ *
+ * Requests share one connection per namespace. The results are enumerated
+ * semisynchronously, in batches of objects.
  */
 class WmiRequest {
  public:
+  /**
+   * @brief Run a WQL query in a namespace.
+   *
+   * @param query the WQL query.
+   * @param nspace the WMI namespace.
+   * @param max_age reuse the results of the same query if they are younger,
+   * for data that rarely changes. Zero always runs the query.
+   */
   static Expected<WmiRequest, WmiError> CreateWmiRequest(
-      const std::string& query, std::wstring nspace = L"ROOT\\CIMV2");
+      const std::string& query,
+      std::wstring nspace = L"ROOT\\CIMV2",
+      std::chrono::seconds max_age = std::chrono::seconds::zero());
   WmiRequest(WmiRequest&& src) = default;
 
   const std::vector<WmiResultItem>& results() const {
-    return results_;
+    return *results_;
   }
 
   /**
@@ -261,10 +275,20 @@ class WmiRequest {
  private:
   WmiRequest() = default;
   Status status_;
-  std::vector<WmiResultItem> results_;
 
-  std::unique_ptr<IEnumWbemClassObject, impl::WmiObjectDeleter> enum_{nullptr};
-  std::unique_ptr<IWbemLocator, impl::WmiObjectDeleter> locator_{nullptr};
-  std::unique_ptr<IWbemServices, impl::WmiObjectDeleter> services_{nullptr};
+  /// The results, which may be shared with other requests of the query.
+  std::shared_ptr<const std::vector<WmiResultItem>> results_{
+      std::make_shared<const std::vector<WmiResultItem>>()};
+
+  /// The connection to the namespace, shared with other requests.
+  std::shared_ptr<IWbemServices> services_;
 };
+
+/**
+ * @brief Release the shared WMI connections and results.
+ *
+ * This must be called before the COM libraries are uninitialized.
+ */
+void releaseWmiConnections();
+
 } // namespace osquery
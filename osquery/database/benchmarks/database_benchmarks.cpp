@@ -7,11 +7,15 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <vector>
+
 #include <benchmark/benchmark.h>
 
 #include <osquery/core/query.h>
 #include <osquery/database/database.h>
 #include <osquery/filesystem/filesystem.h>
+#include <osquery/registry/registry_factory.h>
 
 #include "osquery/tests/test_util.h"
 #include <osquery/utils/json/json.h>
@@ -177,4 +181,274 @@ static void DATABASE_store_append(benchmark::State& state) {
 }
 
 BENCHMARK(DATABASE_store_append);
+
+/// Backends compared by the workload benchmarks, selected by their first arg.
+const std::vector<std::string> kBenchmarkBackends = {"rocksdb", "ephemeral"};
+
+/// Bytes of each benchmark event record and log line.
+const size_t kBenchmarkRecordSize{256};
+
+/// Records written by each event subscriber batch.
+const size_t kBenchmarkEventBatch{64};
+
+/// Events stored in each time bucket by the expiry benchmarks.
+const size_t kBenchmarkBucketEvents{256};
+
+/// Lines read by each buffered logger check, like kMaxLogLines.
+const size_t kBenchmarkLogLines{1024};
+
+static void useBenchmarkBackend(benchmark::State& state) {
+  const auto& name = kBenchmarkBackends.at(state.range(0));
+  auto& rf = RegistryFactory::get();
+  if (rf.getActive("database") != name) {
+    rf.setActive("database", name);
+    resetDatabase();
+  }
+  state.SetLabel(name);
+}
+
+/// A zero-padded index, so keys sort like the event subscriber keys.
+static std::string benchmarkIndex(size_t i) {
+  auto index = std::to_string(i);
+  index.insert(index.begin(), (index.size() < 10) ? 10 - index.size() : 0, '0');
+  return index;
 }
+
+static std::string benchmarkEventKey(const std::string& name,
+                                     size_t bucket,
+                                     size_t eid) {
+  return "data.benchmark." + name + "." + benchmarkIndex(bucket) + "." +
+         benchmarkIndex(eid);
+}
+
+static void addBenchmarkBucket(const std::string& name, size_t bucket) {
+  DatabaseStringValueList data;
+  for (size_t i = 0; i < kBenchmarkBucketEvents; ++i) {
+    data.push_back(std::make_pair(
+        benchmarkEventKey(name, bucket, bucket * kBenchmarkBucketEvents + i),
+        std::string(kBenchmarkRecordSize, 'e')));
+  }
+  setDatabaseBatch(kEvents, data);
+}
+
+static void addBenchmarkLogs(size_t first, size_t count) {
+  DatabaseStringValueList data;
+  for (size_t i = first; i < first + count; ++i) {
+    // Buffered logs are "<index>_<r|s>_<time>_<count>".
+    data.push_back(std::make_pair("benchmark_r_" + benchmarkIndex(i) + "_1",
+                                  std::string(kBenchmarkRecordSize, 'l')));
+  }
+  setDatabaseBatch(kLogs, data);
+}
+
+static void removeBenchmarkKeys(const std::string& domain,
+                                const std::string& prefix) {
+  deleteDatabaseRange(domain, prefix, prefix + '\xff');
+}
+
+/// Event subscribers of each thread store batches, like addBatch.
+static void DATABASE_event_writers(benchmark::State& state) {
+  if (state.thread_index == 0) {
+    useBenchmarkBackend(state);
+  }
+
+  auto name = "writer" + std::to_string(state.thread_index);
+  size_t eid = 0;
+  DatabaseStringValueList data;
+  while (state.KeepRunning()) {
+    data.clear();
+    for (size_t i = 0; i < kBenchmarkEventBatch; ++i, ++eid) {
+      data.push_back(std::make_pair(benchmarkEventKey(name, eid / 1024, eid),
+                                    std::string(kBenchmarkRecordSize, 'e')));
+    }
+    setDatabaseBatch(kEvents, data);
+  }
+
+  state.SetItemsProcessed(state.iterations() * kBenchmarkEventBatch);
+  state.SetBytesProcessed(state.iterations() * kBenchmarkEventBatch *
+                          kBenchmarkRecordSize);
+  if (state.thread_index == 0) {
+    removeBenchmarkKeys(kEvents, "data.benchmark.");
+  }
+}
+
+BENCHMARK(DATABASE_event_writers)
+    ->Arg(0)
+    ->Arg(1)
+    ->Threads(1)
+    ->Threads(4)
+    ->Threads(8)
+    ->UseRealTime();
+
+/// A buffered logger check reading and removing its oldest lines.
+static void DATABASE_buffered_drain(benchmark::State& state) {
+  useBenchmarkBackend(state);
+
+  // The backlog of a logger whose endpoint was unavailable.
+  size_t backlog = static_cast<size_t>(state.range(1));
+  addBenchmarkLogs(0, backlog);
+
+  size_t next = backlog;
+  std::vector<std::string> indexes;
+  std::vector<std::string> lines;
+  while (state.KeepRunning()) {
+    indexes.clear();
+    lines.clear();
+    std::string next_index;
+    scanDatabaseValues(
+        kLogs,
+        "benchmark_",
+        "",
+        kBenchmarkLogLines,
+        [&indexes, &lines](const std::string& index, const std::string& line) {
+          indexes.push_back(index);
+          lines.push_back(line);
+          return true;
+        },
+        next_index);
+
+    for (const auto& index : indexes) {
+      deleteDatabaseValue(kLogs, index);
+    }
+
+    // New lines keep the backlog at the same size.
+    state.PauseTiming();
+    addBenchmarkLogs(next, indexes.size());
+    next += indexes.size();
+    state.ResumeTiming();
+  }
+
+  state.SetItemsProcessed(state.iterations() * kBenchmarkLogLines);
+  removeBenchmarkKeys(kLogs, "benchmark_");
+}
+
+BENCHMARK(DATABASE_buffered_drain)
+    ->Args({0, 10000})
+    ->Args({0, 100000})
+    ->Args({1, 10000})
+    ->Args({1, 100000});
+
+/// A buffered logger purge of the oldest tenth of its lines.
+static void DATABASE_buffered_purge(benchmark::State& state) {
+  useBenchmarkBackend(state);
+
+  size_t backlog = static_cast<size_t>(state.range(1));
+  size_t purge_count = backlog / 10;
+  addBenchmarkLogs(0, backlog);
+
+  size_t next = backlog;
+  while (state.KeepRunning()) {
+    std::vector<std::string> indexes;
+    scanDatabaseKeys(kLogs, indexes, "benchmark_r_", purge_count);
+    std::nth_element(indexes.begin(),
+                     indexes.begin() + (indexes.size() / 2),
+                     indexes.end());
+    for (const auto& index : indexes) {
+      deleteDatabaseValue(kLogs, index);
+    }
+
+    state.PauseTiming();
+    addBenchmarkLogs(next, indexes.size());
+    next += indexes.size();
+    state.ResumeTiming();
+  }
+
+  state.SetItemsProcessed(state.iterations() * purge_count);
+  removeBenchmarkKeys(kLogs, "benchmark_");
+}
+
+BENCHMARK(DATABASE_buffered_purge)
+    ->Args({0, 10000})
+    ->Args({0, 100000})
+    ->Args({1, 10000})
+    ->Args({1, 100000});
+
+static QueryDataTyped getBenchmarkResults(size_t rows, size_t generation) {
+  QueryDataTyped results;
+  results.reserve(rows);
+  for (size_t i = 0; i < rows; ++i) {
+    RowTyped row;
+    row["pid"] = static_cast<long long>(i);
+    row["name"] = "process" + std::to_string(i);
+    row["path"] = "/usr/bin/process" + std::to_string(i);
+    row["cmdline"] = "/usr/bin/process" + std::to_string(i) + " --flag";
+    row["uid"] = 0LL;
+    row["resident_size"] = static_cast<long long>(i * 4096);
+
+    // A scheduled query sees about 1% of its rows change between runs.
+    row["state"] = (i % 100 == 0) ? std::to_string(generation) : "S";
+    results.push_back(std::move(row));
+  }
+  return results;
+}
+
+/// A scheduled query loading, diffing and storing its previous results.
+static void DATABASE_query_results_diff(benchmark::State& state) {
+  useBenchmarkBackend(state);
+
+  auto rows = static_cast<size_t>(state.range(1));
+  std::vector<QueryDataTyped> generations = {getBenchmarkResults(rows, 0),
+                                             getBenchmarkResults(rows, 1)};
+
+  ScheduledQuery query(
+      "benchmark_pack", "benchmark_results", "SELECT * FROM processes");
+  auto dbq = Query("benchmark_results", query);
+
+  uint64_t counter = 0;
+  DiffResults diff_results;
+  dbq.addNewResults(generations[0], 0, counter, diff_results);
+
+  size_t generation = 0;
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    generation = (generation + 1) % generations.size();
+    auto results = generations[generation];
+    diff_results = DiffResults();
+    state.ResumeTiming();
+
+    dbq.addNewResults(std::move(results), 0, counter, diff_results);
+  }
+
+  state.SetItemsProcessed(state.iterations() * rows);
+  deleteDatabaseValue(kQueries, "benchmark_results");
+  deleteDatabaseValue(kQueries, "benchmark_resultsepoch");
+  deleteDatabaseValue(kQueries, "benchmark_resultscounter");
+}
+
+BENCHMARK(DATABASE_query_results_diff)
+    ->Args({0, 10000})
+    ->Args({0, 100000})
+    ->Args({1, 10000})
+    ->Args({1, 100000})
+    ->Unit(benchmark::kMillisecond);
+
+/// An event subscriber expiring its oldest time bucket.
+static void DATABASE_expire_range(benchmark::State& state) {
+  useBenchmarkBackend(state);
+
+  auto buckets = static_cast<size_t>(state.range(1));
+  for (size_t bucket = 0; bucket < buckets; ++bucket) {
+    addBenchmarkBucket("expire", bucket);
+  }
+
+  size_t oldest = 0;
+  while (state.KeepRunning()) {
+    auto low = "data.benchmark.expire." + benchmarkIndex(oldest) + ".";
+    deleteDatabaseRange(kEvents, low, low + '\xff');
+
+    state.PauseTiming();
+    addBenchmarkBucket("expire", oldest + buckets);
+    ++oldest;
+    state.ResumeTiming();
+  }
+
+  state.SetItemsProcessed(state.iterations() * kBenchmarkBucketEvents);
+  removeBenchmarkKeys(kEvents, "data.benchmark.");
+}
+
+BENCHMARK(DATABASE_expire_range)
+    ->Args({0, 60})
+    ->Args({0, 1440})
+    ->Args({1, 60})
+    ->Args({1, 1440});
+} // namespace osquery
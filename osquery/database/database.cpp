@@ -16,6 +16,7 @@
 #include <osquery/database/database.h>
 #include <osquery/logger/logger.h>
 #include <osquery/process/process.h>
+#include <osquery/profiler/code_profiler.h>
 #include <osquery/registry/registry.h>
 #include <osquery/utils/config/default_paths.h>
 #include <osquery/utils/conversions/tryto.h>
@@ -37,6 +38,16 @@ CLI_FLAG(string,
 
 FLAG_ALIAS(std::string, db_path, database_path);
 
+CLI_FLAG(bool,
+         database_read_only,
+         false,
+         "Read the disk-based backing store while another process writes it");
+
+CLI_FLAG(uint64,
+         database_memory_limit,
+         0,
+         "Megabytes of cache and write buffers of the backing store (0 = any)");
+
 FLAG(bool, disable_database, false, "Disable the persistent RocksDB storage");
 
 const std::string kInternalDatabase = "rocksdb";
@@ -44,6 +55,7 @@ const std::string kPersistentSettings = "configurations";
 const std::string kQueries = "queries";
 const std::string kEvents = "events";
 const std::string kCarves = "carves";
+const std::string kFileHashes = "file_hashes";
 const std::string kLogs = "logs";
 const std::string kDistributedQueries = "distributed";
 const std::string kDistributedRunningQueries = "distributed_running";
@@ -58,6 +70,7 @@ const std::vector<std::string> kDomains = {kPersistentSettings,
                                            kEvents,
                                            kLogs,
                                            kCarves,
+                                           kFileHashes,
                                            kDistributedQueries,
                                            kDistributedRunningQueries};
 
@@ -120,6 +133,58 @@ Status DatabasePlugin::scan(const std::string& domain,
   return Status::success();
 }
 
+Status DatabasePlugin::scanValues(const std::string& domain,
+                                  const std::string& prefix,
+                                  const std::string& resume,
+                                  uint64_t max,
+                                  const DatabaseScanCallback& callback,
+                                  std::string& next_key) const {
+  next_key.clear();
+
+  std::vector<std::string> keys;
+  auto status = scan(domain, keys, prefix, 0);
+  if (!status.ok()) {
+    return status;
+  }
+
+  uint64_t count = 0;
+  bool stopped = false;
+  for (const auto& key : keys) {
+    if (key < resume) {
+      continue;
+    }
+
+    if (stopped || (max > 0 && count >= max)) {
+      next_key = key;
+      break;
+    }
+
+    std::string value;
+    if (!get(domain, key, value).ok()) {
+      continue;
+    }
+
+    ++count;
+    stopped = !callback(key, value);
+  }
+  return Status::success();
+}
+
+std::future<Status> DatabasePlugin::putBatchAsync(
+    const std::string& domain, const DatabaseStringValueList& data) {
+  std::promise<Status> promise;
+  promise.set_value(putBatch(domain, data));
+  return promise.get_future();
+}
+
+Status DatabasePlugin::stats(PluginResponse& results) const {
+  return Status::success();
+}
+
+Status DatabasePlugin::memoryUsage(uint64_t& bytes) const {
+  return Status::failure("Database plugin does not report memory");
+}
+
 Status DatabasePlugin::call(const PluginRequest& request,
                             PluginResponse& response) {
   if (request.count("action") == 0) {
@@ -211,6 +276,39 @@ Status DatabasePlugin::call(const PluginRequest& request,
       response.push_back({{"k", k}});
     }
     return status;
+  } else if (request.at("action") == "scan_values") {
+    // Values are returned with their keys, followed by the resume key.
+    uint64_t max = 0;
+    if (request.count("max") > 0) {
+      max = std::stoull(request.at("max"));
+    }
+    auto prefix = (request.count("prefix") > 0) ? request.at("prefix") : "";
+    auto resume = (request.count("resume") > 0) ? request.at("resume") : "";
+
+    std::string next_key;
+    auto status = this->scanValues(
+        domain,
+        prefix,
+        resume,
+        max,
+        [&response](const std::string& k, const std::string& v) {
+          response.push_back({{"k", k}, {"v", v}});
+          return true;
+        },
+        next_key);
+    if (!next_key.empty()) {
+      response.push_back({{"next", next_key}});
+    }
+    return status;
+  } else if (request.at("action") == "stats") {
+    return this->stats(response);
+  } else if (request.at("action") == "memory") {
+    uint64_t bytes = 0;
+    auto status = this->memoryUsage(bytes);
+    if (status.ok()) {
+      response.push_back({{"bytes", std::to_string(bytes)}});
+    }
+    return status;
   }
 
   return Status(1, "Unknown database plugin action");
@@ -280,6 +378,8 @@ Status getDatabaseValue(const std::string& domain,
     return Status(1, "Missing domain");
   }
 
+  ScopedProfile profile("database", domain);
+
   if (RegistryFactory::get().external()) {
     // External registries (extensions) do not have databases active.
     // It is not possible to use an extension-based database.
@@ -328,6 +428,8 @@ Status setDatabaseBatch(const std::string& domain,
     return Status(1, "Missing domain");
   }
 
+  ScopedProfile profile("database", domain);
+
   // External registries (extensions) do not have databases active.
   // It is not possible to use an extension-based database.
   if (RegistryFactory::get().external()) {
@@ -347,6 +449,24 @@ Status setDatabaseBatch(const std::string& domain,
   return plugin->putBatch(domain, data);
 }
 
+std::future<Status> setDatabaseBatchAsync(
+    const std::string& domain, const DatabaseStringValueList& data) {
+  // Extensions, and invalid requests, complete before returning.
+  if (domain.empty() || RegistryFactory::get().external()) {
+    std::promise<Status> promise;
+    promise.set_value(setDatabaseBatch(domain, data));
+    return promise.get_future();
+  }
+
+  ReadLock lock(kDatabaseReset);
+  if (!kDBInitialized) {
+    throw std::runtime_error("Cannot set database values");
+  }
+
+  auto plugin = getDatabasePlugin();
+  return plugin->putBatchAsync(domain, data);
+}
+
 Status setDatabaseValue(const std::string& domain,
                         const std::string& key,
                         int value) {
@@ -358,6 +478,8 @@ Status deleteDatabaseValue(const std::string& domain, const std::string& key) {
     return Status(1, "Missing domain");
   }
 
+  ScopedProfile profile("database", domain);
+
   if (RegistryFactory::get().external()) {
     // External registries (extensions) do not have databases active.
     // It is not possible to use an extension-based database.
@@ -382,6 +504,8 @@ Status deleteDatabaseRange(const std::string& domain,
     return Status(1, "Missing domain");
   }
 
+  ScopedProfile profile("database", domain);
+
   if (RegistryFactory::get().external()) {
     // External registries (extensions) do not have databases active.
     // It is not possible to use an extension-based database.
@@ -417,6 +541,8 @@ Status scanDatabaseKeys(const std::string& domain,
     return Status(1, "Missing domain");
   }
 
+  ScopedProfile profile("database", domain);
+
   if (RegistryFactory::get().external()) {
     // External registries (extensions) do not have databases active.
     // It is not possible to use an extension-based database.
@@ -444,6 +570,112 @@ Status scanDatabaseKeys(const std::string& domain,
   }
 }
 
+Status scanDatabaseValues(const std::string& domain,
+                          const std::string& prefix,
+                          const std::string& resume,
+                          uint64_t max,
+                          const DatabaseScanCallback& callback,
+                          std::string& next_key) {
+  next_key.clear();
+  if (domain.empty()) {
+    return Status(1, "Missing domain");
+  }
+
+  ScopedProfile profile("database", domain);
+
+  if (RegistryFactory::get().external()) {
+    // External registries (extensions) do not have databases active.
+    PluginRequest request = {{"action", "scan_values"},
+                             {"domain", domain},
+                             {"prefix", prefix},
+                             {"resume", resume},
+                             {"max", std::to_string(max)}};
+    PluginResponse response;
+    auto status = Registry::call("database", request, response);
+
+    bool stopped = false;
+    for (const auto& item : response) {
+      if (item.count("next") > 0) {
+        next_key = item.at("next");
+      } else if (item.count("k") == 0 || item.count("v") == 0) {
+        continue;
+      } else if (stopped) {
+        next_key = item.at("k");
+        break;
+      } else {
+        stopped = !callback(item.at("k"), item.at("v"));
+      }
+    }
+    return status;
+  }
+
+  ReadLock lock(kDatabaseReset);
+  if (!kDBInitialized) {
+    throw std::runtime_error("Cannot scan database values: " + prefix);
+  } else {
+    auto plugin = getDatabasePlugin();
+    return plugin->scanValues(domain, prefix, resume, max, callback, next_key);
+  }
+}
+
+Status scanDatabaseValues(const std::string& domain,
+                          const std::string& prefix,
+                          const DatabaseScanCallback& callback) {
+  std::string next_key;
+  return scanDatabaseValues(domain, prefix, "", 0, callback, next_key);
+}
+
+Status getDatabaseStats(PluginResponse& stats) {
+  if (RegistryFactory::get().external()) {
+    // External registries (extensions) do not have databases active.
+    PluginRequest request = {{"action", "stats"}};
+    return Registry::call("database", request, stats);
+  }
+
+  ReadLock lock(kDatabaseReset);
+  if (!kDBInitialized) {
+    return Status::failure("Database not initialized");
+  }
+
+  auto plugin = getDatabasePlugin();
+  if (plugin == nullptr) {
+    return Status::failure("Database plugin not found");
+  }
+  return plugin->stats(stats);
+}
+
+Status getDatabaseMemoryUsage(uint64_t& bytes) {
+  if (RegistryFactory::get().external()) {
+    PluginRequest request = {{"action", "memory"}};
+    PluginResponse response;
+    auto status = Registry::call("database", request, response);
+    if (!status.ok()) {
+      return status;
+    }
+
+    if (response.empty() || response[0].count("bytes") == 0) {
+      return Status::failure("Database plugin did not report memory");
+    }
+    auto value = tryTo<uint64_t>(response[0].at("bytes"));
+    if (value.isError()) {
+      return Status::failure("Invalid database memory usage");
+    }
+    bytes = value.take();
+    return Status::success();
+  }
+
+  ReadLock lock(kDatabaseReset);
+  if (!kDBInitialized) {
+    return Status::failure("Database not initialized");
+  }
+
+  auto plugin = getDatabasePlugin();
+  if (plugin == nullptr) {
+    return Status::failure("Database plugin not found");
+  }
+  return plugin->memoryUsage(bytes);
+}
+
 void resetDatabase() {
   PluginRequest request = {{"action", "reset"}};
   Registry::call("database", request);
@@ -742,6 +974,16 @@ class OsqueryDatabase final : public IDatabaseInterface {
                                   size_t max) const override {
     return osquery::scanDatabaseKeys(domain, keys, prefix, max);
   }
+
+  virtual Status scanDatabaseValues(const std::string& domain,
+                                    const std::string& prefix,
+                                    const std::string& resume,
+                                    uint64_t max,
+                                    const DatabaseScanCallback& callback,
+                                    std::string& next_key) const override {
+    return osquery::scanDatabaseValues(
+        domain, prefix, resume, max, callback, next_key);
+  }
 };
 
 IDatabaseInterface& getOsqueryDatabase() {
@@ -10,6 +10,7 @@
 #pragma once
 
 #include <atomic>
+#include <future>
 #include <string>
 #include <vector>
 
@@ -49,6 +50,9 @@ extern const std::string kEvents;
 /// The "domain" where the results of carve queries are stored.
 extern const std::string kCarves;
 
+/// The "domain" where the hash table keeps file hashes across restarts.
+extern const std::string kFileHashes;
+
 /// The key for the DB version
 extern const std::string kDbVersionKey;
 
@@ -132,6 +136,16 @@ class DatabasePlugin : public Plugin {
   virtual Status putBatch(const std::string& domain,
                           const DatabaseStringValueList& data) = 0;
 
+  /**
+   * @brief Store a batch without waiting for the write.
+   *
+   * Plugins may combine the batch with other pending writes. The future holds
+   * the status of the write once it is stored. The default stores the batch
+   * before returning.
+   */
+  virtual std::future<Status> putBatchAsync(
+      const std::string& domain, const DatabaseStringValueList& data);
+
   /// Data removal method.
   virtual Status remove(const std::string& domain, const std::string& k) = 0;
 
@@ -145,6 +159,40 @@ class DatabasePlugin : public Plugin {
                       const std::string& prefix,
                       uint64_t max) const;
 
+  /**
+   * @brief Visit the keys starting with a prefix and their values in order.
+   *
+   * Keys are not collected, so large domains can be read without holding
+   * every key. The default scans the keys, then gets each value.
+   *
+   * @param resume Start at this key, the next_key of a previous scan.
+   * @param max Stop after this many keys, 0 for no limit.
+   * @param callback Called for each key, returns false to stop. Scans hold
+   * the database reset lock, so the callback must not use the database.
+   * @param next_key Set to the first key that was not visited, empty if the
+   * scan reached the end of the prefix.
+   */
+  virtual Status scanValues(const std::string& domain,
+                            const std::string& prefix,
+                            const std::string& resume,
+                            uint64_t max,
+                            const DatabaseScanCallback& callback,
+                            std::string& next_key) const;
+
+  /**
+   * @brief Report backing storage statistics, one row for each domain.
+   *
+   * Plugins without statistics report no rows.
+   */
+  virtual Status stats(PluginResponse& results) const;
+
+  /**
+   * @brief Report the bytes of caches and write buffers held in memory.
+   *
+   * Plugins that cannot measure their memory return a failure.
+   */
+  virtual Status memoryUsage(uint64_t& bytes) const;
+
   /**
    * @brief Shutdown the database and release initialization resources.
    *
@@ -226,6 +274,15 @@ Status setDatabaseValue(const std::string& domain,
 Status setDatabaseBatch(const std::string& domain,
                         const DatabaseStringValueList& data);
 
+/**
+ * @brief Queue a batch of values without waiting for the write.
+ *
+ * Callers that need the values to be stored wait for the future. Reads may
+ * not see the values before the future completes.
+ */
+std::future<Status> setDatabaseBatchAsync(const std::string& domain,
+                                          const DatabaseStringValueList& data);
+
 /// Remove a domain/key identified value from backing-store.
 Status deleteDatabaseValue(const std::string& domain, const std::string& key);
 
@@ -245,6 +302,30 @@ Status scanDatabaseKeys(const std::string& domain,
                         const std::string& prefix,
                         uint64_t max = 0);
 
+/**
+ * @brief Visit the keys starting with a prefix and their values in order.
+ *
+ * See DatabasePlugin::scanValues, callers may resume a scan that stopped
+ * after max keys from its next_key.
+ */
+Status scanDatabaseValues(const std::string& domain,
+                          const std::string& prefix,
+                          const std::string& resume,
+                          uint64_t max,
+                          const DatabaseScanCallback& callback,
+                          std::string& next_key);
+
+/// Visit every key starting with a prefix and its value.
+Status scanDatabaseValues(const std::string& domain,
+                          const std::string& prefix,
+                          const DatabaseScanCallback& callback);
+
+/// Get the statistics of the active database plugin, one row per domain.
+Status getDatabaseStats(PluginResponse& stats);
+
+/// Get the bytes of memory used by the active database plugin.
+Status getDatabaseMemoryUsage(uint64_t& bytes);
+
 /// Allow callers to reload or reset the database plugin.
 void resetDatabase();
 
@@ -9,28 +9,63 @@
 
 #include <osquery/database/database.h>
 #include <osquery/registry/registry_factory.h>
+#include <osquery/utils/mutex.h>
 
 #include <boost/variant.hpp>
 
-#include <iostream>
+#include <algorithm>
+#include <array>
+#include <map>
+#include <memory>
+#include <unordered_map>
 
 namespace osquery {
 
 class EphemeralDatabasePlugin : public DatabasePlugin {
-  using DBType =
-      std::map<std::string,
-               std::map<std::string, boost::variant<int, std::string>>>;
+  using Value = boost::variant<int, std::string>;
+
+  /// Keys are spread over shards so writers of different keys rarely wait.
+  struct Shard {
+    mutable Mutex mutex;
+    std::unordered_map<std::string, Value> values;
+  };
+
+  /// Number of shards of each domain.
+  static constexpr size_t kShards{16};
+
+  /**
+   * @brief The keys and values of a domain.
+   *
+   * Shards are hash maps, scans sort the keys matching their prefix instead
+   * of keeping every domain ordered.
+   */
+  struct Domain {
+    std::array<Shard, kShards> shards;
+
+    Shard& shard(const std::string& key) {
+      return shards[std::hash<std::string>()(key) % kShards];
+    }
+
+    const Shard& shard(const std::string& key) const {
+      return shards[std::hash<std::string>()(key) % kShards];
+    }
+  };
+
+  using DBType = std::map<std::string, std::unique_ptr<Domain>>;
+
   template <typename T>
   Status getAny(const std::string& domain,
                 const std::string& key,
                 T& value) const;
 
  private:
-  void setValue(const std::string& domain,
-                const std::string& key,
-                const std::string& value);
+  /// Find a domain, nullptr if nothing was written to it.
+  const Domain* findDomain(const std::string& domain) const;
+
+  /// Find a domain, creating it if needed.
+  Domain& getDomain(const std::string& domain);
 
-  void setValue(const std::string& domain, const std::string& key, int value);
+  void setValue(const std::string& domain, const std::string& key, Value value);
 
  public:
   /// Data retrieval method.
@@ -65,31 +100,83 @@ class EphemeralDatabasePlugin : public DatabasePlugin {
               const std::string& prefix,
               uint64_t max) const override;
 
+  Status scanValues(const std::string& domain,
+                    const std::string& prefix,
+                    const std::string& resume,
+                    uint64_t max,
+                    const DatabaseScanCallback& callback,
+                    std::string& next_key) const override;
+
+ private:
+  /// The sorted keys of a domain starting with a prefix, from a start key.
+  std::vector<std::string> sortedKeys(const Domain& domain_values,
+                                      const std::string& prefix,
+                                      const std::string& start,
+                                      uint64_t max) const;
+
  public:
   /// Database workflow: open and setup.
-  Status setUp() override {
-    DBType().swap(db_);
-    return Status(0);
-  }
+  Status setUp() override;
 
  private:
   DBType db_;
+
+  /// Protects the set of domains, not their contents.
+  mutable Mutex domains_mutex_;
 };
 
 /// Backing-storage provider for osquery internal/core.
 REGISTER_INTERNAL(EphemeralDatabasePlugin, "database", "ephemeral");
 
+Status EphemeralDatabasePlugin::setUp() {
+  WriteLock lock(domains_mutex_);
+  DBType().swap(db_);
+
+  // Domains are known up front, so most lookups only take the read lock.
+  for (const auto& domain : kDomains) {
+    db_[domain] = std::make_unique<Domain>();
+  }
+  return Status(0);
+}
+
+const EphemeralDatabasePlugin::Domain* EphemeralDatabasePlugin::findDomain(
+    const std::string& domain) const {
+  ReadLock lock(domains_mutex_);
+  auto it = db_.find(domain);
+  return (it != db_.end()) ? it->second.get() : nullptr;
+}
+
+EphemeralDatabasePlugin::Domain& EphemeralDatabasePlugin::getDomain(
+    const std::string& domain) {
+  {
+    ReadLock lock(domains_mutex_);
+    auto it = db_.find(domain);
+    if (it != db_.end()) {
+      return *it->second;
+    }
+  }
+
+  WriteLock lock(domains_mutex_);
+  auto& entry = db_[domain];
+  if (entry == nullptr) {
+    entry = std::make_unique<Domain>();
+  }
+  return *entry;
+}
+
 template <typename T>
 Status EphemeralDatabasePlugin::getAny(const std::string& domain,
                                        const std::string& key,
                                        T& value) const {
-  auto domainIterator = db_.find(domain);
-  if (domainIterator == db_.end()) {
+  auto domain_values = findDomain(domain);
+  if (domain_values == nullptr) {
     return Status(1, "Domain " + domain + " does not exist");
   }
 
-  auto keyIterator = domainIterator->second.find(key);
-  if (keyIterator == domainIterator->second.end()) {
+  const auto& shard = domain_values->shard(key);
+  ReadLock lock(shard.mutex);
+  auto keyIterator = shard.values.find(key);
+  if (keyIterator == shard.values.end()) {
     return Status(1, "Key " + key + " in domain " + domain + " does not exist");
   }
 
@@ -116,14 +203,10 @@ Status EphemeralDatabasePlugin::get(const std::string& domain,
 
 void EphemeralDatabasePlugin::setValue(const std::string& domain,
                                        const std::string& key,
-                                       const std::string& value) {
-  db_[domain][key] = value;
-}
-
-void EphemeralDatabasePlugin::setValue(const std::string& domain,
-                                       const std::string& key,
-                                       int value) {
-  db_[domain][key] = value;
+                                       Value value) {
+  auto& shard = getDomain(domain).shard(key);
+  WriteLock lock(shard.mutex);
+  shard.values[key] = std::move(value);
 }
 
 Status EphemeralDatabasePlugin::put(const std::string& domain,
@@ -142,11 +225,14 @@ Status EphemeralDatabasePlugin::put(const std::string& domain,
 
 Status EphemeralDatabasePlugin::putBatch(const std::string& domain,
                                          const DatabaseStringValueList& data) {
+  auto& domain_values = getDomain(domain);
   for (const auto& p : data) {
     const auto& key = p.first;
     const auto& value = p.second;
 
-    setValue(domain, key, value);
+    auto& shard = domain_values.shard(key);
+    WriteLock lock(shard.mutex);
+    shard.values[key] = value;
   }
 
   return Status::success();
@@ -154,7 +240,9 @@ Status EphemeralDatabasePlugin::putBatch(const std::string& domain,
 
 Status EphemeralDatabasePlugin::remove(const std::string& domain,
                                        const std::string& k) {
-  db_[domain].erase(k);
+  auto& shard = getDomain(domain).shard(k);
+  WriteLock lock(shard.mutex);
+  shard.values.erase(k);
   return Status(0);
 }
 
@@ -165,37 +253,105 @@ Status EphemeralDatabasePlugin::removeRange(const std::string& domain,
     return Status::failure("Invalid range: low > high");
   }
 
+  for (auto& shard : getDomain(domain).shards) {
+    WriteLock lock(shard.mutex);
+    for (auto it = shard.values.begin(); it != shard.values.end();) {
+      if (it->first >= low && it->first <= high) {
+        it = shard.values.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  return Status(0);
+}
+
+std::vector<std::string> EphemeralDatabasePlugin::sortedKeys(
+    const Domain& domain_values,
+    const std::string& prefix,
+    const std::string& start,
+    uint64_t max) const {
   std::vector<std::string> keys;
-  for (const auto& it : db_[domain]) {
-    if (it.first >= low && it.first <= high) {
-      keys.push_back(it.first);
+  for (const auto& shard : domain_values.shards) {
+    ReadLock lock(shard.mutex);
+    for (const auto& it : shard.values) {
+      if (it.first.compare(0, prefix.size(), prefix) == 0 &&
+          it.first >= start) {
+        keys.push_back(it.first);
+      }
     }
   }
 
-  for (const auto& key : keys) {
-    db_[domain].erase(key);
+  // Results are in key order, like the persistent backing stores.
+  if (max > 0 && keys.size() > max) {
+    std::partial_sort(keys.begin(), keys.begin() + max, keys.end());
+    keys.resize(max);
+  } else {
+    std::sort(keys.begin(), keys.end());
   }
-  return Status(0);
+  return keys;
 }
 
 Status EphemeralDatabasePlugin::scan(const std::string& domain,
                                      std::vector<std::string>& results,
                                      const std::string& prefix,
                                      uint64_t max) const {
-  if (db_.count(domain) == 0) {
+  auto domain_values = findDomain(domain);
+  if (domain_values == nullptr) {
     return Status(0);
   }
 
-  for (const auto& key : db_.at(domain)) {
-    if (!prefix.empty() &&
-        !(std::mismatch(prefix.begin(), prefix.end(), key.first.begin())
-              .first == prefix.end())) {
-      continue;
-    }
-    results.push_back(key.first);
-    if (max > 0 && results.size() >= max) {
+  auto keys = sortedKeys(*domain_values, prefix, prefix, max);
+  results.insert(results.end(),
+                 std::make_move_iterator(keys.begin()),
+                 std::make_move_iterator(keys.end()));
+  return Status(0);
+}
+
+Status EphemeralDatabasePlugin::scanValues(const std::string& domain,
+                                           const std::string& prefix,
+                                           const std::string& resume,
+                                           uint64_t max,
+                                           const DatabaseScanCallback& callback,
+                                           std::string& next_key) const {
+  next_key.clear();
+  auto domain_values = findDomain(domain);
+  if (domain_values == nullptr) {
+    return Status(0);
+  }
+
+  // One more key than requested is the key to resume from.
+  auto keys = sortedKeys(*domain_values,
+                         prefix,
+                         (resume > prefix) ? resume : prefix,
+                         (max > 0) ? max + 1 : 0);
+
+  uint64_t count = 0;
+  bool stopped = false;
+  std::string value;
+  for (const auto& key : keys) {
+    if (stopped || (max > 0 && count >= max)) {
+      next_key = key;
       break;
     }
+
+    {
+      const auto& shard = domain_values->shard(key);
+      ReadLock lock(shard.mutex);
+      auto it = shard.values.find(key);
+      if (it == shard.values.end()) {
+        // Removed since the keys were listed.
+        continue;
+      }
+
+      const auto* string_value = boost::get<std::string>(&it->second);
+      value = (string_value != nullptr)
+                  ? *string_value
+                  : std::to_string(boost::get<int>(it->second));
+    }
+
+    ++count;
+    stopped = !callback(key, value);
   }
   return Status(0);
 }
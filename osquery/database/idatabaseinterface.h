@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -20,6 +21,10 @@ namespace osquery {
 using DatabaseStringValueList =
     std::vector<std::pair<std::string, std::string>>;
 
+/// Receives each key and value of a scan, returns false to stop the scan.
+using DatabaseScanCallback =
+    std::function<bool(const std::string& key, const std::string& value)>;
+
 class IDatabaseInterface {
  public:
   IDatabaseInterface() = default;
@@ -60,6 +65,13 @@ class IDatabaseInterface {
                                   const std::string& prefix,
                                   size_t max) const = 0;
 
+  virtual Status scanDatabaseValues(const std::string& domain,
+                                    const std::string& prefix,
+                                    const std::string& resume,
+                                    uint64_t max,
+                                    const DatabaseScanCallback& callback,
+                                    std::string& next_key) const = 0;
+
   IDatabaseInterface(const IDatabaseInterface&) = delete;
   IDatabaseInterface& operator=(const IDatabaseInterface&) = delete;
 };
@@ -12,6 +12,7 @@
 #include <osquery/core/query.h>
 #include <osquery/core/sql/diff_results.h>
 #include <osquery/core/sql/query_data.h>
+#include <osquery/core/sql/query_data_binary.h>
 #include <osquery/sql/tests/sql_test_utils.h>
 
 #include <gtest/gtest.h>
@@ -20,6 +21,9 @@
 
 namespace osquery {
 
+DECLARE_bool(decorations_top_level);
+DECLARE_bool(logger_numerics);
+
 class ResultsTests : public testing::Test {};
 
 TEST_F(ResultsTests, test_simple_diff) {
@@ -36,6 +40,127 @@ TEST_F(ResultsTests, test_simple_diff) {
   EXPECT_EQ(results.removed, o);
 }
 
+TEST_F(ResultsTests, test_digest_diff) {
+  RowTyped r1;
+  r1["foo"] = "bar";
+  RowTyped r2;
+  r2["foo"] = 1LL;
+  RowTyped r3;
+  r3["foo"] = 1.0;
+
+  QueryDataTyped previous = {r1, r1, r2};
+  QueryDataTyped current = {r3, r1, r2, r1, r1};
+  auto old_digests = digestQueryData(previous);
+
+  RowDigests digests;
+  RowDigests removed;
+  auto results = diff(old_digests, current, digests, removed);
+  EXPECT_EQ(digests, digestQueryData(current));
+  EXPECT_TRUE(removed.empty());
+
+  // Values of different types are different rows, extra copies are added.
+  QueryDataSet os(previous.begin(), previous.end());
+  auto expected = diff(os, current);
+  EXPECT_EQ(results.added, expected.added);
+  EXPECT_EQ(results.added, QueryDataTyped({r3, r1}));
+
+  // The added rows are the first and the last copy of r1.
+  auto added = diffAddedRows(old_digests, current, digests, removed);
+  EXPECT_EQ(added, std::vector<size_t>({0, 4}));
+
+  // Rows only known by their digest are removed.
+  results = diff(digests, previous, old_digests, removed);
+  EXPECT_TRUE(results.added.empty());
+  EXPECT_EQ(removed, digestQueryData({r1, r3}));
+}
+
+TEST_F(ResultsTests, test_row_digests) {
+  RowTyped r1;
+  r1["ab"] = "c";
+  RowTyped r2;
+  r2["a"] = "bc";
+  EXPECT_NE(digestRow(r1), digestRow(r2));
+
+  RowTyped zero;
+  zero["d"] = 0.0;
+  RowTyped negative_zero;
+  negative_zero["d"] = -0.0;
+  EXPECT_EQ(digestRow(zero), digestRow(negative_zero));
+
+  auto digests = digestQueryData({r1, r2, zero});
+  RowDigests output;
+  auto s = deserializeRowDigests(serializeRowDigests(digests), output);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(output, digests);
+
+  s = deserializeRowDigests("short", output);
+  EXPECT_FALSE(s.ok());
+}
+
+TEST_F(ResultsTests, test_visit_query_data_json) {
+  auto results = getSerializedQueryDataJSON();
+  QueryDataTyped output;
+  auto s = visitQueryDataJSON(
+      results.first, [&output](RowTyped&& row) { output.push_back(row); });
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(output, results.second);
+
+  // Nested values, booleans, and nulls are not row values.
+  output.clear();
+  s = visitQueryDataJSON(
+      R"([{"a":"1","b":[1,{"c":2}],"d":true,"e":null,"f":2.5}])",
+      [&output](RowTyped&& row) { output.push_back(row); });
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(output.size(), 1U);
+  RowTyped expected;
+  expected["a"] = "1";
+  expected["f"] = 2.5;
+  EXPECT_EQ(output[0], expected);
+
+  s = visitQueryDataJSON("{}", [](RowTyped&&) {});
+  EXPECT_FALSE(s.ok());
+}
+
+TEST_F(ResultsTests, test_serialize_query_data_binary) {
+  QueryDataTyped qd;
+  for (long long i = 0; i < 200; ++i) {
+    RowTyped r;
+    r["id"] = i - 100;
+    r["ratio"] = static_cast<double>(i) / 8;
+    if (i % 3 != 0) {
+      r["name"] = "name_" + std::to_string(i);
+    }
+    qd.push_back(std::move(r));
+  }
+
+  for (bool compress : {false, true}) {
+    std::string encoded;
+    auto s = serializeQueryDataBinary(qd, encoded, compress);
+    ASSERT_TRUE(s.ok());
+    EXPECT_TRUE(isQueryDataBinary(encoded));
+
+    QueryDataTyped output;
+    s = visitSerializedQueryData(
+        encoded, [&output](RowTyped&& row) { output.push_back(row); });
+    EXPECT_TRUE(s.ok()) << s.getMessage();
+    EXPECT_EQ(output, qd);
+
+    // Truncated content is an error rather than a partial result.
+    encoded.resize(encoded.size() - 1);
+    s = visitSerializedQueryData(encoded, [](RowTyped&&) {});
+    EXPECT_FALSE(s.ok());
+  }
+
+  // JSON results are read by the same visitor.
+  auto results = getSerializedQueryDataJSON();
+  EXPECT_FALSE(isQueryDataBinary(results.first));
+  QueryDataTyped output;
+  auto s = visitSerializedQueryData(
+      results.first, [&output](RowTyped&& row) { output.push_back(row); });
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(output, results.second);
+}
+
 TEST_F(ResultsTests, test_serialize_row) {
   auto results = getSerializedRow();
   auto doc = JSON::newObject();
@@ -126,6 +251,204 @@ TEST_F(ResultsTests, test_serialize_query_log_item_json) {
   EXPECT_EQ(results.first, json);
 }
 
+TEST_F(ResultsTests, test_serialize_snapshot_query_log_item) {
+  QueryLogItem item;
+  item.isSnapshot = true;
+  item.name = "snapshot_query";
+  item.identifier = "snapshot_host";
+  item.calendar_time = "no_time";
+  item.decorations["decoration"] = "value";
+  for (long long i = 0; i < 10; ++i) {
+    RowTyped r;
+    r["id"] = i;
+    r["ratio"] = 0.5;
+    r["name"] = "name_" + std::to_string(i);
+    item.snapshot_results.push_back(std::move(r));
+  }
+
+  std::vector<std::string> lines;
+  auto emit = [&lines](const std::string& line) { lines.push_back(line); };
+
+  // A single line matches the document serialization.
+  std::string expected;
+  ASSERT_TRUE(serializeQueryLogItemJSON(item, expected).ok());
+  auto s = serializeSnapshotQueryLogItem(item, false, 0, emit);
+  ASSERT_TRUE(s.ok());
+  EXPECT_EQ(lines, std::vector<std::string>({expected}));
+
+  // Events match the event serialization.
+  std::vector<std::string> events;
+  ASSERT_TRUE(serializeQueryLogItemAsEventsJSON(item, events).ok());
+  lines.clear();
+  s = serializeSnapshotQueryLogItem(item, true, 0, emit);
+  ASSERT_TRUE(s.ok());
+  EXPECT_EQ(lines, events);
+
+  // Chunks are complete snapshots that together hold every row.
+  lines.clear();
+  s = serializeSnapshotQueryLogItem(item, false, 100, emit);
+  ASSERT_TRUE(s.ok());
+  EXPECT_GT(lines.size(), 1U);
+  QueryDataTyped rows;
+  for (const auto& line : lines) {
+    auto doc = JSON::newObject();
+    ASSERT_TRUE(doc.fromString(line));
+    EXPECT_EQ(std::string(doc.doc()["name"].GetString()), "snapshot_query");
+    ASSERT_TRUE(deserializeQueryData(doc.doc()["snapshot"], rows).ok());
+  }
+  EXPECT_EQ(rows.size(), item.snapshot_results.size());
+
+  // A snapshot without rows is still logged once.
+  item.snapshot_results.clear();
+  lines.clear();
+  s = serializeSnapshotQueryLogItem(item, false, 100, emit);
+  ASSERT_TRUE(s.ok());
+  EXPECT_EQ(lines.size(), 1U);
+}
+
+TEST_F(ResultsTests, test_serialize_query_log_item_columnar) {
+  QueryLogItem item;
+  item.isSnapshot = true;
+  item.name = "columnar_query";
+  item.identifier = "columnar_host";
+  item.calendar_time = "no_time";
+  item.decorations["decoration"] = "value";
+  for (long long i = 0; i < 4; ++i) {
+    RowTyped r;
+    r["id"] = i;
+    r["name"] = "name_" + std::to_string(i);
+    if (i < 3) {
+      r["state"] = (i % 2 == 0) ? "down" : "up";
+    }
+    item.snapshot_results.push_back(std::move(r));
+  }
+
+  std::string json;
+  ASSERT_TRUE(serializeQueryLogItemColumnarJSON(item, json).ok());
+  auto doc = JSON::newObject();
+  ASSERT_TRUE(doc.fromString(json));
+  const auto& line = doc.doc();
+  EXPECT_EQ(std::string(line["name"].GetString()), "columnar_query");
+  EXPECT_EQ(std::string(line["decorations"]["decoration"].GetString()),
+            "value");
+  EXPECT_EQ(std::string(line["action"].GetString()), "snapshot");
+  EXPECT_EQ(line["rows"].GetUint64(), 4U);
+  EXPECT_EQ(line["removed"].GetUint64(), 0U);
+
+  // Distinct strings are written as they are.
+  const auto& names = line["columns"]["name"];
+  ASSERT_TRUE(names.IsArray());
+  ASSERT_EQ(names.Size(), 4U);
+  EXPECT_EQ(std::string(names[3].GetString()), "name_3");
+
+  // Repeated strings are written once, a missing value has no index.
+  const auto& states = line["columns"]["state"];
+  ASSERT_TRUE(states.IsObject());
+  ASSERT_EQ(states["dictionary"].Size(), 2U);
+  EXPECT_EQ(std::string(states["dictionary"][0].GetString()), "down");
+  ASSERT_EQ(states["indexes"].Size(), 4U);
+  EXPECT_EQ(states["indexes"][1].GetInt64(), 1);
+  EXPECT_EQ(states["indexes"][2].GetInt64(), 0);
+  EXPECT_EQ(states["indexes"][3].GetInt64(), -1);
+
+  // The removed rows of a diff come first.
+  item.isSnapshot = false;
+  item.results.removed = {item.snapshot_results[0]};
+  item.results.added = {item.snapshot_results[1], item.snapshot_results[2]};
+  FLAGS_logger_numerics = true;
+  ASSERT_TRUE(serializeQueryLogItemColumnarJSON(item, json).ok());
+  FLAGS_logger_numerics = false;
+  ASSERT_TRUE(doc.fromString(json));
+  EXPECT_EQ(std::string(doc.doc()["action"].GetString()), "diff");
+  EXPECT_EQ(doc.doc()["rows"].GetUint64(), 3U);
+  EXPECT_EQ(doc.doc()["removed"].GetUint64(), 1U);
+  const auto& ids = doc.doc()["columns"]["id"];
+  ASSERT_TRUE(ids.IsArray());
+  ASSERT_EQ(ids.Size(), 3U);
+  EXPECT_EQ(ids[0].GetInt64(), 0);
+  EXPECT_EQ(ids[2].GetInt64(), 2);
+
+  // A decoration replacing a field is written as in a document.
+  FLAGS_decorations_top_level = true;
+  item.decorations["rows"] = "decorated";
+  ASSERT_TRUE(serializeQueryLogItemColumnarJSON(item, json).ok());
+  FLAGS_decorations_top_level = false;
+  ASSERT_TRUE(doc.fromString(json));
+  EXPECT_EQ(std::string(doc.doc()["rows"].GetString()), "decorated");
+  EXPECT_TRUE(doc.doc()["columns"]["id"].IsArray());
+
+  // A diff without changes is not logged.
+  item.results.removed.clear();
+  item.results.added.clear();
+  ASSERT_TRUE(serializeQueryLogItemColumnarJSON(item, json).ok());
+  EXPECT_TRUE(json.empty());
+}
+
+TEST_F(ResultsTests, test_write_query_log_item_matches_document) {
+  QueryLogItem item;
+  item.isSnapshot = false;
+  item.name = "diff_query";
+  item.identifier = "diff_host";
+  item.calendar_time = "no_time";
+  item.time = 1;
+  item.epoch = 2;
+  item.counter = 3;
+  item.decorations["decoration"] = "\"quoted\"";
+  for (long long i = 0; i < 3; ++i) {
+    RowTyped r;
+    r["id"] = i;
+    r["ratio"] = 0.5;
+    r["name"] = "name_" + std::to_string(i);
+    item.results.added.push_back(r);
+    r["id"] = i + 10;
+    item.results.removed.push_back(std::move(r));
+  }
+
+  auto check = [&item]() {
+    auto doc = JSON::newObject();
+    ASSERT_TRUE(serializeQueryLogItem(item, doc).ok());
+    std::string expected;
+    ASSERT_TRUE(doc.toString(expected).ok());
+    std::string json;
+    ASSERT_TRUE(serializeQueryLogItemJSON(item, json).ok());
+    EXPECT_EQ(expected, json);
+
+    auto events_doc = JSON::newArray();
+    ASSERT_TRUE(serializeQueryLogItemAsEvents(item, events_doc).ok());
+    std::vector<std::string> expected_events;
+    for (const auto& event : events_doc.doc().GetArray()) {
+      rapidjson::StringBuffer sb;
+      rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+      event.Accept(writer);
+      expected_events.push_back(sb.GetString());
+    }
+    std::vector<std::string> events;
+    ASSERT_TRUE(serializeQueryLogItemAsEventsJSON(item, events).ok());
+    EXPECT_EQ(expected_events, events);
+  };
+
+  check();
+
+  FLAGS_logger_numerics = true;
+  check();
+  FLAGS_logger_numerics = false;
+
+  // Decorations are cached, a change must still be written.
+  item.decorations["other"] = "value";
+  FLAGS_decorations_top_level = true;
+  check();
+
+  // A decoration replacing a field is written through the document.
+  item.decorations["name"] = "decorated";
+  check();
+  FLAGS_decorations_top_level = false;
+
+  item.decorations.clear();
+  item.isSnapshot = true;
+  item.snapshot_results = item.results.added;
+  check();
+}
+
 TEST_F(ResultsTests, test_adding_duplicate_rows_to_query_data) {
   RowTyped r1, r2, r3;
   r1["foo"] = "bar";
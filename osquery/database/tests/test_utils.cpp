@@ -7,7 +7,9 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <future>
+#include <thread>
 
 #include <osquery/core/flags.h>
 #include <osquery/core/system.h>
@@ -269,4 +271,82 @@ void DatabasePluginTests::testScanLimit() {
   EXPECT_EQ(s.getMessage(), "OK");
   EXPECT_EQ(keys.size(), 2U);
 }
+
+void DatabasePluginTests::testConcurrentPut() {
+  std::vector<std::thread> writers;
+  for (size_t i = 0; i < 4; ++i) {
+    writers.emplace_back([this, i]() {
+      for (size_t j = 0; j < 100; ++j) {
+        auto key = "test_concurrent_" + std::to_string(i) + "_" +
+                   std::to_string(j);
+        EXPECT_TRUE(getPlugin()->put(kQueries, key, "value").ok());
+        std::string value;
+        EXPECT_TRUE(getPlugin()->get(kQueries, key, value).ok());
+        EXPECT_EQ(value, "value");
+      }
+    });
+  }
+  for (auto& writer : writers) {
+    writer.join();
+  }
+
+  std::vector<std::string> keys;
+  auto s = getPlugin()->scan(kQueries, keys, "test_concurrent_", 0);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(keys.size(), 400U);
+  EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+
+  keys.clear();
+  getPlugin()->scan(kQueries, keys, "test_concurrent_1_", 3);
+  EXPECT_EQ(keys,
+            std::vector<std::string>({"test_concurrent_1_0",
+                                      "test_concurrent_1_1",
+                                      "test_concurrent_1_10"}));
+}
+
+void DatabasePluginTests::testScanValues() {
+  getPlugin()->put(kQueries, "test_values_1", "a");
+  getPlugin()->put(kQueries, "test_values_2", "b");
+  getPlugin()->put(kQueries, "test_values_3", "c");
+  getPlugin()->put(kQueries, "test_other", "d");
+
+  DatabaseStringValueList values;
+  auto callback = [&values](const std::string& key, const std::string& value) {
+    values.push_back(std::make_pair(key, value));
+    return true;
+  };
+
+  std::string next_key;
+  auto s = getPlugin()->scanValues(
+      kQueries, "test_values_", "", 2, callback, next_key);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(values,
+            DatabaseStringValueList({{"test_values_1", "a"},
+                                     {"test_values_2", "b"}}));
+  EXPECT_EQ(next_key, "test_values_3");
+
+  // Resume from the next key until the end of the prefix.
+  values.clear();
+  s = getPlugin()->scanValues(
+      kQueries, "test_values_", next_key, 2, callback, next_key);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(values, DatabaseStringValueList({{"test_values_3", "c"}}));
+  EXPECT_TRUE(next_key.empty());
+
+  // The callback may stop the scan.
+  values.clear();
+  s = getPlugin()->scanValues(
+      kQueries,
+      "test_values_",
+      "",
+      0,
+      [&values](const std::string& key, const std::string& value) {
+        values.push_back(std::make_pair(key, value));
+        return false;
+      },
+      next_key);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(values.size(), 1U);
+  EXPECT_EQ(next_key, "test_values_2");
+}
 } // namespace osquery
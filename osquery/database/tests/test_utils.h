@@ -41,6 +41,12 @@
   }                                                                            \
   TEST_F(n, test_scan_limit) {                                                 \
     testScanLimit();                                                           \
+  }                                                                            \
+  TEST_F(n, test_concurrent_put) {                                             \
+    testConcurrentPut();                                                       \
+  }                                                                            \
+  TEST_F(n, test_scan_values) {                                                \
+    testScanValues();                                                          \
   }
 
 namespace osquery {
@@ -95,5 +101,7 @@ class DatabasePluginTests : public testing::Test {
   void testDeleteRange();
   void testScan();
   void testScanLimit();
+  void testConcurrentPut();
+  void testScanValues();
 };
 } // namespace osquery
@@ -69,6 +69,27 @@ void prettyPrint(const QueryData& results,
                  const std::vector<std::string>& columns,
                  std::map<std::string, size_t>& lengths);
 
+/**
+ * @brief Pretty print the header of results printed row by row
+ *
+ * The column names are used as minimum lengths. Rows printed afterward with
+ * generateRow have their values cut to the lengths.
+ *
+ * @param columns The order of the keys (since maps are unordered)
+ * @param lengths A mutable set of column lengths
+ */
+void prettyPrintHeader(const std::vector<std::string>& columns,
+                       std::map<std::string, size_t>& lengths);
+
+/**
+ * @brief Pretty print the closing separator of results printed row by row
+ *
+ * @param columns The order of the keys (since maps are unordered)
+ * @param lengths The column lengths used by prettyPrintHeader
+ */
+void prettyPrintFooter(const std::vector<std::string>& columns,
+                       const std::map<std::string, size_t>& lengths);
+
 /**
  * @brief JSON print a QueryData object
  *
@@ -79,6 +100,20 @@ void prettyPrint(const QueryData& results,
  */
 void jsonPrint(const QueryData& q);
 
+/// Print the opening of a JSON array of rows printed row by row.
+void jsonPrintBegin();
+
+/**
+ * @brief JSON print a row as an element of the array opened by jsonPrintBegin
+ *
+ * @param r The row to print
+ * @param first True for the first row of the array
+ */
+void jsonPrintRow(const Row& r, bool first);
+
+/// Print the closing of a JSON array opened by jsonPrintBegin.
+void jsonPrintEnd();
+
 /**
  * @brief JSON pretty print a QueryData object
  *
@@ -128,6 +163,8 @@ std::string generateHeader(const std::map<std::string, size_t>& lengths,
 /**
  * @brief Generate a row string for query results
  *
+ * Values longer than their column length are cut to the length.
+ *
  * @param r A row to analyze
  * @param lengths The data returned from computeQueryDataLengths
  * @param columns The order of the keys (since maps are unordered)
@@ -7,6 +7,7 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -24,6 +25,22 @@ DECLARE_string(nullvalue);
 
 static std::vector<char> kOffset = {0, 0};
 static std::string kToken = "|";
+static const std::string kTruncated = "...";
+
+/// Cut a value to a number of UTF-8 characters, marking the cut.
+static std::string truncateValue(const std::string& value, size_t size) {
+  size_t keep = (size > kTruncated.size()) ? size - kTruncated.size() : size;
+  auto it = value.begin();
+  for (size_t i = 0; i < keep && it != value.end(); ++i) {
+    incUtf8StringIterator(it, value.end());
+  }
+
+  std::string out(value.begin(), it);
+  if (keep < size) {
+    out += kTruncated;
+  }
+  return out;
+}
 
 std::string generateToken(const std::map<std::string, size_t>& lengths,
                           const std::vector<std::string>& columns) {
@@ -96,6 +113,9 @@ std::string generateRow(const Row& r,
       if (buffer_size >= 0) {
         size = static_cast<size_t>(buffer_size);
         out += r.at(column);
+      } else {
+        // The lengths were computed without this row, cut the value to fit.
+        out += truncateValue(r.at(column), lengths.at(column));
       }
     }
     out += std::string(size + 1, ' ');
@@ -116,33 +136,54 @@ void prettyPrint(const QueryData& results,
     return;
   }
 
-  // Call a final compute using the column names as minimum lengths.
-  computeRowLengths(results.front(), lengths, true);
+  prettyPrintHeader(columns, lengths);
+
+  // Iterate each row and pretty print.
+  for (const auto& row : results) {
+    printf("%s", generateRow(row, lengths, columns).c_str());
+  }
+  prettyPrintFooter(columns, lengths);
+}
+
+void prettyPrintHeader(const std::vector<std::string>& columns,
+                       std::map<std::string, size_t>& lengths) {
+  // Use the column names as minimum lengths.
+  for (const auto& col : columns) {
+    auto& length = lengths[col];
+    length = std::max(length, utf8StringSize(col));
+  }
 
   // Output a nice header wrapping the column names.
   auto separator = generateToken(lengths, columns);
   auto header = separator + generateHeader(lengths, columns) + separator;
   printf("%s", header.c_str());
+}
 
-  // Iterate each row and pretty print.
-  for (const auto& row : results) {
-    printf("%s", generateRow(row, lengths, columns).c_str());
-  }
-  printf("%s", separator.c_str());
+void prettyPrintFooter(const std::vector<std::string>& columns,
+                       const std::map<std::string, size_t>& lengths) {
+  printf("%s", generateToken(lengths, columns).c_str());
 }
 
 void jsonPrint(const QueryData& q) {
-  printf("[\n");
+  jsonPrintBegin();
   for (size_t i = 0; i < q.size(); ++i) {
-    std::string row_string;
+    jsonPrintRow(q[i], i == 0);
+  }
+  jsonPrintEnd();
+}
 
-    if (serializeRowJSON(q[i], row_string).ok()) {
-      printf("  %s", row_string.c_str());
-      if (i < q.size() - 1) {
-        printf(",\n");
-      }
-    }
+void jsonPrintBegin() {
+  printf("[\n");
+}
+
+void jsonPrintRow(const Row& r, bool first) {
+  std::string row_string;
+  if (serializeRowJSON(r, row_string).ok()) {
+    printf("%s  %s", first ? "" : ",\n", row_string.c_str());
   }
+}
+
+void jsonPrintEnd() {
   printf("\n]\n");
 }
 
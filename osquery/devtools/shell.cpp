@@ -71,6 +71,10 @@ SHELL_FLAG(string, pack, "", "Run all queries in a pack");
 SHELL_FLAG(bool, L, false, "List all table names");
 SHELL_FLAG(string, A, "", "Select all from a table");
 SHELL_FLAG(string, connect, "", "Connect to an extension socket");
+SHELL_FLAG(uint64,
+           pretty_buffer_rows,
+           1000,
+           "Rows used to size pretty columns before streaming (0 buffers all)");
 
 DECLARE_string(nullvalue);
 DECLARE_string(extensions_socket);
@@ -387,6 +391,8 @@ struct prettyprint_data {
   osquery::QueryData results;
   std::vector<std::string> columns;
   std::map<std::string, size_t> lengths;
+  /* Number of rows already printed, these are not kept in results */
+  size_t printed{0};
 };
 
 /*
@@ -543,6 +549,38 @@ static void interrupt_handler(int signal) {
 }
 #endif
 
+/*
+** Print or keep a row in pretty mode.  JSON rows are printed as they
+** come.  Pretty rows are kept until enough are seen to size the columns,
+** later rows are printed as they come.
+*/
+static void pretty_print_row(struct prettyprint_data* pp, osquery::Row r) {
+  if (osquery::FLAGS_json_pretty) {
+    pp->results.push_back(std::move(r));
+  } else if (osquery::FLAGS_json) {
+    if (pp->printed == 0) {
+      osquery::jsonPrintBegin();
+    }
+    osquery::jsonPrintRow(r, pp->printed++ == 0);
+  } else if (pp->printed > 0) {
+    printf("%s", osquery::generateRow(r, pp->lengths, pp->columns).c_str());
+    pp->printed++;
+  } else {
+    osquery::computeRowLengths(r, pp->lengths);
+    pp->results.push_back(std::move(r));
+    if (osquery::FLAGS_pretty_buffer_rows > 0 &&
+        pp->results.size() >= osquery::FLAGS_pretty_buffer_rows) {
+      osquery::prettyPrintHeader(pp->columns, pp->lengths);
+      for (const auto& row : pp->results) {
+        auto line = osquery::generateRow(row, pp->lengths, pp->columns);
+        printf("%s", line.c_str());
+      }
+      pp->printed = pp->results.size();
+      pp->results.clear();
+    }
+  }
+}
+
 /*
 ** This is the callback routine that the shell
 ** invokes for each row of a query result.
@@ -571,8 +609,7 @@ static int shell_callback(void* pArg,
                                        : std::string(azArg[i]);
       }
     }
-    osquery::computeRowLengths(r, p->prettyPrint->lengths);
-    p->prettyPrint->results.push_back(r);
+    pretty_print_row(p->prettyPrint, std::move(r));
     break;
   }
   case MODE_Line: {
@@ -802,7 +839,14 @@ static void pretty_print_if_needed(struct callback_data* pArg) {
     if (osquery::FLAGS_json_pretty) {
       osquery::jsonPrettyPrint(pArg->prettyPrint->results);
     } else if (osquery::FLAGS_json) {
-      osquery::jsonPrint(pArg->prettyPrint->results);
+      if (pArg->prettyPrint->printed > 0) {
+        osquery::jsonPrintEnd();
+      } else {
+        osquery::jsonPrint(pArg->prettyPrint->results);
+      }
+    } else if (pArg->prettyPrint->printed > 0) {
+      osquery::prettyPrintFooter(pArg->prettyPrint->columns,
+                                 pArg->prettyPrint->lengths);
     } else {
       osquery::prettyPrint(pArg->prettyPrint->results,
                            pArg->prettyPrint->columns,
@@ -811,6 +855,7 @@ static void pretty_print_if_needed(struct callback_data* pArg) {
     pArg->prettyPrint->results.clear();
     pArg->prettyPrint->columns.clear();
     pArg->prettyPrint->lengths.clear();
+    pArg->prettyPrint->printed = 0;
   }
 }
 
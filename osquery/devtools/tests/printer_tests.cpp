@@ -93,6 +93,21 @@ TEST_F(PrinterTests, test_generate_row) {
   EXPECT_EQ(results, expected);
 }
 
+TEST_F(PrinterTests, test_generate_row_truncated) {
+  // Lengths computed from the first row only, like a streamed result.
+  std::map<std::string, size_t> lengths;
+  computeRowLengths(q.front(), lengths);
+
+  auto results = generateRow(q.back(), lengths, order);
+  auto expected = "| Doctor Who | 20 | fish sticks... | 1 |\n";
+  EXPECT_EQ(results, expected);
+
+  Row r = {{"name", "Àlex Smithson"}};
+  lengths = {{"name", 8}};
+  results = generateRow(r, lengths, {"name"});
+  EXPECT_EQ(results, "| Àlex ... |\n");
+}
+
 TEST_F(PrinterTests, test_unicode) {
   Row r = {{"name", "Àlex Smith"}};
   std::map<std::string, size_t> lengths;
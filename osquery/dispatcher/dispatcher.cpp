@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+
 #include <osquery/core/flags.h>
 #include <osquery/dispatcher/dispatcher.h>
 #include <osquery/logger/logger.h>
@@ -17,15 +19,25 @@ namespace osquery {
 /// The worker_threads define the default thread pool size.
 FLAG(int32, worker_threads, 4, "Number of work dispatch threads");
 
+FLAG(uint64,
+     service_executor_threads,
+     1,
+     "Threads shared by timer-driven services (0 for a thread per service)");
+
 void InterruptibleRunnable::interrupt() {
   // Set the service as interrupted.
   if (!interrupted_.exchange(true)) {
     // Tear down the service's resources such that exiting the expected run
     // loop within ::start does not need to.
     stop();
-    std::lock_guard<std::mutex> lock(condition_lock);
-    // Cancel the run loop's pause request.
-    condition_.notify_one();
+    {
+      std::lock_guard<std::mutex> lock(condition_lock);
+      // Cancel every pause request, a service may pause on several threads.
+      condition_.notify_all();
+    }
+
+    // Periodic services wait within the executor rather than pause.
+    Dispatcher::notifyExecutor();
   }
 }
 
@@ -49,6 +61,23 @@ void InternalRunnable::run() {
   Dispatcher::removeService(this);
 }
 
+void PeriodicRunnable::start() {
+  auto delay = initialDelay();
+  while (!interrupted()) {
+    if (delay.count() > 0) {
+      pause(delay);
+      if (interrupted()) {
+        break;
+      }
+    }
+
+    delay = runOnce();
+    if (delay < std::chrono::milliseconds(0)) {
+      break;
+    }
+  }
+}
+
 Dispatcher& Dispatcher::instance() {
   static Dispatcher instance;
   return instance;
@@ -73,6 +102,16 @@ Status Dispatcher::addService(InternalRunnableRef service) {
       return Status(1, "Cannot add service, dispatcher is stopping");
     }
 
+    auto periodic = std::dynamic_pointer_cast<PeriodicRunnable>(service);
+    if (periodic != nullptr && FLAGS_service_executor_threads > 0) {
+      VLOG(1) << "Adding new periodic service: " << service->name() << " ("
+              << service.get() << ") in process " << platformGetPid();
+
+      self.services_.push_back(std::move(service));
+      self.schedulePeriodic(std::move(periodic));
+      return Status::success();
+    }
+
     auto thread = std::make_unique<std::thread>(
         std::bind(&InternalRunnable::run, &*service));
     VLOG(1) << "Adding new service: " << service->name() << " ("
@@ -85,6 +124,111 @@ Status Dispatcher::addService(InternalRunnableRef service) {
   return Status::success();
 }
 
+void Dispatcher::schedulePeriodic(PeriodicRunnableRef service) {
+  // The mutex_ is held by addService, it is always acquired before the
+  // executor_mutex_.
+  service->run_ = true;
+  auto due = std::chrono::steady_clock::now() + service->initialDelay();
+
+  std::lock_guard<std::mutex> lock(executor_mutex_);
+  periodic_.push_back({due, std::move(service)});
+  periodic_active_++;
+
+  // Never start more threads than there are services to run.
+  auto wanted = std::min<size_t>(FLAGS_service_executor_threads,
+                                 periodic_active_);
+  while (executor_threads_ < wanted) {
+    auto thread = std::make_unique<std::thread>(&Dispatcher::runExecutor);
+    VLOG(1) << "Adding new service executor thread: " << thread->get_id();
+    service_threads_.push_back(std::move(thread));
+    executor_threads_++;
+  }
+  executor_condition_.notify_one();
+}
+
+void Dispatcher::notifyExecutor() {
+  auto& self = instance();
+  std::lock_guard<std::mutex> lock(self.executor_mutex_);
+  self.executor_condition_.notify_all();
+}
+
+void Dispatcher::runExecutor() {
+  auto& self = instance();
+  setThreadName("ServiceExecutor");
+
+  std::unique_lock<std::mutex> lock(self.executor_mutex_);
+  while (self.periodic_active_ > 0) {
+    auto now = std::chrono::steady_clock::now();
+
+    // Release waiting services that were interrupted. A service that is due
+    // checks its interruption before running, like a service loop would.
+    std::vector<PeriodicRunnableRef> finished;
+    auto waiting = std::partition(
+        self.periodic_.begin(),
+        self.periodic_.end(),
+        [now](const PeriodicEntry& entry) {
+          return entry.due <= now || !entry.service->interrupted();
+        });
+    for (auto it = waiting; it != self.periodic_.end(); ++it) {
+      finished.push_back(std::move(it->service));
+    }
+    self.periodic_.erase(waiting, self.periodic_.end());
+
+    PeriodicRunnableRef service;
+    if (finished.empty() && !self.periodic_.empty()) {
+      auto next = std::min_element(
+          self.periodic_.begin(),
+          self.periodic_.end(),
+          [](const PeriodicEntry& lhs, const PeriodicEntry& rhs) {
+            return lhs.due < rhs.due;
+          });
+      if (next->due > now) {
+        self.executor_condition_.wait_until(lock, next->due);
+        continue;
+      }
+
+      service = std::move(next->service);
+      self.periodic_.erase(next);
+    } else if (finished.empty()) {
+      // Every remaining service is running within another executor thread.
+      self.executor_condition_.wait(lock);
+      continue;
+    }
+
+    if (service != nullptr) {
+      lock.unlock();
+      auto delay = PeriodicRunnable::kFinished;
+      if (!service->interrupted()) {
+        setThreadName(service->name());
+        delay = service->runOnce();
+        setThreadName("ServiceExecutor");
+      }
+      lock.lock();
+
+      if (delay >= std::chrono::milliseconds(0)) {
+        auto due = std::chrono::steady_clock::now() + delay;
+        self.periodic_.push_back({due, std::move(service)});
+        continue;
+      }
+      finished.push_back(std::move(service));
+    }
+
+    // Services are removed without the executor_mutex_, see schedulePeriodic.
+    self.periodic_active_ -= finished.size();
+    lock.unlock();
+    for (const auto& done : finished) {
+      VLOG(1) << "Periodic service: " << done.get() << " has finished";
+      removeService(done.get());
+    }
+    finished.clear();
+    lock.lock();
+
+    // Idle executor threads exit once no periodic services remain.
+    self.executor_condition_.notify_all();
+  }
+  self.executor_threads_--;
+}
+
 void Dispatcher::resetStopping() {
   WriteLock lock(mutex_);
   stopping_ = false;
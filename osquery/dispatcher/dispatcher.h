@@ -110,10 +110,49 @@ class InternalRunnable : private boost::noncopyable,
 
  private:
   std::atomic<bool> run_{false};
+
+ private:
+  friend class Dispatcher;
+};
+
+/**
+ * @brief A service that only wakes on a timer.
+ *
+ * Rather than looping within start, a periodic service performs one unit of
+ * work in runOnce and returns the delay until it should run again. The
+ * Dispatcher runs periodic services cooperatively on a small shared set of
+ * executor threads, see the service_executor_threads flag, so a runOnce
+ * should not block for long. Services that block on I/O should remain plain
+ * InternalRunnables with a dedicated thread.
+ */
+class PeriodicRunnable : public InternalRunnable {
+ public:
+  explicit PeriodicRunnable(const std::string& name)
+      : InternalRunnable(name) {}
+  virtual ~PeriodicRunnable() override = default;
+
+  /// Returned by runOnce when the service has no more work.
+  static constexpr std::chrono::milliseconds kFinished{-1};
+
+ protected:
+  /// Perform one unit of work and return the delay until the next.
+  virtual std::chrono::milliseconds runOnce() = 0;
+
+  /// The delay before the first runOnce.
+  virtual std::chrono::milliseconds initialDelay() {
+    return std::chrono::milliseconds(0);
+  }
+
+  /// Loop over runOnce when the service is given a dedicated thread.
+  void start() override;
+
+ private:
+  friend class Dispatcher;
 };
 
 /// An internal runnable used throughout osquery as dispatcher services.
 using InternalRunnableRef = std::shared_ptr<InternalRunnable>;
+using PeriodicRunnableRef = std::shared_ptr<PeriodicRunnable>;
 using InternalThreadRef = std::unique_ptr<std::thread>;
 
 /**
@@ -159,6 +198,15 @@ class Dispatcher : private boost::noncopyable {
   /// When a service ends, it will remove itself from the dispatcher.
   static void removeService(const InternalRunnable* service);
 
+  /// Queue a periodic service, starting executor threads as needed.
+  void schedulePeriodic(PeriodicRunnableRef service);
+
+  /// The entrypoint of an executor thread, runs until no periodic services.
+  static void runExecutor();
+
+  /// Wake the executor threads so they notice an interrupted service.
+  static void notifyExecutor();
+
  public:
   /// For testing only, reset the stopping status for unittests.
   void resetStopping();
@@ -186,8 +234,32 @@ class Dispatcher : private boost::noncopyable {
    */
   bool stopping_{false};
 
+  /// A periodic service waiting for an executor thread.
+  struct PeriodicEntry {
+    /// When the service should next run.
+    std::chrono::steady_clock::time_point due;
+
+    PeriodicRunnableRef service;
+  };
+
+  /// Periodic services waiting to run, not ordered.
+  std::vector<PeriodicEntry> periodic_;
+
+  /// The number of periodic services waiting or running.
+  size_t periodic_active_{0};
+
+  /// The number of live executor threads.
+  size_t executor_threads_{0};
+
+  /// Protection around the periodic services and executor threads.
+  std::mutex executor_mutex_;
+
+  /// Wake the executor when services are added or interrupted.
+  std::condition_variable executor_condition_;
+
  private:
   friend class InternalRunnable;
+  friend class InterruptibleRunnable;
 
   // Tests
   friend class ConfigTests;
@@ -25,30 +25,72 @@ FLAG(uint64,
      60,
      "Seconds between polling for new queries (default 60)")
 
+FLAG(bool,
+     distributed_adaptive_interval,
+     false,
+     "Read sooner after distributed work arrives, back off while idle");
+
 DECLARE_bool(disable_distributed);
 DECLARE_string(distributed_plugin);
+DECLARE_uint64(distributed_long_poll);
 
 const size_t kDistributedAccelerationInterval = 5;
 
+/// The first adaptive delay after a read returned work.
+const std::chrono::milliseconds kDistributedAdaptiveDelay{1000};
+
 void DistributedRunner::start() {
   auto dist = Distributed();
   while (!interrupted()) {
+    auto read_start = std::chrono::steady_clock::now();
     dist.pullUpdates();
+    auto read_time = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - read_start);
+
+    auto work = !dist.getPendingQueries().empty();
     dist.runQueries();
     dist.cleanupExpiredRunningQueries();
 
-    std::string accelerate_checkins_expire_str = "-1";
-    Status status = getDatabaseValue(kPersistentSettings,
-                                     "distributed_accelerate_checkins_expire",
-                                     accelerate_checkins_expire_str);
-    if (!status.ok() || getUnixTime() > tryTo<unsigned long int>(
-                                            accelerate_checkins_expire_str, 10)
-                                            .takeOr(0ul)) {
-      pause(std::chrono::seconds(FLAGS_distributed_interval));
+    pause(getPollDelay(work, read_time));
+  }
+}
+
+std::chrono::milliseconds DistributedRunner::getPollDelay(
+    bool work, std::chrono::milliseconds read_time) {
+  std::chrono::milliseconds interval =
+      std::chrono::seconds(FLAGS_distributed_interval);
+
+  std::string accelerate_checkins_expire_str = "-1";
+  Status status = getDatabaseValue(kPersistentSettings,
+                                   "distributed_accelerate_checkins_expire",
+                                   accelerate_checkins_expire_str);
+  if (status.ok() && getUnixTime() <= tryTo<unsigned long int>(
+                                          accelerate_checkins_expire_str, 10)
+                                          .takeOr(0ul)) {
+    interval = std::chrono::seconds(kDistributedAccelerationInterval);
+  }
+
+  // A server without long poll support answers at once, and is polled at the
+  // normal interval.
+  if (FLAGS_distributed_long_poll > 0 &&
+      (work ||
+       read_time >= std::chrono::seconds(FLAGS_distributed_long_poll) / 2)) {
+    return std::chrono::milliseconds(0);
+  }
+
+  if (FLAGS_distributed_adaptive_interval) {
+    if (work) {
+      adaptive_delay_ = kDistributedAdaptiveDelay;
     } else {
-      pause(std::chrono::seconds(kDistributedAccelerationInterval));
+      adaptive_delay_ *= 2;
+    }
+
+    if (adaptive_delay_.count() > 0 && adaptive_delay_ < interval) {
+      return adaptive_delay_;
     }
+    adaptive_delay_ = std::chrono::milliseconds(0);
   }
+  return interval;
 }
 
 Status startDistributed() {
@@ -9,6 +9,10 @@
 
 #pragma once
 
+#include <chrono>
+
+#include <gtest/gtest_prod.h>
+
 #include <osquery/dispatcher/dispatcher.h>
 
 namespace osquery {
@@ -22,6 +26,27 @@ class DistributedRunner : public InternalRunnable {
  public:
   /// The Dispatcher thread entry point.
   void start() override;
+
+ protected:
+  /**
+   * @brief Get the delay before the next distributed read.
+   *
+   * A read the server held as a long poll, or that returned work, is
+   * followed by the next read right away. With an adaptive interval, reads
+   * after work start 1 second apart and back off to distributed_interval.
+   *
+   * @param work True if the last read returned queries.
+   * @param read_time How long the last read took.
+   */
+  std::chrono::milliseconds getPollDelay(bool work,
+                                         std::chrono::milliseconds read_time);
+
+ private:
+  /// The adaptive delay since the last work, 0 when idle.
+  std::chrono::milliseconds adaptive_delay_{0};
+
+ private:
+  FRIEND_TEST(SchedulerTests, test_distributed_poll_delay);
 };
 
 Status startDistributed();
@@ -0,0 +1,287 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#ifdef OSQUERY_WINDOWS
+#include <osquery/utils/system/system.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <pthread.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#include <osquery/dispatcher/dispatcher.h>
+#include <osquery/dispatcher/query_budget.h>
+#include <osquery/logger/logger.h>
+#include <osquery/utils/mutex.h>
+#include <osquery/utils/status/status.h>
+
+#ifdef OSQUERY_LINUX
+#include <osquery/filesystem/linux/proc.h>
+#endif
+
+namespace osquery {
+
+namespace {
+
+/// How often running query budgets are sampled.
+const std::chrono::milliseconds kQueryBudgetPeriod{100};
+
+/// The CPU time used by a single thread.
+class ThreadCpuClock : private boost::noncopyable {
+ public:
+  /// Measure the calling thread.
+  ThreadCpuClock();
+  ~ThreadCpuClock();
+
+  /// CPU milliseconds used by the thread, or 0 if it cannot be measured.
+  std::uint64_t milliseconds() const;
+
+ private:
+#ifdef OSQUERY_WINDOWS
+  HANDLE thread_{nullptr};
+#elif defined(__APPLE__)
+  mach_port_t thread_{MACH_PORT_NULL};
+#else
+  clockid_t clock_;
+  bool valid_{false};
+#endif
+};
+
+#ifdef OSQUERY_WINDOWS
+ThreadCpuClock::ThreadCpuClock() {
+  thread_ = OpenThread(
+      THREAD_QUERY_LIMITED_INFORMATION, FALSE, GetCurrentThreadId());
+}
+
+ThreadCpuClock::~ThreadCpuClock() {
+  if (thread_ != nullptr) {
+    CloseHandle(thread_);
+  }
+}
+
+std::uint64_t ThreadCpuClock::milliseconds() const {
+  FILETIME creation, exit, kernel, user;
+  if (thread_ == nullptr ||
+      !GetThreadTimes(thread_, &creation, &exit, &kernel, &user)) {
+    return 0;
+  }
+
+  // Thread times are in 100 nanosecond units.
+  ULARGE_INTEGER k, u;
+  k.LowPart = kernel.dwLowDateTime;
+  k.HighPart = kernel.dwHighDateTime;
+  u.LowPart = user.dwLowDateTime;
+  u.HighPart = user.dwHighDateTime;
+  return (k.QuadPart + u.QuadPart) / 10000;
+}
+#elif defined(__APPLE__)
+ThreadCpuClock::ThreadCpuClock() {
+  thread_ = pthread_mach_thread_np(pthread_self());
+}
+
+ThreadCpuClock::~ThreadCpuClock() {}
+
+std::uint64_t ThreadCpuClock::milliseconds() const {
+  thread_basic_info_data_t info;
+  mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+  if (thread_info(thread_,
+                  THREAD_BASIC_INFO,
+                  reinterpret_cast<thread_info_t>(&info),
+                  &count) != KERN_SUCCESS) {
+    return 0;
+  }
+
+  return (info.user_time.seconds + info.system_time.seconds) * 1000ULL +
+         (info.user_time.microseconds + info.system_time.microseconds) / 1000;
+}
+#else
+ThreadCpuClock::ThreadCpuClock() {
+  valid_ = (pthread_getcpuclockid(pthread_self(), &clock_) == 0);
+}
+
+ThreadCpuClock::~ThreadCpuClock() {}
+
+std::uint64_t ThreadCpuClock::milliseconds() const {
+  struct timespec ts;
+  if (!valid_ || clock_gettime(clock_, &ts) != 0) {
+    return 0;
+  }
+  return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+#endif
+
+/// The resident memory of this process, or 0 if it cannot be measured.
+std::uint64_t residentBytes() {
+#ifdef OSQUERY_LINUX
+  auto rss = getProcRSS("self");
+  return rss.isValue() ? rss.take() : 0;
+#else
+  return 0;
+#endif
+}
+
+} // namespace
+
+/// A running query and its limits, shared with the watcher service.
+struct QueryBudgetWatch {
+  std::string name;
+
+  /// CPU milliseconds the query may use, 0 for no limit.
+  std::uint64_t cpu_ms{0};
+
+  /// Resident memory growth the query may cause, 0 for no limit.
+  std::uint64_t memory_bytes{0};
+
+  /// The thread running the query and its CPU time when the query started.
+  ThreadCpuClock clock;
+  std::uint64_t cpu_start{0};
+
+  /**
+   * @brief The process resident memory the query's growth is measured from.
+   *
+   * Only the watcher service changes it once the query started.
+   */
+  std::uint64_t memory_start{0};
+
+  QueryCancellationRef cancellation;
+};
+
+namespace {
+
+Mutex kQueryBudgetsMutex;
+
+std::vector<std::shared_ptr<QueryBudgetWatch>> kQueryBudgets;
+
+/// Whether a watcher service is sampling the budgets.
+std::atomic<bool> kQueryBudgetRunning{false};
+
+/// Sample the running query budgets until no queries are running.
+class QueryBudgetRunner : public PeriodicRunnable {
+ public:
+  QueryBudgetRunner() : PeriodicRunnable("QueryBudgetRunner") {}
+
+ protected:
+  std::chrono::milliseconds runOnce() override;
+
+  std::chrono::milliseconds initialDelay() override {
+    return kQueryBudgetPeriod;
+  }
+
+  /// An interrupted watcher lets the next budget start another.
+  void stop() override {
+    kQueryBudgetRunning = false;
+  }
+};
+
+std::chrono::milliseconds QueryBudgetRunner::runOnce() {
+  std::vector<std::shared_ptr<QueryBudgetWatch>> watches;
+  {
+    WriteLock lock(kQueryBudgetsMutex);
+    if (kQueryBudgets.empty()) {
+      kQueryBudgetRunning = false;
+      return kFinished;
+    }
+    watches = kQueryBudgets;
+  }
+
+  bool memory = std::any_of(
+      watches.begin(),
+      watches.end(),
+      [](const std::shared_ptr<QueryBudgetWatch>& watch) {
+        return watch->memory_bytes > 0;
+      });
+  auto resident = (memory) ? residentBytes() : 0;
+
+  // Resident memory is measured for the whole process. While several
+  // queries run, for example with schedule_workers above 1, the growth
+  // cannot be attributed to one of them. It is only counted while a query
+  // runs alone, and the other queries' growth moves the baseline.
+  auto shared = (watches.size() > 1);
+
+  for (const auto& watch : watches) {
+    if (shared && resident > watch->memory_start) {
+      watch->memory_start = resident;
+    }
+
+    if (watch->cancellation->cancelled()) {
+      continue;
+    }
+
+    auto cpu = watch->clock.milliseconds();
+    if (watch->cpu_ms > 0 && cpu > watch->cpu_start &&
+        cpu - watch->cpu_start > watch->cpu_ms) {
+      watch->cancellation->cancel("exceeded the CPU budget of " +
+                                  std::to_string(watch->cpu_ms) + "ms");
+    } else if (watch->memory_bytes > 0 && resident > watch->memory_start &&
+               resident - watch->memory_start > watch->memory_bytes) {
+      watch->cancellation->cancel(
+          "exceeded the memory budget of " +
+          std::to_string(watch->memory_bytes / 1024 / 1024) + "MB");
+    }
+  }
+  return kQueryBudgetPeriod;
+}
+
+} // namespace
+
+QueryBudget::QueryBudget(const std::string& name,
+                         std::uint64_t cpu_ms,
+                         std::uint64_t memory_bytes)
+    : watch_(std::make_shared<QueryBudgetWatch>()),
+      previous_(QueryCancellation::kCurrent) {
+  watch_->name = name;
+  watch_->cpu_ms = cpu_ms;
+  watch_->memory_bytes = memory_bytes;
+  watch_->cpu_start = watch_->clock.milliseconds();
+  watch_->memory_start = (memory_bytes > 0) ? residentBytes() : 0;
+  watch_->cancellation = std::make_shared<QueryCancellation>();
+  QueryCancellation::kCurrent = watch_->cancellation;
+
+  bool start = false;
+  {
+    WriteLock lock(kQueryBudgetsMutex);
+    kQueryBudgets.push_back(watch_);
+    start = !kQueryBudgetRunning.exchange(true);
+  }
+
+  // The dispatcher is not called while holding the budgets lock, since it
+  // stops services while holding its own.
+  if (start &&
+      !Dispatcher::addService(std::make_shared<QueryBudgetRunner>()).ok()) {
+    kQueryBudgetRunning = false;
+    VLOG(1) << "Cannot enforce the budget of query " << name;
+  }
+}
+
+QueryBudget::~QueryBudget() {
+  {
+    WriteLock lock(kQueryBudgetsMutex);
+    kQueryBudgets.erase(
+        std::remove(kQueryBudgets.begin(), kQueryBudgets.end(), watch_),
+        kQueryBudgets.end());
+  }
+  QueryCancellation::kCurrent = previous_;
+}
+
+bool QueryBudget::exceeded() const {
+  return watch_->cancellation->cancelled();
+}
+
+std::string QueryBudget::reason() const {
+  return watch_->cancellation->reason();
+}
+
+} // namespace osquery
@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core/query_cancellation.h>
+
+namespace osquery {
+
+struct QueryBudgetWatch;
+
+/**
+ * @brief Enforce CPU time and memory limits on the query run by this thread.
+ *
+ * While a budget exists the queries run by the creating thread share its
+ * cancellation. A watcher service samples the thread's CPU time and the
+ * growth of the process resident memory, and cancels the query when either
+ * exceeds its limit. The query then fails on its own, rather than the
+ * watchdog stopping the worker.
+ *
+ * CPU time is only measured on the creating thread, so time spent by table
+ * prefetch and generator threads is not counted. Memory limits are only
+ * enforced on Linux.
+ */
+class QueryBudget : private boost::noncopyable {
+ public:
+  /**
+   * @brief Start the budget of a query.
+   *
+   * @param name The query name, used when it is cancelled.
+   * @param cpu_ms CPU milliseconds the thread may use, 0 for no limit.
+   * @param memory_bytes Resident memory growth allowed, 0 for no limit.
+   */
+  QueryBudget(const std::string& name,
+              std::uint64_t cpu_ms,
+              std::uint64_t memory_bytes);
+  ~QueryBudget();
+
+  /// Check if the query was cancelled for exceeding the budget.
+  bool exceeded() const;
+
+  /// A description of the exceeded limit.
+  std::string reason() const;
+
+ private:
+  /// The watched state, shared with the watcher service.
+  std::shared_ptr<QueryBudgetWatch> watch_;
+
+  /// The cancellation of an enclosing query, restored afterward.
+  QueryCancellationRef previous_;
+};
+
+} // namespace osquery
@@ -8,9 +8,16 @@
  */
 
 #include "osquery/dispatcher/scheduler.h"
+#include "osquery/dispatcher/query_budget.h"
+#include "osquery/dispatcher/scheduler_stats.h"
 
 #include <algorithm>
+#include <atomic>
 #include <ctime>
+#include <functional>
+#include <limits>
+#include <map>
+#include <thread>
 
 #include <boost/format.hpp>
 #include <boost/io/quoted.hpp>
@@ -19,19 +26,31 @@
 #include <osquery/config/config.h>
 #include <osquery/core/core.h>
 #include <osquery/core/flags.h>
+#include <osquery/core/flight_recorder.h>
 #include <osquery/core/query.h>
+#include <osquery/core/query_accounting.h>
 #include <osquery/core/shutdown.h>
+#include <osquery/core/startup_trace.h>
+#include <osquery/core/watcher.h>
 #include <osquery/database/database.h>
 #include <osquery/logger/data_logger.h>
 #include <osquery/numeric_monitoring/numeric_monitoring.h>
 #include <osquery/process/process.h>
+#include <osquery/profiler/allocations.h>
 #include <osquery/profiler/code_profiler.h>
+#include <osquery/profiler/query_trace.h>
+#include <osquery/registry/registry.h>
 #include <osquery/sql/sqlite_util.h>
 #include <osquery/utils/expected/expected.h>
+#include <osquery/utils/mutex.h>
 #include <osquery/utils/system/time.h>
 #include <osquery/worker/system/memory.h>
 #include <plugins/config/parsers/decorators.h>
 
+#ifdef OSQUERY_LINUX
+#include <osquery/filesystem/linux/proc.h>
+#endif
+
 namespace osquery {
 
 FLAG(uint64,
@@ -53,6 +72,41 @@ FLAG(bool,
      false,
      "Log the running scheduled query name at INFO level");
 
+FLAG(uint64,
+     schedule_workers,
+     0,
+     "Threads running a schedule step's queries concurrently (0 or 1 runs "
+     "them serially)");
+
+FLAG(bool,
+     schedule_adaptive_splay,
+     false,
+     "Choose query phases from recorded performance to even out the "
+     "per-second cost");
+
+FLAG(uint64,
+     schedule_cpu_budget,
+     0,
+     "Per-second CPU milliseconds the adaptive splay warns above (0 for no "
+     "budget)");
+
+FLAG(uint64,
+     schedule_query_cpu_limit,
+     0,
+     "CPU milliseconds a scheduled query may use before it is cancelled and "
+     "denylisted (0 for no limit)");
+
+FLAG(uint64,
+     schedule_query_memory_limit,
+     0,
+     "Resident memory growth in MB a scheduled query may cause while it runs "
+     "alone before it is cancelled and denylisted (0 for no limit)");
+
+FLAG(string,
+     worker_shard_by,
+     "query",
+     "Partition the schedule across worker_shards by 'query' or 'pack' name");
+
 HIDDEN_FLAG(bool,
             schedule_reload_sql,
             false,
@@ -63,7 +117,22 @@ DECLARE_bool(events_optimize);
 DECLARE_bool(enable_numeric_monitoring);
 DECLARE_bool(verbose);
 
-SQLInternal monitor(const std::string& name, const ScheduledQuery& query) {
+/// Steps between enumerations of an unchanged schedule.
+const uint64_t kScheduleRefreshSteps{60};
+
+/// Steps between adaptive phase assignments of an unchanged schedule.
+const uint64_t kScheduleRebalanceSteps{600};
+
+/// The window of steps over which adaptive phases even out the cost.
+const uint64_t kSchedulePhaseWindow{3600};
+
+/// The most phases considered for a query with a long interval.
+const uint64_t kSchedulePhaseCandidates{60};
+
+SQLInternal monitor(const std::string& name,
+                    const ScheduledQuery& query,
+                    const SQLiteDBInstanceRef& instance) {
+  ScopedProfile profile("query", name);
   if (FLAGS_enable_numeric_monitoring) {
     CodeProfiler profiler(
         {(boost::format("scheduler.pack.%s") % query.pack_name).str(),
@@ -78,28 +147,43 @@ SQLInternal monitor(const std::string& name, const ScheduledQuery& query) {
           monitoring::hostIdentifierKeys().scheme % query.pack_name %
           query.name)
              .str()});
-    return SQLInternal(query.query, true);
+    return SQLInternal(query.query, true, instance);
   } else {
     // Snapshot the performance and times for the worker before running.
     auto pid = std::to_string(PlatformProcess::getCurrentPid());
-    auto r0 = SQL::selectFrom({"resident_size", "user_time", "system_time"},
-                              "processes",
-                              "pid",
-                              EQUALS,
-                              pid);
+    auto snapshot = [&pid, &instance]() {
+      if (instance == nullptr) {
+        return SQL::selectFrom({"resident_size", "user_time", "system_time"},
+                               "processes",
+                               "pid",
+                               EQUALS,
+                               pid);
+      }
+
+      // Concurrent queries snapshot through their own database.
+      QueryData rows;
+      queryInternal(
+          "SELECT resident_size, user_time, system_time FROM processes "
+          "WHERE pid = " +
+              pid,
+          rows,
+          instance);
+      instance->clearAffectedTables();
+      return rows;
+    };
+    auto r0 = snapshot();
 
     using namespace std::chrono;
     auto t0 = steady_clock::now();
     Config::get().recordQueryStart(name);
-    SQLInternal sql(query.query, true);
+    ScopedAllocationAccount allocations;
+    SQLInternal sql(query.query, true, instance);
+    auto allocated_bytes = allocations.allocated();
+    auto peak_bytes = allocations.peak();
 
     // Snapshot the performance after, and compare.
     auto t1 = steady_clock::now();
-    auto r1 = SQL::selectFrom({"resident_size", "user_time", "system_time"},
-                              "processes",
-                              "pid",
-                              EQUALS,
-                              pid);
+    auto r1 = snapshot();
     if (r0.size() > 0 && r1.size() > 0) {
       // Always called while processes table is working.
       uint64_t size = sql.getSize();
@@ -108,13 +192,20 @@ SQLInternal monitor(const std::string& name, const ScheduledQuery& query) {
           duration_cast<milliseconds>(t1 - t0).count(),
           size,
           r0[0],
-          r1[0]);
+          r1[0],
+          allocated_bytes,
+          peak_bytes);
     }
     return sql;
   }
 }
 
-Status launchQuery(const std::string& name, const ScheduledQuery& query) {
+Status launchQuery(const std::string& name,
+                   const ScheduledQuery& query,
+                   const SQLiteDBInstanceRef& instance,
+                   size_t& rows) {
+  ScopedQueryTrace trace("scheduled", name);
+
   // Execute the scheduled query and create a named query object.
   if (FLAGS_verbose) {
     VLOG(1) << "Executing scheduled query " << name << ": " << query.query;
@@ -123,12 +214,13 @@ Status launchQuery(const std::string& name, const ScheduledQuery& query) {
   }
   runDecorators(DECORATE_ALWAYS);
 
-  auto sql = monitor(name, query);
+  auto sql = monitor(name, query, instance);
   if (!sql.getStatus().ok()) {
     LOG(ERROR) << "Error executing scheduled query " << name << ": "
                << sql.getStatus().toString();
     return Status::failure("Error executing scheduled query");
   }
+  rows = sql.rowsTyped().size();
 
   // Fill in a host identifier fields based on configuration or availability.
   std::string ident = getHostIdentifier();
@@ -142,7 +234,7 @@ Status launchQuery(const std::string& name, const ScheduledQuery& query) {
   item.epoch = FLAGS_schedule_epoch;
   item.calendar_time = osquery::getAsciiTime();
   item.isSnapshot = false;
-  getDecorations(item.decorations);
+  item.decorations_generation = getDecorations(item.decorations);
 
   if (query.isSnapshotQuery()) {
     // This is a snapshot query, emit results without a differential or state.
@@ -167,12 +259,16 @@ Status launchQuery(const std::string& name, const ScheduledQuery& query) {
   // Add this execution's set of results to the database-tracked named query.
   // We can then ask for a differential from the last time this named query
   // was executed by exact matching each row.
-  if (!FLAGS_events_optimize || !sql.eventBased()) {
-    status = dbQuery.addNewResults(
-        std::move(sql.rowsTyped()), item.epoch, item.counter, diff_results);
-  } else {
-    status = dbQuery.addNewEvents(
-        std::move(sql.rowsTyped()), item.epoch, item.counter, diff_results);
+  {
+    ScopedTraceSpan span("diff");
+    if (!FLAGS_events_optimize || !sql.eventBased()) {
+      status = dbQuery.addNewResults(
+          std::move(sql.rowsTyped()), item.epoch, item.counter, diff_results);
+    } else {
+      status = dbQuery.addNewEvents(
+          std::move(sql.rowsTyped()), item.epoch, item.counter, diff_results);
+    }
+    span.setRows(diff_results.added.size() + diff_results.removed.size());
   }
 
   if (!status.ok()) {
@@ -205,12 +301,13 @@ Status launchQuery(const std::string& name, const ScheduledQuery& query) {
 }
 
 void SchedulerRunner::calculateTimeDriftAndMaybePause(
-    std::chrono::milliseconds loop_step_duration) {
-  if (loop_step_duration + time_drift_ < interval_) {
-    pause(interval_ - loop_step_duration - time_drift_);
+    std::chrono::milliseconds loop_step_duration, uint64_t steps) {
+  auto period = interval_ * steps;
+  if (loop_step_duration + time_drift_ < period) {
+    pause(period - loop_step_duration - time_drift_);
     time_drift_ = std::chrono::milliseconds::zero();
   } else {
-    time_drift_ += loop_step_duration - interval_;
+    time_drift_ += loop_step_duration - period;
     if (time_drift_ > max_time_drift_) {
       // giving up
       time_drift_ = std::chrono::milliseconds::zero();
@@ -246,7 +343,11 @@ void SchedulerRunner::maybeReloadSchedule(uint64_t time_step) {
 
     if (FLAGS_schedule_reload_sql) {
       SQLiteDBManager::resetPrimary();
+    } else {
+      // Release statements prepared for queries that may be unscheduled.
+      SQLiteDBManager::resetStatements();
     }
+    worker_instances_.clear();
     resetDatabase();
   }
 }
@@ -265,47 +366,474 @@ void SchedulerRunner::maybeFlushLogs(uint64_t time_step) {
   }
 }
 
+/// Copy a due query so it may run after the schedule is released.
+static ScheduledQuery copyScheduledQuery(const ScheduledQuery& query) {
+  ScheduledQuery copy(query.pack_name, query.name, query.query);
+  copy.oncall = query.oncall;
+  copy.interval = query.interval;
+  copy.splayed_interval = query.splayed_interval;
+  copy.denylisted = query.denylisted;
+  copy.options = query.options;
+  copy.diff_key = query.diff_key;
+  copy.diff_buckets = query.diff_buckets;
+  return copy;
+}
+
+/// Order the queue so the earliest deadline is at the front.
+template <typename Pending>
+static bool laterDeadline(const Pending& left, const Pending& right) {
+  return left.deadline > right.deadline;
+}
+
+/// The first step after time_step divisible by period.
+static uint64_t nextMultiple(uint64_t time_step, uint64_t period) {
+  return (time_step / period + 1) * period;
+}
+
+/// The first step at or after time_step where (step % interval) is phase.
+static uint64_t nextDeadline(uint64_t time_step,
+                             uint64_t interval,
+                             uint64_t phase) {
+  phase %= interval;
+  auto base = time_step - (time_step % interval) + phase;
+  return (base >= time_step) ? base : base + interval;
+}
+
+std::vector<uint64_t> assignSchedulePhases(
+    const std::vector<ScheduleLoad>& loads, uint64_t* peak) {
+  std::vector<uint64_t> phases(loads.size(), 0);
+  std::vector<uint64_t> window(kSchedulePhaseWindow, 0);
+
+  // The steps within the window a query runs on for a given phase.
+  auto forEachStep = [](const ScheduleLoad& load,
+                        uint64_t phase,
+                        const std::function<void(uint64_t)>& fn) {
+    if (load.interval >= kSchedulePhaseWindow) {
+      fn(phase % kSchedulePhaseWindow);
+      return;
+    }
+    for (auto step = phase; step < kSchedulePhaseWindow;
+         step += load.interval) {
+      fn(step);
+    }
+  };
+
+  // Place the most expensive queries first.
+  std::vector<size_t> order(loads.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&loads](size_t l, size_t r) {
+    return loads[l].cost > loads[r].cost;
+  });
+
+  for (auto i : order) {
+    const auto& load = loads[i];
+    if (load.interval == 0) {
+      continue;
+    }
+
+    auto candidates = std::min(load.interval, kSchedulePhaseCandidates);
+    uint64_t best_phase = 0;
+    uint64_t best_peak = std::numeric_limits<uint64_t>::max();
+    for (uint64_t c = 0; c < candidates; ++c) {
+      auto phase = c * load.interval / candidates;
+      uint64_t highest = 0;
+      forEachStep(load, phase, [&window, &highest](uint64_t step) {
+        highest = std::max(highest, window[step]);
+      });
+      if (highest < best_peak) {
+        best_peak = highest;
+        best_phase = phase;
+      }
+    }
+
+    phases[i] = best_phase;
+    forEachStep(load, best_phase, [&window, &load](uint64_t step) {
+      window[step] += load.cost;
+    });
+  }
+
+  if (peak != nullptr) {
+    *peak = *std::max_element(window.begin(), window.end());
+  }
+  return phases;
+}
+
+/// Record a value in the per-pack histogram, exported as percentile paths.
+static void recordPackPercentiles(const std::string& prefix,
+                                  monitoring::ValueType value) {
+  monitoring::record(prefix, value, monitoring::PreAggregationType::Histogram);
+}
+
+void SchedulerRunner::runScheduledQuery(uint64_t time_step,
+                                        const PendingQuery& pending,
+                                        const SQLiteDBInstanceRef& instance) {
+  using namespace std::chrono;
+  const auto& query = pending.query;
+
+  // The startup ends when the first scheduled query runs.
+  StartupTrace::get().ready();
+
+  // Lateness is the delay between the intended and actual start.
+  auto intended = first_step_time_ + interval_ * (time_step - first_step_);
+  auto started = steady_clock::now();
+  auto lateness = duration_cast<milliseconds>(started - intended).count();
+  lateness = std::max<decltype(lateness)>(lateness, 0);
+  if (FLAGS_enable_numeric_monitoring) {
+    monitoring::record((boost::format("scheduler.query.%s.%s.lateness") %
+                        query.pack_name % query.name)
+                           .str(),
+                       lateness,
+                       monitoring::PreAggregationType::Max,
+                       true);
+    monitoring::record("scheduler.lateness",
+                       lateness,
+                       monitoring::PreAggregationType::Max,
+                       true);
+  }
+
+  TablePlugin::kCacheInterval = query.splayed_interval;
+  TablePlugin::kCacheStep = time_step;
+  size_t rows = 0;
+  std::unique_ptr<QueryBudget> budget;
+  if (FLAGS_schedule_query_cpu_limit > 0 ||
+      FLAGS_schedule_query_memory_limit > 0) {
+    budget = std::make_unique<QueryBudget>(
+        pending.name,
+        FLAGS_schedule_query_cpu_limit,
+        FLAGS_schedule_query_memory_limit * 1024 * 1024);
+  }
+  // The watcher blames the query that used the most when it stops the worker.
+  ScopedQueryAccount account(pending.name, true);
+  ScopedFlightQuery flight(pending.name);
+  const auto status = launchQuery(pending.name, query, instance, rows);
+  auto duration =
+      duration_cast<milliseconds>(steady_clock::now() - started).count();
+  if (budget != nullptr && budget->exceeded()) {
+    // Only this query fails, the worker and its event state are kept.
+    LOG(WARNING) << "Scheduled query " << pending.name << " "
+                 << budget->reason() << " and was denylisted";
+    Config::get().denylistQuery(pending.name);
+  }
+  budget.reset();
+  monitoring::record((boost::format("scheduler.query.%s.%s.status.%s") %
+                      query.pack_name % query.name %
+                      (status.ok() ? "success" : "failure"))
+                         .str(),
+                     1,
+                     monitoring::PreAggregationType::Sum,
+                     true);
+
+  recordSchedulerStats(query.pack_name, lateness, duration, rows);
+  if (FLAGS_enable_numeric_monitoring) {
+    auto prefix = "scheduler.stats." + query.pack_name;
+    recordPackPercentiles(prefix + ".lateness_ms", lateness);
+    recordPackPercentiles(prefix + ".duration_ms", duration);
+    recordPackPercentiles(prefix + ".rows", static_cast<long long>(rows));
+  }
+}
+
+/**
+ * @brief Check if a query reads tables only the primary worker shard serves.
+ *
+ * Event-based tables are only filled, and extension tables only attached, in
+ * the primary worker. A query that does not compile in this worker, such as
+ * one reading an extension table from another shard, is also kept there.
+ * Every shard reaches the same answer for a query.
+ */
+static bool usesPrimaryShardTables(const std::string& sql) {
+  static Mutex cache_mutex;
+  static std::map<std::string, bool> cache;
+  {
+    WriteLock lock(cache_mutex);
+    auto it = cache.find(sql);
+    if (it != cache.end()) {
+      return it->second;
+    }
+  }
+
+  TableColumns columns;
+  bool primary = !getQueryColumns(sql, columns).ok();
+  if (!primary) {
+    std::vector<std::string> tables;
+    getQueryTables(sql, tables);
+    for (const auto& name : tables) {
+      if (!Registry::get().exists("table", name, true)) {
+        primary = true;
+        break;
+      }
+
+      auto table = std::dynamic_pointer_cast<TablePlugin>(
+          Registry::get().plugin("table", name));
+      if (table == nullptr ||
+          (table->attributes() & TableAttributes::EVENT_BASED) != 0) {
+        primary = true;
+        break;
+      }
+    }
+  }
+
+  WriteLock lock(cache_mutex);
+  cache[sql] = primary;
+  return primary;
+}
+
+size_t getScheduledQueryShard(const std::string& name,
+                              const ScheduledQuery& query,
+                              size_t shards) {
+  if (shards <= 1 || usesPrimaryShardTables(query.query)) {
+    return 0;
+  }
+
+  bool by_pack = FLAGS_worker_shard_by == "pack" && !query.pack_name.empty();
+  const auto& key = (by_pack) ? query.pack_name : name;
+
+  // FNV-1a, std::hash is not required to agree between processes.
+  uint64_t hash = 14695981039346656037ULL;
+  for (auto c : key) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ULL;
+  }
+  return static_cast<size_t>(hash % shards);
+}
+
+void SchedulerRunner::maybeRebuildQueue(uint64_t time_step) {
+  // Pack discovery and denylist expiration are evaluated while enumerating,
+  // so the schedule is also enumerated again on a fixed interval.
+  auto generation = Config::get().getScheduleGeneration();
+  bool changed = !queue_built_ || generation != queue_generation_;
+  if (!changed && (time_step % kScheduleRefreshSteps) != 0) {
+    return;
+  }
+
+  // Keep each query's phase and last run so a rebuild never runs it early.
+  std::map<std::string, std::pair<uint64_t, uint64_t>> previous;
+  for (const auto& pending : queue_) {
+    previous[pending.name] = std::make_pair(pending.phase, pending.last_run);
+  }
+
+  queue_.clear();
+  auto shard = getWorkerShard();
+  auto enqueue = [this, &previous, shard](const std::string& name,
+                                          const ScheduledQuery& query) {
+    if (query.splayed_interval == 0) {
+      return;
+    }
+
+    // Each worker shard runs its own part of the schedule.
+    if (getScheduledQueryShard(name, query, FLAGS_worker_shards) != shard) {
+      return;
+    }
+
+    PendingQuery pending;
+    pending.order = queue_.size();
+    pending.name = name;
+    pending.query = copyScheduledQuery(query);
+    auto it = previous.find(name);
+    if (it != previous.end()) {
+      pending.phase = it->second.first;
+      pending.last_run = it->second.second;
+    }
+    queue_.push_back(std::move(pending));
+  };
+  Config::get().scheduledQueries(enqueue);
+
+  if (!FLAGS_schedule_adaptive_splay) {
+    for (auto& pending : queue_) {
+      pending.phase = 0;
+    }
+  } else if (changed || (time_step % kScheduleRebalanceSteps) == 0) {
+    rebalanceQueue();
+  }
+
+  for (auto& pending : queue_) {
+    auto interval = pending.query.splayed_interval;
+    auto from = time_step;
+    if (pending.last_run > 0) {
+      from = std::max(from, pending.last_run + interval);
+    }
+    pending.deadline = nextDeadline(from, interval, pending.phase);
+  }
+  std::make_heap(queue_.begin(), queue_.end(), laterDeadline<PendingQuery>);
+
+  queue_generation_ = generation;
+  queue_built_ = true;
+}
+
+void SchedulerRunner::rebalanceQueue() {
+  std::vector<ScheduleLoad> loads;
+  loads.reserve(queue_.size());
+  for (const auto& pending : queue_) {
+    // Queries without recorded performance are given a nominal cost.
+    ScheduleLoad load;
+    load.interval = pending.query.splayed_interval;
+    load.cost = 1;
+    Config::get().getPerformanceStats(
+        pending.name, ([&load](const QueryPerformance& perf) {
+          if (perf.executions == 0) {
+            return;
+          }
+          auto total = perf.user_time + perf.system_time;
+          if (total == 0) {
+            total = perf.wall_time_ms;
+          }
+          load.cost = std::max<uint64_t>(1, total / perf.executions);
+        }));
+    loads.push_back(load);
+  }
+
+  uint64_t peak = 0;
+  auto phases = assignSchedulePhases(loads, &peak);
+  for (size_t i = 0; i < queue_.size(); ++i) {
+    queue_[i].phase = phases[i];
+  }
+
+  if (FLAGS_schedule_cpu_budget > 0 && peak > FLAGS_schedule_cpu_budget) {
+    LOG(WARNING) << "The schedule needs " << peak
+                 << "ms of CPU in its busiest second, above the budget of "
+                 << FLAGS_schedule_cpu_budget << "ms";
+  }
+}
+
+void SchedulerRunner::runDueQueries(uint64_t time_step) {
+  std::vector<PendingQuery> due;
+  while (!queue_.empty() && queue_.front().deadline <= time_step) {
+    std::pop_heap(queue_.begin(), queue_.end(), laterDeadline<PendingQuery>);
+    due.push_back(std::move(queue_.back()));
+    queue_.pop_back();
+  }
+
+  if (due.empty()) {
+    return;
+  }
+
+  // Run in schedule order, as enumerating the schedule would.
+  std::sort(due.begin(),
+            due.end(),
+            [](const PendingQuery& left, const PendingQuery& right) {
+              return left.order < right.order;
+            });
+  runQueries(time_step, due);
+
+  for (auto& pending : due) {
+    pending.last_run = time_step;
+    pending.deadline = nextDeadline(
+        time_step + 1, pending.query.splayed_interval, pending.phase);
+    queue_.push_back(std::move(pending));
+    std::push_heap(queue_.begin(), queue_.end(), laterDeadline<PendingQuery>);
+  }
+}
+
+uint64_t SchedulerRunner::nextStep(uint64_t time_step) const {
+  // Logs are flushed every 3 steps, which also covers the decorator, carve
+  // and schedule refresh steps.
+  auto step = nextMultiple(time_step, 3);
+  if (FLAGS_schedule_reload > 0) {
+    step = std::min(step, nextMultiple(time_step, FLAGS_schedule_reload));
+  }
+  if (!queue_.empty()) {
+    step = std::min(step, queue_.front().deadline);
+  }
+  return std::max(step, time_step + 1);
+}
+
+size_t SchedulerRunner::workerCount() const {
+  auto cores = std::max<size_t>(1, std::thread::hardware_concurrency());
+  return std::min<size_t>(FLAGS_schedule_workers, cores);
+}
+
+void SchedulerRunner::runQueries(uint64_t time_step,
+                                 const std::vector<PendingQuery>& queries) {
+  auto workers = std::min(workerCount(), queries.size());
+  if (workers < 2) {
+    for (const auto& pending : queries) {
+      if (shutdownRequested()) {
+        break;
+      }
+      runScheduledQuery(time_step, pending, nullptr);
+
+#ifdef OSQUERY_LINUX
+      // Attempt to release some unused memory kept by malloc internal caching
+      releaseRetainedMemory();
+#endif
+    }
+
+#ifdef OSQUERY_LINUX
+    // The descriptors read for the step's queries are stale in the next.
+    procReleaseDescriptorSnapshot();
+#endif
+    return;
+  }
+
+  // Each worker owns a database, so concurrent queries do not contend for
+  // the primary or attach every table for each query. The databases are
+  // replaced when tables are registered or removed.
+  auto tables = Registry::get().names("table");
+  if (tables != worker_tables_) {
+    worker_instances_.clear();
+    worker_tables_ = std::move(tables);
+  }
+  while (worker_instances_.size() < workers) {
+    worker_instances_.push_back(SQLiteDBManager::getUnique());
+  }
+
+  // Idle workers take the next due query, each query runs once per step.
+  std::atomic<size_t> next{0};
+  auto worker = [this, time_step, &queries, &next](size_t id) {
+    for (auto i = next++; i < queries.size(); i = next++) {
+      runScheduledQuery(time_step, queries[i], worker_instances_[id]);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t id = 0; id < workers; ++id) {
+    threads.emplace_back(worker, id);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+#ifdef OSQUERY_LINUX
+  procReleaseDescriptorSnapshot();
+
+  // Attempt to release some unused memory kept by malloc internal caching
+  releaseRetainedMemory();
+#endif
+}
+
 void SchedulerRunner::start() {
   // Start the counter at the second.
   auto i = osquery::getUnixTime();
   // Timeout is the number of seconds from starting.
   auto end = (timeout_ == 0) ? 0 : timeout_ + i;
 
-  for (; (end == 0) || (i <= end); ++i) {
+  first_step_ = i;
+  first_step_time_ = std::chrono::steady_clock::now();
+  while ((end == 0) || (i <= end)) {
     auto start_time_point = std::chrono::steady_clock::now();
-    Config::get().scheduledQueries(([&i](const std::string& name,
-                                         const ScheduledQuery& query) {
-      if (query.splayed_interval > 0 && i % query.splayed_interval == 0) {
-        TablePlugin::kCacheInterval = query.splayed_interval;
-        TablePlugin::kCacheStep = i;
-        const auto status = launchQuery(name, query);
-        monitoring::record((boost::format("scheduler.query.%s.%s.status.%s") %
-                            query.pack_name % query.name %
-                            (status.ok() ? "success" : "failure"))
-                               .str(),
-                           1,
-                           monitoring::PreAggregationType::Sum,
-                           true);
-
-#ifdef OSQUERY_LINUX
-        // Attempt to release some unused memory kept by malloc internal caching
-        releaseRetainedMemory();
-#endif
-      }
-    }));
+    maybeRebuildQueue(i);
+    runDueQueries(i);
 
     maybeRunDecorators(i);
     maybeReloadSchedule(i);
     maybeFlushLogs(i);
     maybeScheduleCarves(i);
 
+    // Sleep until the next step with work instead of waking every step.
+    auto next = nextStep(i);
+    if (end != 0) {
+      next = std::min(next, end + 1);
+    }
+
     auto loop_step_duration =
         std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::steady_clock::now() - start_time_point);
-    calculateTimeDriftAndMaybePause(loop_step_duration);
+    calculateTimeDriftAndMaybePause(loop_step_duration, next - i);
     if (interrupted()) {
       break;
     }
+    i = next;
   }
 
   /* Wait for the thread relaying/flushing the logs,
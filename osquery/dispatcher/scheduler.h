@@ -11,6 +11,9 @@
 
 #include <chrono>
 #include <map>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <osquery/dispatcher/dispatcher.h>
 
@@ -43,7 +46,7 @@ class SchedulerRunner : public InternalRunnable {
 
  private:
   void calculateTimeDriftAndMaybePause(
-      std::chrono::milliseconds loop_step_duration);
+      std::chrono::milliseconds loop_step_duration, uint64_t steps = 1);
 
   /// Check interval-based decorators.
   void maybeRunDecorators(uint64_t time_step);
@@ -57,6 +60,47 @@ class SchedulerRunner : public InternalRunnable {
   /// Check if carve requests should be scheduled.
   void maybeScheduleCarves(uint64_t time_step);
 
+  /// A scheduled query waiting for its next step.
+  struct PendingQuery {
+    /// The next step the query is due.
+    uint64_t deadline{0};
+
+    /// The position of the query in the schedule, due queries run in order.
+    size_t order{0};
+
+    /// The query is due on steps where (step % interval) equals the phase.
+    uint64_t phase{0};
+
+    /// The last step the query ran, or 0 if it has not run.
+    uint64_t last_run{0};
+
+    std::string name;
+    ScheduledQuery query;
+  };
+
+  /// Enumerate the schedule again if it changed or is due for a refresh.
+  void maybeRebuildQueue(uint64_t time_step);
+
+  /// Choose query phases from their recorded cost, see schedule_adaptive_splay.
+  void rebalanceQueue();
+
+  /// Run every query whose deadline has been reached.
+  void runDueQueries(uint64_t time_step);
+
+  /// The next step with a due query or periodic work.
+  uint64_t nextStep(uint64_t time_step) const;
+
+  /// The number of threads running a step's queries, see schedule_workers.
+  size_t workerCount() const;
+
+  /// Run a step's due queries, on the worker threads if enabled.
+  void runQueries(uint64_t time_step, const std::vector<PendingQuery>& queries);
+
+  /// Run a due query and record its status, lateness, duration and rows.
+  void runScheduledQuery(uint64_t time_step,
+                         const PendingQuery& pending,
+                         const SQLiteDBInstanceRef& instance);
+
  private:
   /// Interval in seconds between schedule steps.
   const std::chrono::milliseconds interval_;
@@ -71,13 +115,71 @@ class SchedulerRunner : public InternalRunnable {
 
   const std::chrono::milliseconds max_time_drift_;
 
+  /// Scheduled queries as a min-heap ordered by deadline.
+  std::vector<PendingQuery> queue_;
+
+  /// The schedule generation the queue was built from.
+  uint64_t queue_generation_{0};
+
+  /// Whether the queue has been built.
+  bool queue_built_{false};
+
+  /// The first step and when it started, used to measure lateness.
+  uint64_t first_step_{0};
+  std::chrono::steady_clock::time_point first_step_time_;
+
+  /// Databases owned by each worker running queries concurrently.
+  std::vector<SQLiteDBInstanceRef> worker_instances_;
+
+  /// The table names attached to the worker databases.
+  std::vector<std::string> worker_tables_;
+
   /// Tests should not always trigger a shutdown when the scheduler expires,
   /// so let tests decide when this should happen.
   FRIEND_TEST(TLSConfigTests, test_runner_and_scheduler);
   bool request_shutdown_on_expiration{true};
 };
 
-SQLInternal monitor(const std::string& name, const ScheduledQuery& query);
+/**
+ * @brief Run a scheduled query and record its performance.
+ *
+ * The query runs on the given database, or the manager's if it is nullptr.
+ */
+/// A query's interval and expected cost per execution.
+struct ScheduleLoad {
+  uint64_t interval{0};
+  uint64_t cost{0};
+};
+
+/**
+ * @brief Choose a phase for each query that keeps the per-step cost flat.
+ *
+ * Queries are placed from the most to the least expensive. Each takes the
+ * phase, within its interval, that minimizes the highest cost of the steps it
+ * runs on across a window of steps.
+ *
+ * @param loads The interval and cost of each query.
+ * @param peak [optional] The highest per-step cost of the chosen phases.
+ * @return The phase for each query, parallel to loads.
+ */
+std::vector<uint64_t> assignSchedulePhases(
+    const std::vector<ScheduleLoad>& loads, uint64_t* peak = nullptr);
+
+/**
+ * @brief The worker shard that runs a scheduled query, see worker_shards.
+ *
+ * Queries are hashed by name, or by pack name with worker_shard_by=pack so
+ * that the queries of a pack run in one worker. The hash does not depend on
+ * the process, every worker agrees on the assignment. Queries reading
+ * event-based or extension tables always run in the primary shard, 0.
+ */
+size_t getScheduledQueryShard(const std::string& name,
+                              const ScheduledQuery& query,
+                              size_t shards);
+
+SQLInternal monitor(const std::string& name,
+                    const ScheduledQuery& query,
+                    const SQLiteDBInstanceRef& instance = nullptr);
 
 /// Start querying according to the config's schedule
 void startScheduler();
@@ -0,0 +1,169 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+#include <osquery/dispatcher/scheduler_stats.h>
+#include <osquery/utils/mutex.h>
+#include <osquery/utils/system/time.h>
+
+namespace osquery {
+
+namespace {
+
+/// Seconds of executions kept before the oldest are dropped.
+const std::uint64_t kSchedulerStatsWindow{3600};
+
+/// Values below this are counted exactly, also the buckets per power of two.
+const std::uint64_t kHistogramLinear{16};
+
+/// The current and previous window of a pack's statistics.
+struct PackSchedulerStats {
+  SchedulerStats current;
+  SchedulerStats previous;
+
+  /// When the current window started.
+  std::uint64_t window_start{0};
+};
+
+Mutex kSchedulerStatsMutex;
+
+std::map<std::string, PackSchedulerStats> kSchedulerStats;
+
+/// The position of the highest set bit.
+size_t highestBit(std::uint64_t value) {
+  size_t bit = 0;
+  while (value >>= 1) {
+    ++bit;
+  }
+  return bit;
+}
+
+} // namespace
+
+size_t SchedulerHistogram::bucket(std::uint64_t value) {
+  if (value < kHistogramLinear) {
+    return static_cast<size_t>(value);
+  }
+
+  // Each power of two at or above 16 is split into 16 buckets.
+  auto shift = highestBit(value) - 4;
+  auto sub = (value >> shift) - kHistogramLinear;
+  return kHistogramLinear + shift * kHistogramLinear + sub;
+}
+
+std::uint64_t SchedulerHistogram::bucketValue(size_t index) {
+  if (index < kHistogramLinear) {
+    return index;
+  }
+
+  auto shift = (index - kHistogramLinear) / kHistogramLinear;
+  auto sub = (index - kHistogramLinear) % kHistogramLinear;
+  auto lower = (kHistogramLinear + sub) << shift;
+  return lower + ((std::uint64_t{1} << shift) >> 1);
+}
+
+void SchedulerHistogram::add(std::uint64_t value) {
+  auto index = bucket(value);
+  if (index >= counts_.size()) {
+    counts_.resize(index + 1, 0);
+  }
+  counts_[index]++;
+  count_++;
+  max_ = std::max(max_, value);
+}
+
+void SchedulerHistogram::merge(const SchedulerHistogram& other) {
+  if (other.counts_.size() > counts_.size()) {
+    counts_.resize(other.counts_.size(), 0);
+  }
+  for (size_t i = 0; i < other.counts_.size(); ++i) {
+    counts_[i] += other.counts_[i];
+  }
+  count_ += other.count_;
+  max_ = std::max(max_, other.max_);
+}
+
+std::uint64_t SchedulerHistogram::quantile(double q) const {
+  if (count_ == 0) {
+    return 0;
+  }
+
+  q = std::min(std::max(q, 0.0), 1.0);
+  auto rank = static_cast<std::uint64_t>(std::ceil(q * count_));
+  rank = std::max<std::uint64_t>(rank, 1);
+
+  std::uint64_t seen = 0;
+  for (size_t i = 0; i < counts_.size(); ++i) {
+    seen += counts_[i];
+    if (seen >= rank) {
+      return std::min(bucketValue(i), max_);
+    }
+  }
+  return max_;
+}
+
+SchedulerStats& SchedulerStats::operator+=(const SchedulerStats& other) {
+  lateness_ms.merge(other.lateness_ms);
+  duration_ms.merge(other.duration_ms);
+  rows.merge(other.rows);
+  return *this;
+}
+
+void recordSchedulerStats(const std::string& pack,
+                          std::uint64_t lateness_ms,
+                          std::uint64_t duration_ms,
+                          std::uint64_t rows) {
+  auto now = getUnixTime();
+
+  WriteLock lock(kSchedulerStatsMutex);
+  auto& stats = kSchedulerStats[pack];
+  auto age = now - std::min(now, stats.window_start);
+  if (age >= kSchedulerStatsWindow) {
+    // Start a new window, the previous is dropped when it is also expired.
+    stats.previous = (age < 2 * kSchedulerStatsWindow) ? stats.current
+                                                       : SchedulerStats();
+    stats.current = SchedulerStats();
+    stats.window_start = now;
+  }
+
+  stats.current.lateness_ms.add(lateness_ms);
+  stats.current.duration_ms.add(duration_ms);
+  stats.current.rows.add(rows);
+}
+
+void getSchedulerStats(
+    std::function<void(const std::string&, const SchedulerStats&)> predicate) {
+  auto now = getUnixTime();
+
+  ReadLock lock(kSchedulerStatsMutex);
+  for (const auto& pack : kSchedulerStats) {
+    const auto& stats = pack.second;
+    auto age = now - std::min(now, stats.window_start);
+    if (age >= 2 * kSchedulerStatsWindow) {
+      continue;
+    }
+
+    // An expired current window is the previous window of the next record.
+    auto recent = stats.current;
+    if (age < kSchedulerStatsWindow) {
+      recent += stats.previous;
+    }
+    predicate(pack.first, recent);
+  }
+}
+
+void resetSchedulerStats() {
+  WriteLock lock(kSchedulerStatsMutex);
+  kSchedulerStats.clear();
+}
+
+} // namespace osquery
@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace osquery {
+
+/**
+ * @brief A histogram of non-negative values with a bounded relative error.
+ *
+ * Values below 16 are counted exactly. Larger values are counted in 16
+ * buckets per power of two, so a quantile is estimated within about 3% of
+ * the recorded value. Memory grows with the largest value recorded, not the
+ * number of values.
+ */
+class SchedulerHistogram {
+ public:
+  /// Count a value.
+  void add(std::uint64_t value);
+
+  /// Add the counts of another histogram.
+  void merge(const SchedulerHistogram& other);
+
+  /// Estimate the value at quantile q, within [0, 1], or 0 if empty.
+  std::uint64_t quantile(double q) const;
+
+  /// The number of values counted.
+  std::uint64_t count() const {
+    return count_;
+  }
+
+  /// The largest value counted.
+  std::uint64_t max() const {
+    return max_;
+  }
+
+ private:
+  /// The index of the bucket counting a value.
+  static size_t bucket(std::uint64_t value);
+
+  /// The value a bucket reports, the middle of its range.
+  static std::uint64_t bucketValue(size_t index);
+
+ private:
+  /// Per-bucket counts, only as long as the largest bucket used.
+  std::vector<std::uint32_t> counts_;
+
+  std::uint64_t count_{0};
+  std::uint64_t max_{0};
+};
+
+/**
+ * @brief Recent scheduler statistics for one pack.
+ *
+ * These complement QueryPerformance, which keeps running averages per query,
+ * with distributions that show when a schedule saturates the agent.
+ */
+struct SchedulerStats {
+  /// Delay in milliseconds between a query's intended and actual start.
+  SchedulerHistogram lateness_ms;
+
+  /// Time in milliseconds spent running each query.
+  SchedulerHistogram duration_ms;
+
+  /// Rows returned by each query.
+  SchedulerHistogram rows;
+
+  SchedulerStats& operator+=(const SchedulerStats& other);
+};
+
+/**
+ * @brief Add the statistics of a scheduled query execution to its pack.
+ *
+ * Executions are kept for at least one and at most two stats windows, so the
+ * distributions follow changes to the schedule.
+ */
+void recordSchedulerStats(const std::string& pack,
+                          std::uint64_t lateness_ms,
+                          std::uint64_t duration_ms,
+                          std::uint64_t rows);
+
+/// Visit the recent statistics for every pack that has run a query.
+void getSchedulerStats(
+    std::function<void(const std::string&, const SchedulerStats&)> predicate);
+
+/// Reset all recorded statistics.
+void resetSchedulerStats();
+
+} // namespace osquery
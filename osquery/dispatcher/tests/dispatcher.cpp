@@ -11,11 +11,14 @@
 
 #include <gtest/gtest.h>
 
+#include <osquery/core/flags.h>
 #include <osquery/dispatcher/dispatcher.h>
 #include <osquery/utils/status/status.h>
 
 namespace osquery {
 
+DECLARE_uint64(service_executor_threads);
+
 class DispatcherTests : public testing::Test {
   void TearDown() override {
     Dispatcher::instance().resetStopping();
@@ -144,4 +147,90 @@ TEST_F(DispatcherTests, test_stop_dispatcher) {
   auto s = Dispatcher::addService(r1);
   EXPECT_FALSE(s);
 }
+
+class CountingPeriodicRunnable : public PeriodicRunnable {
+ public:
+  CountingPeriodicRunnable(size_t runs, std::chrono::milliseconds delay)
+      : PeriodicRunnable("CountingPeriodicRunnable"),
+        runs_(runs),
+        delay_(delay) {}
+
+  std::chrono::milliseconds runOnce() override {
+    thread_ = std::this_thread::get_id();
+    return (++count_ < runs_) ? delay_ : kFinished;
+  }
+
+  std::chrono::milliseconds initialDelay() override {
+    return delay_;
+  }
+
+  size_t count() const {
+    return count_;
+  }
+
+  std::thread::id thread() const {
+    return thread_;
+  }
+
+ private:
+  size_t runs_{0};
+  std::chrono::milliseconds delay_;
+  std::atomic<size_t> count_{0};
+  std::thread::id thread_;
+};
+
+TEST_F(DispatcherTests, test_periodic_executor) {
+  auto executor_threads = FLAGS_service_executor_threads;
+  FLAGS_service_executor_threads = 1;
+
+  auto service_count = Dispatcher::instance().serviceCount();
+  auto r1 = std::make_shared<CountingPeriodicRunnable>(
+      3, std::chrono::milliseconds(1));
+  auto r2 = std::make_shared<CountingPeriodicRunnable>(
+      2, std::chrono::milliseconds(2));
+  EXPECT_TRUE(Dispatcher::addService(r1));
+  EXPECT_TRUE(Dispatcher::addService(r2));
+  EXPECT_FALSE(Dispatcher::addService(r1));
+
+  Dispatcher::joinServices();
+  EXPECT_EQ(3U, r1->count());
+  EXPECT_EQ(2U, r2->count());
+  EXPECT_TRUE(r1->hasRun());
+
+  // Both services shared the single executor thread.
+  EXPECT_EQ(r1->thread(), r2->thread());
+  EXPECT_NE(std::this_thread::get_id(), r1->thread());
+  EXPECT_EQ(service_count, Dispatcher::instance().serviceCount());
+
+  FLAGS_service_executor_threads = executor_threads;
+}
+
+TEST_F(DispatcherTests, test_periodic_interruption) {
+  auto r1 = std::make_shared<CountingPeriodicRunnable>(
+      2, std::chrono::seconds(100));
+  Dispatcher::addService(r1);
+
+  // The executor releases the service without waiting for its delay.
+  r1->interrupt();
+  Dispatcher::joinServices();
+  EXPECT_EQ(0U, r1->count());
+}
+
+TEST_F(DispatcherTests, test_periodic_dedicated_thread) {
+  auto executor_threads = FLAGS_service_executor_threads;
+  FLAGS_service_executor_threads = 0;
+
+  auto r1 = std::make_shared<CountingPeriodicRunnable>(
+      3, std::chrono::milliseconds(1));
+  auto r2 = std::make_shared<CountingPeriodicRunnable>(
+      3, std::chrono::milliseconds(1));
+  Dispatcher::addService(r1);
+  Dispatcher::addService(r2);
+  Dispatcher::joinServices();
+  EXPECT_EQ(3U, r1->count());
+  EXPECT_EQ(3U, r2->count());
+  EXPECT_NE(r1->thread(), r2->thread());
+
+  FLAGS_service_executor_threads = executor_threads;
+}
 }
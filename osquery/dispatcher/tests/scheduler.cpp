@@ -7,13 +7,19 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <set>
+
 #include <gtest/gtest.h>
 
 #include <osquery/config/config.h>
 #include <osquery/core/shutdown.h>
 #include <osquery/core/system.h>
+#include <osquery/core/tables.h>
 #include <osquery/database/database.h>
+#include <osquery/dispatcher/distributed_runner.h>
+#include <osquery/dispatcher/query_budget.h>
 #include <osquery/dispatcher/scheduler.h>
+#include <osquery/dispatcher/scheduler_stats.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry.h>
 #include <osquery/sql/sqlite_util.h>
@@ -22,7 +28,13 @@
 namespace osquery {
 
 DECLARE_bool(disable_logging);
+DECLARE_bool(distributed_adaptive_interval);
+DECLARE_uint64(distributed_interval);
+DECLARE_uint64(distributed_long_poll);
+DECLARE_uint64(schedule_query_cpu_limit);
 DECLARE_uint64(schedule_reload);
+DECLARE_uint64(schedule_workers);
+DECLARE_string(worker_shard_by);
 
 class SchedulerTests : public testing::Test {
   void SetUp() override {
@@ -283,6 +295,300 @@ TEST_F(SchedulerTests, test_scheduler_drift_accumulation) {
   TablePlugin::kCacheInterval = backup_interval;
 }
 
+TEST_F(SchedulerTests, test_scheduler_deadlines) {
+  std::string config = R"config(
+  {
+    "packs": {
+      "deadlines": {
+        "queries": {
+          "fast": {"query": "select 1 as number", "interval": 1},
+          "slow": {"query": "select 2 as number", "interval": 2}
+        }
+      }
+    }
+  })config";
+  Config::get().update({{"data", config}});
+
+  // Run 4 steps without pausing between them.
+  SchedulerRunner runner(static_cast<unsigned long int>(3), size_t{0});
+  runner.start();
+
+  // Each query runs on every step divisible by its interval.
+  QueryPerformance fast;
+  Config::get().getPerformanceStats(
+      "pack_deadlines_fast",
+      ([&fast](const QueryPerformance& r) { fast = r; }));
+  EXPECT_EQ(fast.executions, 4U);
+
+  QueryPerformance slow;
+  Config::get().getPerformanceStats(
+      "pack_deadlines_slow",
+      ([&slow](const QueryPerformance& r) { slow = r; }));
+  EXPECT_EQ(slow.executions, 2U);
+}
+
+TEST_F(SchedulerTests, test_assign_schedule_phases) {
+  // Expensive queries sharing an interval are spread across it.
+  std::vector<ScheduleLoad> loads = {{10, 100}, {10, 100}, {10, 100}};
+  uint64_t peak = 0;
+  auto phases = assignSchedulePhases(loads, &peak);
+  ASSERT_EQ(phases.size(), 3U);
+  EXPECT_NE(phases[0], phases[1]);
+  EXPECT_NE(phases[1], phases[2]);
+  EXPECT_NE(phases[0], phases[2]);
+  EXPECT_EQ(peak, 100U);
+
+  // Cheap queries fill the steps the expensive query does not use.
+  loads = {{1, 1}, {2, 50}, {2, 5}};
+  phases = assignSchedulePhases(loads, &peak);
+  EXPECT_EQ(phases[0], 0U);
+  EXPECT_NE(phases[1], phases[2]);
+  EXPECT_EQ(peak, 51U);
+
+  // Every phase is within its interval.
+  loads = {{7200, 10}, {86400, 10}, {3, 10}};
+  phases = assignSchedulePhases(loads);
+  EXPECT_LT(phases[0], 7200U);
+  EXPECT_LT(phases[1], 86400U);
+  EXPECT_LT(phases[2], 3U);
+}
+
+TEST_F(SchedulerTests, test_scheduled_query_shard) {
+  ScheduledQuery first("pack_a", "first", "select 1");
+  ScheduledQuery second("pack_a", "second", "select 2");
+
+  // A single shard runs every query.
+  EXPECT_EQ(getScheduledQueryShard("pack_pack_a_first", first, 1), 0U);
+
+  // Queries are spread by name, and always land on the same shard.
+  std::set<size_t> shards;
+  for (size_t i = 0; i < 64; ++i) {
+    auto name = "query_" + std::to_string(i);
+    auto shard = getScheduledQueryShard(name, first, 4);
+    EXPECT_LT(shard, 4U);
+    EXPECT_EQ(shard, getScheduledQueryShard(name, first, 4));
+    shards.insert(shard);
+  }
+  EXPECT_EQ(shards.size(), 4U);
+
+  // By pack, the queries of a pack share a shard.
+  auto shard_by = FLAGS_worker_shard_by;
+  FLAGS_worker_shard_by = "pack";
+  for (size_t i = 0; i < 16; ++i) {
+    EXPECT_EQ(getScheduledQueryShard("query_" + std::to_string(i), first, 4),
+              getScheduledQueryShard("other", second, 4));
+  }
+  FLAGS_worker_shard_by = shard_by;
+}
+
+class ShardEventsTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("value", TEXT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  TableAttributes attributes() const override {
+    return TableAttributes::EVENT_BASED;
+  }
+
+  TableRows generate(QueryContext& /* context */) override {
+    return TableRows();
+  }
+};
+
+TEST_F(SchedulerTests, test_scheduled_query_shard_events) {
+  auto tables = RegistryFactory::get().registry("table");
+  tables->add("shard_events", std::make_shared<ShardEventsTablePlugin>());
+
+  // Events are only collected by the primary worker shard.
+  ScheduledQuery events("pack_a", "events", "select * from shard_events");
+  for (size_t i = 0; i < 64; ++i) {
+    auto name = "query_" + std::to_string(i);
+    EXPECT_EQ(getScheduledQueryShard(name, events, 4), 0U);
+  }
+
+  // So are tables this worker does not serve, such as an extension's.
+  ScheduledQuery missing("pack_a", "missing", "select * from shard_missing");
+  for (size_t i = 0; i < 64; ++i) {
+    auto name = "query_" + std::to_string(i);
+    EXPECT_EQ(getScheduledQueryShard(name, missing, 4), 0U);
+  }
+
+  // Other queries are still spread across the shards.
+  ScheduledQuery time("pack_a", "time", "select * from time");
+  std::set<size_t> shards;
+  for (size_t i = 0; i < 64; ++i) {
+    auto name = "query_" + std::to_string(i);
+    shards.insert(getScheduledQueryShard(name, time, 4));
+  }
+  EXPECT_EQ(shards.size(), 4U);
+  tables->remove("shard_events");
+}
+
+TEST_F(SchedulerTests, test_scheduler_workers) {
+  auto backup_workers = FLAGS_schedule_workers;
+  FLAGS_schedule_workers = 2;
+
+  std::string config = R"config(
+  {
+    "packs": {
+      "workers": {
+        "queries": {
+          "1": {"query": "select * from osquery_info", "interval": 1},
+          "2": {"query": "select * from time", "interval": 1},
+          "3": {"query": "select 3 as number", "interval": 1}
+        }
+      }
+    }
+  })config";
+  Config::get().update({{"data", config}});
+
+  // Run the scheduler for 1 second with a second interval.
+  SchedulerRunner runner(static_cast<unsigned long int>(1), size_t{1});
+  runner.start();
+
+  // Every due query runs once per step on the worker threads.
+  for (const auto& name :
+       {"pack_workers_1", "pack_workers_2", "pack_workers_3"}) {
+    QueryPerformance perf;
+    Config::get().getPerformanceStats(
+        name, ([&perf](const QueryPerformance& r) { perf = r; }));
+    EXPECT_GE(perf.executions, 1U) << name;
+    EXPECT_GT(perf.output_size, 0U) << name;
+  }
+
+  FLAGS_schedule_workers = backup_workers;
+}
+
+TEST_F(SchedulerTests, test_scheduler_histogram) {
+  SchedulerHistogram histogram;
+  EXPECT_EQ(0U, histogram.quantile(0.5));
+
+  for (uint64_t i = 1; i <= 100; ++i) {
+    histogram.add(i);
+  }
+  EXPECT_EQ(100U, histogram.count());
+  EXPECT_EQ(100U, histogram.max());
+  EXPECT_EQ(1U, histogram.quantile(0));
+  EXPECT_EQ(100U, histogram.quantile(1));
+
+  // Values at or above 16 are estimated within their bucket.
+  EXPECT_NEAR(50, histogram.quantile(0.5), 2);
+  EXPECT_NEAR(95, histogram.quantile(0.95), 3);
+  EXPECT_NEAR(99, histogram.quantile(0.99), 3);
+
+  // Small values are counted exactly, large values keep a bounded error.
+  SchedulerHistogram other;
+  other.add(3);
+  other.add(1000000);
+  histogram.merge(other);
+  EXPECT_EQ(102U, histogram.count());
+  EXPECT_EQ(1000000U, histogram.max());
+  EXPECT_NEAR(1000000, histogram.quantile(1), 1000000 / 32);
+}
+
+TEST_F(SchedulerTests, test_scheduler_stats) {
+  resetSchedulerStats();
+
+  std::string config = R"config(
+  {
+    "packs": {
+      "stats": {
+        "queries": {
+          "1": {"query": "select 1 as number", "interval": 1},
+          "2": {"query": "select 2 as number", "interval": 1}
+        }
+      }
+    }
+  })config";
+  Config::get().update({{"data", config}});
+
+  // Run the scheduler for 1 second with a second interval.
+  SchedulerRunner runner(static_cast<unsigned long int>(1), size_t{1});
+  runner.start();
+
+  SchedulerStats pack_stats;
+  getSchedulerStats(
+      [&pack_stats](const std::string& pack, const SchedulerStats& stats) {
+        if (pack == "stats") {
+          pack_stats = stats;
+        }
+      });
+
+  // Each query returned a single row on each step.
+  EXPECT_GE(pack_stats.duration_ms.count(), 2U);
+  EXPECT_EQ(pack_stats.duration_ms.count(), pack_stats.lateness_ms.count());
+  EXPECT_EQ(1U, pack_stats.rows.quantile(0.5));
+  EXPECT_EQ(1U, pack_stats.rows.max());
+
+  resetSchedulerStats();
+  size_t packs = 0;
+  getSchedulerStats(
+      [&packs](const std::string&, const SchedulerStats&) { packs++; });
+  EXPECT_EQ(0U, packs);
+}
+
+/// A query that runs for several seconds without reading a table.
+const std::string kLongQuery{
+    "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c "
+    "LIMIT 1000000000) SELECT count(*) FROM c"};
+
+TEST_F(SchedulerTests, test_query_budget) {
+  {
+    // The query is interrupted once it exceeds its CPU budget.
+    QueryBudget budget("long", 50, 0);
+    SQLInternal sql(kLongQuery, false);
+    EXPECT_FALSE(sql.getStatus().ok());
+    EXPECT_TRUE(budget.exceeded());
+    EXPECT_NE(std::string::npos, budget.reason().find("CPU budget"));
+  }
+
+  {
+    QueryBudget budget("short", 60000, 0);
+    SQLInternal sql("select 1 as number", false);
+    EXPECT_TRUE(sql.getStatus().ok());
+    EXPECT_FALSE(budget.exceeded());
+  }
+
+  // Queries without a budget are not cancelled.
+  EXPECT_EQ(nullptr, QueryCancellation::kCurrent);
+}
+
+TEST_F(SchedulerTests, test_scheduler_query_budget) {
+  auto backup_limit = FLAGS_schedule_query_cpu_limit;
+  FLAGS_schedule_query_cpu_limit = 50;
+
+  std::string config = R"config(
+  {
+    "packs": {
+      "budget": {
+        "queries": {
+          "long": {"query": ")config" +
+                       kLongQuery + R"config(", "interval": 1},
+          "short": {"query": "select 1 as number", "interval": 1}
+        }
+      }
+    }
+  })config";
+  Config::get().update({{"data", config}});
+
+  SchedulerRunner runner(static_cast<unsigned long int>(1), size_t{1});
+  runner.start();
+
+  // Only the query over its budget is denylisted.
+  std::vector<std::string> names;
+  Config::get().scheduledQueries(
+      ([&names](std::string name, const ScheduledQuery&) {
+        names.push_back(std::move(name));
+      }));
+  EXPECT_EQ(names, std::vector<std::string>{"pack_budget_short"});
+
+  FLAGS_schedule_query_cpu_limit = backup_limit;
+  setDatabaseValue(kPersistentSettings, "failed_queries", "");
+}
+
 TEST_F(SchedulerTests, test_scheduler_reload) {
   std::string config =
       "{\"schedule\":{\"1\":{"
@@ -295,4 +601,43 @@ TEST_F(SchedulerTests, test_scheduler_reload) {
   SchedulerRunner runner(expire, 1);
   FLAGS_schedule_reload = backup_reload;
 }
+
+TEST_F(SchedulerTests, test_distributed_poll_delay) {
+  auto backup_interval = FLAGS_distributed_interval;
+  auto backup_adaptive = FLAGS_distributed_adaptive_interval;
+  auto backup_long_poll = FLAGS_distributed_long_poll;
+  FLAGS_distributed_interval = 60;
+  FLAGS_distributed_adaptive_interval = false;
+  FLAGS_distributed_long_poll = 0;
+  deleteDatabaseValue(kPersistentSettings,
+                      "distributed_accelerate_checkins_expire");
+
+  using ms = std::chrono::milliseconds;
+  DistributedRunner runner;
+  EXPECT_EQ(ms(60000), runner.getPollDelay(true, ms(0)));
+
+  // Reads after work start quickly and back off to the interval.
+  FLAGS_distributed_adaptive_interval = true;
+  EXPECT_EQ(ms(1000), runner.getPollDelay(true, ms(0)));
+  EXPECT_EQ(ms(2000), runner.getPollDelay(false, ms(0)));
+  EXPECT_EQ(ms(4000), runner.getPollDelay(false, ms(0)));
+  runner.getPollDelay(false, ms(0));
+  runner.getPollDelay(false, ms(0));
+  EXPECT_EQ(ms(32000), runner.getPollDelay(false, ms(0)));
+  EXPECT_EQ(ms(60000), runner.getPollDelay(false, ms(0)));
+  EXPECT_EQ(ms(60000), runner.getPollDelay(false, ms(0)));
+
+  // A read the server held, or that returned work, is followed right away.
+  FLAGS_distributed_adaptive_interval = false;
+  FLAGS_distributed_long_poll = 30;
+  EXPECT_EQ(ms(0), runner.getPollDelay(false, ms(30000)));
+  EXPECT_EQ(ms(0), runner.getPollDelay(true, ms(10)));
+
+  // A server answering at once is not polled in a loop.
+  EXPECT_EQ(ms(60000), runner.getPollDelay(false, ms(10)));
+
+  FLAGS_distributed_interval = backup_interval;
+  FLAGS_distributed_adaptive_interval = backup_adaptive;
+  FLAGS_distributed_long_poll = backup_long_poll;
+}
 } // namespace osquery
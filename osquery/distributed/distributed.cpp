@@ -7,18 +7,30 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
 #include <sstream>
+#include <thread>
 #include <utility>
 
 #include <osquery/core/flags.h>
+#include <osquery/core/flight_recorder.h>
 #include <osquery/core/plugins/logger.h>
+#include <osquery/core/query_accounting.h>
+#include <osquery/core/query_cancellation.h>
 #include <osquery/core/system.h>
 #include <osquery/database/database.h>
 #include <osquery/distributed/distributed.h>
 #include <osquery/hashing/hashing.h>
 #include <osquery/logger/logger.h>
 #include <osquery/process/process.h>
+#include <osquery/profiler/allocations.h>
+#include <osquery/profiler/query_trace.h>
 #include <osquery/registry/registry_factory.h>
+#include <osquery/sql/query_cost.h>
 #include <osquery/sql/sql.h>
 #include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/json/json.h>
@@ -48,9 +60,178 @@ FLAG(uint64,
      86400,
      "Seconds to denylist distributed queries (default 1 day)");
 
+FLAG(uint64,
+     distributed_max_concurrency,
+     1,
+     "Distributed queries executed at once (default 1)");
+
+FLAG(uint64,
+     distributed_query_timeout,
+     0,
+     "Seconds after which a distributed query is cancelled (0 = no timeout)");
+
+FLAG(uint64,
+     distributed_long_poll,
+     0,
+     "Seconds a server may hold a distributed read until work is available");
+
+FLAG(uint64,
+     distributed_max_result_part_size,
+     0,
+     "Approximate max bytes of results in one write request (0 = no limit)");
+
+FLAG(uint64,
+     distributed_cost_budget,
+     0,
+     "Estimated milliseconds a distributed query may cost (0 = no budget)");
+
+FLAG(string,
+     distributed_cost_action,
+     "reject",
+     "What to do with queries over the cost budget: reject or defer");
+
 DECLARE_bool(verbose);
 
-std::string Distributed::currentRequestId_{""};
+/// Completed results wait this long for other queries before a flush.
+const std::chrono::milliseconds kDistributedFlushDelay{1000};
+
+thread_local std::string Distributed::currentRequestId_{""};
+
+namespace {
+
+/// Approximate size of the JSON of a row, without escaping.
+uint64_t getRowSize(const Row& row) {
+  uint64_t size = 2;
+  for (const auto& column : row) {
+    size += column.first.size() + column.second.size() + 6;
+  }
+  return size;
+}
+
+/**
+ * @brief Read the work of a distributed read without building a document.
+ *
+ * Only the "discovery" and "queries" string members, and the "accelerate"
+ * integer, of the root object are kept. The other members are skipped.
+ */
+struct WorkHandler : public rj::BaseReaderHandler<rj::UTF8<>, WorkHandler> {
+  enum class Section { kNone, kDiscovery, kQueries };
+
+  bool root_object{false};
+
+  std::vector<std::pair<std::string, std::string>> discovery;
+  bool discovery_strings{true};
+
+  std::vector<std::pair<std::string, std::string>> queries;
+  bool queries_strings{true};
+
+  bool has_accelerate{false};
+  bool accelerate_int{false};
+  int accelerate{0};
+
+  bool Default() {
+    if (depth_ == 1) {
+      // A scalar member of the root object.
+      has_accelerate = has_accelerate || (key_ == "accelerate");
+    } else if (depth_ == 2) {
+      // A scalar, but not string, query.
+      setNotString();
+    }
+    return true;
+  }
+
+  bool Int(int i) {
+    if (depth_ == 1 && key_ == "accelerate") {
+      has_accelerate = true;
+      accelerate_int = true;
+      accelerate = i;
+      return true;
+    }
+    return Default();
+  }
+
+  bool Uint(unsigned u) {
+    if (u <= static_cast<unsigned>(std::numeric_limits<int>::max())) {
+      return Int(static_cast<int>(u));
+    }
+    return Default();
+  }
+
+  bool String(const char* str, rj::SizeType length, bool) {
+    if (depth_ == 2 && section_ == Section::kDiscovery) {
+      discovery.emplace_back(key_, std::string(str, length));
+      return true;
+    } else if (depth_ == 2 && section_ == Section::kQueries) {
+      queries.emplace_back(key_, std::string(str, length));
+      return true;
+    }
+    return Default();
+  }
+
+  bool Key(const char* str, rj::SizeType length, bool) {
+    if (depth_ <= 2) {
+      key_.assign(str, length);
+    }
+    return true;
+  }
+
+  bool StartObject() {
+    return start(true);
+  }
+
+  bool EndObject(rj::SizeType) {
+    return end();
+  }
+
+  bool StartArray() {
+    return start(false);
+  }
+
+  bool EndArray(rj::SizeType) {
+    return end();
+  }
+
+ private:
+  bool start(bool object) {
+    if (depth_ == 0) {
+      root_object = object;
+    } else if (depth_ == 1) {
+      if (object && key_ == "discovery") {
+        section_ = Section::kDiscovery;
+      } else if (object && key_ == "queries") {
+        section_ = Section::kQueries;
+      }
+      has_accelerate = has_accelerate || (key_ == "accelerate");
+    } else if (depth_ == 2) {
+      setNotString();
+    }
+    depth_++;
+    return true;
+  }
+
+  bool end() {
+    depth_--;
+    if (depth_ == 1) {
+      section_ = Section::kNone;
+    }
+    return true;
+  }
+
+  void setNotString() {
+    if (section_ == Section::kDiscovery) {
+      discovery_strings = false;
+    } else if (section_ == Section::kQueries) {
+      queries_strings = false;
+    }
+  }
+
+ private:
+  size_t depth_{0};
+  Section section_{Section::kNone};
+  std::string key_;
+};
+
+} // namespace
 
 Status DistributedPlugin::call(const PluginRequest& request,
                                PluginResponse& response) {
@@ -101,28 +282,95 @@ std::vector<std::string> Distributed::getPendingQueries() {
 }
 
 size_t Distributed::getCompletedCount() {
+  ReadLock lock(results_mutex_);
   return results_.size();
 }
 
 Status Distributed::serializeResults(std::string& json) {
+  std::vector<ResultPart> parts;
+  selectResultParts(results_.size(), 0, parts);
+  return serializeResultParts(parts, json);
+}
+
+void Distributed::selectResultParts(size_t count,
+                                    uint64_t limit,
+                                    std::vector<ResultPart>& parts) {
+  uint64_t size = 0;
+  for (size_t i = 0; i < count && i < results_.size(); ++i) {
+    if (limit > 0 && size >= limit) {
+      break;
+    }
+
+    const auto& result = results_[i];
+    ResultPart part;
+    part.index = i;
+    part.begin = result.sent_rows;
+    part.end = part.begin;
+    part.sequence = result.next_part;
+    size += result.request.id.size() + result.message.size();
+
+    // A part has at least one row, even if that row alone is too large.
+    const auto& rows = result.results;
+    while (part.end < rows.size()) {
+      auto row_size = getRowSize(rows[part.end]);
+      if (limit > 0 && size + row_size > limit && part.end > part.begin) {
+        break;
+      }
+      size += row_size;
+      part.end++;
+    }
+
+    part.last = (part.end == rows.size());
+    if (!part.last && part.end == part.begin) {
+      break;
+    }
+    parts.push_back(part);
+    if (!part.last) {
+      break;
+    }
+  }
+}
+
+Status Distributed::serializeResultParts(const std::vector<ResultPart>& parts,
+                                         std::string& json) {
   auto doc = JSON::newObject();
   auto queries_obj = doc.getObject();
   auto statuses_obj = doc.getObject();
   auto messages_obj = doc.getObject();
   auto stats_obj = doc.getObject();
-  for (const auto& result : results_) {
+  auto parts_obj = doc.getObject();
+  for (const auto& part : parts) {
+    const auto& result = results_[part.index];
     auto arr = doc.getArray();
-    auto s = serializeQueryData(result.results, result.columns, doc, arr);
-    if (!s.ok()) {
-      return s;
+    for (auto i = part.begin; i < part.end; ++i) {
+      auto row_obj = doc.getObject();
+      auto s = serializeRow(result.results[i], result.columns, doc, row_obj);
+      if (!s.ok()) {
+        return s;
+      }
+      doc.push(row_obj, arr);
     }
     doc.add(result.request.id, arr, queries_obj);
     doc.add(result.request.id, result.status.getCode(), statuses_obj);
     doc.add(result.request.id, result.message, messages_obj);
 
+    if (FLAGS_distributed_max_result_part_size > 0) {
+      auto part_obj = doc.getObject();
+      doc.add("sequence", static_cast<uint64_t>(part.sequence), part_obj);
+      doc.add("offset", static_cast<uint64_t>(part.begin), part_obj);
+      doc.add("last", part.last, part_obj);
+      doc.add(result.request.id, part_obj, parts_obj);
+    }
+
+    // The statistics cover the whole query, they come with its last part.
+    if (!part.last) {
+      continue;
+    }
+
     auto obj = doc.getObject();
-    if (performance_.count(result.request.id) > 0) {
-      auto perf = performance_[result.request.id];
+    auto perf_it = performance_.find(result.request.id);
+    if (perf_it != performance_.end()) {
+      const auto& perf = perf_it->second;
       obj.AddMember("wall_time_ms",
                     static_cast<uint64_t>(perf.wall_time_ms),
                     obj.GetAllocator());
@@ -135,6 +383,14 @@ Status Distributed::serializeResults(std::string& json) {
       obj.AddMember("memory",
                     static_cast<uint64_t>(perf.last_memory),
                     obj.GetAllocator());
+      if (allocationsCounted()) {
+        obj.AddMember("allocated_bytes",
+                      static_cast<uint64_t>(perf.last_allocated_bytes),
+                      obj.GetAllocator());
+        obj.AddMember("peak_bytes",
+                      static_cast<uint64_t>(perf.last_peak_bytes),
+                      obj.GetAllocator());
+      }
     };
 
     doc.add(result.request.id, obj, stats_obj);
@@ -144,55 +400,238 @@ Status Distributed::serializeResults(std::string& json) {
   doc.add("statuses", statuses_obj);
   doc.add("messages", messages_obj);
   doc.add("stats", stats_obj);
+  if (FLAGS_distributed_max_result_part_size > 0) {
+    doc.add("parts", parts_obj);
+  }
   return doc.toString(json);
 }
 
+size_t Distributed::acknowledgeResultParts(
+    const std::vector<ResultPart>& parts) {
+  WriteLock lock(results_mutex_);
+  size_t completed = 0;
+  for (const auto& part : parts) {
+    auto& result = results_[part.index];
+    if (part.last) {
+      performance_.erase(result.request.id);
+      completed++;
+      continue;
+    }
+
+    // The rows are not needed anymore, a retry starts after them.
+    for (auto i = part.begin; i < part.end; ++i) {
+      Row().swap(result.results[i]);
+    }
+    result.sent_rows = part.end;
+    result.next_part = part.sequence + 1;
+  }
+
+  results_.erase(results_.begin(), results_.begin() + completed);
+  return completed;
+}
+
 void Distributed::addResult(const DistributedQueryResult& result) {
+  WriteLock lock(results_mutex_);
   results_.push_back(result);
 }
 
-Status Distributed::runQueries() {
-  auto queries = getPendingQueries();
+void Distributed::rejectQuery(const std::string& name,
+                              const std::string& message) {
+  auto request = popRequest(name);
+  LOG(WARNING) << "Rejected distributed query: " << request.id << ": "
+               << message;
+
+  DistributedQueryResult result;
+  result.request = request;
+  result.status = Status(1, "Over cost budget");
+  result.message = message;
+  addResult(result);
+}
+
+void Distributed::admitQueries(std::vector<std::string>& queries) {
+  if (FLAGS_distributed_cost_budget == 0) {
+    return;
+  }
 
-  for (const auto& query : queries) {
-    auto request = popRequest(query);
-
-    const auto denylisted = checkAndSetAsRunning(request.query);
-    if (denylisted) {
-      VLOG(1) << "Not executing distributed denylisted query: \""
-              << request.query << "\"";
-      DistributedQueryResult result;
-      result.request = request;
-      result.status = Status(1, "Denylisted");
-      result.message = "distributed query is denylisted";
-      addResult(result);
+  auto budget = static_cast<double>(FLAGS_distributed_cost_budget);
+  auto defer = (FLAGS_distributed_cost_action == "defer");
+  std::vector<std::string> admitted;
+  std::vector<std::string> deferred;
+  for (const auto& name : queries) {
+    std::string query;
+    getDatabaseValue(kDistributedQueries, name, query);
+
+    // A query that cannot be planned fails when it runs.
+    QueryCost cost;
+    if (!estimateQueryCost(query, cost).ok() || cost.time_ms <= budget) {
+      admitted.push_back(name);
       continue;
     }
 
-    if (FLAGS_verbose) {
-      VLOG(1) << "Executing distributed query: " << request.id << ": "
-              << request.query;
-    } else if (FLAGS_distributed_loginfo) {
-      LOG(INFO) << "Executing distributed query: " << request.id << ": "
-                << request.query;
+    auto message = "distributed query estimated cost of " +
+                   std::to_string(static_cast<uint64_t>(cost.time_ms)) +
+                   "ms exceeds the distributed_cost_budget of " +
+                   std::to_string(FLAGS_distributed_cost_budget) +
+                   "ms: " + cost.describe();
+    if (defer) {
+      VLOG(1) << "Deferring " << name << ", " << message;
+      deferred.push_back(name);
+    } else {
+      rejectQuery(name, message);
     }
+  }
+
+  admitted.insert(admitted.end(), deferred.begin(), deferred.end());
+  queries = std::move(admitted);
+}
+
+void Distributed::runQuery(const std::string& name) {
+  auto request = popRequest(name);
+
+  const auto denylisted = checkAndSetAsRunning(request.query);
+  if (denylisted) {
+    VLOG(1) << "Not executing distributed denylisted query: \""
+            << request.query << "\"";
+    DistributedQueryResult result;
+    result.request = request;
+    result.status = Status(1, "Denylisted");
+    result.message = "distributed query is denylisted";
+    addResult(result);
+    return;
+  }
+
+  if (FLAGS_verbose) {
+    VLOG(1) << "Executing distributed query: " << request.id << ": "
+            << request.query;
+  } else if (FLAGS_distributed_loginfo) {
+    LOG(INFO) << "Executing distributed query: " << request.id << ": "
+              << request.query;
+  }
+
+  // Keep track of the currently executing request
+  Distributed::setCurrentRequestId(request.id);
+  ScopedQueryTrace trace("distributed", request.id);
+
+  auto sql = monitorNonnumeric(request.id, request.query);
+  const auto ok = sql.getStatus().ok();
+  const auto& msg = ok ? "" : sql.getMessageString();
+  if (!ok) {
+    LOG(ERROR) << "Error executing distributed query: " << request.id << ": "
+               << msg;
+  }
+
+  setAsNotRunning(request.query);
+
+  DistributedQueryResult result(
+      request, sql.rows(), sql.columns(), sql.getStatus(), msg);
+  addResult(result);
+}
+
+Status Distributed::runQueries() {
+  auto queries = getPendingQueries();
+  admitQueries(queries);
+  auto workers = std::min<size_t>(
+      queries.size(),
+      static_cast<size_t>(
+          std::max<uint64_t>(FLAGS_distributed_max_concurrency, 1)));
+  if (workers == 0) {
+    return flushCompleted();
+  }
+
+  using Clock = std::chrono::steady_clock;
+  struct RunningQuery {
+    QueryCancellationRef cancellation;
+    Clock::time_point deadline;
+  };
+
+  // State shared with the workers.
+  std::mutex mutex;
+  std::condition_variable changed;
+  size_t next = 0;
+  size_t done = 0;
+  std::map<std::string, RunningQuery> running;
+
+  // Results of the queries done after the last flush wait since.
+  size_t flushed = 0;
+  Clock::time_point pending_since;
+
+  auto timeout = std::chrono::seconds(FLAGS_distributed_query_timeout);
+  auto worker = [&]() {
+    while (true) {
+      std::string name;
+      auto cancellation = std::make_shared<QueryCancellation>();
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (next == queries.size()) {
+          break;
+        }
+
+        name = queries[next++];
+        auto deadline = (timeout.count() > 0) ? Clock::now() + timeout
+                                              : Clock::time_point::max();
+        running[name] = {cancellation, deadline};
+      }
 
-    // Keep track of the currently executing request
-    Distributed::setCurrentRequestId(request.id);
+      QueryCancellation::kCurrent = cancellation;
+      {
+        ScopedQueryAccount account(name, false);
+        ScopedFlightQuery flight(name);
+        runQuery(name);
+      }
+      QueryCancellation::kCurrent = nullptr;
 
-    auto sql = monitorNonnumeric(request.id, request.query);
-    const auto ok = sql.getStatus().ok();
-    const auto& msg = ok ? "" : sql.getMessageString();
-    if (!ok) {
-      LOG(ERROR) << "Error executing distributed query: " << request.id << ": "
-                 << msg;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        running.erase(name);
+        if (done++ == flushed) {
+          pending_since = Clock::now();
+        }
+      }
+      changed.notify_all();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < workers; ++i) {
+    threads.emplace_back(worker);
+  }
+
+  std::unique_lock<std::mutex> lock(mutex);
+  while (done < queries.size()) {
+    auto now = Clock::now();
+    auto wake = Clock::time_point::max();
+    for (auto& query : running) {
+      if (query.second.deadline <= now) {
+        query.second.cancellation->cancel(
+            "exceeded the distributed_query_timeout of " +
+            std::to_string(timeout.count()) + " seconds");
+        query.second.deadline = Clock::time_point::max();
+      }
+      wake = std::min(wake, query.second.deadline);
     }
 
-    setAsNotRunning(request.query);
+    // Flush the completed results without waiting for the slow queries.
+    if (done > flushed) {
+      if (now - pending_since >= kDistributedFlushDelay) {
+        flushed = done;
+        lock.unlock();
+        flushCompleted();
+        lock.lock();
+        continue;
+      }
+      wake = std::min(wake, pending_since + kDistributedFlushDelay);
+    }
 
-    DistributedQueryResult result(
-        request, sql.rows(), sql.columns(), sql.getStatus(), msg);
-    addResult(result);
+    if (wake == Clock::time_point::max()) {
+      changed.wait(lock);
+    } else {
+      changed.wait_until(lock, wake);
+    }
+  }
+  lock.unlock();
+
+  for (auto& thread : threads) {
+    thread.join();
   }
   return flushCompleted();
 }
@@ -262,19 +701,30 @@ Status Distributed::flushCompleted() {
     return Status(1, "Missing distributed plugin " + distributed_plugin);
   }
 
-  std::string results;
-  auto s = serializeResults(results);
-  if (!s.ok()) {
-    return s;
-  }
+  // Queries still running add their results while these are sent.
+  auto remaining = getCompletedCount();
+  Status s;
+  while (remaining > 0) {
+    std::vector<ResultPart> parts;
+    std::string results;
+    {
+      ReadLock lock(results_mutex_);
+      selectResultParts(
+          remaining, FLAGS_distributed_max_result_part_size, parts);
+      s = serializeResultParts(parts, results);
+    }
+    if (!s.ok() || parts.empty()) {
+      break;
+    }
 
-  PluginResponse response;
-  s = Registry::call("distributed",
-                     {{"action", "writeResults"}, {"results", results}},
-                     response);
-  if (s.ok()) {
-    results_.clear();
-    performance_.clear();
+    PluginResponse response;
+    s = Registry::call("distributed",
+                       {{"action", "writeResults"}, {"results", results}},
+                       response);
+    if (!s.ok()) {
+      break;
+    }
+    remaining -= acknowledgeResultParts(parts);
   }
 
 #ifdef OSQUERY_LINUX
@@ -286,69 +736,54 @@ Status Distributed::flushCompleted() {
 }
 
 Status Distributed::acceptWork(const std::string& work) {
-  auto doc = JSON::newObject();
-  if (!doc.fromString(work) || !doc.doc().IsObject()) {
+  WorkHandler handler;
+  rj::Reader reader;
+  rj::StringStream stream(work.c_str());
+  if (reader.Parse<rj::kParseIterativeFlag>(stream, handler).IsError() ||
+      !handler.root_object) {
     return Status(1, "Error Parsing JSON");
   }
 
+  if (!handler.discovery_strings) {
+    return Status(1, "Distributed discovery query is not a string");
+  }
+
   // Check for and run discovery queries first.
   // Store their result in discovery_results.
   std::map<std::string, bool> discovery_results;
-  if (doc.doc().HasMember("discovery")) {
-    const auto& queries = doc.doc()["discovery"];
-    assert(queries.IsObject());
-
-    if (queries.IsObject()) {
-      for (const auto& query_entry : queries.GetObject()) {
-        if (!query_entry.name.IsString() || !query_entry.value.IsString()) {
-          return Status(1, "Distributed discovery query is not a string");
-        }
-
-        auto name = std::string(query_entry.name.GetString());
-        auto query = std::string(query_entry.value.GetString());
-        if (query.empty() || name.empty()) {
-          return Status(1, "Distributed discovery query is not a string");
-        }
+  for (const auto& entry : handler.discovery) {
+    if (entry.first.empty() || entry.second.empty()) {
+      return Status(1, "Distributed discovery query is not a string");
+    }
 
-        SQL sql(query);
-        if (!sql.getStatus().ok()) {
-          return Status(1, "Distributed discovery query has an SQL error");
-        }
-        discovery_results.insert({name, (sql.rows().size() > 0)});
-      }
+    SQL sql(entry.second);
+    if (!sql.getStatus().ok()) {
+      return Status(1, "Distributed discovery query has an SQL error");
     }
+    discovery_results.insert({entry.first, (sql.rows().size() > 0)});
   }
 
-  if (doc.doc().HasMember("queries")) {
-    const auto& queries = doc.doc()["queries"];
-    assert(queries.IsObject());
-
-    if (queries.IsObject()) {
-      for (const auto& query_entry : queries.GetObject()) {
-        if (!query_entry.name.IsString() || !query_entry.value.IsString()) {
-          return Status(1, "Distributed query is not a string");
-        }
+  if (!handler.queries_strings) {
+    return Status(1, "Distributed query is not a string");
+  }
 
-        auto name = std::string(query_entry.name.GetString());
-        auto query = std::string(query_entry.value.GetString());
-        if (name.empty() || query.empty()) {
-          return Status(1, "Distributed query is not a string");
-        }
+  for (const auto& entry : handler.queries) {
+    if (entry.first.empty() || entry.second.empty()) {
+      return Status(1, "Distributed query is not a string");
+    }
 
-        // If a query does not have a corresponding discovery query
-        // or it does and it returned results, then store the query
-        // for execution.
-        const auto result = discovery_results.find(name);
-        if (result == discovery_results.cend() || result->second) {
-          setDatabaseValue(kDistributedQueries, name, query);
-        }
-      }
+    // If a query does not have a corresponding discovery query
+    // or it does and it returned results, then store the query
+    // for execution.
+    const auto result = discovery_results.find(entry.first);
+    if (result == discovery_results.cend() || result->second) {
+      setDatabaseValue(kDistributedQueries, entry.first, entry.second);
     }
   }
-  if (doc.doc().HasMember("accelerate")) {
-    const auto& accelerate = doc.doc()["accelerate"];
-    if (accelerate.IsInt()) {
-      auto duration = accelerate.GetInt();
+
+  if (handler.has_accelerate) {
+    if (handler.accelerate_int) {
+      auto duration = handler.accelerate;
       LOG(INFO) << "Accelerating distributed query checkins for " << duration
                 << " seconds";
       setDatabaseValue(kPersistentSettings,
@@ -390,7 +825,10 @@ SQL Distributed::monitorNonnumeric(const std::string& name,
 
   using namespace std::chrono;
   auto t0 = steady_clock::now();
+  ScopedAllocationAccount allocations;
   SQL sql(query, true);
+  auto allocated_bytes = allocations.allocated();
+  auto peak_bytes = allocations.peak();
 
   // Snapshot the performance after, and compare.
   auto t1 = steady_clock::now();
@@ -402,8 +840,13 @@ SQL Distributed::monitorNonnumeric(const std::string& name,
   if (r0.size() > 0 && r1.size() > 0) {
     // Always called while processes table is working.
     uint64_t size = sql.rows().size();
-    recordQueryPerformance(
-        name, duration_cast<milliseconds>(t1 - t0).count(), size, r0[0], r1[0]);
+    recordQueryPerformance(name,
+                           duration_cast<milliseconds>(t1 - t0).count(),
+                           size,
+                           r0[0],
+                           r1[0],
+                           allocated_bytes,
+                           peak_bytes);
   }
   return sql;
 }
@@ -412,10 +855,10 @@ void Distributed::recordQueryPerformance(const std::string& name,
                                          uint64_t delay_ms,
                                          uint64_t size,
                                          const Row& r0,
-                                         const Row& r1) {
-  performance_[name] = QueryPerformance();
-
-  auto& query = performance_.at(name);
+                                         const Row& r1,
+                                         uint64_t allocated_bytes,
+                                         uint64_t peak_bytes) {
+  QueryPerformance query;
   if (!r1.at("user_time").empty() && !r0.at("user_time").empty()) {
     auto ut1 = tryTo<long long>(r1.at("user_time"));
     auto ut0 = tryTo<long long>(r0.at("user_time"));
@@ -444,6 +887,11 @@ void Distributed::recordQueryPerformance(const std::string& name,
   }
 
   query.wall_time_ms = delay_ms;
+  query.last_allocated_bytes = allocated_bytes;
+  query.last_peak_bytes = peak_bytes;
+
+  WriteLock lock(results_mutex_);
+  performance_[name] = query;
 }
 
 Status serializeDistributedQueryRequest(const DistributedQueryRequest& r,
@@ -16,6 +16,7 @@
 #include <osquery/core/query.h>
 #include <osquery/core/sql/query_performance.h>
 #include <osquery/sql/sql.h>
+#include <osquery/utils/mutex.h>
 #include <osquery/utils/status/status.h>
 
 namespace osquery {
@@ -96,6 +97,12 @@ struct DistributedQueryResult {
   ColumnNames columns;
   Status status;
   std::string message;
+
+  /// Rows sent in acknowledged parts, their content is already released.
+  size_t sent_rows{0};
+
+  /// Sequence number of the next part of the results.
+  size_t next_part{0};
 };
 
 /**
@@ -216,6 +223,13 @@ class DistributedPlugin : public Plugin {
    *   }
    * @endcode
    *
+   * When distributed_max_result_part_size is set, results are split into
+   * parts of about that size. Each request then has a "parts" object giving
+   * the sequence number of each query's part, the offset of its first row,
+   * and whether it is the last part. Statuses, messages and stats are sent
+   * with every part but stats only with the last one. A part is sent again,
+   * with the same sequence number, until it is acknowledged.
+   *
    * @param json is the results data to write
    * @return a Status indicating the success or failure of the operation
    */
@@ -260,7 +274,14 @@ class Distributed {
   /// Serialize result data into a JSON string and clear the results
   Status serializeResults(std::string& json);
 
-  /// Process and execute queued queries
+  /**
+   * @brief Process and execute queued queries
+   *
+   * Up to distributed_max_concurrency queries run at once. Completed results
+   * are flushed while the other queries run, and a query running longer than
+   * distributed_query_timeout is cancelled. Queries over the
+   * distributed_cost_budget are rejected or deferred first.
+   */
   Status runQueries();
 
   /// Cleanup distributed queries marked as running that have expired.
@@ -296,6 +317,21 @@ class Distributed {
    */
   DistributedQueryRequest popRequest(std::string query);
 
+  /// Pop, execute and add the result of a queued query.
+  void runQuery(const std::string& name);
+
+  /// Pop a queued query and add a failed result instead of running it.
+  void rejectQuery(const std::string& name, const std::string& message);
+
+  /**
+   * @brief Check the estimated cost of queued queries against the budget.
+   *
+   * With a distributed_cost_budget, the queries estimated to cost more are
+   * rejected, or moved after the other queries when distributed_cost_action
+   * is "defer". The remaining queries are left in run order.
+   */
+  void admitQueries(std::vector<std::string>& queries);
+
   /**
    * @brief Queue a result to be batch sent to the server
    *
@@ -334,9 +370,53 @@ class Distributed {
 
   /**
    * @brief Flush all of the collected results to the server
+   *
+   * Results added while the flush is sent are kept for the next flush. Large
+   * results are sent in parts of distributed_max_result_part_size, a failed
+   * flush resumes from the first part that was not acknowledged.
    */
   virtual Status flushCompleted();
 
+  /// The rows of one result sent within a request.
+  struct ResultPart {
+    /// Index of the result in results_.
+    size_t index{0};
+
+    /// Range of the rows in the part.
+    size_t begin{0};
+    size_t end{0};
+
+    size_t sequence{0};
+    bool last{false};
+  };
+
+  /**
+   * @brief Select the parts of the next request
+   *
+   * Parts follow the order of the results, all but the final one are the
+   * last parts of their result. Must be called with results_mutex_ held.
+   *
+   * @param count only the first count results are considered
+   * @param limit the approximate maximum size of the request, 0 for no limit
+   * @param parts [output] the selected parts
+   */
+  void selectResultParts(size_t count,
+                         uint64_t limit,
+                         std::vector<ResultPart>& parts);
+
+  /// Serialize parts of the results, with results_mutex_ held.
+  Status serializeResultParts(const std::vector<ResultPart>& parts,
+                              std::string& json);
+
+  /**
+   * @brief Record that the server received the parts
+   *
+   * Completed results are removed, and the sent rows of the others released.
+   *
+   * @return the number of results removed
+   */
+  size_t acknowledgeResultParts(const std::vector<ResultPart>& parts);
+
   // Setter for ID of currently executing request
   static void setCurrentRequestId(const std::string& cReqId);
 
@@ -352,25 +432,35 @@ class Distributed {
    * @param size number of rows output
    * @param r0 Row generated from first call to the processes table
    * @param r1 Row generated from second call to the processes table
+   * @param allocated_bytes Heap bytes allocated by the query
+   * @param peak_bytes Most heap bytes held by the query
    */
   void recordQueryPerformance(const std::string& name,
                               uint64_t delay_ms,
                               uint64_t size,
                               const Row& r0,
-                              const Row& r1);
+                              const Row& r1,
+                              uint64_t allocated_bytes,
+                              uint64_t peak_bytes);
 
   std::vector<DistributedQueryResult> results_;
 
-  // ID of the currently executing query
-  static std::string currentRequestId_;
+  // ID of the query executing on this thread
+  static thread_local std::string currentRequestId_;
 
   // Performance statistics recorded from distributed queries
   std::map<std::string, QueryPerformance> performance_;
 
+  // Protects the results and performance, queries add them concurrently
+  Mutex results_mutex_;
+
  private:
   friend class DistributedTests;
   FRIEND_TEST(DistributedTests, test_workflow);
   FRIEND_TEST(DistributedTests, test_run_queries_with_denylisted_query);
+  FRIEND_TEST(DistributedTests, test_run_queries_concurrently);
+  FRIEND_TEST(DistributedTests, test_run_queries_over_cost_budget);
+  FRIEND_TEST(DistributedTests, test_flush_results_in_parts);
   FRIEND_TEST(DistributedTests, test_check_and_set_as_running);
   FRIEND_TEST(DistributedTests, test_accept_work_basic);
   FRIEND_TEST(DistributedTests, test_accept_work_with_discovery);
@@ -30,6 +30,11 @@ namespace osquery {
 
 DECLARE_string(distributed_tls_read_endpoint);
 DECLARE_string(distributed_tls_write_endpoint);
+DECLARE_uint64(distributed_max_concurrency);
+DECLARE_uint64(distributed_query_timeout);
+DECLARE_uint64(distributed_max_result_part_size);
+DECLARE_uint64(distributed_cost_budget);
+DECLARE_string(distributed_cost_action);
 
 class DistributedTests : public testing::Test {
  protected:
@@ -343,6 +348,203 @@ TEST_F(DistributedTests, test_run_queries_with_denylisted_query) {
   ASSERT_TRUE(ts2.empty());
 }
 
+class DistributedFlushRecorder : public Distributed {
+ public:
+  Status flushCompleted() override {
+    WriteLock lock(results_mutex_);
+    if (!results_.empty()) {
+      flushes.push_back(std::move(results_));
+      results_.clear();
+    }
+    return Status::success();
+  }
+
+  /// The results of each flush.
+  std::vector<std::vector<DistributedQueryResult>> flushes;
+};
+
+TEST_F(DistributedTests, test_run_queries_concurrently) {
+  FLAGS_distributed_max_concurrency = 2;
+  FLAGS_distributed_query_timeout = 2;
+
+  // The first query never ends on its own.
+  const std::string work = R"json(
+{
+  "queries": {
+    "q1": "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c) SELECT count(*) FROM c;",
+    "q2": "SELECT * FROM osquery_info;"
+  }
+}
+)json";
+  DistributedFlushRecorder dist;
+  auto status = dist.acceptWork(work);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  status = dist.runQueries();
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  FLAGS_distributed_max_concurrency = 1;
+  FLAGS_distributed_query_timeout = 0;
+
+  // The fast query was flushed while the slow query still ran.
+  ASSERT_EQ(2U, dist.flushes.size());
+  ASSERT_EQ(1U, dist.flushes[0].size());
+  EXPECT_EQ("q2", dist.flushes[0][0].request.id);
+  EXPECT_TRUE(dist.flushes[0][0].status.ok());
+
+  // The slow query was cancelled once its timeout passed.
+  ASSERT_EQ(1U, dist.flushes[1].size());
+  EXPECT_EQ("q1", dist.flushes[1][0].request.id);
+  EXPECT_FALSE(dist.flushes[1][0].status.ok());
+  EXPECT_EQ(0U, dist.flushes[1][0].status.getMessage().find("Query cancelled"));
+  EXPECT_TRUE(dist.getPendingQueries().empty());
+}
+
+TEST_F(DistributedTests, test_run_queries_over_cost_budget) {
+  FLAGS_distributed_cost_budget = 100;
+
+  // A pattern on the file path may search the whole filesystem.
+  const std::string work = R"json(
+{
+  "queries": {
+    "q1": "SELECT * FROM file WHERE path LIKE '/osquery_missing_dir/%%';",
+    "q2": "SELECT 1 AS one;"
+  }
+}
+)json";
+  DistributedFlushRecorder dist;
+  auto status = dist.acceptWork(work);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  status = dist.runQueries();
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  std::vector<DistributedQueryResult> results;
+  for (auto& flush : dist.flushes) {
+    results.insert(results.end(), flush.begin(), flush.end());
+  }
+  ASSERT_EQ(2U, results.size());
+  EXPECT_EQ("q1", results[0].request.id);
+  EXPECT_EQ("Over cost budget", results[0].status.getMessage());
+  EXPECT_NE(std::string::npos, results[0].message.find("file: pattern"));
+  EXPECT_EQ("q2", results[1].request.id);
+  EXPECT_TRUE(results[1].status.ok());
+
+  // Deferred queries run after the others.
+  FLAGS_distributed_cost_action = "defer";
+  dist.flushes.clear();
+  status = dist.acceptWork(work);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  status = dist.runQueries();
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  FLAGS_distributed_cost_budget = 0;
+  FLAGS_distributed_cost_action = "reject";
+
+  results.clear();
+  for (auto& flush : dist.flushes) {
+    results.insert(results.end(), flush.begin(), flush.end());
+  }
+  ASSERT_EQ(2U, results.size());
+  EXPECT_EQ("q2", results[0].request.id);
+  EXPECT_EQ("q1", results[1].request.id);
+  EXPECT_TRUE(results[1].status.ok()) << results[1].status.getMessage();
+  EXPECT_TRUE(dist.getPendingQueries().empty());
+}
+
+class RecordingDistributedPlugin : public DistributedPlugin {
+ public:
+  Status getQueries(std::string& json) override {
+    return Status::success();
+  }
+
+  Status writeResults(const std::string& json) override {
+    if (failures > 0) {
+      failures--;
+      return Status::failure("Write failed");
+    }
+    writes.push_back(json);
+    return Status::success();
+  }
+
+  /// Writes to fail before accepting any.
+  size_t failures{0};
+
+  std::vector<std::string> writes;
+};
+
+TEST_F(DistributedTests, test_flush_results_in_parts) {
+  auto plugin = std::make_shared<RecordingDistributedPlugin>();
+  auto& rf = RegistryFactory::get();
+  rf.registry("distributed")->add("recording", plugin);
+  auto distributed_plugin = rf.getActive("distributed");
+  rf.setActive("distributed", "recording");
+
+  // Each row is about 20 bytes, three fit in a part.
+  FLAGS_distributed_max_result_part_size = 64;
+
+  Distributed dist;
+  DistributedQueryResult large;
+  large.request.id = "q1";
+  large.columns = {"value"};
+  for (size_t i = 0; i < 7; ++i) {
+    large.results.push_back({{"value", "row" + std::to_string(i)}});
+  }
+  dist.results_.push_back(large);
+
+  DistributedQueryResult small;
+  small.request.id = "q2";
+  small.columns = {"value"};
+  small.results.push_back({{"value", "row"}});
+  dist.results_.push_back(small);
+
+  std::vector<Distributed::ResultPart> parts;
+  dist.selectResultParts(2, FLAGS_distributed_max_result_part_size, parts);
+  ASSERT_EQ(1U, parts.size());
+  EXPECT_EQ(0U, parts[0].begin);
+  EXPECT_EQ(3U, parts[0].end);
+  EXPECT_FALSE(parts[0].last);
+  EXPECT_EQ(0U, dist.acknowledgeResultParts(parts));
+  EXPECT_EQ(3U, dist.results_[0].sent_rows);
+  EXPECT_TRUE(dist.results_[0].results[0].empty());
+
+  // The second part fails, the next flush resumes from it.
+  plugin->failures = 1;
+  auto status = dist.flushCompleted();
+  EXPECT_FALSE(status.ok());
+  EXPECT_TRUE(plugin->writes.empty());
+  EXPECT_EQ(2U, dist.getCompletedCount());
+
+  status = dist.flushCompleted();
+  EXPECT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ(0U, dist.getCompletedCount());
+  FLAGS_distributed_max_result_part_size = 0;
+  rf.setActive("distributed", distributed_plugin);
+
+  // The remaining rows of q1 are resumed at the second part.
+  ASSERT_EQ(2U, plugin->writes.size());
+  auto first_doc = JSON::newObject();
+  ASSERT_TRUE(first_doc.fromString(plugin->writes[0]));
+  const auto& first = first_doc.doc();
+  ASSERT_EQ(3U, first["queries"]["q1"].Size());
+  EXPECT_EQ("row3",
+            std::string(first["queries"]["q1"][0]["value"].GetString()));
+  EXPECT_EQ(1U, first["parts"]["q1"]["sequence"].GetUint64());
+  EXPECT_EQ(3U, first["parts"]["q1"]["offset"].GetUint64());
+  EXPECT_FALSE(first["parts"]["q1"]["last"].GetBool());
+  EXPECT_FALSE(first["stats"].HasMember("q1"));
+
+  // The last part of q1 shares its request with q2.
+  auto second_doc = JSON::newObject();
+  ASSERT_TRUE(second_doc.fromString(plugin->writes[1]));
+  const auto& second = second_doc.doc();
+  ASSERT_EQ(1U, second["queries"]["q1"].Size());
+  EXPECT_EQ(2U, second["parts"]["q1"]["sequence"].GetUint64());
+  EXPECT_TRUE(second["parts"]["q1"]["last"].GetBool());
+  EXPECT_TRUE(second["stats"].HasMember("q1"));
+  ASSERT_EQ(1U, second["queries"]["q2"].Size());
+  EXPECT_EQ(0U, second["parts"]["q2"]["sequence"].GetUint64());
+  EXPECT_TRUE(second["parts"]["q2"]["last"].GetBool());
+}
+
 TEST_F(DistributedTests, test_accept_work_basic) {
   auto dist = Distributed();
 
@@ -435,4 +637,26 @@ TEST_F(DistributedTests, test_accept_work_with_discovery_all_fail) {
   const auto queries = dist.getPendingQueries();
   ASSERT_EQ(queries.size(), 0);
 }
+
+TEST_F(DistributedTests, test_accept_work_invalid) {
+  auto dist = Distributed();
+
+  auto s = dist.acceptWork(R"json(["queries"])json");
+  EXPECT_EQ("Error Parsing JSON", s.getMessage());
+
+  s = dist.acceptWork(R"json({"queries": {"q1": "SELECT 1;")json");
+  EXPECT_EQ("Error Parsing JSON", s.getMessage());
+
+  s = dist.acceptWork(R"json({"queries": {"q1": {"sql": "SELECT 1;"}}})json");
+  EXPECT_EQ("Distributed query is not a string", s.getMessage());
+
+  s = dist.acceptWork(R"json({"discovery": {"q1": 1}})json");
+  EXPECT_EQ("Distributed discovery query is not a string", s.getMessage());
+
+  // Unknown members are skipped.
+  s = dist.acceptWork(
+      R"json({"other": {"q2": 1}, "queries": {"q1": "SELECT 1;"}})json");
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  EXPECT_EQ(std::vector<std::string>{"q1"}, dist.getPendingQueries());
+}
 } // namespace osquery
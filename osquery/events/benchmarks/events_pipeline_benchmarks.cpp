@@ -0,0 +1,360 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include <benchmark/benchmark.h>
+
+#include <osquery/config/config.h>
+#include <osquery/core/flags.h>
+#include <osquery/core/tables.h>
+#include <osquery/events/eventfactory.h>
+#include <osquery/events/eventpublisher.h>
+#include <osquery/events/eventsubscriber.h>
+#include <osquery/registry/registry_factory.h>
+
+namespace osquery {
+
+DECLARE_uint64(events_expiry);
+
+/// The shape of the synthetic events, after the tables they imitate.
+enum class SyntheticShape {
+  /// An audit process event, like process_events.
+  Audit = 0,
+
+  /// A BPF process event, like bpf_process_events.
+  BPF = 1,
+
+  /// A file integrity event, like file_events.
+  FIM = 2,
+};
+
+const std::vector<std::string> kSyntheticShapeNames{"audit", "bpf", "fim"};
+
+/// The synthetic publisher fires its events in this many ticks per second.
+const size_t kSyntheticTicksPerSecond{10};
+
+struct SyntheticSubscriptionContext : public SubscriptionContext {};
+
+/// The raw values of an event, formatted into a row by the subscriber.
+struct SyntheticEventContext : public EventContext {
+  SyntheticShape shape{SyntheticShape::Audit};
+  std::uint64_t sequence{0};
+};
+
+using SyntheticEventContextRef = std::shared_ptr<SyntheticEventContext>;
+using SyntheticSubscriptionContextRef =
+    std::shared_ptr<SyntheticSubscriptionContext>;
+
+/**
+ * @brief A publisher of synthetic events at a target rate.
+ *
+ * Each run fires the events of one tick in batches, like the audit and BPF
+ * publishers fire the records read from the kernel, and then waits for the
+ * rest of the tick. When the subscribers cannot keep up, a tick takes longer
+ * and the achieved rate falls below the target.
+ */
+class SyntheticEventPublisher
+    : public EventPublisher<SyntheticSubscriptionContext,
+                            SyntheticEventContext> {
+  DECLARE_PUBLISHER("synthetic");
+
+ public:
+  void configure(SyntheticShape shape, size_t rate, size_t batch_size) {
+    shape_ = shape;
+    rate_ = rate;
+    batch_size_ = std::max<size_t>(batch_size, 1);
+  }
+
+  /// Fire a number of events in batches, returns the number fired.
+  size_t generate(size_t count) {
+    size_t fired = 0;
+    while (fired < count) {
+      auto batch = std::min(batch_size_, count - fired);
+      EventContextList ec_list;
+      ec_list.reserve(batch);
+      for (size_t i = 0; i < batch; ++i) {
+        auto ec = createEventContext();
+        ec->shape = shape_;
+        ec->sequence = sequence_++;
+        ec_list.push_back(std::move(ec));
+      }
+      fire(ec_list);
+      fired += batch;
+    }
+    return fired;
+  }
+
+  Status run() override {
+    auto tick = std::chrono::microseconds(1000000 / kSyntheticTicksPerSecond);
+    auto start = std::chrono::steady_clock::now();
+    generate(rate_ / kSyntheticTicksPerSecond);
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    if (elapsed < tick) {
+      std::this_thread::sleep_for(tick - elapsed);
+    }
+    return Status::success();
+  }
+
+ private:
+  SyntheticShape shape_{SyntheticShape::Audit};
+  size_t rate_{10000};
+  size_t batch_size_{64};
+  std::uint64_t sequence_{0};
+};
+
+REGISTER(SyntheticEventPublisher, "event_publisher", "synthetic");
+
+/**
+ * @brief A subscriber storing the synthetic events.
+ *
+ * The events are formatted into rows with the columns of the imitated table
+ * and stored with one addBatch per fired batch. The subscriber may use a
+ * simulated clock, which lets a benchmark run through expiry quickly.
+ */
+class SyntheticEventSubscriber
+    : public EventSubscriber<SyntheticEventPublisher> {
+ public:
+  SyntheticEventSubscriber() {
+    setName("synthetic_events");
+  }
+
+  Status init() override {
+    subscribeBatch(&SyntheticEventSubscriber::Callback,
+                   createSubscriptionContext());
+    return Status::success();
+  }
+
+  Status Callback(const std::vector<ECRef>& ec_list, const SCRef& sc) {
+    std::vector<Row> rows;
+    rows.reserve(ec_list.size());
+    for (const auto& ec : ec_list) {
+      rows.push_back(formatRow(*ec));
+    }
+    return addBatch(rows, simulated_time_);
+  }
+
+  /// Use a simulated clock and expiry, 0 uses the real ones.
+  void simulate(EventTime time, size_t expiry) {
+    simulated_time_ = time;
+    simulated_expiry_ = expiry;
+  }
+
+  /// Query the stored events like a SELECT * of the table.
+  size_t select() {
+    QueryContext ctx;
+    size_t rows = 0;
+    RowGenerator::pull_type generator(
+        [this, &ctx](RowYield& yield) { genTable(yield, ctx); });
+    while (generator) {
+      generator.get();
+      generator();
+      rows++;
+    }
+    return rows;
+  }
+
+  /// Remove every stored event, a select expires the events it has read.
+  void clear() {
+    simulate(EventSubscriberPlugin::getTime() + 2, 1);
+    select();
+    simulate(0, 0);
+  }
+
+ protected:
+  uint64_t getTime() const override {
+    return (simulated_time_ != 0) ? simulated_time_
+                                  : EventSubscriberPlugin::getTime();
+  }
+
+ private:
+  size_t getEventsExpiry() override {
+    return (simulated_expiry_ != 0) ? simulated_expiry_ : FLAGS_events_expiry;
+  }
+
+  static Row formatRow(const SyntheticEventContext& ec) {
+    auto sequence = std::to_string(ec.sequence);
+    auto pid = std::to_string(1000 + ec.sequence % 30000);
+    auto path = "/usr/lib/synthetic/bin" + std::to_string(ec.sequence % 64);
+
+    Row r;
+    switch (ec.shape) {
+    case SyntheticShape::Audit:
+      r["pid"] = pid;
+      r["path"] = path;
+      r["mode"] = "0100755";
+      r["cmdline"] = path + " --id " + sequence + " --verbose";
+      r["cwd"] = "/home/user";
+      r["auid"] = "1000";
+      r["uid"] = "1000";
+      r["euid"] = "1000";
+      r["gid"] = "1000";
+      r["egid"] = "1000";
+      r["owner_uid"] = "0";
+      r["owner_gid"] = "0";
+      r["atime"] = sequence;
+      r["mtime"] = sequence;
+      r["ctime"] = sequence;
+      r["btime"] = "0";
+      r["parent"] = "1";
+      r["syscall"] = "execve";
+      break;
+    case SyntheticShape::BPF:
+      r["tid"] = pid;
+      r["pid"] = pid;
+      r["parent"] = "1";
+      r["uid"] = "1000";
+      r["gid"] = "1000";
+      r["cid"] = "0";
+      r["exit_code"] = "0";
+      r["probe_error"] = "0";
+      r["syscall"] = "exec";
+      r["path"] = path;
+      r["cwd"] = "/home/user";
+      r["cmdline"] = path + " --id " + sequence;
+      r["json_cmdline"] = "[\"" + path + "\",\"--id\",\"" + sequence + "\"]";
+      r["duration"] = "12345";
+      r["ntime"] = sequence;
+      break;
+    case SyntheticShape::FIM:
+      r["target_path"] = "/etc/synthetic/file" + sequence;
+      r["category"] = "etc";
+      r["action"] = (ec.sequence % 2 == 0) ? "UPDATED" : "CREATED";
+      r["transaction_id"] = sequence;
+      r["inode"] = sequence;
+      r["uid"] = "0";
+      r["gid"] = "0";
+      r["mode"] = "0644";
+      r["size"] = "4096";
+      r["atime"] = sequence;
+      r["mtime"] = sequence;
+      r["ctime"] = sequence;
+      r["md5"] = "";
+      r["sha1"] = "";
+      r["sha256"] = "";
+      r["hashed"] = "0";
+      break;
+    }
+    return r;
+  }
+
+  EventTime simulated_time_{0};
+  size_t simulated_expiry_{0};
+};
+
+/// Register the synthetic publisher and subscriber with the event factory.
+static std::pair<std::shared_ptr<SyntheticEventPublisher>,
+                 std::shared_ptr<SyntheticEventSubscriber>>
+setUpSyntheticEvents(benchmark::State& state, size_t rate, size_t batch) {
+  RegistryFactory::get().setActive("database", "rocksdb");
+  Config::get().getParser("events")->setUp();
+
+  auto shape = static_cast<SyntheticShape>(state.range(0));
+  state.SetLabel(kSyntheticShapeNames[state.range(0)]);
+
+  auto pub = std::make_shared<SyntheticEventPublisher>();
+  pub->configure(shape, rate, batch);
+  EventFactory::registerEventPublisher(pub);
+
+  auto sub = std::make_shared<SyntheticEventSubscriber>();
+  EventFactory::registerEventSubscriber(sub);
+  sub->init();
+  return {pub, sub};
+}
+
+static void tearDownSyntheticEvents(
+    const std::shared_ptr<SyntheticEventSubscriber>& sub) {
+  sub->clear();
+  EventFactory::deregisterEventPublisher("synthetic");
+}
+
+static void EVENTS_pipeline_fire(benchmark::State& state) {
+  // Fire, subscriber callback, addBatch and the database write.
+  auto batch = static_cast<size_t>(state.range(1));
+  auto synthetic = setUpSyntheticEvents(state, 0, batch);
+
+  size_t events = 0;
+  while (state.KeepRunning()) {
+    events += synthetic.first->generate(batch);
+  }
+  state.SetItemsProcessed(events);
+  tearDownSyntheticEvents(synthetic.second);
+}
+
+BENCHMARK(EVENTS_pipeline_fire)
+    ->Args({0, 1})
+    ->Args({0, 64})
+    ->Args({1, 64})
+    ->Args({2, 1})
+    ->Args({2, 64});
+
+static void EVENTS_pipeline_sustained(benchmark::State& state) {
+  // Each iteration is one publisher tick at the target rate.
+  auto rate = static_cast<size_t>(state.range(1));
+  auto synthetic = setUpSyntheticEvents(state, rate, 64);
+
+  while (state.KeepRunning()) {
+    synthetic.first->run();
+  }
+  state.SetItemsProcessed(state.iterations() *
+                          (rate / kSyntheticTicksPerSecond));
+  state.counters["target_rate"] = static_cast<double>(rate);
+  tearDownSyntheticEvents(synthetic.second);
+}
+
+BENCHMARK(EVENTS_pipeline_sustained)
+    ->Args({0, 10000})
+    ->Args({0, 100000})
+    ->Args({1, 100000})
+    ->Args({2, 10000})
+    ->UseRealTime();
+
+static void EVENTS_pipeline_select(benchmark::State& state) {
+  // The cost of a SELECT * over the stored events.
+  auto synthetic = setUpSyntheticEvents(state, 0, 256);
+  synthetic.first->generate(static_cast<size_t>(state.range(1)));
+
+  size_t rows = 0;
+  while (state.KeepRunning()) {
+    rows += synthetic.second->select();
+  }
+  state.SetItemsProcessed(rows);
+  tearDownSyntheticEvents(synthetic.second);
+}
+
+BENCHMARK(EVENTS_pipeline_select)
+    ->Args({0, 1000})
+    ->Args({0, 100000})
+    ->Args({2, 100000});
+
+static void EVENTS_pipeline_expire_under_load(benchmark::State& state) {
+  // Each batch is a simulated second later than the previous one, with a
+  // 60 second expiry the oldest buckets are removed while events are added.
+  auto synthetic = setUpSyntheticEvents(state, 0, 256);
+  auto& sub = synthetic.second;
+
+  EventTime time = 1000000;
+  size_t events = 0;
+  while (state.KeepRunning()) {
+    sub->simulate(time++, 60);
+    events += synthetic.first->generate(state.range(1));
+  }
+  state.SetItemsProcessed(events);
+  tearDownSyntheticEvents(sub);
+}
+
+BENCHMARK(EVENTS_pipeline_expire_under_load)
+    ->Args({0, 256})
+    ->Args({0, 4096})
+    ->Args({2, 4096});
+
+} // namespace osquery
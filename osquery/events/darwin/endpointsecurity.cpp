@@ -18,6 +18,8 @@
 namespace osquery {
 
 DECLARE_bool(disable_endpointsecurity);
+DECLARE_string(es_mute_path_literal);
+DECLARE_string(es_mute_path_prefix);
 
 REGISTER(EndpointSecurityPublisher, "event_publisher", "endpointsecurity")
 
@@ -57,6 +59,11 @@ void EndpointSecurityPublisher::configure() {
     return;
   }
 
+  // Muted executables, such as build tools, are dropped by the kernel before
+  // a message is sent
+  muteEsPaths(
+      es_client_, FLAGS_es_mute_path_literal, FLAGS_es_mute_path_prefix);
+
   for (auto& sub : subscriptions_) {
     auto sc = getSubscriptionContext(sub->context);
     auto events = sc->es_event_subscriptions_;
@@ -82,6 +89,14 @@ void EndpointSecurityPublisher::tearDown() {
   }
 }
 
+Status EndpointSecurityPublisher::run() {
+  auto ec_list = batch_.take();
+  if (!ec_list.empty()) {
+    fire(ec_list);
+  }
+  return Status::success();
+}
+
 void EndpointSecurityPublisher::handleMessage(const es_message_t* message) {
   if (message == nullptr) {
     return;
@@ -150,7 +165,7 @@ void EndpointSecurityPublisher::handleMessage(const es_message_t* message) {
     break;
   }
 
-  EventFactory::fire<EndpointSecurityPublisher>(ec);
+  batch_.push(std::move(ec));
 }
 
 bool EndpointSecurityPublisher::shouldFire(
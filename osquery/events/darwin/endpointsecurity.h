@@ -14,6 +14,9 @@
 #include <libproc.h>
 #include <os/availability.h>
 
+#include <condition_variable>
+#include <mutex>
+
 #include <osquery/core/flags.h>
 #include <osquery/core/plugins/plugin.h>
 #include <osquery/events/eventpublisher.h>
@@ -103,6 +106,30 @@ struct EndpointSecurityFileEventContext : EndpointSecurityEventContext {
 using EndpointSecurityFileEventContextRef =
     std::shared_ptr<EndpointSecurityFileEventContext>;
 
+/**
+ * @brief Events converted on an EndpointSecurity client queue.
+ *
+ * The client handler only converts the messages, the publisher run loop takes
+ * the events in batches and fires them with a single call, so subscribers
+ * can store each batch at once.
+ */
+class EndpointSecurityEventBatch {
+ public:
+  /// Queue an event, wakes the run loop when a batch is full.
+  void push(EventContextRef ec);
+
+  /// Wait for a full batch or the batch latency, and take the events.
+  EventContextList take();
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  EventContextList events_;
+
+  /// Events dropped since the last batch, when the run loop fell behind.
+  size_t dropped_{0};
+};
+
 class EndpointSecurityPublisher
     : public EventPublisher<EndpointSecuritySubscriptionContext,
                             EndpointSecurityEventContext> {
@@ -121,9 +148,7 @@ class EndpointSecurityPublisher
 
   void tearDown() override API_AVAILABLE(macos(10.15));
 
-  Status run() override API_AVAILABLE(macos(10.15)) {
-    return Status::success();
-  }
+  Status run() override API_AVAILABLE(macos(10.15));
 
   bool shouldFire(const EndpointSecuritySubscriptionContextRef& sc,
                   const EndpointSecurityEventContextRef& ec) const override
@@ -134,12 +159,12 @@ class EndpointSecurityPublisher
   }
 
  public:
-  static void handleMessage(const es_message_t* message)
-      API_AVAILABLE(macos(10.15));
+  void handleMessage(const es_message_t* message) API_AVAILABLE(macos(10.15));
 
  private:
   es_client_s* es_client_{nullptr};
   bool es_client_success_{false};
+  EndpointSecurityEventBatch batch_;
 };
 
 class EndpointSecurityFileEventPublisher
@@ -160,9 +185,7 @@ class EndpointSecurityFileEventPublisher
 
   void tearDown() override API_AVAILABLE(macos(10.15));
 
-  Status run() override API_AVAILABLE(macos(10.15)) {
-    return Status::success();
-  }
+  Status run() override API_AVAILABLE(macos(10.15));
 
   bool shouldFire(const EndpointSecurityFileSubscriptionContextRef& sc,
                   const EndpointSecurityFileEventContextRef& ec) const override
@@ -173,14 +196,12 @@ class EndpointSecurityFileEventPublisher
   }
 
  public:
-  static void handleMessage(const es_message_t* message)
-      API_AVAILABLE(macos(10.15));
+  void handleMessage(const es_message_t* message) API_AVAILABLE(macos(10.15));
 
  private:
   es_client_s* es_file_client_{nullptr};
   bool es_file_client_success_{false};
-  std::vector<std::string> muted_path_literals_;
-  std::vector<std::string> muted_path_prefixes_;
+  EndpointSecurityEventBatch batch_;
   // clang-format off
   std::vector<std::string> default_muted_path_literals_ = {
       "/System/Library/PrivateFrameworks/SkyLight.framework/Versions/A/Resources/WindowServer",
@@ -206,7 +227,7 @@ class ESProcessEventSubscriber
   }
 
   Status init() override API_AVAILABLE(macos(10.15));
-  Status Callback(const EndpointSecurityEventContextRef& ec,
+  Status Callback(const std::vector<EndpointSecurityEventContextRef>& ec_list,
                   const EndpointSecuritySubscriptionContextRef& sc)
       API_AVAILABLE(macos(10.15));
 };
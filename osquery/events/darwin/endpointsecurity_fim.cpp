@@ -9,8 +9,6 @@
 
 #include <iomanip>
 
-#include <boost/algorithm/string/classification.hpp>
-#include <boost/algorithm/string/split.hpp>
 #include <osquery/core/flags.h>
 #include <osquery/events/darwin/endpointsecurity.h>
 #include <osquery/events/darwin/es_utils.h>
@@ -23,6 +21,7 @@ DECLARE_bool(disable_endpointsecurity);
 DECLARE_bool(disable_endpointsecurity_fim);
 DECLARE_string(es_fim_mute_path_literal);
 DECLARE_string(es_fim_mute_path_prefix);
+DECLARE_string(es_fim_mute_target_path_prefix);
 
 REGISTER(EndpointSecurityFileEventPublisher,
          "event_publisher",
@@ -40,18 +39,6 @@ Status EndpointSecurityFileEventPublisher::setUp() {
           1, "EndpointSecurity FIM is disabled via configuration");
     }
 
-    if (!FLAGS_es_fim_mute_path_literal.empty()) {
-      boost::split(muted_path_literals_,
-                   FLAGS_es_fim_mute_path_literal,
-                   boost::is_any_of(","));
-    }
-
-    if (!FLAGS_es_fim_mute_path_prefix.empty()) {
-      boost::split(muted_path_prefixes_,
-                   FLAGS_es_fim_mute_path_prefix,
-                   boost::is_any_of(","));
-    }
-
     auto handler = ^(es_client_t* client, const es_message_t* message) {
       handleMessage(message);
     };
@@ -80,23 +67,29 @@ void EndpointSecurityFileEventPublisher::configure() {
     return;
   }
 
+  // The mute lists are read from the configuration options on each update
   for (auto& sub : subscriptions_) {
     auto sc = getSubscriptionContext(sub->context);
     auto events = sc->es_file_event_subscriptions_;
 
-    for (const auto& p : muted_path_literals_) {
-      auto result = es_mute_path_literal(es_file_client_, p.c_str());
-      if (result == ES_RETURN_ERROR) {
-        VLOG(1) << "Unable to mute path literal: " << p;
-      }
-    }
-
-    for (const auto& p : muted_path_prefixes_) {
-      auto result = es_mute_path_prefix(es_file_client_, p.c_str());
-      if (result == ES_RETURN_ERROR) {
-        VLOG(1) << "Unable to mute path with prefix: " << p;
+    muteEsPaths(es_file_client_,
+                FLAGS_es_fim_mute_path_literal,
+                FLAGS_es_fim_mute_path_prefix);
+
+    // Files below the muted prefixes are dropped whichever process writes
+    // them, before a message is sent
+#if defined(__MAC_13_0)
+    if (__builtin_available(macos 13.0, *)) {
+      for (const auto& p :
+           splitEsPathList(FLAGS_es_fim_mute_target_path_prefix)) {
+        auto result = es_mute_path(
+            es_file_client_, p.c_str(), ES_MUTE_PATH_TYPE_TARGET_PREFIX);
+        if (result == ES_RETURN_ERROR) {
+          VLOG(1) << "Unable to mute target path with prefix: " << p;
+        }
       }
     }
+#endif
 
     for (const auto& p : default_muted_path_literals_) {
       auto result = es_mute_path_literal(es_file_client_, p.c_str());
@@ -121,6 +114,14 @@ void EndpointSecurityFileEventPublisher::configure() {
   }
 }
 
+Status EndpointSecurityFileEventPublisher::run() {
+  auto ec_list = batch_.take();
+  if (!ec_list.empty()) {
+    fire(ec_list);
+  }
+  return Status::success();
+}
+
 bool EndpointSecurityFileEventPublisher::shouldFire(
     const EndpointSecurityFileSubscriptionContextRef& sc,
     const EndpointSecurityFileEventContextRef& ec) const {
@@ -206,7 +207,7 @@ void EndpointSecurityFileEventPublisher::handleMessage(
     VLOG(1) << "endpointsecurity_fim: unexpected event " << message->event_type;
     break;
   }
-  EventFactory::fire<EndpointSecurityFileEventPublisher>(ec);
+  batch_.push(std::move(ec));
 }
 
 } // namespace osquery
\ No newline at end of file
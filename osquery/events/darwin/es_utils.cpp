@@ -8,12 +8,19 @@
  */
 
 #include <Kernel/kern/cs_blobs.h>
+#include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/join.hpp>
+#include <algorithm>
+#include <boost/algorithm/string/split.hpp>
+#include <chrono>
 #include <iomanip>
+#include <mutex>
 #include <osquery/core/flags.h>
 #include <osquery/events/darwin/endpointsecurity.h>
+#include <osquery/events/darwin/es_utils.h>
 #include <osquery/logger/logger.h>
 #include <pwd.h>
+#include <unordered_map>
 
 namespace osquery {
 
@@ -37,6 +44,111 @@ FLAG(string,
      "",
      "Comma delimited list of path prefxes to be muted for FIM");
 
+FLAG(string,
+     es_fim_mute_target_path_prefix,
+     "",
+     "Comma delimited list of file path prefixes to be muted for FIM");
+
+FLAG(string,
+     es_mute_path_literal,
+     "",
+     "Comma delimited list of executables whose process events are muted");
+
+FLAG(string,
+     es_mute_path_prefix,
+     "",
+     "Comma delimited list of executable prefixes whose process events are "
+     "muted");
+
+namespace {
+
+/// The longest a converted event waits for its batch to fill up.
+const std::chrono::milliseconds kESBatchLatency{100};
+
+/// The number of events that wakes the run loop before the batch latency.
+const size_t kESBatchSize{256};
+
+/// Events are dropped when this many are waiting for the run loop.
+const size_t kESMaxPendingEvents{65536};
+
+/// Enrichment caches are cleared when they reach this many entries.
+const size_t kESMaxCacheEntries{4096};
+
+/// The code signing columns of an executable, shared by its processes.
+struct ESExecutableIdentity {
+  std::string signing_id;
+  std::string team_id;
+  std::string cdhash;
+  std::string codesigning_flags;
+};
+
+std::mutex kESCacheMutex;
+
+/// Identities keyed by the executable path, cdhash and code signing flags.
+std::unordered_map<std::string, std::shared_ptr<const ESExecutableIdentity>>
+    kESExecutableIdentities;
+
+std::unordered_map<uid_t, std::string> kESUsernames;
+
+} // namespace
+
+void EndpointSecurityEventBatch::push(EventContextRef ec) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (events_.size() >= kESMaxPendingEvents) {
+    dropped_++;
+    return;
+  }
+
+  events_.push_back(std::move(ec));
+  if (events_.size() == kESBatchSize) {
+    cv_.notify_one();
+  }
+}
+
+EventContextList EndpointSecurityEventBatch::take() {
+  EventContextList events;
+  size_t dropped = 0;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait_for(lock, kESBatchLatency, [this]() {
+      return events_.size() >= kESBatchSize;
+    });
+    events.swap(events_);
+    std::swap(dropped, dropped_);
+  }
+
+  if (dropped > 0) {
+    VLOG(1) << "endpointsecurity: dropped " << dropped
+            << " events while the publisher was behind";
+  }
+  return events;
+}
+
+std::vector<std::string> splitEsPathList(const std::string& list) {
+  std::vector<std::string> paths;
+  if (!list.empty()) {
+    boost::split(paths, list, boost::is_any_of(","));
+  }
+  paths.erase(std::remove(paths.begin(), paths.end(), ""), paths.end());
+  return paths;
+}
+
+void muteEsPaths(es_client_t* client,
+                 const std::string& literals,
+                 const std::string& prefixes) {
+  for (const auto& p : splitEsPathList(literals)) {
+    if (es_mute_path_literal(client, p.c_str()) == ES_RETURN_ERROR) {
+      VLOG(1) << "Unable to mute path literal: " << p;
+    }
+  }
+
+  for (const auto& p : splitEsPathList(prefixes)) {
+    if (es_mute_path_prefix(client, p.c_str()) == ES_RETURN_ERROR) {
+      VLOG(1) << "Unable to mute path with prefix: " << p;
+    }
+  }
+}
+
 std::string getEsNewClientErrorMessage(const es_new_client_result_t r) {
   switch (r) {
   case ES_NEW_CLIENT_RESULT_ERR_INTERNAL:
@@ -126,6 +238,60 @@ std::string getCDHash(const es_process_t* p) {
   return s.find_first_not_of(s.front()) == std::string::npos ? "" : s;
 }
 
+/// Get the code signing columns of the executable of a process.
+static std::shared_ptr<const ESExecutableIdentity> getExecutableIdentity(
+    const es_process_t* p) {
+  std::string key(p->executable->path.data, p->executable->path.length);
+  key.append(reinterpret_cast<const char*>(p->cdhash), sizeof(p->cdhash));
+  key.append(reinterpret_cast<const char*>(&p->codesigning_flags),
+             sizeof(p->codesigning_flags));
+
+  {
+    std::lock_guard<std::mutex> lock(kESCacheMutex);
+    auto it = kESExecutableIdentities.find(key);
+    if (it != kESExecutableIdentities.end()) {
+      return it->second;
+    }
+  }
+
+  auto identity = std::make_shared<ESExecutableIdentity>();
+  identity->signing_id = getSigningId(p);
+  identity->team_id = getTeamId(p);
+  identity->cdhash = getCDHash(p);
+  identity->codesigning_flags = getCodesigningFlags(p);
+
+  std::lock_guard<std::mutex> lock(kESCacheMutex);
+  if (kESExecutableIdentities.size() >= kESMaxCacheEntries) {
+    kESExecutableIdentities.clear();
+  }
+  kESExecutableIdentities.emplace(std::move(key), identity);
+  return identity;
+}
+
+/// Get the name of a user, the names are looked up once.
+static std::string getUsername(uid_t uid) {
+  {
+    std::lock_guard<std::mutex> lock(kESCacheMutex);
+    auto it = kESUsernames.find(uid);
+    if (it != kESUsernames.end()) {
+      return it->second;
+    }
+  }
+
+  auto user = getpwuid(uid);
+  std::string username;
+  if (user != nullptr && user->pw_name != nullptr) {
+    username = user->pw_name;
+  }
+
+  std::lock_guard<std::mutex> lock(kESCacheMutex);
+  if (kESUsernames.size() >= kESMaxCacheEntries) {
+    kESUsernames.clear();
+  }
+  kESUsernames.emplace(uid, username);
+  return username;
+}
+
 void getProcessProperties(const es_process_t* p,
                           const EndpointSecurityEventContextRef& ec) {
   auto audit_token = p->audit_token;
@@ -141,16 +307,14 @@ void getProcessProperties(const es_process_t* p,
   ec->gid = audit_token_to_rgid(audit_token);
   ec->egid = audit_token_to_egid(audit_token);
 
-  ec->signing_id = getSigningId(p);
-  ec->team_id = getTeamId(p);
-  ec->cdhash = getCDHash(p);
+  auto identity = getExecutableIdentity(p);
+  ec->signing_id = identity->signing_id;
+  ec->team_id = identity->team_id;
+  ec->cdhash = identity->cdhash;
   ec->platform_binary = p->is_platform_binary;
-  ec->codesigning_flags = getCodesigningFlags(p);
-
-  auto user = getpwuid(ec->uid);
-  ec->username = user->pw_name != nullptr ? std::string(user->pw_name) : "";
+  ec->codesigning_flags = identity->codesigning_flags;
 
-  ec->cwd = getCwdPathFromPid(ec->pid);
+  ec->username = getUsername(ec->uid);
 }
 
 } // namespace osquery
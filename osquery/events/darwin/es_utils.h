@@ -25,4 +25,12 @@ std::string getCwdPathFromPid(pid_t pid);
 std::string getCDHash(const es_process_t* p);
 void getProcessProperties(const es_process_t* p,
                           const EndpointSecurityEventContextRef& ec);
+
+/// Split a comma delimited list of paths, ignoring empty items.
+std::vector<std::string> splitEsPathList(const std::string& list);
+
+/// Mute the events of the processes whose executable matches the paths.
+void muteEsPaths(es_client_t* client,
+                 const std::string& literals,
+                 const std::string& prefixes);
 } // namespace osquery
\ No newline at end of file
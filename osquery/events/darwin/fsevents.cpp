@@ -9,6 +9,9 @@
 
 #include <fnmatch.h>
 
+#include <algorithm>
+#include <unordered_map>
+
 #include <boost/filesystem.hpp>
 
 #include <osquery/config/config.h>
@@ -36,6 +39,11 @@ namespace osquery {
 
 DECLARE_bool(enable_file_events);
 
+FLAG(bool,
+     fsevents_coalesce,
+     true,
+     "Coalesce the FSEvents notifications of a path within the stream latency");
+
 std::map<FSEventStreamEventFlags, std::string> kMaskActions = {
     {kFSEventStreamEventFlagItemChangeOwner, "ATTRIBUTES_MODIFIED"},
     {kFSEventStreamEventFlagItemXattrMod, "ATTRIBUTES_MODIFIED"},
@@ -276,13 +284,35 @@ void FSEventsEventPublisher::Callback(
     void* event_paths,
     const FSEventStreamEventFlags fsevent_flags[],
     const FSEventStreamEventId fsevent_ids[]) {
+  // The stream delivers the notifications of a latency window at once. The
+  // notifications of a path are coalesced into one event: the flags are
+  // combined and the last transaction id is kept.
+  std::vector<FSEventsEventContextRef> events;
+  std::unordered_map<std::string, size_t> path_events;
+
   for (size_t i = 0; i < num_events; ++i) {
+    std::string event_path(((char**)event_paths)[i]);
+    if (FLAGS_fsevents_coalesce) {
+      auto it = path_events.find(event_path);
+      if (it != path_events.end()) {
+        auto& ec = events[it->second];
+        ec->fsevent_flags |= fsevent_flags[i];
+        ec->transaction_id = fsevent_ids[i];
+        ec->event_count++;
+        continue;
+      }
+      path_events.emplace(event_path, events.size());
+    }
+
     auto ec = createEventContext();
     ec->fsevent_stream = stream;
     ec->fsevent_flags = fsevent_flags[i];
     ec->transaction_id = fsevent_ids[i];
-    ec->path = std::string(((char**)event_paths)[i]);
+    ec->path = std::move(event_path);
+    events.push_back(std::move(ec));
+  }
 
+  for (const auto& ec : events) {
     if (ec->fsevent_flags & kFSEventStreamEventFlagMustScanSubDirs) {
       // The FSEvents thread coalesced events within and will report a root.
       TLOG << "FSEvents collision, root: " << ec->path;
@@ -307,11 +337,24 @@ void FSEventsEventPublisher::Callback(
 
     // Record the string-version of the first matched mask bit.
     bool has_action = false;
+    std::vector<std::string> fired_actions;
     for (const auto& action : kMaskActions) {
       if (ec->fsevent_flags & action.first) {
-        // Actions may be multiplexed. Fire and event for each.
-        ec->action = action.second;
-        EventFactory::fire<FSEventsEventPublisher>(ec);
+        // Several flags share an action, a coalesced event fires it once.
+        if (FLAGS_fsevents_coalesce) {
+          if (std::find(fired_actions.begin(),
+                        fired_actions.end(),
+                        action.second) != fired_actions.end()) {
+            continue;
+          }
+          fired_actions.push_back(action.second);
+        }
+
+        // Actions may be multiplexed. Fire and event for each, subscribers
+        // may keep the events so each gets its own context.
+        auto action_ec = std::make_shared<FSEventsEventContext>(*ec);
+        action_ec->action = action.second;
+        EventFactory::fire<FSEventsEventPublisher>(action_ec);
         has_action = true;
       }
     }
@@ -72,6 +72,9 @@ struct FSEventsEventContext : public EventContext {
 
   std::string path;
   std::string action;
+
+  /// The number of notifications coalesced into this event.
+  size_t event_count{1};
 };
 
 using FSEventsEventContextRef = std::shared_ptr<FSEventsEventContext>;
@@ -189,5 +192,6 @@ class FSEventsEventPublisher
   FRIEND_TEST(FSEventsTests, test_fsevents_event_action);
   FRIEND_TEST(FSEventsTests, test_fsevents_embedded_wildcards);
   FRIEND_TEST(FSEventsTests, test_fsevents_match_subscription);
+  FRIEND_TEST(FSEventsTests, test_fsevents_coalesce);
 };
 }
@@ -13,6 +13,7 @@
 #include <osquery/events/darwin/iokit.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
+#include <osquery/sql/step_generations.h>
 #include <osquery/utils/conversions/darwin/iokit.h>
 
 namespace osquery {
@@ -137,6 +138,9 @@ void IOKitEventPublisher::newEvent(const io_service_t& device,
   }
 
   CFRelease(details);
+
+  // Tables of the hardware are generated again after a device changed.
+  resetBootGenerations();
   fire(ec);
 }
 
@@ -0,0 +1,135 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+
+#include <boost/algorithm/string.hpp>
+
+#include <osquery/events/eventaggregator.h>
+
+namespace osquery {
+
+namespace {
+
+/// Groups open at once, the oldest are emitted early beyond this.
+const std::size_t kMaxEventGroups{10000U};
+
+} // namespace
+
+void EventAggregator::configure(std::size_t window,
+                                const std::string& key_columns) {
+  std::vector<std::string> columns;
+  boost::split(columns, key_columns, boost::is_any_of(","));
+  for (auto& column : columns) {
+    boost::trim(column);
+  }
+  columns.erase(std::remove(columns.begin(), columns.end(), std::string()),
+                columns.end());
+
+  WriteLock lock(mutex_);
+  window_ = window;
+  key_columns_ = std::move(columns);
+}
+
+bool EventAggregator::enabled() const {
+  ReadLock lock(mutex_);
+  return window_ > 0;
+}
+
+std::vector<Row> EventAggregator::add(std::vector<Row> rows, EventTime time) {
+  auto closed = flush(time);
+
+  WriteLock lock(mutex_);
+  if (window_ == 0) {
+    for (auto& row : rows) {
+      Group group{std::move(row), 1U, time, time};
+      closed.push_back(groupRow(group));
+    }
+    return closed;
+  }
+
+  for (auto& row : rows) {
+    auto key = groupKey(row);
+    auto it = groups_.find(key);
+    if (it != groups_.end()) {
+      it->second.count++;
+      it->second.last_time = time;
+      continue;
+    }
+
+    if (groups_.size() >= kMaxEventGroups) {
+      emit(closed, 1U);
+    }
+
+    groups_.emplace(key, Group{std::move(row), 1U, time, time});
+    order_.push_back(std::move(key));
+  }
+  return closed;
+}
+
+std::vector<Row> EventAggregator::flush(EventTime time) {
+  std::vector<Row> rows;
+
+  WriteLock lock(mutex_);
+  std::size_t count{0U};
+  for (const auto& key : order_) {
+    if (groups_.at(key).first_time + window_ > time) {
+      break;
+    }
+    count++;
+  }
+
+  emit(rows, count);
+  return rows;
+}
+
+std::vector<Row> EventAggregator::flushAll() {
+  std::vector<Row> rows;
+
+  WriteLock lock(mutex_);
+  emit(rows, order_.size());
+  return rows;
+}
+
+std::size_t EventAggregator::size() const {
+  ReadLock lock(mutex_);
+  return groups_.size();
+}
+
+void EventAggregator::emit(std::vector<Row>& rows, std::size_t count) {
+  for (; count > 0 && !order_.empty(); --count) {
+    auto it = groups_.find(order_.front());
+    order_.pop_front();
+
+    rows.push_back(groupRow(it->second));
+    groups_.erase(it);
+  }
+}
+
+std::string EventAggregator::groupKey(const Row& row) const {
+  std::string key;
+  for (const auto& column : key_columns_) {
+    auto it = row.find(column);
+    if (it != row.end()) {
+      key += it->second;
+    }
+    key += '\0';
+  }
+  return key;
+}
+
+Row EventAggregator::groupRow(Group& group) {
+  auto row = std::move(group.row);
+  row["count"] = std::to_string(group.count);
+  row["first_time"] = std::to_string(group.first_time);
+  row["last_time"] = std::to_string(group.last_time);
+  return row;
+}
+
+} // namespace osquery
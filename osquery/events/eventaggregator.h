@@ -0,0 +1,94 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <osquery/core/sql/row.h>
+#include <osquery/events/types.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+/**
+ * @brief Group identical events of a subscriber over a time window.
+ *
+ * Rows with the same values in the key columns are merged into the first
+ * one until its window closes. The merged row has a count column and the
+ * first_time and last_time the rows were added.
+ *
+ * Without a window, rows are passed through with a count of one.
+ */
+class EventAggregator final {
+ public:
+  /**
+   * @brief Set the window and the key columns, pending groups are kept.
+   *
+   * @param window The window in seconds, 0 disables aggregation.
+   * @param key_columns A comma-separated list of columns.
+   */
+  void configure(std::size_t window, const std::string& key_columns);
+
+  /// True if rows are held until their window closes.
+  bool enabled() const;
+
+  /**
+   * @brief Add the rows of events that happened at a time.
+   *
+   * @return The rows of the groups whose window closed, and all the rows if
+   * aggregation is disabled.
+   */
+  std::vector<Row> add(std::vector<Row> rows, EventTime time);
+
+  /// Remove the rows of the groups whose window closed at a time.
+  std::vector<Row> flush(EventTime time);
+
+  /// Remove the rows of every group.
+  std::vector<Row> flushAll();
+
+  /// The number of open groups.
+  std::size_t size() const;
+
+ private:
+  struct Group final {
+    Row row;
+    std::size_t count{0U};
+    EventTime first_time{0U};
+    EventTime last_time{0U};
+  };
+
+  /// Move the rows of up to a number of the oldest groups to a list.
+  void emit(std::vector<Row>& rows, std::size_t count);
+
+  /// The grouping key of a row.
+  std::string groupKey(const Row& row) const;
+
+  /// Write the aggregation columns of a group to its row.
+  static Row groupRow(Group& group);
+
+ private:
+  std::size_t window_{0U};
+
+  std::vector<std::string> key_columns_;
+
+  /// Open groups, by key.
+  std::map<std::string, Group> groups_;
+
+  /// Keys in the order the groups were opened, which is when they close.
+  std::deque<std::string> order_;
+
+  mutable Mutex mutex_;
+};
+
+} // namespace osquery
@@ -0,0 +1,200 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iterator>
+
+#include <osquery/events/eventcolumnindex.h>
+
+namespace osquery {
+
+namespace {
+
+std::string lowercase(const std::string& value) {
+  std::string lower(value);
+  for (auto& c : lower) {
+    if (c >= 'A' && c <= 'Z') {
+      c = static_cast<char>(c - 'A' + 'a');
+    }
+  }
+  return lower;
+}
+
+/// SQLite compares 1234.0 equal to 1234, which is how the row stores it.
+std::optional<std::string> integralForm(const std::string& value) {
+  if (value.find_first_of(".eE") == std::string::npos) {
+    return std::nullopt;
+  }
+
+  char* end = nullptr;
+  auto number = std::strtod(value.c_str(), &end);
+  if (end == value.c_str() || *end != '\0' || !std::isfinite(number) ||
+      std::trunc(number) != number || std::fabs(number) > 9.0e18) {
+    return std::nullopt;
+  }
+  return std::to_string(static_cast<long long>(number));
+}
+
+} // namespace
+
+bool EventIdFilter::matches(EventID id) const {
+  return id < first_indexed_id ||
+         std::binary_search(ids.begin(), ids.end(), id);
+}
+
+void EventColumnIndex::setColumns(const std::set<std::string>& columns) {
+  WriteLock lock(mutex_);
+  columns_.clear();
+  for (const auto& column : columns) {
+    columns_[column];
+  }
+}
+
+void EventColumnIndex::setFirstIndexedId(EventID id) {
+  WriteLock lock(mutex_);
+  first_indexed_id_ = id;
+}
+
+void EventColumnIndex::add(EventID id, const Row& row) {
+  WriteLock lock(mutex_);
+  for (auto& column : columns_) {
+    auto it = row.find(column.first);
+    if (it == row.end()) {
+      continue;
+    }
+
+    auto& ids = column.second[lowercase(it->second)];
+    if (ids.empty() || id > ids.back()) {
+      ids.push_back(id);
+    } else {
+      // Concurrent batches may add identifiers out of order.
+      auto pos = std::lower_bound(ids.begin(), ids.end(), id);
+      if (pos == ids.end() || *pos != id) {
+        ids.insert(pos, id);
+      }
+    }
+  }
+}
+
+void EventColumnIndex::remove(const EventIndex& removed) {
+  if (removed.empty()) {
+    return;
+  }
+
+  std::vector<EventID> removed_ids;
+  removed_ids.reserve(removed.eventCount());
+  for (const auto& entry : removed) {
+    removed_ids.push_back(entry.id);
+  }
+  std::sort(removed_ids.begin(), removed_ids.end());
+
+  WriteLock lock(mutex_);
+  if (columns_.empty()) {
+    return;
+  }
+
+  for (auto& column : columns_) {
+    auto& values = column.second;
+    for (auto it = values.begin(); it != values.end();) {
+      auto& ids = it->second;
+      auto last = ids.begin();
+      while (last != ids.end() && std::binary_search(removed_ids.begin(),
+                                                     removed_ids.end(),
+                                                     *last)) {
+        ++last;
+      }
+      ids.erase(ids.begin(), last);
+
+      if (ids.empty()) {
+        it = values.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
+std::optional<EventIdFilter> EventColumnIndex::filter(
+    const EventColumnConstraints& constraints) const {
+  ReadLock lock(mutex_);
+
+  std::optional<std::vector<EventID>> matched;
+  for (const auto& constraint : constraints) {
+    const auto& allowed = constraint.second;
+    auto column = columns_.find(constraint.first);
+    if (column == columns_.end() ||
+        (allowed.values.empty() && allowed.prefixes.empty())) {
+      continue;
+    }
+
+    std::vector<EventID> ids;
+    for (const auto& value : allowed.values) {
+      collect(column->second, lowercase(value), ids);
+      auto integral = integralForm(value);
+      if (integral.has_value()) {
+        collect(column->second, *integral, ids);
+      }
+    }
+    for (const auto& prefix : allowed.prefixes) {
+      collectPrefix(column->second, lowercase(prefix), ids);
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    if (!matched.has_value()) {
+      matched = std::move(ids);
+      continue;
+    }
+
+    std::vector<EventID> both;
+    std::set_intersection(matched->begin(),
+                          matched->end(),
+                          ids.begin(),
+                          ids.end(),
+                          std::back_inserter(both));
+    matched = std::move(both);
+  }
+
+  if (!matched.has_value()) {
+    return std::nullopt;
+  }
+  return EventIdFilter{first_indexed_id_, std::move(*matched)};
+}
+
+std::size_t EventColumnIndex::valueCount() const {
+  ReadLock lock(mutex_);
+  std::size_t count{0U};
+  for (const auto& column : columns_) {
+    count += column.second.size();
+  }
+  return count;
+}
+
+void EventColumnIndex::collect(const ValueMap& values,
+                               const std::string& value,
+                               std::vector<EventID>& ids) {
+  auto it = values.find(value);
+  if (it != values.end()) {
+    ids.insert(ids.end(), it->second.begin(), it->second.end());
+  }
+}
+
+void EventColumnIndex::collectPrefix(const ValueMap& values,
+                                     const std::string& prefix,
+                                     std::vector<EventID>& ids) {
+  for (auto it = values.lower_bound(prefix);
+       it != values.end() && it->first.compare(0, prefix.size(), prefix) == 0;
+       ++it) {
+    ids.insert(ids.end(), it->second.begin(), it->second.end());
+  }
+}
+
+} // namespace osquery
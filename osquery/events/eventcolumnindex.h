@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <osquery/core/sql/row.h>
+#include <osquery/events/eventindex.h>
+#include <osquery/events/types.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+/// The values a query allows for one indexed column.
+struct EventColumnConstraint {
+  /// Values from equality constraints, any of them may match.
+  std::set<std::string> values;
+
+  /// Literal prefixes from LIKE 'prefix%' and GLOB 'prefix*' constraints.
+  std::set<std::string> prefixes;
+};
+
+/// Constraints of a query, by column name.
+using EventColumnConstraints = std::map<std::string, EventColumnConstraint>;
+
+/// The events that may match the constraints of a query.
+struct EventIdFilter {
+  /// Events with a smaller identifier were not indexed and always match.
+  EventID first_indexed_id{0U};
+
+  /// The sorted identifiers of indexed events that may match.
+  std::vector<EventID> ids;
+
+  bool matches(EventID id) const;
+};
+
+/**
+ * @brief An inverted index from column values to the events holding them.
+ *
+ * Subscribers select a few columns, usually identifiers or paths, whose
+ * values are kept in memory for the stored events. Queries constraining
+ * those columns only read the records of events that may match.
+ *
+ * Values are compared without ASCII case, like the SQLite LIKE operator, so
+ * a lookup may return more events than the query matches. SQLite still
+ * applies every constraint to the generated rows.
+ */
+class EventColumnIndex final {
+ public:
+  /// Index the values of these columns, this empties the index.
+  void setColumns(const std::set<std::string>& columns);
+
+  /**
+   * @brief Set the identifier of the first event added to the index.
+   *
+   * Events stored before the index was created are not indexed, filters
+   * let them through.
+   */
+  void setFirstIndexedId(EventID id);
+
+  /// Add the values of the indexed columns of an event.
+  void add(EventID id, const Row& row);
+
+  /**
+   * @brief Forget removed events.
+   *
+   * Events are removed oldest first, so only the oldest identifiers of each
+   * value are compared with the removed events.
+   */
+  void remove(const EventIndex& removed);
+
+  /**
+   * @brief Find the events that may match the constraints of a query.
+   *
+   * Constraints on different columns must all match.
+   *
+   * @return The filter, or nothing if no constraint is on an indexed column.
+   */
+  std::optional<EventIdFilter> filter(
+      const EventColumnConstraints& constraints) const;
+
+  /// The number of indexed values across all columns.
+  std::size_t valueCount() const;
+
+ private:
+  using ValueMap = std::map<std::string, std::vector<EventID>>;
+
+  /// Add the events holding one value to a list of identifiers.
+  static void collect(const ValueMap& values,
+                      const std::string& value,
+                      std::vector<EventID>& ids);
+
+  /// Add the events holding a value starting with a prefix.
+  static void collectPrefix(const ValueMap& values,
+                            const std::string& prefix,
+                            std::vector<EventID>& ids);
+
+ private:
+  /// Lowercase values to the sorted identifiers of events, by column.
+  std::map<std::string, ValueMap> columns_;
+
+  EventID first_indexed_id_{0U};
+
+  mutable Mutex mutex_;
+};
+
+} // namespace osquery
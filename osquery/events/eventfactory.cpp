@@ -9,6 +9,7 @@
 
 #include <osquery/config/config.h>
 #include <osquery/core/flags.h>
+#include <osquery/core/plugins/logger.h>
 #include <osquery/core/system.h>
 #include <osquery/events/eventfactory.h>
 #include <osquery/events/eventsubscriber.h>
@@ -59,6 +60,8 @@ Status EventFactory::registerEventSubscriber(const PluginRef& sub) {
     return Status::failure("Subscribers must have set a name");
   }
 
+  base_sub->memory_storage = false;
+  base_sub->async_dispatch = false;
   auto plugin = Config::get().getParser("events");
   if (plugin != nullptr && plugin.get() != nullptr) {
     const auto& data = plugin->getData().doc();
@@ -83,6 +86,28 @@ Status EventFactory::registerEventSubscriber(const PluginRef& sub) {
         }
       }
     }
+    // Subscribers may keep their events in memory instead of the database.
+    if (data["events"].HasMember("memory_subscribers") &&
+        data["events"]["memory_subscribers"].IsArray()) {
+      for (const auto& item :
+           data["events"]["memory_subscribers"].GetArray()) {
+        if (item.IsString() && item.GetString() == name) {
+          VLOG(1) << "Keeping events in memory for subscriber: " << name;
+          base_sub->memory_storage = true;
+        }
+      }
+    }
+    // Subscribers may run their callbacks off the publisher threads.
+    if (data["events"].HasMember("async_subscribers") &&
+        data["events"]["async_subscribers"].IsArray()) {
+      for (const auto& item :
+           data["events"]["async_subscribers"].GetArray()) {
+        if (item.IsString() && item.GetString() == name) {
+          VLOG(1) << "Queueing events for subscriber: " << name;
+          base_sub->async_dispatch = true;
+        }
+      }
+    }
   }
 
   if (base_sub->state() != EventState::EVENT_NONE) {
@@ -176,6 +201,9 @@ Status EventFactory::deregisterEventSubscriber(const std::string& sub) {
   auto subscriber = subscriber_it->second;
   ef.event_subs_.erase(subscriber_it);
 
+  subscriber->stopEventQueue();
+  subscriber->spillMemoryEvents();
+  subscriber->saveEventIndex();
   subscriber->tearDown();
   subscriber->state(EventState::EVENT_NONE);
 
@@ -299,10 +327,20 @@ void EventFactory::addForwarder(const std::string& logger) {
 
 void EventFactory::forwardEvent(const std::string& event) {
   for (const auto& logger : getInstance().loggers_) {
-    Registry::call("logger", logger, {{"event", event}});
+    auto plugin =
+        RegistryFactory::get().localPlugin<LoggerPlugin>("logger", logger);
+    if (plugin != nullptr) {
+      plugin->logEvent(event);
+    } else {
+      Registry::call("logger", logger, {{"event", event}});
+    }
   }
 }
 
+bool EventFactory::forwardsEvents() {
+  return !getInstance().loggers_.empty();
+}
+
 void EventFactory::configUpdate() {
   // Scan the schedule for queries that touch "_events" tables.
   // We will count the queries
@@ -463,6 +501,14 @@ void EventFactory::end(bool join) {
       ef.threads_.clear();
     }
 
+    // Keep the events held in memory now that the publishers have stopped,
+    // and save the indexes for a faster start.
+    for (const auto& subscriber : ef.event_subs_) {
+      subscriber.second->stopEventQueue();
+      subscriber.second->spillMemoryEvents();
+      subscriber.second->saveEventIndex();
+    }
+
     // Threads may still be executing, when they finish, release publishers.
     ef.event_pubs_.clear();
     ef.event_subs_.clear();
@@ -0,0 +1,226 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <cstdint>
+
+#include <osquery/events/eventindex.h>
+#include <osquery/events/eventrecord.h>
+
+namespace osquery {
+
+namespace {
+
+/// The header that begins a serialized index, followed by the version.
+const std::string kIndexMagic{"\0I", 2};
+
+/// The current index encoding version.
+const unsigned char kIndexVersion{1};
+
+bool entryTimeLess(const EventIndexEntry& entry, EventTime time) {
+  return entry.time < time;
+}
+
+bool timeEntryLess(EventTime time, const EventIndexEntry& entry) {
+  return time < entry.time;
+}
+
+bool entryLess(const EventIndexEntry& l, const EventIndexEntry& r) {
+  return (l.time != r.time) ? l.time < r.time : l.id < r.id;
+}
+
+/// Identifiers usually grow with time, signed deltas keep the others small.
+std::uint64_t zigzag(std::int64_t value) {
+  return (static_cast<std::uint64_t>(value) << 1) ^
+         static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t value) {
+  return static_cast<std::int64_t>(value >> 1) ^
+         -static_cast<std::int64_t>(value & 1);
+}
+
+} // namespace
+
+EventIndex::EventIndex(const_iterator first, const_iterator last)
+    : entries_(first, last), batch_count_(countBatches(first, last)) {}
+
+void EventIndex::add(EventTime time, EventID id) {
+  if (empty() || time > back().time) {
+    entries_.push_back({time, id});
+    ++batch_count_;
+    return;
+  }
+
+  // Events with an older time are rare and land close to the end.
+  auto it = upperBound(time);
+  auto new_batch = (it == begin() || std::prev(it)->time != time);
+  entries_.insert(it, {time, id});
+  if (new_batch) {
+    ++batch_count_;
+  }
+}
+
+void EventIndex::merge(const EventIndex& other) {
+  entries_.reserve(entries_.size() + other.eventCount());
+  for (const auto& entry : other) {
+    add(entry.time, entry.id);
+  }
+}
+
+void EventIndex::assign(std::vector<EventIndexEntry> entries) {
+  std::sort(entries.begin(), entries.end(), entryLess);
+  entries_ = std::move(entries);
+  front_ = 0U;
+  batch_count_ = countBatches(begin(), end());
+}
+
+std::size_t EventIndex::size() const {
+  return batch_count_;
+}
+
+std::size_t EventIndex::eventCount() const {
+  return entries_.size() - front_;
+}
+
+bool EventIndex::empty() const {
+  return eventCount() == 0U;
+}
+
+EventIndex::const_iterator EventIndex::begin() const {
+  return entries_.cbegin() + front_;
+}
+
+EventIndex::const_iterator EventIndex::end() const {
+  return entries_.cend();
+}
+
+const EventIndexEntry& EventIndex::front() const {
+  return entries_[front_];
+}
+
+const EventIndexEntry& EventIndex::back() const {
+  return entries_.back();
+}
+
+EventIndex::const_iterator EventIndex::lowerBound(EventTime time) const {
+  return std::lower_bound(begin(), end(), time, entryTimeLess);
+}
+
+EventIndex::const_iterator EventIndex::upperBound(EventTime time) const {
+  return std::upper_bound(begin(), end(), time, timeEntryLess);
+}
+
+EventIndex EventIndex::removeBatches(std::size_t count) {
+  auto last = begin();
+  for (std::size_t batches = 0U; batches < count && last != end();
+       ++batches) {
+    last = upperBound(last->time);
+  }
+  return removeFront(last);
+}
+
+EventIndex EventIndex::removeUntil(EventTime time) {
+  return removeFront(upperBound(time));
+}
+
+EventIndex EventIndex::removeFront(const_iterator last) {
+  EventIndex removed(begin(), last);
+
+  front_ += removed.eventCount();
+  batch_count_ -= removed.size();
+  compact();
+  return removed;
+}
+
+void EventIndex::compact() {
+  if (front_ == entries_.size()) {
+    entries_.clear();
+    front_ = 0U;
+
+  } else if (front_ * 2 > entries_.size()) {
+    entries_.erase(entries_.begin(), entries_.begin() + front_);
+    front_ = 0U;
+  }
+}
+
+std::size_t EventIndex::countBatches(const_iterator first,
+                                     const_iterator last) {
+  std::size_t count{0U};
+  for (auto it = first; it != last; ++it) {
+    if (it == first || std::prev(it)->time != it->time) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+void EventIndex::serialize(std::string& encoded, EventID last_event_id) const {
+  encoded.assign(kIndexMagic);
+  encoded.push_back(static_cast<char>(kIndexVersion));
+  putEventVarint(encoded, last_event_id);
+  putEventVarint(encoded, eventCount());
+
+  EventIndexEntry previous;
+  for (const auto& entry : *this) {
+    putEventVarint(encoded, entry.time - previous.time);
+    putEventVarint(encoded,
+                   zigzag(static_cast<std::int64_t>(entry.id - previous.id)));
+    previous = entry;
+  }
+}
+
+Status EventIndex::deserialize(const std::string& encoded,
+                               EventID& last_event_id) {
+  if (encoded.size() <= kIndexMagic.size() ||
+      encoded.compare(0, kIndexMagic.size(), kIndexMagic) != 0 ||
+      static_cast<unsigned char>(encoded[kIndexMagic.size()]) !=
+          kIndexVersion) {
+    return Status::failure("Unsupported event index encoding");
+  }
+
+  std::size_t offset = kIndexMagic.size() + 1;
+  std::uint64_t saved_last_id = 0;
+  std::uint64_t count = 0;
+  // Every entry takes at least two bytes.
+  if (!getEventVarint(encoded, offset, saved_last_id) ||
+      !getEventVarint(encoded, offset, count) ||
+      count > (encoded.size() - offset) / 2) {
+    return Status::failure("Invalid event index count");
+  }
+
+  std::vector<EventIndexEntry> entries;
+  entries.reserve(static_cast<std::size_t>(count));
+  EventIndexEntry previous;
+  for (std::uint64_t i = 0; i < count; ++i) {
+    std::uint64_t time_delta = 0;
+    std::uint64_t id_delta = 0;
+    if (!getEventVarint(encoded, offset, time_delta) ||
+        !getEventVarint(encoded, offset, id_delta)) {
+      return Status::failure("Truncated event index");
+    }
+
+    previous.time += time_delta;
+    previous.id += static_cast<EventID>(unzigzag(id_delta));
+    entries.push_back(previous);
+  }
+
+  if (offset != encoded.size()) {
+    return Status::failure("Unexpected data after event index");
+  }
+
+  // The entries were saved in order.
+  entries_ = std::move(entries);
+  front_ = 0U;
+  batch_count_ = countBatches(begin(), end());
+  last_event_id = static_cast<EventID>(saved_last_id);
+  return Status::success();
+}
+
+} // namespace osquery
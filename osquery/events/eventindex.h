@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <osquery/events/types.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// The time and identifier of one stored event.
+struct EventIndexEntry {
+  EventTime time{0U};
+  EventID id{0U};
+};
+
+/**
+ * @brief The stored events of a subscriber, ordered by event time.
+ *
+ * Events are kept in one contiguous array sorted by time, events with the
+ * same time form a batch and keep the order they were added in. Events are
+ * almost always added with the newest time and removed with the oldest, so
+ * both ends are cheap: removed entries are only compacted away once they
+ * make up half of the array.
+ */
+class EventIndex final {
+ public:
+  using const_iterator = std::vector<EventIndexEntry>::const_iterator;
+
+  EventIndex() = default;
+
+  /// Copy a sorted range of entries.
+  EventIndex(const_iterator first, const_iterator last);
+
+  /// Add an event after the events already added with the same time.
+  void add(EventTime time, EventID id);
+
+  /// Add every event of another index.
+  void merge(const EventIndex& other);
+
+  /// Replace the contents with entries in any order.
+  void assign(std::vector<EventIndexEntry> entries);
+
+  /// The number of batches, which is the number of distinct event times.
+  std::size_t size() const;
+
+  /// The number of events.
+  std::size_t eventCount() const;
+
+  bool empty() const;
+
+  const_iterator begin() const;
+  const_iterator end() const;
+
+  /// The oldest event.
+  const EventIndexEntry& front() const;
+
+  /// The newest event.
+  const EventIndexEntry& back() const;
+
+  /// The first event at or after a time.
+  const_iterator lowerBound(EventTime time) const;
+
+  /// The first event after a time.
+  const_iterator upperBound(EventTime time) const;
+
+  /// Remove and return the oldest batches.
+  EventIndex removeBatches(std::size_t count);
+
+  /// Remove and return the events at or before a time.
+  EventIndex removeUntil(EventTime time);
+
+  /**
+   * @brief Encode the index, with time and identifier deltas.
+   *
+   * @param encoded [output] The encoded index.
+   * @param last_event_id The largest identifier issued, saved with the index.
+   */
+  void serialize(std::string& encoded, EventID last_event_id) const;
+
+  /**
+   * @brief Replace the contents with an index encoded by serialize.
+   *
+   * @param encoded The encoded index.
+   * @param last_event_id [output] The identifier saved with the index.
+   */
+  Status deserialize(const std::string& encoded, EventID& last_event_id);
+
+ private:
+  /// Remove and return the events before an entry.
+  EventIndex removeFront(const_iterator last);
+
+  /// Drop removed entries once they make up half of the array.
+  void compact();
+
+  /// Count the distinct times within a sorted range.
+  static std::size_t countBatches(const_iterator first, const_iterator last);
+
+ private:
+  std::vector<EventIndexEntry> entries_;
+
+  /// The number of removed entries at the front of the array.
+  std::size_t front_{0U};
+
+  std::size_t batch_count_{0U};
+};
+
+} // namespace osquery
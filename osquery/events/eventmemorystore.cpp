@@ -0,0 +1,87 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+
+#include <osquery/events/eventmemorystore.h>
+
+namespace osquery {
+
+BufferedEventList EventMemoryStore::add(BufferedEventList events) {
+  BufferedEventList evicted;
+  if (capacity_ == 0U) {
+    return events;
+  }
+
+  WriteLock lock(mutex_);
+  for (auto& event : events) {
+    if (events_.size() >= capacity_) {
+      evicted.push_back(std::move(events_.front()));
+      events_.pop_front();
+    }
+    events_.push_back(std::move(event));
+  }
+  return evicted;
+}
+
+bool EventMemoryStore::generateRows(const std::function<void(Row)>& callback,
+                                    EventTime start_time,
+                                    EventTime end_time,
+                                    EventID after_eid,
+                                    EventTime& last_time,
+                                    EventID& last_eid) const {
+  if (end_time != 0U && start_time > end_time) {
+    return false;
+  }
+
+  std::vector<Row> rows;
+  {
+    ReadLock lock(mutex_);
+    for (const auto& event : events_) {
+      if (event.id <= after_eid || event.time < start_time ||
+          (end_time != 0U && event.time > end_time)) {
+        continue;
+      }
+
+      rows.push_back(event.row);
+      last_time = std::max(last_time, event.time);
+      last_eid = std::max(last_eid, event.id);
+    }
+  }
+
+  for (auto& row : rows) {
+    callback(std::move(row));
+  }
+  return !rows.empty();
+}
+
+void EventMemoryStore::expire(EventTime oldest_valid_time) {
+  WriteLock lock(mutex_);
+  events_.erase(std::remove_if(events_.begin(),
+                               events_.end(),
+                               [oldest_valid_time](const BufferedEvent& e) {
+                                 return e.time <= oldest_valid_time;
+                               }),
+                events_.end());
+}
+
+BufferedEventList EventMemoryStore::drain() {
+  WriteLock lock(mutex_);
+  BufferedEventList events(std::make_move_iterator(events_.begin()),
+                           std::make_move_iterator(events_.end()));
+  events_.clear();
+  return events;
+}
+
+std::size_t EventMemoryStore::size() const {
+  ReadLock lock(mutex_);
+  return events_.size();
+}
+
+} // namespace osquery
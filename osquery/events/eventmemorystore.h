@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include <osquery/core/sql/row.h>
+#include <osquery/events/types.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+/// An event row together with its storage time and identifier.
+struct BufferedEvent {
+  EventTime time{0U};
+  EventID id{0U};
+  Row row;
+};
+
+using BufferedEventList = std::vector<BufferedEvent>;
+
+/**
+ * @brief A bounded in-memory store for the events of one subscriber.
+ *
+ * Subscribers configured to keep their events in memory add them here rather
+ * than to the backing store. Once the store is full the oldest events are
+ * handed back to the caller, which may persist or drop them.
+ */
+class EventMemoryStore final {
+ public:
+  explicit EventMemoryStore(std::size_t capacity) : capacity_(capacity) {}
+
+  /**
+   * @brief Add events, returning the oldest events evicted to make room.
+   *
+   * @param events The events to add, in the order they were identified.
+   * @return The events that no longer fit, oldest first.
+   */
+  BufferedEventList add(BufferedEventList events);
+
+  /**
+   * @brief Visit the events within an inclusive time range.
+   *
+   * Matching rows are copied before the callback runs, so publishers can keep
+   * adding events while the rows are consumed.
+   *
+   * @param callback A callback encapsulating Row yield method.
+   * @param start_time Inclusive lower bound time limit.
+   * @param end_time Inclusive upper bound time limit, 0 for no limit.
+   * @param after_eid Only visit events with a larger identifier.
+   * @param last_time [output] The largest visited event time.
+   * @param last_eid [output] The largest visited event identifier.
+   * @return True if any event was visited.
+   */
+  bool generateRows(const std::function<void(Row)>& callback,
+                    EventTime start_time,
+                    EventTime end_time,
+                    EventID after_eid,
+                    EventTime& last_time,
+                    EventID& last_eid) const;
+
+  /// Remove the events at or before a time.
+  void expire(EventTime oldest_valid_time);
+
+  /// Remove and return every event, oldest first.
+  BufferedEventList drain();
+
+  /// Return the number of events held.
+  std::size_t size() const;
+
+ private:
+  /// The maximum number of events held.
+  const std::size_t capacity_;
+
+  /// Events in the order they were added.
+  std::deque<BufferedEvent> events_;
+
+  /// Protects the events, the critical sections only move rows in and out.
+  mutable Mutex mutex_;
+};
+
+} // namespace osquery
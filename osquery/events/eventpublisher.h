@@ -104,8 +104,44 @@ class EventPublisher : public EventPublisherPlugin {
     auto pub_sc = getSubscriptionContext(sub->context);
     auto pub_ec = getEventContext(ec);
 
-    if (shouldFire(pub_sc, pub_ec) && sub->callback != nullptr) {
+    if (!shouldFire(pub_sc, pub_ec)) {
+      return;
+    }
+
+    if (sub->callback != nullptr) {
       sub->callback(pub_ec, pub_sc);
+    } else if (sub->batch_callback != nullptr) {
+      sub->batch_callback({pub_ec}, pub_sc);
+    }
+  }
+
+  /**
+   * @brief The internal `fire` phase of publishing a batch of events.
+   *
+   * Subscriptions with a batch callback receive the events that should fire
+   * in a single call, other subscriptions use fireCallback for each event.
+   *
+   * @param sub The SubscriptionContext and optional callbacks.
+   * @param ec_list The events that were fired.
+   */
+  void fireBatchCallback(const SubscriptionRef& sub,
+                         const EventContextList& ec_list) const override {
+    if (sub->batch_callback == nullptr) {
+      EventPublisherPlugin::fireBatchCallback(sub, ec_list);
+      return;
+    }
+
+    auto pub_sc = getSubscriptionContext(sub->context);
+    EventContextList matched;
+    matched.reserve(ec_list.size());
+    for (const auto& ec : ec_list) {
+      if (shouldFire(pub_sc, getEventContext(ec))) {
+        matched.push_back(ec);
+      }
+    }
+
+    if (!matched.empty()) {
+      sub->batch_callback(matched, pub_sc);
     }
   }
 
@@ -126,7 +162,9 @@ class EventPublisher : public EventPublisherPlugin {
  private:
   FRIEND_TEST(EventsTests, test_event_subscriber_subscribe);
   FRIEND_TEST(EventsTests, test_event_subscriber_context);
+  FRIEND_TEST(EventsTests, test_event_subscriber_async_dispatch);
   FRIEND_TEST(EventsTests, test_fire_event);
+  FRIEND_TEST(EventsTests, test_fire_event_batch);
 };
 
 } // namespace osquery
@@ -7,14 +7,24 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <osquery/core/flight_recorder.h>
 #include <osquery/events/eventfactory.h>
 #include <osquery/events/eventpublisherplugin.h>
 #include <osquery/events/eventsubscriber.h>
+#include <osquery/numeric_monitoring/numeric_monitoring.h>
+#include <osquery/profiler/code_profiler.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/utils/system/time.h>
 
 namespace osquery {
 
+namespace {
+
+/// The minimum time, in seconds, between numeric monitoring reports.
+const std::uint64_t kStatsReportInterval{60U};
+
+} // namespace
+
 CREATE_REGISTRY(EventPublisherPlugin, "event_publisher");
 
 const std::string EventPublisherPlugin::type() const {
@@ -50,6 +60,83 @@ EventContextID EventPublisherPlugin::numEvents() const {
   return next_ec_id_.load();
 }
 
+EventContextID EventPublisherPlugin::numDroppedEvents() const {
+  return dropped_events_.load();
+}
+
+EventContextID EventPublisherPlugin::numReceivedEvents() const {
+  return numEvents() + numDroppedEvents();
+}
+
+size_t EventPublisherPlugin::queueDepth() const {
+  return 0;
+}
+
+std::uint64_t EventPublisherPlugin::callbackTime() const {
+  return callback_time_us_.load();
+}
+
+void EventPublisherPlugin::recordDroppedEvents(EventContextID count) {
+  dropped_events_ += count;
+}
+
+void EventPublisherPlugin::addCallbackTime(
+    std::chrono::steady_clock::time_point start) {
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+  callback_time_us_ += static_cast<std::uint64_t>(elapsed.count());
+}
+
+void EventPublisherPlugin::reportStats() {
+  auto now = getUnixTime();
+  if (now < last_report_time_ + kStatsReportInterval) {
+    return;
+  }
+
+  // Only one firing thread reports, the others move on.
+  std::unique_lock<std::mutex> lock(report_mutex_, std::try_to_lock);
+  if (!lock.owns_lock() || now < last_report_time_ + kStatsReportInterval) {
+    return;
+  }
+  auto elapsed = now - last_report_time_;
+  auto first_report = (last_report_time_ == 0);
+  last_report_time_ = now;
+
+  auto events = numEvents();
+  auto dropped_events = numDroppedEvents();
+  auto callback_time = callbackTime();
+
+  auto prefix = "events." + type() + ".";
+  auto sum = monitoring::PreAggregationType::Sum;
+  monitoring::record(prefix + "fired",
+                     static_cast<monitoring::ValueType>(events -
+                                                        reported_events_),
+                     sum);
+  monitoring::record(
+      prefix + "dropped",
+      static_cast<monitoring::ValueType>(dropped_events -
+                                         reported_dropped_events_),
+      sum);
+  monitoring::record(
+      prefix + "callback_time_us",
+      static_cast<monitoring::ValueType>(callback_time -
+                                         reported_callback_time_us_),
+      sum);
+  monitoring::record(prefix + "queue_depth",
+                     static_cast<monitoring::ValueType>(queueDepth()),
+                     monitoring::PreAggregationType::Max);
+
+  if (!first_report && elapsed > 0) {
+    recordFlight(FlightRecordKind::EventRate,
+                 type(),
+                 (events - reported_events_) / elapsed);
+  }
+
+  reported_events_ = events;
+  reported_dropped_events_ = dropped_events;
+  reported_callback_time_us_ = callback_time;
+}
+
 size_t EventPublisherPlugin::numSubscriptions() {
   ReadLock lock(subscription_lock_);
   return subscriptions_.size();
@@ -58,6 +145,7 @@ size_t EventPublisherPlugin::numSubscriptions() {
 void EventPublisherPlugin::fire(const EventContextRef& ec, EventTime time) {
   if (isEnding()) {
     // Cannot emit/fire while ending
+    recordDroppedEvents(1);
     return;
   }
 
@@ -75,12 +163,69 @@ void EventPublisherPlugin::fire(const EventContextRef& ec, EventTime time) {
     }
   }
 
-  ReadLock lock(subscription_lock_);
-  for (const auto& subscription : subscriptions_) {
-    auto es = EventFactory::getEventSubscriber(subscription->subscriber_name);
-    if (es != nullptr && es->state() == EventState::EVENT_RUNNING) {
-      fireCallback(subscription, ec);
+  {
+    auto start = std::chrono::steady_clock::now();
+    ReadLock lock(subscription_lock_);
+    for (const auto& subscription : subscriptions_) {
+      auto es = EventFactory::getEventSubscriber(subscription->subscriber_name);
+      if (es != nullptr && es->state() == EventState::EVENT_RUNNING) {
+        ScopedProfile profile("subscriber", subscription->subscriber_name);
+        fireCallback(subscription, ec);
+      }
     }
+    addCallbackTime(start);
+  }
+
+  reportStats();
+}
+
+void EventPublisherPlugin::fire(const EventContextList& ec_list,
+                                EventTime time) {
+  if (ec_list.empty()) {
+    return;
+  }
+
+  if (isEnding()) {
+    // Cannot emit/fire while ending
+    recordDroppedEvents(ec_list.size());
+    return;
+  }
+
+  // Reserve one EventContext ID for each event in the batch.
+  EventContextID ec_id = next_ec_id_.fetch_add(ec_list.size());
+  for (const auto& ec : ec_list) {
+    if (ec != nullptr) {
+      ec->id = ec_id;
+      if (ec->time == 0) {
+        if (time == 0) {
+          time = getTime();
+        }
+        ec->time = time;
+      }
+    }
+    ec_id++;
+  }
+
+  {
+    auto start = std::chrono::steady_clock::now();
+    ReadLock lock(subscription_lock_);
+    for (const auto& subscription : subscriptions_) {
+      auto es = EventFactory::getEventSubscriber(subscription->subscriber_name);
+      if (es != nullptr && es->state() == EventState::EVENT_RUNNING) {
+        ScopedProfile profile("subscriber", subscription->subscriber_name);
+        fireBatchCallback(subscription, ec_list);
+      }
+    }
+    addCallbackTime(start);
+  }
+
+  reportStats();
+}
+
+void EventPublisherPlugin::fireBatchCallback(
+    const SubscriptionRef& sub, const EventContextList& ec_list) const {
+  for (const auto& ec : ec_list) {
+    fireCallback(sub, ec);
   }
 }
 
@@ -9,6 +9,11 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
 #include <osquery/core/plugins/plugin.h>
 #include <osquery/dispatcher/dispatcher.h>
 #include <osquery/events/eventer.h>
@@ -108,6 +113,23 @@ class EventPublisherPlugin : public Plugin,
    */
   EventContextID numEvents() const;
 
+  /// The number of events this EventPublisher lost instead of firing them.
+  EventContextID numDroppedEvents() const;
+
+  /// The number of events this EventPublisher fired or lost.
+  EventContextID numReceivedEvents() const;
+
+  /**
+   * @brief The number of events read by this EventPublisher but not yet fired.
+   *
+   * Publishers buffering events between threads override this, the default
+   * is 0.
+   */
+  virtual size_t queueDepth() const;
+
+  /// The total time, in microseconds, spent running subscriber callbacks.
+  std::uint64_t callbackTime() const;
+
   /// Check if the EventFactory is ending all publisher threads.
   bool isEnding() const;
 
@@ -138,13 +160,37 @@ class EventPublisherPlugin : public Plugin,
    */
   void fire(const EventContextRef& ec, EventTime time = 0);
 
+  /**
+   * @brief Fire several events at once.
+   *
+   * Subscriptions with a batch callback receive every matching event in a
+   * single call, so subscribers can store them with one addBatch. Other
+   * subscriptions receive the events one at a time, as with `fire`.
+   *
+   * @param ec_list The EventContexts, in the order the events occurred.
+   * @param time The most accurate time associated with the events.
+   */
+  void fire(const EventContextList& ec_list, EventTime time = 0);
+
   /// The internal fire method used by the typed EventPublisher.
   virtual void fireCallback(const SubscriptionRef& sub,
                             const EventContextRef& ec) const = 0;
 
+  /// The internal batch fire method, the default calls fireCallback per event.
+  virtual void fireBatchCallback(const SubscriptionRef& sub,
+                                 const EventContextList& ec_list) const;
+
   /// Return the current time (included to assist testing).
   virtual uint64_t getTime() const;
 
+  /**
+   * @brief Count events lost before they could be fired.
+   *
+   * Publishers call this when the OS reports lost events, for example when a
+   * kernel buffer overflows.
+   */
+  void recordDroppedEvents(EventContextID count);
+
   /// A lock for subscription manipulation.
   mutable Mutex subscription_lock_;
 
@@ -165,6 +211,29 @@ class EventPublisherPlugin : public Plugin,
   /// A helper count of event publisher runloop iterations.
   std::atomic<size_t> restart_count_{0};
 
+  /// Events lost by the publisher or fired while ending.
+  std::atomic<EventContextID> dropped_events_{0};
+
+  std::atomic<std::uint64_t> callback_time_us_{0};
+
+  /// The unix time of the last numeric monitoring report.
+  std::atomic<std::uint64_t> last_report_time_{0};
+
+  /// Held by the thread sending the numeric monitoring report.
+  std::mutex report_mutex_;
+
+  /// The counters sent by the last numeric monitoring report.
+  EventContextID reported_events_{0};
+  EventContextID reported_dropped_events_{0};
+  std::uint64_t reported_callback_time_us_{0};
+
+ private:
+  /// Add the time spent running subscriber callbacks since a start time.
+  void addCallbackTime(std::chrono::steady_clock::time_point start);
+
+  /// Send the counters to numeric monitoring at most once per interval.
+  void reportStats();
+
   // clang-format off
   [[deprecated("Do not check for interrupted, instead use isEnding.")]]
   // clang-format on
@@ -176,5 +245,6 @@ class EventPublisherPlugin : public Plugin,
 
   FRIEND_TEST(EventsTests, test_event_publisher);
   FRIEND_TEST(EventsTests, test_fire_event);
+  FRIEND_TEST(EventsTests, test_event_publisher_stats);
 };
 } // namespace osquery
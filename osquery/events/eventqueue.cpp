@@ -0,0 +1,282 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <cstdint>
+
+#include <osquery/core/system.h>
+#include <osquery/events/eventqueue.h>
+#include <osquery/logger/logger.h>
+#include <osquery/numeric_monitoring/numeric_monitoring.h>
+#include <osquery/profiler/code_profiler.h>
+
+namespace osquery {
+
+namespace {
+
+/// How long the consumer waits for an event before checking for a stop.
+const std::chrono::milliseconds kQueueWaitTimeout{200};
+
+/// The minimum time between warnings about dropped events.
+const std::chrono::seconds kDropReportInterval{10};
+
+/// How long a blocked producer waits before checking the queue again.
+const std::chrono::milliseconds kBlockWaitTimeout{10};
+
+/// A sampling queue keeps one out of this many events.
+const std::size_t kSampleInterval{8};
+
+std::size_t roundCapacity(std::size_t capacity) {
+  std::size_t size = 2;
+  while (size < capacity) {
+    size <<= 1;
+  }
+  return size;
+}
+
+} // namespace
+
+EventQueue::EventQueue(std::string name,
+                       std::size_t capacity,
+                       EventQueuePolicy policy)
+    : name_(std::move(name)),
+      mask_(roundCapacity(capacity) - 1),
+      policy_(policy),
+      cells_(mask_ + 1) {
+  for (std::size_t i = 0; i < cells_.size(); ++i) {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+EventQueue::~EventQueue() {
+  stop();
+}
+
+bool EventQueue::push(QueuedEvent event) {
+  if (policy_ == EventQueuePolicy::Sample && size() >= cells_.size() / 2 &&
+      sampled_.fetch_add(1, std::memory_order_relaxed) % kSampleInterval != 0) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  while (!tryPush(event)) {
+    auto retry = false;
+    if (policy_ == EventQueuePolicy::DropOldest) {
+      retry = dropOldest();
+    } else if (policy_ == EventQueuePolicy::Block) {
+      retry = waitForSpace();
+    }
+
+    if (!retry) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool EventQueue::tryPush(QueuedEvent& event) {
+  Cell* cell = nullptr;
+  auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+  while (true) {
+    cell = &cells_[pos & mask_];
+    auto sequence = cell->sequence.load(std::memory_order_acquire);
+    auto diff =
+        static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+    if (diff == 0) {
+      // The cell is free, claim it by moving the enqueue position past it.
+      if (enqueue_pos_.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // The consumer has not released this cell yet, the queue is full.
+      return false;
+    } else {
+      // Another producer claimed the cell first.
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+
+  cell->event = std::move(event);
+  cell->sequence.store(pos + 1, std::memory_order_release);
+
+  // Pairs with the fence in pop: either the consumer sees this event before it
+  // sleeps or this thread sees that it is waiting.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiting_.load(std::memory_order_relaxed)) {
+    wake();
+  }
+  return true;
+}
+
+bool EventQueue::tryPop(QueuedEvent& event) {
+  if (policy_ == EventQueuePolicy::DropOldest) {
+    std::lock_guard<std::mutex> lock(pop_mutex_);
+    return tryPopExclusive(event);
+  }
+
+  if (!tryPopExclusive(event)) {
+    return false;
+  }
+
+  if (policy_ == EventQueuePolicy::Block &&
+      blocked_.load(std::memory_order_relaxed) > 0) {
+    space_cv_.notify_all();
+  }
+  return true;
+}
+
+bool EventQueue::tryPopExclusive(QueuedEvent& event) {
+  auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+  auto& cell = cells_[pos & mask_];
+  auto sequence = cell.sequence.load(std::memory_order_acquire);
+  if (sequence != pos + 1) {
+    // The queue is empty or the producer has not finished writing the cell.
+    return false;
+  }
+
+  dequeue_pos_.store(pos + 1, std::memory_order_relaxed);
+  event = std::move(cell.event);
+  cell.event = QueuedEvent();
+  cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+  return true;
+}
+
+bool EventQueue::pop(QueuedEvent& event, std::chrono::milliseconds timeout) {
+  if (tryPop(event)) {
+    return true;
+  }
+
+  std::unique_lock<std::mutex> lock(wait_mutex_);
+  waiting_.store(true, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  bool popped = false;
+  wait_cv_.wait_for(lock, timeout, [this, &event, &popped]() {
+    popped = tryPop(event);
+    return popped || stopping_.load();
+  });
+  waiting_.store(false, std::memory_order_relaxed);
+  return popped;
+}
+
+bool EventQueue::dropOldest() {
+  QueuedEvent oldest;
+  {
+    std::lock_guard<std::mutex> lock(pop_mutex_);
+    if (!tryPopExclusive(oldest)) {
+      // The oldest cell is still being written, drop the new event instead.
+      return false;
+    }
+  }
+
+  dropped_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool EventQueue::waitForSpace() {
+  if (!running_ || stopping_) {
+    // Nothing will make room.
+    return false;
+  }
+
+  // The consumer may miss a producer that starts waiting while it notifies,
+  // the timeout bounds the delay.
+  std::unique_lock<std::mutex> lock(space_mutex_);
+  blocked_.fetch_add(1, std::memory_order_relaxed);
+  space_cv_.wait_for(lock, kBlockWaitTimeout);
+  blocked_.fetch_sub(1, std::memory_order_relaxed);
+  return true;
+}
+
+void EventQueue::wake() {
+  // Taking the lock orders the notification after the consumer either checked
+  // for events or started waiting.
+  { std::lock_guard<std::mutex> lock(wait_mutex_); }
+  wait_cv_.notify_one();
+}
+
+void EventQueue::start() {
+  if (consumer_ == nullptr) {
+    running_ = true;
+    consumer_ = std::make_unique<std::thread>(&EventQueue::consume, this);
+  }
+}
+
+void EventQueue::stop() {
+  if (consumer_ == nullptr) {
+    return;
+  }
+
+  stopping_ = true;
+  wake();
+  consumer_->join();
+  consumer_.reset();
+  running_ = false;
+  stopping_ = false;
+}
+
+void EventQueue::consume() {
+  setThreadName(name_);
+
+  std::size_t reported_drops = 0;
+  auto last_report = std::chrono::steady_clock::now();
+  while (true) {
+    QueuedEvent event;
+    auto popped = pop(event, kQueueWaitTimeout);
+    if (popped && event.callback != nullptr) {
+      ScopedProfile profile("subscriber", name_);
+      auto start = std::chrono::steady_clock::now();
+      (*event.callback)(event.ec, event.sc);
+      auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start);
+      callback_time_us_.fetch_add(static_cast<std::uint64_t>(elapsed.count()),
+                                  std::memory_order_relaxed);
+    }
+
+    auto drops = dropped();
+    auto now = std::chrono::steady_clock::now();
+    if (drops != reported_drops &&
+        (now - last_report >= kDropReportInterval || !popped)) {
+      LOG(WARNING) << "Event subscriber " << name_ << " dropped "
+                   << drops - reported_drops
+                   << " events because its queue is full";
+      monitoring::record("events." + name_ + ".dropped",
+                         static_cast<monitoring::ValueType>(drops -
+                                                            reported_drops),
+                         monitoring::PreAggregationType::Sum);
+      reported_drops = drops;
+      last_report = now;
+    }
+
+    if (!popped && stopping_) {
+      break;
+    }
+  }
+}
+
+std::size_t EventQueue::dropped() const {
+  return dropped_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t EventQueue::callbackTime() const {
+  return callback_time_us_.load(std::memory_order_relaxed);
+}
+
+std::size_t EventQueue::size() const {
+  auto enqueued = enqueue_pos_.load(std::memory_order_relaxed);
+  auto dequeued = dequeue_pos_.load(std::memory_order_relaxed);
+  return (enqueued > dequeued) ? enqueued - dequeued : 0;
+}
+
+std::size_t EventQueue::capacity() const {
+  return cells_.size();
+}
+
+} // namespace osquery
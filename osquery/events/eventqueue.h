@@ -0,0 +1,189 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/events/subscription.h>
+#include <osquery/events/types.h>
+
+namespace osquery {
+
+/// An event waiting to be handed to a subscriber callback.
+struct QueuedEvent {
+  std::shared_ptr<const EventCallback> callback;
+  EventContextRef ec;
+  SubscriptionContextRef sc;
+};
+
+/// What a producer does when the queue is full.
+enum class EventQueuePolicy {
+  /// Drop the event being pushed.
+  DropNewest,
+
+  /// Drop the oldest queued event to make room.
+  DropOldest,
+
+  /// Once the queue is half full keep only one event out of every few.
+  Sample,
+
+  /// Wait for the consumer to make room, while it runs.
+  Block,
+};
+
+/**
+ * @brief A bounded queue of events between publishers and one subscriber.
+ *
+ * Any number of publisher threads may push while a single consumer thread,
+ * started with start, pops and runs the subscriber callbacks. Pushing never
+ * blocks or allocates: the queue is a ring of cells, each with a sequence
+ * number that tells producers and the consumer whose turn the cell is. When
+ * the ring is full the policy decides which event is dropped and counted.
+ */
+class EventQueue : private boost::noncopyable {
+ public:
+  /**
+   * @brief Create a queue holding at least capacity events.
+   *
+   * The capacity is rounded up to a power of two.
+   *
+   * @param name The subscriber name, used for the consumer thread and logs.
+   * @param capacity The requested number of queued events.
+   * @param policy What to do when the queue is full.
+   */
+  EventQueue(std::string name,
+             std::size_t capacity,
+             EventQueuePolicy policy = EventQueuePolicy::DropNewest);
+
+  /// Stops the consumer thread, see stop.
+  ~EventQueue();
+
+  /**
+   * @brief Queue an event, safe to call from any thread.
+   *
+   * Pushing only blocks with the Block policy.
+   *
+   * @return false if the event was dropped.
+   */
+  bool push(QueuedEvent event);
+
+  /**
+   * @brief Remove the oldest event, waiting up to a timeout for one.
+   *
+   * Only one thread may pop at a time.
+   *
+   * @return false if no event was queued before the timeout or a wake.
+   */
+  bool pop(QueuedEvent& event, std::chrono::milliseconds timeout);
+
+  /// Start a consumer thread that runs the queued callbacks.
+  void start();
+
+  /**
+   * @brief Stop the consumer thread and wait for it to exit.
+   *
+   * Events queued before the call are still dispatched.
+   */
+  void stop();
+
+  /// The number of events dropped because the queue was full.
+  std::size_t dropped() const;
+
+  /// The total time, in microseconds, the consumer spent in callbacks.
+  std::uint64_t callbackTime() const;
+
+  /// The number of events waiting for the consumer.
+  std::size_t size() const;
+
+  /// The number of events the queue can hold.
+  std::size_t capacity() const;
+
+ private:
+  /// Push without waiting, the event is only moved if it was queued.
+  bool tryPush(QueuedEvent& event);
+
+  /// Pop without waiting.
+  bool tryPop(QueuedEvent& event);
+
+  /// Pop without waiting, with exclusive access to the oldest cell.
+  bool tryPopExclusive(QueuedEvent& event);
+
+  /// Drop the oldest event to make room for a push.
+  bool dropOldest();
+
+  /// Wait a moment for the consumer to make room for a push.
+  bool waitForSpace();
+
+  /// The consumer thread loop.
+  void consume();
+
+  /// Wake a consumer waiting in pop.
+  void wake();
+
+ private:
+  struct Cell {
+    std::atomic<std::size_t> sequence{0};
+    QueuedEvent event;
+  };
+
+  const std::string name_;
+
+  const std::size_t mask_;
+
+  const EventQueuePolicy policy_;
+
+  std::vector<Cell> cells_;
+
+  /// Producers and the consumer update these at different rates.
+  alignas(64) std::atomic<std::size_t> enqueue_pos_{0};
+  alignas(64) std::atomic<std::size_t> dequeue_pos_{0};
+
+  alignas(64) std::atomic<std::size_t> dropped_{0};
+
+  /// Counts the events pushed while sampling.
+  std::atomic<std::size_t> sampled_{0};
+
+  std::atomic<std::uint64_t> callback_time_us_{0};
+
+  /// Set while the consumer sleeps, producers only notify when it is set.
+  std::atomic<bool> waiting_{false};
+
+  std::atomic<bool> stopping_{false};
+
+  /// Set while the consumer thread runs, blocked producers give up otherwise.
+  std::atomic<bool> running_{false};
+
+  std::mutex wait_mutex_;
+  std::condition_variable wait_cv_;
+
+  /// Taken to pop when producers may drop the oldest event.
+  std::mutex pop_mutex_;
+
+  /// The number of producers waiting for room.
+  std::atomic<std::size_t> blocked_{0};
+
+  std::mutex space_mutex_;
+  std::condition_variable space_cv_;
+
+  std::unique_ptr<std::thread> consumer_;
+};
+
+} // namespace osquery
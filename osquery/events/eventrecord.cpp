@@ -0,0 +1,193 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <cstdint>
+
+#include <osquery/events/eventrecord.h>
+
+namespace osquery {
+
+namespace {
+
+/// The header that begins a binary record, followed by the version.
+const std::string kRecordMagic{"\0E", 2};
+
+/// The header that begins a serialized column dictionary.
+const std::string kColumnsMagic{"\0C", 2};
+
+/// The current binary record encoding version.
+const unsigned char kRecordVersion{1};
+
+void putString(std::string& out, const std::string& value) {
+  putEventVarint(out, value.size());
+  out.append(value);
+}
+
+/// Bounds-checked reads from an encoded record.
+class RecordReader {
+ public:
+  RecordReader(const std::string& data, size_t offset)
+      : data_(data), offset_(offset) {}
+
+  bool varint(std::uint64_t& value) {
+    return getEventVarint(data_, offset_, value);
+  }
+
+  bool string(std::string& value) {
+    std::uint64_t length = 0;
+    if (!varint(length) || length > remaining()) {
+      return false;
+    }
+    value.assign(data_, offset_, static_cast<size_t>(length));
+    offset_ += static_cast<size_t>(length);
+    return true;
+  }
+
+  size_t remaining() const {
+    return data_.size() - offset_;
+  }
+
+ private:
+  const std::string& data_;
+  size_t offset_{0};
+};
+
+bool hasHeader(const std::string& encoded, const std::string& magic) {
+  return encoded.size() > magic.size() &&
+         encoded.compare(0, magic.size(), magic) == 0 &&
+         static_cast<unsigned char>(encoded[magic.size()]) == kRecordVersion;
+}
+
+} // namespace
+
+bool isEventRecordBinary(const std::string& record) {
+  return !record.empty() && record[0] == '\0';
+}
+
+void putEventVarint(std::string& out, std::uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+bool getEventVarint(const std::string& data,
+                    std::size_t& offset,
+                    std::uint64_t& value) {
+  value = 0;
+  for (size_t shift = 0; shift < 64; shift += 7) {
+    if (offset >= data.size()) {
+      return false;
+    }
+    auto byte = static_cast<unsigned char>(data[offset++]);
+    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void EventRecordColumns::encode(const Row& row, std::string& record) {
+  record.assign(kRecordMagic);
+  record.push_back(static_cast<char>(kRecordVersion));
+  putEventVarint(record, row.size());
+
+  WriteLock lock(mutex_);
+  for (const auto& column : row) {
+    auto it = index_.find(column.first);
+    if (it == index_.end()) {
+      it = index_.emplace(column.first, names_.size()).first;
+      names_.push_back(column.first);
+    }
+    putEventVarint(record, it->second);
+    putString(record, column.second);
+  }
+}
+
+Status EventRecordColumns::decode(const std::string& record, Row& row) const {
+  if (!hasHeader(record, kRecordMagic)) {
+    return Status::failure("Unsupported event record encoding");
+  }
+
+  RecordReader reader(record, kRecordMagic.size() + 1);
+  std::uint64_t columns = 0;
+  // Every column takes at least two bytes.
+  if (!reader.varint(columns) || columns > reader.remaining() / 2) {
+    return Status::failure("Invalid event record column count");
+  }
+
+  ReadLock lock(mutex_);
+  for (std::uint64_t i = 0; i < columns; ++i) {
+    std::uint64_t column = 0;
+    if (!reader.varint(column) || column >= names_.size()) {
+      return Status::failure("Unknown event record column");
+    }
+
+    std::string value;
+    if (!reader.string(value)) {
+      return Status::failure("Truncated event record value");
+    }
+    row[names_[static_cast<size_t>(column)]] = std::move(value);
+  }
+
+  if (reader.remaining() != 0) {
+    return Status::failure("Unexpected data after event record");
+  }
+  return Status::success();
+}
+
+size_t EventRecordColumns::size() const {
+  ReadLock lock(mutex_);
+  return names_.size();
+}
+
+size_t EventRecordColumns::serialize(std::string& encoded) const {
+  encoded.assign(kColumnsMagic);
+  encoded.push_back(static_cast<char>(kRecordVersion));
+
+  ReadLock lock(mutex_);
+  putEventVarint(encoded, names_.size());
+  for (const auto& name : names_) {
+    putString(encoded, name);
+  }
+  return names_.size();
+}
+
+Status EventRecordColumns::deserialize(const std::string& encoded) {
+  if (!hasHeader(encoded, kColumnsMagic)) {
+    return Status::failure("Unsupported event columns encoding");
+  }
+
+  RecordReader reader(encoded, kColumnsMagic.size() + 1);
+  std::uint64_t count = 0;
+  if (!reader.varint(count) || count > reader.remaining()) {
+    return Status::failure("Invalid event columns count");
+  }
+
+  std::vector<std::string> names(static_cast<size_t>(count));
+  std::unordered_map<std::string, size_t> index;
+  for (size_t i = 0; i < names.size(); ++i) {
+    if (!reader.string(names[i]) || !index.emplace(names[i], i).second) {
+      return Status::failure("Invalid event column name");
+    }
+  }
+
+  if (reader.remaining() != 0) {
+    return Status::failure("Unexpected data after event columns");
+  }
+
+  WriteLock lock(mutex_);
+  names_ = std::move(names);
+  index_ = std::move(index);
+  return Status::success();
+}
+
+} // namespace osquery
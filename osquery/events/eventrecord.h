@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <osquery/core/sql/row.h>
+#include <osquery/utils/mutex.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/**
+ * @brief Check if a stored event uses the binary record encoding.
+ *
+ * Binary records begin with a NUL byte, which never begins JSON, so events
+ * stored as JSON by earlier versions are still recognized.
+ */
+bool isEventRecordBinary(const std::string& record);
+
+/// Append an unsigned LEB128 variable-length integer.
+void putEventVarint(std::string& out, std::uint64_t value);
+
+/**
+ * @brief Read a variable-length integer written by putEventVarint.
+ *
+ * @param data The encoded bytes.
+ * @param offset [in,out] The read position, advanced past the integer.
+ * @param value [output] The decoded integer.
+ * @return false if the integer is truncated or too long.
+ */
+bool getEventVarint(const std::string& data,
+                    std::size_t& offset,
+                    std::uint64_t& value);
+
+/**
+ * @brief The column names shared by the binary records of one subscriber.
+ *
+ * A subscriber emits the same handful of columns for every event, so the
+ * names are stored once in this dictionary and each record refers to its
+ * columns by index. The dictionary only grows, which keeps every record
+ * written with an older copy of it readable.
+ */
+class EventRecordColumns final {
+ public:
+  /// Encode a row, adding any column names not yet in the dictionary.
+  void encode(const Row& row, std::string& record);
+
+  /// Decode a record created by encode.
+  Status decode(const std::string& record, Row& row) const;
+
+  /// Return the number of column names.
+  size_t size() const;
+
+  /// Serialize the dictionary and return the number of names it contains.
+  size_t serialize(std::string& encoded) const;
+
+  /// Replace the dictionary with one created by serialize.
+  Status deserialize(const std::string& encoded);
+
+ private:
+  /// Column names in the order they were first seen.
+  std::vector<std::string> names_;
+
+  /// Reverse lookup of names_.
+  std::unordered_map<std::string, size_t> index_;
+
+  /// Protects the dictionary, records are encoded and decoded concurrently.
+  mutable Mutex mutex_;
+};
+
+} // namespace osquery
@@ -52,11 +52,18 @@ bool enforceEventsDenylist(const std::string& query) {
 }
 
 void attachEvents() {
+  attachEventPublishers();
+  attachEventSubscribers();
+}
+
+void attachEventPublishers() {
   const auto& publishers = RegistryFactory::get().plugins("event_publisher");
   for (const auto& publisher : publishers) {
     EventFactory::registerEventPublisher(publisher.second);
   }
+}
 
+void attachEventSubscribers() {
   const auto& subscribers = RegistryFactory::get().plugins("event_subscriber");
   for (const auto& subscriber : subscribers) {
     if (!boost::ends_with(subscriber.first, "_events")) {
@@ -15,6 +15,16 @@ namespace osquery {
 /// the event factory.
 void attachEvents();
 
+/// Register and set up each event publisher, the first half of attachEvents.
+void attachEventPublishers();
+
+/**
+ * @brief Register each event subscriber and configure the events.
+ *
+ * The second half of attachEvents, it requires the config to be loaded.
+ */
+void attachEventSubscribers();
+
 /// Return true if a query operates only on event-based tables and should be
 /// denylisted.
 bool enforceEventsDenylist(const std::string& query);
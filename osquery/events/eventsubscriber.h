@@ -10,6 +10,7 @@
 #pragma once
 #include <functional>
 #include <memory>
+#include <vector>
 
 #include <osquery/events/eventfactory.h>
 #include <osquery/events/eventpublisher.h>
@@ -83,14 +84,68 @@ class EventSubscriber : public EventSubscriberPlugin {
 
       // Add a subscription using the callable and
       // SubscriptionContext.
-      Status stat =
-          EventFactory::addSubscription(sub->getType(), sub->getName(), sc, cb);
+      Status stat = EventFactory::addSubscription(
+          sub->getType(), sub->getName(), sc, queueCallback(cb));
       if (stat.ok()) {
         subscription_count_++;
       }
     }
   }
 
+  /**
+   * @brief Bind a member function receiving batches of events to a
+   * Subscription.
+   *
+   * Publishers firing several events at once call the function a single time
+   * with the matching events, which lets it store them with one addBatch.
+   * Subscribers using a dispatch queue receive the events one at a time.
+   *
+   * @param entry A templated EventSubscriber member function.
+   * @param sc The subscription context.
+   */
+  template <typename T>
+  void subscribeBatch(Status (T::*entry)(const std::vector<ECRef>&,
+                                         const SCRef&),
+                      const SCRef& sc) {
+    auto sub = dynamic_cast<T*>(this);
+    if (sub == nullptr) {
+      return;
+    }
+
+    auto cb = [sub, entry](const EventContextList& ec_list,
+                           const SubscriptionContextRef& sc) -> Status {
+      std::vector<ECRef> events;
+      events.reserve(ec_list.size());
+      for (const auto& ec : ec_list) {
+        events.push_back(
+            std::dynamic_pointer_cast<typename ECRef::element_type>(ec));
+      }
+      return std::invoke(
+          entry,
+          *sub,
+          events,
+          std::dynamic_pointer_cast<typename SCRef::element_type>(sc));
+    };
+
+    SubscriptionRef subscription;
+    if (queuesEvents()) {
+      auto single = [cb](const EventContextRef& ec,
+                         const SubscriptionContextRef& sc) -> Status {
+        return cb({ec}, sc);
+      };
+      subscription =
+          Subscription::create(sub->getName(), sc, queueCallback(single));
+    } else {
+      subscription = Subscription::create(sub->getName(), sc);
+      subscription->batch_callback = std::move(cb);
+    }
+
+    Status stat = EventFactory::addSubscription(sub->getType(), subscription);
+    if (stat.ok()) {
+      subscription_count_++;
+    }
+  }
+
  public:
   explicit EventSubscriber(bool enabled = true)
       : EventSubscriberPlugin(enabled) {}
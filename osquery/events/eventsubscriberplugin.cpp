@@ -26,6 +26,9 @@ namespace {
 /// Checkpoint interval to inspect max event buffering.
 const EventContextID kEventsCheckpoint{256U};
 
+/// Buckets before the newest saved event that are read again at startup.
+const EventTime kEventIndexReplayBuckets{10U};
+
 void removeDeprecatedEventKeysOnceHelper() {
   std::vector<std::string> key_list;
   auto status = scanDatabaseKeys(kEvents, key_list);
@@ -68,6 +71,17 @@ void removeDeprecatedEventKeysOnce() {
   std::call_once(f, removeDeprecatedEventKeysOnceHelper);
 }
 
+/// Parse the zero-padded decimal index used within event keys.
+bool parseKeyIndex(const std::string& string_index, std::uint64_t& index) {
+  if (string_index.empty()) {
+    return false;
+  }
+
+  char* null_terminator = nullptr;
+  index = std::strtoull(string_index.c_str(), &null_terminator, 10);
+  return null_terminator != nullptr && *null_terminator == '\0';
+}
+
 } // namespace
 
 FLAG(bool,
@@ -86,11 +100,63 @@ FLAG(uint64,
      50000,
      "Maximum number of event batches per type to buffer");
 
+FLAG(uint64,
+     events_index_checkpoint_interval,
+     0,
+     "Seconds between saves of the event index used to skip reading old "
+     "records at startup, events stored late with an older time are then "
+     "lost (0 reads every record)");
+
+FLAG(uint64,
+     events_memory_max,
+     50000,
+     "Maximum number of events held by each in-memory subscriber");
+
+FLAG(bool,
+     events_memory_spill,
+     true,
+     "Save in-memory events to the backing store on overflow and shutdown");
+
+FLAG(uint64,
+     events_queue_size,
+     8192,
+     "Maximum number of events queued for each asynchronous subscriber");
+
+FLAG(string,
+     events_queue_policy,
+     "drop_newest",
+     "What a full subscriber queue does with new events: drop_newest, "
+     "drop_oldest, sample or block");
+
+namespace {
+
+EventQueuePolicy getQueuePolicy() {
+  const auto& policy = FLAGS_events_queue_policy;
+  if (policy == "drop_oldest") {
+    return EventQueuePolicy::DropOldest;
+  } else if (policy == "sample") {
+    return EventQueuePolicy::Sample;
+  } else if (policy == "block") {
+    return EventQueuePolicy::Block;
+  } else if (policy != "drop_newest") {
+    LOG(WARNING) << "Unknown events_queue_policy " << policy
+                 << ", dropping new events when a queue is full";
+  }
+  return EventQueuePolicy::DropNewest;
+}
+
+} // namespace
+
 CREATE_REGISTRY(EventSubscriberPlugin, "event_subscriber");
 
 EventSubscriberPlugin::EventSubscriberPlugin(bool enabled)
     : disabled(!enabled) {}
 
+EventSubscriberPlugin::~EventSubscriberPlugin() {
+  // The consumer thread runs callbacks bound to this subscriber.
+  stopEventQueue();
+}
+
 Status EventSubscriberPlugin::init() {
   return Status::success();
 }
@@ -112,75 +178,133 @@ Status EventSubscriberPlugin::addBatch(std::vector<Row>& row_list,
                                        EventTime custom_event_time) {
   removeDeprecatedEventKeysOnce();
 
-  DatabaseStringValueList database_data;
-  database_data.reserve(row_list.size());
+  if (row_list.empty()) {
+    return Status(1, "Failed to process the rows");
+  }
 
-  EventIDList event_id_list;
-  event_id_list.reserve(row_list.size());
+  DatabaseStringValueList database_data;
+  EventIndex stored_batches;
+  BufferedEventList memory_events;
+  if (context.memory_events != nullptr) {
+    memory_events.reserve(row_list.size());
+  } else {
+    database_data.reserve(row_list.size());
+  }
 
   auto event_time = custom_event_time != 0 ? custom_event_time : getTime();
   auto string_event_time = std::to_string(event_time);
+  auto forward_events = EventFactory::forwardsEvents();
 
   for (auto& row : row_list) {
     auto event_identifier = getEventID();
-    event_id_list.push_back(event_identifier);
-
     auto string_event_identifier = toIndex(event_identifier);
 
     row["time"] = string_event_time;
     row["eid"] = string_event_identifier;
 
-    // Serialize and store the row data, for query-time retrieval.
-    std::string serialized_row;
-    auto status = serializeRowJSON(row, serialized_row);
-    if (!status.ok()) {
-      VLOG(1) << status.getMessage();
-      continue;
+    // Logger plugins may request events to be forwarded directly as JSON.
+    // If no active logger is marked 'usesLogEvent' then this is a no-op.
+    if (forward_events) {
+      std::string serialized_row;
+      auto status = serializeRowJSON(row, serialized_row);
+      if (!status.ok()) {
+        VLOG(1) << status.getMessage();
+      } else {
+        // Remove the newline before forwarding.
+        if (serialized_row.size() > 0 && serialized_row.back() == '\n') {
+          serialized_row.pop_back();
+        }
+        EventFactory::forwardEvent(serialized_row);
+      }
     }
 
-    // Then remove the newline.
-    if (serialized_row.size() > 0 && serialized_row.back() == '\n') {
-      serialized_row.pop_back();
+    // Keep the row for query-time retrieval.
+    if (context.memory_events != nullptr) {
+      memory_events.push_back({event_time, event_identifier, row});
+    } else {
+      addEventRecord(context,
+                     database_data,
+                     stored_batches,
+                     event_time,
+                     event_identifier,
+                     row);
     }
+  }
 
-    // Logger plugins may request events to be forwarded directly.
-    // If no active logger is marked 'usesLogEvent' then this is a no-op.
-    EventFactory::forwardEvent(serialized_row);
+  if (context.memory_events != nullptr) {
+    // Only the events that no longer fit in memory reach the database.
+    auto evicted = context.memory_events->add(std::move(memory_events));
+    if (FLAGS_events_memory_spill) {
+      for (const auto& event : evicted) {
+        addEventRecord(context,
+                       database_data,
+                       stored_batches,
+                       event.time,
+                       event.id,
+                       event.row);
+      }
+    }
 
-    // Store the event data in the batch
-    database_data.push_back(
-        std::make_pair("data." + dbNamespace() + "." + string_event_identifier,
-                       serialized_row));
+    if (database_data.empty()) {
+      WriteLock lock(event_id_lock_);
+      event_count_ += row_list.size();
+      return Status::success();
+    }
   }
 
-  if (database_data.empty()) {
-    return Status(1, "Failed to process the rows");
-  }
+  return storeEventBatches(std::move(database_data),
+                           std::move(stored_batches),
+                           row_list.size());
+}
 
+void EventSubscriberPlugin::addEventRecord(
+    Context& context,
+    DatabaseStringValueList& database_data,
+    EventIndex& stored_batches,
+    EventTime event_time,
+    EventID event_id,
+    const Row& row) {
+  std::string record;
+  context.columns.encode(row, record);
+  database_data.push_back(std::make_pair(
+      databaseKeyForEventId(context, event_time, event_id), std::move(record)));
+  stored_batches.add(event_time, event_id);
+  context.column_index.add(event_id, row);
+}
+
+Status EventSubscriberPlugin::storeEventBatches(
+    DatabaseStringValueList database_data,
+    EventIndex stored_batches,
+    std::size_t event_count) {
   // Save the batched data inside the database and update the event index
   bool cleanup_events{false};
 
   {
     WriteLock lock(event_id_lock_);
 
+    // Save any new column names in the same batch as the records using them.
+    std::size_t column_count{context.saved_columns};
+    if (context.columns.size() != column_count) {
+      std::string columns;
+      column_count = context.columns.serialize(columns);
+      database_data.push_back(
+          std::make_pair(databaseKeyForColumns(context), std::move(columns)));
+    }
+
     auto status = setDatabaseBatch(kEvents, database_data);
     if (!status.ok()) {
       return status;
     }
+    context.saved_columns = column_count;
 
-    auto it = context.event_index.find(event_time);
-    if (it == context.event_index.end()) {
-      context.event_index.insert({event_time, event_id_list});
-
-    } else {
-      auto& index_entry = it->second;
-      index_entry.insert(
-          index_entry.end(), event_id_list.begin(), event_id_list.end());
+    {
+      WriteLock index_lock(context.event_index_mutex);
+      context.event_index.merge(stored_batches);
     }
 
-    cleanup_events = (((event_count_ % kEventsCheckpoint) + row_list.size()) >=
+    cleanup_events = (((event_count_ % kEventsCheckpoint) + event_count) >=
                       kEventsCheckpoint);
-    event_count_ += row_list.size();
+    event_count_ += event_count;
   }
 
   // Use the last EventID and a checkpoint bucket size to periodically apply
@@ -189,13 +313,94 @@ Status EventSubscriberPlugin::addBatch(std::vector<Row>& row_list,
     removeOverflowingEventBatches(context, getDatabase(), getEventBatchesMax());
 
     expireEventBatches(context, getDatabase(), getMinExpiry(), getTime());
+
+    // A recent index lets the next start only read the newest records.
+    auto interval = FLAGS_events_index_checkpoint_interval;
+    if (interval > 0 && getUnixTime() >= context.last_index_save + interval) {
+      saveEventIndex();
+    }
   }
 
   return Status::success();
 }
 
+void EventSubscriberPlugin::spillMemoryEvents() {
+  if (context.memory_events == nullptr) {
+    return;
+  }
+
+  auto events = context.memory_events->drain();
+  if (events.empty() || !FLAGS_events_memory_spill) {
+    return;
+  }
+
+  DatabaseStringValueList database_data;
+  EventIndex stored_batches;
+  database_data.reserve(events.size());
+  for (const auto& event : events) {
+    addEventRecord(context,
+                   database_data,
+                   stored_batches,
+                   event.time,
+                   event.id,
+                   event.row);
+  }
+
+  auto status = storeEventBatches(
+      std::move(database_data), std::move(stored_batches), 0U);
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to save " << events.size()
+               << " in-memory events for subscriber: " << getName() << ": "
+               << status.getMessage();
+  } else {
+    VLOG(1) << "Saved " << events.size()
+            << " in-memory events for subscriber: " << getName();
+  }
+}
+
+EventCallback EventSubscriberPlugin::queueCallback(EventCallback callback) {
+  if (event_queue_ == nullptr || callback == nullptr) {
+    return callback;
+  }
+
+  // The consumer only needs to run while there are subscriptions.
+  event_queue_->start();
+
+  auto queue = event_queue_;
+  auto queued_callback =
+      std::make_shared<const EventCallback>(std::move(callback));
+  return [queue, queued_callback](const EventContextRef& ec,
+                                  const SubscriptionContextRef& sc) {
+    if (!queue->push({queued_callback, ec, sc})) {
+      return Status::failure("Event queue is full");
+    }
+    return Status::success();
+  };
+}
+
+bool EventSubscriberPlugin::queuesEvents() const {
+  return event_queue_ != nullptr;
+}
+
+void EventSubscriberPlugin::saveEventIndex() {
+  auto status = saveEventDataIndex(context, getDatabase());
+  if (!status.ok()) {
+    VLOG(1) << "Failed to save the event index of subscriber " << getName()
+            << ": " << status.getMessage();
+  }
+}
+
+void EventSubscriberPlugin::stopEventQueue() {
+  if (event_queue_ != nullptr) {
+    event_queue_->stop();
+  }
+}
+
 Status EventSubscriberPlugin::generateEventDataIndex() {
-  return generateEventDataIndex(context, getDatabase());
+  auto expiry = getMinExpiry();
+  auto now = getTime();
+  EventTime expire_before = (expiry > 0 && now > expiry) ? now - expiry : 0U;
+  return generateEventDataIndex(context, getDatabase(), expire_before);
 }
 
 EventID EventSubscriberPlugin::getEventID() {
@@ -210,6 +415,10 @@ size_t EventSubscriberPlugin::getEventBatchesMax() {
   return FLAGS_events_max;
 }
 
+std::set<std::string> EventSubscriberPlugin::indexedColumns() const {
+  return {};
+}
+
 bool EventSubscriberPlugin::shouldOptimize() const {
   return isDaemon() && FLAGS_events_optimize;
 }
@@ -254,7 +463,9 @@ uint64_t EventSubscriberPlugin::getExpireTime() {
 void EventSubscriberPlugin::generateRows(std::function<void(Row)> callback,
                                          bool can_optimize,
                                          EventTime start_time,
-                                         EventTime stop_time) {
+                                         EventTime stop_time,
+                                         const EventColumnConstraints&
+                                             column_constraints) {
   EventTime optimize_time{0U};
   EventID optimize_eid{0U};
   if (can_optimize && shouldOptimize()) {
@@ -269,18 +480,32 @@ void EventSubscriberPlugin::generateRows(std::function<void(Row)> callback,
   }
 
   {
+    auto filter = this->context.column_index.filter(column_constraints);
     auto last = generateRows(this->context,
                              getDatabase(),
                              callback,
                              start_time,
                              stop_time,
-                             optimize_eid);
+                             optimize_eid,
+                             filter.has_value() ? &*filter : nullptr);
+
+    auto visited = last.has_value();
+    EventTime last_time = visited ? last->time : 0U;
+    EventID last_eid = visited ? last->id : 0U;
+
+    // In-memory subscribers keep their recent events outside of the index.
+    if (this->context.memory_events != nullptr &&
+        this->context.memory_events->generateRows(callback,
+                                                  start_time,
+                                                  stop_time,
+                                                  optimize_eid,
+                                                  last_time,
+                                                  last_eid)) {
+      visited = true;
+    }
 
-    if (can_optimize && shouldOptimize()) {
-      if (last != this->context.event_index.end()) {
-        auto last_eid = last->second.empty() ? 0 : last->second.back();
-        setOptimizeData(getDatabase(), last->first, last_eid);
-      }
+    if (can_optimize && shouldOptimize() && visited) {
+      setOptimizeData(getDatabase(), last_time, last_eid);
     }
   }
 
@@ -314,11 +539,26 @@ void EventSubscriberPlugin::genTable(RowYield& yield, QueryContext& context) {
     }
   }
 
-  auto generateRowsCallback = [&yield](Row row) {
+  // Use the constraints on indexed columns to skip most records.
+  EventColumnConstraints column_constraints;
+  for (const auto& column : indexedColumns()) {
+    auto constraints = context.constraints.find(column);
+    if (constraints == context.constraints.end()) {
+      continue;
+    }
+
+    auto& allowed = column_constraints[column];
+    allowed.values = constraints->second.getAll(EQUALS);
+    allowed.prefixes = constraints->second.getPrefixes();
+  }
+
+  auto generateRowsCallback = [this, &yield](Row row) {
+    joinEventRow(row);
     yield(TableRowHolder(new DynamicTableRow(std::move(row))));
   };
 
-  generateRows(generateRowsCallback, can_optimize, start, stop);
+  generateRows(
+      generateRowsCallback, can_optimize, start, stop, column_constraints);
 }
 
 size_t EventSubscriberPlugin::numSubscriptions() const {
@@ -329,6 +569,18 @@ EventContextID EventSubscriberPlugin::numEvents() const {
   return event_count_;
 }
 
+size_t EventSubscriberPlugin::numDroppedEvents() const {
+  return (event_queue_ != nullptr) ? event_queue_->dropped() : 0;
+}
+
+size_t EventSubscriberPlugin::queueDepth() const {
+  return (event_queue_ != nullptr) ? event_queue_->size() : 0;
+}
+
+std::uint64_t EventSubscriberPlugin::callbackTime() const {
+  return (event_queue_ != nullptr) ? event_queue_->callbackTime() : 0;
+}
+
 bool EventSubscriberPlugin::executedAllQueries() const {
   ReadLock lock(event_query_record_);
   return queries_.size() >= query_count_;
@@ -405,74 +657,184 @@ void EventSubscriberPlugin::setDatabaseNamespace(Context& context,
 }
 
 Status EventSubscriberPlugin::generateEventDataIndex(
-    Context& context, IDatabaseInterface& db_interface) {
-  std::vector<std::string> key_list;
-
-  std::string prefix = "data." + context.database_namespace + ".";
-  auto status = db_interface.scanDatabaseKeys(kEvents, key_list, prefix, 0);
-  if (!status.ok()) {
-    return status;
+    Context& context,
+    IDatabaseInterface& db_interface,
+    EventTime expire_before) {
+  // Binary records refer to the column names saved with them. A subscriber
+  // that only stored JSON records has none.
+  std::string columns;
+  auto status = db_interface.getDatabaseValue(
+      kEvents, databaseKeyForColumns(context), columns);
+  if (status.ok()) {
+    status = context.columns.deserialize(columns);
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to read the event columns of "
+                 << context.database_namespace << ": " << status.getMessage();
+    } else {
+      context.saved_columns = context.columns.size();
+    }
   }
 
-  std::vector<std::string> invalid_data_key_list;
-  std::size_t event_count{0U};
-
+  // A saved index provides the times of its events without reading their
+  // records. It may be stale, so only events whose keys still exist are used.
   EventID last_event_id{1U};
-  EventIndex event_index;
-
-  for (const auto& key : key_list) {
-    auto string_event_id = &key[prefix.size()];
-
-    EventID event_identifier = {};
-
-    {
-      char* null_terminator = nullptr;
-      auto int_value = std::strtoull(string_event_id, &null_terminator, 10);
-      if (int_value == 0U || null_terminator == nullptr ||
-          *null_terminator != '\0') {
-        invalid_data_key_list.push_back(key);
-        continue;
+  std::vector<EventIndexEntry> saved_entries;
+  {
+    std::string encoded_index;
+    status = db_interface.getDatabaseValue(
+        kEvents, databaseKeyForIndex(context), encoded_index);
+    if (status.ok()) {
+      EventIndex saved_index;
+      EventID saved_last_event_id{0U};
+      status = saved_index.deserialize(encoded_index, saved_last_event_id);
+      if (!status.ok()) {
+        VLOG(1) << "Ignoring the saved event index of "
+                << context.database_namespace << ": " << status.getMessage();
+      } else {
+        // Identifiers are never reused while the saved index exists.
+        last_event_id = std::max(last_event_id, saved_last_event_id);
+        saved_entries.assign(saved_index.begin(), saved_index.end());
+        std::sort(saved_entries.begin(),
+                  saved_entries.end(),
+                  [](const EventIndexEntry& l, const EventIndexEntry& r) {
+                    return l.id < r.id;
+                  });
       }
-
-      event_identifier = static_cast<EventID>(int_value);
     }
+  }
 
-    last_event_id = std::max(last_event_id, event_identifier);
-
-    EventTime event_time = {};
-
-    {
-      std::string serialized_row;
-      status = db_interface.getDatabaseValue(kEvents, key, serialized_row);
-      if (!status.ok()) {
-        invalid_data_key_list.push_back(key);
-        continue;
-      }
+  std::vector<std::string> invalid_data_key_list;
+  std::vector<std::string> legacy_data_key_list;
+  std::vector<std::string> expired_data_key_list;
+  std::vector<EventIndexEntry> entries;
+
+  // With checkpoints the saved index holds every event stored before it was
+  // saved, except events stored late with an older time. Only the buckets
+  // around the newest saved event and after it are read, the saved events of
+  // older buckets are used as is.
+  std::string resume;
+  EventTime first_bucket{0U};
+  if (FLAGS_events_index_checkpoint_interval > 0 && !saved_entries.empty()) {
+    EventTime newest{0U};
+    for (const auto& entry : saved_entries) {
+      newest = std::max(newest, entry.time);
+    }
 
-      Row row;
-      if (!deserializeRowJSON(serialized_row, row)) {
-        invalid_data_key_list.push_back(key);
+    auto newest_bucket = eventBucket(newest);
+    first_bucket = newest_bucket - std::min(newest_bucket,
+                                            kEventIndexReplayBuckets);
+    // Their records may have been expired since the index was saved, those
+    // of buckets before the expiry horizon are dropped instead.
+    auto expired_bucket = eventBucket(expire_before);
+    for (const auto& entry : saved_entries) {
+      auto bucket = eventBucket(entry.time);
+      if (bucket >= first_bucket) {
         continue;
+      } else if (bucket < expired_bucket) {
+        expired_data_key_list.push_back(
+            databaseKeyForEventId(context, entry.time, entry.id));
+      } else {
+        entries.push_back(entry);
       }
+    }
+    resume = databasePrefixForBucket(context, first_bucket);
+  }
 
-      if (row.count("time") == 0) {
-        invalid_data_key_list.push_back(key);
-        continue;
-      }
+  struct LegacyEvent {
+    std::string key;
+    std::string serialized_row;
+    EventIndexEntry entry;
+  };
+  std::vector<LegacyEvent> legacy_events;
 
-      event_time = boost::lexical_cast<EventTime>(row.at("time"));
-    }
+  // Records are read with their keys. Keys written before events were kept
+  // in time buckets are moved once the scan is complete.
+  std::string prefix = "data." + context.database_namespace + ".";
+  std::string next_key;
+  status = db_interface.scanDatabaseValues(
+      kEvents,
+      prefix,
+      resume,
+      0,
+      [&](const std::string& key, const std::string& serialized_row) {
+        // Keys end with "<bucket>.<eid>", legacy keys end with "<eid>".
+        auto suffix = key.substr(prefix.size());
+        auto separator = suffix.find('.');
+        auto legacy_key = (separator == std::string::npos);
+
+        EventID event_identifier = {};
+        EventTime bucket = {};
+
+        {
+          std::uint64_t int_value = 0U;
+          auto string_event_id =
+              legacy_key ? suffix : suffix.substr(separator + 1);
+          auto string_bucket = legacy_key ? "0" : suffix.substr(0, separator);
+          if (!parseKeyIndex(string_event_id, int_value) || int_value == 0U ||
+              !parseKeyIndex(string_bucket, bucket)) {
+            invalid_data_key_list.push_back(key);
+            return true;
+          }
+
+          event_identifier = static_cast<EventID>(int_value);
+        }
+
+        last_event_id = std::max(last_event_id, event_identifier);
+
+        if (!legacy_key) {
+          auto saved = std::lower_bound(
+              saved_entries.begin(),
+              saved_entries.end(),
+              event_identifier,
+              [](const EventIndexEntry& entry, EventID id) {
+                return entry.id < id;
+              });
+          if (saved != saved_entries.end() && saved->id == event_identifier &&
+              eventBucket(saved->time) == bucket) {
+            entries.push_back(*saved);
+            return true;
+          }
+        }
+
+        Row row;
+        if (!deserializeEventRecord(context, serialized_row, row) ||
+            row.count("time") == 0) {
+          invalid_data_key_list.push_back(key);
+          return true;
+        }
+
+        auto event_time = boost::lexical_cast<EventTime>(row.at("time"));
+        if (legacy_key) {
+          legacy_events.push_back(
+              {key, serialized_row, {event_time, event_identifier}});
+          return true;
+
+        } else if (bucket != eventBucket(event_time)) {
+          // The record could not be found when its bucket expires.
+          invalid_data_key_list.push_back(key);
+          return true;
+        }
+
+        entries.push_back({event_time, event_identifier});
+        return true;
+      },
+      next_key);
+  if (!status.ok()) {
+    return status;
+  }
 
-    auto it = event_index.find(event_time);
-    if (it == event_index.end()) {
-      auto insert_status = event_index.insert({event_time, {}});
-      it = insert_status.first;
+  for (const auto& legacy_event : legacy_events) {
+    const auto& entry = legacy_event.entry;
+    auto bucket_key = databaseKeyForEventId(context, entry.time, entry.id);
+    status = db_interface.setDatabaseValue(
+        kEvents, bucket_key, legacy_event.serialized_row);
+    if (!status.ok()) {
+      invalid_data_key_list.push_back(legacy_event.key);
+      continue;
     }
 
-    auto& event_id_list = it->second;
-    event_id_list.push_back(event_identifier);
-
-    ++event_count;
+    legacy_data_key_list.push_back(legacy_event.key);
+    entries.push_back(entry);
   }
 
   if (!invalid_data_key_list.empty()) {
@@ -488,23 +850,142 @@ Status EventSubscriberPlugin::generateEventDataIndex(
     }
   }
 
-  if (event_count != 0U) {
-    VLOG(1) << "Found " << event_count << " events for subscriber "
+  for (const auto& expired_data_key : expired_data_key_list) {
+    status = db_interface.deleteDatabaseValue(kEvents, expired_data_key);
+    if (!status.ok()) {
+      VLOG(1) << "Failed to delete the following expired event: "
+              << expired_data_key;
+    }
+  }
+
+  if (!legacy_data_key_list.empty()) {
+    VLOG(1) << "Moved " << legacy_data_key_list.size()
+            << " events into time buckets for subscriber "
+            << context.database_namespace;
+
+    for (const auto& legacy_data_key : legacy_data_key_list) {
+      status = db_interface.deleteDatabaseValue(kEvents, legacy_data_key);
+      if (!status.ok()) {
+        VLOG(1) << "Failed to delete the following moved event: "
+                << legacy_data_key;
+      }
+    }
+  }
+
+  if (!entries.empty()) {
+    VLOG(1) << "Found " << entries.size() << " events for subscriber "
             << context.database_namespace;
   }
 
   context.last_event_id = last_event_id;
-  context.event_index = std::move(event_index);
+  {
+    WriteLock lock(context.event_index_mutex);
+    context.event_index.assign(std::move(entries));
+  }
+
+  // The values of events stored by a previous run are not read.
+  context.column_index.setFirstIndexedId(last_event_id + 1);
 
   return Status::success();
 }
 
+const EventTime EventSubscriberPlugin::kEventBucketSeconds{60U};
+
+EventTime EventSubscriberPlugin::eventBucket(EventTime event_time) {
+  return event_time / kEventBucketSeconds;
+}
+
+std::string EventSubscriberPlugin::databasePrefixForBucket(Context& context,
+                                                           EventTime bucket) {
+  return std::string("data.") + context.database_namespace + "." +
+         toIndex(bucket) + ".";
+}
+
 std::string EventSubscriberPlugin::databaseKeyForEventId(Context& context,
+                                                         EventTime event_time,
                                                          EventID event_id) {
-  auto string_event_id = toIndex(event_id);
+  return databasePrefixForBucket(context, eventBucket(event_time)) +
+         toIndex(event_id);
+}
 
-  return std::string("data.") + context.database_namespace + "." +
-         string_event_id;
+std::string EventSubscriberPlugin::databaseKeyForColumns(Context& context) {
+  return std::string("columns.") + context.database_namespace;
+}
+
+std::string EventSubscriberPlugin::databaseKeyForIndex(Context& context) {
+  return std::string("eventindex.") + context.database_namespace;
+}
+
+Status EventSubscriberPlugin::saveEventDataIndex(
+    Context& context, IDatabaseInterface& db_interface) {
+  std::string encoded_index;
+  {
+    ReadLock lock(context.event_index_mutex);
+    context.event_index.serialize(encoded_index, context.last_event_id);
+  }
+  auto status = db_interface.setDatabaseValue(
+      kEvents, databaseKeyForIndex(context), encoded_index);
+  if (status.ok()) {
+    context.last_index_save = getUnixTime();
+  }
+  return status;
+}
+
+Status EventSubscriberPlugin::deserializeEventRecord(Context& context,
+                                                     const std::string& record,
+                                                     Row& row) {
+  if (isEventRecordBinary(record)) {
+    return context.columns.decode(record, row);
+  }
+  return deserializeRowJSON(record, row);
+}
+
+std::size_t EventSubscriberPlugin::deleteEventBatches(
+    Context& context,
+    IDatabaseInterface& db_interface,
+    const EventIndex& removed_batches,
+    std::optional<EventTime> first_kept_time) {
+  if (removed_batches.empty()) {
+    return 0U;
+  }
+
+  // Records in the bucket of the oldest remaining batch must be kept.
+  auto partial_bucket = first_kept_time.has_value()
+                            ? eventBucket(*first_kept_time)
+                            : eventBucket(removed_batches.back().time) + 1;
+
+  std::size_t error_count{0U};
+  auto first_bucket = eventBucket(removed_batches.front().time);
+  if (first_bucket < partial_bucket) {
+    // Every key sorts between the bucket prefix and the prefix with a
+    // trailing 0xFF byte, the range bounds are inclusive.
+    auto low = databasePrefixForBucket(context, first_bucket);
+    auto high = databasePrefixForBucket(context, partial_bucket - 1) + '\xff';
+    auto status = db_interface.deleteDatabaseRange(kEvents, low, high);
+    if (!status.ok()) {
+      VLOG(1) << "Failed to delete the event range " << low << " to "
+              << high.substr(0, high.size() - 1) << ": "
+              << status.getMessage();
+    }
+
+    auto partial_it =
+        removed_batches.lowerBound(partial_bucket * kEventBucketSeconds);
+    if (!status.ok()) {
+      error_count += static_cast<std::size_t>(
+          std::distance(removed_batches.begin(), partial_it));
+    }
+  }
+
+  auto it = removed_batches.lowerBound(partial_bucket * kEventBucketSeconds);
+  for (; it != removed_batches.end(); ++it) {
+    auto key = databaseKeyForEventId(context, it->time, it->id);
+    auto status = db_interface.deleteDatabaseValue(kEvents, key);
+    if (!status.ok()) {
+      ++error_count;
+    }
+  }
+
+  return error_count;
 }
 
 void EventSubscriberPlugin::removeOverflowingEventBatches(
@@ -516,6 +997,7 @@ void EventSubscriberPlugin::removeOverflowingEventBatches(
   }
 
   EventIndex excess_event_batch_list;
+  std::optional<EventTime> first_kept_time;
 
   {
     WriteLock lock(context.event_index_mutex);
@@ -524,13 +1006,11 @@ void EventSubscriberPlugin::removeOverflowingEventBatches(
     }
 
     auto batches_to_remove = context.event_index.size() - max_event_batches;
-    auto range_start = context.event_index.begin();
-    auto range_end = std::next(range_start, batches_to_remove);
-
-    excess_event_batch_list.insert(std::make_move_iterator(range_start),
-                                   std::make_move_iterator(range_end));
-
-    context.event_index.erase(range_start, range_end);
+    excess_event_batch_list =
+        context.event_index.removeBatches(batches_to_remove);
+    if (!context.event_index.empty()) {
+      first_kept_time = context.event_index.front().time;
+    }
   }
 
   if (excess_event_batch_list.empty()) {
@@ -553,20 +1033,13 @@ void EventSubscriberPlugin::removeOverflowingEventBatches(
     string_last_query_time = buffer.data();
   }
 
-  std::size_t batches_removed{};
-  for (const auto& p : excess_event_batch_list) {
-    const auto& event_identifier_list = p.second;
+  context.column_index.remove(excess_event_batch_list);
 
-    for (auto event_id : event_identifier_list) {
-      auto key = databaseKeyForEventId(context, event_id);
-      auto status = db_interface.deleteDatabaseValue(kEvents, key);
-      if (status.ok()) {
-        ++batches_removed;
-      }
-    }
-  }
+  auto event_count = excess_event_batch_list.eventCount();
 
-  auto failed_delete_count = (excess_event_batch_list.size() - batches_removed);
+  auto failed_delete_count = deleteEventBatches(
+      context, db_interface, excess_event_batch_list, first_kept_time);
+  auto batches_removed = event_count - failed_delete_count;
 
   std::stringstream message;
   message << "Removed " << batches_removed << " event batches ";
@@ -590,7 +1063,12 @@ void EventSubscriberPlugin::expireEventBatches(Context& context,
     return;
   }
 
+  if (context.memory_events != nullptr && current_time > events_expiry) {
+    context.memory_events->expire(current_time - events_expiry);
+  }
+
   EventIndex expired_event_batch_list;
+  std::optional<EventTime> first_kept_time;
 
   {
     WriteLock lock(context.event_index_mutex);
@@ -600,34 +1078,22 @@ void EventSubscriberPlugin::expireEventBatches(Context& context,
 
     auto oldest_valid_time = current_time - events_expiry;
 
-    auto oldest_event_time = context.event_index.begin()->first;
+    auto oldest_event_time = context.event_index.front().time;
     if (oldest_event_time >= oldest_valid_time) {
       return;
     }
 
-    auto range_start = context.event_index.begin();
-    auto range_end = context.event_index.upper_bound(oldest_valid_time);
-
-    expired_event_batch_list.insert(std::make_move_iterator(range_start),
-                                    std::make_move_iterator(range_end));
-
-    context.event_index.erase(range_start, range_end);
+    expired_event_batch_list =
+        context.event_index.removeUntil(oldest_valid_time);
+    if (!context.event_index.empty()) {
+      first_kept_time = context.event_index.front().time;
+    }
   }
 
-  // TODO(alessandro): Implement deleteDatabaseBatch
-  std::size_t error_count{};
-
-  for (const auto& p : expired_event_batch_list) {
-    const auto& event_identifier_list = p.second;
+  context.column_index.remove(expired_event_batch_list);
 
-    for (const auto& event_identifier : event_identifier_list) {
-      auto key = databaseKeyForEventId(context, event_identifier);
-      auto status = db_interface.deleteDatabaseValue(kEvents, key);
-      if (!status.ok()) {
-        ++error_count;
-      }
-    }
-  }
+  auto error_count = deleteEventBatches(
+      context, db_interface, expired_event_batch_list, first_kept_time);
 
   if (error_count > 0U) {
     LOG(ERROR) << "Failed to expire " << error_count
@@ -635,61 +1101,64 @@ void EventSubscriberPlugin::expireEventBatches(Context& context,
   }
 }
 
-EventIndex::iterator EventSubscriberPlugin::generateRows(
+std::optional<EventIndexEntry> EventSubscriberPlugin::generateRows(
     Context& context,
     IDatabaseInterface& db_interface,
     std::function<void(Row)> callback,
     EventTime start_time,
     EventTime end_time,
-    EventID last_eid) {
-  auto last = context.event_index.end();
+    EventID last_eid,
+    const EventIdFilter* filter) {
   if (end_time != 0 && start_time > end_time) {
-    return last;
+    return std::nullopt;
   }
 
-  EventIndex::iterator lower_bound_it;
-  if (start_time == 0U) {
-    lower_bound_it = context.event_index.begin();
-
-  } else {
-    lower_bound_it = context.event_index.lower_bound(start_time);
-    if (lower_bound_it == context.event_index.end()) {
-      return last;
+  // Copy the events in the range so publishers can keep adding events while
+  // the records are read.
+  std::vector<EventIndexEntry> entries;
+  {
+    ReadLock lock(context.event_index_mutex);
+    auto lower_bound_it = context.event_index.lowerBound(start_time);
+    auto upper_bound_it = (end_time == 0U)
+                              ? context.event_index.end()
+                              : context.event_index.upperBound(end_time);
+    if (lower_bound_it < upper_bound_it) {
+      entries.assign(lower_bound_it, upper_bound_it);
     }
   }
 
-  auto upper_bound_it = (end_time == 0U)
-                            ? context.event_index.end()
-                            : context.event_index.upper_bound(end_time);
+  if (entries.empty()) {
+    return std::nullopt;
+  }
 
   std::vector<std::string> invalid_key_list;
-  for (auto it = lower_bound_it; it != upper_bound_it; ++it) {
-    const auto& event_id_list = it->second;
-
-    for (const auto& event_identifier : event_id_list) {
-      if (last_eid >= event_identifier) {
-        // A previous optimized query has already visited this event.
-        continue;
-      }
-      auto key = databaseKeyForEventId(context, event_identifier);
+  for (const auto& entry : entries) {
+    if (last_eid >= entry.id) {
+      // A previous optimized query has already visited this event.
+      continue;
+    }
 
-      std::string serialized_row;
-      auto status = db_interface.getDatabaseValue(kEvents, key, serialized_row);
-      if (serialized_row.empty()) {
-        invalid_key_list.push_back(key);
-        continue;
-      }
+    if (filter != nullptr && !filter->matches(entry.id)) {
+      // The event does not hold an allowed value of an indexed column.
+      continue;
+    }
+    auto key = databaseKeyForEventId(context, entry.time, entry.id);
 
-      Row row = {};
-      status = deserializeRowJSON(serialized_row, row);
-      if (!status.ok()) {
-        invalid_key_list.push_back(key);
-        continue;
-      }
+    std::string serialized_row;
+    auto status = db_interface.getDatabaseValue(kEvents, key, serialized_row);
+    if (serialized_row.empty()) {
+      invalid_key_list.push_back(key);
+      continue;
+    }
 
-      callback(std::move(row));
+    Row row = {};
+    status = deserializeEventRecord(context, serialized_row, row);
+    if (!status.ok()) {
+      invalid_key_list.push_back(key);
+      continue;
     }
-    last = it;
+
+    callback(std::move(row));
   }
 
   if (!invalid_key_list.empty()) {
@@ -705,7 +1174,7 @@ EventIndex::iterator EventSubscriberPlugin::generateRows(
     LOG(ERROR) << "Found " << invalid_key_list.size() << " invalid events ("
                << erased_key_count << " have been successfully erased)";
   }
-  return last;
+  return entries.back();
 }
 
 const std::string EventSubscriberPlugin::dbNamespace() const {
@@ -716,6 +1185,8 @@ uint64_t EventSubscriberPlugin::getTime() const {
   return getUnixTime();
 }
 
+void EventSubscriberPlugin::joinEventRow(Row& row) const {}
+
 IDatabaseInterface& EventSubscriberPlugin::getDatabase() const {
   return getOsqueryDatabase();
 }
@@ -741,12 +1212,37 @@ void EventSubscriberPlugin::setDatabaseNamespace() {
 
 Status EventSubscriberPlugin::setUp() {
   setDatabaseNamespace();
+
+  // Events held in memory by a previous set up are kept in the database.
+  spillMemoryEvents();
+  if (memory_storage) {
+    context.memory_events =
+        std::make_unique<EventMemoryStore>(FLAGS_events_memory_max);
+  } else {
+    context.memory_events.reset();
+  }
+
+  // Subscriptions made by a previous set up keep using an existing queue.
+  if (async_dispatch) {
+    if (event_queue_ == nullptr) {
+      event_queue_ = std::make_shared<EventQueue>(
+          getName(), FLAGS_events_queue_size, getQueuePolicy());
+    }
+  } else if (event_queue_ != nullptr) {
+    stopEventQueue();
+    event_queue_.reset();
+  }
+
+  context.column_index.setColumns(indexedColumns());
   generateEventDataIndex();
 
   expireEventBatches(context, getDatabase(), getMinExpiry(), getTime());
 
   removeOverflowingEventBatches(context, getDatabase(), getEventBatchesMax());
 
+  // A restart before the next save still finds most events in this copy.
+  saveEventIndex();
+
   return Status::success();
 }
 
@@ -9,12 +9,20 @@
 
 #pragma once
 
+#include <optional>
+#include <set>
+
 #include <gtest/gtest_prod.h>
 
 #include <osquery/core/plugins/plugin.h>
 #include <osquery/core/tables.h>
 #include <osquery/database/database.h>
+#include <osquery/events/eventcolumnindex.h>
 #include <osquery/events/eventer.h>
+#include <osquery/events/eventindex.h>
+#include <osquery/events/eventmemorystore.h>
+#include <osquery/events/eventqueue.h>
+#include <osquery/events/eventrecord.h>
 #include <osquery/events/types.h>
 #include <osquery/utils/mutex.h>
 
@@ -75,6 +83,11 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   /// Scans the database to enumerate all the data keys and build a new index
   Status generateEventDataIndex();
 
+  /// Save encoded event records and add their batches to the index.
+  Status storeEventBatches(DatabaseStringValueList database_data,
+                           EventIndex stored_batches,
+                           std::size_t event_count);
+
   /**
    * @brief Get a unique storage-related EventID.
    *
@@ -124,12 +137,23 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
    * @param can_optimize If true then optimization can be considered.
    * @param start_time Inclusive lower bound time limit.
    * @param end_time Inclusive upper bound time limit.
+   * @param column_constraints Query constraints on the indexed columns.
    * @return Set of event rows matching time limits.
    */
   void generateRows(std::function<void(Row)> callback,
                     bool can_optimize,
                     EventTime start_time,
-                    EventTime stop_stop);
+                    EventTime stop_stop,
+                    const EventColumnConstraints& column_constraints = {});
+
+  /**
+   * @brief Columns whose values are indexed to answer query constraints.
+   *
+   * Equality and prefix LIKE constraints on these columns limit the records
+   * read by a query. The table spec must mark the columns `additional` for
+   * SQLite to pass their constraints.
+   */
+  virtual std::set<std::string> indexedColumns() const;
 
   /// Track a query execution.
   virtual void setExecutedQuery(const std::string& query_name,
@@ -158,7 +182,7 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
    */
   explicit EventSubscriberPlugin(bool enabled);
 
-  virtual ~EventSubscriberPlugin() override = default;
+  virtual ~EventSubscriberPlugin() override;
 
   /**
    * @brief Suggested entrypoint for table generation.
@@ -179,6 +203,15 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   /// The number of events this EventSubscriber has received.
   EventContextID numEvents() const;
 
+  /// The number of events dropped because the dispatch queue was full.
+  size_t numDroppedEvents() const;
+
+  /// The number of events waiting in the dispatch queue.
+  size_t queueDepth() const;
+
+  /// The total time, in microseconds, the dispatch queue spent in callbacks.
+  std::uint64_t callbackTime() const;
+
   /// Compare the number of queries run against the queries configured.
   virtual bool executedAllQueries() const;
 
@@ -189,6 +222,21 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
 
     std::size_t last_query_time{0U};
     std::atomic<EventID> last_event_id{0U};
+
+    /// The time the event index was last saved.
+    std::atomic<EventTime> last_index_save{0U};
+
+    /// Column names used by the binary event records.
+    EventRecordColumns columns;
+
+    /// The number of column names saved in the database.
+    std::size_t saved_columns{0U};
+
+    /// Recent events of a subscriber configured to keep them in memory.
+    std::unique_ptr<EventMemoryStore> memory_events;
+
+    /// The events holding each value of the indexed columns.
+    EventColumnIndex column_index;
   };
 
   static std::string toIndex(std::uint64_t i);
@@ -210,10 +258,76 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
                                    const std::string& type,
                                    const std::string& name);
 
+  /**
+   * @brief Build the event index from the stored records.
+   *
+   * @param expire_before events older than this time are expired, the saved
+   * index entries of buckets before it are dropped with their records.
+   */
   static Status generateEventDataIndex(Context& context,
-                                       IDatabaseInterface& db_interface);
+                                       IDatabaseInterface& db_interface,
+                                       EventTime expire_before = 0U);
+
+  /// Event records are stored in key ranges covering this much event time.
+  static const EventTime kEventBucketSeconds;
+
+  /// Return the time bucket holding events from an event time.
+  static EventTime eventBucket(EventTime event_time);
+
+  /// The common prefix of the record keys within a time bucket.
+  static std::string databasePrefixForBucket(Context& context,
+                                             EventTime bucket);
+
+  static std::string databaseKeyForEventId(Context& context,
+                                           EventTime event_time,
+                                           EventID event_id);
+
+  /// The database key holding the column names of the event records.
+  static std::string databaseKeyForColumns(Context& context);
+
+  /// The database key holding a saved copy of the event index.
+  static std::string databaseKeyForIndex(Context& context);
+
+  /**
+   * @brief Save the event index so the next start can skip reading records.
+   *
+   * The saved index is only a hint: generateEventDataIndex still lists the
+   * record keys, and reads the records of events missing from the copy.
+   */
+  static Status saveEventDataIndex(Context& context,
+                                   IDatabaseInterface& db_interface);
 
-  static std::string databaseKeyForEventId(Context& context, EventID event_id);
+  /// Decode an event record stored as either binary or JSON.
+  static Status deserializeEventRecord(Context& context,
+                                       const std::string& record,
+                                       Row& row);
+
+  /**
+   * @brief Delete the records of batches removed from the front of the index.
+   *
+   * Time buckets without any remaining batch are dropped with a single range
+   * delete. Only the records sharing a bucket with the oldest remaining batch
+   * are deleted one key at a time.
+   *
+   * @param context The subscriber context.
+   * @param db_interface A database interface.
+   * @param removed_batches The batches removed from the index.
+   * @param first_kept_time The time of the oldest remaining batch, if any.
+   * @return The number of records that could not be deleted.
+   */
+  static std::size_t deleteEventBatches(
+      Context& context,
+      IDatabaseInterface& db_interface,
+      const EventIndex& removed_batches,
+      std::optional<EventTime> first_kept_time);
+
+  /// Encode an event record and add it to a database batch.
+  static void addEventRecord(Context& context,
+                             DatabaseStringValueList& database_data,
+                             EventIndex& stored_batches,
+                             EventTime event_time,
+                             EventID event_id,
+                             const Row& row);
 
   static void removeOverflowingEventBatches(Context& context,
                                             IDatabaseInterface& db_interface,
@@ -235,14 +349,17 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
    * @param start_time Inclusive lower bound time limit.
    * @param end_time Inclusive upper bound time limit.
    * @param last_eid (optional) The last visited event id.
-   * @return The upper bound time or 0 if there were no events in the range.
+   * @param filter (optional) Only read the records of events it matches.
+   * @return The last event in the range, if there were any.
    */
-  static EventIndex::iterator generateRows(Context& context,
-                                           IDatabaseInterface& db_interface,
-                                           std::function<void(Row)> callback,
-                                           EventTime start_time,
-                                           EventTime end_time,
-                                           EventID last_eid = 0);
+  static std::optional<EventIndexEntry> generateRows(
+      Context& context,
+      IDatabaseInterface& db_interface,
+      std::function<void(Row)> callback,
+      EventTime start_time,
+      EventTime end_time,
+      EventID last_eid = 0,
+      const EventIdFilter* filter = nullptr);
 
   explicit EventSubscriberPlugin(EventSubscriberPlugin const&) = delete;
   EventSubscriberPlugin& operator=(EventSubscriberPlugin const&) = delete;
@@ -265,6 +382,9 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   /// Return the current time (included to assist testing).
   virtual uint64_t getTime() const;
 
+  /// Add columns that were only known after an event was stored to its row.
+  virtual void joinEventRow(Row& row) const;
+
   /// Return the backing storage (included to assist testing).
   virtual IDatabaseInterface& getDatabase() const;
 
@@ -277,6 +397,21 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   /// Set the subscriber type and name on the managed context.
   void setDatabaseNamespace();
 
+  /// Move the events held in memory to the database, if spilling is enabled.
+  void spillMemoryEvents();
+
+  /**
+   * @brief Route a subscription callback through the dispatch queue.
+   *
+   * Subscribers without a queue get the callback back unchanged. Otherwise the
+   * returned callback only queues the event, and the queue's consumer thread
+   * runs the original callback.
+   */
+  EventCallback queueCallback(EventCallback callback);
+
+  /// Return true if callbacks are run by a dispatch queue.
+  bool queuesEvents() const;
+
   /// A helper value counting the number of fired events tracked by publishers.
   EventContextID event_count_{0};
 
@@ -286,6 +421,12 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
  private:
   Status setUp() override;
 
+  /// Run the events still queued and stop the dispatch queue consumer.
+  void stopEventQueue();
+
+  /// Save the event index of this subscriber, see saveEventDataIndex.
+  void saveEventIndex();
+
   /// Do not respond to periodic/scheduled/triggered event expiration requests.
   bool expire_events_{true};
 
@@ -322,11 +463,31 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
    */
   bool disabled{false};
 
+  /**
+   * @brief Keep events in memory rather than in the backing store.
+   *
+   * Set by the EventFactory from the "memory_subscribers" list of the events
+   * configuration before the subscriber is set up.
+   */
+  bool memory_storage{false};
+
+  /**
+   * @brief Run callbacks on a dedicated thread rather than the publisher's.
+   *
+   * Set by the EventFactory from the "async_subscribers" list of the events
+   * configuration before the subscriber is set up.
+   */
+  bool async_dispatch{false};
+
+  /// Events fired by publishers and waiting for the subscriber callbacks.
+  std::shared_ptr<EventQueue> event_queue_;
+
   friend class EventFactory;
   friend class EventPublisherPlugin;
 
   FRIEND_TEST(EventsTests, test_event_subscriber_configure);
   FRIEND_TEST(EventsTests, test_event_toggle_subscribers);
+  FRIEND_TEST(EventsTests, test_event_subscriber_memory_storage);
   FRIEND_TEST(EventSubscriberPluginTests, getExpireTime);
   FRIEND_TEST(EventSubscriberPluginTests, getEventsExpiry);
   FRIEND_TEST(EventSubscriberPluginTests, generateRowsWithExpiry);
@@ -13,8 +13,10 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
+#include <thread>
 
 #include <boost/utility/string_ref.hpp>
 
@@ -56,6 +58,12 @@ FLAG(int32, audit_backlog_wait_time, 0, "The audit backlog wait time");
 /// This value is passed directly to the audit API.
 FLAG(int32, audit_backlog_limit, 4096, "The audit backlog limit");
 
+FLAG(uint64,
+     audit_parser_threads,
+     0,
+     "Number of threads parsing audit records (default 0 uses half of the "
+     "CPU cores, up to 4)");
+
 // External flags; they are used to determine which rules need to be installed
 DECLARE_bool(audit_allow_config);
 DECLARE_bool(audit_allow_fim_events);
@@ -76,6 +84,19 @@ constexpr std::uint64_t kUnprocessedRecordsThreshold{4096};
 constexpr std::uint64_t kThrottlingMessageInterval{60};
 // How much to wait for each throttling loop in millseconds
 constexpr std::uint64_t kThrottlingDuration{100};
+// The most parser threads used when audit_parser_threads is 0
+constexpr std::size_t kMaxDefaultParserThreads{4};
+
+std::size_t getParserThreadCount() noexcept {
+  if (FLAGS_audit_parser_threads > 0) {
+    return static_cast<std::size_t>(FLAGS_audit_parser_threads);
+  }
+
+  auto thread_count =
+      static_cast<std::size_t>(std::thread::hardware_concurrency()) / 2;
+  return std::max<std::size_t>(
+      1, std::min(thread_count, kMaxDefaultParserThreads));
+}
 
 bool IsSELinuxRecord(const audit_reply& reply) noexcept {
   static const auto& selinux_event_set = kSELinuxEventList;
@@ -137,11 +158,20 @@ AuditdNetlink::AuditdNetlink() {
   try {
     auditd_context_ = std::make_shared<AuditdContext>();
 
+    // Create every queue before the services start using them
+    auto parser_count = getParserThreadCount();
+    for (std::size_t i = 0; i < parser_count; ++i) {
+      auditd_context_->unprocessed_queues.push_back(
+          std::make_unique<AuditdRecordQueue>());
+    }
+
     Dispatcher::addService(
         std::make_shared<AuditdNetlinkReader>(auditd_context_));
 
-    Dispatcher::addService(
-        std::make_shared<AuditdNetlinkParser>(auditd_context_));
+    for (std::size_t i = 0; i < parser_count; ++i) {
+      Dispatcher::addService(
+          std::make_shared<AuditdNetlinkParser>(auditd_context_, i));
+    }
 
   } catch (const std::bad_alloc&) {
     VLOG(1) << "Failed to initialize the AuditdNetlink services due to a "
@@ -174,10 +204,20 @@ std::vector<AuditEventRecord> AuditdNetlink::getEvents() noexcept {
   return record_list;
 }
 
+std::size_t AuditdNetlink::backlog() const noexcept {
+  return auditd_context_->unprocessed_records_amount +
+         auditd_context_->processed_records_backlog;
+}
+
+std::size_t AuditdNetlink::takeLostRecords() noexcept {
+  return auditd_context_->lost_records.exchange(0);
+}
+
 AuditdNetlinkReader::AuditdNetlinkReader(AuditdContextRef context)
     : InternalRunnable("AuditdNetlinkReader"),
       auditd_context_(std::move(context)),
-      read_buffer_(1024U) {}
+      read_buffer_(1024U),
+      read_buffer_queues_(read_buffer_.size()) {}
 
 void AuditdNetlinkReader::start() {
   int counter_to_next_status_request = 0;
@@ -235,7 +275,9 @@ void AuditdNetlinkReader::stop() {
 
   VLOG(1) << "Releasing the audit handle...";
 
-  auditd_context_->unprocessed_records_cv.notify_all();
+  for (auto& queue : auditd_context_->unprocessed_queues) {
+    queue->cv.notify_all();
+  }
 
   if (FLAGS_audit_allow_config) {
     restoreAuditServiceConfiguration();
@@ -287,6 +329,13 @@ bool AuditdNetlinkReader::acquireMessages() noexcept {
                            &nladdrlen);
 
     if (len < 0) {
+      if (errno == ENOBUFS) {
+        // The kernel dropped records, the socket is still usable.
+        VLOG(1) << "The audit netlink socket buffer is full (ENOBUFS)";
+        ++auditd_context_->lost_records;
+        break;
+      }
+
       VLOG(1) << "Failed to receive data from the audit netlink";
       reset_handle = true;
       break;
@@ -319,20 +368,7 @@ bool AuditdNetlinkReader::acquireMessages() noexcept {
   }
 
   if (events_received != 0) {
-    std::unique_lock<std::mutex> lock(
-        auditd_context_->unprocessed_records_mutex);
-
-    auditd_context_->unprocessed_records.reserve(
-        auditd_context_->unprocessed_records.size() + events_received);
-
-    auditd_context_->unprocessed_records.insert(
-        auditd_context_->unprocessed_records.end(),
-        read_buffer_.begin(),
-        std::next(read_buffer_.begin(), events_received));
-
-    auditd_context_->unprocessed_records_amount += events_received;
-
-    auditd_context_->unprocessed_records_cv.notify_all();
+    queueMessages(events_received);
   }
 
   /* Throttle reading if the processing thread cannot keep up,
@@ -722,29 +758,94 @@ NetlinkStatus AuditdNetlinkReader::acquireHandle() noexcept {
   return NetlinkStatus::ActiveMutable;
 }
 
-AuditdNetlinkParser::AuditdNetlinkParser(AuditdContextRef context)
-    : InternalRunnable("AuditdNetlinkParser"),
-      auditd_context_(std::move(context)) {}
+void AuditdNetlinkReader::queueMessages(std::size_t record_count) noexcept {
+  auto& queues = auditd_context_->unprocessed_queues;
+
+  // Records without a serial number, such as status replies, use the first
+  // queue
+  for (std::size_t i = 0; i < record_count; ++i) {
+    read_buffer_queues_[i] =
+        (queues.size() == 1)
+            ? 0
+            : AuditdNetlinkParser::GetAuditSerial(read_buffer_[i]) %
+                  queues.size();
+  }
+
+  auditd_context_->unprocessed_records_amount += record_count;
+
+  for (std::size_t queue_index = 0; queue_index < queues.size();
+       ++queue_index) {
+    auto& queue = *queues[queue_index];
+    std::size_t queued_count = 0;
+
+    {
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      for (std::size_t i = 0; i < record_count; ++i) {
+        if (read_buffer_queues_[i] == queue_index) {
+          queue.records.push_back(read_buffer_[i]);
+          ++queued_count;
+        }
+      }
+    }
+
+    if (queued_count != 0) {
+      queue.cv.notify_all();
+    }
+  }
+}
+
+AuditdNetlinkParser::AuditdNetlinkParser(AuditdContextRef context,
+                                         std::size_t queue_index)
+    : InternalRunnable("AuditdNetlinkParser" +
+                       (queue_index == 0 ? "" : std::to_string(queue_index))),
+      auditd_context_(std::move(context)),
+      queue_(*auditd_context_->unprocessed_queues.at(queue_index)) {}
+
+std::uint64_t AuditdNetlinkParser::GetAuditSerial(
+    const audit_reply& reply) noexcept {
+  // Event records start with "audit(<seconds>.<milliseconds>:<serial>): "
+  static const boost::string_ref kAuditPrefix{"audit("};
+
+  // The kernel stores the payload length in nlmsg_len, see AdjustAuditReply
+  auto length = std::min<std::size_t>(reply.msg.nlh.nlmsg_len,
+                                      sizeof(reply.msg.data));
+  boost::string_ref message_view(reply.msg.data, length);
+  if (!message_view.starts_with(kAuditPrefix)) {
+    return 0;
+  }
+
+  auto separator = message_view.find(':');
+  if (separator == boost::string_ref::npos) {
+    return 0;
+  }
+
+  std::uint64_t serial = 0;
+  for (auto i = separator + 1;
+       i < message_view.size() && message_view[i] >= '0' &&
+       message_view[i] <= '9';
+       ++i) {
+    serial = serial * 10 + static_cast<std::uint64_t>(message_view[i] - '0');
+  }
+  return serial;
+}
 
 void AuditdNetlinkParser::start() {
   while (!interrupted()) {
     std::vector<audit_reply> queue;
 
     {
-      std::unique_lock<std::mutex> lock(
-          auditd_context_->unprocessed_records_mutex);
+      std::unique_lock<std::mutex> lock(queue_.mutex);
 
-      while (auditd_context_->unprocessed_records.empty()) {
+      while (queue_.records.empty()) {
         if (interrupted()) {
           return;
         }
 
-        auditd_context_->unprocessed_records_cv.wait_for(
-            lock, std::chrono::seconds(1));
+        queue_.cv.wait_for(lock, std::chrono::seconds(1));
       }
 
-      queue = std::move(auditd_context_->unprocessed_records);
-      auditd_context_->unprocessed_records.clear();
+      queue = std::move(queue_.records);
+      queue_.records.clear();
     }
 
     std::vector<AuditEventRecord> audit_event_record_queue;
@@ -829,19 +930,24 @@ void AuditdNetlinkParser::start() {
        kThrottlingMessageInterval seconds */
     if (auditd_context_->processing_throttling_count > 0) {
       auto now = getUnixTime();
-      if (auditd_context_->last_processing_throttling_message_time +
-              kThrottlingMessageInterval <=
-          now) {
+      auto last_message_time =
+          auditd_context_->last_processing_throttling_message_time.load();
+
+      // Only one of the parsers reports the throttling of all of them
+      if (last_message_time + kThrottlingMessageInterval <= now &&
+          auditd_context_->last_processing_throttling_message_time
+              .compare_exchange_strong(last_message_time, now)) {
+        auto throttling_count =
+            auditd_context_->processing_throttling_count.exchange(0);
+
         /* NOTE: this is meant as a debugging message since throttling here
            doesn't mean that events will be lost. It might cause throttling on
            the reading side, but if that happens a warning
            will be given there */
         VLOG(1) << "The Audit publisher has throttled record processing for "
-                << (auditd_context_->processing_throttling_count / 10.0f)
+                << (throttling_count / 10.0f)
                 << " seconds. This may cause further throttling and loss of "
                    "events.";
-        auditd_context_->processing_throttling_count = 0;
-        auditd_context_->last_processing_throttling_message_time = now;
       }
     }
   }
@@ -881,39 +987,44 @@ bool AuditdNetlinkParser::ParseAuditReply(
     event_record.raw_data = reply.message;
   }
 
-  // Tokenize the message
-  boost::string_ref field_view(message_view.substr(preamble_end + 3));
+  // Tokenize the message; keys and values point into the retained copy
+  auto field_view = event_record.fields.retain(std::string_view(
+      message_view.data() + preamble_end + 3,
+      message_view.size() - preamble_end - 3));
 
-  // The linear search will construct series of key value pairs.
-  std::string key, value;
-  key.reserve(20);
-  value.reserve(256);
+  // The linear search will construct series of key value pairs, as offsets
+  // into the message.
+  std::size_t key_start{0U};
+  std::size_t key_size{0U};
+  std::size_t value_start{0U};
+  std::size_t value_size{0U};
 
   // There are several ways of representing value data (enclosed strings,
   // etc).
   bool found_assignment{false};
   bool found_enclose{false};
 
-  for (const auto& c : field_view) {
+  for (std::size_t i = 0U; i < field_view.size(); ++i) {
     // Iterate over each character in the audit message.
+    auto c = field_view[i];
     if ((found_enclose && c == '"') || (!found_enclose && c == ' ')) {
       if (c == '"') {
-        value += c;
+        ++value_size;
       }
 
       // This is a terminating sequence, the end of an enclosure or space
       // tok.
-      if (!key.empty()) {
+      if (key_size != 0U) {
         // Multiple space tokens are supported.
-        event_record.fields.emplace(
-            std::make_pair(std::move(key), std::move(value)));
+        event_record.fields.emplace(field_view.substr(key_start, key_size),
+                                    field_view.substr(value_start, value_size));
       }
 
       found_enclose = false;
       found_assignment = false;
 
-      key.clear();
-      value.clear();
+      key_size = 0U;
+      value_size = 0U;
 
     } else if (!found_assignment && c == ' ') {
       // A field tokenizer.
@@ -924,25 +1035,98 @@ bool AuditdNetlinkParser::ParseAuditReply(
         found_enclose = true;
       }
 
-      value += c;
+      ++value_size;
 
     } else if (c == '=') {
       found_assignment = true;
+      value_start = i + 1;
 
     } else {
-      key += c;
+      if (key_size == 0U) {
+        key_start = i;
+      }
+      ++key_size;
     }
   }
 
   // Last step, if there was no trailing tokenizer.
-  if (!key.empty()) {
-    event_record.fields.emplace(
-        std::make_pair(std::move(key), std::move(value)));
+  if (key_size != 0U) {
+    event_record.fields.emplace(field_view.substr(key_start, key_size),
+                                field_view.substr(value_start, value_size));
   }
 
   return true;
 }
 
+AuditFields::AuditFields(
+    std::initializer_list<std::pair<std::string, std::string>> list) {
+  for (const auto& field : list) {
+    set(field.first, field.second);
+  }
+}
+
+std::string_view AuditFields::retain(std::string_view message) {
+  buffers_.push_back(std::make_shared<const std::string>(message));
+  return *buffers_.back();
+}
+
+void AuditFields::emplace(std::string_view key, std::string_view value) {
+  fields_.emplace_back(key, value);
+}
+
+void AuditFields::set(std::string_view key, std::string_view value) {
+  std::string buffer;
+  buffer.reserve(key.size() + value.size());
+  buffer.append(key).append(value);
+
+  auto field_view = retain(buffer);
+  Field field{field_view.substr(0, key.size()),
+              field_view.substr(key.size())};
+
+  for (auto& existing_field : fields_) {
+    if (existing_field.first == key) {
+      existing_field = field;
+      return;
+    }
+  }
+  fields_.push_back(field);
+}
+
+AuditFields::const_iterator AuditFields::find(
+    std::string_view key) const noexcept {
+  return std::find_if(fields_.begin(),
+                      fields_.end(),
+                      [key](const Field& field) { return field.first == key; });
+}
+
+std::string_view AuditFields::at(std::string_view key) const {
+  auto it = find(key);
+  if (it == end()) {
+    throw std::out_of_range("Missing audit record field");
+  }
+  return it->second;
+}
+
+std::size_t AuditFields::count(std::string_view key) const noexcept {
+  return (find(key) == end()) ? 0U : 1U;
+}
+
+std::size_t AuditFields::size() const noexcept {
+  return fields_.size();
+}
+
+bool AuditFields::empty() const noexcept {
+  return fields_.empty();
+}
+
+AuditFields::const_iterator AuditFields::begin() const noexcept {
+  return fields_.begin();
+}
+
+AuditFields::const_iterator AuditFields::end() const noexcept {
+  return fields_.end();
+}
+
 void AuditdNetlinkParser::AdjustAuditReply(audit_reply& reply) noexcept {
   reply.type = reply.msg.nlh.nlmsg_type;
   reply.len = reply.msg.nlh.nlmsg_len;
@@ -14,10 +14,14 @@
 #include <atomic>
 #include <condition_variable>
 #include <future>
+#include <initializer_list>
 #include <map>
 #include <memory>
 #include <set>
+#include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <boost/algorithm/hex.hpp>
@@ -32,6 +36,53 @@ enum class NetlinkStatus { ActiveMutable, ActiveImmutable, Disabled, Error };
 /// Contains an audit_rule_data structure
 using AuditRuleDataObject = std::vector<std::uint8_t>;
 
+/**
+ * @brief The fields of an audit record, in the order of the message.
+ *
+ * Keys and values point into a copy of the record message that is kept, and
+ * shared, by the field list; the strings are only materialized when a field
+ * is copied into a row. Records have a handful of fields, so a linear search
+ * is faster than a map.
+ */
+class AuditFields final {
+ public:
+  using Field = std::pair<std::string_view, std::string_view>;
+  using const_iterator = std::vector<Field>::const_iterator;
+
+  AuditFields() = default;
+
+  /// Copy fields that are not part of a message, used to build records.
+  AuditFields(std::initializer_list<std::pair<std::string, std::string>> list);
+
+  /// Keep a copy of a message; the returned view may be passed to emplace.
+  std::string_view retain(std::string_view message);
+
+  /// Add a field pointing into a retained message.
+  void emplace(std::string_view key, std::string_view value);
+
+  /// Add or replace a field, copying the key and value.
+  void set(std::string_view key, std::string_view value);
+
+  /// The first field with the given key, lookups ignore later duplicates.
+  const_iterator find(std::string_view key) const noexcept;
+
+  /// Get the value of a field, throws std::out_of_range if missing.
+  std::string_view at(std::string_view key) const;
+
+  std::size_t count(std::string_view key) const noexcept;
+  std::size_t size() const noexcept;
+  bool empty() const noexcept;
+
+  const_iterator begin() const noexcept;
+  const_iterator end() const noexcept;
+
+ private:
+  /// Buffers holding the keys and values; shared by copies of the list
+  std::vector<std::shared_ptr<const std::string>> buffers_;
+
+  std::vector<Field> fields_;
+};
+
 /// A single, prepared audit event record.
 struct AuditEventRecord final {
   /// Record type (i.e.: AUDIT_SYSCALL, AUDIT_PATH, ...)
@@ -45,7 +96,7 @@ struct AuditEventRecord final {
 
   /// The field list for this record. Valid for everything except SELinux and
   /// AppArmor records
-  std::map<std::string, std::string> fields;
+  AuditFields fields;
 
   /// The raw message, only valid for SELinux and AppArmor records (because they
   /// have broken syntax)
@@ -55,20 +106,27 @@ struct AuditEventRecord final {
 static_assert(std::is_move_constructible<AuditEventRecord>::value,
               "not move constructible");
 
-// This structure is used to share data between the reading and processing
-// services
-struct AuditdContext final {
+/// Raw audit records waiting for one of the parser services
+struct AuditdRecordQueue final {
   /// Unprocessed audit records
-  std::vector<audit_reply> unprocessed_records;
-  static_assert(
-      std::is_move_constructible<decltype(unprocessed_records)>::value,
-      "not move constructible");
+  std::vector<audit_reply> records;
+  static_assert(std::is_move_constructible<decltype(records)>::value,
+                "not move constructible");
 
   /// Mutex for the list of unprocessed records
-  std::mutex unprocessed_records_mutex;
+  std::mutex mutex;
 
-  /// Processed events condition variable
-  std::condition_variable unprocessed_records_cv;
+  /// Unprocessed records condition variable
+  std::condition_variable cv;
+};
+
+// This structure is used to share data between the reading and processing
+// services
+struct AuditdContext final {
+  /// Unprocessed audit records, one queue for each parser service. The
+  /// records of an audit event always go to the same queue, so they are
+  /// parsed in order
+  std::vector<std::unique_ptr<AuditdRecordQueue>> unprocessed_queues;
 
   /// This queue contains processed events
   std::vector<AuditEventRecord> processed_events;
@@ -91,17 +149,21 @@ struct AuditdContext final {
   /// publisher cannot empty the backlog fast enough
   std::atomic<std::size_t> processed_records_backlog{};
 
+  /// Amount of records the kernel dropped because the netlink socket buffer
+  /// was full (ENOBUFS)
+  std::atomic<std::size_t> lost_records{};
+
   /// Timestamp of the last Netlink records reading throttling message
   std::uint64_t last_netlink_throttling_message_time{};
 
   /// Timestamp of the last records processing throttling message
-  std::uint64_t last_processing_throttling_message_time{};
+  std::atomic<std::uint64_t> last_processing_throttling_message_time{};
 
   /// Count of loops done during Netlink records reading throttling
   std::uint32_t netlink_throttling_count{};
 
   /// Count of loops done during records processing throttling
-  std::uint32_t processing_throttling_count{};
+  std::atomic<std::uint32_t> processing_throttling_count{};
 };
 
 using AuditdContextRef = std::shared_ptr<AuditdContext>;
@@ -119,6 +181,9 @@ class AuditdNetlinkReader final : public InternalRunnable {
   /// Reads as many audit event records as possible before returning.
   bool acquireMessages() noexcept;
 
+  /// Hands the records in the read buffer to the parser queues.
+  void queueMessages(std::size_t record_count) noexcept;
+
   /// Configures the audit service and applies required rules
   bool configureAuditService() noexcept;
 
@@ -141,6 +206,9 @@ class AuditdNetlinkReader final : public InternalRunnable {
   /// Read buffer used when receiving events from the netlink
   std::vector<audit_reply> read_buffer_;
 
+  /// The parser queue of each record in the read buffer
+  std::vector<std::size_t> read_buffer_queues_;
+
   /// The set of rules we applied (and that we'll uninstall when exiting)
   std::vector<audit_rule_data> installed_rule_list_;
 
@@ -151,12 +219,15 @@ class AuditdNetlinkReader final : public InternalRunnable {
   int audit_netlink_handle_{-1};
 };
 
-/// This service parses the raw audit records
+/// This service parses the raw audit records of one queue
 class AuditdNetlinkParser final : public InternalRunnable {
  public:
-  explicit AuditdNetlinkParser(AuditdContextRef context);
+  AuditdNetlinkParser(AuditdContextRef context, std::size_t queue_index);
   virtual void start() override;
 
+  /// Returns the audit event serial number of a raw record, or 0
+  static std::uint64_t GetAuditSerial(const audit_reply& reply) noexcept;
+
   /// Parses an audit_reply structure into an AuditEventRecord object
   static bool ParseAuditReply(const audit_reply& reply,
                               AuditEventRecord& event_record) noexcept;
@@ -167,6 +238,9 @@ class AuditdNetlinkParser final : public InternalRunnable {
  private:
   /// Shared data
   AuditdContextRef auditd_context_;
+
+  /// The queue of the records parsed by this service
+  AuditdRecordQueue& queue_;
 };
 
 /// This class provides access to the audit netlink data
@@ -178,6 +252,12 @@ class AuditdNetlink final : private boost::noncopyable {
   /// Prepares the raw audit event records stored in the given context.
   std::vector<AuditEventRecord> getEvents() noexcept;
 
+  /// Returns the number of records read but not yet returned by getEvents
+  std::size_t backlog() const noexcept;
+
+  /// Returns, and resets, the number of records lost by the netlink socket
+  std::size_t takeLostRecords() noexcept;
+
  private:
   /// Shared data
   AuditdContextRef auditd_context_;
@@ -99,6 +99,10 @@ Status AuditEventPublisher::run() {
   }
 
   auto audit_event_record_queue = audit_netlink_->getEvents();
+  queue_depth_ = audit_netlink_->backlog();
+
+  // Each lost netlink message is at least one audit record of an event.
+  recordDroppedEvents(audit_netlink_->takeLostRecords());
 
   auto event_context = createEventContext();
 
@@ -118,6 +122,10 @@ Status AuditEventPublisher::run() {
   return Status::success();
 }
 
+size_t AuditEventPublisher::queueDepth() const {
+  return queue_depth_;
+}
+
 void AuditEventPublisher::ProcessEvents(
     AuditEventContextRef event_context,
     const std::vector<AuditEventRecord>& record_list,
@@ -434,7 +442,7 @@ const AuditEventRecord* GetEventRecord(const AuditEvent& event,
 };
 
 bool GetStringFieldFromMap(std::string& value,
-                           const std::map<std::string, std::string>& fields,
+                           const AuditFields& fields,
                            const std::string& name,
                            const std::string& default_value) noexcept {
   auto it = fields.find(name);
@@ -448,7 +456,7 @@ bool GetStringFieldFromMap(std::string& value,
 }
 
 bool GetIntegerFieldFromMap(std::uint64_t& value,
-                            const std::map<std::string, std::string>& field_map,
+                            const AuditFields& field_map,
                             const std::string& field_name,
                             std::size_t base,
                             std::uint64_t default_value) noexcept {
@@ -463,7 +471,7 @@ bool GetIntegerFieldFromMap(std::uint64_t& value,
 }
 
 void CopyFieldFromMap(Row& row,
-                      const std::map<std::string, std::string>& fields,
+                      const AuditFields& fields,
                       const std::string& name,
                       const std::string& default_value) noexcept {
   GetStringFieldFromMap(row[name], fields, name, default_value);
@@ -143,6 +143,9 @@ class AuditEventPublisher final
   void tearDown() override;
   Status run() override;
 
+  /// Audit records read from the netlink but not yet assembled into events
+  size_t queueDepth() const override;
+
   virtual ~AuditEventPublisher() {
     tearDown();
   }
@@ -166,6 +169,9 @@ class AuditEventPublisher final
 
   /// Syscalls allowed to fail (captured even if success=no)
   std::set<int> syscalls_allowed_to_fail_;
+
+  /// The netlink backlog seen by the last run
+  std::atomic<std::size_t> queue_depth_{0};
 };
 
 /// Extracts the specified audit event record from the given audit event
@@ -175,14 +181,14 @@ const AuditEventRecord* GetEventRecord(const AuditEvent& event,
 /// Extracts the specified string key from the given string map
 bool GetStringFieldFromMap(
     std::string& value,
-    const std::map<std::string, std::string>& fields,
+    const AuditFields& fields,
     const std::string& name,
     const std::string& default_value = std::string()) noexcept;
 
 /// Extracts the specified integer key from the given string map
 bool GetIntegerFieldFromMap(
     std::uint64_t& value,
-    const std::map<std::string, std::string>& field_map,
+    const AuditFields& field_map,
     const std::string& field_name,
     std::size_t base = 10,
     std::uint64_t default_value =
@@ -191,7 +197,7 @@ bool GetIntegerFieldFromMap(
 /// Copies a named field from the 'fields' map to the specified row
 void CopyFieldFromMap(
     Row& row,
-    const std::map<std::string, std::string>& fields,
+    const AuditFields& fields,
     const std::string& name,
     const std::string& default_value = std::string()) noexcept;
 
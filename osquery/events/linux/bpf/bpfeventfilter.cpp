@@ -0,0 +1,164 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/events/linux/bpf/bpfeventfilter.h>
+
+#include <algorithm>
+
+namespace osquery {
+
+namespace {
+
+Status parseIntegerList(std::unordered_set<std::uint64_t>& value_set,
+                        const rapidjson::Value& exclude,
+                        const char* key) {
+  auto member_it = exclude.FindMember(key);
+  if (member_it == exclude.MemberEnd()) {
+    return Status::success();
+  }
+
+  if (!member_it->value.IsArray()) {
+    return Status::failure(std::string("The ") + key +
+                           " entry is not an array");
+  }
+
+  for (const auto& value : member_it->value.GetArray()) {
+    if (!value.IsUint64()) {
+      return Status::failure(std::string("The ") + key +
+                             " entry contains a value that is not an "
+                             "unsigned integer");
+    }
+
+    value_set.insert(value.GetUint64());
+  }
+
+  return Status::success();
+}
+
+Status parseStringList(std::vector<std::string>& value_list,
+                       const rapidjson::Value& exclude,
+                       const char* key) {
+  auto member_it = exclude.FindMember(key);
+  if (member_it == exclude.MemberEnd()) {
+    return Status::success();
+  }
+
+  if (!member_it->value.IsArray()) {
+    return Status::failure(std::string("The ") + key +
+                           " entry is not an array");
+  }
+
+  for (const auto& value : member_it->value.GetArray()) {
+    if (!value.IsString() || value.GetStringLength() == 0U) {
+      return Status::failure(std::string("The ") + key +
+                             " entry contains a value that is not a "
+                             "valid string");
+    }
+
+    value_list.push_back(value.GetString());
+  }
+
+  return Status::success();
+}
+
+} // namespace
+
+bool BPFEventFilter::empty() const {
+  return uid_set.empty() && cgroup_id_set.empty() && path_set.empty() &&
+         path_prefix_list.empty() && name_set.empty();
+}
+
+bool BPFEventFilter::excluded(const ISystemStateTracker::Event& event) const {
+  const auto& header = event.bpf_header;
+  if (uid_set.count(static_cast<std::uint64_t>(header.user_id)) != 0U ||
+      cgroup_id_set.count(header.cgroup_id) != 0U) {
+    return true;
+  }
+
+  const auto& binary_path = event.binary_path;
+  if (binary_path.empty()) {
+    return false;
+  }
+
+  if (path_set.count(binary_path) != 0U) {
+    return true;
+  }
+
+  auto prefix_it = std::find_if(
+      path_prefix_list.begin(),
+      path_prefix_list.end(),
+      [&binary_path](const std::string& prefix) -> bool {
+        return binary_path.compare(0, prefix.size(), prefix) == 0;
+      });
+
+  if (prefix_it != path_prefix_list.end()) {
+    return true;
+  }
+
+  if (name_set.empty()) {
+    return false;
+  }
+
+  auto separator = binary_path.rfind('/');
+  auto name = (separator == std::string::npos)
+                  ? binary_path
+                  : binary_path.substr(separator + 1U);
+
+  return name_set.count(name) != 0U;
+}
+
+Status BPFEventFilter::parse(BPFEventFilter& filter,
+                             const rapidjson::Value& exclude) {
+  filter = {};
+
+  if (!exclude.IsObject()) {
+    return Status::failure("The exclude entry is not an object");
+  }
+
+  BPFEventFilter new_filter;
+
+  auto status = parseIntegerList(new_filter.uid_set, exclude, "uids");
+  if (!status.ok()) {
+    return status;
+  }
+
+  status = parseIntegerList(new_filter.cgroup_id_set, exclude, "cgroup_ids");
+  if (!status.ok()) {
+    return status;
+  }
+
+  std::vector<std::string> path_list;
+  status = parseStringList(path_list, exclude, "paths");
+  if (!status.ok()) {
+    return status;
+  }
+
+  for (auto& path : path_list) {
+    if (path.back() == '%') {
+      path.pop_back();
+      new_filter.path_prefix_list.push_back(std::move(path));
+
+    } else {
+      new_filter.path_set.insert(std::move(path));
+    }
+  }
+
+  std::vector<std::string> name_list;
+  status = parseStringList(name_list, exclude, "names");
+  if (!status.ok()) {
+    return status;
+  }
+
+  new_filter.name_set.insert(name_list.begin(), name_list.end());
+
+  filter = std::move(new_filter);
+  return Status::success();
+}
+
+} // namespace osquery
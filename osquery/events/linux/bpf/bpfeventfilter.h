@@ -0,0 +1,53 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <osquery/events/linux/bpf/isystemstatetracker.h>
+#include <osquery/utils/json/json.h>
+#include <osquery/utils/status/status.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace osquery {
+
+/// \brief The events excluded by the bpf_events configuration
+/// Events are matched on the process that emitted them: its user id,
+/// its cgroup, its binary path or the file name of its binary
+struct BPFEventFilter final {
+  /// Excluded user ids
+  std::unordered_set<std::uint64_t> uid_set;
+
+  /// Excluded cgroup ids
+  std::unordered_set<std::uint64_t> cgroup_id_set;
+
+  /// Excluded binary paths
+  std::unordered_set<std::string> path_set;
+
+  /// Excluded binary path prefixes, configured as paths ending with '%'
+  std::vector<std::string> path_prefix_list;
+
+  /// Excluded binary file names
+  std::unordered_set<std::string> name_set;
+
+  /// Returns true if nothing is excluded
+  bool empty() const;
+
+  /// Returns true if the given event should not be emitted
+  bool excluded(const ISystemStateTracker::Event& event) const;
+
+  /// \brief Parses the "exclude" object of the bpf_events configuration
+  /// The filter is left empty when the configuration is not valid
+  static Status parse(BPFEventFilter& filter, const rapidjson::Value& exclude);
+};
+
+} // namespace osquery
@@ -7,16 +7,27 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <osquery/config/config.h>
 #include <osquery/core/flags.h>
 #include <osquery/events/linux/bpf/bpferrorstate.h>
+#include <osquery/events/linux/bpf/bpfeventfilter.h>
 #include <osquery/events/linux/bpf/bpfeventpublisher.h>
 #include <osquery/events/linux/bpf/serializers.h>
 #include <osquery/events/linux/bpf/setrlimit.h>
 #include <osquery/events/linux/bpf/systemstatetracker.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
+#include <osquery/utils/mutex.h>
 #include <osquery/utils/system/time.h>
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <thread>
+
 #include <fcntl.h>
 #include <sys/sysinfo.h>
 
@@ -115,18 +126,114 @@ FLAG(uint64,
      512ULL,
      "How many slots each buffer storage should have");
 
+FLAG(uint64,
+     bpf_reader_threads,
+     1ULL,
+     "Number of threads reading BPF events, each one with its own perf event "
+     "array");
+
 REGISTER(BPFEventPublisher, "event_publisher", "BPFEventPublisher");
 
-struct BPFEventPublisher::PrivateData final {
-  bool initialized{false};
+namespace {
+
+using BPFEventQueue =
+    std::multimap<std::uint64_t, ebpfpub::IFunctionTracer::Event>;
 
+/// A perf event array, drained by its own thread
+struct BPFEventReader final {
   ebpf::PerfEventArray::Ref perf_event_array;
   ebpfpub::IPerfEventReader::Ref perf_event_reader;
+  std::thread thread;
+
+  /// Protects the event queue and the error state
+  std::mutex mutex;
+
+  /// The events read and not yet processed, sorted by timestamp
+  BPFEventQueue event_queue;
+
+  /// The errors reported since the publisher last took the events
+  BPFErrorState error_state;
+};
+
+using BPFEventReaderList = std::vector<std::unique_ptr<BPFEventReader>>;
+
+void readBPFEvents(BPFEventReader& reader, const std::atomic<bool>& stop) {
+  while (!stop) {
+    reader.perf_event_reader->exec(
+        std::chrono::seconds(1U),
+
+        [&](const ebpfpub::IFunctionTracer::EventList& event_list,
+            const ebpfpub::IPerfEventReader::ErrorCounters&
+                perf_error_counters) {
+          std::lock_guard<std::mutex> lock(reader.mutex);
+          updateBpfErrorState(reader.error_state, perf_error_counters);
+
+          for (auto& event : event_list) {
+            if (event.header.probe_error) {
+              ++reader.error_state.probe_error_counter;
+            }
+
+            auto rel_timestamp = event.header.timestamp;
+            reader.event_queue.insert({rel_timestamp, std::move(event)});
+          }
+        });
+  }
+}
+
+/// Move the events older than the timestamp limit out of a reader queue
+void takeBPFEvents(std::vector<ebpfpub::IFunctionTracer::Event>& event_list,
+                   BPFErrorState& bpf_error_state,
+                   BPFEventReader& reader,
+                   std::uint64_t timestamp_limit) {
+  std::lock_guard<std::mutex> lock(reader.mutex);
+
+  updateBpfErrorState(bpf_error_state, reader.error_state.perf_error_counters);
+  bpf_error_state.probe_error_counter += reader.error_state.probe_error_counter;
+  reader.error_state = {};
+
+  auto last_event_it = reader.event_queue.lower_bound(timestamp_limit);
+  for (auto event_it = reader.event_queue.begin(); event_it != last_event_it;
+       ++event_it) {
+    event_list.push_back(std::move(event_it->second));
+  }
+
+  reader.event_queue.erase(reader.event_queue.begin(), last_event_it);
+}
+
+} // namespace
+
+struct BPFEventPublisher::PrivateData final {
+  bool initialized{false};
+
+  BPFEventReaderList reader_list;
+  std::atomic<bool> stop_readers{false};
+
   BufferStorageMap buffer_storage_map;
   EventHandlerMap event_handler_map;
 
-  std::map<std::uint64_t, ebpfpub::IFunctionTracer::Event> event_queue;
   ISystemStateTracker::Ref system_state_tracker;
+
+  Mutex event_filter_mutex;
+  std::shared_ptr<const BPFEventFilter> event_filter;
+
+  void startReaders() {
+    stop_readers = false;
+
+    for (auto& reader : reader_list) {
+      reader->thread = std::thread(
+          readBPFEvents, std::ref(*reader.get()), std::cref(stop_readers));
+    }
+  }
+
+  void stopReaders() {
+    stop_readers = true;
+
+    for (auto& reader : reader_list) {
+      if (reader->thread.joinable()) {
+        reader->thread.join();
+      }
+    }
+  }
 };
 
 Status BPFEventPublisher::setUp() {
@@ -139,29 +246,39 @@ Status BPFEventPublisher::setUp() {
     return status;
   }
 
-  auto perf_event_array_exp =
-      ebpf::PerfEventArray::create(FLAGS_bpf_perf_event_array_exp);
+  auto reader_count = std::max<std::uint64_t>(1ULL, FLAGS_bpf_reader_threads);
+  for (std::uint64_t i = 0U; i < reader_count; ++i) {
+    auto reader = std::make_unique<BPFEventReader>();
 
-  if (!perf_event_array_exp.succeeded()) {
-    const auto& error = perf_event_array_exp.error();
+    auto perf_event_array_exp =
+        ebpf::PerfEventArray::create(FLAGS_bpf_perf_event_array_exp);
 
-    return Status::failure("Failed to create the perf event array: " +
-                           error.message());
-  }
+    if (!perf_event_array_exp.succeeded()) {
+      const auto& error = perf_event_array_exp.error();
 
-  d->perf_event_array = perf_event_array_exp.takeValue();
+      return Status::failure("Failed to create the perf event array: " +
+                             error.message());
+    }
 
-  auto perf_event_reader_exp =
-      ebpfpub::IPerfEventReader::create(*d->perf_event_array.get());
+    reader->perf_event_array = perf_event_array_exp.takeValue();
 
-  if (!perf_event_reader_exp.succeeded()) {
-    const auto& error = perf_event_reader_exp.error();
+    auto perf_event_reader_exp =
+        ebpfpub::IPerfEventReader::create(*reader->perf_event_array.get());
+
+    if (!perf_event_reader_exp.succeeded()) {
+      const auto& error = perf_event_reader_exp.error();
+
+      return Status::failure("Failed to create the perf event reader: " +
+                             error.message());
+    }
 
-    return Status::failure("Failed to create the perf event reader: " +
-                           error.message());
+    reader->perf_event_reader = perf_event_reader_exp.takeValue();
+    d->reader_list.push_back(std::move(reader));
   }
 
-  d->perf_event_reader = perf_event_reader_exp.takeValue();
+  // Tracers are spread across the readers, each event is merged back by
+  // timestamp before reaching the system state tracker
+  std::size_t tracer_count{0U};
 
   for (const auto& tracer_allocator : kFunctionTracerAllocators) {
     auto buffer_storage_it =
@@ -190,6 +307,7 @@ Status BPFEventPublisher::setUp() {
     }
 
     auto& buffer_storage = *buffer_storage_it->second.get();
+    auto& reader = *d->reader_list.at(tracer_count % d->reader_list.size());
 
     tob::StringErrorOr<ebpfpub::IFunctionTracer::Ref> function_tracer_exp;
 
@@ -212,7 +330,7 @@ Status BPFEventPublisher::setUp() {
           true,
           parameter_list,
           buffer_storage,
-          *d->perf_event_array.get(),
+          *reader.perf_event_array.get(),
           kEventMapSize);
 
     } else {
@@ -221,7 +339,7 @@ Status BPFEventPublisher::setUp() {
             ebpfpub::IFunctionTracer::createFromSyscallTracepoint(
                 tracer_allocator.syscall_name,
                 buffer_storage,
-                *d->perf_event_array.get(),
+                *reader.perf_event_array.get(),
                 kEventMapSize);
 
       } else {
@@ -232,7 +350,7 @@ Status BPFEventPublisher::setUp() {
                 tracer_allocator.syscall_name,
                 parameter_list,
                 buffer_storage,
-                *d->perf_event_array.get(),
+                *reader.perf_event_array.get(),
                 kEventMapSize);
       }
     }
@@ -268,7 +386,8 @@ Status BPFEventPublisher::setUp() {
             << tracer_allocator.syscall_name << " (" << event_id << ")";
 
     d->event_handler_map[event_id] = tracer_allocator.event_handler;
-    d->perf_event_reader->insert(std::move(function_tracer));
+    reader.perf_event_reader->insert(std::move(function_tracer));
+    ++tracer_count;
   }
 
   d->system_state_tracker = SystemStateTracker::create();
@@ -284,6 +403,29 @@ void BPFEventPublisher::configure() {
   if (!FLAGS_enable_bpf_events) {
     return;
   }
+
+  auto event_filter = std::make_shared<BPFEventFilter>();
+
+  auto parser = Config::getParser("bpf_events");
+  if (parser != nullptr) {
+    const auto& doc = parser->getData().doc();
+
+    if (doc.IsObject() && doc.HasMember("bpf_events") &&
+        doc["bpf_events"].IsObject() &&
+        doc["bpf_events"].HasMember("exclude")) {
+      auto status =
+          BPFEventFilter::parse(*event_filter, doc["bpf_events"]["exclude"]);
+
+      if (!status.ok()) {
+        LOG(ERROR) << "The bpf_events exclusions are not valid and will be "
+                      "ignored: "
+                   << status.getMessage();
+      }
+    }
+  }
+
+  WriteLock lock(d->event_filter_mutex);
+  d->event_filter = std::move(event_filter);
 }
 
 void BPFEventPublisher::tearDown() {
@@ -291,13 +433,12 @@ void BPFEventPublisher::tearDown() {
     return;
   }
 
-  d->perf_event_array.reset();
-  d->perf_event_reader.reset();
+  d->stopReaders();
+  d->reader_list.clear();
   d->system_state_tracker.reset();
 
   d->buffer_storage_map.clear();
   d->event_handler_map.clear();
-  d->event_queue.clear();
 
   d->initialized = false;
 }
@@ -317,6 +458,8 @@ Status BPFEventPublisher::run() {
   auto last_error_report = getUnixTime();
   auto last_tracker_restart = getUnixTime();
 
+  d->startReaders();
+
   while (!isEnding()) {
     auto current_time = getUnixTime();
     if (last_tracker_restart + (FLAGS_bpf_state_tracker_reset_time * 60) <
@@ -334,23 +477,26 @@ Status BPFEventPublisher::run() {
       last_tracker_restart = current_time;
     }
 
-    d->perf_event_reader->exec(
-        std::chrono::seconds(1U),
+    std::this_thread::sleep_for(std::chrono::seconds(1U));
 
-        [&](const ebpfpub::IFunctionTracer::EventList& event_list,
-            const ebpfpub::IPerfEventReader::ErrorCounters&
-                perf_error_counters) {
-          updateBpfErrorState(bpf_error_state, perf_error_counters);
+    // Events are held for 5 seconds, so that the events of every reader
+    // from the same time are available to the merge
+    struct sysinfo system_info {};
+    sysinfo(&system_info);
 
-          for (auto& event : event_list) {
-            if (event.header.probe_error) {
-              ++bpf_error_state.probe_error_counter;
-            }
+    std::uint64_t timestamp_limit{0U};
+    if (system_info.uptime > 4) {
+      timestamp_limit =
+          static_cast<std::uint64_t>(system_info.uptime - 4) * 1000000000ULL;
+    }
 
-            auto rel_timestamp = event.header.timestamp;
-            d->event_queue.insert({rel_timestamp, std::move(event)});
-          }
-        });
+    std::vector<std::vector<ebpfpub::IFunctionTracer::Event>> event_lists(
+        d->reader_list.size());
+
+    for (std::size_t i = 0U; i < d->reader_list.size(); ++i) {
+      takeBPFEvents(
+          event_lists[i], bpf_error_state, *d->reader_list[i], timestamp_limit);
+    }
 
     current_time = getUnixTime();
     if (last_error_report + 5U < current_time) {
@@ -360,20 +506,7 @@ Status BPFEventPublisher::run() {
 
     auto& state = *d->system_state_tracker.get();
 
-    struct sysinfo system_info {};
-    sysinfo(&system_info);
-
-    for (auto event_it = d->event_queue.begin();
-         event_it != d->event_queue.end();) {
-      const auto& rel_timestamp = event_it->first / 1000000000ULL;
-      if (system_info.uptime - rel_timestamp < 5ULL) {
-        ++event_it;
-        continue;
-      }
-
-      auto event = std::move(event_it->second);
-      event_it = d->event_queue.erase(event_it);
-
+    for (auto& event : mergeEvents(std::move(event_lists))) {
       auto event_handler_it = d->event_handler_map.find(event.identifier);
       if (event_handler_it == d->event_handler_map.end()) {
         LOG(ERROR) << "Unhandled event received in BPFEventPublisher: "
@@ -388,6 +521,26 @@ Status BPFEventPublisher::run() {
     }
 
     auto event_list = state.eventList();
+
+    std::shared_ptr<const BPFEventFilter> event_filter;
+
+    {
+      ReadLock lock(d->event_filter_mutex);
+      event_filter = d->event_filter;
+    }
+
+    // The state tracker still sees every event, so that the process
+    // contexts stay correct for the processes that are not excluded
+    if (event_filter && !event_filter->empty()) {
+      event_list.erase(
+          std::remove_if(event_list.begin(),
+                         event_list.end(),
+                         [&event_filter](const ISystemStateTracker::Event& e) {
+                           return event_filter->excluded(e);
+                         }),
+          event_list.end());
+    }
+
     if (!event_list.empty()) {
       auto event_context = createEventContext();
       event_context->event_list = std::move(event_list);
@@ -396,6 +549,7 @@ Status BPFEventPublisher::run() {
     }
   }
 
+  d->stopReaders();
   return Status::success();
 }
 
@@ -405,6 +559,50 @@ BPFEventPublisher::~BPFEventPublisher() {
   tearDown();
 }
 
+std::vector<ebpfpub::IFunctionTracer::Event> BPFEventPublisher::mergeEvents(
+    std::vector<std::vector<ebpfpub::IFunctionTracer::Event>> event_lists) {
+  if (event_lists.size() == 1U) {
+    return std::move(event_lists.front());
+  }
+
+  std::size_t event_count{0U};
+  for (const auto& event_list : event_lists) {
+    event_count += event_list.size();
+  }
+
+  std::vector<ebpfpub::IFunctionTracer::Event> merged_event_list;
+  merged_event_list.reserve(event_count);
+
+  // The next timestamp of each list, and the list index; readers with a
+  // lower index win ties, keeping the merge stable
+  using MergeHead = std::pair<std::uint64_t, std::size_t>;
+  std::priority_queue<MergeHead, std::vector<MergeHead>, std::greater<>>
+      merge_heads;
+
+  std::vector<std::size_t> positions(event_lists.size(), 0U);
+  for (std::size_t i = 0U; i < event_lists.size(); ++i) {
+    if (!event_lists[i].empty()) {
+      merge_heads.push({event_lists[i].front().header.timestamp, i});
+    }
+  }
+
+  while (!merge_heads.empty()) {
+    auto list_index = merge_heads.top().second;
+    merge_heads.pop();
+
+    auto& event_list = event_lists[list_index];
+    auto& position = positions[list_index];
+    merged_event_list.push_back(std::move(event_list[position]));
+
+    ++position;
+    if (position < event_list.size()) {
+      merge_heads.push({event_list[position].header.timestamp, list_index});
+    }
+  }
+
+  return merged_event_list;
+}
+
 bool BPFEventPublisher::processForkEvent(
     ISystemStateTracker& state, const ebpfpub::IFunctionTracer::Event& event) {
   auto child_process_id = static_cast<pid_t>(event.header.exit_code);
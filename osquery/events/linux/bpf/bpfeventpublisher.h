@@ -64,6 +64,12 @@ class BPFEventPublisher final : public EventPublisher<BPFEventSC, BPFEventEC> {
     return true;
   }
 
+  /// Merge the sorted event lists of the readers, by timestamp. Events with
+  /// the same timestamp are all kept, in reader order.
+  static std::vector<tob::ebpfpub::IFunctionTracer::Event> mergeEvents(
+      std::vector<std::vector<tob::ebpfpub::IFunctionTracer::Event>>
+          event_lists);
+
   static bool processForkEvent(
       ISystemStateTracker& state,
       const tob::ebpfpub::IFunctionTracer::Event& event);
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -60,6 +61,97 @@ struct ProcessContext final {
 
   using FileDescriptorMap = std::unordered_map<int, FileDescriptor>;
 
+  /// \brief A file descriptor map that is shared until it is modified
+  /// Forking copies the whole process context, and most children either
+  /// exit or exec before touching their file descriptors. Copies share the
+  /// same map, and the non-const methods make a private copy first if the
+  /// map is shared. Use a const reference for lookups that do not modify
+  /// the map.
+  class FileDescriptorTable final {
+   public:
+    using iterator = FileDescriptorMap::iterator;
+    using const_iterator = FileDescriptorMap::const_iterator;
+    using value_type = FileDescriptorMap::value_type;
+
+    FileDescriptorTable() : map_(std::make_shared<FileDescriptorMap>()) {}
+
+    // Moving copies the reference too, so moved-from tables stay usable
+    FileDescriptorTable(const FileDescriptorTable&) = default;
+    FileDescriptorTable& operator=(const FileDescriptorTable&) = default;
+
+    const_iterator find(int fd) const {
+      return map_->find(fd);
+    }
+
+    const_iterator begin() const {
+      return map_->begin();
+    }
+
+    const_iterator end() const {
+      return map_->end();
+    }
+
+    const FileDescriptor& at(int fd) const {
+      return map_->at(fd);
+    }
+
+    std::size_t count(int fd) const {
+      return map_->count(fd);
+    }
+
+    std::size_t size() const {
+      return map_->size();
+    }
+
+    bool empty() const {
+      return map_->empty();
+    }
+
+    /// True if other copies of the table share the same map
+    bool shared() const {
+      return map_.use_count() > 1;
+    }
+
+    iterator find(int fd) {
+      return mutableMap().find(fd);
+    }
+
+    iterator begin() {
+      return mutableMap().begin();
+    }
+
+    iterator end() {
+      return mutableMap().end();
+    }
+
+    FileDescriptor& at(int fd) {
+      return mutableMap().at(fd);
+    }
+
+    std::pair<iterator, bool> insert(value_type value) {
+      return mutableMap().insert(std::move(value));
+    }
+
+    iterator erase(iterator it) {
+      return mutableMap().erase(it);
+    }
+
+    std::size_t erase(int fd) {
+      return mutableMap().erase(fd);
+    }
+
+   private:
+    FileDescriptorMap& mutableMap() {
+      if (map_.use_count() > 1) {
+        map_ = std::make_shared<FileDescriptorMap>(*map_);
+      }
+
+      return *map_;
+    }
+
+    std::shared_ptr<FileDescriptorMap> map_;
+  };
+
   /// Parent process id
   pid_t parent_process_id{};
 
@@ -73,7 +165,7 @@ struct ProcessContext final {
   std::string cwd;
 
   /// File descriptor map, automatically inherited when forking
-  FileDescriptorMap fd_map;
+  FileDescriptorTable fd_map;
 };
 
 using ProcessContextMap = std::unordered_map<pid_t, ProcessContext>;
@@ -98,6 +190,10 @@ class IProcessContextFactory {
   /// Creates a system snapshot, using captureSingleProcess on all processes
   virtual bool captureAllProcesses(ProcessContextMap& process_map) const = 0;
 
+  /// Lists the process ids found in procfs, without capturing them
+  virtual bool enumerateProcesses(
+      std::vector<pid_t>& process_id_list) const = 0;
+
   IProcessContextFactory() = default;
   virtual ~IProcessContextFactory() = default;
 
@@ -12,6 +12,8 @@
 #include <ebpfpub/ifunctiontracer.h>
 #include <ebpfpub/iperfeventreader.h>
 
+#include <osquery/utils/status/status.h>
+
 #include <cstdint>
 #include <string>
 #include <variant>
@@ -39,6 +39,11 @@ bool ProcessContextFactory::captureAllProcesses(
   return captureAllProcesses(*fs.get(), process_map);
 }
 
+bool ProcessContextFactory::enumerateProcesses(
+    std::vector<pid_t>& process_id_list) const {
+  return enumerateProcesses(*fs.get(), process_id_list);
+}
+
 ProcessContextFactory::ProcessContextFactory(
     IFilesystem::Ref filesystem_interface) {
   fs = std::move(filesystem_interface);
@@ -159,12 +164,32 @@ bool ProcessContextFactory::captureAllProcesses(
     IFilesystem& fs, ProcessContextMap& process_map) {
   process_map = {};
 
+  std::vector<pid_t> process_id_list;
+  auto succeeded = enumerateProcesses(fs, process_id_list);
+
+  ProcessContextMap output;
+
+  for (auto pid : process_id_list) {
+    ProcessContext process_context = {};
+    if (captureSingleProcess(fs, process_context, pid)) {
+      output.insert({pid, std::move(process_context)});
+    }
+  }
+
+  process_map = std::move(output);
+  return succeeded;
+}
+
+bool ProcessContextFactory::enumerateProcesses(
+    IFilesystem& fs, std::vector<pid_t>& process_id_list) {
+  process_id_list = {};
+
   tob::utils::UniqueFd process_root;
   if (!fs.open(process_root, kProcFsRoot, O_DIRECTORY)) {
     return false;
   }
 
-  ProcessContextMap output;
+  std::vector<pid_t> output;
 
   // clang-format off
   auto succeeded = fs.enumFiles(
@@ -180,18 +205,12 @@ bool ProcessContextFactory::captureAllProcesses(
         return;
       }
 
-      auto pid = pid_exp.take();
-
-      ProcessContext process_context = {};
-      if (captureSingleProcess(fs, process_context, pid)) {
-        output.insert({pid, std::move(process_context)});
-      } else {
-      }
+      output.push_back(static_cast<pid_t>(pid_exp.take()));
     }
   );
   // clang-format on
 
-  process_map = std::move(output);
+  process_id_list = std::move(output);
   return succeeded;
 }
 
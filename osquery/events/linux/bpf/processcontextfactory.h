@@ -23,6 +23,9 @@ class ProcessContextFactory final : public IProcessContextFactory {
   virtual bool captureAllProcesses(
       ProcessContextMap& process_map) const override;
 
+  virtual bool enumerateProcesses(
+      std::vector<pid_t>& process_id_list) const override;
+
  private:
   IFilesystem::Ref fs;
 
@@ -36,6 +39,9 @@ class ProcessContextFactory final : public IProcessContextFactory {
   static bool captureAllProcesses(IFilesystem& fs,
                                   ProcessContextMap& process_map);
 
+  static bool enumerateProcesses(IFilesystem& fs,
+                                 std::vector<pid_t>& process_id_list);
+
   static bool getArgvFromCmdlineFile(IFilesystem& fs,
                                      std::vector<std::string>& argv,
                                      int fd);
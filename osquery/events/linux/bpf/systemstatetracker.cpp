@@ -7,12 +7,14 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 
 #include <osquery/events/linux/bpf/systemstatetracker.h>
 #include <osquery/logger/logger.h>
+#include <osquery/numeric_monitoring/numeric_monitoring.h>
 #include <osquery/utils/status/status.h>
 #include <osquery/utils/system/time.h>
 
@@ -29,13 +31,56 @@ namespace {
 const std::size_t kMaxFileHandleEntryCount{512U};
 const std::uint64_t kExpirationTime{180U};
 const std::size_t kEventsBeforeExpiration{10000U};
+
+// Expire the contexts of exited processes early past this many contexts
+const std::size_t kMaxProcessContextCount{16384U};
+
+// How many procfs processes are captured on each restart() and eventList()
+// call; the other ones are captured when they are first referenced
+const std::size_t kProcessCaptureBatchSize{256U};
+
+void recordStateTrackerSize(const SystemStateTracker::Context& context,
+                            std::size_t expired_process_count) {
+  std::size_t fd_count{0U};
+  std::size_t shared_fd_table_count{0U};
+  for (const auto& process_map_entry : context.process_map) {
+    const auto& fd_map = process_map_entry.second.fd_map;
+    fd_count += fd_map.size();
+    if (fd_map.shared()) {
+      ++shared_fd_table_count;
+    }
+  }
+
+  auto max = monitoring::PreAggregationType::Max;
+  monitoring::record(
+      "bpf.state_tracker.process_contexts",
+      static_cast<monitoring::ValueType>(context.process_map.size()),
+      max);
+  monitoring::record("bpf.state_tracker.file_descriptors",
+                     static_cast<monitoring::ValueType>(fd_count),
+                     max);
+  monitoring::record("bpf.state_tracker.shared_fd_tables",
+                     static_cast<monitoring::ValueType>(shared_fd_table_count),
+                     max);
+  monitoring::record(
+      "bpf.state_tracker.file_handles",
+      static_cast<monitoring::ValueType>(context.file_handle_struct_map.size()),
+      max);
+  monitoring::record("bpf.state_tracker.expired_process_contexts",
+                     static_cast<monitoring::ValueType>(expired_process_count),
+                     monitoring::PreAggregationType::Sum);
 }
+} // namespace
 
 struct SystemStateTracker::PrivateData final {
   Context context;
   IProcessContextFactory::Ref process_context_factory;
   std::uint64_t last_expiration{};
   std::size_t event_count_since_expiration{};
+
+  // The contexts left by the last expiration, to avoid scanning procfs
+  // again while most of the processes are still alive
+  std::size_t process_count_after_expiration{};
 };
 
 SystemStateTracker::Ref SystemStateTracker::create() {
@@ -66,11 +111,24 @@ SystemStateTracker::Ref SystemStateTracker::create(
 SystemStateTracker::~SystemStateTracker() {}
 
 Status SystemStateTracker::restart() {
-  if (!d->process_context_factory->captureAllProcesses(
-          d->context.process_map)) {
+  std::vector<pid_t> process_id_list;
+  if (!d->process_context_factory->enumerateProcesses(process_id_list)) {
     return Status::failure("Failed to scan the procfs folder");
   }
 
+  // Reading the file descriptors of every process can take a long time,
+  // start from the oldest processes and capture the rest in batches
+  std::sort(process_id_list.begin(),
+            process_id_list.end(),
+            std::greater<pid_t>());
+
+  d->context.process_map = {};
+  d->context.pending_process_id_list = std::move(process_id_list);
+
+  capturePendingProcesses(d->context,
+                          *d->process_context_factory.get(),
+                          kProcessCaptureBatchSize);
+
   return Status::success();
 }
 
@@ -242,9 +300,14 @@ SystemStateTracker::EventList SystemStateTracker::eventList() {
 
   d->event_count_since_expiration += event_list.size();
 
+  auto process_count = d->context.process_map.size();
+  auto max_process_count = std::max(kMaxProcessContextCount,
+                                    d->process_count_after_expiration * 2U);
+
   auto current_time = getUnixTime();
   if (d->last_expiration + kExpirationTime < current_time ||
-      d->event_count_since_expiration >= kEventsBeforeExpiration) {
+      d->event_count_since_expiration >= kEventsBeforeExpiration ||
+      process_count >= max_process_count) {
     IFilesystem::Ref fs;
     auto status = IFilesystem::create(fs);
     if (status.ok()) {
@@ -261,6 +324,16 @@ SystemStateTracker::EventList SystemStateTracker::eventList() {
 
     d->last_expiration = current_time;
     d->event_count_since_expiration = 0;
+    d->process_count_after_expiration = d->context.process_map.size();
+
+    recordStateTrackerSize(
+        d->context, process_count - d->process_count_after_expiration);
+  }
+
+  if (!d->context.pending_process_id_list.empty()) {
+    capturePendingProcesses(d->context,
+                            *d->process_context_factory.get(),
+                            kProcessCaptureBatchSize);
   }
 
   return event_list;
@@ -336,6 +409,34 @@ Status SystemStateTracker::expireProcessContexts(Context& context,
   return Status::success();
 }
 
+std::size_t SystemStateTracker::capturePendingProcesses(
+    Context& context,
+    IProcessContextFactory& process_context_factory,
+    std::size_t max_count) {
+  std::size_t capture_count{0U};
+
+  auto& pending_process_id_list = context.pending_process_id_list;
+  while (capture_count < max_count && !pending_process_id_list.empty()) {
+    auto process_id = pending_process_id_list.back();
+    pending_process_id_list.pop_back();
+
+    // Processes referenced by an event have already been captured
+    if (context.process_map.count(process_id) != 0U) {
+      continue;
+    }
+
+    ++capture_count;
+
+    ProcessContext process_context;
+    if (process_context_factory.captureSingleProcess(process_context,
+                                                     process_id)) {
+      context.process_map.insert({process_id, std::move(process_context)});
+    }
+  }
+
+  return capture_count;
+}
+
 bool SystemStateTracker::createProcess(
     Context& context,
     IProcessContextFactory& process_context_factory,
@@ -379,6 +480,9 @@ bool SystemStateTracker::executeBinary(
   auto& process_context =
       getProcessContext(context, process_context_factory, process_id);
 
+  // Lookups go through a const reference, to keep a shared table shared
+  const auto& fd_map = process_context.fd_map;
+
   auto execute_dirfd = (flags & AT_EMPTY_PATH) != 0;
   auto execute_path = !binary_path.empty();
 
@@ -389,8 +493,8 @@ bool SystemStateTracker::executeBinary(
   if (binary_path.empty()) {
     std::string root_path;
 
-    auto fd_info_it = process_context.fd_map.find(dirfd);
-    if (fd_info_it == process_context.fd_map.end()) {
+    auto fd_info_it = fd_map.find(dirfd);
+    if (fd_info_it == fd_map.end()) {
       return false;
     }
 
@@ -414,8 +518,8 @@ bool SystemStateTracker::executeBinary(
   } else {
     std::string root_path;
 
-    auto fd_info_it = process_context.fd_map.find(dirfd);
-    if (fd_info_it == process_context.fd_map.end()) {
+    auto fd_info_it = fd_map.find(dirfd);
+    if (fd_info_it == fd_map.end()) {
       return false;
     }
 
@@ -434,13 +538,20 @@ bool SystemStateTracker::executeBinary(
 
   process_context.argv = argv;
 
-  for (auto fd_it = process_context.fd_map.begin();
-       fd_it != process_context.fd_map.end();) {
-    const auto& fd_info = fd_it->second;
-    if (fd_info.close_on_exec) {
-      fd_it = process_context.fd_map.erase(fd_it);
-    } else {
-      ++fd_it;
+  auto close_on_exec = std::any_of(
+      fd_map.begin(), fd_map.end(), [](const auto& fd_map_entry) {
+        return fd_map_entry.second.close_on_exec;
+      });
+
+  if (close_on_exec) {
+    for (auto fd_it = process_context.fd_map.begin();
+         fd_it != process_context.fd_map.end();) {
+      const auto& fd_info = fd_it->second;
+      if (fd_info.close_on_exec) {
+        fd_it = process_context.fd_map.erase(fd_it);
+      } else {
+        ++fd_it;
+      }
     }
   }
 
@@ -467,8 +578,9 @@ bool SystemStateTracker::setWorkingDirectory(
   auto& process_context =
       getProcessContext(context, process_context_factory, process_id);
 
-  auto fd_info_it = process_context.fd_map.find(dirfd);
-  if (fd_info_it == process_context.fd_map.end()) {
+  const auto& fd_map = process_context.fd_map;
+  auto fd_info_it = fd_map.find(dirfd);
+  if (fd_info_it == fd_map.end()) {
     return false;
   }
 
@@ -536,8 +648,9 @@ bool SystemStateTracker::openFile(
     absolute_path += path;
 
   } else {
-    auto fd_info_it = process_context.fd_map.find(dirfd);
-    if (fd_info_it == process_context.fd_map.end()) {
+    const auto& fd_map = process_context.fd_map;
+    auto fd_info_it = fd_map.find(dirfd);
+    if (fd_info_it == fd_map.end()) {
       return false;
     }
 
@@ -583,8 +696,9 @@ bool SystemStateTracker::duplicateHandle(Context& context,
   }
 
   auto& process_context = process_context_it->second;
-  auto fd_info_it = process_context.fd_map.find(oldfd);
-  if (fd_info_it == process_context.fd_map.end()) {
+  const auto& fd_map = process_context.fd_map;
+  auto fd_info_it = fd_map.find(oldfd);
+  if (fd_info_it == fd_map.end()) {
     return false;
   }
 
@@ -607,12 +721,12 @@ bool SystemStateTracker::closeHandle(
   auto& process_context =
       getProcessContext(context, process_context_factory, process_id);
 
-  auto fd_info_it = process_context.fd_map.find(fd);
-  if (fd_info_it == process_context.fd_map.end()) {
+  const auto& fd_map = process_context.fd_map;
+  if (fd_map.find(fd) == fd_map.end()) {
     return false;
   }
 
-  process_context.fd_map.erase(fd_info_it);
+  process_context.fd_map.erase(fd);
   return true;
 }
 
@@ -733,13 +847,14 @@ bool SystemStateTracker::listen(
   auto& process_context =
       getProcessContext(context, process_context_factory, process_id);
 
-  auto fd_info_it = process_context.fd_map.find(fd);
-  if (fd_info_it != process_context.fd_map.end()) {
-    auto& fd_info = fd_info_it->second;
+  const auto& fd_map = process_context.fd_map;
+  auto fd_info_it = fd_map.find(fd);
+  if (fd_info_it != fd_map.end()) {
+    const auto& fd_info = fd_info_it->second;
 
     if (std::holds_alternative<ProcessContext::FileDescriptor::SocketData>(
             fd_info.data)) {
-      auto& socket_address =
+      const auto& socket_address =
           std::get<ProcessContext::FileDescriptor::SocketData>(fd_info.data);
 
       if (socket_address.opt_domain.has_value()) {
@@ -979,6 +1094,7 @@ bool SystemStateTracker::openByHandleAt(
   auto& process_context =
       getProcessContext(context, process_context_factory, process_id);
 
+  const auto& fd_map = process_context.fd_map;
   std::string absolute_path;
 
   if (!file_handle.name.empty()) {
@@ -992,8 +1108,8 @@ bool SystemStateTracker::openByHandleAt(
         base_path = process_context.cwd;
 
       } else {
-        auto fd_info_it = process_context.fd_map.find(file_handle.dfd);
-        if (fd_info_it == process_context.fd_map.end()) {
+        auto fd_info_it = fd_map.find(file_handle.dfd);
+        if (fd_info_it == fd_map.end()) {
           return false;
         }
 
@@ -1013,8 +1129,8 @@ bool SystemStateTracker::openByHandleAt(
     }
 
   } else if ((file_handle.flags & AT_EMPTY_PATH) != 0) {
-    auto fd_info_it = process_context.fd_map.find(file_handle.dfd);
-    if (fd_info_it == process_context.fd_map.end()) {
+    auto fd_info_it = fd_map.find(file_handle.dfd);
+    if (fd_info_it == fd_map.end()) {
       return false;
     }
 
@@ -125,6 +125,10 @@ class SystemStateTracker final : public ISystemStateTracker {
     ProcessContextMap process_map;
     EventList event_list;
 
+    /// Processes found in procfs that have not been captured yet, sorted
+    /// from the highest pid to the lowest
+    std::vector<pid_t> pending_process_id_list;
+
     std::vector<std::string> file_handle_struct_index;
     FileHandleStructMap file_handle_struct_map;
   };
@@ -136,6 +140,11 @@ class SystemStateTracker final : public ISystemStateTracker {
 
   static Status expireProcessContexts(Context& context, IFilesystem& fs);
 
+  static std::size_t capturePendingProcesses(
+      Context& context,
+      IProcessContextFactory& process_context_factory,
+      std::size_t max_count);
+
   static bool createProcess(
       Context& context,
       IProcessContextFactory& process_context_factory,
@@ -0,0 +1,480 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <poll.h>
+#include <sys/fanotify.h>
+#include <sys/statfs.h>
+#include <unistd.h>
+
+#include <boost/filesystem.hpp>
+
+#include <osquery/config/config.h>
+#include <osquery/core/flags.h>
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/logger/logger.h>
+#include <osquery/registry/registry_factory.h>
+
+#include "osquery/events/linux/fanotify.h"
+
+// Older kernel headers do not define the directory entry reporting.
+#ifndef FAN_MARK_FILESYSTEM
+#define FAN_MARK_FILESYSTEM 0x00000100
+#endif
+
+#ifndef FAN_REPORT_DFID_NAME
+#define FAN_REPORT_DFID_NAME (0x00000400 | 0x00000800)
+#endif
+
+#ifndef FAN_ATTRIB
+#define FAN_ATTRIB 0x00000004
+#define FAN_MOVED_FROM 0x00000040
+#define FAN_MOVED_TO 0x00000080
+#define FAN_CREATE 0x00000100
+#define FAN_DELETE 0x00000200
+#endif
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+DECLARE_bool(enable_file_events);
+
+FLAG(bool,
+     enable_fanotify_events,
+     false,
+     "Use fanotify filesystem marks instead of inotify watches for "
+     "file_events (Linux 5.9 and newer)");
+
+namespace {
+
+const std::size_t kFanotifyBufferSize{64 * 1024};
+
+/// The directory entry info reported with FAN_REPORT_DFID_NAME.
+const std::uint8_t kEventInfoTypeDfidName{2};
+
+/// fanotify uses the inotify bits for the events both support.
+const std::uint64_t kFanotifyEventMask =
+    FAN_ACCESS | FAN_MODIFY | FAN_ATTRIB | FAN_CLOSE_WRITE | FAN_OPEN |
+    FAN_MOVED_FROM | FAN_MOVED_TO | FAN_CREATE | FAN_DELETE;
+
+static_assert(FAN_MODIFY == IN_MODIFY && FAN_ATTRIB == IN_ATTRIB &&
+                  FAN_CLOSE_WRITE == IN_CLOSE_WRITE &&
+                  FAN_CREATE == IN_CREATE && FAN_DELETE == IN_DELETE &&
+                  FAN_MOVED_TO == IN_MOVED_TO,
+              "fanotify and inotify event bits differ");
+
+/// The layout of struct fanotify_event_info_header.
+struct EventInfoHeader final {
+  std::uint8_t info_type;
+  std::uint8_t pad;
+  std::uint16_t len;
+};
+
+/// The fsid follows the header, then a struct file_handle and the name.
+const std::size_t kEventInfoFsidSize{2 * sizeof(int)};
+
+} // namespace
+
+REGISTER(FanotifyEventPublisher, "event_publisher", "fanotify");
+
+Status FanotifyEventPublisher::setUp() {
+  if (!FLAGS_enable_file_events || !FLAGS_enable_fanotify_events) {
+    return Status(1, "Publisher disabled via configuration");
+  }
+
+  auto handle = ::fanotify_init(
+      FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK | FAN_REPORT_DFID_NAME,
+      O_RDONLY | O_LARGEFILE);
+
+  if (handle == -1) {
+    return Status::failure(
+        "Could not start fanotify: fanotify_init failed with errno " +
+        std::to_string(errno) + ", Linux 5.9 and CAP_SYS_ADMIN are required");
+  }
+
+  fanotify_handle_ = handle;
+  scratch_.resize(kFanotifyBufferSize);
+  return Status::success();
+}
+
+void FanotifyEventPublisher::configure() {
+  if (!FLAGS_enable_file_events || !FLAGS_enable_fanotify_events) {
+    return;
+  }
+
+  if (fanotify_handle_ == -1) {
+    // This publisher has not been setup correctly.
+    return;
+  }
+
+  buildExcludePathsSet();
+
+  // The union of the masks of the subscriptions on each mark path.
+  std::map<std::string, std::uint64_t> mark_masks;
+  {
+    WriteLock lock(subscription_lock_);
+    for (auto& sub : subscriptions_) {
+      auto sc = getSubscriptionContext(sub->context);
+      if (sc->path.find('*') == std::string::npos &&
+          isDirectory(sc->path).ok() && sc->path.back() != '/') {
+        sc->path += '/';
+      }
+
+      auto mask = (sc->mask == 0) ? kFileDefaultMasks : sc->mask;
+      mark_masks[getMarkPath(sc->path)] |= (mask & kFanotifyEventMask);
+    }
+  }
+
+  // The marks cover whole filesystems, they are rebuilt on each change.
+  removeMarks();
+
+  for (const auto& mark : mark_masks) {
+    auto status = markFilesystem(mark.first, mark.second | FAN_ONDIR);
+    if (!status.ok()) {
+      LOG(WARNING) << "Could not add a fanotify mark on: " << mark.first
+                   << ": " << status.getMessage();
+    }
+  }
+}
+
+void FanotifyEventPublisher::tearDown() {
+  if (fanotify_handle_ == -1) {
+    return;
+  }
+
+  removeMarks();
+
+  ::close(fanotify_handle_);
+  fanotify_handle_ = -1;
+}
+
+Status FanotifyEventPublisher::run() {
+  if (!FLAGS_enable_file_events || !FLAGS_enable_fanotify_events) {
+    return Status(1, "Publisher disabled via configuration");
+  }
+
+  struct pollfd fds[1];
+  fds[0].fd = fanotify_handle_;
+  fds[0].events = POLLIN;
+  int selector = ::poll(fds, 1, 1000);
+  if (selector == -1) {
+    if (errno == EINTR) {
+      return Status::success();
+    }
+    LOG(WARNING) << "Could not read fanotify handle";
+    return Status(1, "fanotify poll failed");
+  }
+
+  if (selector == 0 || !(fds[0].revents & POLLIN)) {
+    return Status::success();
+  }
+
+  auto buffer_size =
+      ::read(fanotify_handle_, scratch_.data(), scratch_.size());
+  if (buffer_size == -1) {
+    if (errno == EAGAIN || errno == EINTR) {
+      return Status::success();
+    }
+    return Status(1, "fanotify read failed");
+  }
+
+  // Events read together are fired together, subscribers may store them as
+  // one batch.
+  EventContextList batch;
+  auto self = ::getpid();
+
+  auto metadata =
+      reinterpret_cast<const struct fanotify_event_metadata*>(scratch_.data());
+  for (auto length = buffer_size; FAN_EVENT_OK(metadata, length);
+       metadata = FAN_EVENT_NEXT(metadata, length)) {
+    if (metadata->vers != FANOTIFY_METADATA_VERSION) {
+      return Status(1, "Unsupported fanotify metadata version");
+    }
+
+    // Directory entry reporting does not open files, this is a safeguard.
+    if (metadata->fd >= 0) {
+      ::close(metadata->fd);
+    }
+
+    if (metadata->mask & FAN_Q_OVERFLOW) {
+      // The kernel does not report how many events were lost.
+      recordDroppedEvents(1);
+      continue;
+    }
+
+    // Hashing the changed files would otherwise report accesses.
+    if (metadata->pid == self) {
+      continue;
+    }
+
+    auto ec = createEventContextFrom(metadata);
+    if (ec != nullptr) {
+      batch.push_back(ec);
+    }
+  }
+  fire(batch);
+
+  return Status::success();
+}
+
+bool FanotifyEventPublisher::matchesPath(const std::string& pattern,
+                                         const std::string& path) {
+  auto recursive_pos = pattern.find("**");
+  if (recursive_pos != std::string::npos) {
+    auto prefix = pattern.substr(0, recursive_pos);
+    if (prefix.size() > 1 && prefix.back() == '/') {
+      prefix.pop_back();
+    }
+
+    return ::fnmatch(prefix.c_str(),
+                     path.c_str(),
+                     FNM_PATHNAME | FNM_LEADING_DIR) == 0;
+  }
+
+  if (!pattern.empty() && pattern.back() == '/') {
+    // A directory matches itself and the files it holds.
+    auto files = pattern + '*';
+    auto directory = pattern.substr(0, pattern.size() - 1);
+
+    return ::fnmatch(files.c_str(), path.c_str(), FNM_PATHNAME) == 0 ||
+           ::fnmatch(directory.c_str(), path.c_str(), FNM_PATHNAME) == 0;
+  }
+
+  return ::fnmatch(pattern.c_str(), path.c_str(), FNM_PATHNAME) == 0;
+}
+
+std::string FanotifyEventPublisher::getMarkPath(const std::string& pattern) {
+  auto prefix = pattern.substr(0, pattern.find('*'));
+  prefix = prefix.substr(0, prefix.rfind('/') + 1);
+
+  // Missing directories are still covered by their filesystem.
+  auto directory = fs::path(prefix.empty() ? "/" : prefix);
+  while (!isDirectory(directory).ok() && directory.has_parent_path() &&
+         directory != directory.root_path()) {
+    directory = directory.parent_path();
+  }
+
+  return directory.string();
+}
+
+bool FanotifyEventPublisher::shouldFire(
+    const INotifySubscriptionContextRef& sc,
+    const INotifyEventContextRef& ec) const {
+  // The subscription may supply a required event mask.
+  if (sc->mask != 0 && !(ec->event->mask & sc->mask)) {
+    return false;
+  }
+
+  if (!matchesPath(sc->path, ec->path)) {
+    return false;
+  }
+
+  // exclude paths should be applied at last
+  auto path = ec->path.substr(0, ec->path.rfind('/'));
+  if (!exclude_paths_.empty() &&
+      (exclude_paths_.find(path) || exclude_paths_.find(ec->path))) {
+    return false;
+  }
+
+  return true;
+}
+
+INotifyEventContextRef FanotifyEventPublisher::createEventContextFrom(
+    const struct fanotify_event_metadata* metadata) const {
+  auto ec = createEventContext();
+  if (!getEventPath(ec->path, metadata)) {
+    return nullptr;
+  }
+
+  // Subscribers read the inotify event, the common bits are identical.
+  ec->event = std::make_unique<struct inotify_event>();
+  std::memset(ec->event.get(), 0, sizeof(struct inotify_event));
+  ec->event->wd = -1;
+  ec->event->mask = static_cast<std::uint32_t>(metadata->mask &
+                                               kFanotifyEventMask);
+
+  for (const auto& action : kMaskActions) {
+    if (ec->event->mask & action.first) {
+      ec->action = action.second;
+      break;
+    }
+  }
+
+  if (ec->action.empty()) {
+    return nullptr;
+  }
+  return ec;
+}
+
+bool FanotifyEventPublisher::getEventPath(
+    std::string& path, const struct fanotify_event_metadata* metadata) const {
+  auto event = reinterpret_cast<const char*>(metadata);
+  std::size_t offset = metadata->metadata_len;
+
+  while (offset + sizeof(EventInfoHeader) <= metadata->event_len) {
+    EventInfoHeader header;
+    std::memcpy(&header, event + offset, sizeof(header));
+    if (header.len < sizeof(header) ||
+        offset + header.len > metadata->event_len) {
+      return false;
+    }
+
+    auto info = event + offset;
+    auto info_end = info + header.len;
+    offset += header.len;
+
+    if (header.info_type != kEventInfoTypeDfidName) {
+      continue;
+    }
+
+    auto handle_start = info + sizeof(header) + kEventInfoFsidSize;
+    if (handle_start + sizeof(struct file_handle) > info_end) {
+      return false;
+    }
+
+    int fsid[2];
+    std::memcpy(fsid, info + sizeof(header), sizeof(fsid));
+
+    struct file_handle handle_header;
+    std::memcpy(&handle_header, handle_start, sizeof(handle_header));
+
+    auto name = handle_start + sizeof(struct file_handle) +
+                handle_header.handle_bytes;
+    if (name >= info_end ||
+        std::memchr(name, '\0', static_cast<std::size_t>(info_end - name)) ==
+            nullptr) {
+      return false;
+    }
+
+    // open_by_handle_at needs an aligned handle.
+    std::vector<char> handle(sizeof(struct file_handle) +
+                             handle_header.handle_bytes);
+    std::memcpy(handle.data(), handle_start, handle.size());
+
+    int directory_fd{-1};
+    {
+      ReadLock lock(mount_mutex_);
+      auto mount_it = mount_descriptors_.find({fsid[0], fsid[1]});
+      if (mount_it == mount_descriptors_.end()) {
+        return false;
+      }
+
+      directory_fd = ::open_by_handle_at(
+          mount_it->second,
+          reinterpret_cast<struct file_handle*>(handle.data()),
+          O_PATH | O_CLOEXEC);
+    }
+
+    if (directory_fd == -1) {
+      // The directory was removed before the event was read.
+      return false;
+    }
+
+    char directory[PATH_MAX];
+    auto link = "/proc/self/fd/" + std::to_string(directory_fd);
+    auto link_size = ::readlink(link.c_str(), directory, sizeof(directory));
+    ::close(directory_fd);
+
+    if (link_size <= 0 || static_cast<std::size_t>(link_size) >= PATH_MAX) {
+      return false;
+    }
+
+    path.assign(directory, static_cast<std::size_t>(link_size));
+    if (std::strcmp(name, ".") != 0) {
+      if (path.back() != '/') {
+        path += '/';
+      }
+      path += name;
+    }
+    return true;
+  }
+
+  return false;
+}
+
+Status FanotifyEventPublisher::markFilesystem(const std::string& path,
+                                              std::uint64_t mask) {
+  auto mount_fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (mount_fd == -1) {
+    return Status::failure("Could not open the directory");
+  }
+
+  struct statfs fs_info;
+  if (::fstatfs(mount_fd, &fs_info) != 0) {
+    ::close(mount_fd);
+    return Status::failure("Could not read the filesystem id");
+  }
+
+  int fsid[2];
+  static_assert(sizeof(fsid) == sizeof(fs_info.f_fsid),
+                "Unexpected filesystem id size");
+  std::memcpy(fsid, &fs_info.f_fsid, sizeof(fsid));
+
+  if (::fanotify_mark(fanotify_handle_,
+                      FAN_MARK_ADD | FAN_MARK_FILESYSTEM,
+                      mask,
+                      mount_fd,
+                      nullptr) != 0) {
+    auto error = errno;
+    ::close(mount_fd);
+    return Status::failure("fanotify_mark failed with errno " +
+                           std::to_string(error));
+  }
+
+  WriteLock lock(mount_mutex_);
+  auto inserted = mount_descriptors_.insert({{fsid[0], fsid[1]}, mount_fd});
+  if (!inserted.second) {
+    // The filesystem was already marked, its mask has been extended.
+    ::close(mount_fd);
+  }
+
+  return Status::success();
+}
+
+void FanotifyEventPublisher::removeMarks() {
+  ::fanotify_mark(fanotify_handle_,
+                  FAN_MARK_FLUSH | FAN_MARK_FILESYSTEM,
+                  0,
+                  AT_FDCWD,
+                  nullptr);
+
+  WriteLock lock(mount_mutex_);
+  for (const auto& mount : mount_descriptors_) {
+    ::close(mount.second);
+  }
+  mount_descriptors_.clear();
+}
+
+void FanotifyEventPublisher::buildExcludePathsSet() {
+  auto parser = Config::getParser("file_paths");
+
+  WriteLock lock(subscription_lock_);
+  exclude_paths_.clear();
+
+  const auto& doc = parser->getData();
+  if (!doc.doc().HasMember("exclude_paths")) {
+    return;
+  }
+
+  for (const auto& category : doc.doc()["exclude_paths"].GetObject()) {
+    for (const auto& excl_path : category.value.GetArray()) {
+      std::string pattern = excl_path.GetString();
+      if (pattern.empty()) {
+        continue;
+      }
+      exclude_paths_.insert(pattern);
+    }
+  }
+}
+
+} // namespace osquery
@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <osquery/events/eventpublisher.h>
+#include <osquery/events/linux/inotify.h>
+#include <osquery/utils/mutex.h>
+
+struct fanotify_event_metadata;
+
+namespace osquery {
+
+/**
+ * @brief A Linux `fanotify` EventPublisher.
+ *
+ * This EventPublisher accepts the same subscriptions as INotifyEventPublisher
+ * and emits the same event contexts, so the file_events subscriber can use
+ * either one.
+ *
+ * Instead of one inotify watch per directory, each filesystem holding a
+ * subscribed path is marked once with the union of the subscription masks.
+ * The kernel reports the parent directory handle and the name of every
+ * change, the path is resolved and matched against the subscriptions when
+ * the event is read. Startup time and kernel memory no longer depend on the
+ * size of the monitored trees, and directories created later are covered.
+ *
+ * Requires Linux 5.9 (FAN_REPORT_DFID_NAME), CAP_SYS_ADMIN to create the
+ * filesystem marks and CAP_DAC_READ_SEARCH to open the directory handles.
+ */
+class FanotifyEventPublisher
+    : public EventPublisher<INotifySubscriptionContext, INotifyEventContext> {
+  DECLARE_PUBLISHER("fanotify");
+
+ public:
+  virtual ~FanotifyEventPublisher() {
+    tearDown();
+  }
+
+  /// Create the `fanotify` group.
+  Status setUp() override;
+
+  /// Mark the filesystems holding the subscribed paths.
+  void configure() override;
+
+  /// Remove the marks and release the `fanotify` group.
+  void tearDown() override;
+
+  /// Read and fire the events queued by the kernel.
+  Status run() override;
+
+  /**
+   * @brief Check if a path matches a subscription path.
+   *
+   * The subscription path uses the file_paths wildcards, after the '%' to
+   * '*' replacement: '*' matches within one path component, a '**' matches
+   * everything below, and a trailing '/' matches the files in a directory.
+   */
+  static bool matchesPath(const std::string& pattern, const std::string& path);
+
+  /// The existing directory whose filesystem holds a subscription path.
+  static std::string getMarkPath(const std::string& pattern);
+
+ private:
+  /// Given a SubscriptionContext and INotifyEventContext match path and action.
+  bool shouldFire(const INotifySubscriptionContextRef& sc,
+                  const INotifyEventContextRef& ec) const override;
+
+  /// Create an event context from a fanotify event, nullptr if unresolved.
+  INotifyEventContextRef createEventContextFrom(
+      const struct fanotify_event_metadata* metadata) const;
+
+  /// Resolve the path from the directory file handle and name of an event.
+  bool getEventPath(std::string& path,
+                    const struct fanotify_event_metadata* metadata) const;
+
+  /// Add a filesystem mark for the filesystem holding a path.
+  Status markFilesystem(const std::string& path, std::uint64_t mask);
+
+  /// Remove the filesystem marks, and close the mount descriptors.
+  void removeMarks();
+
+  /// Build the set of excluded paths for which events are not to be propagated.
+  void buildExcludePathsSet();
+
+ private:
+  /// The filesystem id reported with each event.
+  using FilesystemId = std::pair<int, int>;
+
+  /// Marked filesystems to a directory descriptor used to open the handles.
+  std::map<FilesystemId, int> mount_descriptors_;
+
+  /// Events pertaining to these paths not to be propagated.
+  ExcludePathSet exclude_paths_;
+
+  /// The fanotify group descriptor.
+  std::atomic<int> fanotify_handle_{-1};
+
+  /// Buffer for reading events, only used by the run loop.
+  std::vector<char> scratch_;
+
+  /// Access to the mount descriptors.
+  mutable Mutex mount_mutex_;
+};
+
+} // namespace osquery
@@ -7,7 +7,13 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <condition_variable>
+#include <iterator>
+#include <mutex>
+#include <set>
 #include <sstream>
+#include <thread>
 
 #include <fnmatch.h>
 #include <linux/limits.h>
@@ -30,6 +36,11 @@ namespace osquery {
 
 DECLARE_bool(enable_file_events);
 
+FLAG(uint32,
+     inotify_monitor_threads,
+     4,
+     "Number of threads adding watches to recursively monitored directories");
+
 static const size_t kINotifyMaxEvents = 512;
 static const size_t kINotifyEventSize =
     sizeof(struct inotify_event) + (NAME_MAX + 1);
@@ -221,6 +232,9 @@ void INotifyEventPublisher::tearDown() {
 }
 
 void INotifyEventPublisher::handleOverflow() {
+  // The kernel does not report how many events were lost, count at least one.
+  recordDroppedEvents(1);
+
   if (inotify_events_ < kINotifyMaxEvents) {
     VLOG(1) << "inotify was overflown: increasing scratch buffer";
     // Exponential increment.
@@ -266,9 +280,19 @@ Status INotifyEventPublisher::run() {
     return Status(1, "INotify read failed");
   }
 
+  // Events read together are fired together, subscribers may store them as
+  // one batch.
+  EventContextList batch;
   for (char* p = scratch_; p < scratch_ + record_num;) {
     // Cast the inotify struct, make shared pointer, and append to contexts.
     auto event = reinterpret_cast<struct inotify_event*>(p);
+    if (event->mask & (IN_Q_OVERFLOW | IN_IGNORED | IN_MOVE_SELF |
+                       IN_DELETE_SELF)) {
+      // Deliver the events read so far before the watches change.
+      fire(batch);
+      batch.clear();
+    }
+
     if (event->mask & IN_Q_OVERFLOW) {
       // The inotify queue was overflown (try to receive more events from OS).
       handleOverflow();
@@ -284,12 +308,13 @@ Status INotifyEventPublisher::run() {
     } else {
       auto ec = createEventContextFrom(event);
       if (!ec->action.empty()) {
-        fire(ec);
+        batch.push_back(ec);
       }
     }
     // Continue to iterate
     p += (sizeof(struct inotify_event)) + event->len;
   }
+  fire(batch);
 
   return Status::success();
 }
@@ -392,18 +417,94 @@ bool INotifyEventPublisher::addMonitor(const std::string& path,
   }
 
   if (recursive && isDirectory(path).ok()) {
+    addSubdirectoryMonitors(path, isc, mask);
+  }
+
+  return true;
+}
+
+void INotifyEventPublisher::addSubdirectoryMonitors(
+    const std::string& path,
+    INotifySubscriptionContextRef& isc,
+    uint32_t mask) {
+  std::mutex walk_mutex;
+  std::condition_variable walk_cv;
+
+  std::vector<std::string> pending_directories;
+  std::set<std::string> visited_directories{path};
+  std::size_t active_workers{0U};
+
+  // Monitor the subdirectories of one directory, queue them to be walked.
+  auto walkDirectory = [&](const std::string& directory) {
     std::vector<std::string> children;
-    // Get a list of children of this directory (requested recursive watches).
-    listDirectoriesInDirectory(path, children, true);
+    listDirectoriesInDirectory(directory, children, false);
 
     boost::system::error_code ec;
-    for (const auto& child : children) {
-      auto canonicalized = fs::canonical(child, ec).string() + '/';
-      addMonitor(canonicalized, isc, mask, false);
+    for (auto& child : children) {
+      child = fs::canonical(child, ec).string() + '/';
+    }
+
+    std::vector<std::string> new_directories;
+    {
+      std::lock_guard<std::mutex> lock(walk_mutex);
+      for (auto& child : children) {
+        if (visited_directories.insert(child).second) {
+          new_directories.push_back(std::move(child));
+        }
+      }
+    }
+
+    for (const auto& child : new_directories) {
+      addMonitor(child, isc, mask, false);
     }
+
+    return new_directories;
+  };
+
+  auto worker = [&]() {
+    std::unique_lock<std::mutex> lock(walk_mutex);
+    for (;;) {
+      walk_cv.wait(lock, [&]() {
+        return !pending_directories.empty() || active_workers == 0U;
+      });
+
+      if (pending_directories.empty()) {
+        break;
+      }
+
+      auto directory = std::move(pending_directories.back());
+      pending_directories.pop_back();
+      ++active_workers;
+
+      lock.unlock();
+      auto new_directories = walkDirectory(directory);
+      lock.lock();
+
+      std::move(new_directories.begin(),
+                new_directories.end(),
+                std::back_inserter(pending_directories));
+
+      --active_workers;
+      walk_cv.notify_all();
+    }
+  };
+
+  // Most directories have no subdirectories, only start threads if needed.
+  pending_directories = walkDirectory(path);
+
+  auto thread_count = std::min<std::size_t>(
+      std::max<std::uint32_t>(FLAGS_inotify_monitor_threads, 1U),
+      pending_directories.size());
+
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < thread_count; ++i) {
+    threads.emplace_back(worker);
   }
 
-  return true;
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
 }
 
 bool INotifyEventPublisher::removeMonitor(int watch,
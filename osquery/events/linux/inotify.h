@@ -124,7 +124,7 @@ using INotifyEventContextRef = std::shared_ptr<INotifyEventContext>;
 // Publisher container
 using DescriptorINotifySubCtxMap = std::map<int, INotifySubscriptionContextRef>;
 
-using ExcludePathSet = PathSet<patternedPath>;
+using ExcludePathSet = PathTrie;
 
 /**
  * @brief A Linux `inotify` EventPublisher.
@@ -218,6 +218,17 @@ class INotifyEventPublisher
                       bool recursive,
                       bool add_watch);
 
+  /**
+   * @brief Add monitors to every subdirectory of a directory.
+   *
+   * Directories are listed level by level, by up to inotify_monitor_threads
+   * threads once there is more than one subdirectory to walk. Symbolic links
+   * to directories that are already monitored are not followed again.
+   */
+  void addSubdirectoryMonitors(const std::string& path,
+                               INotifySubscriptionContextRef& isc,
+                               uint32_t mask);
+
   /// Helper method to parse a subscription and add an equivalent monitor.
   bool monitorSubscription(INotifySubscriptionContextRef& sc,
                            bool add_watch = true);
@@ -291,5 +302,6 @@ class INotifyEventPublisher
   FRIEND_TEST(INotifyTests, DISABLED_test_inotify_recursion);
   FRIEND_TEST(INotifyTests, test_inotify_match_subscription);
   FRIEND_TEST(INotifyTests, test_inotify_embedded_wildcards);
+  FRIEND_TEST(INotifyTests, test_inotify_recursive_monitor);
 };
 }
@@ -0,0 +1,68 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/events/linux/process_changes.h>
+
+namespace osquery {
+
+namespace {
+
+/// Processes remembered between two reads of the processes table.
+const std::size_t kMaxProcessChanges{65536};
+
+} // namespace
+
+ProcessChanges& ProcessChanges::get() {
+  static ProcessChanges changes;
+  return changes;
+}
+
+void ProcessChanges::setTracked(bool tracked) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (tracked) {
+    ++trackers_;
+  } else if (trackers_ > 0) {
+    --trackers_;
+  }
+
+  // The execs before a subscriber started, or after it stopped, are unknown.
+  lost_ = true;
+  pids_.clear();
+}
+
+bool ProcessChanges::isTracked() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return trackers_ > 0;
+}
+
+void ProcessChanges::changed(std::uint64_t pid) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (lost_) {
+    return;
+  }
+
+  if (pids_.size() >= kMaxProcessChanges) {
+    lost_ = true;
+    pids_.clear();
+    return;
+  }
+  pids_.insert(pid);
+}
+
+bool ProcessChanges::take(std::set<std::uint64_t>& pids) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  pids.clear();
+  pids.swap(pids_);
+
+  auto complete = !lost_ && trackers_ > 0;
+  lost_ = false;
+  return complete;
+}
+
+} // namespace osquery
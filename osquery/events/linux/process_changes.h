@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <set>
+
+#include <boost/noncopyable.hpp>
+
+namespace osquery {
+
+/**
+ * @brief The processes that executed a binary since they were last read.
+ *
+ * The process event subscribers report every exec they see, so the
+ * processes table can keep the columns set by exec, such as the path and
+ * the cmdline, for the processes that did not change.
+ */
+class ProcessChanges : private boost::noncopyable {
+ public:
+  /// Get the changes of the processes of the host.
+  static ProcessChanges& get();
+
+  /// Called by a subscriber that reports every exec when it starts.
+  void setTracked(bool tracked);
+
+  /// Check if a subscriber reports every exec.
+  bool isTracked() const;
+
+  /// Report that a process executed a binary.
+  void changed(std::uint64_t pid);
+
+  /**
+   * @brief Take the processes that changed since the last call.
+   *
+   * @param pids The processes that changed.
+   * @return false if too many processes changed to remember them, or if the
+   * changes were not tracked, every process must be read again.
+   */
+  bool take(std::set<std::uint64_t>& pids);
+
+ private:
+  ProcessChanges() = default;
+
+ private:
+  mutable std::mutex mutex_;
+
+  std::set<std::uint64_t> pids_;
+
+  /// Subscribers reporting the changes.
+  std::size_t trackers_{0};
+
+  /// Changes were lost since the last take.
+  bool lost_{true};
+};
+
+} // namespace osquery
@@ -9,20 +9,18 @@
 
 #include <fcntl.h>
 #include <grp.h>
+#include <poll.h>
 #include <sys/file.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
 
-#include <istream>
+#include <cstring>
 #include <string>
+#include <string_view>
 
-#include <boost/algorithm/string/trim.hpp>
 #include <boost/filesystem.hpp>
-#include <boost/lexical_cast.hpp>
-#include <boost/property_tree/json_parser.hpp>
-#include <boost/tokenizer.hpp>
 #include <osquery/registry/registry_factory.h>
 
 #include <osquery/core/flags.h>
@@ -44,7 +42,7 @@ FLAG(string,
 
 FLAG(uint64,
      syslog_rate_limit,
-     100,
+     4096,
      "Maximum number of logs to ingest per run (~200ms between runs)");
 
 REGISTER(SyslogEventPublisher, "event_publisher", "syslog");
@@ -55,8 +53,17 @@ const std::string kPipeGroupName = "syslog";
 const char* kTimeFormat = "%Y-%m-%dT%H:%M:%S";
 const std::vector<std::string> kCsvFields = {
     "time", "host", "severity", "facility", "tag", "message"};
+const size_t kCsvTimeField = 0;
+const size_t kCsvTagField = 4;
+const char* kCsvWhitespace = " \t\n\v\f\r";
 const size_t kErrorThreshold = 10;
 
+/// Lines longer than the buffer are dropped.
+const size_t kSyslogBufferSize = 65536;
+
+/// Milliseconds to wait for rsyslog to write, per run.
+const int kSyslogPollTimeout = 1000;
+
 Status NonBlockingFStream::openReadOnly(const std::string& path) {
   WriteLock lock(fd_mutex_);
 
@@ -74,60 +81,91 @@ Status NonBlockingFStream::openReadOnly(const std::string& path) {
 Status NonBlockingFStream::getline(std::string& output) {
   output.clear();
 
-  char* buffer_end = nullptr;
-  if (offset_ > 0) {
-    buffer_end = static_cast<char*>(memchr(buffer_.data(), '\n', offset_));
-  }
-
-  if (buffer_end == nullptr) {
-    WriteLock lock(fd_mutex_);
-
+  std::string_view line;
+  if (!nextLine(line)) {
     // Poll for available data with a near-instant delay.
     // It is the caller's responsibility to yield context.
-    fd_set set;
-    struct timeval timeout = {0, 200};
-    FD_ZERO(&set);
-    FD_SET(fd_, &set);
-    int rv = ::select(FD_SETSIZE, &set, nullptr, nullptr, &timeout);
-    if (rv <= 0) {
+    if (!wait(0)) {
       // No data.
       return Status::failure("No data to read");
     }
 
-    // Read starting where we left off (if there was a previous read).
-    auto buffer_data = buffer_.data() + offset_;
-    // Only read up to the capacity of the vector buffer.
-    auto max_read = buffer_.capacity() - offset_;
-    auto bytes_read = ::read(fd_, buffer_data, max_read);
-    if (bytes_read <= 0) {
-      return Status::failure("Not enough data available");
+    auto status = fill();
+    if (!status.ok()) {
+      return status;
     }
 
-    offset_ += bytes_read;
-
-    buffer_end = static_cast<char*>(memchr(buffer_data, '\n', bytes_read));
-    if (buffer_end == nullptr) {
-      if (offset_ == buffer_.capacity()) {
-        // This is a problem we cannot handle.
-        offset_ = 0;
-        return Status::failure("Too much data");
-      }
+    if (!nextLine(line)) {
       // Wait for the next read.
       return Status::success();
     }
   }
 
-  size_t line_size = buffer_end - buffer_.data();
-  output.reserve(line_size);
-  std::copy(buffer_.data(), buffer_end, std::back_inserter(output));
-  offset_ = offset_ - line_size - 1;
-  if (offset_ > 0) {
-    // Shift bytes down.
-    memcpy(buffer_.data(), buffer_end + 1, offset_);
+  output.assign(line.data(), line.size());
+  return Status::success();
+}
+
+bool NonBlockingFStream::wait(int timeout) {
+  WriteLock lock(fd_mutex_);
+  if (fd_ == -1) {
+    return false;
+  }
+
+  struct pollfd fds[1];
+  fds[0].fd = fd_;
+  fds[0].events = POLLIN;
+  return ::poll(fds, 1, timeout) > 0 && (fds[0].revents & POLLIN);
+}
+
+Status NonBlockingFStream::fill() {
+  if (start_ > 0) {
+    // Shift the incomplete line down, once per read rather than per line.
+    offset_ -= start_;
+    if (offset_ > 0) {
+      memmove(buffer_.data(), buffer_.data() + start_, offset_);
+    }
+    start_ = 0;
+  }
+
+  WriteLock lock(fd_mutex_);
+
+  // Read starting where we left off (if there was a previous read).
+  auto buffer_data = buffer_.data() + offset_;
+  // Only read up to the capacity of the vector buffer.
+  auto max_read = buffer_.capacity() - offset_;
+  auto bytes_read = ::read(fd_, buffer_data, max_read);
+  if (bytes_read <= 0) {
+    return Status::failure("Not enough data available");
+  }
+
+  offset_ += bytes_read;
+  if (offset_ == buffer_.capacity() &&
+      memchr(buffer_.data(), '\n', offset_) == nullptr) {
+    // This is a problem we cannot handle.
+    offset_ = 0;
+    return Status::failure("Too much data");
   }
   return Status::success();
 }
 
+bool NonBlockingFStream::nextLine(std::string_view& line) {
+  auto line_start = buffer_.data() + start_;
+  auto line_end =
+      static_cast<char*>(memchr(line_start, '\n', offset_ - start_));
+  if (line_end == nullptr) {
+    return false;
+  }
+
+  line = std::string_view(line_start, line_end - line_start);
+  start_ = line_end - buffer_.data() + 1;
+  if (start_ == offset_) {
+    // Everything was dequeued, the next read starts at the beginning.
+    start_ = 0;
+    offset_ = 0;
+  }
+  return true;
+}
+
 Status NonBlockingFStream::close() {
   WriteLock lock(fd_mutex_);
 
@@ -138,6 +176,12 @@ Status NonBlockingFStream::close() {
   return Status();
 }
 
+SyslogEventPublisher::SyslogEventPublisher()
+    : EventPublisher(),
+      readStream_(kSyslogBufferSize),
+      errorCount_(0),
+      lockFd_(-1) {}
+
 Status SyslogEventPublisher::setUp() {
   if (!FLAGS_enable_syslog) {
     return Status(1, "Publisher disabled via configuration");
@@ -228,22 +272,35 @@ void SyslogEventPublisher::unlockPipe() {
 }
 
 Status SyslogEventPublisher::run() {
-  // This run function will be called by the event factory with ~100ms pause
-  // (see InterruptibleRunnable::pause()) between runs. In case something goes
-  // weird and there is a huge amount of input, we limit how many logs we
-  // take in per run to avoid pegging the CPU.
-
-  std::string line;
-  for (size_t i = 0; i < FLAGS_syslog_rate_limit; ++i) {
-    if (!readStream_.getline(line) || line.empty()) {
-      // Not enough data was available, fall through an wait.
-      break;
+  // Wait for rsyslog to write, then drain everything that is available. The
+  // event factory pauses ~200ms between runs. In case something goes weird and
+  // there is a huge amount of input, we limit how many logs we take in per run
+  // to avoid pegging the CPU.
+  if (!readStream_.wait(kSyslogPollTimeout)) {
+    return Status::success();
+  }
+
+  std::string_view line;
+  EventContextList batch;
+  size_t line_count = 0;
+  while (line_count < FLAGS_syslog_rate_limit) {
+    if (!readStream_.nextLine(line)) {
+      if (!readStream_.fill().ok()) {
+        // Not enough data was available, fall through an wait.
+        break;
+      }
+      continue;
+    }
+
+    ++line_count;
+    if (line.empty()) {
+      continue;
     }
 
     auto ec = createEventContext();
     Status status = populateEventContext(line, ec);
     if (status.ok()) {
-      fire(ec);
+      batch.push_back(ec);
       if (errorCount_ > 0) {
         --errorCount_;
       }
@@ -251,10 +308,14 @@ Status SyslogEventPublisher::run() {
       LOG(ERROR) << status.getMessage() << " in line: " << line;
       ++errorCount_;
       if (errorCount_ >= kErrorThreshold) {
+        fire(batch);
         return Status(1, "Too many errors in syslog parsing.");
       }
     }
   }
+
+  // Lines read in the same run are fired, and stored, as one batch.
+  fire(batch);
   return Status::success();
 }
 
@@ -263,28 +324,44 @@ void SyslogEventPublisher::tearDown() {
   unlockPipe();
 }
 
-Status SyslogEventPublisher::populateEventContext(const std::string& line,
+Status SyslogEventPublisher::populateEventContext(std::string_view line,
                                                   SyslogEventContextRef& ec) {
-  boost::tokenizer<RsyslogCsvSeparator> tokenizer(line);
-  auto key = kCsvFields.begin();
-  for (std::string value : tokenizer) {
-    if (key == kCsvFields.end()) {
+  RsyslogCsvSeparator separator;
+  auto next = line.begin();
+
+  // Every field is split into the same buffer.
+  std::string field;
+  field.reserve(line.size());
+
+  size_t index = 0;
+  while (separator(next, line.end(), field)) {
+    if (index == kCsvFields.size()) {
       return Status(1, "Received more fields than expected");
     }
 
-    boost::trim(value);
-    if (*key == "time") {
-      ec->fields["datetime"] = value;
-    } else if (*key == "tag" && !value.empty() && value.back() == ':') {
+    std::string_view value(field);
+    auto first = value.find_first_not_of(kCsvWhitespace);
+    if (first == std::string_view::npos) {
+      value = std::string_view();
+    } else {
+      value = value.substr(first, value.find_last_not_of(kCsvWhitespace) + 1 -
+                                      first);
+    }
+
+    const auto& key = kCsvFields[index];
+    if (index == kCsvTimeField) {
+      ec->fields.emplace("datetime", value);
+    } else if (index == kCsvTagField && !value.empty() &&
+               value.back() == ':') {
       // rsyslog sends "tag" with a trailing colon that we don't need
-      ec->fields.emplace(*key, value.substr(0, value.size() - 1));
+      ec->fields.emplace(key, value.substr(0, value.size() - 1));
     } else {
-      ec->fields.emplace(*key, value);
+      ec->fields.emplace(key, value);
     }
-    ++key;
+    ++index;
   }
 
-  if (key == kCsvFields.end()) {
+  if (index == kCsvFields.size()) {
     return Status::success();
   } else {
     return Status(1, "Received fewer fields than expected");
@@ -16,6 +16,7 @@
 #include <boost/noncopyable.hpp>
 
 #include <map>
+#include <string_view>
 #include <vector>
 
 #include <stdio.h>
@@ -55,6 +56,10 @@ using SyslogSubscriptionContextRef = std::shared_ptr<SyslogSubscriptionContext>;
  * The goal is to abstract a managed buffer and stream-like-object to implement
  * a version of std::getline that does not block.
  *
+ * Callers draining the pipe should wait for data, then alternate between
+ * nextLine and fill until neither yields anything. Lines are views into the
+ * buffer, so draining does not copy or shift the buffer for each line.
+ *
  * Limitations include undefined behavior (dropping the initial bytes) when a
  * line would overflow the reserved internal buffer.
  */
@@ -92,9 +97,35 @@ class NonBlockingFStream : public boost::noncopyable {
    */
   Status getline(std::string& output);
 
-  /// Inspect the internal offset.
+  /**
+   * @brief Wait up to timeout milliseconds for data to read.
+   *
+   * @return true if the stream is readable.
+   */
+  bool wait(int timeout);
+
+  /**
+   * @brief Read the data available without blocking.
+   *
+   * Consumed lines are discarded first to make room. The read fails if there
+   * is nothing to read, or if the buffer is full without a complete line, in
+   * which case the buffered bytes are dropped.
+   */
+  Status fill();
+
+  /**
+   * @brief Dequeue a buffered line, without reading.
+   *
+   * The line does not include the newline and is only valid until the next
+   * call to fill or getline.
+   *
+   * @return false if there is no complete line buffered.
+   */
+  bool nextLine(std::string_view& line);
+
+  /// Inspect the number of buffered bytes that are not yet dequeued.
   size_t offset() {
-    return offset_;
+    return offset_ - start_;
   }
 
  private:
@@ -107,6 +138,9 @@ class NonBlockingFStream : public boost::noncopyable {
   /// Push/pop buffer for reading a line and dequeuing.
   std::vector<char> buffer_;
 
+  /// Offset into the buffer of the next line to dequeue.
+  size_t start_{0};
+
   /**
    * @brief Offset into the buffer for the next read.
    *
@@ -117,6 +151,7 @@ class NonBlockingFStream : public boost::noncopyable {
 
  private:
   FRIEND_TEST(SyslogTests, test_nonblockingfstream);
+  FRIEND_TEST(SyslogTests, test_nonblockingfstream_drain);
 };
 
 /**
@@ -141,7 +176,7 @@ class SyslogEventPublisher
   Status run() override;
 
  public:
-  SyslogEventPublisher() : EventPublisher(), errorCount_(0), lockFd_(-1) {}
+  SyslogEventPublisher();
 
  private:
   /// Apply normal subscription to event matching logic.
@@ -180,9 +215,10 @@ class SyslogEventPublisher
    * @brief Populate the SyslogEventContext with the syslog JSON.
    *
    * Performs basic cleanup on the JSON data as it is populated into the
-   * context.
+   * context. Fields are split into a reused buffer, the only allocations are
+   * the copies stored in the context.
    */
-  static Status populateEventContext(const std::string& line,
+  static Status populateEventContext(std::string_view line,
                                      SyslogEventContextRef& ec);
 
   /**
@@ -234,7 +270,8 @@ class RsyslogCsvSeparator {
   template <typename InputIterator, typename Token>
   bool operator()(InputIterator& next, InputIterator end, Token& tok) {
     bool in_quote = false;
-    tok = Token();
+    // Clear rather than replace the token to keep its capacity.
+    tok.clear();
 
     if (next == end) {
       if (last_) {
@@ -9,15 +9,24 @@
 
 #include <poll.h>
 
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
+#include <osquery/sql/step_generations.h>
 
 #include "osquery/events/linux/udev.h"
 
 namespace osquery {
 
-static const int kUdevMLatency = 200;
+/// Milliseconds to wait for the monitor, per run.
+static const int kUdevPollTimeout = 1000;
+
+/// The most devices fired as one batch.
+static const size_t kUdevMaxBatch = 1024;
 
 REGISTER(UdevEventPublisher, "event_publisher", "udev");
 
@@ -73,7 +82,7 @@ Status UdevEventPublisher::run() {
     fds[0].fd = fd;
     fds[0].events = POLLIN;
 
-    int selector = ::poll(fds, 1, 1000);
+    int selector = ::poll(fds, 1, kUdevPollTimeout);
     if (selector == -1 && errno != EINTR && errno != EAGAIN) {
       LOG(ERROR) << "Could not read udev monitor: " << std::strerror(errno);
       return Status::failure("udev monitor failed");
@@ -84,20 +93,42 @@ Status UdevEventPublisher::run() {
       return Status::success();
     }
 
-    struct udev_device* device = udev_monitor_receive_device(monitor_);
-    if (device == nullptr) {
+    // Drain every message the monitor has queued, the monitor socket does
+    // not block once it is empty.
+    std::vector<struct udev_device*> devices;
+    EventContextList batch;
+    while (devices.size() < kUdevMaxBatch) {
+      errno = 0;
+      struct udev_device* device = udev_monitor_receive_device(monitor_);
+      if (device == nullptr) {
+        break;
+      }
+
+      devices.push_back(device);
+      batch.push_back(createEventContextFrom(device));
+    }
+
+    if (devices.empty() && errno != 0 && errno != EAGAIN &&
+        errno != EWOULDBLOCK && errno != EINTR) {
       LOG(ERROR) << "udev monitor returned invalid device: "
                  << std::strerror(errno);
       return Status::failure("udev monitor failed");
     }
 
-    auto ec = createEventContextFrom(device);
-    fire(ec);
+    // Tables of the hardware are generated again after a device changed.
+    if (!devices.empty()) {
+      resetBootGenerations();
+    }
+
+    // Devices received together are fired together, subscribers may store
+    // them as one batch.
+    fire(batch);
 
-    udev_device_unref(device);
+    for (auto device : devices) {
+      udev_device_unref(device);
+    }
   }
 
-  pause(std::chrono::milliseconds(kUdevMLatency));
   return Status::success();
 }
 
@@ -9,6 +9,8 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
@@ -155,4 +157,105 @@ class patternedPath {
   }
 };
 
+/**
+ * @brief Component trie implementation for path search.
+ *
+ * Accepts the same patterns as PathSet<patternedPath>, but a lookup walks
+ * the path components once instead of comparing the path with every
+ * pattern.
+ *
+ * A '%' component matches exactly one path component, or any path below
+ * the parent when it is the last component. A '%%' component matches the
+ * parent path and everything below it; components after it are ignored.
+ *
+ * The trie is protected by lock. It is threadsafe.
+ */
+class PathTrie : private boost::noncopyable {
+ public:
+  void insert(const std::string& str) {
+    auto pattern = str;
+    replaceGlobWildcards(pattern);
+    auto path = patternedPath::createPath(pattern);
+
+    WriteLock lock(trie_lock_);
+    empty_ = false;
+
+    auto node = &root_;
+    for (const auto& component : path) {
+      if (component == "**") {
+        node->terminal = true;
+        node->subtree = true;
+        return;
+      }
+
+      auto& child = node->children[component];
+      if (child == nullptr) {
+        child = std::make_unique<Node>();
+      }
+
+      node = child.get();
+    }
+
+    node->terminal = true;
+    if (!path.empty() && path.back() == "*") {
+      node->subtree = true;
+    }
+  }
+
+  bool find(const std::string& str) const {
+    auto path = patternedPath::createPath(str);
+
+    ReadLock lock(trie_lock_);
+    return !empty_ && matches(root_, path, 0);
+  }
+
+  void clear() {
+    WriteLock lock(trie_lock_);
+    root_ = {};
+    empty_ = true;
+  }
+
+  bool empty() const {
+    ReadLock lock(trie_lock_);
+    return empty_;
+  }
+
+ private:
+  struct Node final {
+    std::map<std::string, std::unique_ptr<Node>> children;
+
+    /// A pattern ends at this node.
+    bool terminal{false};
+
+    /// The pattern also matches every path below this node.
+    bool subtree{false};
+  };
+
+  static bool matches(const Node& node,
+                      const patternedPath::Path& path,
+                      std::size_t index) {
+    if (index == path.size()) {
+      return node.terminal;
+    }
+
+    if (node.subtree) {
+      return true;
+    }
+
+    auto child = node.children.find(path[index]);
+    if (child != node.children.end() &&
+        matches(*child->second, path, index + 1)) {
+      return true;
+    }
+
+    auto wildcard = node.children.find("*");
+    return wildcard != node.children.end() &&
+           matches(*wildcard->second, path, index + 1);
+  }
+
+  Node root_;
+  bool empty_{true};
+  mutable Mutex trie_lock_;
+};
+
 } // namespace osquery
@@ -23,6 +23,10 @@ namespace osquery {
 using EventCallback = std::function<Status(const EventContextRef&,
                                            const SubscriptionContextRef&)>;
 
+/// An EventCallback receiving the matching events of a fired batch at once.
+using EventBatchCallback = std::function<Status(
+    const EventContextList&, const SubscriptionContextRef&)>;
+
 struct Subscription;
 using SubscriptionRef = std::shared_ptr<Subscription>;
 
@@ -63,6 +67,9 @@ struct Subscription : private boost::noncopyable {
   /// An EventSubscription member EventCallback method.
   EventCallback callback;
 
+  /// Optional callback used instead of callback to receive batches of events.
+  EventBatchCallback batch_callback;
+
   explicit Subscription(std::string name);
 
   static SubscriptionRef create(const std::string& name);
@@ -301,6 +301,7 @@ class TestFSEventsEventSubscriber
   FRIEND_TEST(FSEventsTests, test_fsevents_fire_event);
   FRIEND_TEST(FSEventsTests, test_fsevents_event_action);
   FRIEND_TEST(FSEventsTests, test_fsevents_embedded_wildcards);
+  FRIEND_TEST(FSEventsTests, test_fsevents_coalesce);
 };
 
 TEST_F(FSEventsTests, test_fsevents_run) {
@@ -424,6 +425,36 @@ TEST_F(FSEventsTests, test_fsevents_event_action) {
   EndEventLoop();
 }
 
+TEST_F(FSEventsTests, test_fsevents_coalesce) {
+  event_pub_ = std::make_shared<FSEventsEventPublisher>();
+  auto s = EventFactory::registerEventPublisher(event_pub_);
+  ASSERT_TRUE(s.ok());
+
+  auto sub = std::make_shared<TestFSEventsEventSubscriber>();
+  s = EventFactory::registerEventSubscriber(sub);
+  ASSERT_TRUE(s.ok());
+  sub->subscribe(&TestFSEventsEventSubscriber::Callback,
+                 sub->GetSubscription(real_test_path, 0));
+
+  // A latency window with several notifications for the same path.
+  const char* paths[] = {
+      real_test_path.c_str(), real_test_path.c_str(), real_test_path.c_str()};
+  FSEventStreamEventFlags flags[] = {kFSEventStreamEventFlagItemCreated,
+                                     kFSEventStreamEventFlagItemModified,
+                                     kFSEventStreamEventFlagItemModified};
+  FSEventStreamEventId ids[] = {1, 2, 3};
+  FSEventsEventPublisher::Callback(nullptr, nullptr, 3, paths, flags, ids);
+
+  {
+    WriteLock lock(sub->mutex_);
+    EXPECT_EQ(sub->callback_count_, 2);
+    EXPECT_EQ(sub->actions_, std::vector<std::string>({"CREATED", "UPDATED"}));
+  }
+
+  s = EventFactory::deregisterEventPublisher("fsevents");
+  EXPECT_TRUE(s.ok());
+}
+
 TEST_F(FSEventsTests, test_fsevents_embedded_wildcards) {
   // Assume event type is not registered.
   event_pub_ = std::make_shared<FSEventsEventPublisher>();
@@ -368,6 +368,7 @@ class FakeEventSubscriber : public EventSubscriber<FakeEventPublisher> {
   bool contextBellHathTolled{false};
   bool shouldFireBethHathTolled{false};
   size_t timesConfigured{0};
+  std::vector<size_t> batchSizes;
 
   FakeEventSubscriber() {
     setName("fake_events");
@@ -397,6 +398,16 @@ class FakeEventSubscriber : public EventSubscriber<FakeEventPublisher> {
     return Status::success();
   }
 
+  Status BatchCallback(const std::vector<ECRef>& ec_list, const SCRef& sc) {
+    batchSizes.push_back(ec_list.size());
+    return Status::success();
+  }
+
+  void batchInit() {
+    auto sub_ctx = createSubscriptionContext();
+    subscribeBatch(&FakeEventSubscriber::BatchCallback, sub_ctx);
+  }
+
   void lateInit() {
     auto sub_ctx = createSubscriptionContext();
     subscribe(&FakeEventSubscriber::Callback, sub_ctx);
@@ -509,6 +520,95 @@ TEST_F(EventsTests, test_event_subscriber_configure) {
   EXPECT_EQ(sub->timesConfigured, 2U);
 }
 
+TEST_F(EventsTests, test_event_subscriber_memory_storage) {
+  Config::get().update(
+      {{"data", "{\"events\": {\"memory_subscribers\": [\"fake_events\"]}}"}});
+
+  auto sub = std::make_shared<FakeEventSubscriber>();
+  auto status = EventFactory::registerEventSubscriber(sub);
+  ASSERT_TRUE(status.ok());
+
+  std::vector<Row> rows = {{{"value", "1"}}, {{"value", "2"}}};
+  status = sub->addBatch(rows, 100);
+  ASSERT_TRUE(status.ok());
+
+  // The events are not written to the database.
+  std::vector<std::string> keys;
+  auto prefix = "data." + sub->dbNamespace() + ".";
+  scanDatabaseKeys(kEvents, keys, prefix, 0);
+  EXPECT_TRUE(keys.empty());
+
+  std::vector<Row> results;
+  sub->generateRows([&results](Row row) { results.push_back(std::move(row)); },
+                    false,
+                    0,
+                    0);
+  ASSERT_EQ(results.size(), 2U);
+  EXPECT_EQ(results[0]["time"], "100");
+
+  // They are saved when the subscriber is removed.
+  status = EventFactory::deregisterEventSubscriber(sub->getName());
+  EXPECT_TRUE(status.ok());
+  scanDatabaseKeys(kEvents, keys, prefix, 0);
+  EXPECT_EQ(keys.size(), 2U);
+
+  for (const auto& key : keys) {
+    deleteDatabaseValue(kEvents, key);
+  }
+  Config::get().update({{"data", "{\"events\": {}}"}});
+}
+
+TEST_F(EventsTests, test_event_subscriber_async_dispatch) {
+  Config::get().update(
+      {{"data", "{\"events\": {\"async_subscribers\": [\"fake_events\"]}}"}});
+
+  auto pub = std::make_shared<FakeEventPublisher>();
+  auto status = EventFactory::registerEventPublisher(pub);
+  ASSERT_TRUE(status.ok());
+
+  auto sub = std::make_shared<FakeEventSubscriber>();
+  status = EventFactory::registerEventSubscriber(sub);
+  ASSERT_TRUE(status.ok());
+
+  sub->lateInit();
+  pub->configure();
+  auto ec = pub->createEventContext();
+  pub->fire(ec, 0);
+
+  // Removing the subscriber runs the callbacks that are still queued.
+  status = EventFactory::deregisterEventSubscriber(sub->getName());
+  EXPECT_TRUE(status.ok());
+  EXPECT_TRUE(sub->bellHathTolled);
+  EXPECT_EQ(sub->numDroppedEvents(), 0U);
+
+  status = EventFactory::deregisterEventPublisher(pub->type());
+  EXPECT_TRUE(status.ok());
+  Config::get().update({{"data", "{\"events\": {}}"}});
+}
+
+TEST_F(EventsTests, test_event_publisher_stats) {
+  auto pub = std::make_shared<BasicEventPublisher>();
+  pub->setName("BasicPublisher");
+
+  pub->fire(pub->createEventContext(), 0);
+  pub->fire({pub->createEventContext(), pub->createEventContext()}, 0);
+  EXPECT_EQ(pub->numEvents(), 3U);
+  EXPECT_EQ(pub->numDroppedEvents(), 0U);
+
+  // Publishers count the events the OS lost.
+  pub->recordDroppedEvents(5);
+  EXPECT_EQ(pub->numDroppedEvents(), 5U);
+
+  // Events fired while ending are dropped.
+  pub->isEnding(true);
+  pub->fire(pub->createEventContext(), 0);
+  pub->fire({pub->createEventContext(), pub->createEventContext()}, 0);
+  EXPECT_EQ(pub->numEvents(), 3U);
+  EXPECT_EQ(pub->numDroppedEvents(), 8U);
+  EXPECT_EQ(pub->numReceivedEvents(), 11U);
+  EXPECT_EQ(pub->queueDepth(), 0U);
+}
+
 TEST_F(EventsTests, test_fire_event) {
   auto pub = std::make_shared<BasicEventPublisher>();
   pub->setName("BasicPublisher");
@@ -553,6 +653,45 @@ TEST_F(EventsTests, test_fire_event) {
   EXPECT_TRUE(status.ok());
 }
 
+TEST_F(EventsTests, test_fire_event_batch) {
+  auto pub = std::make_shared<FakeEventPublisher>();
+  auto status = EventFactory::registerEventPublisher(pub);
+  ASSERT_TRUE(status.ok());
+
+  auto sub = std::make_shared<FakeEventSubscriber>();
+  status = EventFactory::registerEventSubscriber(sub);
+  ASSERT_TRUE(status.ok());
+
+  // One subscription takes batches, the other single events.
+  sub->batchInit();
+  sub->lateInit();
+  pub->configure();
+
+  EventContextList batch;
+  for (size_t i = 0; i < 3; ++i) {
+    batch.push_back(pub->createEventContext());
+  }
+  pub->fire(batch, 0);
+  ASSERT_EQ(sub->batchSizes.size(), 1U);
+  EXPECT_EQ(sub->batchSizes[0], 3U);
+  EXPECT_TRUE(sub->bellHathTolled);
+
+  // Each event in the batch has its own identifier.
+  EXPECT_EQ(batch[0]->id + 1, batch[1]->id);
+  EXPECT_EQ(batch[1]->id + 1, batch[2]->id);
+  EXPECT_EQ(pub->numEvents(), 3U);
+
+  // Single events reach the batch callback as a batch of one.
+  pub->fire(pub->createEventContext(), 0);
+  ASSERT_EQ(sub->batchSizes.size(), 2U);
+  EXPECT_EQ(sub->batchSizes[1], 1U);
+
+  status = EventFactory::deregisterEventSubscriber(sub->getName());
+  EXPECT_TRUE(status.ok());
+  status = EventFactory::deregisterEventPublisher(pub->type());
+  EXPECT_TRUE(status.ok());
+}
+
 class SubFakeEventSubscriber : public FakeEventSubscriber {
  public:
   SubFakeEventSubscriber() : FakeEventSubscriber(true) {
@@ -9,16 +9,22 @@
 
 #include "mockedosquerydatabase.h"
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <thread>
 
 #include <gtest/gtest.h>
 
+#include <osquery/core/flags.h>
+#include <osquery/events/eventaggregator.h>
 #include <osquery/events/eventsubscriber.h>
 
 namespace osquery {
 
+DECLARE_uint64(events_index_checkpoint_interval);
+
 class EventSubscriberPluginTests : public testing::Test {};
 
 TEST_F(EventSubscriberPluginTests, generateEventIdentifier) {
@@ -118,15 +124,20 @@ TEST_F(EventSubscriberPluginTests, databaseKeyForEventId) {
   EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
 
   const std::size_t kEventIdentifier{1000};
+  const EventTime kEventTime{125U};
 
   std::stringstream expected_key;
   expected_key << "data." << context.database_namespace << "."
+               << std::setfill('0') << std::setw(10) << 2 << "."
                << std::setfill('0') << std::setw(10) << kEventIdentifier;
 
-  auto key =
-      EventSubscriberPlugin::databaseKeyForEventId(context, kEventIdentifier);
+  auto key = EventSubscriberPlugin::databaseKeyForEventId(
+      context, kEventTime, kEventIdentifier);
 
   EXPECT_EQ(key, expected_key.str());
+  EXPECT_EQ(key.find(EventSubscriberPlugin::databasePrefixForBucket(
+                context, EventSubscriberPlugin::eventBucket(kEventTime))),
+            0U);
 }
 
 TEST_F(EventSubscriberPluginTests, removeOverflowingEventBatches) {
@@ -193,6 +204,96 @@ TEST_F(EventSubscriberPluginTests, expireEventBatches) {
   EXPECT_EQ(context.event_index.size(), 5U);
 }
 
+namespace {
+
+/// Add one JSON event per time to the database, returning their keys.
+std::vector<std::string> addBucketedEvents(
+    MockedOsqueryDatabase& mocked_database,
+    EventSubscriberPlugin::Context& context,
+    const std::vector<EventTime>& times) {
+  std::vector<std::string> keys;
+  for (auto event_time : times) {
+    auto event_id = EventSubscriberPlugin::generateEventIdentifier(context);
+    Row row = {{"time", std::to_string(event_time)},
+               {"eid", EventSubscriberPlugin::toIndex(event_id)}};
+
+    std::string serialized_row;
+    serializeRowJSON(row, serialized_row);
+    keys.push_back(EventSubscriberPlugin::databaseKeyForEventId(
+        context, event_time, event_id));
+    mocked_database.key_map.insert({keys.back(), serialized_row});
+  }
+  return keys;
+}
+
+} // namespace
+
+TEST_F(EventSubscriberPluginTests, expireEventBuckets) {
+  MockedOsqueryDatabase mocked_database;
+  EventSubscriberPlugin::Context writer;
+  EventSubscriberPlugin::setDatabaseNamespace(writer, "type", "name");
+  auto keys = addBucketedEvents(
+      mocked_database, writer, {0, 30, 60, 90, 120, 150, 180, 210});
+
+  EventSubscriberPlugin::Context context;
+  EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
+  auto status =
+      EventSubscriberPlugin::generateEventDataIndex(context, mocked_database);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(context.event_index.size(), 8U);
+
+  // Expire the events up to time 90, the first two buckets are dropped with
+  // a single range delete.
+  EventSubscriberPlugin::expireEventBatches(
+      context, mocked_database, 1000, 1090);
+  EXPECT_EQ(context.event_index.size(), 4U);
+  EXPECT_EQ(mocked_database.range_delete_count, 1U);
+  EXPECT_EQ(mocked_database.key_map.size(), 4U);
+
+  // Expire up to time 120, only a part of the next bucket is removed.
+  EventSubscriberPlugin::expireEventBatches(
+      context, mocked_database, 1000, 1120);
+  EXPECT_EQ(context.event_index.size(), 3U);
+  EXPECT_EQ(mocked_database.range_delete_count, 1U);
+  EXPECT_EQ(mocked_database.key_map.count(keys[4]), 0U);
+  EXPECT_EQ(mocked_database.key_map.count(keys[5]), 1U);
+
+  // Overflowing batches are removed the same way.
+  EventSubscriberPlugin::removeOverflowingEventBatches(
+      context, mocked_database, 1U);
+  EXPECT_EQ(context.event_index.size(), 1U);
+  EXPECT_EQ(mocked_database.range_delete_count, 2U);
+  ASSERT_EQ(mocked_database.key_map.size(), 1U);
+  EXPECT_EQ(mocked_database.key_map.begin()->first, keys[7]);
+}
+
+TEST_F(EventSubscriberPluginTests, generateEventDataIndexMovesLegacyKeys) {
+  MockedOsqueryDatabase mocked_database;
+
+  // Events stored before buckets are keyed only by their identifier.
+  Row row = {{"time", "130"}, {"eid", "0000000007"}};
+  std::string serialized_row;
+  serializeRowJSON(row, serialized_row);
+  mocked_database.key_map.insert({"data.type.name.0000000007", serialized_row});
+
+  EventSubscriberPlugin::Context context;
+  EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
+  auto status =
+      EventSubscriberPlugin::generateEventDataIndex(context, mocked_database);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(context.last_event_id, 7U);
+
+  auto key = EventSubscriberPlugin::databaseKeyForEventId(context, 130, 7);
+  ASSERT_EQ(mocked_database.key_map.size(), 1U);
+  EXPECT_EQ(mocked_database.key_map.count(key), 1U);
+
+  std::size_t callback_count{0U};
+  EventSubscriberPlugin::generateRows(
+      context, mocked_database, [&callback_count](Row) { ++callback_count; },
+      0, 0);
+  EXPECT_EQ(callback_count, 1U);
+}
+
 TEST_F(EventSubscriberPluginTests, generateRows) {
   MockedOsqueryDatabase mocked_database;
   mocked_database.generateEvents("type", "name");
@@ -210,31 +311,568 @@ TEST_F(EventSubscriberPluginTests, generateRows) {
   std::size_t callback_count{0U};
   auto callback = [&callback_count](Row) { ++callback_count; };
 
-  EventIndex::iterator last;
-  last = EventSubscriberPlugin::generateRows(
+  auto last = EventSubscriberPlugin::generateRows(
       context, mocked_database, callback, 2, 1);
   EXPECT_EQ(callback_count, 0U);
-  EXPECT_EQ(last, context.event_index.end());
+  EXPECT_FALSE(last.has_value());
 
   last = EventSubscriberPlugin::generateRows(
       context, mocked_database, callback, 0, 0);
   EXPECT_EQ(callback_count, 10U);
-  EXPECT_EQ(last->first, 9U);
+  EXPECT_EQ(last->time, 9U);
 
   last = EventSubscriberPlugin::generateRows(
       context, mocked_database, callback, 0, 4);
   EXPECT_EQ(callback_count, 15U);
-  EXPECT_EQ(last->first, 4U);
+  EXPECT_EQ(last->time, 4U);
 
   last = EventSubscriberPlugin::generateRows(
       context, mocked_database, callback, 5, 9);
   EXPECT_EQ(callback_count, 20U);
-  EXPECT_EQ(last->first, 9U);
+  EXPECT_EQ(last->time, 9U);
 
   last = EventSubscriberPlugin::generateRows(
       context, mocked_database, callback, 10, 15);
   EXPECT_EQ(callback_count, 20U);
-  EXPECT_EQ(last, context.event_index.end());
+  EXPECT_FALSE(last.has_value());
+}
+
+TEST_F(EventSubscriberPluginTests, eventIndex) {
+  EventIndex index;
+  index.add(10, 1);
+  index.add(10, 2);
+  index.add(20, 3);
+  index.add(30, 5);
+
+  // An event with an older time is kept in time order.
+  index.add(20, 4);
+  index.add(15, 6);
+  EXPECT_EQ(index.size(), 4U);
+  EXPECT_EQ(index.eventCount(), 6U);
+
+  std::vector<EventID> ids;
+  for (const auto& entry : index) {
+    ids.push_back(entry.id);
+  }
+  EXPECT_EQ(ids, std::vector<EventID>({1, 2, 6, 3, 4, 5}));
+
+  EXPECT_EQ(index.lowerBound(16)->id, 3U);
+  EXPECT_EQ(index.upperBound(20)->id, 5U);
+  EXPECT_EQ(index.lowerBound(31), index.end());
+
+  std::string encoded;
+  index.serialize(encoded, 6);
+  EventIndex decoded;
+  EventID last_event_id{0U};
+  ASSERT_TRUE(decoded.deserialize(encoded, last_event_id).ok());
+  EXPECT_EQ(last_event_id, 6U);
+  EXPECT_EQ(decoded.size(), 4U);
+  EXPECT_EQ(decoded.eventCount(), 6U);
+  EXPECT_EQ(decoded.back().id, 5U);
+  EXPECT_FALSE(
+      decoded.deserialize(encoded.substr(0, encoded.size() - 1), last_event_id)
+          .ok());
+
+  // The oldest batches are removed as a whole.
+  auto removed = index.removeBatches(2);
+  EXPECT_EQ(removed.size(), 2U);
+  EXPECT_EQ(removed.eventCount(), 3U);
+  EXPECT_EQ(index.front().id, 3U);
+
+  removed = index.removeUntil(25);
+  EXPECT_EQ(removed.eventCount(), 2U);
+  EXPECT_EQ(index.size(), 1U);
+  EXPECT_EQ(index.front().id, 5U);
+
+  index.removeUntil(30);
+  EXPECT_TRUE(index.empty());
+  EXPECT_EQ(index.size(), 0U);
+}
+
+TEST_F(EventSubscriberPluginTests, generateEventDataIndexFromSavedIndex) {
+  MockedOsqueryDatabase mocked_database;
+  mocked_database.generateEvents("type", "name");
+
+  EventSubscriberPlugin::Context context;
+  EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
+  auto status =
+      EventSubscriberPlugin::generateEventDataIndex(context, mocked_database);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(context.event_index.size(), 10U);
+  status = EventSubscriberPlugin::saveEventDataIndex(context, mocked_database);
+  ASSERT_TRUE(status.ok());
+
+  // Events without a saved entry are still read, removed events are skipped.
+  auto added_key =
+      EventSubscriberPlugin::databaseKeyForEventId(context, 100, 20);
+  mocked_database.key_map[added_key] = "{\"time\":\"100\",\"eid\":\"20\"}";
+  auto removed_key =
+      EventSubscriberPlugin::databaseKeyForEventId(context, 0, 1);
+  ASSERT_EQ(mocked_database.key_map.erase(removed_key), 1U);
+
+  mocked_database.record_read_count = 0U;
+  EventSubscriberPlugin::Context restarted;
+  EventSubscriberPlugin::setDatabaseNamespace(restarted, "type", "name");
+  status =
+      EventSubscriberPlugin::generateEventDataIndex(restarted, mocked_database);
+  ASSERT_TRUE(status.ok());
+
+  // Records are scanned with their keys, none are read one at a time.
+  EXPECT_EQ(restarted.event_index.size(), 10U);
+  EXPECT_EQ(restarted.event_index.front().time, 1U);
+  EXPECT_EQ(restarted.event_index.back().id, 20U);
+  EXPECT_EQ(mocked_database.record_read_count, 0U);
+}
+
+TEST_F(EventSubscriberPluginTests, generateEventDataIndexFromCheckpoint) {
+  auto interval = FLAGS_events_index_checkpoint_interval;
+  FLAGS_events_index_checkpoint_interval = 300;
+
+  MockedOsqueryDatabase mocked_database;
+  EventSubscriberPlugin::Context context;
+  EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
+  auto addEvent = [&](EventTime time, EventID eid) {
+    auto key = EventSubscriberPlugin::databaseKeyForEventId(context, time, eid);
+    mocked_database.key_map[key] = "{\"time\":\"" + std::to_string(time) +
+                                   "\",\"eid\":\"" + std::to_string(eid) +
+                                   "\"}";
+  };
+  addEvent(100, 1);
+  addEvent(200, 2);
+  addEvent(3600, 3);
+
+  auto status =
+      EventSubscriberPlugin::generateEventDataIndex(context, mocked_database);
+  ASSERT_TRUE(status.ok());
+  status = EventSubscriberPlugin::saveEventDataIndex(context, mocked_database);
+  ASSERT_TRUE(status.ok());
+  EXPECT_GT(context.last_index_save, 0U);
+
+  // Events stored after the checkpoint near the newest saved event are read,
+  // the buckets of older saved events are not.
+  addEvent(3590, 4);
+  addEvent(3700, 5);
+  addEvent(300, 6);
+
+  auto restart = [&mocked_database](EventTime expire_before = 0U) {
+    EventSubscriberPlugin::Context restarted;
+    EventSubscriberPlugin::setDatabaseNamespace(restarted, "type", "name");
+    EXPECT_TRUE(EventSubscriberPlugin::generateEventDataIndex(
+                    restarted, mocked_database, expire_before)
+                    .ok());
+    std::vector<EventID> ids;
+    for (const auto& entry : restarted.event_index) {
+      ids.push_back(entry.id);
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+  };
+
+  auto ids = restart();
+  EXPECT_EQ(ids, std::vector<EventID>({1, 2, 3, 4, 5}));
+
+  // Saved events of buckets before the expiry horizon are dropped, with
+  // their records.
+  ids = restart(150);
+  EXPECT_EQ(ids, std::vector<EventID>({2, 3, 4, 5}));
+  auto expired_key =
+      EventSubscriberPlugin::databaseKeyForEventId(context, 100, 1);
+  EXPECT_EQ(mocked_database.key_map.count(expired_key), 0U);
+
+  // Without checkpoints every record is read.
+  FLAGS_events_index_checkpoint_interval = 0;
+  ids = restart();
+  FLAGS_events_index_checkpoint_interval = interval;
+  EXPECT_EQ(ids, std::vector<EventID>({2, 3, 4, 5, 6}));
+}
+
+TEST_F(EventSubscriberPluginTests, eventRecordColumns) {
+  EventRecordColumns columns;
+  Row row = {{"path", "/bin/ls"}, {"pid", "100"}, {"cmdline", ""}};
+
+  std::string record;
+  columns.encode(row, record);
+  EXPECT_TRUE(isEventRecordBinary(record));
+  EXPECT_EQ(columns.size(), 3U);
+
+  // Encoding the same columns again does not grow the dictionary.
+  std::string other_record;
+  columns.encode({{"pid", "101"}}, other_record);
+  EXPECT_EQ(columns.size(), 3U);
+
+  std::string encoded;
+  EXPECT_EQ(columns.serialize(encoded), 3U);
+
+  EventRecordColumns restored;
+  ASSERT_TRUE(restored.deserialize(encoded).ok());
+
+  Row decoded;
+  ASSERT_TRUE(restored.decode(record, decoded).ok());
+  EXPECT_EQ(decoded, row);
+
+  decoded.clear();
+  ASSERT_TRUE(restored.decode(other_record, decoded).ok());
+  EXPECT_EQ(decoded, Row({{"pid", "101"}}));
+
+  // Truncated records and records using unknown columns are rejected.
+  EXPECT_FALSE(
+      restored.decode(record.substr(0, record.size() - 1), decoded).ok());
+  EXPECT_FALSE(EventRecordColumns().decode(record, decoded).ok());
+  EXPECT_FALSE(restored.deserialize(encoded.substr(0, 4)).ok());
+  EXPECT_FALSE(isEventRecordBinary("{\"pid\":\"100\"}"));
+}
+
+TEST_F(EventSubscriberPluginTests, generateRowsFromBinaryRecords) {
+  MockedOsqueryDatabase mocked_database;
+  mocked_database.generateEvents("type", "name");
+
+  // Add binary records next to the JSON records from an earlier version.
+  EventSubscriberPlugin::Context writer;
+  EventSubscriberPlugin::setDatabaseNamespace(writer, "type", "name");
+  writer.last_event_id = 100U;
+  for (std::size_t i = 10U; i < 15U; ++i) {
+    auto event_id = EventSubscriberPlugin::generateEventIdentifier(writer);
+    Row row = {{"time", std::to_string(i)},
+               {"eid", EventSubscriberPlugin::toIndex(event_id)},
+               {"value", "binary"}};
+
+    std::string record;
+    writer.columns.encode(row, record);
+    auto key =
+        EventSubscriberPlugin::databaseKeyForEventId(writer, i, event_id);
+    mocked_database.key_map.insert({key, std::move(record)});
+  }
+
+  std::string columns;
+  writer.columns.serialize(columns);
+  mocked_database.key_map.insert(
+      {EventSubscriberPlugin::databaseKeyForColumns(writer), columns});
+
+  EventSubscriberPlugin::Context context;
+  EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
+  auto status =
+      EventSubscriberPlugin::generateEventDataIndex(context, mocked_database);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(context.event_index.size(), 15U);
+  EXPECT_EQ(context.saved_columns, 3U);
+
+  std::size_t json_count{0U};
+  std::size_t binary_count{0U};
+  auto callback = [&json_count, &binary_count](Row row) {
+    if (row["value"] == "binary") {
+      ++binary_count;
+    } else if (row["key1"] == "value1") {
+      ++json_count;
+    }
+  };
+
+  EventSubscriberPlugin::generateRows(
+      context, mocked_database, callback, 0, 0);
+  EXPECT_EQ(json_count, 10U);
+  EXPECT_EQ(binary_count, 5U);
+}
+
+TEST_F(EventSubscriberPluginTests, eventColumnIndex) {
+  EventColumnIndex index;
+  index.setColumns({"pid", "path"});
+  index.add(1, {{"pid", "10"}, {"path", "/etc/passwd"}});
+  index.add(2, {{"pid", "20"}, {"path", "/ETC/hosts"}});
+  index.add(3, {{"pid", "10"}, {"path", "/tmp/file"}});
+  index.add(4, {{"pid", "30"}});
+  EXPECT_EQ(index.valueCount(), 6U);
+
+  // Constraints on other columns cannot be answered.
+  EXPECT_FALSE(index.filter({{"cmdline", {{"ls"}, {}}}}).has_value());
+
+  auto filter = index.filter({{"pid", {{"10", "30.0"}, {}}}});
+  ASSERT_TRUE(filter.has_value());
+  EXPECT_EQ(filter->ids, std::vector<EventID>({1, 3, 4}));
+
+  // Prefixes match without case, like LIKE.
+  filter = index.filter({{"path", {{}, {"/etc/"}}}});
+  ASSERT_TRUE(filter.has_value());
+  EXPECT_EQ(filter->ids, std::vector<EventID>({1, 2}));
+
+  // Constraints on several columns must all match.
+  filter = index.filter({{"pid", {{"10"}, {}}}, {"path", {{}, {"/etc/"}}}});
+  ASSERT_TRUE(filter.has_value());
+  EXPECT_EQ(filter->ids, std::vector<EventID>({1}));
+
+  // Events that were not indexed always match.
+  index.setFirstIndexedId(2);
+  filter = index.filter({{"pid", {{"99"}, {}}}});
+  ASSERT_TRUE(filter.has_value());
+  EXPECT_TRUE(filter->ids.empty());
+  EXPECT_TRUE(filter->matches(1));
+  EXPECT_FALSE(filter->matches(2));
+
+  EventIndex removed;
+  removed.add(100, 1);
+  removed.add(100, 2);
+  index.remove(removed);
+  EXPECT_EQ(index.valueCount(), 3U);
+  filter = index.filter({{"path", {{}, {"/"}}}});
+  ASSERT_TRUE(filter.has_value());
+  EXPECT_EQ(filter->ids, std::vector<EventID>({3}));
+}
+
+TEST_F(EventSubscriberPluginTests, eventAggregator) {
+  EventAggregator aggregator;
+
+  // Without a window every row is stored.
+  auto rows = aggregator.add({{{"pid", "1"}}, {{"pid", "1"}}}, 100);
+  ASSERT_EQ(rows.size(), 2U);
+  EXPECT_EQ(rows[0]["count"], "1");
+  EXPECT_EQ(rows[0]["first_time"], "100");
+  EXPECT_EQ(rows[0]["last_time"], "100");
+
+  aggregator.configure(60, "pid, remote_port");
+  EXPECT_TRUE(aggregator.enabled());
+
+  rows = aggregator.add({{{"pid", "1"}, {"remote_port", "443"}},
+                         {{"pid", "1"}, {"remote_port", "443"}},
+                         {{"pid", "1"}, {"remote_port", "80"}}},
+                        100);
+  EXPECT_TRUE(rows.empty());
+
+  rows = aggregator.add({{{"pid", "1"}, {"remote_port", "443"}},
+                         {{"pid", "2"}, {"remote_port", "443"}}},
+                        130);
+  EXPECT_TRUE(rows.empty());
+  EXPECT_EQ(aggregator.size(), 3U);
+
+  // The groups opened at 100 close at 160.
+  EXPECT_TRUE(aggregator.flush(159).empty());
+  rows = aggregator.flush(160);
+  ASSERT_EQ(rows.size(), 2U);
+  EXPECT_EQ(rows[0]["remote_port"], "443");
+  EXPECT_EQ(rows[0]["count"], "3");
+  EXPECT_EQ(rows[0]["first_time"], "100");
+  EXPECT_EQ(rows[0]["last_time"], "130");
+  EXPECT_EQ(rows[1]["remote_port"], "80");
+  EXPECT_EQ(rows[1]["count"], "1");
+
+  // Adding rows also stores the groups whose window closed.
+  rows = aggregator.add({{{"pid", "1"}, {"remote_port", "443"}}}, 200);
+  ASSERT_EQ(rows.size(), 1U);
+  EXPECT_EQ(rows[0]["pid"], "2");
+  EXPECT_EQ(aggregator.size(), 1U);
+
+  rows = aggregator.flushAll();
+  ASSERT_EQ(rows.size(), 1U);
+  EXPECT_EQ(rows[0]["first_time"], "200");
+  EXPECT_EQ(aggregator.size(), 0U);
+}
+
+TEST_F(EventSubscriberPluginTests, generateRowsWithColumnIndex) {
+  MockedOsqueryDatabase mocked_database;
+  mocked_database.generateEvents("type", "name");
+
+  EventSubscriberPlugin::Context context;
+  EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
+  context.column_index.setColumns({"pid"});
+  auto status =
+      EventSubscriberPlugin::generateEventDataIndex(context, mocked_database);
+  ASSERT_TRUE(status.ok());
+
+  DatabaseStringValueList database_data;
+  EventIndex stored_batches;
+  std::vector<std::string> pids = {"10", "20", "10", "300"};
+  for (std::size_t i = 0U; i < pids.size(); ++i) {
+    auto event_id = EventSubscriberPlugin::generateEventIdentifier(context);
+    Row row = {{"time", std::to_string(10U + i)},
+               {"eid", EventSubscriberPlugin::toIndex(event_id)},
+               {"pid", pids[i]}};
+    EventSubscriberPlugin::addEventRecord(
+        context, database_data, stored_batches, 10U + i, event_id, row);
+  }
+  for (auto& data : database_data) {
+    mocked_database.key_map.insert(std::move(data));
+  }
+  context.event_index.merge(stored_batches);
+
+  std::size_t indexed_count{0U};
+  std::size_t callback_count{0U};
+  auto callback = [&indexed_count, &callback_count](Row row) {
+    ++callback_count;
+    if (row.count("pid") > 0) {
+      ++indexed_count;
+    }
+  };
+
+  // The events stored before the index was created are still read.
+  auto filter = context.column_index.filter({{"pid", {{"10"}, {}}}});
+  ASSERT_TRUE(filter.has_value());
+  mocked_database.record_read_count = 0U;
+  auto last = EventSubscriberPlugin::generateRows(
+      context, mocked_database, callback, 0, 0, 0, &*filter);
+  EXPECT_EQ(callback_count, 12U);
+  EXPECT_EQ(indexed_count, 2U);
+  EXPECT_EQ(mocked_database.record_read_count, 12U);
+
+  // The last event in the range is returned even if it was not read.
+  ASSERT_TRUE(last.has_value());
+  EXPECT_EQ(last->time, 13U);
+
+  filter = context.column_index.filter({{"pid", {{}, {"3"}}}});
+  ASSERT_TRUE(filter.has_value());
+  callback_count = indexed_count = 0U;
+  EventSubscriberPlugin::generateRows(
+      context, mocked_database, callback, 10, 0, 0, &*filter);
+  EXPECT_EQ(callback_count, 1U);
+  EXPECT_EQ(indexed_count, 1U);
+
+  // Expired events are removed from the column index.
+  EventSubscriberPlugin::expireEventBatches(context, mocked_database, 10, 21);
+  EXPECT_EQ(context.column_index.valueCount(), 2U);
+}
+
+TEST_F(EventSubscriberPluginTests, eventMemoryStore) {
+  EventMemoryStore store(3);
+
+  BufferedEventList events;
+  for (EventID i = 1U; i <= 4U; ++i) {
+    events.push_back({i * 10, i, {{"eid", std::to_string(i)}}});
+  }
+
+  // The oldest event does not fit and is handed back.
+  auto evicted = store.add(std::move(events));
+  ASSERT_EQ(evicted.size(), 1U);
+  EXPECT_EQ(evicted[0].id, 1U);
+  EXPECT_EQ(store.size(), 3U);
+
+  std::vector<Row> rows;
+  auto callback = [&rows](Row row) { rows.push_back(std::move(row)); };
+  EventTime last_time{0U};
+  EventID last_eid{0U};
+  EXPECT_TRUE(store.generateRows(callback, 25, 0, 0, last_time, last_eid));
+  ASSERT_EQ(rows.size(), 2U);
+  EXPECT_EQ(rows[0]["eid"], "3");
+  EXPECT_EQ(last_time, 40U);
+  EXPECT_EQ(last_eid, 4U);
+
+  // Events at or before the optimized identifier are skipped.
+  rows.clear();
+  EXPECT_FALSE(store.generateRows(callback, 0, 0, 4, last_time, last_eid));
+  EXPECT_TRUE(rows.empty());
+
+  store.expire(20);
+  EXPECT_EQ(store.size(), 2U);
+
+  auto drained = store.drain();
+  ASSERT_EQ(drained.size(), 2U);
+  EXPECT_EQ(drained[0].id, 3U);
+  EXPECT_EQ(store.size(), 0U);
+}
+
+TEST_F(EventSubscriberPluginTests, eventQueue) {
+  // The capacity is rounded up to a power of two.
+  EventQueue queue("queue", 3);
+  EXPECT_EQ(queue.capacity(), 4U);
+
+  auto callback = std::make_shared<const EventCallback>(
+      [](const EventContextRef&, const SubscriptionContextRef&) {
+        return Status::success();
+      });
+  for (EventContextID i = 0; i < 5; ++i) {
+    auto ec = std::make_shared<EventContext>();
+    ec->id = i;
+    EXPECT_EQ(queue.push({callback, ec, nullptr}), i < 4);
+  }
+  EXPECT_EQ(queue.size(), 4U);
+  EXPECT_EQ(queue.dropped(), 1U);
+
+  // Events are removed in the order they were pushed.
+  QueuedEvent event;
+  for (EventContextID i = 0; i < 4; ++i) {
+    ASSERT_TRUE(queue.pop(event, std::chrono::milliseconds(0)));
+    EXPECT_EQ(event.ec->id, i);
+  }
+  EXPECT_FALSE(queue.pop(event, std::chrono::milliseconds(10)));
+
+  // The consumer thread runs the callbacks of events pushed from many threads.
+  std::atomic<size_t> called{0};
+  auto counter = std::make_shared<const EventCallback>(
+      [&called](const EventContextRef&, const SubscriptionContextRef&) {
+        called++;
+        return Status::success();
+      });
+
+  EventQueue consumed("consumed", 1024);
+  consumed.start();
+  std::vector<std::thread> producers;
+  for (size_t i = 0; i < 4; ++i) {
+    producers.emplace_back([&consumed, &counter]() {
+      for (size_t j = 0; j < 100; ++j) {
+        consumed.push({counter, nullptr, nullptr});
+      }
+    });
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+
+  // Stopping runs the events that are still queued.
+  consumed.stop();
+  EXPECT_EQ(called + consumed.dropped(), 400U);
+  EXPECT_EQ(consumed.size(), 0U);
+}
+
+TEST_F(EventSubscriberPluginTests, eventQueuePolicies) {
+  auto callback = std::make_shared<const EventCallback>(
+      [](const EventContextRef&, const SubscriptionContextRef&) {
+        return Status::success();
+      });
+  auto push = [&callback](EventQueue& queue, EventContextID id) {
+    auto ec = std::make_shared<EventContext>();
+    ec->id = id;
+    return queue.push({callback, ec, nullptr});
+  };
+
+  // A full queue drops its oldest events.
+  EventQueue oldest("oldest", 4, EventQueuePolicy::DropOldest);
+  for (EventContextID i = 0; i < 6; ++i) {
+    EXPECT_TRUE(push(oldest, i));
+  }
+  EXPECT_EQ(oldest.dropped(), 2U);
+
+  QueuedEvent event;
+  for (EventContextID i = 2; i < 6; ++i) {
+    ASSERT_TRUE(oldest.pop(event, std::chrono::milliseconds(0)));
+    EXPECT_EQ(event.ec->id, i);
+  }
+
+  // A half full queue keeps one out of every eight events.
+  EventQueue sampled("sampled", 32, EventQueuePolicy::Sample);
+  for (EventContextID i = 0; i < 32; ++i) {
+    push(sampled, i);
+  }
+  EXPECT_EQ(sampled.size(), 18U);
+  EXPECT_EQ(sampled.dropped(), 14U);
+
+  // Producers only wait while a consumer runs.
+  EventQueue blocked("blocked", 2, EventQueuePolicy::Block);
+  EXPECT_TRUE(push(blocked, 0));
+  EXPECT_TRUE(push(blocked, 1));
+  EXPECT_FALSE(push(blocked, 2));
+  EXPECT_EQ(blocked.dropped(), 1U);
+
+  std::atomic<size_t> called{0};
+  auto slow = std::make_shared<const EventCallback>(
+      [&called](const EventContextRef&, const SubscriptionContextRef&) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        called++;
+        return Status::success();
+      });
+  EventQueue waited("waited", 2, EventQueuePolicy::Block);
+  waited.start();
+  for (size_t i = 0; i < 20; ++i) {
+    EXPECT_TRUE(waited.push({slow, nullptr, nullptr}));
+  }
+  waited.stop();
+  EXPECT_EQ(called, 20U);
+  EXPECT_EQ(waited.dropped(), 0U);
+  EXPECT_GT(waited.callbackTime(), 0U);
 }
 
 class FakeEventSubscriberPlugin : public EventSubscriberPlugin {
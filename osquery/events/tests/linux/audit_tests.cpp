@@ -70,10 +70,34 @@ TEST_F(AuditTests, test_handle_reply) {
   EXPECT_EQ("1440542781.644:403030", audit_event_record.audit_id);
   EXPECT_EQ(audit_event_record.fields.size(), 4U);
   EXPECT_EQ(audit_event_record.fields.count("argc"), 1U);
-  EXPECT_EQ(audit_event_record.fields["argc"], "3");
-  EXPECT_EQ(audit_event_record.fields["a0"], "\"H=1 \"");
-  EXPECT_EQ(audit_event_record.fields["a1"], "\"/bin/sh\"");
-  EXPECT_EQ(audit_event_record.fields["a2"], "c");
+  EXPECT_EQ(audit_event_record.fields.at("argc"), "3");
+  EXPECT_EQ(audit_event_record.fields.at("a0"), "\"H=1 \"");
+  EXPECT_EQ(audit_event_record.fields.at("a1"), "\"/bin/sh\"");
+  EXPECT_EQ(audit_event_record.fields.at("a2"), "c");
+}
+
+TEST_F(AuditTests, test_get_audit_serial) {
+  auto make_reply = [](const std::string& message) {
+    struct audit_reply reply {};
+    reply.msg.nlh.nlmsg_len = static_cast<std::uint32_t>(message.size());
+    memcpy(reply.msg.data, message.c_str(), message.size());
+    return reply;
+  };
+
+  auto reply =
+      make_reply("audit(1440542781.644:403030): argc=3 a0=\"H=1 \" a1=c");
+  EXPECT_EQ(AuditdNetlinkParser::GetAuditSerial(reply), 403030U);
+
+  // Records of the same event share the serial number.
+  reply = make_reply("audit(1440542781.644:403030): item=0 name=\"/bin/sh\"");
+  EXPECT_EQ(AuditdNetlinkParser::GetAuditSerial(reply), 403030U);
+
+  // Replies that are not event records all use the first parser.
+  reply = make_reply("enabled=1 failure=1");
+  EXPECT_EQ(AuditdNetlinkParser::GetAuditSerial(reply), 0U);
+
+  reply = make_reply("audit(1440542781.644");
+  EXPECT_EQ(AuditdNetlinkParser::GetAuditSerial(reply), 0U);
 }
 
 TEST_F(AuditTests, test_audit_value_decode) {
@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "bpftestsmain.h"
+
+#include <osquery/events/linux/bpf/bpfeventfilter.h>
+
+namespace osquery {
+
+namespace {
+
+const std::string kValidExclusions{R"json(
+{
+  "uids": [ 998 ],
+  "cgroup_ids": [ 1234 ],
+  "paths": [ "/usr/sbin/chronyd", "/usr/lib/systemd/%" ],
+  "names": [ "sshd" ]
+}
+)json"};
+
+ISystemStateTracker::Event generateEvent(const std::string& binary_path) {
+  ISystemStateTracker::Event event;
+  event.type = ISystemStateTracker::Event::Type::Exec;
+  event.binary_path = binary_path;
+  event.bpf_header.user_id = 1000;
+  event.bpf_header.cgroup_id = 1;
+
+  return event;
+}
+
+} // namespace
+
+TEST_F(BPFEventFilterTests, parse) {
+  auto doc = JSON::newObject();
+  ASSERT_TRUE(doc.fromString(kValidExclusions).ok());
+
+  BPFEventFilter filter;
+  ASSERT_TRUE(BPFEventFilter::parse(filter, doc.doc()).ok());
+
+  EXPECT_EQ(filter.uid_set.count(998U), 1U);
+  EXPECT_EQ(filter.cgroup_id_set.count(1234U), 1U);
+  EXPECT_EQ(filter.path_set.count("/usr/sbin/chronyd"), 1U);
+  ASSERT_EQ(filter.path_prefix_list.size(), 1U);
+  EXPECT_EQ(filter.path_prefix_list.front(), "/usr/lib/systemd/");
+  EXPECT_EQ(filter.name_set.count("sshd"), 1U);
+
+  // A single invalid entry discards the whole configuration
+  ASSERT_TRUE(doc.fromString(R"json({ "uids": [ 0 ], "names": [ 1 ] })json")
+                  .ok());
+
+  EXPECT_FALSE(BPFEventFilter::parse(filter, doc.doc()).ok());
+  EXPECT_TRUE(filter.empty());
+
+  ASSERT_TRUE(doc.fromString(R"json({ "uids": [ -1 ] })json").ok());
+  EXPECT_FALSE(BPFEventFilter::parse(filter, doc.doc()).ok());
+  EXPECT_TRUE(filter.empty());
+}
+
+TEST_F(BPFEventFilterTests, excluded) {
+  auto doc = JSON::newObject();
+  ASSERT_TRUE(doc.fromString(kValidExclusions).ok());
+
+  BPFEventFilter filter;
+  ASSERT_TRUE(BPFEventFilter::parse(filter, doc.doc()).ok());
+  EXPECT_FALSE(filter.empty());
+
+  EXPECT_FALSE(filter.excluded(generateEvent("/usr/bin/bash")));
+  EXPECT_FALSE(filter.excluded(generateEvent("")));
+
+  EXPECT_TRUE(filter.excluded(generateEvent("/usr/sbin/chronyd")));
+  EXPECT_FALSE(filter.excluded(generateEvent("/usr/sbin/chronyd2")));
+
+  EXPECT_TRUE(filter.excluded(generateEvent("/usr/lib/systemd/systemd")));
+  EXPECT_FALSE(filter.excluded(generateEvent("/usr/lib/systemd")));
+
+  EXPECT_TRUE(filter.excluded(generateEvent("/usr/sbin/sshd")));
+  EXPECT_FALSE(filter.excluded(generateEvent("/usr/sbin/sshd-keygen")));
+
+  auto event = generateEvent("/usr/bin/bash");
+  event.bpf_header.user_id = 998;
+  EXPECT_TRUE(filter.excluded(event));
+
+  event = generateEvent("/usr/bin/bash");
+  event.bpf_header.cgroup_id = 1234;
+  EXPECT_TRUE(filter.excluded(event));
+
+  EXPECT_TRUE(BPFEventFilter().empty());
+}
+
+} // namespace osquery
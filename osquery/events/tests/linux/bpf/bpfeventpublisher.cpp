@@ -72,8 +72,107 @@ IProcessContextFactory::Ref getMockedProcessContextFactory() {
   return IProcessContextFactory::Ref(new MockedProcessContextFactory);
 }
 
+tob::ebpfpub::IFunctionTracer::Event getTimedBPFEvent(
+    std::uint64_t timestamp, std::uint64_t identifier) {
+  auto bpf_event = kBaseBPFEvent;
+  bpf_event.identifier = identifier;
+  bpf_event.header.timestamp = timestamp;
+  return bpf_event;
+}
+
+/// The (timestamp, identifier) pairs of a merged event list
+std::vector<std::pair<std::uint64_t, std::uint64_t>> getMergedEventKeys(
+    const std::vector<tob::ebpfpub::IFunctionTracer::Event>& event_list) {
+  std::vector<std::pair<std::uint64_t, std::uint64_t>> keys;
+  for (const auto& event : event_list) {
+    keys.push_back({event.header.timestamp, event.identifier});
+  }
+  return keys;
+}
+
 } // namespace
 
+TEST_F(BPFEventPublisherTests, mergeEvents_ordering) {
+  std::vector<std::vector<tob::ebpfpub::IFunctionTracer::Event>> event_lists(
+      3U);
+
+  event_lists[0].push_back(getTimedBPFEvent(10U, 1U));
+  event_lists[0].push_back(getTimedBPFEvent(40U, 2U));
+  event_lists[0].push_back(getTimedBPFEvent(70U, 3U));
+
+  event_lists[1].push_back(getTimedBPFEvent(20U, 4U));
+  event_lists[1].push_back(getTimedBPFEvent(30U, 5U));
+
+  event_lists[2].push_back(getTimedBPFEvent(5U, 6U));
+  event_lists[2].push_back(getTimedBPFEvent(50U, 7U));
+  event_lists[2].push_back(getTimedBPFEvent(60U, 8U));
+  event_lists[2].push_back(getTimedBPFEvent(80U, 9U));
+
+  auto merged_event_list = BPFEventPublisher::mergeEvents(event_lists);
+
+  std::vector<std::pair<std::uint64_t, std::uint64_t>> expected_keys = {
+      {5U, 6U},
+      {10U, 1U},
+      {20U, 4U},
+      {30U, 5U},
+      {40U, 2U},
+      {50U, 7U},
+      {60U, 8U},
+      {70U, 3U},
+      {80U, 9U}};
+
+  EXPECT_EQ(getMergedEventKeys(merged_event_list), expected_keys);
+
+  // Empty readers are skipped
+  event_lists[1].clear();
+  event_lists.emplace_back();
+
+  merged_event_list = BPFEventPublisher::mergeEvents(event_lists);
+  EXPECT_EQ(merged_event_list.size(), 7U);
+
+  // A single reader is returned as is
+  merged_event_list =
+      BPFEventPublisher::mergeEvents({std::move(event_lists[2])});
+
+  expected_keys = {{5U, 6U}, {50U, 7U}, {60U, 8U}, {80U, 9U}};
+  EXPECT_EQ(getMergedEventKeys(merged_event_list), expected_keys);
+
+  event_lists.assign(2U, {});
+  merged_event_list = BPFEventPublisher::mergeEvents(event_lists);
+  EXPECT_TRUE(merged_event_list.empty());
+}
+
+TEST_F(BPFEventPublisherTests, mergeEvents_same_timestamp) {
+  // Events with the same timestamp are distinct events, read by different
+  // readers or by the same one; none of them is dropped
+  std::vector<std::vector<tob::ebpfpub::IFunctionTracer::Event>> event_lists(
+      3U);
+
+  event_lists[0].push_back(getTimedBPFEvent(10U, 1U));
+  event_lists[0].push_back(getTimedBPFEvent(20U, 2U));
+  event_lists[0].push_back(getTimedBPFEvent(20U, 3U));
+
+  event_lists[1].push_back(getTimedBPFEvent(10U, 4U));
+  event_lists[1].push_back(getTimedBPFEvent(20U, 5U));
+
+  event_lists[2].push_back(getTimedBPFEvent(10U, 6U));
+  event_lists[2].push_back(getTimedBPFEvent(10U, 7U));
+
+  auto merged_event_list = BPFEventPublisher::mergeEvents(event_lists);
+
+  // Ties are ordered by reader, then by their order within the reader
+  std::vector<std::pair<std::uint64_t, std::uint64_t>> expected_keys = {
+      {10U, 1U},
+      {10U, 4U},
+      {10U, 6U},
+      {10U, 7U},
+      {20U, 2U},
+      {20U, 3U},
+      {20U, 5U}};
+
+  EXPECT_EQ(getMergedEventKeys(merged_event_list), expected_keys);
+}
+
 TEST_F(BPFEventPublisherTests, processForkEvent_and_processVforkEvent) {
   auto state_tracker_ref =
       SystemStateTracker::create(getMockedProcessContextFactory());
@@ -98,4 +98,10 @@ bool MockedProcessContextFactory::captureAllProcesses(
   return true;
 }
 
+bool MockedProcessContextFactory::enumerateProcesses(
+    std::vector<pid_t>& process_id_list) const {
+  process_id_list = {2};
+  return true;
+}
+
 } // namespace osquery
@@ -27,6 +27,9 @@ class MockedProcessContextFactory final : public IProcessContextFactory {
   virtual bool captureAllProcesses(
       ProcessContextMap& process_map) const override;
 
+  virtual bool enumerateProcesses(
+      std::vector<pid_t>& process_id_list) const override;
+
  private:
   mutable bool fail_next_request{false};
   mutable std::size_t invocation_count{false};
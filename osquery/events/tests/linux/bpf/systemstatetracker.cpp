@@ -217,6 +217,50 @@ TEST_F(SystemStateTrackerTests, create_process) {
   EXPECT_TRUE(std::holds_alternative<std::monostate>(fork_event2.data));
 }
 
+TEST_F(SystemStateTrackerTests, create_process_shares_fd_map) {
+  auto process_context_factory =
+      std::make_unique<MockedProcessContextFactory>();
+
+  auto bpf_event_header = kBaseBPFEventHeader;
+  bpf_event_header.process_id = 1001;
+
+  SystemStateTracker::Context context;
+  auto succeeded = SystemStateTracker::createProcess(
+      context,
+      *process_context_factory.get(),
+      bpf_event_header,
+      1000, // parent pid
+      bpf_event_header.process_id); // child pid
+
+  ASSERT_TRUE(succeeded);
+
+  // The child shares the file descriptors of the parent until one of them
+  // is changed
+  const auto& parent_process = context.process_map.at(1000);
+  const auto& child_process = context.process_map.at(1001);
+  EXPECT_TRUE(parent_process.fd_map.shared());
+  EXPECT_TRUE(child_process.fd_map.shared());
+
+  auto parent_fd_count = parent_process.fd_map.size();
+  ASSERT_EQ(parent_process.fd_map.count(2), 1U);
+
+  // Lookups do not copy the map
+  succeeded = SystemStateTracker::setWorkingDirectory(
+      context, *process_context_factory.get(), 1001, 2);
+
+  EXPECT_TRUE(succeeded);
+  EXPECT_TRUE(child_process.fd_map.shared());
+
+  succeeded = SystemStateTracker::closeHandle(
+      context, *process_context_factory.get(), 1001, 2);
+
+  EXPECT_TRUE(succeeded);
+  EXPECT_EQ(child_process.fd_map.count(2), 0U);
+  EXPECT_EQ(parent_process.fd_map.count(2), 1U);
+  EXPECT_EQ(parent_process.fd_map.size(), parent_fd_count);
+  EXPECT_FALSE(parent_process.fd_map.shared());
+}
+
 TEST_F(SystemStateTrackerTests, execute_binary_with_absolute_path) {
   auto bpf_event_header = kBaseBPFEventHeader;
   bpf_event_header.process_id = 1001;
@@ -1455,6 +1499,36 @@ TEST_F(SystemStateTrackerTests, expireProcessContexts) {
   EXPECT_EQ(context.process_map.size(), 1U);
 }
 
+TEST_F(SystemStateTrackerTests, capturePendingProcesses) {
+  auto process_context_factory =
+      std::make_unique<MockedProcessContextFactory>();
+
+  SystemStateTracker::Context context;
+  context.pending_process_id_list = {1002, 1001, 1000, 2};
+
+  // pid 1000 has already been captured by an event, and is skipped
+  context.process_map.insert({1000, ProcessContext{}});
+
+  auto capture_count = SystemStateTracker::capturePendingProcesses(
+      context, *process_context_factory.get(), 2U);
+
+  EXPECT_EQ(capture_count, 2U);
+  EXPECT_EQ(process_context_factory->invocationCount(), 2U);
+  EXPECT_EQ(context.pending_process_id_list.size(), 1U);
+  EXPECT_EQ(context.process_map.size(), 3U);
+  EXPECT_EQ(context.process_map.count(2), 1U);
+  EXPECT_EQ(context.process_map.count(1001), 1U);
+  EXPECT_TRUE(context.process_map.at(1000).binary_path.empty());
+
+  // Processes that can no longer be captured are dropped
+  capture_count = SystemStateTracker::capturePendingProcesses(
+      context, *process_context_factory.get(), 2U);
+
+  EXPECT_EQ(capture_count, 1U);
+  EXPECT_TRUE(context.pending_process_id_list.empty());
+  EXPECT_EQ(context.process_map.size(), 3U);
+}
+
 TEST_F(SystemStateTrackerTests, parseSocketAddress) {
   static const std::uint16_t kUnspecFamily{AF_UNSPEC};
 
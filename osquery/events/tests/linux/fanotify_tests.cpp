@@ -0,0 +1,70 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <gtest/gtest.h>
+
+#include <osquery/events/linux/fanotify.h>
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+class FanotifyTests : public testing::Test {};
+
+TEST_F(FanotifyTests, test_fanotify_match_path) {
+  // A single file.
+  EXPECT_TRUE(
+      FanotifyEventPublisher::matchesPath("/etc/passwd", "/etc/passwd"));
+  EXPECT_FALSE(
+      FanotifyEventPublisher::matchesPath("/etc/passwd", "/etc/passwd-"));
+
+  // The files of a directory, and the directory.
+  EXPECT_TRUE(FanotifyEventPublisher::matchesPath("/etc/", "/etc/hosts"));
+  EXPECT_TRUE(FanotifyEventPublisher::matchesPath("/etc/", "/etc"));
+  EXPECT_FALSE(
+      FanotifyEventPublisher::matchesPath("/etc/", "/etc/ssh/sshd_config"));
+
+  // A wildcard within one path component.
+  EXPECT_TRUE(FanotifyEventPublisher::matchesPath("/etc/*.conf",
+                                                  "/etc/resolv.conf"));
+  EXPECT_FALSE(FanotifyEventPublisher::matchesPath("/etc/*.conf",
+                                                   "/etc/ld.so.conf.d/a.conf"));
+  EXPECT_TRUE(FanotifyEventPublisher::matchesPath("/home/*/.ssh/",
+                                                  "/home/user/.ssh/config"));
+
+  // Everything below a directory.
+  EXPECT_TRUE(FanotifyEventPublisher::matchesPath("/etc/**",
+                                                  "/etc/ssh/sshd_config"));
+  EXPECT_TRUE(FanotifyEventPublisher::matchesPath("/etc/**", "/etc"));
+  EXPECT_FALSE(FanotifyEventPublisher::matchesPath("/etc/**", "/etcd/a"));
+  EXPECT_TRUE(FanotifyEventPublisher::matchesPath("/home/*/**",
+                                                  "/home/user/a/b/c"));
+}
+
+TEST_F(FanotifyTests, test_fanotify_mark_path) {
+  auto root = fs::temp_directory_path() /
+              fs::unique_path("osquery.tests.%%%%.%%%%");
+  fs::create_directories(root / "a");
+
+  auto base = root.string();
+  EXPECT_EQ(FanotifyEventPublisher::getMarkPath(base + "/a/file"),
+            base + "/a/");
+  EXPECT_EQ(FanotifyEventPublisher::getMarkPath(base + "/a/**"), base + "/a/");
+  EXPECT_EQ(FanotifyEventPublisher::getMarkPath(base + "/*/file"), base + "/");
+
+  // Missing directories are marked through their existing parent.
+  EXPECT_EQ(FanotifyEventPublisher::getMarkPath(base + "/b/c/file"), base);
+
+  fs::remove_all(root);
+}
+
+} // namespace osquery
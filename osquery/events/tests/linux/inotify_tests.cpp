@@ -551,4 +551,83 @@ TEST_F(INotifyTests, test_inotify_embedded_wildcards) {
   ASSERT_EQ(event_pub_->numDescriptors(), 1U);
   EXPECT_EQ(event_pub_->path_descriptors_.count(real_test_dir + "/2/1/"), 1U);
 }
+
+TEST_F(INotifyTests, test_inotify_recursive_monitor) {
+  event_pub_ = std::make_shared<INotifyEventPublisher>(true);
+  ASSERT_TRUE(event_pub_->setUp().ok());
+
+  // Several branches, so that the walk is shared between threads.
+  std::vector<std::string> directories;
+  for (const auto& branch : {"a", "b", "c"}) {
+    for (const auto& leaf : {"1", "2"}) {
+      auto directory = real_test_dir + "/" + branch + "/" + leaf;
+      fs::create_directories(directory);
+      directories.push_back(real_test_dir + "/" + branch + "/");
+      directories.push_back(directory + "/");
+    }
+  }
+
+  // A link back to the root must not be walked again.
+  fs::create_directory_symlink(real_test_dir, real_test_dir + "/a/1/root");
+
+  addMonitor(real_test_dir + "/", IN_ALL_EVENTS, true, true);
+
+  EXPECT_EQ(event_pub_->path_descriptors_.count(real_test_dir + "/"), 1U);
+  for (const auto& directory : directories) {
+    EXPECT_EQ(event_pub_->path_descriptors_.count(directory), 1U) << directory;
+  }
+  EXPECT_EQ(event_pub_->path_descriptors_.size(), 10U);
+  EXPECT_EQ(event_pub_->numDescriptors(), 10U);
+
+  event_pub_->tearDown();
+}
+
+TEST_F(INotifyTests, test_inotify_exclude_path_trie) {
+  // The trie accepts the patterns of PathSet<patternedPath>.
+  std::vector<std::string> patterns = {"/osquery_missing/etc/ssh/%%",
+                                       "/osquery_missing/etc/",
+                                       "/osquery_missing/etc/ssl/openssl.cnf",
+                                       "/osquery_missing/var/%/log",
+                                       "/osquery_missing/home/%",
+                                       "/"};
+
+  PathTrie trie;
+  PathSet<patternedPath> set;
+  EXPECT_TRUE(trie.empty());
+  EXPECT_FALSE(trie.find("/osquery_missing/etc"));
+
+  for (const auto& pattern : patterns) {
+    trie.insert(pattern);
+    set.insert(pattern);
+  }
+  EXPECT_FALSE(trie.empty());
+
+  std::vector<std::pair<std::string, bool>> paths = {
+      {"/", true},
+      {"/osquery_missing", false},
+      {"/osquery_missing/etc", true},
+      {"/osquery_missing/etc/passwd", false},
+      {"/osquery_missing/etc/ssh", true},
+      {"/osquery_missing/etc/ssh/ssh_config", true},
+      {"/osquery_missing/etc/ssh/keys/host", true},
+      {"/osquery_missing/etc/ssl", false},
+      {"/osquery_missing/etc/ssl/openssl.cnf", true},
+      {"/osquery_missing/etc/ssl/certs", false},
+      {"/osquery_missing/var/lib/log", true},
+      {"/osquery_missing/var/lib/log/syslog", false},
+      {"/osquery_missing/var/log", false},
+      {"/osquery_missing/home", false},
+      {"/osquery_missing/home/user", true},
+      {"/osquery_missing/home/user/.ssh", true},
+  };
+
+  for (const auto& path : paths) {
+    EXPECT_EQ(trie.find(path.first), path.second) << path.first;
+    EXPECT_EQ(set.find(path.first), path.second) << path.first;
+  }
+
+  trie.clear();
+  EXPECT_TRUE(trie.empty());
+  EXPECT_FALSE(trie.find("/osquery_missing/etc"));
+}
 }
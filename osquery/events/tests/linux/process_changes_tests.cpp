@@ -0,0 +1,47 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/events/linux/process_changes.h>
+
+#include <gtest/gtest.h>
+
+namespace osquery {
+
+class ProcessChangesTests : public testing::Test {};
+
+TEST_F(ProcessChangesTests, test_take_changes) {
+  auto& changes = ProcessChanges::get();
+  std::set<std::uint64_t> pids;
+
+  // Nothing reports the execs, every process must be read.
+  changes.changed(1);
+  EXPECT_FALSE(changes.take(pids));
+  EXPECT_TRUE(pids.empty());
+
+  // The execs before a subscriber started are unknown.
+  changes.setTracked(true);
+  EXPECT_TRUE(changes.isTracked());
+  EXPECT_FALSE(changes.take(pids));
+
+  changes.changed(10);
+  changes.changed(20);
+  changes.changed(10);
+  EXPECT_TRUE(changes.take(pids));
+  EXPECT_EQ(pids, std::set<std::uint64_t>({10, 20}));
+
+  EXPECT_TRUE(changes.take(pids));
+  EXPECT_TRUE(pids.empty());
+
+  changes.setTracked(false);
+  EXPECT_FALSE(changes.isTracked());
+  changes.changed(30);
+  EXPECT_FALSE(changes.take(pids));
+}
+
+} // namespace osquery
@@ -152,6 +152,53 @@ TEST_F(SyslogTests, test_nonblockingfstream) {
   }
 }
 
+TEST_F(SyslogTests, test_nonblockingfstream_drain) {
+  auto pipe_path = test_working_dir_ / "pipe";
+  auto ret = mkfifo(pipe_path.string().c_str(), 0660);
+  ASSERT_EQ(ret, 0);
+
+  NonBlockingFStream nbfs(16);
+  auto s = nbfs.openReadOnly(pipe_path.string());
+  EXPECT_TRUE(s.ok());
+  EXPECT_FALSE(nbfs.wait(0));
+
+  auto fd = open(pipe_path.string().c_str(), O_WRONLY | O_NONBLOCK);
+  ASSERT_GT(fd, 0);
+
+  // Several lines and a partial line arrive in one write.
+  std::string fill = "one\ntwo\n\nthree";
+  auto bytes_written = write(fd, fill.data(), fill.size());
+  ASSERT_EQ(static_cast<ssize_t>(fill.size()), bytes_written);
+  ASSERT_TRUE(nbfs.wait(0));
+
+  std::string_view line;
+  EXPECT_FALSE(nbfs.nextLine(line));
+  EXPECT_TRUE(nbfs.fill().ok());
+  ASSERT_TRUE(nbfs.nextLine(line));
+  EXPECT_EQ("one", line);
+  ASSERT_TRUE(nbfs.nextLine(line));
+  EXPECT_EQ("two", line);
+  ASSERT_TRUE(nbfs.nextLine(line));
+  EXPECT_TRUE(line.empty());
+  EXPECT_FALSE(nbfs.nextLine(line));
+  EXPECT_EQ(5U, nbfs.offset());
+
+  // The partial line is shifted down when more data is read.
+  fill = "\nfour\n";
+  bytes_written = write(fd, fill.data(), fill.size());
+  ASSERT_EQ(static_cast<ssize_t>(fill.size()), bytes_written);
+  EXPECT_TRUE(nbfs.fill().ok());
+  ASSERT_TRUE(nbfs.nextLine(line));
+  EXPECT_EQ("three", line);
+  ASSERT_TRUE(nbfs.nextLine(line));
+  EXPECT_EQ("four", line);
+  EXPECT_EQ(0U, nbfs.offset());
+
+  EXPECT_FALSE(nbfs.nextLine(line));
+  EXPECT_FALSE(nbfs.fill().ok());
+  close(fd);
+}
+
 TEST_F(SyslogTests, test_populate_event_context) {
   std::string line =
       R"|("2016-03-22T21:17:01.701882+00:00","vagrant-ubuntu-trusty-64","6","cron","CRON[16538]:"," (root) CMD (   cd / && run-parts --report /etc/cron.hourly)")|";
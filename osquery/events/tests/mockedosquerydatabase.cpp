@@ -49,12 +49,13 @@ void MockedOsqueryDatabase::generateEvents(const std::string& publisher,
           "MockedOsqueryDatabase: Failed to serialize the row");
     }
 
-    auto key = EventSubscriberPlugin::databaseKeyForEventId(context, event_id);
+    auto key =
+        EventSubscriberPlugin::databaseKeyForEventId(context, i, event_id);
     key_map.insert({key, std::move(serialized_row)});
 
     // this value can't be deserialized and should be skipped
     event_id = EventSubscriberPlugin::generateEventIdentifier(context);
-    key = EventSubscriberPlugin::databaseKeyForEventId(context, event_id);
+    key = EventSubscriberPlugin::databaseKeyForEventId(context, i, event_id);
     key_map.insert({key, "broken_serialized_value"});
   }
 }
@@ -66,12 +67,21 @@ Status MockedOsqueryDatabase::getDatabaseValue(const std::string& domain,
 
   if (domain == kEvents) {
     auto key_it = key_map.find(key);
-    if (key_it == key_map.end()) {
+    if (key_it == key_map.end() &&
+        (key.find("columns.") == 0 || key.find("eventindex.") == 0)) {
+      // Subscribers that only stored JSON records have no column names, and
+      // the index is only saved once a subscriber was set up.
+      return Status::failure("MockedOsqueryDatabase: Key not found: " + key);
+
+    } else if (key_it == key_map.end()) {
       throw std::logic_error(
           "MockedOsqueryDatabase: Invalid key passed to getDatabaseValue: " +
           key);
     }
 
+    if (key.find("data.") == 0) {
+      ++record_read_count;
+    }
     value = key_it->second;
     return Status::success();
 
@@ -108,7 +118,8 @@ Status MockedOsqueryDatabase::setDatabaseValue(const std::string& domain,
         domain);
   }
 
-  if (key != "optimize.test_query" && key != "optimize_eid.test_query") {
+  if (key != "optimize.test_query" && key != "optimize_eid.test_query" &&
+      key.find("data.") != 0 && key.find("eventindex.") != 0) {
     throw std::logic_error(
         "MockedOsqueryDatabase: Invalid key passed to setDatabaseValue: " +
         key);
@@ -155,8 +166,16 @@ Status MockedOsqueryDatabase::deleteDatabaseRange(
     const std::string& domain,
     const std::string& low,
     const std::string& high) const {
-  return Status::failure(
-      "MockedOsqueryDatabase: Unsupported deleteDatabaseRange call");
+  if (domain != kEvents || low > high) {
+    throw std::logic_error(
+        "MockedOsqueryDatabase: Invalid parameter passed to "
+        "deleteDatabaseRange");
+  }
+
+  // Both bounds are inclusive, like the database plugins.
+  key_map.erase(key_map.lower_bound(low), key_map.upper_bound(high));
+  ++range_delete_count;
+  return Status::success();
 }
 
 Status MockedOsqueryDatabase::scanDatabaseKeys(const std::string& domain,
@@ -190,4 +209,43 @@ Status MockedOsqueryDatabase::scanDatabaseKeys(const std::string& domain,
   return Status::success();
 }
 
+Status MockedOsqueryDatabase::scanDatabaseValues(
+    const std::string& domain,
+    const std::string& prefix,
+    const std::string& resume,
+    uint64_t max,
+    const DatabaseScanCallback& callback,
+    std::string& next_key) const {
+  next_key = {};
+
+  if (domain != kEvents) {
+    throw std::logic_error(
+        "MockedOsqueryDatabase: Invalid domain passed to scanDatabaseValues: " +
+        domain);
+  }
+
+  // Like the database plugins, writes made while scanning are not visited.
+  std::vector<std::pair<std::string, std::string>> values;
+  for (auto it = key_map.lower_bound(std::max(prefix, resume));
+       it != key_map.end() && it->first.find(prefix) == 0;
+       ++it) {
+    values.push_back(*it);
+  }
+
+  uint64_t count = 0U;
+  for (const auto& p : values) {
+    if (max > 0 && count >= max) {
+      next_key = p.first;
+      break;
+    }
+
+    ++count;
+    if (!callback(p.first, p.second)) {
+      break;
+    }
+  }
+
+  return Status::success();
+}
+
 } // namespace osquery
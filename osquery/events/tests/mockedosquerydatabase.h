@@ -16,6 +16,8 @@ namespace osquery {
 class MockedOsqueryDatabase final : public IDatabaseInterface {
  public:
   mutable std::map<std::string, std::string> key_map;
+  mutable std::size_t range_delete_count{0U};
+  mutable std::size_t record_read_count{0U};
 
   MockedOsqueryDatabase() = default;
   virtual ~MockedOsqueryDatabase() override = default;
@@ -57,6 +59,13 @@ class MockedOsqueryDatabase final : public IDatabaseInterface {
                                   std::vector<std::string>& keys,
                                   const std::string& prefix,
                                   size_t max) const override;
+
+  virtual Status scanDatabaseValues(const std::string& domain,
+                                    const std::string& prefix,
+                                    const std::string& resume,
+                                    uint64_t max,
+                                    const DatabaseScanCallback& callback,
+                                    std::string& next_key) const override;
 };
 
 } // namespace osquery
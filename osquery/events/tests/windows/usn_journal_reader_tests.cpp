@@ -215,4 +215,53 @@ TEST_F(UsnJournalReaderTests, test_get_event_string) {
   EXPECT_FALSE(USNParsers::GetEventString(buffer, (USN_RECORD*)usn_v3))
       << "GetEventString should refuse to parse V4 records";
 }
+
+TEST_F(UsnJournalReaderTests, test_decompress_record) {
+  USNJournalEventRecord base_record = {};
+  base_record.node_ref_number = 0x1234ULL;
+  base_record.attributes = FILE_ATTRIBUTE_NORMAL;
+
+  USNPerFileLastRecordType last_record_types;
+  std::vector<USNJournalEventRecord> records;
+  auto status = USNJournalReader::DecompressRecord(
+      records,
+      base_record,
+      USN_REASON_FILE_CREATE | USN_REASON_DATA_EXTEND,
+      last_record_types);
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(records.size(), 2U);
+  EXPECT_EQ(records[0].type, USNJournalEventRecord::Type::FileCreation);
+  EXPECT_EQ(records[1].type, USNJournalEventRecord::Type::FileWrite);
+
+  // The last event of the file is used to drop the repeated ones.
+  ASSERT_EQ(last_record_types.count(base_record.node_ref_number), 1U);
+  EXPECT_EQ(last_record_types.at(base_record.node_ref_number),
+            USNJournalEventRecord::Type::FileWrite);
+  EXPECT_FALSE(USNJournalReader::HasNewUSNEvents(base_record.node_ref_number,
+                                                 USN_REASON_DATA_EXTEND,
+                                                 FILE_ATTRIBUTE_NORMAL,
+                                                 last_record_types));
+  EXPECT_TRUE(USNJournalReader::HasNewUSNEvents(base_record.node_ref_number,
+                                                USN_REASON_FILE_DELETE,
+                                                FILE_ATTRIBUTE_NORMAL,
+                                                last_record_types));
+}
+
+TEST_F(UsnJournalReaderTests, test_resume_sequence_number) {
+  auto checkpoint = SerializeUSNJournalCheckpoint(42U, 1500);
+  EXPECT_EQ(GetUSNJournalResumeSequenceNumber(checkpoint, 42U, 1000, 2000),
+            1500);
+
+  // Missing, malformed or foreign checkpoints start from the end.
+  EXPECT_EQ(GetUSNJournalResumeSequenceNumber("", 42U, 1000, 2000), 2000);
+  EXPECT_EQ(GetUSNJournalResumeSequenceNumber("42:x", 42U, 1000, 2000), 2000);
+  EXPECT_EQ(GetUSNJournalResumeSequenceNumber(checkpoint, 43U, 1000, 2000),
+            2000);
+  EXPECT_EQ(GetUSNJournalResumeSequenceNumber(checkpoint, 42U, 1000, 1200),
+            1200);
+
+  // Purged records are skipped.
+  EXPECT_EQ(GetUSNJournalResumeSequenceNumber(checkpoint, 42U, 1800, 2000),
+            1800);
+}
 } // namespace osquery
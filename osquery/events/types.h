@@ -23,7 +23,6 @@ using EventTime = uint64_t;
 using EventRecord = std::pair<std::string, EventTime>;
 using EventID = std::uint64_t;
 using EventIDList = std::vector<EventID>;
-using EventIndex = std::map<EventTime, EventIDList>;
 
 /**
  * @brief An EventSubscriber EventCallback method will receive an EventContext.
@@ -45,6 +44,9 @@ struct EventContext : private boost::noncopyable {
 
 using EventContextRef = std::shared_ptr<EventContext>;
 
+/// Events fired together by a publisher, in the order they occurred.
+using EventContextList = std::vector<EventContextRef>;
+
 /**
  * @brief An EventPublisher will define a SubscriptionContext for
  * EventSubscriber%s to use.
@@ -9,8 +9,12 @@
 
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <mutex>
 #include <queue>
 
@@ -102,10 +106,165 @@ class ConcurrentQueue : public boost::noncopyable {
   std::condition_variable condition_;
 };
 
+/**
+ * @brief Lock-free bounded Concurrent Queue
+ *
+ * Each slot carries a sequence number. Producers and consumers claim a slot
+ * with a compare-and-swap on their position and never take a lock, a push
+ * fails when the queue is full so the caller decides to drop the element.
+ * Consumers may wait for an element, producers only take the mutex to wake a
+ * waiting consumer.
+ */
+template <typename T>
+class BoundedConcurrentQueue : public boost::noncopyable {
+ public:
+  /**
+   * @brief The capacity is rounded up to a power of two.
+   */
+  explicit BoundedConcurrentQueue(std::size_t capacity) {
+    std::size_t size = 2;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    mask_ = size - 1;
+    slots_ = std::make_unique<Slot[]>(size);
+    for (std::size_t i = 0; i < size; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief Returns the maximum number of elements in the queue.
+   */
+  std::size_t capacity() const {
+    return mask_ + 1;
+  }
+
+  /**
+   * @brief Returns the approximate size of the queue.
+   */
+  unsigned long size() const {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    auto head = head_.load(std::memory_order_relaxed);
+    return static_cast<unsigned long>(tail > head ? tail - head : 0);
+  }
+
+  /**
+   * @brief Checks if the queue is empty
+   */
+  bool empty() const {
+    return size() == 0;
+  }
+
+  /**
+   * @brief Stores a new element to the back of the queue. The call returns
+   * FALSE, without storing the element, when the queue is full.
+   */
+  bool tryPush(T item) {
+    auto pos = tail_.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+    for (;;) {
+      slot = &slots_[pos & mask_];
+      auto sequence = slot->sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::intptr_t>(sequence) -
+                  static_cast<std::intptr_t>(pos);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(
+                pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+
+    slot->data = std::move(item);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    // Pairs with the fence in popWait, either the consumer sees the element
+    // or the producer sees the waiting consumer.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting_.load(std::memory_order_relaxed) > 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      condition_.notify_all();
+    }
+    return true;
+  }
+
+  /**
+   * @brief Removes the front element from the queue without blocking. The
+   * call returns FALSE if no element was found in the queue.
+   */
+  bool tryPop(T& element) {
+    auto pos = head_.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+    for (;;) {
+      slot = &slots_[pos & mask_];
+      auto sequence = slot->sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::intptr_t>(sequence) -
+                  static_cast<std::intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(
+                pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+
+    element = std::move(slot->data);
+    slot->data = T{};
+    slot->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Removes the front element from the queue, waiting up to the
+   * specified timeout duration for one. The call returns FALSE if no element
+   * was found in the queue. The timeout is set by default to 300ms.
+   */
+  bool popWait(T& element, const unsigned int timeoutMS = 300) {
+    if (tryPop(element)) {
+      return true;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    waiting_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool ready = condition_.wait_for(lock,
+                                     std::chrono::milliseconds(timeoutMS),
+                                     [&] { return tryPop(element); });
+    waiting_.fetch_sub(1, std::memory_order_relaxed);
+    return ready;
+  }
+
+ private:
+  struct Slot {
+    std::atomic<std::size_t> sequence{0};
+    T data{};
+  };
+
+  std::unique_ptr<Slot[]> slots_;
+  std::size_t mask_{0};
+
+  /// Producer and consumer positions, kept on separate cache lines.
+  alignas(64) std::atomic<std::size_t> tail_{0};
+  alignas(64) std::atomic<std::size_t> head_{0};
+
+  std::atomic<std::size_t> waiting_{0};
+  std::mutex mutex_;
+  std::condition_variable condition_;
+};
+
 /**
  * @brief Concurrent Queue for ETW events
  */
-using ConcurrentEventQueue = ConcurrentQueue<EtwEventDataRef>;
+using ConcurrentEventQueue = BoundedConcurrentQueue<EtwEventDataRef>;
 using ConcurrentEventQueueRef = std::shared_ptr<ConcurrentEventQueue>;
 
 } // namespace osquery
\ No newline at end of file
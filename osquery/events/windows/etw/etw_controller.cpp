@@ -7,6 +7,9 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+
+#include <osquery/core/flags.h>
 #include <osquery/events/windows/etw/etw_controller.h>
 #include <osquery/events/windows/etw/etw_kernel_session.h>
 #include <osquery/events/windows/etw/etw_post_processing_pipeline.h>
@@ -17,18 +20,42 @@
 
 namespace osquery {
 
+FLAG(uint32,
+     etw_post_processing_threads,
+     4,
+     "Number of threads post-processing ETW events");
+
+FLAG(uint32,
+     etw_queue_size,
+     16384,
+     "Maximum ETW events waiting for each post-processing thread");
+
 // Returns a reference to the single global EtwController instance
 EtwController& EtwController::instance() {
   static EtwController instance;
   return instance;
 }
 
-//  New events get stored in the post-processing queue
+//  New events get stored in the post-processing queue of their process
 void EtwController::dispatchETWEvents(const EtwEventDataRef& data) {
-  // storing the event in the thread-safe concurrent event queue
-  if (concurrentQueue_) {
-    concurrentQueue_->push(data);
+  if (concurrentQueues_.empty() || !data) {
+    return;
+  }
+
+  // storing the event in the lock-free queue of its worker, the event is
+  // dropped instead of blocking the ETW session when the worker is behind
+  auto shard = getEtwEventProcessId(*data) % concurrentQueues_.size();
+  if (!concurrentQueues_[shard]->tryPush(data) && pipelineCounters_) {
+    pipelineCounters_->recordDropped(data->Header.Type);
+  }
+}
+
+std::map<EtwEventType, EtwPipelineStats> EtwController::getPipelineStats()
+    const {
+  if (!pipelineCounters_) {
+    return {};
   }
+  return pipelineCounters_->getStats();
 }
 
 Status EtwController::addProvider(const EtwProviderConfig& configData) {
@@ -48,12 +75,13 @@ Status EtwController::addProvider(const EtwProviderConfig& configData) {
     return Status::failure(initStatus.getMessage());
   }
 
-  // Adding post-processors callbacks to handle
-  Status postProcessingStatus =
-      etwPostProcessingEngine_->addProvider(configData);
+  // Adding post-processors callbacks to handle, on every worker
+  for (const auto& engine : etwPostProcessingEngines_) {
+    Status postProcessingStatus = engine->addProvider(configData);
 
-  if (!postProcessingStatus.ok()) {
-    return Status::failure(postProcessingStatus.getMessage());
+    if (!postProcessingStatus.ok()) {
+      return Status::failure(postProcessingStatus.getMessage());
+    }
   }
 
   // ETW configuration data contains information to determine if an userspace or
@@ -80,7 +108,7 @@ Status EtwController::addProvider(const EtwProviderConfig& configData) {
 // post-processing pipeline is started here.
 Status EtwController::startProcessing() {
   // sanity checks on processing engines
-  if (!etwPostProcessingEngine_) {
+  if (etwPostProcessingEngines_.empty()) {
     return Status::failure("ETW Post processing engine not ready");
   }
 
@@ -93,10 +121,13 @@ Status EtwController::startProcessing() {
   }
 
   // Spinning up runnable osquery services
-  Status pipelineStatus = Dispatcher::addService(etwPostProcessingEngine_);
-  if (!pipelineStatus.ok()) {
-    return Status::failure("ETW Post processing engine couldn't be started: " +
-                           pipelineStatus.getMessage());
+  for (const auto& engine : etwPostProcessingEngines_) {
+    Status pipelineStatus = Dispatcher::addService(engine);
+    if (!pipelineStatus.ok()) {
+      return Status::failure(
+          "ETW Post processing engine couldn't be started: " +
+          pipelineStatus.getMessage());
+    }
   }
 
   Status userStatus = Dispatcher::addService(etwUserSession_);
@@ -123,11 +154,8 @@ Status EtwController::initialize() {
     return Status::success();
   }
 
-  // Initializing concurrent ETW event queue
-  concurrentQueue_ = std::make_shared<ConcurrentEventQueue>();
-  if (!concurrentQueue_) {
-    return Status::failure("There was a problem allocating concurrent queue");
-  }
+  // Counters shared by the post-processing workers
+  pipelineCounters_ = std::make_shared<EtwPipelineCounters>();
 
   // Initializing ETW userspace trace session
   etwUserSession_ =
@@ -143,12 +171,17 @@ Status EtwController::initialize() {
     return Status::failure("There was a problem allocating ETW Kernel Session");
   }
 
-  // Initializing ETW post processing engine
-  etwPostProcessingEngine_ = std::make_shared<EtwPostProcessorsRunnable>(
-      runNamePostProcessingEngine, concurrentQueue_);
-  if (!etwPostProcessingEngine_) {
-    return Status::failure(
-        "There was a problem allocating ETW Post Processing Engine");
+  // Initializing ETW post processing workers, each with its own queue
+  auto workers = std::max<std::uint32_t>(FLAGS_etw_post_processing_threads, 1);
+  auto queueSize = std::max<std::uint32_t>(FLAGS_etw_queue_size, 2);
+  for (std::uint32_t i = 0; i < workers; ++i) {
+    auto queue = std::make_shared<ConcurrentEventQueue>(queueSize);
+    auto engine = std::make_shared<EtwPostProcessorsRunnable>(
+        runNamePostProcessingEngine + std::to_string(i),
+        queue,
+        pipelineCounters_);
+    concurrentQueues_.push_back(std::move(queue));
+    etwPostProcessingEngines_.push_back(std::move(engine));
   }
 
   // Launching processing threads
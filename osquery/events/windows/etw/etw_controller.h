@@ -9,16 +9,19 @@
 
 #pragma once
 
+#include <map>
+#include <vector>
+
 #include <boost/noncopyable.hpp>
 
 #include <osquery/events/windows/etw/etw_concurrent_queue.h>
+#include <osquery/events/windows/etw/etw_post_processing_pipeline.h>
 
 namespace osquery {
 
 class EtwProviderConfig;
 class UserEtwSessionRunnable;
 class KernelEtwSessionRunnable;
-class EtwPostProcessorsRunnable;
 class Status;
 
 /**
@@ -55,6 +58,11 @@ class EtwController : public boost::noncopyable {
    */
   void dispatchETWEvents(const EtwEventDataRef& data);
 
+  /**
+   * @brief Returns the post-processing statistics of every event type.
+   */
+  std::map<EtwEventType, EtwPipelineStats> getPipelineStats() const;
+
  private:
   const std::string runNameUserETWSession = "OsqueryUserETWSession";
   const std::string runNameKernelETWSession = "OsqueryKernelETWSession";
@@ -81,8 +89,10 @@ class EtwController : public boost::noncopyable {
   std::atomic<bool> initialized_{false};
   std::shared_ptr<UserEtwSessionRunnable> etwUserSession_{nullptr};
   std::shared_ptr<KernelEtwSessionRunnable> etwKernelSession_{nullptr};
-  std::shared_ptr<EtwPostProcessorsRunnable> etwPostProcessingEngine_{nullptr};
-  std::shared_ptr<ConcurrentEventQueue> concurrentQueue_{nullptr};
+  std::vector<std::shared_ptr<EtwPostProcessorsRunnable>>
+      etwPostProcessingEngines_;
+  std::vector<ConcurrentEventQueueRef> concurrentQueues_;
+  EtwPipelineCountersRef pipelineCounters_{nullptr};
   mutable std::mutex mutex_;
 };
 
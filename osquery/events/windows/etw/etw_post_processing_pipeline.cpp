@@ -8,15 +8,128 @@
  */
 
 #include <osquery/events/windows/etw/etw_post_processing_pipeline.h>
+#include <osquery/logger/logger.h>
 #include <osquery/utils/conversions/windows/windows_time.h>
 #include <osquery/utils/map_take.h>
 #include <osquery/utils/status/status.h>
+#include <osquery/utils/system/time.h>
 
 namespace osquery {
 
+namespace {
+
+/// Seconds between two logs of the pipeline statistics.
+const std::uint64_t kEtwStatsReportInterval{60};
+
+} // namespace
+
+EtwPipelineCounters::EtwPipelineCounters() {
+  for (const auto& eventType : kEtwEventTypeStrings) {
+    counters_.emplace(std::piecewise_construct,
+                      std::forward_as_tuple(eventType.first),
+                      std::forward_as_tuple());
+  }
+}
+
+EtwPipelineCounters::Counters* EtwPipelineCounters::find(EtwEventType type) {
+  auto it = counters_.find(type);
+  return (it == counters_.end()) ? nullptr : &it->second;
+}
+
+void EtwPipelineCounters::recordDropped(EtwEventType type) {
+  auto counters = find(type);
+  if (counters != nullptr) {
+    counters->dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void EtwPipelineCounters::recordProcessed(EtwEventType type,
+                                          std::uint64_t latency_us) {
+  auto counters = find(type);
+  if (counters == nullptr) {
+    return;
+  }
+
+  counters->processed.fetch_add(1, std::memory_order_relaxed);
+  counters->total_latency_us.fetch_add(latency_us, std::memory_order_relaxed);
+  auto max = counters->max_latency_us.load(std::memory_order_relaxed);
+  while (latency_us > max &&
+         !counters->max_latency_us.compare_exchange_weak(
+             max, latency_us, std::memory_order_relaxed)) {
+  }
+}
+
+std::map<EtwEventType, EtwPipelineStats> EtwPipelineCounters::getStats()
+    const {
+  std::map<EtwEventType, EtwPipelineStats> stats;
+  for (const auto& counters : counters_) {
+    auto& stat = stats[counters.first];
+    stat.processed = counters.second.processed.load();
+    stat.dropped = counters.second.dropped.load();
+    stat.total_latency_us = counters.second.total_latency_us.load();
+    stat.max_latency_us = counters.second.max_latency_us.load();
+  }
+  return stats;
+}
+
+void EtwPipelineCounters::reportStats() {
+  // Only one worker reports, the others move on.
+  std::unique_lock<std::mutex> lock(report_mutex_, std::try_to_lock);
+  auto now = getUnixTime();
+  if (!lock.owns_lock() || now < last_report_time_ + kEtwStatsReportInterval) {
+    return;
+  }
+  last_report_time_ = now;
+
+  for (const auto& stat : getStats()) {
+    auto& last = reported_[stat.first];
+    auto processed = stat.second.processed - last.processed;
+    auto dropped = stat.second.dropped - last.dropped;
+    auto latency = stat.second.total_latency_us - last.total_latency_us;
+    last = stat.second;
+    if (processed == 0 && dropped == 0) {
+      continue;
+    }
+
+    auto name = tryTakeCopy(kEtwEventTypeStrings, stat.first)
+                    .takeOr(std::string("Invalid"));
+    auto average = (processed > 0) ? latency / processed : 0;
+    if (dropped > 0) {
+      LOG(WARNING) << "ETW post-processing dropped " << dropped << " " << name
+                   << " events, processed " << processed
+                   << ", average latency " << average << "us";
+    } else {
+      VLOG(1) << "ETW post-processing processed " << processed << " " << name
+              << " events, average latency " << average << "us, max "
+              << stat.second.max_latency_us << "us";
+    }
+  }
+}
+
+std::uint32_t getEtwEventProcessId(const EtwEventData& data) {
+  // Process events are sharded by the process they describe, the start and
+  // stop events of a process can be emitted by other processes.
+  if (std::holds_alternative<EtwProcStartDataRef>(data.Payload)) {
+    const auto& payload = std::get<EtwProcStartDataRef>(data.Payload);
+    if (payload != nullptr) {
+      return payload->ProcessId;
+    }
+  } else if (std::holds_alternative<EtwProcStopDataRef>(data.Payload)) {
+    const auto& payload = std::get<EtwProcStopDataRef>(data.Payload);
+    if (payload != nullptr) {
+      return payload->ProcessId;
+    }
+  }
+  return data.Header.RawHeader.ProcessId;
+}
+
 EtwPostProcessorsRunnable::EtwPostProcessorsRunnable(
-    const std::string& sessionName, ConcurrentEventQueueRef& sharedQueue)
-    : InternalRunnable(sessionName), concurrentQueue_(sharedQueue) {}
+    const std::string& sessionName,
+    ConcurrentEventQueueRef queue,
+    EtwPipelineCountersRef counters)
+    : InternalRunnable(sessionName),
+      concurrentQueue_(std::move(queue)),
+      counters_(std::move(counters)) {}
 
 EtwPostProcessorsRunnable::~EtwPostProcessorsRunnable() {
   stop();
@@ -74,6 +187,8 @@ void EtwPostProcessorsRunnable::start() {
       if (!CommonPostProcessing(data)) {
         return;
       }
+      auto eventType = data->Header.Type;
+      auto eventTime = data->Header.WinTimestamp;
 
       // Getting event specific post processing callback logic
       auto postProcessorFn =
@@ -84,6 +199,23 @@ void EtwPostProcessorsRunnable::start() {
       if (postProcessorFn) {
         postProcessorFn(std::move(data));
       }
+
+      if (counters_) {
+        // Both times are in 100 nanoseconds units
+        FILETIME nowTime{0};
+        GetSystemTimeAsFileTime(&nowTime);
+        ULARGE_INTEGER now{0};
+        now.LowPart = nowTime.dwLowDateTime;
+        now.HighPart = nowTime.dwHighDateTime;
+        auto latency = (now.QuadPart > eventTime)
+                           ? (now.QuadPart - eventTime) / 10
+                           : 0;
+        counters_->recordProcessed(eventType, latency);
+      }
+    }
+
+    if (counters_) {
+      counters_->reportStats();
     }
   }
 }
@@ -9,6 +9,12 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
 #include <osquery/dispatcher/dispatcher.h>
 #include <osquery/events/windows/etw/etw_concurrent_queue.h>
 #include <osquery/events/windows/etw/etw_provider_config.h>
@@ -17,15 +23,78 @@ namespace osquery {
 
 class Status;
 
+/**
+ * @brief Post-processing statistics of an ETW event type
+ */
+struct EtwPipelineStats {
+  /// Events post-processed.
+  std::uint64_t processed{0};
+
+  /// Events dropped because the queue of their worker was full.
+  std::uint64_t dropped{0};
+
+  /// Sum and maximum of the microseconds from the event to its processing.
+  std::uint64_t total_latency_us{0};
+  std::uint64_t max_latency_us{0};
+};
+
+/**
+ * @brief Drop and latency counters shared by the post-processing workers
+ *
+ * Providers register their post-processors by event type, the counters are
+ * kept for each event type. Updates are lock-free.
+ */
+class EtwPipelineCounters : public boost::noncopyable {
+ public:
+  EtwPipelineCounters();
+
+  /// Count an event dropped before post-processing.
+  void recordDropped(EtwEventType type);
+
+  /// Count a post-processed event and its latency.
+  void recordProcessed(EtwEventType type, std::uint64_t latency_us);
+
+  /// Returns the statistics of every event type.
+  std::map<EtwEventType, EtwPipelineStats> getStats() const;
+
+  /// Log the statistics of the last interval, from a single worker.
+  void reportStats();
+
+ private:
+  struct Counters {
+    std::atomic<std::uint64_t> processed{0};
+    std::atomic<std::uint64_t> dropped{0};
+    std::atomic<std::uint64_t> total_latency_us{0};
+    std::atomic<std::uint64_t> max_latency_us{0};
+  };
+
+  Counters* find(EtwEventType type);
+
+  /// Created for every event type, then only the counters change.
+  std::unordered_map<EtwEventType, Counters> counters_;
+
+  /// The statistics at the last report.
+  std::map<EtwEventType, EtwPipelineStats> reported_;
+  std::uint64_t last_report_time_{0};
+  std::mutex report_mutex_;
+};
+
+using EtwPipelineCountersRef = std::shared_ptr<EtwPipelineCounters>;
+
 /**
  * @brief Manages the collection of post-processing
  * callbacks in-charge of processing and dispatching events to event
  * subscribers.
+ *
+ * Each runnable is a post-processing worker with its own queue. Events are
+ * sharded across the workers by process ID, so the events of a process are
+ * post-processed in order.
  */
 class EtwPostProcessorsRunnable final : public InternalRunnable {
  public:
   EtwPostProcessorsRunnable(const std::string& runnableName,
-                            ConcurrentEventQueueRef& sharedQueue);
+                            ConcurrentEventQueueRef queue,
+                            EtwPipelineCountersRef counters);
   virtual ~EtwPostProcessorsRunnable();
 
   /**
@@ -65,9 +134,19 @@ class EtwPostProcessorsRunnable final : public InternalRunnable {
   std::atomic<bool> shouldRun_{true};
 
   /**
-   * @brief Concurrent event queue reference
+   * @brief Concurrent event queue of this worker
+   */
+  ConcurrentEventQueueRef concurrentQueue_;
+
+  /**
+   * @brief Counters shared by the workers
    */
-  ConcurrentEventQueueRef& concurrentQueue_;
+  EtwPipelineCountersRef counters_;
 };
 
+/**
+ * @brief Returns the process ID used to shard an event across the workers
+ */
+std::uint32_t getEtwEventProcessId(const EtwEventData& data);
+
 } // namespace osquery
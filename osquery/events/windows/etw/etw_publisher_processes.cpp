@@ -291,16 +291,24 @@ void EtwPublisherProcesses::providerPostProcessor(
     std::uint64_t searchKey = getComposedKey(procStartData->ProcessId,
                                              procStartData->ParentProcessId);
 
-    // Access to the map iterator is required, tryTakeCopy cannot be used here.
-    auto processCacheIt = processStartAggregationCache_.find(searchKey);
-    if (processCacheIt == processStartAggregationCache_.end()) {
-      // this event needs to be agreggated, so cache it for the time being
-      if (procStartData->CreateTime.dwHighDateTime == 0 &&
-          procStartData->CreateTime.dwLowDateTime == 0) {
-        GetSystemTimeAsFileTime(&procStartData->CreateTime);
+    // The post-processing workers share the caches, the events of a process
+    // are post-processed in order by a single worker.
+    {
+      std::lock_guard<std::mutex> lock(cacheMutex_);
+
+      // Access to the map iterator is required, tryTakeCopy cannot be used
+      // here.
+      auto processCacheIt = processStartAggregationCache_.find(searchKey);
+      if (processCacheIt == processStartAggregationCache_.end()) {
+        // this event needs to be agreggated, so cache it for the time being
+        if (procStartData->CreateTime.dwHighDateTime == 0 &&
+            procStartData->CreateTime.dwLowDateTime == 0) {
+          GetSystemTimeAsFileTime(&procStartData->CreateTime);
+        }
+        processStartAggregationCache_.insert({searchKey, procStartData});
+        return;
       }
-      processStartAggregationCache_.insert({searchKey, procStartData});
-    } else {
+
       // A previous event was found on the cache, aggregate and dispatch it
       auto procStartCacheData = processCacheIt->second;
       if (procStartCacheData == nullptr) {
@@ -335,29 +343,32 @@ void EtwPublisherProcesses::providerPostProcessor(
         shouldDispatch = true;
       }
 
-      if (shouldDispatch) {
-        // Event is ready to be dispatched
-
-        // Event enrichment phase
-        updateHardVolumeWithLogicalDrive(procStartData->ImageName);
-        updateUserInfo(procStartData->UserSid, procStartData->UserName);
-        updateTokenInfo(procStartData->TokenElevationType,
-                        procStartData->TokenElevationTypeInfo);
-
-        // Event dispatch
-        event_context->data = std::move(eventData);
-        fire(event_context);
+      if (!shouldDispatch) {
+        return;
+      }
 
-        // Remove it from the process start aggregation cache
-        processStartAggregationCache_.erase(processCacheIt);
+      // Remove it from the process start aggregation cache
+      processStartAggregationCache_.erase(processCacheIt);
 
-        // Houskeeping of expired aggregation cache entries
-        cleanOldAggregationCacheEntries();
+      // Houskeeping of expired aggregation cache entries
+      cleanOldAggregationCacheEntries();
+    }
 
-        // Caching image full path
-        processImageCache_.insert({searchKey, procStartData->ImageName});
-      }
+    // Event enrichment phase
+    updateHardVolumeWithLogicalDrive(procStartData->ImageName);
+    updateUserInfo(procStartData->UserSid, procStartData->UserName);
+    updateTokenInfo(procStartData->TokenElevationType,
+                    procStartData->TokenElevationTypeInfo);
+
+    // Caching image full path
+    {
+      std::lock_guard<std::mutex> lock(cacheMutex_);
+      processImageCache_.insert({searchKey, procStartData->ImageName});
     }
+
+    // Event dispatch
+    event_context->data = std::move(eventData);
+    fire(event_context);
   }
 }
 
@@ -402,10 +413,10 @@ void EtwPublisherProcesses::cleanOldAggregationCacheEntries() {
     if ((eventTimestamp.QuadPart + expiredTime10secs) <
         currentTimestamp.QuadPart) {
       // event expire and should be deleted
-      processStartAggregationCache_.erase(it);
+      it = processStartAggregationCache_.erase(it);
+    } else {
+      ++it;
     }
-
-    ++it;
   }
 }
 
@@ -424,51 +435,58 @@ void EtwPublisherProcesses::updateHardVolumeWithLogicalDrive(
 void EtwPublisherProcesses::updateUserInfo(const std::string& userSid,
                                            std::string& username) {
   // Updating user information using gathered user SIDs as input
-  auto usernameIt = usernamesBySIDs_.find(userSid);
-  if (usernameIt != usernamesBySIDs_.end()) {
-    auto cachedUsername = usernameIt->second;
-    username.assign(cachedUsername);
-  } else {
-    PSID pSid = nullptr;
-
-    if (!ConvertStringSidToSidA(userSid.c_str(), &pSid) || pSid == nullptr) {
-      // Inserting empty username to avoid the lookup logic to be called again
-      usernamesBySIDs_.insert({userSid, ""});
+  {
+    std::lock_guard<std::mutex> lock(usernamesMutex_);
+    auto usernameIt = usernamesBySIDs_.find(userSid);
+    if (usernameIt != usernamesBySIDs_.end()) {
+      username.assign(usernameIt->second);
       return;
     }
+  }
 
-    std::vector<char> domainNameStr(MAX_PATH - 1, 0x0);
-    std::vector<char> userNameStr(MAX_PATH - 1, 0x0);
-    DWORD domainNameSize = MAX_PATH;
-    DWORD userNameSize = MAX_PATH;
-    SID_NAME_USE sidType = SID_NAME_USE::SidTypeInvalid;
-
-    if (!LookupAccountSidA(NULL,
-                           pSid,
-                           userNameStr.data(),
-                           &userNameSize,
-                           domainNameStr.data(),
-                           &domainNameSize,
-                           &sidType) ||
-        strlen(domainNameStr.data()) == 0 ||
-        strlen(domainNameStr.data()) >= MAX_PATH ||
-        strlen(userNameStr.data()) == 0 ||
-        strlen(userNameStr.data()) >= MAX_PATH ||
-        sidType == SID_NAME_USE::SidTypeInvalid) {
-      // Inserting empty username to avoid the lookup logic to be called again
-      usernamesBySIDs_.insert({userSid, ""});
-      LocalFree(pSid);
-      return;
-    }
+  // The account lookup may be slow, it runs without holding the cache lock
+  PSID pSid = nullptr;
 
+  if (!ConvertStringSidToSidA(userSid.c_str(), &pSid) || pSid == nullptr) {
+    // Inserting empty username to avoid the lookup logic to be called again
+    std::lock_guard<std::mutex> lock(usernamesMutex_);
+    usernamesBySIDs_.insert({userSid, ""});
+    return;
+  }
+
+  std::vector<char> domainNameStr(MAX_PATH - 1, 0x0);
+  std::vector<char> userNameStr(MAX_PATH - 1, 0x0);
+  DWORD domainNameSize = MAX_PATH;
+  DWORD userNameSize = MAX_PATH;
+  SID_NAME_USE sidType = SID_NAME_USE::SidTypeInvalid;
+
+  if (!LookupAccountSidA(NULL,
+                         pSid,
+                         userNameStr.data(),
+                         &userNameSize,
+                         domainNameStr.data(),
+                         &domainNameSize,
+                         &sidType) ||
+      strlen(domainNameStr.data()) == 0 ||
+      strlen(domainNameStr.data()) >= MAX_PATH ||
+      strlen(userNameStr.data()) == 0 ||
+      strlen(userNameStr.data()) >= MAX_PATH ||
+      sidType == SID_NAME_USE::SidTypeInvalid) {
+    // Inserting empty username to avoid the lookup logic to be called again
     LocalFree(pSid);
+    std::lock_guard<std::mutex> lock(usernamesMutex_);
+    usernamesBySIDs_.insert({userSid, ""});
+    return;
+  }
 
-    username.append(domainNameStr.data());
-    username.append("\\");
-    username.append(userNameStr.data());
+  LocalFree(pSid);
 
-    usernamesBySIDs_.insert({userSid, username});
-  }
+  username.append(domainNameStr.data());
+  username.append("\\");
+  username.append(userNameStr.data());
+
+  std::lock_guard<std::mutex> lock(usernamesMutex_);
+  usernamesBySIDs_.insert({userSid, username});
 }
 
 void EtwPublisherProcesses::updateImagePath(const std::uint64_t& key1,
@@ -478,6 +496,7 @@ void EtwPublisherProcesses::updateImagePath(const std::uint64_t& key1,
   std::uint64_t searchKey = getComposedKey(key1, key2);
 
   // Event specific post processing callback logic
+  std::lock_guard<std::mutex> lock(cacheMutex_);
   imagePath = tryTake(processImageCache_, searchKey).takeOr(imagePath);
 }
 
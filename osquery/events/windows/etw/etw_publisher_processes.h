@@ -9,6 +9,8 @@
 
 #pragma once
 
+#include <mutex>
+
 #include <osquery/events/windows/etw/etw_publisher.h>
 
 namespace osquery {
@@ -140,9 +142,13 @@ class EtwPublisherProcesses
       std::unordered_map<std::string, std::string>;
   using UsernameBySIDCollection = std::unordered_map<std::string, std::string>;
 
+  /// The post-processing workers share the caches.
+  std::mutex cacheMutex_;
   ProcessStartCacheCollection processStartAggregationCache_;
   ProcessImageCacheCollection processImageCache_;
   HardVolumeDriveCollection hardVolumeDrives_;
+
+  std::mutex usernamesMutex_;
   UsernameBySIDCollection usernamesBySIDs_;
 };
 
@@ -117,48 +117,64 @@ EvtSubscription::EvtSubscription(const std::string& channel)
 }
 
 void EvtSubscription::processEvent(EVT_HANDLE event) {
+  // The event handle is only valid during the callback, so the event is
+  // rendered here. The callback thread keeps its buffer, most events are
+  // rendered with a single call.
+  thread_local std::vector<wchar_t> buffer(4096U);
+
   DWORD buffer_size{0U};
   DWORD property_count{0U};
 
   if (!EvtRender(nullptr,
                  event,
                  EvtRenderEventXml,
-                 0U,
-                 nullptr,
+                 static_cast<DWORD>(buffer.size() * sizeof(wchar_t)),
+                 buffer.data(),
                  &buffer_size,
                  &property_count)) {
     auto error = GetLastError();
 
     if (error != ERROR_INSUFFICIENT_BUFFER) {
-      LOG(ERROR) << "Failed to allocated the necessary memory to handle an "
-                    "event for channel "
-                 << d_->channel;
+      LOG(ERROR) << "Failed to process an event for channel " << d_->channel
+                 << ". Error: " << error;
 
       return;
     }
-  }
 
-  std::wstring buffer(buffer_size / 2U, L'\0');
-  if (!EvtRender(nullptr,
-                 event,
-                 EvtRenderEventXml,
-                 buffer_size,
-                 &buffer[0],
-                 &buffer_size,
-                 &property_count)) {
-    auto error = GetLastError();
+    buffer.resize(buffer_size / sizeof(wchar_t) + 1U);
+    if (!EvtRender(nullptr,
+                   event,
+                   EvtRenderEventXml,
+                   static_cast<DWORD>(buffer.size() * sizeof(wchar_t)),
+                   buffer.data(),
+                   &buffer_size,
+                   &property_count)) {
+      error = GetLastError();
+
+      LOG(ERROR) << "Failed to process an event for channel " << d_->channel
+                 << ". Error: " << error;
 
-    LOG(ERROR) << "Failed to process an event for channel " << d_->channel
-               << ". Error: " << error;
+      return;
+    }
+  }
 
-    return;
+  // The rendered size includes the null terminator.
+  auto length = buffer_size / sizeof(wchar_t);
+  if (length > 0U && buffer[length - 1U] == L'\0') {
+    --length;
   }
 
+  bool was_empty = false;
   {
     std::lock_guard<std::mutex> lock(d_->event_list_mutex);
-    d_->event_list.push_back(std::move(buffer));
+    was_empty = d_->event_list.empty();
+    d_->event_list.emplace_back(buffer.data(), length);
   }
 
-  d_->event_list_cv.notify_one();
+  // The consumer takes every queued event at once, it only waits when the
+  // list is empty.
+  if (was_empty) {
+    d_->event_list_cv.notify_one();
+  }
 }
 } // namespace osquery
@@ -9,6 +9,7 @@
 
 #include <algorithm>
 #include <array>
+#include <chrono>
 #include <ctime>
 #include <iomanip>
 #include <map>
@@ -18,7 +19,9 @@
 #include <winioctl.h>
 
 #include <osquery/core/flags.h>
+#include <osquery/database/database.h>
 #include <osquery/logger/logger.h>
+#include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/conversions/windows/strings.h>
 #include <osquery/utils/conversions/windows/windows_time.h>
 #include <osquery/utils/system/errno.h>
@@ -41,6 +44,11 @@ HIDDEN_FLAG(bool,
             false,
             "Debug USN journal messages");
 
+FLAG(bool,
+     usn_journal_reader_checkpoint,
+     true,
+     "Resume the NTFS journal readers from the last processed USN");
+
 // clang-format off
 const std::unordered_map<int, std::string> kWindowsFileAttributeMap = {
     {FILE_ATTRIBUTE_ARCHIVE, "FILE_ATTRIBUTE_ARCHIVE"},
@@ -102,8 +110,17 @@ const std::unordered_map<USNJournalEventRecord::Type, std::string>
 // clang-format on
 
 namespace {
-/// Read buffer size
-const size_t kUSNJournalReaderBufferSize = 4096U;
+/// Read buffer size; a busy volume is drained with a few large reads
+const size_t kUSNJournalReaderBufferSize = 0x10000U;
+
+/// A read returns as soon as this many bytes of records are available
+const DWORD kUSNJournalReaderBytesToWaitFor = 4096U;
+
+/// How often the sequence number of the dispatched records is persisted
+const std::chrono::seconds kUSNJournalCheckpointInterval{10};
+
+/// Database key prefix of the per-volume checkpoints
+const std::string kUSNJournalCheckpointPrefix{"usn_journal_checkpoint."};
 
 /// This variable holds the list of change events we are interested in. Order
 /// is important, as it determines the priority when decompressing/splitting
@@ -204,8 +221,8 @@ struct USNJournalReader::PrivateData final {
   /// journal_reader_context->drive_letter
   HANDLE volume_handle{INVALID_HANDLE_VALUE};
 
-  /// Read buffer
-  std::array<std::uint8_t, kUSNJournalReaderBufferSize> read_buffer;
+  /// Read buffer; records are 64 bits aligned from the buffer start
+  alignas(8) std::array<std::uint8_t, kUSNJournalReaderBufferSize> read_buffer;
 
   /// How many bytes the service was able to read during the last acquireRecords
   /// call
@@ -224,6 +241,12 @@ struct USNJournalReader::PrivateData final {
   /// The volume path (i.e.: \\.\C:)
   std::string volume_path;
 
+  /// The sequence number saved by the last checkpoint
+  USN checkpoint_seq_number{0U};
+
+  /// When the last checkpoint was saved
+  std::chrono::steady_clock::time_point checkpoint_time;
+
   /// This map is used to deduplicate the journal records; when the maximum size
   /// is reached, the oldest entries are automatically cleared
   USNPerFileLastRecordType per_file_last_record_type_map;
@@ -286,14 +309,65 @@ Status USNJournalReader::initialize() {
   /// This is the next USN identifier, to be used when requesting the next
   /// updates; we keep the initial ones for queries
   d_->initial_sequence_number = journal_data.NextUsn;
-  d_->next_update_seq_number = d_->initial_sequence_number;
 
   // Also save the journal id
   d_->journal_id = journal_data.UsnJournalID;
 
+  // Resume from the records the previous worker has dispatched
+  if (FLAGS_usn_journal_reader_checkpoint) {
+    std::string checkpoint;
+    getDatabaseValue(kPersistentSettings,
+                     kUSNJournalCheckpointPrefix +
+                         d_->journal_reader_context->drive_letter,
+                     checkpoint);
+
+    d_->initial_sequence_number =
+        GetUSNJournalResumeSequenceNumber(checkpoint,
+                                          journal_data.UsnJournalID,
+                                          journal_data.FirstUsn,
+                                          journal_data.NextUsn);
+
+    if (d_->initial_sequence_number != journal_data.NextUsn) {
+      VLOG(1) << "Resuming the journal of the following volume: "
+              << d_->volume_path << " from USN "
+              << d_->initial_sequence_number;
+    }
+  }
+
+  d_->next_update_seq_number = d_->initial_sequence_number;
+  d_->checkpoint_seq_number = d_->initial_sequence_number;
+  d_->checkpoint_time = std::chrono::steady_clock::now();
+
   return Status::success();
 }
 
+void USNJournalReader::saveCheckpoint(bool force) {
+  if (!FLAGS_usn_journal_reader_checkpoint ||
+      d_->next_update_seq_number == d_->checkpoint_seq_number) {
+    return;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  if (!force && now - d_->checkpoint_time < kUSNJournalCheckpointInterval) {
+    return;
+  }
+
+  auto status = setDatabaseValue(
+      kPersistentSettings,
+      kUSNJournalCheckpointPrefix + d_->journal_reader_context->drive_letter,
+      SerializeUSNJournalCheckpoint(d_->journal_id,
+                                    d_->next_update_seq_number));
+  if (!status.ok()) {
+    VLOG(1) << "Failed to save the journal checkpoint of the following "
+               "volume: "
+            << d_->volume_path << ". " << status.getMessage();
+    return;
+  }
+
+  d_->checkpoint_seq_number = d_->next_update_seq_number;
+  d_->checkpoint_time = now;
+}
+
 Status USNJournalReader::acquireRecords() {
   static const DWORD flag_mask = GetUSNChangeReasonFlagMask();
 
@@ -305,7 +379,7 @@ Status USNJournalReader::acquireRecords() {
                                                 flag_mask,
                                                 0U,
                                                 1U,
-                                                kUSNJournalReaderBufferSize,
+                                                kUSNJournalReaderBytesToWaitFor,
                                                 d_->journal_id,
                                                 2U,
                                                 3U};
@@ -362,6 +436,8 @@ Status USNJournalReader::processAcquiredRecords(
     std::vector<USNJournalEventRecord>& record_list) {
   record_list.clear();
 
+  // The records are parsed in place in the read buffer; only the ones
+  // producing events are converted
   const auto buffer_end_ptr = d_->read_buffer.data() + d_->bytes_received;
 
   auto current_buffer_ptr = d_->read_buffer.data() + sizeof(USN);
@@ -396,7 +472,7 @@ Status USNJournalReader::processAcquiredRecords(
 }
 
 void USNJournalReader::dispatchEventRecords(
-    const std::vector<USNJournalEventRecord>& record_list) {
+    std::vector<USNJournalEventRecord>& record_list) {
   if (record_list.empty()) {
     return;
   }
@@ -407,12 +483,15 @@ void USNJournalReader::dispatchEventRecords(
   {
     WriteLock lock(context->processed_records_mutex);
 
-    context->processed_record_list.reserve(
-        context->processed_record_list.size() + record_list.size());
-
-    context->processed_record_list.insert(context->processed_record_list.end(),
-                                          record_list.begin(),
-                                          record_list.end());
+    auto& processed_record_list = context->processed_record_list;
+    if (processed_record_list.empty()) {
+      processed_record_list.swap(record_list);
+    } else {
+      processed_record_list.insert(
+          processed_record_list.end(),
+          std::make_move_iterator(record_list.begin()),
+          std::make_move_iterator(record_list.end()));
+    }
 
     context->processed_records_cv.notify_all();
   }
@@ -445,7 +524,10 @@ void USNJournalReader::start() {
 
     // Send the new records to the event publisher
     dispatchEventRecords(record_list);
+    saveCheckpoint(false);
   }
+
+  saveCheckpoint(true);
 }
 
 void USNJournalReader::stop() {
@@ -505,9 +587,9 @@ Status USNJournalReader::DecompressRecord(
         TLOG << new_record;
       }
 
-      new_records.push_back(std::move(new_record));
       per_file_last_record_type_map[new_record.node_ref_number] =
           new_record.type;
+      new_records.push_back(std::move(new_record));
 
       // clear out space if map if hit size limit (oldest records, first)
       if (per_file_last_record_type_map.size() >= 20000U) {
@@ -550,6 +632,24 @@ Status USNJournalReader::ProcessAndAppendUSNRecord(
     return Status::failure("Failed to get the file reference number");
   }
 
+  DWORD reason;
+  if (!USNParsers::GetReason(reason, record)) {
+    return Status::failure("Failed to get the `reason` field from the record");
+  }
+
+  if (!USNParsers::GetAttributes(base_event_record.attributes, record)) {
+    return Status::failure("Failed to get the file attributes");
+  }
+
+  // Most records repeat the last event of their file; skip them before
+  // the name is converted
+  if (!HasNewUSNEvents(base_event_record.node_ref_number,
+                       reason,
+                       base_event_record.attributes,
+                       per_file_last_record_type_map)) {
+    return Status::success();
+  }
+
   if (!USNParsers::GetParentFileReferenceNumber(
           base_event_record.parent_ref_number, record)) {
     return Status::failure("Failed to get the parent reference number");
@@ -559,19 +659,11 @@ Status USNJournalReader::ProcessAndAppendUSNRecord(
     return Status::failure("Failed to get the timestamp");
   }
 
-  if (!USNParsers::GetAttributes(base_event_record.attributes, record)) {
-    return Status::failure("Failed to get the file attributes");
-  }
-
   if (!USNParsers::GetEventString(base_event_record.name, record)) {
     return Status::failure("Failed to acquire the file name");
   }
 
   // Now decompress the record by splitting the `reason` field
-  DWORD reason;
-  if (!USNParsers::GetReason(reason, record)) {
-    return Status::failure("Failed to get the `reason` field from the record");
-  }
 
   auto status = DecompressRecord(
       record_list, base_event_record, reason, per_file_last_record_type_map);
@@ -582,6 +674,62 @@ Status USNJournalReader::ProcessAndAppendUSNRecord(
   return Status::success();
 }
 
+bool USNJournalReader::HasNewUSNEvents(
+    const USNFileReferenceNumber& node_ref_number,
+    DWORD journal_record_reason,
+    DWORD journal_file_attributes,
+    const USNPerFileLastRecordType& per_file_last_record_type_map) {
+  auto last_file_state_it = per_file_last_record_type_map.find(node_ref_number);
+  if (last_file_state_it == per_file_last_record_type_map.end()) {
+    return true;
+  }
+
+  // DecompressRecord emits every bit whose type differs from the previous one
+  for (const auto& reason_bit : kUSNChangeReasonFlagList) {
+    if ((journal_record_reason & reason_bit) == 0) {
+      continue;
+    }
+
+    USNJournalEventRecord::Type type;
+    if (!USNParsers::GetEventType(type, reason_bit, journal_file_attributes) ||
+        type != last_file_state_it->second) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+std::string SerializeUSNJournalCheckpoint(DWORDLONG journal_id, USN usn) {
+  return std::to_string(journal_id) + ":" + std::to_string(usn);
+}
+
+USN GetUSNJournalResumeSequenceNumber(const std::string& checkpoint,
+                                      DWORDLONG journal_id,
+                                      USN first_usn,
+                                      USN next_usn) {
+  auto separator = checkpoint.find(':');
+  if (separator == std::string::npos) {
+    return next_usn;
+  }
+
+  auto checkpoint_journal_id =
+      tryTo<std::uint64_t>(checkpoint.substr(0, separator));
+  auto checkpoint_usn = tryTo<std::int64_t>(checkpoint.substr(separator + 1));
+  if (checkpoint_journal_id.isError() || checkpoint_usn.isError()) {
+    return next_usn;
+  }
+
+  // A journal that has been deleted and created again restarts its numbering
+  if (checkpoint_journal_id.get() != journal_id ||
+      checkpoint_usn.get() > next_usn) {
+    return next_usn;
+  }
+
+  // The oldest records may have been purged while osquery was not running
+  return std::max<USN>(checkpoint_usn.get(), first_usn);
+}
+
 void GetNativeFileIdFromUSNReference(FILE_ID_DESCRIPTOR& file_id,
                                      const USNFileReferenceNumber& ref) {
   file_id = {};
@@ -187,9 +187,12 @@ class USNJournalReader final : public InternalRunnable {
   Status processAcquiredRecords(
       std::vector<USNJournalEventRecord>& record_list);
 
-  /// Sends the given record vector to the publisher
-  void dispatchEventRecords(
-      const std::vector<USNJournalEventRecord>& record_list);
+  /// Moves the given records to the publisher
+  void dispatchEventRecords(std::vector<USNJournalEventRecord>& record_list);
+
+  /// Persists the sequence number of the dispatched records, at most once
+  /// per checkpoint interval unless forced
+  void saveCheckpoint(bool force);
 
  protected:
   /// Service entry point
@@ -212,6 +215,14 @@ class USNJournalReader final : public InternalRunnable {
       DWORD journal_record_reason,
       USNPerFileLastRecordType& per_file_last_record_type_map);
 
+  /// Returns false when every event of the record repeats the last event of
+  /// its file, and DecompressRecord would not emit anything
+  static bool HasNewUSNEvents(
+      const USNFileReferenceNumber& node_ref_number,
+      DWORD journal_record_reason,
+      DWORD journal_file_attributes,
+      const USNPerFileLastRecordType& per_file_last_record_type_map);
+
   /// Processes a single USN record, appending the output to the given vector
   static Status ProcessAndAppendUSNRecord(
       std::vector<USNJournalEventRecord>& record_list,
@@ -222,6 +233,17 @@ class USNJournalReader final : public InternalRunnable {
 
 using USNJournalReaderRef = std::shared_ptr<USNJournalReader>;
 
+/// Serializes the journal id and next sequence number of a volume
+std::string SerializeUSNJournalCheckpoint(DWORDLONG journal_id, USN usn);
+
+/// Returns the sequence number a reader resumes from given its saved
+/// checkpoint; the current end of the journal is used when the checkpoint
+/// is missing or belongs to another journal
+USN GetUSNJournalResumeSequenceNumber(const std::string& checkpoint,
+                                      DWORDLONG journal_id,
+                                      USN first_usn,
+                                      USN next_usn);
+
 /// Converts our USNFileReferenceNumber type to the native format
 void GetNativeFileIdFromUSNReference(FILE_ID_DESCRIPTOR& file_id,
                                      const USNFileReferenceNumber& ref);
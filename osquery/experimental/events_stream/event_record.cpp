@@ -0,0 +1,196 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <cstring>
+#include <limits>
+
+#include <osquery/experimental/events_stream/event_record.h>
+
+namespace osquery {
+namespace events {
+
+namespace {
+
+/// Each field is preceded by its 32-bit length.
+const std::size_t kFieldLengthSize{4U};
+
+template <typename T>
+T readValue(const char* data) {
+  T value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+} // namespace
+
+EventRecordWriter::EventRecordWriter(std::vector<char>& buffer)
+    : buffer_(buffer) {
+  buffer_.clear();
+}
+
+void EventRecordWriter::begin(EventRecordType type) {
+  buffer_.resize(kEventRecordHeaderSize);
+  field_count_ = 0U;
+
+  auto record_type = static_cast<std::uint16_t>(type);
+  std::memcpy(buffer_.data() + 4, &record_type, sizeof(record_type));
+}
+
+void EventRecordWriter::addInteger(std::uint64_t value) {
+  addField(&value, sizeof(value));
+}
+
+void EventRecordWriter::addString(std::string_view value) {
+  addField(value.data(), value.size());
+}
+
+const std::vector<char>& EventRecordWriter::finish() {
+  auto size = static_cast<std::uint32_t>(buffer_.size());
+  std::memcpy(buffer_.data(), &size, sizeof(size));
+  std::memcpy(buffer_.data() + 6, &field_count_, sizeof(field_count_));
+  return buffer_;
+}
+
+void EventRecordWriter::addField(const void* data, std::size_t size) {
+  if (field_count_ == std::numeric_limits<std::uint16_t>::max()) {
+    return;
+  }
+
+  auto length = static_cast<std::uint32_t>(size);
+  auto offset = buffer_.size();
+  buffer_.resize(offset + kFieldLengthSize + size);
+  std::memcpy(buffer_.data() + offset, &length, sizeof(length));
+  if (size > 0) {
+    std::memcpy(buffer_.data() + offset + kFieldLengthSize, data, size);
+  }
+
+  ++field_count_;
+}
+
+EventRecordView::EventRecordView(const char* data, std::size_t size)
+    : data_(data), size_(size) {
+  if (data_ == nullptr || size_ < kEventRecordHeaderSize ||
+      readValue<std::uint32_t>(data_) != size_) {
+    return;
+  }
+
+  auto offset = kEventRecordHeaderSize;
+  for (std::size_t i = 0; i < fieldCount(); ++i) {
+    if (size_ - offset < kFieldLengthSize) {
+      return;
+    }
+
+    auto length = readValue<std::uint32_t>(data_ + offset);
+    offset += kFieldLengthSize;
+    if (size_ - offset < length) {
+      return;
+    }
+    offset += length;
+  }
+
+  valid_ = (offset == size_);
+}
+
+bool EventRecordView::valid() const {
+  return valid_;
+}
+
+EventRecordType EventRecordView::type() const {
+  return static_cast<EventRecordType>(readValue<std::uint16_t>(data_ + 4));
+}
+
+std::size_t EventRecordView::fieldCount() const {
+  return readValue<std::uint16_t>(data_ + 6);
+}
+
+bool EventRecordView::getInteger(std::size_t index,
+                                 std::uint64_t& value) const {
+  std::string_view field;
+  if (!getField(index, field) || field.size() != sizeof(value)) {
+    return false;
+  }
+
+  value = readValue<std::uint64_t>(field.data());
+  return true;
+}
+
+bool EventRecordView::getString(std::size_t index,
+                                std::string_view& value) const {
+  return getField(index, value);
+}
+
+bool EventRecordView::getField(std::size_t index,
+                               std::string_view& field) const {
+  if (!valid_ || index >= fieldCount()) {
+    return false;
+  }
+
+  // Fields were bounds checked when the view was created.
+  auto offset = kEventRecordHeaderSize;
+  for (std::size_t i = 0; i < index; ++i) {
+    offset += kFieldLengthSize + readValue<std::uint32_t>(data_ + offset);
+  }
+
+  auto length = readValue<std::uint32_t>(data_ + offset);
+  field = std::string_view(data_ + offset + kFieldLengthSize, length);
+  return true;
+}
+
+std::shared_ptr<EventRecordBufferPool> EventRecordBufferPool::create(
+    std::size_t max_free) {
+  return std::shared_ptr<EventRecordBufferPool>(
+      new EventRecordBufferPool(max_free));
+}
+
+EventRecordBufferPool::EventRecordBufferPool(std::size_t max_free)
+    : max_free_(max_free) {}
+
+EventRecordBufferPool::Buffer EventRecordBufferPool::acquire() {
+  std::unique_ptr<std::vector<char>> buffer;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_.empty()) {
+      buffer = std::move(free_.back());
+      free_.pop_back();
+    }
+  }
+
+  if (buffer == nullptr) {
+    buffer = std::make_unique<std::vector<char>>();
+  }
+
+  // Buffers released after the pool is gone are freed.
+  std::weak_ptr<EventRecordBufferPool> pool = shared_from_this();
+  return Buffer(buffer.release(), [pool](std::vector<char>* released) {
+    auto owner = pool.lock();
+    if (owner != nullptr) {
+      owner->release(released);
+    } else {
+      delete released;
+    }
+  });
+}
+
+std::size_t EventRecordBufferPool::freeCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return free_.size();
+}
+
+void EventRecordBufferPool::release(std::vector<char>* buffer) {
+  std::unique_ptr<std::vector<char>> owned(buffer);
+  owned->clear();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (free_.size() < max_free_) {
+    free_.push_back(std::move(owned));
+  }
+}
+
+} // namespace events
+} // namespace osquery
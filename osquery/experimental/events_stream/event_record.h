@@ -0,0 +1,134 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace osquery {
+namespace events {
+
+/**
+ * @brief The record types shared by producers and consumers.
+ *
+ * A record is a 32-bit size covering the whole record, a 16-bit type and a
+ * 16-bit field count, followed by the fields. Each field is a 32-bit length
+ * and its bytes, integers are 8 bytes in host byte order. Values are native
+ * endian because records never leave the host.
+ */
+enum class EventRecordType : std::uint16_t {
+  /// Fills the end of a ring buffer, it is never returned to readers.
+  Padding = 0,
+
+  /**
+   * A process execution from the linuxevents experiment.
+   *
+   * Fields: ktime, ppid, pid (integers), cgroup path, binary path (strings),
+   * then one string field for each argument.
+   */
+  ProcessExec = 1,
+};
+
+/// The size of the record header: size, type and field count.
+constexpr std::size_t kEventRecordHeaderSize{8U};
+
+/// Encodes one record at a time into a reusable buffer.
+class EventRecordWriter final {
+ public:
+  /// The buffer is cleared, its capacity is kept across records.
+  explicit EventRecordWriter(std::vector<char>& buffer);
+
+  /// Start a record, discarding the previous one.
+  void begin(EventRecordType type);
+
+  void addInteger(std::uint64_t value);
+  void addString(std::string_view value);
+
+  /// Complete the header, the record is the whole buffer.
+  const std::vector<char>& finish();
+
+ private:
+  void addField(const void* data, std::size_t size);
+
+ private:
+  std::vector<char>& buffer_;
+  std::uint16_t field_count_{0U};
+};
+
+/**
+ * @brief Read the fields of an encoded record without copying them.
+ *
+ * The view does not own the record bytes.
+ */
+class EventRecordView final {
+ public:
+  EventRecordView() = default;
+  EventRecordView(const char* data, std::size_t size);
+
+  /// True if the header and every field are within the record.
+  bool valid() const;
+
+  EventRecordType type() const;
+  std::size_t fieldCount() const;
+
+  bool getInteger(std::size_t index, std::uint64_t& value) const;
+  bool getString(std::size_t index, std::string_view& value) const;
+
+ private:
+  bool getField(std::size_t index, std::string_view& field) const;
+
+ private:
+  const char* data_{nullptr};
+  std::size_t size_{0U};
+  bool valid_{false};
+};
+
+/**
+ * @brief Reuse record buffers across threads.
+ *
+ * Buffers are returned when released and keep their capacity, so encoding
+ * stops allocating once the buffers have grown to the largest record.
+ */
+class EventRecordBufferPool final
+    : public std::enable_shared_from_this<EventRecordBufferPool> {
+ public:
+  using BufferDeleter = std::function<void(std::vector<char>*)>;
+  using Buffer = std::unique_ptr<std::vector<char>, BufferDeleter>;
+
+  /// Create a pool keeping up to a number of released buffers.
+  static std::shared_ptr<EventRecordBufferPool> create(std::size_t max_free);
+
+  /// Take a buffer, it goes back to the pool when released.
+  Buffer acquire();
+
+  /// The number of buffers waiting to be reused.
+  std::size_t freeCount() const;
+
+ private:
+  explicit EventRecordBufferPool(std::size_t max_free);
+
+  void release(std::vector<char>* buffer);
+
+ private:
+  const std::size_t max_free_;
+
+  std::vector<std::unique_ptr<std::vector<char>>> free_;
+
+  mutable std::mutex mutex_;
+};
+
+} // namespace events
+} // namespace osquery
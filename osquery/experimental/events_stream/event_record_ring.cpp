@@ -0,0 +1,276 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <atomic>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <osquery/experimental/events_stream/event_record_ring.h>
+
+namespace osquery {
+namespace events {
+
+namespace {
+
+const std::uint64_t kRingMagic{0x6f73717279726e67ULL};
+const std::uint32_t kRingVersion{1U};
+
+/// Records start on their own page, after the header.
+const std::size_t kRingDataOffset{4096U};
+
+const std::size_t kRecordAlignment{8U};
+
+std::size_t alignRecordSize(std::size_t size) {
+  return (size + kRecordAlignment - 1) & ~(kRecordAlignment - 1);
+}
+
+std::size_t roundCapacity(std::size_t capacity) {
+  std::size_t size = 4096U;
+  while (size < capacity) {
+    size <<= 1;
+  }
+  return size;
+}
+
+} // namespace
+
+struct EventRecordRing::Header final {
+  std::uint64_t magic;
+  std::uint32_t version;
+  std::uint32_t reserved;
+  std::uint64_t capacity;
+
+  /// Total bytes written, the writer publishes records by advancing it.
+  alignas(64) std::atomic<std::uint64_t> write_position;
+};
+
+static_assert(sizeof(std::atomic<std::uint64_t>) == sizeof(std::uint64_t) &&
+                  std::atomic<std::uint64_t>::is_always_lock_free,
+              "The ring header is shared between processes");
+
+Expected<EventRecordRing::Ptr, EventRecordRing::ErrorCode>
+EventRecordRing::create(const std::string& name, std::size_t capacity) {
+  if (name.size() < 2 || name.front() != '/' || capacity == 0) {
+    return createError(ErrorCode::InvalidArgument)
+           << "Invalid ring name or capacity";
+  }
+
+  capacity = roundCapacity(capacity);
+  ::shm_unlink(name.c_str());
+
+  auto fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd == -1) {
+    return createError(ErrorCode::SharedMemoryFailure)
+           << "Failed to create the shared memory object " << name;
+  }
+
+  auto size = kRingDataOffset + capacity;
+  Ptr ring(new EventRecordRing());
+  ring->name_ = name;
+  ring->owner_ = true;
+
+  auto mapped = (::ftruncate(fd, static_cast<off_t>(size)) == 0) &&
+                ring->map(fd, size, true);
+  ::close(fd);
+
+  if (!mapped) {
+    return createError(ErrorCode::SharedMemoryFailure)
+           << "Failed to map the shared memory object " << name;
+  }
+
+  // Readers check the magic last, once the header is complete.
+  auto header = new (ring->mapping_) Header();
+  header->version = kRingVersion;
+  header->reserved = 0U;
+  header->capacity = capacity;
+  header->write_position.store(0U, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = kRingMagic;
+
+  ring->header_ = header;
+  ring->capacity_ = capacity;
+  return ring;
+}
+
+Expected<EventRecordRing::Ptr, EventRecordRing::ErrorCode>
+EventRecordRing::open(const std::string& name) {
+  auto fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd == -1) {
+    return createError(ErrorCode::SharedMemoryFailure)
+           << "Failed to open the shared memory object " << name;
+  }
+
+  struct stat info;
+  if (::fstat(fd, &info) != 0 ||
+      static_cast<std::size_t>(info.st_size) <= kRingDataOffset) {
+    ::close(fd);
+    return createError(ErrorCode::IncompatibleRing)
+           << "The shared memory object is too small";
+  }
+
+  Ptr ring(new EventRecordRing());
+  ring->name_ = name;
+  auto mapped = ring->map(fd, static_cast<std::size_t>(info.st_size), false);
+  ::close(fd);
+
+  if (!mapped) {
+    return createError(ErrorCode::SharedMemoryFailure)
+           << "Failed to map the shared memory object " << name;
+  }
+
+  auto header = static_cast<Header*>(ring->mapping_);
+  if (header->magic != kRingMagic || header->version != kRingVersion ||
+      header->capacity + kRingDataOffset > ring->mapping_size_ ||
+      (header->capacity & (header->capacity - 1)) != 0) {
+    return createError(ErrorCode::IncompatibleRing)
+           << "The shared memory object is not a compatible ring";
+  }
+
+  ring->header_ = header;
+  ring->capacity_ = header->capacity;
+
+  // Readers start with the records written after they open the ring.
+  ring->read_position_ =
+      header->write_position.load(std::memory_order_acquire);
+  return ring;
+}
+
+EventRecordRing::~EventRecordRing() {
+  if (mapping_ != nullptr) {
+    ::munmap(mapping_, mapping_size_);
+  }
+
+  if (owner_) {
+    ::shm_unlink(name_.c_str());
+  }
+}
+
+bool EventRecordRing::write(const std::vector<char>& record) {
+  if (!owner_ || record.size() < kEventRecordHeaderSize ||
+      alignRecordSize(record.size()) > capacity_ / 2) {
+    return false;
+  }
+
+  auto position = header_->write_position.load(std::memory_order_relaxed);
+  auto offset = static_cast<std::size_t>(position & (capacity_ - 1));
+  auto size = alignRecordSize(record.size());
+
+  if (offset + size > capacity_) {
+    // Records are never split across the end of the ring.
+    auto padding_size = static_cast<std::uint32_t>(capacity_ - offset);
+    auto padding_type = static_cast<std::uint16_t>(EventRecordType::Padding);
+    std::memcpy(data_ + offset, &padding_size, sizeof(padding_size));
+    std::memcpy(data_ + offset + 4, &padding_type, sizeof(padding_type));
+
+    // Publish the padding first, at most one record is written in place.
+    position += padding_size;
+    header_->write_position.store(position, std::memory_order_release);
+    offset = 0U;
+  }
+
+  std::memcpy(data_ + offset, record.data(), record.size());
+  header_->write_position.store(position + size, std::memory_order_release);
+  return true;
+}
+
+bool EventRecordRing::read(std::vector<char>& buffer, EventRecordView& view) {
+  for (;;) {
+    auto write_position =
+        header_->write_position.load(std::memory_order_acquire);
+    if (read_position_ == write_position) {
+      return false;
+    }
+
+    if (overrun(write_position)) {
+      skipOverrun(write_position);
+      continue;
+    }
+
+    auto offset = static_cast<std::size_t>(read_position_ & (capacity_ - 1));
+    std::uint32_t size;
+    std::uint16_t type;
+    std::memcpy(&size, data_ + offset, sizeof(size));
+    std::memcpy(&type, data_ + offset + 4, sizeof(type));
+
+    auto padding =
+        (type == static_cast<std::uint16_t>(EventRecordType::Padding));
+    auto valid_size = padding ? size == capacity_ - offset
+                              : size >= kEventRecordHeaderSize &&
+                                    alignRecordSize(size) <= capacity_ - offset;
+
+    if (valid_size && !padding) {
+      if (buffer.size() < size) {
+        buffer.resize(size);
+      }
+      std::memcpy(buffer.data(), data_ + offset, size);
+    }
+
+    // The writer may have overwritten the record while it was copied.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    write_position = header_->write_position.load(std::memory_order_relaxed);
+    if (overrun(write_position)) {
+      skipOverrun(write_position);
+      continue;
+    }
+
+    if (!valid_size) {
+      // Not overwritten yet still invalid, the ring is not usable.
+      skipOverrun(write_position);
+      return false;
+    }
+
+    read_position_ += padding ? size : alignRecordSize(size);
+    if (padding) {
+      continue;
+    }
+
+    view = EventRecordView(buffer.data(), size);
+    if (view.valid()) {
+      return true;
+    }
+  }
+}
+
+std::size_t EventRecordRing::overrunCount() const {
+  return overrun_count_;
+}
+
+std::size_t EventRecordRing::capacity() const {
+  return capacity_;
+}
+
+bool EventRecordRing::map(int fd, std::size_t size, bool writable) {
+  auto protection = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+  auto mapping = ::mmap(nullptr, size, protection, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+
+  mapping_ = mapping;
+  mapping_size_ = size;
+  data_ = static_cast<char*>(mapping_) + kRingDataOffset;
+  return true;
+}
+
+bool EventRecordRing::overrun(std::uint64_t write_position) const {
+  // The writer may be copying a record of up to half the ring in place.
+  return write_position - read_position_ > capacity_ / 2;
+}
+
+void EventRecordRing::skipOverrun(std::uint64_t write_position) {
+  read_position_ = write_position;
+  ++overrun_count_;
+}
+
+} // namespace events
+} // namespace osquery
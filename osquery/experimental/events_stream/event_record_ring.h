@@ -0,0 +1,119 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <osquery/experimental/events_stream/event_record.h>
+#include <osquery/utils/expected/expected.h>
+
+namespace osquery {
+namespace events {
+
+/**
+ * @brief A shared memory ring of event records.
+ *
+ * One process creates the ring and writes records, any number of processes
+ * open it by name and read them. Writers never wait for readers: a reader
+ * that falls behind by more than half the ring skips the records it missed,
+ * and counts the overrun. Records are at most half the ring, so the other
+ * half is what the writer may be overwriting.
+ *
+ * Records are stored contiguously, 8-byte aligned. A padding record fills
+ * the end of the ring when the next record does not fit before the wrap.
+ */
+class EventRecordRing final {
+ public:
+  enum class ErrorCode {
+    InvalidArgument,
+    SharedMemoryFailure,
+    IncompatibleRing,
+  };
+
+  using Ptr = std::unique_ptr<EventRecordRing>;
+
+  /**
+   * @brief Create the ring, replacing a ring with the same name.
+   *
+   * @param name The shared memory object name, starting with '/'.
+   * @param capacity The size of the record area, rounded up to a power of 2.
+   */
+  static Expected<Ptr, ErrorCode> create(const std::string& name,
+                                         std::size_t capacity);
+
+  /// Open a ring created by another process, for reading.
+  static Expected<Ptr, ErrorCode> open(const std::string& name);
+
+  /// Unmaps the ring, the creator also removes its name.
+  ~EventRecordRing();
+
+  /**
+   * @brief Append a record, only the creator may write.
+   *
+   * @return false if the record is larger than half the ring.
+   */
+  bool write(const std::vector<char>& record);
+
+  /**
+   * @brief Copy the next record to a reusable buffer.
+   *
+   * The buffer only grows, so reading does not allocate once it holds the
+   * largest record.
+   *
+   * @return false if there is no new record.
+   */
+  bool read(std::vector<char>& buffer, EventRecordView& view);
+
+  /// The number of times this reader was overrun and skipped records.
+  std::size_t overrunCount() const;
+
+  /// The size of the record area.
+  std::size_t capacity() const;
+
+  EventRecordRing(const EventRecordRing&) = delete;
+  EventRecordRing& operator=(const EventRecordRing&) = delete;
+
+ private:
+  struct Header;
+
+  EventRecordRing() = default;
+
+  /// Map a shared memory object and check its header.
+  bool map(int fd, std::size_t size, bool writable);
+
+  /// True if the record at the read position may have been overwritten.
+  bool overrun(std::uint64_t write_position) const;
+
+  /// Skip the records a reader missed.
+  void skipOverrun(std::uint64_t write_position);
+
+ private:
+  std::string name_;
+  bool owner_{false};
+
+  void* mapping_{nullptr};
+  std::size_t mapping_size_{0U};
+
+  Header* header_{nullptr};
+  char* data_{nullptr};
+  std::size_t capacity_{0U};
+
+  /// The next position of this reader.
+  std::uint64_t read_position_{0U};
+
+  std::size_t overrun_count_{0U};
+};
+
+} // namespace events
+} // namespace osquery
@@ -14,6 +14,12 @@
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry.h>
 
+#ifndef WIN32
+#include <osquery/experimental/events_stream/event_record_ring.h>
+#endif
+
+#include <mutex>
+
 #include <boost/io/quoted.hpp>
 
 namespace osquery {
@@ -22,6 +28,14 @@ DEFINE_string(events_streaming_plugin,
               "",
               "Experimental events streaming plugin");
 
+DEFINE_string(events_stream_ring,
+              "",
+              "Experimental shared memory ring receiving binary event records");
+
+DEFINE_uint64(events_stream_ring_size,
+              16 * 1024 * 1024,
+              "Size in bytes of the experimental event record ring");
+
 namespace events {
 
 void dispatchSerializedEvent(const std::string& serialized_event) {
@@ -40,5 +54,46 @@ void dispatchSerializedEvent(const std::string& serialized_event) {
   }
 }
 
+bool streamsEventRecords() {
+#ifdef WIN32
+  return false;
+#else
+  return !FLAGS_events_stream_ring.empty();
+#endif
+}
+
+bool dispatchEventRecord(const std::vector<char>& record) {
+#ifdef WIN32
+  return false;
+#else
+  if (FLAGS_events_stream_ring.empty()) {
+    return false;
+  }
+
+  static std::mutex ring_mutex;
+  static EventRecordRing::Ptr ring;
+  static bool ring_failed{false};
+
+  std::lock_guard<std::mutex> lock(ring_mutex);
+  if (ring == nullptr) {
+    if (ring_failed) {
+      return false;
+    }
+
+    auto ring_exp = EventRecordRing::create(FLAGS_events_stream_ring,
+                                            FLAGS_events_stream_ring_size);
+    if (ring_exp.isError()) {
+      LOG(ERROR) << "Event records will not be streamed: "
+                 << ring_exp.getError().getMessage();
+      ring_failed = true;
+      return false;
+    }
+    ring = ring_exp.take();
+  }
+
+  return ring->write(record);
+#endif
+}
+
 } // namespace events
 } // namespace osquery
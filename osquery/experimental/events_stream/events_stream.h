@@ -10,11 +10,24 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 namespace osquery {
 namespace events {
 
 void dispatchSerializedEvent(const std::string& event);
 
+/// True if binary event records are streamed to a shared memory ring.
+bool streamsEventRecords();
+
+/**
+ * @brief Append a binary event record to the shared memory ring.
+ *
+ * The record is copied, the caller may reuse its buffer right away.
+ *
+ * @return false if records are not streamed or the record was rejected.
+ */
+bool dispatchEventRecord(const std::vector<char>& record);
+
 } // namespace events
 } // namespace osquery
@@ -10,6 +10,8 @@
 #include "linuxeventsservice.h"
 
 #include <osquery/core/flags.h>
+#include <osquery/experimental/events_stream/event_record.h>
+#include <osquery/experimental/events_stream/events_stream.h>
 #include <osquery/logger/logger.h>
 
 namespace osquery {
@@ -24,9 +26,36 @@ CLI_FLAG(uint32,
          1000,
          "Size of the circular buffer used by tables to store events");
 
+CLI_FLAG(bool,
+         experiments_linuxevents_stream_records,
+         false,
+         "Also stream the events as binary records, see events_stream_ring");
+
+namespace {
+
+/// Encode a process event, the ProcessExec fields are in event_record.h.
+void encodeProcessEvent(events::EventRecordWriter& writer,
+                        const tob::linuxevents::ILinuxEvents::Event& event) {
+  writer.begin(events::EventRecordType::ProcessExec);
+  writer.addInteger(event.ktime);
+  writer.addInteger(static_cast<std::uint64_t>(event.parent_process_id));
+  writer.addInteger(static_cast<std::uint64_t>(event.process_id));
+  writer.addString(event.cgroup_path);
+  writer.addString(event.binary_path);
+  for (const auto& argument : event.argument_list) {
+    writer.addString(argument);
+  }
+}
+
+} // namespace
+
 struct LinuxEventsService::PrivateData final {
   PrivateData(BPFProcessEventsTable& table_) : table(table_) {}
   BPFProcessEventsTable& table;
+
+  /// Record buffers, reused for every batch of events.
+  std::shared_ptr<events::EventRecordBufferPool> buffer_pool{
+      events::EventRecordBufferPool::create(1U)};
 };
 
 LinuxEventsService::LinuxEventsService(BPFProcessEventsTable& table)
@@ -72,6 +101,25 @@ void LinuxEventsService::start() {
     error_counters = {};
 
     auto event_list = event_list_exp.takeValue();
+    if (FLAGS_experiments_linuxevents_stream_records &&
+        events::streamsEventRecords()) {
+      auto buffer = d->buffer_pool->acquire();
+      events::EventRecordWriter writer(*buffer);
+
+      std::size_t dropped_record_count{0U};
+      for (const auto& event : event_list) {
+        encodeProcessEvent(writer, event);
+        if (!events::dispatchEventRecord(writer.finish())) {
+          ++dropped_record_count;
+        }
+      }
+
+      if (dropped_record_count != 0) {
+        LOG(ERROR) << "linuxevents experiment: Records not streamed: "
+                   << dropped_record_count;
+      }
+    }
+
     d->table.addEvents(std::move(event_list));
   }
 
@@ -7,7 +7,9 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <functional>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <tuple>
@@ -21,12 +23,15 @@
 #include <osquery/core/shutdown.h>
 #include <osquery/core/system.h>
 #include <osquery/extensions/interface.h>
+#include <osquery/extensions/shared_memory.h>
 #include <osquery/filesystem/fileops.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
 #include <osquery/process/process.h>
 #include <osquery/registry/registry.h>
 #include <osquery/sql/sql.h>
+#include <osquery/sql/table_row_batch.h>
+#include <osquery/utils/mutex.h>
 
 #include <osquery/utils/config/default_paths.h>
 #include <osquery/utils/conversions/join.h>
@@ -57,6 +62,15 @@ const std::map<PlatformType, ExtendableTypeSet> kFileExtensions{
 /// Millisecond latency between initializing manager pings.
 const size_t kExtensionInitializeLatency{20};
 
+/// The extension tables that cannot be returned by column.
+std::set<std::pair<RouteUUID, std::string>> kColumnarUnsupported;
+
+/// The extension tables that cannot be read from a cursor.
+std::set<std::pair<RouteUUID, std::string>> kCursorUnsupported;
+
+/// Protects the extension tables that cannot be returned by column or cursor.
+Mutex kColumnarUnsupportedMutex;
+
 } // namespace
 
 CLI_FLAG(bool, disable_extensions, false, "Disable extension API");
@@ -101,6 +115,89 @@ EXTENSION_FLAG_ALIAS(socket, extensions_socket);
 EXTENSION_FLAG_ALIAS(timeout, extensions_timeout);
 EXTENSION_FLAG_ALIAS(interval, extensions_interval);
 
+CLI_FLAG(uint32,
+         extensions_table_batch_rows,
+         1024,
+         "Rows read from an extension table per batch (0 reads each table in "
+         "one response)");
+
+CLI_FLAG(uint32,
+         extensions_idle_connections,
+         4,
+         "Connections kept open to each extension socket between calls (0 "
+         "connects for every call)");
+
+CLI_FLAG(uint32,
+         extensions_shared_memory_size,
+         0,
+         "Bytes of shared memory an extension receives large requests in (0 "
+         "sends every request through the socket)");
+
+namespace {
+
+/// Open connections to extension sockets that no call is using.
+std::map<std::string, std::vector<std::unique_ptr<ExtensionClient>>>
+    kIdleClients;
+
+/// Protects the idle connections.
+Mutex kIdleClientsMutex;
+
+/// Take an idle connection to a socket, or connect a new one.
+std::unique_ptr<ExtensionClient> acquireClient(const std::string& path,
+                                               bool& reused) {
+  {
+    WriteLock lock(kIdleClientsMutex);
+    auto it = kIdleClients.find(path);
+    if (it != kIdleClients.end() && !it->second.empty()) {
+      auto client = std::move(it->second.back());
+      it->second.pop_back();
+      reused = true;
+      return client;
+    }
+  }
+
+  reused = false;
+  return std::make_unique<ExtensionClient>(path);
+}
+
+/// Keep a connection for the next call, unless enough are idle.
+void releaseClient(const std::string& path,
+                   std::unique_ptr<ExtensionClient> client) {
+  WriteLock lock(kIdleClientsMutex);
+  auto& idle = kIdleClients[path];
+  if (idle.size() < FLAGS_extensions_idle_connections) {
+    idle.push_back(std::move(client));
+  }
+}
+
+/**
+ * @brief Run a call on a pooled connection to an extension socket.
+ *
+ * The server may have closed an idle connection. A call on a reused
+ * connection found closed before the request was answered is sent again on
+ * another connection. Other failures, such as timeouts, may happen after the
+ * extension ran the request and are thrown to the caller, as are failures of
+ * a new connection. Failed connections are closed.
+ */
+Status callPooledClient(const std::string& path,
+                        const std::function<Status(ExtensionClient&)>& call) {
+  while (true) {
+    bool reused = false;
+    auto client = acquireClient(path, reused);
+    try {
+      auto status = call(*client);
+      releaseClient(path, std::move(client));
+      return status;
+    } catch (const ExtensionConnectionClosed& /* e */) {
+      if (!reused) {
+        throw;
+      }
+    }
+  }
+}
+
+} // namespace
+
 /// A Dispatcher service thread that watches an ExtensionManagerHandler.
 class ExtensionWatcher : public InternalRunnable {
  public:
@@ -511,6 +608,16 @@ Status startExtension(const std::string& manager_path,
   info.sdk_version = sdk_version;
   info.min_sdk_version = min_sdk_version;
 
+  if (FLAGS_extensions_shared_memory_size > 0) {
+    status = createExtensionSharedMemory(FLAGS_extensions_shared_memory_size,
+                                         info.shared_memory);
+    if (!status.ok()) {
+      LOG(WARNING) << "Extension shared memory is not used: "
+                   << status.getMessage();
+      info.shared_memory.clear();
+    }
+  }
+
   // If registration is successful, we will also request the manager's options.
   OptionList options;
   // Register the extension's registry broadcast with the manager.
@@ -518,6 +625,8 @@ Status startExtension(const std::string& manager_path,
   try {
     ExtensionManagerClient client(manager_path);
     status = client.registerExtension(info, broadcast, uuid);
+    // The core mapped the segment while registering, if it could.
+    unlinkExtensionSharedMemory();
     // The main reason for a failed registry is a duplicate extension name
     // (the extension process is already running), or the extension broadcasts
     // a duplicate registry item.
@@ -528,6 +637,7 @@ Status startExtension(const std::string& manager_path,
     // logger and config.
     options = client.options();
   } catch (const std::exception& e) {
+    unlinkExtensionSharedMemory();
     return Status(1, "Extension register failed: " + std::string(e.what()));
   }
 
@@ -678,8 +788,12 @@ Status callExtension(const RouteUUID uuid,
   if (FLAGS_disable_extensions) {
     return Status(1, "Extensions disabled");
   }
-  return callExtension(
-      getExtensionSocket(uuid), registry, item, request, response);
+  SharedMemoryRequest shared_request(uuid, request);
+  return callExtension(getExtensionSocket(uuid),
+                       registry,
+                       item,
+                       shared_request.request(),
+                       response);
 }
 
 Status callExtension(const std::string& extension_path,
@@ -694,8 +808,9 @@ Status callExtension(const std::string& extension_path,
   }
 
   try {
-    ExtensionClient client(extension_path);
-    status = client.call(registry, item, request, response);
+    status = callPooledClient(extension_path, [&](ExtensionClient& client) {
+      return client.call(registry, item, request, response);
+    });
   } catch (const std::exception& e) {
     return Status(1, "Extension call failed: " + std::string(e.what()));
   }
@@ -703,6 +818,178 @@ Status callExtension(const std::string& extension_path,
   return status;
 }
 
+Status callExtensionTable(const std::string& table,
+                          const PluginRequest& request,
+                          TableRowBatch& batch) {
+  const Status unsupported(static_cast<int>(ExtensionCode::EXT_UNSUPPORTED),
+                           "The table is not returned by column: " + table);
+  if (FLAGS_disable_extensions) {
+    return unsupported;
+  }
+
+  auto external = RegistryFactory::get().registry("table")->getExternal();
+  RouteUUID uuid = 0;
+  if (external.count(table) > 0) {
+    uuid = external.at(table);
+  } else if (!RegistryFactory::get().external()) {
+    return unsupported;
+  }
+
+  auto key = std::make_pair(uuid, table);
+  {
+    ReadLock lock(kColumnarUnsupportedMutex);
+    if (kColumnarUnsupported.count(key) > 0) {
+      return unsupported;
+    }
+  }
+
+  auto extension_path = getExtensionSocket(uuid);
+  auto status = extensionPathActive(extension_path);
+  if (!status.ok()) {
+    return status;
+  }
+
+  try {
+    status = callPooledClient(extension_path, [&](ExtensionClient& client) {
+      return client.callColumnar("table", table, request, batch);
+    });
+  } catch (const std::exception& e) {
+    return Status(1, "Extension call failed: " + std::string(e.what()));
+  }
+
+  if (status.getCode() == static_cast<int>(ExtensionCode::EXT_UNSUPPORTED)) {
+    WriteLock lock(kColumnarUnsupportedMutex);
+    kColumnarUnsupported.insert(std::move(key));
+  }
+  return status;
+}
+
+ExtensionTableReader::ExtensionTableReader(const std::string& table,
+                                           const TableColumns& columns)
+    : table_(table), columns_(columns) {}
+
+ExtensionTableReader::~ExtensionTableReader() {
+  if (client_ == nullptr) {
+    return;
+  }
+
+  if (more_) {
+    // The extension stops generating, the rows read are complete.
+    try {
+      client_->closeCursor(cursor_);
+    } catch (const std::exception& /* e */) {
+      return;
+    }
+  }
+  releaseClient(path_, std::move(client_));
+}
+
+Status ExtensionTableReader::open(const PluginRequest& request,
+                                  TableRows& rows) {
+  const Status unsupported(static_cast<int>(ExtensionCode::EXT_UNSUPPORTED),
+                           "The table is not read from a cursor: " + table_);
+  if (FLAGS_disable_extensions || FLAGS_extensions_table_batch_rows == 0) {
+    return unsupported;
+  }
+
+  auto external = RegistryFactory::get().registry("table")->getExternal();
+  RouteUUID uuid = 0;
+  if (external.count(table_) > 0) {
+    uuid = external.at(table_);
+  } else if (!RegistryFactory::get().external()) {
+    return unsupported;
+  }
+
+  auto key = std::make_pair(uuid, table_);
+  {
+    ReadLock lock(kColumnarUnsupportedMutex);
+    if (kCursorUnsupported.count(key) > 0) {
+      return unsupported;
+    }
+  }
+
+  path_ = getExtensionSocket(uuid);
+  auto status = extensionPathActive(path_);
+  if (!status.ok()) {
+    return status;
+  }
+
+  auto call = [&](TableRowBatch& batch) {
+    return client_->openCursor(table_,
+                               request,
+                               FLAGS_extensions_table_batch_rows,
+                               batch,
+                               cursor_,
+                               more_);
+  };
+  while (true) {
+    bool reused = false;
+    client_ = acquireClient(path_, reused);
+    status = read(call, rows);
+    // An idle connection may have been closed by the extension.
+    if (client_ != nullptr || !reused) {
+      break;
+    }
+  }
+
+  if (status.getCode() == static_cast<int>(ExtensionCode::EXT_UNSUPPORTED)) {
+    WriteLock lock(kColumnarUnsupportedMutex);
+    kCursorUnsupported.insert(std::move(key));
+  }
+  return status;
+}
+
+Status ExtensionTableReader::next(TableRows& rows) {
+  if (client_ == nullptr || !more_) {
+    return Status::failure("The table cursor is closed: " + table_);
+  }
+
+  return read(
+      [this](TableRowBatch& batch) {
+        return client_->fetchCursor(cursor_, batch, more_);
+      },
+      rows);
+}
+
+Status ExtensionTableReader::read(
+    const std::function<Status(TableRowBatch&)>& call, TableRows& rows) {
+  auto batch = std::make_shared<TableRowBatch>(columns_);
+  Status status;
+  try {
+    status = call(*batch);
+  } catch (const std::exception& e) {
+    client_ = nullptr;
+    more_ = false;
+    return Status(1, "Extension call failed: " + std::string(e.what()));
+  }
+
+  if (!status.ok()) {
+    // The extension closes a cursor that fails.
+    more_ = false;
+    return status;
+  }
+  rows = tableRowsFromBatch(std::move(batch));
+  return status;
+}
+
+void resetExtensionConnections(const RouteUUID uuid) {
+  closeExtensionSharedMemory(uuid);
+
+  {
+    WriteLock lock(kIdleClientsMutex);
+    kIdleClients.erase(getExtensionSocket(uuid));
+  }
+
+  WriteLock lock(kColumnarUnsupportedMutex);
+  for (auto it = kColumnarUnsupported.begin();
+       it != kColumnarUnsupported.end();) {
+    it = (it->first == uuid) ? kColumnarUnsupported.erase(it) : std::next(it);
+  }
+  for (auto it = kCursorUnsupported.begin(); it != kCursorUnsupported.end();) {
+    it = (it->first == uuid) ? kCursorUnsupported.erase(it) : std::next(it);
+  }
+}
+
 Status startExtensionWatcher(const std::string& manager_path,
                              size_t interval,
                              bool fatal,
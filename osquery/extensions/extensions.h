@@ -9,13 +9,22 @@
 
 #pragma once
 
+#include <functional>
+#include <memory>
+
+#include <boost/noncopyable.hpp>
+
 #include <osquery/core/core.h>
 #include <osquery/core/flags.h>
 #include <osquery/core/plugins/sql.h>
+#include <osquery/core/sql/table_rows.h>
 #include <osquery/registry/registry_interface.h>
 
 namespace osquery {
 
+class ExtensionClient;
+class TableRowBatch;
+
 DECLARE_string(extensions_socket);
 DECLARE_string(extensions_autoload);
 DECLARE_string(extensions_timeout);
@@ -31,6 +40,8 @@ struct ExtensionInfo {
   std::string version;
   std::string sdk_version;
   std::string min_sdk_version;
+  /// The shared memory segment the extension reads large requests from.
+  std::string shared_memory;
 };
 
 typedef std::map<RouteUUID, ExtensionInfo> ExtensionList;
@@ -138,6 +149,80 @@ Status callExtension(const std::string& extension_path,
                      const PluginRequest& request,
                      PluginResponse& response);
 
+/**
+ * @brief Generate an extension's table, receiving its rows by column.
+ *
+ * The extension owning the table is found in the table registry, an
+ * extension process asks the core. The rows are set into the batch, the
+ * columns that are not in its schema are ignored.
+ *
+ * @param table The table name.
+ * @param request The generate request of the table.
+ * @param batch The output batch, rows are appended.
+ * @return EXT_UNSUPPORTED if the extension cannot return rows by column, the
+ * caller generates the table with Registry::call.
+ */
+Status callExtensionTable(const std::string& table,
+                          const PluginRequest& request,
+                          TableRowBatch& batch);
+
+/**
+ * @brief Reads an extension's table in batches from a cursor.
+ *
+ * The extension generates the table as batches are requested, at most
+ * --extensions_table_batch_rows rows each, so neither process holds all rows
+ * and no message holds all rows. The batches are received by column. An
+ * unfinished cursor is closed when the reader is destroyed, e.g., when a
+ * LIMIT is satisfied, and the extension stops generating.
+ */
+class ExtensionTableReader : private boost::noncopyable {
+ public:
+  ExtensionTableReader(const std::string& table, const TableColumns& columns);
+  ~ExtensionTableReader();
+
+  /**
+   * @brief Open a cursor and read the first batch.
+   *
+   * @param request The generate request of the table.
+   * @param rows The output rows of the first batch.
+   * @return EXT_UNSUPPORTED if the extension has no table cursors, the caller
+   * generates the table with callExtensionTable.
+   */
+  Status open(const PluginRequest& request, TableRows& rows);
+
+  /// Read the next batch, only while more is true.
+  Status next(TableRows& rows);
+
+  /// Check if the cursor returns another batch.
+  bool more() const {
+    return more_;
+  }
+
+ private:
+  /// Read a batch, the connection is dropped if it fails.
+  Status read(const std::function<Status(TableRowBatch&)>& call,
+              TableRows& rows);
+
+ private:
+  std::string table_;
+  TableColumns columns_;
+  std::string path_;
+
+  /// The connection the cursor is read from, it is kept for every batch.
+  std::unique_ptr<ExtensionClient> client_;
+
+  int64_t cursor_{0};
+  bool more_{false};
+};
+
+/**
+ * @brief Forget the connections to an extension that went away.
+ *
+ * Calls keep connections to extension sockets open. The UUID, and so the
+ * socket path, of a removed extension may be given to the next one.
+ */
+void resetExtensionConnections(const RouteUUID uuid);
+
 /// The main runloop entered by an Extension, start an ExtensionRunner thread.
 Status startExtension(const std::string& name, const std::string& version);
 
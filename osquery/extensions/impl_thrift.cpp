@@ -7,10 +7,14 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+
 #include <osquery/core/core.h>
 #include <osquery/core/system.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/sql/table_row_batch.h>
+#include <osquery/utils/conversions/tryto.h>
 
 #include <thrift/concurrency/ThreadManager.h>
 #include <thrift/protocol/TBinaryProtocol.h>
@@ -32,6 +36,7 @@
 #include "ExtensionManager.h"
 
 #include "osquery/extensions/interface.h"
+#include "osquery/extensions/shared_memory.h"
 
 #include <boost/chrono/include.hpp>
 #include <boost/thread/condition_variable.hpp>
@@ -62,6 +67,137 @@ using TPlatformServerSocket = TServerSocket;
 using TPlatformSocket = TSocket;
 #endif
 
+namespace {
+
+/// The value lists of an ExtensionColumn.
+enum ColumnarType : int32_t {
+  kColumnarText = 0,
+  kColumnarInteger = 1,
+  kColumnarDouble = 2,
+};
+
+/// Get the list a column is sent in, numbers are sent if they all round-trip.
+ColumnarType getColumnarType(const std::string& name,
+                             ColumnType type,
+                             const PluginResponse& response) {
+  if (type != INTEGER_TYPE && type != BIGINT_TYPE &&
+      type != UNSIGNED_BIGINT_TYPE && type != DOUBLE_TYPE) {
+    return kColumnarText;
+  }
+
+  for (const auto& row : response) {
+    auto it = row.find(name);
+    if (it == row.end()) {
+      continue;
+    }
+
+    if (type == DOUBLE_TYPE) {
+      char* end = nullptr;
+      auto number = strtod(it->second.c_str(), &end);
+      if (it->second.empty() || end == nullptr || *end != '\0' ||
+          std::to_string(number) != it->second) {
+        return kColumnarText;
+      }
+    } else {
+      auto number = tryTo<long long>(it->second, 10);
+      if (number.isError() || std::to_string(*number) != it->second) {
+        return kColumnarText;
+      }
+    }
+  }
+  return (type == DOUBLE_TYPE) ? kColumnarDouble : kColumnarInteger;
+}
+
+/// Move the rows of a table into the columns of a columnar response.
+void setColumnarResponse(const TableColumns& columns,
+                         PluginResponse& response,
+                         extensions::ExtensionColumnarResponse& result) {
+  result.rows = static_cast<int64_t>(response.size());
+  result.columns.reserve(columns.size());
+  for (const auto& column : columns) {
+    const auto& name = std::get<0>(column);
+    extensions::ExtensionColumn values;
+    values.name = name;
+    values.type = getColumnarType(name, std::get<1>(column), response);
+
+    for (size_t i = 0; i < response.size(); ++i) {
+      auto it = response[i].find(name);
+      if (it == response[i].end()) {
+        values.missing_rows.push_back(static_cast<int32_t>(i));
+      } else if (values.type == kColumnarInteger) {
+        values.integer_values.push_back(
+            tryTo<long long>(it->second, 10).takeOr(0LL));
+      } else if (values.type == kColumnarDouble) {
+        values.double_values.push_back(strtod(it->second.c_str(), nullptr));
+      } else {
+        values.text_values.push_back(std::move(it->second));
+      }
+    }
+    result.columns.push_back(std::move(values));
+  }
+}
+
+/// Set the columns of a columnar response into a batch.
+Status setColumnarBatch(extensions::ExtensionColumnarResponse& result,
+                        TableRowBatch& batch) {
+  if (result.rows < 0) {
+    return Status::failure("Invalid columnar response row count");
+  }
+
+  auto rows = static_cast<size_t>(result.rows);
+  batch.reserve(batch.size() + rows);
+  auto first = batch.size();
+  for (size_t i = 0; i < rows; ++i) {
+    batch.addRow();
+  }
+
+  for (auto& values : result.columns) {
+    auto index = batch.schema().find(values.name);
+    if (index < 0) {
+      continue;
+    }
+
+    size_t count = 0;
+    if (values.type == kColumnarInteger) {
+      count = values.integer_values.size();
+    } else if (values.type == kColumnarDouble) {
+      count = values.double_values.size();
+    } else {
+      count = values.text_values.size();
+    }
+    if (count + values.missing_rows.size() != rows) {
+      return Status::failure("Invalid columnar response column: " +
+                             values.name);
+    }
+
+    auto column = static_cast<size_t>(index);
+    auto missing = values.missing_rows.begin();
+    size_t value = 0;
+    for (size_t row = 0; row < rows; ++row) {
+      if (missing != values.missing_rows.end() &&
+          static_cast<size_t>(*missing) == row) {
+        ++missing;
+        continue;
+      }
+
+      if (value >= count) {
+        return Status::failure("Invalid columnar response column: " +
+                               values.name);
+      } else if (values.type == kColumnarInteger) {
+        batch.setInteger(first + row, column, values.integer_values[value]);
+      } else if (values.type == kColumnarDouble) {
+        batch.setDouble(first + row, column, values.double_values[value]);
+      } else {
+        batch.set(first + row, column, std::move(values.text_values[value]));
+      }
+      ++value;
+    }
+  }
+  return Status::success();
+}
+
+} // namespace
+
 class ThriftServerEventHandler : public TServerEventHandler,
                                  boost::noncopyable {
  public:
@@ -121,6 +257,22 @@ class ExtensionHandler : virtual public extensions::ExtensionIf,
   using ExtensionInterface::shutdown;
   void shutdown() override;
 
+  void callColumnar(extensions::ExtensionColumnarResponse& _return,
+                    const std::string& registry,
+                    const std::string& item,
+                    const extensions::ExtensionPluginRequest& request) override;
+
+  void openCursor(extensions::ExtensionColumnarResponse& _return,
+                  const std::string& item,
+                  const extensions::ExtensionPluginRequest& request,
+                  const int32_t batch_rows) override;
+
+  void fetchCursor(extensions::ExtensionColumnarResponse& _return,
+                   const int64_t cursor) override;
+
+  void closeCursor(extensions::ExtensionStatus& _return,
+                   const int64_t cursor) override;
+
  protected:
   /// UUID accessor.
   RouteUUID getUUID() const;
@@ -164,6 +316,10 @@ class ExtensionManagerHandler : virtual public extensions::ExtensionManagerIf,
 
  public:
   using ExtensionHandler::call;
+  using ExtensionHandler::callColumnar;
+  using ExtensionHandler::closeCursor;
+  using ExtensionHandler::fetchCursor;
+  using ExtensionHandler::openCursor;
   using ExtensionHandler::ping;
   using ExtensionHandler::shutdown;
 };
@@ -205,7 +361,10 @@ void ExtensionHandler::call(extensions::ExtensionResponse& _return,
   }
 
   PluginResponse response;
-  auto s = ExtensionInterface::call(registry, item, plugin_request, response);
+  auto s = readSharedMemoryRequest(plugin_request);
+  if (s.ok()) {
+    s = ExtensionInterface::call(registry, item, plugin_request, response);
+  }
   _return.status.code = s.getCode();
   _return.status.message = s.getMessage();
   _return.status.uuid = getUUID();
@@ -220,6 +379,86 @@ void ExtensionHandler::call(extensions::ExtensionResponse& _return,
 
 void ExtensionHandler::shutdown() {}
 
+void ExtensionHandler::callColumnar(
+    extensions::ExtensionColumnarResponse& _return,
+    const std::string& registry,
+    const std::string& item,
+    const extensions::ExtensionPluginRequest& request) {
+  _return.status.uuid = getUUID();
+  if (registry != "table") {
+    _return.status.code = (int)extensions::ExtensionCode::EXT_UNSUPPORTED;
+    _return.status.message = "Only tables are returned by column";
+    return;
+  }
+
+  PluginRequest plugin_request(request.begin(), request.end());
+  TableColumns columns;
+  PluginResponse response;
+  auto s =
+      ExtensionInterface::generateTable(item, plugin_request, columns, response);
+  _return.status.code = s.getCode();
+  _return.status.message = s.getMessage();
+
+  if (s.ok()) {
+    setColumnarResponse(columns, response, _return);
+  }
+}
+
+void ExtensionHandler::openCursor(
+    extensions::ExtensionColumnarResponse& _return,
+    const std::string& item,
+    const extensions::ExtensionPluginRequest& request,
+    const int32_t batch_rows) {
+  PluginRequest plugin_request(request.begin(), request.end());
+  TableColumns columns;
+  PluginResponse response;
+  int64_t cursor = 0;
+  bool more = false;
+  auto s = ExtensionInterface::openTableCursor(
+      item,
+      plugin_request,
+      static_cast<size_t>(std::max(batch_rows, 1)),
+      columns,
+      response,
+      cursor,
+      more);
+  _return.status.code = s.getCode();
+  _return.status.message = s.getMessage();
+  _return.status.uuid = getUUID();
+
+  if (s.ok()) {
+    setColumnarResponse(columns, response, _return);
+    _return.cursor = more ? cursor : 0;
+    _return.more = more;
+  }
+}
+
+void ExtensionHandler::fetchCursor(
+    extensions::ExtensionColumnarResponse& _return, const int64_t cursor) {
+  TableColumns columns;
+  PluginResponse response;
+  bool more = false;
+  auto s =
+      ExtensionInterface::fetchTableCursor(cursor, columns, response, more);
+  _return.status.code = s.getCode();
+  _return.status.message = s.getMessage();
+  _return.status.uuid = getUUID();
+
+  if (s.ok()) {
+    setColumnarResponse(columns, response, _return);
+    _return.cursor = more ? cursor : 0;
+    _return.more = more;
+  }
+}
+
+void ExtensionHandler::closeCursor(extensions::ExtensionStatus& _return,
+                                   const int64_t cursor) {
+  auto s = ExtensionInterface::closeTableCursor(cursor);
+  _return.code = s.getCode();
+  _return.message = s.getMessage();
+  _return.uuid = getUUID();
+}
+
 RouteUUID ExtensionHandler::getUUID() const {
   return uuid_;
 }
@@ -257,7 +496,11 @@ void ExtensionManagerHandler::registerExtension(
 
   RouteUUID uuid;
   auto s = ExtensionManagerInterface::registerExtension(
-      {info.name, info.version, info.sdk_version, info.min_sdk_version},
+      {info.name,
+       info.version,
+       info.sdk_version,
+       info.min_sdk_version,
+       info.shared_memory},
       er,
       uuid);
   _return.message = s.getMessage();
@@ -439,6 +682,42 @@ bool ExtensionClientCore::manager() {
   return manager_;
 }
 
+namespace {
+
+/// Check if a transport failure means the connection was closed.
+bool isConnectionClosed(const TTransportException& e) {
+  return e.getType() == TTransportException::NOT_OPEN ||
+         e.getType() == TTransportException::END_OF_FILE;
+}
+
+/**
+ * @brief Send a request, then read its response.
+ *
+ * A connection closed while sending, or before the first byte of the response
+ * arrived, throws ExtensionConnectionClosed. Failures after that, including
+ * timeouts, are thrown as is since the extension may have run the request.
+ */
+template <typename Send, typename Receive>
+void sendRequest(ImplExtensionClient& client, Send send, Receive receive) {
+  bool answered = false;
+  try {
+    send();
+    answered = client.transport->peek();
+  } catch (const TTransportException& e) {
+    if (!isConnectionClosed(e)) {
+      throw;
+    }
+    throw ExtensionConnectionClosed(e.what());
+  }
+
+  if (!answered) {
+    throw ExtensionConnectionClosed("The extension closed the connection");
+  }
+  receive();
+}
+
+} // namespace
+
 ExtensionClient::ExtensionClient(const std::string& path, size_t timeout) {
   init(path, false);
   setTimeouts(timeout == 0 ? FLAGS_thrift_timeout : timeout);
@@ -466,7 +745,10 @@ Status ExtensionClient::call(const std::string& registry,
                              PluginResponse& response) {
   extensions::ExtensionResponse er;
   auto client = manager() ? client_->em : client_->e;
-  client->call(er, registry, item, request);
+  sendRequest(
+      *client_,
+      [&]() { client->send_call(registry, item, request); },
+      [&]() { client->recv_call(er); });
   for (const auto& r : er.response) {
     response.push_back(r);
   }
@@ -474,6 +756,77 @@ Status ExtensionClient::call(const std::string& registry,
   return Status(er.status.code, er.status.message);
 }
 
+Status ExtensionClient::callColumnar(const std::string& registry,
+                                     const std::string& item,
+                                     const PluginRequest& request,
+                                     TableRowBatch& batch) {
+  extensions::ExtensionColumnarResponse er;
+  auto client = manager() ? client_->em : client_->e;
+  try {
+    sendRequest(
+        *client_,
+        [&]() { client->send_callColumnar(registry, item, request); },
+        [&]() { client->recv_callColumnar(er); });
+  } catch (const TApplicationException& e) {
+    if (e.getType() != TApplicationException::UNKNOWN_METHOD) {
+      throw;
+    }
+    // The extension was built before the columnar call was added.
+    return Status((int)extensions::ExtensionCode::EXT_UNSUPPORTED, e.what());
+  }
+
+  if (er.status.code != (int)extensions::ExtensionCode::EXT_SUCCESS) {
+    return Status(er.status.code, er.status.message);
+  }
+  return setColumnarBatch(er, batch);
+}
+
+Status ExtensionClient::openCursor(const std::string& item,
+                                   const PluginRequest& request,
+                                   size_t batch_rows,
+                                   TableRowBatch& batch,
+                                   int64_t& cursor,
+                                   bool& more) {
+  extensions::ExtensionColumnarResponse er;
+  auto client = manager() ? client_->em : client_->e;
+  try {
+    client->openCursor(er, item, request, static_cast<int32_t>(batch_rows));
+  } catch (const TApplicationException& e) {
+    if (e.getType() != TApplicationException::UNKNOWN_METHOD) {
+      throw;
+    }
+    // The extension was built before table cursors were added.
+    return Status((int)extensions::ExtensionCode::EXT_UNSUPPORTED, e.what());
+  }
+
+  if (er.status.code != (int)extensions::ExtensionCode::EXT_SUCCESS) {
+    return Status(er.status.code, er.status.message);
+  }
+  cursor = er.cursor;
+  more = er.more;
+  return setColumnarBatch(er, batch);
+}
+
+Status ExtensionClient::fetchCursor(int64_t cursor,
+                                    TableRowBatch& batch,
+                                    bool& more) {
+  extensions::ExtensionColumnarResponse er;
+  auto client = manager() ? client_->em : client_->e;
+  client->fetchCursor(er, cursor);
+  if (er.status.code != (int)extensions::ExtensionCode::EXT_SUCCESS) {
+    return Status(er.status.code, er.status.message);
+  }
+  more = er.more;
+  return setColumnarBatch(er, batch);
+}
+
+Status ExtensionClient::closeCursor(int64_t cursor) {
+  extensions::ExtensionStatus status;
+  auto client = manager() ? client_->em : client_->e;
+  client->closeCursor(status, cursor);
+  return Status(status.code, status.message);
+}
+
 void ExtensionClient::shutdown() {
   auto client = manager() ? client_->em : client_->e;
   client->shutdown();
@@ -513,6 +866,7 @@ Status ExtensionManagerClient::registerExtension(
   iei.version = info.version;
   iei.sdk_version = info.sdk_version;
   iei.min_sdk_version = info.min_sdk_version;
+  iei.shared_memory = info.shared_memory;
   extensions::ExtensionStatus status;
   client_->em->registerExtension(status, iei, registry);
   uuid = status.uuid;
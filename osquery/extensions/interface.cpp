@@ -7,12 +7,19 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <chrono>
 #include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
+#include <boost/noncopyable.hpp>
+
 #include <osquery/core/core.h>
+#include <osquery/core/flags.h>
 #include <osquery/core/shutdown.h>
 #include <osquery/core/system.h>
 #include <osquery/filesystem/filesystem.h>
@@ -21,6 +28,7 @@
 #include <osquery/sql/sql.h>
 
 #include "osquery/extensions/interface.h"
+#include "osquery/extensions/shared_memory.h"
 
 #include <osquery/utils/conversions/split.h>
 #include <osquery/utils/info/platform_type.h>
@@ -60,6 +68,78 @@ class UuidGenerator {
 
 UuidGenerator kUuidGenerator;
 
+CLI_FLAG(uint32,
+         extensions_table_cursors,
+         32,
+         "Table cursors an extension keeps open, the oldest is stopped for "
+         "more (minimum 1)");
+
+/// The rows of a table plugin generated for a table cursor.
+class ExtensionTableCursor : private boost::noncopyable {
+ public:
+  ExtensionTableCursor(std::shared_ptr<TablePlugin> table,
+                       const PluginRequest& request,
+                       size_t batch_rows)
+      : table_(std::move(table)),
+        columns_(table_->columns()),
+        context_(table_->getContextFromRequest(request)),
+        batch_rows_(std::max<size_t>(batch_rows, 1)) {}
+
+  const TableColumns& columns() const {
+    return columns_;
+  }
+
+  /// Move the next batch of rows into a response, false after the last.
+  bool next(PluginResponse& response) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (table_->usesGenerator()) {
+      if (generator_ == nullptr) {
+        generator_ = std::make_unique<RowGenerator::pull_type>(
+            std::bind(&TablePlugin::generator,
+                      table_,
+                      std::placeholders::_1,
+                      std::ref(context_)));
+      }
+
+      // The generator runs one row ahead, it is held for the next batch.
+      for (; *generator_ && response.size() < batch_rows_; (*generator_)()) {
+        auto row = generator_->get();
+        if (row != nullptr) {
+          response.push_back(static_cast<Row>(*row));
+        }
+      }
+      return static_cast<bool>(*generator_);
+    }
+
+    if (!generated_) {
+      rows_ = table_->generate(context_);
+      generated_ = true;
+    }
+    for (; position_ < rows_.size() && response.size() < batch_rows_;
+         ++position_) {
+      response.push_back(static_cast<Row>(*rows_[position_]));
+      rows_[position_].reset();
+    }
+    return position_ < rows_.size();
+  }
+
+ private:
+  std::shared_ptr<TablePlugin> table_;
+  TableColumns columns_;
+  QueryContext context_;
+  size_t batch_rows_;
+
+  /// The generator of tables that yield their rows.
+  std::unique_ptr<RowGenerator::pull_type> generator_;
+
+  /// The rows of other tables, generated for the first batch.
+  TableRows rows_;
+  size_t position_{0};
+  bool generated_{false};
+
+  std::mutex mutex_;
+};
+
 Status ExtensionInterface::ping() {
   // Need to translate return code into 0 and extract the UUID.
   assert(uuid_ < INT_MAX);
@@ -82,6 +162,98 @@ Status ExtensionInterface::call(const std::string& registry,
   return RegistryFactory::call(registry, local_item, request, response);
 }
 
+Status ExtensionInterface::generateTable(const std::string& item,
+                                         const PluginRequest& request,
+                                         TableColumns& columns,
+                                         PluginResponse& response) {
+  auto local_item = RegistryFactory::get().getAlias("table", item);
+  if (!RegistryFactory::get().exists("table", local_item, true)) {
+    return Status(static_cast<int>(ExtensionCode::EXT_UNSUPPORTED),
+                  "Not a table of this process: " + item);
+  }
+
+  auto table = std::dynamic_pointer_cast<TablePlugin>(
+      RegistryFactory::get().plugin("table", local_item));
+  if (table == nullptr) {
+    return Status(static_cast<int>(ExtensionCode::EXT_UNSUPPORTED),
+                  "Not a table plugin: " + item);
+  }
+
+  columns = table->columns();
+  return RegistryFactory::call("table", local_item, request, response);
+}
+
+Status ExtensionInterface::openTableCursor(const std::string& item,
+                                           const PluginRequest& request,
+                                           size_t batch_rows,
+                                           TableColumns& columns,
+                                           PluginResponse& response,
+                                           int64_t& cursor,
+                                           bool& more) {
+  auto local_item = RegistryFactory::get().getAlias("table", item);
+  if (!RegistryFactory::get().exists("table", local_item, true)) {
+    return Status(static_cast<int>(ExtensionCode::EXT_UNSUPPORTED),
+                  "Not a table of this process: " + item);
+  }
+
+  auto table = std::dynamic_pointer_cast<TablePlugin>(
+      RegistryFactory::get().plugin("table", local_item));
+  if (table == nullptr) {
+    return Status(static_cast<int>(ExtensionCode::EXT_UNSUPPORTED),
+                  "Not a table plugin: " + item);
+  }
+
+  {
+    WriteLock lock(cursors_mutex_);
+    auto max_cursors = std::max<size_t>(FLAGS_extensions_table_cursors, 1);
+    while (cursors_.size() >= max_cursors) {
+      // The caller of the oldest cursor went away without closing it.
+      VLOG(1) << "Stopping table cursor " << cursors_.begin()->first;
+      cursors_.erase(cursors_.begin());
+    }
+    cursor = next_cursor_++;
+    cursors_[cursor] =
+        std::make_shared<ExtensionTableCursor>(table, request, batch_rows);
+  }
+  return fetchTableCursor(cursor, columns, response, more);
+}
+
+Status ExtensionInterface::fetchTableCursor(int64_t cursor,
+                                            TableColumns& columns,
+                                            PluginResponse& response,
+                                            bool& more) {
+  std::shared_ptr<ExtensionTableCursor> table_cursor;
+  {
+    ReadLock lock(cursors_mutex_);
+    auto it = cursors_.find(cursor);
+    if (it == cursors_.end()) {
+      return Status::failure("Unknown table cursor: " + std::to_string(cursor));
+    }
+    table_cursor = it->second;
+  }
+
+  columns = table_cursor->columns();
+  try {
+    more = table_cursor->next(response);
+  } catch (const std::exception& e) {
+    closeTableCursor(cursor);
+    return Status::failure(e.what());
+  }
+
+  if (!more) {
+    closeTableCursor(cursor);
+  }
+  return Status::success();
+}
+
+Status ExtensionInterface::closeTableCursor(int64_t cursor) {
+  WriteLock lock(cursors_mutex_);
+  if (cursors_.erase(cursor) == 0) {
+    return Status::failure("Unknown table cursor: " + std::to_string(cursor));
+  }
+  return Status::success();
+}
+
 void ExtensionInterface::shutdown() {
   // Request a graceful shutdown of the Thrift listener.
   VLOG(1) << "Extension " << uuid_ << " requested shutdown";
@@ -147,6 +319,15 @@ Status ExtensionManagerInterface::registerExtension(
                   "Failed adding registry: " + status.getMessage());
   }
 
+  if (!info.shared_memory.empty()) {
+    // Without the segment every request is sent through the socket.
+    status = openExtensionSharedMemory(uuid, info.shared_memory);
+    if (!status.ok()) {
+      LOG(WARNING) << "Extension " << info.name
+                   << " shared memory is not used: " << status.getMessage();
+    }
+  }
+
   WriteLock lock(extensions_mutex_);
   extensions_[uuid] = info;
   return Status::success();
@@ -10,11 +10,16 @@
 #pragma once
 
 #include <osquery/core/query.h>
+#include <osquery/core/tables.h>
 #include <osquery/dispatcher/dispatcher.h>
 #include <osquery/extensions/extensions.h>
+#include <osquery/utils/mutex.h>
 
 namespace osquery {
 
+class ExtensionTableCursor;
+class TableRowBatch;
+
 /**
  * An option is a 'basic' flag, the only important information is value.
  */
@@ -32,6 +37,7 @@ enum class ExtensionCode {
   EXT_SUCCESS = 0,
   EXT_FAILED = 1,
   EXT_FATAL = 2,
+  EXT_UNSUPPORTED = 3,
 };
 
 using OptionList = std::map<std::string, Option>;
@@ -98,9 +104,55 @@ class ExtensionInterface : public ExtensionAPI {
                       PluginResponse& response) override;
   virtual void shutdown() override;
 
+  /**
+   * @brief Generate a table plugin of this process for a columnar response.
+   *
+   * The columns of the plugin are returned with the rows, so they can be
+   * sent by column. Tables that are not plugins of this process are
+   * EXT_UNSUPPORTED, the caller uses call instead.
+   */
+  Status generateTable(const std::string& item,
+                       const PluginRequest& request,
+                       TableColumns& columns,
+                       PluginResponse& response);
+
+  /**
+   * @brief Start generating a table plugin of this process in batches.
+   *
+   * The first batch of at most batch_rows rows is returned. While more is
+   * true the next batches are read with fetchTableCursor. Generator tables
+   * only produce the rows of a batch when it is fetched.
+   */
+  Status openTableCursor(const std::string& item,
+                         const PluginRequest& request,
+                         size_t batch_rows,
+                         TableColumns& columns,
+                         PluginResponse& response,
+                         int64_t& cursor,
+                         bool& more);
+
+  /// Return the next batch of rows of a cursor, it closes after the last.
+  Status fetchTableCursor(int64_t cursor,
+                          TableColumns& columns,
+                          PluginResponse& response,
+                          bool& more);
+
+  /// Stop a cursor, its remaining rows are not generated.
+  Status closeTableCursor(int64_t cursor);
+
  protected:
   /// Transient UUID assigned to the extension after registering.
   std::atomic<RouteUUID> uuid_;
+
+ private:
+  /// Open table cursors, the IDs increase.
+  std::map<int64_t, std::shared_ptr<ExtensionTableCursor>> cursors_;
+
+  /// The ID of the next table cursor.
+  int64_t next_cursor_{1};
+
+  /// Protects the table cursors.
+  Mutex cursors_mutex_;
 };
 
 /**
@@ -308,6 +360,18 @@ class ExtensionManagerRunner : public ExtensionRunnerCore {
   void start() override;
 };
 
+/**
+ * @brief A connection found closed before the extension answered a request.
+ *
+ * The connection failed while sending the request, or was closed before any
+ * of the response was read. The request was not processed and may be sent
+ * again on a new connection.
+ */
+class ExtensionConnectionClosed : public std::runtime_error {
+ public:
+  using std::runtime_error::runtime_error;
+};
+
 /// Internal accessor for extension clients.
 class ExtensionClientCore : private boost::noncopyable {
  public:
@@ -366,6 +430,38 @@ class ExtensionClient : public ExtensionClientCore, public ExtensionAPI {
               const PluginRequest& request,
               PluginResponse& response) override;
 
+  /**
+   * @brief Generate an extension's table into a columnar batch.
+   *
+   * The rows are received by column and set into the batch without a
+   * PluginResponse. Extensions built before the columnar call was added
+   * return EXT_UNSUPPORTED.
+   */
+  Status callColumnar(const std::string& registry,
+                      const std::string& item,
+                      const PluginRequest& request,
+                      TableRowBatch& batch);
+
+  /**
+   * @brief Start reading an extension's table in batches.
+   *
+   * The first batch is set into the batch. While more is true the cursor
+   * returns further batches with fetchCursor, or is stopped with closeCursor.
+   * Extensions built before cursors were added return EXT_UNSUPPORTED.
+   */
+  Status openCursor(const std::string& item,
+                    const PluginRequest& request,
+                    size_t batch_rows,
+                    TableRowBatch& batch,
+                    int64_t& cursor,
+                    bool& more);
+
+  /// Set the next batch of a table cursor into the batch.
+  Status fetchCursor(int64_t cursor, TableRowBatch& batch, bool& more);
+
+  /// Stop a table cursor before its last batch.
+  Status closeCursor(int64_t cursor);
+
   /// Request that the extension stop.
   void shutdown() override;
 };
@@ -0,0 +1,314 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <atomic>
+#include <cstring>
+#include <map>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <osquery/extensions/shared_memory.h>
+#include <osquery/utils/conversions/tryto.h>
+
+namespace osquery {
+
+const size_t kSharedMemoryMinPayload{4096};
+
+const std::string kSharedMemoryKey{"shared_memory_key"};
+const std::string kSharedMemoryOffset{"shared_memory_offset"};
+const std::string kSharedMemoryLength{"shared_memory_length"};
+
+namespace {
+
+/// The segment of this extension, the core only writes to it.
+std::unique_ptr<SharedMemoryRing> kExtensionRing;
+Mutex kExtensionRingMutex;
+
+/// The segments of the registered extensions.
+std::map<RouteUUID, std::shared_ptr<SharedMemoryRing>> kExtensionRings;
+Mutex kExtensionRingsMutex;
+
+} // namespace
+
+SharedMemoryRing::SharedMemoryRing(const std::string& name,
+                                   char* data,
+                                   size_t size)
+    : name_(name), data_(data), size_(size) {}
+
+Status SharedMemoryRing::create(const std::string& name,
+                                size_t size,
+                                std::unique_ptr<SharedMemoryRing>& ring) {
+  if (name.size() < 2 || name.front() != '/' || size == 0) {
+    return Status::failure("Invalid shared memory name or size");
+  }
+
+#ifdef WIN32
+  return Status::failure("Shared memory is not supported on this platform");
+#else
+  // A segment left with this name by an exited process is replaced.
+  ::shm_unlink(name.c_str());
+  auto fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd == -1) {
+    return Status::failure("Cannot create the shared memory object " + name);
+  }
+
+  void* data = MAP_FAILED;
+  if (::ftruncate(fd, static_cast<off_t>(size)) == 0) {
+    data = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  ::close(fd);
+
+  if (data == MAP_FAILED) {
+    ::shm_unlink(name.c_str());
+    return Status::failure("Cannot map the shared memory object " + name);
+  }
+
+  ring.reset(new SharedMemoryRing(name, static_cast<char*>(data), size));
+  return Status::success();
+#endif
+}
+
+Status SharedMemoryRing::open(const std::string& name,
+                              std::unique_ptr<SharedMemoryRing>& ring) {
+  if (name.size() < 2 || name.front() != '/') {
+    return Status::failure("Invalid shared memory name");
+  }
+
+#ifdef WIN32
+  return Status::failure("Shared memory is not supported on this platform");
+#else
+  auto fd = ::shm_open(name.c_str(), O_RDWR, 0);
+  if (fd == -1) {
+    return Status::failure("Cannot open the shared memory object " + name);
+  }
+
+  // The extension owns the segment, it must not be shared with other users.
+  struct stat info;
+  if (::fstat(fd, &info) != 0 || info.st_uid != ::geteuid() ||
+      info.st_size <= 0) {
+    ::close(fd);
+    return Status::failure("The shared memory object cannot be used: " + name);
+  }
+
+  auto size = static_cast<size_t>(info.st_size);
+  auto data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+
+  if (data == MAP_FAILED) {
+    return Status::failure("Cannot map the shared memory object " + name);
+  }
+
+  ring.reset(new SharedMemoryRing(name, static_cast<char*>(data), size));
+  return Status::success();
+#endif
+}
+
+SharedMemoryRing::~SharedMemoryRing() {
+#ifndef WIN32
+  if (data_ != nullptr) {
+    ::munmap(data_, size_);
+  }
+#endif
+}
+
+void SharedMemoryRing::unlink() {
+#ifndef WIN32
+  ::shm_unlink(name_.c_str());
+#endif
+}
+
+bool SharedMemoryRing::write(const std::string& payload, size_t& offset) {
+  auto length = payload.size();
+  if (length == 0 || length > size_) {
+    return false;
+  }
+
+  WriteLock lock(mutex_);
+  if (records_.empty()) {
+    head_ = 0;
+    offset = 0;
+  } else {
+    auto tail = records_.front().offset;
+    auto wrapped = records_.back().offset < tail;
+    if (!wrapped && head_ + length <= size_) {
+      offset = head_;
+    } else if (!wrapped && length <= tail) {
+      // Payloads are never split across the end of the segment.
+      offset = 0;
+    } else if (wrapped && head_ + length <= tail) {
+      offset = head_;
+    } else {
+      return false;
+    }
+  }
+
+  std::memcpy(data_ + offset, payload.data(), length);
+  // The payload is complete before the call naming it is sent.
+  std::atomic_thread_fence(std::memory_order_release);
+
+  head_ = offset + length;
+  records_.push_back({offset, length, false});
+  return true;
+}
+
+void SharedMemoryRing::release(size_t offset) {
+  WriteLock lock(mutex_);
+  for (auto& record : records_) {
+    if (record.offset == offset && !record.released) {
+      record.released = true;
+      break;
+    }
+  }
+
+  while (!records_.empty() && records_.front().released) {
+    records_.pop_front();
+  }
+}
+
+bool SharedMemoryRing::read(size_t offset,
+                            size_t length,
+                            std::string& payload) const {
+  if (offset > size_ || length > size_ - offset) {
+    return false;
+  }
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  payload.assign(data_ + offset, length);
+  return true;
+}
+
+Status createExtensionSharedMemory(size_t size, std::string& name) {
+#ifdef WIN32
+  name = "/osquery.extension";
+#else
+  name = "/osquery.extension." + std::to_string(::getpid());
+#endif
+
+  std::unique_ptr<SharedMemoryRing> ring;
+  auto status = SharedMemoryRing::create(name, size, ring);
+  if (!status.ok()) {
+    return status;
+  }
+
+  WriteLock lock(kExtensionRingMutex);
+  kExtensionRing = std::move(ring);
+  return Status::success();
+}
+
+void unlinkExtensionSharedMemory() {
+  WriteLock lock(kExtensionRingMutex);
+  if (kExtensionRing != nullptr) {
+    kExtensionRing->unlink();
+  }
+}
+
+Status readSharedMemoryRequest(PluginRequest& request) {
+  auto key = request.find(kSharedMemoryKey);
+  if (key == request.end()) {
+    return Status::success();
+  }
+
+  auto offset = tryTo<unsigned long long>(request[kSharedMemoryOffset], 10);
+  auto length = tryTo<unsigned long long>(request[kSharedMemoryLength], 10);
+  if (offset.isError() || length.isError()) {
+    return Status::failure("Invalid shared memory request");
+  }
+
+  std::string payload;
+  {
+    ReadLock lock(kExtensionRingMutex);
+    if (kExtensionRing == nullptr ||
+        !kExtensionRing->read(static_cast<size_t>(*offset),
+                              static_cast<size_t>(*length),
+                              payload)) {
+      return Status::failure("Invalid shared memory request");
+    }
+  }
+
+  auto name = key->second;
+  request.erase(kSharedMemoryKey);
+  request.erase(kSharedMemoryOffset);
+  request.erase(kSharedMemoryLength);
+  request[name] = std::move(payload);
+  return Status::success();
+}
+
+Status openExtensionSharedMemory(RouteUUID uuid, const std::string& name) {
+  std::unique_ptr<SharedMemoryRing> ring;
+  auto status = SharedMemoryRing::open(name, ring);
+  if (!status.ok()) {
+    return status;
+  }
+
+  WriteLock lock(kExtensionRingsMutex);
+  kExtensionRings[uuid] = std::move(ring);
+  return Status::success();
+}
+
+void closeExtensionSharedMemory(RouteUUID uuid) {
+  // Calls in flight keep their segment mapped until they return.
+  WriteLock lock(kExtensionRingsMutex);
+  kExtensionRings.erase(uuid);
+}
+
+SharedMemoryRequest::SharedMemoryRequest(RouteUUID uuid,
+                                         const PluginRequest& request)
+    : request_(request) {
+  auto largest = request.end();
+  for (auto it = request.begin(); it != request.end(); ++it) {
+    if (it->second.size() >= kSharedMemoryMinPayload &&
+        (largest == request.end() ||
+         it->second.size() > largest->second.size())) {
+      largest = it;
+    }
+  }
+
+  if (largest == request.end() || request.count(kSharedMemoryKey) > 0) {
+    return;
+  }
+
+  std::shared_ptr<SharedMemoryRing> ring;
+  {
+    ReadLock lock(kExtensionRingsMutex);
+    auto it = kExtensionRings.find(uuid);
+    if (it == kExtensionRings.end()) {
+      return;
+    }
+    ring = it->second;
+  }
+
+  // A full ring sends the value in the request.
+  if (!ring->write(largest->second, offset_)) {
+    return;
+  }
+
+  for (auto it = request.begin(); it != request.end(); ++it) {
+    if (it != largest) {
+      shared_request_.insert(*it);
+    }
+  }
+  shared_request_[kSharedMemoryKey] = largest->first;
+  shared_request_[kSharedMemoryOffset] = std::to_string(offset_);
+  shared_request_[kSharedMemoryLength] =
+      std::to_string(largest->second.size());
+  ring_ = std::move(ring);
+}
+
+SharedMemoryRequest::~SharedMemoryRequest() {
+  if (ring_ != nullptr) {
+    ring_->release(offset_);
+  }
+}
+
+} // namespace osquery
@@ -0,0 +1,171 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core/plugins/plugin.h>
+#include <osquery/registry/registry_interface.h>
+#include <osquery/utils/mutex.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// Request values of at least this size are sent through shared memory.
+extern const size_t kSharedMemoryMinPayload;
+
+/// The request keys naming the value that was moved to shared memory.
+extern const std::string kSharedMemoryKey;
+extern const std::string kSharedMemoryOffset;
+extern const std::string kSharedMemoryLength;
+
+/**
+ * @brief A shared memory segment carrying large request values.
+ *
+ * An extension creates the segment and names it when it registers, the core
+ * maps it and copies large request values into it instead of the Thrift
+ * request. The request only carries the offset and length of the value, the
+ * Thrift socket still carries every call and its response.
+ *
+ * All bookkeeping stays in the core: the segment is a ring of payloads, each
+ * one is written at the head and released when its call returns. Calls may
+ * return out of order, the space is reclaimed once the oldest payload is
+ * released.
+ */
+class SharedMemoryRing : private boost::noncopyable {
+ public:
+  /**
+   * @brief Create and map a new segment, as the extension reading from it.
+   *
+   * @param name The shared memory object name, starting with '/'.
+   * @param size The size of the segment.
+   * @param ring The output parameter, the mapped segment.
+   */
+  static Status create(const std::string& name,
+                       size_t size,
+                       std::unique_ptr<SharedMemoryRing>& ring);
+
+  /// Map the segment of an extension, as the core writing to it.
+  static Status open(const std::string& name,
+                     std::unique_ptr<SharedMemoryRing>& ring);
+
+  /// Unmap the segment.
+  ~SharedMemoryRing();
+
+  /// Remove the name of the segment, the mappings stay valid.
+  void unlink();
+
+  /**
+   * @brief Copy a payload to the head of the ring.
+   *
+   * @return false if the ring has no space for the payload.
+   */
+  bool write(const std::string& payload, size_t& offset);
+
+  /// Release the payload written at an offset.
+  void release(size_t offset);
+
+  /**
+   * @brief Copy a payload written by the core.
+   *
+   * @return false if the offset and length are outside of the segment.
+   */
+  bool read(size_t offset, size_t length, std::string& payload) const;
+
+  /// The name of the segment.
+  const std::string& name() const {
+    return name_;
+  }
+
+  /// The size of the segment.
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  SharedMemoryRing(const std::string& name, char* data, size_t size);
+
+ private:
+  /// A written payload, in the order of the writes.
+  struct Record {
+    size_t offset;
+    size_t length;
+    bool released;
+  };
+
+  std::string name_;
+  char* data_{nullptr};
+  size_t size_{0};
+
+  /// The offset of the next payload, used when records_ is not empty.
+  size_t head_{0};
+  std::deque<Record> records_;
+
+  Mutex mutex_;
+};
+
+/**
+ * @brief Create the shared memory segment of this extension.
+ *
+ * The segment is kept until the extension exits.
+ *
+ * @param size The size of the segment.
+ * @param name The output parameter, the name to register with the core.
+ */
+Status createExtensionSharedMemory(size_t size, std::string& name);
+
+/// Remove the name of the segment of this extension once it is registered.
+void unlinkExtensionSharedMemory();
+
+/**
+ * @brief Replace a request value moved to shared memory by the core.
+ *
+ * Requests without a shared memory value are left as they are.
+ */
+Status readSharedMemoryRequest(PluginRequest& request);
+
+/// Map the segment named by an extension when it registers.
+Status openExtensionSharedMemory(RouteUUID uuid, const std::string& name);
+
+/// Unmap the segment of an extension when it is removed.
+void closeExtensionSharedMemory(RouteUUID uuid);
+
+/**
+ * @brief A request to an extension with its largest value in shared memory.
+ *
+ * If the extension has a segment with space for the largest value of at
+ * least kSharedMemoryMinPayload bytes, it is copied there and the request
+ * names it instead. Otherwise the request is sent as it is. The value is
+ * released when the call returns and this goes out of scope.
+ */
+class SharedMemoryRequest : private boost::noncopyable {
+ public:
+  SharedMemoryRequest(RouteUUID uuid, const PluginRequest& request);
+  ~SharedMemoryRequest();
+
+  /// The request to send.
+  const PluginRequest& request() const {
+    return (ring_ != nullptr) ? shared_request_ : request_;
+  }
+
+ private:
+  const PluginRequest& request_;
+  PluginRequest shared_request_;
+
+  std::shared_ptr<SharedMemoryRing> ring_;
+  size_t offset_{0};
+};
+
+} // namespace osquery
@@ -24,8 +24,11 @@
 
 #include <osquery/database/database.h>
 #include <osquery/extensions/interface.h>
+#include <osquery/extensions/shared_memory.h>
 #include <osquery/filesystem/fileops.h>
 #include <osquery/process/process.h>
+#include <osquery/sql/dynamic_table_row.h>
+#include <osquery/sql/table_row_batch.h>
 
 #include <boost/filesystem.hpp>
 
@@ -34,6 +37,8 @@ namespace fs = boost::filesystem;
 namespace osquery {
 
 DECLARE_string(extensions_require);
+DECLARE_uint32(extensions_shared_memory_size);
+DECLARE_uint32(extensions_table_cursors);
 
 const int kDelay = 20;
 const int kTimeout = 3000;
@@ -213,6 +218,189 @@ class TestExtensionPlugin : public ExtensionPlugin {};
 
 CREATE_REGISTRY(ExtensionPlugin, "extension_test");
 
+namespace {
+
+const TableColumns kColumnarTestColumns = {
+    std::make_tuple("name", TEXT_TYPE, ColumnOptions::DEFAULT),
+    std::make_tuple("count", INTEGER_TYPE, ColumnOptions::DEFAULT),
+    std::make_tuple("ratio", DOUBLE_TYPE, ColumnOptions::DEFAULT),
+};
+
+class ColumnarTestTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return kColumnarTestColumns;
+  }
+
+  TableRows generate(QueryContext& context) override {
+    TableRows results;
+    auto first = make_table_row();
+    first["name"] = "a";
+    first["count"] = "1";
+    first["ratio"] = "0.500000";
+    results.push_back(std::move(first));
+
+    auto second = make_table_row();
+    second["name"] = "b";
+    second["count"] = "x1";
+    results.push_back(std::move(second));
+    return results;
+  }
+};
+
+class CursorTestTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return kColumnarTestColumns;
+  }
+
+  bool usesGenerator() const override {
+    return true;
+  }
+
+  void generator(RowYield& yield, QueryContext& context) override {
+    for (size_t i = 0; i < 5; ++i) {
+      auto row = make_table_row();
+      row["name"] = std::to_string(i);
+      yield(std::move(row));
+    }
+  }
+};
+
+} // namespace
+
+TEST_F(ExtensionsTest, test_extension_table_cursor) {
+  auto& rf = RegistryFactory::get();
+  rf.registry("table")->add("columnar_test",
+                            std::make_shared<ColumnarTestTablePlugin>());
+  rf.registry("table")->add("cursor_test",
+                            std::make_shared<CursorTestTablePlugin>());
+
+  auto status = startExtensionManager(socket_path);
+  ASSERT_TRUE(status.ok());
+  ASSERT_TRUE(socketExistsLocal(socket_path));
+
+  PluginRequest request = {{"action", "generate"}};
+  ExtensionManagerClient client(socket_path);
+
+  // Generated tables are returned in batches until the last row.
+  TableRowBatch batch(kColumnarTestColumns);
+  int64_t cursor = 0;
+  bool more = false;
+  status = client.openCursor("columnar_test", request, 1, batch, cursor, more);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(batch.size(), 1U);
+  EXPECT_EQ(batch.get(0, 0), "a");
+  ASSERT_TRUE(more);
+
+  status = client.fetchCursor(cursor, batch, more);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(batch.size(), 2U);
+  EXPECT_EQ(batch.get(1, 0), "b");
+  EXPECT_FALSE(more);
+
+  // The cursor closed after the last batch.
+  EXPECT_FALSE(client.closeCursor(cursor).ok());
+
+  // A closed generator stops before its remaining rows.
+  TableRowBatch rows(kColumnarTestColumns);
+  status = client.openCursor("cursor_test", request, 2, rows, cursor, more);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(rows.size(), 2U);
+  ASSERT_TRUE(more);
+
+  status = client.fetchCursor(cursor, rows, more);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(rows.size(), 4U);
+  EXPECT_EQ(rows.get(3, 0), "3");
+  ASSERT_TRUE(more);
+
+  EXPECT_TRUE(client.closeCursor(cursor).ok());
+  EXPECT_FALSE(client.fetchCursor(cursor, rows, more).ok());
+  EXPECT_EQ(rows.size(), 4U);
+
+  // Only tables of the extension have cursors.
+  status = client.openCursor("not_a_table", request, 2, rows, cursor, more);
+  EXPECT_EQ(status.getCode(), (int)ExtensionCode::EXT_UNSUPPORTED);
+
+  rf.registry("table")->remove("columnar_test");
+  rf.registry("table")->remove("cursor_test");
+}
+
+TEST_F(ExtensionsTest, test_extension_table_cursors_limit) {
+  auto& rf = RegistryFactory::get();
+  rf.registry("table")->add("cursor_test",
+                            std::make_shared<CursorTestTablePlugin>());
+
+  auto table_cursors = FLAGS_extensions_table_cursors;
+  FLAGS_extensions_table_cursors = 2;
+
+  auto status = startExtensionManager(socket_path);
+  ASSERT_TRUE(status.ok());
+  ASSERT_TRUE(socketExistsLocal(socket_path));
+
+  PluginRequest request = {{"action", "generate"}};
+  ExtensionManagerClient client(socket_path);
+
+  // Opening a third cursor stops the oldest.
+  std::vector<int64_t> cursors;
+  for (size_t i = 0; i < 3; ++i) {
+    TableRowBatch rows(kColumnarTestColumns);
+    int64_t cursor = 0;
+    bool more = false;
+    status = client.openCursor("cursor_test", request, 1, rows, cursor, more);
+    ASSERT_TRUE(status.ok()) << status.getMessage();
+    cursors.push_back(cursor);
+  }
+
+  EXPECT_FALSE(client.closeCursor(cursors[0]).ok());
+  EXPECT_TRUE(client.closeCursor(cursors[1]).ok());
+  EXPECT_TRUE(client.closeCursor(cursors[2]).ok());
+
+  FLAGS_extensions_table_cursors = table_cursors;
+  rf.registry("table")->remove("cursor_test");
+}
+
+TEST_F(ExtensionsTest, test_extension_call_columnar) {
+  auto& rf = RegistryFactory::get();
+  rf.registry("table")->add("columnar_test",
+                            std::make_shared<ColumnarTestTablePlugin>());
+
+  auto status = startExtensionManager(socket_path);
+  ASSERT_TRUE(status.ok());
+  ASSERT_TRUE(socketExistsLocal(socket_path));
+
+  TableRowBatch batch(kColumnarTestColumns);
+  {
+    ExtensionManagerClient client(socket_path);
+    status = client.callColumnar(
+        "table", "columnar_test", {{"action", "generate"}}, batch);
+  }
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(batch.size(), 2U);
+  EXPECT_EQ(batch.get(0, 0), "a");
+  EXPECT_EQ(batch.get(1, 0), "b");
+
+  // A value that is not a number sends the column as text.
+  EXPECT_EQ(batch.get(0, 1), "1");
+  EXPECT_EQ(batch.get(1, 1), "x1");
+
+  // Missing values stay unset.
+  EXPECT_EQ(batch.get(0, 2), "0.500000");
+  EXPECT_FALSE(batch.isSet(1, 2));
+
+  // Only tables are returned by column.
+  TableRowBatch other(kColumnarTestColumns);
+  {
+    ExtensionManagerClient client(socket_path);
+    status = client.callColumnar("extension_test", "test_item", {}, other);
+  }
+  EXPECT_EQ(status.getCode(), (int)ExtensionCode::EXT_UNSUPPORTED);
+  EXPECT_EQ(other.size(), 0U);
+
+  rf.registry("table")->remove("columnar_test");
+}
+
 TEST_F(ExtensionsTest, test_extension_broadcast) {
   auto status = startExtensionManager(socket_path);
   EXPECT_TRUE(status.ok());
@@ -287,4 +475,76 @@ TEST_F(ExtensionsTest, test_extension_broadcast) {
   rf.allowDuplicates(false);
 }
 
+TEST_F(ExtensionsTest, test_shared_memory_ring) {
+  if (isPlatform(PlatformType::TYPE_WINDOWS)) {
+    return;
+  }
+
+  auto name = "/osquery.extensions_test." +
+              fs::unique_path("%%%%.%%%%").string();
+  std::unique_ptr<SharedMemoryRing> reader;
+  ASSERT_TRUE(SharedMemoryRing::create(name, 16, reader).ok());
+  std::unique_ptr<SharedMemoryRing> writer;
+  ASSERT_TRUE(SharedMemoryRing::open(name, writer).ok());
+  reader->unlink();
+  ASSERT_EQ(writer->size(), 16U);
+
+  size_t first = 0;
+  size_t second = 0;
+  size_t offset = 0;
+  ASSERT_TRUE(writer->write("aaaaaa", first));
+  ASSERT_TRUE(writer->write("bbbbbb", second));
+  EXPECT_EQ(second, 6U);
+  EXPECT_FALSE(writer->write("cccccc", offset));
+
+  std::string payload;
+  ASSERT_TRUE(reader->read(second, 6, payload));
+  EXPECT_EQ(payload, "bbbbbb");
+  EXPECT_FALSE(reader->read(12, 6, payload));
+
+  // Space is reclaimed in order, the released second payload waits.
+  writer->release(second);
+  EXPECT_FALSE(writer->write("cccccc", offset));
+  writer->release(first);
+  ASSERT_TRUE(writer->write("cccccc", offset));
+  EXPECT_EQ(offset, 0U);
+}
+
+TEST_F(ExtensionsTest, test_extension_shared_memory) {
+  if (isPlatform(PlatformType::TYPE_WINDOWS)) {
+    return;
+  }
+
+  auto status = startExtensionManager(socket_path);
+  ASSERT_TRUE(status.ok());
+
+  auto& rf = RegistryFactory::get();
+  rf.registry("extension_test")
+      ->add("shared_item", std::make_shared<TestExtensionPlugin>());
+  rf.addAlias("extension_test", "shared_item", "shared_alias");
+  rf.allowDuplicates(true);
+
+  FLAGS_extensions_shared_memory_size = 64 * 1024;
+  status = startExtension(socket_path, "shared", "0.1", "0.0.0", "0.0.0");
+  FLAGS_extensions_shared_memory_size = 0;
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  auto uuid = (RouteUUID)stoi(status.getMessage(), nullptr, 0);
+
+  // The large value is read from shared memory by the extension.
+  std::string large(kSharedMemoryMinPayload * 2, 'a');
+  PluginResponse response;
+  status = callExtension(uuid,
+                         "extension_test",
+                         "shared_alias",
+                         {{"small", "b"}, {"large", large}},
+                         response);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(response.size(), 2U);
+  EXPECT_EQ(response[0]["large"], large);
+  EXPECT_EQ(response[1]["small"], "b");
+
+  rf.removeBroadcast(uuid);
+  rf.allowDuplicates(false);
+}
+
 } // namespace osquery
@@ -25,6 +25,10 @@ class ExtensionIf {
   virtual void ping(ExtensionStatus& _return) = 0;
   virtual void call(ExtensionResponse& _return, const std::string& registry, const std::string& item, const ExtensionPluginRequest& request) = 0;
   virtual void shutdown() = 0;
+  virtual void callColumnar(ExtensionColumnarResponse& _return, const std::string& registry, const std::string& item, const ExtensionPluginRequest& request) = 0;
+  virtual void openCursor(ExtensionColumnarResponse& _return, const std::string& item, const ExtensionPluginRequest& request, const int32_t batch_rows) = 0;
+  virtual void fetchCursor(ExtensionColumnarResponse& _return, const int64_t cursor) = 0;
+  virtual void closeCursor(ExtensionStatus& _return, const int64_t cursor) = 0;
 };
 
 class ExtensionIfFactory {
@@ -64,6 +68,18 @@ class ExtensionNull : virtual public ExtensionIf {
   void shutdown() {
     return;
   }
+  void callColumnar(ExtensionColumnarResponse& /* _return */, const std::string& /* registry */, const std::string& /* item */, const ExtensionPluginRequest& /* request */) {
+    return;
+  }
+  void openCursor(ExtensionColumnarResponse& /* _return */, const std::string& /* item */, const ExtensionPluginRequest& /* request */, const int32_t /* batch_rows */) {
+    return;
+  }
+  void fetchCursor(ExtensionColumnarResponse& /* _return */, const int64_t /* cursor */) {
+    return;
+  }
+  void closeCursor(ExtensionStatus& /* _return */, const int64_t /* cursor */) {
+    return;
+  }
 };
 
 
@@ -350,6 +366,450 @@ class Extension_shutdown_presult {
 
 };
 
+typedef struct _Extension_callColumnar_args__isset {
+  _Extension_callColumnar_args__isset() : registry(false), item(false), request(false) {}
+  bool registry :1;
+  bool item :1;
+  bool request :1;
+} _Extension_callColumnar_args__isset;
+
+class Extension_callColumnar_args {
+ public:
+
+  Extension_callColumnar_args(const Extension_callColumnar_args&);
+  Extension_callColumnar_args(Extension_callColumnar_args&&);
+  Extension_callColumnar_args& operator=(const Extension_callColumnar_args&);
+  Extension_callColumnar_args& operator=(Extension_callColumnar_args&&);
+  Extension_callColumnar_args() : registry(), item() {
+  }
+
+  virtual ~Extension_callColumnar_args() noexcept;
+  std::string registry;
+  std::string item;
+  ExtensionPluginRequest request;
+
+  _Extension_callColumnar_args__isset __isset;
+
+  void __set_registry(const std::string& val);
+
+  void __set_item(const std::string& val);
+
+  void __set_request(const ExtensionPluginRequest& val);
+
+  bool operator == (const Extension_callColumnar_args & rhs) const
+  {
+    if (!(registry == rhs.registry))
+      return false;
+    if (!(item == rhs.item))
+      return false;
+    if (!(request == rhs.request))
+      return false;
+    return true;
+  }
+  bool operator != (const Extension_callColumnar_args &rhs) const {
+    return !(*this == rhs);
+  }
+
+  bool operator < (const Extension_callColumnar_args & ) const;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+
+class Extension_callColumnar_pargs {
+ public:
+  virtual ~Extension_callColumnar_pargs() noexcept;
+  const std::string* registry;
+  const std::string* item;
+  const ExtensionPluginRequest* request;
+
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+typedef struct _Extension_callColumnar_result__isset {
+  _Extension_callColumnar_result__isset() : success(false) {}
+  bool success :1;
+} _Extension_callColumnar_result__isset;
+
+class Extension_callColumnar_result {
+ public:
+
+  Extension_callColumnar_result(const Extension_callColumnar_result&);
+  Extension_callColumnar_result(Extension_callColumnar_result&&);
+  Extension_callColumnar_result& operator=(const Extension_callColumnar_result&);
+  Extension_callColumnar_result& operator=(Extension_callColumnar_result&&);
+  Extension_callColumnar_result() {
+  }
+
+  virtual ~Extension_callColumnar_result() noexcept;
+  ExtensionColumnarResponse success;
+
+  _Extension_callColumnar_result__isset __isset;
+
+  void __set_success(const ExtensionColumnarResponse& val);
+
+  bool operator == (const Extension_callColumnar_result & rhs) const
+  {
+    if (!(success == rhs.success))
+      return false;
+    return true;
+  }
+  bool operator != (const Extension_callColumnar_result &rhs) const {
+    return !(*this == rhs);
+  }
+
+  bool operator < (const Extension_callColumnar_result & ) const;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+typedef struct _Extension_callColumnar_presult__isset {
+  _Extension_callColumnar_presult__isset() : success(false) {}
+  bool success :1;
+} _Extension_callColumnar_presult__isset;
+
+class Extension_callColumnar_presult {
+ public:
+  virtual ~Extension_callColumnar_presult() noexcept;
+  ExtensionColumnarResponse* success;
+
+  _Extension_callColumnar_presult__isset __isset;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+
+};
+
+typedef struct _Extension_openCursor_args__isset {
+  _Extension_openCursor_args__isset() : item(false), request(false), batch_rows(false) {}
+  bool item :1;
+  bool request :1;
+  bool batch_rows :1;
+} _Extension_openCursor_args__isset;
+
+class Extension_openCursor_args {
+ public:
+
+  Extension_openCursor_args(const Extension_openCursor_args&);
+  Extension_openCursor_args(Extension_openCursor_args&&);
+  Extension_openCursor_args& operator=(const Extension_openCursor_args&);
+  Extension_openCursor_args& operator=(Extension_openCursor_args&&);
+  Extension_openCursor_args() : item(), batch_rows(0) {
+  }
+
+  virtual ~Extension_openCursor_args() noexcept;
+  std::string item;
+  ExtensionPluginRequest request;
+  int32_t batch_rows;
+
+  _Extension_openCursor_args__isset __isset;
+
+  void __set_item(const std::string& val);
+
+  void __set_request(const ExtensionPluginRequest& val);
+
+  void __set_batch_rows(const int32_t val);
+
+  bool operator == (const Extension_openCursor_args & rhs) const
+  {
+    if (!(item == rhs.item))
+      return false;
+    if (!(request == rhs.request))
+      return false;
+    if (!(batch_rows == rhs.batch_rows))
+      return false;
+    return true;
+  }
+  bool operator != (const Extension_openCursor_args &rhs) const {
+    return !(*this == rhs);
+  }
+
+  bool operator < (const Extension_openCursor_args & ) const;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+
+class Extension_openCursor_pargs {
+ public:
+  virtual ~Extension_openCursor_pargs() noexcept;
+  const std::string* item;
+  const ExtensionPluginRequest* request;
+  const int32_t* batch_rows;
+
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+typedef struct _Extension_openCursor_result__isset {
+  _Extension_openCursor_result__isset() : success(false) {}
+  bool success :1;
+} _Extension_openCursor_result__isset;
+
+class Extension_openCursor_result {
+ public:
+
+  Extension_openCursor_result(const Extension_openCursor_result&);
+  Extension_openCursor_result(Extension_openCursor_result&&);
+  Extension_openCursor_result& operator=(const Extension_openCursor_result&);
+  Extension_openCursor_result& operator=(Extension_openCursor_result&&);
+  Extension_openCursor_result() {
+  }
+
+  virtual ~Extension_openCursor_result() noexcept;
+  ExtensionColumnarResponse success;
+
+  _Extension_openCursor_result__isset __isset;
+
+  void __set_success(const ExtensionColumnarResponse& val);
+
+  bool operator == (const Extension_openCursor_result & rhs) const
+  {
+    if (!(success == rhs.success))
+      return false;
+    return true;
+  }
+  bool operator != (const Extension_openCursor_result &rhs) const {
+    return !(*this == rhs);
+  }
+
+  bool operator < (const Extension_openCursor_result & ) const;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+typedef struct _Extension_openCursor_presult__isset {
+  _Extension_openCursor_presult__isset() : success(false) {}
+  bool success :1;
+} _Extension_openCursor_presult__isset;
+
+class Extension_openCursor_presult {
+ public:
+  virtual ~Extension_openCursor_presult() noexcept;
+  ExtensionColumnarResponse* success;
+
+  _Extension_openCursor_presult__isset __isset;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+
+};
+
+typedef struct _Extension_fetchCursor_args__isset {
+  _Extension_fetchCursor_args__isset() : cursor(false) {}
+  bool cursor :1;
+} _Extension_fetchCursor_args__isset;
+
+class Extension_fetchCursor_args {
+ public:
+
+  Extension_fetchCursor_args(const Extension_fetchCursor_args&);
+  Extension_fetchCursor_args(Extension_fetchCursor_args&&);
+  Extension_fetchCursor_args& operator=(const Extension_fetchCursor_args&);
+  Extension_fetchCursor_args& operator=(Extension_fetchCursor_args&&);
+  Extension_fetchCursor_args() : cursor(0) {
+  }
+
+  virtual ~Extension_fetchCursor_args() noexcept;
+  int64_t cursor;
+
+  _Extension_fetchCursor_args__isset __isset;
+
+  void __set_cursor(const int64_t val);
+
+  bool operator == (const Extension_fetchCursor_args & rhs) const
+  {
+    if (!(cursor == rhs.cursor))
+      return false;
+    return true;
+  }
+  bool operator != (const Extension_fetchCursor_args &rhs) const {
+    return !(*this == rhs);
+  }
+
+  bool operator < (const Extension_fetchCursor_args & ) const;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+
+class Extension_fetchCursor_pargs {
+ public:
+  virtual ~Extension_fetchCursor_pargs() noexcept;
+  const int64_t* cursor;
+
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+typedef struct _Extension_fetchCursor_result__isset {
+  _Extension_fetchCursor_result__isset() : success(false) {}
+  bool success :1;
+} _Extension_fetchCursor_result__isset;
+
+class Extension_fetchCursor_result {
+ public:
+
+  Extension_fetchCursor_result(const Extension_fetchCursor_result&);
+  Extension_fetchCursor_result(Extension_fetchCursor_result&&);
+  Extension_fetchCursor_result& operator=(const Extension_fetchCursor_result&);
+  Extension_fetchCursor_result& operator=(Extension_fetchCursor_result&&);
+  Extension_fetchCursor_result() {
+  }
+
+  virtual ~Extension_fetchCursor_result() noexcept;
+  ExtensionColumnarResponse success;
+
+  _Extension_fetchCursor_result__isset __isset;
+
+  void __set_success(const ExtensionColumnarResponse& val);
+
+  bool operator == (const Extension_fetchCursor_result & rhs) const
+  {
+    if (!(success == rhs.success))
+      return false;
+    return true;
+  }
+  bool operator != (const Extension_fetchCursor_result &rhs) const {
+    return !(*this == rhs);
+  }
+
+  bool operator < (const Extension_fetchCursor_result & ) const;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+typedef struct _Extension_fetchCursor_presult__isset {
+  _Extension_fetchCursor_presult__isset() : success(false) {}
+  bool success :1;
+} _Extension_fetchCursor_presult__isset;
+
+class Extension_fetchCursor_presult {
+ public:
+  virtual ~Extension_fetchCursor_presult() noexcept;
+  ExtensionColumnarResponse* success;
+
+  _Extension_fetchCursor_presult__isset __isset;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+
+};
+
+typedef struct _Extension_closeCursor_args__isset {
+  _Extension_closeCursor_args__isset() : cursor(false) {}
+  bool cursor :1;
+} _Extension_closeCursor_args__isset;
+
+class Extension_closeCursor_args {
+ public:
+
+  Extension_closeCursor_args(const Extension_closeCursor_args&);
+  Extension_closeCursor_args(Extension_closeCursor_args&&);
+  Extension_closeCursor_args& operator=(const Extension_closeCursor_args&);
+  Extension_closeCursor_args& operator=(Extension_closeCursor_args&&);
+  Extension_closeCursor_args() : cursor(0) {
+  }
+
+  virtual ~Extension_closeCursor_args() noexcept;
+  int64_t cursor;
+
+  _Extension_closeCursor_args__isset __isset;
+
+  void __set_cursor(const int64_t val);
+
+  bool operator == (const Extension_closeCursor_args & rhs) const
+  {
+    if (!(cursor == rhs.cursor))
+      return false;
+    return true;
+  }
+  bool operator != (const Extension_closeCursor_args &rhs) const {
+    return !(*this == rhs);
+  }
+
+  bool operator < (const Extension_closeCursor_args & ) const;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+
+class Extension_closeCursor_pargs {
+ public:
+  virtual ~Extension_closeCursor_pargs() noexcept;
+  const int64_t* cursor;
+
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+typedef struct _Extension_closeCursor_result__isset {
+  _Extension_closeCursor_result__isset() : success(false) {}
+  bool success :1;
+} _Extension_closeCursor_result__isset;
+
+class Extension_closeCursor_result {
+ public:
+
+  Extension_closeCursor_result(const Extension_closeCursor_result&);
+  Extension_closeCursor_result(Extension_closeCursor_result&&);
+  Extension_closeCursor_result& operator=(const Extension_closeCursor_result&);
+  Extension_closeCursor_result& operator=(Extension_closeCursor_result&&);
+  Extension_closeCursor_result() {
+  }
+
+  virtual ~Extension_closeCursor_result() noexcept;
+  ExtensionStatus success;
+
+  _Extension_closeCursor_result__isset __isset;
+
+  void __set_success(const ExtensionStatus& val);
+
+  bool operator == (const Extension_closeCursor_result & rhs) const
+  {
+    if (!(success == rhs.success))
+      return false;
+    return true;
+  }
+  bool operator != (const Extension_closeCursor_result &rhs) const {
+    return !(*this == rhs);
+  }
+
+  bool operator < (const Extension_closeCursor_result & ) const;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+typedef struct _Extension_closeCursor_presult__isset {
+  _Extension_closeCursor_presult__isset() : success(false) {}
+  bool success :1;
+} _Extension_closeCursor_presult__isset;
+
+class Extension_closeCursor_presult {
+ public:
+  virtual ~Extension_closeCursor_presult() noexcept;
+  ExtensionStatus* success;
+
+  _Extension_closeCursor_presult__isset __isset;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+
+};
+
 class ExtensionClient : virtual public ExtensionIf {
  public:
   ExtensionClient(std::shared_ptr<::apache::thrift::protocol::TProtocol> prot) {
@@ -391,6 +851,18 @@ class ExtensionClient : virtual public ExtensionIf {
   void shutdown();
   void send_shutdown();
   void recv_shutdown();
+  void callColumnar(ExtensionColumnarResponse& _return, const std::string& registry, const std::string& item, const ExtensionPluginRequest& request);
+  void send_callColumnar(const std::string& registry, const std::string& item, const ExtensionPluginRequest& request);
+  void recv_callColumnar(ExtensionColumnarResponse& _return);
+  void openCursor(ExtensionColumnarResponse& _return, const std::string& item, const ExtensionPluginRequest& request, const int32_t batch_rows);
+  void send_openCursor(const std::string& item, const ExtensionPluginRequest& request, const int32_t batch_rows);
+  void recv_openCursor(ExtensionColumnarResponse& _return);
+  void fetchCursor(ExtensionColumnarResponse& _return, const int64_t cursor);
+  void send_fetchCursor(const int64_t cursor);
+  void recv_fetchCursor(ExtensionColumnarResponse& _return);
+  void closeCursor(ExtensionStatus& _return, const int64_t cursor);
+  void send_closeCursor(const int64_t cursor);
+  void recv_closeCursor(ExtensionStatus& _return);
  protected:
   std::shared_ptr<::apache::thrift::protocol::TProtocol> piprot_;
   std::shared_ptr<::apache::thrift::protocol::TProtocol> poprot_;
@@ -409,11 +881,19 @@ class ExtensionProcessor : public ::apache::thrift::TDispatchProcessor {
   void process_ping(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot, void* callContext);
   void process_call(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot, void* callContext);
   void process_shutdown(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot, void* callContext);
+  void process_callColumnar(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot, void* callContext);
+  void process_openCursor(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot, void* callContext);
+  void process_fetchCursor(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot, void* callContext);
+  void process_closeCursor(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot, void* callContext);
  public:
   ExtensionProcessor(::std::shared_ptr<ExtensionIf> iface) : iface_(iface) {
     processMap_["ping"] = &ExtensionProcessor::process_ping;
     processMap_["call"] = &ExtensionProcessor::process_call;
     processMap_["shutdown"] = &ExtensionProcessor::process_shutdown;
+    processMap_["callColumnar"] = &ExtensionProcessor::process_callColumnar;
+    processMap_["openCursor"] = &ExtensionProcessor::process_openCursor;
+    processMap_["fetchCursor"] = &ExtensionProcessor::process_fetchCursor;
+    processMap_["closeCursor"] = &ExtensionProcessor::process_closeCursor;
   }
 
   virtual ~ExtensionProcessor() {}
@@ -474,6 +954,46 @@ class ExtensionMultiface : virtual public ExtensionIf {
     ifaces_[i]->shutdown();
   }
 
+  void callColumnar(ExtensionColumnarResponse& _return, const std::string& registry, const std::string& item, const ExtensionPluginRequest& request) {
+    size_t sz = ifaces_.size();
+    size_t i = 0;
+    for (; i < (sz - 1); ++i) {
+      ifaces_[i]->callColumnar(_return, registry, item, request);
+    }
+    ifaces_[i]->callColumnar(_return, registry, item, request);
+    return;
+  }
+
+  void openCursor(ExtensionColumnarResponse& _return, const std::string& item, const ExtensionPluginRequest& request, const int32_t batch_rows) {
+    size_t sz = ifaces_.size();
+    size_t i = 0;
+    for (; i < (sz - 1); ++i) {
+      ifaces_[i]->openCursor(_return, item, request, batch_rows);
+    }
+    ifaces_[i]->openCursor(_return, item, request, batch_rows);
+    return;
+  }
+
+  void fetchCursor(ExtensionColumnarResponse& _return, const int64_t cursor) {
+    size_t sz = ifaces_.size();
+    size_t i = 0;
+    for (; i < (sz - 1); ++i) {
+      ifaces_[i]->fetchCursor(_return, cursor);
+    }
+    ifaces_[i]->fetchCursor(_return, cursor);
+    return;
+  }
+
+  void closeCursor(ExtensionStatus& _return, const int64_t cursor) {
+    size_t sz = ifaces_.size();
+    size_t i = 0;
+    for (; i < (sz - 1); ++i) {
+      ifaces_[i]->closeCursor(_return, cursor);
+    }
+    ifaces_[i]->closeCursor(_return, cursor);
+    return;
+  }
+
 };
 
 // The 'concurrent' client is a thread safe client that correctly handles
@@ -525,6 +1045,18 @@ class ExtensionConcurrentClient : virtual public ExtensionIf {
   void shutdown();
   int32_t send_shutdown();
   void recv_shutdown(const int32_t seqid);
+  void callColumnar(ExtensionColumnarResponse& _return, const std::string& registry, const std::string& item, const ExtensionPluginRequest& request);
+  int32_t send_callColumnar(const std::string& registry, const std::string& item, const ExtensionPluginRequest& request);
+  void recv_callColumnar(ExtensionColumnarResponse& _return, const int32_t seqid);
+  void openCursor(ExtensionColumnarResponse& _return, const std::string& item, const ExtensionPluginRequest& request, const int32_t batch_rows);
+  int32_t send_openCursor(const std::string& item, const ExtensionPluginRequest& request, const int32_t batch_rows);
+  void recv_openCursor(ExtensionColumnarResponse& _return, const int32_t seqid);
+  void fetchCursor(ExtensionColumnarResponse& _return, const int64_t cursor);
+  int32_t send_fetchCursor(const int64_t cursor);
+  void recv_fetchCursor(ExtensionColumnarResponse& _return, const int32_t seqid);
+  void closeCursor(ExtensionStatus& _return, const int64_t cursor);
+  int32_t send_closeCursor(const int64_t cursor);
+  void recv_closeCursor(ExtensionStatus& _return, const int32_t seqid);
  protected:
   std::shared_ptr<::apache::thrift::protocol::TProtocol> piprot_;
   std::shared_ptr<::apache::thrift::protocol::TProtocol> poprot_;
@@ -35,6 +35,26 @@ class ExtensionHandler : virtual public ExtensionIf {
     printf("shutdown\n");
   }
 
+  void callColumnar(ExtensionColumnarResponse& _return, const std::string& registry, const std::string& item, const ExtensionPluginRequest& request) {
+    // Your implementation goes here
+    printf("callColumnar\n");
+  }
+
+  void openCursor(ExtensionColumnarResponse& _return, const std::string& item, const ExtensionPluginRequest& request, const int32_t batch_rows) {
+    // Your implementation goes here
+    printf("openCursor\n");
+  }
+
+  void fetchCursor(ExtensionColumnarResponse& _return, const int64_t cursor) {
+    // Your implementation goes here
+    printf("fetchCursor\n");
+  }
+
+  void closeCursor(ExtensionStatus& _return, const int64_t cursor) {
+    // Your implementation goes here
+    printf("closeCursor\n");
+  }
+
 };
 
 int main(int argc, char **argv) {
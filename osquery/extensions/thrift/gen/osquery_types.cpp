@@ -16,14 +16,16 @@ namespace osquery { namespace extensions {
 int _kExtensionCodeValues[] = {
   ExtensionCode::EXT_SUCCESS,
   ExtensionCode::EXT_FAILED,
-  ExtensionCode::EXT_FATAL
+  ExtensionCode::EXT_FATAL,
+  ExtensionCode::EXT_UNSUPPORTED
 };
 const char* _kExtensionCodeNames[] = {
   "EXT_SUCCESS",
   "EXT_FAILED",
-  "EXT_FATAL"
+  "EXT_FATAL",
+  "EXT_UNSUPPORTED"
 };
-const std::map<int, const char*> _ExtensionCode_VALUES_TO_NAMES(::apache::thrift::TEnumIterator(3, _kExtensionCodeValues, _kExtensionCodeNames), ::apache::thrift::TEnumIterator(-1, NULL, NULL));
+const std::map<int, const char*> _ExtensionCode_VALUES_TO_NAMES(::apache::thrift::TEnumIterator(4, _kExtensionCodeValues, _kExtensionCodeNames), ::apache::thrift::TEnumIterator(-1, NULL, NULL));
 
 std::ostream& operator<<(std::ostream& out, const ExtensionCode::type& val) {
   std::map<int, const char*>::const_iterator it = _ExtensionCode_VALUES_TO_NAMES.find(val);
@@ -205,6 +207,10 @@ void InternalExtensionInfo::__set_sdk_version(const std::string& val) {
 void InternalExtensionInfo::__set_min_sdk_version(const std::string& val) {
   this->min_sdk_version = val;
 }
+
+void InternalExtensionInfo::__set_shared_memory(const std::string& val) {
+  this->shared_memory = val;
+}
 std::ostream& operator<<(std::ostream& out, const InternalExtensionInfo& obj)
 {
   obj.printTo(out);
@@ -265,6 +271,14 @@ uint32_t InternalExtensionInfo::read(::apache::thrift::protocol::TProtocol* ipro
           xfer += iprot->skip(ftype);
         }
         break;
+      case 5:
+        if (ftype == ::apache::thrift::protocol::T_STRING) {
+          xfer += iprot->readString(this->shared_memory);
+          this->__isset.shared_memory = true;
+        } else {
+          xfer += iprot->skip(ftype);
+        }
+        break;
       default:
         xfer += iprot->skip(ftype);
         break;
@@ -298,6 +312,10 @@ uint32_t InternalExtensionInfo::write(::apache::thrift::protocol::TProtocol* opr
   xfer += oprot->writeString(this->min_sdk_version);
   xfer += oprot->writeFieldEnd();
 
+  xfer += oprot->writeFieldBegin("shared_memory", ::apache::thrift::protocol::T_STRING, 5);
+  xfer += oprot->writeString(this->shared_memory);
+  xfer += oprot->writeFieldEnd();
+
   xfer += oprot->writeFieldStop();
   xfer += oprot->writeStructEnd();
   return xfer;
@@ -309,6 +327,7 @@ void swap(InternalExtensionInfo &a, InternalExtensionInfo &b) {
   swap(a.version, b.version);
   swap(a.sdk_version, b.sdk_version);
   swap(a.min_sdk_version, b.min_sdk_version);
+  swap(a.shared_memory, b.shared_memory);
   swap(a.__isset, b.__isset);
 }
 
@@ -318,6 +337,7 @@ InternalExtensionInfo::InternalExtensionInfo(
   version = other4.version;
   sdk_version = other4.sdk_version;
   min_sdk_version = other4.min_sdk_version;
+  shared_memory = other4.shared_memory;
   __isset = other4.__isset;
 }
 InternalExtensionInfo::InternalExtensionInfo(InternalExtensionInfo&& other5) {
@@ -325,6 +345,7 @@ InternalExtensionInfo::InternalExtensionInfo(InternalExtensionInfo&& other5) {
   version = std::move(other5.version);
   sdk_version = std::move(other5.sdk_version);
   min_sdk_version = std::move(other5.min_sdk_version);
+  shared_memory = std::move(other5.shared_memory);
   __isset = std::move(other5.__isset);
 }
 InternalExtensionInfo& InternalExtensionInfo::operator=(
@@ -333,6 +354,7 @@ InternalExtensionInfo& InternalExtensionInfo::operator=(
   version = other6.version;
   sdk_version = other6.sdk_version;
   min_sdk_version = other6.min_sdk_version;
+  shared_memory = other6.shared_memory;
   __isset = other6.__isset;
   return *this;
 }
@@ -342,6 +364,7 @@ InternalExtensionInfo& InternalExtensionInfo::operator=(
   version = std::move(other7.version);
   sdk_version = std::move(other7.sdk_version);
   min_sdk_version = std::move(other7.min_sdk_version);
+  shared_memory = std::move(other7.shared_memory);
   __isset = std::move(other7.__isset);
   return *this;
 }
@@ -352,6 +375,7 @@ void InternalExtensionInfo::printTo(std::ostream& out) const {
   out << ", " << "version=" << to_string(version);
   out << ", " << "sdk_version=" << to_string(sdk_version);
   out << ", " << "min_sdk_version=" << to_string(min_sdk_version);
+  out << ", " << "shared_memory=" << to_string(shared_memory);
   out << ")";
 }
 
@@ -818,4 +842,499 @@ const char* ExtensionException::what() const noexcept {
     return "TException - service has thrown: ExtensionException";
   }
 }
+
+ExtensionColumn::~ExtensionColumn() noexcept {}
+
+void ExtensionColumn::__set_name(const std::string& val) {
+  this->name = val;
+}
+
+void ExtensionColumn::__set_type(const int32_t val) {
+  this->type = val;
+}
+
+void ExtensionColumn::__set_text_values(const std::vector<std::string> & val) {
+  this->text_values = val;
+}
+
+void ExtensionColumn::__set_integer_values(const std::vector<int64_t> & val) {
+  this->integer_values = val;
+}
+
+void ExtensionColumn::__set_double_values(const std::vector<double> & val) {
+  this->double_values = val;
+}
+
+void ExtensionColumn::__set_missing_rows(const std::vector<int32_t> & val) {
+  this->missing_rows = val;
+}
+std::ostream& operator<<(std::ostream& out, const ExtensionColumn& obj)
+{
+  obj.printTo(out);
+  return out;
+}
+
+
+uint32_t ExtensionColumn::read(::apache::thrift::protocol::TProtocol* iprot) {
+
+  ::apache::thrift::protocol::TInputRecursionTracker tracker(*iprot);
+  uint32_t xfer = 0;
+  std::string fname;
+  ::apache::thrift::protocol::TType ftype;
+  int16_t fid;
+
+  xfer += iprot->readStructBegin(fname);
+
+  using ::apache::thrift::protocol::TProtocolException;
+
+
+  while (true)
+  {
+    xfer += iprot->readFieldBegin(fname, ftype, fid);
+    if (ftype == ::apache::thrift::protocol::T_STOP) {
+      break;
+    }
+    switch (fid)
+    {
+      case 1:
+        if (ftype == ::apache::thrift::protocol::T_STRING) {
+          xfer += iprot->readString(this->name);
+          this->__isset.name = true;
+        } else {
+          xfer += iprot->skip(ftype);
+        }
+        break;
+      case 2:
+        if (ftype == ::apache::thrift::protocol::T_I32) {
+          xfer += iprot->readI32(this->type);
+          this->__isset.type = true;
+        } else {
+          xfer += iprot->skip(ftype);
+        }
+        break;
+      case 3:
+        if (ftype == ::apache::thrift::protocol::T_LIST) {
+          {
+            this->text_values.clear();
+            uint32_t _size38;
+            ::apache::thrift::protocol::TType _etype41;
+            xfer += iprot->readListBegin(_etype41, _size38);
+            this->text_values.resize(_size38);
+            uint32_t _i42;
+            for (_i42 = 0; _i42 < _size38; ++_i42)
+            {
+              xfer += iprot->readString(this->text_values[_i42]);
+            }
+            xfer += iprot->readListEnd();
+          }
+          this->__isset.text_values = true;
+        } else {
+          xfer += iprot->skip(ftype);
+        }
+        break;
+      case 4:
+        if (ftype == ::apache::thrift::protocol::T_LIST) {
+          {
+            this->integer_values.clear();
+            uint32_t _size43;
+            ::apache::thrift::protocol::TType _etype46;
+            xfer += iprot->readListBegin(_etype46, _size43);
+            this->integer_values.resize(_size43);
+            uint32_t _i47;
+            for (_i47 = 0; _i47 < _size43; ++_i47)
+            {
+              xfer += iprot->readI64(this->integer_values[_i47]);
+            }
+            xfer += iprot->readListEnd();
+          }
+          this->__isset.integer_values = true;
+        } else {
+          xfer += iprot->skip(ftype);
+        }
+        break;
+      case 5:
+        if (ftype == ::apache::thrift::protocol::T_LIST) {
+          {
+            this->double_values.clear();
+            uint32_t _size48;
+            ::apache::thrift::protocol::TType _etype51;
+            xfer += iprot->readListBegin(_etype51, _size48);
+            this->double_values.resize(_size48);
+            uint32_t _i52;
+            for (_i52 = 0; _i52 < _size48; ++_i52)
+            {
+              xfer += iprot->readDouble(this->double_values[_i52]);
+            }
+            xfer += iprot->readListEnd();
+          }
+          this->__isset.double_values = true;
+        } else {
+          xfer += iprot->skip(ftype);
+        }
+        break;
+      case 6:
+        if (ftype == ::apache::thrift::protocol::T_LIST) {
+          {
+            this->missing_rows.clear();
+            uint32_t _size53;
+            ::apache::thrift::protocol::TType _etype56;
+            xfer += iprot->readListBegin(_etype56, _size53);
+            this->missing_rows.resize(_size53);
+            uint32_t _i57;
+            for (_i57 = 0; _i57 < _size53; ++_i57)
+            {
+              xfer += iprot->readI32(this->missing_rows[_i57]);
+            }
+            xfer += iprot->readListEnd();
+          }
+          this->__isset.missing_rows = true;
+        } else {
+          xfer += iprot->skip(ftype);
+        }
+        break;
+      default:
+        xfer += iprot->skip(ftype);
+        break;
+    }
+    xfer += iprot->readFieldEnd();
+  }
+
+  xfer += iprot->readStructEnd();
+
+  return xfer;
+}
+
+uint32_t ExtensionColumn::write(::apache::thrift::protocol::TProtocol* oprot) const {
+  uint32_t xfer = 0;
+  ::apache::thrift::protocol::TOutputRecursionTracker tracker(*oprot);
+  xfer += oprot->writeStructBegin("ExtensionColumn");
+
+  xfer += oprot->writeFieldBegin("name", ::apache::thrift::protocol::T_STRING, 1);
+  xfer += oprot->writeString(this->name);
+  xfer += oprot->writeFieldEnd();
+
+  xfer += oprot->writeFieldBegin("type", ::apache::thrift::protocol::T_I32, 2);
+  xfer += oprot->writeI32(this->type);
+  xfer += oprot->writeFieldEnd();
+
+  xfer += oprot->writeFieldBegin("text_values", ::apache::thrift::protocol::T_LIST, 3);
+  {
+    xfer += oprot->writeListBegin(::apache::thrift::protocol::T_STRING, static_cast<uint32_t>(this->text_values.size()));
+    std::vector<std::string> ::const_iterator _iter58;
+    for (_iter58 = this->text_values.begin(); _iter58 != this->text_values.end(); ++_iter58)
+    {
+      xfer += oprot->writeString((*_iter58));
+    }
+    xfer += oprot->writeListEnd();
+  }
+  xfer += oprot->writeFieldEnd();
+
+  xfer += oprot->writeFieldBegin("integer_values", ::apache::thrift::protocol::T_LIST, 4);
+  {
+    xfer += oprot->writeListBegin(::apache::thrift::protocol::T_I64, static_cast<uint32_t>(this->integer_values.size()));
+    std::vector<int64_t> ::const_iterator _iter59;
+    for (_iter59 = this->integer_values.begin(); _iter59 != this->integer_values.end(); ++_iter59)
+    {
+      xfer += oprot->writeI64((*_iter59));
+    }
+    xfer += oprot->writeListEnd();
+  }
+  xfer += oprot->writeFieldEnd();
+
+  xfer += oprot->writeFieldBegin("double_values", ::apache::thrift::protocol::T_LIST, 5);
+  {
+    xfer += oprot->writeListBegin(::apache::thrift::protocol::T_DOUBLE, static_cast<uint32_t>(this->double_values.size()));
+    std::vector<double> ::const_iterator _iter60;
+    for (_iter60 = this->double_values.begin(); _iter60 != this->double_values.end(); ++_iter60)
+    {
+      xfer += oprot->writeDouble((*_iter60));
+    }
+    xfer += oprot->writeListEnd();
+  }
+  xfer += oprot->writeFieldEnd();
+
+  xfer += oprot->writeFieldBegin("missing_rows", ::apache::thrift::protocol::T_LIST, 6);
+  {
+    xfer += oprot->writeListBegin(::apache::thrift::protocol::T_I32, static_cast<uint32_t>(this->missing_rows.size()));
+    std::vector<int32_t> ::const_iterator _iter61;
+    for (_iter61 = this->missing_rows.begin(); _iter61 != this->missing_rows.end(); ++_iter61)
+    {
+      xfer += oprot->writeI32((*_iter61));
+    }
+    xfer += oprot->writeListEnd();
+  }
+  xfer += oprot->writeFieldEnd();
+
+  xfer += oprot->writeFieldStop();
+  xfer += oprot->writeStructEnd();
+  return xfer;
+}
+
+void swap(ExtensionColumn &a, ExtensionColumn &b) {
+  using ::std::swap;
+  swap(a.name, b.name);
+  swap(a.type, b.type);
+  swap(a.text_values, b.text_values);
+  swap(a.integer_values, b.integer_values);
+  swap(a.double_values, b.double_values);
+  swap(a.missing_rows, b.missing_rows);
+  swap(a.__isset, b.__isset);
+}
+
+ExtensionColumn::ExtensionColumn(const ExtensionColumn& other62) {
+  name = other62.name;
+  type = other62.type;
+  text_values = other62.text_values;
+  integer_values = other62.integer_values;
+  double_values = other62.double_values;
+  missing_rows = other62.missing_rows;
+  __isset = other62.__isset;
+}
+ExtensionColumn::ExtensionColumn(ExtensionColumn&& other63) {
+  name = std::move(other63.name);
+  type = std::move(other63.type);
+  text_values = std::move(other63.text_values);
+  integer_values = std::move(other63.integer_values);
+  double_values = std::move(other63.double_values);
+  missing_rows = std::move(other63.missing_rows);
+  __isset = std::move(other63.__isset);
+}
+ExtensionColumn& ExtensionColumn::operator=(const ExtensionColumn& other64) {
+  name = other64.name;
+  type = other64.type;
+  text_values = other64.text_values;
+  integer_values = other64.integer_values;
+  double_values = other64.double_values;
+  missing_rows = other64.missing_rows;
+  __isset = other64.__isset;
+  return *this;
+}
+ExtensionColumn& ExtensionColumn::operator=(ExtensionColumn&& other65) {
+  name = std::move(other65.name);
+  type = std::move(other65.type);
+  text_values = std::move(other65.text_values);
+  integer_values = std::move(other65.integer_values);
+  double_values = std::move(other65.double_values);
+  missing_rows = std::move(other65.missing_rows);
+  __isset = std::move(other65.__isset);
+  return *this;
+}
+void ExtensionColumn::printTo(std::ostream& out) const {
+  using ::apache::thrift::to_string;
+  out << "ExtensionColumn(";
+  out << "name=" << to_string(name);
+  out << ", " << "type=" << to_string(type);
+  out << ", " << "text_values=" << to_string(text_values);
+  out << ", " << "integer_values=" << to_string(integer_values);
+  out << ", " << "double_values=" << to_string(double_values);
+  out << ", " << "missing_rows=" << to_string(missing_rows);
+  out << ")";
+}
+
+
+ExtensionColumnarResponse::~ExtensionColumnarResponse() noexcept {}
+
+void ExtensionColumnarResponse::__set_status(const ExtensionStatus& val) {
+  this->status = val;
+}
+
+void ExtensionColumnarResponse::__set_rows(const int64_t val) {
+  this->rows = val;
+}
+
+void ExtensionColumnarResponse::__set_columns(const std::vector<ExtensionColumn> & val) {
+  this->columns = val;
+}
+
+void ExtensionColumnarResponse::__set_cursor(const int64_t val) {
+  this->cursor = val;
+}
+
+void ExtensionColumnarResponse::__set_more(const bool val) {
+  this->more = val;
+}
+std::ostream& operator<<(std::ostream& out, const ExtensionColumnarResponse& obj)
+{
+  obj.printTo(out);
+  return out;
+}
+
+
+uint32_t ExtensionColumnarResponse::read(::apache::thrift::protocol::TProtocol* iprot) {
+
+  ::apache::thrift::protocol::TInputRecursionTracker tracker(*iprot);
+  uint32_t xfer = 0;
+  std::string fname;
+  ::apache::thrift::protocol::TType ftype;
+  int16_t fid;
+
+  xfer += iprot->readStructBegin(fname);
+
+  using ::apache::thrift::protocol::TProtocolException;
+
+
+  while (true)
+  {
+    xfer += iprot->readFieldBegin(fname, ftype, fid);
+    if (ftype == ::apache::thrift::protocol::T_STOP) {
+      break;
+    }
+    switch (fid)
+    {
+      case 1:
+        if (ftype == ::apache::thrift::protocol::T_STRUCT) {
+          xfer += this->status.read(iprot);
+          this->__isset.status = true;
+        } else {
+          xfer += iprot->skip(ftype);
+        }
+        break;
+      case 2:
+        if (ftype == ::apache::thrift::protocol::T_I64) {
+          xfer += iprot->readI64(this->rows);
+          this->__isset.rows = true;
+        } else {
+          xfer += iprot->skip(ftype);
+        }
+        break;
+      case 3:
+        if (ftype == ::apache::thrift::protocol::T_LIST) {
+          {
+            this->columns.clear();
+            uint32_t _size66;
+            ::apache::thrift::protocol::TType _etype69;
+            xfer += iprot->readListBegin(_etype69, _size66);
+            this->columns.resize(_size66);
+            uint32_t _i70;
+            for (_i70 = 0; _i70 < _size66; ++_i70)
+            {
+              xfer += this->columns[_i70].read(iprot);
+            }
+            xfer += iprot->readListEnd();
+          }
+          this->__isset.columns = true;
+        } else {
+          xfer += iprot->skip(ftype);
+        }
+        break;
+      case 4:
+        if (ftype == ::apache::thrift::protocol::T_I64) {
+          xfer += iprot->readI64(this->cursor);
+          this->__isset.cursor = true;
+        } else {
+          xfer += iprot->skip(ftype);
+        }
+        break;
+      case 5:
+        if (ftype == ::apache::thrift::protocol::T_BOOL) {
+          xfer += iprot->readBool(this->more);
+          this->__isset.more = true;
+        } else {
+          xfer += iprot->skip(ftype);
+        }
+        break;
+      default:
+        xfer += iprot->skip(ftype);
+        break;
+    }
+    xfer += iprot->readFieldEnd();
+  }
+
+  xfer += iprot->readStructEnd();
+
+  return xfer;
+}
+
+uint32_t ExtensionColumnarResponse::write(::apache::thrift::protocol::TProtocol* oprot) const {
+  uint32_t xfer = 0;
+  ::apache::thrift::protocol::TOutputRecursionTracker tracker(*oprot);
+  xfer += oprot->writeStructBegin("ExtensionColumnarResponse");
+
+  xfer += oprot->writeFieldBegin("status", ::apache::thrift::protocol::T_STRUCT, 1);
+  xfer += this->status.write(oprot);
+  xfer += oprot->writeFieldEnd();
+
+  xfer += oprot->writeFieldBegin("rows", ::apache::thrift::protocol::T_I64, 2);
+  xfer += oprot->writeI64(this->rows);
+  xfer += oprot->writeFieldEnd();
+
+  xfer += oprot->writeFieldBegin("columns", ::apache::thrift::protocol::T_LIST, 3);
+  {
+    xfer += oprot->writeListBegin(::apache::thrift::protocol::T_STRUCT, static_cast<uint32_t>(this->columns.size()));
+    std::vector<ExtensionColumn> ::const_iterator _iter71;
+    for (_iter71 = this->columns.begin(); _iter71 != this->columns.end(); ++_iter71)
+    {
+      xfer += (*_iter71).write(oprot);
+    }
+    xfer += oprot->writeListEnd();
+  }
+  xfer += oprot->writeFieldEnd();
+
+  xfer += oprot->writeFieldBegin("cursor", ::apache::thrift::protocol::T_I64, 4);
+  xfer += oprot->writeI64(this->cursor);
+  xfer += oprot->writeFieldEnd();
+
+  xfer += oprot->writeFieldBegin("more", ::apache::thrift::protocol::T_BOOL, 5);
+  xfer += oprot->writeBool(this->more);
+  xfer += oprot->writeFieldEnd();
+
+  xfer += oprot->writeFieldStop();
+  xfer += oprot->writeStructEnd();
+  return xfer;
+}
+
+void swap(ExtensionColumnarResponse &a, ExtensionColumnarResponse &b) {
+  using ::std::swap;
+  swap(a.status, b.status);
+  swap(a.rows, b.rows);
+  swap(a.columns, b.columns);
+  swap(a.cursor, b.cursor);
+  swap(a.more, b.more);
+  swap(a.__isset, b.__isset);
+}
+
+ExtensionColumnarResponse::ExtensionColumnarResponse(const ExtensionColumnarResponse& other72) {
+  status = other72.status;
+  rows = other72.rows;
+  columns = other72.columns;
+  cursor = other72.cursor;
+  more = other72.more;
+  __isset = other72.__isset;
+}
+ExtensionColumnarResponse::ExtensionColumnarResponse(ExtensionColumnarResponse&& other73) {
+  status = std::move(other73.status);
+  rows = std::move(other73.rows);
+  columns = std::move(other73.columns);
+  cursor = std::move(other73.cursor);
+  more = std::move(other73.more);
+  __isset = std::move(other73.__isset);
+}
+ExtensionColumnarResponse& ExtensionColumnarResponse::operator=(const ExtensionColumnarResponse& other74) {
+  status = other74.status;
+  rows = other74.rows;
+  columns = other74.columns;
+  cursor = other74.cursor;
+  more = other74.more;
+  __isset = other74.__isset;
+  return *this;
+}
+ExtensionColumnarResponse& ExtensionColumnarResponse::operator=(ExtensionColumnarResponse&& other75) {
+  status = std::move(other75.status);
+  rows = std::move(other75.rows);
+  columns = std::move(other75.columns);
+  cursor = std::move(other75.cursor);
+  more = std::move(other75.more);
+  __isset = std::move(other75.__isset);
+  return *this;
+}
+void ExtensionColumnarResponse::printTo(std::ostream& out) const {
+  using ::apache::thrift::to_string;
+  out << "ExtensionColumnarResponse(";
+  out << "status=" << to_string(status);
+  out << ", " << "rows=" << to_string(rows);
+  out << ", " << "columns=" << to_string(columns);
+  out << ", " << "cursor=" << to_string(cursor);
+  out << ", " << "more=" << to_string(more);
+  out << ")";
+}
 }} // namespace
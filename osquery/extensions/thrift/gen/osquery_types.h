@@ -24,7 +24,8 @@ struct ExtensionCode {
   enum type {
     EXT_SUCCESS = 0,
     EXT_FAILED = 1,
-    EXT_FATAL = 2
+    EXT_FATAL = 2,
+    EXT_UNSUPPORTED = 3
   };
 };
 
@@ -58,6 +59,10 @@ class ExtensionResponse;
 
 class ExtensionException;
 
+class ExtensionColumn;
+
+class ExtensionColumnarResponse;
+
 typedef struct _InternalOptionInfo__isset {
   _InternalOptionInfo__isset() : value(false), default_value(false), type(false) {}
   bool value :1;
@@ -115,11 +120,12 @@ void swap(InternalOptionInfo &a, InternalOptionInfo &b);
 std::ostream& operator<<(std::ostream& out, const InternalOptionInfo& obj);
 
 typedef struct _InternalExtensionInfo__isset {
-  _InternalExtensionInfo__isset() : name(false), version(false), sdk_version(false), min_sdk_version(false) {}
+  _InternalExtensionInfo__isset() : name(false), version(false), sdk_version(false), min_sdk_version(false), shared_memory(false) {}
   bool name :1;
   bool version :1;
   bool sdk_version :1;
   bool min_sdk_version :1;
+  bool shared_memory :1;
 } _InternalExtensionInfo__isset;
 
 class InternalExtensionInfo : public virtual ::apache::thrift::TBase {
@@ -129,7 +135,7 @@ class InternalExtensionInfo : public virtual ::apache::thrift::TBase {
   InternalExtensionInfo(InternalExtensionInfo&&);
   InternalExtensionInfo& operator=(const InternalExtensionInfo&);
   InternalExtensionInfo& operator=(InternalExtensionInfo&&);
-  InternalExtensionInfo() : name(), version(), sdk_version(), min_sdk_version() {
+  InternalExtensionInfo() : name(), version(), sdk_version(), min_sdk_version(), shared_memory() {
   }
 
   virtual ~InternalExtensionInfo() noexcept;
@@ -137,6 +143,7 @@ class InternalExtensionInfo : public virtual ::apache::thrift::TBase {
   std::string version;
   std::string sdk_version;
   std::string min_sdk_version;
+  std::string shared_memory;
 
   _InternalExtensionInfo__isset __isset;
 
@@ -148,6 +155,8 @@ class InternalExtensionInfo : public virtual ::apache::thrift::TBase {
 
   void __set_min_sdk_version(const std::string& val);
 
+  void __set_shared_memory(const std::string& val);
+
   bool operator == (const InternalExtensionInfo & rhs) const
   {
     if (!(name == rhs.name))
@@ -158,6 +167,8 @@ class InternalExtensionInfo : public virtual ::apache::thrift::TBase {
       return false;
     if (!(min_sdk_version == rhs.min_sdk_version))
       return false;
+    if (!(shared_memory == rhs.shared_memory))
+      return false;
     return true;
   }
   bool operator != (const InternalExtensionInfo &rhs) const {
@@ -340,6 +351,148 @@ void swap(ExtensionException &a, ExtensionException &b);
 
 std::ostream& operator<<(std::ostream& out, const ExtensionException& obj);
 
+typedef struct _ExtensionColumn__isset {
+  _ExtensionColumn__isset() : name(false), type(false), text_values(false), integer_values(false), double_values(false), missing_rows(false) {}
+  bool name :1;
+  bool type :1;
+  bool text_values :1;
+  bool integer_values :1;
+  bool double_values :1;
+  bool missing_rows :1;
+} _ExtensionColumn__isset;
+
+class ExtensionColumn : public virtual ::apache::thrift::TBase {
+ public:
+
+  ExtensionColumn(const ExtensionColumn&);
+  ExtensionColumn(ExtensionColumn&&);
+  ExtensionColumn& operator=(const ExtensionColumn&);
+  ExtensionColumn& operator=(ExtensionColumn&&);
+  ExtensionColumn() : name(), type(0) {
+  }
+
+  virtual ~ExtensionColumn() noexcept;
+  std::string name;
+  int32_t type;
+  std::vector<std::string>  text_values;
+  std::vector<int64_t>  integer_values;
+  std::vector<double>  double_values;
+  std::vector<int32_t>  missing_rows;
+
+  _ExtensionColumn__isset __isset;
+
+  void __set_name(const std::string& val);
+
+  void __set_type(const int32_t val);
+
+  void __set_text_values(const std::vector<std::string> & val);
+
+  void __set_integer_values(const std::vector<int64_t> & val);
+
+  void __set_double_values(const std::vector<double> & val);
+
+  void __set_missing_rows(const std::vector<int32_t> & val);
+
+  bool operator == (const ExtensionColumn & rhs) const
+  {
+    if (!(name == rhs.name))
+      return false;
+    if (!(type == rhs.type))
+      return false;
+    if (!(text_values == rhs.text_values))
+      return false;
+    if (!(integer_values == rhs.integer_values))
+      return false;
+    if (!(double_values == rhs.double_values))
+      return false;
+    if (!(missing_rows == rhs.missing_rows))
+      return false;
+    return true;
+  }
+  bool operator != (const ExtensionColumn &rhs) const {
+    return !(*this == rhs);
+  }
+
+  bool operator < (const ExtensionColumn & ) const;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+  virtual void printTo(std::ostream& out) const;
+};
+
+void swap(ExtensionColumn &a, ExtensionColumn &b);
+
+std::ostream& operator<<(std::ostream& out, const ExtensionColumn& obj);
+
+typedef struct _ExtensionColumnarResponse__isset {
+  _ExtensionColumnarResponse__isset() : status(false), rows(false), columns(false), cursor(false), more(false) {}
+  bool status :1;
+  bool rows :1;
+  bool columns :1;
+  bool cursor :1;
+  bool more :1;
+} _ExtensionColumnarResponse__isset;
+
+class ExtensionColumnarResponse : public virtual ::apache::thrift::TBase {
+ public:
+
+  ExtensionColumnarResponse(const ExtensionColumnarResponse&);
+  ExtensionColumnarResponse(ExtensionColumnarResponse&&);
+  ExtensionColumnarResponse& operator=(const ExtensionColumnarResponse&);
+  ExtensionColumnarResponse& operator=(ExtensionColumnarResponse&&);
+  ExtensionColumnarResponse() : rows(0), cursor(0), more(0) {
+  }
+
+  virtual ~ExtensionColumnarResponse() noexcept;
+  ExtensionStatus status;
+  int64_t rows;
+  std::vector<ExtensionColumn>  columns;
+  int64_t cursor;
+  bool more;
+
+  _ExtensionColumnarResponse__isset __isset;
+
+  void __set_status(const ExtensionStatus& val);
+
+  void __set_rows(const int64_t val);
+
+  void __set_columns(const std::vector<ExtensionColumn> & val);
+
+  void __set_cursor(const int64_t val);
+
+  void __set_more(const bool val);
+
+  bool operator == (const ExtensionColumnarResponse & rhs) const
+  {
+    if (!(status == rhs.status))
+      return false;
+    if (!(rows == rhs.rows))
+      return false;
+    if (!(columns == rhs.columns))
+      return false;
+    if (!(cursor == rhs.cursor))
+      return false;
+    if (!(more == rhs.more))
+      return false;
+    return true;
+  }
+  bool operator != (const ExtensionColumnarResponse &rhs) const {
+    return !(*this == rhs);
+  }
+
+  bool operator < (const ExtensionColumnarResponse & ) const;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+  virtual void printTo(std::ostream& out) const;
+};
+
+void swap(ExtensionColumnarResponse &a, ExtensionColumnarResponse &b);
+
+std::ostream& operator<<(std::ostream& out, const ExtensionColumnarResponse& obj);
+
 }} // namespace
 
 #endif
@@ -30,6 +30,8 @@ struct InternalExtensionInfo {
   2:string version,
   3:string sdk_version,
   4:string min_sdk_version,
+  /// Name of a shared memory segment the extension reads large requests from.
+  5:string shared_memory,
 }
 
 /// Unique ID for each extension.
@@ -45,6 +47,8 @@ enum ExtensionCode {
   EXT_SUCCESS = 0,
   EXT_FAILED = 1,
   EXT_FATAL = 2,
+  /// The extension does not implement the call for the registry item.
+  EXT_UNSUPPORTED = 3,
 }
 
 /// Most communication uses the Status return type.
@@ -66,6 +70,29 @@ exception ExtensionException {
   3:ExtensionRouteUUID uuid,
 }
 
+/// The values of one column of a table, in row order.
+struct ExtensionColumn {
+  1:string name,
+  /// The list holding the values: 0 for text, 1 for integers, 2 for doubles.
+  2:i32 type,
+  3:list<string> text_values,
+  4:list<i64> integer_values,
+  5:list<double> double_values,
+  /// The rows without a value, the value lists skip them.
+  6:list<i32> missing_rows,
+}
+
+/// Table rows sent column by column, the names are not repeated per row.
+struct ExtensionColumnarResponse {
+  1:ExtensionStatus status,
+  2:i64 rows,
+  3:list<ExtensionColumn> columns,
+  /// The cursor returning the next rows, 0 once the last batch was sent.
+  4:i64 cursor,
+  /// Another batch of rows follows from the cursor.
+  5:bool more,
+}
+
 service Extension {
   /// Ping to/from an extension and extension manager for metadata.
   ExtensionStatus ping(),
@@ -79,6 +106,26 @@ service Extension {
     3:ExtensionPluginRequest request),
   /// Request that an extension shutdown (does not apply to managers).
   void shutdown(),
+  /// Generate a table plugin, the rows are returned by column.
+  ExtensionColumnarResponse callColumnar(
+    /// The registry name, only table is supported.
+    1:string registry,
+    /// The registry item name (plugin name).
+    2:string item,
+    /// The thrift-equivalent of an osquery::PluginRequest.
+    3:ExtensionPluginRequest request),
+  /// Start generating a table plugin, returns the first batch of rows.
+  ExtensionColumnarResponse openCursor(
+    /// The table plugin name.
+    1:string item,
+    /// The thrift-equivalent of an osquery::PluginRequest.
+    2:ExtensionPluginRequest request,
+    /// The most rows returned by each batch.
+    3:i32 batch_rows),
+  /// Return the next batch of rows of a cursor.
+  ExtensionColumnarResponse fetchCursor(1:i64 cursor),
+  /// Stop a cursor before its last batch, the remaining rows are dropped.
+  ExtensionStatus closeCursor(1:i64 cursor),
 }
 
 /// The extension manager is run by the osquery core process.
@@ -33,6 +33,18 @@ static void PLIST_parse_content(benchmark::State& state) {
 
 BENCHMARK(PLIST_parse_content);
 
+static void PLIST_parse_content_native(benchmark::State& state) {
+  std::string content;
+  readFile(kTestDataPath + "test.plist", content);
+
+  while (state.KeepRunning()) {
+    pt::ptree tree;
+    auto status = parsePlistContentNative(content, tree);
+  }
+}
+
+BENCHMARK(PLIST_parse_content_native);
+
 static void PLIST_parse_file(benchmark::State& state) {
   while (state.KeepRunning()) {
     pt::ptree tree;
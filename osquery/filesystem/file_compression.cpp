@@ -15,12 +15,163 @@
 #include <archive_entry.h>
 #include <zstd.h>
 
+#include <algorithm>
+#include <cerrno>
+
 #include <osquery/core/flags.h>
 #include <osquery/core/system.h>
 #include <osquery/filesystem/filesystem.h>
 
 namespace osquery {
 
+namespace {
+
+/// The zstd streams of a thread, reused by its compressions.
+struct ZstdStreams {
+  ZSTD_CStream* cstream{nullptr};
+  ZSTD_DStream* dstream{nullptr};
+
+  ~ZstdStreams() {
+    if (cstream != nullptr) {
+      ZSTD_freeCStream(cstream);
+    }
+    if (dstream != nullptr) {
+      ZSTD_freeDStream(dstream);
+    }
+  }
+};
+
+thread_local ZstdStreams kZstdStreams;
+
+/// Get the compression stream of the thread, initialized for a new frame.
+ZSTD_CStream* getCStream() {
+  if (kZstdStreams.cstream == nullptr) {
+    kZstdStreams.cstream = ZSTD_createCStream();
+    if (kZstdStreams.cstream == nullptr) {
+      return nullptr;
+    }
+  }
+
+  if (ZSTD_isError(ZSTD_initCStream(kZstdStreams.cstream, 1))) {
+    return nullptr;
+  }
+  return kZstdStreams.cstream;
+}
+
+/// Get the decompression stream of the thread, initialized for a new frame.
+ZSTD_DStream* getDStream(size_t& toRead) {
+  if (kZstdStreams.dstream == nullptr) {
+    kZstdStreams.dstream = ZSTD_createDStream();
+    if (kZstdStreams.dstream == nullptr) {
+      return nullptr;
+    }
+  }
+
+  toRead = ZSTD_initDStream(kZstdStreams.dstream);
+  if (ZSTD_isError(toRead)) {
+    return nullptr;
+  }
+  return kZstdStreams.dstream;
+}
+
+/// Writes the output of libarchive to a sink, optionally through zstd.
+class ArchiveStream {
+ public:
+  ArchiveStream(const ArchiveSink& sink, bool compress)
+      : sink_(sink), compress_(compress) {}
+
+  Status open() {
+    if (!compress_) {
+      return Status::success();
+    }
+
+    // The stream of the thread is reused, it is not freed.
+    cstream_ = getCStream();
+    if (cstream_ == nullptr) {
+      return Status(1, "Couldn't initialize compression stream");
+    }
+    buffOut_.resize(ZSTD_CStreamOutSize());
+    return Status::success();
+  }
+
+  Status write(const void* data, size_t size) {
+    if (!compress_) {
+      return sink_(static_cast<const char*>(data), size);
+    }
+
+    ZSTD_inBuffer input = {data, size, 0};
+    while (input.pos < input.size) {
+      ZSTD_outBuffer output = {buffOut_.data(), buffOut_.size(), 0};
+      auto ret = ZSTD_compressStream(cstream_, &output, &input);
+      if (ZSTD_isError(ret)) {
+        return Status(1,
+                      "ZSTD_compressStream() error : " +
+                          std::string(ZSTD_getErrorName(ret)));
+      }
+
+      if (output.pos > 0) {
+        auto s = sink_(buffOut_.data(), output.pos);
+        if (!s.ok()) {
+          return s;
+        }
+      }
+    }
+    return Status::success();
+  }
+
+  /// Write the end of the zstd frame.
+  Status finish() {
+    if (!compress_) {
+      return Status::success();
+    }
+
+    size_t remainingToFlush = 0;
+    do {
+      ZSTD_outBuffer output = {buffOut_.data(), buffOut_.size(), 0};
+      remainingToFlush = ZSTD_endStream(cstream_, &output);
+      if (ZSTD_isError(remainingToFlush)) {
+        return Status(1, "Couldn't fully flush compressed archive");
+      }
+
+      if (output.pos > 0) {
+        auto s = sink_(buffOut_.data(), output.pos);
+        if (!s.ok()) {
+          return s;
+        }
+      }
+    } while (remainingToFlush > 0);
+    return Status::success();
+  }
+
+  /// The first failure of the sink or the compression.
+  const Status& status() const {
+    return status_;
+  }
+
+  static la_ssize_t writeCallback(struct archive* arch,
+                                  void* client,
+                                  const void* buffer,
+                                  size_t length) {
+    auto stream = static_cast<ArchiveStream*>(client);
+    auto s = stream->write(buffer, length);
+    if (!s.ok()) {
+      stream->status_ = s;
+      archive_set_error(arch, EIO, "%s", s.getMessage().c_str());
+      return -1;
+    }
+    return static_cast<la_ssize_t>(length);
+  }
+
+ private:
+  const ArchiveSink& sink_;
+  const bool compress_;
+  ZSTD_CStream* cstream_{nullptr};
+  std::vector<char> buffOut_;
+  Status status_;
+};
+
+} // namespace
+
 Status compress(const boost::filesystem::path& in,
                 const boost::filesystem::path& out) {
   PlatformFile inFile(in, PF_OPEN_EXISTING | PF_READ);
@@ -36,13 +187,8 @@ Status compress(const boost::filesystem::path& in,
   }
 
   auto inFileSize = inFile.size();
-  ZSTD_CStream* const cstream = ZSTD_createCStream();
+  ZSTD_CStream* const cstream = getCStream();
   if (cstream == nullptr) {
-    return Status(1, "Couldn't create compression stream");
-  }
-
-  size_t const initResult = ZSTD_initCStream(cstream, 1);
-  if (ZSTD_isError(initResult)) {
     return Status(1, "Couldn't initialize compression stream");
   }
 
@@ -60,7 +206,6 @@ Status compress(const boost::filesystem::path& in,
     }
     readSoFar += read;
     if (readSoFar > inFileSize) {
-      ZSTD_freeCStream(cstream);
       return Status(1, "File changed during compression");
     }
 
@@ -69,7 +214,6 @@ Status compress(const boost::filesystem::path& in,
       ZSTD_outBuffer output = {buffOut.data(), buffOutSize, 0};
       toRead = ZSTD_compressStream(cstream, &output, &input);
       if (ZSTD_isError(toRead)) {
-        ZSTD_freeCStream(cstream);
         return Status(1,
                       "ZSTD_compressStream() error : " +
                           std::string(ZSTD_getErrorName(toRead)));
@@ -86,14 +230,11 @@ Status compress(const boost::filesystem::path& in,
   size_t const remainingToFlush = ZSTD_endStream(cstream, &output);
 
   if (remainingToFlush) {
-    ZSTD_freeCStream(cstream);
     return Status(1, "Couldn't fully flush compressed file");
   }
 
   outFile.seek(0, PF_SEEK_END);
   outFile.write(buffOut.data(), output.pos);
-  ZSTD_freeCStream(cstream);
-
   return Status(0);
 }
 
@@ -117,17 +258,10 @@ Status decompress(const boost::filesystem::path& in,
   std::vector<void*> buffIn(buffInSize);
   std::vector<void*> buffOut(buffOutSize);
 
-  ZSTD_DStream* const dstream = ZSTD_createDStream();
-  if (dstream == NULL) {
-    return Status(1, "ZSTD_createDStream() error");
-  }
-
-  size_t const initResult = ZSTD_initDStream(dstream);
-  if (ZSTD_isError(initResult)) {
-    ZSTD_freeDStream(dstream);
-    return Status(1,
-                  "ZSTD_initDStream() error : " +
-                      std::string(ZSTD_getErrorName(initResult)));
+  size_t initResult = 0;
+  ZSTD_DStream* const dstream = getDStream(initResult);
+  if (dstream == nullptr) {
+    return Status(1, "ZSTD_initDStream() error");
   }
   auto read = initResult;
   auto toRead = initResult;
@@ -139,7 +273,6 @@ Status decompress(const boost::filesystem::path& in,
     }
     readSoFar += read;
     if (readSoFar > inFileSize) {
-      ZSTD_freeDStream(dstream);
       return Status(1, "File changed during decompression");
     }
 
@@ -148,7 +281,6 @@ Status decompress(const boost::filesystem::path& in,
       ZSTD_outBuffer output = {buffOut.data(), buffOutSize, 0};
       toRead = ZSTD_decompressStream(dstream, &output, &input);
       if (ZSTD_isError(toRead)) {
-        ZSTD_freeDStream(dstream);
         return Status(1,
                       "ZSTD_decompressStream() error : " +
                           std::string(ZSTD_getErrorName(toRead)));
@@ -157,47 +289,103 @@ Status decompress(const boost::filesystem::path& in,
       outFile.write(buffOut.data(), output.pos);
     }
   }
-  ZSTD_freeDStream(dstream);
   return Status(0);
 }
 
 Status archive(const std::set<boost::filesystem::path>& paths,
                const boost::filesystem::path& out,
                std::size_t block_size) {
+  PlatformFile outFile(out, PF_CREATE_ALWAYS | PF_WRITE);
+  if (!outFile.isValid()) {
+    return Status(1, "Failed to open tar archive for writing");
+  }
+
+  std::vector<ArchiveFile> files;
+  for (const auto& f : paths) {
+    PlatformFile pFile(f, PF_OPEN_EXISTING | PF_READ);
+    files.push_back({f, f.string(), pFile.size()});
+  }
+
+  return archive(
+      files,
+      [&outFile](const char* data, size_t size) {
+        auto written = outFile.write(data, size);
+        if (written < 0 || static_cast<size_t>(written) != size) {
+          return Status(1, "Failed to write tar archive");
+        }
+        return Status::success();
+      },
+      false,
+      block_size);
+}
+
+Status archive(const std::vector<ArchiveFile>& files,
+               const ArchiveSink& sink,
+               bool compress,
+               std::size_t block_size) {
+  ArchiveStream stream(sink, compress);
+  auto status = stream.open();
+  if (!status.ok()) {
+    return status;
+  }
+
   auto arch = archive_write_new();
   if (arch == nullptr) {
     return Status(1, "Failed to create tar archive");
   }
   archive_write_set_format_pax_restricted(arch);
-  auto ret = archive_write_open_filename(arch, out.string().c_str());
+  auto ret = archive_write_open(
+      arch, &stream, nullptr, &ArchiveStream::writeCallback, nullptr);
   if (ret == ARCHIVE_FATAL) {
     archive_write_free(arch);
     return Status(1, "Failed to open tar archive for writing");
   }
-  for (const auto& f : paths) {
-    PlatformFile pFile(f, PF_OPEN_EXISTING | PF_READ);
+
+  std::vector<char> block(block_size, 0);
+  for (const auto& file : files) {
+    PlatformFile pFile(file.path, PF_OPEN_EXISTING | PF_READ);
 
     auto entry = archive_entry_new();
-    archive_entry_set_pathname(entry, f.string().c_str());
-    archive_entry_set_size(entry, pFile.size());
+    archive_entry_set_pathname(entry, file.name.c_str());
+    archive_entry_set_size(entry, file.size);
     archive_entry_set_filetype(entry, AE_IFREG);
     archive_entry_set_perm(entry, 0644);
-    archive_write_header(arch, entry);
-
-    auto blkCount = static_cast<size_t>(ceil(static_cast<double>(pFile.size()) /
-                                             static_cast<double>(block_size)));
-    for (size_t i = 0; i < blkCount; i++) {
-      std::vector<char> block(block_size, 0);
-      auto r = pFile.read(block.data(), block_size);
-      if (r > 0 && static_cast<std::size_t>(r) != block_size) {
-        // resize the buffer to size we read as last block is likely smaller
-        block.resize(static_cast<std::size_t>(r));
+    ret = archive_write_header(arch, entry);
+    archive_entry_free(entry);
+    if (ret == ARCHIVE_FATAL) {
+      break;
+    }
+
+    // Content missing because the file shrank is zero-padded by libarchive.
+    auto remaining = file.size;
+    while (remaining > 0 && pFile.isValid()) {
+      auto r = pFile.read(block.data(),
+                          static_cast<size_t>(std::min<uint64_t>(
+                              remaining, static_cast<uint64_t>(block_size))));
+      if (r <= 0) {
+        break;
+      }
+      if (archive_write_data(arch, block.data(), static_cast<size_t>(r)) < 0) {
+        ret = ARCHIVE_FATAL;
+        break;
       }
-      archive_write_data(arch, block.data(), block.size());
+      remaining -= static_cast<uint64_t>(r);
+    }
+    if (ret == ARCHIVE_FATAL) {
+      break;
     }
-    archive_entry_free(entry);
+  }
+
+  if (ret != ARCHIVE_FATAL) {
+    ret = archive_write_close(arch);
   }
   archive_write_free(arch);
-  return Status::success();
-};
+
+  if (!stream.status().ok()) {
+    return stream.status();
+  } else if (ret == ARCHIVE_FATAL) {
+    return Status(1, "Failed to write tar archive");
+  }
+  return stream.finish();
+}
 } // namespace osquery
@@ -14,11 +14,21 @@
 #include <sys/stat.h>
 
 #ifndef WIN32
+#include <dirent.h>
 #include <glob.h>
 #include <pwd.h>
 #include <sys/time.h>
+#include <unistd.h>
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
@@ -45,12 +55,29 @@ namespace osquery {
 
 FLAG(uint64, read_max, 50 * 1024 * 1024, "Maximum file read size");
 
+FLAG(uint64,
+     stream_read_max,
+     0,
+     "Maximum file size read in blocks to hash or identify files, 0 to use "
+     "read_max");
+
+FLAG(uint64,
+     stream_read_rate,
+     0,
+     "Maximum bytes per second read in blocks to hash or identify files, 0 "
+     "for no limit");
+
 /// See reference #1382 for reasons why someone would allow unsafe.
 HIDDEN_FLAG(bool, allow_unsafe, false, "Allow unsafe executable permissions");
 
 /// Disable forensics (atime/mtime preserving) file reads.
 HIDDEN_FLAG(bool, disable_forensic, true, "Disable atime/mtime preservation");
 
+HIDDEN_FLAG(uint32,
+            glob_walk_threads,
+            4,
+            "Threads listing the directories of recursive file patterns");
+
 static const size_t kMaxRecursiveGlobs = 64;
 
 Status writeTextFile(const fs::path& path,
@@ -200,6 +227,63 @@ Status readFile(const fs::path& path,
   return Status::success();
 } // namespace osquery
 
+Status streamFile(const fs::path& path,
+                  size_t block_size,
+                  bool preserve_time,
+                  std::function<void(const char* buffer, size_t size)> predicate) {
+  // Streamed reads block, there is no pending IO to wait for.
+  OpenReadableFile handle(path, true);
+  if (handle.fd == nullptr || !handle.fd->isValid()) {
+    return Status::failure("Cannot open file for reading: " + path.string());
+  }
+
+  auto read_max = (FLAGS_stream_read_max > 0) ? FLAGS_stream_read_max
+                                               : FLAGS_read_max;
+  auto file_size = static_cast<uint64_t>(handle.fd->size());
+  if (!handle.fd->isSpecialFile() && file_size > read_max) {
+    return Status::failure("Cannot read " + path.string() +
+                           " size exceeds limit: " + std::to_string(file_size) +
+                           " > " + std::to_string(read_max));
+  }
+
+  PlatformTime times;
+  handle.fd->getFileTimes(times);
+
+  block_size = std::max<size_t>(block_size, 4096);
+  std::vector<char> buffer(block_size);
+  auto start = std::chrono::steady_clock::now();
+  uint64_t total_bytes = 0;
+  while (true) {
+    auto part_bytes = handle.fd->read(buffer.data(), block_size);
+    if (part_bytes < 0) {
+      return Status::failure("Cannot read file: " + path.string());
+    } else if (part_bytes == 0) {
+      break;
+    }
+
+    // Special files do not report their size.
+    total_bytes += static_cast<uint64_t>(part_bytes);
+    if (total_bytes > read_max) {
+      return Status::failure("File exceeds read limits");
+    }
+    predicate(buffer.data(), static_cast<size_t>(part_bytes));
+
+    if (FLAGS_stream_read_rate > 0) {
+      std::chrono::duration<double> due(static_cast<double>(total_bytes) /
+                                        FLAGS_stream_read_rate);
+      std::this_thread::sleep_until(
+          start +
+          std::chrono::duration_cast<std::chrono::steady_clock::duration>(due));
+    }
+  }
+
+  // Attempt to restore the atime and mtime before the file read.
+  if (preserve_time && !FLAGS_disable_forensic) {
+    handle.fd->setFileTimes(times);
+  }
+  return Status::success();
+}
+
 Status readFile(const fs::path& path,
                 std::string& content,
                 size_t size,
@@ -302,6 +386,17 @@ Status removePath(const fs::path& path) {
   return Status(0, std::to_string(removed_files));
 }
 
+/// Receives each path of a glob and its recursion level.
+using GlobLevelCallback =
+    std::function<bool(const std::string& path, size_t level)>;
+
+static bool matchesGlobLimits(const std::string& found, GlobLimits limits) {
+  auto folder = found.back() == '/' || found.back() == '\\';
+  return (folder && (limits & GLOB_FOLDERS)) ||
+         (!folder && (limits & GLOB_FILES));
+}
+
+#ifdef WIN32
 static bool checkForLoops(std::set<int>& dsym_inos, std::string path) {
   if (path.empty() || path.back() != '/') {
     return false;
@@ -326,12 +421,185 @@ static bool checkForLoops(std::set<int>& dsym_inos, std::string path) {
   }
   return false;
 }
+#else
+namespace {
+
+/**
+ * @brief Walks the directories below the first level of a recursive glob.
+ *
+ * Threads take directories from a shared queue and add the subdirectories
+ * they find, so one deep subtree does not leave the others waiting. The
+ * entries are listed as a '*' glob would: names starting with a '.' are
+ * skipped and symlinks to directories are followed.
+ */
+class GlobWalker : private boost::noncopyable {
+ public:
+  GlobWalker(GlobLimits limits, const GlobLevelCallback& callback)
+      : limits_(limits), callback_(callback) {}
+
+  /// Queue a directory path, ending with a '/', unless it was walked.
+  void add(const std::string& path, size_t level);
+
+  /// Walk the queued directories until none are left or the callback stops.
+  void run();
+
+  /// Pass a path to the callback, false if the walk stopped.
+  bool emit(const std::string& path, size_t level);
+
+ private:
+  void work();
+
+  void list(const std::string& path, size_t level);
+
+ private:
+  const GlobLimits limits_;
+  const GlobLevelCallback& callback_;
+
+  /// The directories to list, with their level.
+  std::vector<std::pair<std::string, size_t>> queue_;
+
+  /// Devices and inodes of the queued directories, symlinks may loop.
+  std::set<std::pair<dev_t, ino_t>> walked_;
+
+  /// Threads listing a directory, the walk ends with none and an empty queue.
+  size_t busy_{0};
+
+  std::atomic<bool> stopped_{false};
+
+  /// Protects the queue, walked_ and busy_.
+  std::mutex mutex_;
+  std::condition_variable changed_;
+
+  /// Callback calls are serialized.
+  std::mutex callback_mutex_;
+};
+
+void GlobWalker::add(const std::string& path, size_t level) {
+  struct stat st;
+  if (level >= kMaxRecursiveGlobs || ::stat(path.c_str(), &st) != 0) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!walked_.emplace(st.st_dev, st.st_ino).second) {
+      return;
+    }
+    queue_.emplace_back(path, level);
+  }
+  changed_.notify_one();
+}
+
+bool GlobWalker::emit(const std::string& path, size_t level) {
+  if (stopped_) {
+    return false;
+  }
+
+  if (matchesGlobLimits(path, limits_)) {
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    if (!stopped_ && !callback_(path, level)) {
+      stopped_ = true;
+    }
+  }
+  return !stopped_;
+}
+
+void GlobWalker::run() {
+  auto count = std::max<uint32_t>(FLAGS_glob_walk_threads, 1);
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < count; ++i) {
+    threads.emplace_back([this]() { work(); });
+  }
+  work();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+void GlobWalker::work() {
+  while (true) {
+    std::pair<std::string, size_t> directory;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      changed_.wait(lock, [this]() {
+        return !queue_.empty() || busy_ == 0 || stopped_;
+      });
+      if (queue_.empty() || stopped_) {
+        changed_.notify_all();
+        return;
+      }
+
+      // Depth first keeps the queue short on wide trees.
+      directory = std::move(queue_.back());
+      queue_.pop_back();
+      ++busy_;
+    }
+
+    list(directory.first, directory.second);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --busy_;
+    }
+    changed_.notify_all();
+  }
+}
+
+void GlobWalker::list(const std::string& path, size_t level) {
+  auto fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+
+  auto dir = ::fdopendir(fd);
+  if (dir == nullptr) {
+    ::close(fd);
+    return;
+  }
+
+  struct dirent* entry = nullptr;
+  while ((entry = ::readdir(dir)) != nullptr) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+
+    // Only symlinks, and file systems without entry types, need a stat.
+    auto directory = entry->d_type == DT_DIR;
+    if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) {
+      struct stat st;
+      directory = ::fstatat(fd, entry->d_name, &st, 0) == 0 &&
+                  S_ISDIR(st.st_mode);
+    }
+
+    auto found = path + entry->d_name;
+    if (directory) {
+      found += '/';
+    }
+    if (!emit(found, level + 1)) {
+      break;
+    }
+    if (directory) {
+      add(found, level + 1);
+    }
+  }
+  ::closedir(dir);
+}
+
+} // namespace
+#endif
 
 static void genGlobs(std::string path,
-                     std::vector<std::string>& results,
-                     GlobLimits limits) {
+                     GlobLimits limits,
+                     const GlobLevelCallback& callback) {
   // Use our helped escape/replace for wildcards.
   replaceGlobWildcards(path, limits);
+
+  // The end state is a non-recursive ending or empty set of matches.
+  size_t wild = path.rfind("**");
+  // Allow a trailing slash after the double wild indicator.
+  auto recursive = wild <= path.size() && wild + 3 >= path.size();
+
+#ifdef WIN32
   // inodes of directory symlinks for loop detection
   std::set<int> dsym_inos;
 
@@ -340,35 +608,53 @@ static void genGlobs(std::string path,
     auto glob_results = platformGlob(path);
 
     for (auto& result_path : glob_results) {
-      results.push_back(result_path);
+      if (matchesGlobLimits(result_path, limits) &&
+          !callback(result_path, glob_index)) {
+        return;
+      }
 
       if (checkForLoops(dsym_inos, result_path)) {
         glob_index = kMaxRecursiveGlobs;
       }
     }
 
-    // The end state is a non-recursive ending or empty set of matches.
-    size_t wild = path.rfind("**");
-    // Allow a trailing slash after the double wild indicator.
-    if (glob_results.size() == 0 || wild > path.size() ||
-        wild + 3 < path.size()) {
+    if (glob_results.size() == 0 || !recursive) {
       break;
     }
 
     path += "/**";
   }
+#else
+  // Only the first level is a glob, the levels below list every entry.
+  GlobWalker walker(limits, callback);
+  for (const auto& result_path : platformGlob(path)) {
+    if (!walker.emit(result_path, 1)) {
+      return;
+    }
 
-  // Prune results based on settings/requested glob limitations.
-  auto end = std::remove_if(
-      results.begin(), results.end(), [limits](const std::string& found) {
-        return !(((found[found.length() - 1] == '/' ||
-                   found[found.length() - 1] == '\\') &&
-                  limits & GLOB_FOLDERS) ||
-                 ((found[found.length() - 1] != '/' &&
-                   found[found.length() - 1] != '\\') &&
-                  limits & GLOB_FILES));
-      });
-  results.erase(end, results.end());
+    if (recursive && result_path.back() == '/') {
+      walker.add(result_path, 1);
+    }
+  }
+  walker.run();
+#endif
+}
+
+static void genGlobs(const std::string& path,
+                     std::vector<std::string>& results,
+                     GlobLimits limits) {
+  // Order the paths by level, then name, as a glob per level would.
+  std::vector<std::pair<size_t, std::string>> found;
+  genGlobs(path, limits, [&found](const std::string& result, size_t level) {
+    found.emplace_back(level, result);
+    return true;
+  });
+
+  std::sort(found.begin(), found.end());
+  results.reserve(results.size() + found.size());
+  for (auto& result : found) {
+    results.push_back(std::move(result.second));
+  }
 }
 
 Status resolveFilePattern(const fs::path& fs_path,
@@ -383,6 +669,17 @@ Status resolveFilePattern(const fs::path& fs_path,
   return Status::success();
 }
 
+Status resolveFilePattern(const fs::path& fs_path,
+                          const GlobCallback& callback,
+                          GlobLimits setting) {
+  genGlobs(fs_path.string(),
+           setting,
+           [&callback](const std::string& result, size_t /* level */) {
+             return callback(result);
+           });
+  return Status::success();
+}
+
 inline void replaceGlobWildcards(std::string& pattern, GlobLimits limits) {
   // Replace SQL-wildcard '%' with globbing wildcard '*'.
   if (pattern.find('%') != std::string::npos) {
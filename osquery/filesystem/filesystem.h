@@ -11,6 +11,7 @@
 
 #include <osquery/filesystem/fileops.h>
 
+#include <functional>
 #include <map>
 #include <set>
 #include <string>
@@ -94,6 +95,24 @@ Status readFile(const boost::filesystem::path& path,
                 bool blocking = false,
                 bool log = true);
 
+/**
+ * @brief Read a file in blocks, in constant memory.
+ *
+ * Unlike readFile the content is never held whole, one buffer of block_size
+ * bytes is reused. The size of the file is limited by stream_read_max
+ * instead of read_max, and reads are throttled to stream_read_rate bytes
+ * per second.
+ *
+ * @param path the path of the file that you would like to read.
+ * @param block_size the number of bytes read at once.
+ * @param preserve_time Attempt to preserve file mtime and atime.
+ * @param predicate called with each block read, in order.
+ */
+Status streamFile(const boost::filesystem::path& path,
+                  size_t block_size,
+                  bool preserve_time,
+                  std::function<void(const char* buffer, size_t size)> predicate);
+
 /**
  * @brief Write text to disk.
  *
@@ -208,6 +227,27 @@ Status resolveFilePattern(const boost::filesystem::path& pattern,
                           std::vector<std::string>& results,
                           GlobLimits setting);
 
+/// Receives each path matching a pattern, returns false to stop the search.
+using GlobCallback = std::function<bool(const std::string& path)>;
+
+/**
+ * @brief Given a filesystem globbing patten, stream the matching paths.
+ *
+ * Unlike the vector variants, paths are passed as soon as they are found, in
+ * no particular order, and the search of a large tree can stop early. The
+ * directories below a recursive pattern are listed by several threads, but
+ * the callback is only called by one at a time.
+ *
+ * @param pattern filesystem globbing pattern.
+ * @param callback called with each matching path.
+ * @param setting a bit list of match types, e.g., files, folders.
+ *
+ * @return an instance of Status, indicating success or failure.
+ */
+Status resolveFilePattern(const boost::filesystem::path& pattern,
+                          const GlobCallback& callback,
+                          GlobLimits setting = GLOB_ALL);
+
 /**
  * @brief Transform a path with SQL wildcards to globbing wildcard.
  *
@@ -378,6 +418,39 @@ Status readRawMem(size_t base, size_t length, void** buffer);
 Status archive(const std::set<boost::filesystem::path>& path,
                const boost::filesystem::path& out, std::size_t block_size = 8192);
 
+/// Receives the bytes of a streamed archive, in order.
+using ArchiveSink = std::function<Status(const char* data, size_t size)>;
+
+/// A file to add to a streamed archive.
+struct ArchiveFile {
+  /// The file to read.
+  boost::filesystem::path path;
+
+  /// The name of the archive entry.
+  std::string name;
+
+  /// The entry size, the content is truncated or zero-padded to this size.
+  uint64_t size{0};
+};
+
+/*
+ * @brief Stream files as a tar archive to a sink, without temporary files.
+ *
+ * Each file is read block by block, the archive is optionally compressed with
+ * zstd, the same way as compress, before it is given to the sink. Only a few
+ * blocks are buffered at once.
+ *
+ * @param files The files to bundle, in order
+ * @param sink Receives the archive
+ * @param compress True to compress the archive with zstd
+ * @param block_size The size of the blocks read from the files
+ * @return A failure if the sink failed or the archive could not be written
+ */
+Status archive(const std::vector<ArchiveFile>& files,
+               const ArchiveSink& sink,
+               bool compress,
+               std::size_t block_size = 8192);
+
 /*
  * @brief Given a path, compress it with zstd and save to out.
  *
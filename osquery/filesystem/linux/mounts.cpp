@@ -10,11 +10,24 @@
 #include <mntent.h>
 #include <sys/vfs.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include <osquery/core/flags.h>
 #include <osquery/filesystem/linux/mounts.h>
 #include <osquery/logger/logger.h>
 #include <osquery/utils/system/filepath.h>
 
 namespace osquery {
+
+FLAG(uint64,
+     mounts_statfs_timeout,
+     1000,
+     "Milliseconds to wait for the statfs of every mount (0 = no limit)");
+
 namespace {
 const std::string kMountsPseudoFile{"/proc/mounts"};
 
@@ -42,9 +55,177 @@ Status getMountData(MountData& obj) {
   obj.reset(mount_data);
   return Status::success();
 }
+
+/// The most threads running statfs for a list of mounts.
+const size_t kStatfsThreads{8};
+
+/// A mount whose statfs timed out is not queried again for this long.
+const std::chrono::minutes kStatfsBackoff{5};
+
+/// The statfs calls of a list of mounts, shared with the helper threads.
+struct StatfsJob final {
+  std::mutex mutex;
+  std::condition_variable done_cv;
+
+  std::vector<std::string> paths;
+  std::vector<boost::optional<MountInformation::StatFsInfo>> results;
+  std::vector<int> errors;
+  std::vector<bool> started;
+  std::vector<bool> finished;
+
+  /// The next path to call statfs on, helpers stop at the end of the paths.
+  size_t next{0};
+  size_t pending{0};
+};
+
+/// A mount that did not answer statfs in time.
+struct UnresponsiveMount final {
+  std::chrono::steady_clock::time_point since;
+
+  /// A helper thread is still waiting for the mount.
+  bool waiting{true};
+};
+
+std::mutex kUnresponsiveMountsMutex;
+std::map<std::string, UnresponsiveMount> kUnresponsiveMounts;
+
+/// Check if a mount timed out recently or still has a statfs waiting.
+bool isUnresponsiveMount(const std::string& path) {
+  std::lock_guard<std::mutex> lock(kUnresponsiveMountsMutex);
+  auto it = kUnresponsiveMounts.find(path);
+  if (it == kUnresponsiveMounts.end()) {
+    return false;
+  }
+
+  if (it->second.waiting ||
+      std::chrono::steady_clock::now() - it->second.since < kStatfsBackoff) {
+    return true;
+  }
+  kUnresponsiveMounts.erase(it);
+  return false;
+}
+
+void runStatfsJob(std::shared_ptr<StatfsJob> job) {
+  std::unique_lock<std::mutex> lock(job->mutex);
+  while (job->next < job->paths.size()) {
+    auto index = job->next++;
+    job->started[index] = true;
+    auto path = job->paths[index];
+    lock.unlock();
+
+    struct statfs stats = {};
+    boost::optional<MountInformation::StatFsInfo> result;
+    int error = 0;
+    if (statfs(path.c_str(), &stats) == 0) {
+      MountInformation::StatFsInfo statfs_info = {};
+
+      statfs_info.block_size = static_cast<std::uint32_t>(stats.f_bsize);
+      statfs_info.block_count = static_cast<std::uint32_t>(stats.f_blocks);
+      statfs_info.free_block_count = static_cast<std::uint32_t>(stats.f_bfree);
+
+      statfs_info.unprivileged_free_block_count =
+          static_cast<std::uint32_t>(stats.f_bavail);
+
+      statfs_info.inode_count = static_cast<std::uint32_t>(stats.f_files);
+      statfs_info.free_inode_count = static_cast<std::uint32_t>(stats.f_ffree);
+      result = std::move(statfs_info);
+    } else {
+      error = errno;
+    }
+
+    lock.lock();
+    job->results[index] = std::move(result);
+    job->errors[index] = error;
+    job->finished[index] = true;
+    job->pending--;
+    job->done_cv.notify_all();
+
+    // A late answer lets the mount be queried once its backoff ends. The
+    // job lock is held so the timeout cannot mark the mount afterwards.
+    std::lock_guard<std::mutex> unresponsive_lock(kUnresponsiveMountsMutex);
+    auto it = kUnresponsiveMounts.find(path);
+    if (it != kUnresponsiveMounts.end()) {
+      it->second.waiting = false;
+    }
+  }
+}
+
+/**
+ * @brief Call statfs on the mounts using helper threads.
+ *
+ * A statfs on a hung network or FUSE mount may never return, so the calls
+ * are bounded by mounts_statfs_timeout. The mounts still waiting then have no
+ * statfs information, and are skipped for a backoff period. Their helper
+ * threads are detached and exit when statfs returns.
+ */
+void statMountedFilesystems(MountedFilesystems& mounted_fs_info) {
+  auto job = std::make_shared<StatfsJob>();
+  std::vector<size_t> indexes;
+  for (size_t i = 0; i < mounted_fs_info.size(); ++i) {
+    const auto& mount_info = mounted_fs_info[i];
+    if (mount_info.type == "autofs") {
+      VLOG(1) << "Skipping statfs information for autofs mount: "
+              << mount_info.path;
+    } else if (isUnresponsiveMount(mount_info.path)) {
+      VLOG(1) << "Skipping statfs information for unresponsive mount: "
+              << mount_info.path;
+    } else {
+      job->paths.push_back(mount_info.path);
+      indexes.push_back(i);
+    }
+  }
+
+  if (job->paths.empty()) {
+    return;
+  }
+
+  job->results.resize(job->paths.size());
+  job->errors.resize(job->paths.size(), 0);
+  job->started.resize(job->paths.size(), false);
+  job->finished.resize(job->paths.size(), false);
+  job->pending = job->paths.size();
+
+  auto threads = std::min(kStatfsThreads, job->paths.size());
+  for (size_t i = 0; i < threads; ++i) {
+    std::thread(runStatfsJob, job).detach();
+  }
+
+  std::unique_lock<std::mutex> lock(job->mutex);
+  auto finished = [&job]() { return job->pending == 0; };
+  if (FLAGS_mounts_statfs_timeout == 0) {
+    job->done_cv.wait(lock, finished);
+  } else {
+    job->done_cv.wait_for(
+        lock, std::chrono::milliseconds(FLAGS_mounts_statfs_timeout), finished);
+  }
+
+  // Helpers still waiting for a mount take no further paths.
+  job->next = job->paths.size();
+  for (size_t i = 0; i < job->paths.size(); ++i) {
+    auto& mount_info = mounted_fs_info[indexes[i]];
+    if (job->finished[i]) {
+      if (job->results[i]) {
+        mount_info.optional_statfs_info = job->results[i];
+      } else {
+        LOG(ERROR) << "statfs failed with errno "
+                   << std::to_string(job->errors[i]) << " on path "
+                   << mount_info.path;
+      }
+    } else if (job->started[i]) {
+      LOG(WARNING) << "statfs timed out on path " << mount_info.path
+                   << ", skipping the mount for "
+                   << std::to_string(kStatfsBackoff.count()) << " minutes";
+
+      std::lock_guard<std::mutex> unresponsive_lock(kUnresponsiveMountsMutex);
+      kUnresponsiveMounts[mount_info.path] = {std::chrono::steady_clock::now(),
+                                              true};
+    }
+  }
+}
 } // namespace
 
-Status getMountedFilesystems(MountedFilesystems& mounted_fs_info) {
+Status getMountedFilesystems(MountedFilesystems& mounted_fs_info,
+                             bool with_statfs) {
   mounted_fs_info = {};
 
   MountData mount_data;
@@ -75,40 +256,13 @@ Status getMountedFilesystems(MountedFilesystems& mounted_fs_info) {
     mount_info.path = ent.mnt_dir;
     mount_info.flags = ent.mnt_opts;
 
-    if (mount_info.type == "autofs") {
-      VLOG(1) << "Skipping statfs information for autofs mount: "
-              << mount_info.path;
-
-    } else {
-      struct statfs stats = {};
-      if (statfs(mount_info.path.c_str(), &stats) == 0) {
-        MountInformation::StatFsInfo statfs_info = {};
-
-        statfs_info.block_size = static_cast<std::uint32_t>(stats.f_bsize);
-        statfs_info.block_count = static_cast<std::uint32_t>(stats.f_blocks);
-
-        statfs_info.free_block_count =
-            static_cast<std::uint32_t>(stats.f_bfree);
-
-        statfs_info.unprivileged_free_block_count =
-            static_cast<std::uint32_t>(stats.f_bavail);
-
-        statfs_info.inode_count = static_cast<std::uint32_t>(stats.f_files);
-
-        statfs_info.free_inode_count =
-            static_cast<std::uint32_t>(stats.f_ffree);
-
-        mount_info.optional_statfs_info = std::move(statfs_info);
-
-      } else {
-        LOG(ERROR) << "statfs failed with errno " << std::to_string(errno)
-                   << " on path " << mount_info.path;
-      }
-    }
-
     mounted_fs_info.emplace_back(std::move(mount_info));
   }
 
+  if (with_statfs) {
+    statMountedFilesystems(mounted_fs_info);
+  }
+
   return Status::success();
 }
 } // namespace osquery
@@ -59,5 +59,8 @@ struct MountInformation final {
 // Information about all mounted filesystems
 using MountedFilesystems = std::vector<MountInformation>;
 
-Status getMountedFilesystems(MountedFilesystems& mounted_fs_info);
+// List the mounted filesystems, with statfs information if with_statfs
+// is set; mounts that do not answer statfs in time have none
+Status getMountedFilesystems(MountedFilesystems& mounted_fs_info,
+                             bool with_statfs = true);
 } // namespace osquery
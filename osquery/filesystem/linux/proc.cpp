@@ -7,59 +7,218 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <dirent.h>
+#include <fcntl.h>
 #include <linux/limits.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include <boost/filesystem.hpp>
 
+#include <osquery/core/flags.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/filesystem/linux/proc.h>
 #include <osquery/logger/logger.h>
 #include <osquery/utils/conversions/split.h>
 
 namespace osquery {
+
+DECLARE_uint64(read_max);
+
 const std::vector<std::string> kUserNamespaceList = {
     "cgroup", "ipc", "mnt", "net", "pid", "user", "uts"};
 
 constexpr std::uint64_t kStatmElementsCount = 7;
 constexpr std::uint64_t kMemoryPageSize = 4096;
 
-Status procGetNamespaceInode(ino_t& inode,
-                             const std::string& namespace_name,
-                             const std::string& process_namespace_root) {
-  inode = 0;
+/// Size of the reusable buffer of a ProcReader, most attributes fit.
+const size_t kProcReadBufferSize = 16 * 1024;
 
-  auto path = process_namespace_root + "/" + namespace_name;
+ProcReader::ProcReader() : buffer_(kProcReadBufferSize) {
+  proc_fd_ = ::open(
+      kLinuxProcPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
 
-  char link_destination[PATH_MAX] = {};
-  auto link_dest_length = readlink(path.data(), link_destination, PATH_MAX - 1);
-  if (link_dest_length < 0) {
-    return Status(1, "Failed to retrieve the inode for namespace " + path);
+ProcReader::~ProcReader() {
+  closeProcess();
+  if (proc_fd_ >= 0) {
+    ::close(proc_fd_);
+  }
+}
+
+void ProcReader::closeProcess() {
+  if (process_fd_ >= 0) {
+    ::close(process_fd_);
+    process_fd_ = -1;
   }
+}
+
+Status ProcReader::setProcess(const std::string& pid) {
+  closeProcess();
+  if (proc_fd_ < 0) {
+    return Status::failure("Cannot open " + kLinuxProcPath);
+  }
+
+  process_fd_ =
+      ::openat(proc_fd_, pid.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (process_fd_ < 0) {
+    return Status::failure("Cannot open process " + pid);
+  }
+  return Status::success();
+}
+
+Status ProcReader::read(const std::string& attr, std::string& content) {
+  std::string_view view;
+  auto status = read(attr, view);
+  content.assign(view.data(), view.size());
+  return status;
+}
+
+Status ProcReader::read(const std::string& attr, std::string_view& content) {
+  content = std::string_view();
+  if (process_fd_ < 0) {
+    return Status::failure("No process is selected");
+  }
+
+  auto fd = ::openat(process_fd_, attr.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return Status::failure("Cannot open process attribute " + attr);
+  }
+
+  // Attributes report a size of 0, they are read until the end.
+  size_t size = 0;
+  while (true) {
+    if (size == buffer_.size()) {
+      if (buffer_.size() >= FLAGS_read_max) {
+        ::close(fd);
+        return Status::failure("Process attribute " + attr +
+                               " exceeds read limits");
+      }
+      buffer_.resize(buffer_.size() * 2);
+    }
+
+    auto bytes = ::read(fd, buffer_.data() + size, buffer_.size() - size);
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    } else if (bytes < 0) {
+      ::close(fd);
+      return Status::failure("Cannot read process attribute " + attr);
+    } else if (bytes == 0) {
+      break;
+    }
+    size += static_cast<size_t>(bytes);
+  }
+
+  ::close(fd);
+  content = std::string_view(buffer_.data(), size);
+  return Status::success();
+}
+
+Status ProcReader::readLink(const std::string& attr, std::string& target) {
+  target.clear();
+  if (process_fd_ < 0) {
+    return Status::failure("No process is selected");
+  }
+
+  char destination[PATH_MAX] = {};
+  auto length =
+      ::readlinkat(process_fd_, attr.c_str(), destination, sizeof(destination));
+  if (length <= 0) {
+    return Status::failure("Cannot read process link " + attr);
+  }
+
+  target.assign(destination, static_cast<size_t>(length));
+  return Status::success();
+}
+
+Status ProcReader::readDescriptors(
+    std::map<std::string, std::string>& descriptors) {
+  if (process_fd_ < 0) {
+    return Status::failure("No process is selected");
+  }
+
+  auto fd = ::openat(process_fd_, "fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    return Status::failure("Cannot open the process descriptors");
+  }
+
+  auto dir = ::fdopendir(fd);
+  if (dir == nullptr) {
+    ::close(fd);
+    return Status::failure("Cannot list the process descriptors");
+  }
+
+  char destination[PATH_MAX] = {};
+  struct dirent* entry = nullptr;
+  while ((entry = ::readdir(dir)) != nullptr) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+
+    // The descriptor may be closed before it is read.
+    auto length = ::readlinkat(
+        ::dirfd(dir), entry->d_name, destination, sizeof(destination));
+    if (length > 0) {
+      descriptors[entry->d_name].assign(destination,
+                                        static_cast<size_t>(length));
+    }
+  }
+  ::closedir(dir);
+  return Status::success();
+}
 
-  // The link destination must be in the following form: namespace:[inode]
-  if (std::strncmp(link_destination,
-                   namespace_name.data(),
-                   namespace_name.size()) != 0 ||
-      std::strncmp(link_destination + namespace_name.size(), ":[", 2) != 0) {
-    return Status(1, "Invalid descriptor for namespace " + path);
+/// Parse the inode of a namespace link, in the form namespace:[inode].
+Status procParseNamespaceLink(ino_t& inode,
+                              const std::string& namespace_name,
+                              const std::string& link_destination) {
+  inode = 0;
+  if (link_destination.compare(
+          0, namespace_name.size(), namespace_name) != 0 ||
+      link_destination.compare(namespace_name.size(), 2, ":[") != 0) {
+    return Status(1, "Invalid descriptor for namespace " + namespace_name);
   }
 
   // Parse the inode part of the string; strtoull should return us a pointer
   // to the closing square bracket
-  const char* inode_string_ptr = link_destination + namespace_name.size() + 2;
+  const char* inode_string_ptr =
+      link_destination.c_str() + namespace_name.size() + 2;
   char* square_bracket_ptr = nullptr;
 
   inode = static_cast<ino_t>(
       std::strtoull(inode_string_ptr, &square_bracket_ptr, 10));
   if (inode == 0 || square_bracket_ptr == nullptr ||
       *square_bracket_ptr != ']') {
-    return Status(1, "Invalid inode value in descriptor for namespace " + path);
+    return Status(1,
+                  "Invalid inode value in descriptor for namespace " +
+                      namespace_name);
   }
 
   return Status::success();
 }
 
+Status procGetNamespaceInode(ino_t& inode,
+                             const std::string& namespace_name,
+                             const std::string& process_namespace_root) {
+  inode = 0;
+
+  auto path = process_namespace_root + "/" + namespace_name;
+
+  char link_destination[PATH_MAX] = {};
+  auto link_dest_length = readlink(path.data(), link_destination, PATH_MAX - 1);
+  if (link_dest_length < 0) {
+    return Status(1, "Failed to retrieve the inode for namespace " + path);
+  }
+
+  return procParseNamespaceLink(inode, namespace_name, link_destination);
+}
+
 Status procGetProcessNamespaces(const std::string& process_id,
                                 ProcessNamespaceList& namespace_list,
                                 std::vector<std::string> namespaces) {
@@ -85,6 +244,31 @@ Status procGetProcessNamespaces(const std::string& process_id,
   return Status::success();
 }
 
+Status procGetProcessNamespaces(ProcReader& reader,
+                                ProcessNamespaceList& namespace_list,
+                                std::vector<std::string> namespaces) {
+  namespace_list.clear();
+
+  if (namespaces.empty()) {
+    namespaces = kUserNamespaceList;
+  }
+
+  std::string link_destination;
+  for (const auto& namespace_name : namespaces) {
+    ino_t namespace_inode;
+    if (!reader.readLink("ns/" + namespace_name, link_destination).ok() ||
+        !procParseNamespaceLink(
+             namespace_inode, namespace_name, link_destination)
+             .ok()) {
+      continue;
+    }
+
+    namespace_list[namespace_name] = namespace_inode;
+  }
+
+  return Status::success();
+}
+
 std::string procDecodeAddressFromHex(const std::string& encoded_address,
                                      int family) {
   char addr_buffer[INET6_ADDRSTRLEN] = {0};
@@ -360,6 +544,109 @@ Status procGetSocketInodeToProcessInfoMap(const std::string& pid,
       pid, result, callback);
 }
 
+namespace {
+
+/// Threads reading the descriptors of a snapshot.
+const size_t kDescriptorSnapshotThreads{4};
+
+/// Processes a thread reads at once.
+const size_t kDescriptorSnapshotChunk{64};
+
+std::mutex kDescriptorSnapshotMutex;
+std::uint64_t kDescriptorSnapshotStep{0};
+std::shared_ptr<const ProcessDescriptorSnapshot> kDescriptorSnapshot;
+
+/// Read the descriptors of every process on several threads.
+std::shared_ptr<ProcessDescriptorSnapshot> readDescriptorSnapshot() {
+  std::set<std::string> pid_set;
+  procProcesses(pid_set);
+  const std::vector<std::string> pids(pid_set.begin(), pid_set.end());
+
+  std::vector<std::map<std::string, std::string>> descriptors(pids.size());
+  std::vector<char> read(pids.size(), 0);
+  std::atomic<size_t> next{0};
+  auto worker = [&pids, &descriptors, &read, &next]() {
+    ProcReader reader;
+    for (auto start = next.fetch_add(kDescriptorSnapshotChunk);
+         start < pids.size();
+         start = next.fetch_add(kDescriptorSnapshotChunk)) {
+      auto end = std::min(pids.size(), start + kDescriptorSnapshotChunk);
+      for (auto i = start; i < end; ++i) {
+        if (reader.setProcess(pids[i]).ok() &&
+            reader.readDescriptors(descriptors[i]).ok()) {
+          read[i] = 1;
+        }
+      }
+    }
+  };
+
+  auto chunks =
+      (pids.size() + kDescriptorSnapshotChunk - 1) / kDescriptorSnapshotChunk;
+  auto count = std::min(
+      {chunks,
+       kDescriptorSnapshotThreads,
+       std::max<size_t>(1, std::thread::hardware_concurrency())});
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < count; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // The sockets of shared descriptors belong to the last process, in order.
+  auto snapshot = std::make_shared<ProcessDescriptorSnapshot>();
+  for (size_t i = 0; i < pids.size(); ++i) {
+    if (read[i] == 0) {
+      continue;
+    }
+
+    for (const auto& descriptor : descriptors[i]) {
+      const auto& link = descriptor.second;
+      if (link.find("socket:[") == 0) {
+        snapshot->sockets[link.substr(8, link.size() - 9)] = {
+            pids[i], descriptor.first};
+      }
+    }
+    snapshot->descriptors.emplace(pids[i], std::move(descriptors[i]));
+  }
+  return snapshot;
+}
+
+} // namespace
+
+std::shared_ptr<const ProcessDescriptorSnapshot> procGetDescriptorSnapshot(
+    std::uint64_t step) {
+  if (step == 0) {
+    // A snapshot read outside of the schedule is not shared.
+    return readDescriptorSnapshot();
+  }
+
+  // The queries of a step wait for the first one to read the snapshot.
+  std::lock_guard<std::mutex> lock(kDescriptorSnapshotMutex);
+  if (step != kDescriptorSnapshotStep || kDescriptorSnapshot == nullptr) {
+    kDescriptorSnapshot = readDescriptorSnapshot();
+    kDescriptorSnapshotStep = step;
+  }
+  return kDescriptorSnapshot;
+}
+
+std::shared_ptr<const ProcessDescriptorSnapshot> procPeekDescriptorSnapshot(
+    std::uint64_t step) {
+  std::lock_guard<std::mutex> lock(kDescriptorSnapshotMutex);
+  if (step == 0 || step != kDescriptorSnapshotStep) {
+    return nullptr;
+  }
+  return kDescriptorSnapshot;
+}
+
+void procReleaseDescriptorSnapshot() {
+  std::lock_guard<std::mutex> lock(kDescriptorSnapshotMutex);
+  kDescriptorSnapshot = nullptr;
+  kDescriptorSnapshotStep = 0;
+}
+
 Status procProcesses(std::set<std::string>& processes) {
   auto callback = [](const std::string& pid,
                      std::set<std::string>& _processes) -> bool {
@@ -9,6 +9,8 @@
 
 #pragma once
 
+#include <memory>
+#include <string_view>
 #include <unordered_map>
 
 #include <arpa/inet.h>
@@ -16,6 +18,7 @@
 #include <unistd.h>
 
 #include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
 
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
@@ -84,11 +87,65 @@ const std::vector<std::string> tcp_states = {"UNKNOWN",
 
 using ProcessNamespaceList = std::map<std::string, ino_t>;
 
+/**
+ * @brief Read the small files of processes with few syscalls.
+ *
+ * readFile resolves the whole path, stats and reads a file in several calls,
+ * and allocates a buffer for each file. A reader keeps a /proc descriptor,
+ * opens the directory of a process once, and reads each attribute with one
+ * openat and as few reads as its size needs, into a buffer reused across
+ * files and processes.
+ */
+class ProcReader : private boost::noncopyable {
+ public:
+  ProcReader();
+  ~ProcReader();
+
+  /// Select the process of the next reads, fails if it exited.
+  Status setProcess(const std::string& pid);
+
+  /// Read an attribute file of the process, such as "stat".
+  Status read(const std::string& attr, std::string& content);
+
+  /**
+   * @brief Read an attribute file of the process without copying it.
+   *
+   * The content points into the buffer of the reader, it is valid until the
+   * next read.
+   */
+  Status read(const std::string& attr, std::string_view& content);
+
+  /// Read the target of an attribute link of the process, such as "exe".
+  Status readLink(const std::string& attr, std::string& target);
+
+  /// Read the targets of the open descriptors of the process, by number.
+  Status readDescriptors(std::map<std::string, std::string>& descriptors);
+
+ private:
+  void closeProcess();
+
+ private:
+  /// The /proc directory.
+  int proc_fd_{-1};
+
+  /// The directory of the selected process.
+  int process_fd_{-1};
+
+  /// Reused by every read, grown to the largest attribute.
+  std::vector<char> buffer_;
+};
+
 Status procGetProcessNamespaces(
     const std::string& process_id,
     ProcessNamespaceList& namespace_list,
     std::vector<std::string> namespaces = std::vector<std::string>());
 
+/// See procGetProcessNamespaces, the process is the one selected in reader.
+Status procGetProcessNamespaces(
+    ProcReader& reader,
+    ProcessNamespaceList& namespace_list,
+    std::vector<std::string> namespaces = std::vector<std::string>());
+
 Status procReadDescriptor(const std::string& process,
                           const std::string& descriptor,
                           std::string& result);
@@ -164,6 +221,40 @@ Status procGetSocketList(int family,
 Status procGetSocketInodeToProcessInfoMap(const std::string& pid,
                                           SocketInodeToProcessInfoMap& result);
 
+/// The open descriptors of every process.
+struct ProcessDescriptorSnapshot final {
+  /// The descriptor targets by process, then by descriptor number.
+  std::map<std::string, std::map<std::string, std::string>> descriptors;
+
+  /// The process owning each socket, by socket inode.
+  SocketInodeToProcessInfoMap sockets;
+};
+
+/**
+ * @brief Read the open descriptors of every process.
+ *
+ * process_open_sockets, listening_ports, process_open_files and
+ * process_open_pipes each walk the descriptors of every process. The queries
+ * of a schedule step share one walk, read on several threads by the first
+ * query that needs it.
+ *
+ * @param step The schedule step of the query, 0 reads a new snapshot.
+ */
+std::shared_ptr<const ProcessDescriptorSnapshot> procGetDescriptorSnapshot(
+    std::uint64_t step);
+
+/**
+ * @brief Get the snapshot of a step only if a query already read it.
+ *
+ * A query needing the descriptors of a few sockets reads them itself unless
+ * the snapshot is already shared.
+ */
+std::shared_ptr<const ProcessDescriptorSnapshot> procPeekDescriptorSnapshot(
+    std::uint64_t step);
+
+/// Drop the snapshot of the step, the scheduler calls it when a step ends.
+void procReleaseDescriptorSnapshot();
+
 /**
  * @brief Enumerate all pids in the system by listing pid numbers under /proc
  * and execute a callback for each one of them. The callback will receive the
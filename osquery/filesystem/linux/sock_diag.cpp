@@ -0,0 +1,271 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <arpa/inet.h>
+#include <linux/inet_diag.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sock_diag.h>
+#include <linux/unix_diag.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+#include <osquery/filesystem/linux/sock_diag.h>
+
+namespace osquery {
+
+namespace {
+
+/// Size of the buffer receiving the dump messages.
+const size_t kSockDiagBufferSize{64 * 1024};
+
+/// Closes a netlink socket when a dump returns.
+class NetlinkSocket final {
+ public:
+  NetlinkSocket()
+      : fd_(::socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG)) {
+  }
+
+  ~NetlinkSocket() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+
+  int fd() const {
+    return fd_;
+  }
+
+ private:
+  int fd_{-1};
+};
+
+/**
+ * @brief Send a dump request and parse each message of the reply.
+ *
+ * @param request The request, starting with its netlink header.
+ * @param size The size of the request.
+ * @param parse Called with each socket message.
+ */
+Status sockDiagDump(void* request,
+                    size_t size,
+                    const std::function<void(const nlmsghdr*)>& parse) {
+  NetlinkSocket sock;
+  if (sock.fd() < 0) {
+    return Status::failure("Cannot open a sock_diag netlink socket");
+  }
+
+  sockaddr_nl address{};
+  address.nl_family = AF_NETLINK;
+  iovec iov{request, size};
+  msghdr message{};
+  message.msg_name = &address;
+  message.msg_namelen = sizeof(address);
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+
+  ssize_t sent = 0;
+  do {
+    sent = ::sendmsg(sock.fd(), &message, 0);
+  } while (sent < 0 && errno == EINTR);
+  if (sent < 0) {
+    return Status::failure("Cannot send the sock_diag request");
+  }
+
+  // The messages are aligned for their headers.
+  std::vector<nlmsghdr> buffer(kSockDiagBufferSize / sizeof(nlmsghdr));
+  while (true) {
+    auto bytes = ::recv(sock.fd(), buffer.data(), kSockDiagBufferSize, 0);
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    } else if (bytes <= 0) {
+      return Status::failure("Cannot read the sock_diag reply");
+    }
+
+    auto length = static_cast<unsigned int>(bytes);
+    for (auto header = buffer.data(); NLMSG_OK(header, length);
+         header = NLMSG_NEXT(header, length)) {
+      if (header->nlmsg_type == NLMSG_DONE) {
+        return Status::success();
+      } else if (header->nlmsg_type == NLMSG_ERROR) {
+        auto error = static_cast<const nlmsgerr*>(NLMSG_DATA(header));
+        return Status::failure("The sock_diag request failed: " +
+                               std::string(::strerror(-error->error)));
+      } else if (header->nlmsg_type == SOCK_DIAG_BY_FAMILY) {
+        parse(header);
+      }
+    }
+  }
+}
+
+Status sockDiagGetSocketListInet(int family,
+                                 int protocol,
+                                 ino_t net_ns,
+                                 const SockDiagFilter& filter,
+                                 SocketInfoList& result) {
+  struct {
+    nlmsghdr header;
+    inet_diag_req_v2 request;
+  } request{};
+  request.header.nlmsg_len = sizeof(request);
+  request.header.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+  request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  request.request.sdiag_family = static_cast<std::uint8_t>(family);
+  request.request.sdiag_protocol = static_cast<std::uint8_t>(protocol);
+  request.request.idiag_states =
+      (protocol == IPPROTO_TCP) ? filter.tcp_states : ~0U;
+
+  return sockDiagDump(
+      &request, sizeof(request), [&](const nlmsghdr* header) {
+        if (header->nlmsg_len < NLMSG_LENGTH(sizeof(inet_diag_msg))) {
+          return;
+        }
+
+        auto message = static_cast<const inet_diag_msg*>(NLMSG_DATA(header));
+        auto local_port = ntohs(message->id.idiag_sport);
+        auto remote_port = ntohs(message->id.idiag_dport);
+        if ((filter.local_port && *filter.local_port != local_port) ||
+            (filter.remote_port && *filter.remote_port != remote_port)) {
+          return;
+        }
+
+        char address[INET6_ADDRSTRLEN] = {0};
+        SocketInfo socket_info = {};
+        socket_info.socket = std::to_string(message->idiag_inode);
+        socket_info.net_ns = net_ns;
+        socket_info.family = family;
+        socket_info.protocol = protocol;
+        inet_ntop(family, message->id.idiag_src, address, sizeof(address));
+        socket_info.local_address = address;
+        socket_info.local_port = local_port;
+        inet_ntop(family, message->id.idiag_dst, address, sizeof(address));
+        socket_info.remote_address = address;
+        socket_info.remote_port = remote_port;
+
+        if (protocol == IPPROTO_TCP) {
+          auto state = static_cast<size_t>(message->idiag_state);
+          socket_info.state = (state == 0 || state >= tcp_states.size())
+                                  ? "UNKNOWN"
+                                  : tcp_states[state];
+        }
+
+        result.push_back(std::move(socket_info));
+      });
+}
+
+Status sockDiagGetSocketListUnix(ino_t net_ns,
+                                 const SockDiagFilter& filter,
+                                 SocketInfoList& result) {
+  // Unix sockets have no ports, the rows report 0 for both.
+  if ((filter.local_port && *filter.local_port != 0) ||
+      (filter.remote_port && *filter.remote_port != 0)) {
+    return Status::success();
+  }
+
+  struct {
+    nlmsghdr header;
+    unix_diag_req request;
+  } request{};
+  request.header.nlmsg_len = sizeof(request);
+  request.header.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+  request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  request.request.sdiag_family = AF_UNIX;
+  request.request.udiag_states = ~0U;
+  request.request.udiag_show = UDIAG_SHOW_NAME;
+
+  return sockDiagDump(
+      &request, sizeof(request), [&](const nlmsghdr* header) {
+        if (header->nlmsg_len < NLMSG_LENGTH(sizeof(unix_diag_msg))) {
+          return;
+        }
+
+        auto message = static_cast<const unix_diag_msg*>(NLMSG_DATA(header));
+        SocketInfo socket_info = {};
+        socket_info.socket = std::to_string(message->udiag_ino);
+        socket_info.net_ns = net_ns;
+        socket_info.family = AF_UNIX;
+        socket_info.protocol = 0;
+
+        // The attributes follow the message.
+        auto attribute = reinterpret_cast<const rtattr*>(message + 1);
+        auto length = static_cast<int>(header->nlmsg_len -
+                                       NLMSG_LENGTH(sizeof(unix_diag_msg)));
+        for (; RTA_OK(attribute, length);
+             attribute = RTA_NEXT(attribute, length)) {
+          if (attribute->rta_type != UNIX_DIAG_NAME) {
+            continue;
+          }
+
+          auto name = static_cast<const char*>(RTA_DATA(attribute));
+          auto size = RTA_PAYLOAD(attribute);
+          if (size > 0 && name[0] == '\0') {
+            // /proc/net/unix shows abstract names with a leading @.
+            socket_info.unix_socket_path = "@" + std::string(name + 1, size - 1);
+          } else {
+            socket_info.unix_socket_path = std::string(name, strnlen(name, size));
+          }
+        }
+
+        result.push_back(std::move(socket_info));
+      });
+}
+
+} // namespace
+
+bool sockDiagSupported(ino_t net_ns) {
+  static const ino_t own_net_ns = []() -> ino_t {
+    struct stat st;
+    return (::stat("/proc/self/ns/net", &st) == 0) ? st.st_ino : 0;
+  }();
+  return net_ns == 0 || net_ns == own_net_ns;
+}
+
+Status sockDiagGetSocketList(int family,
+                             int protocol,
+                             ino_t net_ns,
+                             const SockDiagFilter& filter,
+                             SocketInfoList& result) {
+  if (!sockDiagSupported(net_ns)) {
+    return Status::failure("The network namespace is not the one of osquery");
+  }
+
+  // Nothing is appended unless the whole dump succeeds.
+  SocketInfoList sockets;
+  Status status;
+  if ((family == AF_INET || family == AF_INET6) &&
+      (protocol == IPPROTO_TCP || protocol == IPPROTO_UDP ||
+       protocol == IPPROTO_UDPLITE)) {
+    status =
+        sockDiagGetSocketListInet(family, protocol, net_ns, filter, sockets);
+  } else if (family == AF_UNIX && protocol == IPPROTO_IP) {
+    status = sockDiagGetSocketListUnix(net_ns, filter, sockets);
+  } else {
+    return Status::failure("Unsupported family " + std::to_string(family) +
+                           " and protocol " + std::to_string(protocol));
+  }
+
+  if (!status.ok()) {
+    return status;
+  }
+
+  result.insert(result.end(),
+                std::make_move_iterator(sockets.begin()),
+                std::make_move_iterator(sockets.end()));
+  return Status::success();
+}
+
+} // namespace osquery
@@ -0,0 +1,62 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <boost/optional.hpp>
+
+#include <osquery/filesystem/linux/proc.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// The sockets a dump selects.
+struct SockDiagFilter final {
+  /// The TCP states to dump, a mask of 1 << state, the kernel skips others.
+  std::uint32_t tcp_states{~0U};
+
+  /// Only the sockets bound to this local port.
+  boost::optional<std::uint16_t> local_port;
+
+  /// Only the sockets connected to this remote port.
+  boost::optional<std::uint16_t> remote_port;
+};
+
+/**
+ * @brief Check if the sockets of a network namespace can be dumped.
+ *
+ * A netlink socket only dumps the sockets of the network namespace it was
+ * created in, the namespace of osquery. Namespace 0 stands for an unknown
+ * namespace, as the /proc readers use it.
+ */
+bool sockDiagSupported(ino_t net_ns);
+
+/**
+ * @brief List the sockets of a family and protocol with NETLINK_SOCK_DIAG.
+ *
+ * The sockets are read from binary netlink dumps instead of the text of
+ * /proc/net, the rows are the same as procGetSocketList. TCP and UDP of
+ * AF_INET and AF_INET6, and AF_UNIX, are supported. The caller falls back to
+ * procGetSocketList if this fails.
+ *
+ * @param family The socket family.
+ * @param protocol The socket protocol, IPPROTO_IP for AF_UNIX.
+ * @param net_ns The network namespace reported with the sockets.
+ * @param filter The sockets to list.
+ * @param result The output parameter, sockets are appended.
+ */
+Status sockDiagGetSocketList(int family,
+                             int protocol,
+                             ino_t net_ns,
+                             const SockDiagFilter& filter,
+                             SocketInfoList& result);
+
+} // namespace osquery
@@ -0,0 +1,165 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+
+#include <osquery/core/flags.h>
+#include <osquery/filesystem/fileops.h>
+#include <osquery/filesystem/posix/appended_file.h>
+
+namespace osquery {
+
+FLAG(uint64,
+     appended_file_cache_size,
+     32,
+     "Megabytes of rows parsed from appended files kept per table (0 = none)");
+
+namespace {
+
+/// Bytes before a checkpoint compared to detect a rewritten file.
+const size_t kAppendedFileTailSize{64};
+
+/// The estimated bytes of a row, including the map nodes.
+size_t getRowBytes(const Row& row) {
+  size_t bytes = sizeof(Row);
+  for (const auto& column : row) {
+    bytes += column.first.size() + column.second.size() + 64;
+  }
+  return bytes;
+}
+
+/// Read size bytes at an offset, fewer if the file is shorter.
+bool readAt(int fd, std::uint64_t offset, size_t size, std::string& data) {
+  data.resize(size);
+  size_t done = 0;
+  while (done < size) {
+    auto n = ::pread(fd, &data[done], size - done, offset + done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    } else if (n == 0) {
+      break;
+    }
+    done += static_cast<size_t>(n);
+  }
+  data.resize(done);
+  return true;
+}
+
+} // namespace
+
+Status AppendedFileReader::read(const std::string& path,
+                                const Parser& parser,
+                                QueryData& rows,
+                                size_t max_size) {
+  PlatformFile file(path, PF_OPEN_EXISTING | PF_READ | PF_NONBLOCK);
+  if (!file.isValid()) {
+    return Status::failure("Cannot open file for reading: " + path);
+  }
+
+  struct stat st;
+  if (::fstat(file.nativeHandle(), &st) != 0 || !S_ISREG(st.st_mode)) {
+    return Status::failure("Cannot read non-regular file: " + path);
+  }
+
+  auto size = static_cast<std::uint64_t>(st.st_size);
+  if (max_size > 0 && size > max_size) {
+    return Status::failure("Cannot read " + path +
+                           " size exceeds limit: " + std::to_string(size));
+  }
+
+  // The entry is taken out while the file is read and parsed, so that other
+  // files are read concurrently, and put back when done.
+  Entry entry;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(path);
+    if (it != entries_.end()) {
+      bytes_ -= it->second.bytes;
+      entry = std::move(it->second);
+      entries_.erase(it);
+    }
+  }
+
+  // Parse from the start if the file is not the one that was parsed.
+  bool appended = entry.device == static_cast<std::uint64_t>(st.st_dev) &&
+                  entry.inode == static_cast<std::uint64_t>(st.st_ino) &&
+                  entry.offset <= size;
+  if (appended && !entry.tail.empty()) {
+    std::string tail;
+    appended = readAt(file.nativeHandle(),
+                      entry.offset - entry.tail.size(),
+                      entry.tail.size(),
+                      tail) &&
+               tail == entry.tail;
+  }
+
+  if (!appended) {
+    entry = Entry();
+    entry.device = static_cast<std::uint64_t>(st.st_dev);
+    entry.inode = static_cast<std::uint64_t>(st.st_ino);
+  }
+
+  std::string data;
+  if (!readAt(file.nativeHandle(), entry.offset, size - entry.offset, data)) {
+    return Status::failure("Cannot read file: " + path);
+  }
+
+  auto first = entry.rows.size();
+  auto used = std::min(parser(data, false, entry.rows), data.size());
+  for (auto i = first; i < entry.rows.size(); ++i) {
+    entry.bytes += getRowBytes(entry.rows[i]);
+  }
+  entry.offset += used;
+  entry.tail += data.substr(0, used);
+  if (entry.tail.size() > kAppendedFileTailSize) {
+    entry.tail.erase(0, entry.tail.size() - kAppendedFileTailSize);
+  }
+
+  rows.insert(rows.end(), entry.rows.begin(), entry.rows.end());
+  if (used < data.size()) {
+    parser(data.substr(used), true, rows);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  entry.last_read = ++reads_;
+  auto& cached = entries_[path];
+  bytes_ -= cached.bytes;
+  bytes_ += entry.bytes;
+  cached = std::move(entry);
+
+  // Without a cache size the rows are dropped right away.
+  evict(FLAGS_appended_file_cache_size * 1024 * 1024);
+  return Status::success();
+}
+
+void AppendedFileReader::evict(size_t limit) {
+  while ((bytes_ > limit || limit == 0) && !entries_.empty()) {
+    auto oldest = std::min_element(
+        entries_.begin(), entries_.end(), [](const auto& a, const auto& b) {
+          return a.second.last_read < b.second.last_read;
+        });
+    bytes_ -= oldest->second.bytes;
+    entries_.erase(oldest);
+  }
+}
+
+void AppendedFileReader::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  bytes_ = 0;
+}
+
+} // namespace osquery
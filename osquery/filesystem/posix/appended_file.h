@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core/sql/query_data.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/**
+ * @brief Rows parsed from files that are only appended to.
+ *
+ * Files such as wtmp and shell histories grow by appending records, and are
+ * read whole by every query. The reader keeps the rows parsed from each file
+ * with a checkpoint: the device and inode, and the offset of the first byte
+ * not parsed. Later reads only parse the bytes appended since.
+ *
+ * A file is parsed again from the start when it was replaced (rotated), is
+ * shorter than the checkpoint (truncated), or the bytes just before the
+ * checkpoint changed (rewritten in place).
+ *
+ * The cached rows of all files of a reader are bounded by
+ * appended_file_cache_size, the least recently read files are dropped first.
+ * Different files may be read concurrently.
+ */
+class AppendedFileReader : private boost::noncopyable {
+ public:
+  /**
+   * @brief Parse the complete records at the start of data.
+   *
+   * The parser appends a row for each record and returns the number of bytes
+   * used, the remaining bytes are given again with the next appended bytes.
+   * When final is true the data is the end of the file that was not used
+   * before, every byte should be parsed. Those rows are not cached.
+   */
+  using Parser = std::function<size_t(
+      const std::string& data, bool final, QueryData& rows)>;
+
+  /**
+   * @brief Read the rows of a file.
+   *
+   * @param path the file to read, special files are refused.
+   * @param parser parses the records of the file.
+   * @param rows the cached rows and the rows of the new bytes, in order.
+   * @param max_size the largest file read, or 0 for no limit.
+   */
+  Status read(const std::string& path,
+              const Parser& parser,
+              QueryData& rows,
+              size_t max_size = 0);
+
+  /// Drop the rows of every file.
+  void clear();
+
+ private:
+  struct Entry {
+    std::uint64_t device{0};
+    std::uint64_t inode{0};
+
+    /// The first byte not parsed into rows.
+    std::uint64_t offset{0};
+
+    /// The bytes just before the offset, to detect rewrites.
+    std::string tail;
+
+    QueryData rows;
+
+    /// Estimated bytes of the rows.
+    size_t bytes{0};
+
+    /// The read counter when the file was last read.
+    std::uint64_t last_read{0};
+  };
+
+  /// Drop the least recently read files until the rows fit the limit.
+  void evict(size_t limit);
+
+ private:
+  std::mutex mutex_;
+  std::map<std::string, Entry> entries_;
+
+  /// Estimated bytes of the rows of all files.
+  size_t bytes_{0};
+
+  std::uint64_t reads_{0};
+};
+
+} // namespace osquery
@@ -83,6 +83,74 @@ TEST_F(PlistTests, test_parse_plist_array) {
   EXPECT_EQ(s.toString(), "OK");
 }
 
+TEST_F(PlistTests, test_parse_plist_content_native) {
+  std::string content;
+  readFile(getTestConfigDirectory() / "test.plist", content);
+
+  pt::ptree tree;
+  auto s = parsePlistContentNative(content, tree);
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  EXPECT_EQ(tree.get<std::string>("Disabled"), "1");
+  EXPECT_EQ(tree.get<std::string>("Label"), "com.apple.FileSyncAgent.sshd");
+  EXPECT_EQ(tree.get_child("ProgramArguments").size(), 4U);
+  EXPECT_EQ(tree.get("inetdCompatibility.Wait", ""), "0");
+  EXPECT_EQ(tree.count("com.apple.Sync"), 1U);
+
+  // A binary plist, with nested dictionaries, arrays and data.
+  readFile(getTestConfigDirectory() / "test_binary.plist", content);
+  s = parsePlistContentNative(content, tree);
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  EXPECT_EQ(tree.get<std::string>("SessionItems.Controller"),
+            "CustomListItems");
+  auto first_element =
+      tree.get_child("SessionItems.CustomListItems").begin()->second;
+  EXPECT_EQ(first_element.get<std::string>("Name"), "Flux");
+  std::string alias = base64::decode(first_element.get<std::string>("Alias"));
+  EXPECT_NE(alias.find("Applications/Flux.app"), std::string::npos);
+
+  // A top level array is added as root.
+  readFile(getTestConfigDirectory() / "test_array.plist", content);
+  s = parsePlistContentNative(content, tree);
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  EXPECT_EQ(tree.get_child("root").size(), 1U);
+
+  // OpenStep plists are left to Foundation.
+  s = parsePlistContentNative("{ Label = \"test\"; }", tree);
+  EXPECT_FALSE(s.ok());
+  s = parsePlistContent("{ Label = \"test\"; }", tree);
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  EXPECT_EQ(tree.get<std::string>("Label"), "test");
+}
+
+TEST_F(PlistTests, test_parse_plist_cache) {
+  auto path = fs::temp_directory_path() /
+              fs::unique_path("osquery.tests.%%%%.%%%%.plist");
+  auto write_plist = [&path](const std::string& label) {
+    writeTextFile(path,
+                  "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                  "<plist version=\"1.0\"><dict><key>Label</key><string>" +
+                      label + "</string></dict></plist>\n",
+                  0644,
+                  PF_CREATE_ALWAYS | PF_WRITE);
+  };
+
+  write_plist("first");
+  pt::ptree tree;
+  ASSERT_TRUE(parsePlist(path, tree).ok());
+  EXPECT_EQ(tree.get<std::string>("Label"), "first");
+
+  // The cached tree is a copy.
+  tree.put("Label", "changed");
+  ASSERT_TRUE(parsePlist(path, tree).ok());
+  EXPECT_EQ(tree.get<std::string>("Label"), "first");
+
+  // A changed file is parsed again.
+  write_plist("second.value");
+  ASSERT_TRUE(parsePlist(path, tree).ok());
+  EXPECT_EQ(tree.get<std::string>("Label"), "second.value");
+  fs::remove(path);
+}
+
 TEST_F(PlistTests, test_parse_plist_content_with_blobs) {
   pt::ptree tree;
   fs::path test_root(getTestConfigDirectory());
@@ -50,6 +50,7 @@ const std::vector<std::string> kFileNameList{
 }
 
 DECLARE_uint64(read_max);
+DECLARE_uint64(stream_read_max);
 
 class FilesystemTests : public testing::Test {
  protected:
@@ -192,6 +193,36 @@ TEST_F(FilesystemTests, test_readwrite_file) {
   }
 }
 
+TEST_F(FilesystemTests, test_stream_file) {
+  auto test_file = (fake_directory_ / "stream.txt").string();
+  std::string in_content(3 * 4096 + 1, 'A');
+  ASSERT_TRUE(writeTextFile(test_file, in_content).ok());
+
+  std::string out_content;
+  size_t blocks = 0;
+  auto status = streamFile(
+      test_file, 4096, false, [&](const char* buffer, size_t size) {
+        out_content.append(buffer, size);
+        blocks++;
+      });
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(in_content, out_content);
+  EXPECT_EQ(blocks, 4U);
+
+  // Streamed reads are limited by stream_read_max, not read_max.
+  auto max = FLAGS_read_max;
+  FLAGS_read_max = 3;
+  status = streamFile(test_file, 4096, false, [](const char*, size_t) {});
+  EXPECT_FALSE(status.ok());
+
+  FLAGS_stream_read_max = in_content.size();
+  status = streamFile(test_file, 4096, false, [](const char*, size_t) {});
+  EXPECT_TRUE(status.ok());
+  FLAGS_stream_read_max = 0;
+  FLAGS_read_max = max;
+  removePath(test_file);
+}
+
 TEST_F(FilesystemTests, test_read_limit) {
   auto max = FLAGS_read_max;
   FLAGS_read_max = 3;
@@ -373,6 +404,41 @@ TEST_F(FilesystemTests, test_wildcard_double_folders) {
                            .string()));
 }
 
+TEST_F(FilesystemTests, test_wildcard_double_callback) {
+  std::set<std::string> results;
+  auto status = resolveFilePattern(
+      fake_directory_ / "%%", [&results](const std::string& path) {
+        results.insert(path);
+        return true;
+      });
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(results.size(), 20U);
+
+  // The search stops once the callback returns false.
+  size_t count = 0;
+  resolveFilePattern(fake_directory_ / "%%", [&count](const std::string&) {
+    return ++count < 3;
+  });
+  EXPECT_EQ(count, 3U);
+}
+
+#ifndef WIN32
+TEST_F(FilesystemTests, test_wildcard_double_symlink_loop) {
+  boost::system::error_code ec;
+  fs::create_directory_symlink(
+      fake_directory_ / "deep1", fake_directory_ / "deep1/deep2/loop", ec);
+  ASSERT_FALSE(ec);
+
+  // The symlinked directory is listed once, not until the level limit.
+  std::vector<std::string> results;
+  resolveFilePattern(fake_directory_ / "deep1/%%", results);
+  EXPECT_TRUE(contains(results,
+                       (fake_directory_ / "deep1/deep2/loop/").string()));
+  EXPECT_LT(results.size(), 10U);
+  fs::remove(fake_directory_ / "deep1/deep2/loop");
+}
+#endif
+
 TEST_F(FilesystemTests, test_wildcard_end_last_component) {
   std::vector<std::string> results;
   auto status = resolveFilePattern(fake_directory_ / "%11/%sh", results);
@@ -7,8 +7,16 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+
 #include <gtest/gtest.h>
 #include <osquery/filesystem/linux/proc.h>
+#include <osquery/filesystem/linux/sock_diag.h>
 
 #ifndef ETH_P_ALL
 #define ETH_P_ALL 0x0003
@@ -123,5 +131,119 @@ TEST_F(LinuxProc, testProcGetSocketListPacketValidInvalidContent) {
   EXPECT_EQ("NONE", socket_list[0].state);
 }
 
+TEST_F(LinuxProc, testProcReader) {
+  ProcReader reader;
+  std::string content;
+  EXPECT_FALSE(reader.read("stat", content).ok());
+
+  auto pid = std::to_string(::getpid());
+  ASSERT_TRUE(reader.setProcess(pid).ok());
+
+  ASSERT_TRUE(reader.read("stat", content).ok());
+  EXPECT_EQ(0U, content.find(pid + " ("));
+
+  // A read larger than the initial buffer grows it.
+  ASSERT_TRUE(reader.read("maps", content).ok());
+  std::string expected;
+  ASSERT_TRUE(readFile(kLinuxProcPath + "/" + pid + "/maps", expected).ok());
+  EXPECT_EQ(expected.substr(0, 64), content.substr(0, 64));
+
+  std::string target;
+  ASSERT_TRUE(reader.readLink("exe", target).ok());
+  EXPECT_FALSE(target.empty());
+
+  std::map<std::string, std::string> descriptors;
+  ASSERT_TRUE(reader.readDescriptors(descriptors).ok());
+  EXPECT_FALSE(descriptors.empty());
+
+  EXPECT_FALSE(reader.setProcess("not_a_pid").ok());
+  EXPECT_FALSE(reader.read("stat", content).ok());
+}
+
+TEST_F(LinuxProc, testSockDiagGetSocketList) {
+  int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  ASSERT_GE(fd, 0);
+
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  ASSERT_EQ(::bind(fd, reinterpret_cast<sockaddr*>(&address), length), 0);
+  ASSERT_EQ(::listen(fd, 1), 0);
+  ASSERT_EQ(
+      ::getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length), 0);
+  auto port = ntohs(address.sin_port);
+
+  // The dump selects the listening socket by its port.
+  SockDiagFilter filter;
+  filter.local_port = port;
+  filter.tcp_states = 1U << TCP_LISTEN;
+  SocketInfoList sockets;
+  auto status = sockDiagGetSocketList(AF_INET, IPPROTO_TCP, 0, filter, sockets);
+  if (!status.ok()) {
+    ::close(fd);
+    GTEST_SKIP() << "sock_diag is not available: " << status.getMessage();
+  }
+
+  ASSERT_EQ(sockets.size(), 1U);
+  EXPECT_EQ(sockets[0].local_address, "127.0.0.1");
+  EXPECT_EQ(sockets[0].local_port, port);
+  EXPECT_EQ(sockets[0].remote_port, 0U);
+  EXPECT_EQ(sockets[0].state, "LISTEN");
+
+  // /proc/net reports the same socket.
+  SocketInfoList proc_sockets;
+  ASSERT_TRUE(
+      procGetSocketList(AF_INET, IPPROTO_TCP, 0, "self", proc_sockets).ok());
+  auto it = std::find_if(
+      proc_sockets.begin(), proc_sockets.end(), [&](const SocketInfo& info) {
+        return info.socket == sockets[0].socket;
+      });
+  ASSERT_NE(it, proc_sockets.end());
+  EXPECT_EQ(it->local_address, sockets[0].local_address);
+  EXPECT_EQ(it->local_port, sockets[0].local_port);
+  EXPECT_EQ(it->state, sockets[0].state);
+
+  // Established sockets are not dumped.
+  filter.tcp_states = 1U << TCP_ESTABLISHED;
+  sockets.clear();
+  EXPECT_TRUE(
+      sockDiagGetSocketList(AF_INET, IPPROTO_TCP, 0, filter, sockets).ok());
+  EXPECT_TRUE(sockets.empty());
+
+  ::close(fd);
+}
+
+TEST_F(LinuxProc, testProcGetDescriptorSnapshot) {
+  int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  ASSERT_GE(fd, 0);
+
+  // The queries of a step share the snapshot.
+  auto first = procGetDescriptorSnapshot(42);
+  EXPECT_EQ(first, procGetDescriptorSnapshot(42));
+  EXPECT_NE(first, procGetDescriptorSnapshot(43));
+  EXPECT_NE(procGetDescriptorSnapshot(0), procGetDescriptorSnapshot(0));
+
+  // A step's snapshot is read again once it was released.
+  auto second = procGetDescriptorSnapshot(43);
+  procReleaseDescriptorSnapshot();
+  EXPECT_NE(second, procGetDescriptorSnapshot(43));
+  procReleaseDescriptorSnapshot();
+
+  auto pid = std::to_string(::getpid());
+  auto descriptors = first->descriptors.find(pid);
+  ASSERT_NE(descriptors, first->descriptors.end());
+
+  auto target = descriptors->second.find(std::to_string(fd));
+  ASSERT_NE(target, descriptors->second.end());
+  auto inode = target->second.substr(8, target->second.size() - 9);
+  auto owner = first->sockets.find(inode);
+  ASSERT_NE(owner, first->sockets.end());
+  EXPECT_EQ(owner->second.pid, pid);
+  EXPECT_EQ(owner->second.fd, std::to_string(fd));
+
+  ::close(fd);
+}
+
 } // namespace
 } // namespace osquery
\ No newline at end of file
@@ -0,0 +1,122 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/filesystem/posix/appended_file.h>
+
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+#include <gtest/gtest.h>
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+class AppendedFileTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = fs::temp_directory_path() /
+            fs::unique_path("osquery.appended_file.%%%%.%%%%");
+  }
+
+  void TearDown() override {
+    fs::remove(path_);
+  }
+
+  /// Read the lines of the test file, counting the lines parsed.
+  QueryData readLines() {
+    auto parser = [this](const std::string& data, bool final, QueryData& rows) {
+      size_t used = 0;
+      auto newline = data.find('\n');
+      while (newline != std::string::npos) {
+        rows.push_back({{"line", data.substr(used, newline - used)}});
+        parsed_++;
+        used = newline + 1;
+        newline = data.find('\n', used);
+      }
+      if (final) {
+        rows.push_back({{"line", data.substr(used)}});
+        parsed_++;
+        used = data.size();
+      }
+      return used;
+    };
+
+    QueryData rows;
+    EXPECT_TRUE(reader_.read(path_.string(), parser, rows).ok());
+    return rows;
+  }
+
+ protected:
+  fs::path path_;
+  AppendedFileReader reader_;
+  size_t parsed_{0};
+};
+
+TEST_F(AppendedFileTests, test_appended_lines) {
+  ASSERT_TRUE(writeTextFile(path_, "one\ntwo\nthr").ok());
+  auto rows = readLines();
+  ASSERT_EQ(rows.size(), 3U);
+  EXPECT_EQ(rows[2]["line"], "thr");
+
+  // The unterminated line is parsed again with the appended bytes.
+  ASSERT_TRUE(writeTextFile(path_, "ee\nfour\n").ok());
+  parsed_ = 0;
+  rows = readLines();
+  ASSERT_EQ(rows.size(), 4U);
+  EXPECT_EQ(rows[2]["line"], "three");
+  EXPECT_EQ(rows[3]["line"], "four");
+  EXPECT_EQ(parsed_, 2U);
+
+  // Without appended bytes nothing is parsed.
+  parsed_ = 0;
+  rows = readLines();
+  EXPECT_EQ(rows.size(), 4U);
+  EXPECT_EQ(parsed_, 0U);
+}
+
+TEST_F(AppendedFileTests, test_truncated_and_rewritten) {
+  ASSERT_TRUE(writeTextFile(path_, "one\ntwo\n").ok());
+  EXPECT_EQ(readLines().size(), 2U);
+
+  // A truncated file is parsed from the start.
+  auto mode = PF_CREATE_ALWAYS | PF_WRITE;
+  ASSERT_TRUE(writeTextFile(path_, "1\n", 0660, mode).ok());
+  auto rows = readLines();
+  ASSERT_EQ(rows.size(), 1U);
+  EXPECT_EQ(rows[0]["line"], "1");
+
+  // So is a file rewritten with more bytes.
+  ASSERT_TRUE(writeTextFile(path_, "uno\ndos\ntres\n", 0660, mode).ok());
+  rows = readLines();
+  ASSERT_EQ(rows.size(), 3U);
+  EXPECT_EQ(rows[0]["line"], "uno");
+
+  // And a replaced file.
+  auto other = path_.string() + ".new";
+  ASSERT_TRUE(writeTextFile(other, "uno\ndos\ntres\ncuatro\n").ok());
+  fs::rename(other, path_);
+  rows = readLines();
+  ASSERT_EQ(rows.size(), 4U);
+  EXPECT_EQ(rows[3]["line"], "cuatro");
+
+  fs::remove(path_);
+  QueryData missing;
+  EXPECT_FALSE(reader_
+                   .read(path_.string(),
+                         [](const std::string&, bool, QueryData&) {
+                           return size_t{0};
+                         },
+                         missing)
+                   .ok());
+}
+
+} // namespace osquery
@@ -8,27 +8,199 @@
  */
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <future>
 #include <iomanip>
+#include <memory>
 #include <sstream>
 #include <unordered_map>
 #include <vector>
 
+#include <openssl/evp.h>
 #include <openssl/md5.h>
 #include <openssl/sha.h>
 
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/hashing/hashing.h>
 #include <osquery/utils/base64.h>
-#include <osquery/utils/info/platform_type.h>
 #include <osquery/utils/status/status.h>
 
 namespace osquery {
 
 /// The buffer read size from file IO to hashing structures.
-const size_t kHashChunkSize{4096};
+const size_t kHashChunkSize{1024 * 1024};
+
+/// Smaller buffers are not worth a thread per digest.
+const size_t kHashParallelMinSize{256 * 1024};
+
+const std::vector<std::pair<HashType, std::string>> kHashTypeNames = {
+    {HASH_TYPE_MD5, "md5"},
+    {HASH_TYPE_SHA1, "sha1"},
+    {HASH_TYPE_SHA256, "sha256"},
+    {HASH_TYPE_XXH64, "xxh64"},
+    {HASH_TYPE_BLAKE2B, "blake2b"},
+};
+
+namespace {
+
+const uint64_t kXXH64Prime1{0x9E3779B185EBCA87ULL};
+const uint64_t kXXH64Prime2{0xC2B2AE3D27D4EB4FULL};
+const uint64_t kXXH64Prime3{0x165667B19E3779F9ULL};
+const uint64_t kXXH64Prime4{0x85EBCA77C2B2AE63ULL};
+const uint64_t kXXH64Prime5{0x27D4EB2F165667C5ULL};
+
+/// The streaming state of an XXH64 digest, with a seed of 0.
+struct XXH64State {
+  uint64_t total_size;
+  uint64_t lanes[4];
+  unsigned char pending[32];
+  size_t pending_size;
+};
+
+inline uint64_t rotl64(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64_t readLE64(const unsigned char* bytes) {
+  uint64_t value = 0;
+  for (int i = 7; i >= 0; --i) {
+    value = (value << 8) | bytes[i];
+  }
+  return value;
+}
+
+inline uint32_t readLE32(const unsigned char* bytes) {
+  uint32_t value = 0;
+  for (int i = 3; i >= 0; --i) {
+    value = (value << 8) | bytes[i];
+  }
+  return value;
+}
+
+inline uint64_t xxh64Round(uint64_t lane, uint64_t input) {
+  lane += input * kXXH64Prime2;
+  return rotl64(lane, 31) * kXXH64Prime1;
+}
+
+inline uint64_t xxh64Merge(uint64_t hash, uint64_t lane) {
+  hash ^= xxh64Round(0, lane);
+  return hash * kXXH64Prime1 + kXXH64Prime4;
+}
+
+void xxh64Init(XXH64State* state) {
+  state->total_size = 0;
+  state->lanes[0] = kXXH64Prime1 + kXXH64Prime2;
+  state->lanes[1] = kXXH64Prime2;
+  state->lanes[2] = 0;
+  state->lanes[3] = 0 - kXXH64Prime1;
+  state->pending_size = 0;
+}
+
+void xxh64Stripe(XXH64State* state, const unsigned char* stripe) {
+  for (size_t i = 0; i < 4; ++i) {
+    state->lanes[i] = xxh64Round(state->lanes[i], readLE64(stripe + i * 8));
+  }
+}
+
+void xxh64Update(XXH64State* state, const unsigned char* input, size_t size) {
+  state->total_size += size;
+
+  // Complete the pending stripe first.
+  if (state->pending_size > 0) {
+    auto fill = std::min(size, sizeof(state->pending) - state->pending_size);
+    memcpy(state->pending + state->pending_size, input, fill);
+    state->pending_size += fill;
+    input += fill;
+    size -= fill;
+    if (state->pending_size < sizeof(state->pending)) {
+      return;
+    }
+    xxh64Stripe(state, state->pending);
+    state->pending_size = 0;
+  }
+
+  for (; size >= 32; input += 32, size -= 32) {
+    xxh64Stripe(state, input);
+  }
+
+  memcpy(state->pending, input, size);
+  state->pending_size = size;
+}
+
+uint64_t xxh64Final(const XXH64State* state) {
+  uint64_t hash;
+  if (state->total_size >= 32) {
+    hash = rotl64(state->lanes[0], 1) + rotl64(state->lanes[1], 7) +
+           rotl64(state->lanes[2], 12) + rotl64(state->lanes[3], 18);
+    for (size_t i = 0; i < 4; ++i) {
+      hash = xxh64Merge(hash, state->lanes[i]);
+    }
+  } else {
+    hash = state->lanes[2] + kXXH64Prime5;
+  }
+  hash += state->total_size;
+
+  const unsigned char* input = state->pending;
+  auto size = state->pending_size;
+  for (; size >= 8; input += 8, size -= 8) {
+    hash ^= xxh64Round(0, readLE64(input));
+    hash = rotl64(hash, 27) * kXXH64Prime1 + kXXH64Prime4;
+  }
+  if (size >= 4) {
+    hash ^= static_cast<uint64_t>(readLE32(input)) * kXXH64Prime1;
+    hash = rotl64(hash, 23) * kXXH64Prime2 + kXXH64Prime3;
+    input += 4;
+    size -= 4;
+  }
+  for (; size > 0; ++input, --size) {
+    hash ^= *input * kXXH64Prime5;
+    hash = rotl64(hash, 11) * kXXH64Prime1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= kXXH64Prime2;
+  hash ^= hash >> 29;
+  hash *= kXXH64Prime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+/// Update every digest with a buffer, each on its own thread if it is large.
+void updateHashes(const std::vector<Hash*>& hashes,
+                  const void* buffer,
+                  size_t size) {
+  if (hashes.size() < 2 || size < kHashParallelMinSize) {
+    for (auto hash : hashes) {
+      hash->update(buffer, size);
+    }
+    return;
+  }
+
+  // The contexts are independent, the last digest runs on this thread.
+  std::vector<std::future<void>> updates;
+  for (size_t i = 0; i + 1 < hashes.size(); ++i) {
+    updates.push_back(
+        std::async(std::launch::async, [&hashes, i, buffer, size]() {
+          hashes[i]->update(buffer, size);
+        }));
+  }
+  hashes.back()->update(buffer, size);
+  for (auto& update : updates) {
+    update.get();
+  }
+}
+
+} // namespace
 
 Hash::~Hash() {
-  if (ctx_ != nullptr) {
+  if (ctx_ == nullptr) {
+    return;
+  }
+
+  if (algorithm_ == HASH_TYPE_BLAKE2B) {
+    EVP_MD_CTX_free(static_cast<EVP_MD_CTX*>(ctx_));
+  } else {
     free(ctx_);
   }
 }
@@ -50,6 +222,14 @@ Hash::Hash(HashType algorithm, HashEncodingType encoding)
     length_ = SHA256_DIGEST_LENGTH;
     ctx_ = static_cast<SHA256_CTX*>(malloc(sizeof(SHA256_CTX)));
     SHA256_Init(static_cast<SHA256_CTX*>(ctx_));
+  } else if (algorithm_ == HASH_TYPE_XXH64) {
+    length_ = sizeof(uint64_t);
+    ctx_ = static_cast<XXH64State*>(malloc(sizeof(XXH64State)));
+    xxh64Init(static_cast<XXH64State*>(ctx_));
+  } else if (algorithm_ == HASH_TYPE_BLAKE2B) {
+    length_ = EVP_MD_size(EVP_blake2b512());
+    ctx_ = EVP_MD_CTX_new();
+    EVP_DigestInit_ex(static_cast<EVP_MD_CTX*>(ctx_), EVP_blake2b512(), nullptr);
   } else {
     throw std::domain_error("Unknown hash function");
   }
@@ -62,6 +242,12 @@ void Hash::update(const void* buffer, size_t size) {
     SHA1_Update(static_cast<SHA_CTX*>(ctx_), buffer, size);
   } else if (algorithm_ == HASH_TYPE_SHA256) {
     SHA256_Update(static_cast<SHA256_CTX*>(ctx_), buffer, size);
+  } else if (algorithm_ == HASH_TYPE_XXH64) {
+    xxh64Update(static_cast<XXH64State*>(ctx_),
+                static_cast<const unsigned char*>(buffer),
+                size);
+  } else if (algorithm_ == HASH_TYPE_BLAKE2B) {
+    EVP_DigestUpdate(static_cast<EVP_MD_CTX*>(ctx_), buffer, size);
   }
 }
 
@@ -75,6 +261,15 @@ std::string Hash::digest() {
     SHA1_Final(hash.data(), static_cast<SHA_CTX*>(ctx_));
   } else if (algorithm_ == HASH_TYPE_SHA256) {
     SHA256_Final(hash.data(), static_cast<SHA256_CTX*>(ctx_));
+  } else if (algorithm_ == HASH_TYPE_XXH64) {
+    // The canonical form of the digest is big-endian, as printed by xxhsum.
+    auto value = xxh64Final(static_cast<XXH64State*>(ctx_));
+    for (size_t i = 0; i < length_; i++) {
+      hash[length_ - 1 - i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+  } else if (algorithm_ == HASH_TYPE_BLAKE2B) {
+    EVP_DigestFinal_ex(
+        static_cast<EVP_MD_CTX*>(ctx_), hash.data(), nullptr);
   }
 
   if (encoding_ == HASH_ENCODING_TYPE_HEX) {
@@ -103,26 +298,23 @@ std::string hashFromBuffer(HashType hash_type,
 }
 
 MultiHashes hashMultiFromFile(int mask, const std::string& path) {
-  std::map<HashType, std::shared_ptr<Hash>> hashes = {
-      {HASH_TYPE_MD5, std::make_shared<Hash>(HASH_TYPE_MD5)},
-      {HASH_TYPE_SHA1, std::make_shared<Hash>(HASH_TYPE_SHA1)},
-      {HASH_TYPE_SHA256, std::make_shared<Hash>(HASH_TYPE_SHA256)},
-  };
-
-  auto blocking = isPlatform(PlatformType::TYPE_WINDOWS);
-  auto s = readFile(path,
-                    0,
-                    kHashChunkSize,
-                    false,
-                    true,
-                    ([&hashes, &mask](std::string& buffer, size_t size) {
-                      for (auto& hash : hashes) {
-                        if (mask & hash.first) {
-                          hash.second->update(&buffer[0], size);
-                        }
-                      }
-                    }),
-                    blocking);
+  // Only the requested digests are computed.
+  std::vector<std::unique_ptr<Hash>> owned;
+  std::vector<Hash*> hashes;
+  for (const auto& type : kHashTypeNames) {
+    if (mask & type.first) {
+      owned.push_back(std::make_unique<Hash>(type.first));
+      hashes.push_back(owned.back().get());
+    }
+  }
+
+  // Files are hashed one chunk at a time, whatever their size.
+  auto s = streamFile(path,
+                      kHashChunkSize,
+                      true,
+                      ([&hashes](const char* buffer, size_t size) {
+                        updateHashes(hashes, buffer, size);
+                      }));
 
   MultiHashes mh = {};
   if (!s.ok()) {
@@ -130,26 +322,45 @@ MultiHashes hashMultiFromFile(int mask, const std::string& path) {
   }
 
   mh.mask = mask;
-  if (mask & HASH_TYPE_MD5) {
-    mh.md5 = hashes.at(HASH_TYPE_MD5)->digest();
-  }
-  if (mask & HASH_TYPE_SHA1) {
-    mh.sha1 = hashes.at(HASH_TYPE_SHA1)->digest();
-  }
-  if (mask & HASH_TYPE_SHA256) {
-    mh.sha256 = hashes.at(HASH_TYPE_SHA256)->digest();
+  auto hash = owned.begin();
+  for (const auto& type : kHashTypeNames) {
+    if (mask & type.first) {
+      getHashDigest(mh, type.first) = (*hash++)->digest();
+    }
   }
   return mh;
 }
 
 std::string hashFromFile(HashType hash_type, const std::string& path) {
   auto hashes = hashMultiFromFile(hash_type, path);
-  if (hash_type == HASH_TYPE_MD5) {
+  return getHashDigest(hashes, hash_type);
+}
+
+int getHashType(const std::string& name) {
+  for (const auto& type : kHashTypeNames) {
+    if (type.second == name) {
+      return type.first;
+    }
+  }
+  return 0;
+}
+
+std::string& getHashDigest(MultiHashes& hashes, HashType type) {
+  switch (type) {
+  case HASH_TYPE_MD5:
     return hashes.md5;
-  } else if (hash_type == HASH_TYPE_SHA1) {
+  case HASH_TYPE_SHA1:
     return hashes.sha1;
-  } else {
+  case HASH_TYPE_XXH64:
+    return hashes.xxh64;
+  case HASH_TYPE_BLAKE2B:
+    return hashes.blake2b;
+  default:
     return hashes.sha256;
   }
 }
+
+const std::string& getHashDigest(const MultiHashes& hashes, HashType type) {
+  return getHashDigest(const_cast<MultiHashes&>(hashes), type);
+}
 } // namespace osquery
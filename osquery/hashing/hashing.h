@@ -10,6 +10,8 @@
 #pragma once
 
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <boost/noncopyable.hpp>
 
@@ -24,6 +26,12 @@ enum HashType {
   HASH_TYPE_MD5 = 2,
   HASH_TYPE_SHA1 = 4,
   HASH_TYPE_SHA256 = 8,
+
+  /// XXH64, a fast non-cryptographic hash to detect changes.
+  HASH_TYPE_XXH64 = 16,
+
+  /// BLAKE2b-512, a cryptographic hash faster than SHA256.
+  HASH_TYPE_BLAKE2B = 32,
 };
 
 /**
@@ -42,6 +50,8 @@ struct MultiHashes {
   std::string md5;
   std::string sha1;
   std::string sha256;
+  std::string xxh64;
+  std::string blake2b;
 };
 
 /**
@@ -152,4 +162,18 @@ MultiHashes hashMultiFromFile(int mask, const std::string& path);
  * @return A string (hex) representation of the hash digest.
  */
 std::string hashFromBuffer(HashType hash_type, const void* buffer, size_t size);
+
+/// Every hash type, and the name of its digest, such as "sha256".
+extern const std::vector<std::pair<HashType, std::string>> kHashTypeNames;
+
+/**
+ * @brief Get the hash type of a name, such as "sha256".
+ *
+ * @return The hash type, 0 if the name is unknown.
+ */
+int getHashType(const std::string& name);
+
+/// Get the digest of a hash type, empty if it was not computed.
+std::string& getHashDigest(MultiHashes& hashes, HashType type);
+const std::string& getHashDigest(const MultiHashes& hashes, HashType type);
 } // namespace osquery
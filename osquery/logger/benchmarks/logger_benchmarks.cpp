@@ -9,14 +9,37 @@
 
 #include <benchmark/benchmark.h>
 
+#include <boost/filesystem.hpp>
+
 #include <osquery/core/core.h>
 #include <osquery/core/flags.h>
+#include <osquery/core/query.h>
+#include <osquery/database/database.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
+#include <osquery/remote/tests/test_utils.h>
+
+#include "plugins/logger/buffered.h"
+#include "plugins/logger/filesystem_logger.h"
+#include "plugins/logger/tls_logger.h"
+
+namespace fs = boost::filesystem;
 
 namespace osquery {
 
 DECLARE_bool(disable_logging);
+DECLARE_uint64(buffered_log_max);
+DECLARE_string(buffered_log_spool_path);
+DECLARE_string(logger_path);
+DECLARE_bool(logger_async);
+DECLARE_uint64(logger_tls_max_lines);
+DECLARE_uint64(logger_tls_max_inflight);
+
+/// Bytes of each benchmark log line.
+const size_t kBenchmarkLineSize{256};
+
+/// Lines sent by each buffered forwarder check, like kMaxLogLines.
+const size_t kBenchmarkLogLines{1024};
 
 class DummyLoggerPlugin : public LoggerPlugin {
  public:
@@ -83,4 +106,239 @@ static void LOGGER_logstring_plugin(benchmark::State& state) {
 }
 
 BENCHMARK(LOGGER_logstring_plugin);
+
+/// A query log item of rows like the processes table, with decorations.
+static QueryLogItem getBenchmarkLogItem(size_t rows, bool snapshot) {
+  QueryDataTyped data;
+  data.reserve(rows);
+  for (size_t i = 0; i < rows; ++i) {
+    RowTyped row;
+    row["pid"] = static_cast<long long>(i);
+    row["name"] = "process" + std::to_string(i);
+    row["path"] = "/usr/bin/process" + std::to_string(i);
+    row["cmdline"] = "/usr/bin/process" + std::to_string(i) + " --flag";
+    row["uid"] = 0LL;
+    row["resident_size"] = static_cast<long long>(i * 4096);
+    row["state"] = "S";
+    data.push_back(std::move(row));
+  }
+
+  QueryLogItem item;
+  item.name = "benchmark";
+  item.identifier = "benchmark.local";
+  item.time = 1500000000;
+  item.epoch = 1;
+  item.counter = 2;
+  item.calendar_time = "Fri Jul 14 02:40:00 2017 UTC";
+  item.decorations["host_uuid"] = "00000000-0000-0000-0000-000000000000";
+  item.decorations["username"] = "benchmark";
+  item.isSnapshot = snapshot;
+  if (snapshot) {
+    item.snapshot_results = std::move(data);
+  } else {
+    item.results.added = std::move(data);
+  }
+  return item;
+}
+
+/// Serialize a scheduled query result as a batch, events, or a snapshot.
+static void LOGGER_serialize_results(benchmark::State& state) {
+  auto format = state.range(1);
+  auto item = getBenchmarkLogItem(state.range(0), format == 2);
+
+  size_t bytes = 0;
+  while (state.KeepRunning()) {
+    if (format == 1) {
+      std::vector<std::string> events;
+      serializeQueryLogItemAsEventsJSON(item, events);
+      for (const auto& event : events) {
+        bytes += event.size();
+      }
+    } else {
+      std::string json;
+      serializeQueryLogItemJSON(item, json);
+      bytes += json.size();
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(bytes);
+}
+
+BENCHMARK(LOGGER_serialize_results)
+    ->Args({100, 0})
+    ->Args({10000, 0})
+    ->Args({100, 1})
+    ->Args({10000, 1})
+    ->Args({100, 2})
+    ->Args({10000, 2});
+
+/// A buffered forwarder whose endpoint accepts every line.
+class BenchmarkLogForwarder : public BufferedLogForwarder {
+ public:
+  BenchmarkLogForwarder()
+      : BufferedLogForwarder("BenchmarkLogForwarder",
+                             "benchmark",
+                             std::chrono::seconds(1),
+                             kBenchmarkLogLines) {}
+
+  using BufferedLogForwarder::check;
+
+ protected:
+  Status send(std::vector<std::string>& log_data,
+              const std::string& log_type) override {
+    return Status::success();
+  }
+};
+
+static void addBenchmarkLines(BufferedLogForwarder& forwarder, size_t count) {
+  std::string line(kBenchmarkLineSize, 'l');
+  for (size_t i = 0; i < count; ++i) {
+    forwarder.logString(line);
+  }
+}
+
+/**
+ * @brief A buffered forwarder check at its buffered_log_max.
+ *
+ * Every check sends kBenchmarkLogLines lines then purges as many, with the
+ * database or the spool holding the backlog.
+ */
+static void LOGGER_buffered_check(benchmark::State& state) {
+  size_t backlog = static_cast<size_t>(state.range(0));
+  auto spool = fs::temp_directory_path() /
+               fs::unique_path("osquery.logger_benchmarks.%%%%.%%%%");
+  if (state.range(1) == 1) {
+    FLAGS_buffered_log_spool_path = spool.string();
+  }
+  state.SetLabel(state.range(1) == 1 ? "spool" : "database");
+
+  auto buffered_log_max = FLAGS_buffered_log_max;
+  FLAGS_buffered_log_max = backlog;
+  BenchmarkLogForwarder forwarder;
+  forwarder.setUp();
+  addBenchmarkLines(forwarder, backlog);
+
+  while (state.KeepRunning()) {
+    // The lines the check sends and the lines it purges.
+    state.PauseTiming();
+    addBenchmarkLines(forwarder, 2 * kBenchmarkLogLines);
+    state.ResumeTiming();
+
+    forwarder.check();
+  }
+
+  state.SetItemsProcessed(state.iterations() * 2 * kBenchmarkLogLines);
+  FLAGS_buffered_log_max = buffered_log_max;
+  FLAGS_buffered_log_spool_path.clear();
+  deleteDatabaseRange(kLogs, "benchmark_", "benchmark_\xff");
+  boost::system::error_code ec;
+  fs::remove_all(spool, ec);
+}
+
+BENCHMARK(LOGGER_buffered_check)
+    ->Args({10000, 0})
+    ->Args({1000000, 0})
+    ->Args({10000, 1})
+    ->Args({1000000, 1})
+    ->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Append result lines with the filesystem logger.
+ *
+ * With logger_async the time is what the caller waits for, lines refused
+ * while the writer thread is behind are counted.
+ */
+static void LOGGER_filesystem_append(benchmark::State& state) {
+  auto logger_path = FLAGS_logger_path;
+  auto logger_async = FLAGS_logger_async;
+  auto path = fs::temp_directory_path() /
+              fs::unique_path("osquery.logger_benchmarks.%%%%.%%%%");
+  fs::create_directories(path);
+  FLAGS_logger_path = path.string();
+  FLAGS_logger_async = (state.range(0) == 1);
+  state.SetLabel(FLAGS_logger_async ? "async" : "sync");
+
+  size_t refused = 0;
+  {
+    auto plugin = std::make_shared<FilesystemLoggerPlugin>();
+    plugin->setUp();
+
+    std::string line(state.range(1), 'r');
+    while (state.KeepRunning()) {
+      if (!plugin->logString(line).ok()) {
+        refused++;
+      }
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * (state.range(1) + 1));
+  state.counters["refused"] = static_cast<double>(refused);
+
+  FLAGS_logger_path = logger_path;
+  FLAGS_logger_async = logger_async;
+  boost::system::error_code ec;
+  fs::remove_all(path, ec);
+}
+
+BENCHMARK(LOGGER_filesystem_append)
+    ->Args({0, 256})
+    ->Args({0, 4096})
+    ->Args({1, 256})
+    ->Args({1, 4096});
+
+/// A TLS forwarder whose checks are run by the benchmark.
+class BenchmarkTLSLogForwarder : public TLSLogForwarder {
+ public:
+  using BufferedLogForwarder::check;
+};
+
+/**
+ * @brief Send buffered result lines to the local test TLS server.
+ *
+ * Each check sends the lines as requests of logger_tls_max_lines lines, with
+ * up to logger_tls_max_inflight of them at once.
+ */
+static void LOGGER_tls_forwarder(benchmark::State& state) {
+  if (!TLSServerRunner::start()) {
+    state.SkipWithError("Cannot start the test TLS server");
+    return;
+  }
+  TLSServerRunner::setClientConfig();
+
+  auto max_lines = FLAGS_logger_tls_max_lines;
+  auto max_inflight = FLAGS_logger_tls_max_inflight;
+  FLAGS_logger_tls_max_lines = static_cast<uint64_t>(state.range(0));
+  FLAGS_logger_tls_max_inflight = static_cast<uint64_t>(state.range(1));
+  {
+    BenchmarkTLSLogForwarder forwarder;
+    forwarder.setUp();
+
+    auto lines = state.range(0) * state.range(1);
+    while (state.KeepRunning()) {
+      state.PauseTiming();
+      addBenchmarkLines(forwarder, lines);
+      state.ResumeTiming();
+
+      forwarder.check();
+    }
+    state.SetItemsProcessed(state.iterations() * lines);
+    state.SetBytesProcessed(state.iterations() * lines * kBenchmarkLineSize);
+  }
+
+  FLAGS_logger_tls_max_lines = max_lines;
+  FLAGS_logger_tls_max_inflight = max_inflight;
+  deleteDatabaseRange(kLogs, "tls_", "tls_\xff");
+  TLSServerRunner::unsetClientConfig();
+  TLSServerRunner::stop();
+}
+
+BENCHMARK(LOGGER_tls_forwarder)
+    ->Args({128, 1})
+    ->Args({1024, 1})
+    ->Args({128, 4})
+    ->Args({1024, 4})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
 }
@@ -9,6 +9,8 @@
 
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -136,6 +138,45 @@ void waitLogRelay();
 /// Inspect the number of internal-buffered status log lines.
 size_t queuedStatuses();
 
+/// Statistics of the result lines sent to one logger plugin.
+struct LoggerDispatchStats {
+  /// Lines waiting in the plugin's queue.
+  uint64_t queued{0};
+
+  /// Lines the plugin accepted.
+  uint64_t delivered{0};
+
+  /// Lines the plugin returned an error for.
+  uint64_t failed{0};
+
+  /// Lines refused because the plugin's queue was full.
+  uint64_t dropped{0};
+
+  /// Total and largest microseconds from logging a line to the plugin return.
+  uint64_t latency_us{0};
+  uint64_t max_latency_us{0};
+};
+
+/**
+ * @brief Visit the statistics of every logger plugin sent a result line.
+ *
+ * With logger_dispatch_queue set, the latency includes the time a line waited
+ * in the plugin's queue.
+ */
+void getLoggerDispatchStats(
+    std::function<void(const std::string&, const LoggerDispatchStats&)>
+        predicate);
+
+/// Wait for the lines queued for logger plugins before the call to be sent.
+void flushLoggerDispatch();
+
+/**
+ * @brief Send the queued lines and stop the logger plugin threads.
+ *
+ * Lines logged afterwards are sent on the calling thread.
+ */
+void stopLoggerDispatch();
+
 /**
  * @brief Write a log line to the OS system log.
  *
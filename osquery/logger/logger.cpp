@@ -12,10 +12,16 @@
 #endif
 
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <future>
+#include <map>
+#include <mutex>
 #include <optional>
 #include <queue>
 #include <thread>
+#include <tuple>
 
 #include <boost/noncopyable.hpp>
 
@@ -28,12 +34,15 @@
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/data_logger.h>
 #include <osquery/numeric_monitoring/numeric_monitoring.h>
+#include <osquery/profiler/code_profiler.h>
+#include <osquery/profiler/query_trace.h>
 #include <osquery/registry/registry_factory.h>
 
 #include <osquery/core/flagalias.h>
 #include <osquery/utils/conversions/split.h>
 #include <osquery/utils/info/platform_type.h>
 #include <osquery/utils/json/json.h>
+#include <osquery/utils/mutex.h>
 #include <osquery/utils/system/time.h>
 
 namespace rj = rapidjson;
@@ -56,6 +65,27 @@ FLAG(bool,
      false,
      "Log scheduled snapshot results as events");
 
+/// Log each query execution as one record of column arrays.
+FLAG(bool,
+     logger_columnar,
+     false,
+     "Log the results of each query execution as a single record of column "
+     "arrays, instead of rows");
+
+/// Split snapshot results across several log lines of a bounded size.
+FLAG(uint64,
+     logger_snapshot_chunk_size,
+     0,
+     "Approximate bytes of rows in each snapshot log line (0 logs each "
+     "snapshot as a single line)");
+
+/// Keep a slow logger plugin from holding up the others and the scheduler.
+FLAG(uint64,
+     logger_dispatch_queue,
+     0,
+     "Result lines queued for each logger plugin, sent from a thread per "
+     "plugin (0 sends on the logging thread)");
+
 /// Alias for the minloglevel used internally by GLOG.
 FLAG(int32, logger_min_status, 0, "Minimum level for status log recording");
 
@@ -82,8 +112,185 @@ HIDDEN_FLAG(bool,
             false,
             "Always send status logs synchronously");
 
+/// Keep a noisy status log from flooding the logger plugins.
+FLAG(uint64,
+     logger_status_dedup_window,
+     0,
+     "Seconds during which identical status logs are collapsed into one "
+     "line with a count (0 disables)");
+
+/// Keep status logs from crowding out results.
+FLAG(uint64,
+     logger_status_rate_limit,
+     0,
+     "Status logs buffered per minute from each source file (0 is "
+     "unlimited)");
+
 DECLARE_bool(enable_numeric_monitoring);
 
+/// The most identical status logs tracked at once, others are not collapsed.
+const size_t kMaxStatusLogRepeats = 1024;
+
+/// Minimum time between two reports of the status logs a source dropped.
+const std::chrono::seconds kStatusLogDropReportInterval{10};
+
+/**
+ * @brief Collapse repeated status logs, and limit them per source file.
+ *
+ * The first of identical status logs within logger_status_dedup_window is
+ * buffered, the following ones are only counted. Once the window ends they
+ * are summarized by a single line with their count.
+ *
+ * Each source file may buffer logger_status_rate_limit lines per minute, with
+ * bursts of as many lines. The lines over the limit are counted and reported
+ * periodically.
+ */
+class StatusLogAggregator : private boost::noncopyable {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /// Check if a status log should be buffered, otherwise it is counted.
+  bool admit(google::LogSeverity severity,
+             const char* filename,
+             int line,
+             const char* message,
+             size_t message_len,
+             const struct ::tm* tm_time,
+             Clock::time_point now);
+
+  /**
+   * @brief Append summaries of the counted status logs that are due.
+   *
+   * @param force Check for due summaries even if it was done recently.
+   */
+  void flush(std::vector<StatusLogLine>& logs,
+             Clock::time_point now,
+             bool force);
+
+ private:
+  using RepeatKey = std::tuple<int, std::string, int, std::string>;
+
+  /// Identical status logs within a window.
+  struct Repeat {
+    Clock::time_point start;
+    uint64_t count{0};
+    struct ::tm last {};
+  };
+
+  /// The rate limit state of a source file.
+  struct Source {
+    double tokens{0};
+    Clock::time_point refilled;
+    Clock::time_point reported;
+    uint64_t dropped{0};
+    struct ::tm last {};
+  };
+
+  std::map<RepeatKey, Repeat> repeats_;
+  std::map<std::string, Source> sources_;
+
+  /// Due summaries are looked for at most once per second while logging.
+  Clock::time_point next_flush_;
+};
+
+bool StatusLogAggregator::admit(google::LogSeverity severity,
+                                const char* filename,
+                                int line,
+                                const char* message,
+                                size_t message_len,
+                                const struct ::tm* tm_time,
+                                Clock::time_point now) {
+  auto window = std::chrono::seconds(FLAGS_logger_status_dedup_window);
+  if (window.count() > 0) {
+    RepeatKey key{static_cast<int>(severity),
+                  filename,
+                  line,
+                  std::string(message, message_len)};
+    auto it = repeats_.find(key);
+    if (it != repeats_.end() && now - it->second.start < window) {
+      it->second.count++;
+      it->second.last = *tm_time;
+      return false;
+    }
+
+    if (it != repeats_.end()) {
+      // The window ended without being summarized yet.
+      it->second = Repeat{now, 0, *tm_time};
+    } else if (repeats_.size() < kMaxStatusLogRepeats) {
+      repeats_.emplace(std::move(key), Repeat{now, 0, *tm_time});
+    }
+  }
+
+  auto rate = static_cast<double>(FLAGS_logger_status_rate_limit);
+  if (rate > 0) {
+    auto it = sources_.find(filename);
+    if (it == sources_.end()) {
+      it = sources_.emplace(filename, Source{rate, now, now, 0, {}}).first;
+    }
+
+    auto& source = it->second;
+    auto elapsed = std::chrono::duration<double>(now - source.refilled);
+    source.tokens = std::min(rate, source.tokens + elapsed.count() * rate / 60);
+    source.refilled = now;
+    if (source.tokens < 1) {
+      source.dropped++;
+      source.last = *tm_time;
+      return false;
+    }
+    source.tokens -= 1;
+  }
+  return true;
+}
+
+void StatusLogAggregator::flush(std::vector<StatusLogLine>& logs,
+                                Clock::time_point now,
+                                bool force) {
+  if (!force && now < next_flush_) {
+    return;
+  }
+  next_flush_ = now + std::chrono::seconds(1);
+
+  auto window = std::chrono::seconds(FLAGS_logger_status_dedup_window);
+  for (auto it = repeats_.begin(); it != repeats_.end();) {
+    auto& repeat = it->second;
+    if (window.count() > 0 && now - repeat.start < window) {
+      ++it;
+      continue;
+    }
+
+    if (repeat.count > 0) {
+      logs.push_back({static_cast<StatusLogSeverity>(std::get<0>(it->first)),
+                      std::get<1>(it->first),
+                      static_cast<size_t>(std::get<2>(it->first)),
+                      std::get<3>(it->first) + " [repeated " +
+                          std::to_string(repeat.count) + " more times]",
+                      toAsciiTimeUTC(&repeat.last),
+                      toUnixTime(&repeat.last),
+                      std::string()});
+    }
+    it = repeats_.erase(it);
+  }
+
+  for (auto& it : sources_) {
+    auto& source = it.second;
+    if (source.dropped == 0 ||
+        now - source.reported < kStatusLogDropReportInterval) {
+      continue;
+    }
+
+    logs.push_back({O_WARNING,
+                    it.first,
+                    0,
+                    "Dropped " + std::to_string(source.dropped) +
+                        " status logs over the logger_status_rate_limit",
+                    toAsciiTimeUTC(&source.last),
+                    toUnixTime(&source.last),
+                    std::string()});
+    source.dropped = 0;
+    source.reported = now;
+  }
+}
+
 /**
  * @brief Logger plugin registry.
  *
@@ -154,6 +361,9 @@ class BufferedLogSink : public google::LogSink, private boost::noncopyable {
   /// Retrieve the list of enabled plugins that should have logs forwarded.
   const std::vector<std::string>& enabledPlugins() const;
 
+  /// Buffer the summaries of collapsed or dropped status logs that are due.
+  void flushAggregates();
+
  public:
   BufferedLogSink(BufferedLogSink const&) = delete;
   void operator=(BufferedLogSink const&) = delete;
@@ -179,6 +389,9 @@ class BufferedLogSink : public google::LogSink, private boost::noncopyable {
 
   /// Track multiple loggers that should receive sinks from the send forwarder.
   std::vector<std::string> sinks_;
+
+  /// Collapses and limits status logs, protected like the buffered logs.
+  StatusLogAggregator aggregator_;
 };
 
 /// Mutex protecting accesses to buffered status logs.
@@ -317,6 +530,18 @@ void BufferedLogSink::send(google::LogSeverity severity,
   // This should not cause any persistent storage or logging actions.
   {
     WriteLock lock(kBufferedLogSinkLogs);
+    auto now = StatusLogAggregator::Clock::now();
+    aggregator_.flush(logs_, now, false);
+    if (!aggregator_.admit(severity,
+                           base_filename,
+                           line,
+                           message,
+                           message_len,
+                           tm_time,
+                           now)) {
+      return;
+    }
+
     logs_.push_back({(StatusLogSeverity)severity,
                      std::string(base_filename),
                      static_cast<size_t>(line),
@@ -367,6 +592,11 @@ const std::vector<std::string>& BufferedLogSink::enabledPlugins() const {
   return sinks_;
 }
 
+void BufferedLogSink::flushAggregates() {
+  WriteLock lock(kBufferedLogSinkLogs);
+  aggregator_.flush(logs_, StatusLogAggregator::Clock::now(), true);
+}
+
 BufferedLogSink::~BufferedLogSink() {
   enabled_ = false;
 }
@@ -376,6 +606,229 @@ Status logString(const std::string& message, const std::string& category) {
       message, category, RegistryFactory::get().getActive("logger"));
 }
 
+namespace {
+
+/// A result line waiting for a logger plugin.
+struct LoggerLine {
+  bool snapshot{false};
+  std::string message;
+  std::string category;
+  std::chrono::steady_clock::time_point logged;
+};
+
+/// The statistics, and with dispatching the queue and thread, of a plugin.
+struct LoggerQueue {
+  std::deque<LoggerLine> lines;
+  LoggerDispatchStats stats;
+
+  /// Lines queued, and lines sent or failed by the thread.
+  uint64_t pushed{0};
+  uint64_t sent{0};
+
+  bool stopping{false};
+  std::thread thread;
+
+  /// Protects all of the above but the thread.
+  std::mutex mutex;
+
+  /// Wakes the thread when a line is queued or it should stop.
+  std::condition_variable wake;
+
+  /// Wakes flush callers after a line is sent.
+  std::condition_variable sent_cv;
+};
+
+/// Protects the queues map and whether dispatching stopped.
+Mutex kLoggerQueuesMutex;
+std::map<std::string, std::unique_ptr<LoggerQueue>> kLoggerQueues;
+bool kLoggerDispatchStopped{false};
+
+Status sendToLogger(const std::string& logger, const LoggerLine& line) {
+  ScopedProfile profile("logger", logger);
+  auto plugin =
+      RegistryFactory::get().localPlugin<LoggerPlugin>("logger", logger);
+  if (plugin != nullptr) {
+    return line.snapshot ? plugin->logSnapshot(line.message)
+                         : plugin->logString(line.message);
+  } else if (line.snapshot) {
+    return Registry::call("logger", logger, {{"snapshot", line.message}});
+  }
+  return Registry::call(
+      "logger", logger, {{"string", line.message}, {"category", line.category}});
+}
+
+/**
+ * @brief Count a line the plugin returned for, the queue must be locked.
+ *
+ * @return The line's latency in microseconds.
+ */
+uint64_t recordLoggerLine(LoggerQueue& queue,
+                          const LoggerLine& line,
+                          const Status& status) {
+  auto latency = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - line.logged)
+          .count());
+  if (status.ok()) {
+    queue.stats.delivered++;
+  } else {
+    queue.stats.failed++;
+  }
+  queue.stats.latency_us += latency;
+  queue.stats.max_latency_us = std::max(queue.stats.max_latency_us, latency);
+  return latency;
+}
+
+void recordLoggerLatency(const std::string& logger, uint64_t latency) {
+  if (FLAGS_enable_numeric_monitoring) {
+    monitoring::record("logger." + logger + ".latency_us",
+                       latency,
+                       monitoring::PreAggregationType::Avg);
+  }
+}
+
+void runLoggerQueue(const std::string& logger, LoggerQueue& queue) {
+  std::unique_lock<std::mutex> lock(queue.mutex);
+  while (true) {
+    queue.wake.wait(
+        lock, [&queue]() { return queue.stopping || !queue.lines.empty(); });
+    if (queue.lines.empty()) {
+      // Stopping, with every queued line sent.
+      break;
+    }
+
+    auto line = std::move(queue.lines.front());
+    queue.lines.pop_front();
+    queue.stats.queued = queue.lines.size();
+    lock.unlock();
+
+    auto status = sendToLogger(logger, line);
+
+    lock.lock();
+    auto latency = recordLoggerLine(queue, line, status);
+    queue.sent++;
+    queue.sent_cv.notify_all();
+
+    lock.unlock();
+    recordLoggerLatency(logger, latency);
+    lock.lock();
+  }
+}
+
+/// Get the queue of a logger plugin, its thread is started when dispatching.
+LoggerQueue& getLoggerQueue(const std::string& logger, bool& threaded) {
+  {
+    ReadLock lock(kLoggerQueuesMutex);
+    auto it = kLoggerQueues.find(logger);
+    if (it != kLoggerQueues.end() &&
+        (it->second->thread.joinable() || kLoggerDispatchStopped ||
+         FLAGS_logger_dispatch_queue == 0)) {
+      threaded = it->second->thread.joinable();
+      return *it->second;
+    }
+  }
+
+  WriteLock lock(kLoggerQueuesMutex);
+  auto& queue = kLoggerQueues[logger];
+  if (queue == nullptr) {
+    queue = std::make_unique<LoggerQueue>();
+  }
+  if (!queue->thread.joinable() && !kLoggerDispatchStopped &&
+      FLAGS_logger_dispatch_queue > 0) {
+    auto target = queue.get();
+    queue->thread = std::thread([logger, target]() {
+      runLoggerQueue(logger, *target);
+    });
+  }
+  threaded = queue->thread.joinable();
+  return *queue;
+}
+
+/// Send a line to a logger plugin, or queue it for the plugin's thread.
+Status dispatchLine(const std::string& logger, LoggerLine line) {
+  line.logged = std::chrono::steady_clock::now();
+
+  bool threaded = false;
+  auto& queue = getLoggerQueue(logger, threaded);
+  std::unique_lock<std::mutex> lock(queue.mutex);
+  if (threaded && !queue.stopping) {
+    if (queue.lines.size() < FLAGS_logger_dispatch_queue) {
+      queue.lines.push_back(std::move(line));
+      queue.stats.queued = queue.lines.size();
+      queue.pushed++;
+      queue.wake.notify_one();
+      return Status::success();
+    }
+
+    queue.stats.dropped++;
+    lock.unlock();
+    if (FLAGS_enable_numeric_monitoring) {
+      monitoring::record("logger." + logger + ".dropped",
+                         1,
+                         monitoring::PreAggregationType::Sum);
+    }
+    return Status::failure("The queue of logger " + logger + " is full");
+  }
+
+  // Without a thread, including once it stopped, the line is sent here.
+  lock.unlock();
+  auto status = sendToLogger(logger, line);
+  lock.lock();
+  auto latency = recordLoggerLine(queue, line, status);
+  lock.unlock();
+  recordLoggerLatency(logger, latency);
+  return status;
+}
+
+} // namespace
+
+void getLoggerDispatchStats(
+    std::function<void(const std::string&, const LoggerDispatchStats&)>
+        predicate) {
+  std::map<std::string, LoggerDispatchStats> stats;
+  {
+    ReadLock lock(kLoggerQueuesMutex);
+    for (const auto& queue : kLoggerQueues) {
+      std::lock_guard<std::mutex> queue_lock(queue.second->mutex);
+      stats[queue.first] = queue.second->stats;
+    }
+  }
+
+  for (const auto& logger : stats) {
+    predicate(logger.first, logger.second);
+  }
+}
+
+void flushLoggerDispatch() {
+  ReadLock lock(kLoggerQueuesMutex);
+  for (const auto& it : kLoggerQueues) {
+    auto& queue = *it.second;
+    std::unique_lock<std::mutex> queue_lock(queue.mutex);
+    auto target = queue.pushed;
+    queue.sent_cv.wait(queue_lock, [&queue, target]() {
+      return queue.sent >= target || !queue.thread.joinable();
+    });
+  }
+}
+
+void stopLoggerDispatch() {
+  WriteLock lock(kLoggerQueuesMutex);
+  kLoggerDispatchStopped = true;
+  for (auto& it : kLoggerQueues) {
+    auto& queue = *it.second;
+    if (!queue.thread.joinable()) {
+      continue;
+    }
+
+    {
+      std::lock_guard<std::mutex> queue_lock(queue.mutex);
+      queue.stopping = true;
+    }
+    queue.wake.notify_one();
+    queue.thread.join();
+  }
+}
+
 Status logString(const std::string& message,
                  const std::string& category,
                  const std::string& receiver) {
@@ -385,20 +838,14 @@ Status logString(const std::string& message,
 
   Status status;
   for (const auto& logger : osquery::split(receiver, ",")) {
-    if (Registry::get().exists("logger", logger, true)) {
-      auto plugin = Registry::get().plugin("logger", logger);
-      auto logger_plugin = std::dynamic_pointer_cast<LoggerPlugin>(plugin);
-      status = logger_plugin->logString(message);
-    } else {
-      status = Registry::call(
-          "logger", logger, {{"string", message}, {"category", category}});
-    }
+    status = dispatchLine(logger, {false, message, category, {}});
   }
   return status;
 }
 
 namespace {
-const std::string kTotalQueryCounterMonitorPath("query.total.count");
+const monitoring::Metric kTotalQueryCounter("query.total.count",
+                                           monitoring::PreAggregationType::Sum);
 }
 
 Status logQueryLogItem(const QueryLogItem& results) {
@@ -411,24 +858,32 @@ Status logQueryLogItem(const QueryLogItem& results,
     return Status::success();
   }
 
-  if (FLAGS_enable_numeric_monitoring) {
-    monitoring::record(
-        kTotalQueryCounterMonitorPath, 1, monitoring::PreAggregationType::Sum);
-  }
+  kTotalQueryCounter.record(1);
 
   std::vector<std::string> json_items;
   Status status;
-  if (FLAGS_logger_event_type) {
-    status = serializeQueryLogItemAsEventsJSON(results, json_items);
-  } else {
-    std::string json;
-    status = serializeQueryLogItemJSON(results, json);
-    json_items.emplace_back(json);
+  {
+    ScopedTraceSpan span("serialize");
+    if (FLAGS_logger_columnar) {
+      std::string json;
+      status = serializeQueryLogItemColumnarJSON(results, json);
+      if (!json.empty()) {
+        json_items.push_back(std::move(json));
+      }
+    } else if (FLAGS_logger_event_type) {
+      status = serializeQueryLogItemAsEventsJSON(results, json_items);
+    } else {
+      std::string json;
+      status = serializeQueryLogItemJSON(results, json);
+      json_items.push_back(std::move(json));
+    }
   }
   if (!status.ok()) {
     return status;
   }
 
+  ScopedTraceSpan span("log");
+  span.setRows(json_items.size());
   for (const auto& json : json_items) {
     status = logString(json, "event", receiver);
   }
@@ -440,35 +895,37 @@ Status logSnapshotQuery(const QueryLogItem& item) {
     return Status::success();
   }
 
-  if (FLAGS_enable_numeric_monitoring) {
-    monitoring::record(
-        kTotalQueryCounterMonitorPath, 1, monitoring::PreAggregationType::Sum);
-  }
+  kTotalQueryCounter.record(1);
 
-  std::vector<std::string> json_items;
+  // Lines are sent to the loggers as they are serialized, so at most one is
+  // held in memory. A single span covers serialization and logging.
+  ScopedTraceSpan span("serialize_log");
   Status status;
-  if (FLAGS_logger_snapshot_event_type) {
-    status = serializeQueryLogItemAsEventsJSON(item, json_items);
-  } else {
+  auto receiver = RegistryFactory::get().getActive("logger");
+  auto loggers = osquery::split(receiver, ",");
+  auto emit = [&status, &loggers](const std::string& json) {
+    for (const auto& logger : loggers) {
+      status = dispatchLine(logger, {true, json, "", {}});
+    }
+  };
+
+  if (FLAGS_logger_columnar) {
     std::string json;
-    status = serializeQueryLogItemJSON(item, json);
-    json_items.emplace_back(json);
-  }
-  if (!status.ok()) {
+    auto serialized = serializeQueryLogItemColumnarJSON(item, json);
+    if (!serialized.ok()) {
+      return serialized;
+    }
+    emit(json);
     return status;
   }
 
-  for (const auto& json : json_items) {
-    auto receiver = RegistryFactory::get().getActive("logger");
-    for (const auto& logger : osquery::split(receiver, ",")) {
-      if (Registry::get().exists("logger", logger, true)) {
-        auto plugin = Registry::get().plugin("logger", logger);
-        auto logger_plugin = std::dynamic_pointer_cast<LoggerPlugin>(plugin);
-        status = logger_plugin->logSnapshot(json);
-      } else {
-        status = Registry::call("logger", logger, {{"snapshot", json}});
-      }
-    }
+  auto serialized =
+      serializeSnapshotQueryLogItem(item,
+                                    FLAGS_logger_snapshot_event_type,
+                                    FLAGS_logger_snapshot_chunk_size,
+                                    emit);
+  if (!serialized.ok()) {
+    return serialized;
   }
 
   return status;
@@ -499,6 +956,9 @@ void relayStatusLogs(LoggerRelayMode relay_mode) {
     return;
   }
 
+  // Summaries of collapsed status logs are relayed even if nothing was logged
+  // since their window ended.
+  BufferedLogSink::get().flushAggregates();
   {
     ReadLock lock(kBufferedLogSinkLogs);
     if (BufferedLogSink::get().dump().size() == 0) {
@@ -509,36 +969,47 @@ void relayStatusLogs(LoggerRelayMode relay_mode) {
   auto sender = ([]() {
     auto identifier = getHostIdentifier();
 
-    // Construct a status log plugin request.
-    PluginRequest request = {{"status", "true"}};
+    // Take the buffered status logs, flushing the buffer.
+    std::vector<StatusLogLine> status_logs;
     {
       WriteLock lock(kBufferedLogSinkLogs);
-      auto& status_logs = BufferedLogSink::get().dump();
-
-      // Prevent serializing and broadcasting an empty response
-      if (status_logs.empty()) {
-        return;
-      }
-
-      for (auto& log : status_logs) {
-        // Copy the host identifier into each status log.
-        log.identifier = identifier;
-      }
+      status_logs.swap(BufferedLogSink::get().dump());
+    }
 
-      serializeIntermediateLog(status_logs, request);
+    // Prevent serializing and broadcasting an empty response
+    if (status_logs.empty()) {
+      return;
+    }
 
-      // Flush the buffered status logs.
-      status_logs.clear();
+    for (auto& log : status_logs) {
+      // Copy the host identifier into each status log.
+      log.identifier = identifier;
     }
 
+    // Only loggers within extensions need the logs serialized in a request.
+    PluginRequest request;
     auto logger_plugin = RegistryFactory::get().getActive("logger");
     for (const auto& logger : osquery::split(logger_plugin, ",")) {
       auto& enabled = BufferedLogSink::get().enabledPlugins();
-      if (std::find(enabled.begin(), enabled.end(), logger) != enabled.end()) {
-        // Skip the registry's logic, and send directly to the core's logger.
-        PluginResponse response;
-        Registry::call("logger", logger, request, response);
+      if (std::find(enabled.begin(), enabled.end(), logger) == enabled.end()) {
+        continue;
+      }
+
+      // Skip the registry's logic, and send directly to the core's logger.
+      ScopedProfile profile("logger", logger);
+      auto plugin =
+          RegistryFactory::get().localPlugin<LoggerPlugin>("logger", logger);
+      if (plugin != nullptr) {
+        plugin->logStatus(status_logs);
+        continue;
+      }
+
+      if (request.empty()) {
+        request["status"] = "true";
+        serializeIntermediateLog(status_logs, request);
       }
+      PluginResponse response;
+      Registry::call("logger", logger, request, response);
     }
   });
 
@@ -7,6 +7,9 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <atomic>
+#include <chrono>
+#include <map>
 #include <thread>
 
 #include <gtest/gtest.h>
@@ -30,6 +33,9 @@ DECLARE_bool(logger_event_type);
 DECLARE_bool(logger_snapshot_event_type);
 DECLARE_bool(disable_logging);
 DECLARE_bool(logger_numerics);
+DECLARE_uint64(logger_dispatch_queue);
+DECLARE_uint64(logger_status_dedup_window);
+DECLARE_uint64(logger_status_rate_limit);
 
 class LoggerTests : public testing::Test {
  public:
@@ -228,6 +234,39 @@ TEST_F(LoggerTests, test_logger_status_level) {
   FLAGS_logger_min_status = logger_min_status;
 }
 
+TEST_F(LoggerTests, test_logger_status_dedup) {
+  FLAGS_logger_status_dedup_window = 1;
+  for (size_t i = 0; i < 5; i++) {
+    LOG(WARNING) << "Logger test is repeating a warning status";
+  }
+
+  // Only the first of the identical statuses is relayed.
+  EXPECT_EQ(1U, LoggerTests::statuses_logged);
+
+  // Once the window ends the repeats are summarized.
+  std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+  relayStatusLogs(LoggerRelayMode::Sync);
+  EXPECT_EQ(2U, LoggerTests::statuses_logged);
+  EXPECT_EQ(O_WARNING, LoggerTests::last_status.severity);
+  EXPECT_EQ(
+      "Logger test is repeating a warning status [repeated 4 more times]",
+      LoggerTests::last_status.message);
+  FLAGS_logger_status_dedup_window = 0;
+}
+
+TEST_F(LoggerTests, test_logger_status_rate_limit) {
+  FLAGS_logger_status_rate_limit = 2;
+  for (size_t i = 0; i < 5; i++) {
+    LOG(WARNING) << "Logger test is generating warning status " << i;
+  }
+
+  // The source file may only burst as many statuses as its limit.
+  EXPECT_EQ(2U, LoggerTests::statuses_logged);
+  EXPECT_EQ("Logger test is generating warning status 1",
+            LoggerTests::last_status.message);
+  FLAGS_logger_status_rate_limit = 0;
+}
+
 TEST_F(LoggerTests, test_feature_request) {
   // Retrieve the test logger plugin.
   auto plugin = RegistryFactory::get().plugin("logger", "test");
@@ -343,6 +382,79 @@ TEST_F(LoggerTests, test_multiple_loggers) {
   EXPECT_EQ(1U, LoggerTests::statuses_logged);
 }
 
+class BlockingLoggerPlugin : public LoggerPlugin {
+ public:
+  Status logString(const std::string& s) override {
+    entered = true;
+    while (!released) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    lines++;
+    return Status::success();
+  }
+
+ public:
+  std::atomic<bool> entered{false};
+  std::atomic<bool> released{false};
+  std::atomic<size_t> lines{0};
+};
+
+TEST_F(LoggerTests, test_logger_dispatch_queue) {
+  auto& rf = RegistryFactory::get();
+  auto blocking = std::make_shared<BlockingLoggerPlugin>();
+  auto fast = std::make_shared<BlockingLoggerPlugin>();
+  fast->released = true;
+  rf.registry("logger")->add("blocking", blocking);
+  rf.registry("logger")->add("fast", fast);
+  EXPECT_TRUE(rf.setActive("logger", "blocking,fast").ok());
+  FLAGS_logger_dispatch_queue = 2;
+
+  auto log = [&fast](const std::string& line, size_t sent) {
+    auto status = logString(line, "event");
+    while (fast->lines < sent) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return status;
+  };
+
+  // The blocking plugin's thread takes the first line and stays in the plugin.
+  EXPECT_TRUE(log("first", 1).ok());
+  while (!blocking->entered) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  // Two more lines fill its queue and the fourth is dropped, while the other
+  // plugin keeps receiving every line.
+  EXPECT_TRUE(log("second", 2).ok());
+  EXPECT_TRUE(log("third", 3).ok());
+  EXPECT_FALSE(log("fourth", 4).ok());
+
+  blocking->released = true;
+  flushLoggerDispatch();
+  EXPECT_EQ(3U, blocking->lines);
+
+  std::map<std::string, LoggerDispatchStats> stats;
+  getLoggerDispatchStats(
+      [&stats](const std::string& logger, const LoggerDispatchStats& s) {
+        stats[logger] = s;
+      });
+  ASSERT_EQ(1U, stats.count("blocking"));
+  EXPECT_EQ(0U, stats["blocking"].queued);
+  EXPECT_EQ(3U, stats["blocking"].delivered);
+  EXPECT_EQ(1U, stats["blocking"].dropped);
+  ASSERT_EQ(1U, stats.count("fast"));
+  EXPECT_EQ(4U, stats["fast"].delivered);
+  EXPECT_EQ(0U, stats["fast"].dropped);
+  EXPECT_GE(stats["blocking"].max_latency_us, stats["fast"].max_latency_us);
+
+  // Once stopped, lines are sent on the logging thread.
+  stopLoggerDispatch();
+  EXPECT_TRUE(logString("fifth", "event").ok());
+  EXPECT_EQ(4U, blocking->lines);
+  EXPECT_EQ(5U, fast->lines);
+  FLAGS_logger_dispatch_queue = 0;
+}
+
 TEST_F(LoggerTests, test_logger_scheduled_query) {
   RegistryFactory::get().setActive("logger", "test");
   initLogger("scheduled_query");
@@ -7,8 +7,15 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <atomic>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <thread>
 #include <unordered_map>
 
+#include <boost/algorithm/string/trim.hpp>
 #include <boost/io/quoted.hpp>
 
 #include <osquery/core/flags.h>
@@ -35,6 +42,14 @@ FLAG(uint64,
      numeric_monitoring_pre_aggregation_time,
      60,
      "Time period in seconds for numeric monitoring pre-aggregation buffer.");
+FLAG(string,
+     numeric_monitoring_histogram_percentiles,
+     "50,95,99",
+     "Comma separated percentiles exported for histogram points");
+FLAG(bool,
+     numeric_monitoring_histogram_buckets,
+     false,
+     "Export the count of each non-empty bucket of histogram points");
 
 namespace {
 using monitoring::PreAggregationType;
@@ -61,7 +76,8 @@ const auto& getAggregationTypeToStringTable() {
           {PreAggregationType::P10, "p10"},
           {PreAggregationType::P50, "p50"},
           {PreAggregationType::P95, "p95"},
-          {PreAggregationType::P99, "p99"}};
+          {PreAggregationType::P99, "p99"},
+          {PreAggregationType::Histogram, "histogram"}};
   return table;
 }
 
@@ -104,6 +120,172 @@ namespace {
 class FlusherIsScheduled {};
 FlusherIsScheduled schedule();
 
+/// Handles of types that cannot be aggregated in a shard are not registered.
+const std::size_t kUnregisteredMetric = std::numeric_limits<std::size_t>::max();
+
+bool isShardable(PreAggregationType pre_aggregation) {
+  switch (pre_aggregation) {
+  case PreAggregationType::Sum:
+  case PreAggregationType::Min:
+  case PreAggregationType::Max:
+  case PreAggregationType::Histogram:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// The values a thread recorded for a metric since the last flush.
+struct MetricSlot {
+  bool recorded{false};
+  ValueType value{0};
+  std::unique_ptr<Histogram> histogram;
+};
+
+/**
+ * The metric values of a thread.
+ * Only the thread and the flusher take the lock, it is almost never contended
+ * so a spin lock is cheaper than a mutex.
+ */
+struct MetricShard {
+  std::atomic_flag lock = ATOMIC_FLAG_INIT;
+  std::atomic<bool> exited{false};
+  std::vector<MetricSlot> slots;
+};
+
+class MetricShardLock final {
+ public:
+  explicit MetricShardLock(MetricShard& shard) : shard_(shard) {
+    while (shard_.lock.test_and_set(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+  }
+
+  ~MetricShardLock() {
+    shard_.lock.clear(std::memory_order_release);
+  }
+
+ private:
+  MetricShard& shard_;
+};
+
+/**
+ * The metric handles and the shard of each thread recording them.
+ * It does not schedule the flusher, handles may be created during static
+ * initialization.
+ */
+class MetricShards final {
+ public:
+  static MetricShards& get() {
+    static MetricShards instance;
+    return instance;
+  }
+
+  std::size_t add(const std::string& path, PreAggregationType pre_aggregation) {
+    if (!isShardable(pre_aggregation)) {
+      return kUnregisteredMetric;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::size_t id = 0; id < metrics_.size(); ++id) {
+      if (metrics_[id].first == path &&
+          metrics_[id].second == pre_aggregation) {
+        return id;
+      }
+    }
+    metrics_.emplace_back(path, pre_aggregation);
+    return metrics_.size() - 1;
+  }
+
+  void record(std::size_t id,
+              PreAggregationType pre_aggregation,
+              ValueType value) {
+    auto& shard = getThreadShard();
+    MetricShardLock lock(shard);
+    if (id >= shard.slots.size()) {
+      shard.slots.resize(id + 1);
+    }
+
+    auto& slot = shard.slots[id];
+    if (pre_aggregation == PreAggregationType::Histogram) {
+      if (slot.histogram == nullptr) {
+        slot.histogram = std::make_unique<Histogram>();
+      }
+      slot.histogram->add(value);
+    } else if (!slot.recorded) {
+      slot.value = value;
+    } else if (pre_aggregation == PreAggregationType::Sum) {
+      slot.value += value;
+    } else if (pre_aggregation == PreAggregationType::Min) {
+      slot.value = std::min(slot.value, value);
+    } else {
+      slot.value = std::max(slot.value, value);
+    }
+    slot.recorded = true;
+  }
+
+  /// Take the values recorded since the last call, as points stamped now.
+  std::vector<Point> takePoints() {
+    std::vector<Point> points;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = Clock::now();
+    for (auto it = shards_.begin(); it != shards_.end();) {
+      auto& shard = **it;
+      // A thread sets exited after its last record.
+      auto exited = shard.exited.load();
+      {
+        MetricShardLock shard_lock(shard);
+        for (std::size_t id = 0; id < shard.slots.size(); ++id) {
+          auto& slot = shard.slots[id];
+          if (!slot.recorded) {
+            continue;
+          }
+
+          const auto& metric = metrics_[id];
+          points.emplace_back(metric.first, slot.value, metric.second, now);
+          if (slot.histogram != nullptr) {
+            points.back().histogram_ = std::move(slot.histogram);
+            points.back().value_ = points.back().histogram_->max();
+          }
+          slot.recorded = false;
+        }
+      }
+      it = (exited) ? shards_.erase(it) : std::next(it);
+    }
+    return points;
+  }
+
+ private:
+  /// The shard of the calling thread, kept until merged after it exits.
+  MetricShard& getThreadShard() {
+    struct ShardHolder {
+      ShardHolder() : shard(std::make_shared<MetricShard>()) {
+        auto& shards = MetricShards::get();
+        std::lock_guard<std::mutex> lock(shards.mutex_);
+        shards.shards_.push_back(shard);
+      }
+
+      ~ShardHolder() {
+        shard->exited = true;
+      }
+
+      std::shared_ptr<MetricShard> shard;
+    };
+
+    thread_local ShardHolder holder;
+    return *holder.shard;
+  }
+
+ private:
+  /// The path and type of each metric handle, indexed by its id.
+  std::vector<std::pair<std::string, PreAggregationType>> metrics_;
+
+  std::vector<std::shared_ptr<MetricShard>> shards_;
+
+  /// Protection around the metrics and the list of shards.
+  std::mutex mutex_;
+};
+
 class PreAggregationBuffer final {
  public:
   static PreAggregationBuffer& get() {
@@ -119,7 +301,7 @@ class PreAggregationBuffer final {
               const bool sync,
               const TimePoint& time_point) {
     if (0 == FLAGS_numeric_monitoring_pre_aggregation_time || sync) {
-      dispatchOne(path, value, pre_aggregation, sync, time_point);
+      dispatchPoint(Point(path, value, pre_aggregation, time_point), sync);
     } else {
       std::lock_guard<std::mutex> lock(mutex_);
       cache_.addPoint(Point(path, value, pre_aggregation, time_point));
@@ -127,14 +309,76 @@ class PreAggregationBuffer final {
   }
 
   void flush() {
+    mergeShards();
     auto points = takeCachedPoints();
     for (const auto& pt : points) {
-      dispatchOne(
-          pt.path_, pt.value_, pt.pre_aggregation_type_, false, pt.time_point_);
+      dispatchPoint(pt, false);
     }
   }
 
+  void recordMetric(std::size_t id,
+                    PreAggregationType pre_aggregation,
+                    ValueType value) {
+    MetricShards::get().record(id, pre_aggregation, value);
+  }
+
  private:
+  /// Move the values recorded through metric handles to the cache.
+  void mergeShards() {
+    auto points = MetricShards::get().takePoints();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& point : points) {
+      cache_.addPoint(std::move(point));
+    }
+  }
+
+  void dispatchPoint(const Point& pt, const bool sync) {
+    if (pt.histogram_ == nullptr) {
+      dispatchOne(
+          pt.path_, pt.value_, pt.pre_aggregation_type_, sync, pt.time_point_);
+      return;
+    }
+
+    // Plugins receive plain values, a histogram is exported as several paths.
+    const auto& histogram = *pt.histogram_;
+    const auto type = pt.pre_aggregation_type_;
+    dispatchOne(pt.path_ + ".count",
+                static_cast<ValueType>(histogram.count()),
+                type,
+                sync,
+                pt.time_point_);
+    dispatchOne(pt.path_ + ".max", histogram.max(), type, sync, pt.time_point_);
+
+    std::istringstream percentiles(
+        FLAGS_numeric_monitoring_histogram_percentiles);
+    std::string percentile;
+    while (std::getline(percentiles, percentile, ',')) {
+      boost::algorithm::trim(percentile);
+      char* end = nullptr;
+      auto value = std::strtod(percentile.c_str(), &end);
+      if (percentile.empty() || *end != '\0' || value < 0 || value > 100) {
+        LOG(WARNING) << "Invalid numeric monitoring histogram percentile "
+                     << boost::io::quoted(percentile);
+        continue;
+      }
+      dispatchOne(pt.path_ + ".p" + percentile,
+                  histogram.percentile(value),
+                  type,
+                  sync,
+                  pt.time_point_);
+    }
+
+    if (FLAGS_numeric_monitoring_histogram_buckets) {
+      for (const auto& bucket : histogram.buckets()) {
+        dispatchOne(pt.path_ + ".bucket." + std::to_string(bucket.first),
+                    static_cast<ValueType>(bucket.second),
+                    type,
+                    sync,
+                    pt.time_point_);
+      }
+    }
+  }
+
   std::vector<Point> takeCachedPoints() {
     std::lock_guard<std::mutex> lock(mutex_);
     auto points = cache_.takePoints();
@@ -168,18 +412,22 @@ class PreAggregationBuffer final {
   std::mutex mutex_;
 };
 
-class PreAggregationFlusher : public InternalRunnable {
+class PreAggregationFlusher : public PeriodicRunnable {
  public:
   explicit PreAggregationFlusher()
-      : InternalRunnable("numeric_monitoring_pre_aggregation_buffer_flusher") {}
-
-  void start() override {
-    while (!interrupted() &&
-           0 != FLAGS_numeric_monitoring_pre_aggregation_time) {
-      pause(
-          std::chrono::seconds(FLAGS_numeric_monitoring_pre_aggregation_time));
-      PreAggregationBuffer::get().flush();
+      : PeriodicRunnable("numeric_monitoring_pre_aggregation_buffer_flusher") {}
+
+ protected:
+  std::chrono::milliseconds runOnce() override {
+    if (0 == FLAGS_numeric_monitoring_pre_aggregation_time) {
+      return kFinished;
     }
+    PreAggregationBuffer::get().flush();
+    return initialDelay();
+  }
+
+  std::chrono::milliseconds initialDelay() override {
+    return std::chrono::seconds(FLAGS_numeric_monitoring_pre_aggregation_time);
   }
 };
 
@@ -194,6 +442,23 @@ void flush() {
   PreAggregationBuffer::get().flush();
 }
 
+Metric::Metric(std::string path, PreAggregationType pre_aggregation)
+    : path_(std::move(path)),
+      pre_aggregation_(pre_aggregation),
+      id_(MetricShards::get().add(path_, pre_aggregation)) {}
+
+void Metric::record(ValueType value) const {
+  if (!FLAGS_enable_numeric_monitoring) {
+    return;
+  }
+  if (id_ == kUnregisteredMetric ||
+      0 == FLAGS_numeric_monitoring_pre_aggregation_time) {
+    monitoring::record(path_, value, pre_aggregation_);
+    return;
+  }
+  PreAggregationBuffer::get().recordMetric(id_, pre_aggregation_, value);
+}
+
 void record(const std::string& path,
             ValueType value,
             PreAggregationType pre_aggregation,
@@ -10,6 +10,7 @@
 #pragma once
 
 #include <chrono>
+#include <cstddef>
 #include <string>
 
 #include "osquery/utils/conversions/tryto.h"
@@ -57,6 +58,7 @@ enum class PreAggregationType {
   P50, // Estimates 50th percentile
   P95, // Estimates 95th percentile
   P99, // Estimates 99th percentile
+  Histogram, // Exports the count, max and percentiles of a log-linear histogram
   // not existing PreAggregationType, upper limit definition
   InvalidTypeUpperLimit,
 };
@@ -89,6 +91,42 @@ void record(const std::string& path,
             const bool sync = false,
             TimePoint time_point = Clock::now());
 
+/**
+ * @brief A pre-registered path, recorded without locks or path lookups.
+ *
+ * The path is interned once, when the handle is created. Each thread records
+ * into its own shard, at the index of the handle, and the shards are merged
+ * into the pre-aggregation buffer when it is flushed. Recording costs a few
+ * nanoseconds, use handles on hot paths with a fixed path.
+ *
+ * Only Sum, Min, Max and Histogram values are aggregated in the shards, the
+ * points are stamped with the flush time. Other types, and all values when
+ * the pre-aggregation buffer is disabled, are passed to @see record.
+ *
+ * @code{.cpp}
+ * static const monitoring::Metric kFired("events.fired",
+ *                                        monitoring::PreAggregationType::Sum);
+ * kFired.record(1);
+ * @endcode
+ */
+class Metric {
+ public:
+  Metric(std::string path, PreAggregationType pre_aggregation);
+
+  void record(ValueType value) const;
+
+  const std::string& path() const noexcept {
+    return path_;
+  }
+
+ private:
+  std::string path_;
+  PreAggregationType pre_aggregation_;
+
+  /// The index of the metric in the thread shards.
+  std::size_t id_;
+};
+
 /**
  * Force flush the pre-aggregation buffer.
  * Please use it, only when it's totally necessary.
@@ -7,6 +7,9 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <cmath>
+
 #include <boost/io/quoted.hpp>
 
 #include "osquery/numeric_monitoring/pre_aggregation_cache.h"
@@ -16,6 +19,83 @@ namespace osquery {
 
 namespace monitoring {
 
+std::size_t Histogram::bucketIndex(ValueType value) {
+  if (value < static_cast<ValueType>(kSubBuckets)) {
+    return (value < 0) ? 0 : static_cast<std::size_t>(value);
+  }
+
+  auto unsigned_value = static_cast<std::uint64_t>(value);
+  std::size_t magnitude = kSubBucketBits;
+  while ((unsigned_value >> (magnitude + 1)) != 0) {
+    ++magnitude;
+  }
+  auto shift = magnitude - kSubBucketBits;
+  auto sub_bucket = (unsigned_value >> shift) & (kSubBuckets - 1);
+  return (shift + 1) * kSubBuckets + static_cast<std::size_t>(sub_bucket);
+}
+
+ValueType Histogram::bucketUpperBound(std::size_t index) {
+  auto group = index / kSubBuckets;
+  auto sub_bucket = index % kSubBuckets;
+  if (group == 0) {
+    return static_cast<ValueType>(sub_bucket);
+  }
+
+  auto shift = group - 1;
+  auto lower = static_cast<std::uint64_t>(kSubBuckets + sub_bucket) << shift;
+  return static_cast<ValueType>(lower + ((std::uint64_t{1} << shift) - 1));
+}
+
+void Histogram::add(ValueType value) {
+  value = std::max<ValueType>(value, 0);
+  min_ = (count_ == 0) ? value : std::min(min_, value);
+  max_ = (count_ == 0) ? value : std::max(max_, value);
+  ++counts_[bucketIndex(value)];
+  ++count_;
+}
+
+void Histogram::merge(const Histogram& other) {
+  if (other.count_ == 0) {
+    return;
+  }
+  min_ = (count_ == 0) ? other.min_ : std::min(min_, other.min_);
+  max_ = (count_ == 0) ? other.max_ : std::max(max_, other.max_);
+  for (std::size_t i = 0; i < kBuckets; ++i) {
+    counts_[i] += other.counts_[i];
+  }
+  count_ += other.count_;
+}
+
+ValueType Histogram::percentile(double percentile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+
+  percentile = std::min(std::max(percentile, 0.0), 100.0);
+  auto rank = static_cast<std::uint64_t>(
+      std::ceil(percentile / 100.0 * static_cast<double>(count_)));
+  rank = std::max<std::uint64_t>(rank, 1);
+
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < kBuckets; ++i) {
+    seen += counts_[i];
+    if (seen >= rank) {
+      return std::min(std::max(bucketUpperBound(i), min_), max_);
+    }
+  }
+  return max_;
+}
+
+std::vector<std::pair<ValueType, std::uint64_t>> Histogram::buckets() const {
+  std::vector<std::pair<ValueType, std::uint64_t>> buckets;
+  for (std::size_t i = 0; i < kBuckets; ++i) {
+    if (counts_[i] != 0) {
+      buckets.emplace_back(bucketUpperBound(i), counts_[i]);
+    }
+  }
+  return buckets;
+}
+
 Point::Point(std::string path,
              ValueType value,
              PreAggregationType pre_aggregation_type,
@@ -23,7 +103,13 @@ Point::Point(std::string path,
     : path_(std::move(path)),
       value_(std::move(value)),
       pre_aggregation_type_(std::move(pre_aggregation_type)),
-      time_point_(std::move(time_point)) {}
+      time_point_(std::move(time_point)) {
+  if (pre_aggregation_type_ == PreAggregationType::Histogram) {
+    histogram_ = std::make_shared<Histogram>();
+    histogram_->add(value_);
+    value_ = histogram_->max();
+  }
+}
 
 bool Point::tryToAggregate(const Point& new_point) {
   if (path_ != new_point.path_) {
@@ -62,6 +148,10 @@ bool Point::tryToAggregate(const Point& new_point) {
   case PreAggregationType::Max:
     value_ = std::max(value_, new_point.value_);
     break;
+  case PreAggregationType::Histogram:
+    histogram_->merge(*new_point.histogram_);
+    value_ = histogram_->max();
+    break;
   case PreAggregationType::InvalidTypeUpperLimit:
     // nothing to do, the type is invalid
     LOG(ERROR) << "Invalid Pre-aggregation type "
@@ -9,7 +9,12 @@
 
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <memory>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <osquery/numeric_monitoring/numeric_monitoring.h>
 
@@ -17,6 +22,51 @@ namespace osquery {
 
 namespace monitoring {
 
+/**
+ * A fixed-memory log-linear histogram of non-negative values.
+ * Values below 16 have a bucket each, above that each power of two is split in
+ * 16 linear buckets, as done by HDR histograms. A value is estimated by the
+ * upper bound of its bucket, which is at most ~6% above it. Negative values
+ * are counted as 0.
+ */
+class Histogram {
+ public:
+  static constexpr std::size_t kSubBucketBits = 4;
+  static constexpr std::size_t kSubBuckets = 1 << kSubBucketBits;
+  static constexpr std::size_t kBuckets = (64 - kSubBucketBits) * kSubBuckets;
+
+  void add(ValueType value);
+
+  void merge(const Histogram& other);
+
+  std::uint64_t count() const noexcept {
+    return count_;
+  }
+
+  ValueType max() const noexcept {
+    return max_;
+  }
+
+  /**
+   * Estimate the value below which @param percentile percent of the values
+   * fall, between 0 and 100. The estimate is within the recorded min and max.
+   */
+  ValueType percentile(double percentile) const;
+
+  /// The upper bound and count of each non-empty bucket, in order.
+  std::vector<std::pair<ValueType, std::uint64_t>> buckets() const;
+
+  static std::size_t bucketIndex(ValueType value);
+
+  static ValueType bucketUpperBound(std::size_t index);
+
+ private:
+  std::array<std::uint64_t, kBuckets> counts_{};
+  std::uint64_t count_{0};
+  ValueType min_{0};
+  ValueType max_{0};
+};
+
 /**
  * Monitoring system smallest unit
  * Consists of watched value itself, watching time, unique name for this set of
@@ -54,6 +104,12 @@ class Point {
   ValueType value_;
   PreAggregationType pre_aggregation_type_;
   TimePoint time_point_;
+
+  /**
+   * The values of a Histogram point, its `value_` is their max.
+   * Copies of a point share it.
+   */
+  std::shared_ptr<Histogram> histogram_;
 };
 
 class PreAggregationCache {
@@ -7,6 +7,9 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <map>
+#include <thread>
+
 #include <gtest/gtest.h>
 
 #include <boost/filesystem.hpp>
@@ -187,4 +190,68 @@ TEST_F(NumericMonitoringTests, record_without_buffer) {
   Dispatcher::joinServices();
 }
 
+TEST_F(NumericMonitoringTests, record_metric_handles) {
+  const auto isEnabled = FLAGS_enable_numeric_monitoring;
+  const auto plugins = FLAGS_numeric_monitoring_plugins;
+  const auto pre_aggregation_time =
+      FLAGS_numeric_monitoring_pre_aggregation_time;
+
+  FLAGS_enable_numeric_monitoring = true;
+  FLAGS_numeric_monitoring_plugins = kNameForTestPlugin;
+  FLAGS_numeric_monitoring_pre_aggregation_time = 1;
+
+  auto status = RegistryFactory::get().setActive(
+      monitoring::registryName(), FLAGS_numeric_monitoring_plugins);
+  ASSERT_TRUE(status.ok());
+
+  monitoring::flush();
+  NumericMonitoringInMemoryTestPlugin::points.clear();
+
+  const auto sum = monitoring::Metric("some.path.to.sum",
+                                      monitoring::PreAggregationType::Sum);
+  const auto max = monitoring::Metric("some.path.to.max",
+                                      monitoring::PreAggregationType::Max);
+
+  // Each thread records in its own shard, a thread that exited is merged.
+  std::vector<std::thread> threads;
+  for (int i = 1; i <= 4; ++i) {
+    threads.emplace_back([&sum, &max, i]() {
+      for (int j = 0; j < 100; ++j) {
+        sum.record(i);
+      }
+      max.record(i * 10);
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  sum.record(1000);
+
+  // A plain record of the same path is aggregated with the handles.
+  monitoring::record(
+      "some.path.to.sum", 5, monitoring::PreAggregationType::Sum);
+  monitoring::flush();
+
+  std::map<std::string, std::string> values;
+  for (const auto& point : NumericMonitoringInMemoryTestPlugin::points) {
+    values[point.at(monitoring::recordKeys().path)] =
+        point.at(monitoring::recordKeys().value);
+  }
+  EXPECT_EQ(2U, NumericMonitoringInMemoryTestPlugin::points.size());
+  EXPECT_EQ("2005", values["some.path.to.sum"]);
+  EXPECT_EQ("40", values["some.path.to.max"]);
+
+  // Nothing is left in the shards.
+  NumericMonitoringInMemoryTestPlugin::points.clear();
+  monitoring::flush();
+  EXPECT_TRUE(NumericMonitoringInMemoryTestPlugin::points.empty());
+
+  FLAGS_enable_numeric_monitoring = isEnabled;
+  FLAGS_numeric_monitoring_plugins = plugins;
+  FLAGS_numeric_monitoring_pre_aggregation_time = pre_aggregation_time;
+
+  Dispatcher::stopServices();
+  Dispatcher::joinServices();
+}
+
 } // namespace osquery
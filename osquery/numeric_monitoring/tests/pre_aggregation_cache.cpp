@@ -111,6 +111,76 @@ GTEST_TEST(PreAggregationPoint, tryToUpdate_max) {
   EXPECT_EQ(42, prev_pt.value_);
 }
 
+GTEST_TEST(PreAggregationHistogram, buckets) {
+  using monitoring::Histogram;
+  // Small values are exact.
+  for (monitoring::ValueType value = 0; value < 32; ++value) {
+    auto index = Histogram::bucketIndex(value);
+    EXPECT_EQ(value, Histogram::bucketUpperBound(index));
+  }
+  EXPECT_EQ(0, Histogram::bucketIndex(-5));
+
+  // Larger values are estimated within 1/16 above them.
+  for (monitoring::ValueType value : {33LL, 1000LL, 123456789LL}) {
+    auto upper = Histogram::bucketUpperBound(Histogram::bucketIndex(value));
+    EXPECT_GE(upper, value);
+    EXPECT_LE(upper - value, value / 16);
+  }
+
+  const auto max = std::numeric_limits<monitoring::ValueType>::max();
+  EXPECT_EQ(Histogram::kBuckets - 1, Histogram::bucketIndex(max));
+  EXPECT_EQ(max, Histogram::bucketUpperBound(Histogram::kBuckets - 1));
+}
+
+GTEST_TEST(PreAggregationHistogram, percentiles) {
+  auto histogram = monitoring::Histogram{};
+  EXPECT_EQ(0, histogram.percentile(50));
+
+  for (monitoring::ValueType value = 1; value <= 1000; ++value) {
+    histogram.add(value);
+  }
+  EXPECT_EQ(1000U, histogram.count());
+  EXPECT_EQ(1000, histogram.max());
+  EXPECT_EQ(1, histogram.percentile(0));
+  EXPECT_EQ(1000, histogram.percentile(100));
+
+  for (double percentile : {50.0, 95.0, 99.0, 99.9}) {
+    auto exact = static_cast<monitoring::ValueType>(percentile * 10);
+    auto estimate = histogram.percentile(percentile);
+    EXPECT_GE(estimate, exact);
+    EXPECT_LE(estimate - exact, exact / 16);
+  }
+
+  auto buckets = histogram.buckets();
+  std::uint64_t count = 0;
+  for (const auto& bucket : buckets) {
+    count += bucket.second;
+  }
+  EXPECT_EQ(1000U, count);
+  using monitoring::Histogram;
+  EXPECT_EQ(Histogram::bucketUpperBound(Histogram::bucketIndex(1000)),
+            buckets.back().first);
+}
+
+GTEST_TEST(PreAggregationPoint, tryToUpdate_histogram) {
+  const auto now = monitoring::Clock::now();
+  const auto path = "test.path.to.nowhere";
+  auto prev_pt = monitoring::Point(
+      path, 3, monitoring::PreAggregationType::Histogram, now);
+  ASSERT_NE(nullptr, prev_pt.histogram_);
+  for (monitoring::ValueType value : {42, 7, 1}) {
+    auto new_pt = monitoring::Point(path,
+                                    value,
+                                    monitoring::PreAggregationType::Histogram,
+                                    now - std::chrono::seconds{1});
+    ASSERT_TRUE(prev_pt.tryToAggregate(new_pt));
+  }
+  EXPECT_EQ(now, prev_pt.time_point_);
+  EXPECT_EQ(42, prev_pt.value_);
+  EXPECT_EQ(4U, prev_pt.histogram_->count());
+  EXPECT_EQ(7, prev_pt.histogram_->percentile(75));
+}
+
 GTEST_TEST(PreAggregationCache, life_cycle) {
   const auto now = monitoring::Clock::now();
   auto cache = monitoring::PreAggregationCache{};
@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+// Replace the global operator new and delete to count the heap allocations
+// of each thread, see ScopedAllocationAccount. Only executables link this,
+// osqueryd and osqueryi when built with OSQUERY_ENABLE_ALLOCATION_HOOKS.
+
+#include <cstdlib>
+#include <new>
+
+#if defined(__linux__)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#elif defined(WIN32)
+#include <malloc.h>
+#endif
+
+#include <osquery/profiler/allocations.h>
+
+namespace {
+
+/// The usable size of a block, the same on allocation and deallocation.
+std::size_t blockSize(void* ptr) {
+#if defined(__linux__)
+  return malloc_usable_size(ptr);
+#elif defined(__APPLE__)
+  return malloc_size(ptr);
+#elif defined(WIN32)
+  return _msize(ptr);
+#else
+  return 0;
+#endif
+}
+
+void* countedAllocate(std::size_t size) noexcept {
+  auto ptr = std::malloc((size == 0) ? 1 : size);
+  if (ptr != nullptr) {
+    osquery::countAllocation(blockSize(ptr));
+  }
+  return ptr;
+}
+
+void* countedAllocateOrThrow(std::size_t size) {
+  while (true) {
+    auto ptr = countedAllocate(size);
+    if (ptr != nullptr) {
+      return ptr;
+    }
+
+    auto handler = std::get_new_handler();
+    if (handler == nullptr) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+}
+
+void countedFree(void* ptr) noexcept {
+  if (ptr != nullptr) {
+    osquery::countDeallocation(blockSize(ptr));
+    std::free(ptr);
+  }
+}
+
+struct AllocationHooks {
+  AllocationHooks() {
+    osquery::setAllocationsCounted();
+  }
+};
+
+AllocationHooks kAllocationHooks;
+
+} // namespace
+
+void* operator new(std::size_t size) {
+  return countedAllocateOrThrow(size);
+}
+
+void* operator new[](std::size_t size) {
+  return countedAllocateOrThrow(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return countedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return countedAllocate(size);
+}
+
+void operator delete(void* ptr) noexcept {
+  countedFree(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  countedFree(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  countedFree(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  countedFree(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  countedFree(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+  countedFree(ptr);
+}
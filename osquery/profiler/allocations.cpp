@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <atomic>
+
+#include <osquery/profiler/allocations.h>
+
+namespace osquery {
+
+namespace {
+
+/**
+ * The counters of a thread.
+ *
+ * They are trivial so the thread local storage is initialized without a
+ * constructor, allocations may be counted before main and during thread
+ * exit.
+ */
+struct ThreadAllocations {
+  std::uint64_t allocations;
+  std::uint64_t allocated;
+
+  /// Bytes held, negative when the thread frees memory of other threads.
+  std::int64_t held;
+
+  /// The most bytes held since the innermost account started.
+  std::int64_t peak;
+};
+
+thread_local ThreadAllocations kThreadAllocations;
+
+std::atomic<bool> kAllocationsCounted{false};
+
+} // namespace
+
+bool allocationsCounted() {
+  return kAllocationsCounted.load(std::memory_order_relaxed);
+}
+
+void setAllocationsCounted() {
+  kAllocationsCounted = true;
+}
+
+void countAllocation(std::size_t bytes) {
+  auto& counters = kThreadAllocations;
+  counters.allocations++;
+  counters.allocated += bytes;
+  counters.held += static_cast<std::int64_t>(bytes);
+  if (counters.held > counters.peak) {
+    counters.peak = counters.held;
+  }
+}
+
+void countDeallocation(std::size_t bytes) {
+  kThreadAllocations.held -= static_cast<std::int64_t>(bytes);
+}
+
+ScopedAllocationAccount::ScopedAllocationAccount() {
+  auto& counters = kThreadAllocations;
+  allocations_start_ = counters.allocations;
+  allocated_start_ = counters.allocated;
+  held_start_ = counters.held;
+  outer_peak_ = counters.peak;
+  counters.peak = counters.held;
+}
+
+ScopedAllocationAccount::~ScopedAllocationAccount() {
+  auto& counters = kThreadAllocations;
+  counters.peak = std::max(outer_peak_, counters.peak);
+}
+
+std::uint64_t ScopedAllocationAccount::allocations() const {
+  return kThreadAllocations.allocations - allocations_start_;
+}
+
+std::uint64_t ScopedAllocationAccount::allocated() const {
+  return kThreadAllocations.allocated - allocated_start_;
+}
+
+std::uint64_t ScopedAllocationAccount::peak() const {
+  auto peak = kThreadAllocations.peak - held_start_;
+  return (peak > 0) ? static_cast<std::uint64_t>(peak) : 0;
+}
+
+} // namespace osquery
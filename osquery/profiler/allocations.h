@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace osquery {
+
+/**
+ * @brief Whether the heap allocations of this process are counted.
+ *
+ * Allocations are counted when the executable links the allocation hooks,
+ * which replace the global operator new and delete. osqueryd and osqueryi
+ * link them when built with OSQUERY_ENABLE_ALLOCATION_HOOKS, other builds,
+ * tests and tools report no allocations.
+ */
+bool allocationsCounted();
+
+/// Count an allocation of the calling thread, used by the hooks.
+void countAllocation(std::size_t bytes);
+
+/// Count a deallocation by the calling thread, used by the hooks.
+void countDeallocation(std::size_t bytes);
+
+/// Mark the allocations as counted, called when the hooks are initialized.
+void setAllocationsCounted();
+
+/**
+ * @brief Account the heap allocations of the calling thread within a scope.
+ *
+ * Only allocations through operator new are counted, which include the rows
+ * and strings of osquery but not the internal memory of SQLite. Memory freed
+ * by another thread than the one that allocated it is not subtracted from
+ * the allocating scope, so the peak is an upper bound when rows are handed
+ * between threads.
+ *
+ * Scopes may be nested, the peak of an inner scope is part of the outer one.
+ */
+class ScopedAllocationAccount final {
+ public:
+  ScopedAllocationAccount();
+  ~ScopedAllocationAccount();
+
+  /// Allocations made by the thread since the scope started.
+  std::uint64_t allocations() const;
+
+  /// Bytes allocated by the thread since the scope started.
+  std::uint64_t allocated() const;
+
+  /// The most bytes held by the thread above what it held at the start.
+  std::uint64_t peak() const;
+
+  ScopedAllocationAccount(const ScopedAllocationAccount&) = delete;
+  ScopedAllocationAccount& operator=(const ScopedAllocationAccount&) = delete;
+
+ private:
+  std::uint64_t allocations_start_{0};
+  std::uint64_t allocated_start_{0};
+  std::int64_t held_start_{0};
+  std::int64_t outer_peak_{0};
+};
+
+} // namespace osquery
@@ -9,6 +9,9 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <initializer_list>
 #include <memory>
 #include <string>
@@ -16,6 +19,13 @@
 
 namespace osquery {
 
+/**
+ * @brief Record rusage and wall time of a scope as numeric monitoring points.
+ *
+ * Each name receives a set of "<name>.time.*", "rss.*" and IO points. This is
+ * used around scheduled queries when numeric monitoring is enabled, see
+ * ScopedProfile for a cheaper per-subsystem breakdown.
+ */
 class CodeProfiler final {
  public:
   CodeProfiler(const std::initializer_list<std::string>& names);
@@ -29,4 +39,54 @@ class CodeProfiler final {
   const std::unique_ptr<CodeProfilerData> code_profiler_data_;
 };
 
+/// The accumulated cost of a profiled scope.
+struct ProfileStats {
+  /// Number of times the scope ran.
+  std::uint64_t calls{0};
+
+  /// CPU time in microseconds of the threads running the scope.
+  std::uint64_t cpu_time_us{0};
+
+  /// Wall time in microseconds, and the longest single run.
+  std::uint64_t wall_time_us{0};
+  std::uint64_t max_wall_time_us{0};
+
+  ProfileStats& operator+=(const ProfileStats& other);
+};
+
+/**
+ * @brief Account the thread CPU and wall time of a scope to a subsystem.
+ *
+ * Scopes are identified by a subsystem, such as "table" or "logger", and a
+ * name within it, such as the table or plugin name. Costs accumulate for the
+ * life of the process and are reported by the osquery_profile table. When
+ * numeric monitoring is enabled each run is also recorded as summed
+ * "profile.<subsystem>.<name>.cpu_time_us" and "wall_time_us" points.
+ *
+ * Nothing is measured unless --enable_profile is set, a disabled scope only
+ * reads the flag. Nested scopes both account the inner run.
+ */
+class ScopedProfile final {
+ public:
+  ScopedProfile(const char* subsystem, const std::string& name);
+  ~ScopedProfile();
+
+  ScopedProfile(const ScopedProfile&) = delete;
+  ScopedProfile& operator=(const ScopedProfile&) = delete;
+
+ private:
+  const char* subsystem_{nullptr};
+  std::string name_;
+  std::uint64_t cpu_start_us_{0};
+  std::chrono::steady_clock::time_point wall_start_;
+};
+
+/// Visit the accumulated statistics of each subsystem and name.
+void getProfileStats(std::function<void(const std::string& subsystem,
+                                        const std::string& name,
+                                        const ProfileStats&)> predicate);
+
+/// Reset all accumulated statistics.
+void resetProfileStats();
+
 } // namespace osquery
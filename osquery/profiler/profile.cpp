@@ -0,0 +1,128 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+#ifdef WIN32
+#include <osquery/utils/system/system.h>
+#else
+#include <time.h>
+#endif
+
+#include <osquery/core/flags.h>
+#include <osquery/numeric_monitoring/numeric_monitoring.h>
+#include <osquery/profiler/code_profiler.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+FLAG(bool,
+     enable_profile,
+     false,
+     "Account the CPU and wall time of tables, subscribers, loggers, config "
+     "parsers and database calls");
+
+DECLARE_bool(enable_numeric_monitoring);
+
+namespace {
+
+Mutex kProfileStatsMutex;
+
+std::map<std::pair<std::string, std::string>, ProfileStats> kProfileStats;
+
+std::uint64_t getThreadCpuMicroseconds() {
+#ifdef WIN32
+  FILETIME creation, exit, kernel, user;
+  if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+    return 0;
+  }
+  // Thread times are counted in 100 nanosecond intervals.
+  auto ticks = [](const FILETIME& time) {
+    return (static_cast<std::uint64_t>(time.dwHighDateTime) << 32) |
+           time.dwLowDateTime;
+  };
+  return (ticks(kernel) + ticks(user)) / 10;
+#else
+  struct timespec ts;
+  if (::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+    return 0;
+  }
+  return static_cast<std::uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+} // namespace
+
+ProfileStats& ProfileStats::operator+=(const ProfileStats& other) {
+  calls += other.calls;
+  cpu_time_us += other.cpu_time_us;
+  wall_time_us += other.wall_time_us;
+  max_wall_time_us = std::max(max_wall_time_us, other.max_wall_time_us);
+  return *this;
+}
+
+ScopedProfile::ScopedProfile(const char* subsystem, const std::string& name) {
+  if (!FLAGS_enable_profile) {
+    return;
+  }
+
+  subsystem_ = subsystem;
+  name_ = name;
+  cpu_start_us_ = getThreadCpuMicroseconds();
+  wall_start_ = std::chrono::steady_clock::now();
+}
+
+ScopedProfile::~ScopedProfile() {
+  if (subsystem_ == nullptr) {
+    return;
+  }
+
+  ProfileStats run;
+  run.calls = 1;
+  auto cpu_end_us = getThreadCpuMicroseconds();
+  run.cpu_time_us = (cpu_end_us > cpu_start_us_) ? cpu_end_us - cpu_start_us_
+                                                 : 0;
+  run.wall_time_us = static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - wall_start_)
+          .count());
+  run.max_wall_time_us = run.wall_time_us;
+
+  {
+    WriteLock lock(kProfileStatsMutex);
+    kProfileStats[std::make_pair(std::string(subsystem_), name_)] += run;
+  }
+
+  if (!FLAGS_enable_numeric_monitoring) {
+    return;
+  }
+
+  auto prefix = std::string("profile.") + subsystem_ + "." + name_ + ".";
+  auto sum = monitoring::PreAggregationType::Sum;
+  monitoring::record(prefix + "cpu_time_us", run.cpu_time_us, sum);
+  monitoring::record(prefix + "wall_time_us", run.wall_time_us, sum);
+}
+
+void getProfileStats(std::function<void(const std::string& subsystem,
+                                        const std::string& name,
+                                        const ProfileStats&)> predicate) {
+  ReadLock lock(kProfileStatsMutex);
+  for (const auto& stats : kProfileStats) {
+    predicate(stats.first.first, stats.first.second, stats.second);
+  }
+}
+
+void resetProfileStats() {
+  WriteLock lock(kProfileStatsMutex);
+  kProfileStats.clear();
+}
+
+} // namespace osquery
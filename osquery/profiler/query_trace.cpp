@@ -0,0 +1,293 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <atomic>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <random>
+#include <sstream>
+
+#include <osquery/core/flags.h>
+#include <osquery/logger/logger.h>
+#include <osquery/profiler/query_trace.h>
+#include <osquery/utils/json/json.h>
+#include <osquery/utils/system/system.h>
+
+namespace rj = rapidjson;
+
+namespace osquery {
+
+FLAG(uint64,
+     query_trace_sample,
+     0,
+     "Trace one in N scheduled and distributed query executions (0 = off)");
+
+FLAG(uint64,
+     query_trace_buffer_size,
+     256,
+     "Number of the most recent query traces to keep");
+
+FLAG(string,
+     query_trace_otlp_path,
+     "",
+     "Append each query trace to this file as a line of OTLP/JSON");
+
+namespace {
+
+/// The trace of the execution running on this thread.
+struct ActiveTrace {
+  QueryTrace* trace{nullptr};
+  std::chrono::steady_clock::time_point start;
+};
+
+thread_local ActiveTrace kActiveTrace;
+
+std::atomic<std::uint64_t> kTraceExecutions{0};
+
+/// Protects the ring buffer, the identifiers and the OTLP file.
+std::mutex kQueryTracesMutex;
+std::deque<QueryTrace> kQueryTraces;
+
+std::uint64_t elapsedUs(std::chrono::steady_clock::time_point from,
+                        std::chrono::steady_clock::time_point to) {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(to - from)
+          .count());
+}
+
+std::string toHex(std::uint64_t value) {
+  std::ostringstream stream;
+  stream << std::hex << std::setfill('0') << std::setw(16) << value;
+  return stream.str();
+}
+
+std::string newTraceId() {
+  static std::mt19937_64 generator(std::random_device{}());
+  return toHex(generator()) + toHex(generator());
+}
+
+/// Span identifiers are unique within a trace, 0 is the execution itself.
+std::string spanId(const QueryTrace& trace, std::uint64_t number) {
+  return trace.trace_id.substr(0, 8) + toHex(number).substr(8);
+}
+
+void addAttribute(JSON& doc,
+                  rj::Value& attributes,
+                  const std::string& key,
+                  const std::string& value) {
+  auto attribute = doc.getObject();
+  doc.addCopy("key", key, attribute);
+  auto any_value = doc.getObject();
+  doc.addCopy("stringValue", value, any_value);
+  doc.add("value", any_value, attribute);
+  doc.push(attribute, attributes);
+}
+
+void addAttribute(JSON& doc,
+                  rj::Value& attributes,
+                  const std::string& key,
+                  std::uint64_t value) {
+  // OTLP/JSON encodes 64-bit integers as strings.
+  addAttribute(doc, attributes, key, std::to_string(value));
+}
+
+void addSpan(JSON& doc,
+             rj::Value& spans,
+             const QueryTrace& trace,
+             const std::string& span_id,
+             const std::string& parent_id,
+             const std::string& name,
+             std::uint64_t start_us,
+             std::uint64_t duration_us,
+             rj::Value& attributes) {
+  auto start_ns = (trace.start_time_us + start_us) * 1000;
+  auto span = doc.getObject();
+  doc.addCopy("traceId", trace.trace_id, span);
+  doc.addCopy("spanId", span_id, span);
+  if (!parent_id.empty()) {
+    doc.addCopy("parentSpanId", parent_id, span);
+  }
+  doc.addCopy("name", name, span);
+  // SPAN_KIND_INTERNAL
+  doc.add("kind", 1, span);
+  doc.addCopy("startTimeUnixNano", std::to_string(start_ns), span);
+  doc.addCopy("endTimeUnixNano",
+              std::to_string(start_ns + duration_us * 1000),
+              span);
+  doc.add("attributes", attributes, span);
+  doc.push(span, spans);
+}
+
+void exportTrace(const QueryTrace& trace) {
+  std::string json;
+  auto status = serializeQueryTraceOTLP(trace, json);
+  if (!status.ok()) {
+    VLOG(1) << "Cannot serialize the trace of " << trace.name << ": "
+            << status.getMessage();
+    return;
+  }
+
+  std::ofstream output(FLAGS_query_trace_otlp_path, std::ios::app);
+  if (!output.is_open()) {
+    VLOG(1) << "Cannot open the query trace file "
+            << FLAGS_query_trace_otlp_path;
+    return;
+  }
+  output << json << "\n";
+}
+
+} // namespace
+
+ScopedQueryTrace::ScopedQueryTrace(const char* kind, const std::string& name) {
+  auto sample = FLAGS_query_trace_sample;
+  if (sample == 0 || kActiveTrace.trace != nullptr ||
+      kTraceExecutions.fetch_add(1, std::memory_order_relaxed) % sample != 0) {
+    return;
+  }
+
+  trace_ = std::make_unique<QueryTrace>();
+  trace_->kind = kind;
+  trace_->name = name;
+  trace_->start_time_us = static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+  {
+    std::lock_guard<std::mutex> lock(kQueryTracesMutex);
+    trace_->trace_id = newTraceId();
+  }
+
+  kActiveTrace.trace = trace_.get();
+  kActiveTrace.start = std::chrono::steady_clock::now();
+}
+
+ScopedQueryTrace::~ScopedQueryTrace() {
+  if (trace_ == nullptr) {
+    return;
+  }
+
+  trace_->duration_us =
+      elapsedUs(kActiveTrace.start, std::chrono::steady_clock::now());
+  kActiveTrace.trace = nullptr;
+
+  std::lock_guard<std::mutex> lock(kQueryTracesMutex);
+  if (!FLAGS_query_trace_otlp_path.empty()) {
+    exportTrace(*trace_);
+  }
+
+  kQueryTraces.push_back(std::move(*trace_));
+  while (kQueryTraces.size() > FLAGS_query_trace_buffer_size) {
+    kQueryTraces.pop_front();
+  }
+}
+
+ScopedTraceSpan::ScopedTraceSpan(const char* stage)
+    : ScopedTraceSpan(stage, std::string()) {}
+
+ScopedTraceSpan::ScopedTraceSpan(const char* stage, const std::string& detail) {
+  if (kActiveTrace.trace == nullptr) {
+    return;
+  }
+
+  stage_ = stage;
+  detail_ = detail;
+  start_ = std::chrono::steady_clock::now();
+}
+
+ScopedTraceSpan::~ScopedTraceSpan() {
+  if (stage_ == nullptr || kActiveTrace.trace == nullptr) {
+    return;
+  }
+
+  QueryTraceSpan span;
+  span.stage = stage_;
+  span.detail = std::move(detail_);
+  span.start_us = elapsedUs(kActiveTrace.start, start_);
+  span.duration_us = elapsedUs(start_, std::chrono::steady_clock::now());
+  span.rows = rows_;
+  kActiveTrace.trace->spans.push_back(std::move(span));
+}
+
+void getQueryTraces(std::function<void(const QueryTrace&)> predicate) {
+  std::lock_guard<std::mutex> lock(kQueryTracesMutex);
+  for (const auto& trace : kQueryTraces) {
+    predicate(trace);
+  }
+}
+
+void resetQueryTraces() {
+  std::lock_guard<std::mutex> lock(kQueryTracesMutex);
+  kQueryTraces.clear();
+}
+
+Status serializeQueryTraceOTLP(const QueryTrace& trace, std::string& json) {
+  auto doc = JSON::newObject();
+
+  auto resource_attributes = doc.getArray();
+  addAttribute(doc, resource_attributes, "service.name", "osquery");
+  addAttribute(doc, resource_attributes, "host.name", getHostname());
+  auto resource = doc.getObject();
+  doc.add("attributes", resource_attributes, resource);
+
+  auto spans = doc.getArray();
+  auto root_id = spanId(trace, 0);
+  auto root_attributes = doc.getArray();
+  addAttribute(doc, root_attributes, "osquery.query.kind", trace.kind);
+  addAttribute(doc, root_attributes, "osquery.query.name", trace.name);
+  addSpan(doc,
+          spans,
+          trace,
+          root_id,
+          "",
+          trace.kind + " " + trace.name,
+          0,
+          trace.duration_us,
+          root_attributes);
+
+  for (size_t i = 0; i < trace.spans.size(); ++i) {
+    const auto& span = trace.spans[i];
+    auto attributes = doc.getArray();
+    if (!span.detail.empty()) {
+      addAttribute(doc, attributes, "osquery.table", span.detail);
+    }
+    if (span.rows > 0) {
+      addAttribute(doc, attributes, "osquery.rows", span.rows);
+    }
+    addSpan(doc,
+            spans,
+            trace,
+            spanId(trace, i + 1),
+            root_id,
+            span.stage,
+            span.start_us,
+            span.duration_us,
+            attributes);
+  }
+
+  auto scope = doc.getObject();
+  doc.add("name", "osquery", scope);
+  auto scope_spans = doc.getObject();
+  doc.add("scope", scope, scope_spans);
+  doc.add("spans", spans, scope_spans);
+  auto scope_spans_array = doc.getArray();
+  doc.push(scope_spans, scope_spans_array);
+
+  auto resource_spans = doc.getObject();
+  doc.add("resource", resource, resource_spans);
+  doc.add("scopeSpans", scope_spans_array, resource_spans);
+  auto resource_spans_array = doc.getArray();
+  doc.push(resource_spans, resource_spans_array);
+  doc.add("resourceSpans", resource_spans_array);
+
+  return doc.toString(json);
+}
+
+} // namespace osquery
@@ -0,0 +1,114 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// A stage of a traced query execution.
+struct QueryTraceSpan {
+  /// The stage, such as "prepare", "step", "generate", "diff" or "log".
+  std::string stage;
+
+  /// The table of a "generate" span, empty otherwise.
+  std::string detail;
+
+  /// Start of the stage in microseconds after the execution started.
+  std::uint64_t start_us{0};
+  std::uint64_t duration_us{0};
+
+  /// Rows produced by the stage, when it produces rows.
+  std::uint64_t rows{0};
+};
+
+/// The spans of a sampled scheduled or distributed query execution.
+struct QueryTrace {
+  /// The 128-bit trace identifier as 32 hex characters.
+  std::string trace_id;
+
+  /// Either "scheduled" or "distributed".
+  std::string kind;
+
+  /// The scheduled query name or distributed request id.
+  std::string name;
+
+  /// Unix time in microseconds when the execution started.
+  std::uint64_t start_time_us{0};
+  std::uint64_t duration_us{0};
+
+  /// Spans in the order they ended, nested stages end first.
+  std::vector<QueryTraceSpan> spans;
+};
+
+/**
+ * @brief Trace a query execution on the calling thread, if it is sampled.
+ *
+ * One in --query_trace_sample executions is traced, none by default. While
+ * a trace is active, ScopedTraceSpan%s on the same thread add spans to it.
+ * Finished traces are kept in a ring buffer of --query_trace_buffer_size
+ * traces and reported by the osquery_query_traces table. With
+ * --query_trace_otlp_path each trace is also appended to a file as one line
+ * of OTLP/JSON, which an OpenTelemetry collector can import.
+ *
+ * An execution started while another is traced on the thread, such as the
+ * snapshot queries of the scheduler, adds its spans to the outer trace.
+ */
+class ScopedQueryTrace final {
+ public:
+  ScopedQueryTrace(const char* kind, const std::string& name);
+  ~ScopedQueryTrace();
+
+  ScopedQueryTrace(const ScopedQueryTrace&) = delete;
+  ScopedQueryTrace& operator=(const ScopedQueryTrace&) = delete;
+
+ private:
+  std::unique_ptr<QueryTrace> trace_;
+};
+
+/// Add the time of a scope to the trace active on the calling thread.
+class ScopedTraceSpan final {
+ public:
+  explicit ScopedTraceSpan(const char* stage);
+  ScopedTraceSpan(const char* stage, const std::string& detail);
+  ~ScopedTraceSpan();
+
+  /// Count the rows produced by the stage.
+  void setRows(std::uint64_t rows) {
+    rows_ = rows;
+  }
+
+  ScopedTraceSpan(const ScopedTraceSpan&) = delete;
+  ScopedTraceSpan& operator=(const ScopedTraceSpan&) = delete;
+
+ private:
+  const char* stage_{nullptr};
+  std::string detail_;
+  std::chrono::steady_clock::time_point start_;
+  std::uint64_t rows_{0};
+};
+
+/// Visit the traces kept in the ring buffer, the oldest first.
+void getQueryTraces(std::function<void(const QueryTrace&)> predicate);
+
+/// Remove all traces kept in the ring buffer.
+void resetQueryTraces();
+
+/// Serialize a trace as an OTLP/JSON ExportTraceServiceRequest.
+Status serializeQueryTraceOTLP(const QueryTrace& trace, std::string& json);
+
+} // namespace osquery
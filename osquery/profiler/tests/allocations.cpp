@@ -0,0 +1,55 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include <osquery/profiler/allocations.h>
+
+namespace osquery {
+
+class AllocationsTests : public testing::Test {};
+
+TEST_F(AllocationsTests, test_not_counted) {
+  // The tests do not link the allocation hooks.
+  EXPECT_FALSE(allocationsCounted());
+
+  ScopedAllocationAccount account;
+  auto data = std::make_unique<char[]>(4096);
+  EXPECT_EQ(account.allocations(), 0U);
+  EXPECT_EQ(account.allocated(), 0U);
+  EXPECT_EQ(account.peak(), 0U);
+}
+
+TEST_F(AllocationsTests, test_nested_accounts) {
+  ScopedAllocationAccount outer;
+  countAllocation(100);
+  {
+    ScopedAllocationAccount inner;
+    countAllocation(1000);
+    countDeallocation(1000);
+    countAllocation(200);
+    EXPECT_EQ(inner.allocations(), 2U);
+    EXPECT_EQ(inner.allocated(), 1200U);
+    EXPECT_EQ(inner.peak(), 1000U);
+  }
+  countDeallocation(300);
+
+  EXPECT_EQ(outer.allocated(), 1300U);
+  EXPECT_EQ(outer.peak(), 1100U);
+
+  // Freeing memory of another thread is not a negative peak.
+  ScopedAllocationAccount other;
+  countDeallocation(50);
+  EXPECT_EQ(other.peak(), 0U);
+  countAllocation(50);
+}
+
+} // namespace osquery
@@ -0,0 +1,75 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <chrono>
+#include <map>
+
+#include <gtest/gtest.h>
+
+#include <osquery/core/flags.h>
+#include <osquery/profiler/code_profiler.h>
+
+namespace osquery {
+
+DECLARE_bool(enable_profile);
+
+class ProfileTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    resetProfileStats();
+  }
+
+  void TearDown() override {
+    FLAGS_enable_profile = false;
+    resetProfileStats();
+  }
+
+  std::map<std::string, ProfileStats> stats() {
+    std::map<std::string, ProfileStats> results;
+    getProfileStats([&results](const std::string& subsystem,
+                               const std::string& name,
+                               const ProfileStats& stats) {
+      results[subsystem + "." + name] = stats;
+    });
+    return results;
+  }
+};
+
+TEST_F(ProfileTests, test_disabled) {
+  FLAGS_enable_profile = false;
+  { ScopedProfile profile("table", "processes"); }
+  EXPECT_TRUE(stats().empty());
+}
+
+TEST_F(ProfileTests, test_accumulate) {
+  FLAGS_enable_profile = true;
+  for (size_t i = 0; i < 3; ++i) {
+    ScopedProfile profile("table", "processes");
+
+    // Use some CPU time on this thread.
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(5);
+    volatile size_t spins = 0;
+    while (std::chrono::steady_clock::now() < end) {
+      spins = spins + 1;
+    }
+  }
+  { ScopedProfile profile("logger", "filesystem"); }
+
+  auto results = stats();
+  ASSERT_EQ(results.size(), 2U);
+  const auto& table = results["table.processes"];
+  EXPECT_EQ(table.calls, 3U);
+  EXPECT_GE(table.wall_time_us, 15000U);
+  EXPECT_GT(table.cpu_time_us, 0U);
+  EXPECT_GE(table.wall_time_us, table.max_wall_time_us);
+  EXPECT_GE(table.max_wall_time_us, 5000U);
+  EXPECT_EQ(results["logger.filesystem"].calls, 1U);
+}
+
+} // namespace osquery
@@ -0,0 +1,124 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <gtest/gtest.h>
+
+#include <osquery/core/flags.h>
+#include <osquery/profiler/query_trace.h>
+#include <osquery/utils/json/json.h>
+
+namespace osquery {
+
+DECLARE_uint64(query_trace_sample);
+DECLARE_uint64(query_trace_buffer_size);
+
+class QueryTraceTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    resetQueryTraces();
+  }
+
+  void TearDown() override {
+    FLAGS_query_trace_sample = 0;
+    FLAGS_query_trace_buffer_size = 256;
+    resetQueryTraces();
+  }
+
+  std::vector<QueryTrace> traces() {
+    std::vector<QueryTrace> results;
+    getQueryTraces(
+        [&results](const QueryTrace& trace) { results.push_back(trace); });
+    return results;
+  }
+};
+
+TEST_F(QueryTraceTests, test_disabled) {
+  {
+    ScopedQueryTrace trace("scheduled", "pack_test_query");
+    ScopedTraceSpan span("step");
+  }
+  EXPECT_TRUE(traces().empty());
+}
+
+TEST_F(QueryTraceTests, test_spans) {
+  FLAGS_query_trace_sample = 1;
+  {
+    ScopedQueryTrace trace("scheduled", "pack_test_query");
+    {
+      ScopedTraceSpan step("step");
+      {
+        ScopedTraceSpan generate("generate", "time");
+        generate.setRows(1);
+      }
+      step.setRows(1);
+    }
+    ScopedTraceSpan diff("diff");
+  }
+
+  // Spans outside of a trace are ignored.
+  { ScopedTraceSpan span("step"); }
+
+  auto results = traces();
+  ASSERT_EQ(results.size(), 1U);
+  const auto& trace = results[0];
+  EXPECT_EQ(trace.kind, "scheduled");
+  EXPECT_EQ(trace.name, "pack_test_query");
+  EXPECT_EQ(trace.trace_id.size(), 32U);
+  ASSERT_EQ(trace.spans.size(), 3U);
+  EXPECT_EQ(trace.spans[0].stage, "generate");
+  EXPECT_EQ(trace.spans[0].detail, "time");
+  EXPECT_EQ(trace.spans[0].rows, 1U);
+  EXPECT_EQ(trace.spans[1].stage, "step");
+  EXPECT_LE(trace.spans[1].start_us, trace.spans[0].start_us);
+  EXPECT_EQ(trace.spans[2].stage, "diff");
+  EXPECT_GE(trace.duration_us, trace.spans[1].duration_us);
+}
+
+TEST_F(QueryTraceTests, test_sampling_and_buffer) {
+  FLAGS_query_trace_sample = 2;
+  FLAGS_query_trace_buffer_size = 2;
+  for (size_t i = 0; i < 8; ++i) {
+    ScopedQueryTrace trace("distributed", std::to_string(i));
+  }
+
+  // Four executions were traced, the last two are kept.
+  auto results = traces();
+  ASSERT_EQ(results.size(), 2U);
+  EXPECT_EQ(std::stoul(results[1].name) - std::stoul(results[0].name), 2U);
+}
+
+TEST_F(QueryTraceTests, test_otlp) {
+  QueryTrace trace;
+  trace.trace_id = "0123456789abcdef0123456789abcdef";
+  trace.kind = "scheduled";
+  trace.name = "pack_test_query";
+  trace.start_time_us = 1000;
+  trace.duration_us = 10;
+  trace.spans.push_back({"generate", "time", 2, 3, 1});
+
+  std::string json;
+  ASSERT_TRUE(serializeQueryTraceOTLP(trace, json).ok());
+
+  auto doc = JSON::newObject();
+  ASSERT_TRUE(doc.fromString(json).ok());
+  const auto& spans =
+      doc.doc()["resourceSpans"][0]["scopeSpans"][0]["spans"].GetArray();
+  ASSERT_EQ(spans.Size(), 2U);
+  EXPECT_STREQ(spans[0]["traceId"].GetString(), trace.trace_id.c_str());
+  EXPECT_STREQ(spans[0]["startTimeUnixNano"].GetString(), "1000000");
+  EXPECT_STREQ(spans[0]["endTimeUnixNano"].GetString(), "1010000");
+  EXPECT_FALSE(spans[0].HasMember("parentSpanId"));
+  EXPECT_STREQ(spans[1]["name"].GetString(), "generate");
+  EXPECT_STREQ(spans[1]["parentSpanId"].GetString(),
+               spans[0]["spanId"].GetString());
+  EXPECT_STREQ(spans[1]["startTimeUnixNano"].GetString(), "1002000");
+  EXPECT_STREQ(spans[1]["endTimeUnixNano"].GetString(), "1005000");
+}
+
+} // namespace osquery
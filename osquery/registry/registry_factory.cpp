@@ -141,6 +141,7 @@ Status RegistryFactory::removeBroadcast(const RouteUUID& uuid) {
   for (const auto& registry : registries_) {
     registry.second->removeExternal(uuid);
   }
+  resetExtensionConnections(uuid);
 
   WriteLock lock(mutex_);
   extensions_.erase(uuid);
@@ -86,6 +86,25 @@ class RegistryFactory : private boost::noncopyable {
   PluginRef plugin(const std::string& registry_name,
                    const std::string& item_name) const;
 
+  /**
+   * @brief Typed access to a plugin implemented within this process.
+   *
+   * Internal callers use the plugin's methods directly, without building a
+   * PluginRequest for the plugin to parse. A plugin within an extension is
+   * not returned, it must be called with a request.
+   *
+   * @return The plugin, or nullptr if it is not local or not a PluginType.
+   */
+  template <class PluginType>
+  std::shared_ptr<PluginType> localPlugin(const std::string& registry_name,
+                                          const std::string& item_name) const {
+    if (!exists(registry_name)) {
+      return nullptr;
+    }
+    return std::dynamic_pointer_cast<PluginType>(
+        plugin(registry_name, item_name));
+  }
+
   /// Serialize this core or extension's registry.
   RegistryBroadcast getBroadcast();
 
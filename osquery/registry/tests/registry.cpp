@@ -144,6 +144,27 @@ TEST_F(RegistryTests, test_persistent_registries) {
   EXPECT_EQ(TestCoreRegistry::get().count("cat"), 1U);
 }
 
+TEST_F(RegistryTests, test_local_plugin) {
+  TestCoreRegistry::get().add(
+      "kitten", std::make_shared<RegistryType<CatPlugin>>("kitten"));
+  TestCoreRegistry::get().registry("kitten")->add(
+      "house", std::make_shared<HouseCat>());
+
+  // A local plugin is returned with its type, for direct calls.
+  auto cat =
+      TestCoreRegistry::get().localPlugin<CatPlugin>("kitten", "house");
+  ASSERT_NE(cat, nullptr);
+  EXPECT_EQ(cat, TestCoreRegistry::get().plugin("kitten", "house"));
+
+  // Other types, names and registries are not.
+  EXPECT_EQ(TestCoreRegistry::get().localPlugin<DogPlugin>("kitten", "house"),
+            nullptr);
+  EXPECT_EQ(TestCoreRegistry::get().localPlugin<CatPlugin>("kitten", "tom"),
+            nullptr);
+  EXPECT_EQ(TestCoreRegistry::get().localPlugin<CatPlugin>("lion", "house"),
+            nullptr);
+}
+
 TEST_F(RegistryTests, test_registry_exceptions) {
   auto dog_registry = TestCoreRegistry::get().registry("dog");
   EXPECT_TRUE(dog_registry->add("doge2", std::make_shared<Doge>()).ok());
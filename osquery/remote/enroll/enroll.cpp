@@ -8,11 +8,13 @@
  */
 
 #include <boost/algorithm/string/trim.hpp>
+#include <boost/filesystem.hpp>
 
 #include <osquery/core/core.h>
 #include <osquery/core/flags.h>
 #include <osquery/database/database.h>
 #include <osquery/filesystem/filesystem.h>
+#include <osquery/logger/logger.h>
 #include <osquery/process/process.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/remote/enroll/enroll.h>
@@ -52,6 +54,17 @@ CLI_FLAG(bool,
          false,
          "Disable re-enrollment attempts if related plugins return invalid");
 
+/// Set for the workers of a sharded schedule, see worker_shards.
+HIDDEN_FLAG(string,
+            enroll_shared_node_key,
+            "",
+            "Path the primary worker shard shares its node key through");
+
+HIDDEN_FLAG(bool,
+            enroll_from_shared_node_key,
+            false,
+            "Use the node key of the primary worker shard, do not enroll");
+
 /**
  * @brief Enroll plugin registry.
  *
@@ -72,17 +85,69 @@ const std::set<std::string> kEnrollHostDetails{
 // re-enrollment at the same time.
 Mutex node_key_mutex;
 
+namespace {
+
+/// The config returned with the last enrollment, until it is taken.
+Mutex enroll_config_mutex;
+std::string enroll_config;
+bool has_enroll_config{false};
+
+/// The node key last written to the shared path.
+Mutex shared_node_key_mutex;
+std::string shared_node_key;
+
+/**
+ * @brief Share the node key of the primary worker with the other shards.
+ *
+ * Each shard keeps its own backing store, only the primary enrolls. The key
+ * is written beside the path and renamed so a shard never reads part of it.
+ */
+void shareNodeKey(const std::string& node_key) {
+  if (FLAGS_enroll_shared_node_key.empty() || node_key.empty()) {
+    return;
+  }
+
+  WriteLock lock(shared_node_key_mutex);
+  if (shared_node_key == node_key) {
+    return;
+  }
+
+  auto pending = FLAGS_enroll_shared_node_key + ".pending";
+  auto status =
+      writeTextFile(pending, node_key, 0600, PF_CREATE_ALWAYS | PF_WRITE);
+  boost::system::error_code ec;
+  if (status.ok()) {
+    boost::filesystem::rename(pending, FLAGS_enroll_shared_node_key, ec);
+  }
+  if (!status.ok() || ec) {
+    LOG(WARNING) << "Could not share the node key with the worker shards";
+    return;
+  }
+  shared_node_key = node_key;
+}
+
+} // namespace
+
 Status clearNodeKey() {
   WriteLock lock(node_key_mutex);
   return deleteDatabaseValue(kPersistentSettings, "nodeKey");
 }
 
 std::string getNodeKey(const std::string& enroll_plugin) {
-  UpgradeLock lock(node_key_mutex);
   std::string node_key;
+  if (FLAGS_enroll_from_shared_node_key) {
+    // The primary worker shard enrolls, a new node key is read when it
+    // enrolls again.
+    readFile(FLAGS_enroll_shared_node_key, node_key);
+    boost::trim(node_key);
+    return node_key;
+  }
+
+  UpgradeLock lock(node_key_mutex);
   getDatabaseValue(kPersistentSettings, "nodeKey", node_key);
   if (node_key.size() > 0) {
     // A non-empty node key was found in the backing-store (cache).
+    shareNodeKey(node_key);
     return node_key;
   }
 
@@ -99,10 +164,29 @@ std::string getNodeKey(const std::string& enroll_plugin) {
     setDatabaseValue(kPersistentSettings, "nodeKey", node_key);
     // Set the last time a nodeKey was requested from an enrollment endpoint.
     setDatabaseValue(kPersistentSettings, "nodeKeyTime", request_time);
+    shareNodeKey(node_key);
   }
   return node_key;
 }
 
+void setEnrollConfig(const std::string& config) {
+  WriteLock lock(enroll_config_mutex);
+  enroll_config = config;
+  has_enroll_config = true;
+}
+
+bool takeEnrollConfig(std::string& config) {
+  WriteLock lock(enroll_config_mutex);
+  if (!has_enroll_config) {
+    return false;
+  }
+
+  config = std::move(enroll_config);
+  enroll_config.clear();
+  has_enroll_config = false;
+  return true;
+}
+
 const std::string getEnrollSecret() {
   std::string enrollment_secret;
 
@@ -95,6 +95,22 @@ std::string getNodeKey(const std::string& enroll_plugin);
  */
 Status clearNodeKey();
 
+/**
+ * @brief Keep the config an enrollment returned with the node key.
+ *
+ * The config plugin of the same remote API takes it instead of requesting
+ * the config, which saves a request per host at startup.
+ */
+void setEnrollConfig(const std::string& config);
+
+/**
+ * @brief Take the config returned with the last enrollment.
+ *
+ * @param config The output config content.
+ * @return false if there is no config, or it was already taken.
+ */
+bool takeEnrollConfig(std::string& config);
+
 /**
  * @brief Read the enrollment secret from disk.
  *
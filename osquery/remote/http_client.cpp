@@ -10,7 +10,10 @@
 #include <osquery/logger/logger.h>
 #include <osquery/remote/http_client.h>
 
+#include <map>
+
 #include <boost/asio/connect.hpp>
+#include <boost/filesystem.hpp>
 
 namespace osquery {
 namespace http {
@@ -21,6 +24,62 @@ const std::string kProxyDefaultPort{"3128"};
 
 const long kSSLShortReadError{0x140000dbL};
 
+/// The cached TLS contexts are loaded again once there are this many.
+const size_t kMaxTLSContexts{16};
+
+/// Idle clients kept for each host, port and options.
+const size_t kMaxIdleClients{8};
+
+/// Idle connections are closed before most servers close them.
+const std::chrono::seconds kIdleClientTimeout{60};
+
+/**
+ * @brief A TLS context shared by the connections with the same TLS options.
+ *
+ * It holds the loaded CA bundle and client certificate, and the last session
+ * of each remote host, resumed by new connections to skip a full handshake.
+ */
+struct TLSContext {
+  TLSContext() : ctx(boost::asio::ssl::context::sslv23) {}
+
+  boost::asio::ssl::context ctx;
+
+  /// Protects the sessions.
+  std::mutex mutex;
+  std::map<std::string, std::shared_ptr<SSL_SESSION>> sessions;
+};
+
+namespace {
+
+std::mutex kTLSContextsMutex;
+std::map<std::string, std::shared_ptr<TLSContext>> kTLSContexts;
+
+/// A file with its modification time, so a changed file is loaded again.
+std::string getFileVersion(const boost::optional<std::string>& path) {
+  if (!path) {
+    return std::string();
+  }
+
+  boost::system::error_code ec;
+  auto time = boost::filesystem::last_write_time(*path, ec);
+  return *path + '@' + std::to_string(ec ? 0 : time);
+}
+
+std::string getPoolKey(Request& req) {
+  auto protocol = (req.protocol()) ? *req.protocol() : std::string("http");
+  std::string port;
+  if (req.remotePort()) {
+    port = *req.remotePort();
+  } else {
+    port = (protocol == "https") ? kHTTPSDefaultPort : kHTTPDefaultPort;
+  }
+
+  auto host = (req.remoteHost()) ? *req.remoteHost() : std::string();
+  return protocol + "://" + host + ':' + port;
+}
+
+} // namespace
+
 void Client::callNetworkOperation(std::function<void()> callback) {
   if (client_options_.timeout_) {
     timer_.async_wait(
@@ -138,6 +197,7 @@ void Client::createConnection() {
     throw std::system_error(ec_, error);
   }
 
+  connected_ = std::chrono::steady_clock::now();
   if (client_options_.keep_alive_) {
     boost::asio::socket_base::keep_alive option(true);
     sock_.set_option(option);
@@ -191,50 +251,110 @@ void Client::createConnection() {
   }
 }
 
-void Client::encryptConnection() {
-  boost::asio::ssl::context ctx{boost::asio::ssl::context::sslv23};
-
-  if (client_options_.always_verify_peer_) {
+void Client::loadTLSContext() {
+  const auto& options = client_options_;
+  auto key = std::to_string(options.always_verify_peer_) + '\n' +
+             std::to_string(options.ssl_options_) + '\n' +
+             options.ciphers_.value_or(std::string()) + '\n' +
+             getFileVersion(options.server_certificate_) + '\n' +
+             getFileVersion(options.verify_path_) + '\n' +
+             getFileVersion(options.client_certificate_file_) + '\n' +
+             getFileVersion(options.client_private_key_file_);
+
+  std::lock_guard<std::mutex> lock(kTLSContextsMutex);
+  auto it = kTLSContexts.find(key);
+  if (it != kTLSContexts.end()) {
+    tls_context_ = it->second;
+    return;
+  }
+
+  auto context = std::make_shared<TLSContext>();
+  auto& ctx = context->ctx;
+  if (options.always_verify_peer_) {
     ctx.set_verify_mode(boost::asio::ssl::verify_peer);
   } else {
     ctx.set_verify_mode(boost::asio::ssl::verify_none);
   }
 
-  if (client_options_.server_certificate_) {
+  if (options.server_certificate_) {
     ctx.set_verify_mode(boost::asio::ssl::verify_peer);
-    ctx.load_verify_file(*client_options_.server_certificate_);
+    ctx.load_verify_file(*options.server_certificate_);
   }
 
-  if (client_options_.verify_path_) {
+  if (options.verify_path_) {
     ctx.set_verify_mode(boost::asio::ssl::verify_peer);
-    ctx.add_verify_path(*client_options_.verify_path_);
+    ctx.add_verify_path(*options.verify_path_);
   }
 
-  if (client_options_.ciphers_) {
-    ::SSL_CTX_set_cipher_list(ctx.native_handle(),
-                              client_options_.ciphers_->c_str());
+  if (options.ciphers_) {
+    ::SSL_CTX_set_cipher_list(ctx.native_handle(), options.ciphers_->c_str());
   }
 
-  if (client_options_.ssl_options_) {
-    ctx.set_options(client_options_.ssl_options_);
+  if (options.ssl_options_) {
+    ctx.set_options(options.ssl_options_);
   }
 
-  if (client_options_.client_certificate_file_) {
-    ctx.use_certificate_chain_file(*client_options_.client_certificate_file_);
+  if (options.client_certificate_file_) {
+    ctx.use_certificate_chain_file(*options.client_certificate_file_);
   }
 
-  if (client_options_.client_private_key_file_) {
-    ctx.use_private_key_file(*client_options_.client_private_key_file_,
+  if (options.client_private_key_file_) {
+    ctx.use_private_key_file(*options.client_private_key_file_,
                              boost::asio::ssl::context::pem);
   }
 
-  ssl_sock_ = std::make_shared<ssl_stream>(sock_, ctx);
+  // Contexts of replaced files are never used again.
+  if (kTLSContexts.size() >= kMaxTLSContexts) {
+    kTLSContexts.clear();
+  }
+  kTLSContexts.emplace(std::move(key), context);
+  tls_context_ = std::move(context);
+}
+
+std::string Client::getTLSSessionKey() const {
+  return *client_options_.remote_hostname_ + ':' +
+         *client_options_.remote_port_;
+}
+
+void Client::resumeTLSSession() {
+  std::lock_guard<std::mutex> lock(tls_context_->mutex);
+  auto it = tls_context_->sessions.find(getTLSSessionKey());
+  if (it != tls_context_->sessions.end()) {
+    ::SSL_set_session(ssl_sock_->native_handle(), it->second.get());
+  }
+}
+
+void Client::saveTLSSession() {
+  // TLS 1.3 sessions are sent after the handshake, they are kept once the
+  // first response was read.
+  auto session = ::SSL_get1_session(ssl_sock_->native_handle());
+  if (session == nullptr) {
+    return;
+  }
+
+  std::shared_ptr<SSL_SESSION> owned(session, ::SSL_SESSION_free);
+  if (!::SSL_SESSION_is_resumable(session)) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(tls_context_->mutex);
+  tls_context_->sessions[getTLSSessionKey()] = std::move(owned);
+  tls_session_saved_ = true;
+}
+
+void Client::encryptConnection() {
+  loadTLSContext();
+
+  ssl_sock_ = std::make_shared<ssl_stream>(sock_, tls_context_->ctx);
   ::SSL_set_tlsext_host_name(ssl_sock_->native_handle(),
                              client_options_.remote_hostname_->c_str());
 
   ssl_sock_->set_verify_callback(boost::asio::ssl::rfc2818_verification(
       *client_options_.remote_hostname_));
 
+  resumeTLSSession();
+  tls_session_saved_ = false;
+
   callNetworkOperation([&]() {
     ssl_sock_->async_handshake(
         boost::asio::ssl::stream_base::client,
@@ -242,6 +362,9 @@ void Client::encryptConnection() {
   });
 
   if (ec_) {
+    // The next connection starts a new session.
+    std::lock_guard<std::mutex> lock(tls_context_->mutex);
+    tls_context_->sessions.erase(getTLSSessionKey());
     throw std::system_error(ec_);
   }
 }
@@ -391,6 +514,9 @@ Response Client::sendHTTPRequest(Request& req) {
 
       if (client_options_.ssl_connection_) {
         sendRequest(*ssl_sock_, req, resp);
+        if (!tls_session_saved_) {
+          saveTLSSession();
+        }
       } else {
         sendRequest(sock_, req, resp);
       }
@@ -399,7 +525,6 @@ Response Client::sendHTTPRequest(Request& req) {
       case beast_http::status::moved_permanently:
       case beast_http::status::found:
       case beast_http::status::see_other:
-      case beast_http::status::not_modified:
       case beast_http::status::use_proxy:
       case beast_http::status::temporary_redirect:
       case beast_http::status::permanent_redirect: {
@@ -511,5 +636,134 @@ Response Client::delete_(Request& req) {
   req.method(beast_http::verb::delete_);
   return sendHTTPRequest(req);
 }
+
+InstanceMetadataCache& InstanceMetadataCache::get() {
+  static InstanceMetadataCache cache;
+  return cache;
+}
+
+Status InstanceMetadataCache::fetch(const std::string& key,
+                                    const Fetcher& fetcher,
+                                    std::string& body,
+                                    std::chrono::seconds ttl) {
+  auto now = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto entry = entries_.find(key);
+    if (entry != entries_.end() && now < entry->second.expires) {
+      body = entry->second.body;
+      return Status::success();
+    }
+  }
+
+  // Requests are sent without the lock, a slow endpoint does not hold back
+  // the others.
+  std::string fetched;
+  auto status = fetcher(fetched);
+  if (!status.ok()) {
+    return status;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_[key] = {fetched, now + ttl};
+  body = std::move(fetched);
+  return Status::success();
+}
+
+void InstanceMetadataCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+}
+
+ClientPool& ClientPool::get() {
+  static ClientPool pool;
+  return pool;
+}
+
+std::shared_ptr<Client> ClientPool::acquire(Request& req,
+                                            Client::Options const& options) {
+  auto key = getPoolKey(req);
+
+  std::unique_ptr<Client> client;
+  std::vector<std::unique_ptr<Client>> expired;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    expire(expired);
+
+    // The most recently used connection is the least likely to be closed.
+    for (auto it = idle_.rbegin(); it != idle_.rend(); ++it) {
+      if (it->key == key && it->options == options) {
+        client = std::move(it->client);
+        idle_.erase(std::next(it).base());
+        break;
+      }
+    }
+  }
+
+  if (client == nullptr) {
+    client = std::make_unique<Client>(options);
+  }
+
+  return std::shared_ptr<Client>(
+      client.release(), [key, options](Client* released) {
+        ClientPool::get().release(
+            key, options, std::unique_ptr<Client>(released));
+      });
+}
+
+void ClientPool::release(const std::string& key,
+                         Client::Options const& options,
+                         std::unique_ptr<Client> client) {
+  // Clients without keep-alive closed their connection after the request.
+  if (!client->isSocketOpen()) {
+    return;
+  }
+
+  // Clients are closed after the lock is released.
+  std::vector<std::unique_ptr<Client>> expired;
+  std::lock_guard<std::mutex> lock(mutex_);
+  idle_.push_back(
+      {key, options, std::move(client), std::chrono::steady_clock::now()});
+  expire(expired);
+
+  size_t count = 0;
+  for (auto it = idle_.rbegin(); it != idle_.rend();) {
+    if (it->key == key && ++count > kMaxIdleClients) {
+      expired.push_back(std::move(it->client));
+      it = std::make_reverse_iterator(idle_.erase(std::next(it).base()));
+    } else {
+      ++it;
+    }
+  }
+}
+
+void ClientPool::expire(std::vector<std::unique_ptr<Client>>& expired) {
+  auto now = std::chrono::steady_clock::now();
+  for (auto it = idle_.begin(); it != idle_.end();) {
+    if (now - it->released > kIdleClientTimeout ||
+        (max_age_.count() > 0 && now - it->client->connected_ > max_age_)) {
+      expired.push_back(std::move(it->client));
+      it = idle_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void ClientPool::setMaxAge(std::chrono::seconds max_age) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  max_age_ = max_age;
+}
+
+size_t ClientPool::idleClients() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return idle_.size();
+}
+
+void ClientPool::clear() {
+  std::deque<IdleClient> idle;
+  std::lock_guard<std::mutex> lock(mutex_);
+  idle.swap(idle_);
+}
 } // namespace http
 } // namespace osquery
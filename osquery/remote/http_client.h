@@ -20,10 +20,15 @@
 #define OPENSSL_NO_MD5 1
 #define OPENSSL_NO_DEPRECATED 1
 
-#ifdef WIN32
-// For std:call_once, used below
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
 #include <mutex>
-#endif
+#include <string>
+#include <vector>
 
 // clang-format off
 // Keep it on top of all other includes to fix double include WinSock.h header file
@@ -36,12 +41,14 @@
 
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
+#include <boost/noncopyable.hpp>
 #include <boost/optional/optional.hpp>
 
 #include <openssl/crypto.h>
 #include <openssl/ssl.h>
 
 #include <osquery/remote/uri.h>
+#include <osquery/utils/status/status.h>
 
 namespace beast_http = boost::beast::http;
 
@@ -66,6 +73,8 @@ class HTTP_Response;
 typedef HTTP_Request<beast_http_request> Request;
 typedef HTTP_Response<beast_http_response> Response;
 
+struct TLSContext;
+
 /**
  * @brief A simple HTTP client class based upon Boost.Beast.
  *        This General-purpose HTTP Client allows HTTP and HTTPS.
@@ -166,7 +175,7 @@ class Client {
       return *this;
     }
 
-    bool operator==(Options const& ropts) {
+    bool operator==(Options const& ropts) const {
       return (server_certificate_ == ropts.server_certificate_) &&
              (verify_path_ == ropts.verify_path_) &&
              (client_certificate_file_ == ropts.client_certificate_file_) &&
@@ -216,9 +225,18 @@ class Client {
   }
 
   void setOptions(Options const& opts) {
-    new_client_options_ = !(client_options_ == opts);
+    // Requests naming their host set the remote options, an open connection
+    // is only reused if the rest of the options are the same.
+    auto options = opts;
+    if (!options.remote_hostname_) {
+      options.remote_hostname_ = client_options_.remote_hostname_;
+      options.remote_port_ = client_options_.remote_port_;
+      options.ssl_connection_ = client_options_.ssl_connection_;
+    }
+
+    new_client_options_ = !(client_options_ == options);
     if (new_client_options_) {
-      client_options_ = opts;
+      client_options_ = options;
     }
   }
 
@@ -262,6 +280,18 @@ class Client {
   /// Convert plain socket to TLS socket.
   void encryptConnection();
 
+  /// Use the shared TLS context of the options, loading it if needed.
+  void loadTLSContext();
+
+  /// Offer the last session of the remote host in the handshake.
+  void resumeTLSSession();
+
+  /// Keep the session of the connection for the next handshakes.
+  void saveTLSSession();
+
+  /// The key of the sessions of the remote host.
+  std::string getTLSSessionKey() const;
+
   template <typename STREAM_TYPE>
   void sendRequest(STREAM_TYPE& stream,
                    Request& req,
@@ -330,9 +360,123 @@ class Client {
   boost::asio::ip::tcp::resolver r_;
   boost::asio::ip::tcp::socket sock_;
   boost::asio::deadline_timer timer_;
+  std::shared_ptr<TLSContext> tls_context_;
   std::shared_ptr<ssl_stream> ssl_sock_;
   boost::system::error_code ec_;
   bool new_client_options_{true};
+
+  /// When the connection was opened.
+  std::chrono::steady_clock::time_point connected_;
+
+  /// If the session of the TLS connection was kept.
+  bool tls_session_saved_{false};
+
+ private:
+  friend class ClientPool;
+};
+
+/**
+ * @brief Idle clients shared by the remote plugins.
+ *
+ * A keep-alive client leaves its connection open after a request. Returned to
+ * the pool, it is taken by the next request to the same host and port with
+ * the same options, whichever thread sends it. That request skips the DNS
+ * resolve, TCP connect and TLS handshake.
+ */
+class ClientPool : private boost::noncopyable {
+ public:
+  static ClientPool& get();
+
+  /**
+   * @brief Take an idle client for a request, or create one.
+   *
+   * The client returns to the pool once it is released, if its connection is
+   * still open.
+   *
+   * @param req The request, its URI selects the host and port.
+   * @param options The options of the client.
+   */
+  std::shared_ptr<Client> acquire(Request& req, Client::Options const& options);
+
+  /// Set the max age of a pooled connection, 0 for no limit.
+  void setMaxAge(std::chrono::seconds max_age);
+
+  /// The number of idle clients.
+  size_t idleClients();
+
+  /// Close the idle clients.
+  void clear();
+
+ private:
+  ClientPool() = default;
+
+  /// Keep a client with an open connection for the next request.
+  void release(const std::string& key,
+               Client::Options const& options,
+               std::unique_ptr<Client> client);
+
+  /// Remove the idle clients that expired.
+  void expire(std::vector<std::unique_ptr<Client>>& expired);
+
+ private:
+  struct IdleClient {
+    std::string key;
+    Client::Options options;
+    std::unique_ptr<Client> client;
+    std::chrono::steady_clock::time_point released;
+  };
+
+  /// Idle clients, the most recently released last.
+  std::deque<IdleClient> idle_;
+
+  std::chrono::seconds max_age_{0};
+
+  std::mutex mutex_;
+};
+
+/**
+ * @brief Responses of the instance metadata services, shared by the cloud
+ * tables and utilities.
+ *
+ * The metadata of an instance rarely changes, while decorators and packs
+ * query the cloud tables often. A body is kept for the TTL chosen by the
+ * caller for its endpoint, failed requests are not kept.
+ */
+class InstanceMetadataCache : private boost::noncopyable {
+ public:
+  static InstanceMetadataCache& get();
+
+  /// Request a body, returns a failure if it should not be kept.
+  using Fetcher = std::function<Status(std::string& body)>;
+
+  /**
+   * @brief Get the body kept for a key, or fetch and keep it.
+   *
+   * @param key The endpoint, usually its URL.
+   * @param fetcher Requests the body when none is kept.
+   * @param body The output body.
+   * @param ttl How long the body is kept.
+   */
+  Status fetch(const std::string& key,
+               const Fetcher& fetcher,
+               std::string& body,
+               std::chrono::seconds ttl);
+
+  /// Forget the kept bodies.
+  void clear();
+
+ private:
+  InstanceMetadataCache() = default;
+
+ private:
+  struct Entry {
+    std::string body;
+    std::chrono::steady_clock::time_point expires;
+  };
+
+  std::map<std::string, Entry> entries_;
+
+  std::mutex mutex_;
 };
 
 /**
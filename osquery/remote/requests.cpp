@@ -7,16 +7,49 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <string>
 
 #include <zlib.h>
+#include <zstd.h>
+
+#include <osquery/remote/requests.h>
 
 namespace osquery {
 
 #define MOD_GZIP_ZLIB_WINDOWSIZE 15
 #define MOD_GZIP_ZLIB_CFACTOR 9
 
+/// The zstd level of request bodies, the zstd default.
+const int kRequestZstdLevel = 3;
+
+namespace {
+
+/// A digested dictionary, shared by the requests compressing with it.
+struct CompressionDictionary {
+  explicit CompressionDictionary(ZSTD_CDict* dictionary) : cdict(dictionary) {}
+
+  ~CompressionDictionary() {
+    ZSTD_freeCDict(cdict);
+  }
+
+  ZSTD_CDict* cdict;
+};
+
+std::mutex kCompressionDictionaryMutex;
+std::shared_ptr<CompressionDictionary> kCompressionDictionary;
+
+std::shared_ptr<CompressionDictionary> getCompressionDictionary() {
+  std::lock_guard<std::mutex> lock(kCompressionDictionaryMutex);
+  return kCompressionDictionary;
+}
+
+} // namespace
+
 std::string compressString(const std::string& data) {
   z_stream zs;
   memset(&zs, 0, sizeof(zs));
@@ -56,4 +89,75 @@ std::string compressString(const std::string& data) {
 
   return output;
 }
+
+std::string compressStringZstd(const std::string& data) {
+  // The context of the thread is reused, each frame starts from a reset.
+  thread_local std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> cctx(
+      ZSTD_createCCtx(), ZSTD_freeCCtx);
+  if (cctx == nullptr) {
+    return std::string();
+  }
+
+  std::string output;
+  output.resize(ZSTD_compressBound(data.size()));
+
+  // Keep a reference, the dictionary may be replaced while compressing.
+  auto dictionary = getCompressionDictionary();
+  size_t size = 0;
+  if (dictionary != nullptr) {
+    size = ZSTD_compress_usingCDict(cctx.get(),
+                                    &output[0],
+                                    output.size(),
+                                    data.data(),
+                                    data.size(),
+                                    dictionary->cdict);
+  } else {
+    size = ZSTD_compressCCtx(cctx.get(),
+                             &output[0],
+                             output.size(),
+                             data.data(),
+                             data.size(),
+                             kRequestZstdLevel);
+  }
+
+  if (ZSTD_isError(size)) {
+    return std::string();
+  }
+
+  output.resize(size);
+  return output;
+}
+
+Status setCompressionDictionary(const std::string& dictionary) {
+  std::shared_ptr<CompressionDictionary> digested;
+  if (!dictionary.empty()) {
+    auto cdict = ZSTD_createCDict(
+        dictionary.data(), dictionary.size(), kRequestZstdLevel);
+    if (cdict == nullptr) {
+      return Status::failure("Cannot load the zstd dictionary");
+    }
+    digested = std::make_shared<CompressionDictionary>(cdict);
+  }
+
+  std::lock_guard<std::mutex> lock(kCompressionDictionaryMutex);
+  kCompressionDictionary = std::move(digested);
+  return Status::success();
+}
+
+bool hasCompressionDictionary() {
+  return getCompressionDictionary() != nullptr;
+}
+
+std::chrono::milliseconds getRetryDelay(size_t attempt,
+                                        std::chrono::milliseconds max) {
+  std::chrono::milliseconds delay = max;
+  attempt = std::max<size_t>(attempt, 1);
+  if (attempt < 32) {
+    delay = std::min(max, std::chrono::milliseconds(1000LL << (attempt - 1)));
+  }
+
+  static thread_local std::mt19937_64 generator{std::random_device{}()};
+  std::uniform_int_distribution<long long> jitter(0, delay.count() / 2);
+  return delay - std::chrono::milliseconds(jitter(generator));
 }
+} // namespace osquery
@@ -9,6 +9,11 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <map>
 #include <memory>
 #include <utility>
 #include <string>
@@ -23,6 +28,12 @@ namespace osquery {
 
 class Serializer;
 
+/// Status code of a request the server answered with 304 Not Modified.
+const int kRequestNotModified = 304;
+
+/// Max milliseconds between the attempts of a request.
+const int64_t kRequestMaxRetryDelay = 5 * 60 * 1000;
+
 /**
  * @brief Compress data using GZip.
  *
@@ -34,6 +45,42 @@ class Serializer;
  */
 std::string compressString(const std::string& data);
 
+/**
+ * @brief Compress data as a zstd frame.
+ *
+ * The dictionary set by setCompressionDictionary is used if there is one, a
+ * trained dictionary writes its ID in the frame header so the server can
+ * select the same dictionary to decompress.
+ *
+ * @param data The input container.
+ * @return The frame, empty if compression failed.
+ */
+std::string compressStringZstd(const std::string& data);
+
+/**
+ * @brief Set the zstd dictionary of compressed request bodies.
+ *
+ * @param dictionary A trained or raw content dictionary, empty to stop using
+ * a dictionary.
+ */
+Status setCompressionDictionary(const std::string& dictionary);
+
+/// Check if compressStringZstd uses a dictionary.
+bool hasCompressionDictionary();
+
+/**
+ * @brief Get the delay before the next attempt of a failed request.
+ *
+ * The delay doubles with every failed attempt, starting at 1 second, up to
+ * the max. Up to half of it is randomly taken off, so hosts failing at the
+ * same time, such as after a fleet-wide restart, do not retry at once.
+ *
+ * @param attempt The count of failed attempts, from 1.
+ * @param max The max delay.
+ */
+std::chrono::milliseconds getRetryDelay(size_t attempt,
+                                        std::chrono::milliseconds max);
+
 /**
  * @brief Abstract base class for remote transport implementations
  *
@@ -98,6 +145,18 @@ class Transport {
     return response_params_;
   }
 
+  /// Get the protocol status code of the response, 0 if there is none.
+  unsigned getResponseCode() const {
+    return response_code_;
+  }
+
+  /// Get a response header by case-insensitive name, empty if missing.
+  std::string getResponseHeader(std::string name) const {
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    auto it = response_headers_.find(name);
+    return (it != response_headers_.end()) ? it->second : "";
+  }
+
   template <typename T>
   void setOption(const std::string& name, const T& value) {
     options_.add(name, value);
@@ -121,6 +180,12 @@ class Transport {
   /// storage for response parameters
   JSON response_params_;
 
+  /// storage for the response status code
+  unsigned response_code_{0};
+
+  /// storage for the response headers, by lowercase name
+  std::map<std::string, std::string> response_headers_;
+
   /// options from request call (use defined by specific transport)
   JSON options_;
 };
@@ -250,6 +315,11 @@ class Request {
     return transport_->getResponseStatus();
   }
 
+  /// Get a header of the request response, empty if missing.
+  std::string getResponseHeader(const std::string& name) const {
+    return transport_->getResponseHeader(name);
+  }
+
   template <typename T>
   void setOption(const std::string& name, const T& value) {
     options_.add(name, value);
@@ -276,6 +346,7 @@ class Request {
   FRIEND_TEST(TLSTransportsTests, test_call_server_cert_pinning);
   FRIEND_TEST(TLSTransportsTests, test_call_client_auth);
   FRIEND_TEST(TLSTransportsTests, test_wrong_hostname);
+  FRIEND_TEST(TLSTransportsTests, test_call_reuses_connection);
 
   friend class TestDistributedPlugin;
 };
@@ -9,6 +9,8 @@
 
 #include <gtest/gtest.h>
 
+#include <zstd.h>
+
 #include <osquery/remote/requests.h>
 #include <osquery/remote/serializers/json.h>
 #include <osquery/remote/transports/tls.h>
@@ -177,4 +179,51 @@ TEST_F(RequestsTests, test_compression) {
   EXPECT_EQ(compressed.substr(10), expected2);
   EXPECT_LT(compressed.size(), uncompressed.size());
 }
+
+std::string decompressZstd(const std::string& frame,
+                           const std::string& dictionary) {
+  std::string output;
+  output.resize(ZSTD_getFrameContentSize(frame.data(), frame.size()));
+
+  auto dctx = ZSTD_createDCtx();
+  auto size = ZSTD_decompress_usingDict(dctx,
+                                        &output[0],
+                                        output.size(),
+                                        frame.data(),
+                                        frame.size(),
+                                        dictionary.data(),
+                                        dictionary.size());
+  ZSTD_freeDCtx(dctx);
+  if (ZSTD_isError(size)) {
+    return std::string();
+  }
+  output.resize(size);
+  return output;
+}
+
+TEST_F(RequestsTests, test_zstd_compression) {
+  std::string uncompressed =
+      R"({"name":"pack_incident_processes","hostIdentifier":"host",)"
+      R"("columns":{"pid":"1","path":"/sbin/launchd"},"action":"added"})";
+
+  auto compressed = compressStringZstd(uncompressed);
+  ASSERT_FALSE(compressed.empty());
+  EXPECT_EQ(uncompressed, decompressZstd(compressed, ""));
+
+  // A raw content dictionary of similar lines.
+  std::string dictionary =
+      R"({"name":"pack_incident_processes","hostIdentifier":"other",)"
+      R"("columns":{"pid":"2","path":"/sbin/init"},"action":"removed"})";
+  ASSERT_TRUE(setCompressionDictionary(dictionary).ok());
+  EXPECT_TRUE(hasCompressionDictionary());
+
+  auto with_dictionary = compressStringZstd(uncompressed);
+  ASSERT_FALSE(with_dictionary.empty());
+  EXPECT_LT(with_dictionary.size(), compressed.size());
+  EXPECT_EQ(uncompressed, decompressZstd(with_dictionary, dictionary));
+
+  ASSERT_TRUE(setCompressionDictionary("").ok());
+  EXPECT_FALSE(hasCompressionDictionary());
+  EXPECT_EQ(compressed, compressStringZstd(uncompressed));
 }
+} // namespace osquery
@@ -18,6 +18,7 @@
 #include <osquery/database/database.h>
 #include <osquery/logger/logger.h>
 #include <osquery/process/process.h>
+#include <osquery/remote/http_client.h>
 #include <osquery/remote/tests/test_utils.h>
 #include <osquery/sql/sql.h>
 #include <osquery/tests/test_util.h>
@@ -182,6 +183,9 @@ void TLSServerRunner::unsetClientConfig() {
 }
 
 void TLSServerRunner::stop() {
+  // Pooled connections to the server must not be reused by the next one.
+  http::ClientPool::get().clear();
+
   auto& self = instance();
   if (self.server_ != nullptr) {
     self.server_->kill();
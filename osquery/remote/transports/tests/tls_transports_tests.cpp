@@ -98,6 +98,63 @@ TEST_F(TLSTransportsTests, test_call) {
   EXPECT_TRUE(status.ok());
 }
 
+TEST_F(TLSTransportsTests, test_call_reuses_connection) {
+  startServer();
+  http::ClientPool::get().clear();
+
+  auto url = "https://localhost:" + port_;
+  for (size_t i = 0; i < 3; i++) {
+    auto t = std::make_shared<TLSTransport>();
+    t->disableVerifyPeer();
+    Request<TLSTransport, JSONSerializer> r(url, t);
+
+    Status status;
+    ASSERT_NO_THROW(status = r.call());
+    ASSERT_TRUE(status.ok()) << getTLSError(status);
+
+    // Every request takes the connection the previous one left open.
+    EXPECT_EQ(1U, http::ClientPool::get().idleClients());
+  }
+
+  http::ClientPool::get().clear();
+  EXPECT_EQ(0U, http::ClientPool::get().idleClients());
+}
+
+TEST_F(TLSTransportsTests, test_instance_metadata_cache) {
+  auto& cache = http::InstanceMetadataCache::get();
+  cache.clear();
+
+  size_t requests = 0;
+  auto fetcher = [&requests](std::string& body) {
+    requests++;
+    body = "metadata";
+    return Status::success();
+  };
+
+  std::string body;
+  for (size_t i = 0; i < 3; i++) {
+    ASSERT_TRUE(
+        cache.fetch("endpoint", fetcher, body, std::chrono::seconds(60)).ok());
+    EXPECT_EQ(body, "metadata");
+  }
+  EXPECT_EQ(requests, 1U);
+
+  // An expired body is requested again, a failure is not kept.
+  ASSERT_TRUE(
+      cache.fetch("expired", fetcher, body, std::chrono::seconds(0)).ok());
+  ASSERT_TRUE(
+      cache.fetch("expired", fetcher, body, std::chrono::seconds(0)).ok());
+  EXPECT_EQ(requests, 3U);
+
+  auto failing = [](std::string&) { return Status::failure("down"); };
+  EXPECT_FALSE(
+      cache.fetch("failing", failing, body, std::chrono::seconds(60)).ok());
+  ASSERT_TRUE(
+      cache.fetch("failing", fetcher, body, std::chrono::seconds(60)).ok());
+  EXPECT_EQ(requests, 4U);
+  cache.clear();
+}
+
 TEST_F(TLSTransportsTests, test_call_with_params) {
   startServer();
 
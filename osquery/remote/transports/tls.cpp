@@ -9,6 +9,7 @@
 
 #include "tls.h"
 
+#include <algorithm>
 #include <chrono>
 #include <osquery/core/core.h>
 #include <osquery/filesystem/filesystem.h>
@@ -75,6 +76,18 @@ HIDDEN_FLAG(bool,
 /// Undocumented feature to override TLS endpoints.
 HIDDEN_FLAG(bool, tls_node_api, false, "Use node key as TLS endpoints");
 
+/// Content encoding of the request bodies plugins ask to compress.
+FLAG(string,
+     tls_compression,
+     "gzip",
+     "Content encoding of compressed TLS/HTTPS request bodies (gzip, zstd)");
+
+/// Optional zstd dictionary, fetched by the plugins compressing requests.
+FLAG(string,
+     tls_compression_dictionary_endpoint,
+     "",
+     "TLS/HTTPS endpoint of a zstd dictionary for request bodies");
+
 DECLARE_bool(verbose);
 
 TLSTransport::TLSTransport() {
@@ -92,12 +105,28 @@ void TLSTransport::decorateRequest(http::Request& r) {
   r << http::Request::Header("Content-Type", serializer_->getContentType());
   r << http::Request::Header("Accept", serializer_->getContentType());
   r << http::Request::Header("User-Agent", kTLSUserAgentBase + kVersion);
+
+  // Conditional requests are answered with 304 if the content is unchanged.
+  auto it = options_.doc().FindMember("if_none_match");
+  if (it != options_.doc().MemberEnd() && it->value.IsString() &&
+      it->value.GetStringLength() > 0) {
+    r << http::Request::Header("If-None-Match", it->value.GetString());
+  }
 }
 
 http::Client::Options TLSTransport::getOptions() {
   http::Client::Options options;
 
-  options.follow_redirects(true).always_verify_peer(verify_peer_).timeout(16);
+  // Requests the server may hold, such as long polls, set a longer timeout.
+  int timeout = 16;
+  auto it = options_.doc().FindMember("timeout");
+  if (it != options_.doc().MemberEnd() && it->value.IsInt() &&
+      it->value.GetInt() > 0) {
+    timeout = it->value.GetInt();
+  }
+
+  options.follow_redirects(true).always_verify_peer(verify_peer_).timeout(
+      timeout);
 
   if (server_certificate_file_.size() > 0) {
     if (!osquery::isReadable(server_certificate_file_).ok()) {
@@ -182,34 +211,44 @@ inline bool tlsFailure(const std::string& what) {
   return true;
 }
 
-static auto getClient() {
-  std::shared_ptr<http::Client> client = nullptr;
-  if (FLAGS_tls_session_reuse) {
-    thread_local std::shared_ptr<http::Client> tl_client;
-    thread_local auto last_time_reseted = std::chrono::system_clock::now();
-    client = tl_client;
-
-    if (client.get() == nullptr) {
-      tl_client = client = std::make_shared<http::Client>();
-    }
-
-    if (FLAGS_tls_session_timeout > 0 &&
-        std::chrono::duration_cast<std::chrono::seconds>(
-            std::chrono::system_clock::now() - last_time_reseted)
-                .count() > FLAGS_tls_session_timeout) {
-      tl_client.reset();
-      last_time_reseted = std::chrono::system_clock::now();
-    }
-  } else {
-    client = std::make_shared<http::Client>();
+static std::shared_ptr<http::Client> getClient(
+    http::Request& r, const http::Client::Options& options) {
+  if (!FLAGS_tls_session_reuse) {
+    return std::make_shared<http::Client>(options);
   }
-  return client;
+
+  // Connections to the same host are shared by every plugin and thread.
+  auto& pool = http::ClientPool::get();
+  pool.setMaxAge(std::chrono::seconds(FLAGS_tls_session_timeout));
+  return pool.acquire(r, options);
 }
 
 void printRawStderr(const std::string& s) {
   fprintf(stderr, "%s\n", s.c_str());
 }
 
+Status TLSTransport::readResponse() {
+  response_code_ = response_.status();
+  response_headers_.clear();
+  for (const auto& header : response_.headers()) {
+    auto name = header.first;
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    response_headers_[name] = header.second;
+  }
+
+  const auto& response_body = response_.body();
+  if (FLAGS_verbose && FLAGS_tls_dump) {
+    // Not using VLOG to avoid logging whole body to logging destination.
+    printRawStderr(response_body);
+  }
+
+  if (response_code_ == 304) {
+    response_params_ = JSON::newObject();
+    return Status(kRequestNotModified, "Not modified");
+  }
+  return serializer_->deserialize(response_body, response_params_);
+}
+
 Status TLSTransport::sendRequest() {
   if (destination_.find("https://") == std::string::npos) {
     return Status::failure(
@@ -221,18 +260,9 @@ Status TLSTransport::sendRequest() {
 
   VLOG(1) << "TLS/HTTPS GET request to URI: " << destination_;
   try {
-    std::shared_ptr<http::Client> client = getClient();
-
-    client->setOptions(getInternalOptions());
+    auto client = getClient(r, getInternalOptions());
     response_ = client->get(r);
-
-    const auto& response_body = response_.body();
-    if (FLAGS_verbose && FLAGS_tls_dump) {
-      // Not using VLOG to avoid logging whole body to logging destination.
-      printRawStderr(response_body);
-    }
-    response_status_ =
-        serializer_->deserialize(response_body, response_params_);
+    response_status_ = readResponse();
   } catch (const std::exception& e) {
     return Status::failure(std::string("Request error: ") + e.what());
   }
@@ -247,9 +277,21 @@ Status TLSTransport::sendRequest(const std::string& params, bool compress) {
 
   http::Request r(destination_);
   decorateRequest(r);
+
+  // Later, when posting/putting, the data will be optionally compressed.
+  std::string body;
   if (compress) {
-    // Later, when posting/putting, the data will be optionally compressed.
-    r << http::Request::Header("Content-Encoding", "gzip");
+    if (FLAGS_tls_compression == "zstd") {
+      r << http::Request::Header("Content-Encoding", "zstd");
+      body = compressStringZstd(params);
+    } else {
+      r << http::Request::Header("Content-Encoding", "gzip");
+      body = compressString(params);
+    }
+
+    if (body.empty()) {
+      return Status::failure("Cannot compress the request body");
+    }
   }
 
   // Allow request calls to override the default HTTP POST verb.
@@ -268,22 +310,14 @@ Status TLSTransport::sendRequest(const std::string& params, bool compress) {
   }
 
   try {
-    std::shared_ptr<http::Client> client = getClient();
-    client->setOptions(getInternalOptions());
+    auto client = getClient(r, getInternalOptions());
 
     if (verb == HTTP_POST) {
-      response_ = client->post(r, (compress) ? compressString(params) : params);
+      response_ = client->post(r, (compress) ? body : params);
     } else {
-      response_ = client->put(r, (compress) ? compressString(params) : params);
-    }
-
-    const auto& response_body = response_.body();
-    if (FLAGS_verbose && FLAGS_tls_dump) {
-      // Not using VLOG to avoid logging whole body to logging destination.
-      printRawStderr(response_body);
+      response_ = client->put(r, (compress) ? body : params);
     }
-    response_status_ =
-        serializer_->deserialize(response_body, response_params_);
+    response_status_ = readResponse();
   } catch (const std::exception& e) {
     return Status::failure(std::string("Request error: ") + e.what());
   }
@@ -134,6 +134,14 @@ class TLSTransport : public Transport {
    */
   void decorateRequest(http::Request& r);
 
+  /**
+   * @brief Record and deserialize the response
+   *
+   * A 304 Not Modified response has no parameters, its status has the
+   * kRequestNotModified code.
+   */
+  Status readResponse();
+
  protected:
   /// Storage for the HTTP response object
   http::Response response_;
@@ -10,6 +10,7 @@
 #pragma once
 
 #include <chrono>
+#include <mutex>
 
 // clang-format off
 // Keep it on top of all other includes to fix double include WinSock.h header file
@@ -24,6 +25,7 @@
 
 #include <osquery/process/process.h>
 #include <osquery/remote/requests.h>
+#include <osquery/utils/base64.h>
 
 namespace osquery {
 
@@ -32,6 +34,8 @@ DECLARE_string(tls_hostname);
 DECLARE_bool(tls_node_api);
 DECLARE_bool(tls_secret_always);
 DECLARE_bool(disable_reenrollment);
+DECLARE_string(tls_compression);
+DECLARE_string(tls_compression_dictionary_endpoint);
 
 /**
  * @brief Helper class for allowing TLS plugins to easily kick off requests
@@ -69,16 +73,70 @@ class TLSRequestHelper : private boost::noncopyable {
     return uri;
   }
 
+  /**
+   * @brief Fetch the zstd dictionary of compressed request bodies.
+   *
+   * The dictionary is read once from tls_compression_dictionary_endpoint, as
+   * base64 in the "dictionary" member of the response. A failed fetch is
+   * tried again at most every 10 minutes, requests are compressed without a
+   * dictionary in between.
+   */
+  template <class TSerializer>
+  static Status loadCompressionDictionary() {
+    if (FLAGS_tls_compression != "zstd" ||
+        FLAGS_tls_compression_dictionary_endpoint.empty() ||
+        hasCompressionDictionary()) {
+      return Status::success();
+    }
+
+    static std::mutex mutex;
+    static std::chrono::steady_clock::time_point attempted;
+    static bool has_attempted{false};
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto now = std::chrono::steady_clock::now();
+    if (hasCompressionDictionary() ||
+        (has_attempted && now - attempted < std::chrono::minutes(10))) {
+      return Status::success();
+    }
+    has_attempted = true;
+    attempted = now;
+
+    JSON output;
+    auto uri = makeURI(FLAGS_tls_compression_dictionary_endpoint);
+    auto status = TLSRequestHelper::go<TSerializer>(uri, output);
+    if (status.ok()) {
+      auto it = output.doc().FindMember("dictionary");
+      if (it == output.doc().MemberEnd() || !it->value.IsString()) {
+        status = Status::failure("No dictionary received from remote endpoint");
+      } else {
+        auto dictionary = base64::decode(it->value.GetString());
+        status = dictionary.empty()
+                     ? Status::failure("Invalid dictionary received")
+                     : setCompressionDictionary(dictionary);
+      }
+    }
+
+    if (!status.ok()) {
+      LOG(WARNING) << "Cannot fetch the request compression dictionary: "
+                   << status.getMessage();
+    }
+    return status;
+  }
+
   /**
    * @brief Send a TLS request
    *
    * @param uri is the URI to send the request to
    * @param params is a JSON object containing the params to send to the server.
    * This isn't const because it will be modified to include node_key.
+   * An "_if_none_match" param makes the request conditional, and the ETag of
+   * the response, if any, is set as the "_etag" param.
    * @param output is the JSON which will be populated with the deserialized
    * results
    *
-   * @return a Status object indicating the success or failure of the operation
+   * @return a Status object indicating the success or failure of the
+   * operation, with the kRequestNotModified code if the content is unchanged
    */
   template <class TSerializer>
   static Status go(const std::string& uri, JSON& params, JSON& output) {
@@ -103,10 +161,34 @@ class TLSRequestHelper : private boost::noncopyable {
     auto it = params_doc.FindMember("_compress");
     if (it != params_doc.MemberEnd()) {
       compress = true;
+      loadCompressionDictionary<TSerializer>();
       request.setOption("compress", compress);
       params_doc.RemoveMember("_compress");
     }
 
+    // The entity tag of content the caller already has.
+    std::string if_none_match;
+    params_doc.RemoveMember("_etag");
+    it = params_doc.FindMember("_if_none_match");
+    if (it != params_doc.MemberEnd()) {
+      if (it->value.IsString()) {
+        if_none_match = it->value.GetString();
+        request.setOption("if_none_match", if_none_match);
+      }
+      params_doc.RemoveMember("_if_none_match");
+    }
+
+    // The server may hold the request for longer than the default timeout.
+    int timeout = 0;
+    it = params_doc.FindMember("_timeout");
+    if (it != params_doc.MemberEnd()) {
+      if (it->value.IsInt()) {
+        timeout = it->value.GetInt();
+        request.setOption("timeout", timeout);
+      }
+      params_doc.RemoveMember("_timeout");
+    }
+
     // The caller-supplied parameters may force a POST request.
     bool force_post = false;
     it = params_doc.FindMember("_verb");
@@ -135,6 +217,14 @@ class TLSRequestHelper : private boost::noncopyable {
       params.add("_compress", true);
     }
 
+    if (!if_none_match.empty()) {
+      params.add("_if_none_match", if_none_match);
+    }
+
+    if (timeout > 0) {
+      params.add("_timeout", timeout);
+    }
+
     if (!status.ok()) {
       return status;
     }
@@ -178,6 +268,10 @@ class TLSRequestHelper : private boost::noncopyable {
       return Status(1, message);
     }
 
+    auto etag = request.getResponseHeader("ETag");
+    if (!etag.empty()) {
+      params.add("_etag", etag);
+    }
     return Status::success();
   }
 
@@ -266,7 +360,7 @@ class TLSRequestHelper : private boost::noncopyable {
     bool should_shutdown = false;
     for (size_t i = 1; i <= attempts && !should_shutdown; i++) {
       s = TLSRequestHelper::go<TSerializer>(uri, params, output);
-      if (s.ok()) {
+      if (s.ok() || s.getCode() == kRequestNotModified) {
         return s;
       }
       if (i == attempts) {
@@ -276,8 +370,8 @@ class TLSRequestHelper : private boost::noncopyable {
         params.add(m.name.GetString(), m.value);
       }
 
-      should_shutdown =
-          waitTimeoutOrShutdown(std::chrono::milliseconds(i * i * 1000));
+      should_shutdown = waitTimeoutOrShutdown(
+          getRetryDelay(i, std::chrono::milliseconds(kRequestMaxRetryDelay)));
     }
     return s;
   }
@@ -0,0 +1,176 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <osquery/core/core.h>
+#include <osquery/sql/sql.h>
+
+#include "osquery/sql/sqlite_util.h"
+
+namespace osquery {
+
+/**
+ * @brief Call a SQL function once for each of the given number of rows.
+ *
+ * The rows come from a recursive common table expression, so the timings
+ * contain the cost of the function and of SQLite stepping, and no virtual
+ * table. The expression may use the row number as `i`. Only the count of
+ * the results is returned to keep the result rows out of the timings.
+ */
+static void runFunction(benchmark::State& state, const std::string& expr) {
+  auto rows = state.range(0);
+  auto query = "with recursive numbers(i) as (select 0 union all select i + 1 "
+               "from numbers where i < " +
+               std::to_string(rows - 1) + ") select count(" + expr +
+               ") from numbers";
+
+  auto dbc = SQLiteDBManager::getUnique();
+  while (state.KeepRunning()) {
+    QueryDataTyped results;
+    auto status = queryInternal(query, results, dbc);
+    if (!status.ok()) {
+      state.SkipWithError(status.getMessage().c_str());
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * rows);
+}
+
+/// A process command line, like those matched in process auditing queries.
+const std::string kCommandLine{
+    "'/usr/bin/python3 -m http.server --bind 127.0.0.1 ' || i"};
+
+static void SQL_function_split(benchmark::State& state) {
+  runFunction(state, "split(" + kCommandLine + ", ' ', 3)");
+}
+
+BENCHMARK(SQL_function_split)->Arg(1000)->Arg(100000);
+
+static void SQL_function_regex_split(benchmark::State& state) {
+  runFunction(state, "regex_split(" + kCommandLine + ", '[ -]+', 3)");
+}
+
+BENCHMARK(SQL_function_regex_split)->Arg(1000)->Arg(100000);
+
+static void SQL_function_regex_match(benchmark::State& state) {
+  runFunction(
+      state,
+      "regex_match(" + kCommandLine + ", '--bind ([0-9.]+) ([0-9]+)', 2)");
+}
+
+BENCHMARK(SQL_function_regex_match)->Arg(1000)->Arg(100000);
+
+static void SQL_function_regex_match_distinct(benchmark::State& state) {
+  // Each row uses one of 100 patterns, the cost of compiling a pattern is
+  // paid on every call unless compiled patterns are reused.
+  runFunction(state,
+              "regex_match(" + kCommandLine +
+                  ", '([0-9]+)' || (i % 100) || '?$', 1)");
+}
+
+BENCHMARK(SQL_function_regex_match_distinct)->Arg(1000)->Arg(100000);
+
+static void SQL_function_inet_aton(benchmark::State& state) {
+  runFunction(state, "inet_aton('10.0.' || (i % 256) || '.' || (i % 199))");
+}
+
+BENCHMARK(SQL_function_inet_aton)->Arg(1000)->Arg(100000);
+
+static void SQL_function_concat(benchmark::State& state) {
+  runFunction(state, "concat('pid:', i, ' path:', '/usr/bin/', i % 10)");
+}
+
+BENCHMARK(SQL_function_concat)->Arg(1000)->Arg(100000);
+
+static void SQL_function_concat_ws(benchmark::State& state) {
+  runFunction(state, "concat_ws(',', 'pid', i, '/usr/bin/', i % 10)");
+}
+
+BENCHMARK(SQL_function_concat_ws)->Arg(1000)->Arg(100000);
+
+static void SQL_function_md5(benchmark::State& state) {
+  runFunction(state, "md5(" + kCommandLine + ")");
+}
+
+BENCHMARK(SQL_function_md5)->Arg(1000)->Arg(100000);
+
+static void SQL_function_sha1(benchmark::State& state) {
+  runFunction(state, "sha1(" + kCommandLine + ")");
+}
+
+BENCHMARK(SQL_function_sha1)->Arg(1000)->Arg(100000);
+
+static void SQL_function_sha256(benchmark::State& state) {
+  runFunction(state, "sha256(" + kCommandLine + ")");
+}
+
+BENCHMARK(SQL_function_sha256)->Arg(1000)->Arg(100000);
+
+static void SQL_function_community_id_v1(benchmark::State& state) {
+  // Mix IPv4 and IPv6 flows like the process_open_sockets table.
+  runFunction(state,
+              "community_id_v1(case when i % 2 then '10.0.0.' || (i % 256) "
+              "else 'fe80::' || (i % 4096) end, case when i % 2 then "
+              "'192.168.1.1' else 'fe80::1' end, i % 65536, 443, 6)");
+}
+
+BENCHMARK(SQL_function_community_id_v1)->Arg(1000)->Arg(100000);
+
+static void SQL_function_to_base64(benchmark::State& state) {
+  runFunction(state, "to_base64(" + kCommandLine + ")");
+}
+
+BENCHMARK(SQL_function_to_base64)->Arg(1000)->Arg(100000);
+
+static void SQL_function_from_base64(benchmark::State& state) {
+  runFunction(state, "from_base64(to_base64(" + kCommandLine + "))");
+}
+
+BENCHMARK(SQL_function_from_base64)->Arg(1000)->Arg(100000);
+
+static void SQL_function_conditional_to_base64(benchmark::State& state) {
+  // Every tenth value is not printable and is encoded.
+  runFunction(state,
+              "conditional_to_base64(case when i % 10 then " + kCommandLine +
+                  " else char(1, 2, 3) || i end)");
+}
+
+BENCHMARK(SQL_function_conditional_to_base64)->Arg(1000)->Arg(100000);
+
+static void SQL_function_in_cidr_block(benchmark::State& state) {
+  runFunction(state,
+              "in_cidr_block('10.0.0.0/16', '10.0.' || (i % 512) || '.1')");
+}
+
+BENCHMARK(SQL_function_in_cidr_block)->Arg(1000)->Arg(100000);
+
+static void SQL_function_in_cidr_block_ipv6(benchmark::State& state) {
+  runFunction(state,
+              "in_cidr_block('2001:db8::/48', '2001:db8:' || (i % 2) || "
+              "'::' || (i % 4096))");
+}
+
+BENCHMARK(SQL_function_in_cidr_block_ipv6)->Arg(1000)->Arg(100000);
+
+static void SQL_function_math(benchmark::State& state) {
+  runFunction(state,
+              "sqrt(i) + log10(i + 1) + power(i % 10, 2) + floor(sin(i))");
+}
+
+BENCHMARK(SQL_function_math)->Arg(1000)->Arg(100000);
+
+static void SQL_function_baseline(benchmark::State& state) {
+  // The cost of stepping the rows, to subtract from the function timings.
+  runFunction(state, "i");
+}
+
+BENCHMARK(SQL_function_baseline)->Arg(1000)->Arg(100000);
+
+} // namespace osquery
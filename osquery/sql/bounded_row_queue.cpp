@@ -0,0 +1,68 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "bounded_row_queue.h"
+
+namespace osquery {
+
+BoundedRowQueue::BoundedRowQueue(size_t capacity)
+    : capacity_((capacity == 0) ? 1 : capacity) {}
+
+bool BoundedRowQueue::push(TableRowHolder row) {
+  WriteLock lock(mutex_);
+  not_full_.wait(lock,
+                 [this]() { return cancelled_ || rows_.size() < capacity_; });
+  if (cancelled_) {
+    return false;
+  }
+
+  rows_.push_back(std::move(row));
+  not_empty_.notify_one();
+  return true;
+}
+
+bool BoundedRowQueue::pop(TableRowHolder& row) {
+  WriteLock lock(mutex_);
+  not_empty_.wait(lock, [this]() { return finished_ || !rows_.empty(); });
+  if (rows_.empty()) {
+    return false;
+  }
+
+  row = std::move(rows_.front());
+  rows_.pop_front();
+  not_full_.notify_one();
+  return true;
+}
+
+void BoundedRowQueue::finish() {
+  WriteLock lock(mutex_);
+  finished_ = true;
+  not_empty_.notify_all();
+}
+
+void BoundedRowQueue::fail(std::exception_ptr error) {
+  WriteLock lock(mutex_);
+  error_ = std::move(error);
+  finished_ = true;
+  not_empty_.notify_all();
+}
+
+void BoundedRowQueue::cancel() {
+  WriteLock lock(mutex_);
+  cancelled_ = true;
+  rows_.clear();
+  not_full_.notify_all();
+}
+
+std::exception_ptr BoundedRowQueue::error() const {
+  ReadLock lock(mutex_);
+  return error_;
+}
+
+} // namespace osquery
@@ -0,0 +1,81 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <deque>
+#include <exception>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core/sql/table_row.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+/**
+ * @brief A fixed-size window of rows between a table producer and SQLite.
+ *
+ * The producer blocks when the window is full and the consumer blocks when it
+ * is empty. Either side may stop early: the producer calls finish when it has
+ * no more rows and the consumer calls cancel when SQLite no longer needs rows,
+ * for example when a LIMIT is satisfied.
+ */
+class BoundedRowQueue : private boost::noncopyable {
+ public:
+  explicit BoundedRowQueue(size_t capacity);
+
+  /**
+   * @brief Add a row, blocking while the window is full.
+   *
+   * @return false if the consumer cancelled and the row was dropped.
+   */
+  bool push(TableRowHolder row);
+
+  /**
+   * @brief Remove the next row, blocking while the window is empty.
+   *
+   * @return false once the producer finished and all rows were consumed.
+   */
+  bool pop(TableRowHolder& row);
+
+  /// Producer signal that no more rows will be pushed.
+  void finish();
+
+  /// Producer signal that generation failed, this implies finish.
+  void fail(std::exception_ptr error);
+
+  /// Consumer signal that no more rows will be popped.
+  void cancel();
+
+  /// The exception reported by the producer, if any.
+  std::exception_ptr error() const;
+
+ private:
+  /// Maximum number of buffered rows.
+  const size_t capacity_;
+
+  /// Buffered rows in generation order.
+  std::deque<TableRowHolder> rows_;
+
+  /// Set when the producer has no more rows.
+  bool finished_{false};
+
+  /// Set when the consumer no longer wants rows.
+  bool cancelled_{false};
+
+  /// Optional producer failure.
+  std::exception_ptr error_{nullptr};
+
+  mutable Mutex mutex_;
+  ConditionVariable not_full_;
+  ConditionVariable not_empty_;
+};
+
+} // namespace osquery
@@ -57,58 +57,37 @@ Status deserializeRow(const rj::Value& doc, DynamicTableRowHolder& r) {
     return Status(1);
   }
 
+  // Typed rows serialize their numeric columns as numbers.
   for (const auto& i : doc.GetObject()) {
     std::string name(i.name.GetString());
-    if (!name.empty() && i.value.IsString()) {
+    if (name.empty()) {
+      continue;
+    }
+    if (i.value.IsString()) {
       r[name] = i.value.GetString();
+    } else if (i.value.IsInt64()) {
+      r[name] = BIGINT(i.value.GetInt64());
+    } else if (i.value.IsUint64()) {
+      r[name] = UNSIGNED_BIGINT(i.value.GetUint64());
+    } else if (i.value.IsDouble()) {
+      r[name] = DOUBLE(i.value.GetDouble());
     }
   }
   return Status::success();
 }
 
-int DynamicTableRow::get_rowid(sqlite_int64 default_value,
-                               sqlite_int64* pRowid) const {
-  auto& current_row = this->row;
-  auto rowid_it = current_row.find("rowid");
-  if (rowid_it != current_row.end()) {
-    const auto& rowid_text_field = rowid_it->second;
-
-    auto exp = tryTo<long long>(rowid_text_field, 10);
-    if (exp.isError()) {
-      VLOG(1) << "Invalid rowid value returned " << exp.getError();
-      return SQLITE_ERROR;
-    }
-    *pRowid = exp.take();
-
-  } else {
-    *pRowid = default_value;
-  }
-  return SQLITE_OK;
+sqlite3_destructor_type tableRowTextDestructor(const sqlite3_vtab* vtab) {
+  return rowTextDestructor(vtab);
 }
 
-int DynamicTableRow::get_column(sqlite3_context* ctx,
-                                sqlite3_vtab* vtab,
-                                int col) {
-  VirtualTable* pVtab = (VirtualTable*)vtab;
-  auto& column_name = std::get<0>(pVtab->content->columns[col]);
-  auto& type = std::get<1>(pVtab->content->columns[col]);
-  if (pVtab->content->aliases.count(column_name)) {
-    // Overwrite the aliased column with the type and name of the new column.
-    type = std::get<1>(
-        pVtab->content->columns[pVtab->content->aliases.at(column_name)]);
-    column_name = std::get<0>(
-        pVtab->content->columns[pVtab->content->aliases.at(column_name)]);
-  }
-
-  // Attempt to cast each xFilter-populated row/column to the SQLite type.
-  const auto& value = row[column_name];
-  if (this->row.count(column_name) == 0) {
-    // Missing content.
-    VLOG(1) << "Error " << column_name << " is empty";
-    sqlite3_result_null(ctx);
-  } else if (type == TEXT_TYPE || type == BLOB_TYPE) {
+void setSqliteResult(sqlite3_context* ctx,
+                     const std::string& column_name,
+                     ColumnType type,
+                     const std::string& value,
+                     sqlite3_destructor_type destructor) {
+  if (type == TEXT_TYPE || type == BLOB_TYPE) {
     sqlite3_result_text(
-        ctx, value.c_str(), static_cast<int>(value.size()), SQLITE_TRANSIENT);
+        ctx, value.c_str(), static_cast<int>(value.size()), destructor);
   } else if (value.empty() &&
              (type == INTEGER_TYPE || type == BIGINT_TYPE ||
               type == UNSIGNED_BIGINT_TYPE || type == DOUBLE_TYPE)) {
@@ -145,13 +124,56 @@ int DynamicTableRow::get_column(sqlite3_context* ctx,
   } else {
     LOG(ERROR) << "Error unknown column type " << column_name;
   }
+}
+
+int DynamicTableRow::get_rowid(sqlite_int64 default_value,
+                               sqlite_int64* pRowid) const {
+  auto& current_row = this->row;
+  auto rowid_it = current_row.find("rowid");
+  if (rowid_it != current_row.end()) {
+    const auto& rowid_text_field = rowid_it->second;
+
+    auto exp = tryTo<long long>(rowid_text_field, 10);
+    if (exp.isError()) {
+      VLOG(1) << "Invalid rowid value returned " << exp.getError();
+      return SQLITE_ERROR;
+    }
+    *pRowid = exp.take();
+
+  } else {
+    *pRowid = default_value;
+  }
+  return SQLITE_OK;
+}
+
+int DynamicTableRow::get_column(sqlite3_context* ctx,
+                                sqlite3_vtab* vtab,
+                                int col) {
+  VirtualTable* pVtab = (VirtualTable*)vtab;
+  auto& column_name = std::get<0>(pVtab->content->columns[col]);
+  auto& type = std::get<1>(pVtab->content->columns[col]);
+  if (pVtab->content->aliases.count(column_name)) {
+    // Overwrite the aliased column with the type and name of the new column.
+    type = std::get<1>(
+        pVtab->content->columns[pVtab->content->aliases.at(column_name)]);
+    column_name = std::get<0>(
+        pVtab->content->columns[pVtab->content->aliases.at(column_name)]);
+  }
+
+  // Attempt to cast each xFilter-populated row/column to the SQLite type.
+  // A column missing from the row reads as an empty value, without adding
+  // the column to the row.
+  static const std::string kEmptyValue;
+  auto it = row.find(column_name);
+  const auto& value = (it != row.end()) ? it->second : kEmptyValue;
+  setSqliteResult(ctx, column_name, type, value, rowTextDestructor(vtab));
 
   return SQLITE_OK;
 }
 
 Status DynamicTableRow::serialize(JSON& doc, rj::Value& obj) const {
   for (const auto& i : row) {
-    doc.addRef(i.first, i.second, obj);
+    doc.appendRef(i.first, i.second, obj);
   }
 
   return Status::success();
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <osquery/core/sql/column.h>
 #include <osquery/core/sql/table_row.h>
 #include <osquery/core/sql/table_rows.h>
 #include <osquery/utils/json/json.h>
@@ -88,6 +89,30 @@ inline DynamicTableRowHolder make_table_row(
 /// generated code.
 TableRows tableRowsFromQueryData(QueryData&& rows);
 
+/**
+ * @brief Invoke the sqlite3_result_xxx method for a text-encoded cell.
+ *
+ * Cells are cast to the column's SQLite type, values that cannot be cast
+ * produce a NULL result. This is shared by TableRow implementations that
+ * store their content as strings.
+ *
+ * Text is copied by SQLite unless a destructor of SQLITE_STATIC is given, in
+ * which case the caller must keep the value alive until the scan completes.
+ */
+void setSqliteResult(sqlite3_context* ctx,
+                     const std::string& column_name,
+                     ColumnType type,
+                     const std::string& value,
+                     sqlite3_destructor_type destructor = SQLITE_TRANSIENT);
+
+/**
+ * @brief The SQLite destructor for text owned by a row of a virtual table.
+ *
+ * A cursor releases the rows it has visited unless the table keeps its
+ * results until the scan completes, only then may rows use SQLITE_STATIC.
+ */
+sqlite3_destructor_type tableRowTextDestructor(const sqlite3_vtab* vtab);
+
 /**
  * @brief Deserialize a DynamicTableRow object from JSON object.
  *
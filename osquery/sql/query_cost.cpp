@@ -0,0 +1,244 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+#include <osquery/sql/query_cost.h>
+#include <osquery/sql/table_stats.h>
+#include <osquery/sql/virtual_table.h>
+#include <osquery/utils/conversions/tryto.h>
+
+namespace osquery {
+
+namespace {
+
+/// The plan detail of a virtual table, followed by "<idxNum>:<idxStr>".
+const std::string kVirtualTableIndex{" VIRTUAL TABLE INDEX "};
+
+/// A table scanned for the first time is assumed to be small and fast.
+const double kDefaultScanRows{100};
+const double kDefaultScanMs{10};
+
+/// Patterns may expand to a recursive search, such as file paths like '/%%'.
+const double kPatternScanRows{10000};
+const double kPatternScanMs{1000};
+
+/// The average rows and generate time of one filter of a table.
+struct TableHistory {
+  double rows{0};
+  double time_ms{0};
+};
+
+std::map<std::string, TableHistory> getTableHistory() {
+  std::map<std::string, TableHistory> history;
+  getTableStats([&history](const std::string& name, const TableStats& stats) {
+    if (stats.filters == 0) {
+      return;
+    }
+    auto filters = static_cast<double>(stats.filters);
+    history[name] = {stats.rows_produced / filters,
+                     stats.generate_time_us / filters / 1000};
+  });
+  return history;
+}
+
+bool isPatternOperator(unsigned char op) {
+  return op == LIKE || op == GLOB || op == REGEXP || op == MATCH;
+}
+
+/// Classify how a recorded xBestIndex plan reads its table.
+TableAccess getTableAccess(const VirtualTablePlan& plan) {
+  bool has_required = false;
+  bool required_constrained = false;
+  bool lookup = false;
+  for (const auto& column : plan.content->columns) {
+    if ((std::get<2>(column) & ColumnOptions::REQUIRED) != 0) {
+      has_required = true;
+    }
+  }
+
+  for (const auto& constraint : plan.constraints) {
+    for (const auto& column : plan.content->columns) {
+      if (std::get<0>(column) == constraint.first &&
+          (std::get<2>(column) & ColumnOptions::REQUIRED) != 0) {
+        required_constrained = true;
+      }
+    }
+    if (!isPatternOperator(constraint.second.op)) {
+      lookup = true;
+    }
+  }
+
+  if (has_required && !required_constrained) {
+    return TableAccess::MissingRequired;
+  } else if (lookup) {
+    return TableAccess::Lookup;
+  } else if (!plan.constraints.empty()) {
+    return TableAccess::Pattern;
+  }
+  return TableAccess::Scan;
+}
+
+/// Estimate the rows and time of one filter of a table.
+void estimateFilter(const VirtualTablePlan& plan,
+                    const std::map<std::string, TableHistory>& history,
+                    TableCost& table) {
+  const auto& content = *plan.content;
+  auto it = history.find(content.name);
+  table.history = (it != history.end());
+
+  switch (table.access) {
+  case TableAccess::MissingRequired:
+    table.rows = 0;
+    table.time_ms = 0;
+    break;
+  case TableAccess::Lookup:
+    table.rows = table.history ? it->second.rows : 1;
+    table.time_ms = table.history ? it->second.time_ms : 1;
+    break;
+  case TableAccess::Scan:
+    if (table.history) {
+      table.rows = it->second.rows;
+      table.time_ms = it->second.time_ms;
+    } else {
+      table.rows = (content.estimates.rows > 0)
+                       ? static_cast<double>(content.estimates.rows)
+                       : kDefaultScanRows;
+      table.time_ms = kDefaultScanMs;
+    }
+    break;
+  case TableAccess::Pattern:
+    table.rows = kPatternScanRows;
+    table.time_ms = kPatternScanMs;
+    if (table.history) {
+      table.rows = std::max(table.rows, it->second.rows);
+      table.time_ms = std::max(table.time_ms, it->second.time_ms);
+    }
+    break;
+  }
+}
+
+std::string getAccessName(TableAccess access) {
+  switch (access) {
+  case TableAccess::Scan:
+    return "scan";
+  case TableAccess::Lookup:
+    return "lookup";
+  case TableAccess::Pattern:
+    return "pattern";
+  case TableAccess::MissingRequired:
+    return "missing required constraint";
+  }
+  return "";
+}
+
+std::string formatCount(double value) {
+  return std::to_string(static_cast<unsigned long long>(std::llround(value)));
+}
+
+} // namespace
+
+std::string QueryCost::describe() const {
+  std::string summary;
+  for (const auto& table : tables) {
+    if (!summary.empty()) {
+      summary += "; ";
+    }
+    summary += table.name + ": " + getAccessName(table.access);
+    if (table.access != TableAccess::MissingRequired) {
+      summary += " " + formatCount(table.calls) + "x" +
+                 formatCount(table.rows) + " rows in " +
+                 formatCount(table.calls * table.time_ms) + "ms";
+    }
+  }
+  return summary;
+}
+
+Status estimateQueryCost(const std::string& query,
+                         QueryCost& cost,
+                         const SQLiteDBInstanceRef& instance) {
+  cost = QueryCost();
+
+  // Only planning the query runs xBestIndex, the plans are recorded as when
+  // a statement is prepared for the cache.
+  std::vector<std::pair<int, std::string>> details;
+  VirtualTablePlans plans;
+  {
+    const auto lock = instance->attachLock();
+    auto explain = "EXPLAIN QUERY PLAN " + query;
+    sqlite3_stmt* stmt = nullptr;
+    recordVirtualTablePlans(&plans);
+    auto rc =
+        sqlite3_prepare_v2(instance->db(), explain.c_str(), -1, &stmt, nullptr);
+    recordVirtualTablePlans(nullptr);
+    if (rc != SQLITE_OK) {
+      auto status = Status::failure(sqlite3_errmsg(instance->db()));
+      sqlite3_finalize(stmt);
+      instance->clearAffectedTables();
+      return status;
+    }
+
+    while (stmt != nullptr && sqlite3_step(stmt) == SQLITE_ROW) {
+      auto detail = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+      details.emplace_back(sqlite3_column_int(stmt, 1),
+                           (detail != nullptr) ? detail : "");
+    }
+    sqlite3_finalize(stmt);
+    instance->clearAffectedTables();
+  }
+
+  auto history = getTableHistory();
+
+  // The rows produced by the loops before each nested loop, by parent.
+  std::map<int, double> outer_rows;
+  for (const auto& detail : details) {
+    auto pos = detail.second.find(kVirtualTableIndex);
+    if (pos == std::string::npos) {
+      continue;
+    }
+
+    auto index_str = detail.second.substr(pos + kVirtualTableIndex.size());
+    index_str = index_str.substr(0, index_str.find(':'));
+    auto index = tryTo<std::size_t>(index_str);
+    if (index.isError()) {
+      continue;
+    }
+
+    auto plan = std::find_if(
+        plans.begin(), plans.end(), [&index](const VirtualTablePlan& p) {
+          return p.index == *index;
+        });
+    if (plan == plans.end()) {
+      continue;
+    }
+
+    TableCost table;
+    table.name = plan->content->name;
+    table.access = getTableAccess(*plan);
+    estimateFilter(*plan, history, table);
+
+    auto& outer = outer_rows.emplace(detail.first, 1.0).first->second;
+    table.calls = outer;
+    outer *= std::max(table.rows, 1.0);
+
+    cost.time_ms += table.calls * table.time_ms;
+    cost.rows += table.calls * table.rows;
+    cost.tables.push_back(std::move(table));
+  }
+
+  return Status::success();
+}
+
+Status estimateQueryCost(const std::string& query, QueryCost& cost) {
+  return estimateQueryCost(query, cost, SQLiteDBManager::get());
+}
+
+} // namespace osquery
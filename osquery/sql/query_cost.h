@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <osquery/sql/sqlite_util.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// How a virtual table is read by a query plan.
+enum class TableAccess {
+  /// Every row of the table is generated.
+  Scan,
+
+  /// An indexed or required column is matched to values.
+  Lookup,
+
+  /// Only pattern constraints (LIKE, GLOB, REGEXP) restrict the table.
+  Pattern,
+
+  /// A required column is not constrained, the table returns no rows.
+  MissingRequired,
+};
+
+/// The estimated cost of reading one virtual table within a query.
+struct TableCost {
+  std::string name;
+  TableAccess access{TableAccess::Scan};
+
+  /// Times the table is filtered, once per row of the outer loops.
+  double calls{0};
+
+  /// Rows returned by each filter.
+  double rows{0};
+
+  /// Generate time in milliseconds of all filters.
+  double time_ms{0};
+
+  /// Whether the table was scanned before, or defaults are used.
+  bool history{false};
+};
+
+/**
+ * @brief The estimated cost of a query, before it runs.
+ *
+ * The estimate follows the plan SQLite chooses: the virtual tables in join
+ * order, how xBestIndex constrains each one, and the average generate time
+ * and rows per filter from the table statistics. Tables in nested loops are
+ * filtered once per row of the loops before them, so a cartesian join costs
+ * the product of its tables.
+ *
+ * The estimate is rough: it does not see constraint values, WHERE terms SQLite
+ * evaluates itself, or subqueries run per row.
+ */
+struct QueryCost {
+  /// Estimated generate time in milliseconds of all tables.
+  double time_ms{0};
+
+  /// Estimated rows produced by all tables.
+  double rows{0};
+
+  std::vector<TableCost> tables;
+
+  /// A short summary, such as "file: pattern 1000 rows in 1000ms".
+  std::string describe() const;
+};
+
+/**
+ * @brief Estimate the cost of a query without running it.
+ *
+ * The query is planned with EXPLAIN QUERY PLAN on the instance, which calls
+ * xBestIndex but does not generate any table.
+ */
+Status estimateQueryCost(const std::string& query,
+                         QueryCost& cost,
+                         const SQLiteDBInstanceRef& instance);
+
+/// Estimate the cost of a query on the managed database.
+Status estimateQueryCost(const std::string& query, QueryCost& cost);
+
+} // namespace osquery
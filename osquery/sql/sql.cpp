@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <cstdint>
+#include <cstring>
 #include <sstream>
 
 #include <osquery/core/core.h>
@@ -60,8 +62,42 @@ std::string SQL::getMessageString() const {
   return status_.toString();
 }
 
+/**
+ * @brief Find the first byte below 0x20 or above 0x7F.
+ *
+ * Most values need no escaping, so the bytes are tested a word at a time:
+ * subtracting 0x20 from each byte borrows into the high bit of the bytes
+ * below 0x20, and the high bit is already set in the bytes above 0x7F.
+ */
+static size_t findNonPrintableByte(const std::string& data) {
+  const uint64_t kLowBytes = 0x2020202020202020ULL;
+  const uint64_t kHighBits = 0x8080808080808080ULL;
+
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= data.size(); i += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, data.data() + i, sizeof(word));
+    if (((word - kLowBytes) | word) & kHighBits) {
+      break;
+    }
+  }
+
+  for (; i < data.size(); i++) {
+    auto c = static_cast<unsigned char>(data[i]);
+    if (c < 0x20 || c >= 0x80) {
+      return i;
+    }
+  }
+  return std::string::npos;
+}
+
 static inline void escapeNonPrintableBytes(std::string& data) {
-  std::string escaped;
+  // Only replace if any escapes are needed.
+  auto first = findNonPrintableByte(data);
+  if (first == std::string::npos) {
+    return;
+  }
+
   // clang-format off
   char const hex_chars[16] = {
     '0', '1', '2', '3', '4', '5', '6', '7',
@@ -69,22 +105,20 @@ static inline void escapeNonPrintableBytes(std::string& data) {
   };
   // clang-format on
 
-  bool needs_replacement = false;
-  for (size_t i = 0; i < data.length(); i++) {
-    if (((unsigned char)data[i]) < 0x20 || ((unsigned char)data[i]) >= 0x80) {
-      needs_replacement = true;
+  std::string escaped;
+  escaped.reserve(data.size() + (data.size() - first) * 3);
+  escaped.append(data, 0, first);
+  for (size_t i = first; i < data.length(); i++) {
+    auto c = static_cast<unsigned char>(data[i]);
+    if (c < 0x20 || c >= 0x80) {
       escaped += "\\x";
-      escaped += hex_chars[(((unsigned char)data[i])) >> 4];
-      escaped += hex_chars[((unsigned char)data[i] & 0x0F) >> 0];
+      escaped += hex_chars[c >> 4];
+      escaped += hex_chars[c & 0x0F];
     } else {
       escaped += data[i];
     }
   }
-
-  // Only replace if any escapes were made.
-  if (needs_replacement) {
-    data = std::move(escaped);
-  }
+  data = std::move(escaped);
 }
 
 void escapeNonPrintableBytesEx(std::string& data) {
@@ -92,6 +126,12 @@ void escapeNonPrintableBytesEx(std::string& data) {
 }
 
 QueryData SQL::selectAllFrom(const std::string& table) {
+  auto plugin = RegistryFactory::get().localPlugin<TablePlugin>("table", table);
+  if (plugin != nullptr) {
+    QueryContext ctx;
+    return tableRowsToPluginResponse(plugin->generateLocal(ctx));
+  }
+
   PluginResponse response;
   Registry::call("table", table, {{"action", "generate"}}, response);
   return response;
@@ -109,7 +149,6 @@ QueryData SQL::selectFrom(const std::initializer_list<std::string>& columns,
                           const std::string& column,
                           ConstraintOperator op,
                           const std::string& expr) {
-  PluginRequest request = {{"action", "generate"}};
   // Create a fake content, there will be no caching.
   QueryContext ctx;
   ctx.constraints[column].add(Constraint(op, expr));
@@ -121,10 +160,15 @@ QueryData SQL::selectFrom(const std::initializer_list<std::string>& columns,
   // We can't set colsUsedBitset here (because we don't know the column
   // indexes). The plugin that handles the request will figure it out from the
   // column names.
-  TablePlugin::setRequestFromContext(ctx, request);
-
   PluginResponse response;
-  Registry::call("table", table, request, response);
+  auto plugin = RegistryFactory::get().localPlugin<TablePlugin>("table", table);
+  if (plugin != nullptr) {
+    response = tableRowsToPluginResponse(plugin->generateLocal(ctx));
+  } else {
+    PluginRequest request = {{"action", "generate"}};
+    TablePlugin::setRequestFromContext(ctx, request);
+    Registry::call("table", table, request, response);
+  }
   response.erase(
       std::remove_if(response.begin(),
                      response.end(),
@@ -16,8 +16,13 @@
 #endif
 
 #include <functional>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <regex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <osquery/core/flags.h>
@@ -35,6 +40,87 @@ HIDDEN_FLAG(
     "Defines the maximum size in bytes of a regex that can be used with the "
     "regex_match and regex_split functions");
 
+/// Patterns kept compiled by each regex function of a connection.
+const size_t kRegexCacheSize{128};
+
+/**
+ * @brief The patterns compiled by a regex function of a connection.
+ *
+ * SQLite keeps the pattern of a statement compiled while it is a constant
+ * argument, see getRegex. This least recently used cache also covers the
+ * patterns that are computed for each row and the statements prepared again
+ * for each query.
+ */
+class RegexCache {
+ public:
+  using RegexRef = std::shared_ptr<const std::regex>;
+
+  /// Return the compiled pattern, it throws a std::regex_error if invalid.
+  RegexRef get(const std::string& pattern) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(pattern);
+    if (it != index_.end()) {
+      entries_.splice(entries_.begin(), entries_, it->second);
+      return it->second->second;
+    }
+
+    auto regex = std::make_shared<const std::regex>(
+        pattern, std::regex::ECMAScript | std::regex::optimize);
+    entries_.emplace_front(pattern, regex);
+    index_[pattern] = entries_.begin();
+    if (entries_.size() > kRegexCacheSize) {
+      index_.erase(entries_.back().first);
+      entries_.pop_back();
+    }
+    return regex;
+  }
+
+  static void destroy(void* cache) {
+    delete static_cast<RegexCache*>(cache);
+  }
+
+ private:
+  using Entries = std::list<std::pair<std::string, RegexRef>>;
+
+  std::mutex mutex_;
+
+  /// The most recently used pattern first.
+  Entries entries_;
+  std::unordered_map<std::string, Entries::iterator> index_;
+};
+
+static void destroyRegexRef(void* regex) {
+  delete static_cast<RegexCache::RegexRef*>(regex);
+}
+
+/**
+ * @brief Return the compiled pattern of a regex function argument.
+ *
+ * The pattern is attached to the argument with sqlite3_set_auxdata, which
+ * SQLite keeps for the next rows while the argument is a constant.
+ */
+static RegexCache::RegexRef getRegex(sqlite3_context* context,
+                                     int argument,
+                                     const std::string& pattern) {
+  auto cached = static_cast<RegexCache::RegexRef*>(
+      sqlite3_get_auxdata(context, argument));
+  if (cached != nullptr) {
+    return *cached;
+  }
+
+  if (pattern.size() > FLAGS_regex_max_size) {
+    throw std::regex_error(std::regex_constants::error_complexity);
+  }
+
+  auto cache = static_cast<RegexCache*>(sqlite3_user_data(context));
+  auto regex = cache->get(pattern);
+  sqlite3_set_auxdata(context,
+                      argument,
+                      new RegexCache::RegexRef(regex),
+                      destroyRegexRef);
+  return regex;
+}
+
 using SplitResult = std::vector<std::string>;
 using StringSplitFunction = std::function<SplitResult(
     const std::string& input, const std::string& tokens)>;
@@ -74,16 +160,11 @@ static SplitResult tokenSplit(const std::string& input,
  *      192.168
  */
 static SplitResult regexSplit(const std::string& input,
-                              const std::string& token) {
+                              const std::regex& pattern) {
   // Split using the token as a regex to support multi-character tokens.
   // Exceptions are caught by the caller, as that's where the sql context is
   std::vector<std::string> result;
 
-  if (token.size() > FLAGS_regex_max_size) {
-    throw std::regex_error(std::regex_constants::error_complexity);
-  }
-
-  std::regex pattern = std::regex(token);
   std::sregex_token_iterator iter_begin(
       input.begin(), input.end(), pattern, -1);
   std::sregex_token_iterator iter_end;
@@ -140,7 +221,13 @@ static void regexStringSplitFunc(sqlite3_context* context,
                                  int argc,
                                  sqlite3_value** argv) {
   try {
-    callStringSplitFunc(context, argc, argv, regexSplit);
+    callStringSplitFunc(
+        context,
+        argc,
+        argv,
+        [context](const std::string& input, const std::string& token) {
+          return regexSplit(input, *getRegex(context, 1, token));
+        });
   } catch (const std::regex_error& e) {
     LOG(INFO) << "Invalid regex: " << e.what();
     sqlite3_result_error(context, "Invalid regex", -1);
@@ -187,7 +274,8 @@ static void regexStringMatchFunc(sqlite3_context* context,
   }
 
   try {
-    isMatchFound = std::regex_search(input, results, std::regex(regex));
+    isMatchFound =
+        std::regex_search(input, results, *getRegex(context, 1, regex));
   } catch (const std::regex_error& e) {
     LOG(INFO) << "Invalid regex: " << e.what();
     sqlite3_result_error(context, "Invalid regex", -1);
@@ -312,14 +400,15 @@ void registerStringExtensions(sqlite3* db) {
                           tokenStringSplitFunc,
                           nullptr,
                           nullptr);
-  sqlite3_create_function(db,
-                          "regex_split",
-                          3,
-                          SQLITE_UTF8 | SQLITE_DETERMINISTIC,
-                          nullptr,
-                          regexStringSplitFunc,
-                          nullptr,
-                          nullptr);
+  sqlite3_create_function_v2(db,
+                             "regex_split",
+                             3,
+                             SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                             new RegexCache(),
+                             regexStringSplitFunc,
+                             nullptr,
+                             nullptr,
+                             RegexCache::destroy);
   sqlite3_create_function(db,
                           "inet_aton",
                           1,
@@ -328,14 +417,15 @@ void registerStringExtensions(sqlite3* db) {
                           ip4StringToDecimalFunc,
                           nullptr,
                           nullptr);
-  sqlite3_create_function(db,
-                          "regex_match",
-                          3,
-                          SQLITE_UTF8 | SQLITE_DETERMINISTIC,
-                          nullptr,
-                          regexStringMatchFunc,
-                          nullptr,
-                          nullptr);
+  sqlite3_create_function_v2(db,
+                             "regex_match",
+                             3,
+                             SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                             new RegexCache(),
+                             regexStringMatchFunc,
+                             nullptr,
+                             nullptr,
+                             RegexCache::destroy);
   sqlite3_create_function(db,
                           "concat",
                           -1,
@@ -10,6 +10,9 @@
 #include "osquery/sql/sqlite_util.h"
 #include "osquery/sql/virtual_table.h"
 
+#include <algorithm>
+#include <numeric>
+
 #include <osquery/core/plugins/sql.h>
 
 #include <osquery/utils/conversions/castvariant.h>
@@ -17,7 +20,9 @@
 #include <osquery/core/core.h>
 #include <osquery/core/flags.h>
 #include <osquery/core/shutdown.h>
+#include <osquery/core/watcher.h>
 #include <osquery/logger/logger.h>
+#include <osquery/profiler/query_trace.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/sql/sql.h>
 
@@ -39,6 +44,30 @@ CLI_FLAG(string,
 
 FLAG(string, nullvalue, "", "Set string for NULL values, default ''");
 
+FLAG(uint64,
+     sql_statement_cache_size,
+     128,
+     "Number of prepared statements reused per SQLite database (0 disables)");
+
+FLAG(uint64,
+     sql_memory_limit,
+     0,
+     "Soft limit of SQLite memory in MB (0 uses a quarter of the watchdog "
+     "memory limit)");
+
+FLAG(uint64,
+     sql_cache_size,
+     2048,
+     "Page cache of each SQLite connection in KB, holds temporary tables");
+
+FLAG(uint64,
+     sql_mmap_size,
+     0,
+     "Bytes of each automatic table database SQLite may map in MB");
+
+DECLARE_bool(disable_watchdog);
+DECLARE_int32(watchdog_level);
+
 using OpReg = QueryPlanner::Opcode::Register;
 
 using SQLiteDBInstanceRef = std::shared_ptr<SQLiteDBInstance>;
@@ -65,9 +94,8 @@ const std::map<int, std::string> kSQLiteReturnCodes = {
 
 const std::map<std::string, std::string> kMemoryDBSettings = {
     {"synchronous", "OFF"},      {"count_changes", "OFF"},
-    {"default_temp_store", "0"}, {"auto_vacuum", "FULL"},
-    {"journal_mode", "OFF"},     {"cache_size", "0"},
-    {"page_count", "0"},
+    {"temp_store", "MEMORY"},    {"auto_vacuum", "FULL"},
+    {"journal_mode", "OFF"},     {"page_count", "0"},
 };
 // clang-format on
 
@@ -120,6 +148,7 @@ const std::map<std::string, QueryPlanner::Opcode> kSQLOpcodes = {
 };
 
 RecursiveMutex SQLiteDBInstance::kPrimaryAttachMutex;
+SQLiteStatementCache SQLiteDBInstance::kPrimaryStatements;
 
 /// The SQLiteSQLPlugin implements the "sql" registry for internal/core.
 class SQLiteSQLPlugin : public SQLPlugin {
@@ -181,8 +210,11 @@ Status SQLiteSQLPlugin::getQueryTables(const std::string& query,
   return Status(0);
 }
 
-SQLInternal::SQLInternal(const std::string& query, bool use_cache) {
-  auto dbc = SQLiteDBManager::get();
+SQLInternal::SQLInternal(const std::string& query,
+                         bool use_cache,
+                         SQLiteDBInstanceRef instance) {
+  auto dbc =
+      (instance != nullptr) ? std::move(instance) : SQLiteDBManager::get();
   dbc->useCache(use_cache);
   status_ = queryInternal(query, resultsTyped_, dbc);
 
@@ -340,6 +372,8 @@ static inline void openOptimized(sqlite3*& db) {
   for (const auto& setting : kMemoryDBSettings) {
     settings += "PRAGMA " + setting.first + "=" + setting.second + "; ";
   }
+  // Sorts, groupings and temporary B-trees are kept in the page cache.
+  settings += "PRAGMA cache_size=-" + std::to_string(FLAGS_sql_cache_size);
   sqlite3_exec(db, settings.c_str(), nullptr, nullptr, nullptr);
 
   // Register function extensions.
@@ -382,6 +416,64 @@ RecursiveLock SQLiteDBInstance::attachLock() const {
   return RecursiveLock(attach_mutex_);
 }
 
+SQLiteStatementCache& SQLiteDBInstance::statements() {
+  if (isPrimary()) {
+    return kPrimaryStatements;
+  }
+  return statements_;
+}
+
+void SQLiteDBInstance::clearStatements() {
+  auto lock(attachLock());
+  statements().clear();
+}
+
+SQLiteStatementCache::~SQLiteStatementCache() {
+  clear();
+}
+
+sqlite3_stmt* SQLiteStatementCache::take(const std::string& query,
+                                         VirtualTablePlans& plans) {
+  auto it = index_.find(query);
+  if (it == index_.end()) {
+    return nullptr;
+  }
+
+  auto stmt = it->second->stmt;
+  plans = std::move(it->second->plans);
+  queue_.erase(it->second);
+  index_.erase(it);
+  return stmt;
+}
+
+void SQLiteStatementCache::put(const std::string& query,
+                               sqlite3_stmt* stmt,
+                               VirtualTablePlans plans) {
+  auto capacity = static_cast<size_t>(FLAGS_sql_statement_cache_size);
+  if (capacity == 0 || index_.count(query) > 0) {
+    // A re-entered query may have already returned its own statement.
+    sqlite3_finalize(stmt);
+    return;
+  }
+
+  while (index_.size() >= capacity) {
+    sqlite3_finalize(queue_.back().stmt);
+    index_.erase(queue_.back().query);
+    queue_.pop_back();
+  }
+
+  queue_.push_front(Entry{query, stmt, std::move(plans)});
+  index_[query] = queue_.begin();
+}
+
+void SQLiteStatementCache::clear() {
+  for (auto& entry : queue_) {
+    sqlite3_finalize(entry.stmt);
+  }
+  queue_.clear();
+  index_.clear();
+}
+
 void SQLiteDBInstance::addAffectedTable(
     std::shared_ptr<VirtualTableContent> table) {
   // An xFilter/scan was requested for this virtual table.
@@ -419,6 +511,7 @@ void SQLiteDBInstance::clearAffectedTables() {
     table.second->cache.clear();
     table.second->colsUsed.clear();
     table.second->colsUsedBitsets.clear();
+    table.second->prefetched.reset();
   }
   // Since the affected tables are cleared, there are no more affected tables.
   // There is no concept of compounding tables between queries.
@@ -428,14 +521,36 @@ void SQLiteDBInstance::clearAffectedTables() {
 
 SQLiteDBInstance::~SQLiteDBInstance() {
   if (!isPrimary() && db_ != nullptr) {
+    statements_.clear();
     sqlite3_close(db_);
   } else {
     db_ = nullptr;
   }
 }
 
+uint64_t getSQLiteMemoryLimit() {
+  bool watchdog = !FLAGS_disable_watchdog && FLAGS_watchdog_level >= 0;
+  auto limit = FLAGS_sql_memory_limit;
+  if (watchdog) {
+    // SQLite allocates from the worker, its memory counts against the
+    // watchdog limit and must leave room for the tables and the rest.
+    auto worker_limit = getWorkerLimit(WatchdogLimitType::MEMORY_LIMIT);
+    limit = (limit == 0) ? worker_limit / 4 : std::min(limit, worker_limit);
+  }
+  return limit * 1024 * 1024;
+}
+
+uint64_t getSQLiteMmapSize() {
+  auto size = FLAGS_sql_mmap_size * 1024 * 1024;
+  auto limit = getSQLiteMemoryLimit();
+  return (limit == 0) ? size : std::min(size, limit);
+}
+
 SQLiteDBManager::SQLiteDBManager() : db_(nullptr) {
-  sqlite3_soft_heap_limit64(1);
+  // The page caches are released when SQLite memory reaches the limit,
+  // instead of after every statement.
+  auto limit = static_cast<sqlite3_int64>(getSQLiteMemoryLimit());
+  sqlite3_soft_heap_limit64(limit);
   setDisabledTables(Flag::getValue("disable_tables"));
   setEnabledTables(Flag::getValue("enable_tables"));
 }
@@ -480,6 +595,7 @@ void SQLiteDBManager::resetPrimary() {
   auto& self = instance();
 
   WriteLock connection_lock(self.mutex_);
+  resetStatements();
   self.connection_.reset();
 
   {
@@ -489,6 +605,11 @@ void SQLiteDBManager::resetPrimary() {
   }
 }
 
+void SQLiteDBManager::resetStatements() {
+  RecursiveLock lock(SQLiteDBInstance::kPrimaryAttachMutex);
+  SQLiteDBInstance::kPrimaryStatements.clear();
+}
+
 void SQLiteDBManager::setDisabledTables(const std::string& list) {
   const auto& tables = split(list, ",");
   disabled_tables_ =
@@ -535,6 +656,7 @@ SQLiteDBInstanceRef SQLiteDBManager::getConnection(bool primary) {
 SQLiteDBManager::~SQLiteDBManager() {
   connection_ = nullptr;
   if (db_ != nullptr) {
+    resetStatements();
     sqlite3_close(db_);
     db_ = nullptr;
   }
@@ -638,16 +760,23 @@ Status queryInternal(const std::string& query,
 
 Status readRows(sqlite3_stmt* prepared_statement,
                 QueryDataTyped& results,
-                const SQLiteDBInstanceRef& instance) {
+                const SQLiteDBInstanceRef& instance,
+                bool finalize = true) {
   // Do nothing with a null prepared_statement (eg, if the sql was just
   // whitespace)
   if (prepared_statement == nullptr) {
     return Status::success();
   }
+
+  // The step span includes the generate spans of the virtual tables.
+  ScopedTraceSpan span("step");
+  auto first_row = results.size();
   int rc = sqlite3_step(prepared_statement);
   /* if we have a result set row... */
   if (SQLITE_ROW == rc) {
-    // First collect the column names
+    // First collect the column names, and the order of the columns by name.
+    // Each row is filled in that order so every insert is at the end of the
+    // row map. When names repeat, the value of the last column is kept.
     int num_columns = sqlite3_column_count(prepared_statement);
     std::vector<std::string> colNames;
     colNames.reserve(num_columns);
@@ -655,24 +784,39 @@ Status readRows(sqlite3_stmt* prepared_statement,
       colNames.push_back(sqlite3_column_name(prepared_statement, i));
     }
 
+    std::vector<int> order(num_columns);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&colNames](int a, int b) {
+      return colNames[a] < colNames[b];
+    });
+    std::vector<int> columns;
+    columns.reserve(num_columns);
+    for (size_t i = 0; i < order.size(); i++) {
+      if (i + 1 == order.size() ||
+          colNames[order[i]] != colNames[order[i + 1]]) {
+        columns.push_back(order[i]);
+      }
+    }
+
     do {
       RowTyped row;
-      for (int i = 0; i < num_columns; i++) {
+      for (auto i : columns) {
+        auto& value = row.emplace_hint(row.end(), colNames[i], 0LL)->second;
         switch (sqlite3_column_type(prepared_statement, i)) {
         case SQLITE_INTEGER:
-          row[colNames[i]] = static_cast<long long>(
+          value = static_cast<long long>(
               sqlite3_column_int64(prepared_statement, i));
           break;
         case SQLITE_FLOAT:
-          row[colNames[i]] = sqlite3_column_double(prepared_statement, i);
+          value = sqlite3_column_double(prepared_statement, i);
           break;
         case SQLITE_NULL:
-          row[colNames[i]] = FLAGS_nullvalue;
+          value = FLAGS_nullvalue;
           break;
         default:
           // Everything else (SQLITE_TEXT, SQLITE3_TEXT, SQLITE_BLOB) is
           // obtained/conveyed as text/string
-          row[colNames[i]] = std::string(reinterpret_cast<const char*>(
+          value = std::string(reinterpret_cast<const char*>(
               sqlite3_column_text(prepared_statement, i)));
         }
       }
@@ -680,12 +824,25 @@ Status readRows(sqlite3_stmt* prepared_statement,
       rc = sqlite3_step(prepared_statement);
     } while (SQLITE_ROW == rc);
   }
+  span.setRows(results.size() - first_row);
   if (rc != SQLITE_DONE) {
     auto s = Status::failure(sqlite3_errmsg(instance->db()));
     sqlite3_finalize(prepared_statement);
     return s;
   }
 
+  if (!finalize) {
+    // The statement will be executed again, keep the compiled program.
+    rc = sqlite3_reset(prepared_statement);
+    if (rc != SQLITE_OK) {
+      auto s = Status::failure(sqlite3_errmsg(instance->db()));
+      sqlite3_finalize(prepared_statement);
+      return s;
+    }
+    sqlite3_clear_bindings(prepared_statement);
+    return Status::success();
+  }
+
   rc = sqlite3_finalize(prepared_statement);
   if (rc != SQLITE_OK) {
     return Status::failure(sqlite3_errmsg(instance->db()));
@@ -694,15 +851,35 @@ Status readRows(sqlite3_stmt* prepared_statement,
   return Status::success();
 }
 
-Status queryInternal(const std::string& query,
-                     QueryDataTyped& results,
-                     const SQLiteDBInstanceRef& instance) {
+static Status runQueryInternal(const std::string& query,
+                               QueryDataTyped& results,
+                               const SQLiteDBInstanceRef& instance) {
   sqlite3_stmt* prepared_statement{nullptr}; /* Statement to execute. */
 
   int rc = SQLITE_OK; /* Return Code */
   const char* leftover_sql = nullptr; /* Tail of unprocessed SQL */
   const char* sql = query.c_str(); /* SQL to be processed */
 
+  {
+    // Queries with a single statement are prepared once and then reused.
+    const auto lock = instance->attachLock();
+    VirtualTablePlans plans;
+    prepared_statement = instance->statements().take(query, plans);
+    if (prepared_statement != nullptr) {
+      restoreVirtualTablePlans(plans);
+      {
+        ScopedTraceSpan span("prefetch");
+        prefetchVirtualTables(plans, instance->useCache());
+      }
+      Status s = readRows(prepared_statement, results, instance, false);
+      if (s.ok()) {
+        instance->statements().put(query, prepared_statement, std::move(plans));
+      }
+      sqlite3_db_release_memory(instance->db());
+      return s;
+    }
+  }
+
   /* The big while loop.  One iteration per statement */
   while ((sql[0] != '\0') && (SQLITE_OK == rc)) {
     const auto lock = instance->attachLock();
@@ -711,25 +888,87 @@ Status queryInternal(const std::string& query,
     while (isspace(sql[0])) {
       sql++;
     }
-    rc = sqlite3_prepare_v2(
-        instance->db(), sql, -1, &prepared_statement, &leftover_sql);
+    bool first = (leftover_sql == nullptr);
+    VirtualTablePlans plans;
+    recordVirtualTablePlans(&plans);
+    {
+      ScopedTraceSpan span("prepare");
+      rc = sqlite3_prepare_v2(
+          instance->db(), sql, -1, &prepared_statement, &leftover_sql);
+    }
+    recordVirtualTablePlans(nullptr);
     if (rc != SQLITE_OK) {
       Status s = Status::failure(sqlite3_errmsg(instance->db()));
       sqlite3_finalize(prepared_statement);
       return s;
     }
 
-    Status s = readRows(prepared_statement, results, instance);
+    // Only a query that compiles to exactly one statement may be cached.
+    bool cacheable = first && prepared_statement != nullptr;
+    for (auto tail = leftover_sql; cacheable && tail[0] != '\0'; tail++) {
+      cacheable = isspace(tail[0]);
+    }
+
+    {
+      ScopedTraceSpan span("prefetch");
+      prefetchVirtualTables(plans, instance->useCache());
+    }
+    Status s = readRows(prepared_statement, results, instance, !cacheable);
     if (!s.ok()) {
       return s;
     }
 
+    if (cacheable) {
+      instance->statements().put(query, prepared_statement, std::move(plans));
+    }
+
     sql = leftover_sql;
   } /* end while */
   sqlite3_db_release_memory(instance->db());
   return Status::success();
 }
 
+namespace {
+
+/// Let a cancellation interrupt the database while a query runs on it.
+class ScopedQueryCancellation : private boost::noncopyable {
+ public:
+  explicit ScopedQueryCancellation(sqlite3* db)
+      : cancellation_(QueryCancellation::kCurrent) {
+    if (cancellation_ != nullptr) {
+      cancellation_->setDatabase(db);
+    }
+  }
+
+  ~ScopedQueryCancellation() {
+    if (cancellation_ != nullptr) {
+      cancellation_->setDatabase(nullptr);
+    }
+  }
+
+  /// Replace an interrupted query's error with the cancellation reason.
+  Status check(Status status) const {
+    if (!status.ok() && cancellation_ != nullptr &&
+        cancellation_->cancelled()) {
+      return Status::failure("Query cancelled: " + cancellation_->reason());
+    }
+    return status;
+  }
+
+ private:
+  QueryCancellationRef cancellation_;
+};
+
+} // namespace
+
+Status queryInternal(const std::string& query,
+                     QueryDataTyped& results,
+                     const SQLiteDBInstanceRef& instance) {
+  ScopedQueryCancellation cancellation(instance->db());
+  auto status = runQueryInternal(query, results, instance);
+  return cancellation.check(std::move(status));
+}
+
 Status getQueryColumnsInternal(const std::string& q,
                                TableColumns& columns,
                                const SQLiteDBInstanceRef& instance) {
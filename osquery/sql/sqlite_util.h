@@ -10,9 +10,14 @@
 #pragma once
 
 #include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <list>
 #include <map>
 #include <mutex>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <sqlite3.h>
 
@@ -86,6 +91,70 @@ const std::unordered_set<std::string> kAllowedSQLitePragmas = {
 
 class SQLiteDBManager;
 
+/**
+ * @brief The planner state xBestIndex recorded for one virtual table index.
+ *
+ * Virtual tables keep their constraints per index number and clear them after
+ * each query. A reused prepared statement does not run xBestIndex again, so
+ * the state is copied when the statement is prepared and restored before each
+ * run.
+ */
+struct VirtualTablePlan {
+  std::shared_ptr<VirtualTableContent> content;
+  size_t index{0};
+  ConstraintSet constraints;
+  std::unordered_set<size_t> inConstraints;
+  UsedColumns colsUsed;
+  UsedColumnsBitset colsUsedBitset;
+};
+
+using VirtualTablePlans = std::vector<VirtualTablePlan>;
+
+/**
+ * @brief A least-recently-used set of prepared statements keyed by SQL text.
+ *
+ * Statements are taken out of the cache while they execute, so a query that
+ * is re-entered on the same database prepares a private statement. Evicted
+ * and cleared statements are finalized, the owning database must outlive the
+ * cache or clear it before closing.
+ *
+ * Access is not synchronized, callers hold the owning instance's attachLock.
+ */
+class SQLiteStatementCache : private boost::noncopyable {
+ public:
+  SQLiteStatementCache() = default;
+  ~SQLiteStatementCache();
+
+  /// Remove and return the statement for a query, or nullptr on a miss.
+  sqlite3_stmt* take(const std::string& query, VirtualTablePlans& plans);
+
+  /// Return a reset statement to the cache, the cache owns it afterward.
+  void put(const std::string& query,
+           sqlite3_stmt* stmt,
+           VirtualTablePlans plans);
+
+  /// Finalize every cached statement.
+  void clear();
+
+  /// The number of cached statements.
+  size_t size() const {
+    return index_.size();
+  }
+
+ private:
+  struct Entry {
+    std::string query;
+    sqlite3_stmt* stmt{nullptr};
+    VirtualTablePlans plans;
+  };
+
+  /// Statements ordered from most to least recently used.
+  std::list<Entry> queue_;
+
+  /// Lookup from SQL text into the queue.
+  std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+};
+
 /**
  * @brief An RAII wrapper around an `sqlite3` object.
  *
@@ -139,6 +208,17 @@ class SQLiteDBInstance : private boost::noncopyable {
   /// Lock the database for attaching virtual tables.
   RecursiveLock attachLock() const;
 
+  /**
+   * @brief The prepared statements reusable on this database.
+   *
+   * Primary instances share a single cache for the managed database. The
+   * caller must hold attachLock.
+   */
+  SQLiteStatementCache& statements();
+
+  /// Finalize the prepared statements, required when the schema changes.
+  void clearStatements();
+
  private:
   /// Handle the primary/forwarding requests for table attribute accesses.
   TableAttributes getAttributes() const;
@@ -181,6 +261,12 @@ class SQLiteDBInstance : private boost::noncopyable {
   /// See attach_mutex_ but used for the primary database.
   static RecursiveMutex kPrimaryAttachMutex;
 
+  /// Prepared statements for a transient database.
+  SQLiteStatementCache statements_;
+
+  /// See statements_ but used for the primary database.
+  static SQLiteStatementCache kPrimaryStatements;
+
   /// Vector of tables that need their constraints cleared after execution.
   std::map<std::string, std::shared_ptr<VirtualTableContent>> affected_tables_;
 
@@ -241,6 +327,14 @@ class SQLiteDBManager : private boost::noncopyable {
    */
   static void resetPrimary();
 
+  /**
+   * @brief Finalize the primary database's prepared statements.
+   *
+   * Called when the schedule is reloaded so that statements for queries that
+   * are no longer scheduled are released.
+   */
+  static void resetStatements();
+
   /**
    * @brief Check if `table_name` is disabled.
    *
@@ -429,8 +523,11 @@ class SQLInternal : private only_movable {
    *
    * @param query An osquery SQL query.
    * @param use_cache [optional] Set true to use the query cache.
+   * @param instance [optional] The database to use, the manager's otherwise.
    */
-  explicit SQLInternal(const std::string& query, bool use_cache = false);
+  explicit SQLInternal(const std::string& query,
+                       bool use_cache = false,
+                       SQLiteDBInstanceRef instance = nullptr);
 
  public:
   /**
@@ -471,6 +568,17 @@ class SQLInternal : private only_movable {
   bool event_based_{false};
 };
 
+/**
+ * @brief The soft limit in bytes of the memory used by SQLite.
+ *
+ * The sql_memory_limit flag, capped by the watchdog memory limit. When unset
+ * a quarter of the watchdog memory limit is used. 0 means unlimited.
+ */
+uint64_t getSQLiteMemoryLimit();
+
+/// The bytes of an automatic table database SQLite may map, within the limit.
+uint64_t getSQLiteMmapSize();
+
 /**
  * @brief Get a string representation of a SQLite return code.
  */
@@ -535,6 +643,58 @@ Status genTableRowsForSqliteTable(const boost::filesystem::path& sqlite_db,
                                   TableRows& results,
                                   bool respect_locking = true);
 
+/**
+ * @brief A read-only connection to a SQLite database file.
+ *
+ * Used by ATC tables queried repeatedly. The connection and its prepared
+ * statements are kept between queries and reopened when the file's inode,
+ * size or modification time changes. No transaction stays open between
+ * queries. On Windows the connection is closed after each query, an open
+ * handle would prevent the owning application from replacing the file.
+ */
+class SqliteFileHandle : private boost::noncopyable {
+ public:
+  /// What identifies a version of the file.
+  struct Identity {
+    std::uint64_t inode{0};
+    std::uint64_t size{0};
+    std::time_t mtime{0};
+
+    bool operator!=(const Identity& other) const {
+      return inode != other.inode || size != other.size ||
+             mtime != other.mtime;
+    }
+  };
+
+  explicit SqliteFileHandle(const boost::filesystem::path& path)
+      : path_(path) {}
+  ~SqliteFileHandle();
+
+  /**
+   * @brief Run a query and append its rows, like genTableRowsForSqliteTable.
+   *
+   * @param sqlite_query The query, prepared once and reused.
+   * @param parameters Text values bound to the parameters of the query.
+   * @param results The rows, with the implicit path column.
+   */
+  Status query(const std::string& sqlite_query,
+               const std::vector<std::string>& parameters,
+               TableRows& results);
+
+ private:
+  Status open();
+  void close();
+
+ private:
+  /// The prepared statements kept, different constraints use different ones.
+  static constexpr size_t kMaxStatements{16};
+
+  boost::filesystem::path path_;
+  sqlite3* db_{nullptr};
+  Identity identity_;
+  std::map<std::string, sqlite3_stmt*> statements_;
+};
+
 /**
  * @brief Detect journal_mode of d SQLite database file
  *
@@ -0,0 +1,225 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <chrono>
+#include <map>
+#include <vector>
+
+#include <osquery/sql/step_generations.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+namespace {
+
+/// Bytes of rows kept for a single schedule step.
+const size_t kMaxStepGenerationBytes = 64 * 1024 * 1024;
+
+/// Bytes of rows kept for boot-stable tables.
+const size_t kMaxBootGenerationBytes = 16 * 1024 * 1024;
+
+struct StepGeneration {
+  std::string constraints;
+  UsedColumnsBitset columns;
+  TableRows rows;
+};
+
+Mutex kStepGenerationsMutex;
+
+uint64_t kStepGenerationsStep{0};
+
+size_t kStepGenerationsBytes{0};
+
+using StepGenerations = std::map<std::string, std::vector<StepGeneration>>;
+
+StepGenerations kStepGenerations;
+
+Mutex kBootGenerationsMutex;
+
+/// When the first boot-stable generation was kept, all expire together.
+std::chrono::steady_clock::time_point kBootGenerationsTime;
+
+size_t kBootGenerationsBytes{0};
+
+StepGenerations kBootGenerations;
+
+void copyRows(const TableRows& from, TableRows& to) {
+  to.reserve(to.size() + from.size());
+  for (const auto& row : from) {
+    to.push_back(row->clone());
+  }
+}
+
+/// Release the kept generations if they belong to another step.
+void useStep(uint64_t step) {
+  if (kStepGenerationsStep != step) {
+    kStepGenerations.clear();
+    kStepGenerationsBytes = 0;
+    kStepGenerationsStep = step;
+  }
+}
+
+/// Release the boot-stable generations once they are older than max_age.
+void useBootAge(uint64_t max_age) {
+  auto now = std::chrono::steady_clock::now();
+  if (kBootGenerations.empty()) {
+    kBootGenerationsTime = now;
+  } else if (now - kBootGenerationsTime >= std::chrono::seconds(max_age)) {
+    kBootGenerations.clear();
+    kBootGenerationsBytes = 0;
+    kBootGenerationsTime = now;
+  }
+}
+
+bool findGeneration(const StepGenerations& kept,
+                    const std::string& table,
+                    const std::string& constraints,
+                    bool unconstrained,
+                    const UsedColumnsBitset& columns,
+                    TableRows& rows) {
+  auto generations = kept.find(table);
+  if (generations == kept.end()) {
+    return false;
+  }
+
+  for (const auto& generation : generations->second) {
+    if ((columns & ~generation.columns).any()) {
+      continue;
+    }
+
+    if (generation.constraints == constraints ||
+        (unconstrained && generation.constraints.empty())) {
+      copyRows(generation.rows, rows);
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Keep a copy of the rows, returns false if an equivalent one is kept.
+bool addGeneration(StepGenerations& kept,
+                   const std::string& table,
+                   std::string constraints,
+                   const UsedColumnsBitset& columns,
+                   const TableRows& rows) {
+  auto& generations = kept[table];
+  for (const auto& generation : generations) {
+    if (generation.constraints == constraints &&
+        (columns & ~generation.columns).none()) {
+      // A concurrent query kept an equivalent generation.
+      return false;
+    }
+  }
+
+  StepGeneration generation;
+  generation.constraints = std::move(constraints);
+  generation.columns = columns;
+  copyRows(rows, generation.rows);
+  generations.push_back(std::move(generation));
+  return true;
+}
+
+} // namespace
+
+std::string stepGenerationConstraints(const ConstraintMap& constraints) {
+  std::string signature;
+  for (const auto& column : constraints) {
+    const auto& list = column.second.getAll();
+    if (list.empty()) {
+      continue;
+    }
+
+    signature += column.first;
+    signature += '\0';
+    for (const auto& constraint : list) {
+      signature += static_cast<char>(constraint.op);
+      signature += constraint.expr;
+      signature += '\0';
+    }
+    signature += '\n';
+  }
+  return signature;
+}
+
+bool findStepGeneration(uint64_t step,
+                        const std::string& table,
+                        const std::string& constraints,
+                        bool unconstrained,
+                        const UsedColumnsBitset& columns,
+                        TableRows& rows) {
+  WriteLock lock(kStepGenerationsMutex);
+  useStep(step);
+  return findGeneration(
+      kStepGenerations, table, constraints, unconstrained, columns, rows);
+}
+
+void addStepGeneration(uint64_t step,
+                       const std::string& table,
+                       std::string constraints,
+                       const UsedColumnsBitset& columns,
+                       const TableRows& rows) {
+  auto bytes = estimateTableRowsBytes(rows);
+
+  WriteLock lock(kStepGenerationsMutex);
+  useStep(step);
+  if (kStepGenerationsBytes + bytes > kMaxStepGenerationBytes) {
+    return;
+  }
+
+  if (addGeneration(
+          kStepGenerations, table, std::move(constraints), columns, rows)) {
+    kStepGenerationsBytes += bytes;
+  }
+}
+
+void resetStepGenerations() {
+  WriteLock lock(kStepGenerationsMutex);
+  kStepGenerations.clear();
+  kStepGenerationsBytes = 0;
+  kStepGenerationsStep = 0;
+}
+
+bool findBootGeneration(uint64_t max_age,
+                        const std::string& table,
+                        const std::string& constraints,
+                        bool unconstrained,
+                        const UsedColumnsBitset& columns,
+                        TableRows& rows) {
+  WriteLock lock(kBootGenerationsMutex);
+  useBootAge(max_age);
+  return findGeneration(
+      kBootGenerations, table, constraints, unconstrained, columns, rows);
+}
+
+void addBootGeneration(uint64_t max_age,
+                       const std::string& table,
+                       std::string constraints,
+                       const UsedColumnsBitset& columns,
+                       const TableRows& rows) {
+  auto bytes = estimateTableRowsBytes(rows);
+
+  WriteLock lock(kBootGenerationsMutex);
+  useBootAge(max_age);
+  if (kBootGenerationsBytes + bytes > kMaxBootGenerationBytes) {
+    return;
+  }
+
+  if (addGeneration(
+          kBootGenerations, table, std::move(constraints), columns, rows)) {
+    kBootGenerationsBytes += bytes;
+  }
+}
+
+void resetBootGenerations() {
+  WriteLock lock(kBootGenerationsMutex);
+  kBootGenerations.clear();
+  kBootGenerationsBytes = 0;
+}
+
+} // namespace osquery
@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <osquery/core/sql/table_rows.h>
+#include <osquery/core/tables.h>
+
+namespace osquery {
+
+/**
+ * @brief Build the signature of the constraints a table is generated with.
+ *
+ * Two scans with the same signature request the same rows from the table.
+ * An empty signature means the table was generated without constraints.
+ */
+std::string stepGenerationConstraints(const ConstraintMap& constraints);
+
+/**
+ * @brief Copy the rows of a table generated earlier in a schedule step.
+ *
+ * A generation is compatible when it includes every requested column and was
+ * generated with the same constraints. If unconstrained is true a generation
+ * without constraints is also compatible, SQLite filters its rows.
+ *
+ * @return true if rows were appended.
+ */
+bool findStepGeneration(uint64_t step,
+                        const std::string& table,
+                        const std::string& constraints,
+                        bool unconstrained,
+                        const UsedColumnsBitset& columns,
+                        TableRows& rows);
+
+/**
+ * @brief Keep a copy of a table's rows for the other queries of the step.
+ *
+ * Generations from an earlier step are released, and rows are not kept once
+ * the step's generations exceed a fixed size.
+ */
+void addStepGeneration(uint64_t step,
+                       const std::string& table,
+                       std::string constraints,
+                       const UsedColumnsBitset& columns,
+                       const TableRows& rows);
+
+/// Release every kept generation.
+void resetStepGenerations();
+
+/**
+ * @brief Copy the rows of a boot-stable table generated by an earlier query.
+ *
+ * Generations are compatible as for findStepGeneration. They are kept across
+ * queries and steps until they are max_age seconds old, or a device is added
+ * or removed.
+ *
+ * @return true if rows were appended.
+ */
+bool findBootGeneration(uint64_t max_age,
+                        const std::string& table,
+                        const std::string& constraints,
+                        bool unconstrained,
+                        const UsedColumnsBitset& columns,
+                        TableRows& rows);
+
+/// Keep a copy of a boot-stable table's rows for later queries.
+void addBootGeneration(uint64_t max_age,
+                       const std::string& table,
+                       std::string constraints,
+                       const UsedColumnsBitset& columns,
+                       const TableRows& rows);
+
+/// Release the boot-stable generations, such as when the hardware changed.
+void resetBootGenerations();
+
+} // namespace osquery
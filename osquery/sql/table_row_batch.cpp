@@ -0,0 +1,334 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "table_row_batch.h"
+#include "dynamic_table_row.h"
+#include "virtual_table.h"
+
+#include <osquery/logger/logger.h>
+#include <osquery/utils/conversions/tryto.h>
+
+namespace rj = rapidjson;
+
+namespace osquery {
+
+namespace {
+
+bool isIntegerType(ColumnType type) {
+  return type == INTEGER_TYPE || type == BIGINT_TYPE ||
+         type == UNSIGNED_BIGINT_TYPE;
+}
+
+} // namespace
+
+TableRowBatchSchema::TableRowBatchSchema(const TableColumns& columns) {
+  names.reserve(columns.size());
+  types.reserve(columns.size());
+  for (const auto& column : columns) {
+    index_[std::get<0>(column)] = names.size();
+    names.push_back(std::get<0>(column));
+    types.push_back(std::get<1>(column));
+  }
+}
+
+int TableRowBatchSchema::find(const std::string& name) const {
+  auto it = index_.find(name);
+  if (it == index_.end()) {
+    return -1;
+  }
+  return static_cast<int>(it->second);
+}
+
+TableRowBatch::TableRowBatch(TableRowBatchSchemaRef schema)
+    : schema_(std::move(schema)) {
+  auto columns = schema_->names.size();
+  storage_.reserve(columns);
+  for (const auto& type : schema_->types) {
+    if (isIntegerType(type)) {
+      storage_.push_back(Storage::Integer);
+    } else if (type == DOUBLE_TYPE) {
+      storage_.push_back(Storage::Double);
+    } else {
+      storage_.push_back(Storage::Text);
+    }
+  }
+
+  values_.resize(columns);
+  integers_.resize(columns);
+  doubles_.resize(columns);
+  fallback_.resize(columns);
+  present_.resize(columns);
+}
+
+TableRowBatch::TableRowBatch(const TableColumns& columns)
+    : TableRowBatch(std::make_shared<const TableRowBatchSchema>(columns)) {}
+
+size_t TableRowBatch::addRow() {
+  for (size_t i = 0; i < storage_.size(); ++i) {
+    if (storage_[i] == Storage::Integer) {
+      integers_[i].push_back(0);
+    } else if (storage_[i] == Storage::Double) {
+      doubles_[i].push_back(0);
+    } else {
+      values_[i].emplace_back();
+    }
+    present_[i].push_back(false);
+  }
+  return rows_++;
+}
+
+void TableRowBatch::set(size_t row, size_t column, std::string value) {
+  if (row >= rows_ || column >= storage_.size()) {
+    return;
+  }
+  if (storage_[column] != Storage::Text) {
+    setNumeric(row, column, std::move(value));
+    return;
+  }
+  values_[column][row] = std::move(value);
+  present_[column][row] = true;
+}
+
+void TableRowBatch::setNumeric(size_t row, size_t column, std::string value) {
+  // Only keep the native value if it formats back to the same text, so the
+  // string views of the row are unchanged.
+  bool native = false;
+  if (storage_[column] == Storage::Integer) {
+    auto number = tryTo<long long>(value, 10);
+    if (number.isValue() && std::to_string(*number) == value) {
+      integers_[column][row] = *number;
+      native = true;
+    }
+  } else if (!value.empty()) {
+    char* end = nullptr;
+    double number = strtod(value.c_str(), &end);
+    if (end != nullptr && *end == '\0' && std::to_string(number) == value) {
+      doubles_[column][row] = number;
+      native = true;
+    }
+  }
+
+  if (native) {
+    fallback_[column].erase(row);
+  } else {
+    fallback_[column][row] = std::move(value);
+  }
+  present_[column][row] = true;
+}
+
+void TableRowBatch::setInteger(size_t row, size_t column, long long value) {
+  if (row >= rows_ || column >= storage_.size()) {
+    return;
+  }
+  if (storage_[column] != Storage::Integer) {
+    set(row, column, std::to_string(value));
+    return;
+  }
+  integers_[column][row] = value;
+  fallback_[column].erase(row);
+  present_[column][row] = true;
+}
+
+void TableRowBatch::setDouble(size_t row, size_t column, double value) {
+  if (row >= rows_ || column >= storage_.size()) {
+    return;
+  }
+  if (storage_[column] != Storage::Double) {
+    set(row, column, std::to_string(value));
+    return;
+  }
+  doubles_[column][row] = value;
+  fallback_[column].erase(row);
+  present_[column][row] = true;
+}
+
+bool TableRowBatch::set(size_t row,
+                        const std::string& column,
+                        std::string value) {
+  auto index = schema_->find(column);
+  if (index < 0) {
+    return false;
+  }
+  set(row, static_cast<size_t>(index), std::move(value));
+  return true;
+}
+
+bool TableRowBatch::isSet(size_t row, size_t column) const {
+  return row < rows_ && column < present_.size() && present_[column][row];
+}
+
+std::string TableRowBatch::get(size_t row, size_t column) const {
+  if (!isSet(row, column)) {
+    return std::string();
+  }
+
+  auto stored = text(row, column);
+  if (stored != nullptr) {
+    return *stored;
+  } else if (storage_[column] == Storage::Integer) {
+    return std::to_string(integers_[column][row]);
+  }
+  return std::to_string(doubles_[column][row]);
+}
+
+const std::string* TableRowBatch::text(size_t row, size_t column) const {
+  if (!isSet(row, column)) {
+    return nullptr;
+  }
+  if (storage_[column] == Storage::Text) {
+    return &values_[column][row];
+  }
+
+  auto it = fallback_[column].find(row);
+  return (it != fallback_[column].end()) ? &it->second : nullptr;
+}
+
+void TableRowBatch::result(sqlite3_context* ctx,
+                           size_t row,
+                           size_t column,
+                           sqlite3_destructor_type destructor) const {
+  const auto& name = schema_->names[column];
+  auto type = schema_->types[column];
+  if (!isSet(row, column)) {
+    setSqliteResult(ctx, name, type, std::string());
+    return;
+  }
+
+  auto stored = text(row, column);
+  if (stored != nullptr) {
+    setSqliteResult(ctx, name, type, *stored, destructor);
+  } else if (type == INTEGER_TYPE) {
+    sqlite3_result_int(ctx, static_cast<int>(integers_[column][row]));
+  } else if (storage_[column] == Storage::Integer) {
+    sqlite3_result_int64(ctx, integers_[column][row]);
+  } else {
+    sqlite3_result_double(ctx, doubles_[column][row]);
+  }
+}
+
+void TableRowBatch::reserve(size_t rows) {
+  for (size_t i = 0; i < storage_.size(); ++i) {
+    if (storage_[i] == Storage::Integer) {
+      integers_[i].reserve(rows);
+    } else if (storage_[i] == Storage::Double) {
+      doubles_[i].reserve(rows);
+    } else {
+      values_[i].reserve(rows);
+    }
+    present_[i].reserve(rows);
+  }
+}
+
+BatchTableRow::operator Row() const {
+  Row r;
+  const auto& names = batch_->schema().names;
+  for (size_t i = 0; i < names.size(); ++i) {
+    if (batch_->isSet(row_, i)) {
+      r[names[i]] = batch_->get(row_, i);
+    }
+  }
+  return r;
+}
+
+int BatchTableRow::get_rowid(sqlite_int64 default_value,
+                             sqlite_int64* pRowid) const {
+  auto index = batch_->schema().find("rowid");
+  if (index < 0 || !batch_->isSet(row_, static_cast<size_t>(index))) {
+    *pRowid = default_value;
+    return SQLITE_OK;
+  }
+
+  auto rowid = batch_->get(row_, static_cast<size_t>(index));
+  auto exp = tryTo<long long>(rowid, 10);
+  if (exp.isError()) {
+    VLOG(1) << "Invalid rowid value returned " << exp.getError();
+    return SQLITE_ERROR;
+  }
+  *pRowid = exp.take();
+  return SQLITE_OK;
+}
+
+int BatchTableRow::get_column(sqlite3_context* ctx,
+                              sqlite3_vtab* vtab,
+                              int col) {
+  VirtualTable* pVtab = (VirtualTable*)vtab;
+  const auto& content = pVtab->content;
+  auto column = static_cast<size_t>(col);
+  auto alias = content->aliases.find(std::get<0>(content->columns[column]));
+  if (alias != content->aliases.end()) {
+    column = alias->second;
+  }
+
+  const auto& column_name = std::get<0>(content->columns[column]);
+  auto type = std::get<1>(content->columns[column]);
+
+  // The schema is normally built from the same column list as the virtual
+  // table, so the index can be used directly. Fall back to a name lookup.
+  const auto& schema = batch_->schema();
+  int index = -1;
+  if (column < schema.names.size() && schema.names[column] == column_name) {
+    index = static_cast<int>(column);
+  } else {
+    index = schema.find(column_name);
+  }
+
+  if (index < 0) {
+    // Missing content.
+    VLOG(1) << "Error " << column_name << " is empty";
+    sqlite3_result_null(ctx);
+    return SQLITE_OK;
+  }
+
+  if (schema.types[index] != type) {
+    // The batch was built with a different affinity, cast its text.
+    setSqliteResult(ctx,
+                    column_name,
+                    type,
+                    batch_->get(row_, static_cast<size_t>(index)));
+    return SQLITE_OK;
+  }
+
+  batch_->result(
+      ctx, row_, static_cast<size_t>(index), rowTextDestructor(vtab));
+  return SQLITE_OK;
+}
+
+Status BatchTableRow::serialize(JSON& doc, rj::Value& obj) const {
+  const auto& names = batch_->schema().names;
+  for (size_t i = 0; i < names.size(); ++i) {
+    if (!batch_->isSet(row_, i)) {
+      continue;
+    }
+
+    auto stored = batch_->text(row_, i);
+    if (stored != nullptr) {
+      doc.addRef(names[i], *stored, obj);
+    } else {
+      doc.add(names[i], batch_->get(row_, i), obj);
+    }
+  }
+
+  return Status::success();
+}
+
+TableRowHolder BatchTableRow::clone() const {
+  return TableRowHolder(new BatchTableRow(batch_, row_));
+}
+
+TableRows tableRowsFromBatch(std::shared_ptr<const TableRowBatch> batch) {
+  TableRows result;
+  result.reserve(batch->size());
+  for (size_t i = 0; i < batch->size(); ++i) {
+    result.push_back(TableRowHolder(new BatchTableRow(batch, i)));
+  }
+
+  return result;
+}
+
+} // namespace osquery
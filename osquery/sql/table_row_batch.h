@@ -0,0 +1,179 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <osquery/core/sql/table_row.h>
+#include <osquery/core/sql/table_rows.h>
+#include <osquery/core/tables.h>
+
+namespace osquery {
+
+/**
+ * @brief The column layout shared by every row in a TableRowBatch.
+ *
+ * A schema is created once per table (usually from TablePlugin::columns) and
+ * may be shared across batches. Column indexes match the order of the
+ * virtual table's declared columns, which lets xColumn read cells without a
+ * name lookup.
+ */
+struct TableRowBatchSchema {
+  explicit TableRowBatchSchema(const TableColumns& columns);
+
+  /// Return the column index for a name, or -1 if it is not in the schema.
+  int find(const std::string& name) const;
+
+  /// Column names in declaration order.
+  ColumnNames names;
+
+  /// Column SQLite type affinities, parallel to names.
+  std::vector<ColumnType> types;
+
+ private:
+  std::unordered_map<std::string, size_t> index_;
+};
+
+using TableRowBatchSchemaRef = std::shared_ptr<const TableRowBatchSchema>;
+
+/**
+ * @brief A columnar set of rows for a single table.
+ *
+ * Each column keeps its values in one contiguous buffer, so filling a batch
+ * costs one string per cell rather than a map node and a key copy per cell.
+ * Table generators may opt in by filling a batch and returning the result of
+ * tableRowsFromBatch in place of DynamicTableRows.
+ *
+ * Cells that are never set are treated as missing, matching the behavior of
+ * a DynamicTableRow that does not contain the column key.
+ *
+ * INTEGER, BIGINT and DOUBLE columns keep their values natively so xColumn
+ * does not parse text for every access. Text set on a numeric column is
+ * parsed once; values that do not round-trip are kept as text.
+ */
+class TableRowBatch {
+ public:
+  explicit TableRowBatch(TableRowBatchSchemaRef schema);
+  explicit TableRowBatch(const TableColumns& columns);
+
+  /// Append an empty row and return its index.
+  size_t addRow();
+
+  /// Set a cell by column index.
+  void set(size_t row, size_t column, std::string value);
+
+  /// Set a cell by column name, returns false if the column is unknown.
+  bool set(size_t row, const std::string& column, std::string value);
+
+  /// Set an integer cell by column index.
+  void setInteger(size_t row, size_t column, long long value);
+
+  /// Set a double cell by column index.
+  void setDouble(size_t row, size_t column, double value);
+
+  /// Check if a cell has been set.
+  bool isSet(size_t row, size_t column) const;
+
+  /// Access a cell as text, unset cells are empty.
+  std::string get(size_t row, size_t column) const;
+
+  /// Access a set cell's stored text, or nullptr if it is stored natively.
+  const std::string* text(size_t row, size_t column) const;
+
+  /**
+   * @brief Set the SQLite result for a cell.
+   *
+   * Native numeric cells are returned without conversion. Text cells are
+   * cast to the column type and passed to SQLite using the destructor.
+   */
+  void result(sqlite3_context* ctx,
+              size_t row,
+              size_t column,
+              sqlite3_destructor_type destructor) const;
+
+  /// Return the number of rows.
+  size_t size() const {
+    return rows_;
+  }
+
+  /// Reserve capacity in every column buffer.
+  void reserve(size_t rows);
+
+  /// The shared column layout.
+  const TableRowBatchSchema& schema() const {
+    return *schema_;
+  }
+
+ private:
+  /// How a column's cells are stored.
+  enum class Storage {
+    Text,
+    Integer,
+    Double,
+  };
+
+  /// Store text on a numeric column, natively if it round-trips.
+  void setNumeric(size_t row, size_t column, std::string value);
+
+  /// Shared column layout.
+  TableRowBatchSchemaRef schema_;
+
+  /// Per-column storage, parallel to the schema types.
+  std::vector<Storage> storage_;
+
+  /// Per-column contiguous value buffers for text columns.
+  std::vector<std::vector<std::string>> values_;
+
+  /// Per-column value buffers for INTEGER and BIGINT columns.
+  std::vector<std::vector<long long>> integers_;
+
+  /// Per-column value buffers for DOUBLE columns.
+  std::vector<std::vector<double>> doubles_;
+
+  /// Numeric cells that were set with text that is not a canonical number.
+  std::vector<std::unordered_map<size_t, std::string>> fallback_;
+
+  /// Per-column presence, parallel to values_.
+  std::vector<std::vector<bool>> present_;
+
+  /// Number of rows appended.
+  size_t rows_{0};
+};
+
+/**
+ * @brief A TableRow view into a single row of a TableRowBatch.
+ *
+ * The view shares ownership of the batch so rows may outlive the generator
+ * that produced them. The batch must not be modified once views are created.
+ */
+class BatchTableRow : public TableRow {
+ public:
+  BatchTableRow(std::shared_ptr<const TableRowBatch> batch, size_t row)
+      : batch_(std::move(batch)), row_(row) {}
+
+  explicit operator Row() const override;
+  int get_rowid(sqlite_int64 default_value,
+                sqlite_int64* pRowid) const override;
+  int get_column(sqlite3_context* ctx, sqlite3_vtab* pVtab, int col) override;
+  Status serialize(JSON& doc, rapidjson::Value& obj) const override;
+  TableRowHolder clone() const override;
+
+ private:
+  std::shared_ptr<const TableRowBatch> batch_;
+  size_t row_{0};
+};
+
+/// Creates a TableRowHolder view for every row in the batch.
+TableRows tableRowsFromBatch(std::shared_ptr<const TableRowBatch> batch);
+
+} // namespace osquery
@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <map>
+
+#include <osquery/core/flags.h>
+#include <osquery/core/flight_recorder.h>
+#include <osquery/numeric_monitoring/numeric_monitoring.h>
+#include <osquery/profiler/allocations.h>
+#include <osquery/sql/table_stats.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+DECLARE_bool(enable_numeric_monitoring);
+
+namespace {
+
+Mutex kTableStatsMutex;
+
+std::map<std::string, TableStats> kTableStats;
+
+/// Scans of at least 10ms are kept in the flight recorder of the worker.
+const std::uint64_t kFlightRecorderMinGenerateUs{10000};
+
+} // namespace
+
+TableStats& TableStats::operator+=(const TableStats& other) {
+  scans += other.scans;
+  filters += other.filters;
+  generate_time_us += other.generate_time_us;
+  rows_produced += other.rows_produced;
+  rows_consumed += other.rows_consumed;
+  bytes += other.bytes;
+  allocated_bytes += other.allocated_bytes;
+  peak_bytes = std::max(peak_bytes, other.peak_bytes);
+  return *this;
+}
+
+void recordTableStats(const std::string& table, const TableStats& scan) {
+  {
+    WriteLock lock(kTableStatsMutex);
+    kTableStats[table] += scan;
+  }
+
+  if (scan.generate_time_us >= kFlightRecorderMinGenerateUs) {
+    recordFlight(FlightRecordKind::TableGenerate, table, scan.generate_time_us);
+  }
+
+  if (!FLAGS_enable_numeric_monitoring) {
+    return;
+  }
+
+  auto prefix = "table." + table + ".";
+  auto sum = monitoring::PreAggregationType::Sum;
+  monitoring::record(prefix + "filters", scan.filters, sum);
+  monitoring::record(prefix + "generate_time_us", scan.generate_time_us, sum);
+  monitoring::record(prefix + "rows_produced", scan.rows_produced, sum);
+  monitoring::record(prefix + "rows_consumed", scan.rows_consumed, sum);
+  monitoring::record(prefix + "bytes", scan.bytes, sum);
+  if (allocationsCounted()) {
+    monitoring::record(prefix + "allocated_bytes", scan.allocated_bytes, sum);
+    monitoring::record(prefix + "peak_bytes",
+                       scan.peak_bytes,
+                       monitoring::PreAggregationType::Max);
+  }
+}
+
+void getTableStats(
+    std::function<void(const std::string&, const TableStats&)> predicate) {
+  ReadLock lock(kTableStatsMutex);
+  for (const auto& stats : kTableStats) {
+    predicate(stats.first, stats.second);
+  }
+}
+
+void resetTableStats() {
+  WriteLock lock(kTableStatsMutex);
+  kTableStats.clear();
+}
+
+} // namespace osquery
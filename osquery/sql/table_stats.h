@@ -0,0 +1,68 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace osquery {
+
+/**
+ * @brief Cumulative access statistics for one virtual table.
+ *
+ * Statistics are collected by the virtual table cursors and accumulated for
+ * the life of the process. They complement QueryPerformance, which only
+ * describes whole queries.
+ */
+struct TableStats {
+  /// Number of cursors opened over the table.
+  std::uint64_t scans{0};
+
+  /// Number of xFilter requests across all scans.
+  std::uint64_t filters{0};
+
+  /// Time in microseconds spent inside the table's generate or generator.
+  std::uint64_t generate_time_us{0};
+
+  /// Rows returned by the table implementation.
+  std::uint64_t rows_produced{0};
+
+  /// Rows SQLite advanced past, fewer than produced when a scan stops early.
+  std::uint64_t rows_consumed{0};
+
+  /// Estimated bytes of the produced rows.
+  std::uint64_t bytes{0};
+
+  /// Heap bytes allocated while generating, see ScopedAllocationAccount.
+  std::uint64_t allocated_bytes{0};
+
+  /// The most heap bytes held by a single generation.
+  std::uint64_t peak_bytes{0};
+
+  TableStats& operator+=(const TableStats& other);
+};
+
+/**
+ * @brief Add the statistics of a finished scan to the table's totals.
+ *
+ * When numeric monitoring is enabled the scan is also recorded as a set of
+ * "table.<name>.*" points pre-aggregated with a sum.
+ */
+void recordTableStats(const std::string& table, const TableStats& scan);
+
+/// Visit the accumulated statistics for every table that has been scanned.
+void getTableStats(
+    std::function<void(const std::string&, const TableStats&)> predicate);
+
+/// Reset all accumulated statistics.
+void resetTableStats();
+
+} // namespace osquery
@@ -81,6 +81,21 @@ TEST_F(SQLTests, test_raw_access_context) {
   EXPECT_EQ(results[0]["test_int"], "2");
 }
 
+TEST_F(SQLTests, test_deserialize_typed_table_rows) {
+  // Typed rows serialize their numeric columns as JSON numbers.
+  TableRows rows;
+  auto status = deserializeTableRowsJSON(
+      "[{\"name\":\"init\",\"pid\":1,\"size\":18446744073709551615}]",
+      rows);
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(rows.size(), 1U);
+
+  auto row = static_cast<Row>(*rows[0]);
+  EXPECT_EQ(row["name"], "init");
+  EXPECT_EQ(row["pid"], "1");
+  EXPECT_EQ(row["size"], "18446744073709551615");
+}
+
 TEST_F(SQLTests, test_sql_escape) {
   std::string input = "しかたがない";
   escapeNonPrintableBytesEx(input);
@@ -116,6 +131,15 @@ TEST_F(SQLTests, test_sql_escape) {
   input = "The quick brown fox jumps over the lazy dog.";
   escapeNonPrintableBytesEx(input);
   EXPECT_EQ(input, "The quick brown fox jumps over the lazy dog.");
+
+  // Bytes are escaped at any offset, after and within printable words.
+  input = std::string("0123456789abcdef\x7F\x1F", 18);
+  escapeNonPrintableBytesEx(input);
+  EXPECT_EQ(input, "0123456789abcdef\x7F\\x1F");
+
+  input = std::string("abcdefg\0hij", 11);
+  escapeNonPrintableBytesEx(input);
+  EXPECT_EQ(input, "abcdefg\\x00hij");
 }
 
 TEST_F(SQLTests, test_sql_base64_encode) {
@@ -265,6 +289,28 @@ TEST_F(SQLTests, test_regex_match_too_big) {
             0);
 }
 
+TEST_F(SQLTests, test_regex_match_rows) {
+  QueryData d;
+  // The compiled patterns are reused, both constant and per row patterns.
+  query(
+      "with recursive numbers(i) as (select 0 union all select i + 1 from \
+                numbers where i < 299) \
+       select i, regex_match('id' || i, 'id(\\d+)', 1) as t0, \
+                regex_match('a' || (i % 3), 'a' || (i % 3), 0) as t1, \
+                regex_match('a' || (i % 3), 'a[' || (i % 3) || ']', 0) as t2, \
+                regex_split('a-b_c', '[' || substr('-_', i % 2 + 1, 1) || ']', \
+                            1) as t3 \
+       from numbers",
+      d);
+  ASSERT_EQ(d.size(), 300U);
+  for (size_t i = 0; i < d.size(); ++i) {
+    EXPECT_EQ(d[i]["t0"], std::to_string(i));
+    EXPECT_EQ(d[i]["t1"], "a" + std::to_string(i % 3));
+    EXPECT_EQ(d[i]["t2"], "a" + std::to_string(i % 3));
+    EXPECT_EQ(d[i]["t3"], (i % 2 == 0) ? "b_c" : "c");
+  }
+}
+
 /*
  * split
  */
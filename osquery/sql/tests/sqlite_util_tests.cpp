@@ -13,6 +13,7 @@
 #include <osquery/registry/registry_interface.h>
 #include <osquery/sql/sql.h>
 #include <osquery/sql/sqlite_util.h>
+#include <osquery/sql/virtual_table.h>
 #include <osquery/sql/tests/sql_test_utils.h>
 #include <osquery/utils/info/platform_type.h>
 
@@ -185,6 +186,82 @@ TEST_F(SQLiteUtilTests, test_affected_tables) {
   EXPECT_EQ(dbc->affected_tables_.size(), 0U);
 }
 
+TEST_F(SQLiteUtilTests, test_duplicate_column_names) {
+  auto dbc = getTestDBC();
+  QueryDataTyped results;
+  auto status =
+      queryInternal("select 1 as b, 2 as a, 'x' as c, 3 as a", results, dbc);
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(results.size(), 1U);
+
+  // The last column of a repeated name is kept.
+  RowTyped expected = {{"a", 3LL}, {"b", 1LL}, {"c", "x"}};
+  EXPECT_EQ(results[0], expected);
+}
+
+TEST_F(SQLiteUtilTests, test_memory_policy) {
+  auto disable_watchdog = Flag::getValue("disable_watchdog");
+  const uint64_t mb = 1024 * 1024;
+
+  // Without the watchdog only the explicit limit applies.
+  Flag::updateValue("disable_watchdog", "true");
+  Flag::updateValue("sql_memory_limit", "0");
+  EXPECT_EQ(getSQLiteMemoryLimit(), 0U);
+  Flag::updateValue("sql_memory_limit", "500");
+  EXPECT_EQ(getSQLiteMemoryLimit(), 500 * mb);
+
+  // With the watchdog the limit is part of the worker memory limit.
+  Flag::updateValue("disable_watchdog", "false");
+  Flag::updateValue("watchdog_memory_limit", "200");
+  EXPECT_EQ(getSQLiteMemoryLimit(), 200 * mb);
+  Flag::updateValue("sql_memory_limit", "0");
+  EXPECT_EQ(getSQLiteMemoryLimit(), 50 * mb);
+
+  Flag::updateValue("sql_mmap_size", "64");
+  EXPECT_EQ(getSQLiteMmapSize(), 50 * mb);
+
+  // Temporary B-trees are kept in memory.
+  auto dbc = SQLiteDBManager::getUnique();
+  QueryDataTyped results;
+  ASSERT_TRUE(queryInternal("PRAGMA temp_store", results, dbc).ok());
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(results[0]["temp_store"], RowDataTyped(2LL));
+
+  Flag::updateValue("sql_mmap_size", "0");
+  Flag::updateValue("watchdog_memory_limit", "0");
+  Flag::updateValue("disable_watchdog", disable_watchdog);
+}
+
+TEST_F(SQLiteUtilTests, test_prepared_statement_cache) {
+  auto dbc = getTestDBC();
+  std::string query = "SELECT path FROM file WHERE path = '/'";
+
+  QueryDataTyped results;
+  ASSERT_TRUE(queryInternal(query, results, dbc).ok());
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(dbc->statements().size(), 1U);
+  dbc->clearAffectedTables();
+
+  // The reused statement must still apply the required path constraint.
+  results.clear();
+  ASSERT_TRUE(queryInternal(query, results, dbc).ok());
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(boost::get<std::string>(results[0]["path"]), "/");
+  EXPECT_EQ(dbc->statements().size(), 1U);
+  dbc->clearAffectedTables();
+
+  // Queries with several statements are not cached.
+  results.clear();
+  ASSERT_TRUE(
+      queryInternal("SELECT 1 AS a; SELECT 2 AS a;", results, dbc).ok());
+  EXPECT_EQ(results.size(), 2U);
+  EXPECT_EQ(dbc->statements().size(), 1U);
+
+  // Attaching or detaching tables invalidates the cache.
+  detachTableInternal("time", dbc);
+  EXPECT_EQ(dbc->statements().size(), 0U);
+}
+
 TEST_F(SQLiteUtilTests, test_table_attributes_event_based) {
   {
     SQLInternal sql_internal("select * from process_events");
@@ -451,6 +528,45 @@ TEST_F(SQLiteUtilTests, test_enable) {
   ASSERT_TRUE(SQLiteDBManager::isDisabled("fake_table"));
 }
 
+TEST_F(SQLiteUtilTests, test_sqlite_file_handle) {
+  auto path = boost::filesystem::temp_directory_path() /
+              boost::filesystem::unique_path("osquery.atc.%%%%.%%%%.db");
+  auto write = [&path](const std::string& query) {
+    sqlite3* db = nullptr;
+    ASSERT_EQ(sqlite3_open(path.string().c_str(), &db), SQLITE_OK);
+    EXPECT_EQ(sqlite3_exec(db, query.c_str(), nullptr, nullptr, nullptr),
+              SQLITE_OK);
+    sqlite3_close(db);
+  };
+  write("CREATE TABLE t (id int, name text); INSERT INTO t VALUES (1, 'a')");
+
+  SqliteFileHandle handle(path);
+  TableRows rows;
+  auto query = "SELECT name FROM t WHERE id = ?";
+  ASSERT_TRUE(handle.query(query, {"1"}, rows).ok());
+  ASSERT_EQ(rows.size(), 1U);
+  auto row = static_cast<Row>(*rows[0]);
+  EXPECT_EQ(row["name"], "a");
+  EXPECT_EQ(row["path"], path.string());
+
+  // Changes are seen by the kept connection.
+  write("INSERT INTO t VALUES (1, 'b')");
+  rows.clear();
+  ASSERT_TRUE(handle.query(query, {"1"}, rows).ok());
+  EXPECT_EQ(rows.size(), 2U);
+
+  // A replaced file is reopened.
+  boost::filesystem::remove(path);
+  write("CREATE TABLE t (id int, name text); INSERT INTO t VALUES (1, 'c')");
+  rows.clear();
+  ASSERT_TRUE(handle.query(query, {"1"}, rows).ok());
+  ASSERT_EQ(rows.size(), 1U);
+  EXPECT_EQ(static_cast<Row>(*rows[0])["name"], "c");
+
+  boost::filesystem::remove(path);
+  EXPECT_FALSE(handle.query(query, {"1"}, rows).ok());
+}
+
 TEST_F(SQLiteUtilTests, test_sqlite_authorizer) {
   auto rc = sqliteAuthorizer(
       nullptr, SQLITE_ATTACH, nullptr, nullptr, nullptr, nullptr);
@@ -7,6 +7,9 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <atomic>
+#include <thread>
+
 #include <gtest/gtest.h>
 
 #include <osquery/core/core.h>
@@ -15,13 +18,22 @@
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry.h>
 #include <osquery/sql/dynamic_table_row.h>
+#include <osquery/sql/query_cost.h>
 #include <osquery/sql/sql.h>
+#include <osquery/sql/step_generations.h>
+#include <osquery/sql/table_row_batch.h>
 
 #include <osquery/sql/virtual_table.h>
 
 namespace osquery {
 
 DECLARE_bool(ignore_table_exceptions);
+DECLARE_uint64(table_generator_window);
+DECLARE_bool(table_static_results);
+DECLARE_uint64(sql_statement_cache_size);
+DECLARE_uint64(table_prefetch_threads);
+DECLARE_bool(schedule_share_tables);
+DECLARE_uint64(boot_stable_table_ttl);
 
 class VirtualTableTests : public testing::Test {
  public:
@@ -66,6 +78,7 @@ class optionsTablePlugin : public TablePlugin {
 
  private:
   FRIEND_TEST(VirtualTableTests, test_tableplugin_options);
+  FRIEND_TEST(VirtualTableTests, test_query_cost);
 };
 
 TEST_F(VirtualTableTests, test_tableplugin_options) {
@@ -253,6 +266,33 @@ TEST_F(VirtualTableTests, test_sqlite3_table_joins) {
   ASSERT_EQ(results.size(), 1U);
 }
 
+TEST_F(VirtualTableTests, test_lazy_attach) {
+  auto tables = RegistryFactory::get().registry("table");
+  tables->add("lazy", std::make_shared<aliasesTablePlugin>());
+  auto dbc = SQLiteDBManager::getUnique();
+
+  // Tables are not created until a statement uses them.
+  QueryData results;
+  auto status = queryInternal(
+      "SELECT name FROM sqlite_temp_master WHERE tbl_name = 'lazy'",
+      results,
+      dbc);
+  ASSERT_TRUE(status.ok());
+  EXPECT_TRUE(results.empty());
+
+  status = queryInternal("SELECT username FROM lazy", results, dbc);
+  EXPECT_TRUE(status.ok()) << status.getMessage();
+
+  // Aliases are modules of the same table, rather than views.
+  status = queryInternal(
+      "SELECT user_name FROM aliases1 WHERE name1 = 'a'", results, dbc);
+  EXPECT_TRUE(status.ok()) << status.getMessage();
+
+  detachTableInternal("lazy", dbc);
+  EXPECT_FALSE(queryInternal("SELECT * FROM lazy", results, dbc).ok());
+  EXPECT_FALSE(queryInternal("SELECT * FROM aliases2", results, dbc).ok());
+}
+
 class pTablePlugin : public TablePlugin {
  private:
   TableColumns columns() const override {
@@ -681,6 +721,654 @@ TEST_F(VirtualTableTests, test_yield_generator) {
   EXPECT_EQ(results[0]["index"], "10");
 }
 
+class batchTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("name", TEXT_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("value", INTEGER_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("ratio", DOUBLE_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+ public:
+  TableRows generate(QueryContext&) override {
+    auto batch = std::make_shared<TableRowBatch>(columns());
+    for (size_t i = 0; i < 3; i++) {
+      auto row = batch->addRow();
+      batch->set(row, 0, "row" + std::to_string(i));
+      if (i == 0) {
+        batch->set(row, "value", "0");
+        batch->setDouble(row, 2, 0.5);
+      } else if (i == 2) {
+        batch->setInteger(row, 1, 20);
+        batch->set(row, "ratio", "1.500000");
+      }
+    }
+
+    // Text that does not round-trip is kept and cast like a dynamic row.
+    auto row = batch->addRow();
+    batch->set(row, 0, "row3");
+    batch->set(row, 1, "0x10");
+    batch->set(row, 2, "2.5");
+    return tableRowsFromBatch(batch);
+  }
+
+ private:
+  FRIEND_TEST(VirtualTableTests, test_table_row_batch);
+};
+
+TEST_F(VirtualTableTests, test_table_row_batch) {
+  auto table = std::make_shared<batchTablePlugin>();
+  auto table_registry = RegistryFactory::get().registry("table");
+  table_registry->add("batch", table);
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("batch", table->columnDefinition(false), dbc, false);
+
+  QueryData results;
+  auto status = queryInternal(
+      "SELECT name, value, typeof(value) AS t, ratio, typeof(ratio) AS r "
+      "FROM batch",
+      results,
+      dbc);
+  dbc->clearAffectedTables();
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(results.size(), 4U);
+  EXPECT_EQ(results[0]["name"], "row0");
+  EXPECT_EQ(results[0]["t"], "integer");
+  EXPECT_EQ(results[0]["r"], "real");
+  EXPECT_EQ(results[0]["ratio"], "0.5");
+  EXPECT_EQ(results[2]["value"], "20");
+  EXPECT_EQ(results[2]["ratio"], "1.5");
+  EXPECT_EQ(results[3]["value"], "16");
+  EXPECT_EQ(results[3]["ratio"], "2.5");
+  // Unset numeric cells are NULL.
+  EXPECT_EQ(results[1]["t"], "null");
+  EXPECT_EQ(results[1]["r"], "null");
+
+  // Views convert back into string maps containing only the set cells.
+  QueryContext context;
+  auto rows = table->generate(context);
+  ASSERT_EQ(rows.size(), 4U);
+  auto r = static_cast<Row>(*rows[1]);
+  EXPECT_EQ(r.size(), 1U);
+  EXPECT_EQ(r["name"], "row1");
+
+  auto copy = rows[2]->clone();
+  EXPECT_EQ(static_cast<Row>(*copy)["value"], "20");
+  EXPECT_EQ(static_cast<Row>(*copy)["ratio"], "1.500000");
+  EXPECT_EQ(static_cast<Row>(*rows[0])["ratio"], "0.500000");
+  EXPECT_EQ(static_cast<Row>(*rows[3])["value"], "0x10");
+}
+
+class staticTextTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("name", TEXT_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("size", INTEGER_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+ public:
+  bool usesGenerator() const override {
+    return use_generator_;
+  }
+
+  TableRows generate(QueryContext&) override {
+    TableRows rows;
+    for (size_t i = 0; i < 100; i++) {
+      rows.push_back(makeRow(i));
+    }
+    return rows;
+  }
+
+  void generator(RowYield& yield, QueryContext&) override {
+    for (size_t i = 0; i < 100; i++) {
+      yield(makeRow(i));
+    }
+  }
+
+ private:
+  TableRowHolder makeRow(size_t i) {
+    auto r = make_table_row();
+    // Use text longer than any small string buffer.
+    r["name"] = std::string(32, 'a' + static_cast<char>(i % 26)) +
+                std::to_string(i);
+    r["size"] = INTEGER(i % 10);
+    return r;
+  }
+
+ public:
+  bool use_generator_{false};
+
+ private:
+  FRIEND_TEST(VirtualTableTests, test_table_static_results);
+};
+
+TEST_F(VirtualTableTests, test_table_static_results) {
+  auto table = std::make_shared<staticTextTablePlugin>();
+  auto table_registry = RegistryFactory::get().registry("table");
+  table_registry->add("static_text", table);
+
+  auto static_results = FLAGS_table_static_results;
+  FLAGS_table_static_results = true;
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal(
+      "static_text", table->columnDefinition(false), dbc, false);
+
+  for (const auto use_generator : {false, true}) {
+    table->use_generator_ = use_generator;
+
+    // Aggregates and sorters keep column text after the cursor moves on.
+    QueryData results;
+    auto status = queryInternal(
+        "SELECT max(name) AS m, min(name) AS n, count(*) AS c "
+        "FROM static_text",
+        results,
+        dbc);
+    dbc->clearAffectedTables();
+    ASSERT_TRUE(status.ok()) << status.getMessage();
+    ASSERT_EQ(results.size(), 1U);
+    EXPECT_EQ(results[0]["m"], std::string(32, 'z') + "77");
+    EXPECT_EQ(results[0]["n"], std::string(32, 'a') + "0");
+    EXPECT_EQ(results[0]["c"], "100");
+
+    results.clear();
+    status = queryInternal(
+        "SELECT substr(name, 33) AS i FROM static_text WHERE size = 0 "
+        "ORDER BY name DESC",
+        results,
+        dbc);
+    dbc->clearAffectedTables();
+    ASSERT_TRUE(status.ok()) << status.getMessage();
+    std::vector<std::string> order;
+    for (auto& row : results) {
+      order.push_back(row["i"]);
+    }
+    std::vector<std::string> expected = {
+        "50", "20", "70", "40", "90", "10", "60", "30", "80", "0"};
+    EXPECT_EQ(order, expected);
+  }
+
+  FLAGS_table_static_results = static_results;
+}
+
+class prefetchTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("id", INTEGER_TYPE, ColumnOptions::INDEX),
+    };
+  }
+
+ public:
+  TableRows generate(QueryContext&) override {
+    // Record the thread of the first scan.
+    if (generates_++ == 0) {
+      thread_ = std::this_thread::get_id();
+    }
+    TableRows rows;
+    for (size_t i = 0; i < 3; i++) {
+      auto r = make_table_row();
+      r["id"] = INTEGER(i);
+      rows.push_back(std::move(r));
+    }
+    return rows;
+  }
+
+ public:
+  std::atomic<size_t> generates_{0};
+  std::thread::id thread_;
+
+ private:
+  FRIEND_TEST(VirtualTableTests, test_table_prefetch);
+};
+
+TEST_F(VirtualTableTests, test_table_prefetch) {
+  auto first = std::make_shared<prefetchTablePlugin>();
+  auto second = std::make_shared<prefetchTablePlugin>();
+  auto table_registry = RegistryFactory::get().registry("table");
+  table_registry->add("prefetch_first", first);
+  table_registry->add("prefetch_second", second);
+
+  auto prefetch_threads = FLAGS_table_prefetch_threads;
+  FLAGS_table_prefetch_threads = 2;
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal(
+      "prefetch_first", first->columnDefinition(false), dbc, false);
+  attachTableInternal(
+      "prefetch_second", second->columnDefinition(false), dbc, false);
+
+  // Unconstrained tables are generated before the statement runs.
+  QueryData results;
+  auto status = queryInternal(
+      "SELECT * FROM prefetch_first, prefetch_second", results, dbc);
+  dbc->clearAffectedTables();
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ(results.size(), 9U);
+  EXPECT_NE(first->thread_, std::this_thread::get_id());
+  EXPECT_NE(second->thread_, std::this_thread::get_id());
+
+  // A table joined on another table's values depends on it.
+  first->generates_ = 0;
+  second->generates_ = 0;
+  results.clear();
+  status = queryInternal(
+      "SELECT * FROM prefetch_first f JOIN prefetch_second s "
+      "ON f.id = s.id",
+      results,
+      dbc);
+  dbc->clearAffectedTables();
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ(results.size(), 3U);
+  EXPECT_EQ(first->thread_, std::this_thread::get_id());
+  EXPECT_EQ(second->thread_, std::this_thread::get_id());
+
+  // Disabled prefetching generates on the query thread.
+  FLAGS_table_prefetch_threads = 0;
+  first->generates_ = 0;
+  results.clear();
+  status = queryInternal(
+      "SELECT * FROM prefetch_first, prefetch_second", results, dbc);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(results.size(), 9U);
+  EXPECT_EQ(first->thread_, std::this_thread::get_id());
+
+  FLAGS_table_prefetch_threads = prefetch_threads;
+}
+
+class stepSharedTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("id", INTEGER_TYPE, ColumnOptions::INDEX),
+        std::make_tuple("name", TEXT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+ public:
+  TableRows generate(QueryContext&) override {
+    generates_++;
+    TableRows rows;
+    for (size_t i = 0; i < 3; i++) {
+      auto r = make_table_row();
+      r["id"] = INTEGER(i);
+      r["name"] = "name" + std::to_string(i);
+      rows.push_back(std::move(r));
+    }
+    return rows;
+  }
+
+ public:
+  size_t generates_{0};
+
+ private:
+  FRIEND_TEST(VirtualTableTests, test_step_generations);
+};
+
+TEST_F(VirtualTableTests, test_step_generations) {
+  auto table = std::make_shared<stepSharedTablePlugin>();
+  auto table_registry = RegistryFactory::get().registry("table");
+  table_registry->add("step_shared", table);
+
+  auto share_tables = FLAGS_schedule_share_tables;
+  FLAGS_schedule_share_tables = true;
+  auto step = TablePlugin::kCacheStep;
+  TablePlugin::kCacheStep = 5;
+  resetStepGenerations();
+
+  auto dbc = SQLiteDBManager::getUnique();
+  dbc->useCache(true);
+  attachTableInternal(
+      "step_shared", table->columnDefinition(false), dbc, false);
+
+  auto query = [&dbc](const std::string& sql) {
+    QueryData results;
+    auto status = queryInternal(sql, results, dbc);
+    dbc->clearAffectedTables();
+    EXPECT_TRUE(status.ok()) << status.getMessage();
+    return results;
+  };
+
+  EXPECT_EQ(query("SELECT id FROM step_shared").size(), 3U);
+  EXPECT_EQ(table->generates_, 1U);
+
+  // The first generation did not include every column.
+  EXPECT_EQ(query("SELECT * FROM step_shared").size(), 3U);
+  EXPECT_EQ(table->generates_, 2U);
+
+  // SQLite filters the unconstrained generation.
+  auto results = query("SELECT name FROM step_shared WHERE id = 1");
+  EXPECT_EQ(table->generates_, 2U);
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(results[0]["name"], "name1");
+
+  // Generations are not shared across steps.
+  TablePlugin::kCacheStep = 6;
+  EXPECT_EQ(query("SELECT * FROM step_shared").size(), 3U);
+  EXPECT_EQ(table->generates_, 3U);
+
+  // Only scheduled queries share generations.
+  dbc->useCache(false);
+  EXPECT_EQ(query("SELECT * FROM step_shared").size(), 3U);
+  EXPECT_EQ(table->generates_, 4U);
+
+  resetStepGenerations();
+  TablePlugin::kCacheStep = step;
+  FLAGS_schedule_share_tables = share_tables;
+}
+
+class bootStableTablePlugin : public stepSharedTablePlugin {
+ private:
+  TableAttributes attributes() const override {
+    return TableAttributes::BOOT_STABLE;
+  }
+
+ private:
+  FRIEND_TEST(VirtualTableTests, test_boot_generations);
+};
+
+TEST_F(VirtualTableTests, test_boot_generations) {
+  auto table = std::make_shared<bootStableTablePlugin>();
+  auto table_registry = RegistryFactory::get().registry("table");
+  table_registry->add("boot_stable", table);
+
+  auto ttl = FLAGS_boot_stable_table_ttl;
+  FLAGS_boot_stable_table_ttl = 3600;
+  resetBootGenerations();
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal(
+      "boot_stable", table->columnDefinition(false), dbc, false);
+
+  auto query = [&dbc](const std::string& sql) {
+    QueryData results;
+    auto status = queryInternal(sql, results, dbc);
+    dbc->clearAffectedTables();
+    EXPECT_TRUE(status.ok()) << status.getMessage();
+    return results;
+  };
+
+  // Queries outside of the schedule reuse the rows too.
+  EXPECT_EQ(query("SELECT * FROM boot_stable").size(), 3U);
+  EXPECT_EQ(query("SELECT id FROM boot_stable").size(), 3U);
+  auto results = query("SELECT name FROM boot_stable WHERE id = 2");
+  EXPECT_EQ(table->generates_, 1U);
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(results[0]["name"], "name2");
+
+  // A device change releases the rows.
+  resetBootGenerations();
+  EXPECT_EQ(query("SELECT * FROM boot_stable").size(), 3U);
+  EXPECT_EQ(table->generates_, 2U);
+
+  FLAGS_boot_stable_table_ttl = 0;
+  EXPECT_EQ(query("SELECT * FROM boot_stable").size(), 3U);
+  EXPECT_EQ(table->generates_, 3U);
+
+  resetBootGenerations();
+  FLAGS_boot_stable_table_ttl = ttl;
+}
+
+class windowedYieldTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("index", INTEGER_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+ public:
+  bool usesGenerator() const override {
+    return true;
+  }
+
+  void generator(RowYield& yield, QueryContext& qc) override {
+    for (size_t i = 0; i < 1000; i++) {
+      auto r = make_table_row();
+      r["index"] = std::to_string(i);
+      generated_++;
+      yield(std::move(r));
+    }
+  }
+
+ public:
+  std::atomic<size_t> generated_{0};
+
+ private:
+  FRIEND_TEST(VirtualTableTests, test_yield_generator_window);
+  FRIEND_TEST(VirtualTableTests, test_table_stats);
+  FRIEND_TEST(VirtualTableTests, test_table_stats_window);
+};
+
+TEST_F(VirtualTableTests, test_yield_generator_window) {
+  auto table = std::make_shared<windowedYieldTablePlugin>();
+  auto table_registry = RegistryFactory::get().registry("table");
+  table_registry->add("windowed_yield", table);
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal(
+      "windowed_yield", table->columnDefinition(false), dbc, false);
+
+  auto window = FLAGS_table_generator_window;
+  FLAGS_table_generator_window = 4;
+
+  QueryData results;
+  queryInternal("SELECT * from windowed_yield", results, dbc);
+  dbc->clearAffectedTables();
+  ASSERT_EQ(results.size(), 1000U);
+  EXPECT_EQ(results[0]["index"], "0");
+  EXPECT_EQ(results[999]["index"], "999");
+
+  // A satisfied LIMIT stops the producer, leaving at most a window of rows.
+  table->generated_ = 0;
+  results.clear();
+  queryInternal("SELECT * from windowed_yield LIMIT 5", results, dbc);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(results.size(), 5U);
+  EXPECT_LT(table->generated_, 12U);
+
+  FLAGS_table_generator_window = window;
+}
+
+TEST_F(VirtualTableTests, test_table_stats) {
+  auto table = std::make_shared<windowedYieldTablePlugin>();
+  auto table_registry = RegistryFactory::get().registry("table");
+  table_registry->add("stats_yield", table);
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal(
+      "stats_yield", table->columnDefinition(false), dbc, false);
+
+  resetTableStats();
+  QueryData results;
+  queryInternal("SELECT * from stats_yield LIMIT 10", results, dbc);
+  dbc->clearAffectedTables();
+  ASSERT_EQ(results.size(), 10U);
+
+  bool found = false;
+  getTableStats([&found](const std::string& name, const TableStats& stats) {
+    if (name != "stats_yield") {
+      return;
+    }
+    found = true;
+    EXPECT_EQ(stats.scans, 1U);
+    EXPECT_EQ(stats.filters, 1U);
+    // The generator stops shortly after the LIMIT is satisfied.
+    EXPECT_GE(stats.rows_produced, 10U);
+    EXPECT_LT(stats.rows_produced, 1000U);
+    EXPECT_GE(stats.rows_consumed, 9U);
+    EXPECT_LE(stats.rows_consumed, stats.rows_produced);
+    EXPECT_GT(stats.bytes, 0U);
+  });
+  EXPECT_TRUE(found);
+}
+
+TEST_F(VirtualTableTests, test_table_stats_window) {
+  auto table = std::make_shared<windowedYieldTablePlugin>();
+  auto table_registry = RegistryFactory::get().registry("table");
+  table_registry->add("stats_window", table);
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal(
+      "stats_window", table->columnDefinition(false), dbc, false);
+
+  auto window = FLAGS_table_generator_window;
+  FLAGS_table_generator_window = 4;
+
+  resetTableStats();
+  QueryData results;
+  queryInternal("SELECT * from stats_window", results, dbc);
+  dbc->clearAffectedTables();
+  FLAGS_table_generator_window = window;
+  ASSERT_EQ(results.size(), 1000U);
+
+  // The producer's statistics are recorded with the cursor's, as one scan.
+  size_t recorded = 0;
+  getTableStats([&recorded](const std::string& name, const TableStats& stats) {
+    if (name != "stats_window") {
+      return;
+    }
+    recorded++;
+    EXPECT_EQ(stats.scans, 1U);
+    EXPECT_EQ(stats.filters, 1U);
+    EXPECT_EQ(stats.rows_produced, 1000U);
+    EXPECT_EQ(stats.rows_consumed, 1000U);
+    EXPECT_GT(stats.bytes, 0U);
+  });
+  EXPECT_EQ(recorded, 1U);
+}
+
+class inListTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("i", TEXT_TYPE, ColumnOptions::INDEX),
+    };
+  }
+
+  TableEstimates estimates() const override {
+    return {100U, 500.0};
+  }
+
+ public:
+  TableRows generate(QueryContext& context) override {
+    generates_++;
+    TableRows results;
+    auto values = context.constraints["i"].getAll(EQUALS);
+    for (const auto& value : values) {
+      results.push_back(make_table_row({{"i", value}}));
+    }
+    return results;
+  }
+
+  size_t generates_{0};
+
+ private:
+  FRIEND_TEST(VirtualTableTests, test_in_list_constraints);
+};
+
+TEST_F(VirtualTableTests, test_in_list_constraints) {
+  auto table = std::make_shared<inListTablePlugin>();
+  auto table_registry = RegistryFactory::get().registry("table");
+  table_registry->add("in_list", table);
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("in_list", table->columnDefinition(false), dbc, false);
+
+  // The routed column information includes the planner hints.
+  PluginResponse response;
+  Registry::call("table", "in_list", {{"action", "columns"}}, response);
+  bool has_estimates = false;
+  for (const auto& item : response) {
+    if (item.at("id") == "estimates") {
+      has_estimates = true;
+      EXPECT_EQ(item.at("rows"), "100");
+    }
+  }
+  EXPECT_TRUE(has_estimates);
+
+  // An IN list is passed to the table in a single call.
+  QueryData results;
+  auto status = queryInternal(
+      "SELECT * FROM in_list WHERE i IN ('a', 'b', 'c')", results, dbc);
+  dbc->clearAffectedTables();
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ(results.size(), 3U);
+  EXPECT_EQ(table->generates_, 1U);
+}
+
+class columnGroupsTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("id", INTEGER_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("size", INTEGER_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("hash", TEXT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  ColumnGroups columnGroups() const override {
+    return {{"content", {"size", "hash"}}};
+  }
+
+ public:
+  TableRows generate(QueryContext& context) override {
+    content_used_ = context.isColumnGroupUsed("content");
+    unknown_used_ = context.isColumnGroupUsed("unknown");
+    auto r = make_table_row({{"id", "1"}});
+    if (content_used_) {
+      r["size"] = "10";
+      r["hash"] = "abc";
+    }
+    TableRows results;
+    results.push_back(std::move(r));
+    return results;
+  }
+
+  bool content_used_{false};
+  bool unknown_used_{false};
+
+ private:
+  FRIEND_TEST(VirtualTableTests, test_column_groups);
+};
+
+TEST_F(VirtualTableTests, test_column_groups) {
+  auto table = std::make_shared<columnGroupsTablePlugin>();
+  auto table_registry = RegistryFactory::get().registry("table");
+  table_registry->add("column_groups", table);
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal(
+      "column_groups", table->columnDefinition(false), dbc, false);
+
+  // Columns outside of the group do not need its source.
+  QueryData results;
+  queryInternal("SELECT id FROM column_groups", results, dbc);
+  dbc->clearAffectedTables();
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_FALSE(table->content_used_);
+  EXPECT_TRUE(table->unknown_used_);
+
+  // Constraining a grouped column uses the group.
+  results.clear();
+  queryInternal("SELECT id FROM column_groups WHERE size = 10", results, dbc);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(results.size(), 1U);
+  EXPECT_TRUE(table->content_used_);
+
+  results.clear();
+  queryInternal("SELECT hash FROM column_groups", results, dbc);
+  dbc->clearAffectedTables();
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_TRUE(table->content_used_);
+  EXPECT_EQ(results[0]["hash"], "abc");
+}
+
 class likeTablePlugin : public TablePlugin {
  private:
   TableColumns columns() const override {
@@ -717,6 +1405,7 @@ class likeTablePlugin : public TablePlugin {
 
  private:
   FRIEND_TEST(VirtualTableTests, test_like_constraints);
+  FRIEND_TEST(VirtualTableTests, test_best_index_plans);
 };
 
 TEST_F(VirtualTableTests, test_like_constraints) {
@@ -788,6 +1477,49 @@ TEST_F(VirtualTableTests, test_like_constraints) {
   EXPECT_EQ(results[1]["op"], "LIKE");
 }
 
+TEST_F(VirtualTableTests, test_best_index_plans) {
+  auto table = std::make_shared<likeTablePlugin>();
+  auto table_registry = RegistryFactory::get().registry("table");
+  table_registry->add("planned_like", table);
+
+  // Prepare every query so each execution is planned again.
+  auto cache_size = FLAGS_sql_statement_cache_size;
+  FLAGS_sql_statement_cache_size = 0;
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal(
+      "planned_like", table->columnDefinition(false), dbc, false);
+
+  // Memoized plans must produce the same constraints for each shape.
+  for (size_t i = 0; i < 3; i++) {
+    QueryData results;
+    queryInternal("SELECT * FROM planned_like WHERE i = 'a'", results, dbc);
+    dbc->clearAffectedTables();
+    ASSERT_EQ(results.size(), 1U);
+    EXPECT_EQ(results[0]["i"], "a");
+
+    results.clear();
+    queryInternal("SELECT * FROM planned_like", results, dbc);
+    dbc->clearAffectedTables();
+    EXPECT_EQ(results.size(), 0U);
+
+    results.clear();
+    queryInternal(
+        "SELECT * FROM planned_like WHERE i IN ('b', 'c')", results, dbc);
+    dbc->clearAffectedTables();
+    EXPECT_EQ(results.size(), 2U);
+
+    results.clear();
+    queryInternal(
+        "SELECT * FROM planned_like WHERE i LIKE 'd%'", results, dbc);
+    dbc->clearAffectedTables();
+    ASSERT_EQ(results.size(), 1U);
+    EXPECT_EQ(results[0]["op"], "LIKE");
+  }
+
+  FLAGS_sql_statement_cache_size = cache_size;
+}
+
 class indexIOptimizedTablePlugin : public TablePlugin {
  private:
   TableColumns columns() const override {
@@ -1239,4 +1971,90 @@ TEST_F(VirtualTableTests, test_table_exceptions) {
   FLAGS_ignore_table_exceptions = backup_flag;
 }
 
+class costScanTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("x", INTEGER_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  TableEstimates estimates() const override {
+    return {50U, 0};
+  }
+
+ public:
+  TableRows generate(QueryContext&) override {
+    return {};
+  }
+
+ private:
+  FRIEND_TEST(VirtualTableTests, test_query_cost);
+};
+
+TEST_F(VirtualTableTests, test_query_cost) {
+  auto table_registry = RegistryFactory::get().registry("table");
+  auto scan = std::make_shared<costScanTablePlugin>();
+  table_registry->add("cost_scan", scan);
+  auto required = std::make_shared<optionsTablePlugin>();
+  table_registry->add("cost_required", required);
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("cost_scan", scan->columnDefinition(false), dbc, false);
+  attachTableInternal(
+      "cost_required", required->columnDefinition(false), dbc, false);
+  resetTableStats();
+
+  // Without statistics a scan uses the table estimates.
+  QueryCost cost;
+  auto status = estimateQueryCost("SELECT * FROM cost_scan", cost, dbc);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(cost.tables.size(), 1U);
+  EXPECT_EQ(cost.tables[0].name, "cost_scan");
+  EXPECT_EQ(cost.tables[0].access, TableAccess::Scan);
+  EXPECT_FALSE(cost.tables[0].history);
+  EXPECT_EQ(cost.tables[0].rows, 50);
+  EXPECT_EQ(cost.rows, 50);
+
+  // The inner table of a cartesian join is scanned once per outer row.
+  status = estimateQueryCost(
+      "SELECT * FROM cost_scan a, cost_scan b", cost, dbc);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(cost.tables.size(), 2U);
+  EXPECT_EQ(cost.tables[1].calls, 50);
+  EXPECT_EQ(cost.rows, 50 + 50 * 50);
+  EXPECT_EQ(cost.time_ms, 51 * cost.tables[0].time_ms);
+
+  // A table missing its required column does not generate rows.
+  status = estimateQueryCost("SELECT * FROM cost_required", cost, dbc);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(cost.tables.size(), 1U);
+  EXPECT_EQ(cost.tables[0].access, TableAccess::MissingRequired);
+  EXPECT_EQ(cost.time_ms, 0);
+  EXPECT_EQ(cost.describe(), "cost_required: missing required constraint");
+
+  status = estimateQueryCost(
+      "SELECT * FROM cost_required WHERE id = 1", cost, dbc);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(cost.tables.size(), 1U);
+  EXPECT_EQ(cost.tables[0].access, TableAccess::Lookup);
+
+  // Recorded statistics replace the defaults.
+  TableStats stats;
+  stats.filters = 2;
+  stats.rows_produced = 10;
+  stats.generate_time_us = 4000;
+  recordTableStats("cost_scan", stats);
+  status = estimateQueryCost("SELECT * FROM cost_scan", cost, dbc);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(cost.tables.size(), 1U);
+  EXPECT_TRUE(cost.tables[0].history);
+  EXPECT_EQ(cost.tables[0].rows, 5);
+  EXPECT_EQ(cost.time_ms, 2);
+  EXPECT_EQ(cost.describe(), "cost_scan: scan 1x5 rows in 2ms");
+  resetTableStats();
+
+  EXPECT_FALSE(estimateQueryCost("SELECT * FROM", cost, dbc).ok());
+}
+
 } // namespace osquery
@@ -7,6 +7,10 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#ifndef WIN32
+#include <sys/stat.h>
+#endif
+
 #include <boost/algorithm/string.hpp>
 
 #include <osquery/core/core.h>
@@ -79,15 +83,11 @@ Status genSqliteTableRow(sqlite3_stmt* stmt,
   return Status::success();
 }
 
-Status genTableRowsForSqliteTable(const fs::path& sqlite_db,
-                                  const std::string& sqlite_query,
-                                  TableRows& results,
-                                  bool respect_locking) {
-  sqlite3* db = nullptr;
-  if (!pathExists(sqlite_db).ok()) {
-    return Status(1, "Database path does not exist");
-  }
-
+/// Open a database file read-only, as an ATC table reads it.
+static Status openSqliteDatabase(const fs::path& sqlite_db,
+                                 bool respect_locking,
+                                 sqlite3*& db) {
+  db = nullptr;
   auto rc = sqlite3_open_v2(
       sqlite_db.string().c_str(),
       &db,
@@ -98,20 +98,46 @@ Status genTableRowsForSqliteTable(const fs::path& sqlite_db,
             << getStringForSQLiteReturnCode(rc);
     if (db != nullptr) {
       sqlite3_close(db);
+      db = nullptr;
     }
     return Status(1, "Could not open database");
   }
 
   rc = sqlite3_set_authorizer(db, &sqliteAuthorizer, nullptr);
   if (rc != SQLITE_OK) {
-    sqlite3_close(db);
     auto errMsg =
         std::string("Failed to set sqlite authorizer: ") + sqlite3_errmsg(db);
+    sqlite3_close(db);
+    db = nullptr;
     return Status(1, errMsg);
   }
 
+  auto mmap_size = getSQLiteMmapSize();
+  if (mmap_size > 0) {
+    // Read the database pages from a mapping instead of copying them into
+    // the page cache of this connection.
+    auto pragma = "PRAGMA mmap_size=" + std::to_string(mmap_size);
+    sqlite3_exec(db, pragma.c_str(), nullptr, nullptr, nullptr);
+  }
+  return Status::success();
+}
+
+Status genTableRowsForSqliteTable(const fs::path& sqlite_db,
+                                  const std::string& sqlite_query,
+                                  TableRows& results,
+                                  bool respect_locking) {
+  if (!pathExists(sqlite_db).ok()) {
+    return Status(1, "Database path does not exist");
+  }
+
+  sqlite3* db = nullptr;
+  auto status = openSqliteDatabase(sqlite_db, respect_locking, db);
+  if (!status.ok()) {
+    return status;
+  }
+
   sqlite3_stmt* stmt = nullptr;
-  rc = sqlite3_prepare_v2(db, sqlite_query.c_str(), -1, &stmt, nullptr);
+  auto rc = sqlite3_prepare_v2(db, sqlite_query.c_str(), -1, &stmt, nullptr);
   if (rc != SQLITE_OK) {
     sqlite3_close(db);
     VLOG(1) << "ATC table: Could not prepare database at path: " << sqlite_db;
@@ -132,6 +158,125 @@ Status genTableRowsForSqliteTable(const fs::path& sqlite_db,
   return Status{};
 }
 
+/// The identity of a database file, a change reopens its connection.
+static bool getSqliteFileIdentity(const fs::path& sqlite_db,
+                                  SqliteFileHandle::Identity& identity) {
+  boost::system::error_code ec;
+  identity.size = fs::file_size(sqlite_db, ec);
+  if (ec) {
+    return false;
+  }
+  identity.mtime = fs::last_write_time(sqlite_db, ec);
+  if (ec) {
+    return false;
+  }
+#ifndef WIN32
+  struct stat file_stat;
+  if (::stat(sqlite_db.string().c_str(), &file_stat) != 0) {
+    return false;
+  }
+  identity.inode = static_cast<std::uint64_t>(file_stat.st_ino);
+#endif
+  return true;
+}
+
+SqliteFileHandle::~SqliteFileHandle() {
+  close();
+}
+
+void SqliteFileHandle::close() {
+  for (auto& statement : statements_) {
+    sqlite3_finalize(statement.second);
+  }
+  statements_.clear();
+  if (db_ != nullptr) {
+    sqlite3_close(db_);
+    db_ = nullptr;
+  }
+}
+
+Status SqliteFileHandle::open() {
+  // The locking policy follows the journal mode, see the ATC table.
+  auto s = getSqliteJournalMode(path_);
+  bool respect_locking = false;
+  if (!s.ok()) {
+    VLOG(1) << "ATC Table: Unable to detect journal mode, applying default "
+               "locking policy for path "
+            << path_;
+  } else {
+    respect_locking = s.getMessage() == "wal";
+  }
+  return openSqliteDatabase(path_, respect_locking, db_);
+}
+
+Status SqliteFileHandle::query(const std::string& sqlite_query,
+                               const std::vector<std::string>& parameters,
+                               TableRows& results) {
+  Identity identity;
+  if (!getSqliteFileIdentity(path_, identity)) {
+    close();
+    return Status(1, "Database path does not exist");
+  }
+
+  if (db_ != nullptr && identity != identity_) {
+    // The file was replaced or modified outside of a transaction.
+    close();
+  }
+
+  if (db_ == nullptr) {
+    auto status = open();
+    if (!status.ok()) {
+      return status;
+    }
+    identity_ = identity;
+  }
+
+  auto statement = statements_.find(sqlite_query);
+  if (statement == statements_.end()) {
+    if (statements_.size() >= kMaxStatements) {
+      for (auto& stale : statements_) {
+        sqlite3_finalize(stale.second);
+      }
+      statements_.clear();
+    }
+
+    sqlite3_stmt* prepared = nullptr;
+    auto rc =
+        sqlite3_prepare_v2(db_, sqlite_query.c_str(), -1, &prepared, nullptr);
+    if (rc != SQLITE_OK) {
+      VLOG(1) << "ATC table: Could not prepare database at path: " << path_;
+      return Status(rc, "Could not prepare database");
+    }
+    statement = statements_.emplace(sqlite_query, prepared).first;
+  }
+
+  auto stmt = statement->second;
+  for (size_t i = 0; i < parameters.size(); ++i) {
+    sqlite3_bind_text(stmt,
+                      static_cast<int>(i + 1),
+                      parameters[i].c_str(),
+                      static_cast<int>(parameters[i].size()),
+                      SQLITE_STATIC);
+  }
+
+  while ((sqlite3_step(stmt)) == SQLITE_ROW) {
+    auto s = genSqliteTableRow(stmt, results, path_);
+    if (!s.ok()) {
+      break;
+    }
+  }
+
+  // Resetting ends the read transaction, no lock is held between queries.
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+
+  if (!isPlatform(PlatformType::TYPE_POSIX)) {
+    // An open handle prevents other processes from removing the file.
+    close();
+  }
+  return Status::success();
+}
+
 Status getSqliteJournalMode(const fs::path& sqlite_db) {
   TableRows result;
   auto status = genTableRowsForSqliteTable(
@@ -7,17 +7,29 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <iterator>
+#include <map>
+#include <set>
+#include <stdexcept>
 #include <unordered_set>
 
 #include <osquery/core/core.h>
 #include <osquery/core/flagalias.h>
 #include <osquery/core/flags.h>
 #include <osquery/core/system.h>
+#include <osquery/extensions/interface.h>
 #include <osquery/logger/logger.h>
 #include <osquery/process/process.h>
+#include <osquery/profiler/allocations.h>
+#include <osquery/profiler/code_profiler.h>
+#include <osquery/profiler/query_trace.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/sql/dynamic_table_row.h>
+#include <osquery/sql/step_generations.h>
+#include <osquery/sql/table_row_batch.h>
 #include <osquery/sql/virtual_table.h>
 #include <osquery/utils/conversions/tryto.h>
 
@@ -25,6 +37,24 @@ namespace osquery {
 
 FLAG(bool, enable_foreign, false, "Enable no-op foreign virtual tables");
 
+FLAG(uint64,
+     table_generator_window,
+     0,
+     "Rows buffered from generator tables running on a producer thread (0 "
+     "generates on the query thread)");
+
+FLAG(bool,
+     table_static_results,
+     false,
+     "Keep table rows until a scan completes so SQLite can read column text "
+     "without copying it");
+
+FLAG(uint64,
+     table_prefetch_threads,
+     0,
+     "Threads generating a query's independent tables before it runs (0 "
+     "disables prefetching)");
+
 FLAG(uint64,
      table_delay,
      0,
@@ -44,6 +74,18 @@ FLAG(bool,
      "Ignore exceptions thrown by tables. osquery and extensions default to "
      "true.");
 
+FLAG(bool,
+     schedule_share_tables,
+     false,
+     "Generate a table once for the scheduled queries of a step that scan it "
+     "with compatible constraints");
+
+FLAG(uint64,
+     boot_stable_table_ttl,
+     3600,
+     "Seconds the results of tables that only change with the hardware are "
+     "reused (0 = disabled)");
+
 SHELL_FLAG(bool, planner, false, "Enable osquery runtime planner output");
 
 DECLARE_bool(disable_events);
@@ -63,9 +105,15 @@ static std::atomic<size_t> kPlannerCursorID{0};
  */
 static std::atomic<size_t> kConstraintIndexID{0};
 
+/// Planner state copies requested for statements prepared on this thread.
+thread_local VirtualTablePlans* kRecordedPlans{nullptr};
+
 /// We consider the max-cost as an error-state, e.g., unusable constraints.
 const double kMaxIndexCost{1000000};
 
+/// Memoized xBestIndex decisions kept per table before they are reset.
+const size_t kMaxBestIndexPlans{256};
+
 static inline std::string opString(unsigned char op) {
   switch (op) {
   case EQUALS:
@@ -119,6 +167,19 @@ TableList extension_table_list;
 std::unordered_map<std::string, struct sqlite3_module> sqlite_module_map;
 Mutex sqlite_module_map_mutex;
 
+// The aliases of each table, read once from its columns, and the reverse map
+// used when a statement first uses an alias.
+std::unordered_map<std::string, std::vector<std::string>> table_aliases;
+std::unordered_map<std::string, std::string> alias_tables;
+Mutex table_aliases_mutex;
+
+/// The table a module connects to, modules of aliases use their table.
+std::string getAliasTarget(const std::string& name) {
+  ReadLock lock(table_aliases_mutex);
+  auto it = alias_tables.find(name);
+  return (it == alias_tables.end()) ? name : it->second;
+}
+
 bool getColumnValue(std::string& value,
                     size_t index,
                     size_t argc,
@@ -301,6 +362,142 @@ static void plan(const std::string& output) {
   }
 }
 
+/// Generator rows are sampled at this rate when estimating produced bytes.
+const size_t kStatsSampleRows{32};
+
+/// The rows of one in this many filters are sampled to estimate their bytes.
+const size_t kStatsSampleFilters{16};
+
+/// Microseconds elapsed since a steady clock time point.
+static inline uint64_t elapsedUs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+/// Account for a row returned by a table generator.
+static inline void countGeneratedRow(TableStats& stats,
+                                     const TableRowHolder& row) {
+  if (row != nullptr && stats.rows_produced % kStatsSampleRows == 0) {
+    stats.bytes += estimateTableRowBytes(*row) * kStatsSampleRows;
+  }
+  stats.rows_produced++;
+}
+
+/**
+ * @brief Keep the rows a cursor has handed to SQLite alive until it closes.
+ *
+ * Static results reference the row's own storage, which SQLite may still read
+ * after the cursor has moved on, for example to compute an aggregate.
+ */
+static void retainRows(BaseCursor* pCur) {
+  const auto* pVtab = (VirtualTable*)pCur->base.pVtab;
+  if (!pVtab->static_results) {
+    return;
+  }
+
+  if (pCur->current != nullptr) {
+    pCur->retained.push_back(std::move(pCur->current));
+  }
+  for (auto& row : pCur->rows) {
+    if (row != nullptr) {
+      pCur->retained.push_back(std::move(row));
+    }
+  }
+  pCur->rows.clear();
+}
+
+/// Stop a generator producer thread and drop any buffered rows.
+static void stopProducer(BaseCursor* pCur) {
+  if (pCur->queue == nullptr) {
+    return;
+  }
+
+  pCur->queue->cancel();
+  if (pCur->producer.joinable()) {
+    pCur->producer.join();
+  }
+  pCur->queue = nullptr;
+  pCur->current = nullptr;
+
+  // The producer no longer writes its statistics.
+  if (pCur->producer_stats != nullptr) {
+    pCur->stats += *pCur->producer_stats;
+    pCur->producer_stats = nullptr;
+  }
+}
+
+/// Move the next row from the producer window into the cursor.
+static int popQueuedRow(BaseCursor* pCur) {
+  retainRows(pCur);
+  if (pCur->queue->pop(pCur->current)) {
+    return SQLITE_OK;
+  }
+
+  pCur->current = nullptr;
+  auto error = pCur->queue->error();
+  if (error == nullptr) {
+    return SQLITE_OK;
+  }
+
+  const auto* pVtab = (VirtualTable*)pCur->base.pVtab;
+  try {
+    std::rethrow_exception(error);
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "Exception while executing table " << pVtab->content->name
+               << ": " << e.what();
+    setTableErrorMessage(pCur->base.pVtab, e.what());
+    if (!FLAGS_ignore_table_exceptions) {
+      throw;
+    }
+  }
+  return SQLITE_ERROR;
+}
+
+/**
+ * @brief Check if a generation may be shared with the step's other queries.
+ *
+ * Event-based tables are excluded because their rows depend on when each
+ * query last read them.
+ */
+static bool sharesStepGenerations(const VirtualTable* pVtab) {
+  return FLAGS_schedule_share_tables && pVtab->instance->useCache() &&
+         TablePlugin::kCacheStep != 0 &&
+         (pVtab->content->attributes & TableAttributes::EVENT_BASED) == 0;
+}
+
+/// Check if the rows of a table are reused until the hardware changes.
+static bool keepsBootGenerations(const VirtualTable* pVtab) {
+  return FLAGS_boot_stable_table_ttl > 0 &&
+         (pVtab->content->attributes & TableAttributes::BOOT_STABLE) != 0 &&
+         (pVtab->content->attributes & TableAttributes::EVENT_BASED) == 0;
+}
+
+/**
+ * @brief Check if rows generated without constraints serve a scan.
+ *
+ * This holds unless a constrained column changes which rows are generated
+ * rather than narrowing them, such as REQUIRED, ADDITIONAL, or HIDDEN input
+ * columns. SQLite re-checks every constraint on the rows it reads.
+ */
+static bool servedUnconstrained(const VirtualTableContent& content,
+                                const QueryContext& context) {
+  for (const auto& column : content.columns) {
+    auto constraints = context.constraints.find(std::get<0>(column));
+    if (constraints == context.constraints.end() ||
+        constraints->second.getAll().empty()) {
+      continue;
+    }
+
+    auto options = std::get<2>(column);
+    if (options & (ColumnOptions::REQUIRED | ColumnOptions::ADDITIONAL |
+                   ColumnOptions::HIDDEN)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 int xOpen(sqlite3_vtab* tab, sqlite3_vtab_cursor** ppCursor) {
   auto* pCur = new BaseCursor;
   auto* pVtab = (VirtualTable*)tab;
@@ -310,6 +507,7 @@ int xOpen(sqlite3_vtab* tab, sqlite3_vtab_cursor** ppCursor) {
   }
   pCur->id = kPlannerCursorID++;
   pCur->base.pVtab = tab;
+  pCur->stats.scans = 1;
   *ppCursor = (sqlite3_vtab_cursor*)pCur;
 
   return SQLITE_OK;
@@ -318,6 +516,16 @@ int xOpen(sqlite3_vtab* tab, sqlite3_vtab_cursor** ppCursor) {
 int xClose(sqlite3_vtab_cursor* cur) {
   BaseCursor* pCur = (BaseCursor*)cur;
   plan("Closing cursor (" + std::to_string(pCur->id) + ")");
+  stopProducer(pCur);
+  if (pCur->stats.filters > 0) {
+    if (pCur->sampled_rows > 0) {
+      pCur->stats.bytes += static_cast<uint64_t>(
+          static_cast<double>(pCur->sampled_bytes) * pCur->filtered_rows /
+          pCur->sampled_rows);
+    }
+    const auto* pVtab = (VirtualTable*)cur->pVtab;
+    recordTableStats(pVtab->content->name, pCur->stats);
+  }
   delete pCur;
   return SQLITE_OK;
 }
@@ -325,6 +533,9 @@ int xClose(sqlite3_vtab_cursor* cur) {
 int xEof(sqlite3_vtab_cursor* cur) {
   BaseCursor* pCur = (BaseCursor*)cur;
   if (pCur->uses_generator) {
+    if (pCur->queue != nullptr) {
+      return pCur->current == nullptr;
+    }
     if (*pCur->generator) {
       return false;
     }
@@ -348,11 +559,24 @@ int xDestroy(sqlite3_vtab* p) {
 
 int xNext(sqlite3_vtab_cursor* cur) {
   BaseCursor* pCur = (BaseCursor*)cur;
+  pCur->stats.rows_consumed++;
   if (pCur->uses_generator) {
+    if (pCur->queue != nullptr) {
+      pCur->row++;
+      return popQueuedRow(pCur);
+    }
+    retainRows(pCur);
+    auto start = std::chrono::steady_clock::now();
     pCur->generator->operator()();
+    pCur->stats.generate_time_us += elapsedUs(start);
     if (*pCur->generator) {
       pCur->current = pCur->generator->get();
+      countGeneratedRow(pCur->stats, pCur->current);
     }
+  } else if (pCur->row < pCur->rows.size() &&
+             !((VirtualTable*)cur->pVtab)->static_results) {
+    // SQLite cursors only move forward, release rows once they are visited.
+    pCur->rows[pCur->row].reset();
   }
   pCur->row++;
   return SQLITE_OK;
@@ -564,10 +788,11 @@ int xCreate(sqlite3* db,
   pVtab->base = {};
   pVtab->content = std::make_shared<VirtualTableContent>();
   pVtab->instance = (SQLiteDBInstance*)pAux;
+  pVtab->static_results = FLAGS_table_static_results;
 
   // Create a TablePlugin Registry call, expect column details as the response.
   PluginResponse response;
-  pVtab->content->name = std::string(argv[0]);
+  pVtab->content->name = getAliasTarget(argv[0]);
   const auto& name = pVtab->content->name;
 
   // Get the table column information.
@@ -597,8 +822,7 @@ int xCreate(sqlite3* db,
     return (rc != SQLITE_OK) ? rc : SQLITE_ERROR;
   }
 
-  // Tables may request aliases as views.
-  std::set<std::string> views;
+  std::vector<std::pair<std::string, std::string>> column_groups;
 
   // Keep a local copy of the column details in the VirtualTableContent struct.
   // This allows introspection into the column type without additional calls.
@@ -635,12 +859,6 @@ int xCreate(sqlite3* db,
 
       pVtab->content->columns.push_back(std::make_tuple(
           cname->second, columnTypeName(ctype->second), options));
-    } else if (cid->second == "alias") {
-      // Create associated views for table aliases.
-      auto calias = column.find("alias");
-      if (calias != column.end()) {
-        views.insert(calias->second);
-      }
     } else if (cid->second == "columnAlias" && cname != column.end()) {
       auto ctarget = column.find("target");
       if (ctarget == column.end()) {
@@ -662,6 +880,27 @@ int xCreate(sqlite3* db,
         }
       }
       pVtab->content->aliases[cname->second] = target_index;
+    } else if (cid->second == "columnGroup" && cname != column.end()) {
+      auto cgroup = column.find("group");
+      if (cgroup != column.end()) {
+        column_groups.push_back(std::make_pair(cname->second, cgroup->second));
+      }
+    } else if (cid->second == "estimates") {
+      auto crows = column.find("rows");
+      if (crows != column.end()) {
+        auto rows = tryTo<unsigned long long>(crows->second);
+        if (rows) {
+          pVtab->content->estimates.rows = rows.take();
+        }
+      }
+      auto ccost = column.find("cost");
+      if (ccost != column.end()) {
+        char* end = nullptr;
+        double cost = strtod(ccost->second.c_str(), &end);
+        if (end != nullptr && end != ccost->second.c_str() && *end == '\0') {
+          pVtab->content->estimates.cost = cost;
+        }
+      }
     } else if (cid->second == "attributes") {
       auto cattr = column.find("attributes");
       // Store the attributes locally so they may be passed to the SQL object.
@@ -675,10 +914,17 @@ int xCreate(sqlite3* db,
     }
   }
 
-  // Create the requested 'aliases'.
-  for (const auto& view : views) {
-    statement = "CREATE VIEW " + view + " AS SELECT * FROM " + name;
-    sqlite3_exec(db, statement.c_str(), nullptr, nullptr, nullptr);
+  // Groups are resolved once all columns, and so their indexes, are known.
+  const auto& columns = pVtab->content->columns;
+  for (const auto& member : column_groups) {
+    auto& mask = pVtab->content->columnGroups[member.second];
+    for (size_t i = 0; i < columns.size(); i++) {
+      if (std::get<0>(columns[i]) == member.first) {
+        // Columns past the 63rd share the last bit of SQLite's colUsed.
+        mask.set(i < 63 ? i : 63U);
+        break;
+      }
+    }
   }
 
   *ppVtab = (sqlite3_vtab*)pVtab;
@@ -712,18 +958,30 @@ static inline bool sensibleComparison(ColumnType type, unsigned char op) {
   return true;
 }
 
-static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
-  auto* pVtab = (VirtualTable*)tab;
-  const auto& columns = pVtab->content->columns;
+/// Build the memoization key for the constraint terms and used columns.
+static std::string bestIndexKey(const sqlite3_index_info* pIdxInfo) {
+  std::string key;
+  key.reserve(sizeof(pIdxInfo->colUsed) + pIdxInfo->nConstraint * 6);
+  key.append(reinterpret_cast<const char*>(&pIdxInfo->colUsed),
+             sizeof(pIdxInfo->colUsed));
+  for (int i = 0; i < pIdxInfo->nConstraint; ++i) {
+    const auto& constraint_info = pIdxInfo->aConstraint[i];
+    key.append(reinterpret_cast<const char*>(&constraint_info.iColumn),
+               sizeof(constraint_info.iColumn));
+    key.push_back(static_cast<char>(constraint_info.op));
+    key.push_back(static_cast<char>(constraint_info.usable));
+  }
+  return key;
+}
 
-  pVtab->instance->addAffectedTable(pVtab->content);
+/// Compute the constraints, used columns and cost for an index request.
+static BestIndexPlan planBestIndex(const VirtualTable* pVtab,
+                                   const sqlite3_index_info* pIdxInfo) {
+  const auto& columns = pVtab->content->columns;
 
-  ConstraintSet constraints;
-  // Keep track of the index used for each valid constraint.
-  // Expect this index to correspond with argv within xFilter.
-  size_t expr_index = 0;
+  BestIndexPlan best;
   // If any constraints are unusable increment the cost of the index.
-  double cost = kMaxIndexCost;
+  best.cost = kMaxIndexCost;
 
   // Tables may have requirements or use indexes.
   bool hasRequiredColumns = false;
@@ -757,7 +1015,7 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
       const auto& name = std::get<0>(columns[constraint_info.iColumn]);
       const auto& type = std::get<1>(columns[constraint_info.iColumn]);
       if (!sensibleComparison(type, constraint_info.op)) {
-        cost += 10;
+        best.cost += 10;
         continue;
       }
 
@@ -765,9 +1023,9 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
       const auto& options = std::get<2>(columns[constraint_info.iColumn]);
       if (options & ColumnOptions::REQUIRED) {
         hasRequiredConstraints = true;
-        cost = 1;
+        best.cost = 1;
       } else if (options & (ColumnOptions::INDEX | ColumnOptions::ADDITIONAL)) {
-        cost = 1;
+        best.cost = 1;
       } else {
         // not indexed, let sqlite filter it
         continue;
@@ -776,7 +1034,7 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
       // Save a pair of the name and the constraint operator.
       // Use this constraint during xFilter by performing a scan and column
       // name lookup through out all cursor constraint lists.
-      constraints.push_back(
+      best.constraints.push_back(
           std::make_pair(name, Constraint(constraint_info.op)));
 
       // important: if we specify an index, it means xFilter will be called
@@ -786,21 +1044,20 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
       // when a spec file specifies a column to be required or index, the
       // table implementation must be able to quickly find and return a
       // single row. See issue 5379.
-
-      pIdxInfo->aConstraintUsage[i].argvIndex = static_cast<int>(++expr_index);
+      best.terms.push_back(static_cast<int>(i));
 
       if (FLAGS_planner) {
         plan("xBestIndex Adding index constraint for table: " +
              pVtab->content->name + " [column=" + name +
-             " arg_index=" + std::to_string(expr_index) +
+             " arg_index=" + std::to_string(best.constraints.size()) +
              " op=" + std::to_string(constraint_info.op) + "]");
       }
     }
   }
 
   // track columns used
-  UsedColumns colsUsed;
-  UsedColumnsBitset colsUsedBitset(pIdxInfo->colUsed);
+  best.colsUsedBitset = UsedColumnsBitset(pIdxInfo->colUsed);
+  auto& colsUsedBitset = best.colsUsedBitset;
   if (colsUsedBitset.any()) {
     for (size_t i = 0; i < columns.size(); i++) {
       // Check whether the column is used. colUsed has one bit for each of the
@@ -813,14 +1070,15 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
       }
 
       auto column_name = std::get<0>(columns[i]);
-      if (pVtab->content->aliases.count(column_name)) {
+      auto alias = pVtab->content->aliases.find(column_name);
+      if (alias != pVtab->content->aliases.end()) {
         colsUsedBitset.reset(bit);
-        auto real_column_index = pVtab->content->aliases[column_name];
+        auto real_column_index = alias->second;
         bit = real_column_index < 63 ? real_column_index : 63U;
         colsUsedBitset.set(bit);
         column_name = std::get<0>(columns[real_column_index]);
       }
-      colsUsed.insert(column_name);
+      best.colsUsed.insert(column_name);
 
       const auto& options = std::get<2>(columns[i]);
       if (options & ColumnOptions::REQUIRED) {
@@ -832,21 +1090,89 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
   // Return max-cost if a required constraint is not present.
   // For example, you can't do a hash of a file if path not provided.
   if (hasRequiredColumns && !hasRequiredConstraints) {
-    cost = kMaxIndexCost;
+    best.cost = kMaxIndexCost;
+  }
+
+  // Tables may provide hints about a full scan. The default costs are kept
+  // when no hints are provided so existing planner choices do not change.
+  const auto& estimates = pVtab->content->estimates;
+  if (best.constraints.empty()) {
+    if (estimates.cost > 0 && !hasRequiredColumns) {
+      best.cost = std::min(estimates.cost, kMaxIndexCost);
+    }
+    if (estimates.rows > 0) {
+      best.rows = static_cast<long long>(estimates.rows);
+    }
+  } else if (estimates.rows > 0) {
+    // Indexed lookups are expected to return one row per expression.
+    best.rows = 1;
+  }
+
+  return best;
+}
+
+static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
+  auto* pVtab = (VirtualTable*)tab;
+  auto& plans = pVtab->content->bestIndexPlans;
+
+  pVtab->instance->addAffectedTable(pVtab->content);
+
+  // The same statement shapes are planned repeatedly, reuse the decision.
+  auto key = bestIndexKey(pIdxInfo);
+  auto cached = plans.find(key);
+  if (cached == plans.end()) {
+    if (plans.size() >= kMaxBestIndexPlans) {
+      plans.clear();
+    }
+    cached = plans.emplace(key, planBestIndex(pVtab, pIdxInfo)).first;
+  } else if (FLAGS_planner) {
+    plan("xBestIndex Reusing plan for table: " + pVtab->content->name);
+  }
+  const auto& best = cached->second;
+
+  // Keep track of the index used for each valid constraint.
+  // Expect this index to correspond with argv within xFilter.
+  std::unordered_set<size_t> in_constraints;
+  for (size_t i = 0; i < best.terms.size(); ++i) {
+    auto term = best.terms[i];
+    pIdxInfo->aConstraintUsage[term].argvIndex = static_cast<int>(i + 1);
+
+    // Ask SQLite to pass an IN operator's values in a single xFilter call.
+    // The values are expanded into EQUALS constraints, which tables treat
+    // as alternatives, instead of calling xFilter once per value.
+    if (best.constraints[i].second.op == EQUALS &&
+        sqlite3_vtab_in(pIdxInfo, term, 1)) {
+      in_constraints.insert(i);
+    }
+  }
+
+  if (best.rows > 0) {
+    pIdxInfo->estimatedRows = static_cast<sqlite3_int64>(best.rows);
   }
 
   pIdxInfo->idxNum = static_cast<int>(kConstraintIndexID++);
   if (FLAGS_planner) {
     plan("xBestIndex Recording constraint set for table: " +
-         pVtab->content->name + " [cost=" + std::to_string(cost) +
-         " size=" + std::to_string(constraints.size()) +
+         pVtab->content->name + " [cost=" + std::to_string(best.cost) +
+         " size=" + std::to_string(best.constraints.size()) +
          " idx=" + std::to_string(pIdxInfo->idxNum) + "]");
   }
+  if (kRecordedPlans != nullptr) {
+    kRecordedPlans->push_back({pVtab->content,
+                               static_cast<size_t>(pIdxInfo->idxNum),
+                               best.constraints,
+                               in_constraints,
+                               best.colsUsed,
+                               best.colsUsedBitset});
+  }
+
   // Add the constraint set to the table's tracked constraints.
-  pVtab->content->constraints[pIdxInfo->idxNum] = std::move(constraints);
-  pVtab->content->colsUsed[pIdxInfo->idxNum] = std::move(colsUsed);
-  pVtab->content->colsUsedBitsets[pIdxInfo->idxNum] = colsUsedBitset;
-  pIdxInfo->estimatedCost = cost;
+  auto index = static_cast<size_t>(pIdxInfo->idxNum);
+  pVtab->content->constraints[index] = best.constraints;
+  pVtab->content->inConstraints[index] = std::move(in_constraints);
+  pVtab->content->colsUsed[index] = best.colsUsed;
+  pVtab->content->colsUsedBitsets[index] = best.colsUsedBitset;
+  pIdxInfo->estimatedCost = best.cost;
 
   return SQLITE_OK;
 }
@@ -859,12 +1185,17 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
   BaseCursor* pCur = (BaseCursor*)pVtabCursor;
   auto* pVtab = (VirtualTable*)pVtabCursor->pVtab;
   auto content = pVtab->content;
+  ScopedProfile profile("table", content->name);
+  ScopedTraceSpan span("generate", content->name);
   if (FLAGS_table_delay > 0 && pVtab->instance->tableCalled(*content)) {
     // Apply an optional sleep between table calls.
     sleepFor(FLAGS_table_delay);
   }
   pVtab->instance->addAffectedTable(content);
 
+  // A cursor may be filtered again, for example within a JOIN.
+  retainRows(pCur);
+  stopProducer(pCur);
   pCur->row = 0;
   pCur->n = 0;
   QueryContext context(content);
@@ -915,8 +1246,29 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
   // Iterate over every argument to xFilter, filling in constraint values.
   if (content->constraints.size() > 0) {
     auto& constraints = content->constraints[idxNum];
+    const auto& in_constraints = content->inConstraints[idxNum];
     if (argc > 0) {
       for (size_t i = 0; i < static_cast<size_t>(argc); ++i) {
+        if (in_constraints.count(i) > 0) {
+          // The argument is the complete list of an IN operator.
+          const auto& column = constraints[i].first;
+          sqlite3_value* value = nullptr;
+          for (int rc = sqlite3_vtab_in_first(argv[i], &value);
+               rc == SQLITE_OK && value != nullptr;
+               rc = sqlite3_vtab_in_next(argv[i], &value)) {
+            auto expr = (const char*)sqlite3_value_text(value);
+            if (expr == nullptr || expr[0] == 0) {
+              continue;
+            }
+            if (FLAGS_planner) {
+              plan("xFilter Adding IN constraint to cursor (" +
+                   std::to_string(pCur->id) + "): " + column + " = " + expr);
+            }
+            context.constraints[column].add(Constraint(EQUALS, expr));
+          }
+          continue;
+        }
+
         auto expr = (const char*)sqlite3_value_text(argv[i]);
         if (expr == nullptr || expr[0] == 0) {
           // SQLite did not expose the expression value.
@@ -993,25 +1345,129 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
     }
   }
 
+  if (context.isCancelled()) {
+    // The query was cancelled, do not start generating another table.
+    setTableErrorMessage(pVtabCursor->pVtab, "Query cancelled");
+    return SQLITE_INTERRUPT;
+  }
+
   // Generate the row data set.
   plan("Scanning rows for cursor (" + std::to_string(pCur->id) + ")");
-  if (Registry::get().exists("table", pVtab->content->name, true)) {
+  pCur->stats.filters++;
+  auto start = std::chrono::steady_clock::now();
+  ScopedAllocationAccount allocations;
+  if (content->prefetched != nullptr && argc == 0) {
+    // The rows were generated before the query ran.
+    pCur->rows = std::move(*content->prefetched);
+    content->prefetched.reset();
+    pCur->stats.generate_time_us += content->prefetchTimeUs;
+  } else if (Registry::get().exists("table", pVtab->content->name, true)) {
     auto plugin = Registry::get().plugin("table", pVtab->content->name);
     auto table = std::dynamic_pointer_cast<TablePlugin>(plugin);
+    bool queued = false;
     try {
-      if (table->usesGenerator()) {
+      if (table->usesGenerator() && FLAGS_table_generator_window > 0) {
+        pCur->uses_generator = true;
+        pCur->generator = nullptr;
+        pCur->queue =
+            std::make_shared<BoundedRowQueue>(FLAGS_table_generator_window);
+        pCur->producer_stats = std::make_shared<TableStats>();
+        pCur->producer = std::thread([table,
+                                      queue = pCur->queue,
+                                      producer_stats = pCur->producer_stats,
+                                      interval = TablePlugin::kCacheInterval,
+                                      step = TablePlugin::kCacheStep,
+                                      context = std::move(context)]() mutable {
+          TablePlugin::kCacheInterval = interval;
+          TablePlugin::kCacheStep = step;
+          // The producer owns its generation statistics until the cursor
+          // joins it, time blocked on a full window is not counted.
+          auto& stats = *producer_stats;
+          ScopedAllocationAccount allocations;
+          auto account = [&stats, &allocations]() {
+            stats.allocated_bytes = allocations.allocated();
+            stats.peak_bytes = allocations.peak();
+          };
+          try {
+            auto start = std::chrono::steady_clock::now();
+            RowGenerator::pull_type generator(
+                std::bind(&TablePlugin::generator,
+                          table,
+                          std::placeholders::_1,
+                          std::ref(context)));
+            stats.generate_time_us += elapsedUs(start);
+            while (generator) {
+              countGeneratedRow(stats, generator.get());
+              if (!queue->push(generator.get())) {
+                // SQLite stopped reading, e.g., a LIMIT was satisfied.
+                break;
+              }
+              if (context.isCancelled()) {
+                break;
+              }
+              start = std::chrono::steady_clock::now();
+              generator();
+              stats.generate_time_us += elapsedUs(start);
+            }
+          } catch (...) {
+            account();
+            queue->fail(std::current_exception());
+            return;
+          }
+          account();
+          queue->finish();
+        });
+        queued = true;
+      } else if (table->usesGenerator()) {
         pCur->uses_generator = true;
         pCur->generator = std::make_unique<RowGenerator::pull_type>(
             std::bind(&TablePlugin::generator,
                       table,
                       std::placeholders::_1,
                       std::move(context)));
+        pCur->stats.generate_time_us += elapsedUs(start);
         if (*pCur->generator) {
           pCur->current = pCur->generator->get();
+          countGeneratedRow(pCur->stats, pCur->current);
         }
         return SQLITE_OK;
+      } else if (keepsBootGenerations(pVtab)) {
+        auto max_age = FLAGS_boot_stable_table_ttl;
+        auto constraints = stepGenerationConstraints(context.constraints);
+        auto columns = *context.colsUsedBitset;
+        if (!findBootGeneration(max_age,
+                                content->name,
+                                constraints,
+                                servedUnconstrained(*content, context),
+                                columns,
+                                pCur->rows)) {
+          pCur->rows = table->generate(context);
+          addBootGeneration(max_age,
+                            content->name,
+                            std::move(constraints),
+                            columns,
+                            pCur->rows);
+        }
+      } else if (sharesStepGenerations(pVtab)) {
+        auto step = TablePlugin::kCacheStep;
+        auto constraints = stepGenerationConstraints(context.constraints);
+        auto columns = *context.colsUsedBitset;
+        if (!findStepGeneration(step,
+                                content->name,
+                                constraints,
+                                servedUnconstrained(*content, context),
+                                columns,
+                                pCur->rows)) {
+          pCur->rows = table->generate(context);
+          addStepGeneration(step,
+                            content->name,
+                            std::move(constraints),
+                            columns,
+                            pCur->rows);
+        }
+      } else {
+        pCur->rows = table->generate(context);
       }
-      pCur->rows = table->generate(context);
     } catch (const std::exception& e) {
       LOG(ERROR) << "Exception while executing table " << pVtab->content->name
                  << ": " << e.what();
@@ -1021,22 +1477,114 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
       }
       return SQLITE_ERROR;
     }
+
+    if (queued) {
+      // Wait for the first row, the producer continues filling the window.
+      return popQueuedRow(pCur);
+    }
   } else {
     PluginRequest request = {{"action", "generate"}};
     TablePlugin::setRequestFromContext(context, request);
+
+    // Extensions return the rows in batches from a cursor, by column.
+    auto reader = std::make_shared<ExtensionTableReader>(
+        pVtab->content->name, pVtab->content->columns);
+    auto status = reader->open(request, pCur->rows);
+    auto unsupported = [](const Status& s) {
+      return s.getCode() == static_cast<int>(ExtensionCode::EXT_UNSUPPORTED);
+    };
+
+    // Older extensions return the rows in one response, by column or by row.
+    auto from_cursor = !unsupported(status);
+    auto columnar = false;
+    auto batch = std::make_shared<TableRowBatch>(pVtab->content->columns);
     QueryData qd;
-    auto status = Registry::call("table", pVtab->content->name, request, qd);
+    if (!from_cursor) {
+      status = callExtensionTable(pVtab->content->name, request, *batch);
+      columnar = !unsupported(status);
+      if (!columnar) {
+        status = Registry::call("table", pVtab->content->name, request, qd);
+      }
+    }
+
     if (!status.ok()) {
       VLOG(1) << "Invalid response from the extension table. Error "
               << status.getCode() << ": " << status.getMessage();
       setTableErrorMessage(pVtabCursor->pVtab, status.getMessage());
       return SQLITE_ERROR;
     }
-    pCur->rows = tableRowsFromQueryData(std::move(qd));
+
+    if (!from_cursor) {
+      pCur->rows = columnar ? tableRowsFromBatch(std::move(batch))
+                            : tableRowsFromQueryData(std::move(qd));
+    } else if (reader->more() && FLAGS_table_generator_window > 0) {
+      // The next batches are read by a producer, the cursor is closed when
+      // SQLite stops reading.
+      pCur->uses_generator = true;
+      pCur->generator = nullptr;
+      pCur->queue =
+          std::make_shared<BoundedRowQueue>(FLAGS_table_generator_window);
+      pCur->producer_stats = std::make_shared<TableStats>();
+      pCur->producer = std::thread([reader,
+                                    queue = pCur->queue,
+                                    producer_stats = pCur->producer_stats,
+                                    rows = std::move(pCur->rows)]() mutable {
+        auto& stats = *producer_stats;
+        while (true) {
+          for (auto& row : rows) {
+            countGeneratedRow(stats, row);
+            if (!queue->push(std::move(row))) {
+              queue->finish();
+              return;
+            }
+          }
+
+          if (!reader->more()) {
+            break;
+          }
+          auto start = std::chrono::steady_clock::now();
+          auto status = reader->next(rows);
+          stats.generate_time_us += elapsedUs(start);
+          if (!status.ok()) {
+            queue->fail(std::make_exception_ptr(
+                std::runtime_error(status.getMessage())));
+            return;
+          }
+        }
+        queue->finish();
+      });
+      pCur->rows.clear();
+      return popQueuedRow(pCur);
+    } else {
+      // Without a producer window every batch is read now.
+      while (reader->more()) {
+        TableRows rows;
+        status = reader->next(rows);
+        if (!status.ok()) {
+          VLOG(1) << "Invalid response from the extension table. Error "
+                  << status.getCode() << ": " << status.getMessage();
+          setTableErrorMessage(pVtabCursor->pVtab, status.getMessage());
+          return SQLITE_ERROR;
+        }
+        std::move(rows.begin(), rows.end(), std::back_inserter(pCur->rows));
+      }
+    }
   }
 
   // Set the number of rows.
   pCur->n = pCur->rows.size();
+  span.setRows(pCur->n);
+  pCur->stats.generate_time_us += elapsedUs(start);
+  pCur->stats.rows_produced += pCur->n;
+  // Joins filter a cursor once per outer row, the bytes of a sample of the
+  // filters are extrapolated to all of them when the cursor closes.
+  pCur->filtered_rows += pCur->n;
+  if ((pCur->stats.filters - 1) % kStatsSampleFilters == 0) {
+    pCur->sampled_rows += pCur->n;
+    pCur->sampled_bytes += estimateTableRowsBytes(pCur->rows);
+  }
+  pCur->stats.allocated_bytes += allocations.allocated();
+  pCur->stats.peak_bytes = std::max(pCur->stats.peak_bytes, allocations.peak());
 
   if (FLAGS_planner) {
     plan("xFilter " + pVtab->content->name +
@@ -1080,6 +1628,82 @@ struct sqlite3_module* getVirtualTableModule(const std::string& table_name,
 
   return &sqlite_module_map[table_name];
 }
+
+std::vector<std::string> getCachedTableAliases(const std::string& name) {
+  ReadLock lock(table_aliases_mutex);
+  auto it = table_aliases.find(name);
+  return (it == table_aliases.end()) ? std::vector<std::string>() : it->second;
+}
+
+/**
+ * @brief The aliases of a table, read from its columns the first time.
+ *
+ * A table attached again may be a new definition, refresh reads its aliases
+ * again.
+ */
+std::vector<std::string> getTableAliases(const std::string& name,
+                                         bool refresh) {
+  if (!refresh) {
+    ReadLock lock(table_aliases_mutex);
+    auto it = table_aliases.find(name);
+    if (it != table_aliases.end()) {
+      return it->second;
+    }
+  }
+
+  std::vector<std::string> aliases;
+  PluginResponse response;
+  auto status =
+      Registry::call("table", name, {{"action", "columns"}}, response);
+  if (!status.ok()) {
+    // The table may be registered later, nothing is remembered.
+    return aliases;
+  }
+
+  for (const auto& column : response) {
+    auto cid = column.find("id");
+    auto calias = column.find("alias");
+    if (cid != column.end() && cid->second == "alias" &&
+        calias != column.end()) {
+      aliases.push_back(calias->second);
+    }
+  }
+
+  WriteLock lock(table_aliases_mutex);
+  auto& cached = table_aliases[name];
+  for (const auto& alias : cached) {
+    alias_tables.erase(alias);
+  }
+  for (const auto& alias : aliases) {
+    alias_tables[alias] = name;
+  }
+  cached = aliases;
+  return aliases;
+}
+
+/**
+ * @brief Register the modules of a table and its aliases with a database.
+ *
+ * The modules are eponymous virtual tables, SQLite connects the table the
+ * first time a statement uses it. Registering ~300 modules costs far less
+ * than creating every table, which parses a statement and declares the table
+ * for each.
+ */
+int createTableModules(const std::string& name,
+                       struct sqlite3_module* module,
+                       const SQLiteDBInstanceRef& instance,
+                       bool refresh) {
+  int rc = sqlite3_create_module(
+      instance->db(), name.c_str(), module, (void*)&(*instance));
+  for (const auto& alias : getTableAliases(name, refresh)) {
+    if (rc != SQLITE_OK && rc != SQLITE_MISUSE) {
+      break;
+    }
+    rc = sqlite3_create_module(
+        instance->db(), alias.c_str(), module, (void*)&(*instance));
+  }
+  return rc;
+}
 } // namespace sqlite
 } // namespace tables
 
@@ -1103,10 +1727,13 @@ Status attachTableInternal(const std::string& name,
   // Note, if the clientData API is used then this will save a registry call
   // within xCreate.
   auto lock(instance->attachLock());
+  // Prepared statements may reference a previous definition of the table.
+  instance->clearStatements();
 
-  int rc = sqlite3_create_module(
-      instance->db(), name.c_str(), module, (void*)&(*instance));
+  // A table attached explicitly may be a new definition with new aliases.
+  int rc = tables::sqlite::createTableModules(name, module, instance, true);
 
+  // The table is created now, rather than on first use, to report errors.
   if (rc == SQLITE_OK || rc == SQLITE_MISUSE) {
     auto format =
         "CREATE VIRTUAL TABLE temp." + name + " USING " + name + statement;
@@ -1124,15 +1751,146 @@ Status attachTableInternal(const std::string& name,
 Status detachTableInternal(const std::string& name,
                            const SQLiteDBInstanceRef& instance) {
   auto lock(instance->attachLock());
+  instance->clearStatements();
   auto format = "DROP TABLE IF EXISTS temp." + name;
   int rc = sqlite3_exec(instance->db(), format.c_str(), nullptr, nullptr, 0);
   if (rc != SQLITE_OK) {
     LOG(ERROR) << "Error detaching table: " << name << " (" << rc << ")";
   }
 
+  // Without its modules the table and its aliases are no longer eponymous.
+  sqlite3_create_module(instance->db(), name.c_str(), nullptr, nullptr);
+  for (const auto& alias : tables::sqlite::getCachedTableAliases(name)) {
+    sqlite3_create_module(instance->db(), alias.c_str(), nullptr, nullptr);
+  }
+
   return Status(rc, getStringForSQLiteReturnCode(rc));
 }
 
+void recordVirtualTablePlans(VirtualTablePlans* plans) {
+  tables::sqlite::kRecordedPlans = plans;
+}
+
+void restoreVirtualTablePlans(const VirtualTablePlans& plans) {
+  for (const auto& plan : plans) {
+    auto& content = *plan.content;
+    content.constraints[plan.index] = plan.constraints;
+    content.inConstraints[plan.index] = plan.inConstraints;
+    content.colsUsed[plan.index] = plan.colsUsed;
+    content.colsUsedBitsets[plan.index] = plan.colsUsedBitset;
+  }
+}
+
+void prefetchVirtualTables(const VirtualTablePlans& plans, bool use_cache) {
+  if (FLAGS_table_prefetch_threads == 0) {
+    return;
+  }
+
+  // A table with any constrained plan, or plans using different columns,
+  // is left to the statement.
+  std::map<VirtualTableContent*, const VirtualTablePlan*> independent;
+  std::set<VirtualTableContent*> dependent;
+  for (const auto& plan : plans) {
+    auto* content = plan.content.get();
+    if (dependent.count(content) > 0) {
+      continue;
+    }
+
+    auto it = independent.find(content);
+    if (!plan.constraints.empty() ||
+        (it != independent.end() &&
+         it->second->colsUsedBitset != plan.colsUsedBitset)) {
+      independent.erase(content);
+      dependent.insert(content);
+    } else {
+      independent.emplace(content, &plan);
+    }
+  }
+
+  struct PrefetchTask {
+    const VirtualTablePlan* plan;
+    std::shared_ptr<TablePlugin> table;
+  };
+
+  std::vector<PrefetchTask> tasks;
+  for (const auto& candidate : independent) {
+    const auto& content = *candidate.first;
+    if (content.prefetched != nullptr ||
+        !Registry::get().exists("table", content.name, true)) {
+      continue;
+    }
+
+    // Generators stream their rows, and tables with required columns
+    // cannot be scanned without constraints.
+    auto table = std::dynamic_pointer_cast<TablePlugin>(
+        Registry::get().plugin("table", content.name));
+    if (table == nullptr || table->usesGenerator()) {
+      continue;
+    }
+
+    bool required = false;
+    for (const auto& column : content.columns) {
+      required |= (std::get<2>(column) & ColumnOptions::REQUIRED) != 0;
+    }
+    if (!required) {
+      tasks.push_back({candidate.second, table});
+    }
+  }
+
+  if (tasks.size() < 2) {
+    // There is nothing to overlap.
+    return;
+  }
+
+  std::atomic<size_t> next{0};
+  auto interval = TablePlugin::kCacheInterval;
+  auto step = TablePlugin::kCacheStep;
+  auto cancellation = QueryCancellation::kCurrent;
+  auto worker = [&tasks, &next, use_cache, interval, step, cancellation]() {
+    TablePlugin::kCacheInterval = interval;
+    TablePlugin::kCacheStep = step;
+    QueryCancellation::kCurrent = cancellation;
+    for (auto i = next++; i < tasks.size(); i = next++) {
+      const auto& content = tasks[i].plan->content;
+      QueryContext context(content);
+      if (context.isCancelled()) {
+        // The scan stops before generating the table.
+        break;
+      }
+      context.useCache(use_cache);
+      for (const auto& column : content->columns) {
+        context.constraints[std::get<0>(column)].affinity =
+            std::get<1>(column);
+      }
+      context.colsUsed = tasks[i].plan->colsUsed;
+      context.colsUsedBitset = tasks[i].plan->colsUsedBitset;
+
+      auto start = std::chrono::steady_clock::now();
+      try {
+        auto rows = tasks[i].table->generate(context);
+        content->prefetchTimeUs = tables::sqlite::elapsedUs(start);
+        content->prefetched = std::make_unique<TableRows>(std::move(rows));
+      } catch (const std::exception& e) {
+        // The scan generates the table again and reports the error.
+        VLOG(1) << "Could not prefetch table " << content->name << ": "
+                << e.what();
+      } catch (...) {
+        VLOG(1) << "Could not prefetch table " << content->name;
+      }
+    }
+  };
+
+  auto count = std::min(tasks.size(),
+                        static_cast<size_t>(FLAGS_table_prefetch_threads));
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < count; ++i) {
+    workers.emplace_back(worker);
+  }
+  for (auto& thread : workers) {
+    thread.join();
+  }
+}
+
 Status attachFunctionInternal(
     const std::string& name,
     std::function<
@@ -1161,16 +1919,21 @@ void attachVirtualTables(const SQLiteDBInstanceRef& instance) {
 #endif
   }
 
-  PluginResponse response;
-  bool is_extension = false;
+  auto lock(instance->attachLock());
+  instance->clearStatements();
 
+  // Tables are created by SQLite when a statement first uses them.
   for (const auto& name : RegistryFactory::get().names("table")) {
-    // Column information is nice for virtual table create call.
-    auto status =
-        Registry::call("table", name, {{"action", "columns"}}, response);
-    if (status.ok()) {
-      auto statement = columnDefinition(response, true, is_extension);
-      attachTableInternal(name, statement, instance, is_extension);
+    if (SQLiteDBManager::isDisabled(name)) {
+      VLOG(1) << "Table " << name << " is disabled, not attaching";
+      continue;
+    }
+
+    auto module = tables::sqlite::getVirtualTableModule(name, false);
+    auto rc =
+        tables::sqlite::createTableModules(name, module, instance, false);
+    if (rc != SQLITE_OK && rc != SQLITE_MISUSE) {
+      LOG(ERROR) << "Error attaching table: " << name << " (" << rc << ")";
     }
   }
 }
@@ -10,11 +10,14 @@
 #pragma once
 
 #include <memory>
+#include <thread>
 
 #include <boost/noncopyable.hpp>
 
 #include <osquery/core/tables.h>
+#include <osquery/sql/bounded_row_queue.h>
 #include <osquery/sql/sqlite_util.h>
+#include <osquery/sql/table_stats.h>
 
 namespace osquery {
 
@@ -53,11 +56,33 @@ struct BaseCursor : private boost::noncopyable {
   /// Does the backing local table use a generator type.
   bool uses_generator{false};
 
+  /// Optional window of rows filled by a generator running on producer.
+  std::shared_ptr<BoundedRowQueue> queue{nullptr};
+
+  /// Thread running the table generator when a row window is used.
+  std::thread producer;
+
   /// Current cursor position.
   size_t row{0};
 
   /// Total number of rows.
   size_t n{0};
+
+  /// Access statistics recorded for the table when the cursor closes.
+  TableStats stats;
+
+  /// Statistics of the producer, added to stats once it has stopped.
+  std::shared_ptr<TableStats> producer_stats{nullptr};
+
+  /// Rows of the filters whose size was estimated, and their bytes.
+  size_t sampled_rows{0};
+  size_t sampled_bytes{0};
+
+  /// Rows of every filter that returned a complete set of rows.
+  size_t filtered_rows{0};
+
+  /// Rows already visited, kept until close when results are static.
+  TableRows retained;
 };
 
 /**
@@ -75,15 +100,34 @@ struct VirtualTable : private boost::noncopyable {
 
   /// Added structure: The thread-local DB instance associated with the query.
   SQLiteDBInstance* instance{nullptr};
+
+  /**
+   * @brief Added structure: Rows outlive the SQLite statement step.
+   *
+   * When set, cursors keep every row they have produced until they close and
+   * rows may hand their text to SQLite with SQLITE_STATIC.
+   */
+  bool static_results{false};
 };
 
-/// Attach a table plugin name to an in-memory SQLite database.
+/// The SQLite destructor rows should use for text owned by the row itself.
+inline sqlite3_destructor_type rowTextDestructor(const sqlite3_vtab* vtab) {
+  return ((const VirtualTable*)vtab)->static_results ? SQLITE_STATIC
+                                                     : SQLITE_TRANSIENT;
+}
+
+/**
+ * @brief Attach a table plugin name to an in-memory SQLite database.
+ *
+ * Unlike attachVirtualTables the table is created at once, so errors in its
+ * definition are reported to the caller.
+ */
 Status attachTableInternal(const std::string& name,
                            const std::string& statement,
                            const SQLiteDBInstanceRef& instance,
                            bool is_extension);
 
-/// Detach (drop) a table.
+/// Detach (drop) a table and remove its modules, with those of its aliases.
 Status detachTableInternal(const std::string& name,
                            const SQLiteDBInstanceRef& instance);
 
@@ -92,9 +136,35 @@ Status attachFunctionInternal(
     std::function<
         void(sqlite3_context* context, int argc, sqlite3_value** argv)> func);
 
-/// Attach all table plugins to an in-memory SQLite database.
+/**
+ * @brief Attach all table plugins to an in-memory SQLite database.
+ *
+ * Only the modules of the tables and their aliases are registered, each is an
+ * eponymous virtual table created the first time a statement uses it.
+ */
 void attachVirtualTables(const SQLiteDBInstanceRef& instance);
 
+/**
+ * @brief Copy the planner state of indexes created by xBestIndex.
+ *
+ * Recording applies to statements prepared on the calling thread until it is
+ * stopped by passing nullptr.
+ */
+void recordVirtualTablePlans(VirtualTablePlans* plans);
+
+/// Install recorded planner state before re-running a prepared statement.
+void restoreVirtualTablePlans(const VirtualTablePlans& plans);
+
+/**
+ * @brief Generate the independent tables of a statement concurrently.
+ *
+ * A table is independent if every plan SQLite considered scans it without
+ * constraints, so its rows cannot depend on other tables. When at least two
+ * such tables exist they are generated on --table_prefetch_threads threads
+ * before the statement runs, and their first scans use the results.
+ */
+void prefetchVirtualTables(const VirtualTablePlans& plans, bool use_cache);
+
 #if !defined(OSQUERY_EXTERNAL)
 /**
  * A generated foreign amalgamation file includes schema for all tables.
@@ -0,0 +1,105 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <grp.h>
+#include <pwd.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+#include <osquery/core/flags.h>
+#include <osquery/system/usersgroups/posix/users_groups_cache.h>
+
+namespace osquery {
+
+DECLARE_uint32(users_groups_cache_ttl);
+
+/// A uid unlikely to resolve.
+const uid_t kMissingUid{0x7ffffff0};
+
+class PosixUsersGroupsCacheTests : public testing::Test {
+ protected:
+  void TearDown() override {
+    FLAGS_users_groups_cache_ttl = 60;
+    UsersGroupsCache::get().clear();
+  }
+};
+
+TEST_F(PosixUsersGroupsCacheTests, test_user_lookups) {
+  auto& cache = UsersGroupsCache::get();
+  auto pwd = ::getpwuid(::getuid());
+  ASSERT_NE(pwd, nullptr);
+  std::string username = pwd->pw_name;
+
+  auto user = cache.getUserByUid(::getuid());
+  ASSERT_TRUE(user.has_value());
+  EXPECT_EQ(user->username, username);
+  EXPECT_EQ(user->gid, pwd->pw_gid);
+
+  auto by_name = cache.getUserByName(username);
+  ASSERT_TRUE(by_name.has_value());
+  EXPECT_EQ(by_name->uid, ::getuid());
+
+  // Missing users are remembered as such.
+  EXPECT_FALSE(cache.getUserByUid(kMissingUid).has_value());
+  EXPECT_FALSE(cache.getUserByUid(kMissingUid).has_value());
+  EXPECT_FALSE(cache.getUserByName("osquery-missing-user").has_value());
+}
+
+TEST_F(PosixUsersGroupsCacheTests, test_enumerations) {
+  auto& cache = UsersGroupsCache::get();
+  auto users = cache.getUsers();
+  ASSERT_FALSE(users.empty());
+  EXPECT_TRUE(std::any_of(users.begin(), users.end(), [](const auto& user) {
+    return user.uid == 0;
+  }));
+
+  // The cached enumeration is returned until it expires.
+  auto cached_users = cache.getUsers();
+  EXPECT_EQ(users.size(), cached_users.size());
+
+  auto groups = cache.getGroups();
+  ASSERT_FALSE(groups.empty());
+  auto root = cache.getGroupByGid(0);
+  ASSERT_TRUE(root.has_value());
+  EXPECT_FALSE(root->groupname.empty());
+
+  // Each gid is listed once.
+  std::vector<gid_t> gids;
+  for (const auto& group : groups) {
+    gids.push_back(group.gid);
+  }
+  std::sort(gids.begin(), gids.end());
+  EXPECT_EQ(std::adjacent_find(gids.begin(), gids.end()), gids.end());
+}
+
+TEST_F(PosixUsersGroupsCacheTests, test_user_groups) {
+  auto& cache = UsersGroupsCache::get();
+  auto user = cache.getUserByUid(::getuid());
+  ASSERT_TRUE(user.has_value());
+
+  // The primary group is always included.
+  auto groups = cache.getUserGroups(*user);
+  EXPECT_NE(std::find(groups.begin(), groups.end(), user->gid), groups.end());
+}
+
+TEST_F(PosixUsersGroupsCacheTests, test_uncached) {
+  FLAGS_users_groups_cache_ttl = 0;
+  auto& cache = UsersGroupsCache::get();
+  EXPECT_TRUE(cache.getUserByUid(::getuid()).has_value());
+
+  UsersGroupsCache uncached(false);
+  EXPECT_TRUE(uncached.getUserByUid(::getuid()).has_value());
+  EXPECT_FALSE(uncached.getUserByUid(kMissingUid).has_value());
+  EXPECT_FALSE(uncached.getUsers().empty());
+}
+
+} // namespace osquery
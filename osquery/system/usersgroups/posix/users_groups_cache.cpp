@@ -0,0 +1,303 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <grp.h>
+#include <pwd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <set>
+
+#include <osquery/core/flags.h>
+#include <osquery/system/usersgroups/posix/users_groups_cache.h>
+
+namespace osquery {
+
+FLAG(uint32,
+     users_groups_cache_ttl,
+     60,
+     "Seconds users and groups resolved through NSS are kept, 0 disables");
+
+namespace {
+
+/// Lookups kept for each map before it is emptied.
+const size_t kMaxCachedLookups{65536};
+
+/// Groups expected for a user, the buffer grows if more are found.
+const int kExpectedGroupsMax{64};
+
+/// Size of the buffers of the reentrant passwd and group calls.
+size_t getBufferSize(int name) {
+  auto size = ::sysconf(name);
+  // Values over 16K, or -1, are indeterminate, 16K should be more than enough.
+  return (size <= 0 || size > 16384) ? 16384 : static_cast<size_t>(size);
+}
+
+UserEntry makeUserEntry(const struct passwd* pwd) {
+  UserEntry user;
+  user.uid = pwd->pw_uid;
+  user.gid = pwd->pw_gid;
+  if (pwd->pw_name != nullptr) {
+    user.username = pwd->pw_name;
+  }
+  if (pwd->pw_gecos != nullptr) {
+    user.description = pwd->pw_gecos;
+  }
+  if (pwd->pw_dir != nullptr) {
+    user.directory = pwd->pw_dir;
+  }
+  if (pwd->pw_shell != nullptr) {
+    user.shell = pwd->pw_shell;
+  }
+  return user;
+}
+
+GroupEntry makeGroupEntry(const struct group* grp) {
+  GroupEntry group;
+  group.gid = grp->gr_gid;
+  if (grp->gr_name != nullptr) {
+    group.groupname = grp->gr_name;
+  }
+  return group;
+}
+
+} // namespace
+
+UsersGroupsCache& UsersGroupsCache::get() {
+  static UsersGroupsCache cache(true);
+  return cache;
+}
+
+UsersGroupsCache::UsersGroupsCache(bool shared) : shared_(shared) {}
+
+std::optional<UsersGroupsCache::Clock::time_point>
+UsersGroupsCache::expiration() const {
+  if (!shared_ || FLAGS_users_groups_cache_ttl == 0) {
+    return std::nullopt;
+  }
+  return Clock::now() + std::chrono::seconds(FLAGS_users_groups_cache_ttl);
+}
+
+template <typename K, typename T>
+void UsersGroupsCache::remember(std::map<K, Cached<T>>& entries,
+                                const K& key,
+                                const std::optional<T>& value,
+                                Clock::time_point expires) {
+  if (entries.size() >= kMaxCachedLookups && entries.count(key) == 0) {
+    entries.clear();
+  }
+  auto& entry = entries[key];
+  entry.value = value;
+  entry.expires = expires;
+}
+
+std::vector<UserEntry> UsersGroupsCache::getUsers() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto now = Clock::now();
+  if (shared_ && FLAGS_users_groups_cache_ttl > 0 && now < users_expire_) {
+    return users_;
+  }
+
+  std::vector<UserEntry> users;
+  auto bufsize = getBufferSize(_SC_GETPW_R_SIZE_MAX);
+  auto buf = std::make_unique<char[]>(bufsize);
+  struct passwd pwd;
+  struct passwd* pwd_result{nullptr};
+
+  ::setpwent();
+  while (::getpwent_r(&pwd, buf.get(), bufsize, &pwd_result) == 0 &&
+         pwd_result != nullptr) {
+    users.push_back(makeUserEntry(pwd_result));
+  }
+  ::endpwent();
+
+  auto expires = expiration();
+  if (expires) {
+    // The enumeration refreshes the lookups of every user.
+    for (const auto& user : users) {
+      remember(uids_, user.uid, std::optional<UserEntry>(user), *expires);
+      remember(
+          usernames_, user.username, std::optional<UserEntry>(user), *expires);
+    }
+    users_ = users;
+    users_expire_ = *expires;
+  }
+  return users;
+}
+
+std::vector<GroupEntry> UsersGroupsCache::getGroups() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto now = Clock::now();
+  if (shared_ && FLAGS_users_groups_cache_ttl > 0 && now < groups_expire_) {
+    return groups_;
+  }
+
+  std::vector<GroupEntry> groups;
+  std::set<gid_t> gids;
+  auto bufsize = getBufferSize(_SC_GETGR_R_SIZE_MAX);
+  auto buf = std::make_unique<char[]>(bufsize);
+  struct group grp;
+  struct group* grp_result{nullptr};
+
+  ::setgrent();
+  while (::getgrent_r(&grp, buf.get(), bufsize, &grp_result) == 0 &&
+         grp_result != nullptr) {
+    if (gids.insert(grp_result->gr_gid).second) {
+      groups.push_back(makeGroupEntry(grp_result));
+    }
+  }
+  ::endgrent();
+
+  auto expires = expiration();
+  if (expires) {
+    for (const auto& group : groups) {
+      remember(gids_, group.gid, std::optional<GroupEntry>(group), *expires);
+    }
+    groups_ = groups;
+    groups_expire_ = *expires;
+  }
+  return groups;
+}
+
+std::optional<UserEntry> UsersGroupsCache::getUserByUid(uid_t uid) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = uids_.find(uid);
+  if (it != uids_.end() && Clock::now() < it->second.expires) {
+    return it->second.value;
+  }
+
+  auto bufsize = getBufferSize(_SC_GETPW_R_SIZE_MAX);
+  auto buf = std::make_unique<char[]>(bufsize);
+  struct passwd pwd;
+  struct passwd* pwd_result{nullptr};
+
+  std::optional<UserEntry> user;
+  if (::getpwuid_r(uid, &pwd, buf.get(), bufsize, &pwd_result) == 0 &&
+      pwd_result != nullptr) {
+    user = makeUserEntry(pwd_result);
+  }
+
+  auto expires = expiration();
+  if (expires) {
+    remember(uids_, uid, user, *expires);
+  }
+  return user;
+}
+
+std::optional<UserEntry> UsersGroupsCache::getUserByName(
+    const std::string& username) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = usernames_.find(username);
+  if (it != usernames_.end() && Clock::now() < it->second.expires) {
+    return it->second.value;
+  }
+
+  auto bufsize = getBufferSize(_SC_GETPW_R_SIZE_MAX);
+  auto buf = std::make_unique<char[]>(bufsize);
+  struct passwd pwd;
+  struct passwd* pwd_result{nullptr};
+
+  std::optional<UserEntry> user;
+  if (::getpwnam_r(username.c_str(), &pwd, buf.get(), bufsize, &pwd_result) ==
+          0 &&
+      pwd_result != nullptr) {
+    user = makeUserEntry(pwd_result);
+  }
+
+  auto expires = expiration();
+  if (expires) {
+    remember(usernames_, username, user, *expires);
+  }
+  return user;
+}
+
+std::optional<GroupEntry> UsersGroupsCache::getGroupByGid(gid_t gid) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = gids_.find(gid);
+  if (it != gids_.end() && Clock::now() < it->second.expires) {
+    return it->second.value;
+  }
+
+  auto bufsize = getBufferSize(_SC_GETGR_R_SIZE_MAX);
+  auto buf = std::make_unique<char[]>(bufsize);
+  struct group grp;
+  struct group* grp_result{nullptr};
+
+  std::optional<GroupEntry> group;
+  if (::getgrgid_r(gid, &grp, buf.get(), bufsize, &grp_result) == 0 &&
+      grp_result != nullptr) {
+    group = makeGroupEntry(grp_result);
+  }
+
+  auto expires = expiration();
+  if (expires) {
+    remember(gids_, gid, group, *expires);
+  }
+  return group;
+}
+
+std::vector<gid_t> UsersGroupsCache::getUserGroups(const UserEntry& user) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = user_groups_.find(user.username);
+  if (it != user_groups_.end() && Clock::now() < it->second.expires &&
+      it->second.value) {
+    return *it->second.value;
+  }
+
+  // getgrouplist reports the number of groups when the buffer is too small,
+  // some implementations do not, so the buffer also doubles.
+  int ngroups = kExpectedGroupsMax;
+  std::vector<gid_t> groups;
+  while (true) {
+    groups.resize(static_cast<size_t>(ngroups));
+    auto size = ngroups;
+#ifdef __APPLE__
+    auto result = ::getgrouplist(user.username.c_str(),
+                                 static_cast<int>(user.gid),
+                                 reinterpret_cast<int*>(groups.data()),
+                                 &ngroups);
+#else
+    auto result = ::getgrouplist(
+        user.username.c_str(), user.gid, groups.data(), &ngroups);
+#endif
+    if (result >= 0) {
+      groups.resize(static_cast<size_t>(ngroups));
+      break;
+    }
+    if (size >= 65536) {
+      groups.clear();
+      break;
+    }
+    ngroups = std::max(ngroups, size * 2);
+  }
+
+  auto expires = expiration();
+  if (expires) {
+    remember(user_groups_,
+             user.username,
+             std::optional<std::vector<gid_t>>(groups),
+             *expires);
+  }
+  return groups;
+}
+
+void UsersGroupsCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  uids_.clear();
+  usernames_.clear();
+  gids_.clear();
+  user_groups_.clear();
+  users_.clear();
+  users_expire_ = Clock::time_point();
+  groups_.clear();
+  groups_expire_ = Clock::time_point();
+}
+
+} // namespace osquery
@@ -0,0 +1,117 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include <boost/noncopyable.hpp>
+
+namespace osquery {
+
+/// An account from the passwd database.
+struct UserEntry {
+  uid_t uid{0};
+  gid_t gid{0};
+  std::string username;
+  std::string description;
+  std::string directory;
+  std::string shell;
+};
+
+/// A group from the group database.
+struct GroupEntry {
+  gid_t gid{0};
+  std::string groupname;
+};
+
+/**
+ * @brief Users and groups resolved through NSS, kept for a while.
+ *
+ * On hosts using LDAP or SSSD each getpwuid or getgrent call may be a network
+ * round trip. The tables resolving users and groups share this cache, which
+ * keeps the results of lookups, including the ids that do not resolve, and of
+ * full enumerations for --users_groups_cache_ttl seconds. An enumeration also
+ * refreshes the lookups of the entries it returns.
+ */
+class UsersGroupsCache : private boost::noncopyable {
+ public:
+  /// The cache shared by the tables.
+  static UsersGroupsCache& get();
+
+  /**
+   * @brief Create a cache.
+   *
+   * @param shared If false nothing is kept and every call resolves through
+   * NSS, as needed within the namespaces of a container.
+   */
+  explicit UsersGroupsCache(bool shared);
+
+  /// Enumerate the users, with getpwent.
+  std::vector<UserEntry> getUsers();
+
+  /// Enumerate the groups, with getgrent, the first group of each gid is kept.
+  std::vector<GroupEntry> getGroups();
+
+  std::optional<UserEntry> getUserByUid(uid_t uid);
+  std::optional<UserEntry> getUserByName(const std::string& username);
+  std::optional<GroupEntry> getGroupByGid(gid_t gid);
+
+  /// The groups of a user, including its primary group, with getgrouplist.
+  std::vector<gid_t> getUserGroups(const UserEntry& user);
+
+  /// Forget all entries.
+  void clear();
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  template <typename T>
+  struct Cached {
+    /// Empty if the lookup did not resolve.
+    std::optional<T> value;
+    Clock::time_point expires;
+  };
+
+  /// The time entries stored now expire, empty if they are not kept.
+  std::optional<Clock::time_point> expiration() const;
+
+  /// Store the result of a lookup.
+  template <typename K, typename T>
+  void remember(std::map<K, Cached<T>>& entries,
+                const K& key,
+                const std::optional<T>& value,
+                Clock::time_point expires);
+
+ private:
+  const bool shared_{false};
+
+  std::map<uid_t, Cached<UserEntry>> uids_;
+  std::map<std::string, Cached<UserEntry>> usernames_;
+  std::map<gid_t, Cached<GroupEntry>> gids_;
+  std::map<std::string, Cached<std::vector<gid_t>>> user_groups_;
+
+  std::vector<UserEntry> users_;
+  Clock::time_point users_expire_;
+
+  std::vector<GroupEntry> groups_;
+  Clock::time_point groups_expire_;
+
+  /// Also serializes the NSS enumerations, which are not reentrant.
+  std::mutex mutex_;
+};
+
+} // namespace osquery
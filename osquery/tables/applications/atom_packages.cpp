@@ -56,8 +56,6 @@ void genReadJSONAndAddRow(const std::string& uid,
 }
 
 QueryData genAtomPackages(QueryContext& context) {
-  QueryData results;
-
   // find atom config directories
   std::set<std::pair<std::string, fs::path>> confDirs;
   auto users = usersFromContext(context);
@@ -70,16 +68,23 @@ QueryData genAtomPackages(QueryContext& context) {
     confDirs.insert({uid->second, fs::path(directory->second) / ".atom"});
   }
 
+  // Read the config directories of the users in parallel
+  QueryData confDirRows;
   for (const auto& confDir : confDirs) {
-    std::vector<std::string> packages;
-    resolveFilePattern(confDir.second / "packages" / "%" / "package.json",
-                       packages);
-    for (const auto& package : packages) {
-      genReadJSONAndAddRow(confDir.first, package, results);
-    }
+    confDirRows.push_back(
+        {{"uid", confDir.first}, {"directory", confDir.second.string()}});
   }
 
-  return results;
+  return forEachUserParallel(
+      confDirRows, [](const Row& confDir, QueryData& results) {
+        std::vector<std::string> packages;
+        resolveFilePattern(fs::path(confDir.at("directory")) / "packages" /
+                               "%" / "package.json",
+                           packages);
+        for (const auto& package : packages) {
+          genReadJSONAndAddRow(confDir.at("uid"), package, results);
+        }
+      });
 }
 } // namespace tables
 } // namespace osquery
@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <unordered_map>
+
 #include <boost/property_tree/json_parser.hpp>
 
 #include <osquery/core/tables.h>
@@ -14,6 +16,7 @@
 #include <osquery/logger/logger.h>
 #include <osquery/tables/system/system_utils.h>
 #include <osquery/utils/conversions/tryto.h>
+#include <osquery/utils/mutex.h>
 
 namespace fs = boost::filesystem;
 namespace pt = boost::property_tree;
@@ -32,6 +35,34 @@ inline void jsonBoolAsInt(std::string& s) {
   }
 }
 
+/// The most extensions files kept parsed, across all profiles.
+const size_t kMaxCachedExtensionsFiles{1024};
+
+/// Addon rows parsed from an extensions file, without the uid column.
+struct FirefoxAddonsEntry {
+  /// The file size and modification time when parsed.
+  std::string identity;
+
+  QueryData rows;
+};
+
+Mutex kFirefoxAddonsMutex;
+std::unordered_map<std::string, FirefoxAddonsEntry> kFirefoxAddonsCache;
+
+/// The size and modification time of a file, or empty if unknown.
+std::string getFileIdentity(const fs::path& path) {
+  boost::system::error_code ec;
+  auto size = fs::file_size(path, ec);
+  if (ec) {
+    return "";
+  }
+  auto mtime = fs::last_write_time(path, ec);
+  if (ec) {
+    return "";
+  }
+  return std::to_string(size) + ":" + std::to_string(mtime);
+}
+
 } // namespace
 
 /// Each home directory will include custom extensions.
@@ -64,18 +95,9 @@ const std::map<std::string, std::string> kFirefoxAddonKeys = {
     {"path", "path"},
 };
 
-void genFirefoxAddonsFromExtensions(const std::string& uid,
-                                    const std::string& path,
-                                    QueryData& results) {
-  pt::ptree tree;
-  if (!osquery::parseJSON(path + kFirefoxExtensionsFile, tree).ok()) {
-    TLOG << "Could not parse JSON from: " << path + kFirefoxExtensionsFile;
-    return;
-  }
-
+void parseFirefoxAddons(const pt::ptree& tree, QueryData& results) {
   for (const auto& addon : tree.get_child("addons")) {
     Row r;
-    r["uid"] = uid;
     // Most of the keys are in the top-level JSON dictionary.
     for (const auto& it : kFirefoxAddonKeys) {
       r[it.second] = addon.second.get(it.first, "");
@@ -96,18 +118,58 @@ void genFirefoxAddonsFromExtensions(const std::string& uid,
   }
 }
 
-QueryData genFirefoxAddons(QueryContext& context) {
-  QueryData results;
+void genFirefoxAddonsFromExtensions(const std::string& uid,
+                                    const std::string& path,
+                                    QueryData& results) {
+  // Profiles rarely change, reuse the rows parsed from an unchanged file.
+  auto extensions_path = path + kFirefoxExtensionsFile;
+  auto identity = getFileIdentity(extensions_path);
+
+  QueryData rows;
+  bool cached = false;
+  if (!identity.empty()) {
+    ReadLock lock(kFirefoxAddonsMutex);
+    auto it = kFirefoxAddonsCache.find(extensions_path);
+    if (it != kFirefoxAddonsCache.end() && it->second.identity == identity) {
+      rows = it->second.rows;
+      cached = true;
+    }
+  }
 
-  // Iterate over each user
+  if (!cached) {
+    pt::ptree tree;
+    if (!osquery::parseJSON(extensions_path, tree).ok()) {
+      TLOG << "Could not parse JSON from: " << extensions_path;
+      return;
+    }
+
+    parseFirefoxAddons(tree, rows);
+    if (!identity.empty()) {
+      WriteLock lock(kFirefoxAddonsMutex);
+      if (kFirefoxAddonsCache.size() >= kMaxCachedExtensionsFiles &&
+          kFirefoxAddonsCache.count(extensions_path) == 0) {
+        kFirefoxAddonsCache.erase(kFirefoxAddonsCache.begin());
+      }
+      kFirefoxAddonsCache[extensions_path] = {identity, rows};
+    }
+  }
+
+  for (auto& r : rows) {
+    r["uid"] = uid;
+    results.push_back(std::move(r));
+  }
+}
+
+QueryData genFirefoxAddons(QueryContext& context) {
+  // Iterate over each user, the users are read in parallel
   QueryData users = usersFromContext(context);
-  for (const auto& row : users) {
+  return forEachUserParallel(users, [](const Row& row, QueryData& results) {
     if (row.count("uid") > 0 && row.count("directory") > 0) {
       // For each user, enumerate all of their Firefox profiles.
       std::vector<std::string> profiles;
       auto directory = fs::path(row.at("directory")) / kFirefoxPath;
       if (!listDirectoriesInDirectory(directory, profiles).ok()) {
-        continue;
+        return;
       }
 
       // Generate an addons list from their extensions JSON.
@@ -115,9 +177,7 @@ QueryData genFirefoxAddons(QueryContext& context) {
         genFirefoxAddonsFromExtensions(row.at("uid"), profile, results);
       }
     }
-  }
-
-  return results;
+  });
 }
 } // namespace tables
 } // namespace osquery
@@ -367,6 +367,31 @@ TEST_F(ChromeUtilsTests, getExtensionFromSnapshot) {
   EXPECT_EQ(computed_identifier, kExpectedComputedExtensionIdentifier);
 }
 
+TEST_F(ChromeUtilsTests, getExtensionFromSnapshotCache) {
+  ChromeProfileSnapshot::Extension snapshot;
+  snapshot.path = std::string("/cache/") + kTestExtensionPath;
+  snapshot.manifest = kTestExtensionManifest;
+  snapshot.identity = "1:2:3:4";
+
+  ChromeProfile::Extension extension;
+  ASSERT_TRUE(getExtensionFromSnapshot(extension, snapshot).ok());
+
+  // The parsed extension is reused without reading the manifest again
+  snapshot.manifest.clear();
+
+  ChromeProfile::Extension cached_extension;
+  ASSERT_TRUE(getExtensionFromSnapshot(cached_extension, snapshot).ok());
+
+  EXPECT_EQ(cached_extension.path, extension.path);
+  EXPECT_EQ(cached_extension.manifest_hash, extension.manifest_hash);
+  EXPECT_EQ(cached_extension.manifest_json, extension.manifest_json);
+  EXPECT_EQ(cached_extension.properties, extension.properties);
+
+  // A new identity reads the manifest from disk, which does not exist
+  snapshot.identity = "1:2:3:5";
+  EXPECT_FALSE(getExtensionFromSnapshot(cached_extension, snapshot).ok());
+}
+
 TEST_F(ChromeUtilsTests, getChromeProfilesFromSnapshotList) {
   ChromeProfileSnapshot::Extension ref_ext_snapshot;
   ref_ext_snapshot.path = kTestExtensionPath;
@@ -18,6 +18,7 @@
 #include <osquery/utils/base64.h>
 #include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/info/platform_type.h>
+#include <osquery/utils/mutex.h>
 
 namespace osquery {
 
@@ -40,6 +41,12 @@ const std::string kExtensionManifestName{"manifest.json"};
 /// The name of the profile child folder containing extensions
 const std::string kExtensionsFolderName{"Extensions"};
 
+/// The name of the extension child folder containing the localized strings
+const std::string kExtensionLocalesFolderName{"_locales"};
+
+/// The most parsed extensions kept in the cache, across all profiles
+const std::size_t kMaxCachedExtensionCount{4096};
+
 /// The possible configuration file names
 const std::vector<std::reference_wrapper<const std::string>>
     kPossibleConfigFileNames = {std::ref(kProfilePreferencesFile),
@@ -192,6 +199,86 @@ bool parseJsonString(pt::iptree& tree, const std::string& json) {
   }
 }
 
+/// Parsed extensions, by folder path, valid while the identity is unchanged
+class ChromeExtensionCache final {
+ public:
+  bool contains(const std::string& path, const std::string& identity) {
+    ReadLock lock(mutex_);
+    auto it = entries_.find(path);
+    return it != entries_.end() && it->second.first == identity;
+  }
+
+  bool get(const std::string& path,
+           const std::string& identity,
+           ChromeProfile::Extension& extension) {
+    ReadLock lock(mutex_);
+    auto it = entries_.find(path);
+    if (it == entries_.end() || it->second.first != identity) {
+      return false;
+    }
+
+    extension = it->second.second;
+    return true;
+  }
+
+  void put(const std::string& path,
+           const std::string& identity,
+           const ChromeProfile::Extension& extension) {
+    WriteLock lock(mutex_);
+    if (entries_.size() >= kMaxCachedExtensionCount &&
+        entries_.count(path) == 0) {
+      entries_.erase(entries_.begin());
+    }
+
+    entries_[path] = std::make_pair(identity, extension);
+  }
+
+ private:
+  Mutex mutex_;
+  std::unordered_map<std::string,
+                     std::pair<std::string, ChromeProfile::Extension>>
+      entries_;
+};
+
+ChromeExtensionCache& getChromeExtensionCache() {
+  static ChromeExtensionCache cache;
+  return cache;
+}
+
+/// Returns the size and modification times that change when an extension
+/// is installed again or its localized strings are updated. Chrome installs
+/// each version of an extension in a new folder
+std::string getExtensionIdentity(const fs::path& extension_path) {
+  auto manifest_path = extension_path / kExtensionManifestName;
+
+  boost::system::error_code error_code;
+  auto manifest_size = fs::file_size(manifest_path, error_code);
+  if (error_code) {
+    return {};
+  }
+
+  auto manifest_time = fs::last_write_time(manifest_path, error_code);
+  if (error_code) {
+    return {};
+  }
+
+  auto folder_time = fs::last_write_time(extension_path, error_code);
+  if (error_code) {
+    return {};
+  }
+
+  // Most extensions are not localized
+  auto locales_time = fs::last_write_time(
+      extension_path / kExtensionLocalesFolderName, error_code);
+  if (error_code) {
+    locales_time = 0;
+  }
+
+  return std::to_string(manifest_size) + ":" + std::to_string(manifest_time) +
+         ":" + std::to_string(folder_time) + ":" +
+         std::to_string(locales_time);
+}
+
 /// A user id/user home path pair
 struct UserInformation final {
   std::int64_t uid{};
@@ -244,64 +331,85 @@ bool isValidChromeProfile(const fs::path& path) {
   return false;
 }
 
-/// Returns a list of chrome profiles matching the given contraints
-ChromeProfilePathList getChromeProfilePathList(const QueryContext& context) {
-  auto user_info_list = getUserInformationList(context);
-
+/// Returns the list of chrome profiles of the given user
+ChromeProfilePathList getUserChromeProfilePathList(
+    const UserInformation& user_info) {
   ChromeProfilePathList output;
 
-  for (const auto& user_info : user_info_list) {
-    ChromeProfilePath chrome_profile = {};
-    chrome_profile.uid = user_info.uid;
+  ChromeProfilePath chrome_profile = {};
+  chrome_profile.uid = user_info.uid;
 
-    for (const auto& chrome_path_tuple : getChromePathSuffixMap()) {
-      const auto& browser_type = std::get<0>(chrome_path_tuple);
-      const auto& path_suffix = std::get<1>(chrome_path_tuple);
+  for (const auto& chrome_path_tuple : getChromePathSuffixMap()) {
+    const auto& browser_type = std::get<0>(chrome_path_tuple);
+    const auto& path_suffix = std::get<1>(chrome_path_tuple);
 
-      chrome_profile.type = browser_type;
+    chrome_profile.type = browser_type;
 
-      auto path = fs::path(user_info.path) / path_suffix;
+    auto path = fs::path(user_info.path) / path_suffix;
 
-      boost::system::error_code error_code;
-      auto absolute_chrome_path = fs::canonical(path, error_code);
+    boost::system::error_code error_code;
+    auto absolute_chrome_path = fs::canonical(path, error_code);
+    if (error_code) {
+      absolute_chrome_path = path;
+    }
+
+    absolute_chrome_path.make_preferred();
+
+    // Attempt to use the folder as a profile first
+    if (isValidChromeProfile(absolute_chrome_path)) {
+      chrome_profile.value = absolute_chrome_path.string();
+      output.push_back(chrome_profile);
+
+      continue;
+    }
+
+    // Attempt to find profiles inside the subdirectories
+    std::vector<std::string> chrome_subfolder_list;
+    auto status = listDirectoriesInDirectory(absolute_chrome_path.string(),
+                                             chrome_subfolder_list);
+    if (!status.ok()) {
+      continue;
+    }
+
+    for (const auto& chrome_subfolder : chrome_subfolder_list) {
+      auto subfolder = fs::canonical(chrome_subfolder, error_code);
       if (error_code) {
-        absolute_chrome_path = path;
+        subfolder = chrome_subfolder;
       }
 
-      absolute_chrome_path.make_preferred();
+      subfolder.make_preferred();
 
-      // Attempt to use the folder as a profile first
-      if (isValidChromeProfile(absolute_chrome_path)) {
-        chrome_profile.value = absolute_chrome_path.string();
+      if (isValidChromeProfile(subfolder)) {
+        chrome_profile.value = subfolder.string();
         output.push_back(chrome_profile);
 
         continue;
       }
+    }
+  }
 
-      // Attempt to find profiles inside the subdirectories
-      std::vector<std::string> chrome_subfolder_list;
-      auto status = listDirectoriesInDirectory(absolute_chrome_path.string(),
-                                               chrome_subfolder_list);
-      if (!status.ok()) {
-        continue;
-      }
-
-      for (const auto& chrome_subfolder : chrome_subfolder_list) {
-        auto subfolder = fs::canonical(chrome_subfolder, error_code);
-        if (error_code) {
-          subfolder = chrome_subfolder;
-        }
+  return output;
+}
 
-        subfolder.make_preferred();
+/// Returns a list of chrome profiles matching the given contraints; the
+/// home folders of the users are searched in parallel
+ChromeProfilePathList getChromeProfilePathList(const QueryContext& context) {
+  auto user_info_list = getUserInformationList(context);
 
-        if (isValidChromeProfile(subfolder)) {
-          chrome_profile.value = subfolder.string();
-          output.push_back(chrome_profile);
+  std::vector<ChromeProfilePathList> user_profile_list(user_info_list.size());
+  forEachParallel(
+      user_info_list.size(),
+      [&](std::size_t index) {
+        user_profile_list[index] =
+            getUserChromeProfilePathList(user_info_list[index]);
+      },
+      [](std::size_t) {});
 
-          continue;
-        }
-      }
-    }
+  ChromeProfilePathList output;
+  for (auto& profile_path_list : user_profile_list) {
+    output.insert(output.end(),
+                  std::make_move_iterator(profile_path_list.begin()),
+                  std::make_move_iterator(profile_path_list.end()));
   }
 
   return output;
@@ -436,6 +544,23 @@ bool isBuiltInChromeExtension(const fs::path& absolute_ext_path) {
   return base_path_it != kBuiltInExtPathList.end();
 }
 
+/// Reads the manifest of the given extension, unless the extension was
+/// already parsed with the same identity
+Status captureExtensionSnapshot(ChromeProfileSnapshot::Extension& extension,
+                                const std::string& extension_path) {
+  extension = {};
+  extension.path = extension_path;
+  extension.identity = getExtensionIdentity(extension_path);
+
+  if (!extension.identity.empty() &&
+      getChromeExtensionCache().contains(extension_path, extension.identity)) {
+    return Status::success();
+  }
+
+  auto manifest_path = fs::path(extension_path) / kExtensionManifestName;
+  return readFile(manifest_path.string(), extension.manifest, 0);
+}
+
 /// Captures a Chrome profile from the given path
 bool captureProfileSnapshotExtensionsFromPath(
     ChromeProfileSnapshot& snapshot, const ChromeProfilePath& profile_path) {
@@ -478,12 +603,11 @@ bool captureProfileSnapshotExtensionsFromPath(
 
   for (const auto& extension_path : extension_path_list) {
     ChromeProfileSnapshot::Extension extension = {};
-    extension.path = extension_path;
-
-    auto manifest_path = fs::path(extension_path) / kExtensionManifestName;
-    auto status = readFile(manifest_path.string(), extension.manifest, 0);
+    auto status = captureExtensionSnapshot(extension, extension_path);
 
     if (!status.ok()) {
+      auto manifest_path = fs::path(extension_path) / kExtensionManifestName;
+
       if (!isBuiltInChromeExtension(extension_path)) {
         LOG(INFO) << "Failed to read the following manifest.json file: "
                   << manifest_path.string()
@@ -545,14 +669,12 @@ bool captureProfileSnapshotExtensionsFromPath(
       // This extension is outside the profile, so create a new
       // entry
       ChromeProfileSnapshot::Extension extension = {};
-      extension.path = referenced_ext_path;
-
-      auto manifest_path =
-          fs::path(referenced_ext_path) / kExtensionManifestName;
-
-      auto status = readFile(manifest_path.string(), extension.manifest, 0);
+      auto status = captureExtensionSnapshot(extension, referenced_ext_path);
 
       if (!status.ok()) {
+        auto manifest_path =
+            fs::path(referenced_ext_path) / kExtensionManifestName;
+
         if (!isBuiltInChromeExtension(referenced_ext_path)) {
           LOG(ERROR)
               << "Failed to read the following manifest.json file: "
@@ -573,25 +695,40 @@ bool captureProfileSnapshotExtensionsFromPath(
 }
 
 /// Retrieves a list of profiles and extensions with as few parsing
-/// as possible
+/// as possible; the profiles are read in parallel
 ChromeProfileSnapshotList getChromeProfileSnapshotList(
     const QueryContext& context) {
-  ChromeProfileSnapshotList output;
-
   // Go through each profile we have found thanks to the constraints
-  for (const auto& profile_path : getChromeProfilePathList(context)) {
-    // Save path and type, so we can add all the chrome-based
-    // extensions in the same table
-    ChromeProfileSnapshot snapshot = {};
-    if (!captureProfileSnapshotSettingsFromPath(snapshot, profile_path)) {
-      continue;
-    }
+  auto profile_path_list = getChromeProfilePathList(context);
 
-    if (!captureProfileSnapshotExtensionsFromPath(snapshot, profile_path)) {
-      continue;
-    }
+  std::vector<boost::optional<ChromeProfileSnapshot>> snapshot_list(
+      profile_path_list.size());
+
+  forEachParallel(
+      profile_path_list.size(),
+      [&](std::size_t index) {
+        const auto& profile_path = profile_path_list[index];
+
+        // Save path and type, so we can add all the chrome-based
+        // extensions in the same table
+        ChromeProfileSnapshot snapshot = {};
+        if (!captureProfileSnapshotSettingsFromPath(snapshot, profile_path)) {
+          return;
+        }
+
+        if (!captureProfileSnapshotExtensionsFromPath(snapshot, profile_path)) {
+          return;
+        }
 
-    output.push_back(std::move(snapshot));
+        snapshot_list[index] = std::move(snapshot);
+      },
+      [](std::size_t) {});
+
+  ChromeProfileSnapshotList output;
+  for (auto& opt_snapshot : snapshot_list) {
+    if (opt_snapshot.has_value()) {
+      output.push_back(std::move(*opt_snapshot));
+    }
   }
 
   return output;
@@ -602,8 +739,9 @@ Status getLocalizationData(pt::iptree& parsed_localization,
                            const std::string& locale) {
   parsed_localization = {};
 
-  auto messages_file_path =
-      fs::path(extension_path) / "_locales" / locale / "messages.json";
+  auto messages_file_path = fs::path(extension_path) /
+                            kExtensionLocalesFolderName / locale /
+                            "messages.json";
 
   std::string messages_json;
   auto status = readFile(messages_file_path.string(), messages_json, 0);
@@ -923,14 +1061,31 @@ Status getExtensionFromSnapshot(
     const ChromeProfileSnapshot::Extension& snapshot) {
   extension = {};
 
+  auto& cache = getChromeExtensionCache();
+  if (!snapshot.identity.empty() &&
+      cache.get(snapshot.path, snapshot.identity, extension)) {
+    return Status::success();
+  }
+
+  // The manifest is not captured when the extension was cached, but
+  // the cache entry may have been dropped since
+  std::string manifest = snapshot.manifest;
+  if (manifest.empty() && !snapshot.identity.empty()) {
+    auto manifest_path = fs::path(snapshot.path) / kExtensionManifestName;
+    auto status = readFile(manifest_path.string(), manifest, 0);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
   ChromeProfile::Extension output;
   output.path = snapshot.path;
 
-  output.manifest_hash = hashFromBuffer(
-      HASH_TYPE_SHA256, snapshot.manifest.c_str(), snapshot.manifest.size());
+  output.manifest_hash =
+      hashFromBuffer(HASH_TYPE_SHA256, manifest.c_str(), manifest.size());
 
   pt::iptree parsed_manifest;
-  if (!parseJsonString(parsed_manifest, snapshot.manifest)) {
+  if (!parseJsonString(parsed_manifest, manifest)) {
     return Status::failure(
         "Failed to parse the Manifest file for the following extension: " +
         snapshot.path);
@@ -966,6 +1121,10 @@ Status getExtensionFromSnapshot(
     output.opt_computed_identifier = identifier_exp.take();
   }
 
+  if (!snapshot.identity.empty()) {
+    cache.put(snapshot.path, snapshot.identity, output);
+  }
+
   extension = std::move(output);
   return Status::success();
 }
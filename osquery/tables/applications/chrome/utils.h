@@ -47,8 +47,13 @@ struct ChromeProfileSnapshot final {
     /// The absolute path to the extension folder
     std::string path;
 
-    /// The contents of the manifest file
+    /// The contents of the manifest file, empty if the extension was
+    /// already parsed with the same identity
     std::string manifest;
+
+    /// The size and modification times of the manifest and folders, or
+    /// empty if unknown. Extensions are parsed again when it changes
+    std::string identity;
   };
 
   /// A map of extensions where the key identifies the (relative) path
@@ -0,0 +1,165 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <chrono>
+
+#include <benchmark/benchmark.h>
+
+#include <boost/filesystem.hpp>
+
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/profiler/allocations.h>
+#include <osquery/sql/sql.h>
+
+#include "osquery/sql/sqlite_util.h"
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+/// Files per directory of the file and hash fixture.
+const size_t kFixtureFilesPerDirectory{100};
+
+/// Bytes of each fixture file, large enough to be read in several chunks.
+const size_t kFixtureFileSize{16 * 1024};
+
+/**
+ * @brief Run a table query and report its cost per row.
+ *
+ * Besides the time per iteration, each benchmark reports the rows of an
+ * iteration, the nanoseconds per row and, when the executable links the
+ * allocation hooks, the heap allocations and bytes per row.
+ */
+static void runTableQuery(benchmark::State& state, const std::string& query) {
+  size_t rows = 0;
+  std::uint64_t allocations = 0;
+  std::uint64_t allocated = 0;
+  std::chrono::nanoseconds elapsed{0};
+
+  while (state.KeepRunning()) {
+    auto start = std::chrono::steady_clock::now();
+    ScopedAllocationAccount account;
+    SQLInternal sql(query);
+    elapsed += std::chrono::steady_clock::now() - start;
+
+    if (!sql.getStatus().ok()) {
+      state.SkipWithError(sql.getStatus().getMessage().c_str());
+      break;
+    }
+    rows += sql.rowsTyped().size();
+    allocations += account.allocations();
+    allocated += account.allocated();
+  }
+
+  if (rows == 0) {
+    return;
+  }
+  auto per_row = [rows](double total) { return total / rows; };
+  state.counters["rows"] =
+      static_cast<double>(rows) / std::max<size_t>(state.iterations(), 1);
+  state.counters["ns_per_row"] = per_row(elapsed.count());
+  if (allocationsCounted()) {
+    state.counters["allocations_per_row"] = per_row(allocations);
+    state.counters["bytes_per_row"] = per_row(allocated);
+  }
+}
+
+/**
+ * @brief Create a directory tree for the file and hash tables.
+ *
+ * Like createMockFileStructure, the tree is written to a unique temporary
+ * directory. It has the given number of directories, each holding
+ * kFixtureFilesPerDirectory files of kFixtureFileSize bytes.
+ */
+static fs::path createTableFixture(size_t directories) {
+  auto root_dir = fs::temp_directory_path() /
+                  fs::unique_path("osquery.benchmarks.%%%%.%%%%");
+  std::string content(kFixtureFileSize, 'A');
+  for (size_t i = 0; i < directories; ++i) {
+    auto directory = root_dir / std::to_string(i);
+    fs::create_directories(directory);
+    for (size_t j = 0; j < kFixtureFilesPerDirectory; ++j) {
+      // Each file has a distinct content and digest.
+      content[j % content.size()] = 'B';
+      writeTextFile(directory / ("file" + std::to_string(j)), content);
+    }
+  }
+  return root_dir;
+}
+
+static void TABLE_processes(benchmark::State& state) {
+  runTableQuery(state, "select * from processes");
+}
+
+BENCHMARK(TABLE_processes);
+
+static void TABLE_processes_pid_constraint(benchmark::State& state) {
+  // The pid constraint only reads the status of a single process.
+  runTableQuery(state, "select * from processes where pid = 1");
+}
+
+BENCHMARK(TABLE_processes_pid_constraint);
+
+static void TABLE_process_open_sockets(benchmark::State& state) {
+  runTableQuery(state, "select * from process_open_sockets");
+}
+
+BENCHMARK(TABLE_process_open_sockets);
+
+static void TABLE_listening_ports(benchmark::State& state) {
+  runTableQuery(state, "select * from listening_ports");
+}
+
+BENCHMARK(TABLE_listening_ports);
+
+static void TABLE_users(benchmark::State& state) {
+  runTableQuery(state, "select * from users");
+}
+
+BENCHMARK(TABLE_users);
+
+#ifdef __linux__
+static void TABLE_deb_packages(benchmark::State& state) {
+  runTableQuery(state, "select * from deb_packages");
+}
+
+BENCHMARK(TABLE_deb_packages);
+
+static void TABLE_rpm_packages(benchmark::State& state) {
+  runTableQuery(state, "select * from rpm_packages");
+}
+
+BENCHMARK(TABLE_rpm_packages);
+#endif
+
+static void TABLE_file_directory(benchmark::State& state) {
+  auto root_dir = createTableFixture(static_cast<size_t>(state.range(0)));
+  runTableQuery(state,
+                "select * from file where path like '" +
+                    (root_dir / "%" / "%").string() + "'");
+  fs::remove_all(root_dir);
+}
+
+BENCHMARK(TABLE_file_directory)->Arg(1)->Arg(10);
+
+static void TABLE_hash_directory(benchmark::State& state) {
+  // The hash table caches the digests of unchanged files. With one directory
+  // the iterations after the first measure the cache lookups, with ten the
+  // files outnumber --hash_cache_max and are hashed again.
+  auto root_dir = createTableFixture(static_cast<size_t>(state.range(0)));
+  runTableQuery(state,
+                "select * from hash where path like '" +
+                    (root_dir / "%" / "%").string() + "'");
+  fs::remove_all(root_dir);
+}
+
+BENCHMARK(TABLE_hash_directory)->Arg(1)->Arg(10);
+
+} // namespace osquery
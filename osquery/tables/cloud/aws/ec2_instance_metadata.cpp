@@ -43,6 +43,14 @@ class Ec2MetaData {
    */
   std::string doGet() const;
 
+  /**
+   * @brief Request the metadata from the metadata service.
+   *
+   * @param http_body The output HTTP body, empty if there is no value.
+   * @return A failure if the response should not be reused.
+   */
+  Status request(std::string& http_body) const;
+
   /**
    * @brief Extract relevant data from return API call, pure virtual
    *
@@ -135,6 +143,19 @@ class JSONEc2MetaData : public Ec2MetaData {
 std::string Ec2MetaData::doGet() const {
   const static std::string ec2_metadata_url{kEc2MetadataUrl};
 
+  // Responses are shared by the queries within kEc2MetadataCacheTime.
+  std::string body;
+  http::InstanceMetadataCache::get().fetch(
+      ec2_metadata_url + url_suffix_,
+      [this](std::string& http_body) { return request(http_body); },
+      body,
+      kEc2MetadataCacheTime);
+  return body;
+}
+
+Status Ec2MetaData::request(std::string& http_body) const {
+  const static std::string ec2_metadata_url{kEc2MetadataUrl};
+
   auto opt_token = getIMDSToken();
   http::Request req(ec2_metadata_url + url_suffix_);
 
@@ -145,7 +166,7 @@ std::string Ec2MetaData::doGet() const {
        we cannot attempt to do a request, so return with empty results. */
     VLOG(1) << "Could not retrieve an IMDSv2 token to request the instance id "
                "and region. The IMDSv1 fallback is disabled";
-    return {};
+    return Status::failure("No IMDSv2 token");
   }
 
   http::Client::Options options;
@@ -156,24 +177,25 @@ std::string Ec2MetaData::doGet() const {
     http::Response res = client.get(req);
     boost::uint16_t http_status_code = res.status();
 
-    // Silently ignore 404
+    // Silently ignore 404, the missing value is kept like a value
     if (http_status_code == 404) {
-      return {};
+      return Status::success();
     }
 
     // Log "hard" errors
     if (http_status_code != 200) {
       VLOG(1) << "Unexpected HTTP response for: " << url_suffix_
               << " Status: " << http_status_code;
-      return {};
+      return Status::failure("Unexpected HTTP response");
     }
 
-    return res.body();
+    http_body = res.body();
+    return Status::success();
   } catch (std::system_error& e) {
     VLOG(1) << "Request for " << url_suffix_ << " failed: " << e.what();
   }
 
-  return "";
+  return Status::failure("Request failed");
 }
 
 void setRowField(const ColumnType sql_type,
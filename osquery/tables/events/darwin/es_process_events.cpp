@@ -28,7 +28,7 @@ Status ESProcessEventSubscriber::init() {
     sc->es_event_subscriptions_.push_back(ES_EVENT_TYPE_NOTIFY_FORK);
     sc->es_event_subscriptions_.push_back(ES_EVENT_TYPE_NOTIFY_EXIT);
 
-    subscribe(&ESProcessEventSubscriber::Callback, sc);
+    subscribeBatch(&ESProcessEventSubscriber::Callback, sc);
 
     return Status::success();
   } else {
@@ -36,9 +36,8 @@ Status ESProcessEventSubscriber::init() {
   }
 }
 
-Status ESProcessEventSubscriber::Callback(
-    const EndpointSecurityEventContextRef& ec,
-    const EndpointSecuritySubscriptionContextRef& sc) {
+/// Convert an event into a row of the table.
+static Row genRow(const EndpointSecurityEventContextRef& ec) {
   Row r;
 
   r["version"] = INTEGER(ec->version);
@@ -82,12 +81,18 @@ Status ESProcessEventSubscriber::Callback(
     r["exit_code"] = INTEGER(ec->exit_code);
   }
 
-  sc->row_list = {r};
-  if (!sc->row_list.empty()) {
-    addBatch(sc->row_list);
-  }
+  return r;
+}
 
-  return Status::success();
+Status ESProcessEventSubscriber::Callback(
+    const std::vector<EndpointSecurityEventContextRef>& ec_list,
+    const EndpointSecuritySubscriptionContextRef& sc) {
+  std::vector<Row> rows;
+  rows.reserve(ec_list.size());
+  for (const auto& ec : ec_list) {
+    rows.push_back(genRow(ec));
+  }
+  return addBatch(rows);
 }
 
 } // namespace osquery
@@ -100,6 +100,7 @@ Status FileEventSubscriber::Callback(const FSEventsEventContextRef& ec,
   r["target_path"] = ec->path;
   r["category"] = sc->category;
   r["transaction_id"] = INTEGER(ec->transaction_id);
+  r["event_count"] = BIGINT(ec->event_count);
 
   // Add hashing and 'join' against the file table for stat-information.
   decorateFileEvent(
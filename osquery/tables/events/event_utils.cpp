@@ -9,15 +9,44 @@
 
 #include <osquery/sql/sql.h>
 
+#include <osquery/core/flags.h>
 #include <osquery/hashing/hashing.h>
+#include <osquery/logger/logger.h>
 #include <osquery/tables/events/event_utils.h>
+#include <osquery/utils/conversions/split.h>
 
 namespace osquery {
 
+FLAG(string,
+     file_events_hash_types,
+     "md5,sha1,sha256",
+     "Comma-separated digests of file_events targets: md5, sha1, sha256, "
+     "xxh64, blake2b");
+
 const std::set<std::string> kCommonFileColumns = {
     "inode", "uid", "gid", "mode", "size", "atime", "mtime", "ctime",
 };
 
+int getFileEventHashMask() {
+  int mask = 0;
+  for (const auto& name : split(FLAGS_file_events_hash_types, ",")) {
+    auto type = getHashType(name);
+    if (type == 0) {
+      LOG(WARNING) << "Unknown file_events hash type: " << name;
+    }
+    mask |= type;
+  }
+  return mask;
+}
+
+void setFileEventHashes(const MultiHashes& hashes, Row& r) {
+  for (const auto& type : kHashTypeNames) {
+    r[type.second] = getHashDigest(hashes, type.first);
+  }
+  // Hashed determines the success/status of hashing, -1 failed, 1 success.
+  r["hashed"] = (hashes.mask == 0) ? "-1" : "1";
+}
+
 void decorateFileEvent(const std::string& path, bool hash, Row& r) {
   auto results = SQL::selectAllFrom("file", "path", EQUALS, path);
   if (results.size() == 1) {
@@ -29,14 +58,9 @@ void decorateFileEvent(const std::string& path, bool hash, Row& r) {
     }
   }
 
-  if (hash) {
-    auto hashes = hashMultiFromFile(
-        HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
-    r["md5"] = std::move(hashes.md5);
-    r["sha1"] = std::move(hashes.sha1);
-    r["sha256"] = std::move(hashes.sha256);
-    // Hashed determines the success/status of hashing, -1 failed, 1 success.
-    r["hashed"] = (r.at("md5").empty()) ? "-1" : "1";
+  auto mask = getFileEventHashMask();
+  if (hash && mask != 0) {
+    setFileEventHashes(hashMultiFromFile(mask, path), r);
   } else {
     // Alternatively if hashing wasn't needed hashed is a 0.
     r["hashed"] = "0";
@@ -19,6 +19,14 @@ namespace osquery {
 /// List of columns decorated for file events.
 extern const std::set<std::string> kCommonFileColumns;
 
+struct MultiHashes;
+
+/// Get the digests of file_events targets, from file_events_hash_types.
+int getFileEventHashMask();
+
+/// Set the digest columns and the hashed status of a file event row.
+void setFileEventHashes(const MultiHashes& hashes, Row& r);
+
 /**
  * @brief A helper function for each platform's implementation of file_events.
  *
@@ -0,0 +1,163 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/core/system.h>
+#include <osquery/tables/events/event_utils.h>
+#include <osquery/tables/events/file_hash_queue.h>
+#include <osquery/utils/conversions/tryto.h>
+
+namespace osquery {
+
+namespace {
+
+/// Files waiting at once before callbacks hash new events themselves.
+const std::size_t kMaxPendingFiles{4096};
+
+} // namespace
+
+const std::string kFileHashPending{"2"};
+
+FileHashQueue::FileHashQueue(std::size_t thread_count,
+                             std::chrono::milliseconds window,
+                             std::size_t max_digests)
+    : window_(window), max_digests_(max_digests) {
+  if (thread_count == 0) {
+    thread_count = 1;
+  }
+
+  threads_.reserve(thread_count);
+  for (std::size_t i = 0; i < thread_count; ++i) {
+    threads_.emplace_back([this]() {
+      setThreadName("FileHashQueue");
+      work();
+    });
+  }
+}
+
+FileHashQueue::~FileHashQueue() {
+  stop();
+}
+
+void FileHashQueue::add(EventID eid,
+                        const std::string& key,
+                        const std::string& path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = jobs_.find(key);
+  if (it != jobs_.end()) {
+    // The file is hashed once the window of its first event closes.
+    it->second.path = path;
+    it->second.eids.push_back(eid);
+    return;
+  }
+
+  auto& job = jobs_[key];
+  job.path = path;
+  job.eids.push_back(eid);
+  job.deadline = std::chrono::steady_clock::now() + window_;
+  order_.push_back(key);
+
+  cv_.notify_one();
+}
+
+bool FileHashQueue::full() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return jobs_.size() >= kMaxPendingFiles;
+}
+
+bool FileHashQueue::join(Row& row) const {
+  auto hashed = row.find("hashed");
+  auto eid = row.find("eid");
+  if (hashed == row.end() || hashed->second != kFileHashPending ||
+      eid == row.end()) {
+    return false;
+  }
+
+  auto event_id = tryTo<EventID>(eid->second);
+  if (event_id.isError()) {
+    return false;
+  }
+
+  std::shared_ptr<const MultiHashes> hashes;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto digest = digests_.find(event_id.get());
+    if (digest == digests_.end()) {
+      return false;
+    }
+    hashes = digest->second;
+  }
+
+  setFileEventHashes(*hashes, row);
+  return true;
+}
+
+void FileHashQueue::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      return;
+    }
+    stopping_ = true;
+  }
+  cv_.notify_all();
+
+  for (auto& thread : threads_) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+  threads_.clear();
+}
+
+std::size_t FileHashQueue::pending() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return jobs_.size();
+}
+
+void FileHashQueue::work() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    if (order_.empty()) {
+      cv_.wait(lock);
+      continue;
+    }
+
+    auto deadline = jobs_.at(order_.front()).deadline;
+    if (std::chrono::steady_clock::now() < deadline) {
+      cv_.wait_until(lock, deadline);
+      continue;
+    }
+
+    // Later events for the file start a new window while this one hashes.
+    auto key = std::move(order_.front());
+    order_.pop_front();
+    auto job = std::move(jobs_.at(key));
+    jobs_.erase(key);
+
+    lock.unlock();
+    auto hashes = std::make_shared<const MultiHashes>(
+        hashMultiFromFile(getFileEventHashMask(), job.path));
+    lock.lock();
+
+    store(job, std::move(hashes));
+  }
+}
+
+void FileHashQueue::store(const Job& job,
+                          std::shared_ptr<const MultiHashes> hashes) {
+  for (const auto& eid : job.eids) {
+    digests_[eid] = hashes;
+  }
+
+  while (digests_.size() > max_digests_) {
+    digests_.erase(digests_.begin());
+  }
+}
+
+} // namespace osquery
@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core/sql/row.h>
+#include <osquery/events/types.h>
+#include <osquery/hashing/hashing.h>
+
+namespace osquery {
+
+/// The hashed column value of an event whose file is still being hashed.
+extern const std::string kFileHashPending;
+
+/**
+ * @brief Hash the targets of file events on background threads.
+ *
+ * Events are stored before their file is hashed, with a pending hashed
+ * column. Events for the same file within a window share one hash, which is
+ * read once the window closes, so a burst of writes to a large file is only
+ * hashed once. The digests are kept by event id and joined to the rows
+ * when the events are queried.
+ */
+class FileHashQueue : private boost::noncopyable {
+ public:
+  /**
+   * @brief Start the hashing threads.
+   *
+   * @param thread_count The number of files hashed at the same time.
+   * @param window How long events for one file are coalesced.
+   * @param max_digests The number of digests kept for queries, oldest
+   * events are forgotten first.
+   */
+  FileHashQueue(std::size_t thread_count,
+                std::chrono::milliseconds window,
+                std::size_t max_digests);
+
+  /// Stops the hashing threads, see stop.
+  ~FileHashQueue();
+
+  /**
+   * @brief Queue the hash of the file of a stored event.
+   *
+   * @param eid The identifier of the stored event.
+   * @param key Identifies the file, usually its inode.
+   * @param path The path of the file.
+   */
+  void add(EventID eid, const std::string& key, const std::string& path);
+
+  /// Too many files are waiting, callers should hash new events themselves.
+  bool full() const;
+
+  /**
+   * @brief Add the digest of a stored event to its row.
+   *
+   * Only rows with a pending hashed column are changed.
+   *
+   * @return true if the row now holds the digest.
+   */
+  bool join(Row& row) const;
+
+  /// Stop the hashing threads, the files waiting are not hashed.
+  void stop();
+
+  /// The number of files waiting to be hashed.
+  std::size_t pending() const;
+
+ private:
+  struct Job final {
+    std::string path;
+    std::vector<EventID> eids;
+    std::chrono::steady_clock::time_point deadline;
+  };
+
+  /// The hashing thread loop.
+  void work();
+
+  /// Keep the digest of the events of a job.
+  void store(const Job& job, std::shared_ptr<const MultiHashes> hashes);
+
+ private:
+  const std::chrono::milliseconds window_;
+
+  const std::size_t max_digests_;
+
+  /// Files waiting for their window to close, by key.
+  std::map<std::string, Job> jobs_;
+
+  /// Keys in the order their window closes.
+  std::deque<std::string> order_;
+
+  /// Digests of hashed events, events of one job share the digest.
+  std::map<EventID, std::shared_ptr<const MultiHashes>> digests_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+
+  std::atomic<bool> stopping_{false};
+
+  std::vector<std::thread> threads_;
+};
+
+} // namespace osquery
@@ -7,6 +7,7 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <osquery/events/linux/process_changes.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/sql/sql.h>
@@ -23,11 +24,19 @@ Status BPFProcessEventSubscriber::init() {
   auto subscription_context = createSubscriptionContext();
   subscribe(&BPFProcessEventSubscriber::eventCallback, subscription_context);
 
+  ProcessChanges::get().setTracked(true);
   return Status::success();
 }
 
 Status BPFProcessEventSubscriber::eventCallback(const ECRef& event_context,
                                                 const SCRef&) {
+  for (const auto& event : event_context->event_list) {
+    if (event.type == ISystemStateTracker::Event::Type::Exec) {
+      ProcessChanges::get().changed(
+          static_cast<std::uint64_t>(event.bpf_header.process_id));
+    }
+  }
+
   auto row_list = generateRowList(event_context->event_list);
   addBatch(row_list);
 
@@ -0,0 +1,107 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <sys/stat.h>
+
+#include <chrono>
+
+#include <osquery/core/flags.h>
+#include <osquery/core/tables.h>
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/logger/logger.h>
+#include <osquery/tables/events/linux/exec_file_stat.h>
+#include <osquery/utils/caches/sharded.h>
+
+namespace osquery {
+
+FLAG(uint64,
+     process_events_stat_cache_ttl,
+     60,
+     "Seconds the mode and times of an executed binary are reused by process "
+     "events (0 = disabled)");
+
+namespace {
+
+/// The most binaries kept.
+const size_t kExecutedFileCacheSize{4096};
+
+struct ExecutedFileStat {
+  /// False if the binary could not be stat'ed.
+  bool valid{false};
+
+  std::string mode;
+  std::string atime;
+  std::string mtime;
+  std::string ctime;
+
+  std::chrono::steady_clock::time_point time;
+};
+
+caches::ShardedCache<std::string, ExecutedFileStat>& getExecutedFileCache() {
+  static caches::ShardedCache<std::string, ExecutedFileStat> cache(
+      kExecutedFileCacheSize);
+  return cache;
+}
+
+ExecutedFileStat statExecutedFile(const std::string& path) {
+  ExecutedFileStat result;
+  result.time = std::chrono::steady_clock::now();
+
+  struct stat file_stat;
+  if (::stat(path.c_str(), &file_stat) == 0) {
+    result.valid = true;
+    result.mode = lsperms(file_stat.st_mode);
+    result.atime = BIGINT(file_stat.st_atime);
+    result.mtime = BIGINT(file_stat.st_mtime);
+    result.ctime = BIGINT(file_stat.st_ctime);
+  }
+  return result;
+}
+
+} // namespace
+
+void decorateExecutedFile(const std::string& path, Row& r) {
+  auto ttl = std::chrono::seconds(FLAGS_process_events_stat_cache_ttl);
+
+  boost::optional<ExecutedFileStat> cached;
+  if (ttl.count() > 0) {
+    cached = getExecutedFileCache().get(path);
+    if (cached && std::chrono::steady_clock::now() - cached->time >= ttl) {
+      cached = boost::none;
+    }
+  }
+
+  if (!cached) {
+    cached = statExecutedFile(path);
+    if (ttl.count() > 0) {
+      getExecutedFileCache().insert(path, *cached);
+    }
+  }
+
+  if (cached->valid) {
+    if (r["mode"].empty()) {
+      r["mode"] = cached->mode;
+    }
+    r["btime"] = "0";
+    r["atime"] = cached->atime;
+    r["mtime"] = cached->mtime;
+    r["ctime"] = cached->ctime;
+  } else {
+    VLOG(1) << "Failed to stat path: " << path;
+    r["ctime"] = "0";
+    r["atime"] = "0";
+    r["mtime"] = "0";
+  }
+}
+
+void clearExecutedFileCache() {
+  getExecutedFileCache().clear();
+}
+
+} // namespace osquery
@@ -0,0 +1,33 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <string>
+
+#include <osquery/core/sql/row.h>
+
+namespace osquery {
+
+/**
+ * @brief Set the mode and time columns of the binary of a process event.
+ *
+ * Busy hosts execute the same few binaries over and over, so the results of
+ * stat are kept by path for process_events_stat_cache_ttl seconds, in a
+ * cache shared by the process event subscribers. A binary changed within
+ * that time reports its previous times.
+ *
+ * The mode column is only set if empty, the audit records usually carry it.
+ */
+void decorateExecutedFile(const std::string& path, Row& r);
+
+/// Drop the kept results of every binary.
+void clearExecutedFileCache();
+
+} // namespace osquery
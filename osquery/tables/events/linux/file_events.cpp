@@ -7,19 +7,46 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <chrono>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include <osquery/config/config.h>
+#include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
+#include <osquery/events/eventfactory.h>
 #include <osquery/events/eventsubscriber.h>
 #include <osquery/events/linux/inotify.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/tables/events/event_utils.h>
+#include <osquery/tables/events/file_hash_queue.h>
+#include <osquery/utils/conversions/tryto.h>
 
 namespace osquery {
 
+DECLARE_bool(enable_fanotify_events);
+
+FLAG(uint32,
+     file_events_hash_threads,
+     0,
+     "Threads hashing file_events targets after the events are stored, 0 "
+     "hashes within the event callback (default 0). Rows queried before "
+     "their file is hashed are returned with hashed=2 and no digests");
+
+FLAG(uint32,
+     file_events_hash_window,
+     1000,
+     "Milliseconds during which events for the same file share one hash");
+
+namespace {
+
+/// Digests kept for the stored events, about twice the default batch size.
+const std::size_t kMaxFileEventDigests{100000};
+
+} // namespace
+
 /**
  * @brief Track time, action changes to /etc/passwd
  *
@@ -28,21 +55,53 @@ namespace osquery {
 class FileEventSubscriber : public EventSubscriber<INotifyEventPublisher> {
  public:
   Status init() override {
+    if (FLAGS_file_events_hash_threads > 0) {
+      hash_queue_ = std::make_unique<FileHashQueue>(
+          FLAGS_file_events_hash_threads,
+          std::chrono::milliseconds(FLAGS_file_events_hash_window),
+          kMaxFileEventDigests);
+    }
     return Status(0);
   }
 
+  /// Subscribe to the fanotify publisher when it replaces inotify.
+  const std::string& getType() const override {
+    static const std::string kFanotifyType{"fanotify"};
+    if (FLAGS_enable_fanotify_events) {
+      return kFanotifyType;
+    }
+    return EventSubscriber::getType();
+  }
+
   /// Walk the configuration's file paths, create subscriptions.
   void configure() override;
 
   /**
    * @brief This exports a single Callback for INotifyEventPublisher events.
    *
-   * @param ec The EventCallback type receives an EventContextRef substruct
-   * for the INotifyEventPublisher declared in this EventSubscriber subclass.
+   * @param ec_list The events read together by the INotifyEventPublisher
+   * that match the subscription.
    *
    * @return Was the callback successful.
    */
-  Status Callback(const ECRef& ec, const SCRef& sc);
+  Status Callback(const std::vector<ECRef>& ec_list, const SCRef& sc);
+
+  /// Queries commonly select the events below a path.
+  std::set<std::string> indexedColumns() const override {
+    return {"target_path"};
+  }
+
+ protected:
+  /// Add the digests computed by the hash queue.
+  void joinEventRow(Row& row) const override {
+    if (hash_queue_ != nullptr) {
+      hash_queue_->join(row);
+    }
+  }
+
+ private:
+  /// Hashes files in the background, nullptr when hashing in the callback.
+  std::unique_ptr<FileHashQueue> hash_queue_;
 };
 
 /**
@@ -98,34 +157,73 @@ void FileEventSubscriber::configure() {
         }
       }
       sc->category = category;
-      subscribe(&FileEventSubscriber::Callback, sc);
+      subscribeBatch(&FileEventSubscriber::Callback, sc);
     }
   });
 }
 
-Status FileEventSubscriber::Callback(const ECRef& ec, const SCRef& sc) {
-  if (ec->action.empty()) {
-    return Status(0);
-  }
+Status FileEventSubscriber::Callback(const std::vector<ECRef>& ec_list,
+                                     const SCRef& sc) {
+  // Forwarded events are logged when stored, they are hashed right away.
+  auto defer_hashes = hash_queue_ != nullptr &&
+                      !EventFactory::forwardsEvents() && !hash_queue_->full();
+
+  std::vector<Row> rows;
+  std::vector<std::size_t> hashed_rows;
+  rows.reserve(ec_list.size());
+  for (const auto& ec : ec_list) {
+    if (ec->action.empty()) {
+      continue;
+    }
+
+    Row r;
+    r["action"] = ec->action;
+    r["target_path"] = ec->path;
+    r["category"] = sc->category;
+    r["transaction_id"] = INTEGER(ec->event->cookie);
 
-  Row r;
-  r["action"] = ec->action;
-  r["target_path"] = ec->path;
-  r["category"] = sc->category;
-  r["transaction_id"] = INTEGER(ec->event->cookie);
-
-  if ((sc->mask & kFileAccessMasks) != kFileAccessMasks) {
-    // Add hashing and 'join' against the file table for stat-information.
-    decorateFileEvent(
-        ec->path, (ec->action == "CREATED" || ec->action == "UPDATED"), r);
-  } else {
-    // The access event on Linux would generate additional events if hashed.
-    decorateFileEvent(ec->path, false, r);
+    if ((sc->mask & kFileAccessMasks) != kFileAccessMasks) {
+      // Add hashing and 'join' against the file table for stat-information.
+      auto hash = (ec->action == "CREATED" || ec->action == "UPDATED") &&
+                  getFileEventHashMask() != 0;
+      decorateFileEvent(ec->path, hash && !defer_hashes, r);
+      if (hash && defer_hashes) {
+        r["hashed"] = kFileHashPending;
+        hashed_rows.push_back(rows.size());
+      }
+    } else {
+      // The access event on Linux would generate additional events if hashed.
+      decorateFileEvent(ec->path, false, r);
+    }
+    rows.push_back(std::move(r));
   }
 
   // A callback is somewhat useless unless it changes the EventSubscriber
-  // state or calls `add` to store a marked up event.
-  add(r);
+  // state or calls `addBatch` to store the marked up events.
+  if (rows.empty()) {
+    return Status::success();
+  }
+
+  auto status = addBatch(rows);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // The stored events have an identifier, their digests are joined by it.
+  for (auto index : hashed_rows) {
+    const auto& r = rows[index];
+    auto eid = tryTo<EventID>(r.at("eid"));
+    if (eid.isError()) {
+      continue;
+    }
+
+    // Events for one inode within the window share a single hash.
+    auto inode = r.find("inode");
+    const auto& key = (inode != r.end() && !inode->second.empty())
+                          ? inode->second
+                          : r.at("target_path");
+    hash_queue_->add(eid.get(), key, r.at("target_path"));
+  }
   return Status::success();
 }
 } // namespace osquery
@@ -8,15 +8,16 @@
  */
 
 #include <osquery/core/flags.h>
+#include <osquery/events/linux/process_changes.h>
 #include <osquery/events/linux/process_events.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
+#include <osquery/tables/events/linux/exec_file_stat.h>
 #include <osquery/tables/events/linux/process_events.h>
+#include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/system/uptime.h>
 
-#include <sys/stat.h>
-
 namespace osquery {
 namespace {
 const std::unordered_map<int, std::string> kSyscallNameMap = {
@@ -57,9 +58,14 @@ Status AuditProcessEventSubscriber::init() {
   auto sc = createSubscriptionContext();
   subscribe(&AuditProcessEventSubscriber::Callback, sc);
 
+  ProcessChanges::get().setTracked(true);
   return Status::success();
 }
 
+std::set<std::string> AuditProcessEventSubscriber::indexedColumns() const {
+  return {"pid"};
+}
+
 Status AuditProcessEventSubscriber::Callback(const ECRef& ec, const SCRef& sc) {
   std::vector<Row> emitted_row_list;
   auto status = ProcessEvents(emitted_row_list, ec->audit_events);
@@ -68,21 +74,14 @@ Status AuditProcessEventSubscriber::Callback(const ECRef& ec, const SCRef& sc) {
   }
 
   for (auto& row : emitted_row_list) {
-    struct stat file_stat;
-    if (!stat(row.at("path").c_str(), &file_stat)) {
-      if (row["mode"].empty()) {
-        row["mode"] = lsperms(file_stat.st_mode);
+    if (row["syscall"] == "execve" || row["syscall"] == "execveat") {
+      auto pid = tryTo<std::uint64_t>(row["pid"]);
+      if (pid.isValue()) {
+        ProcessChanges::get().changed(pid.get());
       }
-      row["btime"] = "0";
-      row["atime"] = BIGINT(file_stat.st_atime);
-      row["mtime"] = BIGINT(file_stat.st_mtime);
-      row["ctime"] = BIGINT(file_stat.st_ctime);
-    } else {
-      VLOG(1) << "Failed to stat path: " << row.at("path");
-      row["ctime"] = "0";
-      row["atime"] = "0";
-      row["mtime"] = "0";
     }
+
+    decorateExecutedFile(row.at("path"), row);
   }
 
   addBatch(emitted_row_list);
@@ -285,7 +284,7 @@ Status AuditProcessEventSubscriber::ProcessExecveEventData(
       row["cmdline"] += ' ';
     }
 
-    row["cmdline"] += DecodeAuditPathValues(arg.second);
+    row["cmdline"] += DecodeAuditPathValues(std::string(arg.second));
   }
 
   row["cmdline_size"] = std::to_string(row["cmdline"].size());
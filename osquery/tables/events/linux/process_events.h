@@ -23,6 +23,9 @@ class AuditProcessEventSubscriber final
   /// Kernel events matching the event type will fire.
   Status Callback(const ECRef& ec, const SCRef& sc);
 
+  /// Queries commonly select the events of one process.
+  std::set<std::string> indexedColumns() const override;
+
   /// Processes the updates received from the callback
   static Status ProcessEvents(
       std::vector<Row>& emitted_row_list,
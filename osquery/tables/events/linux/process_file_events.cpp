@@ -22,6 +22,7 @@
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/tables/events/linux/process_file_events.h>
+#include <osquery/utils/system/time.h>
 #include <osquery/utils/system/uptime.h>
 
 namespace boostfs = boost::filesystem;
@@ -52,6 +53,17 @@ HIDDEN_FLAG(bool,
             false,
             "Show debug messages for the FIM table");
 
+FLAG(uint64,
+     audit_fim_aggregate_window,
+     0,
+     "Seconds during which identical file events are stored as one row, 0 "
+     "stores every event");
+
+FLAG(string,
+     audit_fim_aggregate_key,
+     "pid,operation,path",
+     "Comma-separated columns that identify identical file events");
+
 REGISTER(ProcessFileEventSubscriber, "event_subscriber", "process_file_events");
 
 namespace {
@@ -1172,6 +1184,9 @@ Status ProcessFileEventSubscriber::init() {
     return Status(1, "Subscriber disabled via configuration");
   }
 
+  aggregator_.configure(FLAGS_audit_fim_aggregate_window,
+                        FLAGS_audit_fim_aggregate_key);
+
   auto sc = createSubscriptionContext();
   subscribe(&ProcessFileEventSubscriber::Callback, sc);
 
@@ -1204,10 +1219,23 @@ Status ProcessFileEventSubscriber::Callback(const ECRef& event_context,
   auto exit_status =
       ProcessEvents(emitted_row_list, context_, event_context->audit_events);
 
-  addBatch(emitted_row_list);
+  auto row_list = aggregator_.add(std::move(emitted_row_list), getUnixTime());
+  if (!row_list.empty()) {
+    addBatch(row_list);
+  }
   return exit_status;
 }
 
+void ProcessFileEventSubscriber::genTable(RowYield& yield,
+                                          QueryContext& context) {
+  auto row_list = aggregator_.flush(getUnixTime());
+  if (!row_list.empty()) {
+    addBatch(row_list);
+  }
+
+  EventSubscriber::genTable(yield, context);
+}
+
 Status ProcessFileEventSubscriber::ProcessEvents(
     std::vector<Row>& emitted_row_list,
     AuditdFimContext& fim_context,
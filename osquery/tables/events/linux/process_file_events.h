@@ -18,6 +18,7 @@
 
 #include <boost/variant.hpp>
 
+#include <osquery/events/eventaggregator.h>
 #include <osquery/events/eventsubscriber.h>
 #include <osquery/events/linux/auditeventpublisher.h>
 
@@ -292,6 +293,9 @@ class ProcessFileEventSubscriber final
   Status Callback(const ECRef& event_context,
                   const SCRef& subscription_context);
 
+  /// Store the aggregated events whose window closed, then read the events.
+  void genTable(RowYield& yield, QueryContext& context) override;
+
   /// Processes the given events, updating the tracing context
   static Status ProcessEvents(
       std::vector<Row>& emitted_row_list,
@@ -304,5 +308,8 @@ class ProcessFileEventSubscriber final
  private:
   /// This structure holds information like handle and inode maps
   AuditdFimContext context_;
+
+  /// Groups identical events when an aggregation window is configured.
+  EventAggregator aggregator_;
 };
 } // namespace osquery
@@ -17,6 +17,7 @@
 #include <osquery/registry/registry_factory.h>
 #include <osquery/tables/events/linux/socket_events.h>
 #include <osquery/utils/conversions/tryto.h>
+#include <osquery/utils/system/time.h>
 #include <osquery/utils/system/uptime.h>
 
 namespace osquery {
@@ -39,6 +40,17 @@ FLAG(bool,
      false,
      "Allow non-blocking accept() syscalls that returned EAGAIN/EWOULDBLOCK");
 
+FLAG(uint64,
+     audit_socket_aggregate_window,
+     0,
+     "Seconds during which identical socket events are stored as one row, 0 "
+     "stores every event");
+
+FLAG(string,
+     audit_socket_aggregate_key,
+     "pid,action,remote_address,remote_port",
+     "Comma-separated columns that identify identical socket events");
+
 std::string ip4FromSaddr(const std::string& saddr, ushort offset) {
   long const result = tryTo<long>(saddr.substr(offset, 8), 16).takeOr(0l);
   return std::to_string((result & 0xff000000) >> 24) + '.' +
@@ -115,6 +127,9 @@ Status SocketEventSubscriber::init() {
     return Status(1, "Subscriber disabled via configuration");
   }
 
+  aggregator_.configure(FLAGS_audit_socket_aggregate_window,
+                        FLAGS_audit_socket_aggregate_key);
+
   auto sc = createSubscriptionContext();
   subscribe(&SocketEventSubscriber::Callback, sc);
 
@@ -133,10 +148,22 @@ Status SocketEventSubscriber::Callback(const ECRef& ec, const SCRef& sc) {
     return status;
   }
 
-  addBatch(emitted_row_list);
+  auto row_list = aggregator_.add(std::move(emitted_row_list), getUnixTime());
+  if (!row_list.empty()) {
+    addBatch(row_list);
+  }
   return Status::success();
 }
 
+void SocketEventSubscriber::genTable(RowYield& yield, QueryContext& context) {
+  auto row_list = aggregator_.flush(getUnixTime());
+  if (!row_list.empty()) {
+    addBatch(row_list);
+  }
+
+  EventSubscriber::genTable(yield, context);
+}
+
 Status SocketEventSubscriber::ProcessEvents(
     std::vector<Row>& emitted_row_list,
     const std::vector<AuditEvent>& event_list,
@@ -296,8 +323,9 @@ Status SocketEventSubscriber::ProcessEvents(
     CopyFieldFromMap(row, syscall_event_record->fields, "pid");
     GetStringFieldFromMap(row["fd"], syscall_event_record->fields, "a0");
 
-    row["path"] = DecodeAuditPathValues(syscall_event_record->fields.at("exe"));
-    row["fd"] = syscall_event_record->fields.at("a0");
+    row["path"] = DecodeAuditPathValues(
+        std::string(syscall_event_record->fields.at("exe")));
+    row["fd"] = std::string(syscall_event_record->fields.at("a0"));
     row["uptime"] = std::to_string(getUptime());
 
     // Set some sane defaults and then attempt to parse the sockaddr value
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <osquery/events/eventaggregator.h>
 #include <osquery/events/eventsubscriber.h>
 #include <osquery/events/linux/auditeventpublisher.h>
 
@@ -23,6 +24,9 @@ class SocketEventSubscriber final
   /// Kernel events matching the event type will fire.
   Status Callback(const ECRef& ec, const SCRef& sc);
 
+  /// Store the aggregated events whose window closed, then read the events.
+  void genTable(RowYield& yield, QueryContext& context) override;
+
   /// Processes the updates received from the callback
   static Status ProcessEvents(std::vector<Row>& emitted_row_list,
                               const std::vector<AuditEvent>& event_list,
@@ -38,6 +42,10 @@ class SocketEventSubscriber final
   static bool parseSockAddr(const std::string& saddr,
                             Row& row,
                             bool& unix_socket);
+
+ private:
+  /// Groups identical events when an aggregation window is configured.
+  EventAggregator aggregator_;
 };
 
 } // namespace osquery
@@ -8,6 +8,7 @@
  */
 
 #include <string>
+#include <vector>
 
 #include <osquery/config/config.h>
 #include <osquery/core/flags.h>
@@ -33,7 +34,7 @@ class SyslogEventSubscriber : public EventSubscriber<SyslogEventPublisher> {
   // Implement the pure virtual init interface.
   Status init() override {
     SyslogSubscriptionContextRef sc = createSubscriptionContext();
-    subscribe(&SyslogEventSubscriber::Callback, sc);
+    subscribeBatch(&SyslogEventSubscriber::Callback, sc);
     return Status::success();
   }
 
@@ -45,14 +46,18 @@ class SyslogEventSubscriber : public EventSubscriber<SyslogEventPublisher> {
     return FLAGS_syslog_events_max;
   }
 
-  Status Callback(const ECRef& ec, const SCRef& sc);
+  Status Callback(const std::vector<ECRef>& ec_list, const SCRef& sc);
 };
 
 REGISTER(SyslogEventSubscriber, "event_subscriber", "syslog_events");
 
-Status SyslogEventSubscriber::Callback(const ECRef& ec, const SCRef& sc) {
-  Row r(ec->fields);
-  add(r);
-  return Status::success();
+Status SyslogEventSubscriber::Callback(const std::vector<ECRef>& ec_list,
+                                       const SCRef& sc) {
+  std::vector<Row> rows;
+  rows.reserve(ec_list.size());
+  for (const auto& ec : ec_list) {
+    rows.emplace_back(ec->fields);
+  }
+  return addBatch(rows);
 }
 }
@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <chrono>
+#include <thread>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <gtest/gtest.h>
+
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/tables/events/file_hash_queue.h>
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+namespace {
+
+/// The MD5 of "hello".
+const std::string kHelloMD5{"5d41402abc4b2a76b9719d911017c592"};
+
+Row pendingRow(const std::string& eid) {
+  return {{"eid", eid}, {"hashed", kFileHashPending}};
+}
+
+/// Wait for the queue to hash every file.
+bool waitForHashes(const FileHashQueue& queue, const Row& row) {
+  for (std::size_t i = 0; i < 200; ++i) {
+    auto copy = row;
+    if (queue.pending() == 0 && queue.join(copy)) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+} // namespace
+
+class FileHashQueueTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    root_ = fs::temp_directory_path() /
+            fs::unique_path("osquery.tests.%%%%.%%%%");
+    fs::create_directories(root_);
+    path_ = (root_ / "file").string();
+  }
+
+  void TearDown() override {
+    fs::remove_all(root_);
+  }
+
+ protected:
+  fs::path root_;
+  std::string path_;
+};
+
+TEST_F(FileHashQueueTests, test_events_share_one_hash) {
+  ASSERT_TRUE(writeTextFile(path_, "first").ok());
+
+  FileHashQueue queue(1, std::chrono::milliseconds(200), 16);
+  queue.add(1, "42", path_);
+
+  // The file is read once the window closes, after the last write.
+  ASSERT_TRUE(writeTextFile(path_, "hello").ok());
+  queue.add(2, "42", path_);
+  EXPECT_EQ(queue.pending(), 1U);
+
+  auto first = pendingRow("0000000001");
+  ASSERT_TRUE(waitForHashes(queue, first));
+
+  EXPECT_TRUE(queue.join(first));
+  EXPECT_EQ(first["md5"], kHelloMD5);
+  EXPECT_EQ(first["hashed"], "1");
+
+  auto second = pendingRow("0000000002");
+  EXPECT_TRUE(queue.join(second));
+  EXPECT_EQ(second["md5"], kHelloMD5);
+
+  // Rows that were hashed when stored are left unchanged.
+  Row hashed = {{"eid", "0000000001"}, {"hashed", "1"}, {"md5", "stored"}};
+  EXPECT_FALSE(queue.join(hashed));
+  EXPECT_EQ(hashed["md5"], "stored");
+}
+
+TEST_F(FileHashQueueTests, test_missing_file_and_digest_limit) {
+  FileHashQueue queue(2, std::chrono::milliseconds(0), 2);
+  queue.add(1, "1", (root_ / "missing").string());
+  queue.add(2, "2", (root_ / "missing").string());
+  queue.add(3, "3", (root_ / "missing").string());
+
+  auto last = pendingRow("0000000003");
+  ASSERT_TRUE(waitForHashes(queue, last));
+  EXPECT_TRUE(queue.join(last));
+  EXPECT_EQ(last["hashed"], "-1");
+
+  // Only the digests of the newest events are kept.
+  auto oldest = pendingRow("0000000001");
+  EXPECT_FALSE(queue.join(oldest));
+  EXPECT_EQ(oldest["hashed"], kFileHashPending);
+}
+
+} // namespace osquery
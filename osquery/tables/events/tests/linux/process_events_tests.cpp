@@ -7,18 +7,29 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <utime.h>
+
 #include <iostream>
 #include <map>
 #include <set>
 #include <string>
 
+#include <boost/filesystem.hpp>
+
 #include <gtest/gtest.h>
 
 #include <osquery/core/flags.h>
 #include <osquery/events/linux/process_events.h>
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/tables/events/linux/exec_file_stat.h>
 #include <osquery/tables/events/linux/process_events.h>
 
+namespace fs = boost::filesystem;
+
 namespace osquery {
+
+DECLARE_uint64(process_events_stat_cache_ttl);
+
 namespace {
 using RawAuditEvent = const std::vector<std::pair<int, std::string>>;
 
@@ -394,4 +405,48 @@ TEST_F(ProcessEventsTests, process_id_acquisition) {
   EXPECT_EQ(parent_process_id, 0U);
   EXPECT_EQ(process_id, 0U);
 }
+
+TEST_F(ProcessEventsTests, executed_file_cache) {
+  auto path = fs::temp_directory_path() /
+              fs::unique_path("osquery.exec_file_stat.%%%%.%%%%");
+  ASSERT_TRUE(writeTextFile(path, "#!/bin/sh\n").ok());
+
+  auto setModified = [&path](time_t mtime) {
+    struct utimbuf times = {mtime, mtime};
+    ASSERT_EQ(::utime(path.string().c_str(), &times), 0);
+  };
+
+  auto ttl = FLAGS_process_events_stat_cache_ttl;
+  FLAGS_process_events_stat_cache_ttl = 3600;
+  clearExecutedFileCache();
+
+  setModified(1000);
+  Row row;
+  decorateExecutedFile(path.string(), row);
+  EXPECT_EQ(row["mtime"], "1000");
+  EXPECT_FALSE(row["mode"].empty());
+
+  // Later executions reuse the kept results, and keep an audited mode.
+  setModified(2000);
+  row = {{"mode", "0100755"}};
+  decorateExecutedFile(path.string(), row);
+  EXPECT_EQ(row["mtime"], "1000");
+  EXPECT_EQ(row["mode"], "0100755");
+
+  clearExecutedFileCache();
+  decorateExecutedFile(path.string(), row);
+  EXPECT_EQ(row["mtime"], "2000");
+
+  FLAGS_process_events_stat_cache_ttl = 0;
+  setModified(3000);
+  decorateExecutedFile(path.string(), row);
+  EXPECT_EQ(row["mtime"], "3000");
+
+  fs::remove(path);
+  decorateExecutedFile(path.string(), row);
+  EXPECT_EQ(row["mtime"], "0");
+
+  clearExecutedFileCache();
+  FLAGS_process_events_stat_cache_ttl = ttl;
+}
 } // namespace osquery
@@ -18,6 +18,7 @@
 #include <osquery/core/system.h>
 #include <osquery/database/database.h>
 #include <osquery/events/events.h>
+#include <osquery/events/windows/etw/etw_post_processing_pipeline.h>
 #include <osquery/events/windows/etw/etw_publisher_processes.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry.h>
@@ -196,4 +197,98 @@ TEST_F(ETWProcessEventsTests, test_concurrent_queue_timeout) {
       << "Events produced: " << totalEventsProduced
       << " - Events consumed: " << totalEventsConsumed;
 }
+
+TEST_F(ETWProcessEventsTests, test_bounded_concurrent_queue) {
+  BoundedConcurrentQueue<unsigned int> testQueue(5);
+  EXPECT_EQ(testQueue.capacity(), 8U);
+
+  // Elements are refused when the queue is full
+  for (unsigned int i = 0; i < 8; ++i) {
+    EXPECT_TRUE(testQueue.tryPush(i));
+  }
+  EXPECT_FALSE(testQueue.tryPush(8));
+  EXPECT_EQ(testQueue.size(), 8U);
+
+  unsigned int value = 0;
+  EXPECT_TRUE(testQueue.tryPop(value));
+  EXPECT_EQ(value, 0U);
+  EXPECT_TRUE(testQueue.tryPush(8));
+  for (unsigned int i = 1; i <= 8; ++i) {
+    EXPECT_TRUE(testQueue.popWait(value, 10));
+    EXPECT_EQ(value, i);
+  }
+  EXPECT_FALSE(testQueue.popWait(value, 10));
+  EXPECT_TRUE(testQueue.empty());
+}
+
+TEST_F(ETWProcessEventsTests, test_bounded_concurrent_queue_threads) {
+  BoundedConcurrentQueue<unsigned int> testQueue(1024);
+  const unsigned int kProducers = 8;
+  const unsigned int kEventsPerProducer = 10000;
+
+  std::atomic<unsigned long long> totalEventsProduced = 0;
+  std::atomic<unsigned long long> totalEventsDropped = 0;
+  std::atomic<unsigned long long> totalEventsConsumed = 0;
+  std::atomic<unsigned int> nrOfThreadsProducing = kProducers;
+
+  std::vector<std::thread> producerThreads;
+  for (unsigned int i = 0; i < kProducers; ++i) {
+    producerThreads.push_back(std::thread([&]() {
+      for (unsigned int it = 0; it < kEventsPerProducer; ++it) {
+        if (testQueue.tryPush(it)) {
+          totalEventsProduced++;
+        } else {
+          totalEventsDropped++;
+        }
+      }
+      nrOfThreadsProducing--;
+    }));
+  }
+
+  std::vector<std::thread> consumerThreads;
+  for (unsigned int i = 0; i < 2; ++i) {
+    consumerThreads.push_back(std::thread([&]() {
+      while (!testQueue.empty() || nrOfThreadsProducing != 0) {
+        unsigned int value = 0;
+        if (testQueue.popWait(value, 10)) {
+          totalEventsConsumed++;
+        }
+      }
+    }));
+  }
+
+  for (auto& producerThread : producerThreads) {
+    producerThread.join();
+  }
+  for (auto& consumerThread : consumerThreads) {
+    consumerThread.join();
+  }
+
+  EXPECT_EQ(totalEventsProduced + totalEventsDropped,
+            kProducers * kEventsPerProducer);
+  EXPECT_EQ(totalEventsProduced, totalEventsConsumed);
+}
+
+TEST_F(ETWProcessEventsTests, test_pipeline_counters) {
+  EtwPipelineCounters counters;
+  counters.recordProcessed(EtwEventType::ProcessStart, 100);
+  counters.recordProcessed(EtwEventType::ProcessStart, 300);
+  counters.recordDropped(EtwEventType::ProcessStop);
+
+  auto stats = counters.getStats();
+  EXPECT_EQ(stats[EtwEventType::ProcessStart].processed, 2U);
+  EXPECT_EQ(stats[EtwEventType::ProcessStart].total_latency_us, 400U);
+  EXPECT_EQ(stats[EtwEventType::ProcessStart].max_latency_us, 300U);
+  EXPECT_EQ(stats[EtwEventType::ProcessStop].dropped, 1U);
+  EXPECT_EQ(stats[EtwEventType::ProcessStop].processed, 0U);
+
+  // Events are sharded by the process they describe
+  EtwEventData data;
+  data.Header.RawHeader.ProcessId = 4;
+  EXPECT_EQ(getEtwEventProcessId(data), 4U);
+  auto startData = std::make_shared<EtwProcessStartData>();
+  startData->ProcessId = 1234;
+  data.Payload = startData;
+  EXPECT_EQ(getEtwEventProcessId(data), 1234U);
+}
 } // namespace osquery
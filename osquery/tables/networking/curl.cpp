@@ -14,31 +14,44 @@
 #include <osquery/remote/transports/tls.h>
 // clang-format on
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <thread>
+#include <vector>
 
 #include <boost/numeric/conversion/cast.hpp>
 
+#include <osquery/core/flags.h>
 #include <osquery/logger/logger.h>
 #include <osquery/utils/status/status.h>
 #include <osquery/core/tables.h>
 
 namespace osquery {
+
+FLAG(uint32,
+     curl_concurrent_requests,
+     8,
+     "Number of requests the curl table sends at the same time");
+
 namespace tables {
 
 const std::string kOsqueryUserAgent{"osquery"};
 
-Status processRequest(Row& r) {
+Status processRequest(Row& r, const http::Client::Options& options) {
   try {
-    osquery::http::Client client(TLSTransport().getOptions());
     osquery::http::Response response;
     osquery::http::Request request(r["url"]);
 
     // Change the user-agent for the request to be osquery
     request << osquery::http::Request::Header("User-Agent", r["user_agent"]);
 
+    // A connection left open by a previous request to the host is reused.
+    auto client = http::ClientPool::get().acquire(request, options);
+
     // Measure the rtt using the system clock
     auto time_start = std::chrono::system_clock::now();
-    response = client.get(request);
+    response = client->get(request);
     auto time_end = std::chrono::system_clock::now();
 
     r["response_code"] = INTEGER(static_cast<int>(response.status()));
@@ -77,13 +90,34 @@ QueryData genCurl(QueryContext& context) {
     r["method"] = "GET";
     r["user_agent"] =
         user_agents.empty() ? kOsqueryUserAgent : *(user_agents.begin());
+    results.push_back(std::move(r));
+  }
 
-    auto status = processRequest(r);
-    if (!status.ok()) {
-      LOG(WARNING) << "Error making request: " << status.getMessage();
+  // Each request is bounded by the timeout of the TLS transport options.
+  auto options = TLSTransport().getOptions();
+  options.keep_alive(true);
+
+  std::atomic<size_t> next{0};
+  auto send = [&results, &options, &next]() {
+    for (auto i = next++; i < results.size(); i = next++) {
+      auto status = processRequest(results[i], options);
+      if (!status.ok()) {
+        LOG(WARNING) << "Error making request: " << status.getMessage();
+      }
     }
-
-    results.push_back(r);
+  };
+
+  // The requests are sent by a bounded number of threads, the latency of the
+  // scan is that of the slowest requests rather than their sum.
+  auto concurrency = std::min<size_t>(
+      std::max<uint32_t>(FLAGS_curl_concurrent_requests, 1), results.size());
+  std::vector<std::thread> senders;
+  for (size_t i = 1; i < concurrency; ++i) {
+    senders.emplace_back(send);
+  }
+  send();
+  for (auto& sender : senders) {
+    sender.join();
   }
 
   return results;
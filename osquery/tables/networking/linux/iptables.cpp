@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <map>
+#include <set>
 #include <sstream>
 
 #include <arpa/inet.h>
@@ -21,6 +23,7 @@
 #include <osquery/logger/logger.h>
 #include <osquery/tables/networking/posix/utils.h>
 #include <osquery/utils/conversions/split.h>
+#include <osquery/utils/mutex.h>
 
 extern "C" {
 #include <osquery/tables/networking/linux/iptc_proxy.h>
@@ -39,6 +42,26 @@ namespace {
 std::string formatInvFlag(const iptcproxy_rule& rule, int flag) {
   return (rule.ip_data.invflags & flag) ? "!" : "";
 }
+
+/**
+ * @brief The rows of each table read during a schedule step.
+ *
+ * Reading a table walks every chain and rule through a new libiptc handle,
+ * which is slow with tens of thousands of rules. Scheduled queries in the
+ * same step share one read of each table, only the last step is kept.
+ */
+struct IptablesSnapshots {
+  Mutex mutex;
+  uint64_t step{0};
+  std::map<std::string, QueryData> tables;
+};
+
+IptablesSnapshots kIptablesSnapshots;
+
+/// Check if a name is requested, no names requests all of them.
+bool isSelected(const std::set<std::string>& names, const std::string& name) {
+  return names.empty() || names.count(name) > 0;
+}
 } // namespace
 
 void parseIptcpRule(const iptcproxy_rule& rule, Row& r) {
@@ -107,7 +130,9 @@ void parseIptcpRule(const iptcproxy_rule& rule, Row& r) {
   r["outiface_mask"] = TEXT(outiface_mask);
 }
 
-void genIPTablesRules(const std::string &filter, QueryData &results) {
+void genIPTablesRules(const std::string& filter,
+                      const std::set<std::string>& chains,
+                      QueryData& results) {
   Row r;
   r["filter_name"] = filter;
 
@@ -121,6 +146,9 @@ void genIPTablesRules(const std::string &filter, QueryData &results) {
   for (auto chain = iptcproxy_first_chain(handle);
       chain != nullptr;
       chain = iptcproxy_next_chain(handle)) {
+    if (!isSelected(chains, chain->chain)) {
+      continue;
+    }
     r["chain"] = TEXT(chain->chain);
 
     if (chain->policy != nullptr) {
@@ -147,17 +175,52 @@ void genIPTablesRules(const std::string &filter, QueryData &results) {
   iptcproxy_free(handle);
 }
 
+/// Add the rows of a table's chains, read at most once per schedule step.
+void genIPTablesSnapshot(const std::string& filter,
+                         const std::set<std::string>& chains,
+                         QueryData& results) {
+  auto step = TablePlugin::kCacheStep;
+  if (step == 0) {
+    // Queries outside of the schedule read only the requested chains.
+    genIPTablesRules(filter, chains, results);
+    return;
+  }
+
+  auto& snapshots = kIptablesSnapshots;
+  WriteLock lock(snapshots.mutex);
+  if (snapshots.step != step) {
+    snapshots.tables.clear();
+    snapshots.step = step;
+  }
+
+  auto table = snapshots.tables.find(filter);
+  if (table == snapshots.tables.end()) {
+    table = snapshots.tables.emplace(filter, QueryData()).first;
+    genIPTablesRules(filter, {}, table->second);
+  }
+
+  for (const auto& row : table->second) {
+    if (isSelected(chains, row.at("chain"))) {
+      results.push_back(row);
+    }
+  }
+}
+
 QueryData genIptables(QueryContext &context) {
   QueryData results;
 
+  // Tables and chains that are not requested are not read.
+  auto filters = context.constraints["filter_name"].getAll(EQUALS);
+  auto chains = context.constraints["chain"].getAll(EQUALS);
+
   // Read in table names
   std::string content;
   auto s = osquery::readFile(kLinuxIpTablesNames, content);
   if (s.ok()) {
     for (auto &line : split(content, "\n")) {
       boost::trim(line);
-      if (line.size() > 0) {
-        genIPTablesRules(line, results);
+      if (line.size() > 0 && isSelected(filters, line)) {
+        genIPTablesSnapshot(line, chains, results);
       }
     }
   } else {
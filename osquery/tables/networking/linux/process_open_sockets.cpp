@@ -7,17 +7,160 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <memory>
+
+#include <netinet/tcp.h>
+
 #include <osquery/core/core.h>
+#include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/filesystem/linux/proc.h>
+#include <osquery/filesystem/linux/sock_diag.h>
+#include <osquery/rows/process_open_sockets.h>
+#include <osquery/utils/conversions/tryto.h>
 
 namespace osquery {
+
+FLAG(bool,
+     enable_sock_diag,
+     true,
+     "List the sockets of the osquery network namespace with netlink "
+     "sock_diag dumps instead of /proc/net");
+
 namespace tables {
 
-QueryData genOpenSockets(QueryContext& context) {
+namespace {
+
+/// Get the port of a single equality constraint of a column.
+boost::optional<std::uint16_t> getPortConstraint(QueryContext& context,
+                                                 const std::string& column) {
+  if (context.constraints.count(column) == 0) {
+    return boost::none;
+  }
+
+  auto ports = context.constraints.at(column).getAll(EQUALS);
+  if (ports.size() != 1) {
+    return boost::none;
+  }
+
+  auto port = tryTo<int>(*ports.begin());
+  if (port.isError() || port.get() < 0 || port.get() > 0xFFFF) {
+    return boost::none;
+  }
+  return static_cast<std::uint16_t>(port.get());
+}
+
+/**
+ * @brief Select the sockets the kernel dumps from the query constraints.
+ *
+ * SQLite checks every constraint on the rows again, the filter only skips
+ * sockets that cannot match.
+ */
+SockDiagFilter getSockDiagFilter(QueryContext& context) {
+  SockDiagFilter filter;
+  filter.local_port = getPortConstraint(context, "local_port");
+  filter.remote_port = getPortConstraint(context, "remote_port");
+
+  if (context.constraints.count("state") > 0 &&
+      context.constraints.at("state").exists(EQUALS)) {
+    std::uint32_t states = 0;
+    for (const auto& state : context.constraints.at("state").getAll(EQUALS)) {
+      auto it = std::find(tcp_states.begin(), tcp_states.end(), state);
+      if (it == tcp_states.begin()) {
+        // Unknown states are reported for any invalid state number.
+        states = ~0U;
+      } else if (it != tcp_states.end()) {
+        states |= 1U << (it - tcp_states.begin());
+      }
+    }
+    filter.tcp_states &= states;
+  }
+
+  // Only listening and unconnected TCP sockets have no remote port.
+  if (filter.remote_port && *filter.remote_port == 0) {
+    filter.tcp_states &= (1U << TCP_LISTEN) | (1U << TCP_CLOSE);
+  }
+  return filter;
+}
+
+/// Get the numbers of the equality constraints of a column, empty for any.
+std::set<int> getNumberConstraints(QueryContext& context,
+                                   const std::string& column) {
+  std::set<int> numbers;
+  if (context.constraints.count(column) == 0) {
+    return numbers;
+  }
+
+  for (const auto& value : context.constraints.at(column).getAll(EQUALS)) {
+    auto number = tryTo<int>(value);
+    if (number.isValue()) {
+      numbers.insert(number.get());
+    }
+  }
+  return numbers;
+}
+
+/// Check if a family or protocol is selected by its constraints.
+bool isSelected(const std::set<int>& selected, int value) {
+  return selected.empty() || selected.count(value) > 0;
+}
+
+/**
+ * @brief Find the processes owning a few sockets.
+ *
+ * The descriptors of the processes are read until every socket is found,
+ * instead of the snapshot of every descriptor of every process.
+ */
+void getSocketOwners(const std::set<std::string>& pids,
+                     const SocketInfoList& socket_list,
+                     SocketInodeToProcessInfoMap& owners) {
+  std::set<std::string> inodes;
+  for (const auto& info : socket_list) {
+    inodes.insert(info.socket);
+  }
+
+  for (const auto& pid : pids) {
+    SocketInodeToProcessInfoMap pid_sockets;
+    if (!procGetSocketInodeToProcessInfoMap(pid, pid_sockets).ok()) {
+      continue;
+    }
+
+    for (auto& pair : pid_sockets) {
+      if (inodes.erase(pair.first) > 0) {
+        owners[pair.first] = std::move(pair.second);
+      }
+    }
+
+    if (inodes.empty()) {
+      break;
+    }
+  }
+}
+
+/// List the sockets of a family and protocol of a network namespace.
+Status getSocketList(int family,
+                     int protocol,
+                     ino_t ns,
+                     const std::string& pid,
+                     const SockDiagFilter& filter,
+                     SocketInfoList& socket_list) {
+  if (FLAGS_enable_sock_diag && sockDiagSupported(ns)) {
+    auto status =
+        sockDiagGetSocketList(family, protocol, ns, filter, socket_list);
+    if (status.ok()) {
+      return status;
+    }
+  }
+  return procGetSocketList(family, protocol, ns, pid, socket_list);
+}
+
+} // namespace
+
+TableRows genOpenSockets(QueryContext& context) {
   Status status;
-  QueryData results;
+  TableRows results;
 
   /*
    * If filtering by pid, restrict results to the list of pids provided
@@ -67,15 +210,22 @@ QueryData genOpenSockets(QueryContext& context) {
 
   /* Use a set to record the namespaces already processed */
   std::set<ino_t> netns_list;
-  SocketInodeToProcessInfoMap inode_proc_map;
+  SocketInodeToProcessInfoMap pid_inode_proc_map;
   SocketInfoList socket_list;
+  auto filter = getSockDiagFilter(context);
+  auto families = getNumberConstraints(context, "family");
+  auto protocols = getNumberConstraints(context, "protocol");
+
   for (const auto& pid : pids) {
     /* Step 1 */
-    status = procGetSocketInodeToProcessInfoMap(pid, inode_proc_map);
-    if (!status.ok()) {
-      VLOG(1) << "Results for process_open_sockets might be incomplete. Failed "
-                 "to acquire socket inode to process map for pid "
-              << pid << ": " << status.what();
+    if (pid_filter) {
+      status = procGetSocketInodeToProcessInfoMap(pid, pid_inode_proc_map);
+      if (!status.ok()) {
+        VLOG(1)
+            << "Results for process_open_sockets might be incomplete. Failed "
+               "to acquire socket inode to process map for pid "
+            << pid << ": " << status.what();
+      }
     }
 
     /* Step 2 */
@@ -98,42 +248,76 @@ QueryData genOpenSockets(QueryContext& context) {
     if (netns_list.count(ns) == 0) {
       netns_list.insert(ns);
 
-      /* Step 3 */
+      /* Step 3, only for the selected families and protocols */
       for (const auto& pair : kLinuxProtocolNames) {
-        status = procGetSocketList(AF_INET, pair.first, ns, pid, socket_list);
+        if (!isSelected(protocols, pair.first)) {
+          continue;
+        }
+
+        if (isSelected(families, AF_INET)) {
+          status = getSocketList(
+              AF_INET, pair.first, ns, pid, filter, socket_list);
+          if (!status.ok()) {
+            VLOG(1) << "Results for process_open_sockets might be incomplete. "
+                       "Failed to acquire basic socket information for "
+                       "AF_INET "
+                    << pair.second << ": " << status.what();
+          }
+        }
+
+        if (isSelected(families, AF_INET6)) {
+          status = getSocketList(
+              AF_INET6, pair.first, ns, pid, filter, socket_list);
+          if (!status.ok()) {
+            VLOG(1) << "Results for process_open_sockets might be incomplete. "
+                       "Failed to acquire basic socket information for "
+                       "AF_INET6 "
+                    << pair.second << ": " << status.what();
+          }
+        }
+      }
+
+      if (isSelected(families, AF_UNIX) && isSelected(protocols, IPPROTO_IP)) {
+        status = getSocketList(
+            AF_UNIX, IPPROTO_IP, ns, pid, filter, socket_list);
         if (!status.ok()) {
           VLOG(1)
               << "Results for process_open_sockets might be incomplete. Failed "
-                 "to acquire basic socket information for AF_INET "
-              << pair.second << ": " << status.what();
+                 "to acquire basic socket information for AF_UNIX: "
+              << status.what();
         }
+      }
 
-        status = procGetSocketList(AF_INET6, pair.first, ns, pid, socket_list);
+      // protocol is 0, we want all protocols here.
+      if (isSelected(families, AF_PACKET)) {
+        status = procGetSocketList(AF_PACKET, 0, ns, pid, socket_list);
         if (!status.ok()) {
           VLOG(1)
               << "Results for process_open_sockets might be incomplete. Failed "
-                 "to acquire basic socket information for AF_INET6 "
-              << pair.second << ": " << status.what();
+                 "to acquire basic socket information for AF_PACKET: "
+              << status.what();
         }
       }
-      status = procGetSocketList(AF_UNIX, IPPROTO_IP, ns, pid, socket_list);
-      if (!status.ok()) {
-        VLOG(1)
-            << "Results for process_open_sockets might be incomplete. Failed "
-               "to acquire basic socket information for AF_UNIX: "
-            << status.what();
-      }
+    }
+  }
 
-      // protocol is 0, we want all protocols here.
-      status = procGetSocketList(AF_PACKET, 0, ns, pid, socket_list);
-      if (!status.ok()) {
-        VLOG(1)
-            << "Results for process_open_sockets might be incomplete. Failed "
-               "to acquire basic socket information for AF_PACKET: "
-            << status.what();
-      }
+  /* Step 1 for every process, only for the sockets found. The queries of a
+   * step share the descriptors of every process, unless a few sockets were
+   * selected by port, family or protocol and no query read them yet.
+   */
+  std::shared_ptr<const ProcessDescriptorSnapshot> snapshot;
+  if (!pid_filter && !socket_list.empty()) {
+    snapshot = procPeekDescriptorSnapshot(TablePlugin::kCacheStep);
+    auto selective =
+        filter.local_port || !families.empty() || !protocols.empty();
+    if (snapshot == nullptr && !selective) {
+      snapshot = procGetDescriptorSnapshot(TablePlugin::kCacheStep);
+    } else if (snapshot == nullptr) {
+      getSocketOwners(pids, socket_list, pid_inode_proc_map);
     }
   }
+  const auto& inode_proc_map =
+      (snapshot != nullptr) ? snapshot->sockets : pid_inode_proc_map;
 
   /* Finally correlate all the information. Go through all the sockets
    * collected on step 3 and correlate that with the pid and fd collected from
@@ -141,30 +325,35 @@ QueryData genOpenSockets(QueryContext& context) {
    * the inode to process information map.
    */
   for (const auto& info : socket_list) {
-    Row r;
+    auto r = std::make_unique<ProcessOpenSocketsRow>();
     auto proc_it = inode_proc_map.find(info.socket);
     if (proc_it != inode_proc_map.end()) {
-      r["pid"] = proc_it->second.pid;
-      r["fd"] = proc_it->second.fd;
+      r->pid_col = tryTo<int>(proc_it->second.pid).takeOr(-1);
+      r->fd_col = tryTo<long long>(proc_it->second.fd).takeOr(-1ll);
     } else if (!pid_filter) {
-      r["pid"] = "-1";
-      r["fd"] = "-1";
+      r->pid_col = -1;
+      r->fd_col = -1;
     } else {
       /* If we're filtering by pid we only care about sockets associated with
        * pids on the list.*/
       continue;
     }
 
-    r["socket"] = info.socket;
-    r["family"] = std::to_string(info.family);
-    r["protocol"] = std::to_string(info.protocol);
-    r["local_address"] = info.local_address;
-    r["local_port"] = std::to_string(info.local_port);
-    r["remote_address"] = info.remote_address;
-    r["remote_port"] = std::to_string(info.remote_port);
-    r["path"] = info.unix_socket_path;
-    r["state"] = info.state;
-    r["net_namespace"] = std::to_string(info.net_ns);
+    auto socket = tryTo<long long>(info.socket);
+    if (socket.isValue()) {
+      r->socket_col = socket.take();
+    } else {
+      r->null_columns |= ProcessOpenSocketsRow::SOCKET;
+    }
+    r->family_col = info.family;
+    r->protocol_col = info.protocol;
+    r->local_address_col = info.local_address;
+    r->local_port_col = info.local_port;
+    r->remote_address_col = info.remote_address;
+    r->remote_port_col = info.remote_port;
+    r->path_col = info.unix_socket_path;
+    r->state_col = info.state;
+    r->net_namespace_col = std::to_string(info.net_ns);
 
     results.push_back(std::move(r));
   }
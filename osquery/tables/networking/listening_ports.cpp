@@ -8,6 +8,7 @@
  */
 
 #include <osquery/core/tables.h>
+#include <osquery/registry/registry.h>
 #include <osquery/sql/sql.h>
 #include <osquery/utils/info/platform_type.h>
 
@@ -19,10 +20,55 @@ const std::string kAF_INET6 = "10";
 
 namespace osquery {
 namespace tables {
+
+namespace {
+
+/**
+ * @brief Select the sockets of process_open_sockets that may be listening.
+ *
+ * Linux reports a remote port of 0 for every socket that may be listening,
+ * the constraint lets the kernel skip the connected TCP sockets. The port,
+ * protocol and family constraints are passed along as the local port, protocol
+ * and family, so only the matching sockets are dumped and attributed to their
+ * processes. SQLite checks the constraints again on the rows.
+ */
+QueryData selectLinuxSockets(QueryContext& context) {
+  QueryContext sockets_context;
+  sockets_context.constraints["remote_port"].add(Constraint(EQUALS, "0"));
+
+  if (context.constraints.count("port") > 0) {
+    auto ports = context.constraints.at("port").getAll(EQUALS);
+    if (ports.size() == 1) {
+      sockets_context.constraints["local_port"].add(
+          Constraint(EQUALS, *ports.begin()));
+    }
+  }
+
+  for (const auto& column : {"protocol", "family"}) {
+    if (context.constraints.count(column) == 0) {
+      continue;
+    }
+    for (const auto& value : context.constraints.at(column).getAll(EQUALS)) {
+      sockets_context.constraints[column].add(Constraint(EQUALS, value));
+    }
+  }
+
+  PluginRequest request = {{"action", "generate"}};
+  TablePlugin::setRequestFromContext(sockets_context, request);
+
+  PluginResponse response;
+  Registry::call("table", "process_open_sockets", request, response);
+  return response;
+}
+
+} // namespace
+
 QueryData genListeningPorts(QueryContext& context) {
   QueryData results;
 
-  auto sockets = SQL::selectAllFrom("process_open_sockets");
+  auto sockets = isPlatform(PlatformType::TYPE_LINUX)
+                     ? selectLinuxSockets(context)
+                     : SQL::selectAllFrom("process_open_sockets");
 
   for (const auto& socket : sockets) {
     if (socket.at("family") == kAF_UNIX && socket.at("path").empty()) {
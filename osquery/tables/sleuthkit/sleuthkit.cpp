@@ -7,7 +7,10 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <chrono>
 #include <map>
+#include <mutex>
 #include <set>
 
 #include <boost/filesystem.hpp>
@@ -15,6 +18,7 @@
 
 #include <tsk/libtsk.h>
 
+#include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/hashing/hashing.h>
@@ -24,8 +28,20 @@
 namespace fs = boost::filesystem;
 
 namespace osquery {
+
+FLAG(uint64,
+     sleuthkit_cache_seconds,
+     60,
+     "Seconds to reuse opened device images in the device tables (0 disables)");
+
 namespace tables {
 
+/// The most devices kept open by the cache.
+const size_t kTskMaxCachedDevices{8};
+
+/// The most directory entries cached for a device.
+const size_t kTskMaxCachedDirectoryEntries{100000};
+
 const std::map<TSK_FS_META_TYPE_ENUM, std::string> kTSKTypeNames{
     {TSK_FS_META_TYPE_REG, "regular"},
     {TSK_FS_META_TYPE_DIR, "directory"},
@@ -36,11 +52,125 @@ const std::map<TSK_FS_META_TYPE_ENUM, std::string> kTSKTypeNames{
     {TSK_FS_META_TYPE_SOCK, "socket"},
 };
 
+/// A directory entry read while walking a filesystem.
+struct TskDirectoryEntry {
+  /// The entry name, empty if it has none.
+  std::string name;
+
+  /// The entry inode and type, TSK_FS_META_TYPE_UNDEF without metadata.
+  TSK_INUM_T inode{0};
+  TSK_FS_META_TYPE_ENUM type{TSK_FS_META_TYPE_UNDEF};
+
+  /// The metadata columns of a regular file.
+  Row meta;
+};
+
+/**
+ * @brief An opened device image, its volume and filesystems.
+ *
+ * The image, volume and the filesystem of each partition are opened once and
+ * reused by the queries of the next sleuthkit_cache_seconds. The entries of
+ * the directories walked are kept as well, a repeated listing of a partition
+ * does not read the directories again.
+ *
+ * TSK structures are not shared between threads, a query holds the mutex of
+ * the device while it uses it.
+ */
+struct TskDevice : private boost::noncopyable {
+  explicit TskDevice(const std::string& path)
+      : path(path), created(std::chrono::steady_clock::now()) {}
+
+  std::mutex mutex;
+
+  /// Filesystem path to the device node.
+  std::string path;
+
+  /// When the device was added to the cache.
+  std::chrono::steady_clock::time_point created;
+
+  /// Has the device open been attempted.
+  bool opened{false};
+
+  /// The result of the opened request.
+  bool opened_result{false};
+
+  /// Image structure.
+  std::shared_ptr<TskImgInfo> image{std::make_shared<TskImgInfo>()};
+
+  /// Volume structure.
+  std::shared_ptr<TskVsInfo> volume{std::make_shared<TskVsInfo>()};
+
+  /// Filesystems by partition address, nullptr if none could be opened.
+  std::map<TSK_DADDR_T, std::shared_ptr<TskFsInfo>> filesystems;
+
+  /// Directory entries by filesystem offset and directory inode.
+  std::map<std::pair<TSK_OFF_T, TSK_INUM_T>, std::vector<TskDirectoryEntry>>
+      directories;
+
+  /// The number of entries in directories.
+  size_t directory_entries{0};
+};
+
+/// Opened devices shared by the device tables.
+class TskDeviceCache : private boost::noncopyable {
+ public:
+  static TskDeviceCache& get() {
+    static TskDeviceCache cache;
+    return cache;
+  }
+
+  /// Get the opened device for a path, or a new one to open.
+  std::shared_ptr<TskDevice> device(const std::string& path);
+
+ private:
+  std::mutex mutex_;
+  std::map<std::string, std::shared_ptr<TskDevice>> devices_;
+};
+
+std::shared_ptr<TskDevice> TskDeviceCache::device(const std::string& path) {
+  if (FLAGS_sleuthkit_cache_seconds == 0) {
+    return std::make_shared<TskDevice>(path);
+  }
+
+  // Devices are removed after a fixed time, not after their last use, so
+  // that changes on the disk are seen within sleuthkit_cache_seconds.
+  auto now = std::chrono::steady_clock::now();
+  auto ttl = std::chrono::seconds(FLAGS_sleuthkit_cache_seconds);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = devices_.begin(); it != devices_.end();) {
+    if (now - it->second->created >= ttl) {
+      it = devices_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  auto it = devices_.find(path);
+  if (it != devices_.end()) {
+    return it->second;
+  }
+
+  if (devices_.size() >= kTskMaxCachedDevices) {
+    auto oldest = std::min_element(
+        devices_.begin(), devices_.end(), [](const auto& a, const auto& b) {
+          return a.second->created < b.second->created;
+        });
+    devices_.erase(oldest);
+  }
+
+  auto device = std::make_shared<TskDevice>(path);
+  devices_[path] = device;
+  return device;
+}
+
 class DeviceHelper : private boost::noncopyable {
  public:
   explicit DeviceHelper(const std::string& device_path)
-      : image_(std::make_shared<TskImgInfo>()),
-        volume_(std::make_shared<TskVsInfo>()),
+      : device_(TskDeviceCache::get().device(device_path)),
+        lock_(device_->mutex),
+        image_(device_->image),
+        volume_(device_->volume),
         device_path_(device_path) {}
 
   /// Volume partition iterator.
@@ -58,6 +188,9 @@ class DeviceHelper : private boost::noncopyable {
     }
   }
 
+  /// The filesystem of a partition, nullptr if none could be opened.
+  TskFsInfo* filesystem(const TskVsPartInfo* part);
+
   void inodes(
       const std::set<std::string>& inodes,
       TskFsInfo* fs,
@@ -71,6 +204,10 @@ class DeviceHelper : private boost::noncopyable {
                      QueryData& results,
                      TSK_INUM_T inode = 0);
 
+  /// Read the entries of a directory, or get the cached entries.
+  const std::vector<TskDirectoryEntry>* directory(TskFsInfo* fs,
+                                                  TSK_INUM_T inode);
+
   /// Similar to generateFiles but only yield a row to results.
   void generateFile(const std::string& partition,
                     TskFsFile* file,
@@ -94,12 +231,15 @@ class DeviceHelper : private boost::noncopyable {
   /// Attempt to open the provided device image and volume.
   bool open();
 
+  /// Add the metadata columns of a file to a row.
+  static void genFileMeta(TskFsFile* file, Row& r);
+
  private:
-  /// Has the device open been attempted.
-  bool opened_{false};
+  /// The device, shared with other queries through the cache.
+  std::shared_ptr<TskDevice> device_;
 
-  /// The result of the opened request.
-  bool opened_result_{false};
+  /// The device is used by a single query at a time.
+  std::lock_guard<std::mutex> lock_;
 
   /// Image structure.
   std::shared_ptr<TskImgInfo> image_{nullptr};
@@ -113,25 +253,43 @@ class DeviceHelper : private boost::noncopyable {
   size_t stack_{0};
   size_t count_{0};
   std::set<std::string> loops_;
+
+  /// Directory entries read by this helper, stored when complete.
+  std::vector<TskDirectoryEntry> entries_;
 };
 
 bool DeviceHelper::open() {
-  if (opened_) {
-    return opened_result_;
+  if (device_->opened) {
+    return device_->opened_result;
   }
 
   // Attempt to open the device image.
-  opened_ = true;
+  device_->opened = true;
   auto status = image_->open(device_path_.c_str(), TSK_IMG_TYPE_DETECT, 0);
   if (status) {
-    opened_result_ = false;
-    return opened_result_;
+    device_->opened_result = false;
+    return device_->opened_result;
   }
 
   // Attempt to open the device image volumn.
   status = volume_->open(&*image_, 0, TSK_VS_TYPE_DETECT);
-  opened_result_ = (status == 0);
-  return opened_result_;
+  device_->opened_result = (status == 0);
+  return device_->opened_result;
+}
+
+TskFsInfo* DeviceHelper::filesystem(const TskVsPartInfo* part) {
+  auto it = device_->filesystems.find(part->getAddr());
+  if (it != device_->filesystems.end()) {
+    return it->second.get();
+  }
+
+  auto fs = std::make_shared<TskFsInfo>();
+  if (fs->open(part, TSK_FS_TYPE_DETECT)) {
+    // Remember that this partition has no readable filesystem.
+    fs = nullptr;
+  }
+  device_->filesystems[part->getAddr()] = fs;
+  return fs.get();
 }
 
 void DeviceHelper::inodes(
@@ -176,6 +334,11 @@ void DeviceHelper::generateFile(const std::string& partition,
     r["block_size"] = BIGINT(fs->getBlockSize());
   }
 
+  genFileMeta(file, r);
+  results.push_back(r);
+}
+
+void DeviceHelper::genFileMeta(TskFsFile* file, Row& r) {
   const auto* meta = file->getMeta();
   if (meta != nullptr) {
     r["inode"] = BIGINT(meta->getAddr());
@@ -194,30 +357,27 @@ void DeviceHelper::generateFile(const std::string& partition,
     }
     delete meta;
   }
-  results.push_back(r);
 }
 
-void DeviceHelper::generateFiles(const std::string& partition,
-                                 TskFsInfo* fs,
-                                 const std::string& path,
-                                 QueryData& results,
-                                 TSK_INUM_T inode) {
-  if (stack_++ > 1024) {
-    return;
+const std::vector<TskDirectoryEntry>* DeviceHelper::directory(
+    TskFsInfo* fs, TSK_INUM_T inode) {
+  auto key = std::make_pair(fs->getOffset(), inode);
+  auto it = device_->directories.find(key);
+  if (it != device_->directories.end()) {
+    return &it->second;
   }
 
   auto* dir = new TskFsDir();
-  if (dir->open(fs, ((inode == 0) ? fs->getRootINum() : inode))) {
+  if (dir->open(fs, inode)) {
     delete dir;
-    return;
+    return nullptr;
   }
 
-  // Iterate through the directory.
-  std::map<TSK_INUM_T, std::string> additional;
+  entries_.clear();
+  entries_.reserve(dir->getSize());
   for (size_t i = 0; i < dir->getSize(); i++) {
-    if (count_++ > 1024 * 10) {
-      break;
-    }
+    entries_.emplace_back();
+    auto& entry = entries_.back();
 
     auto* file = dir->getFile(i);
     if (file == nullptr) {
@@ -231,28 +391,81 @@ void DeviceHelper::generateFiles(const std::string& partition,
       continue;
     }
 
-    std::string leaf;
     auto* name = file->getName();
     if (name != nullptr) {
-      leaf = (fs::path(path) / name->getName()).string();
-    }
-
-    if (meta->getType() == TSK_FS_META_TYPE_REG) {
-      generateFile(partition, file, fs, leaf, results);
-    } else if (meta->getType() == TSK_FS_META_TYPE_DIR) {
-      if (name != nullptr && !TSK_FS_ISDOT(name->getName())) {
-        additional[meta->getAddr()] = leaf;
-      }
+      entry.name = name->getName();
+      delete name;
     }
 
-    if (name != nullptr) {
-      delete name;
+    entry.inode = meta->getAddr();
+    entry.type = meta->getType();
+    if (entry.type == TSK_FS_META_TYPE_REG) {
+      genFileMeta(file, entry.meta);
     }
     delete meta;
     delete file;
   }
   delete dir;
 
+  // Keep the entries if the memory bound of the device allows it.
+  if (FLAGS_sleuthkit_cache_seconds == 0 ||
+      device_->directory_entries + entries_.size() >
+          kTskMaxCachedDirectoryEntries) {
+    return &entries_;
+  }
+  device_->directory_entries += entries_.size();
+  auto& cached = device_->directories[key];
+  cached.swap(entries_);
+  return &cached;
+}
+
+void DeviceHelper::generateFiles(const std::string& partition,
+                                 TskFsInfo* fs,
+                                 const std::string& path,
+                                 QueryData& results,
+                                 TSK_INUM_T inode) {
+  if (stack_++ > 1024) {
+    return;
+  }
+
+  const auto* entries =
+      directory(fs, ((inode == 0) ? fs->getRootINum() : inode));
+  if (entries == nullptr) {
+    return;
+  }
+
+  // Iterate through the directory.
+  std::map<TSK_INUM_T, std::string> additional;
+  for (const auto& entry : *entries) {
+    if (count_++ > 1024 * 10) {
+      break;
+    }
+
+    // Entries without metadata information.
+    if (entry.type == TSK_FS_META_TYPE_UNDEF) {
+      continue;
+    }
+
+    std::string leaf;
+    if (!entry.name.empty()) {
+      leaf = (fs::path(path) / entry.name).string();
+    }
+
+    if (entry.type == TSK_FS_META_TYPE_REG) {
+      Row r = entry.meta;
+      r["device"] = device_path_;
+      r["partition"] = partition;
+      r["path"] = leaf;
+      r["filename"] = fs::path(leaf).leaf().string();
+      r["block_size"] = BIGINT(fs->getBlockSize());
+      results.push_back(std::move(r));
+    } else if (entry.type == TSK_FS_META_TYPE_DIR) {
+      if (!entry.name.empty() && !TSK_FS_ISDOT(entry.name.c_str())) {
+        additional[entry.inode] = leaf;
+      }
+    }
+  }
+
   // If we are recursing.
   for (const auto& d : additional) {
     if (std::find(loops_.begin(), loops_.end(), d.second) == loops_.end()) {
@@ -334,11 +547,9 @@ QueryData genDeviceHash(QueryContext& context) {
         return;
       }
 
-      auto* fs = new TskFsInfo();
-      auto status = fs->open(part, TSK_FS_TYPE_DETECT);
+      auto* fs = dh.filesystem(part);
       // Cannot retrieve file information without accessing the filesystem.
-      if (status) {
-        delete fs;
+      if (fs == nullptr) {
         return;
       }
 
@@ -358,7 +569,6 @@ QueryData genDeviceHash(QueryContext& context) {
                   r["sha256"] = std::move(hashes.sha256);
                   results.push_back(r);
                 }));
-      delete fs;
     }));
   }
 
@@ -393,11 +603,9 @@ QueryData genDeviceFile(QueryContext& context) {
         return;
       }
 
-      auto* fs = new TskFsInfo();
-      auto status = fs->open(part, TSK_FS_TYPE_DETECT);
+      auto* fs = dh.filesystem(part);
       // Cannot retrieve file information without accessing the filesystem.
-      if (status) {
-        delete fs;
+      if (fs == nullptr) {
         return;
       }
 
@@ -424,7 +632,6 @@ QueryData genDeviceFile(QueryContext& context) {
                                                 const std::string& path) {
                   dh.generateFile(address, file, fs, path, results);
                 }));
-      delete fs;
     }));
   }
 
@@ -456,9 +663,8 @@ QueryData genDevicePartitions(QueryContext& context) {
         r["type"] = "normal";
       }
 
-      auto* fs = new TskFsInfo();
-      auto status = fs->open(part, TSK_FS_TYPE_DETECT);
-      if (status) {
+      auto* fs = dh.filesystem(part);
+      if (fs == nullptr) {
         r["offset"] = BIGINT(part->getStart() * dh.getVolume()->getBlockSize());
         r["blocks_size"] = BIGINT(dh.getVolume()->getBlockSize());
         r["blocks"] = BIGINT(part->getLen());
@@ -474,7 +680,6 @@ QueryData genDevicePartitions(QueryContext& context) {
         r["blocks"] = BIGINT(fs->getBlockCount());
         r["inodes"] = BIGINT(fs->getINumCount());
       }
-      delete fs;
       results.push_back(r);
     }));
   }
@@ -16,19 +16,31 @@
 #include <unistd.h>
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 #include <set>
 #include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <boost/filesystem.hpp>
 
 #include <osquery/core/flags.h>
+#include <osquery/database/database.h>
+#include <osquery/dispatcher/dispatcher.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/hashing/hashing.h>
 #include <osquery/logger/logger.h>
 #include <osquery/core/tables.h>
 #include <osquery/sql/dynamic_table_row.h>
-#include <osquery/utils/mutex.h>
+#include <osquery/tables/system/hash.h>
+#include <osquery/utils/caches/sharded.h>
+#include <osquery/utils/conversions/split.h>
+#include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/info/platform_type.h>
+#include <osquery/utils/system/time.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
 #include <osquery/worker/logging/glog/glog_logger.h>
 #include <osquery/worker/logging/logger.h>
@@ -42,6 +54,22 @@ FLAG(bool,
 
 FLAG(uint32, hash_cache_max, 500, "Size of LRU file hash cache");
 
+FLAG(bool,
+     hash_cache_database,
+     true,
+     "Keep cached file hashes in the database across restarts");
+
+FLAG(uint32,
+     hash_cache_database_max,
+     100000,
+     "Number of file hashes kept in the database, least recently used are "
+     "deleted first");
+
+FLAG(uint32,
+     hash_concurrency,
+     4,
+     "Number of files the hash table hashes at once");
+
 HIDDEN_FLAG(uint32,
             hash_delay,
             20,
@@ -51,51 +79,57 @@ DECLARE_uint64(read_max);
 
 namespace tables {
 
-/// Clear this amount of rows every time cache eviction is triggered.
-const size_t kHashCacheEvictSize{5};
+/// A stored hash is marked as used again at most this often, in seconds.
+const uint64_t kStoredHashUseResolution{3600};
+
+/// Seconds between purges of the stored hashes.
+const uint64_t kStoredHashPurgeInterval{3600};
 
 /**
  * @brief Implements persistent in-memory caching of files' hashes.
  *
- * This cache has LRU eviction policy. The hash is recalculated
- * every time the mtime or size of the file changes.
+ * This cache has CLOCK eviction policy, see caches::ShardedCache, and files
+ * are looked up concurrently. The hash is recalculated every time the mtime,
+ * ctime or size of the file changes.
+ *
+ * Evicted and new entries are looked up in the kFileHashes database domain,
+ * which keeps up to hash_cache_database_max hashes across restarts, before
+ * the file is hashed.
  */
 struct FileHashCache {
   /// The file's modification time, changes with a touch.
   time_t file_mtime;
 
-  /// The file's serial or information number (inode).
+  /// The file's status change time, changes with any inode update.
+  time_t file_ctime;
+
+  /// The file's device and serial or information number (inode).
+  dev_t file_device;
   ino_t file_inode;
 
   /// The file's size.
   off_t file_size;
 
-  /// For eviction, the last time this cache item was used.
-  time_t cache_access_time;
-
   /// Cache content, the hashes.
   MultiHashes hashes;
 
-  /// Cache index, the file path.
-  std::string path;
-
-  /// Comparison function for organizing the LRU heap.
-  static bool greater(const FileHashCache* l, const FileHashCache* r) {
-    return l->cache_access_time > r->cache_access_time;
-  }
-
   /**
    * @brief Do-it-all access function.
    *
    * Maintains the cache of hash sums, stats file at path, if it has changed or
    * it is not present in cache calculates the hashes and caches the result.
+   * Only the requested digests missing from the cache are calculated.
    *
    * @param path the path of file to hash.
+   * @param mask the requested digests.
    * @param out stores the calculated hashes.
    *
    * @return true if succeeded, false if something went wrong.
    */
-  static bool load(const std::string& path, MultiHashes& out, Logger& logger);
+  static bool load(const std::string& path,
+                   int mask,
+                   MultiHashes& out,
+                   Logger& logger);
 };
 
 #if defined(WIN32)
@@ -117,6 +151,11 @@ static inline bool statInvalid(const struct stat& st, const FileHashCache& fh) {
     return true;
   }
 
+  if (st.st_dev != fh.file_device || st.st_ctime != fh.file_ctime) {
+    // The mtime may be set back, the ctime cannot.
+    return true;
+  }
+
   if (st.st_size != fh.file_size) {
     // Just in case there's tomfoolery.
     return true;
@@ -124,17 +163,134 @@ static inline bool statInvalid(const struct stat& st, const FileHashCache& fh) {
   return false;
 }
 
+/// The database key of a file, hard links and renames are separate entries.
+static std::string getHashCacheKey(const std::string& path,
+                                   const struct stat& st) {
+  return std::to_string(st.st_dev) + "." + std::to_string(st.st_ino) + "." +
+         path;
+}
+
+/// Add the digests of one set of hashes to another.
+static void mergeHashes(MultiHashes& into, const MultiHashes& from) {
+  for (const auto& type : kHashTypeNames) {
+    if (from.mask & type.first) {
+      getHashDigest(into, type.first) = getHashDigest(from, type.first);
+    }
+  }
+  into.mask |= from.mask;
+}
+
+static void setStoredHashes(const std::string& path,
+                            const struct stat& st,
+                            const MultiHashes& hashes) {
+  // The value is "used mtime ctime size mask", then the digests of the mask.
+  auto value = std::to_string(getUnixTime()) + " " +
+               std::to_string(st.st_mtime) + " " +
+               std::to_string(st.st_ctime) + " " + std::to_string(st.st_size) +
+               " " + std::to_string(hashes.mask);
+  for (const auto& type : kHashTypeNames) {
+    if (hashes.mask & type.first) {
+      value += " " + getHashDigest(hashes, type.first);
+    }
+  }
+  setDatabaseValue(kFileHashes, getHashCacheKey(path, st), value);
+}
+
+/// Get the hashes of a file from the database, if the file did not change.
+static bool getStoredHashes(const std::string& path,
+                            const struct stat& st,
+                            MultiHashes& hashes) {
+  std::string value;
+  if (!getDatabaseValue(kFileHashes, getHashCacheKey(path, st), value).ok()) {
+    return false;
+  }
+
+  auto fields = split(value, " ");
+  if (fields.size() < 5 ||
+      tryTo<int64_t>(fields[1]).takeOr(int64_t{-1}) != st.st_mtime ||
+      tryTo<int64_t>(fields[2]).takeOr(int64_t{-1}) != st.st_ctime ||
+      tryTo<int64_t>(fields[3]).takeOr(int64_t{-1}) != st.st_size) {
+    return false;
+  }
+
+  auto mask = tryTo<int>(fields[4]).takeOr(0);
+  size_t field = 5;
+  for (const auto& type : kHashTypeNames) {
+    if (mask & type.first) {
+      if (field >= fields.size()) {
+        return false;
+      }
+      getHashDigest(hashes, type.first) = std::move(fields[field++]);
+    }
+  }
+  hashes.mask = mask;
+
+  // Hashes that are still used are kept over the least recently used.
+  auto used = tryTo<uint64_t>(fields[0]).takeOr(uint64_t{0});
+  if (used + kStoredHashUseResolution < getUnixTime()) {
+    setStoredHashes(path, st, hashes);
+  }
+  return true;
+}
+
+void purgeStoredHashes() {
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kFileHashes, keys);
+
+  std::vector<std::pair<uint64_t, std::string>> kept;
+  for (auto& key : keys) {
+    auto device_end = key.find('.');
+    auto inode_end = key.find('.', device_end + 1);
+    if (device_end == std::string::npos || inode_end == std::string::npos) {
+      deleteDatabaseValue(kFileHashes, key);
+      continue;
+    }
+
+    struct stat st;
+    auto path = key.substr(inode_end + 1);
+    if (stat(path.c_str(), &st) != 0 || getHashCacheKey(path, st) != key) {
+      deleteDatabaseValue(kFileHashes, key);
+      continue;
+    }
+
+    std::string value;
+    getDatabaseValue(kFileHashes, key, value);
+    auto used = tryTo<uint64_t>(value.substr(0, value.find(' ')));
+    kept.emplace_back(used.takeOr(uint64_t{0}), std::move(key));
+  }
+
+  if (kept.size() <= FLAGS_hash_cache_database_max) {
+    return;
+  }
+
+  // The least recently used hashes are deleted first.
+  auto excess = kept.size() - FLAGS_hash_cache_database_max;
+  std::nth_element(kept.begin(), kept.begin() + excess, kept.end());
+  for (size_t i = 0; i < excess; ++i) {
+    deleteDatabaseValue(kFileHashes, kept[i].second);
+  }
+}
+
+/// Keeps the stored hashes bounded and drops those of removed files.
+class StoredHashesPurgeRunner : public InternalRunnable {
+ public:
+  StoredHashesPurgeRunner() : InternalRunnable("StoredHashesPurgeRunner") {}
+
+  void start() override {
+    while (!interrupted()) {
+      purgeStoredHashes();
+      pause(std::chrono::seconds(kStoredHashPurgeInterval));
+    }
+  }
+};
+
 bool FileHashCache::load(const std::string& path,
+                         int mask,
                          MultiHashes& out,
                          Logger& logger) {
-  // synchronize the access to cache
-  static Mutex mx;
   // path => cache entry
-  static std::unordered_map<std::string, FileHashCache> cache;
-  // minheap on cache_access_time
-  static std::vector<FileHashCache*> lru;
-
-  WriteLock guard(mx);
+  static caches::ShardedCache<std::string, FileHashCache> cache(
+      FLAGS_hash_cache_max);
 
   struct stat st;
   if (stat(path.c_str(), &st) != 0) {
@@ -144,90 +300,180 @@ bool FileHashCache::load(const std::string& path,
     return false;
   }
 
-  auto entry = cache.find(path);
-  if (entry == cache.end()) { // none, load
-    if (cache.size() >= FLAGS_hash_cache_max) {
-      // too large, evict
-      for (size_t i = 0; i < kHashCacheEvictSize; ++i) {
-        if (lru.empty()) {
-          continue;
-        }
-        std::string key = lru[0]->path;
-        std::pop_heap(lru.begin(), lru.end(), FileHashCache::greater);
-        lru.pop_back();
-        if (cache.find(key) != cache.end()) {
-          cache.erase(key);
-        }
-      }
+  MultiHashes hashes = {};
+  auto entry = cache.get(path);
+  if (entry && !statInvalid(st, *entry)) {
+    if ((entry->hashes.mask & mask) == mask) {
+      // ok, got it
+      out = std::move(entry->hashes);
+      return true;
+    }
+
+    // Only the missing digests are calculated.
+    hashes = std::move(entry->hashes);
+  }
+
+  // Other files are hashed, or read from the cache, meanwhile.
+  if (FLAGS_hash_cache_database) {
+    // The stored hashes are purged in the background, not by the query.
+    static std::once_flag purging;
+    std::call_once(purging, []() {
+      Dispatcher::addService(std::make_shared<StoredHashesPurgeRunner>());
+    });
+
+    MultiHashes stored = {};
+    if (getStoredHashes(path, st, stored)) {
+      mergeHashes(hashes, stored);
     }
+  }
 
-    auto hashes = hashMultiFromFile(
-        HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
-    FileHashCache rec = {st.st_mtime, // .file_mtime
-                         st.st_ino, // .file_inode
-                         st.st_size, // .file_size
-                         time(nullptr), // .cache_access_time
-                         std::move(hashes), // .hashes
-                         path}; // .path
-    cache[path] = std::move(rec);
-    lru.push_back(&cache[path]);
-    std::push_heap(lru.begin(), lru.end(), FileHashCache::greater);
-    out = cache[path].hashes;
-  } else if (statInvalid(st, entry->second)) { // changed, update
-    auto hashes = hashMultiFromFile(
-        HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
-    entry->second.cache_access_time = time(nullptr);
-    entry->second.file_inode = st.st_ino;
-    entry->second.file_mtime = st.st_mtime;
-    entry->second.file_size = st.st_size;
-    entry->second.hashes = std::move(hashes);
-    std::make_heap(lru.begin(), lru.end(), FileHashCache::greater);
-    out = entry->second.hashes;
-  } else { // ok, got it
-    out = entry->second.hashes;
-    entry->second.cache_access_time = time(nullptr);
-    std::make_heap(lru.begin(), lru.end(), FileHashCache::greater);
+  auto missing = mask & ~hashes.mask;
+  if (missing != 0) {
+    auto computed = hashMultiFromFile(missing, path);
+    mergeHashes(hashes, computed);
+    if (FLAGS_hash_cache_database && computed.mask != 0) {
+      setStoredHashes(path, st, hashes);
+    }
   }
+
+  FileHashCache rec = {st.st_mtime, // .file_mtime
+                       st.st_ctime, // .file_ctime
+                       st.st_dev, // .file_device
+                       st.st_ino, // .file_inode
+                       st.st_size, // .file_size
+                       hashes}; // .hashes
+  cache.insert(path, std::move(rec));
+  out = std::move(hashes);
   return true;
 }
 
-void genHashForFile(const std::string& path,
-                    const std::string& dir,
-                    QueryContext& context,
-                    QueryData& results,
+bool loadFileHashes(const std::string& path,
+                    int mask,
+                    MultiHashes& out,
                     Logger& logger) {
-  // Must provide the path, filename, directory separate from boost path->string
-  // helpers to match any explicit (query-parsed) predicate constraints.
-  auto tr = TableRowHolder(new DynamicTableRow());
+  return FileHashCache::load(path, mask, out, logger);
+}
+
+/// A file of the hash table, hashed on a worker thread.
+struct HashTarget {
+  std::string path;
+
+  /// The row of an earlier hash of the path in the same query, if any.
+  TableRowHolder cached;
+
   MultiHashes hashes;
-  if (!FLAGS_disable_hash_cache) {
-    FileHashCache::load(path, hashes, logger);
-  } else {
-    if (context.isCached(path)) {
-      // Use the inner-query cache if the global hash cache is disabled.
-      // This protects against hashing the same content twice in the same query.
-      tr = context.getCache(path);
-    } else {
-      hashes = hashMultiFromFile(
-          HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
-      std::this_thread::sleep_for(std::chrono::milliseconds(FLAGS_hash_delay));
+
+  /// Set once hashed, a cancelled query leaves the later files unhashed.
+  bool hashed{false};
+};
+
+/// The files of a query, each hashed once, and the rows in query order.
+struct HashTargets {
+  std::vector<HashTarget> files;
+  std::unordered_map<std::string, size_t> indexes;
+
+  /// The file index and directory column of each row.
+  std::vector<std::pair<size_t, std::string>> rows;
+
+  void add(const std::string& path,
+           const std::string& directory,
+           QueryContext& context) {
+    auto it = indexes.find(path);
+    if (it == indexes.end()) {
+      HashTarget target;
+      target.path = path;
+      if (FLAGS_disable_hash_cache && context.isCached(path)) {
+        // Use the inner-query cache if the global hash cache is disabled.
+        // This protects against hashing the same content twice in the same
+        // query.
+        target.cached = context.getCache(path);
+      }
+      it = indexes.emplace(path, files.size()).first;
+      files.push_back(std::move(target));
     }
+    rows.emplace_back(it->second, directory);
   }
+};
 
-  DynamicTableRow& r = *dynamic_cast<DynamicTableRow*>(tr.get());
-  r["path"] = path;
-  r["directory"] = dir;
-  r["md5"] = std::move(hashes.md5);
-  r["sha1"] = std::move(hashes.sha1);
-  r["sha256"] = std::move(hashes.sha256);
+/// Files hashed before their rows are returned to the query.
+const size_t kHashBatchFiles{64};
+
+/// Receives each row of the hash table as it is generated.
+using HashRowCallback = std::function<void(TableRowHolder&&)>;
+
+/**
+ * @brief Hash the files in [begin, end) that have no cached row.
+ *
+ * Up to hash_concurrency threads hash the files.
+ */
+void hashFiles(std::vector<HashTarget>& files,
+               size_t begin,
+               size_t end,
+               int mask,
+               QueryContext& context,
+               Logger& logger) {
+  std::atomic<size_t> next{begin};
+  auto worker = [&files, end, mask, &context, &logger, &next]() {
+    for (auto i = next++; i < end; i = next++) {
+      if (context.isCancelled()) {
+        // Hashing many files may exceed a query budget.
+        return;
+      }
+
+      auto& file = files[i];
+      if (file.cached != nullptr || mask == 0) {
+        file.hashed = true;
+        continue;
+      }
+
+      if (!FLAGS_disable_hash_cache) {
+        FileHashCache::load(file.path, mask, file.hashes, logger);
+      } else {
+        file.hashes = hashMultiFromFile(mask, file.path);
+        std::this_thread::sleep_for(
+            std::chrono::milliseconds(FLAGS_hash_delay));
+      }
+      file.hashed = true;
+    }
+  };
 
-  if (FLAGS_disable_hash_cache) {
-    context.setCache(path, tr);
+  auto count = std::min<size_t>(
+      end - begin, std::max<uint32_t>(FLAGS_hash_concurrency, 1));
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < count; ++i) {
+    threads.emplace_back(worker);
   }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
 
-  r["pid_with_namespace"] = "0";
+void genHashRow(HashTarget& file,
+                const std::string& dir,
+                QueryContext& context,
+                const HashRowCallback& emit) {
+  // Must provide the path, filename, directory separate from boost path->string
+  // helpers to match any explicit (query-parsed) predicate constraints.
+  if (file.cached == nullptr) {
+    auto tr = TableRowHolder(new DynamicTableRow());
+    DynamicTableRow& r = *dynamic_cast<DynamicTableRow*>(tr.get());
+    r["path"] = file.path;
+    for (const auto& type : kHashTypeNames) {
+      r[type.second] = getHashDigest(file.hashes, type.first);
+    }
+    r["pid_with_namespace"] = "0";
+    file.cached = std::move(tr);
+
+    if (FLAGS_disable_hash_cache) {
+      context.setCache(file.path, file.cached);
+    }
+  }
 
-  results.push_back(static_cast<Row>(r));
+  auto tr = file.cached->clone();
+  DynamicTableRow& r = *dynamic_cast<DynamicTableRow*>(tr.get());
+  r["directory"] = dir;
+  emit(std::move(tr));
 }
 
 void expandFSPathConstraints(QueryContext& context,
@@ -250,9 +496,11 @@ void expandFSPathConstraints(QueryContext& context,
       }));
 }
 
-QueryData genHashImpl(QueryContext& context, Logger& logger) {
-  QueryData results;
+void genHashRows(QueryContext& context,
+                 Logger& logger,
+                 const HashRowCallback& emit) {
   boost::system::error_code ec;
+  HashTargets targets;
 
   // The query must provide a predicate with constraints including path or
   // directory. We search for the parsed predicate constraints with the equals
@@ -260,15 +508,14 @@ QueryData genHashImpl(QueryContext& context, Logger& logger) {
   auto paths = context.constraints["path"].getAll(EQUALS);
   expandFSPathConstraints(context, "path", paths);
 
-  // Iterate through the file paths, adding the hash results
+  // Iterate through the file paths, adding the hash targets
   for (const auto& path_string : paths) {
     boost::filesystem::path path = path_string;
     if (!boost::filesystem::is_regular_file(path, ec)) {
       continue;
     }
 
-    genHashForFile(
-        path_string, path.parent_path().string(), context, results, logger);
+    targets.add(path_string, path.parent_path().string(), context);
   }
 
   // Now loop through constraints using the directory column constraint.
@@ -282,27 +529,65 @@ QueryData genHashImpl(QueryContext& context, Logger& logger) {
       continue;
     }
 
-    // Iterate over the directory files and generate a hash for each regular
-    // file.
+    // Iterate over the directory files and add each regular file.
     boost::filesystem::directory_iterator begin(directory), end;
-    for (; begin != end; ++begin) {
+    for (; begin != end && !context.isCancelled(); ++begin) {
       if (boost::filesystem::is_regular_file(begin->path(), ec)) {
-        genHashForFile(
-            begin->path().string(), directory_string, context, results, logger);
+        targets.add(begin->path().string(), directory_string, context);
       }
     }
   }
 
+  // Only the digests of the selected columns are calculated.
+  int mask = 0;
+  for (const auto& type : kHashTypeNames) {
+    if (context.isColumnUsed(type.second)) {
+      mask |= type.first;
+    }
+  }
+
+  // Files are hashed in batches, returning each batch's rows before hashing
+  // the next. A file first appears in the rows after all files added before
+  // it, so the rows of hashed files are a prefix of those not yet returned.
+  auto row = targets.rows.begin();
+  for (size_t begin = 0; begin < targets.files.size();
+       begin += kHashBatchFiles) {
+    if (context.isCancelled()) {
+      break;
+    }
+
+    auto end = std::min(begin + kHashBatchFiles, targets.files.size());
+    hashFiles(targets.files, begin, end, mask, context, logger);
+    for (; row != targets.rows.end() && row->first < end; ++row) {
+      auto& file = targets.files[row->first];
+      if (file.hashed) {
+        genHashRow(file, row->second, context, emit);
+      }
+    }
+  }
+}
+
+QueryData genHashImpl(QueryContext& context, Logger& logger) {
+  QueryData results;
+  genHashRows(context, logger, [&results](TableRowHolder&& tr) {
+    auto& r = *dynamic_cast<DynamicTableRow*>(tr.get());
+    results.push_back(static_cast<Row>(r));
+  });
   return results;
 }
 
-QueryData genHash(QueryContext& context) {
+void genHash(RowYield& yield, QueryContext& context) {
   if (hasNamespaceConstraint(context)) {
-    return generateInNamespace(context, "hash", genHashImpl);
-  } else {
-    GLOGLogger logger;
-    return genHashImpl(context, logger);
+    // Rows of another mount namespace arrive together from the container.
+    for (auto& r : generateInNamespace(context, "hash", genHashImpl)) {
+      yield(TableRowHolder(new DynamicTableRow(std::move(r))));
+    }
+    return;
   }
+
+  GLOGLogger logger;
+  genHashRows(
+      context, logger, [&yield](TableRowHolder&& tr) { yield(std::move(tr)); });
 }
 } // namespace tables
 } // namespace osquery
@@ -0,0 +1,48 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <string>
+
+#include <osquery/hashing/hashing.h>
+#include <osquery/worker/logging/logger.h>
+
+namespace osquery {
+namespace tables {
+
+/**
+ * @brief Get the hashes of a file, reusing cached digests if it did not change.
+ *
+ * The in-memory cache is used first, then the kFileHashes database domain if
+ * hash_cache_database is set. Only the requested digests missing from both
+ * are calculated.
+ *
+ * @param path the path of file to hash.
+ * @param mask the requested digests.
+ * @param out stores the hashes.
+ *
+ * @return true if succeeded, false if the file could not be read.
+ */
+bool loadFileHashes(const std::string& path,
+                    int mask,
+                    MultiHashes& out,
+                    Logger& logger);
+
+/**
+ * @brief Delete stored hashes that can no longer be used.
+ *
+ * The hashes of removed or replaced files are deleted, then the least
+ * recently used hashes above hash_cache_database_max. Every stored file is
+ * checked, this runs on a background service.
+ */
+void purgeStoredHashes();
+
+} // namespace tables
+} // namespace osquery
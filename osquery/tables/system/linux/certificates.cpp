@@ -9,6 +9,7 @@
 
 #include <osquery/core/tables.h>
 #include <osquery/logger/logger.h>
+#include <osquery/tables/system/package_cache.h>
 #include <osquery/tables/system/posix/openssl_utils.h>
 #include <osquery/utils/expected/expected.h>
 
@@ -18,6 +19,8 @@
 
 #include <ctime>
 #include <filesystem>
+#include <map>
+#include <mutex>
 
 namespace osquery::tables {
 
@@ -236,6 +239,49 @@ Expected<CertificateInformationList, OpenSSLError> enumerateBundleCertificates(
   return parseX509InfoStack(std::move(x509_info_list));
 }
 
+/// Bundles kept before the cache is emptied, paths may come from queries.
+const std::size_t kMaxCachedBundles{64U};
+
+/// The certificates parsed from a bundle, kept until the file changes.
+struct CachedBundle final {
+  std::string signature;
+  CertificateInformationList cert_info_list;
+};
+
+std::mutex kBundleCacheMutex;
+std::map<std::string, CachedBundle> kBundleCache;
+
+Expected<CertificateInformationList, OpenSSLError> getBundleCertificates(
+    const std::filesystem::path& path) {
+  // The device, inode, size and modification time identify the file.
+  auto signature = getPathsSignature({path.string()});
+
+  {
+    std::lock_guard<std::mutex> lock(kBundleCacheMutex);
+    auto it = kBundleCache.find(path.string());
+    if (it != kBundleCache.end() && it->second.signature == signature) {
+      return it->second.cert_info_list;
+    }
+  }
+
+  auto exp_cert_info_list = enumerateBundleCertificates(path);
+  if (exp_cert_info_list.isError()) {
+    std::lock_guard<std::mutex> lock(kBundleCacheMutex);
+    kBundleCache.erase(path.string());
+    return exp_cert_info_list.takeError();
+  }
+
+  auto cert_info_list = exp_cert_info_list.take();
+
+  std::lock_guard<std::mutex> lock(kBundleCacheMutex);
+  if (kBundleCache.size() >= kMaxCachedBundles &&
+      kBundleCache.count(path.string()) == 0) {
+    kBundleCache.clear();
+  }
+  kBundleCache[path.string()] = {signature, cert_info_list};
+  return cert_info_list;
+}
+
 } // namespace
 
 QueryData genCerts(QueryContext& context) {
@@ -254,7 +300,7 @@ QueryData genCerts(QueryContext& context) {
   }
 
   for (const auto& bundle_path : bundle_path_list) {
-    auto exp_cert_info_list = enumerateBundleCertificates(bundle_path);
+    auto exp_cert_info_list = getBundleCertificates(bundle_path);
     if (exp_cert_info_list.isError()) {
       auto error = exp_cert_info_list.takeError();
       LOG(ERROR) << error.getMessage();
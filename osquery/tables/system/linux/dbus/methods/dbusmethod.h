@@ -12,6 +12,7 @@
 #include <osquery/logger/logger.h>
 #include <osquery/tables/system/linux/dbus/uniquedbusconnection.h>
 #include <osquery/tables/system/linux/dbus/uniquedbusmessage.h>
+#include <osquery/tables/system/linux/dbus/uniquedbuspendingcall.h>
 
 #include <dbus/dbus.h>
 
@@ -50,6 +51,67 @@ class DbusMethod final : public MethodHandler {
     return parseReply(output, reply);
   }
 
+  /**
+   * @brief Send the call without waiting for its reply.
+   *
+   * Several calls may be sent over the same connection before their replies
+   * are received with receive, so the bus processes them while the others
+   * are sent.
+   */
+  Status send(UniqueDbusPendingCall& pending_call,
+              const UniqueDbusConnection& connection,
+              const std::string& object_path,
+              ArgumentList... args) const {
+    pending_call.reset(nullptr);
+
+    UniqueDbusMessage message;
+    auto status = UniqueDbusMessage::create(message,
+                                            MethodHandler::kDestination,
+                                            object_path,
+                                            MethodHandler::kInterface,
+                                            MethodHandler::kMethod);
+    if (!status.ok()) {
+      return status;
+    }
+
+    processParameterList(message, args...);
+
+    return UniqueDbusPendingCall::create(
+        pending_call, connection.get(), message.get());
+  }
+
+  /// Wait for the reply of a call started with send.
+  Status receive(Output& output, UniqueDbusPendingCall& pending_call) const {
+    output = {};
+
+    if (!pending_call) {
+      return Status::failure("The call has not been sent");
+    }
+
+    dbus_pending_call_block(pending_call.get());
+    auto reply_ptr = dbus_pending_call_steal_reply(pending_call.get());
+    pending_call.reset(nullptr);
+
+    if (reply_ptr == nullptr) {
+      return Status::failure("Failed to receive the dbus reply");
+    }
+
+    UniqueDbusMessage reply;
+    reply.reset(reply_ptr);
+
+    DBusError error DBUS_ERROR_INIT;
+    if (dbus_set_error_from_message(&error, reply.get())) {
+      std::stringstream message;
+      message << "Failed to call the dbus method: " << error.message << " ("
+              << error.name << ")";
+
+      dbus_error_free(&error);
+      return Status::failure(message.str());
+    }
+
+    return parseReply(output, reply);
+  }
+
   DbusMethod() = default;
   virtual ~DbusMethod() override = default;
 
@@ -0,0 +1,64 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+
+#include <osquery/tables/system/linux/dbus/methods/getallproperties.h>
+
+namespace osquery {
+
+Status GetAllPropertiesMethodHandler::parseReply(
+    Output& output, const UniqueDbusMessage& reply) const {
+  output = {};
+
+  DBusMessageIter message_it{};
+  if (!dbus_message_iter_init(reply.get(), &message_it)) {
+    return Status::failure("Failed to initialize the field iterator");
+  }
+
+  if (dbus_message_iter_get_arg_type(&message_it) != DBUS_TYPE_ARRAY) {
+    return Status::failure(
+        "The method reply is encoded in an unexpected format");
+  }
+
+  // The properties are a dictionary of names and variants, a{sv}.
+  DBusMessageIter array_it{};
+  dbus_message_iter_recurse(&message_it, &array_it);
+
+  try {
+    while (dbus_message_iter_get_arg_type(&array_it) == DBUS_TYPE_DICT_ENTRY) {
+      DBusMessageIter entry_it{};
+      dbus_message_iter_recurse(&array_it, &entry_it);
+
+      std::string name = readDbusMessageStringField(entry_it, true);
+      if (dbus_message_iter_get_arg_type(&entry_it) != DBUS_TYPE_VARIANT) {
+        return Status::failure("Reply is in an unexpected format");
+      }
+
+      DBusMessageIter variant_it{};
+      dbus_message_iter_recurse(&entry_it, &variant_it);
+
+      // Other types are not used by the tables.
+      auto type = dbus_message_iter_get_arg_type(&variant_it);
+      if (type == DBUS_TYPE_STRING) {
+        output[name] = readDbusMessageStringField(variant_it, false);
+      } else if (type == DBUS_TYPE_OBJECT_PATH) {
+        output[name] = readDbusMessageObjectPathField(variant_it, false);
+      }
+
+      dbus_message_iter_next(&array_it);
+    }
+
+  } catch (const Status& status) {
+    return status;
+  }
+
+  return Status::success();
+}
+
+} // namespace osquery
@@ -0,0 +1,41 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+
+#pragma once
+
+#include <map>
+#include <string>
+
+#include <osquery/tables/system/linux/dbus/methods/dbusmethod.h>
+#include <osquery/utils/status/status.h>
+
+#include <dbus/dbus.h>
+
+namespace osquery {
+
+class GetAllPropertiesMethodHandler {
+ public:
+  constexpr static auto kDestination{"org.freedesktop.systemd1"};
+  constexpr static auto kInterface{"org.freedesktop.DBus.Properties"};
+  constexpr static auto kMethod{"GetAll"};
+
+  /// The string and object path properties of the interface, by name.
+  using Output = std::map<std::string, std::string>;
+  Status parseReply(Output& output, const UniqueDbusMessage& reply) const;
+
+ protected:
+  GetAllPropertiesMethodHandler() = default;
+  virtual ~GetAllPropertiesMethodHandler() = default;
+};
+
+using GetAllPropertiesMethod =
+    DbusMethod<GetAllPropertiesMethodHandler, const std::string&>;
+
+} // namespace osquery
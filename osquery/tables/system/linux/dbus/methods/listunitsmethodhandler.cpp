@@ -14,7 +14,7 @@ namespace osquery {
 namespace {
 
 // Make sure we have an upper limit so we don't risk infinite loops
-const std::size_t kMaxSystemdUnitCount{1000U};
+const std::size_t kMaxSystemdUnitCount{65536U};
 
 } // namespace
 
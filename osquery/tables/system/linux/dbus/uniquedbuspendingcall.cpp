@@ -0,0 +1,40 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+
+#include <osquery/tables/system/linux/dbus/uniquedbuspendingcall.h>
+
+namespace osquery {
+
+Status UniqueDbusPendingCallAllocator::allocate(
+    ResourceType& pending_call,
+    DBusConnection* const& connection,
+    DBusMessage* const& message) {
+  pending_call = nullptr;
+  if (!dbus_connection_send_with_reply(connection,
+                                       message,
+                                       &pending_call,
+                                       DBUS_TIMEOUT_USE_DEFAULT) ||
+      pending_call == nullptr) {
+    return Status::failure("Failed to send the dbus request");
+  }
+
+  return Status::success();
+}
+
+void UniqueDbusPendingCallAllocator::deallocate(ResourceType& pending_call) {
+  if (pending_call == nullptr) {
+    return;
+  }
+
+  dbus_pending_call_unref(pending_call);
+  pending_call = nullptr;
+}
+
+} // namespace osquery
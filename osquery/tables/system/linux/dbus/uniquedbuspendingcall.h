@@ -0,0 +1,37 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+
+#pragma once
+
+#include <osquery/tables/system/linux/dbus/uniqueresource.h>
+
+#include <dbus/dbus.h>
+
+namespace osquery {
+
+class UniqueDbusPendingCallAllocator {
+ protected:
+  using ResourceType = DBusPendingCall*;
+
+  UniqueDbusPendingCallAllocator() = default;
+  virtual ~UniqueDbusPendingCallAllocator() = default;
+
+  /// Send the message, the reply is received through the pending call.
+  static Status allocate(ResourceType& pending_call,
+                         DBusConnection* const& connection,
+                         DBusMessage* const& message);
+  static void deallocate(ResourceType& pending_call);
+};
+
+using UniqueDbusPendingCall = UniqueResource<UniqueDbusPendingCallAllocator,
+                                             DBusConnection*,
+                                             DBusMessage*>;
+
+} // namespace osquery
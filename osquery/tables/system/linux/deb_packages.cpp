@@ -7,9 +7,12 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <iterator>
+
 #include <osquery/core/system.h>
 #include <osquery/core/tables.h>
 #include <osquery/logger/logger.h>
+#include <osquery/tables/system/package_cache.h>
 #include <osquery/utils/linux/idpkgquery.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
 #include <osquery/worker/logging/glog/glog_logger.h>
@@ -64,6 +67,17 @@ QueryData genDebPackagesImpl(QueryContext& context, Logger& logger) {
   QueryData results;
 
   for (const auto& admindir : admindir_list) {
+    // libdpkg reads the packages from the status file of the admindir.
+    auto cache_key = "deb_packages:" + admindir;
+    auto signature = getPathsSignature({admindir, admindir + "/status"});
+    QueryData admindir_results;
+    if (PackageCache::get().lookup(cache_key, signature, admindir_results)) {
+      results.insert(results.end(),
+                     std::make_move_iterator(admindir_results.begin()),
+                     std::make_move_iterator(admindir_results.end()));
+      continue;
+    }
+
     auto dpkg_query_exp = IDpkgQuery::create(admindir);
     if (dpkg_query_exp.isError()) {
       logError(logger,
@@ -103,8 +117,13 @@ QueryData genDebPackagesImpl(QueryContext& context, Logger& logger) {
       r["admindir"] = admindir;
       r["pid_with_namespace"] = "0";
 
-      results.push_back(std::move(r));
+      admindir_results.push_back(std::move(r));
     }
+
+    PackageCache::get().store(cache_key, signature, admindir_results);
+    results.insert(results.end(),
+                   std::make_move_iterator(admindir_results.begin()),
+                   std::make_move_iterator(admindir_results.end()));
   }
 
   return results;
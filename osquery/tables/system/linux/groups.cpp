@@ -7,76 +7,58 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
-#include <set>
-
-#include <grp.h>
-
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
+#include <osquery/system/usersgroups/posix/users_groups_cache.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
-#include <osquery/worker/logging/glog/glog_logger.h>
 
 namespace osquery {
 namespace tables {
 
-void setGroupRow(Row& r, const group* grp) {
-  r["groupname"] = TEXT(grp->gr_name);
-  r["gid"] = INTEGER(grp->gr_gid);
-  r["gid_signed"] = INTEGER((int32_t)grp->gr_gid);
+void setGroupRow(Row& r, const GroupEntry& group) {
+  r["groupname"] = TEXT(group.groupname);
+  r["gid"] = INTEGER(group.gid);
+  r["gid_signed"] = INTEGER((int32_t)group.gid);
   r["pid_with_namespace"] = "0";
 }
 
-QueryData genGroupsImpl(QueryContext& context, Logger& logger) {
+QueryData genGroupsFrom(QueryContext& context, UsersGroupsCache& cache) {
   QueryData results;
-  struct group* grp_result{nullptr};
-  struct group grp;
-
-  size_t bufsize = sysconf(_SC_GETGR_R_SIZE_MAX);
-  if (bufsize > 16384) { /* Value was indeterminate */
-    bufsize = 16384; /* Should be more than enough */
-  }
-  auto buf = std::make_unique<char[]>(bufsize);
   if (context.constraints["gid"].exists(EQUALS)) {
     auto gids = context.constraints["gid"].getAll<long long>(EQUALS);
     for (const auto& gid : gids) {
-      getgrgid_r(gid, &grp, buf.get(), bufsize, &grp_result);
-      if (grp_result == nullptr) {
+      auto group = cache.getGroupByGid(static_cast<gid_t>(gid));
+      if (!group) {
         continue;
       }
 
       Row r;
-      setGroupRow(r, grp_result);
+      setGroupRow(r, *group);
       results.push_back(r);
     }
   } else {
-    std::set<long> groups_in;
-    setgrent();
-    while (1) {
-      getgrent_r(&grp, buf.get(), bufsize, &grp_result);
-      if (grp_result == nullptr) {
-        break;
-      }
-      if (std::find(groups_in.begin(), groups_in.end(), grp_result->gr_gid) ==
-          groups_in.end()) {
-        Row r;
-        setGroupRow(r, grp_result);
-        results.push_back(r);
-        groups_in.insert(grp_result->gr_gid);
-      }
+    // The enumeration lists each gid once.
+    for (const auto& group : cache.getGroups()) {
+      Row r;
+      setGroupRow(r, group);
+      results.push_back(r);
     }
-    endgrent();
-    groups_in.clear();
   }
 
   return results;
 }
 
+QueryData genGroupsImpl(QueryContext& context, Logger& logger) {
+  // Within the namespaces of a container the groups of the host do not apply.
+  UsersGroupsCache uncached(false);
+  return genGroupsFrom(context, uncached);
+}
+
 QueryData genGroups(QueryContext& context) {
   if (hasNamespaceConstraint(context)) {
     return generateInNamespace(context, "groups", genGroupsImpl);
   } else {
-    GLOGLogger logger;
-    return genGroupsImpl(context, logger);
+    return genGroupsFrom(context, UsersGroupsCache::get());
   }
 }
 } // namespace tables
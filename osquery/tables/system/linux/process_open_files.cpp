@@ -10,6 +10,7 @@
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
+#include <osquery/filesystem/linux/proc.h>
 #include <osquery/logger/logger.h>
 
 namespace osquery {
@@ -43,12 +44,19 @@ QueryData genOpenFiles(QueryContext& context) {
   if (context.constraints["pid"].exists(EQUALS)) {
     pids = context.constraints["pid"].getAll(EQUALS);
   } else {
-    osquery::procProcesses(pids);
+    // Every process is read, the walk is shared with the socket tables.
+    auto snapshot = procGetDescriptorSnapshot(TablePlugin::kCacheStep);
+    for (const auto& process : snapshot->descriptors) {
+      genDescriptors(process.first, process.second, results);
+    }
+    return results;
   }
 
+  ProcReader reader;
   for (const auto& process : pids) {
     std::map<std::string, std::string> descriptors;
-    if (osquery::procDescriptors(process, descriptors).ok()) {
+    if (reader.setProcess(process).ok() &&
+        reader.readDescriptors(descriptors).ok()) {
       genDescriptors(process, descriptors, results);
     }
   }
@@ -11,6 +11,7 @@
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
+#include <osquery/filesystem/linux/proc.h>
 #include <osquery/logger/logger.h>
 #include <regex>
 
@@ -195,23 +196,19 @@ void genResults(const std::string& process,
 
 QueryData genPipes(QueryContext& context) {
   QueryData results;
-  std::set<std::string> pids;
   PidToPipesMap pipe_desc;
   InodeToPipesMap pipe_partners;
   std::vector<std::unique_ptr<pipe_info>> pipe_structs;
 
-  osquery::procProcesses(pids);
-
-  for (const auto& process : pids) {
-    std::map<std::string, std::string> descriptors;
-    if (osquery::procDescriptors(process, descriptors).ok()) {
-      genPipePartners(
-          process, descriptors, pipe_desc, pipe_partners, pipe_structs);
-    }
+  // The walk of every descriptor is shared with the other process tables.
+  auto snapshot = procGetDescriptorSnapshot(TablePlugin::kCacheStep);
+  for (const auto& process : snapshot->descriptors) {
+    genPipePartners(
+        process.first, process.second, pipe_desc, pipe_partners, pipe_structs);
   }
 
-  for (const auto& process : pids) {
-    genResults(process, pipe_desc, pipe_partners, results);
+  for (const auto& process : snapshot->descriptors) {
+    genResults(process.first, pipe_desc, pipe_partners, results);
   }
 
   return results;
@@ -7,9 +7,21 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <iterator>
 #include <map>
-#include <regex>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <stdlib.h>
 #include <sys/stat.h>
@@ -22,10 +34,13 @@
 #include <boost/noncopyable.hpp>
 
 #include <osquery/core/core.h>
+#include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
+#include <osquery/events/linux/process_changes.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/filesystem/linux/proc.h>
 #include <osquery/logger/logger.h>
+#include <osquery/rows/processes.h>
 #include <osquery/sql/dynamic_table_row.h>
 #include <osquery/tables/system/linux/processes.h>
 #include <osquery/utils/conversions/split.h>
@@ -34,20 +49,226 @@
 #include <ctime>
 
 namespace osquery {
+
+FLAG(uint32,
+     processes_concurrency,
+     0,
+     "Number of threads reading /proc for the processes table (0 for one per "
+     "core)");
+
+FLAG(bool,
+     processes_exec_cache,
+     false,
+     "Keep the columns of processes set by exec between queries of the "
+     "processes table, requires process_events or bpf_process_events");
+
+FLAG(uint32,
+     processes_reconcile_interval,
+     60,
+     "Seconds before the processes table reads the cached columns of a "
+     "process again");
+
 namespace tables {
 
 const int kMSIn1CLKTCK = (1000 / sysconf(_SC_CLK_TCK));
 
+/// Pids read by a thread at once, the rows of a chunk keep the pid order.
+const size_t kProcessChunkSize{64};
+
 inline std::string getProcAttr(const std::string& attr,
                                const std::string& pid) {
   return "/proc/" + pid + "/" + attr;
 }
 
-inline std::string readProcCMDLine(const std::string& pid) {
-  auto attr = getProcAttr("cmdline", pid);
+/// Take the next field of content up to delim, skipping repeated delimiters.
+std::string_view nextProcField(std::string_view& content, char delim) {
+  auto start = content.find_first_not_of(delim);
+  if (start == std::string_view::npos) {
+    content = std::string_view();
+    return content;
+  }
+
+  content.remove_prefix(start);
+  auto end = content.find(delim);
+  auto field = content.substr(0, end);
+  content.remove_prefix((end == std::string_view::npos) ? content.size()
+                                                        : end + 1);
+  return field;
+}
+
+/// Take the next line of content.
+std::string_view nextProcLine(std::string_view& content) {
+  auto end = content.find('\n');
+  auto line = content.substr(0, end);
+  content.remove_prefix((end == std::string_view::npos) ? content.size()
+                                                        : end + 1);
+  return line;
+}
+
+std::string_view trimProcValue(std::string_view value) {
+  auto start = value.find_first_not_of(" \t");
+  if (start == std::string_view::npos) {
+    return std::string_view();
+  }
+  auto end = value.find_last_not_of(" \t");
+  return value.substr(start, end - start + 1);
+}
+
+/// Convert a "<size> kB" status value to bytes.
+bool parseProcKilobytes(std::string_view value, std::string& bytes) {
+  uint64_t size = 0;
+  size_t i = 0;
+  for (; i < value.size() && value[i] >= '0' && value[i] <= '9'; ++i) {
+    size = size * 10 + static_cast<uint64_t>(value[i] - '0');
+  }
+  if (i == 0) {
+    return false;
+  }
+
+  // Memory is reported in kB (1024 bytes).
+  bytes = std::to_string(size * 1024);
+  return true;
+}
+
+/// Parse the real, effective and saved ids of a Uid or Gid status value.
+void parseProcIds(std::string_view value,
+                  std::string& real,
+                  std::string& effective,
+                  std::string& saved) {
+  // Format is: R E S FS
+  std::string_view ids[4];
+  for (auto& id : ids) {
+    id = nextProcField(value, '\t');
+    if (id.empty()) {
+      return;
+    }
+  }
+  real.assign(ids[0]);
+  effective.assign(ids[1]);
+  saved.assign(ids[2]);
+}
+
+Status parseProcStat(std::string_view content, SimpleProcStat& stat) {
+  auto start = content.rfind(')');
+  // Start parsing stats from ") <MODE>..."
+  if (start == std::string_view::npos || content.size() <= start + 2) {
+    return Status(1, "Invalid /proc/stat header");
+  }
+  content.remove_prefix(start + 2);
+
+  // Fields following the name, up to the start time.
+  std::string_view details[20];
+  for (auto& detail : details) {
+    detail = nextProcField(content, ' ');
+    if (detail.empty()) {
+      return Status(1, "Invalid /proc/stat content");
+    }
+  }
+
+  stat.state.assign(details[0]);
+  stat.parent.assign(details[1]);
+  stat.group.assign(details[2]);
+  stat.user_time.assign(details[11]);
+  stat.system_time.assign(details[12]);
+  stat.nice.assign(details[16]);
+  stat.threads.assign(details[17]);
+  stat.start_time.assign(details[19]);
+  return Status::success();
+}
+
+Status parseProcStatus(std::string_view content, SimpleProcStat& stat) {
+  while (!content.empty()) {
+    // Status lines are formatted: Key: Value....\n.
+    auto line = nextProcLine(content);
+    auto colon = line.find(':');
+    if (colon == std::string_view::npos) {
+      continue;
+    }
+
+    // There are specific fields from each detail.
+    auto key = line.substr(0, colon);
+    auto value = trimProcValue(line.substr(colon + 1));
+    if (key == "Name") {
+      stat.name.assign(value);
+    } else if (key == "VmRSS") {
+      if (!parseProcKilobytes(value, stat.resident_size)) {
+        return Status::failure(
+            "Failed to convert VmRSS string value to integer");
+      }
+    } else if (key == "VmSize") {
+      if (!parseProcKilobytes(value, stat.total_size)) {
+        return Status::failure(
+            "Failed to convert VmSize string value to integer");
+      }
+    } else if (key == "Gid") {
+      parseProcIds(
+          value, stat.real_gid, stat.effective_gid, stat.saved_gid);
+    } else if (key == "Uid") {
+      parseProcIds(
+          value, stat.real_uid, stat.effective_uid, stat.saved_uid);
+    }
+  }
+  return Status::success();
+}
+
+void parseProcIo(std::string_view content, SimpleProcIo& io) {
+  while (!content.empty()) {
+    // IO lines are formatted: Key: Value....\n.
+    auto line = nextProcLine(content);
+    auto colon = line.find(':');
+    if (colon == std::string_view::npos) {
+      continue;
+    }
 
+    auto key = line.substr(0, colon);
+    auto value = trimProcValue(line.substr(colon + 1));
+    if (key == "read_bytes") {
+      io.read_bytes.assign(value);
+    } else if (key == "write_bytes") {
+      io.write_bytes.assign(value);
+    } else if (key == "cancelled_write_bytes") {
+      io.cancelled_write_bytes.assign(value);
+    }
+  }
+}
+
+bool parseProcMapLine(std::string_view line, ProcMapEntry& entry) {
+  // Map lines are formatted: start-end perms offset device inode path.
+  auto addresses = nextProcField(line, ' ');
+  auto dash = addresses.find('-');
+  if (dash == std::string_view::npos) {
+    return false;
+  }
+  entry.start = addresses.substr(0, dash);
+  entry.end = addresses.substr(dash + 1);
+
+  entry.permissions = nextProcField(line, ' ');
+  entry.offset = nextProcField(line, ' ');
+  entry.device = nextProcField(line, ' ');
+  entry.inode = nextProcField(line, ' ');
+  if (entry.inode.empty()) {
+    return false;
+  }
+
+  // The path is padded with spaces, and may contain spaces.
+  entry.path = trimProcValue(line);
+  return true;
+}
+
+std::string_view findProcMapInode(std::string_view content,
+                                  std::string_view path) {
+  ProcMapEntry entry;
+  while (!content.empty()) {
+    if (parseProcMapLine(nextProcLine(content), entry) && entry.path == path) {
+      return entry.inode;
+    }
+  }
+  return std::string_view();
+}
+
+inline std::string readProcCMDLine(ProcReader& reader) {
   std::string content;
-  readFile(attr, content);
+  reader.read("cmdline", content);
   // Remove \0 delimiters.
   std::replace_if(
       content.begin(),
@@ -80,66 +301,40 @@ std::string parseProcCGroup(const std::string& content) {
   }
 }
 
-inline std::string readProcCgroup(const std::string& pid) {
-  auto attr = getProcAttr("cgroup", pid);
-
+inline std::string readProcCgroup(ProcReader& reader) {
   std::string content;
-  if (!readFile(attr, content).ok()) {
+  if (!reader.read("cgroup", content).ok()) {
     return {};
   };
   return parseProcCGroup(content);
 }
 
-inline std::string readProcLink(const std::string& attr,
-                                const std::string& pid) {
+inline std::string readProcLink(ProcReader& reader, const std::string& attr) {
   // The exe is a symlink to the binary on-disk.
-  auto attr_path = getProcAttr(attr, pid);
-
-  std::string result = "";
-  struct stat sb;
-  if (lstat(attr_path.c_str(), &sb) != -1) {
-    // Some symlinks may report 'st_size' as zero
-    // Use PATH_MAX as best guess
-    // For cases when 'st_size' is not zero but smaller than
-    // PATH_MAX we will still use PATH_MAX to minimize chance
-    // of output trucation during race condition
-    ssize_t buf_size = sb.st_size < PATH_MAX ? PATH_MAX : sb.st_size;
-    // +1 for \0, since readlink does not append a null
-    char* linkname = static_cast<char*>(malloc(buf_size + 1));
-    ssize_t r = readlink(attr_path.c_str(), linkname, buf_size);
-
-    if (r > 0) { // Success check
-      // r may not be equal to buf_size
-      // if r == buf_size there was race condition
-      // and link is longer than buf_size and because of this
-      // truncated
-      linkname[r] = '\0';
-      result = std::string(linkname);
-    }
-    free(linkname);
-  }
-
+  std::string result;
+  reader.readLink(attr, result);
   return result;
 }
 
 // In the case where the linked binary path ends in " (deleted)", and a file
 // actually exists at that path, check whether the inode of that file matches
 // the inode of the mapped file in /proc/%pid/maps
-Status deletedMatchesInode(const std::string& path, const std::string& pid) {
-  const std::string maps_path = getProcAttr("maps", pid);
-  std::string maps_contents;
-  auto s = osquery::readFile(maps_path, maps_contents);
+Status deletedMatchesInode(const std::string& path,
+                           const std::string& pid,
+                           ProcReader& reader) {
+  std::string_view maps_contents;
+  auto s = reader.read("maps", maps_contents);
   if (!s.ok()) {
-    return Status(-1, "Cannot read maps file: " + maps_path);
+    return Status(-1, "Cannot read maps file: " + getProcAttr("maps", pid));
   }
 
   // Extract the expected inode of the binary file from /proc/%pid/maps
-  std::smatch what;
-  std::regex expression("([0-9]+)\\h+\\Q" + path + "\\E");
-  if (!std::regex_search(maps_contents, what, expression)) {
-    return Status(-1, "Could not find binary inode in maps file: " + maps_path);
+  auto inode = findProcMapInode(maps_contents, path);
+  if (inode.empty()) {
+    return Status(-1,
+                  "Could not find binary inode in maps file: " +
+                      getProcAttr("maps", pid));
   }
-  std::string inode = what[1];
 
   // stat the file at the expected binary path
   struct stat st;
@@ -171,11 +366,11 @@ std::set<std::string> getProcList(const QueryContext& context) {
   return pidlist;
 }
 
-void genProcessEnvironment(const std::string& pid, QueryData& results) {
-  auto attr = getProcAttr("environ", pid);
-
+void genProcessEnvironment(const std::string& pid,
+                           ProcReader& reader,
+                           QueryData& results) {
   std::string content;
-  readFile(attr, content);
+  reader.read("environ", content);
   const char* variable = content.c_str();
 
   // Stop at the end of nul-delimited string content.
@@ -192,205 +387,71 @@ void genProcessEnvironment(const std::string& pid, QueryData& results) {
   }
 }
 
-void genProcessMap(const std::string& pid, QueryData& results) {
-  auto map = getProcAttr("maps", pid);
-
-  std::string content;
-  readFile(map, content);
-  for (auto& line : osquery::split(content, "\n")) {
-    auto fields = osquery::split(line, " ");
-    // If can't read address, not sure.
-    if (fields.size() < 5) {
-      continue;
-    }
-
-    Row r;
-    r["pid"] = pid;
-    if (!fields[0].empty()) {
-      auto addresses = osquery::split(fields[0], "-");
-      if (addresses.size() >= 2) {
-        r["start"] = "0x" + addresses[0];
-        r["end"] = "0x" + addresses[1];
-      } else {
-        // Problem with the address format.
-        continue;
-      }
-    }
-
-    r["permissions"] = fields[1];
-    auto offset = tryTo<long long>(fields[2], 16);
-    r["offset"] = BIGINT((offset) ? offset.take() : -1);
-    r["device"] = fields[3];
-    r["inode"] = fields[4];
-
-    // Path name must be trimmed.
-    if (fields.size() > 5) {
-      boost::trim(fields[5]);
-      r["path"] = fields[5];
-    }
-
-    // BSS with name in pathname.
-    r["pseudo"] = (fields[4] == "0" && !r["path"].empty()) ? "1" : "0";
-    results.push_back(std::move(r));
+/// The paths allowed by the constraints of the path column.
+/// Compare the start of a path to a prefix without ASCII case.
+static bool startsWithNoCase(std::string_view path, const std::string& prefix) {
+  if (path.size() < prefix.size()) {
+    return false;
   }
+  return std::equal(
+      prefix.begin(), prefix.end(), path.begin(), [](char a, char b) {
+        return std::tolower(static_cast<unsigned char>(a)) ==
+               std::tolower(static_cast<unsigned char>(b));
+      });
 }
 
-/**
- *  Output from string parsing /proc/<pid>/status.
- */
-struct SimpleProcStat : private boost::noncopyable {
- public:
-  std::string name;
-  std::string real_uid;
-  std::string real_gid;
-  std::string effective_uid;
-  std::string effective_gid;
-  std::string saved_uid;
-  std::string saved_gid;
-  std::string resident_size;
-  std::string total_size;
-  std::string state;
-  std::string parent;
-  std::string group;
-  std::string nice;
-  std::string threads;
-  std::string user_time;
-  std::string system_time;
-  std::string start_time;
-
-  /// For errors processing proc data.
-  Status status;
-
-  explicit SimpleProcStat(const std::string& pid);
-};
-
-SimpleProcStat::SimpleProcStat(const std::string& pid) {
-  std::string content;
-  if (readFile(getProcAttr("stat", pid), content).ok()) {
-    auto start = content.find_last_of(")");
-    // Start parsing stats from ") <MODE>..."
-    if (start == std::string::npos || content.size() <= start + 2) {
-      status = Status(1, "Invalid /proc/stat header");
-      return;
-    }
-
-    auto details = osquery::split(content.substr(start + 2), " ");
-    if (details.size() <= 19) {
-      status = Status(1, "Invalid /proc/stat content");
-      return;
-    }
-
-    this->state = details.at(0);
-    this->parent = details.at(1);
-    this->group = details.at(2);
-    this->user_time = details.at(11);
-    this->system_time = details.at(12);
-    this->nice = details.at(16);
-    this->threads = details.at(17);
-    this->start_time = details.at(19);
-  }
-
-  // /proc/N/status may be not available, or readable by this user.
-  if (!readFile(getProcAttr("status", pid), content).ok()) {
-    status = Status(1, "Cannot read /proc/status");
-    return;
+bool ProcMapPathFilter::matches(std::string_view path) const {
+  if (!values.empty() && values.count(std::string(path)) == 0) {
+    return false;
   }
-
-  for (const auto& line : osquery::split(content, "\n")) {
-    // Status lines are formatted: Key: Value....\n.
-    auto detail = osquery::split(line, ':', 1);
-    if (detail.size() != 2) {
-      continue;
-    }
-
-    // There are specific fields from each detail.
-    if (detail.at(0) == "Name") {
-      this->name = detail.at(1);
-    } else if (detail.at(0) == "VmRSS") {
-      detail[1].erase(detail.at(1).end() - 3, detail.at(1).end());
-      // Memory is reported in kB (1024 bytes).
-      auto resident_size_result = osquery::tryTo<std::uint64_t>(detail.at(1));
-
-      if (resident_size_result.isError()) {
-        status =
-            Status::failure("Failed to convert VmRSS string value to integer");
-        return;
-      }
-
-      const auto resident_size = resident_size_result.get() * 1024;
-
-      this->resident_size = std::to_string(resident_size);
-    } else if (detail.at(0) == "VmSize") {
-      detail[1].erase(detail.at(1).end() - 3, detail.at(1).end());
-      // Memory is reported in kB (1024 bytes).
-      auto virtual_size_result = osquery::tryTo<std::uint64_t>(detail.at(1));
-
-      if (virtual_size_result.isError()) {
-        status =
-            Status::failure("Failed to convert VmSize string value to integer");
-        return;
-      }
-
-      const auto virtual_size = virtual_size_result.get() * 1024;
-
-      this->total_size = std::to_string(virtual_size);
-    } else if (detail.at(0) == "Gid") {
-      // Format is: R E - -
-      auto gid_detail = osquery::split(detail.at(1), "\t");
-      if (gid_detail.size() == 4) {
-        this->real_gid = gid_detail.at(0);
-        this->effective_gid = gid_detail.at(1);
-        this->saved_gid = gid_detail.at(2);
-      }
-    } else if (detail.at(0) == "Uid") {
-      auto uid_detail = osquery::split(detail.at(1), "\t");
-      if (uid_detail.size() == 4) {
-        this->real_uid = uid_detail.at(0);
-        this->effective_uid = uid_detail.at(1);
-        this->saved_uid = uid_detail.at(2);
-      }
+  // Every constraint must hold.
+  for (const auto& prefix : prefixes) {
+    if (!startsWithNoCase(path, prefix)) {
+      return false;
     }
   }
+  return true;
 }
 
-/**
- * Output from string parsing /proc/<pid>/io.
- */
-struct SimpleProcIo : private boost::noncopyable {
- public:
-  std::string read_bytes;
-  std::string write_bytes;
-  std::string cancelled_write_bytes;
-
-  /// For errors processing proc data.
-  Status status;
-
-  explicit SimpleProcIo(const std::string& pid);
-};
-
-SimpleProcIo::SimpleProcIo(const std::string& pid) {
-  std::string content;
-  if (!readFile(getProcAttr("io", pid), content).ok()) {
-    status = Status(
-        1, "Cannot read /proc/" + pid + "/io (is osquery running as root?)");
+void genProcessMap(const std::string& pid,
+                   ProcReader& reader,
+                   const ProcMapPathFilter& filter,
+                   RowYield& yield) {
+  // The content is parsed in place, only the selected mappings are copied.
+  std::string_view content;
+  if (!reader.read("maps", content).ok()) {
     return;
   }
 
-  for (const auto& line : osquery::split(content, "\n")) {
-    // IO lines are formatted: Key: Value....\n.
-    auto detail = osquery::split(line, ':', 1);
-    if (detail.size() != 2) {
+  ProcMapEntry entry;
+  while (!content.empty()) {
+    if (!parseProcMapLine(nextProcLine(content), entry) ||
+        !filter.matches(entry.path)) {
       continue;
     }
 
-    // There are specific fields from each detail
-    if (detail.at(0) == "read_bytes") {
-      this->read_bytes = detail.at(1);
-    } else if (detail.at(0) == "write_bytes") {
-      this->write_bytes = detail.at(1);
-    } else if (detail.at(0) == "cancelled_write_bytes") {
-      this->cancelled_write_bytes = detail.at(1);
+    long long offset = -1;
+    auto result = std::from_chars(entry.offset.data(),
+                                  entry.offset.data() + entry.offset.size(),
+                                  offset,
+                                  16);
+    if (result.ec != std::errc()) {
+      offset = -1;
     }
+
+    auto r = make_table_row();
+    r["pid"] = pid;
+    r["start"] = "0x" + std::string(entry.start);
+    r["end"] = "0x" + std::string(entry.end);
+    r["permissions"] = std::string(entry.permissions);
+    r["offset"] = BIGINT(offset);
+    r["device"] = std::string(entry.device);
+    r["inode"] = std::string(entry.inode);
+    r["path"] = std::string(entry.path);
+
+    // BSS with name in pathname.
+    r["pseudo"] = (entry.inode == "0" && !entry.path.empty()) ? "1" : "0";
+    yield(std::move(r));
   }
 }
 
@@ -404,11 +465,12 @@ SimpleProcIo::SimpleProcIo(const std::string& pid) {
  * to 0.
  *
  * @param pid The string (because we're referencing file path) pid.
+ * @param reader Reads the attributes of the process.
  * @param path A mutable string found from /proc/N/exe. If this is found
  *             to contain the (deleted) suffix, it will be removed.
  * @return A tristate -1 error, 1 yes, 0 nope.
  */
-int getOnDisk(const std::string& pid, std::string& path) {
+int getOnDisk(const std::string& pid, ProcReader& reader, std::string& path) {
   if (path.empty()) {
     return -1;
   }
@@ -430,7 +492,7 @@ int getOnDisk(const std::string& pid, std::string& path) {
   // process is actually running from a binary file ending with
   // " (deleted)". See #1607
   std::string maps_contents;
-  Status deleted = deletedMatchesInode(path, pid);
+  Status deleted = deletedMatchesInode(path, pid, reader);
   if (deleted.getCode() == -1) {
     LOG(ERROR) << deleted.getMessage();
     return -1;
@@ -446,86 +508,279 @@ int getOnDisk(const std::string& pid, std::string& path) {
   }
 }
 
+/// The columns of a process set by exec, kept between queries.
+struct ProcessExecColumns {
+  /// The start time of the process, a reused pid has another.
+  std::string start_time;
+
+  std::string cmdline;
+  std::string cgroup_path;
+  std::string cwd;
+  std::string root;
+  std::string path;
+  int on_disk{-1};
+
+  std::chrono::steady_clock::time_point read_time;
+};
+
+/**
+ * @brief The exec columns of the processes read by the last queries.
+ *
+ * The process event subscribers report the processes that executed a
+ * binary, their columns are read again. The columns also changed by other
+ * calls, such as the cwd, are read again after the reconcile interval.
+ */
+class ProcessExecCache : private boost::noncopyable {
+ public:
+  static ProcessExecCache& get() {
+    static ProcessExecCache cache;
+    return cache;
+  }
+
+  /**
+   * @brief Drop the processes that executed or exited since the last query.
+   *
+   * @param pids The processes of the query.
+   * @param all_pids If pids lists every process of the host.
+   * @return false if the execs are not tracked, the cache is not used.
+   */
+  bool update(const std::vector<std::string>& pids, bool all_pids) {
+    std::set<std::uint64_t> changed;
+    auto complete = ProcessChanges::get().take(changed);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!ProcessChanges::get().isTracked()) {
+      processes_.clear();
+      return false;
+    }
+
+    if (!complete) {
+      processes_.clear();
+      return true;
+    }
+
+    for (const auto& pid : changed) {
+      processes_.erase(std::to_string(pid));
+    }
+
+    if (all_pids) {
+      std::unordered_set<std::string> running(pids.begin(), pids.end());
+      for (auto it = processes_.begin(); it != processes_.end();) {
+        it = (running.count(it->first) == 0) ? processes_.erase(it)
+                                             : std::next(it);
+      }
+    }
+    return true;
+  }
+
+  /// Get the columns of a process if they are still valid.
+  bool lookup(const std::string& pid,
+              const std::string& start_time,
+              ProcessExecColumns& columns) {
+    auto reconcile = std::chrono::seconds(FLAGS_processes_reconcile_interval);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = processes_.find(pid);
+    if (it == processes_.end() || it->second.start_time != start_time ||
+        std::chrono::steady_clock::now() - it->second.read_time >= reconcile) {
+      return false;
+    }
+
+    columns = it->second;
+    return true;
+  }
+
+  void store(const std::string& pid, const ProcessExecColumns& columns) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    processes_[pid] = columns;
+  }
+
+ private:
+  std::mutex mutex_;
+
+  std::unordered_map<std::string, ProcessExecColumns> processes_;
+};
+
+/// Read the exec columns of the used column groups, or all of them.
+void readProcessExecColumns(const std::string& pid,
+                            ProcReader& reader,
+                            const QueryContext& context,
+                            bool all,
+                            ProcessExecColumns& columns) {
+  // Read/parse cmdline arguments.
+  if (all || context.isColumnGroupUsed("cmdline")) {
+    columns.cmdline = readProcCMDLine(reader);
+  }
+  if (all || context.isColumnGroupUsed("cgroup")) {
+    columns.cgroup_path = readProcCgroup(reader);
+  }
+  if (all || context.isColumnGroupUsed("cwd")) {
+    columns.cwd = readProcLink(reader, "cwd");
+  }
+  if (all || context.isColumnGroupUsed("root")) {
+    columns.root = readProcLink(reader, "root");
+  }
+  if (all || context.isColumnGroupUsed("exe")) {
+    columns.path = readProcLink(reader, "exe");
+    columns.on_disk = getOnDisk(pid, reader, columns.path);
+  }
+  columns.read_time = std::chrono::steady_clock::now();
+}
+
+/// Set a numeric column of a process row, or NULL if it is not a number.
+template <typename T>
+void setProcessColumn(ProcessesRow& r,
+                      ProcessesRow::Column column,
+                      T& field,
+                      const std::string& value) {
+  auto number = tryTo<long long>(value, 10);
+  if (number.isValue()) {
+    field = static_cast<T>(number.take());
+  } else {
+    r.null_columns |= column;
+  }
+}
+
 void genProcess(const std::string& pid,
                 std::uint64_t system_boot_time,
+                ProcReader& reader,
                 QueryContext& context,
+                bool exec_cache,
                 TableRows& results) {
-  // Parse the process stat and status.
-  SimpleProcStat proc_stat(pid);
-  // Parse the process io
-  SimpleProcIo proc_io(pid);
+  // Parse the process stat and status, in place in the reader buffer.
+  SimpleProcStat proc_stat;
+  std::string_view content;
+  if (reader.read("stat", content).ok()) {
+    auto status = parseProcStat(content, proc_stat);
+    if (!status.ok()) {
+      VLOG(1) << status.getMessage() << " for pid " << pid;
+      return;
+    }
+  }
 
-  if (!proc_stat.status.ok()) {
-    VLOG(1) << proc_stat.status.getMessage() << " for pid " << pid;
+  // /proc/N/status may be not available, or readable by this user.
+  if (!reader.read("status", content).ok()) {
+    VLOG(1) << "Cannot read /proc/status for pid " << pid;
     return;
   }
 
-  auto r = make_table_row();
-  r["pid"] = pid;
-  r["parent"] = proc_stat.parent;
-  r["path"] = readProcLink("exe", pid);
-  r["name"] = proc_stat.name;
-  r["pgroup"] = proc_stat.group;
-  r["state"] = proc_stat.state;
-  r["nice"] = proc_stat.nice;
-  r["threads"] = proc_stat.threads;
-  // Read/parse cmdline arguments.
-  r["cmdline"] = readProcCMDLine(pid);
-  if (context.isColumnUsed("cgroup_path")) {
-    r["cgroup_path"] = readProcCgroup(pid);
+  auto status = parseProcStatus(content, proc_stat);
+  if (!status.ok()) {
+    VLOG(1) << status.getMessage() << " for pid " << pid;
+    return;
   }
-  r["cwd"] = readProcLink("cwd", pid);
-  r["root"] = readProcLink("root", pid);
-  r["uid"] = proc_stat.real_uid;
-  r["euid"] = proc_stat.effective_uid;
-  r["suid"] = proc_stat.saved_uid;
-  r["gid"] = proc_stat.real_gid;
-  r["egid"] = proc_stat.effective_gid;
-  r["sgid"] = proc_stat.saved_gid;
 
-  r["on_disk"] = INTEGER(getOnDisk(pid, r["path"]));
+  // Each column group below is read from /proc only when it is used.
+  // The row holds native values, which are handed to SQLite without being
+  // formatted and parsed back from strings.
+  auto r = std::make_unique<ProcessesRow>();
+  setProcessColumn(*r, ProcessesRow::PID, r->pid_col, pid);
+  setProcessColumn(*r, ProcessesRow::PARENT, r->parent_col, proc_stat.parent);
+  r->name_col = proc_stat.name;
+  setProcessColumn(*r, ProcessesRow::PGROUP, r->pgroup_col, proc_stat.group);
+  r->state_col = proc_stat.state;
+  setProcessColumn(*r, ProcessesRow::NICE, r->nice_col, proc_stat.nice);
+  setProcessColumn(
+      *r, ProcessesRow::THREADS, r->threads_col, proc_stat.threads);
+
+  // A cached process has all its exec columns, a read one may be cached.
+  ProcessExecColumns exec;
+  exec_cache = exec_cache && !proc_stat.start_time.empty();
+  if (!exec_cache ||
+      !ProcessExecCache::get().lookup(pid, proc_stat.start_time, exec)) {
+    readProcessExecColumns(pid, reader, context, exec_cache, exec);
+    if (exec_cache) {
+      exec.start_time = proc_stat.start_time;
+      ProcessExecCache::get().store(pid, exec);
+    }
+  }
+
+  if (context.isColumnGroupUsed("cmdline")) {
+    r->cmdline_col = exec.cmdline;
+  }
+  if (context.isColumnGroupUsed("cgroup")) {
+    r->cgroup_path_col = exec.cgroup_path;
+  }
+  if (context.isColumnGroupUsed("cwd")) {
+    r->cwd_col = exec.cwd;
+  }
+  if (context.isColumnGroupUsed("root")) {
+    r->root_col = exec.root;
+  }
+  setProcessColumn(*r, ProcessesRow::UID, r->uid_col, proc_stat.real_uid);
+  setProcessColumn(
+      *r, ProcessesRow::EUID, r->euid_col, proc_stat.effective_uid);
+  setProcessColumn(*r, ProcessesRow::SUID, r->suid_col, proc_stat.saved_uid);
+  setProcessColumn(*r, ProcessesRow::GID, r->gid_col, proc_stat.real_gid);
+  setProcessColumn(
+      *r, ProcessesRow::EGID, r->egid_col, proc_stat.effective_gid);
+  setProcessColumn(*r, ProcessesRow::SGID, r->sgid_col, proc_stat.saved_gid);
+
+  if (context.isColumnGroupUsed("exe")) {
+    r->path_col = exec.path;
+    r->on_disk_col = exec.on_disk;
+  } else {
+    r->null_columns |= ProcessesRow::ON_DISK;
+  }
 
   // size/memory information
-  r["wired_size"] = "0"; // No support for unpagable counters in linux.
-  r["resident_size"] = proc_stat.resident_size;
-  r["total_size"] = proc_stat.total_size;
+  r->wired_size_col = 0; // No support for unpagable counters in linux.
+  setProcessColumn(*r,
+                   ProcessesRow::RESIDENT_SIZE,
+                   r->resident_size_col,
+                   proc_stat.resident_size);
+  setProcessColumn(
+      *r, ProcessesRow::TOTAL_SIZE, r->total_size_col, proc_stat.total_size);
 
   // time information
   auto usr_time = std::strtoull(proc_stat.user_time.data(), nullptr, 10);
-  r["user_time"] = std::to_string(usr_time * kMSIn1CLKTCK);
+  r->user_time_col = usr_time * kMSIn1CLKTCK;
   auto sys_time = std::strtoull(proc_stat.system_time.data(), nullptr, 10);
-  r["system_time"] = std::to_string(sys_time * kMSIn1CLKTCK);
+  r->system_time_col = sys_time * kMSIn1CLKTCK;
 
   auto proc_start_time_exp = tryTo<long>(proc_stat.start_time);
   if (proc_start_time_exp.isValue() && system_boot_time > 0) {
     auto proc_start_time = proc_start_time_exp.take() / sysconf(_SC_CLK_TCK);
 
-    r["start_time"] = BIGINT(system_boot_time + proc_start_time);
+    r->start_time_col = system_boot_time + proc_start_time;
   } else {
-    r["start_time"] = "-1";
+    r->start_time_col = -1;
   }
 
-  if (!proc_io.status.ok()) {
+  const auto io_columns =
+      ProcessesRow::DISK_BYTES_READ | ProcessesRow::DISK_BYTES_WRITTEN;
+  if (!context.isColumnGroupUsed("io")) {
+    r->null_columns |= io_columns;
+  } else if (!reader.read("io", content).ok()) {
     // /proc/<pid>/io can require root to access, so don't fail if we can't
-    VLOG(1) << proc_io.status.getMessage();
+    VLOG(1) << "Cannot read /proc/" << pid
+            << "/io (is osquery running as root?)";
+    r->null_columns |= io_columns;
   } else {
-    r["disk_bytes_read"] = proc_io.read_bytes;
+    // Parse the process io
+    SimpleProcIo proc_io;
+    parseProcIo(content, proc_io);
+    setProcessColumn(*r,
+                     ProcessesRow::DISK_BYTES_READ,
+                     r->disk_bytes_read_col,
+                     proc_io.read_bytes);
     long long write_bytes = tryTo<long long>(proc_io.write_bytes).takeOr(0ll);
     long long cancelled_write_bytes =
         tryTo<long long>(proc_io.cancelled_write_bytes).takeOr(0ll);
 
-    r["disk_bytes_written"] =
-        std::to_string(write_bytes - cancelled_write_bytes);
+    r->disk_bytes_written_col = write_bytes - cancelled_write_bytes;
   }
 
-  results.push_back(r);
+  results.push_back(std::move(r));
 }
 
-void genNamespaces(const std::string& pid, QueryData& results) {
+void genNamespaces(const std::string& pid,
+                   ProcReader& reader,
+                   QueryData& results) {
   Row r;
 
   ProcessNamespaceList proc_ns;
-  Status status = procGetProcessNamespaces(pid, proc_ns);
+  Status status = procGetProcessNamespaces(reader, proc_ns);
   if (!status.ok()) {
     VLOG(1) << "Namespaces for pid " << pid
             << " are incomplete: " << status.what();
@@ -540,45 +795,104 @@ void genNamespaces(const std::string& pid, QueryData& results) {
 }
 
 TableRows genProcesses(QueryContext& context) {
-  TableRows results;
   static const std::uint64_t system_boot_time = getBootTime();
 
   auto pidlist = getProcList(context);
-  for (const auto& pid : pidlist) {
-    genProcess(pid, system_boot_time, context, results);
+  const std::vector<std::string> pids(pidlist.begin(), pidlist.end());
+  const auto chunks = (pids.size() + kProcessChunkSize - 1) / kProcessChunkSize;
+  std::vector<TableRows> chunk_rows(chunks);
+
+  auto all_pids = context.constraints.count("pid") == 0 ||
+                  !context.constraints.at("pid").exists(EQUALS);
+  auto exec_cache = FLAGS_processes_exec_cache &&
+                    ProcessExecCache::get().update(pids, all_pids);
+
+  std::atomic<size_t> next{0};
+  auto worker = [&pids, chunks, &chunk_rows, &next, &context, exec_cache]() {
+    // One reader per thread opens each process directory once for all its
+    // attributes, and reuses its buffer for every read.
+    ProcReader reader;
+    for (auto chunk = next++; chunk < chunks; chunk = next++) {
+      if (context.isCancelled()) {
+        return;
+      }
+
+      auto end = std::min(pids.size(), (chunk + 1) * kProcessChunkSize);
+      for (auto i = chunk * kProcessChunkSize; i < end; ++i) {
+        if (reader.setProcess(pids[i]).ok()) {
+          genProcess(pids[i],
+                     system_boot_time,
+                     reader,
+                     context,
+                     exec_cache,
+                     chunk_rows[chunk]);
+        }
+      }
+    }
+  };
+
+  size_t concurrency = FLAGS_processes_concurrency;
+  if (concurrency == 0) {
+    concurrency = std::thread::hardware_concurrency();
+  }
+  auto count = std::min<size_t>(chunks, std::max<size_t>(concurrency, 1));
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < count; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
   }
 
+  TableRows results;
+  results.reserve(pids.size());
+  for (auto& rows : chunk_rows) {
+    std::move(rows.begin(), rows.end(), std::back_inserter(results));
+  }
   return results;
 }
 
 QueryData genProcessEnvs(QueryContext& context) {
   QueryData results;
 
+  ProcReader reader;
   auto pidlist = getProcList(context);
   for (const auto& pid : pidlist) {
-    genProcessEnvironment(pid, results);
+    if (reader.setProcess(pid).ok()) {
+      genProcessEnvironment(pid, reader, results);
+    }
   }
 
   return results;
 }
 
-QueryData genProcessMemoryMap(QueryContext& context) {
-  QueryData results;
+void genProcessMemoryMap(RowYield& yield, QueryContext& context) {
+  ProcMapPathFilter filter;
+  auto constraints = context.constraints.find("path");
+  if (constraints != context.constraints.end()) {
+    filter.values = constraints->second.getAll(EQUALS);
+    filter.prefixes = constraints->second.getPrefixes();
+  }
 
+  ProcReader reader;
   auto pidlist = getProcList(context);
   for (const auto& pid : pidlist) {
-    genProcessMap(pid, results);
+    if (reader.setProcess(pid).ok()) {
+      genProcessMap(pid, reader, filter, yield);
+    }
   }
-
-  return results;
 }
 
 QueryData genProcessNamespaces(QueryContext& context) {
   QueryData results;
 
+  ProcReader reader;
   const auto pidlist = getProcList(context);
   for (const auto& pid : pidlist) {
-    genNamespaces(pid, results);
+    if (reader.setProcess(pid).ok()) {
+      genNamespaces(pid, reader, results);
+    }
   }
 
   return results;
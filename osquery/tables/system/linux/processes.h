@@ -7,8 +7,104 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#pragma once
+
+#include <set>
+#include <string>
+#include <string_view>
+
+#include <osquery/utils/status/status.h>
+
 namespace osquery {
 namespace tables {
+
+/// Output from parsing /proc/<pid>/stat and /proc/<pid>/status.
+struct SimpleProcStat {
+  std::string name;
+  std::string real_uid;
+  std::string real_gid;
+  std::string effective_uid;
+  std::string effective_gid;
+  std::string saved_uid;
+  std::string saved_gid;
+  std::string resident_size;
+  std::string total_size;
+  std::string state;
+  std::string parent;
+  std::string group;
+  std::string nice;
+  std::string threads;
+  std::string user_time;
+  std::string system_time;
+  std::string start_time;
+};
+
+/// Output from parsing /proc/<pid>/io.
+struct SimpleProcIo {
+  std::string read_bytes;
+  std::string write_bytes;
+  std::string cancelled_write_bytes;
+};
+
 std::string parseProcCGroup(const std::string& content);
+
+/// Parse the fields of /proc/<pid>/stat following the process name.
+Status parseProcStat(std::string_view content, SimpleProcStat& stat);
+
+/// Parse the name, ids and memory sizes of /proc/<pid>/status.
+Status parseProcStatus(std::string_view content, SimpleProcStat& stat);
+
+/// Parse the storage byte counters of /proc/<pid>/io.
+void parseProcIo(std::string_view content, SimpleProcIo& io);
+
+/// The fields of a /proc/<pid>/maps line, pointing into the content.
+struct ProcMapEntry {
+  std::string_view start;
+  std::string_view end;
+  std::string_view permissions;
+  std::string_view offset;
+  std::string_view device;
+  std::string_view inode;
+
+  /// The path or the pseudo path, empty for an anonymous mapping.
+  std::string_view path;
+};
+
+/**
+ * @brief Parse a line of /proc/<pid>/maps without copying it.
+ *
+ * @return false if the line does not hold an address range and the four
+ * fields following it.
+ */
+bool parseProcMapLine(std::string_view line, ProcMapEntry& entry);
+
+/**
+ * @brief Find the inode of a file mapped by a process.
+ *
+ * @param content The content of /proc/<pid>/maps.
+ * @param path The path of the mapped file.
+ * @return The inode column of the first mapping of path, empty if missing.
+ */
+std::string_view findProcMapInode(std::string_view content,
+                                  std::string_view path);
+
+/// The mapped paths allowed by the constraints of a process_memory_map query.
+struct ProcMapPathFilter {
+  /// Paths from equality constraints, any of them may match.
+  std::set<std::string> values;
+
+  /// Literal prefixes from LIKE 'prefix%' and GLOB 'prefix*' constraints.
+  std::set<std::string> prefixes;
+
+  /**
+   * @brief Check if a path may match the constraints.
+   *
+   * Prefixes are compared without ASCII case, like the SQLite LIKE operator,
+   * so more paths may match than the query selects. SQLite still applies the
+   * full patterns to the generated rows.
+   */
+  bool matches(std::string_view path) const;
+};
+
 } // namespace tables
 } // namespace osquery
@@ -15,6 +15,8 @@
 #include <rpm/rpmpgp.h>
 #include <rpm/rpmts.h>
 
+#include <algorithm>
+
 #include <boost/noncopyable.hpp>
 
 #include <osquery/core/system.h>
@@ -22,6 +24,7 @@
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
 #include <osquery/sql/dynamic_table_row.h>
+#include <osquery/tables/system/package_cache.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
 #include <osquery/worker/logging/glog/glog_logger.h>
 
@@ -39,6 +42,18 @@ namespace tables {
 // Maximum number of files per RPM.
 #define MAX_RPM_FILES (64 * 1024)
 
+/// The canonical RPM database, the backends keep one or more files in it.
+const std::string kRpmDatabasePath{"/var/lib/rpm"};
+
+/// Signature of the RPM database directory and the files within.
+static std::string getRpmDatabaseSignature() {
+  std::vector<std::string> files;
+  listFilesInDirectory(kRpmDatabasePath, files, false);
+  std::sort(files.begin(), files.end());
+  files.insert(files.begin(), kRpmDatabasePath);
+  return getPathsSignature(files);
+}
+
 /**
  * @brief Return a string representation of the RPM tag type.
  *
@@ -186,13 +201,34 @@ QueryData genRpmPackagesImpl(QueryContext& context, Logger& logger) {
 QueryData genRpmPackages(QueryContext& context) {
   if (hasNamespaceConstraint(context)) {
     return generateInNamespace(context, "rpm_packages", genRpmPackagesImpl);
-  } else {
-    GLOGLogger logger;
-    return genRpmPackagesImpl(context, logger);
   }
+
+  // Every package satisfies the name constraint of a cached result, SQLite
+  // filters the rows.
+  auto signature = getRpmDatabaseSignature();
+  QueryData results;
+  if (PackageCache::get().lookup("rpm_packages", signature, results)) {
+    return results;
+  }
+
+  GLOGLogger logger;
+  results = genRpmPackagesImpl(context, logger);
+  if (!results.empty() && !context.constraints["name"].exists(EQUALS)) {
+    PackageCache::get().store("rpm_packages", signature, results);
+  }
+  return results;
 }
 
 void genRpmPackageFiles(RowYield& yield, QueryContext& context) {
+  auto signature = getRpmDatabaseSignature();
+  QueryData files;
+  if (PackageCache::get().lookup("rpm_package_files", signature, files)) {
+    for (auto& file : files) {
+      yield(TableRowHolder(new DynamicTableRow(std::move(file))));
+    }
+    return;
+  }
+
   GLOGLogger logger;
   auto dropper = DropPrivileges::get();
   if (!dropper->dropTo("nobody") && isUserAdmin()) {
@@ -209,9 +245,14 @@ void genRpmPackageFiles(RowYield& yield, QueryContext& context) {
     return;
   }
 
+  // Only the files of every package are kept, until they exceed the limit.
+  auto all_packages = !context.constraints["package"].exists(EQUALS);
+  auto max_rows = PackageCache::get().maxRows();
+  auto cache_files = all_packages && max_rows > 0;
+
   rpmts ts = rpmtsCreate();
   rpmdbMatchIterator matches;
-  if (context.constraints["package"].exists(EQUALS)) {
+  if (!all_packages) {
     auto name = (*context.constraints["package"].getAll(EQUALS).begin());
     matches = rpmtsInitIterator(ts, RPMTAG_NAME, name.c_str(), name.size());
   } else {
@@ -241,7 +282,7 @@ void genRpmPackageFiles(RowYield& yield, QueryContext& context) {
 
     // Iterate over every file in this package.
     for (size_t i = 0; rpmfiNext(fi) >= 0 && i < file_count; i++) {
-      auto r = make_table_row();
+      Row r;
       auto path = rpmfiFN(fi);
       r["package"] = package_name;
       r["path"] = (path != nullptr) ? path : "";
@@ -261,7 +302,13 @@ void genRpmPackageFiles(RowYield& yield, QueryContext& context) {
         free(digest);
       }
 
-      yield(std::move(r));
+      if (cache_files && files.size() < max_rows) {
+        files.push_back(r);
+      } else if (cache_files) {
+        cache_files = false;
+        QueryData().swap(files);
+      }
+      yield(TableRowHolder(new DynamicTableRow(std::move(r))));
     }
 
     rpmfiFree(fi);
@@ -271,6 +318,10 @@ void genRpmPackageFiles(RowYield& yield, QueryContext& context) {
   rpmdbFreeIterator(matches);
   rpmtsFree(ts);
   rpmFreeRpmrc();
+
+  if (cache_files && !files.empty()) {
+    PackageCache::get().store("rpm_package_files", signature, files);
+  }
 }
 } // namespace tables
 } // namespace osquery
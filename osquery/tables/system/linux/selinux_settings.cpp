@@ -29,7 +29,7 @@ Status getSelinuxfsMountPath(std::string& path) {
   path = {};
 
   MountedFilesystems mounted_fs{};
-  auto status = getMountedFilesystems(mounted_fs);
+  auto status = getMountedFilesystems(mounted_fs, false);
   if (!status.ok()) {
     return status;
   }
@@ -8,12 +8,12 @@
  */
 
 #include <sys/shm.h>
-#include <pwd.h>
 
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/system/usersgroups/posix/users_groups_cache.h>
 
 namespace osquery {
 namespace tables {
@@ -52,14 +52,15 @@ QueryData genSharedMemory(QueryContext &context) {
     Row r;
     r["shmid"] = INTEGER(shmid);
 
-    struct passwd *pw = getpwuid(shmseg.shm_perm.uid);
-    if (pw != nullptr) {
-      r["owner_uid"] = BIGINT(pw->pw_uid);
+    auto& users = UsersGroupsCache::get();
+    auto owner = users.getUserByUid(shmseg.shm_perm.uid);
+    if (owner) {
+      r["owner_uid"] = BIGINT(owner->uid);
     }
 
-    pw = getpwuid(shmseg.shm_perm.cuid);
-    if (pw != nullptr) {
-      r["creator_uid"] = BIGINT(pw->pw_uid);
+    auto creator = users.getUserByUid(shmseg.shm_perm.cuid);
+    if (creator) {
+      r["creator_uid"] = BIGINT(creator->uid);
     }
 
     // Accessor, creator pids.
@@ -7,8 +7,13 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 #include <osquery/core/tables.h>
 #include <osquery/sql/dynamic_table_row.h>
+#include <osquery/tables/system/linux/dbus/methods/getallproperties.h>
 #include <osquery/tables/system/linux/dbus/methods/getstringproperty.h>
 #include <osquery/tables/system/linux/dbus/methods/listunitsmethodhandler.h>
 
@@ -17,18 +22,28 @@ namespace osquery {
 namespace tables {
 
 namespace {
-struct PropertyQueryDesc final {
-  std::string property_name;
-  std::string column_name;
-  std::string interface;
-};
 
-const std::vector<PropertyQueryDesc> kStringPropertyQueryList = {
-    {"FragmentPath", "fragment_path", "org.freedesktop.systemd1.Unit"},
-    {"SourcePath", "source_path", "org.freedesktop.systemd1.Unit"},
-    {"User", "user", "org.freedesktop.systemd1.Service"},
-    {"UnitFileState", "unit_file_state", "org.freedesktop.systemd1.Unit"},
+/// The calls sent before waiting for their replies.
+const std::size_t kMaxPendingCalls{64U};
+
+const std::string kUnitInterface{"org.freedesktop.systemd1.Unit"};
+const std::string kServiceInterface{"org.freedesktop.systemd1.Service"};
+const std::string kServiceSuffix{".service"};
+
+/// The columns read from the properties of the Unit interface.
+const std::vector<std::pair<std::string, std::string>> kUnitPropertyColumns = {
+    {"FragmentPath", "fragment_path"},
+    {"SourcePath", "source_path"},
+    {"UnitFileState", "unit_file_state"},
 };
+
+bool isServiceUnit(const std::string& id) {
+  return id.size() >= kServiceSuffix.size() &&
+         id.compare(id.size() - kServiceSuffix.size(),
+                    kServiceSuffix.size(),
+                    kServiceSuffix) == 0;
+}
+
 } // namespace
 
 TableRows genSystemdUnits(QueryContext& context) {
@@ -51,40 +66,85 @@ TableRows genSystemdUnits(QueryContext& context) {
     return {};
   }
 
+  // Only the properties of the selected columns are requested.
+  auto read_unit_properties = context.isAnyColumnUsed(
+      {"fragment_path", "source_path", "unit_file_state"});
+  auto read_user = context.isColumnUsed("user");
+
+  GetAllPropertiesMethod get_all_properties_method;
+  GetStringPropertyMethod get_string_property_method;
   TableRows results;
 
-  for (const auto& unit : unit_list) {
-    auto row = make_table_row();
-
-    row["id"] = TEXT(unit.id);
-    row["description"] = TEXT(unit.description);
-    row["load_state"] = TEXT(unit.load_state);
-    row["active_state"] = TEXT(unit.active_state);
-    row["sub_state"] = TEXT(unit.sub_state);
-    row["following"] = TEXT(unit.following);
-    row["object_path"] = TEXT(unit.path);
-    row["job_id"] = BIGINT(unit.job_id);
-    row["job_type"] = TEXT(unit.job_type);
-    row["job_path"] = TEXT(unit.job_path);
-
-    for (const auto& query : kStringPropertyQueryList) {
-      std::string property_value;
-      GetStringPropertyMethod get_string_property_method;
-      status = get_string_property_method.call(property_value,
-                                               connection,
-                                               unit.path,
-                                               query.interface,
-                                               query.property_name);
-
-      if (!status.ok() && query.property_name != "User") {
-        LOG(ERROR) << "Failed to query the property " << query.property_name
-                   << " on the following systemd unit: " << unit.path;
+  for (std::size_t start{0U}; start < unit_list.size();
+       start += kMaxPendingCalls) {
+    auto count = std::min(kMaxPendingCalls, unit_list.size() - start);
+
+    // A single GetAll per unit replaces a Get per property. The calls of a
+    // batch are all sent before the first reply is read.
+    std::vector<UniqueDbusPendingCall> property_calls(count);
+    std::vector<UniqueDbusPendingCall> user_calls(count);
+    for (std::size_t i{0U}; i < count; ++i) {
+      const auto& unit = unit_list[start + i];
+      if (read_unit_properties) {
+        status = get_all_properties_method.send(
+            property_calls[i], connection, unit.path, kUnitInterface);
+        if (!status.ok()) {
+          LOG(ERROR) << "Failed to query the properties of the following "
+                        "systemd unit: "
+                     << unit.path << ": " << status.getMessage();
+        }
       }
 
-      row[query.column_name] = TEXT(property_value);
+      // Only services have a User property.
+      if (read_user && isServiceUnit(unit.id)) {
+        get_string_property_method.send(user_calls[i],
+                                        connection,
+                                        unit.path,
+                                        kServiceInterface,
+                                        "User");
+      }
     }
 
-    results.push_back(std::move(row));
+    for (std::size_t i{0U}; i < count; ++i) {
+      const auto& unit = unit_list[start + i];
+      auto row = make_table_row();
+
+      row["id"] = TEXT(unit.id);
+      row["description"] = TEXT(unit.description);
+      row["load_state"] = TEXT(unit.load_state);
+      row["active_state"] = TEXT(unit.active_state);
+      row["sub_state"] = TEXT(unit.sub_state);
+      row["following"] = TEXT(unit.following);
+      row["object_path"] = TEXT(unit.path);
+      row["job_id"] = BIGINT(unit.job_id);
+      row["job_type"] = TEXT(unit.job_type);
+      row["job_path"] = TEXT(unit.job_path);
+
+      GetAllPropertiesMethod::Output properties;
+      if (property_calls[i]) {
+        status = get_all_properties_method.receive(properties,
+                                                   property_calls[i]);
+        if (!status.ok()) {
+          LOG(ERROR) << "Failed to query the properties of the following "
+                        "systemd unit: "
+                     << unit.path << ": " << status.getMessage();
+        }
+      }
+
+      for (const auto& column : kUnitPropertyColumns) {
+        auto property = properties.find(column.first);
+        row[column.second] =
+            TEXT((property != properties.end()) ? property->second : "");
+      }
+
+      std::string user;
+      if (user_calls[i]) {
+        get_string_property_method.receive(user, user_calls[i]);
+      }
+      row["user"] = TEXT(user);
+
+      results.push_back(std::move(row));
+    }
   }
 
   return results;
@@ -7,94 +7,70 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
-#include <pwd.h>
-
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
+#include <osquery/system/usersgroups/posix/users_groups_cache.h>
 #include <osquery/utils/conversions/tryto.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
-#include <osquery/worker/logging/glog/glog_logger.h>
 
 namespace osquery {
 namespace tables {
 
-void genUser(const struct passwd* pwd, QueryData& results) {
+void genUser(const UserEntry& user, QueryData& results) {
   Row r;
-  r["uid"] = BIGINT(pwd->pw_uid);
-  r["gid"] = BIGINT(pwd->pw_gid);
-  r["uid_signed"] = BIGINT((int32_t)pwd->pw_uid);
-  r["gid_signed"] = BIGINT((int32_t)pwd->pw_gid);
-
-  if (pwd->pw_name != nullptr) {
-    r["username"] = TEXT(pwd->pw_name);
-  }
-
-  if (pwd->pw_gecos != nullptr) {
-    r["description"] = TEXT(pwd->pw_gecos);
-  }
-
-  if (pwd->pw_dir != nullptr) {
-    r["directory"] = TEXT(pwd->pw_dir);
-  }
-
-  if (pwd->pw_shell != nullptr) {
-    r["shell"] = TEXT(pwd->pw_shell);
-  }
+  r["uid"] = BIGINT(user.uid);
+  r["gid"] = BIGINT(user.gid);
+  r["uid_signed"] = BIGINT((int32_t)user.uid);
+  r["gid_signed"] = BIGINT((int32_t)user.gid);
+  r["username"] = TEXT(user.username);
+  r["description"] = TEXT(user.description);
+  r["directory"] = TEXT(user.directory);
+  r["shell"] = TEXT(user.shell);
   r["pid_with_namespace"] = "0";
   results.push_back(r);
 }
 
-QueryData genUsersImpl(QueryContext& context, Logger& logger) {
+QueryData genUsersFrom(QueryContext& context, UsersGroupsCache& cache) {
   QueryData results;
-  struct passwd pwd;
-  struct passwd* pwd_results{nullptr};
-
-  size_t bufsize = sysconf(_SC_GETPW_R_SIZE_MAX);
-  if (bufsize > 16384) { /* Value was indeterminate */
-    bufsize = 16384; /* Should be more than enough */
-  }
-  auto buf = std::make_unique<char[]>(bufsize);
-
   if (context.constraints["uid"].exists(EQUALS)) {
     auto uids = context.constraints["uid"].getAll(EQUALS);
     for (const auto& uid : uids) {
       auto const auid_exp = tryTo<long>(uid, 10);
       if (auid_exp.isValue()) {
-        getpwuid_r(auid_exp.get(), &pwd, buf.get(), bufsize, &pwd_results);
-        if (pwd_results != nullptr) {
-          genUser(pwd_results, results);
+        auto user = cache.getUserByUid(static_cast<uid_t>(auid_exp.get()));
+        if (user) {
+          genUser(*user, results);
         }
       }
     }
   } else if (context.constraints["username"].exists(EQUALS)) {
     auto usernames = context.constraints["username"].getAll(EQUALS);
     for (const auto& username : usernames) {
-      getpwnam_r(username.c_str(), &pwd, buf.get(), bufsize, &pwd_results);
-      if (pwd_results != nullptr) {
-        genUser(pwd_results, results);
+      auto user = cache.getUserByName(username);
+      if (user) {
+        genUser(*user, results);
       }
     }
   } else {
-    setpwent();
-    while (1) {
-      getpwent_r(&pwd, buf.get(), bufsize, &pwd_results);
-      if (pwd_results == nullptr) {
-        break;
-      }
-      genUser(pwd_results, results);
+    for (const auto& user : cache.getUsers()) {
+      genUser(user, results);
     }
-    endpwent();
   }
 
   return results;
 }
 
+QueryData genUsersImpl(QueryContext& context, Logger& logger) {
+  // Within the namespaces of a container the users of the host do not apply.
+  UsersGroupsCache uncached(false);
+  return genUsersFrom(context, uncached);
+}
+
 QueryData genUsers(QueryContext& context) {
   if (hasNamespaceConstraint(context)) {
     return generateInNamespace(context, "users", genUsersImpl);
   } else {
-    GLOGLogger logger;
-    return genUsersImpl(context, logger);
+    return genUsersFrom(context, UsersGroupsCache::get());
   }
 }
 }
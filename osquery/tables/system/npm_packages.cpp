@@ -10,11 +10,14 @@
 #include <boost/filesystem.hpp>
 
 #include <stdlib.h>
+#include <iterator>
 #include <string>
 
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/tables/system/package_cache.h>
+#include <osquery/tables/system/system_utils.h>
 #include <osquery/utils/info/platform_type.h>
 #include <osquery/utils/json/json.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
@@ -105,6 +108,18 @@ void genNodePackage(const std::string& file, Row& r, Logger& logger) {
 void genNodeSiteDirectories(const std::string& site,
                             QueryData& results,
                             Logger& logger) {
+  // npm replaces the directory of a package it installs, upgrades or removes,
+  // changing node_modules.
+  auto cache_key = "npm_packages:" + site;
+  auto signature = getPathsSignature({site, site + "/node_modules"});
+  QueryData site_results;
+  if (PackageCache::get().lookup(cache_key, signature, site_results)) {
+    results.insert(results.end(),
+                   std::make_move_iterator(site_results.begin()),
+                   std::make_move_iterator(site_results.end()));
+    return;
+  }
+
   std::vector<std::string> manifest_paths;
   boost::filesystem::path pattern("node_modules/%/package.json");
   resolveFilePattern(site / pattern, manifest_paths);
@@ -115,8 +130,13 @@ void genNodeSiteDirectories(const std::string& site,
     r["directory"] = site;
     r["path"] = path;
     r["pid_with_namespace"] = "0";
-    results.push_back(r);
+    site_results.push_back(r);
   }
+
+  PackageCache::get().store(cache_key, signature, site_results);
+  results.insert(results.end(),
+                 std::make_move_iterator(site_results.begin()),
+                 std::make_move_iterator(site_results.end()));
 }
 
 void genWinNodePackages(const std::string& keyGlob,
@@ -163,9 +183,24 @@ QueryData genNodePackagesImpl(QueryContext& context, Logger& logger) {
       genWinNodePackages(installPathKey, results, logger);
     }
   }
-  for (const auto& key : paths) {
-    genNodeSiteDirectories(key, results, logger);
-  }
+
+  // The site directories, most in the home directories of users, are read
+  // in parallel and appended in order
+  std::vector<std::string> sites(paths.begin(), paths.end());
+  std::vector<QueryData> site_results(sites.size());
+  SynchronizedLogger sites_logger(logger);
+  forEachParallel(
+      sites.size(),
+      [&](size_t index) {
+        genNodeSiteDirectories(
+            sites[index], site_results[index], sites_logger);
+      },
+      [&](size_t index) {
+        results.insert(results.end(),
+                       std::make_move_iterator(site_results[index].begin()),
+                       std::make_move_iterator(site_results[index].end()));
+        site_results[index].clear();
+      });
 
   return results;
 }
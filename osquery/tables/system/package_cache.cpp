@@ -0,0 +1,102 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <sys/stat.h>
+
+#include <osquery/core/flags.h>
+#include <osquery/tables/system/package_cache.h>
+
+namespace osquery {
+
+FLAG(uint32,
+     package_cache_max_rows,
+     100000,
+     "Maximum rows kept for each package database, 0 disables the cache");
+
+namespace tables {
+
+std::string getPathsSignature(const std::vector<std::string>& paths) {
+  std::string signature;
+  for (const auto& path : paths) {
+    signature += path;
+#ifdef WIN32
+    struct _stat64 st;
+    if (::_stat64(path.c_str(), &st) != 0) {
+      signature += ":-;";
+      continue;
+    }
+    auto mtime = std::to_string(st.st_mtime);
+#else
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+      signature += ":-;";
+      continue;
+    }
+#ifdef __APPLE__
+    auto mtime = std::to_string(st.st_mtimespec.tv_sec) + "." +
+                 std::to_string(st.st_mtimespec.tv_nsec);
+#else
+    auto mtime = std::to_string(st.st_mtim.tv_sec) + "." +
+                 std::to_string(st.st_mtim.tv_nsec);
+#endif
+#endif
+    signature += ":" + std::to_string(st.st_dev) + ":" +
+                 std::to_string(st.st_ino) + ":" + std::to_string(st.st_size) +
+                 ":" + mtime + ";";
+  }
+  return signature;
+}
+
+PackageCache& PackageCache::get() {
+  static PackageCache cache;
+  return cache;
+}
+
+bool PackageCache::lookup(const std::string& key,
+                          const std::string& signature,
+                          QueryData& rows) const {
+  if (FLAGS_package_cache_max_rows == 0) {
+    return false;
+  }
+
+  ReadLock lock(mutex_);
+  auto it = entries_.find(key);
+  if (it == entries_.end() || it->second.signature != signature) {
+    return false;
+  }
+
+  rows = it->second.rows;
+  return true;
+}
+
+void PackageCache::store(const std::string& key,
+                         const std::string& signature,
+                         const QueryData& rows) {
+  WriteLock lock(mutex_);
+  if (rows.size() > FLAGS_package_cache_max_rows) {
+    entries_.erase(key);
+    return;
+  }
+
+  auto& entry = entries_[key];
+  entry.signature = signature;
+  entry.rows = rows;
+}
+
+void PackageCache::clear() {
+  WriteLock lock(mutex_);
+  entries_.clear();
+}
+
+size_t PackageCache::maxRows() const {
+  return FLAGS_package_cache_max_rows;
+}
+
+} // namespace tables
+} // namespace osquery
@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core/sql/query_data.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+namespace tables {
+
+/**
+ * @brief Build a signature of the metadata of a list of paths.
+ *
+ * The device, inode, size and modification time of each path are joined, a
+ * missing path is recorded as such. Package managers replace or rewrite their
+ * databases when packages change, so a new signature means new rows.
+ */
+std::string getPathsSignature(const std::vector<std::string>& paths);
+
+/**
+ * @brief The parsed rows of package databases.
+ *
+ * Reading a package database, librpm, libdpkg or the manifests of a site
+ * directory, is expensive while the database rarely changes. The rows are
+ * kept under a key, such as the table and the database path, along with the
+ * signature of the paths the database is read from. They are used again until
+ * the signature changes.
+ */
+class PackageCache : private boost::noncopyable {
+ public:
+  /// The process-wide cache of package rows.
+  static PackageCache& get();
+
+  /**
+   * @brief Copy the rows of a key if they were stored with this signature.
+   *
+   * @return false on a miss or if --package_cache_max_rows is 0.
+   */
+  bool lookup(const std::string& key,
+              const std::string& signature,
+              QueryData& rows) const;
+
+  /**
+   * @brief Store the rows of a key, generated while the paths had this
+   * signature.
+   *
+   * Rows over the --package_cache_max_rows limit are not kept.
+   */
+  void store(const std::string& key,
+             const std::string& signature,
+             const QueryData& rows);
+
+  /// Remove all rows.
+  void clear();
+
+  /**
+   * @brief The most rows kept under a key, 0 if the cache is disabled.
+   *
+   * Generators collecting rows to store should stop once they exceed it.
+   */
+  size_t maxRows() const;
+
+ private:
+  PackageCache() = default;
+
+ private:
+  struct Entry {
+    std::string signature;
+    QueryData rows;
+  };
+
+  std::map<std::string, Entry> entries_;
+
+  mutable Mutex mutex_;
+};
+
+} // namespace tables
+} // namespace osquery
@@ -8,13 +8,17 @@
  */
 
 #include <augeas.h>
+#include <fnmatch.h>
 
 #include <mutex>
+#include <set>
 #include <sstream>
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 #include <boost/algorithm/string/join.hpp>
+#include <boost/filesystem.hpp>
 
 #include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
@@ -114,11 +118,22 @@ void matchAugeasPattern(augeas* aug,
   free(matches);
 }
 
+/**
+ * @brief The augeas context shared by queries.
+ *
+ * The context is initialized once and kept, aug_load only parses the files
+ * changed since they were last loaded. Until a query needs every file, the
+ * include patterns of the lenses are reduced to the files requested so far,
+ * so that a query by file path does not parse the whole system.
+ */
 class AugeasHandle {
  public:
   augeas* aug{nullptr};
   bool error{false};
 
+  /// Queries use the context one at a time.
+  std::mutex mutex;
+
   void initialize() {
     std::call_once(initialized, [this]() {
       this->aug = aug_init(
@@ -138,21 +153,173 @@ class AugeasHandle {
             << aug_error_message(this->aug);
         aug_close(this->aug);
         this->aug = nullptr;
+      } else {
+        saveLoadSet();
       }
     });
   }
 
+  /**
+   * @brief Load the files needed by a query.
+   *
+   * With an empty set every file of the lenses is loaded. Otherwise only the
+   * files of this and previous selective loads are loaded, aug_load removes
+   * the files that are no longer included from the tree.
+   */
+  int load(const std::set<std::string>& files);
+
   ~AugeasHandle() {
     aug_close(aug);
     aug = nullptr;
   }
 
+ private:
+  /// Read the include patterns of each lens, as set by aug_init.
+  void saveLoadSet();
+
+  /// Replace the include patterns of a lens.
+  void setIncludes(const std::string& lens,
+                   const std::vector<std::string>& includes);
+
  private:
   std::once_flag initialized;
+
+  /// The lens nodes and their original include patterns.
+  std::vector<std::pair<std::string, std::vector<std::string>>> lenses_;
+
+  /// The files of the selective loads.
+  std::set<std::string> files_;
+
+  /// Every file of the lenses has been loaded, later loads are incremental.
+  bool loaded_all_{false};
+
+  /// The include patterns are reduced to files_.
+  bool selective_{false};
 };
 
+void AugeasHandle::saveLoadSet() {
+  char** lenses = nullptr;
+  int len = aug_match(aug, "/augeas/load/*", &lenses);
+  for (int i = 0; i < len; i++) {
+    std::string lens(lenses[i]);
+    free(lenses[i]);
+
+    std::vector<std::string> includes;
+    char** incl = nullptr;
+    int incl_len = aug_match(aug, (lens + "/incl").c_str(), &incl);
+    for (int j = 0; j < incl_len; j++) {
+      const char* value = nullptr;
+      if (aug_get(aug, incl[j], &value) == 1 && value != nullptr) {
+        includes.push_back(value);
+      }
+      free(incl[j]);
+    }
+    free(incl);
+    lenses_.emplace_back(std::move(lens), std::move(includes));
+  }
+  free(lenses);
+}
+
+void AugeasHandle::setIncludes(const std::string& lens,
+                               const std::vector<std::string>& includes) {
+  aug_rm(aug, (lens + "/incl").c_str());
+  auto node = lens + "/incl[last()+1]";
+  for (const auto& include : includes) {
+    aug_set(aug, node.c_str(), include.c_str());
+  }
+}
+
+int AugeasHandle::load(const std::set<std::string>& files) {
+  if (files.empty() || loaded_all_) {
+    if (selective_) {
+      for (const auto& lens : lenses_) {
+        setIncludes(lens.first, lens.second);
+      }
+      selective_ = false;
+    }
+    loaded_all_ = true;
+    return aug_load(aug);
+  }
+
+  // Keep the files of previous selective loads in the tree.
+  files_.insert(files.begin(), files.end());
+  for (const auto& lens : lenses_) {
+    std::vector<std::string> includes;
+    for (const auto& file : files_) {
+      for (const auto& pattern : lens.second) {
+        if (fnmatch(pattern.c_str(), file.c_str(), FNM_PATHNAME) == 0) {
+          includes.push_back(file);
+          break;
+        }
+      }
+    }
+    setIncludes(lens.first, includes);
+  }
+  selective_ = true;
+  return aug_load(aug);
+}
+
 static AugeasHandle kAugeasHandle;
 
+/// Check if a constraint names a single file that augeas may load.
+static bool isAugeasFile(const std::string& path) {
+  if (path.empty() || path[0] != '/' ||
+      path.find_first_of("*?[]") != std::string::npos) {
+    return false;
+  }
+
+  boost::system::error_code ec;
+  return boost::filesystem::is_regular_file(path, ec);
+}
+
+/**
+ * @brief The files read by a query, empty if it may read any file.
+ *
+ * Path constraints name the files. Node constraints name a file when a
+ * prefix of the node below /files is a file. LIKE constraints and nodes
+ * that are expressions or outside of /files need every file.
+ */
+std::set<std::string> filesFromConstraints(QueryContext& context) {
+  if (context.hasConstraint("path", LIKE) ||
+      context.hasConstraint("node", LIKE)) {
+    return {};
+  }
+
+  std::set<std::string> files;
+  for (const auto& path : context.constraints["path"].getAll(EQUALS)) {
+    if (path.empty()) {
+      continue;
+    }
+    if (!isAugeasFile(path)) {
+      return {};
+    }
+    files.insert(path);
+  }
+
+  for (const auto& node : context.constraints["node"].getAll(EQUALS)) {
+    if (node.compare(0, 7, "/files/") != 0 ||
+        node.find_first_of("*?[]$|()") != std::string::npos) {
+      return {};
+    }
+
+    auto size = files.size();
+    for (auto pos = node.find('/', 7);; pos = node.find('/', pos + 1)) {
+      auto path = node.substr(6, pos - 6);
+      if (isAugeasFile(path)) {
+        files.insert(path);
+        break;
+      }
+      if (pos == std::string::npos) {
+        break;
+      }
+    }
+    if (files.size() == size) {
+      return {};
+    }
+  }
+  return files;
+}
+
 void patternsFromOsquery(std::unordered_set<std::string>& search_patterns,
                          const std::string& input,
                          bool isLike,
@@ -225,13 +392,13 @@ QueryData genAugeas(QueryContext& context) {
     return {};
   }
 
+  std::lock_guard<std::mutex> lock(kAugeasHandle.mutex);
   augeas* aug = kAugeasHandle.aug;
 
-  // Load everything. While it would be interesting to do this for
-  // only the requested files, it's not clearly possible to
-  // _unload_. So at present, load everything. (For reference, it
-  // takes abvout 0.3 seconds to run aug_load on seph's laptop.)
-  int ret = aug_load(aug);
+  // Load the requested files, or everything. Augeas removes the files no
+  // longer included when loading, so once everything is needed it stays
+  // loaded. Later loads only parse the files changed since.
+  int ret = kAugeasHandle.load(filesFromConstraints(context));
   if (ret != 0) {
     LOG(ERROR) << "An error has occurred while trying to load augeas: "
                << aug_error_message(aug);
@@ -267,9 +434,8 @@ QueryData genAugeas(QueryContext& context) {
     }
   }
 
-  // This LIKE strategy only works because we've loaded the entire
-  // augeas system. If we ever move to loading by explicit files, this
-  // will break.
+  // This LIKE strategy only works because LIKE constraints load the
+  // entire augeas system.
   if (context.hasConstraint("path", LIKE)) {
     auto paths = context.constraints["path"].getAll(LIKE);
     for (const auto& path : paths) {
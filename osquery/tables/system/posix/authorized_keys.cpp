@@ -154,21 +154,22 @@ void genSSHkeysForUser(const std::string& uid,
 }
 
 QueryData getAuthorizedKeysImpl(QueryContext& context, Logger& logger) {
-  QueryData results;
-
-  // Iterate over each user
+  // Iterate over each user, the users are read in parallel
+  SynchronizedLogger users_logger(logger);
   QueryData users = usersFromContext(context);
-  for (const auto& row : users) {
-    auto uid = row.find("uid");
-    auto gid = row.find("gid");
-    auto directory = row.find("directory");
-    if (uid != row.end() && gid != row.end() && directory != row.end()) {
-      genSSHkeysForUser(
-          uid->second, gid->second, directory->second, results, logger);
-    }
-  }
-
-  return results;
+  return forEachUserParallel(
+      users, [&users_logger](const Row& row, QueryData& results) {
+        auto uid = row.find("uid");
+        auto gid = row.find("gid");
+        auto directory = row.find("directory");
+        if (uid != row.end() && gid != row.end() && directory != row.end()) {
+          genSSHkeysForUser(uid->second,
+                            gid->second,
+                            directory->second,
+                            results,
+                            users_logger);
+        }
+      });
 }
 
 QueryData getAuthorizedKeys(QueryContext& context) {
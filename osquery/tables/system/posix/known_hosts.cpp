@@ -52,11 +52,9 @@ void genSSHkeysForHosts(const std::string& uid,
 } // namespace impl
 
 QueryData getKnownHostsKeys(QueryContext& context) {
-  QueryData results;
-
-  // Iterate over each user
+  // Iterate over each user, the users are read in parallel
   auto users = usersFromContext(context);
-  for (const auto& row : users) {
+  return forEachUserParallel(users, [](const Row& row, QueryData& results) {
     auto uid = row.find("uid");
     auto gid = row.find("gid");
     auto directory = row.find("directory");
@@ -64,9 +62,7 @@ QueryData getKnownHostsKeys(QueryContext& context) {
       impl::genSSHkeysForHosts(
           uid->second, gid->second, directory->second, results);
     }
-  }
-
-  return results;
+  });
 }
 }
 }
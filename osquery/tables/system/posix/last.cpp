@@ -9,8 +9,11 @@
 
 #include <utmpx.h>
 
+#include <cstring>
+
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
+#include <osquery/filesystem/posix/appended_file.h>
 #include <osquery/logger/logger.h>
 
 namespace osquery {
@@ -59,19 +62,40 @@ void genLastAccessForRow(const utmpx& ut, QueryData& results) {
 
 } // namespace impl
 
+#ifdef __linux__
+/// The wtmp records are appended to, until the file is rotated.
+AppendedFileReader kWtmpReader;
+
+/// Parse the complete wtmp records, the file is an array of utmpx.
+size_t parseWtmp(const std::string& data, bool final, QueryData& rows) {
+  size_t used = 0;
+  for (; used + sizeof(utmpx) <= data.size(); used += sizeof(utmpx)) {
+    utmpx ut;
+    std::memcpy(&ut, data.data() + used, sizeof(ut));
+    impl::genLastAccessForRow(ut, rows);
+  }
+
+  // A partially written record is read with the next query.
+  return used;
+}
+#endif
+
 QueryData genLastAccess(QueryContext& context) {
   QueryData results;
+#ifdef __linux__
+  // Only the records appended since the last query are parsed.
+  auto status = kWtmpReader.read(_PATH_WTMP, parseWtmp, results);
+  if (!status.ok()) {
+    VLOG(1) << "Cannot read wtmp: " << status.getMessage();
+  }
+  return results;
+#else
   struct utmpx* ut;
 #ifdef __APPLE__
   setutxent_wtmp(0); // 0 = reverse chronological order
 
   while ((ut = getutxent_wtmp()) != nullptr) {
 #else
-
-#ifndef __FreeBSD__
-  utmpxname(_PATH_WTMP);
-#endif
-
   setutxent();
 
   while ((ut = getutxent()) != nullptr) {
@@ -87,6 +111,7 @@ QueryData genLastAccess(QueryContext& context) {
 #endif
 
   return results;
+#endif
 }
 }
 }
@@ -17,6 +17,7 @@
 
 #include <osquery/core/tables.h>
 #include <osquery/logger/logger.h>
+#include <osquery/utils/conversions/split.h>
 
 namespace osquery {
 namespace tables {
@@ -29,18 +30,85 @@ const std::vector<std::string> kMagicFiles = {
 };
 
 constexpr char const* kMagicFileDBSep = ":";
-} // namespace
 
-QueryData genMagicData(QueryContext& context) {
-  QueryData results;
+/// Bytes of the start of a file matched against the magic database.
+const size_t kMagicBytesMax{1024 * 1024};
+
+/// A loaded magic database, kept by a thread for its next queries.
+struct MagicHandle {
+  ~MagicHandle() {
+    reset();
+  }
+
+  void reset() {
+    if (cookie != nullptr) {
+      magic_close(cookie);
+      cookie = nullptr;
+    }
+    db_files.clear();
+    db_state.clear();
+  }
+
+  magic_t cookie{nullptr};
+
+  /// The database list the cookie loaded.
+  std::string db_files;
+
+  /// The modification times and sizes of the databases when loaded.
+  std::string db_state;
+};
+
+thread_local MagicHandle kMagicHandle;
+
+/// Describe the database files, a changed file is loaded again.
+std::string getMagicDBState(const std::string& db_files) {
+  std::string state;
+  for (const auto& path : osquery::split(db_files, kMagicFileDBSep)) {
+    boost::system::error_code ec;
+    auto mtime = boost::filesystem::last_write_time(path, ec);
+    auto size = boost::filesystem::file_size(path, ec);
+    state += std::to_string(mtime) + "," + std::to_string(size) + ";";
+  }
+  return state;
+}
+
+/// Get the cookie of the thread with the databases loaded.
+magic_t getMagicCookie(const std::string& db_files) {
+  auto db_state = getMagicDBState(db_files);
+  if (kMagicHandle.cookie != nullptr && kMagicHandle.db_files == db_files &&
+      kMagicHandle.db_state == db_state) {
+    return kMagicHandle.cookie;
+  }
+
+  kMagicHandle.reset();
 
   // No default flags
-  magic_t magic_cookie = magic_open(MAGIC_NONE);
-  if (magic_cookie == nullptr) {
+  auto cookie = magic_open(MAGIC_NONE);
+  if (cookie == nullptr) {
     VLOG(1) << "Unable to initialize magic library";
-    return results;
+    return nullptr;
+  }
+
+  // Only the start of a file is read, whatever its size.
+  magic_setparam(cookie, MAGIC_PARAM_BYTES_MAX, &kMagicBytesMax);
+
+  if (magic_load(cookie, db_files.c_str()) != 0) {
+    LOG(WARNING) << "Unable to load magic list of database: " << db_files
+                 << " because: " << magic_error(cookie);
+    magic_close(cookie);
+    return nullptr;
   }
 
+  kMagicHandle.cookie = cookie;
+  kMagicHandle.db_files = db_files;
+  kMagicHandle.db_state = std::move(db_state);
+  return cookie;
+}
+} // namespace
+
+QueryData genMagicData(QueryContext& context) {
+  QueryData results;
+
   std::string magic_db_files;
   if (context.hasConstraint("magic_db_files")) {
     auto magic_files = context.constraints["magic_db_files"].getAll(EQUALS);
@@ -49,10 +117,8 @@ QueryData genMagicData(QueryContext& context) {
     magic_db_files = boost::algorithm::join(kMagicFiles, kMagicFileDBSep);
   }
 
-  if (magic_load(magic_cookie, magic_db_files.c_str()) != 0) {
-    LOG(WARNING) << "Unable to load magic list of database: " << magic_db_files
-                 << " because: " << magic_error(magic_cookie);
-    magic_close(magic_cookie);
+  auto magic_cookie = getMagicCookie(magic_db_files);
+  if (magic_cookie == nullptr) {
     return results;
   }
 
@@ -63,6 +129,7 @@ QueryData genMagicData(QueryContext& context) {
     r["path"] = path_string;
     r["magic_db_files"] = magic_db_files;
 
+    magic_setflags(magic_cookie, MAGIC_NONE);
     auto data = magic_file(magic_cookie, path_string.c_str());
     if (data != nullptr) {
       r["data"] = data;
@@ -85,7 +152,6 @@ QueryData genMagicData(QueryContext& context) {
     results.push_back(r);
   }
 
-  magic_close(magic_cookie);
   return results;
 }
 } // namespace tables
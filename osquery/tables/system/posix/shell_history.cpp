@@ -13,7 +13,9 @@
 
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
+#include <osquery/core/flags.h>
 #include <osquery/filesystem/filesystem.h>
+#include <osquery/filesystem/posix/appended_file.h>
 #include <osquery/tables/system/posix/shell_history.h>
 #include <osquery/tables/system/system_utils.h>
 #include <osquery/utils/system/system.h>
@@ -29,84 +31,77 @@ const std::vector<std::string> kShellHistoryFiles = {
     ".sh_history",
 };
 
-struct HistoryState {
-  std::string content;
-  std::regex bash_timestamp_rx{"^#([0-9]+)$"};
-  std::regex zsh_timestamp_rx{"^: {0,10}([0-9]{1,11}):[0-9]+;(.*)$"};
-  std::string prev_bash_timestamp;
-};
+DECLARE_uint64(read_max);
 
-void genShellHistoryFromFile(
-    const std::string& uid,
-    const boost::filesystem::path& history_file,
-    std::function<void(DynamicTableRowHolder& row)> predicate) {
-  struct HistoryState hState;
-
-  auto parseLine =
-      [&hState, &uid, &history_file, &predicate](std::string& line) {
-        std::smatch bash_timestamp_matches;
-        std::smatch zsh_timestamp_matches;
-
-        if (hState.prev_bash_timestamp.empty() &&
-            std::regex_search(
-                line, bash_timestamp_matches, hState.bash_timestamp_rx)) {
-          hState.prev_bash_timestamp = bash_timestamp_matches[1];
-          return;
-        }
+/// Histories are appended to, and rewritten when they are trimmed.
+AppendedFileReader kShellHistoryReader;
 
-        auto r = make_table_row();
-
-        if (!hState.prev_bash_timestamp.empty()) {
-          r["time"] = INTEGER(hState.prev_bash_timestamp);
-          r["command"] = std::move(line);
-          hState.prev_bash_timestamp.clear();
-        } else if (std::regex_search(
-                       line, zsh_timestamp_matches, hState.zsh_timestamp_rx)) {
-          std::string timestamp = zsh_timestamp_matches[1];
-          r["time"] = INTEGER(timestamp);
-          r["command"] = zsh_timestamp_matches[2];
-        } else {
-          r["time"] = INTEGER(0);
-          r["command"] = std::move(line);
-        }
-
-        r["uid"] = uid;
-        r["history_file"] = history_file.string();
-        predicate(r);
-      };
+/// Parse history lines into rows of time and command.
+size_t parseShellHistory(const std::string& data, bool final, QueryData& rows) {
+  static const std::regex bash_timestamp_rx{"^#([0-9]+)$"};
+  static const std::regex zsh_timestamp_rx{
+      "^: {0,10}([0-9]{1,11}):[0-9]+;(.*)$"};
 
-  auto parseChunk = [&hState, &parseLine](std::string& buffer, size_t size) {
-    // We may be appending this chunk to the end of the previous.
-    if (buffer.size() == size) {
-      hState.content += std::move(buffer);
-    } else {
-      hState.content += buffer.substr(0, size);
+  // A bash timestamp line is only used with the command line after it.
+  std::string prev_bash_timestamp;
+  size_t used = 0;
+  size_t start = 0;
+  while (start < data.size()) {
+    auto newline = data.find('\n', start);
+    if (newline == std::string::npos && !final) {
+      break;
     }
-
-    // Search for newlines and parse each.
-    size_t last_newline = 0;
-    auto newline = hState.content.find('\n');
-    while (newline != std::string::npos) {
-      auto line = hState.content.substr(last_newline, newline - last_newline);
-      parseLine(line);
-
-      last_newline = newline + 1;
-      newline = hState.content.find('\n', last_newline);
+    auto end = (newline == std::string::npos) ? data.size() : newline;
+    auto line = data.substr(start, end - start);
+    start = (newline == std::string::npos) ? data.size() : newline + 1;
+
+    std::smatch bash_timestamp_matches;
+    std::smatch zsh_timestamp_matches;
+    if (prev_bash_timestamp.empty() &&
+        std::regex_search(line, bash_timestamp_matches, bash_timestamp_rx)) {
+      prev_bash_timestamp = bash_timestamp_matches[1];
+      continue;
     }
 
-    if (last_newline != hState.content.size() - 1) {
-      // We need to buffer the end of the string.
-      hState.content = hState.content.substr(last_newline);
+    Row r;
+    if (!prev_bash_timestamp.empty()) {
+      r["time"] = INTEGER(prev_bash_timestamp);
+      r["command"] = std::move(line);
+      prev_bash_timestamp.clear();
+    } else if (std::regex_search(
+                   line, zsh_timestamp_matches, zsh_timestamp_rx)) {
+      std::string timestamp = zsh_timestamp_matches[1];
+      r["time"] = INTEGER(timestamp);
+      r["command"] = zsh_timestamp_matches[2];
+    } else {
+      r["time"] = INTEGER(0);
+      r["command"] = std::move(line);
     }
-  };
+    rows.push_back(std::move(r));
+    used = start;
+  }
+  return final ? data.size() : used;
+}
 
-  if (!readFile(history_file, 0, 4096, false, false, parseChunk, false)) {
+void genShellHistoryFromFile(
+    const std::string& uid,
+    const boost::filesystem::path& history_file,
+    std::function<void(DynamicTableRowHolder& row)> predicate) {
+  // Only the lines appended since the last query are parsed.
+  QueryData history;
+  auto status = kShellHistoryReader.read(
+      history_file.string(), parseShellHistory, history, FLAGS_read_max);
+  if (!status.ok()) {
     return;
   }
 
-  // Parse the final line.
-  if (!hState.content.empty()) {
-    parseLine(hState.content);
+  for (auto& entry : history) {
+    auto r = make_table_row();
+    r["time"] = std::move(entry["time"]);
+    r["command"] = std::move(entry["command"]);
+    r["uid"] = uid;
+    r["history_file"] = history_file.string();
+    predicate(r);
   }
 }
 
@@ -142,19 +137,30 @@ void genShellHistoryFromBashSessions(
 }
 
 void genShellHistory(RowYield& yield, QueryContext& context) {
-  auto predicate = [&yield](DynamicTableRowHolder& r) { yield(std::move(r)); };
-
-  // Iterate over each user
+  // Iterate over each user, the users are read in parallel and the rows of
+  // each user are yielded in order
   QueryData users = usersFromContext(context);
-  for (const auto& row : users) {
-    auto uid = row.find("uid");
-    auto gid = row.find("gid");
-    auto dir = row.find("directory");
-    if (uid != row.end() && gid != row.end() && dir != row.end()) {
-      genShellHistoryForUser(uid->second, gid->second, dir->second, predicate);
-      genShellHistoryFromBashSessions(uid->second, dir->second, predicate);
-    }
-  }
+  forEachUserParallel<TableRows>(
+      users,
+      [](const Row& row, TableRows& rows) {
+        auto predicate = [&rows](DynamicTableRowHolder& r) {
+          rows.push_back(std::move(r));
+        };
+
+        auto uid = row.find("uid");
+        auto gid = row.find("gid");
+        auto dir = row.find("directory");
+        if (uid != row.end() && gid != row.end() && dir != row.end()) {
+          genShellHistoryForUser(
+              uid->second, gid->second, dir->second, predicate);
+          genShellHistoryFromBashSessions(uid->second, dir->second, predicate);
+        }
+      },
+      [&yield](TableRows& rows) {
+        for (auto& r : rows) {
+          yield(std::move(r));
+        }
+      });
 }
 } // namespace tables
 } // namespace osquery
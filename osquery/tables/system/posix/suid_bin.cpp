@@ -7,8 +7,6 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
-#include <pwd.h>
-#include <grp.h>
 #include <sys/stat.h>
 
 #include <sstream>
@@ -18,6 +16,7 @@
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/system/usersgroups/posix/users_groups_cache.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
 #include <osquery/worker/logging/glog/glog_logger.h>
 
@@ -31,7 +30,10 @@ std::vector<std::string> kBinarySearchPaths = {
     "/usr/local/bin", "/usr/local/sbin", "/tmp",
 };
 
-Status genBin(const fs::path& path, int perms, QueryData& results) {
+Status genBin(const fs::path& path,
+              int perms,
+              UsersGroupsCache& cache,
+              QueryData& results) {
   struct stat info;
   // store user and group
   if (stat(path.c_str(), &info) != 0) {
@@ -41,20 +43,20 @@ Status genBin(const fs::path& path, int perms, QueryData& results) {
   // store path
   Row r;
   r["path"] = path.string();
-  struct passwd* pw = getpwuid(info.st_uid);
-  struct group* gr = getgrgid(info.st_gid);
+  auto pw = cache.getUserByUid(info.st_uid);
+  auto gr = cache.getGroupByGid(info.st_gid);
 
   // get user name + group
   std::string user;
-  if (pw != nullptr) {
-    user = std::string(pw->pw_name);
+  if (pw) {
+    user = pw->username;
   } else {
     user = std::to_string(info.st_uid);
   }
 
   std::string group;
-  if (gr != nullptr) {
-    group = std::string(gr->gr_name);
+  if (gr) {
+    group = gr->groupname;
   } else {
     group = std::to_string(info.st_gid);
   }
@@ -76,6 +78,7 @@ Status genBin(const fs::path& path, int perms, QueryData& results) {
 }
 
 void genSuidBinsFromPath(const std::string& path,
+                         UsersGroupsCache& cache,
                          QueryData& results,
                          Logger& logger) {
   if (!pathExists(path).ok()) {
@@ -97,7 +100,7 @@ void genSuidBinsFromPath(const std::string& path,
 
       auto perms = dir_entry.status().permissions();
       if ((perms & 04000) == 04000 || (perms & 02000) == 02000) {
-        genBin(dir_entry_path, perms, results);
+        genBin(dir_entry_path, perms, cache, results);
       }
     }
 
@@ -110,23 +113,29 @@ void genSuidBinsFromPath(const std::string& path,
   }
 }
 
-QueryData genSuidBinImpl(QueryContext& context, Logger& logger) {
+QueryData genSuidBinsFrom(UsersGroupsCache& cache, Logger& logger) {
   QueryData results;
 
   // Todo: add hidden column to select on that triggers non-std path searches.
   for (const auto& path : kBinarySearchPaths) {
-    genSuidBinsFromPath(path, results, logger);
+    genSuidBinsFromPath(path, cache, results, logger);
   }
 
   return results;
 }
 
+QueryData genSuidBinImpl(QueryContext& context, Logger& logger) {
+  // Within the namespaces of a container the owners resolve in its databases.
+  UsersGroupsCache uncached(false);
+  return genSuidBinsFrom(uncached, logger);
+}
+
 QueryData genSuidBin(QueryContext& context) {
   if (hasNamespaceConstraint(context)) {
     return generateInNamespace(context, "suid_bin", genSuidBinImpl);
   } else {
     GLOGLogger logger;
-    return genSuidBinImpl(context, logger);
+    return genSuidBinsFrom(UsersGroupsCache::get(), logger);
   }
 }
 }
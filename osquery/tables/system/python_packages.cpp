@@ -10,11 +10,13 @@
 #include <boost/filesystem.hpp>
 
 #include <stdlib.h>
+#include <iterator>
 #include <string>
 
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/tables/system/package_cache.h>
 #include <osquery/utils/conversions/split.h>
 #include <osquery/utils/info/platform_type.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
@@ -87,6 +89,18 @@ void genPackage(const std::string& path, Row& r, Logger& logger) {
 void genSiteDirectories(const std::string& site,
                         QueryData& results,
                         Logger& logger) {
+  // Installing, upgrading or removing a package replaces its info directory,
+  // changing the site directory.
+  auto cache_key = "python_packages:" + site;
+  auto signature = getPathsSignature({site});
+  QueryData site_results;
+  if (PackageCache::get().lookup(cache_key, signature, site_results)) {
+    results.insert(results.end(),
+                   std::make_move_iterator(site_results.begin()),
+                   std::make_move_iterator(site_results.end()));
+    return;
+  }
+
   std::vector<std::string> directories;
   if (!listDirectoriesInDirectory(site, directories, true).ok()) {
     return;
@@ -111,8 +125,13 @@ void genSiteDirectories(const std::string& site,
     r["directory"] = site;
     r["path"] = directory;
     r["pid_with_namespace"] = "0";
-    results.push_back(r);
+    site_results.push_back(r);
   }
+
+  PackageCache::get().store(cache_key, signature, site_results);
+  results.insert(results.end(),
+                 std::make_move_iterator(site_results.begin()),
+                 std::make_move_iterator(site_results.end()));
 }
 
 void genWinPythonPackages(const std::string& keyGlob,
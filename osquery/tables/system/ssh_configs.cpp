@@ -75,18 +75,18 @@ void genSshConfigForUser(const std::string& uid,
   genSshConfig(uid, gid, ssh_config_file, results);
 }
 QueryData getSshConfigs(QueryContext& context) {
-  QueryData results;
-
-  // Iterate over each user
+  // Iterate over each user, the users are read in parallel
   QueryData users = usersFromContext(context);
-  for (const auto& row : users) {
-    auto uid = row.find("uid");
-    auto gid = row.find("gid");
-    auto directory = row.find("directory");
-    if (uid != row.end() && gid != row.end() && directory != row.end()) {
-      genSshConfigForUser(uid->second, gid->second, directory->second, results);
-    }
-  }
+  auto results =
+      forEachUserParallel(users, [](const Row& row, QueryData& user_results) {
+        auto uid = row.find("uid");
+        auto gid = row.find("gid");
+        auto directory = row.find("directory");
+        if (uid != row.end() && gid != row.end() && directory != row.end()) {
+          genSshConfigForUser(
+              uid->second, gid->second, directory->second, user_results);
+        }
+      });
 
   if (isPlatform(PlatformType::TYPE_WINDOWS)) {
     genSshConfig("0", "0", kWindowsSystemwideSshConfig, results);
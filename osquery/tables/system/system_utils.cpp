@@ -7,11 +7,27 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include <osquery/core/flags.h>
 #include <osquery/sql/sql.h>
+#include <osquery/tables/system/system_utils.h>
+#include <osquery/utils/scope_guard.h>
 
 #include <osquery/process/process.h>
 
 namespace osquery {
+
+FLAG(uint32,
+     table_user_threads,
+     4,
+     "Threads used by tables reading the home directory of each user");
+
 namespace tables {
 
 QueryData usersFromContext(const QueryContext& context, bool all) {
@@ -47,5 +63,80 @@ QueryData pidsFromContext(const QueryContext& context, bool all) {
   }
   return procs;
 }
+
+void forEachParallel(size_t count,
+                     const std::function<void(size_t index)>& generate,
+                     const std::function<void(size_t index)>& consume) {
+  auto threads = std::min<size_t>(FLAGS_table_user_threads, count);
+  if (threads <= 1) {
+    for (size_t index = 0; index < count; ++index) {
+      generate(index);
+      consume(index);
+    }
+    return;
+  }
+
+  std::mutex mutex;
+  std::condition_variable generated;
+  std::vector<char> done(count, 0);
+  std::vector<std::exception_ptr> errors(count);
+  std::atomic<size_t> next{0};
+
+  std::vector<std::thread> workers;
+  // The workers are joined even if the consumer stops early, such as when a
+  // generator table is finalized before all of its rows are read.
+  auto const joiner = scope_guard::create([&next, &workers, count]() {
+    next = count;
+    for (auto& worker : workers) {
+      worker.join();
+    }
+  });
+
+  for (size_t i = 0; i < threads; ++i) {
+    workers.emplace_back([&]() {
+      for (auto index = next++; index < count; index = next++) {
+        std::exception_ptr error;
+        try {
+          generate(index);
+        } catch (...) {
+          error = std::current_exception();
+        }
+
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          done[index] = 1;
+          errors[index] = error;
+        }
+        generated.notify_all();
+      }
+    });
+  }
+
+  for (size_t index = 0; index < count; ++index) {
+    std::exception_ptr error;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      generated.wait(lock, [&done, index]() { return done[index] != 0; });
+      error = errors[index];
+    }
+
+    if (error != nullptr) {
+      std::rethrow_exception(error);
+    }
+    consume(index);
+  }
 }
+
+QueryData forEachUserParallel(
+    const QueryData& users,
+    const std::function<void(const Row& user, QueryData& rows)>& generate) {
+  QueryData results;
+  forEachUserParallel<QueryData>(users, generate, [&results](QueryData& rows) {
+    results.insert(results.end(),
+                   std::make_move_iterator(rows.begin()),
+                   std::make_move_iterator(rows.end()));
+  });
+  return results;
 }
+} // namespace tables
+} // namespace osquery
@@ -9,6 +9,9 @@
 
 #pragma once
 
+#include <functional>
+#include <vector>
+
 #include <osquery/core/tables.h>
 
 namespace osquery {
@@ -35,5 +38,56 @@ QueryData usersFromContext(const QueryContext& context, bool all = false);
  * @return A complete set of rows for each process.
  */
 QueryData pidsFromContext(const QueryContext& context, bool all = true);
+
+/**
+ * @brief Generate several items on a bounded number of threads.
+ *
+ * The generator is called for each index in [0, count) on up to
+ * table_user_threads threads. The consumer is called on the calling thread
+ * for each index in order, as soon as that index and all before it are
+ * generated, so rows may be yielded while later items are still read. An
+ * exception thrown by the generator is rethrown to the calling thread.
+ *
+ * Only the calling thread may query other tables.
+ *
+ * @param count The number of items.
+ * @param generate Generates one item, called concurrently.
+ * @param consume Uses one generated item, called in order.
+ */
+void forEachParallel(size_t count,
+                     const std::function<void(size_t index)>& generate,
+                     const std::function<void(size_t index)>& consume);
+
+/**
+ * @brief Generate the rows of each user on a bounded number of threads.
+ *
+ * Tables reading files in the home directory of each user spend most of
+ * their time waiting for I/O. The rows of each user are appended to a batch,
+ * concurrently with other users, and each batch is given to yield in the
+ * order of users.
+ *
+ * @param users The users, as returned by usersFromContext.
+ * @param generate Appends the rows of one user, called concurrently.
+ * @param yield Uses the rows of one user, called in order.
+ */
+template <typename Rows>
+void forEachUserParallel(
+    const QueryData& users,
+    const std::function<void(const Row& user, Rows& rows)>& generate,
+    const std::function<void(Rows& rows)>& yield) {
+  std::vector<Rows> batches(users.size());
+  forEachParallel(
+      users.size(),
+      [&](size_t index) { generate(users[index], batches[index]); },
+      [&](size_t index) {
+        yield(batches[index]);
+        batches[index] = Rows();
+      });
 }
-}
+
+/// Generate the rows of each user in parallel, returned in order of users.
+QueryData forEachUserParallel(
+    const QueryData& users,
+    const std::function<void(const Row& user, QueryData& rows)>& generate);
+} // namespace tables
+} // namespace osquery
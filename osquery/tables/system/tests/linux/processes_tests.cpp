@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <string>
+
 #include <gtest/gtest.h>
 #include <osquery/tables/system/linux/processes.h>
 
@@ -37,5 +39,109 @@ TEST_F(CGroupTest, invalid) {
   EXPECT_EQ("", got);
 }
 
+class ProcParseTest : public ::testing::Test {};
+
+TEST_F(ProcParseTest, stat) {
+  SimpleProcStat stat;
+  auto status = parseProcStat(
+      "1234 (a) b (c)) S 1 1234 1234 0 -1 4194560 1000 0 0 0 25 10 0 0 20 "
+      "5 3 0 4200 13000000 800 18446744073709551615 1 1 0 0 0 0 0 0 0 0 0\n",
+      stat);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(stat.state, "S");
+  EXPECT_EQ(stat.parent, "1");
+  EXPECT_EQ(stat.group, "1234");
+  EXPECT_EQ(stat.user_time, "25");
+  EXPECT_EQ(stat.system_time, "10");
+  EXPECT_EQ(stat.nice, "5");
+  EXPECT_EQ(stat.threads, "3");
+  EXPECT_EQ(stat.start_time, "4200");
+
+  EXPECT_FALSE(parseProcStat("1234 (a) S 1 1234\n", stat).ok());
+  EXPECT_FALSE(parseProcStat("1234 (a", stat).ok());
+}
+
+TEST_F(ProcParseTest, status) {
+  SimpleProcStat stat;
+  auto status = parseProcStatus(
+      "Name:\ta: b\nUmask:\t0022\nUid:\t1000\t1001\t1002\t1003\n"
+      "Gid:\t100\t101\t102\t103\nVmSize:\t    8000 kB\n"
+      "VmRSS:\t     400 kB\n",
+      stat);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(stat.name, "a: b");
+  EXPECT_EQ(stat.real_uid, "1000");
+  EXPECT_EQ(stat.effective_uid, "1001");
+  EXPECT_EQ(stat.saved_uid, "1002");
+  EXPECT_EQ(stat.real_gid, "100");
+  EXPECT_EQ(stat.effective_gid, "101");
+  EXPECT_EQ(stat.saved_gid, "102");
+  EXPECT_EQ(stat.total_size, "8192000");
+  EXPECT_EQ(stat.resident_size, "409600");
+
+  EXPECT_FALSE(parseProcStatus("VmRSS:\t kB\n", stat).ok());
+}
+
+TEST_F(ProcParseTest, io) {
+  SimpleProcIo io;
+  parseProcIo(
+      "rchar: 10\nread_bytes: 4096\nwrite_bytes: 8192\n"
+      "cancelled_write_bytes: 0\n",
+      io);
+  EXPECT_EQ(io.read_bytes, "4096");
+  EXPECT_EQ(io.write_bytes, "8192");
+  EXPECT_EQ(io.cancelled_write_bytes, "0");
+}
+
+TEST_F(ProcParseTest, map_inode) {
+  std::string maps =
+      "55d0-55d1 r--p 00000000 fd:01 1111                       /bin/a b\n"
+      "55d1-55d2 r-xp 00001000 fd:01 2222                       "
+      "/bin/a (deleted)\n"
+      "7ffd-7ffe rw-p 00000000 00:00 0                          [stack]\n";
+  EXPECT_EQ(findProcMapInode(maps, "/bin/a b"), "1111");
+  EXPECT_EQ(findProcMapInode(maps, "/bin/a (deleted)"), "2222");
+  EXPECT_EQ(findProcMapInode(maps, "/bin/a"), "");
+}
+
+TEST_F(ProcParseTest, map_line) {
+  ProcMapEntry entry;
+  ASSERT_TRUE(parseProcMapLine(
+      "55d0-55d1 r-xp 00001000 fd:01 2222                       /bin/a b",
+      entry));
+  EXPECT_EQ(entry.start, "55d0");
+  EXPECT_EQ(entry.end, "55d1");
+  EXPECT_EQ(entry.permissions, "r-xp");
+  EXPECT_EQ(entry.offset, "00001000");
+  EXPECT_EQ(entry.device, "fd:01");
+  EXPECT_EQ(entry.inode, "2222");
+  EXPECT_EQ(entry.path, "/bin/a b");
+
+  // Anonymous mappings have no path.
+  ASSERT_TRUE(parseProcMapLine("7ffd-7ffe rw-p 00000000 00:00 0 ", entry));
+  EXPECT_EQ(entry.inode, "0");
+  EXPECT_TRUE(entry.path.empty());
+
+  EXPECT_FALSE(parseProcMapLine("7ffd rw-p 00000000 00:00 0", entry));
+  EXPECT_FALSE(parseProcMapLine("7ffd-7ffe rw-p 00000000", entry));
+  EXPECT_FALSE(parseProcMapLine("", entry));
+}
+
+TEST_F(ProcParseTest, map_path_filter) {
+  ProcMapPathFilter filter;
+  EXPECT_TRUE(filter.matches("/usr/lib/libc.so"));
+
+  // LIKE ignores the ASCII case, the filter must not drop those paths.
+  filter.prefixes = {"/USR/Lib/"};
+  EXPECT_TRUE(filter.matches("/usr/lib/libc.so"));
+  EXPECT_TRUE(filter.matches("/usr/LIB/libc.so"));
+  EXPECT_FALSE(filter.matches("/usr/lib"));
+  EXPECT_FALSE(filter.matches("/opt/lib/libc.so"));
+
+  filter.values = {"/usr/lib/libc.so"};
+  EXPECT_TRUE(filter.matches("/usr/lib/libc.so"));
+  EXPECT_FALSE(filter.matches("/usr/lib/libm.so"));
+}
+
 } // namespace tables
 } // namespace osquery
\ No newline at end of file
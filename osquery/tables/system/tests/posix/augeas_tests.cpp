@@ -136,5 +136,24 @@ TEST_F(AugeasTests, select_file_wildcards) {
       SQL("select * from augeas where path LIKE '/%/hosts'").rows().size(), 1U);
 }
 
+TEST_F(AugeasTests, select_file_before_and_after_full_load) {
+  // A path constraint may load only the requested file, a LIKE constraint
+  // loads every file. Both must produce the same rows for the file.
+  auto before = SQL("select * from augeas where path = '/etc/hosts'");
+  ASSERT_GE(before.rows().size(), 1U);
+
+  auto all = SQL("select * from augeas where path LIKE '/etc/hosts'");
+  EXPECT_EQ(all.rows().size(), before.rows().size());
+
+  auto after = SQL("select * from augeas where path = '/etc/hosts'");
+  EXPECT_EQ(after.rows(), before.rows());
+
+  // The load set of the lenses is restored for the full load.
+  EXPECT_GT(SQL("select * from augeas where node LIKE '/augeas/load/%'")
+                .rows()
+                .size(),
+            100U);
+}
+
 } // namespace tables
 } // namespace osquery
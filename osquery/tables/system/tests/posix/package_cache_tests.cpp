@@ -0,0 +1,93 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+
+#include <osquery/tables/system/package_cache.h>
+#include <osquery/utils/scope_guard.h>
+
+namespace osquery {
+namespace tables {
+
+class PackageCacheTests : public testing::Test {
+ protected:
+  void TearDown() override {
+    PackageCache::get().clear();
+  }
+};
+
+TEST_F(PackageCacheTests, test_paths_signature) {
+  namespace fs = boost::filesystem;
+
+  auto directory = fs::temp_directory_path() /
+                   fs::unique_path("osquery.package_cache_tests.%%%%-%%%%");
+  ASSERT_TRUE(fs::create_directories(directory));
+  auto const path_guard =
+      scope_guard::create([directory]() { fs::remove_all(directory); });
+
+  auto status = (directory / "status").string();
+  std::vector<std::string> paths{directory.string(), status};
+  auto missing = getPathsSignature(paths);
+  EXPECT_EQ(missing, getPathsSignature(paths));
+
+  {
+    std::ofstream fout(status);
+    fout << "Package: osquery\n";
+  }
+  auto created = getPathsSignature(paths);
+  EXPECT_NE(missing, created);
+  EXPECT_EQ(created, getPathsSignature(paths));
+
+  // A package manager replacing the file changes the inode.
+  auto replacement = (directory / "status-new").string();
+  {
+    std::ofstream fout(replacement);
+    fout << "Package: osquery\n";
+  }
+  fs::rename(replacement, status);
+  EXPECT_NE(created, getPathsSignature(paths));
+}
+
+TEST_F(PackageCacheTests, test_lookup) {
+  auto& cache = PackageCache::get();
+  QueryData rows;
+  EXPECT_FALSE(cache.lookup("deb_packages:/var/lib/dpkg", "1", rows));
+
+  QueryData packages{{{"name", "osquery"}, {"version", "5.0.0"}}};
+  cache.store("deb_packages:/var/lib/dpkg", "1", packages);
+  ASSERT_TRUE(cache.lookup("deb_packages:/var/lib/dpkg", "1", rows));
+  EXPECT_EQ(packages, rows);
+
+  // The database changed.
+  EXPECT_FALSE(cache.lookup("deb_packages:/var/lib/dpkg", "2", rows));
+  EXPECT_FALSE(cache.lookup("deb_packages:/var/lib/other", "1", rows));
+
+  cache.clear();
+  EXPECT_FALSE(cache.lookup("deb_packages:/var/lib/dpkg", "1", rows));
+}
+
+TEST_F(PackageCacheTests, test_max_rows) {
+  auto& cache = PackageCache::get();
+  ASSERT_GT(cache.maxRows(), 0U);
+
+  QueryData rows;
+  QueryData packages(cache.maxRows() + 1, Row{{"name", "osquery"}});
+  cache.store("rpm_package_files", "1", packages);
+  EXPECT_FALSE(cache.lookup("rpm_package_files", "1", rows));
+
+  packages.pop_back();
+  cache.store("rpm_package_files", "1", packages);
+  EXPECT_TRUE(cache.lookup("rpm_package_files", "1", rows));
+}
+
+} // namespace tables
+} // namespace osquery
@@ -153,5 +153,51 @@ TEST_F(ShellHistoryTests, bash_sessions_empty_ts) {
   fs::remove_all(directory);
 }
 
+TEST_F(ShellHistoryTests, appended_history) {
+  std::vector<DynamicTableRowHolder> results;
+  auto predicate = [&results](DynamicTableRowHolder& r) {
+    results.push_back(std::move(r));
+  };
+
+  auto directory =
+      fs::temp_directory_path() /
+      fs::unique_path("osquery.shell_history_tests.appended.%%%%-%%%%");
+  ASSERT_TRUE(fs::create_directory(directory));
+  auto filepath = directory / fs::path(".bash_history");
+  auto append = [&filepath](const std::string& content) {
+    auto fout = std::ofstream(filepath.native(),
+                              std::ios::out | std::ios::app | std::ios::binary);
+    fout << content;
+  };
+
+  // A timestamp is kept until its command is appended.
+  append("ls\n#1600000000\n");
+  auto const uid = std::to_string(geteuid());
+  auto const gid = std::to_string(getegid());
+  genShellHistoryForUser(uid, gid, directory.native(), predicate);
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_EQ(results[0]["command"], "ls");
+
+  append("cd /tmp\npwd");
+  results.clear();
+  genShellHistoryForUser(uid, gid, directory.native(), predicate);
+  ASSERT_EQ(results.size(), 3u);
+  EXPECT_EQ(results[0]["command"], "ls");
+  EXPECT_EQ(results[1]["time"], "1600000000");
+  EXPECT_EQ(results[1]["command"], "cd /tmp");
+  EXPECT_EQ(results[2]["command"], "pwd");
+
+  // A rewritten history is parsed again.
+  {
+    auto fout = std::ofstream(filepath.native(), std::ios::binary);
+    fout << "whoami\n";
+  }
+  results.clear();
+  genShellHistoryForUser(uid, gid, directory.native(), predicate);
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_EQ(results[0]["command"], "whoami");
+  fs::remove_all(directory);
+}
+
 } // namespace tables
 } // namespace osquery
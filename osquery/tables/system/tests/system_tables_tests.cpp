@@ -24,13 +24,22 @@
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/sql/sql.h>
+#include <osquery/tables/system/hash.h>
+#include <osquery/tables/system/system_utils.h>
 #include <osquery/tests/test_util.h>
+#include <osquery/utils/conversions/join.h>
+#include <osquery/utils/conversions/split.h>
 #include <osquery/utils/info/platform_type.h>
+#include <osquery/worker/logging/glog/glog_logger.h>
 #ifdef OSQUERY_WINDOWS
 #include <osquery/utils/conversions/windows/strings.h>
 #endif
 
 namespace osquery {
+
+DECLARE_uint32(table_user_threads);
+DECLARE_uint32(hash_cache_database_max);
+
 namespace tables {
 
 class SystemsTablesTests : public testing::Test {
@@ -312,6 +321,40 @@ TEST_F(SystemsTablesTests, test_win_crashes_parsing) {
   EXPECT_FALSE(results.rows()[0].at("stack_trace").empty());
 }
 
+TEST_F(SystemsTablesTests, test_for_each_user_parallel) {
+  QueryData users;
+  for (size_t i = 0; i < 32; ++i) {
+    users.push_back({{"uid", std::to_string(i)}});
+  }
+
+  auto generate = [](const Row& user, QueryData& rows) {
+    rows.push_back({{"uid", user.at("uid")}, {"line", "0"}});
+    rows.push_back({{"uid", user.at("uid")}, {"line", "1"}});
+  };
+
+  // The rows of each user are returned in order of users, serially or not.
+  auto threads = FLAGS_table_user_threads;
+  for (auto count : {0U, 1U, 4U}) {
+    FLAGS_table_user_threads = count;
+    auto results = forEachUserParallel(users, generate);
+    ASSERT_EQ(results.size(), 64U);
+    for (size_t i = 0; i < results.size(); ++i) {
+      EXPECT_EQ(results[i]["uid"], std::to_string(i / 2));
+      EXPECT_EQ(results[i]["line"], std::to_string(i % 2));
+    }
+  }
+
+  // Exceptions thrown by the generator are rethrown to the caller.
+  EXPECT_THROW(forEachUserParallel(users,
+                                   [](const Row& user, QueryData& rows) {
+                                     if (user.at("uid") == "7") {
+                                       throw std::runtime_error("user");
+                                     }
+                                   }),
+               std::runtime_error);
+  FLAGS_table_user_threads = threads;
+}
+
 class HashTableTest : public testing::Test {
  public:
   const std::vector<std::string> content{"31337 hax0r", "random n00b"};
@@ -330,6 +373,9 @@ class HashTableTest : public testing::Test {
 
  protected:
   virtual void SetUp() {
+    registryAndPluginInit();
+    initDatabasePluginForTesting();
+
     tmpPath = boost::filesystem::temp_directory_path();
     tmpPath /= boost::filesystem::unique_path(
         "osquery_hash_t_test-%%%%-%%%%-%%%%-%%%%");
@@ -390,5 +436,82 @@ TEST_F(HashTableTest, test_cache_updates) {
   EXPECT_NE(rows[0].at("md5"), contentMd5);
   EXPECT_EQ(rows[0].at("md5"), badContentMd5);
 }
+
+/// The kFileHashes key of a file, its device, inode and path.
+static std::string getStoredHashKey(const boost::filesystem::path& path) {
+  struct stat st;
+  EXPECT_EQ(stat(path.string().c_str(), &st), 0);
+  return std::to_string(st.st_dev) + "." + std::to_string(st.st_ino) + "." +
+         path.string();
+}
+
+TEST_F(HashTableTest, test_stored_hashes_hit) {
+  SetContent(0);
+  GLOGLogger logger;
+  MultiHashes hashes;
+  ASSERT_TRUE(loadFileHashes(tmpPath.string(), HASH_TYPE_MD5, hashes, logger));
+  EXPECT_EQ(hashes.md5, contentMd5);
+
+  // Only the MD5 is stored, add a SHA1 that cannot come from the file.
+  auto key = getStoredHashKey(tmpPath);
+  std::string value;
+  ASSERT_TRUE(getDatabaseValue(kFileHashes, key, value).ok());
+  auto fields = split(value, " ");
+  ASSERT_EQ(fields.size(), 6U);
+  fields[4] = std::to_string(HASH_TYPE_MD5 | HASH_TYPE_SHA1);
+  fields.push_back("stored");
+  ASSERT_TRUE(setDatabaseValue(kFileHashes, key, join(fields, " ")).ok());
+
+  ASSERT_TRUE(loadFileHashes(
+      tmpPath.string(), HASH_TYPE_MD5 | HASH_TYPE_SHA1, hashes, logger));
+  EXPECT_EQ(hashes.md5, contentMd5);
+  EXPECT_EQ(hashes.sha1, "stored");
+}
+
+TEST_F(HashTableTest, test_stored_hashes_invalidated) {
+  SetContent(0);
+  GLOGLogger logger;
+  MultiHashes hashes;
+  ASSERT_TRUE(loadFileHashes(tmpPath.string(), HASH_TYPE_MD5, hashes, logger));
+  EXPECT_EQ(hashes.md5, contentMd5);
+
+  // The inode and path are kept, the size changes.
+  boost::filesystem::resize_file(tmpPath, 0);
+  writeTextFile(tmpPath, "changed");
+  ASSERT_TRUE(loadFileHashes(tmpPath.string(), HASH_TYPE_MD5, hashes, logger));
+  EXPECT_EQ(hashes.md5, hashFromFile(HASH_TYPE_MD5, tmpPath.string()));
+  EXPECT_NE(hashes.md5, contentMd5);
+}
+
+TEST_F(HashTableTest, test_stored_hashes_purge) {
+  auto other = tmpPath.string() + ".other";
+  SetContent(0);
+  writeTextFile(other, content[1]);
+
+  GLOGLogger logger;
+  MultiHashes hashes;
+  ASSERT_TRUE(loadFileHashes(tmpPath.string(), HASH_TYPE_MD5, hashes, logger));
+  ASSERT_TRUE(loadFileHashes(other, HASH_TYPE_MD5, hashes, logger));
+
+  // The first file is the least recently used.
+  auto key = getStoredHashKey(tmpPath);
+  auto other_key = getStoredHashKey(other);
+  std::string value;
+  ASSERT_TRUE(getDatabaseValue(kFileHashes, key, value).ok());
+  value = "1" + value.substr(value.find(' '));
+  ASSERT_TRUE(setDatabaseValue(kFileHashes, key, value).ok());
+
+  auto max = FLAGS_hash_cache_database_max;
+  FLAGS_hash_cache_database_max = 1;
+  purgeStoredHashes();
+  FLAGS_hash_cache_database_max = max;
+  EXPECT_FALSE(getDatabaseValue(kFileHashes, key, value).ok());
+  EXPECT_TRUE(getDatabaseValue(kFileHashes, other_key, value).ok());
+
+  // The hashes of removed files are deleted.
+  removePath(other);
+  purgeStoredHashes();
+  EXPECT_FALSE(getDatabaseValue(kFileHashes, other_key, value).ok());
+}
 } // namespace tables
 } // namespace osquery
@@ -53,6 +53,17 @@ TEST_F(RegistryTablesTest, test_expand_registry_globs) {
   EXPECT_TRUE(results.empty());
 }
 
+TEST_F(RegistryTablesTest, test_expand_registry_globs_pruning) {
+  // Only the subkeys matching each element are descended into.
+  std::set<std::string> results;
+  auto s = expandRegistryGlobs("HKEY_LOCAL_M%\\SOFTWARE\\micro%", results);
+  ASSERT_TRUE(s.ok());
+  EXPECT_TRUE(results.count("HKEY_LOCAL_MACHINE\\SOFTWARE\\Microsoft") == 1);
+  for (const auto& key : results) {
+    EXPECT_TRUE(boost::istarts_with(key, kTestKey + "\\Micro"));
+  }
+}
+
 TEST_F(RegistryTablesTest, test_query_multiple_registry_keys) {
   QueryData test_results;
   auto s = queryMultipleRegistryKeys({kTestKey}, test_results);
@@ -21,7 +21,9 @@ QueryData genChassisInfo(QueryContext& context) {
   QueryData results;
 
   Expected<WmiRequest, WmiError> wmiSystemReq =
-      WmiRequest::CreateWmiRequest("SELECT * FROM Win32_SystemEnclosure");
+      WmiRequest::CreateWmiRequest("SELECT * FROM Win32_SystemEnclosure",
+                                   L"ROOT\\CIMV2",
+                                   std::chrono::minutes(5));
 
   // check if the results are empty and return a warning if so
   if (!wmiSystemReq || wmiSystemReq->results().empty()) {
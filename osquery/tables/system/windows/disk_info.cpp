@@ -23,7 +23,9 @@ QueryData genDiskInfo(QueryContext& context) {
   QueryData results;
 
   const Expected<WmiRequest, WmiError> wmiSystemReq =
-      WmiRequest::CreateWmiRequest("select * from Win32_DiskDrive");
+      WmiRequest::CreateWmiRequest("select * from Win32_DiskDrive",
+                                   L"ROOT\\CIMV2",
+                                   std::chrono::minutes(1));
   if (!wmiSystemReq || wmiSystemReq->results().empty()) {
     LOG(WARNING) << "Error retrieving information from WMI.";
     return results;
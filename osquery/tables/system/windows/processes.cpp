@@ -7,6 +7,7 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <map>
 #include <string>
 
@@ -180,6 +181,63 @@ typedef struct _PS_PROTECTION {
   };
 } PS_PROTECTION, *PPS_PROTECTION;
 
+// The full SystemProcessInformation entry, winternl.h only has a few fields.
+// See the Process Hacker definition for more details
+// https://github.com/processhacker/processhacker/blob/master/phnt/include/ntexapi.h
+typedef struct _SYSTEM_PROCESS_INFORMATION_FULL {
+  ULONG NextEntryOffset;
+  ULONG NumberOfThreads;
+  LARGE_INTEGER WorkingSetPrivateSize;
+  ULONG HardFaultCount;
+  ULONG NumberOfThreadsHighWatermark;
+  ULONGLONG CycleTime;
+  LARGE_INTEGER CreateTime;
+  LARGE_INTEGER UserTime;
+  LARGE_INTEGER KernelTime;
+  UNICODE_STRING ImageName;
+  LONG BasePriority;
+  HANDLE UniqueProcessId;
+  HANDLE InheritedFromUniqueProcessId;
+  ULONG HandleCount;
+  ULONG SessionId;
+  ULONG_PTR UniqueProcessKey;
+  SIZE_T PeakVirtualSize;
+  SIZE_T VirtualSize;
+  ULONG PageFaultCount;
+  SIZE_T PeakWorkingSetSize;
+  SIZE_T WorkingSetSize;
+  SIZE_T QuotaPeakPagedPoolUsage;
+  SIZE_T QuotaPagedPoolUsage;
+  SIZE_T QuotaPeakNonPagedPoolUsage;
+  SIZE_T QuotaNonPagedPoolUsage;
+  SIZE_T PagefileUsage;
+  SIZE_T PeakPagefileUsage;
+  SIZE_T PrivatePageCount;
+  LARGE_INTEGER ReadOperationCount;
+  LARGE_INTEGER WriteOperationCount;
+  LARGE_INTEGER OtherOperationCount;
+  LARGE_INTEGER ReadTransferCount;
+  LARGE_INTEGER WriteTransferCount;
+  LARGE_INTEGER OtherTransferCount;
+} SYSTEM_PROCESS_INFORMATION_FULL, *PSYSTEM_PROCESS_INFORMATION_FULL;
+
+/// Columns that need a handle to the process.
+const std::vector<std::string> kProcessHandleColumns = {
+    "nice",
+    "protection_type",
+    "secure_process",
+    "virtual_process",
+    "path",
+    "on_disk",
+    "cwd",
+    "root",
+    "cmdline",
+    "uid",
+    "gid",
+    "elevated_token",
+    "state",
+};
+
 /// Given a pid, enumerates all loaded modules and memory pages for that process
 Status genMemoryMap(unsigned long pid, QueryData& results) {
   auto proc = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, pid);
@@ -471,56 +529,82 @@ void genProcessUserTokenInfo(HANDLE& proc, DynamicTableRowHolder& r) {
   }
 }
 
-void genProcessTimeInfo(HANDLE& proc, DynamicTableRowHolder& r) {
-  FILETIME create_time;
-  FILETIME exit_time;
-  FILETIME kernel_time;
-  FILETIME user_time;
-  auto ret =
-      GetProcessTimes(proc, &create_time, &exit_time, &kernel_time, &user_time);
-  if (ret == FALSE) {
-    LOG(ERROR) << "Failed to lookup time data for process "
-               << GetProcessId(proc);
-  } else {
-    // Windows stores proc times in 100 nanosecond ticks
-    ULARGE_INTEGER utime;
-    utime.HighPart = user_time.dwHighDateTime;
-    utime.LowPart = user_time.dwLowDateTime;
-    auto user_time_total = utime.QuadPart;
-    r["user_time"] = BIGINT(user_time_total / 10000);
-    utime.HighPart = kernel_time.dwHighDateTime;
-    utime.LowPart = kernel_time.dwLowDateTime;
-    r["system_time"] = BIGINT(utime.QuadPart / 10000);
-    r["percent_processor_time"] = BIGINT(user_time_total + utime.QuadPart);
-
-    auto proc_create_time = osquery::filetimeToUnixtime(create_time);
-    r["start_time"] = BIGINT(proc_create_time);
-
-    FILETIME curr_ft_time;
-    SYSTEMTIME curr_sys_time;
-    GetSystemTime(&curr_sys_time);
-    SystemTimeToFileTime(&curr_sys_time, &curr_ft_time);
-    r["elapsed_time"] =
-        BIGINT(osquery::filetimeToUnixtime(curr_ft_time) - proc_create_time);
+/**
+ * @brief Read the SystemProcessInformation entries of every process.
+ *
+ * The buffer is kept 8 byte aligned for the entries and grown until the
+ * snapshot fits.
+ */
+Status getSystemProcessSnapshot(std::vector<ULONGLONG>& buffer) {
+  if (buffer.empty()) {
+    buffer.resize(0x40000 / sizeof(ULONGLONG));
+  }
+
+  NTSTATUS status = STATUS_INFO_LENGTH_MISMATCH;
+  for (size_t attempt = 0; attempt < 8; ++attempt) {
+    ULONG size = 0;
+    status = NtQuerySystemInformation(
+        SystemProcessInformation,
+        buffer.data(),
+        static_cast<ULONG>(buffer.size() * sizeof(ULONGLONG)),
+        &size);
+    if (status != STATUS_INFO_LENGTH_MISMATCH &&
+        status != STATUS_BUFFER_TOO_SMALL) {
+      break;
+    }
+
+    // Leave room for the processes started before the next call.
+    buffer.resize((size + size / 8) / sizeof(ULONGLONG) + 1);
   }
+
+  if (!NT_SUCCESS(status)) {
+    return Status::failure("NtQuerySystemInformation failed with " +
+                           std::to_string(status));
+  }
+  return Status::success();
 }
 
-void genProcRssInfo(HANDLE& proc, DynamicTableRowHolder& r) {
-  PROCESS_MEMORY_COUNTERS_EX mem_ctr;
-  auto ret =
-      GetProcessMemoryInfo(proc,
-                           reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&mem_ctr),
-                           sizeof(PROCESS_MEMORY_COUNTERS_EX));
+/// Convert a duration in 100 nanosecond ticks to milliseconds.
+static inline LONGLONG ticksToMilliseconds(const LARGE_INTEGER& ticks) {
+  return ticks.QuadPart / 10000;
+}
 
-  if (ret != TRUE) {
-    LOG(ERROR) << "Failed to lookup RSS stats for process "
-               << GetProcessId(proc);
-  }
-  r["wired_size"] =
-      ret == TRUE ? BIGINT(mem_ctr.QuotaNonPagedPoolUsage) : BIGINT(-1);
-  r["resident_size"] =
-      ret == TRUE ? BIGINT(mem_ctr.WorkingSetSize) : BIGINT(-1);
-  r["total_size"] = ret == TRUE ? BIGINT(mem_ctr.PrivateUsage) : BIGINT(-1);
+/// Fill the columns read from the SystemProcessInformation entry.
+void genProcessSnapshotInfo(const SYSTEM_PROCESS_INFORMATION_FULL& proc,
+                            LONGLONG now,
+                            DynamicTableRowHolder& r) {
+  auto pid = static_cast<unsigned long>(
+      reinterpret_cast<ULONG_PTR>(proc.UniqueProcessId));
+  r["pid"] = BIGINT(pid);
+  r["parent"] = BIGINT(reinterpret_cast<ULONG_PTR>(
+      proc.InheritedFromUniqueProcessId));
+  if (pid == 0) {
+    r["name"] = SQL_TEXT("[System Process]");
+  } else {
+    r["name"] = SQL_TEXT(wstringToString(
+        std::wstring(proc.ImageName.Buffer,
+                     proc.ImageName.Length / sizeof(WCHAR))));
+  }
+  r["threads"] = INTEGER(proc.NumberOfThreads);
+
+  // Windows stores proc times in 100 nanosecond ticks
+  r["user_time"] = BIGINT(ticksToMilliseconds(proc.UserTime));
+  r["system_time"] = BIGINT(ticksToMilliseconds(proc.KernelTime));
+  r["percent_processor_time"] =
+      BIGINT(proc.UserTime.QuadPart + proc.KernelTime.QuadPart);
+  if (proc.CreateTime.QuadPart != 0) {
+    auto create_time = proc.CreateTime;
+    auto start_time = osquery::longIntToUnixtime(create_time);
+    r["start_time"] = BIGINT(start_time);
+    r["elapsed_time"] = BIGINT(now - start_time);
+  }
+
+  r["wired_size"] = BIGINT(proc.QuotaNonPagedPoolUsage);
+  r["resident_size"] = BIGINT(proc.WorkingSetSize);
+  r["total_size"] = BIGINT(proc.PrivatePageCount);
+  r["disk_bytes_read"] = BIGINT(proc.ReadTransferCount.QuadPart);
+  r["disk_bytes_written"] = BIGINT(proc.WriteTransferCount.QuadPart);
+  r["handle_count"] = INTEGER(proc.HandleCount);
 }
 
 PS_PROTECTED_TYPE getProcessProtectedType(HANDLE& proc,
@@ -540,6 +624,97 @@ PS_PROTECTED_TYPE getProcessProtectedType(HANDLE& proc,
   return PS_PROTECTED_TYPE::PsProtectedTypeNone;
 }
 
+/// Fill the columns that need a handle to the process.
+void genProcessHandleInfo(QueryContext& context,
+                          const unsigned long pid,
+                          DynamicTableRowHolder& r) {
+  auto proc_handle = OpenProcess(PROCESS_ALL_ACCESS, FALSE, pid);
+  auto const proc_handle_manager =
+      scope_guard::create([&proc_handle]() { CloseHandle(proc_handle); });
+
+  // If we fail to get all privs, open with less permissions
+  if (proc_handle == NULL) {
+    proc_handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+  }
+
+  if (proc_handle == NULL) {
+    VLOG(1) << "Failed to open handle to process " << pid << " with "
+            << GetLastError();
+    return;
+  }
+
+  if (context.isColumnUsed("nice")) {
+    auto nice = GetPriorityClass(proc_handle);
+    r["nice"] = nice != FALSE ? INTEGER(nice) : "-1";
+  }
+
+  auto protection = getProcessProtectedType(proc_handle, pid);
+  r["protection_type"] = SQL_TEXT(kProtectedTypes.at(protection));
+
+  bool isProtectedProcess =
+      protection != PS_PROTECTED_TYPE::PsProtectedTypeNone;
+  bool isSecureProcess = false;
+  bool isVirtualProcess = false;
+  {
+    PROCESS_EXTENDED_BASIC_INFORMATION pebi{0};
+    unsigned long len{0};
+    NTSTATUS status = NtQueryInformationProcess(
+        proc_handle, ProcessBasicInformation, &pebi, sizeof(pebi), &len);
+    // Handle return on pre Windows 8.1 and just populate the non extended
+    // ProcessBasicInformation variant
+    if (status == STATUS_INFO_LENGTH_MISMATCH) {
+      status = NtQueryInformationProcess(proc_handle,
+                                         ProcessBasicInformation,
+                                         &pebi.BasicInfo,
+                                         sizeof(pebi.BasicInfo),
+                                         &len);
+    }
+    if (NT_SUCCESS(status)) {
+      isSecureProcess = pebi.s.IsSecureProcess;
+      r["secure_process"] = BIGINT(isSecureProcess);
+      isVirtualProcess = pebi.BasicInfo.PebBaseAddress == NULL;
+      r["virtual_process"] = BIGINT(isVirtualProcess);
+    } else {
+      VLOG(1) << "Failed to query ProcessBasicInformation for pid " << pid
+              << " with " << status;
+    }
+  }
+
+  if (context.isAnyColumnUsed({"path", "on_disk"})) {
+    getProcessPathInfo(proc_handle, pid, r);
+  }
+
+  if (context.isAnyColumnUsed({"cwd", "root"}) && !isProtectedProcess &&
+      !isSecureProcess && !isVirtualProcess) {
+    getProcessCurrentDirectoryInfo(proc_handle, pid, r);
+  }
+
+  if (context.isColumnUsed("cmdline") && !isSecureProcess &&
+      !isVirtualProcess) {
+    std::string cmd{""};
+    auto s = getProcessCommandLine(proc_handle, cmd, pid);
+    if (!s.ok()) {
+      s = getProcessCommandLineLegacy(proc_handle, cmd, pid);
+    }
+    r["cmdline"] = cmd;
+  }
+
+  if (context.isAnyColumnUsed({"uid", "gid", "elevated_token"})) {
+    genProcessUserTokenInfo(proc_handle, r);
+  }
+
+  /*
+   * Note: On windows the concept of the process state isn't as clear as on
+   * posix. The state value from WMI isn't currently returning anything, and
+   * the most common way to get the state is as follows.
+   */
+  if (context.isColumnUsed("state")) {
+    unsigned long exit_code = 0;
+    GetExitCodeProcess(proc_handle, &exit_code);
+    r["state"] = exit_code == STILL_ACTIVE ? "STILL_ACTIVE" : "EXITED";
+  }
+}
+
 TableRows genProcesses(QueryContext& context) {
   TableRows results;
 
@@ -555,39 +730,43 @@ TableRows genProcesses(QueryContext& context) {
     }
   }
 
-  auto proc_snap = CreateToolhelp32Snapshot(TH32CS_SNAPALL, NULL);
-  auto const proc_snap_manager =
-      scope_guard::create([&proc_snap]() { CloseHandle(proc_snap); });
-  if (proc_snap == INVALID_HANDLE_VALUE) {
-    LOG(ERROR) << "Failed to create snapshot of processes with "
-               << std::to_string(GetLastError());
+  // A single snapshot has the base columns of every process, a handle to a
+  // process is only opened for the columns that need it.
+  std::vector<ULONGLONG> snapshot;
+  auto status = getSystemProcessSnapshot(snapshot);
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to create snapshot of processes: "
+               << status.getMessage();
     return {};
   }
 
-  PROCESSENTRY32W proc;
-  proc.dwSize = sizeof(PROCESSENTRY32W);
+  bool needs_handle = std::any_of(
+      kProcessHandleColumns.begin(),
+      kProcessHandleColumns.end(),
+      [&context](const std::string& column) {
+        return context.isColumnUsed(column);
+      });
 
-  auto ret = Process32FirstW(proc_snap, &proc);
-  if (ret == FALSE) {
-    LOG(ERROR) << "Failed to acquire first process information with "
-               << std::to_string(GetLastError());
-    return {};
-  }
+  FILETIME curr_ft_time;
+  SYSTEMTIME curr_sys_time;
+  GetSystemTime(&curr_sys_time);
+  SystemTimeToFileTime(&curr_sys_time, &curr_ft_time);
+  auto now = osquery::filetimeToUnixtime(curr_ft_time);
 
-  while (ret != FALSE) {
-    auto pid = proc.th32ProcessID;
+  auto entry = reinterpret_cast<const BYTE*>(snapshot.data());
+  for (ULONG next = 1; next != 0; entry += next) {
+    const auto& proc =
+        *reinterpret_cast<const SYSTEM_PROCESS_INFORMATION_FULL*>(entry);
+    auto pid = static_cast<unsigned long>(
+        reinterpret_cast<ULONG_PTR>(proc.UniqueProcessId));
+    next = proc.NextEntryOffset;
 
     bool wanted_pid = (pidlist.empty() || pidlist.count(pid) > 0);
     if (!wanted_pid) {
-      ret = Process32NextW(proc_snap, &proc);
       continue;
     }
 
     auto r = make_table_row();
-    r["pid"] = BIGINT(pid);
-    r["parent"] = BIGINT(proc.th32ParentProcessID);
-    r["name"] = SQL_TEXT(wstringToString(proc.szExeFile));
-    r["threads"] = INTEGER(proc.cntThreads);
 
     // Set default values for columns, in the event opening the process fails
     r["pgroup"] = BIGINT(-1);
@@ -598,150 +777,22 @@ TableRows genProcesses(QueryContext& context) {
     r["uid"] = BIGINT(-1);
     r["gid"] = BIGINT(-1);
 
-    r["user_time"] = BIGINT(-1);
-    r["system_time"] = BIGINT(-1);
     r["start_time"] = BIGINT(-1);
     r["elapsed_time"] = BIGINT(-1);
-    r["percent_processor_time"] = BIGINT(-1);
 
     r["nice"] = BIGINT(-1);
-    r["wired_size"] = BIGINT(-1);
-    r["resident_size"] = BIGINT(-1);
-    r["total_size"] = BIGINT(-1);
-    r["disk_bytes_read"] = BIGINT(-1);
-    r["disk_bytes_written"] = BIGINT(-1);
-    r["handle_count"] = BIGINT(-1);
-
     r["on_disk"] = BIGINT(-1);
     r["elevated_token"] = BIGINT(-1);
     r["secure_process"] = BIGINT(-1);
     r["protection_type"] = SQL_TEXT("");
     r["virtual_process"] = BIGINT(-1);
 
-    if (pid == 0) {
-      results.push_back(r);
-      ret = Process32NextW(proc_snap, &proc);
-      continue;
-    }
-
-    auto proc_handle = OpenProcess(PROCESS_ALL_ACCESS, FALSE, pid);
-    auto const proc_handle_manager =
-        scope_guard::create([&proc_handle]() { CloseHandle(proc_handle); });
-
-    // If we fail to get all privs, open with less permissions
-    if (proc_handle == NULL) {
-      proc_handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
-    }
-
-    if (proc_handle == NULL) {
-      VLOG(1) << "Failed to open handle to process " << pid << " with "
-              << GetLastError();
-      results.push_back(r);
-      ret = Process32NextW(proc_snap, &proc);
-      continue;
-    }
-
-    auto nice = GetPriorityClass(proc_handle);
-    r["nice"] = nice != FALSE ? INTEGER(nice) : "-1";
-
-    auto protection = getProcessProtectedType(proc_handle, pid);
-    r["protection_type"] = SQL_TEXT(kProtectedTypes.at(protection));
-
-    bool isProtectedProcess =
-        protection != PS_PROTECTED_TYPE::PsProtectedTypeNone;
-    bool isSecureProcess = false;
-    bool isVirtualProcess = false;
-    {
-      PROCESS_EXTENDED_BASIC_INFORMATION pebi{0};
-      unsigned long len{0};
-      NTSTATUS status = NtQueryInformationProcess(
-          proc_handle, ProcessBasicInformation, &pebi, sizeof(pebi), &len);
-      // Handle return on pre Windows 8.1 and just populate the non extended
-      // ProcessBasicInformation variant
-      if (status == STATUS_INFO_LENGTH_MISMATCH) {
-        status = NtQueryInformationProcess(proc_handle,
-                                           ProcessBasicInformation,
-                                           &pebi.BasicInfo,
-                                           sizeof(pebi.BasicInfo),
-                                           &len);
-      }
-      if (NT_SUCCESS(status)) {
-        isSecureProcess = pebi.s.IsSecureProcess;
-        r["secure_process"] = BIGINT(isSecureProcess);
-        isVirtualProcess = pebi.BasicInfo.PebBaseAddress == NULL;
-        r["virtual_process"] = BIGINT(isVirtualProcess);
-      } else {
-        VLOG(1) << "Failed to query ProcessBasicInformation for pid "
-                << proc.th32ProcessID << " with " << status;
-      }
-    }
-
-    if (context.isAnyColumnUsed({"path", "on_disk"})) {
-      getProcessPathInfo(proc_handle, pid, r);
-    }
-
-    if (context.isAnyColumnUsed({"cwd", "root"}) && !isProtectedProcess &&
-        !isSecureProcess && !isVirtualProcess) {
-      getProcessCurrentDirectoryInfo(proc_handle, pid, r);
-    }
-
-    if (context.isColumnUsed("cmdline") && !isSecureProcess &&
-        !isVirtualProcess) {
-      std::string cmd{""};
-      auto s = getProcessCommandLine(
-          proc_handle, cmd, static_cast<unsigned long>(proc.th32ProcessID));
-      if (!s.ok()) {
-        s = getProcessCommandLineLegacy(
-            proc_handle, cmd, static_cast<unsigned long>(proc.th32ProcessID));
-      }
-      r["cmdline"] = cmd;
-    }
-
-    if (context.isAnyColumnUsed({"uid", "gid", "elevated_token"})) {
-      genProcessUserTokenInfo(proc_handle, r);
-    }
-
-    if (context.isAnyColumnUsed({"user_time",
-                                 "system_time",
-                                 "start_time",
-                                 "elapsed_time",
-                                 "percent_processor_time"})) {
-      genProcessTimeInfo(proc_handle, r);
-    }
-
-    if (context.isAnyColumnUsed(
-            {"wired_size", "resident_size", "total_size"})) {
-      genProcRssInfo(proc_handle, r);
-    }
+    genProcessSnapshotInfo(proc, now, r);
 
-    if (context.isAnyColumnUsed({"disk_bytes_read", "disk_bytes_written"})) {
-      IO_COUNTERS io_ctrs;
-      ret = GetProcessIoCounters(proc_handle, &io_ctrs);
-      r["disk_bytes_read"] =
-          ret == TRUE ? BIGINT(io_ctrs.ReadTransferCount) : BIGINT(-1);
-      r["disk_bytes_written"] =
-          ret == TRUE ? BIGINT(io_ctrs.WriteTransferCount) : BIGINT(-1);
+    if (pid != 0 && needs_handle) {
+      genProcessHandleInfo(context, pid, r);
     }
-
-    if (context.isColumnUsed("handle_count")) {
-      unsigned long handle_count;
-      ret = GetProcessHandleCount(proc_handle, &handle_count);
-      r["handle_count"] = ret == TRUE ? INTEGER(handle_count) : "-1";
-    }
-
-    /*
-     * Note: On windows the concept of the process state isn't as clear as on
-     * posix. The state value from WMI isn't currently returning anything, and
-     * the most common way to get the state is as follows.
-     */
-    if (context.isColumnUsed("state")) {
-      unsigned long exit_code = 0;
-      GetExitCodeProcess(proc_handle, &exit_code);
-      r["state"] = exit_code == STILL_ACTIVE ? "STILL_ACTIVE" : "EXITED";
-    }
-
     results.push_back(r);
-    ret = Process32NextW(proc_snap, &proc);
   }
 
   return results;
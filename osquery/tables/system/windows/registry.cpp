@@ -13,19 +13,26 @@
 #include <sddl.h>
 // clang-format on
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <iterator>
 #include <map>
+#include <mutex>
 #include <string>
+#include <thread>
 
 #include <boost/algorithm/hex.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
 #include <boost/range/adaptor/map.hpp>
 #include <boost/range/algorithm.hpp>
 
 #include <sqlite3.h>
 
 #include <osquery/core/core.h>
+#include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
@@ -43,6 +50,12 @@
 namespace fs = boost::filesystem;
 
 namespace osquery {
+
+FLAG(uint32,
+     registry_concurrency,
+     4,
+     "Number of registry keys the registry table reads at once");
+
 namespace tables {
 
 auto closeRegHandle = [](HKEY handle) { RegCloseKey(handle); };
@@ -84,6 +97,93 @@ const std::vector<std::string> kClassKeys = {
 const std::vector<std::string> kClassExecSubKeys = {
     "InProcServer%", "InProcHandler%", "LocalServer%"};
 
+/// The longest registry key name, with its terminator.
+const DWORD kRegMaxKeyNameLength = 256;
+
+/**
+ * @brief Handles of the HKEY_USERS subkeys opened during a query.
+ *
+ * Queries such as HKEY_USERS\%\SOFTWARE\... open keys below the same user
+ * hives many times. Keys below a user are opened relative to a cached handle
+ * of the user's hive. The cache is shared by the threads of a query.
+ */
+class RegistryHandleCache : private boost::noncopyable {
+ public:
+  ~RegistryHandleCache() {
+    for (const auto& user : users_) {
+      if (user.second.second != nullptr) {
+        RegCloseKey(user.second.second);
+      }
+    }
+  }
+
+  /// Open a key of a hive for reading, the caller closes the handle.
+  LONG open(HKEY hive,
+            const std::string& hiveName,
+            const std::string& key,
+            HKEY& handle) {
+    if (hiveName != "HKEY_USERS" || key.empty()) {
+      return RegOpenKeyExW(
+          hive, stringToWstring(key).c_str(), 0, KEY_READ, &handle);
+    }
+
+    auto pos = key.find(kRegSep);
+    auto user = key.substr(0, pos);
+    auto subkey = (pos == std::string::npos) ? "" : key.substr(pos + 1);
+
+    HKEY userHandle = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = users_.find(user);
+      if (it == users_.end()) {
+        HKEY opened = nullptr;
+        auto ret = RegOpenKeyExW(
+            hive, stringToWstring(user).c_str(), 0, KEY_READ, &opened);
+        if (ret != ERROR_SUCCESS) {
+          opened = nullptr;
+        }
+        it = users_.emplace(user, std::make_pair(ret, opened)).first;
+      }
+
+      if (it->second.first != ERROR_SUCCESS) {
+        return it->second.first;
+      }
+      userHandle = it->second.second;
+    }
+
+    return RegOpenKeyExW(
+        userHandle, stringToWstring(subkey).c_str(), 0, KEY_READ, &handle);
+  }
+
+ private:
+  /// The result of opening each user hive, and its handle.
+  std::map<std::string, std::pair<LONG, HKEY>> users_;
+  std::mutex mutex_;
+};
+
+/// Call a function for every index below count on registry_concurrency
+/// threads.
+static void forEachRegistryKey(size_t count,
+                               const std::function<void(size_t)>& fn) {
+  std::atomic<size_t> next{0};
+  auto worker = [&fn, &next, count]() {
+    for (auto i = next++; i < count; i = next++) {
+      fn(i);
+    }
+  };
+
+  auto threads = std::min<size_t>(
+      count, std::max<uint32_t>(FLAGS_registry_concurrency, 1));
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < threads; ++i) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : workers) {
+    thread.join();
+  }
+}
+
 QueryData genRegistry(QueryContext& context);
 
 Status queryMultipleRegistryKeys(const std::vector<std::string>& keys,
@@ -214,8 +314,31 @@ inline void explodeRegistryPath(const std::string& path,
   }
 }
 
+/// Open a registry key for reading, through the cache if there is one.
+static LONG openRegistryKey(const std::string& hive,
+                            const std::string& key,
+                            HKEY& handle,
+                            RegistryHandleCache* cache) {
+  auto hiveHandle = kRegistryHives.at(hive);
+  if (cache != nullptr) {
+    return cache->open(hiveHandle, hive, key, handle);
+  }
+  return RegOpenKeyExW(
+      hiveHandle, stringToWstring(key).c_str(), 0, KEY_READ, &handle);
+}
+
+static Status queryKey(const std::string& keyPath,
+                       QueryData& results,
+                       RegistryHandleCache* cache);
+
 /// Microsoft helper function for getting the contents of a registry key
 Status queryKey(const std::string& keyPath, QueryData& results) {
+  return queryKey(keyPath, results, nullptr);
+}
+
+static Status queryKey(const std::string& keyPath,
+                       QueryData& results,
+                       RegistryHandleCache* cache) {
   std::string hive;
   std::string key;
   explodeRegistryPath(keyPath, hive, key);
@@ -225,11 +348,7 @@ Status queryKey(const std::string& keyPath, QueryData& results) {
   }
 
   HKEY hkey;
-  auto ret = RegOpenKeyExW(kRegistryHives.at(hive),
-                           stringToWstring(key).c_str(),
-                           0,
-                           KEY_READ,
-                           &hkey);
+  auto ret = openRegistryKey(hive, key, hkey, cache);
 
   if (ret != ERROR_SUCCESS) {
     return Status(ret, "Failed to open registry handle");
@@ -418,32 +537,120 @@ static inline void populateDefaultKeys(std::set<std::string>& rKeys) {
               std::inserter(rKeys, rKeys.end()));
 }
 
-inline Status populateSubkeys(std::set<std::string>& rKeys, bool replaceKeys) {
-  std::set<std::string> newKeys;
-  if (!replaceKeys) {
-    newKeys = rKeys;
+/// Get the names of the subkeys of a key, without reading its values.
+static Status enumerateSubkeys(const std::string& keyPath,
+                               std::vector<std::string>& names,
+                               RegistryHandleCache* cache) {
+  std::string hive;
+  std::string key;
+  explodeRegistryPath(keyPath, hive, key);
+
+  if (kRegistryHives.count(hive) != 1) {
+    return Status::success();
   }
 
-  for (const auto& key : rKeys) {
-    QueryData regResults;
-    auto ret = queryKey(key, regResults);
-    if (!ret.ok()) {
-      if (ret.getCode() == ERROR_FILE_NOT_FOUND) {
+  HKEY hkey;
+  auto ret = openRegistryKey(hive, key, hkey, cache);
+  if (ret != ERROR_SUCCESS) {
+    return Status(ret, "Failed to open registry handle");
+  }
+
+  reg_handle_t hRegistryHandle(hkey, closeRegHandle);
+
+  DWORD cSubKeys = 0;
+  auto retCode = RegQueryInfoKeyW(hRegistryHandle.get(),
+                                  nullptr,
+                                  nullptr,
+                                  nullptr,
+                                  &cSubKeys,
+                                  nullptr,
+                                  nullptr,
+                                  nullptr,
+                                  nullptr,
+                                  nullptr,
+                                  nullptr,
+                                  nullptr);
+  if (retCode != ERROR_SUCCESS) {
+    return Status(retCode, "Failed to query registry info for key");
+  }
+
+  auto achKey = std::make_unique<WCHAR[]>(kRegMaxKeyNameLength);
+  for (DWORD i = 0; i < cSubKeys; i++) {
+    DWORD cbName = kRegMaxKeyNameLength;
+    retCode = RegEnumKeyExW(hRegistryHandle.get(),
+                            i,
+                            achKey.get(),
+                            &cbName,
+                            nullptr,
+                            nullptr,
+                            nullptr,
+                            nullptr);
+    if (retCode != ERROR_SUCCESS) {
+      return Status(retCode, "Failed to enumerate registry key");
+    }
+    names.push_back(wstringToString(achKey.get()));
+  }
+  return Status::success();
+}
+
+/**
+ * @brief Get the subkeys of a list of keys, reading the keys in parallel.
+ *
+ * @param pattern A LIKE pattern the subkey names must match, keys below the
+ * other subkeys are not enumerated. An empty pattern matches every subkey.
+ */
+static Status getSubkeys(const std::vector<std::string>& keys,
+                         const std::string& pattern,
+                         std::set<std::string>& subkeys,
+                         RegistryHandleCache* cache) {
+  std::vector<std::vector<std::string>> names(keys.size());
+  std::vector<Status> statuses(keys.size());
+  forEachRegistryKey(keys.size(), [&](size_t i) {
+    statuses[i] = enumerateSubkeys(keys[i], names[i], cache);
+  });
+
+  bool matchAll = pattern.empty() || pattern == kSQLGlobWildcard;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (!statuses[i].ok()) {
+      if (statuses[i].getCode() == ERROR_FILE_NOT_FOUND) {
         continue;
       }
-
-      return ret;
+      return statuses[i];
     }
-    for (const auto& r : regResults) {
-      if (r.at("type") == "subkey") {
-        newKeys.insert(r.at("path"));
+
+    for (const auto& name : names[i]) {
+      // Registry names are case insensitive, like the LIKE operator.
+      if (matchAll || sqlite3_strlike(pattern.c_str(), name.c_str(), 0) == 0) {
+        subkeys.insert(keys[i] + kRegSep + name);
       }
     }
   }
-  rKeys = std::move(newKeys);
   return Status::success();
 }
 
+static Status populateSubkeys(std::set<std::string>& rKeys,
+                              bool replaceKeys,
+                              const std::string& pattern,
+                              RegistryHandleCache* cache) {
+  std::vector<std::string> keys(rKeys.begin(), rKeys.end());
+  std::set<std::string> newKeys;
+  auto status = getSubkeys(keys, pattern, newKeys, cache);
+  if (!status.ok()) {
+    return status;
+  }
+
+  if (replaceKeys) {
+    rKeys = std::move(newKeys);
+  } else {
+    rKeys.insert(newKeys.begin(), newKeys.end());
+  }
+  return Status::success();
+}
+
+inline Status populateSubkeys(std::set<std::string>& rKeys, bool replaceKeys) {
+  return populateSubkeys(rKeys, replaceKeys, "", nullptr);
+}
+
 static inline void appendSubkeyToKeys(const std::string& subkey,
                                       std::set<std::string>& rKeys) {
   std::set<std::string> newKeys{};
@@ -455,29 +662,36 @@ static inline void appendSubkeyToKeys(const std::string& subkey,
 
 static inline Status populateAllKeysRecursive(
     std::set<std::string>& rKeys,
+    RegistryHandleCache* cache,
     size_t currDepth = 1,
     size_t maxDepth = kRegMaxRecursiveDepth) {
-  if (currDepth > maxDepth) {
-    return Status(1, "Max recursive depth reached");
-  }
+  // Each level only enumerates the keys found by the previous level.
+  std::vector<std::string> frontier(rKeys.begin(), rKeys.end());
+  for (; !frontier.empty(); ++currDepth) {
+    if (currDepth > maxDepth) {
+      return Status(1, "Max recursive depth reached");
+    }
 
-  auto size_pre = rKeys.size();
-  auto ret = populateSubkeys(rKeys);
-  if (!ret.ok()) {
-    return ret;
-  }
-  if (size_pre < rKeys.size()) {
-    auto status = populateAllKeysRecursive(rKeys, ++currDepth);
-    if (!status.ok()) {
-      return status;
+    std::set<std::string> subkeys;
+    auto ret = getSubkeys(frontier, "", subkeys, cache);
+    if (!ret.ok()) {
+      return ret;
+    }
+
+    frontier.clear();
+    for (auto& key : subkeys) {
+      if (rKeys.insert(key).second) {
+        frontier.push_back(key);
+      }
     }
   }
 
   return Status::success();
 }
 
-Status expandRegistryGlobs(const std::string& pattern,
-                           std::set<std::string>& results) {
+static Status expandRegistryGlobs(const std::string& pattern,
+                                  std::set<std::string>& results,
+                                  RegistryHandleCache* cache) {
   results.clear();
   auto pathElems = osquery::split(pattern, kRegSep);
   if (pathElems.size() == 0) {
@@ -492,12 +706,19 @@ Status expandRegistryGlobs(const std::string& pattern,
   if (boost::ends_with(pathElems[0], kSQLGlobRecursive) &&
       pathElems.size() == 1) {
     populateDefaultKeys(results);
-    return populateAllKeysRecursive(results);
+    return populateAllKeysRecursive(results, cache);
   }
 
   // Special handling to insert default keys when glob present in first elem
   if (pathElems[0].find(kSQLGlobWildcard) != std::string::npos) {
     populateDefaultKeys(results);
+    for (auto hive = results.begin(); hive != results.end();) {
+      if (sqlite3_strlike(pathElems[0].c_str(), hive->c_str(), 0) != 0) {
+        hive = results.erase(hive);
+      } else {
+        ++hive;
+      }
+    }
     pathElems.erase(pathElems.begin());
   } else {
     results.insert(pathElems[0]);
@@ -509,9 +730,10 @@ Status expandRegistryGlobs(const std::string& pattern,
     // pattern i.e. 'HKEY_LOCAL_MACHINE\SOFTWARE\%%'
     if (boost::ends_with(*elem, kSQLGlobRecursive) &&
         *elem == pathElems.back()) {
-      return populateAllKeysRecursive(results);
+      return populateAllKeysRecursive(results, cache);
     } else if ((*elem).find(kSQLGlobWildcard) != std::string::npos) {
-      auto ret = populateSubkeys(results, true);
+      // Only the subkeys matching this element are descended into.
+      auto ret = populateSubkeys(results, true, *elem, cache);
       if (!ret.ok()) {
         return ret;
       }
@@ -522,6 +744,11 @@ Status expandRegistryGlobs(const std::string& pattern,
   return Status::success();
 }
 
+Status expandRegistryGlobs(const std::string& pattern,
+                           std::set<std::string>& results) {
+  return expandRegistryGlobs(pattern, results, nullptr);
+}
+
 static inline void maybeWarnLocalUsers(const std::set<std::string>& rKeys) {
   std::string hive, _;
   for (const auto& key : rKeys) {
@@ -538,13 +765,14 @@ static inline void maybeWarnLocalUsers(const std::set<std::string>& rKeys) {
 QueryData genRegistry(QueryContext& context) {
   QueryData results;
   std::set<std::string> keys;
+  RegistryHandleCache cache;
 
   if (!(context.hasConstraint("key", EQUALS) ||
         context.hasConstraint("key", LIKE) ||
         context.hasConstraint("path", EQUALS) ||
         context.hasConstraint("path", LIKE))) {
     // We default to display all HIVEs
-    expandRegistryGlobs(kSQLGlobWildcard, keys);
+    expandRegistryGlobs(kSQLGlobWildcard, keys, &cache);
   } else {
     if (context.hasConstraint("key", EQUALS)) {
       keys = context.constraints["key"].getAll(EQUALS);
@@ -552,7 +780,7 @@ QueryData genRegistry(QueryContext& context) {
     if (context.hasConstraint("key", LIKE)) {
       for (const auto& key : context.constraints["key"].getAll(LIKE)) {
         std::set<std::string> keys_like;
-        auto status = expandRegistryGlobs(key, keys_like);
+        auto status = expandRegistryGlobs(key, keys_like, &cache);
         keys.insert(keys_like.begin(), keys_like.end());
         if (!status.ok()) {
           LOG(INFO) << "Failed to expand globs: " + status.getMessage();
@@ -569,10 +797,10 @@ QueryData genRegistry(QueryContext& context) {
         Status status;
         std::set<std::string> path_like;
         if (boost::ends_with(path, kSQLGlobRecursive)) {
-          status = expandRegistryGlobs(path, path_like);
+          status = expandRegistryGlobs(path, path_like, &cache);
         } else {
           status = expandRegistryGlobs(
-              path.substr(0, path.find_last_of(kRegSep)), path_like);
+              path.substr(0, path.find_last_of(kRegSep)), path_like, &cache);
         }
         keys.insert(path_like.begin(), path_like.end());
         if (!status.ok()) {
@@ -584,8 +812,15 @@ QueryData genRegistry(QueryContext& context) {
 
   maybeWarnLocalUsers(keys);
 
-  for (const auto& key : keys) {
-    queryKey(key, results);
+  // Keys are read in parallel, the rows keep the order of the keys.
+  std::vector<std::string> keyList(keys.begin(), keys.end());
+  std::vector<QueryData> keyResults(keyList.size());
+  forEachRegistryKey(keyList.size(), [&](size_t i) {
+    queryKey(keyList[i], keyResults[i], &cache);
+  });
+
+  for (auto& keyResult : keyResults) {
+    std::move(keyResult.begin(), keyResult.end(), std::back_inserter(results));
   }
   return results;
 }
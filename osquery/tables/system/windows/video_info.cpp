@@ -26,7 +26,9 @@ QueryData genVideoInfo(QueryContext& context) {
   QueryData results;
 
   const auto wmiSystemReq =
-      WmiRequest::CreateWmiRequest("SELECT * FROM Win32_VideoController");
+      WmiRequest::CreateWmiRequest("SELECT * FROM Win32_VideoController",
+                                   L"ROOT\\CIMV2",
+                                   std::chrono::minutes(1));
   if (!wmiSystemReq || wmiSystemReq->results().empty()) {
     LOG(WARNING) << "Failed to retrieve video information";
     return {};
@@ -30,7 +30,9 @@ QueryData genWinOptionalFeatures(QueryContext& context) {
   QueryData results;
 
   const auto wmiReq = WmiRequest::CreateWmiRequest(
-      "SELECT Caption,Name,InstallState FROM Win32_OptionalFeature");
+      "SELECT Caption,Name,InstallState FROM Win32_OptionalFeature",
+      L"ROOT\\CIMV2",
+      std::chrono::minutes(5));
   if (!wmiReq) {
     return results;
   }
@@ -8,14 +8,20 @@
  */
 
 #if !defined(WIN32)
+#include <fcntl.h>
 #include <sys/stat.h>
 #endif
 
+#if defined(__linux__)
+#include <sys/sysmacros.h>
+#endif
+
 #include <osquery/core/system.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/fileops.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/sql/dynamic_table_row.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
 #include <osquery/worker/logging/glog/glog_logger.h>
 
@@ -27,24 +33,166 @@ namespace tables {
 
 #if !defined(WIN32)
 
-const std::map<fs::file_type, std::string> kTypeNames{
-    {fs::regular_file, "regular"},
-    {fs::directory_file, "directory"},
-    {fs::symlink_file, "symlink"},
-    {fs::block_file, "block"},
-    {fs::character_file, "character"},
-    {fs::fifo_file, "fifo"},
-    {fs::socket_file, "socket"},
-    {fs::type_unknown, "unknown"},
-    {fs::status_error, "error"},
+namespace {
+
+/// The stat of a path, and of its target if it is a symlink.
+struct PathStat {
+  struct stat st;
+
+  /// The path is a symlink.
+  bool symlink{false};
+
+  /// The stat is of the symlink target, or of a path that is not a symlink.
+  bool resolved{false};
+
+  /// The birth time, 0 where the platform or filesystem has none.
+  time_t btime{0};
 };
 
+#if defined(STATX_BASIC_STATS)
+/// Request only the statx fields of the used columns.
+unsigned int getStatxMask(const QueryContext& context) {
+  unsigned int mask = STATX_TYPE | STATX_MODE;
+  if (context.isColumnUsed("inode")) {
+    mask |= STATX_INO;
+  }
+  if (context.isColumnUsed("uid")) {
+    mask |= STATX_UID;
+  }
+  if (context.isColumnUsed("gid")) {
+    mask |= STATX_GID;
+  }
+  if (context.isColumnUsed("size")) {
+    mask |= STATX_SIZE;
+  }
+  if (context.isColumnUsed("hard_links")) {
+    mask |= STATX_NLINK;
+  }
+  if (context.isColumnUsed("atime")) {
+    mask |= STATX_ATIME;
+  }
+  if (context.isColumnUsed("mtime")) {
+    mask |= STATX_MTIME;
+  }
+  if (context.isColumnUsed("ctime")) {
+    mask |= STATX_CTIME;
+  }
+  if (context.isColumnUsed("btime")) {
+    mask |= STATX_BTIME;
+  }
+  return mask;
+}
+
+void copyStatx(const struct statx& stx, PathStat& path_stat) {
+  auto& st = path_stat.st;
+  st = {};
+  st.st_mode = stx.stx_mode;
+  st.st_ino = stx.stx_ino;
+  st.st_uid = stx.stx_uid;
+  st.st_gid = stx.stx_gid;
+  st.st_rdev = makedev(stx.stx_rdev_major, stx.stx_rdev_minor);
+  st.st_size = stx.stx_size;
+  st.st_blksize = stx.stx_blksize;
+  st.st_nlink = stx.stx_nlink;
+  st.st_atime = stx.stx_atime.tv_sec;
+  st.st_mtime = stx.stx_mtime.tv_sec;
+  st.st_ctime = stx.stx_ctime.tv_sec;
+  path_stat.btime = (stx.stx_mask & STATX_BTIME) ? stx.stx_btime.tv_sec : 0;
+}
+#endif
+
+/**
+ * @brief Stat a path, and its target if it is a symlink.
+ *
+ * A path that is not a symlink needs a single call. Where statx is available
+ * only the fields of the used columns are requested, which saves work on
+ * network filesystems.
+ *
+ * @return false if the path was not real, had too many links, or could not
+ * be accessed.
+ */
+bool statPath(const std::string& path,
+              const QueryContext& context,
+              PathStat& path_stat) {
+#if defined(STATX_BASIC_STATS)
+  auto mask = getStatxMask(context);
+  struct statx stx;
+  if (statx(AT_FDCWD, path.c_str(), AT_SYMLINK_NOFOLLOW, mask, &stx) == 0) {
+    path_stat.symlink = S_ISLNK(stx.stx_mode);
+    if (!path_stat.symlink) {
+      path_stat.resolved = true;
+    } else {
+      struct statx target;
+      if (statx(AT_FDCWD, path.c_str(), 0, mask, &target) == 0) {
+        stx = target;
+        path_stat.resolved = true;
+      }
+    }
+    copyStatx(stx, path_stat);
+    return true;
+  } else if (errno != ENOSYS) {
+    return false;
+  }
+#endif
+
+  // On POSIX systems, first check the link state.
+  if (lstat(path.c_str(), &path_stat.st) < 0) {
+    return false;
+  }
+
+  path_stat.symlink = S_ISLNK(path_stat.st.st_mode);
+  if (!path_stat.symlink) {
+    path_stat.resolved = true;
+  } else {
+    struct stat file_stat;
+    if (stat(path.c_str(), &file_stat) == 0) {
+      path_stat.st = file_stat;
+      path_stat.resolved = true;
+    }
+  }
+
+#if !defined(__linux__)
+  path_stat.btime = path_stat.st.st_birthtimespec.tv_sec;
+#endif
+  return true;
+}
+
+/// The type of a resolved path, as boost::filesystem::status names it.
+std::string getFileType(const PathStat& path_stat) {
+  if (!path_stat.resolved) {
+    // The symlink target does not exist.
+    return "unknown";
+  }
+
+  auto mode = path_stat.st.st_mode;
+  if (S_ISREG(mode)) {
+    return "regular";
+  } else if (S_ISDIR(mode)) {
+    return "directory";
+  } else if (S_ISBLK(mode)) {
+    return "block";
+  } else if (S_ISCHR(mode)) {
+    return "character";
+  } else if (S_ISFIFO(mode)) {
+    return "fifo";
+  } else if (S_ISSOCK(mode)) {
+    return "socket";
+  }
+  return "unknown";
+}
+
+} // namespace
+
 #endif
 
+/// Receives each row of the file table as it is generated.
+using FileRowCallback = std::function<void(Row&&)>;
+
 void genFileInfo(const fs::path& path,
                  const fs::path& parent,
                  const std::string& pattern,
-                 QueryData& results) {
+                 const QueryContext& context,
+                 const FileRowCallback& emit) {
   // Must provide the path, filename, directory separate from boost path->string
   // helpers to match any explicit (query-parsed) predicate constraints.
 
@@ -56,22 +204,16 @@ void genFileInfo(const fs::path& path,
 
 #if !defined(WIN32)
 
-  struct stat file_stat;
-
-  // On POSIX systems, first check the link state.
-  struct stat link_stat;
-  if (lstat(path.string().c_str(), &link_stat) < 0) {
+  PathStat path_stat;
+  if (!statPath(path.string(), context, path_stat)) {
     // Path was not real, had too may links, or could not be accessed.
     return;
   }
-  if (S_ISLNK(link_stat.st_mode)) {
+  const auto& file_stat = path_stat.st;
+  if (path_stat.symlink) {
     r["symlink"] = "1";
   }
 
-  if (stat(path.string().c_str(), &file_stat)) {
-    file_stat = link_stat;
-  }
-
   r["inode"] = BIGINT(file_stat.st_ino);
   r["uid"] = BIGINT(file_stat.st_uid);
   r["gid"] = BIGINT(file_stat.st_gid);
@@ -84,23 +226,14 @@ void genFileInfo(const fs::path& path,
   r["atime"] = BIGINT(file_stat.st_atime);
   r["mtime"] = BIGINT(file_stat.st_mtime);
   r["ctime"] = BIGINT(file_stat.st_ctime);
+  r["btime"] = BIGINT(path_stat.btime);
 
 #if defined(__linux__)
-  // No 'birth' or create time in Linux or Windows.
-  r["btime"] = "0";
   r["pid_with_namespace"] = "0";
-#else
-  r["btime"] = BIGINT(file_stat.st_birthtimespec.tv_sec);
 #endif
 
-  // Type booleans
-  boost::system::error_code ec;
-  auto status = fs::status(path, ec);
-  if (kTypeNames.count(status.type())) {
-    r["type"] = kTypeNames.at(status.type());
-  } else {
-    r["type"] = "unknown";
-  }
+  // The type is read from the mode, without another stat.
+  r["type"] = getFileType(path_stat);
 
 #if defined(__APPLE__)
   std::string bsd_file_flags_description;
@@ -146,12 +279,10 @@ void genFileInfo(const fs::path& path,
 
 #endif
 
-  results.push_back(r);
+  emit(std::move(r));
 }
 
-QueryData genFileImpl(QueryContext& context, Logger& logger) {
-  QueryData results;
-
+void genFileRows(QueryContext& context, const FileRowCallback& emit) {
   // Resolve file paths for EQUALS and LIKE operations.
   auto paths = context.constraints["path"].getAll(EQUALS);
   context.expandConstraints(
@@ -173,7 +304,7 @@ QueryData genFileImpl(QueryContext& context, Logger& logger) {
   // Iterate through each of the resolved/supplied paths.
   for (const auto& path_string : paths) {
     fs::path path = path_string;
-    genFileInfo(path, path.parent_path(), "", results);
+    genFileInfo(path, path.parent_path(), "", context, emit);
   }
 
   // Resolve directories for EQUALS and LIKE operations.
@@ -203,24 +334,36 @@ QueryData genFileImpl(QueryContext& context, Logger& logger) {
     try {
       // Iterate over the directory and generate info for each regular file.
       fs::directory_iterator begin(directory_string), end;
-      for (; begin != end; ++begin) {
-        genFileInfo(begin->path(), directory_string, "", results);
+      for (; begin != end && !context.isCancelled(); ++begin) {
+        genFileInfo(begin->path(), directory_string, "", context, emit);
       }
     } catch (const fs::filesystem_error& /* e */) {
       continue;
     }
   }
+}
 
+QueryData genFileImpl(QueryContext& context, Logger& logger) {
+  QueryData results;
+  genFileRows(context,
+              [&results](Row&& r) { results.push_back(std::move(r)); });
   return results;
 }
 
-QueryData genFile(QueryContext& context) {
+void genFile(RowYield& yield, QueryContext& context) {
   if (hasNamespaceConstraint(context)) {
-    return generateInNamespace(context, "file", genFileImpl);
-  } else {
-    GLOGLogger logger;
-    return genFileImpl(context, logger);
+    // Rows of another mount namespace arrive together from the container.
+    for (auto& r : generateInNamespace(context, "file", genFileImpl)) {
+      yield(TableRowHolder(new DynamicTableRow(std::move(r))));
+    }
+    return;
   }
+
+  // Each row is yielded once generated, a large directory is not held in
+  // memory and generation stops when SQLite no longer needs rows.
+  genFileRows(context, [&yield](Row&& r) {
+    yield(TableRowHolder(new DynamicTableRow(std::move(r))));
+  });
 }
 } // namespace tables
 } // namespace osquery
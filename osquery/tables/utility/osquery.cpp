@@ -11,17 +11,24 @@
 #include <osquery/config/packs.h>
 #include <osquery/core/core.h>
 #include <osquery/core/flags.h>
+#include <osquery/core/startup_trace.h>
 #include <osquery/core/system.h>
 #include <osquery/core/tables.h>
+#include <osquery/database/database.h>
+#include <osquery/dispatcher/scheduler_stats.h>
 #include <osquery/events/eventfactory.h>
 #include <osquery/events/eventpublisher.h>
 #include <osquery/events/eventsubscriber.h>
 #include <osquery/extensions/extensions.h>
 #include <osquery/filesystem/filesystem.h>
+#include <osquery/logger/data_logger.h>
 #include <osquery/logger/logger.h>
 #include <osquery/process/process.h>
+#include <osquery/profiler/code_profiler.h>
+#include <osquery/profiler/query_trace.h>
 #include <osquery/registry/registry.h>
 #include <osquery/sql/sql.h>
+#include <osquery/sql/table_stats.h>
 #include <osquery/utils/info/platform_type.h>
 #include <osquery/utils/info/version.h>
 #include <osquery/utils/macros/macros.h>
@@ -33,6 +40,23 @@ DECLARE_bool(disable_events);
 
 namespace tables {
 
+QueryData genOsqueryDatabaseStats(QueryContext& context) {
+  QueryData results;
+
+  PluginResponse stats;
+  auto status = getDatabaseStats(stats);
+  if (!status.ok()) {
+    VLOG(1) << "Cannot read database statistics: " << status.getMessage();
+    return results;
+  }
+
+  for (const auto& domain : stats) {
+    Row r(domain.begin(), domain.end());
+    results.push_back(std::move(r));
+  }
+  return results;
+}
+
 QueryData genOsqueryEvents(QueryContext& context) {
   QueryData results;
 
@@ -49,11 +73,19 @@ QueryData genOsqueryEvents(QueryContext& context) {
       r["events"] = INTEGER(pubref->numEvents());
       r["refreshes"] = INTEGER(pubref->restartCount());
       r["active"] = (pubref->hasStarted() && !pubref->isEnding()) ? "1" : "0";
+      r["received"] = BIGINT(pubref->numReceivedEvents());
+      r["dropped"] = INTEGER(pubref->numDroppedEvents());
+      r["queued"] = BIGINT(pubref->queueDepth());
+      r["callback_time_us"] = BIGINT(pubref->callbackTime());
     } else {
       r["subscriptions"] = "0";
       r["events"] = "0";
       r["refreshes"] = "0";
       r["active"] = "-1";
+      r["received"] = "0";
+      r["dropped"] = "0";
+      r["queued"] = "0";
+      r["callback_time_us"] = "0";
     }
     results.push_back(r);
   }
@@ -65,18 +97,25 @@ QueryData genOsqueryEvents(QueryContext& context) {
     r["type"] = "subscriber";
     // Subscribers will never 'restart'.
     r["refreshes"] = "0";
+    r["received"] = "0";
 
     auto subref = EventFactory::getEventSubscriber(subscriber);
     if (subref != nullptr) {
       r["publisher"] = subref->getType();
       r["subscriptions"] = INTEGER(subref->numSubscriptions());
       r["events"] = INTEGER(subref->numEvents());
+      r["dropped"] = INTEGER(subref->numDroppedEvents());
+      r["queued"] = BIGINT(subref->queueDepth());
+      r["callback_time_us"] = BIGINT(subref->callbackTime());
 
       // Subscribers are always active, even if their publisher is not.
       r["active"] = (subref->state() == EventState::EVENT_RUNNING) ? "1" : "0";
     } else {
       r["subscriptions"] = "0";
       r["events"] = "0";
+      r["dropped"] = "0";
+      r["queued"] = "0";
+      r["callback_time_us"] = "0";
       r["active"] = "-1";
     }
     results.push_back(r);
@@ -221,6 +260,14 @@ QueryData genOsqueryInfo(QueryContext& context) {
   }
   r["platform_mask"] = INTEGER(static_cast<uint64_t>(kPlatformType));
 
+  uint64_t database_memory = 0;
+  r["database_memory"] = (getDatabaseMemoryUsage(database_memory).ok())
+                             ? BIGINT(database_memory)
+                             : "-1";
+
+  r["startup_time"] = BIGINT(StartupTrace::get().readyTime());
+  r["startup_phases"] = StartupTrace::get().toJSON();
+
   std::string uuid;
   r["uuid"] = (getHostUUID(uuid)) ? uuid : "";
 
@@ -253,6 +300,10 @@ QueryData genOsquerySchedule(QueryContext& context) {
         r["last_system_time"] = "0";
         r["average_memory"] = "0";
         r["last_memory"] = "0";
+        r["allocated_bytes"] = "0";
+        r["last_allocated_bytes"] = "0";
+        r["peak_bytes"] = "0";
+        r["last_peak_bytes"] = "0";
         r["last_executed"] = "0";
 
         // Report optional performance information.
@@ -270,6 +321,10 @@ QueryData genOsquerySchedule(QueryContext& context) {
               r["last_system_time"] = BIGINT(perf.last_system_time);
               r["average_memory"] = BIGINT(perf.average_memory);
               r["last_memory"] = BIGINT(perf.last_memory);
+              r["allocated_bytes"] = BIGINT(perf.allocated_bytes);
+              r["last_allocated_bytes"] = BIGINT(perf.last_allocated_bytes);
+              r["peak_bytes"] = BIGINT(perf.peak_bytes);
+              r["last_peak_bytes"] = BIGINT(perf.last_peak_bytes);
             });
 
         results.push_back(r);
@@ -277,5 +332,128 @@ QueryData genOsquerySchedule(QueryContext& context) {
       true);
   return results;
 }
+
+QueryData genOsqueryDiscoveryStats(QueryContext& context) {
+  QueryData results;
+
+  getDiscoveryStats(
+      [&results](const std::string& query, const DiscoveryStats& stats) {
+        Row r;
+        r["query"] = query;
+        r["executions"] = BIGINT(stats.executions);
+        r["cache_hits"] = BIGINT(stats.hits);
+        r["passed"] = INTEGER(stats.passed ? 1 : 0);
+        r["last_executed"] = BIGINT(stats.last_executed);
+        results.push_back(r);
+      });
+  return results;
+}
+
+QueryData genOsquerySchedulerStats(QueryContext& context) {
+  QueryData results;
+
+  getSchedulerStats(
+      [&results](const std::string& pack, const SchedulerStats& stats) {
+        Row r;
+        r["pack"] = pack;
+        r["executions"] = BIGINT(stats.duration_ms.count());
+        auto add = [&r](const std::string& prefix,
+                        const SchedulerHistogram& histogram) {
+          r[prefix + "_p50"] = BIGINT(histogram.quantile(0.50));
+          r[prefix + "_p95"] = BIGINT(histogram.quantile(0.95));
+          r[prefix + "_p99"] = BIGINT(histogram.quantile(0.99));
+          r[prefix + "_max"] = BIGINT(histogram.max());
+        };
+        add("lateness", stats.lateness_ms);
+        add("duration", stats.duration_ms);
+        add("rows", stats.rows);
+        results.push_back(r);
+      });
+  return results;
+}
+
+QueryData genOsqueryLoggerStats(QueryContext& context) {
+  QueryData results;
+
+  getLoggerDispatchStats(
+      [&results](const std::string& logger, const LoggerDispatchStats& stats) {
+        Row r;
+        r["logger"] = logger;
+        r["queued"] = BIGINT(stats.queued);
+        r["delivered"] = BIGINT(stats.delivered);
+        r["failed"] = BIGINT(stats.failed);
+        r["dropped"] = BIGINT(stats.dropped);
+        auto sent = stats.delivered + stats.failed;
+        r["latency_avg_us"] = BIGINT((sent > 0) ? stats.latency_us / sent : 0);
+        r["latency_max_us"] = BIGINT(stats.max_latency_us);
+        results.push_back(r);
+      });
+  return results;
+}
+
+QueryData genOsqueryProfile(QueryContext& context) {
+  QueryData results;
+
+  getProfileStats([&results](const std::string& subsystem,
+                             const std::string& name,
+                             const ProfileStats& stats) {
+    Row r;
+    r["subsystem"] = subsystem;
+    r["name"] = name;
+    r["calls"] = BIGINT(stats.calls);
+    r["cpu_time_us"] = BIGINT(stats.cpu_time_us);
+    r["wall_time_us"] = BIGINT(stats.wall_time_us);
+    r["max_wall_time_us"] = BIGINT(stats.max_wall_time_us);
+    results.push_back(r);
+  });
+  return results;
+}
+
+QueryData genOsqueryQueryTraces(QueryContext& context) {
+  QueryData results;
+
+  getQueryTraces([&results](const QueryTrace& trace) {
+    Row r;
+    r["trace_id"] = trace.trace_id;
+    r["kind"] = trace.kind;
+    r["name"] = trace.name;
+    r["start_time"] = BIGINT(trace.start_time_us);
+    r["stage"] = "query";
+    r["detail"] = "";
+    r["start_us"] = "0";
+    r["duration_us"] = BIGINT(trace.duration_us);
+    r["rows"] = "0";
+    results.push_back(r);
+
+    for (const auto& span : trace.spans) {
+      r["stage"] = span.stage;
+      r["detail"] = span.detail;
+      r["start_us"] = BIGINT(span.start_us);
+      r["duration_us"] = BIGINT(span.duration_us);
+      r["rows"] = BIGINT(span.rows);
+      results.push_back(r);
+    }
+  });
+  return results;
+}
+
+QueryData genOsqueryTableStats(QueryContext& context) {
+  QueryData results;
+
+  getTableStats([&results](const std::string& name, const TableStats& stats) {
+    Row r;
+    r["name"] = name;
+    r["scans"] = BIGINT(stats.scans);
+    r["filters"] = BIGINT(stats.filters);
+    r["generate_time_us"] = BIGINT(stats.generate_time_us);
+    r["rows_produced"] = BIGINT(stats.rows_produced);
+    r["rows_consumed"] = BIGINT(stats.rows_consumed);
+    r["bytes"] = BIGINT(stats.bytes);
+    r["allocated_bytes"] = BIGINT(stats.allocated_bytes);
+    r["peak_bytes"] = BIGINT(stats.peak_bytes);
+    results.push_back(r);
+  });
+  return results;
+}
 } // namespace tables
 } // namespace osquery
@@ -0,0 +1,122 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <osquery/tables/yara/yara_scan_queue.h>
+
+namespace osquery {
+
+namespace {
+
+YaraScanRequest makeRequest(const std::string& path,
+                            const std::string& action) {
+  YaraScanRequest request;
+  request.path = path;
+  request.category = "category";
+  request.action = action;
+  return request;
+}
+
+/// Wait for the queue to scan every file.
+bool waitForScans(const YaraScanQueue& queue,
+                  std::mutex& mutex,
+                  const std::vector<YaraScanRequest>& scanned,
+                  std::size_t count) {
+  for (std::size_t i = 0; i < 200; ++i) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (queue.pending() == 0 && scanned.size() >= count) {
+        return true;
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+} // namespace
+
+class YaraScanQueueTests : public testing::Test {};
+
+TEST_F(YaraScanQueueTests, test_events_share_one_scan) {
+  std::mutex mutex;
+  std::vector<YaraScanRequest> scanned;
+  YaraScanQueue queue(2,
+                      std::chrono::milliseconds(200),
+                      std::chrono::milliseconds(2000),
+                      [&mutex, &scanned](const YaraScanRequest& request) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        scanned.push_back(request);
+                      });
+
+  // Events for one file are scanned once, with the last event.
+  EXPECT_TRUE(queue.add(makeRequest("/tmp/a", "CREATED")));
+  EXPECT_TRUE(queue.add(makeRequest("/tmp/a", "UPDATED")));
+  EXPECT_TRUE(queue.add(makeRequest("/tmp/b", "UPDATED")));
+  EXPECT_EQ(queue.pending(), 2U);
+
+  ASSERT_TRUE(waitForScans(queue, mutex, scanned, 2));
+
+  // Wait for a late duplicate scan.
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  std::lock_guard<std::mutex> lock(mutex);
+  ASSERT_EQ(scanned.size(), 2U);
+  for (const auto& request : scanned) {
+    if (request.path == "/tmp/a") {
+      EXPECT_EQ(request.action, "UPDATED");
+    } else {
+      EXPECT_EQ(request.path, "/tmp/b");
+    }
+  }
+}
+
+TEST_F(YaraScanQueueTests, test_max_delay) {
+  std::mutex mutex;
+  std::vector<YaraScanRequest> scanned;
+  YaraScanQueue queue(1,
+                      std::chrono::milliseconds(100),
+                      std::chrono::milliseconds(300),
+                      [&mutex, &scanned](const YaraScanRequest& request) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        scanned.push_back(request);
+                      });
+
+  // A file changing faster than the quiet period is still scanned.
+  auto start = std::chrono::steady_clock::now();
+  while (std::chrono::steady_clock::now() - start <
+         std::chrono::milliseconds(600)) {
+    queue.add(makeRequest("/tmp/a", "UPDATED"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  EXPECT_FALSE(scanned.empty());
+}
+
+TEST_F(YaraScanQueueTests, test_stop) {
+  std::size_t scans = 0;
+  YaraScanQueue queue(1,
+                      std::chrono::milliseconds(10000),
+                      std::chrono::milliseconds(10000),
+                      [&scans](const YaraScanRequest&) { ++scans; });
+
+  // Files waiting when the queue stops are not scanned.
+  EXPECT_TRUE(queue.add(makeRequest("/tmp/a", "UPDATED")));
+  queue.stop();
+  EXPECT_EQ(scans, 0U);
+  EXPECT_EQ(queue.pending(), 1U);
+}
+
+} // namespace osquery
@@ -185,4 +185,34 @@ TEST_F(YARATest, test_rule_compilation_failures) {
   EXPECT_TRUE(compiler_result.isError());
 }
 
+TEST_F(YARATest, test_rule_files_unchanged) {
+  int result = yr_initialize();
+  ASSERT_TRUE(result == ERROR_SUCCESS);
+
+  const auto rule_file = fs::temp_directory_path() /
+                         fs::unique_path("osquery.tests.yara.%%%%.%%%%.sig");
+  writeTextFile(rule_file.string(), alwaysTrue);
+
+  auto doc = JSON::newArray();
+  doc.pushCopy(rule_file.string());
+
+  YaraRulesMap rules;
+  std::map<std::string, std::string> digests;
+  ASSERT_TRUE(handleRuleFiles("group", doc.doc(), rules, digests).ok());
+  ASSERT_EQ(rules.count("group"), 1U);
+  auto compiled = rules["group"];
+
+  // Unchanged rule files keep the compiled rules.
+  ASSERT_TRUE(handleRuleFiles("group", doc.doc(), rules, digests).ok());
+  EXPECT_EQ(rules["group"], compiled);
+
+  writeTextFile(rule_file.string(), alwaysFalse);
+  ASSERT_TRUE(handleRuleFiles("group", doc.doc(), rules, digests).ok());
+  EXPECT_NE(rules["group"], compiled);
+
+  compiled.reset();
+  rules.clear();
+  fs::remove_all(rule_file);
+}
+
 } // namespace osquery
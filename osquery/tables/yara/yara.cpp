@@ -12,8 +12,12 @@
 
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <regex>
 #include <thread>
+#include <vector>
 
 #ifdef LINUX
 #include <malloc.h>
@@ -52,6 +56,21 @@ FLAG(uint32,
      "Time in ms to sleep after scan of each file (default 50) to reduce "
      "memory spikes");
 
+FLAG(uint32,
+     yara_concurrency,
+     1,
+     "Number of files the yara table scans at once (default 1)");
+
+FLAG(uint64,
+     yara_max_files,
+     0,
+     "Max number of files a yara table query scans, 0 for no limit");
+
+FLAG(uint32,
+     yara_max_scan_time,
+     0,
+     "Max seconds a yara table query scans files, 0 for no limit");
+
 HIDDEN_FLAG(bool,
             enable_yara_string,
             false,
@@ -68,6 +87,21 @@ using YARAConfigParser = std::shared_ptr<YARAConfigParserPlugin>;
 
 using YaraScanContext = std::set<std::pair<YaraRuleType, std::string>>;
 
+/// A signature of the query and its compiled rules.
+struct YaraScanRules {
+  YaraRuleType type;
+  std::string sign;
+  std::shared_ptr<YaraRulesHandle> rules;
+};
+
+/// A file scanned with one signature, and the row of the scan.
+struct YaraScanTask {
+  const std::string* path{nullptr};
+  const YaraScanRules* rules{nullptr};
+  Row row;
+  bool scanned{false};
+};
+
 // Check if the YARAConfigParser is nullptr
 static inline bool isNull(std::shared_ptr<ConfigParserPlugin> parser) {
   return (parser == nullptr) || (parser.get() == nullptr);
@@ -153,13 +187,11 @@ Status getRuleFromURL(const std::string& url, std::string& rule) {
   return Status::success();
 }
 
-void doYARAScan(YR_RULES* rules,
+bool doYARAScan(YR_RULES* rules,
                 const std::string& path,
-                QueryData& results,
+                Row& row,
                 YaraRuleType yr_type,
                 const std::string& sigfile) {
-  Row row;
-
   // These are default values, to be updated in YARACallback.
   row["count"] = INTEGER(0);
   row["matches"] = SQL_TEXT("");
@@ -194,9 +226,7 @@ void doYARAScan(YR_RULES* rules,
   // Perform the scan, using the static YARA subscriber callback.
   int result = yr_rules_scan_file(
       rules, path.c_str(), SCAN_FLAGS_FAST_MODE, YARACallback, (void*)&row, 0);
-  if (result == ERROR_SUCCESS) {
-    results.push_back(std::move(row));
-  }
+  return result == ERROR_SUCCESS;
 }
 
 Status getYaraRules(YARAConfigParser parser,
@@ -208,12 +238,28 @@ Status getYaraRules(YARAConfigParser parser,
   }
 
   auto& rules_map = parser->rules();
+  auto& digests = parser->rule_digests();
 
   // Compile signature string and add them to the scan context
   for (const auto& sign : signature_set) {
     // Check if the signature string has been used/compiled
     const auto signature_hash = hashStr(sign, sign_type);
-    if (rules_map.count(signature_hash) > 0) {
+
+    // A signature file is compiled again once its content changed.
+    std::string digest;
+    if (sign_type == YC_FILE) {
+      auto path = (boost::filesystem::path(sign).is_relative())
+                      ? (kYARAHome + sign)
+                      : sign;
+      std::string content;
+      if (readFile(path, content).ok()) {
+        digest =
+            hashFromBuffer(HASH_TYPE_SHA256, content.data(), content.size());
+      }
+    }
+
+    if (rules_map.count(signature_hash) > 0 &&
+        (sign_type != YC_FILE || digests[signature_hash] == digest)) {
       context.insert(std::make_pair(sign_type, sign));
       continue;
     }
@@ -275,7 +321,11 @@ Status getYaraRules(YARAConfigParser parser,
     // Cache the compiled rules by setting the unique hashed signature
     // string as the lookup name. Additional signature file uses will
     // skip the compile step and be added to the scan context
-    rules_map.insert_or_assign(signature_hash, std::move(handle));
+    rules_map.insert_or_assign(
+        signature_hash, std::make_shared<YaraRulesHandle>(std::move(handle)));
+    if (sign_type == YC_FILE) {
+      digests[signature_hash] = digest;
+    }
     context.insert(std::make_pair(sign_type, sign));
   }
 
@@ -373,26 +423,94 @@ QueryData genYaraImpl(QueryContext& context, Logger& logger) {
         return status;
       }));
 
-  // Scan every path pair with the yara rules
+  // Hold the rules of every signature, the scans do not use the cache.
+  std::vector<YaraScanRules> scan_rules;
   auto& rules = yaraParser->rules();
+  for (const auto& sign : scanContext) {
+    auto rules_it = rules.find(hashStr(sign.second, sign.first));
+    if (rules_it != rules.end()) {
+      scan_rules.push_back({sign.first, sign.second, rules_it->second});
+    }
+  }
+
+  if (FLAGS_yara_max_files > 0 && paths.size() > FLAGS_yara_max_files) {
+    logger.log(google::GLOG_WARNING,
+               "YARA scan is limited to " +
+                   std::to_string(FLAGS_yara_max_files) + " of " +
+                   std::to_string(paths.size()) + " files");
+    paths.erase(std::next(paths.begin(), FLAGS_yara_max_files), paths.end());
+  }
+
+  // Scan every path pair with the yara rules
+  std::vector<YaraScanTask> tasks;
+  tasks.reserve(paths.size() * scan_rules.size());
   for (const auto& path : paths) {
-    for (const auto& sign : scanContext) {
-      auto hash = hashStr(sign.second, sign.first);
-      auto rules_it = rules.find(hash);
-      if (rules_it != rules.end()) {
-        doYARAScan(rules_it->second.get(),
-                   path.c_str(),
-                   results,
-                   sign.first,
-                   sign.second);
-
-        // sleep between each file to help smooth out malloc spikes
-        std::this_thread::sleep_for(
-            std::chrono::milliseconds(FLAGS_yara_delay));
+    for (const auto& sign : scan_rules) {
+      YaraScanTask task;
+      task.path = &path;
+      task.rules = &sign;
+      tasks.push_back(std::move(task));
+    }
+  }
+
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::seconds(FLAGS_yara_max_scan_time);
+  std::atomic<size_t> next{0};
+  std::atomic<bool> expired{false};
+  auto worker = [&tasks, &context, &next, &expired, deadline]() {
+    for (auto i = next++; i < tasks.size(); i = next++) {
+      if (context.isCancelled()) {
+        return;
       }
+
+      if (FLAGS_yara_max_scan_time > 0 &&
+          std::chrono::steady_clock::now() >= deadline) {
+        expired = true;
+        return;
+      }
+
+      auto& task = tasks[i];
+      task.scanned = doYARAScan(task.rules->rules->get(),
+                                *task.path,
+                                task.row,
+                                task.rules->type,
+                                task.rules->sign);
+
+      // sleep between each file to help smooth out malloc spikes
+      std::this_thread::sleep_for(std::chrono::milliseconds(FLAGS_yara_delay));
     }
+  };
+
+  // Scans share the compiled rules, YARA allows up to YR_MAX_THREADS.
+  auto count = std::min<size_t>(
+      {tasks.size(),
+       std::max<uint32_t>(FLAGS_yara_concurrency, 1),
+       static_cast<size_t>(YR_MAX_THREADS)});
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < count; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
   }
 
+  if (expired) {
+    logger.log(google::GLOG_WARNING,
+               "YARA scan stopped after " +
+                   std::to_string(FLAGS_yara_max_scan_time) + " seconds");
+  }
+
+  for (auto& task : tasks) {
+    if (task.scanned) {
+      results.push_back(std::move(task.row));
+    }
+  }
+
+  // Release the rules before YARA is finalized.
+  tasks.clear();
+  scan_rules.clear();
+
   // Rule string is hashed before adding to the cache. There are
   // possibilities of collision when arbitrary queries are executed
   // with distributed API. Clear the hash string from the cache
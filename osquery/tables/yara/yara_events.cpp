@@ -7,13 +7,22 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
+
+#include <sys/stat.h>
 
 #include <osquery/config/config.h>
+#include <osquery/core/flags.h>
 #include <osquery/events/eventsubscriber.h>
+#include <osquery/hashing/hashing.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
+#include <osquery/tables/yara/yara_scan_queue.h>
 #include <osquery/tables/yara/yara_utils.h>
 
 /// The file change event publishers are slightly different in OS X and Linux.
@@ -30,6 +39,27 @@
 
 namespace osquery {
 
+FLAG(uint32,
+     yara_events_scan_threads,
+     1,
+     "Threads scanning yara_events targets after their events, 0 scans "
+     "within the event callback");
+
+FLAG(uint32,
+     yara_events_quiet_period,
+     1000,
+     "Milliseconds a file must not change before yara_events scans it");
+
+namespace {
+
+/// A file changing without pause is scanned after this many quiet periods.
+const uint32_t kMaxQuietPeriods{10};
+
+/// Max scanned files whose content is remembered.
+const std::size_t kMaxScannedFiles{10000};
+
+} // namespace
+
 /// The file change event publishers are slightly different in OS X and Linux.
 #ifdef __APPLE__
 using FileEventSubscriber = EventSubscriber<FSEventsEventPublisher>;
@@ -52,12 +82,31 @@ using FileSubscriptionContextRef = INotifySubscriptionContextRef;
 class YARAEventSubscriber : public FileEventSubscriber {
  public:
   Status init() override {
+    if (FLAGS_yara_events_scan_threads > 0) {
+      std::chrono::milliseconds quiet(FLAGS_yara_events_quiet_period);
+      scan_queue_ = std::make_unique<YaraScanQueue>(
+          FLAGS_yara_events_scan_threads,
+          quiet,
+          quiet * kMaxQuietPeriods,
+          [this](const YaraScanRequest& request) { scan(request); });
+    }
     return Status(0);
   }
 
   void configure() override;
 
  private:
+  /// The content of a scanned file, and the rules it was scanned with.
+  struct ScannedFile final {
+    dev_t device{0};
+    ino_t inode{0};
+    off_t size{0};
+    time_t mtime{0};
+    time_t ctime{0};
+    std::string sha256;
+    std::vector<std::weak_ptr<YaraRulesHandle>> rules;
+  };
+
   /**
    * @brief This exports a single Callback for FSEventsEventPublisher events.
    *
@@ -68,6 +117,28 @@ class YARAEventSubscriber : public FileEventSubscriber {
    */
   Status Callback(const FileEventContextRef& ec,
                   const FileSubscriptionContextRef& sc);
+
+  /// Scan the target of an event with the groups of its category.
+  Status scan(const YaraScanRequest& request);
+
+  /**
+   * @brief Check if a file was scanned with the same content and rules.
+   *
+   * The file is only hashed if its stat changed, the remembered content is
+   * updated when it did.
+   */
+  bool isUnchanged(const std::string& path,
+                   const std::vector<std::shared_ptr<YaraRulesHandle>>& rules);
+
+ private:
+  /// Files scanned, by path.
+  std::map<std::string, ScannedFile> scanned_;
+
+  /// Protects scanned_.
+  std::mutex scanned_mutex_;
+
+  /// Scans files in the background, nullptr when scanning in the callback.
+  std::unique_ptr<YaraScanQueue> scan_queue_;
 };
 
 /**
@@ -134,13 +205,27 @@ Status YARAEventSubscriber::Callback(const FileEventContextRef& ec,
     return Status(1, "Invalid action");
   }
 
-  Row r;
-  r["action"] = ec->action;
-  r["target_path"] = ec->path;
-  r["category"] = sc->category;
+  YaraScanRequest request;
+  request.path = ec->path;
+  request.category = sc->category;
+  request.action = ec->action;
 
   // Only FSEvents transactions updates (inotify is a no-op).
-  r["transaction_id"] = INTEGER(ec->transaction_id);
+  request.transaction_id = INTEGER(ec->transaction_id);
+
+  // Writes to a file are coalesced, the file is scanned once it is quiet.
+  if (scan_queue_ != nullptr && scan_queue_->add(request)) {
+    return Status::success();
+  }
+  return scan(request);
+}
+
+Status YARAEventSubscriber::scan(const YaraScanRequest& request) {
+  Row r;
+  r["action"] = request.action;
+  r["target_path"] = request.path;
+  r["category"] = request.category;
+  r["transaction_id"] = request.transaction_id;
 
   // These are default values, to be updated in YARACallback.
   r["count"] = INTEGER(0);
@@ -163,43 +248,103 @@ Status YARAEventSubscriber::Callback(const FileEventContextRef& ec,
     return Status(1, "Yara parser unknown.");
   }
 
-  const auto& rules = yaraParser->rules();
-
   // Use the category as a lookup into the yara file_paths. The value will be
-  // a list of signature groups to scan with.
-  auto category = r.at("category");
-  const auto& yara_config = parser->getData().doc();
-  const auto& yara_paths = yara_config["file_paths"];
-  const auto group_iter = yara_paths.FindMember(category);
-  if (group_iter != yara_paths.MemberEnd()) {
-    for (const auto& rule : group_iter->value.GetArray()) {
-      std::string group = rule.GetString();
+  // a list of signature groups to scan with. The rules are held, a config
+  // update may replace them during the scan.
+  std::vector<std::shared_ptr<YaraRulesHandle>> group_rules;
+  {
+    const auto& rules = yaraParser->rules();
+    const auto& yara_config = parser->getData().doc();
+    const auto& yara_paths = yara_config["file_paths"];
+    const auto group_iter = yara_paths.FindMember(request.category);
+    if (group_iter != yara_paths.MemberEnd()) {
+      for (const auto& rule : group_iter->value.GetArray()) {
+        std::string group = rule.GetString();
+
+        auto rule_it = rules.find(group);
 
-      auto rule_it = rules.find(group);
+        if (rule_it == rules.end()) {
+          VLOG(1) << "Yara rules group " + group + " not found, skipping it";
 
-      if (rule_it == rules.end()) {
-        VLOG(1) << "Yara rules group " + group + " not found, skipping it";
+          continue;
+        }
 
-        continue;
+        group_rules.push_back(rule_it->second);
       }
+    }
+  }
+
+  if (group_rules.empty() || isUnchanged(request.path, group_rules)) {
+    return Status::success();
+  }
 
-      int result = yr_rules_scan_file(rule_it->second.get(),
-                                      ec->path.c_str(),
-                                      SCAN_FLAGS_FAST_MODE,
-                                      YARACallback,
-                                      (void*)&r,
-                                      0);
+  for (const auto& group : group_rules) {
+    int result = yr_rules_scan_file(group->get(),
+                                    request.path.c_str(),
+                                    SCAN_FLAGS_FAST_MODE,
+                                    YARACallback,
+                                    (void*)&r,
+                                    0);
 
-      if (result != ERROR_SUCCESS) {
-        return Status(1, "YARA error: " + std::to_string(result));
-      }
+    if (result != ERROR_SUCCESS) {
+      // The next event scans the file again.
+      std::lock_guard<std::mutex> lock(scanned_mutex_);
+      scanned_.erase(request.path);
+      return Status(1, "YARA error: " + std::to_string(result));
     }
   }
 
-  if (ec->action != "" && !r.at("matches").empty()) {
+  if (!request.action.empty() && !r.at("matches").empty()) {
     add(r);
   }
 
   return Status::success();
 }
+
+bool YARAEventSubscriber::isUnchanged(
+    const std::string& path,
+    const std::vector<std::shared_ptr<YaraRulesHandle>>& rules) {
+  struct stat sb;
+  if (::stat(path.c_str(), &sb) != 0) {
+    return false;
+  }
+
+  std::unique_lock<std::mutex> lock(scanned_mutex_);
+  auto it = scanned_.find(path);
+  bool same_rules = it != scanned_.end() &&
+                    it->second.rules.size() == rules.size() &&
+                    std::equal(rules.begin(),
+                               rules.end(),
+                               it->second.rules.begin(),
+                               [](const std::shared_ptr<YaraRulesHandle>& a,
+                                  const std::weak_ptr<YaraRulesHandle>& b) {
+                                 return a == b.lock();
+                               });
+  if (same_rules && it->second.device == sb.st_dev &&
+      it->second.inode == sb.st_ino && it->second.size == sb.st_size &&
+      it->second.mtime == sb.st_mtime && it->second.ctime == sb.st_ctime) {
+    return true;
+  }
+  auto previous = (it != scanned_.end()) ? it->second.sha256 : "";
+  lock.unlock();
+
+  // A touched file may still have the scanned content.
+  ScannedFile file;
+  file.device = sb.st_dev;
+  file.inode = sb.st_ino;
+  file.size = sb.st_size;
+  file.mtime = sb.st_mtime;
+  file.ctime = sb.st_ctime;
+  file.sha256 = hashFromFile(HASH_TYPE_SHA256, path);
+  file.rules.assign(rules.begin(), rules.end());
+  auto unchanged = same_rules && !file.sha256.empty() &&
+                   file.sha256 == previous;
+
+  lock.lock();
+  if (scanned_.count(path) == 0 && scanned_.size() >= kMaxScannedFiles) {
+    scanned_.erase(scanned_.begin());
+  }
+  scanned_[path] = std::move(file);
+  return unchanged;
+}
 } // namespace osquery
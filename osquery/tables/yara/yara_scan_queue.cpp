@@ -0,0 +1,133 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+
+#include <osquery/core/system.h>
+#include <osquery/tables/yara/yara_scan_queue.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+namespace {
+
+/// Files waiting at once before the queue refuses new files.
+const std::size_t kMaxPendingScans{4096};
+
+} // namespace
+
+YaraScanQueue::YaraScanQueue(std::size_t thread_count,
+                             std::chrono::milliseconds quiet,
+                             std::chrono::milliseconds max_delay,
+                             ScanFunction scan)
+    : quiet_(quiet), max_delay_(max_delay), scan_(std::move(scan)) {
+  if (thread_count == 0) {
+    thread_count = 1;
+  }
+
+  threads_.reserve(thread_count);
+  for (std::size_t i = 0; i < thread_count; ++i) {
+    threads_.emplace_back([this]() {
+      setThreadName("YaraScanQueue");
+      work();
+    });
+  }
+}
+
+YaraScanQueue::~YaraScanQueue() {
+  stop();
+}
+
+bool YaraScanQueue::add(YaraScanRequest request) {
+  auto now = std::chrono::steady_clock::now();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = jobs_.find(request.path);
+  if (it != jobs_.end()) {
+    // Each event restarts the quiet period, up to the max delay.
+    auto& job = it->second;
+    job.request = std::move(request);
+    job.deadline = std::min(now + quiet_, job.first + max_delay_);
+  } else {
+    if (jobs_.size() >= kMaxPendingScans) {
+      return false;
+    }
+
+    auto path = request.path;
+    auto& job = jobs_[path];
+    job.request = std::move(request);
+    job.first = now;
+    job.deadline = now + quiet_;
+  }
+
+  cv_.notify_one();
+  return true;
+}
+
+void YaraScanQueue::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      return;
+    }
+    stopping_ = true;
+  }
+  cv_.notify_all();
+
+  for (auto& thread : threads_) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+  threads_.clear();
+}
+
+std::size_t YaraScanQueue::pending() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return jobs_.size();
+}
+
+void YaraScanQueue::work() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    // Take the file whose quiet period ends first.
+    auto next = jobs_.end();
+    for (auto it = jobs_.begin(); it != jobs_.end(); ++it) {
+      if (scanning_.count(it->first) == 0 &&
+          (next == jobs_.end() || it->second.deadline < next->second.deadline)) {
+        next = it;
+      }
+    }
+
+    if (next == jobs_.end()) {
+      cv_.wait(lock);
+      continue;
+    }
+
+    auto deadline = next->second.deadline;
+    if (std::chrono::steady_clock::now() < deadline) {
+      cv_.wait_until(lock, deadline);
+      continue;
+    }
+
+    auto request = std::move(next->second.request);
+    jobs_.erase(next);
+    scanning_.insert(request.path);
+
+    lock.unlock();
+    scan_(request);
+    lock.lock();
+
+    // Events during the scan may be waiting for this file.
+    scanning_.erase(request.path);
+    cv_.notify_all();
+  }
+}
+
+} // namespace osquery
@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+namespace osquery {
+
+/// A file event waiting for its scan, later events for the file replace it.
+struct YaraScanRequest final {
+  std::string path;
+  std::string category;
+  std::string action;
+  std::string transaction_id;
+};
+
+/**
+ * @brief Scan the targets of file events on background threads.
+ *
+ * A file under active write sends many events. The scan of a file waits
+ * until no event for it arrived during the quiet period, so a burst of
+ * writes is scanned once, with the last event. A file that never stops
+ * changing is still scanned once the max delay passed since its first
+ * event.
+ */
+class YaraScanQueue : private boost::noncopyable {
+ public:
+  using ScanFunction = std::function<void(const YaraScanRequest&)>;
+
+  /**
+   * @brief Start the scanning threads.
+   *
+   * @param thread_count The number of files scanned at the same time.
+   * @param quiet How long a file must not change before it is scanned.
+   * @param max_delay How long a file may wait after its first event.
+   * @param scan Scans a file, called on the scanning threads.
+   */
+  YaraScanQueue(std::size_t thread_count,
+                std::chrono::milliseconds quiet,
+                std::chrono::milliseconds max_delay,
+                ScanFunction scan);
+
+  /// Stops the scanning threads, see stop.
+  ~YaraScanQueue();
+
+  /**
+   * @brief Queue the scan of the target of an event.
+   *
+   * @return false if too many files are waiting, the event is not queued
+   * and the caller should scan the file itself.
+   */
+  bool add(YaraScanRequest request);
+
+  /// Stop the scanning threads, the files waiting are not scanned.
+  void stop();
+
+  /// The number of files waiting to be scanned.
+  std::size_t pending() const;
+
+ private:
+  struct Job final {
+    YaraScanRequest request;
+    std::chrono::steady_clock::time_point first;
+    std::chrono::steady_clock::time_point deadline;
+  };
+
+  /// The scanning thread loop.
+  void work();
+
+ private:
+  const std::chrono::milliseconds quiet_;
+
+  const std::chrono::milliseconds max_delay_;
+
+  const ScanFunction scan_;
+
+  /// Files waiting for their quiet period to end, by path.
+  std::map<std::string, Job> jobs_;
+
+  /// Files being scanned, their new events wait for the scan to end.
+  std::set<std::string> scanning_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+
+  std::atomic<bool> stopping_{false};
+
+  std::vector<std::thread> threads_;
+};
+
+} // namespace osquery
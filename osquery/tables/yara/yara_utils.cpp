@@ -15,6 +15,8 @@
 
 #include <osquery/config/config.h>
 #include <osquery/filesystem/fileops.h>
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/hashing/hashing.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/remote/uri.h>
@@ -245,7 +247,40 @@ YaraCompilerResult compileFromString(const std::string& rule_defs) {
  */
 Status handleRuleFiles(const std::string& category,
                        const rapidjson::Value& rule_files,
-                       std::map<std::string, YaraRulesHandle>& rules) {
+                       YaraRulesMap& rules,
+                       std::map<std::string, std::string>& digests) {
+  // Config updates with unchanged rule files reuse the compiled rules.
+  std::string contents;
+  for (const auto& item : rule_files.GetArray()) {
+    if (!item.IsString()) {
+      continue;
+    }
+
+    std::string rule = item.GetString();
+    if (boost::filesystem::path(rule).is_relative()) {
+      rule = kYARAHome + rule;
+    }
+
+    std::string content;
+    if (!readFile(rule, content).ok()) {
+      // The compile step reports the missing file.
+      contents.clear();
+      break;
+    }
+    contents += rule + '\0' + std::to_string(content.size()) + '\0' + content;
+  }
+
+  std::string digest;
+  if (!contents.empty()) {
+    digest = hashFromBuffer(HASH_TYPE_SHA256, contents.data(), contents.size());
+    auto it = digests.find(category);
+    if (it != digests.end() && it->second == digest && rules.count(category)) {
+      VLOG(1) << "YARA signature group " << category << " is unchanged";
+      return Status::success();
+    }
+  }
+  digests.erase(category);
+
   auto compiler_result = createCompiler();
 
   if (compiler_result.isError()) {
@@ -287,7 +322,8 @@ Status handleRuleFiles(const std::string& category,
     if (result != ERROR_SUCCESS && result != ERROR_INVALID_FILE) {
       return Status(1, "YARA load error " + std::to_string(result));
     } else if (result == ERROR_SUCCESS) {
-      rules.insert_or_assign(category, tmp_rules);
+      rules.insert_or_assign(category,
+                             std::make_shared<YaraRulesHandle>(tmp_rules));
     } else {
       compiled = true;
       // Try to compile the rules.
@@ -328,9 +364,13 @@ Status handleRuleFiles(const std::string& category,
     }
 
     // All the rules for this category have been compiled, save them in the map.
-    rules.insert_or_assign(category, new_rules);
+    rules.insert_or_assign(category,
+                           std::make_shared<YaraRulesHandle>(new_rules));
   }
 
+  if (!digest.empty()) {
+    digests[category] = digest;
+  }
   return Status::success();
 }
 
@@ -424,7 +464,8 @@ Status YARAConfigParserPlugin::update(const std::string& source,
           VLOG(1) << "YARA signature group " << category << " must be an array";
         } else {
           VLOG(1) << "Compiling YARA signature group: " << category;
-          auto status = handleRuleFiles(category, element.value, rules_);
+          auto status = handleRuleFiles(
+              category, element.value, rules_, rule_digests_);
           if (!status.ok()) {
             VLOG(1) << "YARA rule compile error: " << status.getMessage();
             return status;
@@ -9,6 +9,10 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
+#include <string>
+
 #include <boost/property_tree/ptree.hpp>
 
 #include <osquery/config/config.h>
@@ -67,6 +71,15 @@ enum class YaraCompilerError {
 
 using YaraCompilerResult = Expected<YaraRulesHandle, YaraCompilerError>;
 
+/**
+ * @brief Compiled rules, by group or signature.
+ *
+ * Compiled rules are read-only while scanning, so scans on several threads
+ * share them. A scan holds a reference, a config update replacing the rules
+ * never frees them during the scan.
+ */
+using YaraRulesMap = std::map<std::string, std::shared_ptr<YaraRulesHandle>>;
+
 void YARACompilerCallback(int error_level,
                           const char* file_name,
                           int line_number,
@@ -81,9 +94,16 @@ YaraCompilerResult compileSingleFile(const std::string& file);
 
 YaraCompilerResult compileFromString(const std::string& buffer);
 
+/**
+ * @brief Compile the rule files of a group.
+ *
+ * The digest of the rule file contents is kept for each group, a group is
+ * only compiled again if a rule file changed.
+ */
 Status handleRuleFiles(const std::string& category,
-                       const pt::ptree& rule_files,
-                       std::map<std::string, YaraRulesHandle>& rules);
+                       const rapidjson::Value& rule_files,
+                       YaraRulesMap& rules,
+                       std::map<std::string, std::string>& digests);
 
 /**
  * Avoid scanning files that could cause hangs or issues.
@@ -114,10 +134,15 @@ class YARAConfigParserPlugin : public ConfigParserPlugin {
   }
 
   // Retrieve compiled rules.
-  std::map<std::string, YaraRulesHandle>& rules() {
+  YaraRulesMap& rules() {
     return rules_;
   }
 
+  // Retrieve the digests of the compiled rule files.
+  std::map<std::string, std::string>& rule_digests() {
+    return rule_digests_;
+  }
+
   std::set<std::string>& url_allow_set() {
     return url_allow_set_;
   }
@@ -126,7 +151,10 @@ class YARAConfigParserPlugin : public ConfigParserPlugin {
 
  private:
   // Store compiled rules in a map (group => rules).
-  std::map<std::string, YaraRulesHandle> rules_;
+  YaraRulesMap rules_;
+
+  // Digest of the rule file contents of each group or sigfile.
+  std::map<std::string, std::string> rule_digests_;
 
   std::set<std::string> url_allow_set_;
 
@@ -124,6 +124,12 @@ const std::string kImdsTokenTtlHeader = "x-aws-ec2-metadata-token-ttl-seconds";
 /// Default TTL value for IMDSv2 API token, set as per the AWS SDK
 const std::string kImdsTokenTtlDefaultValue = "21600";
 
+/// An IMDSv2 token is reused until a minute before its TTL ends
+const std::chrono::seconds kImdsTokenReuseTime{21600 - 60};
+
+/// How long the EC2 instance metadata responses are reused
+const std::chrono::seconds kEc2MetadataCacheTime{300};
+
 /// Map of AWS region name to AWS::Region enum.
 static const std::set<std::string> kAwsRegions = {
     "af-south-1",     "ap-east-1",     "ap-northeast-1", "ap-northeast-2",
@@ -514,7 +520,7 @@ boost::optional<std::pair<std::string, std::string>> getInstanceIDAndRegion() {
   return {{cached_id, cached_region}};
 }
 
-boost::optional<std::string> getIMDSToken() {
+static boost::optional<std::string> requestIMDSToken() {
   std::string token;
   http::Request req(kEc2MetadataUrl + kImdsTokenResource);
   http::Client::Options options;
@@ -562,6 +568,26 @@ boost::optional<std::string> getIMDSToken() {
   return token;
 }
 
+boost::optional<std::string> getIMDSToken() {
+  std::string token;
+  auto status = http::InstanceMetadataCache::get().fetch(
+      kEc2MetadataUrl + kImdsTokenResource,
+      [](std::string& body) {
+        auto requested = requestIMDSToken();
+        if (!requested.has_value()) {
+          return Status::failure("Could not retrieve an IMDSv2 token");
+        }
+        body = std::move(*requested);
+        return Status::success();
+      },
+      token,
+      kImdsTokenReuseTime);
+  if (!status.ok()) {
+    return boost::none;
+  }
+  return token;
+}
+
 Status getAWSRegion(std::string& region, bool sts, bool validate_region) {
   // First try using the explicit region flags (STS or otherwise).
   if (sts && !FLAGS_aws_sts_region.empty()) {
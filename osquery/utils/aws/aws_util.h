@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <memory>
 #include <string>
 #include <utility>
@@ -59,6 +60,9 @@ extern const std::string kImdsTokenTtlHeader;
 /// Default TTL value for IMDSv2 API token
 extern const std::string kImdsTokenTtlDefaultValue;
 
+/// How long the EC2 instance metadata responses are reused
+extern const std::chrono::seconds kEc2MetadataCacheTime;
+
 /**
  * @brief Client factory for the Osquery HTTP client
  */
@@ -176,6 +180,7 @@ void initAwsSdk();
  * If it fails to retrieve the token, it does FLAGS_aws_imdsv2_request_attempts
  * attempts, with an interval of FLAGS_aws_imdsv2_request_interval, which scales
  * quadratically.
+ * A token is reused by the following calls until shortly before it expires.
  *
  * @return token as a string if successful, boost::none if not
  */
@@ -17,6 +17,7 @@
 #include <osquery/utils/info/platform_type.h>
 #include <osquery/utils/json/json.h>
 
+#include <chrono>
 #include <mutex>
 
 namespace http = osquery::http;
@@ -33,6 +34,9 @@ const std::string kAzureMetadataEndpoint =
 // respond.
 const int kAzureMetadataTimeout = 3;
 
+// The metadata is reused by the queries within 5 minutes.
+const std::chrono::seconds kAzureMetadataCacheTime{300};
+
 static bool isAzureInstance() {
   static std::atomic<bool> checked(false);
   static std::atomic<bool> is_azure_instance(false);
@@ -79,30 +83,45 @@ Status fetchAzureMetadata(JSON& doc) {
     return Status(1, "Not an Azure instance");
   }
 
-  http::Request request(kAzureMetadataEndpoint);
-  http::Client::Options opts;
-  http::Response response;
-
-  opts.timeout(kAzureMetadataTimeout);
-  http::Client client(opts);
-
-  request << http::Request::Header("Metadata", "true");
-
-  try {
-    response = client.get(request);
-  } catch (const std::system_error& e) {
-    return Status(
-        1, "Couldn't request " + kAzureMetadataEndpoint + ": " + e.what());
-  }
-
-  // Non-200s can indicate a variety of conditions, so report them.
-  if (response.result_int() != 200) {
-    return Status(1,
-                  std::string("Azure metadata service responded with ") +
-                      std::to_string(response.result_int()));
+  // The instance metadata, with its tags, is shared by the Azure tables.
+  std::string body;
+  auto status = http::InstanceMetadataCache::get().fetch(
+      kAzureMetadataEndpoint,
+      [](std::string& response_body) {
+        http::Request request(kAzureMetadataEndpoint);
+        http::Client::Options opts;
+        http::Response response;
+
+        opts.timeout(kAzureMetadataTimeout);
+        http::Client client(opts);
+
+        request << http::Request::Header("Metadata", "true");
+
+        try {
+          response = client.get(request);
+        } catch (const std::system_error& e) {
+          return Status(1,
+                        "Couldn't request " + kAzureMetadataEndpoint + ": " +
+                            e.what());
+        }
+
+        // Non-200s can indicate a variety of conditions, so report them.
+        if (response.result_int() != 200) {
+          return Status(1,
+                        std::string("Azure metadata service responded with ") +
+                            std::to_string(response.result_int()));
+        }
+
+        response_body = response.body();
+        return Status::success();
+      },
+      body,
+      kAzureMetadataCacheTime);
+  if (!status.ok()) {
+    return status;
   }
 
-  auto s = doc.fromString(response.body());
+  auto s = doc.fromString(body);
   if (!s.ok()) {
     return s;
   }
@@ -0,0 +1,191 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <tuple>
+#include <utility>
+
+namespace osquery {
+namespace caches {
+
+template <typename KeyType, typename ValueType, typename Hash>
+ShardedCache<KeyType, ValueType, Hash>::ShardedCache(std::size_t capacity,
+                                                     std::size_t shards,
+                                                     Sizer sizer)
+    : capacity_(capacity), sizer_(std::move(sizer)) {
+  shards = std::max<std::size_t>(shards, 1);
+  shard_capacity_ = capacity / shards;
+  if (shard_capacity_ == 0 && capacity > 0) {
+    // A small cache uses fewer shards, each able to keep an entry.
+    shards = capacity;
+    shard_capacity_ = 1;
+  }
+
+  for (std::size_t i = 0; i < shards; ++i) {
+    shards_.push_back(std::make_unique<Shard>());
+  }
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+typename ShardedCache<KeyType, ValueType, Hash>::Shard&
+ShardedCache<KeyType, ValueType, Hash>::getShard(const KeyType& key) const {
+  // The low bits also pick the bucket within the shard, mix in the high bits.
+  auto hash = static_cast<uint64_t>(hash_(key));
+  hash ^= hash >> 32;
+  hash *= 0x9e3779b97f4a7c15ULL;
+  return *shards_[(hash >> 32) % shards_.size()];
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+bool ShardedCache<KeyType, ValueType, Hash>::insert(const KeyType& key,
+                                                    ValueType value) {
+  auto bytes = (sizer_ != nullptr) ? sizer_(key, value) : 1;
+  auto& shard = getShard(key);
+
+  WriteLock lock(shard.mutex);
+  auto it = shard.map.find(key);
+  if (it != shard.map.end()) {
+    remove(shard, it);
+  }
+
+  if (bytes > shard_capacity_) {
+    return false;
+  }
+
+  evict(shard, bytes);
+  auto& node = *shard.map.emplace(
+      std::piecewise_construct,
+      std::forward_as_tuple(key),
+      std::forward_as_tuple(std::move(value), bytes)).first;
+  node.second.slot = shard.clock.size();
+  shard.clock.push_back(&node);
+  shard.bytes += bytes;
+  shard.insertions++;
+  return true;
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+boost::optional<ValueType> ShardedCache<KeyType, ValueType, Hash>::get(
+    const KeyType& key) const {
+  auto& shard = getShard(key);
+
+  ReadLock lock(shard.mutex);
+  auto it = shard.map.find(key);
+  if (it == shard.map.end()) {
+    shard.misses.fetch_add(1, std::memory_order_relaxed);
+    return boost::none;
+  }
+
+  it->second.referenced.store(true, std::memory_order_relaxed);
+  shard.hits.fetch_add(1, std::memory_order_relaxed);
+  return it->second.value;
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+bool ShardedCache<KeyType, ValueType, Hash>::has(const KeyType& key) const {
+  auto& shard = getShard(key);
+
+  ReadLock lock(shard.mutex);
+  return shard.map.count(key) > 0;
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+bool ShardedCache<KeyType, ValueType, Hash>::erase(const KeyType& key) {
+  auto& shard = getShard(key);
+
+  WriteLock lock(shard.mutex);
+  auto it = shard.map.find(key);
+  if (it == shard.map.end()) {
+    return false;
+  }
+  remove(shard, it);
+  return true;
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+void ShardedCache<KeyType, ValueType, Hash>::clear() {
+  for (auto& shard : shards_) {
+    WriteLock lock(shard->mutex);
+    shard->clock.clear();
+    shard->map.clear();
+    shard->hand = 0;
+    shard->bytes = 0;
+  }
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+std::size_t ShardedCache<KeyType, ValueType, Hash>::size() const {
+  std::size_t size = 0;
+  for (const auto& shard : shards_) {
+    ReadLock lock(shard->mutex);
+    size += shard->map.size();
+  }
+  return size;
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+std::size_t ShardedCache<KeyType, ValueType, Hash>::bytes() const {
+  std::size_t bytes = 0;
+  for (const auto& shard : shards_) {
+    ReadLock lock(shard->mutex);
+    bytes += shard->bytes;
+  }
+  return bytes;
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+CacheStats ShardedCache<KeyType, ValueType, Hash>::stats() const {
+  CacheStats stats;
+  for (const auto& shard : shards_) {
+    ReadLock lock(shard->mutex);
+    stats.hits += shard->hits.load(std::memory_order_relaxed);
+    stats.misses += shard->misses.load(std::memory_order_relaxed);
+    stats.insertions += shard->insertions;
+    stats.evictions += shard->evictions;
+    stats.entries += shard->map.size();
+    stats.bytes += shard->bytes;
+  }
+  return stats;
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+void ShardedCache<KeyType, ValueType, Hash>::remove(
+    Shard& shard, typename MapType::iterator it) {
+  // The last entry of the clock takes the slot, the hand sees it next.
+  auto slot = it->second.slot;
+  shard.clock[slot] = shard.clock.back();
+  shard.clock[slot]->second.slot = slot;
+  shard.clock.pop_back();
+  if (shard.hand >= shard.clock.size()) {
+    shard.hand = 0;
+  }
+
+  shard.bytes -= it->second.bytes;
+  shard.map.erase(it);
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+void ShardedCache<KeyType, ValueType, Hash>::evict(Shard& shard,
+                                                   std::size_t bytes) {
+  while (!shard.clock.empty() && shard.bytes + bytes > shard_capacity_) {
+    auto* node = shard.clock[shard.hand];
+    if (node->second.referenced.exchange(false, std::memory_order_relaxed)) {
+      shard.hand = (shard.hand + 1) % shard.clock.size();
+      continue;
+    }
+
+    remove(shard, shard.map.find(node->first));
+    shard.evictions++;
+  }
+}
+
+} // namespace caches
+} // namespace osquery
@@ -0,0 +1,165 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+namespace caches {
+
+/// Counters of a cache, summed over its shards.
+struct CacheStats {
+  uint64_t hits{0};
+  uint64_t misses{0};
+  uint64_t insertions{0};
+  uint64_t evictions{0};
+
+  /// The entries and their bytes, as counted by the cache's sizer.
+  size_t entries{0};
+  size_t bytes{0};
+};
+
+/**
+ * A cache shared by threads, bounded by the size of its entries.
+ *
+ * Keys are spread over shards by hash, each with its own lock, so threads
+ * using different keys seldom wait for each other. Lookups only take a shared
+ * lock: a hit marks the entry referenced and copies its value, values that are
+ * expensive to copy should be held by a shared_ptr.
+ *
+ * Each shard evicts with the CLOCK algorithm, an approximation of LRU. The
+ * clock hand sweeps the entries, clearing the referenced mark of entries used
+ * since its last pass and evicting the first entry that was not used.
+ *
+ * The capacity is the sum of the sizes of the entries, as returned by the
+ * sizer, split evenly over the shards. Without a sizer each entry has size 1
+ * and the capacity is a number of entries.
+ */
+template <typename KeyType_,
+          typename ValueType_,
+          typename Hash_ = std::hash<KeyType_>>
+class ShardedCache : private boost::noncopyable {
+ public:
+  using KeyType = KeyType_;
+  using ValueType = ValueType_;
+  using Sizer = std::function<size_t(const KeyType&, const ValueType&)>;
+
+  /**
+   * @brief Create a cache with a certain capacity.
+   *
+   * @param capacity the total size of the entries.
+   * @param shards the number of independently locked shards.
+   * @param sizer the size of an entry, 1 if not set.
+   */
+  explicit ShardedCache(std::size_t capacity,
+                        std::size_t shards = 16,
+                        Sizer sizer = nullptr);
+
+  /**
+   * @brief Insert a key and value, replacing the value of the same key.
+   *
+   * Entries are evicted from the key's shard until the value fits. A value
+   * larger than a shard's capacity is not cached.
+   *
+   * @returns true if the value was cached.
+   */
+  bool insert(const KeyType& key, ValueType value);
+
+  /**
+   * @brief Get a copy of the value of a key, if cached.
+   *
+   * A hit marks the entry as referenced, it is not evicted by the next pass
+   * of the clock hand.
+   */
+  boost::optional<ValueType> get(const KeyType& key) const;
+
+  /// Test if a key is cached, without marking it referenced.
+  bool has(const KeyType& key) const;
+
+  /// Remove a key, returns true if it was cached.
+  bool erase(const KeyType& key);
+
+  /// Remove every entry, the counters are kept.
+  void clear();
+
+  /// The number of cached entries.
+  std::size_t size() const;
+
+  /// The sum of the sizes of the cached entries.
+  std::size_t bytes() const;
+
+  std::size_t capacity() const noexcept {
+    return capacity_;
+  }
+
+  /// The counters and current size of the cache.
+  CacheStats stats() const;
+
+ private:
+  struct Entry {
+    Entry(ValueType v, std::size_t b) : value(std::move(v)), bytes(b) {}
+
+    ValueType value;
+    std::size_t bytes;
+
+    /// The position of the entry in its shard's clock.
+    std::size_t slot{0};
+
+    /// Set by a hit, cleared as the clock hand passes.
+    mutable std::atomic<bool> referenced{false};
+  };
+
+  using MapType = std::unordered_map<KeyType, Entry, Hash_>;
+
+  struct Shard {
+    mutable Mutex mutex;
+    MapType map;
+
+    /// The entries in clock order, map nodes do not move.
+    std::vector<typename MapType::value_type*> clock;
+    std::size_t hand{0};
+    std::size_t bytes{0};
+
+    mutable std::atomic<uint64_t> hits{0};
+    mutable std::atomic<uint64_t> misses{0};
+    uint64_t insertions{0};
+    uint64_t evictions{0};
+  };
+
+  Shard& getShard(const KeyType& key) const;
+
+  /// Remove an entry of a locked shard.
+  void remove(Shard& shard, typename MapType::iterator it);
+
+  /// Evict entries of a locked shard until bytes more fit.
+  void evict(Shard& shard, std::size_t bytes);
+
+ private:
+  std::size_t const capacity_;
+  std::size_t shard_capacity_;
+  Sizer sizer_;
+  Hash_ hash_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+} // namespace caches
+} // namespace osquery
+
+#include <osquery/utils/caches/sharded-impl.h>
@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <osquery/utils/caches/sharded.h>
+
+namespace osquery {
+namespace {
+
+class ShardedCacheTests : public testing::Test {};
+
+TEST_F(ShardedCacheTests, insert_and_get) {
+  caches::ShardedCache<int, std::string> cache(16, 4);
+  EXPECT_FALSE(cache.get(1));
+  EXPECT_TRUE(cache.insert(1, "one"));
+  EXPECT_TRUE(cache.insert(2, "two"));
+  EXPECT_EQ(*cache.get(1), "one");
+  EXPECT_EQ(cache.size(), 2U);
+
+  // The value of a key is replaced.
+  EXPECT_TRUE(cache.insert(1, "uno"));
+  EXPECT_EQ(*cache.get(1), "uno");
+  EXPECT_EQ(cache.size(), 2U);
+
+  EXPECT_TRUE(cache.erase(1));
+  EXPECT_FALSE(cache.erase(1));
+  EXPECT_FALSE(cache.has(1));
+
+  cache.clear();
+  EXPECT_EQ(cache.size(), 0U);
+
+  auto stats = cache.stats();
+  EXPECT_EQ(stats.hits, 2U);
+  EXPECT_EQ(stats.misses, 1U);
+  EXPECT_EQ(stats.insertions, 3U);
+}
+
+TEST_F(ShardedCacheTests, clock_eviction) {
+  caches::ShardedCache<int, int> cache(3, 1);
+  cache.insert(1, 10);
+  cache.insert(2, 20);
+  cache.insert(3, 30);
+
+  // The referenced entry is passed over by the clock hand.
+  EXPECT_TRUE(cache.get(1));
+  cache.insert(4, 40);
+  EXPECT_EQ(cache.size(), 3U);
+  EXPECT_TRUE(cache.has(1));
+  EXPECT_FALSE(cache.has(2));
+  EXPECT_TRUE(cache.has(3));
+  EXPECT_TRUE(cache.has(4));
+  EXPECT_EQ(cache.stats().evictions, 1U);
+}
+
+TEST_F(ShardedCacheTests, byte_capacity) {
+  caches::ShardedCache<int, std::string> cache(
+      10, 1, [](const int&, const std::string& value) {
+        return value.size();
+      });
+  cache.insert(1, "aaaa");
+  cache.insert(2, "bbbb");
+  EXPECT_EQ(cache.bytes(), 8U);
+
+  // Entries are evicted until the new value fits.
+  cache.insert(3, "cccccc");
+  EXPECT_LE(cache.bytes(), 10U);
+  EXPECT_TRUE(cache.has(3));
+
+  // A value larger than the capacity is not cached.
+  EXPECT_FALSE(cache.insert(4, std::string(11, 'd')));
+  EXPECT_FALSE(cache.has(4));
+}
+
+TEST_F(ShardedCacheTests, concurrent_access) {
+  caches::ShardedCache<int, int> cache(64, 8);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&cache, t]() {
+      for (int i = 0; i < 10000; ++i) {
+        auto key = (i * 7 + t) % 256;
+        auto value = cache.get(key);
+        if (value) {
+          EXPECT_EQ(*value, key * 2);
+        } else {
+          cache.insert(key, key * 2);
+        }
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_LE(cache.size(), 64U);
+
+  auto stats = cache.stats();
+  EXPECT_EQ(stats.hits + stats.misses, 40000U);
+}
+
+} // namespace
+} // namespace osquery
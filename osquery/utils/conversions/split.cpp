@@ -9,47 +9,87 @@
 
 #include "split.h"
 
-#include <boost/algorithm/string.hpp>
+#include "trim.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
 
 namespace osquery {
 
 std::vector<std::string> split(const std::string& s, const std::string& delim) {
-  std::vector<std::string> elems;
-  boost::split(elems, s, boost::is_any_of(delim));
-  auto start =
-      std::remove_if(elems.begin(), elems.end(), [](const std::string& t) {
-        return t.size() == 0;
-      });
-  elems.erase(start, elems.end());
-  for (auto& each : elems) {
-    boost::algorithm::trim(each);
-  }
-  return elems;
+  auto views = vsplit(s, std::string_view(delim));
+  return std::vector<std::string>(views.begin(), views.end());
 }
 
 std::vector<std::string> split(const std::string& s,
                                char delim,
                                size_t occurrences) {
-  auto delims = std::string(1, delim);
   // Split the string normally with the required delimiter.
-  auto content = split(s, delims);
-  // While the result split exceeds the number of requested occurrences, join.
-  std::vector<std::string> accumulator;
+  auto content = vsplit(s, std::string_view(&delim, 1));
   std::vector<std::string> elems;
-  for (size_t i = 0; i < content.size(); i++) {
-    if (i < occurrences) {
-      elems.push_back(content.at(i));
-    } else {
-      accumulator.push_back(content.at(i));
-    }
+  elems.reserve(std::min(content.size(), occurrences + 1));
+  for (size_t i = 0; i < content.size() && i < occurrences; i++) {
+    elems.emplace_back(content[i]);
   }
-  // Join the optional accumulator.
-  if (accumulator.size() > 0) {
-    elems.push_back(boost::algorithm::join(accumulator, delims));
+  // Join the remaining elements with the delimiter.
+  if (content.size() > occurrences) {
+    std::string accumulator(content[occurrences]);
+    for (size_t i = occurrences + 1; i < content.size(); i++) {
+      accumulator += delim;
+      accumulator.append(content[i].data(), content[i].size());
+    }
+    elems.push_back(std::move(accumulator));
   }
   return elems;
 }
 
+std::vector<std::string_view> vsplit(const std::string_view source,
+                                     const std::string_view delimiters) {
+  std::vector<std::string_view> elements;
+  if (source.empty()) {
+    return elements;
+  }
+
+  auto add = [&elements](std::string_view element) {
+    if (!element.empty()) {
+      elements.push_back(trim(element));
+    }
+  };
+
+  if (delimiters.size() == 1) {
+    // A single delimiter is found with memchr, which is vectorized.
+    const char* start = source.data();
+    const char* const last = source.data() + source.size();
+    while (true) {
+      auto next = static_cast<const char*>(
+          std::memchr(start, delimiters[0], last - start));
+      if (next == nullptr) {
+        add(std::string_view(start, last - start));
+        break;
+      }
+      add(std::string_view(start, next - start));
+      start = next + 1;
+    }
+    return elements;
+  }
+
+  std::array<bool, 256> is_delimiter{};
+  for (const unsigned char c : delimiters) {
+    is_delimiter[c] = true;
+  }
+
+  std::size_t start = 0;
+  for (std::size_t i = 0; i < source.size(); ++i) {
+    if (is_delimiter[static_cast<unsigned char>(source[i])]) {
+      add(source.substr(start, i - start));
+      start = i + 1;
+    }
+  }
+  add(source.substr(start));
+  return elements;
+}
+
 std::vector<std::string_view> vsplit(const std::string_view source,
                                      char delimiter) {
   if (source.empty()) {
@@ -54,4 +54,17 @@ std::vector<std::string> split(const std::string& s,
 std::vector<std::string_view> vsplit(const std::string_view source,
                                      char delimiter);
 
+/**
+ * @brief Split a given string_view on any of the delimiters, like split.
+ *
+ * Empty elements are removed and the remaining elements are trimmed, the
+ * elements point into the source and nothing is copied.
+ *
+ * @param source the string to split, which must outlive the elements.
+ * @param delimiters each of these characters is a delimiter.
+ * @return std::vector<std::string_view>
+ */
+std::vector<std::string_view> vsplit(const std::string_view source,
+                                     const std::string_view delimiters);
+
 } // namespace osquery
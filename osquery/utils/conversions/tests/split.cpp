@@ -114,6 +114,24 @@ TEST_F(SplitConversionsTests, test_vplit) {
   }
 }
 
+TEST_F(SplitConversionsTests, test_vsplit_delimiters) {
+  for (const auto& i : generateSplitStringTestData()) {
+    auto splits = vsplit(i.test_string, std::string_view("\t "));
+    EXPECT_EQ(std::vector<std::string>(splits.begin(), splits.end()),
+              i.test_vector);
+  }
+
+  // Elements are trimmed, only empty elements are removed.
+  std::string content = "a, b,,c ,  ,d";
+  std::vector<std::string_view> expected = {"a", "b", "c", "", "d"};
+  EXPECT_EQ(vsplit(content, std::string_view(",")), expected);
+  EXPECT_EQ(split(content, ","),
+            std::vector<std::string>({"a", "b", "c", "", "d"}));
+
+  expected = {"a", "b", "c", "d"};
+  EXPECT_EQ(vsplit("a:b;c;;d", std::string_view(":;")), expected);
+}
+
 TEST_F(SplitConversionsTests, test_split_occurrences) {
   std::string content = "T: 'S:S'";
   std::vector<std::string> expected = {
@@ -19,14 +19,15 @@ std::string_view trim(std::string_view input) {
       return {};
     }
 
-    if (!std::isspace(input[start])) {
+    if (!std::isspace(static_cast<unsigned char>(input[start]))) {
       break;
     }
   }
 
   std::size_t end = input.size() - 1;
-  for (; end > start && std::isspace(input[end]); --end)
-    ;
+  while (end > start && std::isspace(static_cast<unsigned char>(input[end]))) {
+    --end;
+  }
 
   return std::string_view(&input[start], (end - start) + 1);
 }
@@ -19,6 +19,10 @@ namespace osquery {
 /**
  * @brief Parse a property list on disk into a property tree.
  *
+ * Binary and XML property lists are parsed by parsePlistContentNative. The
+ * trees of recently parsed files are cached by path and file identity, a
+ * file is parsed again when its inode, size, mtime or ctime changes.
+ *
  * @param path the input path to a property list.
  * @param tree the output property tree.
  *
@@ -38,6 +42,22 @@ Status parsePlist(const boost::filesystem::path& path,
 Status parsePlistContent(const std::string& content,
                          boost::property_tree::ptree& tree);
 
+/**
+ * @brief Parse binary or XML property list content without Foundation.
+ *
+ * The tree is the same as the one of parsePlistContent, except that the
+ * dictionary keys keep their order in the content. Other formats, such as
+ * OpenStep property lists, and malformed content return a failure; the
+ * caller may then use parsePlistContent.
+ *
+ * @param content the input string-content of a property list.
+ * @param tree the output property tree.
+ *
+ * @return an instance of Status, indicating success or failure.
+ */
+Status parsePlistContentNative(const std::string& content,
+                               boost::property_tree::ptree& tree);
+
 /**
  * @brief Parse property list alias data into a path string.
  *
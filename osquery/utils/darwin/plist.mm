@@ -12,7 +12,14 @@
 #import <Foundation/Foundation.h>
 #include <boost/filesystem/path.hpp>
 #include <boost/property_tree/json_parser.hpp>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <unordered_map>
+
+#include <sys/stat.h>
 
 #include <osquery/logger/logger.h>
 
@@ -24,6 +31,111 @@ namespace pt = boost::property_tree;
 
 namespace osquery {
 
+/// The most property list files with a cached tree.
+const size_t kPlistCacheMaxEntries{1024};
+
+/// The most bytes of property list files with a cached tree.
+const size_t kPlistCacheMaxBytes{8 * 1024 * 1024};
+
+/// Larger property list files are not cached.
+const size_t kPlistCacheMaxFileBytes{1024 * 1024};
+
+namespace {
+
+/// What identifies the content of a file without reading it.
+struct PlistFileIdentity {
+  dev_t device{0};
+  ino_t inode{0};
+  off_t size{0};
+  timespec mtime{};
+  timespec ctime{};
+
+  explicit PlistFileIdentity(const struct stat& st)
+      : device(st.st_dev),
+        inode(st.st_ino),
+        size(st.st_size),
+        mtime(st.st_mtimespec),
+        ctime(st.st_ctimespec) {}
+
+  bool operator==(const PlistFileIdentity& other) const {
+    return device == other.device && inode == other.inode &&
+           size == other.size && mtime.tv_sec == other.mtime.tv_sec &&
+           mtime.tv_nsec == other.mtime.tv_nsec &&
+           ctime.tv_sec == other.ctime.tv_sec &&
+           ctime.tv_nsec == other.ctime.tv_nsec;
+  }
+};
+
+/// The trees of recently parsed property list files, least recently used
+/// files are removed first.
+class PlistCache {
+ public:
+  static PlistCache& get() {
+    static PlistCache cache;
+    return cache;
+  }
+
+  /// Get the tree of a file if it did not change since it was parsed.
+  std::shared_ptr<const pt::ptree> find(const std::string& path,
+                                        const PlistFileIdentity& identity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(path);
+    if (it == entries_.end() || !(it->second.identity == identity)) {
+      return nullptr;
+    }
+    order_.splice(order_.end(), order_, it->second.position);
+    return it->second.tree;
+  }
+
+  void add(const std::string& path,
+           const PlistFileIdentity& identity,
+           const pt::ptree& tree) {
+    auto size = static_cast<size_t>(identity.size);
+    if (size > kPlistCacheMaxFileBytes) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(path);
+    if (it != entries_.end()) {
+      remove(it);
+    }
+
+    while (!order_.empty() && (entries_.size() >= kPlistCacheMaxEntries ||
+                               bytes_ + size > kPlistCacheMaxBytes)) {
+      remove(entries_.find(order_.front()));
+    }
+
+    order_.push_back(path);
+    entries_.emplace(path,
+                     Entry{identity,
+                           std::make_shared<const pt::ptree>(tree),
+                           std::prev(order_.end())});
+    bytes_ += size;
+  }
+
+ private:
+  struct Entry {
+    PlistFileIdentity identity;
+    std::shared_ptr<const pt::ptree> tree;
+    std::list<std::string>::iterator position;
+  };
+
+  void remove(std::unordered_map<std::string, Entry>::iterator it) {
+    bytes_ -= static_cast<size_t>(it->second.identity.size);
+    order_.erase(it->second.position);
+    entries_.erase(it);
+  }
+
+ private:
+  std::mutex mutex_;
+  std::unordered_map<std::string, Entry> entries_;
+  std::list<std::string> order_;
+  size_t bytes_{0};
+};
+
+} // namespace
+
 /**
  * @brief Filter selected data types from deserialized property list.
  *
@@ -148,6 +260,11 @@ static inline Status filterPlist(NSData* plist, pt::ptree& tree) {
 }
 
 Status parsePlistContent(const std::string& content, pt::ptree& tree) {
+  // Binary and XML property lists do not need Foundation.
+  if (parsePlistContentNative(content, tree).ok()) {
+    return Status(0, "OK");
+  }
+
   tree.clear();
   @autoreleasepool {
     id data = [NSData dataWithBytes:content.c_str() length:content.size()];
@@ -172,7 +289,8 @@ Status parsePlistContent(const std::string& content, pt::ptree& tree) {
   }
 }
 
-Status parsePlist(const fs::path& path, pt::ptree& tree) {
+/// Parse a property list file with Foundation.
+static Status parsePlistFile(const fs::path& path, pt::ptree& tree) {
   tree.clear();
 
   auto status = Status();
@@ -210,6 +328,40 @@ Status parsePlist(const fs::path& path, pt::ptree& tree) {
   return status;
 }
 
+Status parsePlist(const fs::path& path, pt::ptree& tree) {
+  tree.clear();
+
+  struct stat st;
+  if (::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+    return parsePlistFile(path, tree);
+  }
+
+  PlistFileIdentity identity(st);
+  auto cached = PlistCache::get().find(path.string(), identity);
+  if (cached != nullptr) {
+    tree = *cached;
+    return Status(0, "OK");
+  }
+
+  // Read the content and parse binary and XML property lists natively.
+  auto status = Status(1, "Unable to read plist: " + path.string());
+  std::ifstream stream(path.string(), std::ios::in | std::ios::binary);
+  if (stream.good()) {
+    std::stringstream content;
+    content << stream.rdbuf();
+    status = parsePlistContentNative(content.str(), tree);
+  }
+
+  if (!status.ok()) {
+    status = parsePlistFile(path, tree);
+  }
+
+  if (status.ok()) {
+    PlistCache::get().add(path.string(), identity, tree);
+  }
+  return status;
+}
+
 static Status pathFromUnknownAlias(const CFDataRef& data, std::string& result) {
   auto bytes = (const char*)CFDataGetBytePtr(data);
   auto blen = static_cast<size_t>(CFDataGetLength(data));
@@ -0,0 +1,675 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+
+#include <boost/property_tree/xml_parser.hpp>
+
+#include <osquery/utils/base64.h>
+#include <osquery/utils/darwin/plist.h>
+
+namespace pt = boost::property_tree;
+
+namespace osquery {
+
+namespace {
+
+/// Seconds between the Unix epoch and the Core Foundation epoch, 2001-01-01.
+const double kCFAbsoluteTimeIntervalSince1970{978307200.0};
+
+/// Binary property lists nested deeper than this are refused.
+const size_t kMaxPlistDepth{512};
+
+/// The size of the binary property list header and trailer.
+const size_t kBinaryPlistHeaderSize{8};
+const size_t kBinaryPlistTrailerSize{32};
+
+/// Format a number like NSNumber stringValue, with the shortest exact form.
+template <typename T>
+std::string formatReal(T value, int max_precision) {
+  char buffer[64];
+  for (int precision = 1; precision <= max_precision; ++precision) {
+    snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+    if (static_cast<T>(strtod(buffer, nullptr)) == value) {
+      break;
+    }
+  }
+  return buffer;
+}
+
+std::string formatDouble(double value) {
+  return formatReal(value, 17);
+}
+
+std::string formatFloat(float value) {
+  return formatReal(value, 9);
+}
+
+/// Append a code point as UTF-8.
+void appendUtf8(std::string& out, uint32_t cp) {
+  if (cp < 0x80) {
+    out += static_cast<char>(cp);
+  } else if (cp < 0x800) {
+    out += static_cast<char>(0xC0 | (cp >> 6));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  } else if (cp < 0x10000) {
+    out += static_cast<char>(0xE0 | (cp >> 12));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  } else {
+    out += static_cast<char>(0xF0 | (cp >> 18));
+    out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  }
+}
+
+/**
+ * @brief Add a dictionary value to a tree, like filterDictionary.
+ *
+ * A dictionary keeps the last value of a repeated key. Arrays are added as
+ * a child of anonymous elements.
+ */
+void putDictionaryValue(pt::ptree& tree,
+                        const std::string& key,
+                        pt::ptree value) {
+  auto it = tree.find(key);
+  if (it != tree.not_found()) {
+    tree.erase(tree.to_iterator(it));
+  }
+  tree.push_back(pt::ptree::value_type(key, std::move(value)));
+}
+
+/// A reader of the objects of a binary property list.
+class BinaryPlistReader {
+ public:
+  explicit BinaryPlistReader(const std::string& content) : data_(content) {}
+
+  /// Read the trailer and the top object into a tree.
+  Status parse(pt::ptree& tree);
+
+ private:
+  enum class Kind { Scalar, Data, Array, Dictionary };
+
+  /// Read an object, its kind says how it is added to its parent.
+  Status readObject(uint64_t ref, size_t depth, pt::ptree& tree, Kind& kind);
+
+  /// Read the children of an array into anonymous elements.
+  Status readArray(size_t offset, uint64_t count, size_t depth, pt::ptree& out);
+
+  /// Read the key and value references of a dictionary.
+  Status readDictionary(size_t offset,
+                        uint64_t count,
+                        size_t depth,
+                        pt::ptree& out);
+
+  /// Read the object count following a marker, moving the offset past it.
+  bool readCount(uint8_t info, size_t& offset, uint64_t& count) const;
+
+  /// Read a big endian unsigned integer of 1 to 8 bytes.
+  bool readUInt(size_t offset, size_t size, uint64_t& value) const;
+
+  /// Read the string object of a dictionary key.
+  bool readKey(uint64_t ref, std::string& key) const;
+
+  /// Read an ASCII, UTF-8 or UTF-16 string object.
+  bool readString(size_t offset, std::string& value) const;
+
+  bool objectOffset(uint64_t ref, size_t& offset) const;
+
+ private:
+  const std::string& data_;
+
+  size_t offset_size_{0};
+  size_t ref_size_{0};
+  uint64_t object_count_{0};
+  uint64_t offset_table_{0};
+};
+
+bool BinaryPlistReader::readUInt(size_t offset,
+                                 size_t size,
+                                 uint64_t& value) const {
+  if (size == 0 || size > 8 || offset > data_.size() ||
+      data_.size() - offset < size) {
+    return false;
+  }
+
+  value = 0;
+  for (size_t i = 0; i < size; ++i) {
+    value = (value << 8) | static_cast<uint8_t>(data_[offset + i]);
+  }
+  return true;
+}
+
+bool BinaryPlistReader::objectOffset(uint64_t ref, size_t& offset) const {
+  if (ref >= object_count_) {
+    return false;
+  }
+
+  uint64_t value = 0;
+  if (!readUInt(offset_table_ + ref * offset_size_, offset_size_, value) ||
+      value >= offset_table_) {
+    return false;
+  }
+  offset = static_cast<size_t>(value);
+  return true;
+}
+
+bool BinaryPlistReader::readCount(uint8_t info,
+                                  size_t& offset,
+                                  uint64_t& count) const {
+  offset++;
+  if (info != 0x0F) {
+    count = info;
+    return true;
+  }
+
+  // The count is an integer object following the marker.
+  if (offset >= data_.size()) {
+    return false;
+  }
+  auto marker = static_cast<uint8_t>(data_[offset]);
+  if ((marker & 0xF0) != 0x10 || (marker & 0x0F) > 3) {
+    return false;
+  }
+  size_t size = size_t{1} << (marker & 0x0F);
+  if (!readUInt(offset + 1, size, count)) {
+    return false;
+  }
+  offset += 1 + size;
+  return true;
+}
+
+bool BinaryPlistReader::readString(size_t offset, std::string& value) const {
+  auto marker = static_cast<uint8_t>(data_[offset]);
+  uint64_t count = 0;
+  if (!readCount(marker & 0x0F, offset, count)) {
+    return false;
+  }
+
+  switch (marker & 0xF0) {
+  case 0x50:
+  case 0x70:
+    if (count > data_.size() - offset) {
+      return false;
+    }
+    value.assign(data_, offset, static_cast<size_t>(count));
+    return true;
+  case 0x60: {
+    if (count > (data_.size() - offset) / 2) {
+      return false;
+    }
+    value.clear();
+    value.reserve(static_cast<size_t>(count));
+    for (uint64_t i = 0; i < count; ++i) {
+      auto at = offset + i * 2;
+      uint32_t unit = (static_cast<uint8_t>(data_[at]) << 8) |
+                      static_cast<uint8_t>(data_[at + 1]);
+      if (unit >= 0xD800 && unit < 0xDC00 && i + 1 < count) {
+        uint32_t low = (static_cast<uint8_t>(data_[at + 2]) << 8) |
+                       static_cast<uint8_t>(data_[at + 3]);
+        if (low >= 0xDC00 && low < 0xE000) {
+          unit = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+          ++i;
+        }
+      }
+      appendUtf8(value, unit);
+    }
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+bool BinaryPlistReader::readKey(uint64_t ref, std::string& key) const {
+  size_t offset = 0;
+  return objectOffset(ref, offset) && readString(offset, key);
+}
+
+Status BinaryPlistReader::readArray(size_t offset,
+                                    uint64_t count,
+                                    size_t depth,
+                                    pt::ptree& out) {
+  if (count > (data_.size() - offset) / ref_size_) {
+    return Status(1, "Invalid binary plist array");
+  }
+
+  for (uint64_t i = 0; i < count; ++i) {
+    uint64_t ref = 0;
+    readUInt(offset + i * ref_size_, ref_size_, ref);
+
+    pt::ptree child;
+    auto kind = Kind::Scalar;
+    auto status = readObject(ref, depth + 1, child, kind);
+    if (!status.ok()) {
+      return status;
+    }
+
+    if (kind == Kind::Array) {
+      // An array in an array is itself wrapped by an anonymous element.
+      pt::ptree wrapper;
+      wrapper.push_back(pt::ptree::value_type("", std::move(child)));
+      child = std::move(wrapper);
+    }
+    out.push_back(pt::ptree::value_type("", std::move(child)));
+  }
+  return Status::success();
+}
+
+Status BinaryPlistReader::readDictionary(size_t offset,
+                                         uint64_t count,
+                                         size_t depth,
+                                         pt::ptree& out) {
+  if (count > (data_.size() - offset) / ref_size_ / 2) {
+    return Status(1, "Invalid binary plist dictionary");
+  }
+
+  for (uint64_t i = 0; i < count; ++i) {
+    uint64_t key_ref = 0;
+    uint64_t value_ref = 0;
+    readUInt(offset + i * ref_size_, ref_size_, key_ref);
+    readUInt(offset + (count + i) * ref_size_, ref_size_, value_ref);
+
+    std::string key;
+    if (!readKey(key_ref, key)) {
+      // Unknown type as dictionary key, most likely a malformed plist.
+      continue;
+    }
+
+    pt::ptree child;
+    auto kind = Kind::Scalar;
+    auto status = readObject(value_ref, depth + 1, child, kind);
+    if (!status.ok()) {
+      return status;
+    }
+    putDictionaryValue(out, key, std::move(child));
+  }
+  return Status::success();
+}
+
+Status BinaryPlistReader::readObject(uint64_t ref,
+                                     size_t depth,
+                                     pt::ptree& tree,
+                                     Kind& kind) {
+  size_t offset = 0;
+  if (depth > kMaxPlistDepth || !objectOffset(ref, offset)) {
+    return Status(1, "Invalid binary plist object reference");
+  }
+
+  auto marker = static_cast<uint8_t>(data_[offset]);
+  auto info = static_cast<uint8_t>(marker & 0x0F);
+  kind = Kind::Scalar;
+  switch (marker & 0xF0) {
+  case 0x00:
+    if (marker == 0x08 || marker == 0x09) {
+      tree.put_value(marker == 0x09 ? "1" : "0");
+      return Status::success();
+    }
+    break;
+  case 0x10: {
+    if (info > 4) {
+      break;
+    }
+    // A 16 byte integer holds its value in the low 8 bytes.
+    size_t size = size_t{1} << info;
+    uint64_t value = 0;
+    if (!readUInt(offset + 1 + ((size > 8) ? 8 : 0),
+                  std::min<size_t>(size, 8),
+                  value)) {
+      break;
+    }
+    if (size == 8) {
+      tree.put_value(std::to_string(static_cast<int64_t>(value)));
+    } else {
+      tree.put_value(std::to_string(value));
+    }
+    return Status::success();
+  }
+  case 0x20:
+  case 0x30: {
+    bool is_date = ((marker & 0xF0) == 0x30);
+    if ((is_date && info != 3) || (!is_date && info != 2 && info != 3)) {
+      break;
+    }
+    uint64_t bits = 0;
+    if (!readUInt(offset + 1, size_t{1} << info, bits)) {
+      break;
+    }
+    if (info == 2) {
+      float value = 0;
+      auto bits32 = static_cast<uint32_t>(bits);
+      memcpy(&value, &bits32, sizeof(value));
+      tree.put_value(formatFloat(value));
+    } else {
+      double value = 0;
+      memcpy(&value, &bits, sizeof(value));
+      if (is_date) {
+        value += kCFAbsoluteTimeIntervalSince1970;
+      }
+      tree.put_value(formatDouble(value));
+    }
+    return Status::success();
+  }
+  case 0x40: {
+    uint64_t count = 0;
+    if (!readCount(info, offset, count) || count > data_.size() - offset) {
+      break;
+    }
+    kind = Kind::Data;
+    tree.put_value(
+        base64::encode(data_.substr(offset, static_cast<size_t>(count))));
+    return Status::success();
+  }
+  case 0x50:
+  case 0x60:
+  case 0x70: {
+    std::string value;
+    if (!readString(offset, value)) {
+      break;
+    }
+    tree.put_value(value);
+    return Status::success();
+  }
+  case 0x80:
+    // Keyed archiver UIDs are not a filtered type.
+    tree.put_value("");
+    return Status::success();
+  case 0xA0: {
+    uint64_t count = 0;
+    if (!readCount(info, offset, count)) {
+      break;
+    }
+    kind = Kind::Array;
+    return readArray(offset, count, depth, tree);
+  }
+  case 0xD0: {
+    uint64_t count = 0;
+    if (!readCount(info, offset, count)) {
+      break;
+    }
+    kind = Kind::Dictionary;
+    return readDictionary(offset, count, depth, tree);
+  }
+  default:
+    break;
+  }
+  return Status(1, "Unsupported binary plist object");
+}
+
+Status BinaryPlistReader::parse(pt::ptree& tree) {
+  if (data_.size() < kBinaryPlistHeaderSize + kBinaryPlistTrailerSize ||
+      data_.compare(0, kBinaryPlistHeaderSize, "bplist00") != 0) {
+    return Status(1, "Not a binary plist");
+  }
+
+  auto trailer = data_.size() - kBinaryPlistTrailerSize;
+  offset_size_ = static_cast<uint8_t>(data_[trailer + 6]);
+  ref_size_ = static_cast<uint8_t>(data_[trailer + 7]);
+  uint64_t top = 0;
+  readUInt(trailer + 8, 8, object_count_);
+  readUInt(trailer + 16, 8, top);
+  readUInt(trailer + 24, 8, offset_table_);
+
+  if (offset_size_ == 0 || offset_size_ > 8 || ref_size_ == 0 ||
+      ref_size_ > 8 || offset_table_ < kBinaryPlistHeaderSize ||
+      offset_table_ > trailer ||
+      object_count_ > (trailer - offset_table_) / offset_size_) {
+    return Status(1, "Invalid binary plist trailer");
+  }
+
+  pt::ptree object;
+  auto kind = Kind::Scalar;
+  auto status = readObject(top, 0, object, kind);
+  if (!status.ok()) {
+    return status;
+  }
+
+  if (kind == Kind::Dictionary) {
+    tree = std::move(object);
+  } else if (kind == Kind::Array) {
+    tree.push_back(pt::ptree::value_type("root", std::move(object)));
+  } else if (kind == Kind::Data) {
+    tree.push_back(pt::ptree::value_type("data", std::move(object)));
+  } else {
+    return Status(1, "Unexpected plist type");
+  }
+  return Status::success();
+}
+
+/// Convert an ISO 8601 date of an XML property list to Unix seconds.
+bool parseXmlDate(const std::string& text, double& value) {
+  struct tm tm = {};
+  int count = sscanf(text.c_str(),
+                     "%4d-%2d-%2dT%2d:%2d:%2dZ",
+                     &tm.tm_year,
+                     &tm.tm_mon,
+                     &tm.tm_mday,
+                     &tm.tm_hour,
+                     &tm.tm_min,
+                     &tm.tm_sec);
+  if (count != 6) {
+    return false;
+  }
+  tm.tm_year -= 1900;
+  tm.tm_mon -= 1;
+  value = static_cast<double>(timegm(&tm));
+  return true;
+}
+
+Status convertXmlElement(const std::string& name,
+                         const pt::ptree& element,
+                         size_t depth,
+                         pt::ptree& out,
+                         bool& is_array);
+
+/// Convert the children of an XML array element.
+Status convertXmlArray(const pt::ptree& element, size_t depth, pt::ptree& out) {
+  for (const auto& child : element) {
+    if (child.first.compare(0, 4, "<xml") == 0) {
+      continue;
+    }
+
+    pt::ptree value;
+    bool is_array = false;
+    auto status = convertXmlElement(
+        child.first, child.second, depth + 1, value, is_array);
+    if (!status.ok()) {
+      return status;
+    }
+    if (is_array) {
+      pt::ptree wrapper;
+      wrapper.push_back(pt::ptree::value_type("", std::move(value)));
+      value = std::move(wrapper);
+    }
+    out.push_back(pt::ptree::value_type("", std::move(value)));
+  }
+  return Status::success();
+}
+
+/// Convert the key and value children of an XML dict element.
+Status convertXmlDictionary(const pt::ptree& element,
+                            size_t depth,
+                            pt::ptree& out) {
+  const std::string* key = nullptr;
+  for (const auto& child : element) {
+    if (child.first.compare(0, 4, "<xml") == 0) {
+      continue;
+    }
+
+    if (child.first == "key") {
+      key = &child.second.data();
+      continue;
+    }
+    if (key == nullptr) {
+      return Status(1, "Plist dictionary value without a key");
+    }
+
+    pt::ptree value;
+    bool is_array = false;
+    auto status = convertXmlElement(
+        child.first, child.second, depth + 1, value, is_array);
+    if (!status.ok()) {
+      return status;
+    }
+    putDictionaryValue(out, *key, std::move(value));
+    key = nullptr;
+  }
+  return Status::success();
+}
+
+Status convertXmlElement(const std::string& name,
+                         const pt::ptree& element,
+                         size_t depth,
+                         pt::ptree& out,
+                         bool& is_array) {
+  if (depth > kMaxPlistDepth) {
+    return Status(1, "Plist is nested too deeply");
+  }
+
+  is_array = false;
+  const auto& text = element.data();
+  if (name == "string") {
+    out.put_value(text);
+  } else if (name == "true" || name == "false") {
+    out.put_value(name == "true" ? "1" : "0");
+  } else if (name == "integer") {
+    // Integers are decimal, or hexadecimal with a 0x prefix.
+    bool negative = (!text.empty() && text[0] == '-');
+    auto digits = text.c_str() + (negative ? 1 : 0);
+    int base = (strncmp(digits, "0x", 2) == 0 || strncmp(digits, "0X", 2) == 0)
+                   ? 16
+                   : 10;
+    char* end = nullptr;
+    errno = 0;
+    if (negative) {
+      auto value = strtoll(text.c_str(), &end, base);
+      out.put_value(std::to_string(value));
+    } else {
+      auto value = strtoull(text.c_str(), &end, base);
+      out.put_value(std::to_string(value));
+    }
+    if (errno != 0 || end == text.c_str() || *end != '\0') {
+      return Status(1, "Invalid plist integer");
+    }
+  } else if (name == "real") {
+    char* end = nullptr;
+    auto value = strtod(text.c_str(), &end);
+    if (end == text.c_str() || *end != '\0') {
+      return Status(1, "Invalid plist real");
+    }
+    out.put_value(formatDouble(value));
+  } else if (name == "date") {
+    double value = 0;
+    if (!parseXmlDate(text, value)) {
+      return Status(1, "Invalid plist date");
+    }
+    out.put_value(formatDouble(value));
+  } else if (name == "data") {
+    std::string encoded;
+    encoded.reserve(text.size());
+    for (auto c : text) {
+      if (!isspace(static_cast<unsigned char>(c))) {
+        encoded += c;
+      }
+    }
+    out.put_value(base64::encode(base64::decode(encoded)));
+  } else if (name == "array") {
+    is_array = true;
+    return convertXmlArray(element, depth, out);
+  } else if (name == "dict") {
+    return convertXmlDictionary(element, depth, out);
+  } else {
+    return Status(1, "Unsupported plist element: " + name);
+  }
+  return Status::success();
+}
+
+Status parseXmlPlist(const std::string& content, pt::ptree& tree) {
+  pt::ptree document;
+  try {
+    std::stringstream stream(content);
+    pt::read_xml(stream, document, pt::xml_parser::no_comments);
+  } catch (const pt::xml_parser::xml_parser_error& e) {
+    return Status(1, std::string("Invalid XML plist: ") + e.what());
+  }
+
+  auto plist = document.find("plist");
+  if (plist == document.not_found()) {
+    return Status(1, "Not an XML plist");
+  }
+
+  // The plist element has a single top object.
+  for (const auto& child : plist->second) {
+    if (child.first.compare(0, 4, "<xml") == 0) {
+      continue;
+    }
+
+    pt::ptree object;
+    bool is_array = false;
+    auto status =
+        convertXmlElement(child.first, child.second, 0, object, is_array);
+    if (!status.ok()) {
+      return status;
+    }
+
+    if (child.first == "dict") {
+      tree = std::move(object);
+    } else if (is_array) {
+      tree.push_back(pt::ptree::value_type("root", std::move(object)));
+    } else if (child.first == "data") {
+      tree.push_back(pt::ptree::value_type("data", std::move(object)));
+    } else {
+      return Status(1, "Unexpected plist type");
+    }
+    return Status::success();
+  }
+  return Status(1, "Empty XML plist");
+}
+
+} // namespace
+
+Status parsePlistContentNative(const std::string& content,
+                               pt::ptree& tree) {
+  tree.clear();
+  if (content.compare(0, 6, "bplist") == 0) {
+    auto status = BinaryPlistReader(content).parse(tree);
+    if (!status.ok()) {
+      tree.clear();
+    }
+    return status;
+  }
+
+  // Skip a byte order mark and leading whitespace to find an XML document.
+  size_t start = (content.compare(0, 3, "\xEF\xBB\xBF") == 0) ? 3 : 0;
+  while (start < content.size() &&
+         isspace(static_cast<unsigned char>(content[start]))) {
+    start++;
+  }
+  if (content.compare(start, 1, "<") != 0) {
+    return Status(1, "Not a binary or XML plist");
+  }
+
+  auto status = parseXmlPlist(content, tree);
+  if (!status.ok()) {
+    tree.clear();
+  }
+  return status;
+}
+
+} // namespace osquery
@@ -133,6 +133,40 @@ void JSON::addRef(const std::string& key, const std::string& value) {
   addRef(key, value, doc());
 }
 
+void JSON::appendRef(const std::string& key,
+                     const std::string& value,
+                     rj::Value& obj) {
+  assert(obj.IsObject());
+  obj.AddMember(rj::Value(rj::StringRef(key), doc_.GetAllocator()).Move(),
+                rj::Value(rj::StringRef(value), doc_.GetAllocator()).Move(),
+                doc_.GetAllocator());
+}
+
+void JSON::appendCopy(const std::string& key,
+                      const std::string& value,
+                      rj::Value& obj) {
+  assert(obj.IsObject());
+  rj::Value sc;
+  sc.SetString(value.c_str(), value.size(), doc_.GetAllocator());
+  obj.AddMember(rj::Value(rj::StringRef(key), doc_.GetAllocator()).Move(),
+                sc.Move(),
+                doc_.GetAllocator());
+}
+
+void JSON::append(const std::string& key, long long value, rj::Value& obj) {
+  assert(obj.IsObject());
+  obj.AddMember(rj::Value(rj::StringRef(key), doc_.GetAllocator()).Move(),
+                rj::Value(static_cast<int64_t>(value)).Move(),
+                doc_.GetAllocator());
+}
+
+void JSON::append(const std::string& key, double value, rj::Value& obj) {
+  assert(obj.IsObject());
+  obj.AddMember(rj::Value(rj::StringRef(key), doc_.GetAllocator()).Move(),
+                rj::Value(value).Move(),
+                doc_.GetAllocator());
+}
+
 void JSON::add(const std::string& key, const std::string& value) {
   addCopy(key, value);
 }
@@ -298,6 +332,21 @@ Status JSON::toPrettyString(std::string& str, size_t indentCharCount) const {
   return Status::success();
 }
 
+namespace {
+
+Status getParseStatus(const rj::ParseResult& pr) {
+  if (!pr) {
+    std::string message{"Cannot parse JSON: "};
+    message += GetParseError_En(pr.Code());
+    message += " Offset: ";
+    message += std::to_string(pr.Offset());
+    return Status(1, message);
+  }
+  return Status::success();
+}
+
+} // namespace
+
 Status JSON::fromString(const std::string& str, ParseMode mode) {
   rj::ParseResult pr;
   switch (mode) {
@@ -310,15 +359,12 @@ Status JSON::fromString(const std::string& str, ParseMode mode) {
     break;
   }
   }
+  return getParseStatus(pr);
+}
 
-  if (!pr) {
-    std::string message{"Cannot parse JSON: "};
-    message += GetParseError_En(pr.Code());
-    message += " Offset: ";
-    message += std::to_string(pr.Offset());
-    return Status(1, message);
-  }
-  return Status::success();
+Status JSON::fromStringInsitu(std::string& str) {
+  rj::ParseResult pr = doc_.ParseInsitu<rj::kParseIterativeFlag>(&str[0]);
+  return getParseStatus(pr);
 }
 
 void JSON::mergeObject(rj::Value& target_obj, rj::Value& source_obj) {
@@ -377,6 +423,13 @@ std::uint64_t JSON::valueToSize(const rj::Value& value) {
   return 0_sz;
 }
 
+std::string JSON::valueToString(const rj::Value& value) {
+  rj::StringBuffer sb;
+  rj::Writer<rj::StringBuffer> writer(sb);
+  value.Accept(writer);
+  return std::string(sb.GetString(), sb.GetSize());
+}
+
 bool JSON::valueToBool(const rj::Value& value) {
   if (value.IsBool()) {
     return value.GetBool();
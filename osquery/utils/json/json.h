@@ -135,6 +135,43 @@ class JSON : private only_movable {
    */
   void addRef(const std::string& key, const std::string& value);
 
+  /**
+   * @brief Append a string value to a JSON object by referencing the contents.
+   *
+   * The key and value must live longer than the document's use.
+   *
+   * Unlike addRef the object is not searched for an existing key, the caller
+   * guarantees the key is not in the object yet. Use this when adding the
+   * columns of a row, which are unique, to keep it linear in the columns.
+   * The input document must be an object type.
+   */
+  void appendRef(const std::string& key,
+                 const std::string& value,
+                 rapidjson::Value& obj);
+
+  /**
+   * @brief Append a string value to a JSON object by copying the contents.
+   *
+   * The key must live longer than the document's use and not be in the object.
+   */
+  void appendCopy(const std::string& key,
+                  const std::string& value,
+                  rapidjson::Value& obj);
+
+  /**
+   * @brief Append a long long value to a JSON object, like appendRef.
+   *
+   * The key must live longer than the document's use and not be in the object.
+   */
+  void append(const std::string& key, long long value, rapidjson::Value& obj);
+
+  /**
+   * @brief Append a double value to a JSON object, like appendRef.
+   *
+   * The key must live longer than the document's use and not be in the object.
+   */
+  void append(const std::string& key, double value, rapidjson::Value& obj);
+
   /**
    * @brief Add a string value to a JSON object by copying the contents.
    *
@@ -356,6 +393,14 @@ class JSON : private only_movable {
   Status fromString(const std::string& str,
                     ParseMode parse_mode = ParseMode::Recursive);
 
+  /**
+   * @brief Convert a string into JSON, parsing it in place.
+   *
+   * The document strings are not copied, they point into the string, which
+   * is modified and must outlive the document.
+   */
+  Status fromStringInsitu(std::string& str);
+
   /// Merge members of source into target, must both be objects.
   void mergeObject(rapidjson::Value& target_obj, rapidjson::Value& source_obj);
 
@@ -371,6 +416,9 @@ class JSON : private only_movable {
   /// Get the value as a 'size' or 0.
   static std::uint64_t valueToSize(const rapidjson::Value& value);
 
+  /// Convert a value to a JSON string, without copying it to a document.
+  static std::string valueToString(const rapidjson::Value& value);
+
   /// Get the value as a 'bool' or false.
   static bool valueToBool(const rapidjson::Value& value);
 
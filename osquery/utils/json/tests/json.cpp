@@ -99,6 +99,24 @@ TEST_F(ConversionsTests, test_json_from_string) {
   EXPECT_FALSE(doc.fromString(json).ok());
 }
 
+TEST_F(ConversionsTests, test_json_from_string_insitu) {
+  std::string json = "{\"key\":\"value\",\"key2\":{\"key3\":3}}";
+  auto expected = json;
+  auto buffer = json;
+  auto doc = JSON::newObject();
+  ASSERT_TRUE(doc.fromStringInsitu(buffer).ok());
+
+  // The strings of the document point into the buffer.
+  const auto& value = doc.doc()["key"];
+  EXPECT_GE(value.GetString(), buffer.data());
+  EXPECT_LT(value.GetString(), buffer.data() + buffer.size());
+  EXPECT_EQ(expected, JSON::valueToString(doc.doc()));
+  EXPECT_EQ("{\"key3\":3}", JSON::valueToString(doc.doc()["key2"]));
+
+  buffer = json + ";";
+  EXPECT_FALSE(doc.fromStringInsitu(buffer).ok());
+}
+
 TEST_F(ConversionsTests, test_json_from_string_error) {
   std::string json = "{\"key\":\"value\",\"key2\":{\"key3\":'error'}}";
   auto doc = JSON::newObject();
@@ -182,6 +200,23 @@ TEST_F(ConversionsTests, test_json_duplicate_keys) {
   EXPECT_EQ(expected, result);
 }
 
+TEST_F(ConversionsTests, test_json_append) {
+  auto doc = JSON::newObject();
+
+  std::string value("value");
+  doc.appendRef("key", value, doc.doc());
+  doc.appendCopy("key2", "value2", doc.doc());
+  doc.append("key3", 3LL, doc.doc());
+  doc.append("key4", 4.5, doc.doc());
+
+  std::string result;
+  EXPECT_TRUE(doc.toString(result));
+
+  std::string expected =
+      "{\"key\":\"value\",\"key2\":\"value2\",\"key3\":3,\"key4\":4.5}";
+  EXPECT_EQ(expected, result);
+}
+
 TEST_F(ConversionsTests, test_json_merge_object) {
   auto doc1 = JSON::newObject();
 
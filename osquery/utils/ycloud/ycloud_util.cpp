@@ -10,6 +10,8 @@
 // Keep this included first (See #6507).
 #include <osquery/remote/http_client.h>
 
+#include <chrono>
+
 #include <boost/algorithm/string.hpp>
 #include <osquery/core/core.h>
 #include <osquery/logger/logger.h>
@@ -26,6 +28,9 @@ const std::string kYCloudMetadataPathAndQuery =
 const std::string kAttributes = "attributes";
 const int kYCloudMetadataTimeout = 3;
 
+/// The metadata of each endpoint is reused by the queries within 5 minutes.
+const std::chrono::seconds kYCloudMetadataCacheTime{300};
+
 std::tuple<std::string, std::string> getFolderIdAndZoneFromZoneField(
     const std::string& zone) {
   if (boost::algorithm::starts_with(zone, "projects/")) {
@@ -95,28 +100,42 @@ std::string getYCloudKey(JSON& doc, const std::string& key) {
 }
 
 Status fetchYCloudMetadata(JSON& doc, const std::string& endpoint) {
-  http::Request request(endpoint + kYCloudMetadataPathAndQuery);
-  http::Client::Options opts;
-  http::Response response;
-
-  opts.timeout(kYCloudMetadataTimeout);
-  http::Client client(opts);
-
-  request << http::Request::Header("Metadata-Flavor", "Google");
-
-  try {
-    response = client.get(request);
-  } catch (const std::system_error& e) {
-    return Status(1, "Couldn't request " + endpoint + ": " + e.what());
-  }
-
-  if (response.result_int() != 200) {
-    return Status(1,
-                  "YCloud metadata service responded with " +
-                      std::to_string(response.result_int()));
+  auto url = endpoint + kYCloudMetadataPathAndQuery;
+  std::string body;
+  auto status = http::InstanceMetadataCache::get().fetch(
+      url,
+      [&url, &endpoint](std::string& response_body) {
+        http::Request request(url);
+        http::Client::Options opts;
+        http::Response response;
+
+        opts.timeout(kYCloudMetadataTimeout);
+        http::Client client(opts);
+
+        request << http::Request::Header("Metadata-Flavor", "Google");
+
+        try {
+          response = client.get(request);
+        } catch (const std::system_error& e) {
+          return Status(1, "Couldn't request " + endpoint + ": " + e.what());
+        }
+
+        if (response.result_int() != 200) {
+          return Status(1,
+                        "YCloud metadata service responded with " +
+                            std::to_string(response.result_int()));
+        }
+
+        response_body = response.body();
+        return Status::success();
+      },
+      body,
+      kYCloudMetadataCacheTime);
+  if (!status.ok()) {
+    return status;
   }
 
-  auto s = doc.fromString(response.body());
+  auto s = doc.fromString(body);
   if (!s.ok()) {
     return s;
   }
@@ -14,6 +14,7 @@
 #include <unordered_map>
 
 #include <osquery/core/sql/query_data.h>
+#include <osquery/worker/ipc/table_ipc_binary_converter.h>
 #include <osquery/worker/ipc/table_ipc_json_converter.h>
 
 #include <osquery/worker/logging/glog_logger_types.h>
@@ -42,6 +43,39 @@ class TableIPCBase {
     return static_cast<Derived&>(*this).sendJSONString(json_string);
   }
 
+  /**
+   * @brief Send rows as binary batches instead of a JSON message.
+   *
+   * A batch is sent as soon as it reaches the maximum batch size, so the
+   * receiver decodes the rows while the rest are encoded. The channel carries
+   * the batches as it carries JSON strings.
+   */
+  Status sendQueryDataBatches(const QueryData& query_data) {
+    std::string message;
+    TableIPCBinaryConverter::beginQueryDataBatch(message);
+
+    for (const auto& row : query_data) {
+      auto status = TableIPCBinaryConverter::addRowToBatch(row, message);
+
+      if (!status.ok()) {
+        return status;
+      }
+
+      if (message.size() >= TableIPCBinaryConverter::kMaxQueryDataBatchSize) {
+        status = static_cast<Derived&>(*this).sendJSONString(message);
+
+        if (!status.ok()) {
+          return status;
+        }
+
+        TableIPCBinaryConverter::beginQueryDataBatch(message);
+      }
+    }
+
+    TableIPCBinaryConverter::setLastQueryDataBatch(message);
+    return static_cast<Derived&>(*this).sendJSONString(message);
+  }
+
   Status sendLogMessage(int severity,
                         GLOGLogType log_type,
                         const std::string& message) {
@@ -88,7 +122,13 @@ class TableIPCBase {
       return status;
     }
 
-    status = json_message.fromString(json_string);
+    return parseJSONMessage(json_string, json_message, message_type);
+  }
+
+  Status parseJSONMessage(const std::string& json_string,
+                          JSON& json_message,
+                          JSONMessageType& message_type) {
+    auto status = json_message.fromString(json_string);
 
     if (!status.ok()) {
       return status;
@@ -104,8 +144,28 @@ class TableIPCBase {
 
   Status processOneMessage(QueryData* query_results,
                            JSONMessageType& message_type) {
+    std::string message;
+    auto status = static_cast<Derived&>(*this).recvJSONString(message);
+
+    if (!status.ok()) {
+      return status;
+    }
+
+    if (TableIPCBinaryConverter::isQueryDataBatch(message)) {
+      if (!query_results) {
+        return Status::failure(1, "Received unexpected QueryData message");
+      }
+
+      bool last = false;
+      status = TableIPCBinaryConverter::binaryToQueryData(
+          message, *query_results, last);
+      message_type =
+          last ? JSONMessageType::QueryData : JSONMessageType::QueryDataBatch;
+      return status;
+    }
+
     JSON json_message;
-    Status status = recvJSONMessage(json_message, message_type);
+    status = parseJSONMessage(message, json_message, message_type);
 
     if (!status.ok()) {
       return status;
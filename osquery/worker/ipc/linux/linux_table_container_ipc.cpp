@@ -17,9 +17,15 @@
 #include <syslog.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
+#include <condition_variable>
 #include <cstdlib>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
 
 #include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
@@ -39,6 +45,17 @@ CLI_FLAG(bool,
          "Keep the container worker running to be reused instead of closing it "
          "after each query");
 
+CLI_FLAG(uint32,
+         container_workers_max,
+         8,
+         "Maximum number of container workers running at once, one per table");
+
+CLI_FLAG(uint32,
+         container_worker_idle_timeout,
+         300,
+         "Seconds a kept open container worker waits for a query before "
+         "exiting (0 waits forever)");
+
 namespace {
 
 const std::string kProc = "/proc";
@@ -53,8 +70,6 @@ const std::string kMountNamespace = "/ns/mnt";
  */
 const int kMaxNamespaceIdLinkChars = 16;
 
-PlatformProcess current_running_process;
-
 Status extractMountNamespaceId(const std::string& mount_namespace_path,
                                std::string& mount_namespace_id) {
   std::string mnt_namespace_id_source(kMaxNamespaceIdLinkChars, 0);
@@ -145,6 +160,7 @@ Status LinuxTableContainerIPC::connectToContainer(
     bool keep_process_open,
     TableGeneratePtr function_ptr) {
   keep_process_open_ = keep_process_open;
+  table_name_ = table_name;
 
   auto current_pid = getpid();
   std::string original_mnt_path =
@@ -164,12 +180,6 @@ Status LinuxTableContainerIPC::connectToContainer(
   bool is_open = ipc_.setActiveChannelIfOpen(table_name);
 
   if (!is_open) {
-    // This will stop any worker connected to another table,
-    // so that we only have one open each time
-    if (keep_process_open_) {
-      stopContainerWorker();
-    }
-
     PipeChannelTicket channel_ticket = ipc_.createChannelTicket();
 
     auto process_group = getpgrp();
@@ -185,6 +195,7 @@ Status LinuxTableContainerIPC::connectToContainer(
       }
 
       try {
+        ipc_.closeInheritedChannels();
         ipc_.connectToParent(table_name, std::move(channel_ticket));
       } catch (const std::exception& e) {
         syslog(LOG_NOTICE, "Failed to connect to parent: %s", e.what());
@@ -196,7 +207,7 @@ Status LinuxTableContainerIPC::connectToContainer(
       return Status::failure("Failed to start container worker to table " +
                              table_name);
     } else {
-      current_running_process = PlatformProcess(pid);
+      worker_process_ = PlatformProcess(pid);
       ipc_.connectToChild(table_name, std::move(channel_ticket), pid);
     }
   }
@@ -204,19 +215,17 @@ Status LinuxTableContainerIPC::connectToContainer(
   return Status::success();
 }
 void LinuxTableContainerIPC::stopContainerWorker() {
-  PlatformProcess child_process(std::move(current_running_process));
+  PlatformProcess child_process(std::move(worker_process_));
+  std::string table_name = table_name_;
+
+  if (ipc_.setActiveChannelIfOpen(table_name)) {
+    ipc_.closeActiveChannel();
+  }
 
   if (child_process.pid() == kInvalidPid) {
     return;
   }
 
-  std::string table_name = ipc_.isChannelOpen()
-                               ? ipc_.getTableName()
-                               : ipc_.getTableNameFromPid(child_process.pid());
-
-  ipc_.setActiveChannelIfOpen(table_name);
-  ipc_.closeActiveChannel();
-
   ProcessState process_state =
       checkProcessStateAndLog(child_process, table_name);
 
@@ -257,6 +266,21 @@ void LinuxTableContainerIPC::stopContainerWorker() {
   }
 }
 
+bool LinuxTableContainerIPC::isWorkerRunning() {
+  if (worker_process_.pid() == kInvalidPid) {
+    return false;
+  }
+
+  auto process_state = checkProcessStateAndLog(worker_process_, table_name_);
+  if (process_state == ProcessState::PROCESS_STILL_ALIVE) {
+    return true;
+  }
+
+  // An exited worker was reaped while checking it.
+  worker_process_ = PlatformProcess();
+  return false;
+}
+
 Status LinuxTableContainerIPC::handleLog(GLOGLogType log_type,
                                          int priority,
                                          const std::string& message) {
@@ -342,7 +366,7 @@ Status LinuxTableContainerIPC::handleJob(QueryContext& context) {
     So after delivering the results, we return with an error so
     that the process will be always closed.
   */
-  auto write_status = ipc_.sendQueryData(query_data);
+  auto write_status = ipc_.sendQueryDataBatches(query_data);
 
   if (keep_process_open_) {
     int result = static_cast<int>(syscall(SYS_setns, original_mnt_fd_, 0));
@@ -362,7 +386,19 @@ Status LinuxTableContainerIPC::handleJob(QueryContext& context) {
 void LinuxTableContainerIPC::executeQueryJobs() {
   int exit_status_code = 0;
   if (keep_process_open_) {
+    auto idle_timeout_ms =
+        (FLAGS_container_worker_idle_timeout > 0)
+            ? static_cast<int>(std::min<std::uint64_t>(
+                  FLAGS_container_worker_idle_timeout * 1000ULL,
+                  std::numeric_limits<int>::max()))
+            : -1;
+
     while (true) {
+      // An idle worker exits, the parent starts a new one when needed.
+      if (!ipc_.waitForMessage(idle_timeout_ms)) {
+        break;
+      }
+
       JSONMessageType message_type;
       auto status = ipc_.processOneMessage(nullptr, message_type);
 
@@ -393,7 +429,6 @@ void LinuxTableContainerIPC::executeQueryJobs() {
 
 Status LinuxTableContainerIPC::retrieveQueryDataFromContainer(
     const QueryContext& context, QueryData& result) {
-  CleanupWorkerOnError cleanupOnError(*this);
   auto status = ipc_.sendJob(context);
 
   if (!status.ok()) {
@@ -413,22 +448,153 @@ Status LinuxTableContainerIPC::retrieveQueryDataFromContainer(
     }
   }
 
-  cleanupOnError.dismiss();
   return status;
 }
 
+namespace {
+
+/**
+ * @brief The container workers, at most one per table.
+ *
+ * A worker serves one query at a time. Kept open workers are reused by the
+ * next queries of their table, until they exit once idle or are stopped to
+ * make room for the worker of another table. When all the workers are busy,
+ * queries wait for one to be released.
+ */
+class ContainerWorkerPool final {
+ public:
+  /**
+   * @brief Wait for the worker of a table, starting it if needed.
+   *
+   * @param reused Set if the worker ran a previous query.
+   */
+  Status acquire(const std::string& table_name,
+                 TableGeneratePtr generate_ptr,
+                 LinuxTableContainerIPC*& container_ipc,
+                 bool& reused) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      auto it = workers_.find(table_name);
+      if (it != workers_.end()) {
+        if (it->second.busy) {
+          released_.wait(lock);
+          continue;
+        }
+
+        if (!it->second.container_ipc->isWorkerRunning()) {
+          it->second.container_ipc->stopContainerWorker();
+          workers_.erase(it);
+          continue;
+        }
+
+        it->second.busy = true;
+        container_ipc = it->second.container_ipc.get();
+        reused = true;
+        return Status::success();
+      }
+
+      auto max_workers = std::max(FLAGS_container_workers_max, 1U);
+      if (workers_.size() >= max_workers && !stopLeastRecentlyUsed()) {
+        released_.wait(lock);
+        continue;
+      }
+
+      break;
+    }
+
+    // Workers are forked while no other worker is started or stopped.
+    auto& worker = workers_[table_name];
+    worker.container_ipc = std::make_unique<LinuxTableContainerIPC>(factory_);
+    worker.busy = true;
+
+    Status status;
+    try {
+      status = worker.container_ipc->connectToContainer(
+          table_name, FLAGS_keep_container_worker_open, generate_ptr);
+    } catch (const std::exception& e) {
+      status = Status::failure(e.what());
+    }
+
+    if (!status.ok()) {
+      worker.container_ipc->stopContainerWorker();
+      workers_.erase(table_name);
+      released_.notify_all();
+      return status;
+    }
+
+    container_ipc = worker.container_ipc.get();
+    reused = false;
+    return Status::success();
+  }
+
+  /// Release the worker of a table, stopping it if it is not kept open.
+  void release(const std::string& table_name, bool stop) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = workers_.find(table_name);
+    if (it != workers_.end()) {
+      if (stop) {
+        it->second.container_ipc->stopContainerWorker();
+        workers_.erase(it);
+      } else {
+        it->second.busy = false;
+        it->second.last_used = std::chrono::steady_clock::now();
+      }
+    }
+
+    released_.notify_all();
+  }
+
+ private:
+  /// Stop the idle worker released the longest ago, false if all are busy.
+  bool stopLeastRecentlyUsed() {
+    auto oldest = workers_.end();
+    for (auto it = workers_.begin(); it != workers_.end(); ++it) {
+      if (!it->second.busy &&
+          (oldest == workers_.end() ||
+           it->second.last_used < oldest->second.last_used)) {
+        oldest = it;
+      }
+    }
+
+    if (oldest == workers_.end()) {
+      return false;
+    }
+
+    oldest->second.container_ipc->stopContainerWorker();
+    workers_.erase(oldest);
+    return true;
+  }
+
+ private:
+  struct Worker {
+    std::unique_ptr<LinuxTableContainerIPC> container_ipc;
+    bool busy{false};
+    std::chrono::steady_clock::time_point last_used;
+  };
+
+  PipeChannelFactory factory_;
+  std::map<std::string, Worker> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable released_;
+};
+} // namespace
+
 QueryData generateInNamespace(const QueryContext& context,
                               const std::string& table_name,
                               TableGeneratePtr generate_ptr) {
   bool keep_container_worker_open = FLAGS_keep_container_worker_open;
   QueryData results;
 
-  static PipeChannelFactory factory;
+  static ContainerWorkerPool pool;
 
-  try {
-    LinuxTableContainerIPC ipc(factory);
-    auto status = ipc.connectToContainer(
-        table_name, keep_container_worker_open, generate_ptr);
+  // A reused worker may have exited while idle, the query is then run once
+  // more by a new worker.
+  bool reused = true;
+  while (reused) {
+    LinuxTableContainerIPC* container_ipc = nullptr;
+    auto status =
+        pool.acquire(table_name, generate_ptr, container_ipc, reused);
 
     if (!status.ok()) {
       LOG(ERROR) << "Table " << table_name
@@ -437,19 +603,24 @@ QueryData generateInNamespace(const QueryContext& context,
       return results;
     }
 
-    status = ipc.retrieveQueryDataFromContainer(context, results);
+    results.clear();
+    try {
+      status = container_ipc->retrieveQueryDataFromContainer(context, results);
+    } catch (const std::exception& e) {
+      status = Status::failure(e.what());
+    }
 
-    if (!status.ok()) {
+    pool.release(table_name, !status.ok() || !keep_container_worker_open);
+
+    if (status.ok()) {
+      break;
+    }
+
+    if (!reused) {
       LOG(ERROR) << "Table " << table_name
                  << " failed to retrieve QueryData from the container: "
                  << status.getMessage();
     }
-
-    if (!keep_container_worker_open)
-      ipc.stopContainerWorker();
-  } catch (const std::exception& e) {
-    LOG(ERROR) << "Table " << table_name
-               << " failed to run query in the container: " << e.what();
   }
 
   return results;
@@ -41,11 +41,15 @@ class LinuxTableContainerIPC : TableIPCMessageHandler {
   Status connectToContainer(const std::string& table_name,
                             bool keep_process_open,
                             TableGeneratePtr table_generate_ptr_);
+  /// Run a query in the worker, the caller stops the worker on failure.
   Status retrieveQueryDataFromContainer(const QueryContext& context,
                                         QueryData& result);
   [[noreturn]] void executeQueryJobs();
   void stopContainerWorker();
 
+  /// Check if the worker is still running, forgetting it once it exited.
+  bool isWorkerRunning();
+
   Status handleLog(GLOGLogType log_type,
                    int priority,
                    const std::string& message) override;
@@ -55,28 +59,11 @@ class LinuxTableContainerIPC : TableIPCMessageHandler {
   LinuxTableIPC ipc_;
   LinuxTableIPCLogger logger_{ipc_};
   TableGeneratePtr table_generate_ptr_;
+  std::string table_name_;
+  PlatformProcess worker_process_;
   bool keep_process_open_{false};
   int original_mnt_fd_{-1};
 
-  class CleanupWorkerOnError {
-   public:
-    CleanupWorkerOnError() = delete;
-    CleanupWorkerOnError(LinuxTableContainerIPC& container_ipc)
-        : container_ipc_(&container_ipc) {}
-    ~CleanupWorkerOnError() {
-      if (cleanup_)
-        container_ipc_->stopContainerWorker();
-    }
-
-    void dismiss() {
-      cleanup_ = false;
-    }
-
-   private:
-    LinuxTableContainerIPC* container_ipc_;
-    bool cleanup_{true};
-  };
-
   FRIEND_TEST(WorkerTableContainerTests, test_ipc_container_connect);
 };
 
@@ -107,6 +107,19 @@ void LinuxTableIPC::closeActiveChannel() {
   active_channel_ = nullptr;
 }
 
+void LinuxTableIPC::closeInheritedChannels() {
+  active_channel_ = nullptr;
+  factory_->clear();
+}
+
+bool LinuxTableIPC::waitForMessage(int timeout_ms) {
+  if (active_channel_ == nullptr) {
+    return true;
+  }
+
+  return active_channel_->waitForMessage(timeout_ms);
+}
+
 std::string LinuxTableIPC::getTableNameFromPid(pid_t pid) {
   return factory_->getTableNameFromPid(pid);
 }
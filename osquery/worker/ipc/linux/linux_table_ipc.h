@@ -50,6 +50,17 @@ class LinuxTableIPC : public TableIPCBase<LinuxTableIPC> {
                        PipeChannelTicket channel_ticket);
   void closeActiveChannel();
 
+  /**
+   * @brief Close the channels of all the other workers, in a new worker.
+   *
+   * A forked worker holds copies of the pipes of the workers forked before
+   * it, which would keep them open after those workers exit.
+   */
+  void closeInheritedChannels();
+
+  /// Wait for a message on the active channel, false if the timeout expired.
+  bool waitForMessage(int timeout_ms);
+
   std::string getTableNameFromPid(pid_t pid);
 
   bool isChannelOpen() {
@@ -71,4 +71,31 @@ TEST_F(WorkerTableContainerTests, test_ipc_container_connect) {
 
   container_ipc.stopContainerWorker();
 }
+
+TEST_F(WorkerTableContainerTests, test_ipc_container_reuse) {
+  PipeChannelFactory factory;
+
+  LinuxTableContainerIPC container_ipc(factory);
+
+  auto status = container_ipc.connectToContainer("test", true, genTest1);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  QueryContext context;
+  context.constraints["pid_with_namespace"].add(
+      Constraint(ConstraintOperator::EQUALS, std::to_string(getpid())));
+
+  // A kept open worker runs the queries one after the other.
+  for (int i = 0; i < 2; ++i) {
+    QueryData results;
+    status = container_ipc.retrieveQueryDataFromContainer(context, results);
+    ASSERT_TRUE(status.ok()) << status.getMessage();
+
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_EQ(results[0]["test"], "Hello");
+    EXPECT_TRUE(container_ipc.isWorkerRunning());
+  }
+
+  container_ipc.stopContainerWorker();
+  EXPECT_FALSE(container_ipc.isWorkerRunning());
+}
 } // namespace osquery
@@ -9,6 +9,7 @@
 
 #include "pipe_channel.h"
 
+#include <poll.h>
 #include <signal.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -136,6 +137,18 @@ Status PipeChannel::recvStringMessageImpl(std::string& message) {
   return Status::success();
 }
 
+bool PipeChannel::waitForMessage(int timeout_ms) {
+  pollfd read_pipe{read_pipe_fd, POLLIN, 0};
+
+  int result = 0;
+  do {
+    result = poll(&read_pipe, 1, timeout_ms);
+  } while (result < 0 && errno == EINTR);
+
+  // Errors are reported by the next read.
+  return result != 0;
+}
+
 sigset_t PipeChannel::blockSIGPIPE() {
   sigset_t new_mask;
   sigset_t old_mask;
@@ -33,6 +33,13 @@ class PipeChannel : public TableChannelBase<PipeChannel> {
     return remote_pid;
   }
 
+  /**
+   * @brief Wait until a message can be read or the pipe is closed.
+   *
+   * @return false if the timeout expired first.
+   */
+  bool waitForMessage(int timeout_ms);
+
  private:
   friend TableChannelBase<PipeChannel>;
 
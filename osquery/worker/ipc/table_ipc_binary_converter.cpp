@@ -0,0 +1,145 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "table_ipc_binary_converter.h"
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace osquery {
+
+const char TableIPCBinaryConverter::kQueryDataBatchMarker = '\x01';
+
+const size_t TableIPCBinaryConverter::kMaxQueryDataBatchSize = 1024 * 1024;
+
+namespace {
+
+/// The marker and the last batch flag.
+const size_t kBatchHeaderSize = 2;
+
+bool appendLength(size_t length, std::string& message) {
+  if (length > std::numeric_limits<std::uint32_t>::max()) {
+    return false;
+  }
+
+  auto value = static_cast<std::uint32_t>(length);
+  message.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  return true;
+}
+
+bool appendString(const std::string& value, std::string& message) {
+  if (!appendLength(value.size(), message)) {
+    return false;
+  }
+
+  message.append(value);
+  return true;
+}
+
+class BatchReader {
+ public:
+  explicit BatchReader(const std::string& message)
+      : message_(message), pos_(kBatchHeaderSize) {}
+
+  bool done() const {
+    return pos_ == message_.size();
+  }
+
+  bool readLength(std::uint32_t& length) {
+    if (message_.size() - pos_ < sizeof(length)) {
+      return false;
+    }
+
+    std::memcpy(&length, message_.data() + pos_, sizeof(length));
+    pos_ += sizeof(length);
+    return true;
+  }
+
+  bool readString(std::string& value) {
+    std::uint32_t length = 0;
+    if (!readLength(length) || message_.size() - pos_ < length) {
+      return false;
+    }
+
+    value.assign(message_.data() + pos_, length);
+    pos_ += length;
+    return true;
+  }
+
+ private:
+  const std::string& message_;
+  size_t pos_;
+};
+} // namespace
+
+void TableIPCBinaryConverter::beginQueryDataBatch(std::string& message) {
+  message.clear();
+  message.push_back(kQueryDataBatchMarker);
+  message.push_back('\0');
+}
+
+Status TableIPCBinaryConverter::addRowToBatch(const Row& row,
+                                              std::string& message) {
+  if (!appendLength(row.size(), message)) {
+    return Status::failure("Row has too many columns");
+  }
+
+  for (const auto& column : row) {
+    if (!appendString(column.first, message) ||
+        !appendString(column.second, message)) {
+      return Status::failure("Column " + column.first + " is too big");
+    }
+  }
+
+  return Status::success();
+}
+
+void TableIPCBinaryConverter::setLastQueryDataBatch(std::string& message) {
+  message[1] = '\x01';
+}
+
+bool TableIPCBinaryConverter::isQueryDataBatch(const std::string& message) {
+  return message.size() >= kBatchHeaderSize &&
+         message[0] == kQueryDataBatchMarker;
+}
+
+Status TableIPCBinaryConverter::binaryToQueryData(const std::string& message,
+                                                  QueryData& query_data,
+                                                  bool& last) {
+  if (!isQueryDataBatch(message)) {
+    return Status::failure("Not a batch of rows");
+  }
+
+  last = message[1] != '\0';
+
+  BatchReader reader(message);
+  while (!reader.done()) {
+    std::uint32_t columns = 0;
+    if (!reader.readLength(columns)) {
+      return Status::failure("Truncated row in a batch of rows");
+    }
+
+    Row row;
+    std::string name;
+    for (std::uint32_t i = 0; i < columns; ++i) {
+      std::string value;
+      if (!reader.readString(name) || !reader.readString(value)) {
+        return Status::failure("Truncated column in a batch of rows");
+      }
+
+      row.emplace_hint(row.end(), std::move(name), std::move(value));
+    }
+
+    query_data.push_back(std::move(row));
+  }
+
+  return Status::success();
+}
+} // namespace osquery
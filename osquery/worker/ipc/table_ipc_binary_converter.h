@@ -0,0 +1,59 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <osquery/core/sql/query_data.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/**
+ * @brief Binary batches of rows sent by a worker.
+ *
+ * A batch starts with a marker byte, which JSON messages never start with,
+ * and a byte set on the last batch of the results. Each row follows as its
+ * column count, then the length and bytes of each column name and value. The
+ * lengths are 32-bit in host order, both processes run on the same host.
+ */
+class TableIPCBinaryConverter {
+ public:
+  /// The first byte of a batch of rows.
+  static const char kQueryDataBatchMarker;
+
+  /// Batches are sent once their encoded rows reach this size.
+  static const size_t kMaxQueryDataBatchSize;
+
+  /// Start a new batch in a message, replacing its content.
+  static void beginQueryDataBatch(std::string& message);
+
+  /// Append a row to the batch of a message.
+  static Status addRowToBatch(const Row& row, std::string& message);
+
+  /// Mark the batch of a message as the last one of the results.
+  static void setLastQueryDataBatch(std::string& message);
+
+  /// Check if a message holds a batch of rows.
+  static bool isQueryDataBatch(const std::string& message);
+
+  /**
+   * @brief Append the rows of a batch.
+   *
+   * @param message The received batch.
+   * @param query_data The rows are appended to it.
+   * @param last Set if this is the last batch of the results.
+   */
+  static Status binaryToQueryData(const std::string& message,
+                                  QueryData& query_data,
+                                  bool& last);
+};
+} // namespace osquery
@@ -17,7 +17,8 @@
 #include <osquery/utils/status/status.h>
 
 namespace osquery {
-enum class JSONMessageType { None, QueryData, Log, Job };
+/// QueryDataBatch is a binary batch of rows followed by more batches.
+enum class JSONMessageType { None, QueryData, QueryDataBatch, Log, Job };
 
 class TableIPCJSONConverter {
  public:
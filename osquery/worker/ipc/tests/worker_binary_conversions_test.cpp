@@ -0,0 +1,137 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <string>
+
+#include <osquery/core/sql/query_data.h>
+#include <osquery/utils/status/status.h>
+#include <osquery/worker/ipc/table_ipc_base.h>
+#include <osquery/worker/ipc/table_ipc_binary_converter.h>
+
+namespace osquery {
+
+class TestBatchTableIPC : public TableIPCBase<TestBatchTableIPC> {
+ public:
+  Status sendJSONString(const std::string& message) {
+    messages.push_back(message);
+    return Status::success();
+  }
+
+  Status recvJSONString(std::string& message) {
+    if (messages.empty()) {
+      return Status::failure(2, "No message");
+    }
+
+    message = std::move(messages.front());
+    messages.pop_front();
+    return Status::success();
+  }
+
+  Status processLogMessage(const JSON& json_message) {
+    return Status::failure("Unexpected Log message");
+  }
+
+  Status processJobMessage(const JSON& json_message) {
+    return Status::failure("Unexpected Job message");
+  }
+
+  Status processQueryDataMessage(const JSON& json_message,
+                                 QueryData& query_results) {
+    return Status::failure("Unexpected JSON QueryData message");
+  }
+
+  std::deque<std::string> messages;
+};
+
+TEST(WorkerBinaryConversionsTests, test_querydata_batches) {
+  QueryData data;
+  Row r1;
+  r1["column1"] = "test";
+  r1["column2"] = "";
+  data.push_back(r1);
+
+  // Rows of 1 KiB, so the results span several batches.
+  for (size_t i = 0; i < 2048; ++i) {
+    Row row;
+    row["column1"] = std::to_string(i);
+    row["column2"] = std::string(1024, 'a');
+    data.push_back(std::move(row));
+  }
+  data.push_back(Row());
+
+  TestBatchTableIPC ipc;
+  auto status = ipc.sendQueryDataBatches(data);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_GT(ipc.messages.size(), 1U);
+
+  QueryData read_query_data;
+  JSONMessageType message_type = JSONMessageType::None;
+  size_t batches = 0;
+  while (message_type != JSONMessageType::QueryData) {
+    status = ipc.processOneMessage(&read_query_data, message_type);
+    ASSERT_TRUE(status.ok()) << status.getMessage();
+    ++batches;
+  }
+
+  EXPECT_TRUE(ipc.messages.empty());
+  EXPECT_GT(batches, 1U);
+  EXPECT_EQ(read_query_data, data);
+}
+
+TEST(WorkerBinaryConversionsTests, test_empty_querydata) {
+  TestBatchTableIPC ipc;
+  auto status = ipc.sendQueryDataBatches(QueryData());
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(ipc.messages.size(), 1U);
+
+  QueryData read_query_data;
+  JSONMessageType message_type = JSONMessageType::None;
+  status = ipc.processOneMessage(&read_query_data, message_type);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_TRUE(message_type == JSONMessageType::QueryData);
+  EXPECT_TRUE(read_query_data.empty());
+}
+
+TEST(WorkerBinaryConversionsTests, test_invalid_batches) {
+  Row row;
+  row["column1"] = "test";
+
+  std::string message;
+  TableIPCBinaryConverter::beginQueryDataBatch(message);
+  ASSERT_TRUE(TableIPCBinaryConverter::addRowToBatch(row, message).ok());
+  TableIPCBinaryConverter::setLastQueryDataBatch(message);
+
+  QueryData query_data;
+  bool last = false;
+  auto status =
+      TableIPCBinaryConverter::binaryToQueryData(message, query_data, last);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_TRUE(last);
+  ASSERT_EQ(query_data.size(), 1U);
+  EXPECT_EQ(query_data[0]["column1"], "test");
+
+  // A truncated batch is rejected.
+  message.pop_back();
+  status =
+      TableIPCBinaryConverter::binaryToQueryData(message, query_data, last);
+  EXPECT_FALSE(status.ok());
+
+  // JSON messages are not batches.
+  EXPECT_FALSE(TableIPCBinaryConverter::isQueryDataBatch("{\"Type\":\"Log\"}"));
+
+  // Rows are only expected by the parent.
+  TestBatchTableIPC ipc;
+  ASSERT_TRUE(ipc.sendQueryDataBatches({row}).ok());
+  JSONMessageType message_type;
+  EXPECT_FALSE(ipc.processOneMessage(nullptr, message_type).ok());
+}
+} // namespace osquery
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <mutex>
 #include <string>
 
 namespace osquery {
@@ -18,4 +19,24 @@ class Logger {
   virtual void log(int severity, const std::string& message) = 0;
   virtual void vlog(int severity, const std::string& message) = 0;
 };
+
+/// Serializes the messages of a logger used by several threads.
+class SynchronizedLogger final : public Logger {
+ public:
+  explicit SynchronizedLogger(Logger& logger) : logger_(logger) {}
+
+  void log(int severity, const std::string& message) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    logger_.log(severity, message);
+  }
+
+  void vlog(int severity, const std::string& message) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    logger_.vlog(severity, message);
+  }
+
+ private:
+  Logger& logger_;
+  std::mutex mutex_;
+};
 } // namespace osquery
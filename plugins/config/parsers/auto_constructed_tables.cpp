@@ -25,6 +25,37 @@ namespace rj = rapidjson;
 
 namespace osquery {
 
+std::string ATCPlugin::constrainedQuery(
+    QueryContext& context, std::vector<std::string>& parameters) const {
+  std::vector<std::string> predicates;
+  for (const auto& column : tc_columns_) {
+    const auto& name = std::get<0>(column);
+    if (boost::iequals(name, "path") || !context.hasConstraint(name, EQUALS)) {
+      continue;
+    }
+
+    // The table compares the text of each value. Reals and NULLs are always
+    // returned, their text is formatted differently by the table.
+    auto quoted = "\"" + boost::replace_all_copy(name, "\"", "\"\"") + "\"";
+    std::string placeholders;
+    for (const auto& value : context.constraints[name].getAll(EQUALS)) {
+      placeholders += placeholders.empty() ? "?" : ", ?";
+      parameters.push_back(value);
+    }
+    predicates.push_back("(typeof(" + quoted + ") IN ('real', 'null') OR " +
+                         "CAST(" + quoted + " AS TEXT) IN (" + placeholders +
+                         "))");
+  }
+
+  if (predicates.empty()) {
+    return sqlite_query_;
+  }
+
+  auto query =
+      boost::trim_right_copy_if(sqlite_query_, boost::is_any_of("; \t\r\n"));
+  return "SELECT * FROM (" + query + ") WHERE " + join(predicates, " AND ");
+}
+
 TableRows ATCPlugin::generate(QueryContext& context) {
   TableRows result;
   std::vector<std::string> paths;
@@ -33,18 +64,27 @@ TableRows ATCPlugin::generate(QueryContext& context) {
     LOG(WARNING) << "ATC Table: Could not glob: " << path_ << " skipping";
     return result;
   }
+
+  std::vector<std::string> parameters;
+  auto query = constrainedQuery(context, parameters);
+
+  WriteLock lock(handles_mutex_);
+  std::set<std::string> matched(paths.begin(), paths.end());
+  for (auto it = handles_.begin(); it != handles_.end();) {
+    it = (matched.count(it->first) > 0) ? std::next(it) : handles_.erase(it);
+  }
+
   for (const auto& path : paths) {
-    s = getSqliteJournalMode(path);
-    bool preserve_locking = false;
-    if (!s.ok()) {
-      VLOG(1) << "ATC Table: Unable to detect journal mode, applying default "
-                 "locking policy"
-              << " for path " << path;
-    } else {
-      preserve_locking = s.getMessage() == "wal";
+    auto& handle = handles_[path];
+    if (handle == nullptr) {
+      handle = std::make_unique<SqliteFileHandle>(path);
+    }
+
+    s = handle->query(query, parameters, result);
+    if (!s.ok() && !parameters.empty()) {
+      // A constrained column may not be named by the query, filter later.
+      s = handle->query(sqlite_query_, {}, result);
     }
-    s = genTableRowsForSqliteTable(
-        path, sqlite_query_, result, preserve_locking);
     if (!s.ok()) {
       LOG(WARNING) << "ATC Table: Error Code: " << s.getCode()
                    << " Could not generate data: " << s.getMessage()
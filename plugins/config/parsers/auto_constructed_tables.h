@@ -7,8 +7,13 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <map>
+#include <memory>
+
 #include <osquery/config/config.h>
 #include <osquery/core/tables.h>
+#include <osquery/sql/sqlite_util.h>
+#include <osquery/utils/mutex.h>
 
 namespace osquery {
 /**
@@ -19,6 +24,10 @@ class ATCPlugin : public TablePlugin {
   std::string sqlite_query_;
   std::string path_;
 
+  /// The open databases, by path, reused while the path pattern matches them.
+  std::map<std::string, std::unique_ptr<SqliteFileHandle>> handles_;
+  Mutex handles_mutex_;
+
  protected:
   std::string columnDefinition() const {
     return ::osquery::columnDefinition(tc_columns_);
@@ -28,6 +37,16 @@ class ATCPlugin : public TablePlugin {
     return tc_columns_;
   }
 
+  /**
+   * @brief The query with the equality constraints of the context applied.
+   *
+   * The configured query becomes a subquery filtered by the constrained
+   * columns, so the database only returns the requested rows. The values are
+   * appended to parameters.
+   */
+  std::string constrainedQuery(QueryContext& context,
+                               std::vector<std::string>& parameters) const;
+
  public:
   ATCPlugin(const std::string& path,
             const TableColumns& tc_columns,
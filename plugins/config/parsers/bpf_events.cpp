@@ -0,0 +1,59 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/config/config.h>
+#include <osquery/registry/registry_factory.h>
+
+namespace osquery {
+
+/**
+ * @brief A ConfigParserPlugin for the "bpf_events" dictionary key.
+ *
+ * The BPF event publisher reads the "exclude" object in this dictionary to
+ * drop the events of uninteresting processes before they reach the
+ * subscribers.
+ */
+class BPFEventsConfigParserPlugin : public ConfigParserPlugin {
+ public:
+  std::vector<std::string> keys() const override {
+    return {"bpf_events"};
+  }
+
+  Status setUp() override;
+
+  Status update(const std::string& source, const ParserConfig& config) override;
+};
+
+Status BPFEventsConfigParserPlugin::setUp() {
+  auto obj = data_.getObject();
+  data_.add("bpf_events", obj);
+  return Status::success();
+}
+
+Status BPFEventsConfigParserPlugin::update(const std::string& source,
+                                           const ParserConfig& config) {
+  auto bpf_events = config.find("bpf_events");
+  if (bpf_events == config.end()) {
+    return Status::success();
+  }
+
+  if (!bpf_events->second.doc().IsObject()) {
+    return Status::failure("The bpf_events configuration is not an object");
+  }
+
+  auto doc = JSON::newObject();
+  auto obj = doc.getObject();
+  doc.copyFrom(bpf_events->second.doc(), obj);
+  doc.add("bpf_events", obj);
+  data_ = std::move(doc);
+  return Status::success();
+}
+
+REGISTER_INTERNAL(BPFEventsConfigParserPlugin, "config_parser", "bpf_events");
+} // namespace osquery
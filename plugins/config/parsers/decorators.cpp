@@ -95,6 +95,9 @@ class DecoratorsConfigParserPlugin : public ConfigParserPlugin {
   /// The result set of decorations, column names and their values.
   static DecorationStore kDecorations;
 
+  /// Incremented when a decoration changes, protected by kDecorationsMutex.
+  static uint64_t kDecorationsGeneration;
+
   /// Protect additions to the decorator set.
   static Mutex kDecorationsMutex;
 
@@ -104,6 +107,7 @@ class DecoratorsConfigParserPlugin : public ConfigParserPlugin {
 } // namespace
 
 DecorationStore DecoratorsConfigParserPlugin::kDecorations;
+uint64_t DecoratorsConfigParserPlugin::kDecorationsGeneration{1};
 Mutex DecoratorsConfigParserPlugin::kDecorationsMutex;
 Mutex DecoratorsConfigParserPlugin::kDecorationsConfigMutex;
 
@@ -240,7 +244,18 @@ inline void addDecoration(const std::string& source,
                           const std::string& name,
                           const std::string& value) {
   WriteLock lock(DecoratorsConfigParserPlugin::kDecorationsMutex);
-  DecoratorsConfigParserPlugin::kDecorations[source][name] = value;
+  auto& decorations = DecoratorsConfigParserPlugin::kDecorations[source];
+  auto it = decorations.find(name);
+  if (it == decorations.end()) {
+    decorations.emplace(name, value);
+  } else if (it->second != value) {
+    it->second = value;
+  } else {
+    // Rerunning a decorator with the same result keeps the generation, and
+    // the log items keep reusing their serialized decorations.
+    return;
+  }
+  DecoratorsConfigParserPlugin::kDecorationsGeneration++;
 }
 
 inline void runDecorators(const std::string& source,
@@ -270,7 +285,11 @@ inline void runDecorators(const std::string& source,
 
 void clearDecorations(const std::string& source) {
   WriteLock lock(DecoratorsConfigParserPlugin::kDecorationsMutex);
-  DecoratorsConfigParserPlugin::kDecorations[source].clear();
+  auto& decorations = DecoratorsConfigParserPlugin::kDecorations[source];
+  if (!decorations.empty()) {
+    decorations.clear();
+    DecoratorsConfigParserPlugin::kDecorationsGeneration++;
+  }
 }
 
 void runDecorators(DecorationPoint point,
@@ -314,9 +333,9 @@ void runDecorators(DecorationPoint point,
   }
 }
 
-void getDecorations(std::map<std::string, std::string>& results) {
+uint64_t getDecorations(std::map<std::string, std::string>& results) {
   if (FLAGS_disable_decorators) {
-    return;
+    return 0;
   }
 
   ReadLock lock(DecoratorsConfigParserPlugin::kDecorationsMutex);
@@ -326,6 +345,7 @@ void getDecorations(std::map<std::string, std::string>& results) {
       results[decoration.first] = decoration.second;
     }
   }
+  return DecoratorsConfigParserPlugin::kDecorationsGeneration;
 }
 
 REGISTER_INTERNAL(DecoratorsConfigParserPlugin,
@@ -51,8 +51,11 @@ void runDecorators(DecorationPoint point,
  * logging APIs: logString, logSnapshot, etc.
  *
  * @param results the output parameter to write decorations.
+ * @return the generation of the decorations, 0 if decorators are disabled.
+ * Decorations of the same generation are equal, the generation only changes
+ * when a decorator result or the config changes.
  */
-void getDecorations(std::map<std::string, std::string>& results);
+uint64_t getDecorations(std::map<std::string, std::string>& results);
 
 /// Clear decorations for a source when it updates.
 void clearDecorations(const std::string& source);
@@ -30,16 +30,23 @@ class FilePathsConfigParserPlugin : public ConfigParserPlugin {
 
   Status update(const std::string& source, const ParserConfig& config) override;
 
+  bool refresh() override;
+
  private:
+  /// Paths selected by a file_paths_query, by category.
+  using QueryPaths = std::map<std::string, std::vector<std::string>>;
+
   // Parse and update file_accesses top-level key.
   void updateFileAccesses(const JSON& file_accesses, const std::string& source);
 
   // Parse and update file_paths top-level key.
   void updateFilePaths(const JSON& file_paths, const std::string& source);
 
-  // Parse and update file_paths_query top-level key.
-  void updateFilePathsQuery(const JSON& file_paths_query,
-                            const std::string& source);
+  // Run the queries of the file_paths_query top-level key.
+  QueryPaths runFilePathsQuery(const JSON& file_paths_query);
+
+  // Add the paths selected by file_paths_query.
+  void addQueryPaths(const QueryPaths& paths, const std::string& source);
 
   // Parse and update exclude_paths top-level key.
   void updateExcludePaths(const JSON& exclude_paths);
@@ -47,6 +54,15 @@ class FilePathsConfigParserPlugin : public ConfigParserPlugin {
  private:
   /// The access map binds source to category.
   std::map<std::string, std::vector<std::string>> access_map_;
+
+  /// The file_paths and file_paths_query of each source using queries.
+  std::map<std::string, std::pair<JSON, JSON>> query_sections_;
+
+  /// The paths last selected by the file_paths_query of each source.
+  std::map<std::string, QueryPaths> query_paths_;
+
+  /// Sources updated, and their queries run, since the last refresh.
+  std::set<std::string> updated_;
 };
 
 Status FilePathsConfigParserPlugin::setUp() {
@@ -56,6 +72,9 @@ Status FilePathsConfigParserPlugin::setUp() {
   data_.add("exclude_paths", exclude_obj);
 
   access_map_.clear();
+  query_sections_.clear();
+  query_paths_.clear();
+  updated_.clear();
   return Status::success();
 }
 
@@ -115,14 +134,15 @@ void FilePathsConfigParserPlugin::updateFilePaths(const JSON& file_paths,
   }
 }
 
-void FilePathsConfigParserPlugin::updateFilePathsQuery(
-    const JSON& file_paths_query, const std::string& source) {
+FilePathsConfigParserPlugin::QueryPaths
+FilePathsConfigParserPlugin::runFilePathsQuery(const JSON& file_paths_query) {
+  QueryPaths paths;
 #ifdef OSQUERY_IS_FUZZING
-  return;
+  return paths;
 #else
 
   if (!file_paths_query.doc().IsObject()) {
-    return;
+    return paths;
   }
 
   for (const auto& category : file_paths_query.doc().GetObject()) {
@@ -150,15 +170,25 @@ void FilePathsConfigParserPlugin::updateFilePathsQuery(
           } else {
             std::string path = pathIt->second;
             replaceGlobWildcards(path);
-            Config::get().addFile(source, name, path);
+            paths[name].push_back(std::move(path));
           }
         }
       }
     }
   }
+  return paths;
 #endif
 }
 
+void FilePathsConfigParserPlugin::addQueryPaths(const QueryPaths& paths,
+                                                const std::string& source) {
+  for (const auto& category : paths) {
+    for (const auto& path : category.second) {
+      Config::get().addFile(source, category.first, path);
+    }
+  }
+}
+
 void FilePathsConfigParserPlugin::updateExcludePaths(
     const JSON& exclude_paths) {
   if (!exclude_paths.doc().IsObject()) {
@@ -196,6 +226,9 @@ Status FilePathsConfigParserPlugin::update(const std::string& source,
                                            const ParserConfig& config) {
   Config::get().removeFiles(source);
   access_map_.erase(source);
+  query_sections_.erase(source);
+  query_paths_.erase(source);
+  updated_.insert(source);
 
   auto file_paths = config.find("file_paths");
   auto file_paths_query = config.find("file_paths_query");
@@ -208,7 +241,18 @@ Status FilePathsConfigParserPlugin::update(const std::string& source,
   }
 
   if (file_paths_query != config.end()) {
-    updateFilePathsQuery(file_paths_query->second, source);
+    auto paths = runFilePathsQuery(file_paths_query->second);
+    addQueryPaths(paths, source);
+    query_paths_[source] = std::move(paths);
+
+    // Keep both sections, a refresh re-adds the static paths of the source.
+    auto file_paths_copy = (file_paths != config.end())
+                               ? JSON::newFromValue(file_paths->second.doc())
+                               : JSON::newObject();
+    query_sections_.emplace(
+        source,
+        std::make_pair(std::move(file_paths_copy),
+                       JSON::newFromValue(file_paths_query->second.doc())));
   }
 
   auto file_accesses = config.find("file_accesses");
@@ -228,5 +272,31 @@ Status FilePathsConfigParserPlugin::update(const std::string& source,
   return Status::success();
 }
 
+bool FilePathsConfigParserPlugin::refresh() {
+  // The users, mounts, etc. a query selects change without the config.
+  bool changed = false;
+  for (const auto& sections : query_sections_) {
+    const auto& source = sections.first;
+    if (updated_.count(source) > 0) {
+      continue;
+    }
+
+    auto paths = runFilePathsQuery(sections.second.second);
+    auto& last_paths = query_paths_[source];
+    if (paths == last_paths) {
+      continue;
+    }
+
+    Config::get().removeFiles(source);
+    updateFilePaths(sections.second.first, source);
+    addQueryPaths(paths, source);
+    last_paths = std::move(paths);
+    changed = true;
+  }
+
+  updated_.clear();
+  return changed;
+}
+
 REGISTER_INTERNAL(FilePathsConfigParserPlugin, "config_parser", "file_paths");
 } // namespace osquery
@@ -118,6 +118,30 @@ TEST_F(DecoratorsConfigParserPluginTests, test_decorators_run_interval) {
   ASSERT_EQ(second_item.decorations.size(), 2U);
 }
 
+TEST_F(DecoratorsConfigParserPluginTests, test_decorations_generation) {
+  FLAGS_disable_decorators = false;
+  auto status = Config::get().update(config_data_);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  runDecorators(DECORATE_ALWAYS);
+
+  std::map<std::string, std::string> decorations;
+  auto generation = getDecorations(decorations);
+  EXPECT_NE(generation, 0U);
+
+  // Decorators returning the same results keep the generation.
+  runDecorators(DECORATE_LOAD);
+  runDecorators(DECORATE_ALWAYS);
+  std::map<std::string, std::string> rerun;
+  EXPECT_EQ(getDecorations(rerun), generation);
+  EXPECT_EQ(rerun, decorations);
+
+  clearDecorations("awesome");
+  EXPECT_NE(getDecorations(rerun), generation);
+
+  FLAGS_disable_decorators = true;
+  EXPECT_EQ(getDecorations(rerun), 0U);
+}
+
 TEST_F(DecoratorsConfigParserPluginTests, test_decorators_run_load_top_level) {
   // Re-enable the decorators, then update the config.
   // The 'load' decorator set should run every time the config is updated.
@@ -18,12 +18,41 @@
 #include <osquery/database/database.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/registry/registry_interface.h>
+#include <osquery/sql/dynamic_table_row.h>
+#include <osquery/sql/sqlite_util.h>
+#include <osquery/sql/virtual_table.h>
 #include <osquery/utils/conversions/tryto.h>
 
 #include <set>
 
 namespace osquery {
 
+namespace {
+
+/// The paths selected by the file_paths_query of test_query_refresh.
+std::vector<std::string> kQueryTestPaths;
+
+class QueryPathsTablePlugin : public TablePlugin {
+ public:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("path", TEXT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  TableRows generate(QueryContext& /* context */) override {
+    TableRows results;
+    for (const auto& path : kQueryTestPaths) {
+      auto r = make_table_row();
+      r["path"] = path;
+      results.push_back(std::move(r));
+    }
+    return results;
+  }
+};
+
+} // namespace
+
 class FilePathsConfigParserPluginTests : public testing::Test {
  public:
   void SetUp() override {
@@ -114,4 +143,44 @@ TEST_F(FilePathsConfigParserPluginTests, test_remove_source) {
   Config::get().update(config_data_);
   EXPECT_EQ(numFiles(), 0U);
 }
+
+TEST_F(FilePathsConfigParserPluginTests, test_query_refresh) {
+  auto table = std::make_shared<QueryPathsTablePlugin>();
+  RegistryFactory::get().registry("table")->add("query_paths_test", table);
+  attachTableInternal("query_paths_test",
+                      columnDefinition(table->columns()),
+                      SQLiteDBManager::get(),
+                      false);
+
+  std::map<std::string, std::string> config = {
+      {"query_source",
+       "{\"file_paths\": {\"static\": [\"/dev/null\"]}, "
+       "\"file_paths_query\": {\"selected\": "
+       "[\"select path from query_paths_test\"]}}"},
+  };
+
+  auto getFiles = []() {
+    std::map<std::string, std::vector<std::string>> files;
+    Config::get().files(([&files](const std::string& category,
+                                  const std::vector<std::string>& paths) {
+      files[category] = paths;
+    }));
+    return files;
+  };
+
+  kQueryTestPaths = {"/dev/zero"};
+  Config::get().update(config);
+  auto files = getFiles();
+  EXPECT_EQ(files["static"], std::vector<std::string>{"/dev/null"});
+  EXPECT_EQ(files["selected"], std::vector<std::string>{"/dev/zero"});
+
+  // The content did not change, the query is run again.
+  kQueryTestPaths.push_back("/dev/random");
+  Config::get().update(config);
+  files = getFiles();
+  EXPECT_EQ(files["static"], std::vector<std::string>{"/dev/null"});
+  EXPECT_EQ(files["selected"],
+            (std::vector<std::string>{"/dev/zero", "/dev/random"}));
+  kQueryTestPaths.clear();
+}
 }
@@ -7,6 +7,7 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <map>
 #include <set>
 
 #include <osquery/config/config.h>
@@ -19,6 +20,12 @@ namespace osquery {
 
 /**
  * @brief A simple ConfigParserPlugin for a "views" dictionary key.
+ *
+ * Views are created once per config generation. The parser remembers the
+ * views it created, so an update with unchanged views does not touch the
+ * database or the SQL schema. Changing the schema makes SQLite recompile every
+ * prepared statement on the next execution, keeping the schema stable keeps
+ * the statement cache valid.
  */
 class ViewsConfigParserPlugin : public ConfigParserPlugin {
  public:
@@ -31,6 +38,9 @@ class ViewsConfigParserPlugin : public ConfigParserPlugin {
  private:
   const std::string kConfigViews = "config_views.";
   std::atomic<bool> first_time_{true};
+
+  /// The views created by this process, name to query.
+  std::map<std::string, std::string> views_;
 };
 
 Status ViewsConfigParserPlugin::update(const std::string& source,
@@ -52,14 +62,18 @@ Status ViewsConfigParserPlugin::update(const std::string& source,
 
   // We use a restricted scope below to change the data structure from
   // an array to a set. This lets us do deletes much more efficiently
-  std::vector<std::string> created_views;
   std::set<std::string> erase_views;
-  {
+  if (first_time_) {
+    // Views stored by a previous process may no longer be configured.
     std::vector<std::string> old_views_vec;
     scanDatabaseKeys(kQueries, old_views_vec, kConfigViews);
     for (const auto& view : old_views_vec) {
       erase_views.insert(view.substr(kConfigViews.size()));
     }
+  } else {
+    for (const auto& view : views_) {
+      erase_views.insert(view.first);
+    }
   }
 
   QueryData r;
@@ -73,15 +87,12 @@ Status ViewsConfigParserPlugin::update(const std::string& source,
       if (query.empty()) {
         continue;
       }
-
-      std::string old_query;
-      getDatabaseValue(kQueries, kConfigViews + name, old_query);
       erase_views.erase(name);
 
-      // If query exists in the store, view would already have been
-      // created and we don't need to create it. Except, at startup,
-      // the view always needs to be created.
-      if (!first_time_ && old_query == query) {
+      // If this process created the view with the same query, it does not
+      // need to be created again. At startup every view is created.
+      auto existing = views_.find(name);
+      if (existing != views_.end() && existing->second == query) {
         continue;
       }
 
@@ -93,8 +104,10 @@ Status ViewsConfigParserPlugin::update(const std::string& source,
       auto s = osquery::query("CREATE VIEW " + name + " AS " + query, r);
 #endif
       if (s.ok()) {
+        views_[name] = query;
         setDatabaseValue(kQueries, kConfigViews + name, query);
       } else {
+        views_.erase(name);
         LOG(INFO) << "Error creating view (" << name << "): " << s.getMessage();
       }
     }
@@ -106,6 +119,7 @@ Status ViewsConfigParserPlugin::update(const std::string& source,
 #ifndef OSQUERY_IS_FUZZING
     osquery::query("DROP VIEW " + old_view, r);
 #endif
+    views_.erase(old_view);
     deleteDatabaseValue(kQueries, kConfigViews + old_view);
   }
 
@@ -20,6 +20,7 @@
 #include <osquery/hashing/hashing.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry.h>
+#include <osquery/remote/enroll/enroll.h>
 #include <osquery/remote/requests.h>
 #include <osquery/remote/serializers/json.h>
 #include <osquery/remote/tests/test_utils.h>
@@ -104,6 +105,52 @@ TEST_F(TLSConfigTests, test_retrieve_config) {
   EXPECT_EQ("baz", response[0]["tls_plugin"]);
 }
 
+TEST_F(TLSConfigTests, test_retrieve_config_not_modified) {
+  Flag::updateValue("config_tls_endpoint", "/config_etag");
+  Registry::get().setActive("config", "tls");
+
+  PluginResponse response;
+  auto status = Registry::call("config", {{"action", "genConfig"}}, response);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(1U, response.size());
+  EXPECT_FALSE(response[0]["tls_plugin"].empty());
+
+  // The ETag is only used once the config was applied.
+  auto plugin = std::static_pointer_cast<TLSConfigPlugin>(
+      Registry::get().plugin("config", "tls"));
+  EXPECT_TRUE(plugin->etag_.empty());
+  plugin->configApplied(Status::success());
+  EXPECT_FALSE(plugin->etag_.empty());
+
+  // The server answers 304 and the plugin returns no sources.
+  response.clear();
+  status = Registry::call("config", {{"action", "genConfig"}}, response);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(1U, response.size());
+  EXPECT_TRUE(response[0].empty());
+
+  // An invalid config is requested again in full.
+  plugin->configApplied(Status::failure("invalid"));
+  EXPECT_TRUE(plugin->etag_.empty());
+}
+
+TEST_F(TLSConfigTests, test_retrieve_enroll_config) {
+  // A config returned with the enrollment is used without a request.
+  Flag::updateValue("config_tls_endpoint", "/not_an_endpoint");
+  Registry::get().setActive("config", "tls");
+  setEnrollConfig("{\"schedule\":{}}");
+
+  PluginResponse response;
+  auto status = Registry::call("config", {{"action", "genConfig"}}, response);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(1U, response.size());
+  EXPECT_EQ("{\"schedule\":{}}", response[0]["tls_plugin"]);
+
+  // It is only used once.
+  std::string json;
+  EXPECT_FALSE(takeEnrollConfig(json));
+}
+
 TEST_F(TLSConfigTests, test_runner_and_scheduler) {
   Flag::updateValue("config_tls_endpoint", "/config");
   // Will cause another enroll.
@@ -57,20 +57,52 @@ Status TLSConfigPlugin::setUp() {
   }
 
   uri_ = TLSRequestHelper::makeURI(FLAGS_config_tls_endpoint);
+  etag_.clear();
+  pending_etag_.clear();
   return Status(0, "OK");
 }
 
 Status TLSConfigPlugin::genConfig(std::map<std::string, std::string>& config) {
+  // An enrollment may have returned the config, which saves its request.
+  if (!FLAGS_disable_enrollment) {
+    getNodeKey("tls");
+  }
+
   std::string json;
+  if (takeEnrollConfig(json)) {
+    VLOG(1) << "TLS config was returned with the enrollment";
+    etag_.clear();
+    pending_etag_.clear();
+    config["tls_plugin"] = std::move(json);
+    return Status::success();
+  }
+
   JSON params;
   if (FLAGS_tls_node_api) {
     // The TLS node API morphs some verbs and variables.
     params.add("_get", true);
   }
 
+  if (!etag_.empty()) {
+    params.add("_if_none_match", etag_);
+  }
+
   auto s = TLSRequestHelper::go<JSONSerializer>(
       uri_, params, json, FLAGS_config_tls_max_attempts);
+  if (s.getCode() == kRequestNotModified) {
+    // No sources are returned, the config is not updated.
+    VLOG(1) << "TLS config is not modified";
+    return Status::success();
+  }
+
   if (s.ok()) {
+    // The ETag is only sent once the config is known to be valid.
+    auto etag = params.doc().FindMember("_etag");
+    pending_etag_ =
+        (etag != params.doc().MemberEnd() && etag->value.IsString())
+            ? etag->value.GetString()
+            : "";
+
     if (FLAGS_tls_node_api) {
       // The node API embeds configuration data (JSON escaped).
 
@@ -93,4 +125,10 @@ Status TLSConfigPlugin::genConfig(std::map<std::string, std::string>& config) {
 
   return s;
 }
+
+void TLSConfigPlugin::configApplied(const Status& status) {
+  // An invalid config is dropped, the server must send the next one in full.
+  etag_ = status.ok() ? std::move(pending_etag_) : "";
+  pending_etag_.clear();
+}
 } // namespace osquery
@@ -9,6 +9,8 @@
 
 #pragma once
 
+#include <gtest/gtest_prod.h>
+
 #include <osquery/config/config.h>
 #include <osquery/dispatcher/dispatcher.h>
 
@@ -21,12 +23,20 @@ class TLSConfigPlugin : public ConfigPlugin,
  public:
   Status setUp() override;
   Status genConfig(std::map<std::string, std::string>& config) override;
+  void configApplied(const Status& status) override;
 
  protected:
   /// Calculate the URL once and cache the result.
   std::string uri_;
 
+  /// ETag of the last config, the server answers 304 while it is unchanged.
+  std::string etag_;
+
+  /// ETag of the last returned config, kept once the config is applied.
+  std::string pending_etag_;
+
  private:
   friend class TLSConfigTests;
+  FRIEND_TEST(TLSConfigTests, test_retrieve_config_not_modified);
 };
 } // namespace osquery
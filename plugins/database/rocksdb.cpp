@@ -9,9 +9,15 @@
 
 #include <sys/stat.h>
 
+#include <ctime>
+
 #include <rocksdb/db.h>
 #include <rocksdb/env.h>
+#include <rocksdb/filter_policy.h>
 #include <rocksdb/options.h>
+#include <rocksdb/rate_limiter.h>
+#include <rocksdb/table.h>
+#include <rocksdb/write_buffer_manager.h>
 
 #include <osquery/core/flags.h>
 #include <osquery/filesystem/fileops.h>
@@ -19,6 +25,7 @@
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/utils/conversions/tryto.h>
+#include <osquery/utils/info/tool_type.h>
 #include <plugins/database/rocksdb.h>
 
 namespace fs = boost::filesystem;
@@ -30,8 +37,55 @@ HIDDEN_FLAG(int32, rocksdb_write_buffer, 16, "Max write buffer number");
 HIDDEN_FLAG(int32, rocksdb_merge_number, 4, "Min write buffer number to merge");
 HIDDEN_FLAG(int32, rocksdb_background_flushes, 4, "Max background flushes");
 HIDDEN_FLAG(int32, rocksdb_buffer_blocks, 256, "Write buffer blocks (4k)");
+HIDDEN_FLAG(int32, rocksdb_max_open_files, 256, "Max open SST files");
+FLAG(uint64,
+     rocksdb_write_combine_ms,
+     0,
+     "Milliseconds to combine concurrent database writes into one batch");
+
+HIDDEN_FLAG(uint64,
+            rocksdb_write_combine_bytes,
+            4 * 1024 * 1024,
+            "Bytes after which combined writes are committed early");
+
+HIDDEN_FLAG(uint64,
+            rocksdb_block_cache_size,
+            8 * 1024 * 1024,
+            "Bytes of the block cache shared by all domains");
+
+HIDDEN_FLAG(uint64,
+            rocksdb_compression_dictionary_size,
+            16 * 1024,
+            "Bytes of the zstd dictionary of event and log files (0 = none)");
+
+FLAG(uint64,
+     rocksdb_events_ttl,
+     0,
+     "Seconds before compactions drop event data (0 = never)");
+
+FLAG(uint64,
+     rocksdb_logs_ttl,
+     0,
+     "Seconds before compactions drop buffered logs (0 = never)");
+
+FLAG(uint64,
+     rocksdb_events_quota_mb,
+     0,
+     "Megabytes of event data after which new events are refused (0 = none)");
+
+FLAG(uint64,
+     rocksdb_logs_quota_mb,
+     0,
+     "Megabytes of buffered logs after which new logs are refused (0 = none)");
+
+FLAG(uint64,
+     rocksdb_compaction_rate_mb,
+     0,
+     "Megabytes per second written by compactions and flushes (0 = any)");
 
 DECLARE_string(database_path);
+DECLARE_bool(database_read_only);
+DECLARE_uint64(database_memory_limit);
 
 /**
  * @brief Track external systems marking the RocksDB database as corrupted.
@@ -44,6 +98,169 @@ std::atomic<bool> kRocksDBCorruptionIndicator{false};
 /// Backing-storage provider for osquery internal/core.
 REGISTER_INTERNAL(RocksDBDatabasePlugin, "database", "rocksdb");
 
+/// Bits per key of the bloom filters, about a 1% false positive rate.
+const double kRocksDBBloomBitsPerKey = 10;
+
+/// The share of each memtable used for its prefix bloom filter.
+const double kRocksDBMemtableBloomRatio = 0.1;
+
+/// Samples of each file used to train its dictionary, per dictionary byte.
+const uint32_t kRocksDBDictionaryTrainRatio = 100;
+
+/// Seconds of each event bucket, see EventSubscriberPlugin::eventBucket.
+const uint64_t kRocksDBEventBucketSeconds = 60;
+
+/// How often a secondary instance reads the writes of the primary.
+const std::chrono::seconds kRocksDBCatchUpInterval{1};
+
+/// How long the last size of a domain with a quota is trusted.
+const std::chrono::seconds kRocksDBQuotaRefresh{1};
+
+/// Events and buffered logs are written once, scanned, then expired.
+static bool isWriteHeavyDomain(const std::string& domain) {
+  return domain == kEvents || domain == kLogs;
+}
+
+/// Scheduled query results and settings are read more than they change.
+static bool isReadMostlyDomain(const std::string& domain) {
+  return domain == kQueries || domain == kPersistentSettings;
+}
+
+DomainKeyPrefix::DomainKeyPrefix(std::string name,
+                                 char delimiter,
+                                 size_t delimiters,
+                                 std::string nested_prefix,
+                                 size_t nested_delimiters)
+    : name_(std::move(name)),
+      delimiter_(delimiter),
+      delimiters_(delimiters),
+      nested_prefix_(std::move(nested_prefix)),
+      nested_delimiters_(nested_delimiters) {}
+
+const char* DomainKeyPrefix::Name() const {
+  return name_.c_str();
+}
+
+rocksdb::Slice DomainKeyPrefix::Transform(const rocksdb::Slice& key) const {
+  return rocksdb::Slice(key.data(), prefixLength(key));
+}
+
+bool DomainKeyPrefix::InDomain(const rocksdb::Slice& key) const {
+  return prefixLength(key) > 0;
+}
+
+size_t DomainKeyPrefix::prefixLength(const rocksdb::Slice& key) const {
+  auto delimiters = delimiters_;
+  if (!nested_prefix_.empty() && key.starts_with(nested_prefix_)) {
+    delimiters = nested_delimiters_;
+  }
+
+  size_t found = 0;
+  for (size_t i = 0; i < key.size(); ++i) {
+    if (key[i] == delimiter_ && ++found == delimiters) {
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+/// Parse the decimal time field of a key.
+static bool parseKeyTime(const rocksdb::Slice& key,
+                         size_t begin,
+                         size_t end,
+                         uint64_t& time) {
+  // Longer fields are not times, and would overflow.
+  if (begin >= end || end - begin > 19) {
+    return false;
+  }
+
+  time = 0;
+  for (size_t i = begin; i < end; ++i) {
+    if (key[i] < '0' || key[i] > '9') {
+      return false;
+    }
+    time = time * 10 + static_cast<uint64_t>(key[i] - '0');
+  }
+  return true;
+}
+
+/// Find the last delimiter of a key before a position, npos if none.
+static size_t findLastDelimiter(const rocksdb::Slice& key,
+                                char delimiter,
+                                size_t end) {
+  for (size_t i = end; i > 0; --i) {
+    if (key[i - 1] == delimiter) {
+      return i - 1;
+    }
+  }
+  return std::string::npos;
+}
+
+bool getEventKeyTime(const rocksdb::Slice& key, uint64_t& time) {
+  // Event data keys are "data.<type>.<name>.<bucket>.<eid>".
+  const std::string data_prefix = "data.";
+  if (!key.starts_with(data_prefix)) {
+    return false;
+  }
+
+  auto eid = findLastDelimiter(key, '.', key.size());
+  if (eid == std::string::npos || eid < data_prefix.size()) {
+    return false;
+  }
+
+  auto bucket = findLastDelimiter(key, '.', eid);
+  if (bucket == std::string::npos || bucket < data_prefix.size()) {
+    return false;
+  }
+
+  if (!parseKeyTime(key, bucket + 1, eid, time)) {
+    return false;
+  }
+
+  // Every event in the bucket is at most this old.
+  time = (time + 1) * kRocksDBEventBucketSeconds;
+  return true;
+}
+
+bool getLogKeyTime(const rocksdb::Slice& key, uint64_t& time) {
+  // Buffered log keys are "<index>_<r|s>_<time>_<count>".
+  auto count = findLastDelimiter(key, '_', key.size());
+  if (count == std::string::npos) {
+    return false;
+  }
+
+  auto start = findLastDelimiter(key, '_', count);
+  if (start == std::string::npos || start < 2 || key[start - 2] != '_' ||
+      (key[start - 1] != 'r' && key[start - 1] != 's')) {
+    return false;
+  }
+
+  return parseKeyTime(key, start + 1, count, time);
+}
+
+DomainTTLFilter::DomainTTLFilter(std::string name,
+                                 uint64_t ttl,
+                                 KeyTime key_time)
+    : name_(std::move(name)), ttl_(ttl), key_time_(key_time) {}
+
+bool DomainTTLFilter::Filter(int level,
+                             const rocksdb::Slice& key,
+                             const rocksdb::Slice& existing_value,
+                             std::string* new_value,
+                             bool* value_changed) const {
+  uint64_t time = 0;
+  if (!key_time_(key, time)) {
+    return false;
+  }
+
+  auto now = static_cast<uint64_t>(std::time(nullptr));
+  return time < now && now - time > ttl_;
+}
+
+const char* DomainTTLFilter::Name() const {
+  return name_.c_str();
+}
+
 void GlogRocksDBLogger::Logv(const char* format, va_list ap) {
   // Convert RocksDB log to string and check if header or level-ed log.
   std::string log_line;
@@ -100,12 +317,12 @@ Status RocksDBDatabasePlugin::setUp() {
     options_.log_file_time_to_roll = 0;
     options_.keep_log_file_num = 10;
     options_.max_log_file_size = 1024 * 1024 * 1;
-    options_.max_open_files = 128;
+    options_.max_open_files = static_cast<int>(FLAGS_rocksdb_max_open_files);
     options_.stats_dump_period_sec = 0;
     options_.max_manifest_file_size = 1024 * 500;
 
     // Performance and optimization settings.
-    // Use rocksdb::kZSTD to use ZSTD database compression
+    // Domains may override these, see getDomainOptions.
     options_.compression = rocksdb::kNoCompression;
     options_.compaction_style = rocksdb::kCompactionStyleLevel;
     options_.arena_block_size = (4 * 1024);
@@ -117,6 +334,35 @@ Status RocksDBDatabasePlugin::setUp() {
     options_.max_background_flushes =
         static_cast<int>(FLAGS_rocksdb_background_flushes);
 
+    // Compactions yield the disk to flushes and to the rest of the host.
+    if (FLAGS_rocksdb_compaction_rate_mb > 0) {
+      options_.rate_limiter.reset(rocksdb::NewGenericRateLimiter(
+          static_cast<int64_t>(FLAGS_rocksdb_compaction_rate_mb * 1024 *
+                               1024)));
+    }
+    options_.env->LowerThreadPoolIOPriority(rocksdb::Env::LOW);
+    options_.env->LowerThreadPoolCPUPriority(rocksdb::Env::LOW);
+
+    // All domains share one block cache. When the memory of the database is
+    // limited, the memtables are charged to the cache and flushed once they
+    // use half of it.
+    if (FLAGS_database_memory_limit > 0) {
+      auto limit = static_cast<size_t>(FLAGS_database_memory_limit * 1024 *
+                                       1024);
+      block_cache_ = rocksdb::NewLRUCache(limit);
+      options_.write_buffer_manager =
+          std::make_shared<rocksdb::WriteBufferManager>(limit / 2,
+                                                        block_cache_);
+    } else {
+      block_cache_ = rocksdb::NewLRUCache(
+          static_cast<size_t>(FLAGS_rocksdb_block_cache_size));
+    }
+
+    rocksdb::BlockBasedTableOptions table_options;
+    table_options.block_cache = block_cache_;
+    options_.table_factory.reset(
+        rocksdb::NewBlockBasedTableFactory(table_options));
+
     // Create an environment to replace the default logger.
     if (logger_ == nullptr) {
       logger_ = std::make_shared<GlogRocksDBLogger>();
@@ -130,10 +376,22 @@ Status RocksDBDatabasePlugin::setUp() {
 
     for (const auto& cf_name : kDomains) {
       column_families_.push_back(
-          rocksdb::ColumnFamilyDescriptor(cf_name, options_));
+          rocksdb::ColumnFamilyDescriptor(cf_name, getDomainOptions(cf_name)));
       domain_set.insert(cf_name);
     }
 
+    auto addQuota = [this](const std::string& domain,
+                           uint64_t megabytes,
+                           const std::string& key_prefix) {
+      if (megabytes > 0) {
+        auto& quota = quotas_[domain];
+        quota.bytes = megabytes * 1024 * 1024;
+        quota.key_prefix = key_prefix;
+      }
+    };
+    addQuota(kEvents, FLAGS_rocksdb_events_quota_mb, "data.");
+    addQuota(kLogs, FLAGS_rocksdb_logs_quota_mb, "");
+
     // To support osquery rollbacks, meaning running with a database
     // written/used by a newer version of osquery that introduced a new column
     // family, we need to open with all column families known by the database.
@@ -168,13 +426,30 @@ Status RocksDBDatabasePlugin::setUp() {
   close();
 
   // Attempt to create a RocksDB instance and handles.
-  auto s =
-      rocksdb::DB::Open(options_, path_, column_families_, &handles_, &db_);
-
-  if (s.IsCorruption()) {
-    // The database is corrupt - try to repair it
-    repairDB();
+  read_only_ = FLAGS_database_read_only;
+  rocksdb::Status s;
+  if (!read_only_) {
     s = rocksdb::DB::Open(options_, path_, column_families_, &handles_, &db_);
+
+    if (s.IsCorruption()) {
+      // The database is corrupt - try to repair it
+      repairDB();
+      s = rocksdb::DB::Open(
+          options_, path_, column_families_, &handles_, &db_);
+    }
+
+    // The shell may inspect the database of a running daemon.
+    if (s.IsIOError() && isShell() &&
+        s.ToString().find("lock") != std::string::npos) {
+      LOG(WARNING) << "RocksDB is in use by another process, reading it "
+                      "without writing: "
+                   << path_;
+      read_only_ = true;
+    }
+  }
+
+  if (read_only_) {
+    s = openSecondary();
   }
 
   if (!s.ok() || db_ == nullptr) {
@@ -185,13 +460,38 @@ Status RocksDBDatabasePlugin::setUp() {
     return Status(1, s.ToString());
   }
 
+  if (read_only_) {
+    // The primary owns the files, and compacts them.
+    return Status::success();
+  }
+
   // RocksDB may not create/append a directory with acceptable permissions.
   if (platformSetSafeDbPerms(path_) == false) {
     return Status(1, "Cannot set permissions on RocksDB path: " + path_);
   }
 
+  if (FLAGS_rocksdb_write_combine_ms > 0) {
+    write_queue_ = std::make_unique<RocksDBWriteQueue>(
+        db_,
+        std::chrono::milliseconds(FLAGS_rocksdb_write_combine_ms),
+        static_cast<size_t>(FLAGS_rocksdb_write_combine_bytes));
+  }
+
+  // Large databases take minutes to compact, do not wait for them.
+  stop_compaction_ = false;
+  compaction_thread_ = std::thread([this]() { compactDomains(); });
+
+  return Status(0);
+}
+
+void RocksDBDatabasePlugin::compactDomains() {
   for (const auto& cf_name : kDomains) {
-    if (cf_name != kEvents) {
+    if (stop_compaction_) {
+      return;
+    }
+
+    // Universal compaction keeps the write-heavy domains compacted.
+    if (!isWriteHeavyDomain(cf_name)) {
       auto compact_status = compactFiles(cf_name);
       if (!compact_status.ok()) {
         LOG(INFO) << "Cannot compact column family " << cf_name << ": "
@@ -199,8 +499,62 @@ Status RocksDBDatabasePlugin::setUp() {
       }
     }
   }
+}
 
-  return Status(0);
+void RocksDBDatabasePlugin::stopCompaction() {
+  if (!compaction_thread_.joinable()) {
+    return;
+  }
+
+  // Manual compactions return early once they are paused.
+  stop_compaction_ = true;
+  if (db_ != nullptr) {
+    db_->DisableManualCompaction();
+  }
+  compaction_thread_.join();
+}
+
+rocksdb::Status RocksDBDatabasePlugin::openSecondary() {
+  secondary_path_ =
+      (fs::temp_directory_path() /
+       fs::unique_path("osquery.secondary.%%%%.%%%%.%%%%.%%%%"))
+          .string();
+
+  rocksdb::Options options(options_);
+  options.create_if_missing = false;
+  options.create_missing_column_families = false;
+
+  // Secondary instances keep every file of the primary open.
+  options.max_open_files = -1;
+
+  VLOG(1) << "Opening RocksDB handle as a secondary instance: " << path_;
+  return rocksdb::DB::OpenAsSecondary(
+      options, path_, secondary_path_, column_families_, &handles_, &db_);
+}
+
+void RocksDBDatabasePlugin::catchUpWithPrimary() const {
+  if (!read_only_ || getDB() == nullptr) {
+    return;
+  }
+
+  WriteLock lock(catch_up_mutex_);
+  auto now = std::chrono::steady_clock::now();
+  if (now - caught_up_ < kRocksDBCatchUpInterval) {
+    return;
+  }
+  caught_up_ = now;
+
+  auto s = getDB()->TryCatchUpWithPrimary();
+  if (!s.ok()) {
+    VLOG(1) << "Cannot read the recent RocksDB writes: " << s.ToString();
+  }
+}
+
+Status RocksDBDatabasePlugin::checkWritable() const {
+  if (read_only_) {
+    return Status::failure("Database is opened read-only: " + path_);
+  }
+  return Status::success();
 }
 
 Status RocksDBDatabasePlugin::compactFiles(const std::string& domain) {
@@ -221,6 +575,10 @@ Status RocksDBDatabasePlugin::compactFiles(const std::string& domain) {
       input_file_names.push_back(file.name);
     }
 
+    if (stop_compaction_) {
+      return Status::success();
+    }
+
     if (!input_file_names.empty()) {
       auto s = db_->CompactFiles(
           rocksdb::CompactionOptions(), handle, input_file_names, level.level);
@@ -230,17 +588,155 @@ Status RocksDBDatabasePlugin::compactFiles(const std::string& domain) {
     }
   }
 
-  db_->CompactRange(rocksdb::CompactRangeOptions(), handle, nullptr, nullptr);
+  // Automatic compactions of the other domains continue meanwhile.
+  rocksdb::CompactRangeOptions options;
+  options.exclusive_manual_compaction = false;
+  db_->CompactRange(options, handle, nullptr, nullptr);
+
+  return Status::success();
+}
+
+rocksdb::ColumnFamilyOptions RocksDBDatabasePlugin::getDomainOptions(
+    const std::string& domain) {
+  rocksdb::ColumnFamilyOptions options(options_);
+  if (!isWriteHeavyDomain(domain) && !isReadMostlyDomain(domain)) {
+    return options;
+  }
+
+  rocksdb::BlockBasedTableOptions table_options;
+  table_options.block_cache = block_cache_;
+  table_options.cache_index_and_filter_blocks = true;
+  table_options.pin_l0_filter_and_index_blocks_in_cache = true;
+  table_options.filter_policy.reset(
+      rocksdb::NewBloomFilterPolicy(kRocksDBBloomBitsPerKey));
+
+  if (isWriteHeavyDomain(domain)) {
+    // Keys are written in order and expire in order, universal compaction
+    // rewrites them far less than leveled compaction. FIFO compaction would
+    // also drop the index and counter keys sharing these domains.
+    options.compaction_style = rocksdb::kCompactionStyleUniversal;
+    options.compression = rocksdb::kZSTD;
+
+    // Rows repeat the same column names, paths and command lines, which
+    // compress poorly one block at a time. Compactions train a dictionary
+    // from samples of each file they write and store it in that file.
+    auto dictionary_size =
+        static_cast<uint32_t>(FLAGS_rocksdb_compression_dictionary_size);
+    options.compression_opts.max_dict_bytes = dictionary_size;
+    options.compression_opts.zstd_max_train_bytes =
+        dictionary_size * kRocksDBDictionaryTrainRatio;
+
+    // Event data is scanned for each subscriber, buffered logs for each
+    // logger plugin and log type.
+    std::shared_ptr<const DomainKeyPrefix> prefix;
+    if (domain == kEvents) {
+      prefix = std::make_shared<DomainKeyPrefix>(
+          "osquery.EventsKeyPrefix", '.', 1, "data.", 3);
+    } else {
+      prefix =
+          std::make_shared<DomainKeyPrefix>("osquery.LogsKeyPrefix", '_', 2);
+    }
+
+    prefixes_[domain] = prefix;
+    options.prefix_extractor = prefix;
+    options.memtable_prefix_bloom_size_ratio = kRocksDBMemtableBloomRatio;
+
+    auto ttl = (domain == kEvents) ? FLAGS_rocksdb_events_ttl
+                                   : FLAGS_rocksdb_logs_ttl;
+    if (ttl > 0) {
+      auto ttl_filter = std::make_unique<const DomainTTLFilter>(
+          (domain == kEvents) ? "osquery.EventsTTL" : "osquery.LogsTTL",
+          ttl,
+          (domain == kEvents) ? getEventKeyTime : getLogKeyTime);
+
+      // Files are compacted at least once per TTL even without new writes,
+      // for example when a domain has reached its quota.
+      options.compaction_filter = ttl_filter.get();
+      options.periodic_compaction_seconds = ttl;
+      ttl_filters_[domain] = std::move(ttl_filter);
+    }
+  }
+
+  options.table_factory.reset(
+      rocksdb::NewBlockBasedTableFactory(table_options));
+  return options;
+}
+
+Status RocksDBDatabasePlugin::checkDomainQuota(
+    const std::string& domain, const DatabaseStringValueList& data) {
+  auto it = quotas_.find(domain);
+  if (it == quotas_.end()) {
+    return Status::success();
+  }
+
+  auto& quota = it->second;
+  uint64_t batch_size = 0;
+  bool counted = false;
+  for (const auto& p : data) {
+    batch_size += p.first.size() + p.second.size();
+    counted = counted || p.first.compare(0,
+                                         quota.key_prefix.size(),
+                                         quota.key_prefix) == 0;
+  }
+
+  if (!counted) {
+    return Status::success();
+  }
+
+  WriteLock lock(quota_mutex_);
+  auto now = std::chrono::steady_clock::now();
+  if (now - quota.refreshed >= kRocksDBQuotaRefresh) {
+    auto cfh = getHandleForColumnFamily(domain);
+    uint64_t sst_size = 0;
+    uint64_t memtables_size = 0;
+    if (cfh != nullptr) {
+      getDB()->GetIntProperty(
+          cfh, rocksdb::DB::Properties::kTotalSstFilesSize, &sst_size);
+      getDB()->GetIntProperty(
+          cfh, rocksdb::DB::Properties::kCurSizeAllMemTables, &memtables_size);
+    }
+    quota.usage = sst_size + memtables_size;
+    quota.refreshed = now;
+  }
+
+  if (quota.usage >= quota.bytes) {
+    if (!quota.exceeded) {
+      LOG(WARNING) << "RocksDB domain " << domain << " reached its quota of "
+                   << quota.bytes << " bytes, refusing new writes";
+      quota.exceeded = true;
+    }
+    return Status::failure("Database domain quota exceeded: " + domain);
+  }
+
+  if (quota.exceeded) {
+    LOG(INFO) << "RocksDB domain " << domain << " is below its quota";
+    quota.exceeded = false;
+  }
 
+  // Count the batch until the next size reading.
+  quota.usage += batch_size;
   return Status::success();
 }
 
+const DomainKeyPrefix* RocksDBDatabasePlugin::getDomainPrefix(
+    const std::string& domain) const {
+  auto it = prefixes_.find(domain);
+  return (it != prefixes_.end()) ? it->second.get() : nullptr;
+}
+
 void RocksDBDatabasePlugin::tearDown() {
   close();
 }
 
 void RocksDBDatabasePlugin::close() {
   WriteLock lock(close_mutex_);
+
+  // The startup compaction uses the handles.
+  stopCompaction();
+
+  // Commit the combined writes before the handles are released.
+  write_queue_.reset();
+
   for (auto handle : handles_) {
     delete handle;
   }
@@ -251,8 +747,16 @@ void RocksDBDatabasePlugin::close() {
     db_ = nullptr;
   }
 
+  if (!secondary_path_.empty()) {
+    removePath(secondary_path_);
+    secondary_path_.clear();
+  }
+
+  // The database of another process is never moved.
   if (isCorrupted()) {
-    repairDB();
+    if (!read_only_) {
+      repairDB();
+    }
     setCorrupted(false);
   }
 }
@@ -312,6 +816,8 @@ Status RocksDBDatabasePlugin::get(const std::string& domain,
   if (cfh == nullptr) {
     return Status(1, "Could not get column family for " + domain);
   }
+
+  catchUpWithPrimary();
   auto s = getDB()->Get(rocksdb::ReadOptions(), cfh, key, &value);
   return Status(s.code(), s.ToString());
 }
@@ -343,11 +849,25 @@ inline bool skipWal(const std::string& domain) {
 
 Status RocksDBDatabasePlugin::putBatch(const std::string& domain,
                                        const DatabaseStringValueList& data) {
+  if (write_queue_ != nullptr) {
+    return putBatchAsync(domain, data).get();
+  }
+
+  auto writable = checkWritable();
+  if (!writable.ok()) {
+    return writable;
+  }
+
   auto cfh = getHandleForColumnFamily(domain);
   if (cfh == nullptr) {
     return Status(1, "Could not get column family for " + domain);
   }
 
+  auto quota_status = checkDomainQuota(domain, data);
+  if (!quota_status.ok()) {
+    return quota_status;
+  }
+
   // Events should be fast, and do not need to force syncs.
   auto options = rocksdb::WriteOptions();
   if (skipWal(domain)) {
@@ -364,18 +884,42 @@ Status RocksDBDatabasePlugin::putBatch(const std::string& domain,
     batch.Put(cfh, key, value);
   }
 
-  auto s = getDB()->Write(options, &batch);
-  if (s.code() != 0 && s.IsIOError()) {
-    // An error occurred, check if it is an IO error and remove the offending
-    // specific filename or log name.
-    std::string error_string = s.ToString();
-    size_t error_pos = error_string.find_last_of(":");
-    if (error_pos != std::string::npos) {
-      return Status(s.code(), "IOError: " + error_string.substr(error_pos + 2));
-    }
+  return getRocksDBWriteStatus(getDB()->Write(options, &batch));
+}
+
+std::future<Status> RocksDBDatabasePlugin::putBatchAsync(
+    const std::string& domain, const DatabaseStringValueList& data) {
+  if (write_queue_ == nullptr) {
+    return DatabasePlugin::putBatchAsync(domain, data);
   }
 
-  return Status(s.code(), s.ToString());
+  auto writable = checkWritable();
+  if (!writable.ok()) {
+    std::promise<Status> promise;
+    promise.set_value(std::move(writable));
+    return promise.get_future();
+  }
+
+  auto cfh = getHandleForColumnFamily(domain);
+  if (cfh == nullptr) {
+    std::promise<Status> promise;
+    promise.set_value(Status(1, "Could not get column family for " + domain));
+    return promise.get_future();
+  }
+
+  auto quota_status = checkDomainQuota(domain, data);
+  if (!quota_status.ok()) {
+    std::promise<Status> promise;
+    promise.set_value(std::move(quota_status));
+    return promise.get_future();
+  }
+
+  return write_queue_->write(skipWal(domain),
+                             [cfh, &data](rocksdb::WriteBatch& batch) {
+                               for (const auto& p : data) {
+                                 batch.Put(cfh, p.first, p.second);
+                               }
+                             });
 }
 
 Status RocksDBDatabasePlugin::put(const std::string& domain,
@@ -386,12 +930,27 @@ Status RocksDBDatabasePlugin::put(const std::string& domain,
 
 Status RocksDBDatabasePlugin::remove(const std::string& domain,
                                      const std::string& key) {
+  auto writable = checkWritable();
+  if (!writable.ok()) {
+    return writable;
+  }
+
   auto cfh = getHandleForColumnFamily(domain);
   if (cfh == nullptr) {
     return Status(1, "Could not get column family for " + domain);
   }
   auto options = rocksdb::WriteOptions();
 
+  if (write_queue_ != nullptr) {
+    // Queued puts of the same key must not be committed after the delete.
+    return write_queue_
+        ->write(skipWal(domain),
+                [cfh, &key](rocksdb::WriteBatch& batch) {
+                  batch.Delete(cfh, key);
+                })
+        .get();
+  }
+
   // We could sync here, but large deletes will cause multi-syncs.
   // For example: event record expirations found in an expired index.
   if (skipWal(domain)) {
@@ -412,12 +971,27 @@ Status RocksDBDatabasePlugin::removeRange(const std::string& domain,
     return Status::failure("Invalid range: low > high");
   }
 
+  auto writable = checkWritable();
+  if (!writable.ok()) {
+    return writable;
+  }
+
   auto cfh = getHandleForColumnFamily(domain);
   if (cfh == nullptr) {
     return Status(1, "Could not get column family for " + domain);
   }
   auto options = rocksdb::WriteOptions();
 
+  if (write_queue_ != nullptr) {
+    return write_queue_
+        ->write(skipWal(domain),
+                [cfh, &low, &high](rocksdb::WriteBatch& batch) {
+                  batch.DeleteRange(cfh, low, high);
+                  batch.Delete(cfh, high);
+                })
+        .get();
+  }
+
   // We could sync here, but large deletes will cause multi-syncs.
   // For example: event record expirations found in an expired index.
   if (skipWal(domain)) {
@@ -432,6 +1006,32 @@ Status RocksDBDatabasePlugin::removeRange(const std::string& domain,
   return Status(s.code(), s.ToString());
 }
 
+std::unique_ptr<rocksdb::Iterator> RocksDBDatabasePlugin::newPrefixIterator(
+    rocksdb::ColumnFamilyHandle* cfh,
+    const std::string& domain,
+    const std::string& prefix,
+    const std::string& start) const {
+  auto options = rocksdb::ReadOptions();
+  options.verify_checksums = false;
+  options.fill_cache = false;
+
+  // Prefixes that include a complete domain prefix may skip SST files using
+  // the prefix bloom filters, any other prefix is scanned in total order.
+  auto domain_prefix = getDomainPrefix(domain);
+  if (domain_prefix != nullptr && domain_prefix->InDomain(prefix)) {
+    options.prefix_same_as_start = true;
+  } else {
+    options.total_order_seek = true;
+  }
+
+  catchUpWithPrimary();
+  std::unique_ptr<rocksdb::Iterator> it(getDB()->NewIterator(options, cfh));
+  if (it != nullptr) {
+    it->Seek(start);
+  }
+  return it;
+}
+
 Status RocksDBDatabasePlugin::scan(const std::string& domain,
                                    std::vector<std::string>& results,
                                    const std::string& prefix,
@@ -444,25 +1044,166 @@ Status RocksDBDatabasePlugin::scan(const std::string& domain,
   if (cfh == nullptr) {
     return Status(1, "Could not get column family for " + domain);
   }
-  auto options = rocksdb::ReadOptions();
-  options.verify_checksums = false;
-  options.fill_cache = false;
-  auto it = getDB()->NewIterator(options, cfh);
+
+  auto it = newPrefixIterator(cfh, domain, prefix, prefix);
   if (it == nullptr) {
     return Status(1, "Could not get iterator for " + domain);
   }
 
   size_t count = 0;
-  for (it->SeekToFirst(); it->Valid(); it->Next()) {
-    auto key = it->key().ToString();
-    if (key.find(prefix) == 0) {
-      results.push_back(std::move(key));
-      if (max > 0 && ++count >= max) {
-        break;
-      }
+  for (; it->Valid() && it->key().starts_with(prefix); it->Next()) {
+    results.push_back(it->key().ToString());
+    if (max > 0 && ++count >= max) {
+      break;
+    }
+  }
+  return Status::success();
+}
+
+Status RocksDBDatabasePlugin::scanValues(const std::string& domain,
+                                         const std::string& prefix,
+                                         const std::string& resume,
+                                         uint64_t max,
+                                         const DatabaseScanCallback& callback,
+                                         std::string& next_key) const {
+  next_key.clear();
+  if (getDB() == nullptr) {
+    return Status(1, "Database not opened");
+  }
+
+  auto cfh = getHandleForColumnFamily(domain);
+  if (cfh == nullptr) {
+    return Status(1, "Could not get column family for " + domain);
+  }
+
+  auto it = newPrefixIterator(
+      cfh, domain, prefix, (resume > prefix) ? resume : prefix);
+  if (it == nullptr) {
+    return Status(1, "Could not get iterator for " + domain);
+  }
+
+  // The buffers are reused, so only keys and values larger than all the
+  // previous ones allocate.
+  std::string key;
+  std::string value;
+  uint64_t count = 0;
+  bool stopped = false;
+  for (; it->Valid() && it->key().starts_with(prefix); it->Next()) {
+    if (stopped || (max > 0 && count >= max)) {
+      next_key = it->key().ToString();
+      break;
     }
+
+    key.assign(it->key().data(), it->key().size());
+    value.assign(it->value().data(), it->value().size());
+    ++count;
+    stopped = !callback(key, value);
   }
-  delete it;
+
+  if (!it->status().ok()) {
+    return Status(1, it->status().ToString());
+  }
+  return Status::success();
+}
+
+static std::string getCompressionName(rocksdb::CompressionType compression) {
+  switch (compression) {
+  case rocksdb::kNoCompression:
+    return "none";
+  case rocksdb::kSnappyCompression:
+    return "snappy";
+  case rocksdb::kZlibCompression:
+    return "zlib";
+  case rocksdb::kLZ4Compression:
+    return "lz4";
+  case rocksdb::kZSTD:
+    return "zstd";
+  default:
+    return "other";
+  }
+}
+
+static std::string getCompactionName(rocksdb::CompactionStyle style) {
+  switch (style) {
+  case rocksdb::kCompactionStyleLevel:
+    return "level";
+  case rocksdb::kCompactionStyleUniversal:
+    return "universal";
+  case rocksdb::kCompactionStyleFIFO:
+    return "fifo";
+  default:
+    return "none";
+  }
+}
+
+Status RocksDBDatabasePlugin::stats(PluginResponse& results) const {
+  if (getDB() == nullptr) {
+    return Status(1, "Database not opened");
+  }
+
+  for (const auto& domain : kDomains) {
+    auto cfh = getHandleForColumnFamily(domain);
+    if (cfh == nullptr) {
+      continue;
+    }
+
+    PluginRequest row;
+    row["domain"] = domain;
+
+    auto add = [this, cfh, &row](const std::string& column,
+                                 const std::string& property) {
+      uint64_t value = 0;
+      getDB()->GetIntProperty(cfh, property, &value);
+      row[column] = std::to_string(value);
+    };
+    add("keys", rocksdb::DB::Properties::kEstimateNumKeys);
+    add("sst_files_size", rocksdb::DB::Properties::kTotalSstFilesSize);
+    add("memtables_size", rocksdb::DB::Properties::kCurSizeAllMemTables);
+    add("table_readers_size",
+        rocksdb::DB::Properties::kEstimateTableReadersMem);
+    add("pending_compaction_size",
+        rocksdb::DB::Properties::kEstimatePendingCompactionBytes);
+
+    rocksdb::ColumnFamilyMetaData cf_meta;
+    getDB()->GetColumnFamilyMetaData(cfh, &cf_meta);
+    row["sst_files"] = std::to_string(cf_meta.file_count);
+
+    auto options = getDB()->GetOptions(cfh);
+    row["compaction"] = getCompactionName(options.compaction_style);
+    row["compression"] = getCompressionName(options.compression);
+    row["prefix_bloom"] = (options.prefix_extractor != nullptr) ? "1" : "0";
+    results.push_back(std::move(row));
+  }
+
+  return Status::success();
+}
+
+Status RocksDBDatabasePlugin::memoryUsage(uint64_t& bytes) const {
+  if (getDB() == nullptr) {
+    return Status(1, "Database not opened");
+  }
+
+  bytes = (block_cache_ != nullptr) ? block_cache_->GetUsage() : 0;
+
+  // Memtables charged to the block cache are already counted.
+  bool charged = options_.write_buffer_manager != nullptr;
+  for (const auto& domain : kDomains) {
+    auto cfh = getHandleForColumnFamily(domain);
+    if (cfh == nullptr) {
+      continue;
+    }
+
+    auto add = [this, cfh, &bytes](const std::string& property) {
+      uint64_t value = 0;
+      getDB()->GetIntProperty(cfh, property, &value);
+      bytes += value;
+    };
+    if (!charged) {
+      add(rocksdb::DB::Properties::kSizeAllMemTables);
+    }
+    add(rocksdb::DB::Properties::kEstimateTableReadersMem);
+  }
+
   return Status::success();
 }
 } // namespace osquery
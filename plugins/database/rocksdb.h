@@ -8,12 +8,21 @@
  */
 
 #include <atomic>
-
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <rocksdb/cache.h>
+#include <rocksdb/compaction_filter.h>
 #include <rocksdb/db.h>
+#include <rocksdb/slice_transform.h>
 
 #include <osquery/core/core.h>
 #include <osquery/database/database.h>
 #include <osquery/utils/mutex.h>
+#include <plugins/database/rocksdb_write_queue.h>
 
 #include <gtest/gtest_prod.h>
 
@@ -34,6 +43,74 @@ class GlogRocksDBLogger : public rocksdb::Logger {
   void Logv(const char* format, va_list ap) override;
 };
 
+/**
+ * @brief Extract key prefixes for the prefix bloom filters of a domain.
+ *
+ * The prefix of a key ends with the nth delimiter, keys with fewer delimiters
+ * have no prefix. Keys starting with a nested prefix may use a different
+ * delimiter count, for example events use "data.<type>.<name>." for event
+ * data and "eid." or "indexes." for everything else.
+ */
+class DomainKeyPrefix : public rocksdb::SliceTransform {
+ public:
+  DomainKeyPrefix(std::string name,
+                  char delimiter,
+                  size_t delimiters,
+                  std::string nested_prefix = "",
+                  size_t nested_delimiters = 0);
+
+  const char* Name() const override;
+
+  rocksdb::Slice Transform(const rocksdb::Slice& key) const override;
+
+  bool InDomain(const rocksdb::Slice& key) const override;
+
+ private:
+  /// The length of the prefix of a key, 0 if it has no prefix.
+  size_t prefixLength(const rocksdb::Slice& key) const;
+
+ private:
+  std::string name_;
+  char delimiter_;
+  size_t delimiters_;
+  std::string nested_prefix_;
+  size_t nested_delimiters_;
+};
+
+/**
+ * @brief Drop keys older than a time to live while they are compacted.
+ *
+ * Expiring keys this way writes no tombstones, the keys are removed when
+ * RocksDB compacts their files. Keys without a time are always kept, for
+ * example the event counters and indexes sharing the events domain.
+ */
+class DomainTTLFilter : public rocksdb::CompactionFilter {
+ public:
+  /// Read the unix time of a key, false if the key has no time.
+  using KeyTime = bool (*)(const rocksdb::Slice& key, uint64_t& time);
+
+  DomainTTLFilter(std::string name, uint64_t ttl, KeyTime key_time);
+
+  bool Filter(int level,
+              const rocksdb::Slice& key,
+              const rocksdb::Slice& existing_value,
+              std::string* new_value,
+              bool* value_changed) const override;
+
+  const char* Name() const override;
+
+ private:
+  std::string name_;
+  uint64_t ttl_;
+  KeyTime key_time_;
+};
+
+/// The time of an event data key, the end of its bucket.
+bool getEventKeyTime(const rocksdb::Slice& key, uint64_t& time);
+
+/// The time of a buffered result or status log key.
+bool getLogKeyTime(const rocksdb::Slice& key, uint64_t& time);
+
 class RocksDBDatabasePlugin : public DatabasePlugin {
  public:
   /// Data retrieval method.
@@ -57,6 +134,10 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
   Status putBatch(const std::string& domain,
                   const DatabaseStringValueList& data) override;
 
+  /// Combine the batch with the writes of other threads, if enabled.
+  std::future<Status> putBatchAsync(
+      const std::string& domain, const DatabaseStringValueList& data) override;
+
   /// Data removal method.
   Status remove(const std::string& domain, const std::string& k) override;
 
@@ -71,6 +152,20 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
               const std::string& prefix,
               uint64_t max) const override;
 
+  /// Key and value iteration, reading values from the same iterator.
+  Status scanValues(const std::string& domain,
+                    const std::string& prefix,
+                    const std::string& resume,
+                    uint64_t max,
+                    const DatabaseScanCallback& callback,
+                    std::string& next_key) const override;
+
+  /// Column family statistics for each domain.
+  Status stats(PluginResponse& results) const override;
+
+  /// Bytes of the block cache, memtables and SST readers.
+  Status memoryUsage(uint64_t& bytes) const override;
+
  public:
   /// Database workflow: open and setup.
   Status setUp() override;
@@ -87,6 +182,20 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
   /// Obtain a close lock and release resources.
   void close();
 
+  /**
+   * @brief Open the database as a secondary instance of its writer.
+   *
+   * Secondary instances do not take the database lock. They read the files
+   * of the primary and keep their own logs in a temporary directory.
+   */
+  rocksdb::Status openSecondary();
+
+  /// Read the recent writes of the primary, at most once per second.
+  void catchUpWithPrimary() const;
+
+  /// Writes are refused by read-only secondary instances.
+  Status checkWritable() const;
+
   /**
    * @brief Private helper around accessing the column family handle for a
    * specific column family, based on its name
@@ -105,6 +214,47 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
   /// Request RocksDB compact each domain and level to that same level.
   Status compactFiles(const std::string& domain);
 
+  /**
+   * @brief Compact the domains once after the database is opened.
+   *
+   * This runs in the background, setUp returns before it completes. The
+   * writes are limited by rocksdb_compaction_rate_mb.
+   */
+  void compactDomains();
+
+  /// Pause the manual compactions and wait for compactDomains.
+  void stopCompaction();
+
+  /**
+   * @brief Column family options tuned for the workload of a domain.
+   *
+   * Write-heavy domains (events and logs) use universal compaction, ZSTD
+   * compression and prefix bloom filters. Read-mostly domains (queries and
+   * configurations) use whole key bloom filters. Other domains use options_.
+   */
+  rocksdb::ColumnFamilyOptions getDomainOptions(const std::string& domain);
+
+  /// Iterate the keys starting with a prefix, from a start key.
+  std::unique_ptr<rocksdb::Iterator> newPrefixIterator(
+      rocksdb::ColumnFamilyHandle* cfh,
+      const std::string& domain,
+      const std::string& prefix,
+      const std::string& start) const;
+
+  /// The prefix extractor of a domain, if it has prefix bloom filters.
+  const DomainKeyPrefix* getDomainPrefix(const std::string& domain) const;
+
+  /**
+   * @brief Refuse writes to a domain that has used its quota.
+   *
+   * Only batches with a key in the quota key space are refused, so removals
+   * and the bookkeeping keys of a full domain are still written. The size
+   * of a domain is read at most once per second, the writes in between are
+   * added to the last reading.
+   */
+  Status checkDomainQuota(const std::string& domain,
+                          const DatabaseStringValueList& data);
+
   /**
    * @brief Helper method to repair a corrupted db. Best effort only.
    *
@@ -145,6 +295,55 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
   /// The RocksDB connection options that are used to connect to RocksDB
   rocksdb::Options options_;
 
+  /// Block cache shared by all column families, see database_memory_limit.
+  std::shared_ptr<rocksdb::Cache> block_cache_;
+
+  /// Opened as a secondary instance, see openSecondary.
+  bool read_only_{false};
+
+  /// Directory of the logs of a secondary instance.
+  std::string secondary_path_;
+
+  /// The last time a secondary instance read the writes of the primary.
+  mutable std::chrono::steady_clock::time_point caught_up_;
+
+  /// Protects caught_up_.
+  mutable Mutex catch_up_mutex_;
+
+  /// Runs compactDomains after the database is opened.
+  std::thread compaction_thread_;
+
+  /// Ask compactDomains to return before compacting the next domain.
+  std::atomic<bool> stop_compaction_{false};
+
+  /// Combines writes from many threads, when rocksdb_write_combine_ms is set.
+  std::unique_ptr<RocksDBWriteQueue> write_queue_;
+
+  /// Prefix extractors of the domains with prefix bloom filters.
+  std::map<std::string, std::shared_ptr<const DomainKeyPrefix>> prefixes_;
+
+  /// Time to live filters of the domains with a TTL, used by compactions.
+  std::map<std::string, std::unique_ptr<const DomainTTLFilter>> ttl_filters_;
+
+  /// The byte quota of a domain and its last known size.
+  struct DomainQuota {
+    /// Quota in bytes of SST files and memtables.
+    uint64_t bytes{0};
+
+    /// Batches with a key starting with this prefix count against the quota.
+    std::string key_prefix;
+
+    uint64_t usage{0};
+    std::chrono::steady_clock::time_point refreshed;
+    bool exceeded{false};
+  };
+
+  /// Quotas of the domains with a byte quota.
+  std::map<std::string, DomainQuota> quotas_;
+
+  /// Protects the quota usage.
+  Mutex quota_mutex_;
+
   /// Deconstruction mutex.
   Mutex close_mutex_;
 
@@ -152,5 +351,12 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
   friend class GlogRocksDBLogger;
   FRIEND_TEST(RocksDBDatabasePluginTests, test_corruption);
   FRIEND_TEST(RocksDBDatabasePluginTests, test_column_families_rollback);
+  FRIEND_TEST(RocksDBDatabasePluginTests, test_domain_options);
+  FRIEND_TEST(RocksDBDatabasePluginTests, test_write_combining);
+  FRIEND_TEST(RocksDBDatabasePluginTests, test_domain_ttl);
+  FRIEND_TEST(RocksDBDatabasePluginTests, test_domain_quota);
+  FRIEND_TEST(RocksDBDatabasePluginTests, test_read_only_secondary);
+  FRIEND_TEST(RocksDBDatabasePluginTests, test_background_compaction);
+  FRIEND_TEST(RocksDBDatabasePluginTests, test_memory_limit);
 };
 } // namespace osquery
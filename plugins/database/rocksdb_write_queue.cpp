@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <plugins/database/rocksdb_write_queue.h>
+
+namespace osquery {
+
+Status getRocksDBWriteStatus(const rocksdb::Status& s) {
+  if (s.code() != 0 && s.IsIOError()) {
+    // An error occurred, check if it is an IO error and remove the offending
+    // specific filename or log name.
+    std::string error_string = s.ToString();
+    size_t error_pos = error_string.find_last_of(":");
+    if (error_pos != std::string::npos) {
+      return Status(s.code(), "IOError: " + error_string.substr(error_pos + 2));
+    }
+  }
+
+  return Status(s.code(), s.ToString());
+}
+
+RocksDBWriteQueue::RocksDBWriteQueue(rocksdb::DB* db,
+                                     std::chrono::milliseconds window,
+                                     std::size_t max_batch_size)
+    : db_(db),
+      window_(window),
+      max_batch_size_(max_batch_size),
+      wal_batch_(std::make_unique<Batch>()),
+      no_wal_batch_(std::make_unique<Batch>()) {
+  thread_ = std::thread([this]() { work(); });
+}
+
+RocksDBWriteQueue::~RocksDBWriteQueue() {
+  stop();
+}
+
+std::future<Status> RocksDBWriteQueue::write(bool disable_wal,
+                                             const BatchFiller& fill) {
+  std::promise<Status> promise;
+  auto future = promise.get_future();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (stopping_) {
+    promise.set_value(Status::failure("Database write queue stopped"));
+    return future;
+  }
+
+  auto& pending = disable_wal ? no_wal_batch_ : wal_batch_;
+  fill(pending->batch);
+  pending->promises.push_back(std::move(promise));
+
+  // The writer waits for the first write, and for large batches.
+  if (pending->promises.size() == 1 || queuedSize() >= max_batch_size_) {
+    cv_.notify_one();
+  }
+  return future;
+}
+
+void RocksDBWriteQueue::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_one();
+
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void RocksDBWriteQueue::work() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    cv_.wait(lock, [this]() {
+      return stopping_ || !wal_batch_->promises.empty() ||
+             !no_wal_batch_->promises.empty();
+    });
+
+    if (wal_batch_->promises.empty() && no_wal_batch_->promises.empty()) {
+      // Stopping with nothing left to commit.
+      return;
+    }
+
+    // Collect the writes of other threads, unless the batch is large enough.
+    cv_.wait_for(lock, window_, [this]() {
+      return stopping_ || queuedSize() >= max_batch_size_;
+    });
+
+    auto wal_batch = std::make_unique<Batch>();
+    auto no_wal_batch = std::make_unique<Batch>();
+    wal_batch.swap(wal_batch_);
+    no_wal_batch.swap(no_wal_batch_);
+
+    lock.unlock();
+    commit(*wal_batch, false);
+    commit(*no_wal_batch, true);
+    lock.lock();
+  }
+}
+
+std::size_t RocksDBWriteQueue::queuedSize() const {
+  return wal_batch_->batch.GetDataSize() + no_wal_batch_->batch.GetDataSize();
+}
+
+void RocksDBWriteQueue::commit(Batch& batch, bool disable_wal) {
+  if (batch.promises.empty()) {
+    return;
+  }
+
+  auto options = rocksdb::WriteOptions();
+  if (disable_wal) {
+    options.disableWAL = true;
+  } else {
+    options.sync = false;
+  }
+
+  auto status = getRocksDBWriteStatus(db_->Write(options, &batch.batch));
+  for (auto& promise : batch.promises) {
+    promise.set_value(status);
+  }
+}
+
+} // namespace osquery
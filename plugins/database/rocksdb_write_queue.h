@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <rocksdb/db.h>
+#include <rocksdb/write_batch.h>
+
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// Convert the status of a RocksDB write, shortening IO errors.
+Status getRocksDBWriteStatus(const rocksdb::Status& s);
+
+/**
+ * @brief Combine the writes of many threads into few RocksDB write batches.
+ *
+ * A background writer waits for the first queued write, then collects the
+ * writes queued during a short window, and commits them as one batch. Each
+ * write returns a future that completes once its batch is committed, callers
+ * that need the write to be durable wait for it.
+ *
+ * Writes with and without the write-ahead log are committed as separate
+ * batches. Writes queued by one thread are committed in order.
+ */
+class RocksDBWriteQueue : private boost::noncopyable {
+ public:
+  using BatchFiller = std::function<void(rocksdb::WriteBatch&)>;
+
+  /**
+   * @brief Start the background writer.
+   *
+   * @param db The database, it must outlive the queue.
+   * @param window How long the writer collects writes before a commit.
+   * @param max_batch_size Bytes after which a batch is committed without
+   * waiting for the window to close.
+   */
+  RocksDBWriteQueue(rocksdb::DB* db,
+                    std::chrono::milliseconds window,
+                    std::size_t max_batch_size);
+
+  /// Commits the queued writes and stops the writer, see stop.
+  ~RocksDBWriteQueue();
+
+  /**
+   * @brief Queue writes for the next batch.
+   *
+   * @param disable_wal Skip the write-ahead log, as the events domain does.
+   * @param fill Adds the writes to the batch, it is called before returning.
+   * @return The status of the batch commit.
+   */
+  std::future<Status> write(bool disable_wal, const BatchFiller& fill);
+
+  /// Commit the queued writes and stop the writer, later writes fail.
+  void stop();
+
+ private:
+  /// Writes collected for one commit.
+  struct Batch final {
+    rocksdb::WriteBatch batch;
+    std::vector<std::promise<Status>> promises;
+  };
+
+  /// The background writer loop.
+  void work();
+
+  /// Bytes queued in both batches.
+  std::size_t queuedSize() const;
+
+  /// Write a batch and complete its futures.
+  void commit(Batch& batch, bool disable_wal);
+
+ private:
+  rocksdb::DB* db_{nullptr};
+
+  const std::chrono::milliseconds window_;
+
+  const std::size_t max_batch_size_;
+
+  /// Writes waiting for a commit, with and without the write-ahead log.
+  std::unique_ptr<Batch> wal_batch_;
+  std::unique_ptr<Batch> no_wal_batch_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+
+  bool stopping_{false};
+
+  std::thread thread_;
+};
+
+} // namespace osquery
@@ -14,9 +14,19 @@
 
 #include <boost/filesystem.hpp>
 
+#include <ctime>
+#include <thread>
+
 namespace osquery {
 
 DECLARE_string(database_path);
+DECLARE_uint64(rocksdb_write_combine_ms);
+DECLARE_uint64(rocksdb_events_ttl);
+DECLARE_uint64(rocksdb_logs_ttl);
+DECLARE_uint64(rocksdb_logs_quota_mb);
+DECLARE_bool(database_read_only);
+DECLARE_uint64(rocksdb_compaction_rate_mb);
+DECLARE_uint64(database_memory_limit);
 
 class RocksDBDatabasePluginTests : public DatabasePluginTests {
  protected:
@@ -93,4 +103,347 @@ TEST_F(RocksDBDatabasePluginTests, test_column_families_rollback) {
   ASSERT_TRUE(s.ok()) << s.getMessage();
   db2.tearDown();
 }
+
+TEST_F(RocksDBDatabasePluginTests, test_domain_key_prefix) {
+  DomainKeyPrefix events("test", '.', 1, "data.", 3);
+  EXPECT_EQ("data.type.name.",
+            events.Transform("data.type.name.01.02").ToString());
+  EXPECT_EQ("eid.", events.Transform("eid.type.name").ToString());
+  EXPECT_TRUE(events.InDomain("data.type.name."));
+  EXPECT_FALSE(events.InDomain("data.type.name"));
+  EXPECT_FALSE(events.InDomain("data."));
+  EXPECT_FALSE(events.InDomain("eid"));
+
+  DomainKeyPrefix logs("test", '_', 2);
+  EXPECT_EQ("tls_r_", logs.Transform("tls_r_1600000000_1").ToString());
+  EXPECT_FALSE(logs.InDomain("tls"));
+}
+
+TEST_F(RocksDBDatabasePluginTests, test_domain_options) {
+  auto db = RocksDBDatabasePlugin();
+  const auto test_db_path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path(
+           "osquery.test_domain_options.%%%%.%%%%.%%%%.%%%%.db"))
+          .string();
+  FLAGS_database_path = test_db_path;
+
+  auto s = db.setUp();
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  db_dirs_.push_back(test_db_path);
+
+  auto events = db.db_->GetOptions(db.getHandleForColumnFamily(kEvents));
+  EXPECT_EQ(rocksdb::kCompactionStyleUniversal, events.compaction_style);
+  EXPECT_EQ(rocksdb::kZSTD, events.compression);
+  EXPECT_GT(events.compression_opts.max_dict_bytes, 0U);
+  EXPECT_GT(events.compression_opts.zstd_max_train_bytes,
+            events.compression_opts.max_dict_bytes);
+  EXPECT_NE(nullptr, events.prefix_extractor);
+
+  auto queries = db.db_->GetOptions(db.getHandleForColumnFamily(kQueries));
+  EXPECT_EQ(rocksdb::kCompactionStyleLevel, queries.compaction_style);
+  EXPECT_EQ(0U, queries.compression_opts.max_dict_bytes);
+  EXPECT_EQ(nullptr, queries.prefix_extractor);
+
+  // Prefix scans return the same keys with and without prefix blooms.
+  db.putBatch(kEvents,
+              {{"data.type.a.01.1", "1"},
+               {"data.type.a.02.2", "2"},
+               {"data.type.b.01.3", "3"},
+               {"eid.type.a", "2"},
+               {"indexes.type.a", ""}});
+
+  std::vector<std::string> keys;
+  EXPECT_TRUE(db.scan(kEvents, keys, "data.type.a.", 0).ok());
+  EXPECT_EQ(std::vector<std::string>({"data.type.a.01.1", "data.type.a.02.2"}),
+            keys);
+
+  keys.clear();
+  EXPECT_TRUE(db.scan(kEvents, keys, "data.type.a.02.", 0).ok());
+  EXPECT_EQ(std::vector<std::string>({"data.type.a.02.2"}), keys);
+
+  keys.clear();
+  EXPECT_TRUE(db.scan(kEvents, keys, "data.", 0).ok());
+  EXPECT_EQ(3U, keys.size());
+
+  keys.clear();
+  EXPECT_TRUE(db.scan(kEvents, keys, "", 0).ok());
+  EXPECT_EQ(5U, keys.size());
+
+  std::string value;
+  EXPECT_TRUE(db.get(kEvents, "eid.type.a", value).ok());
+  EXPECT_EQ("2", value);
+
+  PluginResponse stats;
+  EXPECT_TRUE(db.stats(stats).ok());
+  ASSERT_EQ(kDomains.size(), stats.size());
+  for (const auto& row : stats) {
+    if (row.at("domain") == kEvents) {
+      EXPECT_EQ("universal", row.at("compaction"));
+      EXPECT_EQ("zstd", row.at("compression"));
+      EXPECT_EQ("1", row.at("prefix_bloom"));
+    }
+  }
+
+  db.tearDown();
+}
+
+TEST_F(RocksDBDatabasePluginTests, test_write_combining) {
+  FLAGS_rocksdb_write_combine_ms = 5;
+  auto db = RocksDBDatabasePlugin();
+  const auto test_db_path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path(
+           "osquery.test_write_combining.%%%%.%%%%.%%%%.%%%%.db"))
+          .string();
+  FLAGS_database_path = test_db_path;
+
+  auto s = db.setUp();
+  FLAGS_rocksdb_write_combine_ms = 0;
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  db_dirs_.push_back(test_db_path);
+  ASSERT_NE(nullptr, db.write_queue_);
+
+  std::vector<std::thread> writers;
+  for (size_t i = 0; i < 4; ++i) {
+    writers.emplace_back([&db, i]() {
+      for (size_t j = 0; j < 50; ++j) {
+        auto key =
+            "test_combine_" + std::to_string(i) + "_" + std::to_string(j);
+        EXPECT_TRUE(db.putBatch(kQueries, {{key, "value"}}).ok());
+      }
+    });
+  }
+  for (auto& writer : writers) {
+    writer.join();
+  }
+
+  std::vector<std::string> keys;
+  EXPECT_TRUE(db.scan(kQueries, keys, "test_combine_", 0).ok());
+  EXPECT_EQ(200U, keys.size());
+
+  // Deletes are committed after the queued writes of the same key.
+  auto future = db.putBatchAsync(kEvents, {{"data.type.name.01.1", "1"}});
+  EXPECT_TRUE(db.remove(kEvents, "data.type.name.01.1").ok());
+  EXPECT_TRUE(future.get().ok());
+
+  std::string value;
+  db.get(kEvents, "data.type.name.01.1", value);
+  EXPECT_TRUE(value.empty());
+
+  future = db.putBatchAsync(kEvents, {{"data.type.name.01.2", "2"}});
+  EXPECT_TRUE(future.get().ok());
+  EXPECT_TRUE(db.get(kEvents, "data.type.name.01.2", value).ok());
+  EXPECT_EQ("2", value);
+
+  db.tearDown();
+}
+
+TEST_F(RocksDBDatabasePluginTests, test_domain_key_time) {
+  uint64_t time = 0;
+  EXPECT_TRUE(getEventKeyTime("data.type.name.0000000002.0000000001", time));
+  EXPECT_EQ(180U, time);
+  EXPECT_TRUE(getEventKeyTime("data.type.a.b.0000000002.0000000001", time));
+  EXPECT_FALSE(getEventKeyTime("data.type.name.0000000001", time));
+  EXPECT_FALSE(getEventKeyTime("data.0000000001", time));
+  EXPECT_FALSE(getEventKeyTime("eid.type.name", time));
+  EXPECT_FALSE(getEventKeyTime("indexes.type.name.60", time));
+
+  EXPECT_TRUE(getLogKeyTime("tls_r_1600000000_1", time));
+  EXPECT_EQ(1600000000U, time);
+  EXPECT_TRUE(getLogKeyTime("tls_s_1600000000_12", time));
+  EXPECT_FALSE(getLogKeyTime("tls_x_1600000000_1", time));
+  EXPECT_FALSE(getLogKeyTime("tls_r_time_1", time));
+  EXPECT_FALSE(getLogKeyTime("1600000000_1", time));
+}
+
+TEST_F(RocksDBDatabasePluginTests, test_domain_ttl) {
+  FLAGS_rocksdb_events_ttl = 3600;
+  FLAGS_rocksdb_logs_ttl = 60;
+  auto db = RocksDBDatabasePlugin();
+  const auto test_db_path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path(
+           "osquery.test_domain_ttl.%%%%.%%%%.%%%%.%%%%.db"))
+          .string();
+  FLAGS_database_path = test_db_path;
+
+  auto s = db.setUp();
+  FLAGS_rocksdb_events_ttl = 0;
+  FLAGS_rocksdb_logs_ttl = 0;
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  db_dirs_.push_back(test_db_path);
+
+  auto events = db.db_->GetOptions(db.getHandleForColumnFamily(kEvents));
+  ASSERT_NE(nullptr, events.compaction_filter);
+  EXPECT_EQ(3600U, events.periodic_compaction_seconds);
+
+  auto queries = db.db_->GetOptions(db.getHandleForColumnFamily(kQueries));
+  EXPECT_EQ(nullptr, queries.compaction_filter);
+
+  auto now = static_cast<uint64_t>(std::time(nullptr));
+  auto bucket = std::to_string(now / 60);
+  std::string value;
+  bool changed = false;
+
+  auto filter = events.compaction_filter;
+  EXPECT_TRUE(filter->Filter(
+      0, "data.type.name.0000000001.0000000001", "", &value, &changed));
+  EXPECT_FALSE(filter->Filter(
+      0, "data.type.name." + bucket + ".0000000001", "", &value, &changed));
+  EXPECT_FALSE(filter->Filter(0, "eid.type.name", "", &value, &changed));
+
+  auto logs = db.db_->GetOptions(db.getHandleForColumnFamily(kLogs));
+  ASSERT_NE(nullptr, logs.compaction_filter);
+  filter = logs.compaction_filter;
+  EXPECT_TRUE(filter->Filter(0, "tls_r_1_1", "", &value, &changed));
+  EXPECT_FALSE(filter->Filter(
+      0, "tls_r_" + std::to_string(now) + "_1", "", &value, &changed));
+  EXPECT_FALSE(changed);
+
+  db.tearDown();
+}
+
+TEST_F(RocksDBDatabasePluginTests, test_domain_quota) {
+  FLAGS_rocksdb_logs_quota_mb = 1;
+  auto db = RocksDBDatabasePlugin();
+  const auto test_db_path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path(
+           "osquery.test_domain_quota.%%%%.%%%%.%%%%.%%%%.db"))
+          .string();
+  FLAGS_database_path = test_db_path;
+
+  auto s = db.setUp();
+  FLAGS_rocksdb_logs_quota_mb = 0;
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  db_dirs_.push_back(test_db_path);
+
+  // Writes are refused once about a megabyte of logs is written.
+  const std::string line(64 * 1024, 'a');
+  size_t written = 0;
+  for (; written < 32; ++written) {
+    auto key = "tls_r_1600000000_" + std::to_string(written);
+    if (!db.putBatch(kLogs, {{key, line}}).ok()) {
+      break;
+    }
+  }
+  EXPECT_GE(written, 15U);
+  EXPECT_LT(written, 32U);
+  EXPECT_TRUE(db.quotas_.at(kLogs).exceeded);
+
+  // Other domains and removals are not limited.
+  EXPECT_TRUE(db.putBatch(kQueries, {{"query", line}}).ok());
+  EXPECT_TRUE(db.putBatch(kEvents, {{"data.type.name.01.1", line}}).ok());
+  EXPECT_TRUE(db.remove(kLogs, "tls_r_1600000000_0").ok());
+
+  db.tearDown();
+}
+
+TEST_F(RocksDBDatabasePluginTests, test_read_only_secondary) {
+  auto primary = RocksDBDatabasePlugin();
+  const auto test_db_path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path(
+           "osquery.test_read_only_secondary.%%%%.%%%%.%%%%.%%%%.db"))
+          .string();
+  FLAGS_database_path = test_db_path;
+
+  auto s = primary.setUp();
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  db_dirs_.push_back(test_db_path);
+  EXPECT_TRUE(primary.put(kQueries, "before", "1").ok());
+
+  // The secondary opens while the primary holds the database lock.
+  FLAGS_database_read_only = true;
+  auto secondary = RocksDBDatabasePlugin();
+  s = secondary.setUp();
+  FLAGS_database_read_only = false;
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+
+  std::string value;
+  EXPECT_TRUE(secondary.get(kQueries, "before", value).ok());
+  EXPECT_EQ("1", value);
+  EXPECT_FALSE(secondary.put(kQueries, "secondary", "1").ok());
+  EXPECT_FALSE(secondary.remove(kQueries, "before").ok());
+
+  // Writes of the primary are read once the secondary catches up.
+  EXPECT_TRUE(primary.put(kQueries, "after", "2").ok());
+  secondary.caught_up_ = {};
+  EXPECT_TRUE(secondary.get(kQueries, "after", value).ok());
+  EXPECT_EQ("2", value);
+
+  auto secondary_path = secondary.secondary_path_;
+  secondary.tearDown();
+  EXPECT_FALSE(pathExists(secondary_path));
+
+  primary.tearDown();
+}
+
+TEST_F(RocksDBDatabasePluginTests, test_background_compaction) {
+  auto db = RocksDBDatabasePlugin();
+  const auto test_db_path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path(
+           "osquery.test_background_compaction.%%%%.%%%%.%%%%.%%%%.db"))
+          .string();
+  FLAGS_database_path = test_db_path;
+  FLAGS_rocksdb_compaction_rate_mb = 1;
+
+  auto s = db.setUp();
+  FLAGS_rocksdb_compaction_rate_mb = 0;
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  db_dirs_.push_back(test_db_path);
+  EXPECT_NE(nullptr, db.options_.rate_limiter);
+
+  // The startup compaction does not delay the first writes.
+  EXPECT_TRUE(db.compaction_thread_.joinable());
+  EXPECT_TRUE(db.put(kQueries, "key", "value").ok());
+
+  // Opening the database again stops the running compaction.
+  s = db.setUp();
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  std::string value;
+  EXPECT_TRUE(db.get(kQueries, "key", value).ok());
+  EXPECT_EQ("value", value);
+
+  db.tearDown();
+  EXPECT_FALSE(db.compaction_thread_.joinable());
+}
+
+TEST_F(RocksDBDatabasePluginTests, test_memory_limit) {
+  auto db = RocksDBDatabasePlugin();
+  const auto test_db_path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path(
+           "osquery.test_memory_limit.%%%%.%%%%.%%%%.%%%%.db"))
+          .string();
+  FLAGS_database_path = test_db_path;
+  FLAGS_database_memory_limit = 16;
+
+  auto s = db.setUp();
+  FLAGS_database_memory_limit = 0;
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  db_dirs_.push_back(test_db_path);
+
+  ASSERT_NE(nullptr, db.block_cache_);
+  EXPECT_EQ(16U * 1024 * 1024, db.block_cache_->GetCapacity());
+  ASSERT_NE(nullptr, db.options_.write_buffer_manager);
+  EXPECT_EQ(8U * 1024 * 1024,
+            db.options_.write_buffer_manager->buffer_size());
+
+  // The memtables are charged to the shared block cache.
+  for (size_t i = 0; i < 100; i++) {
+    EXPECT_TRUE(
+        db.put(kEvents, "data.type.name." + std::to_string(i), "value").ok());
+  }
+  EXPECT_GT(db.block_cache_->GetUsage(), 0U);
+
+  uint64_t bytes = 0;
+  EXPECT_TRUE(db.memoryUsage(bytes).ok());
+  EXPECT_GE(bytes, db.block_cache_->GetUsage());
+
+  db.tearDown();
+  EXPECT_FALSE(db.memoryUsage(bytes).ok());
+}
 } // namespace osquery
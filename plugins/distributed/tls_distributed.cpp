@@ -27,6 +27,10 @@
 namespace osquery {
 
 DECLARE_bool(tls_node_api);
+DECLARE_uint64(distributed_long_poll);
+
+/// Seconds a held read may take beyond the long poll before it times out.
+const int kDistributedLongPollGrace = 16;
 
 FLAG(string,
      distributed_tls_read_endpoint,
@@ -43,6 +47,11 @@ FLAG(uint64,
      3,
      "Number of times to attempt a request")
 
+FLAG(bool,
+     distributed_tls_compress,
+     false,
+     "Compress distributed query results, see tls_compression");
+
 class TLSDistributedPlugin : public DistributedPlugin {
  public:
   Status setUp() override;
@@ -67,6 +76,13 @@ Status TLSDistributedPlugin::setUp() {
 Status TLSDistributedPlugin::getQueries(std::string& json) {
   JSON params;
   params.add("_verb", "POST");
+  if (FLAGS_distributed_long_poll > 0) {
+    // The server may hold the read until work is available.
+    params.add("long_poll", FLAGS_distributed_long_poll);
+    params.add("_timeout",
+               static_cast<int>(FLAGS_distributed_long_poll) +
+                   kDistributedLongPollGrace);
+  }
   return TLSRequestHelper::go<JSONSerializer>(
       read_uri_, params, json, FLAGS_distributed_tls_max_attempts);
 }
@@ -79,6 +95,10 @@ Status TLSDistributedPlugin::writeResults(const std::string& json) {
     return s;
   }
 
+  if (FLAGS_distributed_tls_compress) {
+    params.add("_compress", true);
+  }
+
   // The response is ignored.
   std::string response;
   return TLSRequestHelper::go<JSONSerializer>(
@@ -0,0 +1,292 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "async_log_file.h"
+#include "logrotate.h"
+
+#ifndef WIN32
+#include <climits>
+
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+
+#include <osquery/core/flags.h>
+#include <osquery/logger/logger.h>
+#include <osquery/utils/system/system.h>
+
+namespace osquery {
+
+DECLARE_bool(logger_rotate);
+DECLARE_uint64(logger_rotate_max_files);
+
+/// Lines are refused while this many bytes wait for the writer thread.
+const uint64_t kAsyncLogMaxPendingBytes = 64 * 1024 * 1024;
+
+#ifndef WIN32
+/// Max number of buffers in one vectored write.
+const size_t kAsyncLogMaxBuffers = IOV_MAX;
+#endif
+
+LogSyncPolicy getLogSyncPolicy(const std::string& value) {
+  if (value == "batch") {
+    return LogSyncPolicy::kBatch;
+  } else if (value == "interval") {
+    return LogSyncPolicy::kInterval;
+  }
+  return LogSyncPolicy::kNever;
+}
+
+AsyncLogFile::AsyncLogFile(std::string path,
+                           int mode,
+                           LogRotate* rotate,
+                           LogSyncPolicy policy,
+                           std::chrono::milliseconds interval)
+    : path_(std::move(path)),
+      mode_(mode),
+      rotate_(rotate),
+      policy_(policy),
+      interval_(interval) {}
+
+AsyncLogFile::~AsyncLogFile() {
+  if (thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+  }
+
+  // Lines queued without a writer thread are dropped.
+  auto line = head_.exchange(nullptr);
+  while (line != nullptr) {
+    std::unique_ptr<Line> owned(line);
+    line = line->next;
+  }
+}
+
+Status AsyncLogFile::open() {
+  file_ = std::make_unique<PlatformFile>(
+      path_, PF_OPEN_ALWAYS | PF_WRITE | PF_APPEND, mode_);
+  if (!file_->isValid()) {
+    file_.reset();
+    return Status::failure("Could not open log file: " + path_);
+  }
+
+  // If the file existed with different permissions they must be restricted.
+  if (!platformChmod(path_, mode_)) {
+    return Status::failure("Failed to change permissions for file: " + path_);
+  }
+  return Status::success();
+}
+
+Status AsyncLogFile::start() {
+  auto status = open();
+  if (!status.ok()) {
+    return status;
+  }
+
+  synced_ = std::chrono::steady_clock::now();
+  thread_ = std::thread([this]() { run(); });
+  return Status::success();
+}
+
+Status AsyncLogFile::write(const std::string& line) {
+  auto bytes = line.size() + 1;
+  if (pending_bytes_.load() + bytes > kAsyncLogMaxPendingBytes) {
+    return Status::failure("Too many log lines wait to be written: " + path_);
+  }
+
+  auto node = new Line();
+  node->text.reserve(bytes);
+  node->text.append(line).push_back('\n');
+  pending_bytes_ += bytes;
+  queued_++;
+
+  // Push to the head, the writer thread restores the order. The node may be
+  // written and freed as soon as it is pushed.
+  auto next = head_.load(std::memory_order_relaxed);
+  do {
+    node->next = next;
+  } while (!head_.compare_exchange_weak(
+      next, node, std::memory_order_release, std::memory_order_relaxed));
+
+  // Only the first line after the writer emptied the list wakes it.
+  if (next == nullptr) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wake_.notify_one();
+  }
+  return Status::success();
+}
+
+void AsyncLogFile::flush() {
+  auto target = queued_.load();
+  std::unique_lock<std::mutex> lock(mutex_);
+  written_cv_.wait(lock, [this, target]() {
+    return written_ >= target || !thread_.joinable();
+  });
+}
+
+void AsyncLogFile::run() {
+  while (true) {
+    auto head = head_.exchange(nullptr, std::memory_order_acquire);
+    if (head == nullptr) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (stopping_) {
+        break;
+      }
+
+      auto wait = (policy_ == LogSyncPolicy::kInterval && dirty_)
+                      ? interval_
+                      : std::chrono::milliseconds(1000);
+      wake_.wait_for(lock, wait, [this]() {
+        return stopping_ || head_.load(std::memory_order_relaxed) != nullptr;
+      });
+      lock.unlock();
+
+      // An idle file is synced once the interval passed.
+      if (policy_ == LogSyncPolicy::kInterval && dirty_ &&
+          std::chrono::steady_clock::now() - synced_ >= interval_) {
+        sync();
+      }
+      continue;
+    }
+
+    // The list is newest first.
+    std::vector<std::unique_ptr<Line>> lines;
+    uint64_t bytes = 0;
+    for (auto line = head; line != nullptr; line = line->next) {
+      lines.emplace_back(line);
+      bytes += line->text.size();
+    }
+    std::reverse(lines.begin(), lines.end());
+
+    auto status = append(lines);
+    if (!status.ok()) {
+      LOG(ERROR) << status.getMessage();
+    }
+    pending_bytes_ -= bytes;
+
+    if (policy_ == LogSyncPolicy::kBatch ||
+        (policy_ == LogSyncPolicy::kInterval &&
+         std::chrono::steady_clock::now() - synced_ >= interval_)) {
+      sync();
+    }
+    rotateIfNeeded();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      written_ += lines.size();
+    }
+    written_cv_.notify_all();
+  }
+
+  if (policy_ != LogSyncPolicy::kNever && dirty_) {
+    sync();
+  }
+}
+
+Status AsyncLogFile::append(const std::vector<std::unique_ptr<Line>>& lines) {
+  if (file_ == nullptr) {
+    auto status = open();
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  dirty_ = true;
+
+#ifdef WIN32
+  // There is no vectored write, the batch is joined into one write instead.
+  std::string batch;
+  for (const auto& line : lines) {
+    batch += line->text;
+  }
+
+  auto written = file_->write(batch.data(), batch.size());
+  if (written < 0 || static_cast<size_t>(written) != batch.size()) {
+    return Status::failure("Failed to write to log file: " + path_);
+  }
+#else
+  std::vector<struct iovec> buffers;
+  for (size_t start = 0; start < lines.size();
+       start += kAsyncLogMaxBuffers) {
+    auto end = std::min(lines.size(), start + kAsyncLogMaxBuffers);
+    buffers.clear();
+    for (auto i = start; i < end; ++i) {
+      buffers.push_back(
+          {const_cast<char*>(lines[i]->text.data()), lines[i]->text.size()});
+    }
+
+    // Resume after partial writes.
+    auto buffer = buffers.data();
+    auto count = static_cast<int>(buffers.size());
+    while (count > 0) {
+      auto written = ::writev(file_->nativeHandle(), buffer, count);
+      if (written < 0 && errno == EINTR) {
+        continue;
+      } else if (written <= 0) {
+        return Status::failure("Failed to write to log file: " + path_);
+      }
+
+      auto remaining = static_cast<size_t>(written);
+      while (count > 0 && remaining >= buffer->iov_len) {
+        remaining -= buffer->iov_len;
+        ++buffer;
+        --count;
+      }
+      if (count > 0) {
+        buffer->iov_base = static_cast<char*>(buffer->iov_base) + remaining;
+        buffer->iov_len -= remaining;
+      }
+    }
+  }
+#endif
+
+  return Status::success();
+}
+
+void AsyncLogFile::sync() {
+  if (file_ != nullptr) {
+#ifdef WIN32
+    ::FlushFileBuffers(file_->nativeHandle());
+#else
+    ::fsync(file_->nativeHandle());
+#endif
+  }
+  dirty_ = false;
+  synced_ = std::chrono::steady_clock::now();
+}
+
+void AsyncLogFile::rotateIfNeeded() {
+  if (!FLAGS_logger_rotate || rotate_ == nullptr || !rotate_->shouldRotate()) {
+    return;
+  }
+
+  // The rotated file is complete on disk before it is moved.
+  if (policy_ != LogSyncPolicy::kNever && dirty_) {
+    sync();
+  }
+  file_.reset();
+
+  auto status = rotate_->rotate(FLAGS_logger_rotate_max_files);
+  if (!status.ok()) {
+    LOG(ERROR) << "Could not rotate log file " << path_ << ": "
+               << status.getMessage();
+  }
+
+  status = open();
+  if (!status.ok()) {
+    LOG(ERROR) << status.getMessage();
+  }
+}
+
+} // namespace osquery
@@ -0,0 +1,142 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/filesystem/fileops.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+class LogRotate;
+
+/// When the writer thread flushes a log file to disk.
+enum class LogSyncPolicy {
+  /// Leave it to the operating system.
+  kNever,
+
+  /// After a batch, if the interval passed since the last sync.
+  kInterval,
+
+  /// After every batch.
+  kBatch,
+};
+
+/**
+ * @brief Append lines to a log file from a writer thread.
+ *
+ * Callers push their line to a lock-free list and return. The writer thread
+ * takes every pending line at once, and appends them with one vectored
+ * write. Rotation and syncs happen on the writer thread between batches, so
+ * a slow disk never stalls the callers.
+ */
+class AsyncLogFile : private boost::noncopyable {
+ public:
+  /**
+   * @param path The log file, created if missing.
+   * @param mode Permissions of the log file.
+   * @param rotate Rotates the file when logger_rotate is set, may be null.
+   * @param policy When the file is flushed to disk.
+   * @param interval The minimum time between syncs of kInterval.
+   */
+  AsyncLogFile(std::string path,
+               int mode,
+               LogRotate* rotate,
+               LogSyncPolicy policy,
+               std::chrono::milliseconds interval);
+
+  /// Writes the pending lines and stops the writer thread.
+  ~AsyncLogFile();
+
+  /// Open the file and start the writer thread.
+  Status start();
+
+  /**
+   * @brief Queue a line, a newline is appended.
+   *
+   * Lines are refused while too many bytes wait for the writer thread.
+   */
+  Status write(const std::string& line);
+
+  /// Wait for the lines queued before the call to be written.
+  void flush();
+
+ private:
+  /// A pending line, lines are pushed to the head of a singly linked list.
+  struct Line {
+    std::string text;
+    Line* next{nullptr};
+  };
+
+  /// The writer thread.
+  void run();
+
+  /// Open the log file for appending.
+  Status open();
+
+  /// Append a batch, in order, with as few writes as possible.
+  Status append(const std::vector<std::unique_ptr<Line>>& lines);
+
+  /// Flush the file to disk.
+  void sync();
+
+  /// Rotate the file if it is too large, then reopen it.
+  void rotateIfNeeded();
+
+ private:
+  const std::string path_;
+  const int mode_;
+  LogRotate* rotate_;
+  const LogSyncPolicy policy_;
+  const std::chrono::milliseconds interval_;
+
+  /// The newest pending line, nullptr if none.
+  std::atomic<Line*> head_{nullptr};
+
+  /// Bytes of the pending lines.
+  std::atomic<uint64_t> pending_bytes_{0};
+
+  /// Lines queued, and lines written or dropped by the writer thread.
+  std::atomic<uint64_t> queued_{0};
+  uint64_t written_{0};
+
+  /// Only used by the writer thread, after start.
+  std::unique_ptr<PlatformFile> file_;
+  bool dirty_{false};
+  std::chrono::steady_clock::time_point synced_;
+
+  std::thread thread_;
+  bool stopping_{false};
+
+  /// Protects stopping_ and written_.
+  std::mutex mutex_;
+
+  /// Wakes the writer thread when the list stops being empty.
+  std::condition_variable wake_;
+
+  /// Wakes flush callers after a batch.
+  std::condition_variable written_cv_;
+};
+
+/// Parse the logger_fsync flag value.
+LogSyncPolicy getLogSyncPolicy(const std::string& value);
+
+} // namespace osquery
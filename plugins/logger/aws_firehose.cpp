@@ -34,6 +34,11 @@ FLAG(string, aws_firehose_stream, "", "Name of Firehose stream for logging")
 
 FLAG(string, aws_firehose_endpoint, "", "Custom Firehose endpoint");
 
+FLAG(uint64,
+     aws_firehose_max_inflight,
+     4,
+     "Max concurrent Firehose requests (default 4)");
+
 Status FirehoseLoggerPlugin::setUp() {
   initAwsSdk();
 
@@ -122,4 +127,17 @@ FirehoseLogForwarder::Result FirehoseLogForwarder::getResult(
     Outcome& outcome) const {
   return outcome.GetResult().GetRequestResponses();
 }
+
+size_t FirehoseLogForwarder::getMaxInflightBatches() const {
+  return static_cast<size_t>(FLAGS_aws_firehose_max_inflight);
+}
+
+bool FirehoseLogForwarder::isThrottlingError(
+    const Aws::String& error_code) const {
+  // Records rejected for exceeding the stream's throughput are reported as
+  // ServiceUnavailableException.
+  return error_code == "ServiceUnavailableException" ||
+         error_code == "ThrottlingException" ||
+         error_code == "LimitExceededException";
+}
 }
@@ -58,6 +58,9 @@ class FirehoseLogForwarder final : public IFirehoseLogForwarder {
   size_t getFailedRecordCount(Outcome& outcome) const override;
   Result getResult(Outcome& outcome) const override;
 
+  size_t getMaxInflightBatches() const override;
+  bool isThrottlingError(const Aws::String& error_code) const override;
+
  private:
   FRIEND_TEST(FirehoseTests, test_send);
 };
@@ -20,6 +20,7 @@
 #include <aws/kinesis/model/PutRecordsResult.h>
 
 #include <boost/algorithm/string/join.hpp>
+#include <boost/functional/hash.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
 
@@ -51,6 +52,12 @@ FLAG(bool,
 
 FLAG(string, aws_kinesis_endpoint, "", "Custom Kinesis endpoint");
 
+FLAG(uint64,
+     aws_kinesis_max_inflight,
+     4,
+     "Max concurrent Kinesis requests, records of a partition key are sent "
+     "in order (default 4)");
+
 Status KinesisLoggerPlugin::setUp() {
   initAwsSdk();
   forwarder_ = std::make_shared<KinesisLogForwarder>(
@@ -149,4 +156,25 @@ KinesisLogForwarder::Result KinesisLogForwarder::getResult(
     Outcome& outcome) const {
   return outcome.GetResult().GetRecords();
 }
+
+size_t KinesisLogForwarder::getMaxInflightBatches() const {
+  return static_cast<size_t>(FLAGS_aws_kinesis_max_inflight);
+}
+
+size_t KinesisLogForwarder::getRecordLane(const Record& record,
+                                          size_t index,
+                                          size_t lane_count) const {
+  // A partition key maps to a single shard; its records share a lane so that
+  // they are sent in order, and a throttled shard holds back only its lane.
+  const auto& partition_key = record.GetPartitionKey();
+  return boost::hash_range(partition_key.begin(), partition_key.end()) %
+         lane_count;
+}
+
+bool KinesisLogForwarder::isThrottlingError(
+    const Aws::String& error_code) const {
+  return error_code == "ProvisionedThroughputExceededException" ||
+         error_code == "ThrottlingException" ||
+         error_code == "KMSThrottlingException";
+}
 }
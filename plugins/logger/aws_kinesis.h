@@ -56,6 +56,12 @@ class KinesisLogForwarder final : public IKinesisLogForwarder {
   size_t getFailedRecordCount(Outcome& outcome) const override;
   Result getResult(Outcome& outcome) const override;
 
+  size_t getMaxInflightBatches() const override;
+  bool isThrottlingError(const Aws::String& error_code) const override;
+  size_t getRecordLane(const Record& record,
+                       size_t index,
+                       size_t lane_count) const override;
+
  private:
   /// The partition key; ignored if aws_kinesis_random_partition_key is set
   std::string partition_key_;
@@ -11,8 +11,12 @@
 
 #include "plugins/logger/buffered.h"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <future>
 #include <memory>
+#include <sstream>
 #include <vector>
 
 #include <osquery/core/core.h>
@@ -34,6 +38,7 @@ class AwsLogForwarder : public BufferedLogForwarder {
   using Record = RecordType;
   using Batch = std::vector<RecordType>;
   using BatchList = std::vector<Batch>;
+  using LaneList = std::vector<BatchList>;
   using Result = ResultType;
 
  public:
@@ -117,15 +122,22 @@ class AwsLogForwarder : public BufferedLogForwarder {
     return stream;
   }
 
-  /// Consumes the specified log records generating one or more batches
-  BatchList consumeDataAndGenerateBatches(
+  /**
+   * @brief Consumes the specified log records generating one or more batches
+   *
+   * Each record is assigned to a lane by getRecordLane, a lane is a list of
+   * batches sent in order.
+   */
+  LaneList consumeDataAndGenerateBatches(
       std::vector<std::string>& discarded_records,
       const std::string& log_type,
       std::vector<std::string>& log_data) const {
-    BatchList batch_list;
+    auto lane_count = std::max<size_t>(1U, getMaxInflightBatches());
+    LaneList lane_list(lane_count);
 
-    Batch current_batch;
-    size_t current_batch_byte_size = 0U;
+    std::vector<Batch> current_batches(lane_count);
+    std::vector<size_t> current_batch_byte_sizes(lane_count, 0U);
+    size_t record_index = 0U;
 
     for (auto& record : log_data) {
       // Initialize the line and make sure we are still within protocol limits
@@ -152,16 +164,7 @@ class AwsLogForwarder : public BufferedLogForwarder {
         continue;
       }
 
-      // Complete the current batch if it's full
-      if (current_batch_byte_size + record_size >= getMaxBytesPerBatch() ||
-          (current_batch.size() >= getMaxRecordsPerBatch())) {
-        batch_list.push_back(current_batch);
-
-        current_batch.clear();
-        current_batch_byte_size = 0U;
-      }
-
-      // Initialize and store the new log record
+      // Initialize the new log record
       auto buffer = Aws::Utils::ByteBuffer(
           reinterpret_cast<unsigned char*>(&record[0]), record_size);
 
@@ -172,16 +175,52 @@ class AwsLogForwarder : public BufferedLogForwarder {
       RecordType aws_record;
       initializeRecord(aws_record, buffer);
 
+      auto lane = getRecordLane(aws_record, record_index++, lane_count) %
+                  lane_count;
+      auto& current_batch = current_batches[lane];
+      auto& current_batch_byte_size = current_batch_byte_sizes[lane];
+
+      // Complete the current batch of the lane if it's full
+      if (current_batch_byte_size + record_size >= getMaxBytesPerBatch() ||
+          (current_batch.size() >= getMaxRecordsPerBatch())) {
+        lane_list[lane].push_back(std::move(current_batch));
+
+        current_batch.clear();
+        current_batch_byte_size = 0U;
+      }
+
       current_batch.emplace_back(std::move(aws_record));
       current_batch_byte_size += record_size;
     }
 
-    if (!current_batch.empty()) {
-      batch_list.push_back(current_batch);
+    for (size_t lane = 0U; lane < lane_count; lane++) {
+      if (!current_batches[lane].empty()) {
+        lane_list[lane].push_back(std::move(current_batches[lane]));
+      }
     }
 
     log_data.clear();
-    return batch_list;
+    return lane_list;
+  }
+
+  /**
+   * @brief Adapt the delay before each request to throttling
+   *
+   * The delay doubles each time the service reports its throughput was
+   * exceeded, and halves after each request without throttling.
+   */
+  void updateThrottleDelay(bool throttled) {
+    auto delay = throttle_delay_.load();
+    size_t next_delay = 0U;
+    if (throttled) {
+      next_delay = std::min(kMaxThrottleDelay,
+                            std::max(kMinThrottleDelay, delay * 2U));
+    } else if (delay / 2U >= kMinThrottleDelay) {
+      next_delay = delay / 2U;
+    }
+
+    // Concurrent lanes may race, any of their updates is good enough.
+    throttle_delay_.compare_exchange_strong(delay, next_delay);
   }
 
  protected:
@@ -195,9 +234,11 @@ class AwsLogForwarder : public BufferedLogForwarder {
     for (size_t retry = 0; retry < max_retry_count; retry++) {
       bool is_last_retry = (retry + 1 >= max_retry_count);
 
-      // Increase the resend delay at each retry
+      // Increase the resend delay at each retry, and wait for as long as
+      // the service is throttling requests
       size_t retry_delay =
           (retry == 0 ? 0 : base_retry_delay) + (retry * 1000U);
+      retry_delay = std::max(retry_delay, throttle_delay_.load());
       if (retry_delay != 0) {
         pause(std::chrono::milliseconds(retry_delay));
 
@@ -216,6 +257,8 @@ class AwsLogForwarder : public BufferedLogForwarder {
       if (!outcome.IsSuccess()) {
         failed_record_count = batch.size();
         request_failure = true;
+        updateThrottleDelay(
+            isThrottlingError(outcome.GetError().GetExceptionName()));
       } else {
         failed_record_count = getFailedRecordCount(outcome);
         request_failure = false;
@@ -230,6 +273,7 @@ class AwsLogForwarder : public BufferedLogForwarder {
       }
 
       if (failed_record_count == 0) {
+        updateThrottleDelay(false);
         success = true;
         break;
       }
@@ -256,54 +300,101 @@ class AwsLogForwarder : public BufferedLogForwarder {
 
       const auto& result_record_list = getResult(outcome);
 
+      bool throttled = false;
       for (size_t i = batch.size(); i-- > 0;) {
-        if (!result_record_list[i].GetErrorCode().empty()) {
+        const auto& error_code = result_record_list[i].GetErrorCode();
+        if (!error_code.empty()) {
+          throttled = throttled || isThrottlingError(error_code);
           continue;
         }
 
         auto it = std::next(batch.begin(), i);
         batch.erase(it);
       }
+      updateThrottleDelay(throttled);
     }
 
     return success;
   }
 
-  /// Sends the specified data in one or more batches, depending on the log size
-  Status send(std::vector<std::string>& log_data,
-              const std::string& log_type) override {
-    // Generate the batches, according to the protocol limits
-    std::vector<std::string> discarded_records;
-    auto batch_list =
-        consumeDataAndGenerateBatches(discarded_records, log_type, log_data);
-
-    dumpDiscardedRecordsToErrorLog(discarded_records);
-    discarded_records.clear();
-
-    // Send each batch
-    size_t error_count = 0;
+  /// The outcome of sending the batches of a lane
+  struct LaneStatus {
+    size_t error_count{0U};
+    bool interrupted{false};
     std::stringstream status_output;
+  };
 
+  /// Sends the batches of a lane, in order
+  void sendLane(BatchList& batch_list, LaneStatus& lane_status) {
     for (auto batch_it = batch_list.begin(); batch_it != batch_list.end();) {
       auto& batch = *batch_it;
-      if (!sendBatch(batch, status_output)) {
+      if (!sendBatch(batch, lane_status.status_output)) {
         /* Since we are shutting down, we don't want to count this send failure
            as a real error; returning with failure here will make
            the BufferedLogForwarder try to send this batch again
            when osquery starts again */
         if (interrupted()) {
-          return Status::failure(
-              "Interrupted sending log batch due to osquery shutdown");
+          lane_status.interrupted = true;
+          return;
         }
 
         // We couldn't write some of the records; log them locally so that the
         // administrator will at least be able to inspect them
         dumpBatchToErrorLog(batch);
-        error_count++;
+        lane_status.error_count++;
       }
 
       batch_it = batch_list.erase(batch_it);
     }
+  }
+
+  /// Sends the specified data in one or more batches, depending on the log size
+  Status send(std::vector<std::string>& log_data,
+              const std::string& log_type) override {
+    // Generate the batches, according to the protocol limits
+    std::vector<std::string> discarded_records;
+    auto lane_list =
+        consumeDataAndGenerateBatches(discarded_records, log_type, log_data);
+
+    dumpDiscardedRecordsToErrorLog(discarded_records);
+    discarded_records.clear();
+
+    // Lanes are sent concurrently, the first one on this thread
+    std::vector<LaneStatus> lane_statuses(lane_list.size());
+    std::vector<std::future<void>> senders;
+    for (size_t lane = 1U; lane < lane_list.size(); lane++) {
+      if (lane_list[lane].empty()) {
+        continue;
+      }
+
+      senders.push_back(std::async(
+          std::launch::async, [this, &lane_list, &lane_statuses, lane]() {
+            sendLane(lane_list[lane], lane_statuses[lane]);
+          }));
+    }
+
+    sendLane(lane_list[0], lane_statuses[0]);
+    for (auto& sender : senders) {
+      sender.wait();
+    }
+
+    size_t error_count = 0;
+    std::stringstream status_output;
+    for (const auto& lane_status : lane_statuses) {
+      if (lane_status.interrupted) {
+        return Status::failure(
+            "Interrupted sending log batch due to osquery shutdown");
+      }
+
+      error_count += lane_status.error_count;
+      auto output = lane_status.status_output.str();
+      if (!output.empty()) {
+        if (!status_output.str().empty()) {
+          status_output << "\n";
+        }
+        status_output << output;
+      }
+    }
 
     if (error_count != 0) {
       return Status(1, status_output.str());
@@ -346,6 +437,32 @@ class AwsLogForwarder : public BufferedLogForwarder {
   /// Must return the vector containing the upload result for each record
   virtual Result getResult(Outcome& outcome) const = 0;
 
+  /// The number of batches that may be sent concurrently
+  virtual size_t getMaxInflightBatches() const {
+    return 1U;
+  }
+
+  /**
+   * @brief Returns the lane of a record
+   *
+   * Records of a lane are sent in order, one batch at a time; by default
+   * records are spread across the lanes.
+   *
+   * @param record The initialized record
+   * @param index The position of the record within the sent log lines
+   * @param lane_count The number of lanes, see getMaxInflightBatches
+   */
+  virtual size_t getRecordLane(const Record& record,
+                               size_t index,
+                               size_t lane_count) const {
+    return index % lane_count;
+  }
+
+  /// Must return true if the error code means the throughput was exceeded
+  virtual bool isThrottlingError(const Aws::String& error_code) const {
+    return false;
+  }
+
  protected:
   /// Plugin-specific service client
   std::shared_ptr<Client> client_{nullptr};
@@ -355,5 +472,13 @@ class AwsLogForwarder : public BufferedLogForwarder {
 
   /// Service endpoint override
   std::string endpoint_override_;
+
+ private:
+  /// Bounds of the delay, in milliseconds, while requests are throttled
+  static constexpr size_t kMinThrottleDelay = 100U;
+  static constexpr size_t kMaxThrottleDelay = 30000U;
+
+  /// Delay, in milliseconds, before each request; shared by every lane
+  std::atomic<size_t> throttle_delay_{0U};
 };
 } // namespace osquery
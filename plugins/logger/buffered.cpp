@@ -13,6 +13,7 @@
 #include <chrono>
 #include <thread>
 
+#include <boost/filesystem/path.hpp>
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
 
@@ -26,6 +27,7 @@
 #include <osquery/utils/system/time.h>
 #include <plugins/config/parsers/decorators.h>
 
+namespace fs = boost::filesystem;
 namespace pt = boost::property_tree;
 
 namespace osquery {
@@ -35,75 +37,117 @@ FLAG(uint64,
      1000000,
      "Maximum number of logs in buffered output plugins (0 = unlimited)");
 
+FLAG(string,
+     buffered_log_spool_path,
+     "",
+     "Directory of log segment files used instead of the database to buffer "
+     "logs (empty = database)");
+
+HIDDEN_FLAG(uint64,
+            buffered_log_segment_size,
+            4 * 1024 * 1024,
+            "Bytes after which a buffered log segment file is closed");
+
+/// Buffered logs are appended to segment files instead of database keys.
+static bool isSpooled() {
+  return !FLAGS_buffered_log_spool_path.empty();
+}
+
 const std::chrono::seconds BufferedLogForwarder::kLogPeriod{
     std::chrono::seconds(4)};
 const uint64_t BufferedLogForwarder::kMaxLogLines{1024};
 
 Status BufferedLogForwarder::setUp() {
+  if (isSpooled()) {
+    auto status = openSpools();
+    if (!status.ok()) {
+      return status;
+    }
+
+    RecursiveLock lock(count_mutex_);
+    buffer_count_ = result_spool_->size() + status_spool_->size();
+    return Status(0);
+  }
+
   // initialize buffer_count_ by scanning the DB
-  std::vector<std::string> indexes;
-  auto status = scanDatabaseKeys(kLogs, indexes, index_name_, (uint64_t)0);
+  unsigned long long int count = 0;
+  auto status = scanDatabaseValues(
+      kLogs,
+      index_name_,
+      [&count](const std::string& index, const std::string& value) {
+        ++count;
+        return true;
+      });
 
   if (!status.ok()) {
     return Status(1, "Error scanning for buffered log count");
   }
 
   RecursiveLock lock(count_mutex_);
-  buffer_count_ = indexes.size();
+  buffer_count_ = count;
   return Status(0);
 }
 
 void BufferedLogForwarder::check() {
-  // Get a list of all the buffered log items, with a max of 1024 lines.
-  std::vector<std::string> indexes;
-  auto status = scanDatabaseKeys(kLogs, indexes, index_name_, max_log_lines_);
+  if (isSpooled()) {
+    checkSpools();
+    return;
+  }
 
+  // Read the buffered log items with their indexes, with a max of 1024 lines.
   // For each index, accumulate the log line into the result or status set.
+  std::vector<std::string> result_indexes, status_indexes;
   std::vector<std::string> results, statuses;
-  iterate(indexes, ([&results, &statuses, this](std::string& index) {
-            std::string value;
-            auto& target = isResultIndex(index) ? results : statuses;
-            if (getDatabaseValue(kLogs, index, value)) {
-              target.emplace_back(std::move(value));
-            }
-          }));
+  std::string next_index;
+  auto status = scanDatabaseValues(
+      kLogs,
+      index_name_,
+      "",
+      max_log_lines_,
+      [&](const std::string& index, const std::string& value) {
+        bool is_result = isResultIndex(index);
+        (is_result ? result_indexes : status_indexes).push_back(index);
+        (is_result ? results : statuses).push_back(value);
+        return true;
+      },
+      next_index);
 
   // If any results/statuses were found in the flushed buffer, send.
   if (results.size() > 0) {
-    status = send(results, "result");
+    size_t sent = 0;
+    status = sendOrdered(results, "result", sent);
+
+    // Clear the results logs that were sent.
+    result_indexes.resize(std::min(sent, result_indexes.size()));
+    iterate(result_indexes, ([this](std::string& index) {
+              deleteValueWithCount(kLogs, index);
+            }));
+
     if (!status.ok()) {
       VLOG(1) << "Error sending results to logger: " << status.getMessage();
 
       if (interrupted()) {
         return;
       }
-    } else {
-      // Clear the results logs once they were sent.
-      iterate(indexes, ([this](std::string& index) {
-                if (!isResultIndex(index)) {
-                  return;
-                }
-                deleteValueWithCount(kLogs, index);
-              }));
     }
   }
 
   if (statuses.size() > 0) {
-    status = send(statuses, "status");
+    size_t sent = 0;
+    status = sendOrdered(statuses, "status", sent);
+
+    // Clear the status logs that were sent.
+    status_indexes.resize(std::min(sent, status_indexes.size()));
+    iterate(status_indexes, ([this](std::string& index) {
+              deleteValueWithCount(kLogs, index);
+            }));
+
     if (!status.ok()) {
       VLOG(1) << "Error sending status to logger: " << status.getMessage();
 
       if (interrupted()) {
         return;
       }
-    } else {
-      // Clear the status logs once they were sent.
-      iterate(indexes, ([this](std::string& index) {
-                if (!isStatusIndex(index)) {
-                  return;
-                }
-                deleteValueWithCount(kLogs, index);
-              }));
     }
   }
 
@@ -113,7 +157,111 @@ void BufferedLogForwarder::check() {
   }
 }
 
+Status BufferedLogForwarder::sendOrdered(std::vector<std::string>& log_data,
+                                         const std::string& log_type,
+                                         size_t& sent) {
+  auto count = log_data.size();
+  auto status = send(log_data, log_type);
+  sent = status.ok() ? count : 0;
+  return status;
+}
+
+void BufferedLogForwarder::checkSpools() {
+  auto status = openSpools();
+  if (!status.ok()) {
+    VLOG(1) << "Cannot open the log spools: " << status.getMessage();
+    return;
+  }
+
+  // Results are read first, as the database keys of results sort first.
+  std::vector<std::string> results, statuses;
+  status = result_spool_->read(max_log_lines_, results);
+  if (status.ok() && results.size() < max_log_lines_) {
+    status = status_spool_->read(max_log_lines_ - results.size(), statuses);
+  }
+  if (!status.ok()) {
+    VLOG(1) << "Cannot read the log spools: " << status.getMessage();
+  }
+
+  auto forward = [this](LogSpool& spool,
+                        std::vector<std::string>& lines,
+                        const std::string& log_type) {
+    size_t sent = 0;
+    auto send_status = sendOrdered(lines, log_type, sent);
+
+    // Segments are dropped whole once all their logs were sent.
+    if (sent > 0) {
+      auto ack_status = spool.acknowledge(sent);
+      if (!ack_status.ok()) {
+        LOG(ERROR) << "Cannot save the log spool cursor: "
+                   << ack_status.getMessage();
+      }
+
+      RecursiveLock lock(count_mutex_);
+      buffer_count_ -= std::min<unsigned long long int>(buffer_count_, sent);
+    }
+
+    if (!send_status.ok()) {
+      VLOG(1) << "Error sending " << log_type
+              << " to logger: " << send_status.getMessage();
+      return false;
+    }
+    return true;
+  };
+
+  if (results.size() > 0 && !forward(*result_spool_, results, "result") &&
+      interrupted()) {
+    return;
+  }
+
+  if (statuses.size() > 0 && !forward(*status_spool_, statuses, "status") &&
+      interrupted()) {
+    return;
+  }
+
+  // Purge any logs exceeding the max after our send attempt
+  if (FLAGS_buffered_log_max > 0) {
+    purgeSpools();
+  }
+}
+
+void BufferedLogForwarder::purgeSpools() {
+  RecursiveLock lock(count_mutex_);
+  if (buffer_count_ <= FLAGS_buffered_log_max || result_spool_ == nullptr) {
+    return;
+  }
+
+  LOG(WARNING) << "Purging buffered logs limit (" << FLAGS_buffered_log_max
+               << ") exceeded: " << buffer_count_;
+
+  // The oldest segment of the larger spool is dropped whole, until the count
+  // is under the max.
+  while (buffer_count_ > FLAGS_buffered_log_max) {
+    auto& spool = (result_spool_->size() >= status_spool_->size())
+                      ? result_spool_
+                      : status_spool_;
+    if (spool->size() == 0) {
+      buffer_count_ = 0;
+      break;
+    }
+
+    uint64_t dropped = 0;
+    auto status = spool->dropOldestSegment(dropped);
+    if (!status.ok()) {
+      LOG(ERROR) << "Error dropping a segment during buffered log purge: "
+                 << status.getMessage();
+      return;
+    }
+    buffer_count_ -= std::min<unsigned long long int>(buffer_count_, dropped);
+  }
+}
+
 void BufferedLogForwarder::purge() {
+  if (isSpooled()) {
+    purgeSpools();
+    return;
+  }
+
   RecursiveLock lock(count_mutex_);
   if (buffer_count_ <= FLAGS_buffered_log_max) {
     return;
@@ -175,16 +323,18 @@ void BufferedLogForwarder::purge() {
   });
 }
 
-void BufferedLogForwarder::start() {
-  while (!interrupted()) {
-    check();
+std::chrono::milliseconds BufferedLogForwarder::runOnce() {
+  check();
 
-    // Cool off and time wait the configured period.
-    pause(std::chrono::milliseconds(log_period_));
-  }
+  // Cool off and time wait the configured period.
+  return log_period_;
 }
 
 Status BufferedLogForwarder::logString(const std::string& s, uint64_t time) {
+  if (isSpooled()) {
+    return spoolValueWithCount(true, s);
+  }
+
   std::string index = genResultIndex(time);
   return addValueWithCount(kLogs, index, s);
 }
@@ -230,8 +380,13 @@ Status BufferedLogForwarder::logStatus(const std::vector<StatusLogLine>& log,
     if (!json.empty()) {
       json.pop_back();
     }
-    std::string index = genStatusIndex(time);
-    Status status = addValueWithCount(kLogs, index, json);
+    Status status;
+    if (isSpooled()) {
+      status = spoolValueWithCount(false, json);
+    } else {
+      std::string index = genStatusIndex(time);
+      status = addValueWithCount(kLogs, index, json);
+    }
     if (!status.ok()) {
       // Do not continue if any line fails.
       return status;
@@ -296,4 +451,47 @@ Status BufferedLogForwarder::deleteValueWithCount(const std::string& domain,
   }
   return status;
 }
+
+Status BufferedLogForwarder::openSpools() {
+  std::lock_guard<std::mutex> lock(spool_mutex_);
+  if (result_spool_ != nullptr) {
+    return Status::success();
+  }
+
+  // Each forwarder spools its result and status logs separately, so that a
+  // failed send of one type does not resend the other.
+  auto path = fs::path(FLAGS_buffered_log_spool_path) / index_name_;
+  auto results = std::make_unique<LogSpool>(path / "results",
+                                            FLAGS_buffered_log_segment_size);
+  auto statuses = std::make_unique<LogSpool>(path / "statuses",
+                                             FLAGS_buffered_log_segment_size);
+
+  auto status = results->open();
+  if (status.ok()) {
+    status = statuses->open();
+  }
+  if (!status.ok()) {
+    return status;
+  }
+
+  status_spool_ = std::move(statuses);
+  result_spool_ = std::move(results);
+  return Status::success();
+}
+
+Status BufferedLogForwarder::spoolValueWithCount(bool results,
+                                                 const std::string& value) {
+  auto status = openSpools();
+  if (!status.ok()) {
+    return status;
+  }
+
+  auto& spool = results ? result_spool_ : status_spool_;
+  status = spool->append(value);
+  if (status.ok()) {
+    RecursiveLock lock(count_mutex_);
+    buffer_count_++;
+  }
+  return status;
+}
 } // namespace osquery
@@ -11,6 +11,7 @@
 
 #include <chrono>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
@@ -18,6 +19,7 @@
 
 #include <osquery/core/plugins/logger.h>
 #include <osquery/dispatcher/dispatcher.h>
+#include <plugins/logger/log_spool.h>
 
 namespace osquery {
 
@@ -44,10 +46,13 @@ inline void iterate(std::vector<std::string>& input,
  * status and result logs. Subclasses take advantage of this reliable sending
  * logic, and implement their own methods for actually sending logs.
  *
+ * When buffered_log_spool_path is set, logs are buffered in a LogSpool for
+ * each log type instead of one database key for each log line.
+ *
  * Subclasses must define the send() method, and if a subclass overrides
  * setUp(), it **MUST** call this base class setUp() from that method.
  */
-class BufferedLogForwarder : public InternalRunnable {
+class BufferedLogForwarder : public PeriodicRunnable {
  protected:
   static const std::chrono::seconds kLogPeriod;
   static const uint64_t kMaxLogLines;
@@ -57,7 +62,7 @@ class BufferedLogForwarder : public InternalRunnable {
   // subclasses should expose appropriate constructors to their users.
   explicit BufferedLogForwarder(const std::string& service_name,
                                 const std::string& name)
-      : InternalRunnable(service_name),
+      : PeriodicRunnable(service_name),
         log_period_(kLogPeriod),
         max_log_lines_(kMaxLogLines),
         index_name_(name) {}
@@ -67,7 +72,7 @@ class BufferedLogForwarder : public InternalRunnable {
       const std::string& service_name,
       const std::string& name,
       const std::chrono::duration<Rep, Period>& log_period)
-      : InternalRunnable(service_name),
+      : PeriodicRunnable(service_name),
         log_period_(
             std::chrono::duration_cast<std::chrono::seconds>(log_period)),
         max_log_lines_(kMaxLogLines),
@@ -79,15 +84,15 @@ class BufferedLogForwarder : public InternalRunnable {
       const std::string& name,
       const std::chrono::duration<Rep, Period>& log_period,
       uint64_t max_log_lines)
-      : InternalRunnable(service_name),
+      : PeriodicRunnable(service_name),
         log_period_(
             std::chrono::duration_cast<std::chrono::seconds>(log_period)),
         max_log_lines_(max_log_lines),
         index_name_(name) {}
 
  public:
-  /// A simple wait lock, and flush based on settings.
-  void start() override;
+  /// Flush based on settings, then wait the log period.
+  std::chrono::milliseconds runOnce() override;
 
   /**
    * @brief Set up the forwarder. May be used to init remote clients, etc.
@@ -130,6 +135,18 @@ class BufferedLogForwarder : public InternalRunnable {
   virtual Status send(std::vector<std::string>& log_data,
                       const std::string& log_type) = 0;
 
+  /**
+   * @brief Send labeled logs, confirming the leading lines that were sent.
+   *
+   * The default sends all lines with send(). Forwarders that split the lines
+   * into concurrent requests set sent to the lines of the leading requests
+   * that succeeded, even when a later request failed. Only the sent lines are
+   * removed from the buffer.
+   */
+  virtual Status sendOrdered(std::vector<std::string>& log_data,
+                             const std::string& log_type,
+                             size_t& sent);
+
   /**
    * @brief Check for new logs and send.
    *
@@ -148,6 +165,12 @@ class BufferedLogForwarder : public InternalRunnable {
    */
   void purge();
 
+  /// Send the spooled logs, the spool counterpart of check.
+  void checkSpools();
+
+  /// Drop the oldest spool segments, if the max is exceeded.
+  void purgeSpools();
+
  protected:
   /// Return whether the string is a result index
   bool isResultIndex(const std::string& index);
@@ -186,6 +209,12 @@ class BufferedLogForwarder : public InternalRunnable {
   Status deleteValueWithCount(const std::string& domain,
                               const std::string& key);
 
+  /// Open the result and status spools, if they are not open yet.
+  Status openSpools();
+
+  /// Append a log line to the spool of its type while maintaining count.
+  Status spoolValueWithCount(bool results, const std::string& value);
+
  protected:
   /// Seconds between flushing logs
   std::chrono::seconds log_period_;
@@ -211,5 +240,12 @@ class BufferedLogForwarder : public InternalRunnable {
 
   /// Protects the count of buffered logs
   RecursiveMutex count_mutex_;
+
+  /// Spools of the result and status logs, see buffered_log_spool_path.
+  std::unique_ptr<LogSpool> result_spool_;
+  std::unique_ptr<LogSpool> status_spool_;
+
+  /// Protects opening the spools.
+  std::mutex spool_mutex_;
 };
 }
@@ -8,6 +8,7 @@
  */
 
 #include "filesystem_logger.h"
+#include "async_log_file.h"
 #include "logrotate.h"
 
 #include <osquery/core/flags.h>
@@ -76,6 +77,21 @@ FLAG(uint64,
      25 * 1024 * 1024,
      "Size for each filesystem log in bytes");
 
+FLAG(bool,
+     logger_async,
+     false,
+     "Write results and snapshots to the filesystem on a writer thread");
+
+FLAG(string,
+     logger_fsync,
+     "never",
+     "When the writer thread syncs log files (never, interval, batch)");
+
+FLAG(uint64,
+     logger_fsync_interval,
+     1000,
+     "Milliseconds between syncs when logger_fsync is interval");
+
 CLI_FLAG(string,
          logger_mode,
          "0640",
@@ -199,6 +215,10 @@ struct FilesystemLoggerPlugin::impl {
   /// Filesystem snapshot log write mutex.
   Mutex results_mutex;
 
+  /// Results and snapshot writer threads, if logger_async is set.
+  std::unique_ptr<AsyncLogFile> results_writer{nullptr};
+  std::unique_ptr<AsyncLogFile> snapshot_writer{nullptr};
+
   /// The FLAGS_logger_mode interpreted as a number in octal form, converted to
   /// integer
   std::int32_t logger_mode_octal;
@@ -210,18 +230,56 @@ FilesystemLoggerPlugin::FilesystemLoggerPlugin()
 FilesystemLoggerPlugin::~FilesystemLoggerPlugin() = default;
 
 Status FilesystemLoggerPlugin::setUp() {
+  // Writers use the rotators, they stop first.
+  pimpl_->results_writer.reset();
+  pimpl_->snapshot_writer.reset();
+
   pimpl_->log_path = fs::path(FLAGS_logger_path);
   pimpl_->results_rotate = std::make_unique<LogRotate>(
       (pimpl_->log_path / kFilesystemLoggerFilename).string());
   pimpl_->snapshot_rotate = std::make_unique<LogRotate>(
       (pimpl_->log_path / kFilesystemLoggerSnapshots).string());
 
+  if (FLAGS_logger_async) {
+    auto policy = getLogSyncPolicy(FLAGS_logger_fsync);
+    auto interval = std::chrono::milliseconds(FLAGS_logger_fsync_interval);
+    auto results_writer = std::make_unique<AsyncLogFile>(
+        (pimpl_->log_path / kFilesystemLoggerFilename).string(),
+        pimpl_->logger_mode_octal,
+        pimpl_->results_rotate.get(),
+        policy,
+        interval);
+    auto snapshot_writer = std::make_unique<AsyncLogFile>(
+        (pimpl_->log_path / kFilesystemLoggerSnapshots).string(),
+        pimpl_->logger_mode_octal,
+        pimpl_->snapshot_rotate.get(),
+        policy,
+        interval);
+
+    // Starting the writers creates both logs.
+    auto status = results_writer->start();
+    if (status.ok()) {
+      status = snapshot_writer->start();
+    }
+    if (!status.ok()) {
+      return status;
+    }
+
+    pimpl_->results_writer = std::move(results_writer);
+    pimpl_->snapshot_writer = std::move(snapshot_writer);
+    return Status::success();
+  }
+
   // Ensure that we create the results log here.
   WriteLock lock(pimpl_->results_mutex);
   return logStringToFile("", kFilesystemLoggerFilename, true);
 }
 
 Status FilesystemLoggerPlugin::logString(const std::string& s) {
+  if (pimpl_->results_writer != nullptr) {
+    return pimpl_->results_writer->write(s);
+  }
+
   WriteLock lock(pimpl_->results_mutex);
   if (FLAGS_logger_rotate && pimpl_->results_rotate->shouldRotate()) {
     auto s = pimpl_->results_rotate->rotate(FLAGS_logger_rotate_max_files);
@@ -235,6 +293,10 @@ Status FilesystemLoggerPlugin::logString(const std::string& s) {
 
 Status FilesystemLoggerPlugin::logSnapshot(const std::string& s) {
   // Send the snapshot data to a separate filename.
+  if (pimpl_->snapshot_writer != nullptr) {
+    return pimpl_->snapshot_writer->write(s);
+  }
+
   WriteLock lock(pimpl_->snapshot_mutex);
   if (FLAGS_logger_rotate && pimpl_->snapshot_rotate->shouldRotate()) {
     auto s = pimpl_->snapshot_rotate->rotate(FLAGS_logger_rotate_max_files);
@@ -20,6 +20,8 @@
 #include <unistd.h>
 #endif
 
+#include <algorithm>
+
 #include <boost/algorithm/string/find.hpp>
 
 #include <osquery/config/config.h>
@@ -28,6 +30,7 @@
 #include <osquery/core/flags.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/core/system.h>
+#include <osquery/numeric_monitoring/numeric_monitoring.h>
 #include <osquery/utils/json/json.h>
 
 #include <plugins/config/parsers/kafka_topics.h>
@@ -39,6 +42,7 @@ DECLARE_string(tls_client_cert);
 DECLARE_string(tls_client_key);
 DECLARE_string(tls_server_certs);
 DECLARE_bool(verbose);
+DECLARE_uint64(buffered_log_segment_size);
 
 FLAG(string,
      logger_kafka_brokers,
@@ -59,6 +63,35 @@ FLAG(
     "none",
     "Compression codec to use for compressing message sets ('none' or 'gzip')");
 
+FLAG(uint64,
+     logger_kafka_linger_ms,
+     0,
+     "Milliseconds to wait for messages to batch (default librdkafka's)");
+
+FLAG(uint64,
+     logger_kafka_batch_size,
+     0,
+     "Max number of messages batched in one request (default librdkafka's)");
+
+FLAG(string,
+     logger_kafka_partition_key,
+     "",
+     "Message key choosing the partition ('', 'host_identifier', "
+     "'query_name')");
+
+FLAG(uint64,
+     logger_kafka_max_inflight,
+     0,
+     "Max number of messages waiting for a delivery report (0 for no limit)");
+
+FLAG(string,
+     logger_kafka_spool_path,
+     "",
+     "Directory spooling the messages that do not fit the in-flight window");
+
+/// Max number of spooled messages produced at once.
+const uint64_t kKafkaSpoolReadLines = 1024;
+
 /// How often to poll Kafka broker for publish results.
 const std::chrono::seconds kKafkaPollDuration = std::chrono::seconds(5);
 
@@ -113,39 +146,134 @@ std::once_flag KafkaProducerPlugin::shutdownFlag_;
  * Parses the query name from snapshot, batch, and event
  * mode JSON result objects.
  */
-inline std::string getMsgName(const std::string& payload) {
-  const std::string fieldName = "name";
+std::string getMsgName(const std::string& payload) {
+  std::string name;
+  std::string host_identifier;
+  getMsgFields(payload, name, host_identifier);
+  return name;
+}
 
-  // Parse payload as JSON
+void getMsgFields(const std::string& payload,
+                  std::string& name,
+                  std::string& host_identifier) {
+  name.clear();
+  host_identifier.clear();
+
+  // Parse payload as JSON, the fields stay empty if it is not a JSON object.
   auto doc = JSON::newObject();
-  // If failed to parse as JSON, or JSON object doesn't have "name" top-level
-  // key, return base topic
   if (!doc.fromString(payload, JSON::ParseMode::Iterative) ||
-      !doc.doc().HasMember(fieldName)) {
-    return "";
+      !doc.doc().IsObject()) {
+    return;
   }
-  auto& name = doc.doc()[fieldName];
-  // If value for "name" isn't a String, return base topic
-  if (!name.IsString()) {
-    return "";
+
+  // Only top-level string values are used, a missing "name" means the base
+  // topic.
+  auto it = doc.doc().FindMember("name");
+  if (it != doc.doc().MemberEnd() && it->value.IsString()) {
+    name = it->value.GetString();
+  }
+
+  it = doc.doc().FindMember("hostIdentifier");
+  if (it != doc.doc().MemberEnd() && it->value.IsString()) {
+    host_identifier = it->value.GetString();
   }
-  // Otherwise, return value
-  return name.GetString();
 }
 
 /**
  * @brief callback for status of message delivery
  *
- * Logs an error message for failed deliveries; does nothing if successful.
- * Callback is invoked by rd_kafka_poll.
+ * Logs an error message for failed deliveries, and passes every report to
+ * the plugin set as the configuration opaque. Callback is invoked by
+ * rd_kafka_poll.
  */
 void onMsgDelivery(rd_kafka_t* rk,
                    const rd_kafka_message_t* rkmessage,
                    void* opaque) {
-  if (rkmessage->err != RD_KAFKA_RESP_ERR_NO_ERROR) {
+  bool delivered = (rkmessage->err == RD_KAFKA_RESP_ERR_NO_ERROR);
+  if (!delivered) {
     LOG(ERROR) << "Kafka message delivery failed: "
                << rd_kafka_err2str(rkmessage->err);
   }
+
+  // The brokers would refuse these messages again.
+  bool retriable = (rkmessage->err != RD_KAFKA_RESP_ERR_MSG_SIZE_TOO_LARGE &&
+                    rkmessage->err != RD_KAFKA_RESP_ERR_INVALID_MSG);
+
+  if (opaque != nullptr) {
+    static_cast<KafkaProducerPlugin*>(opaque)->onDelivery(
+        std::string(static_cast<const char*>(rkmessage->payload),
+                    rkmessage->len),
+        delivered,
+        retriable,
+        rd_kafka_message_latency(rkmessage));
+  }
+}
+
+void KafkaProducerPlugin::onDelivery(const std::string& payload,
+                                     bool delivered,
+                                     bool retriable,
+                                     int64_t latency_us) {
+  // Never wrap below zero, even for a report of a message not counted.
+  auto in_flight = inFlight_.load();
+  while (in_flight > 0 &&
+         !inFlight_.compare_exchange_weak(in_flight, in_flight - 1)) {
+  }
+
+  {
+    WriteLock lock(statsMutex_);
+    if (delivered) {
+      stats_.delivered++;
+      if (latency_us >= 0) {
+        auto latency = static_cast<uint64_t>(latency_us);
+        stats_.latency_us += latency;
+        stats_.max_latency_us = std::max(stats_.max_latency_us, latency);
+      }
+    } else {
+      stats_.failed++;
+    }
+  }
+
+  if (!delivered && retriable && spool_ != nullptr) {
+    auto status = spoolMsg(payload);
+    if (!status.ok()) {
+      LOG(ERROR) << "Could not spool Kafka message: " << status.getMessage();
+    }
+  }
+}
+
+KafkaDeliveryStats KafkaProducerPlugin::getDeliveryStats() const {
+  ReadLock lock(statsMutex_);
+  return stats_;
+}
+
+void KafkaProducerPlugin::recordStats() {
+  auto stats = getDeliveryStats();
+  auto delivered = stats.delivered - recordedStats_.delivered;
+  auto latency_us = stats.latency_us - recordedStats_.latency_us;
+
+  auto sum = monitoring::PreAggregationType::Sum;
+  monitoring::record("kafka.delivered",
+                     static_cast<monitoring::ValueType>(delivered),
+                     sum);
+  monitoring::record(
+      "kafka.failed",
+      static_cast<monitoring::ValueType>(stats.failed - recordedStats_.failed),
+      sum);
+  monitoring::record("kafka.spooled",
+                     static_cast<monitoring::ValueType>(
+                         stats.spooled - recordedStats_.spooled),
+                     sum);
+  if (delivered > 0) {
+    monitoring::record(
+        "kafka.latency_ms",
+        static_cast<monitoring::ValueType>(latency_us / delivered / 1000),
+        monitoring::PreAggregationType::Avg);
+  }
+  monitoring::record("kafka.in_flight",
+                     static_cast<monitoring::ValueType>(inFlight_.load()),
+                     monitoring::PreAggregationType::Max);
+
+  recordedStats_ = stats;
 }
 
 void KafkaProducerPlugin::flushMessages() {
@@ -165,6 +293,8 @@ void KafkaProducerPlugin::start() {
       return;
     }
     pollKafka();
+    drainSpool();
+    recordStats();
   }
 }
 
@@ -211,8 +341,21 @@ void KafkaProducerPlugin::init(const std::string& name,
     return;
   }
 
-  // Register send callback.
+  // Zero keeps the librdkafka defaults.
+  if ((FLAGS_logger_kafka_linger_ms > 0 &&
+       !setConf(conf,
+                "linger.ms",
+                std::to_string(FLAGS_logger_kafka_linger_ms))) ||
+      (FLAGS_logger_kafka_batch_size > 0 &&
+       !setConf(conf,
+                "batch.num.messages",
+                std::to_string(FLAGS_logger_kafka_batch_size)))) {
+    return;
+  }
+
+  // Register send callback, reporting to this plugin.
   rd_kafka_conf_set_dr_msg_cb(conf, onMsgDelivery);
+  rd_kafka_conf_set_opaque(conf, this);
 
   // Create producer handle.
   char errstr[512] = {0};
@@ -233,6 +376,17 @@ void KafkaProducerPlugin::init(const std::string& name,
     return;
   }
 
+  if (!FLAGS_logger_kafka_spool_path.empty()) {
+    auto spool = std::make_unique<LogSpool>(FLAGS_logger_kafka_spool_path,
+                                            FLAGS_buffered_log_segment_size);
+    auto status = spool->open();
+    if (!status.ok()) {
+      LOG(ERROR) << "Could not open Kafka spool: " << status.getMessage();
+    } else {
+      spool_ = std::move(spool);
+    }
+  }
+
   // Start bg loop for polling to ensure onMsgDelivery callback is invoked even
   // at times were no messages are produced
   // (http://docs.confluent.io/2.0.0/clients/producer.html#asynchronous-writes)
@@ -248,26 +402,31 @@ Status KafkaProducerPlugin::logString(const std::string& payload) {
         1, "Cannot log because Kafka producer did not initiate properly.");
   }
 
-  std::string name(getMsgName(payload));
-
-  rd_kafka_topic_t* topic = nullptr;
-  try {
-    topic = queryToTopics_.at(name);
-  } catch (const std::out_of_range& _) {
-    topic = queryToTopics_[kKafkaBaseTopic];
-  }
-
+  std::string key;
+  auto topic = resolveMsg(payload, key);
   if (topic == nullptr) {
     std::string errMsg(
         "Could not publish message: Topic not configured for message name '" +
-        name + "'");
+        getMsgName(payload) + "'");
     LOG(ERROR) << errMsg;
     return Status(2, errMsg);
   }
 
-  Status status = publishMsg(topic, payload);
+  // New messages wait behind the spooled ones, keeping their order.
+  Status status;
+  if (spool_ != nullptr && spool_->size() > 0) {
+    status = spoolMsg(payload);
+  } else {
+    status = produce(topic, payload, key);
+    if (!status.ok() && spool_ != nullptr) {
+      status = spoolMsg(payload);
+    }
+  }
+
   if (!status.ok()) {
     LOG(ERROR) << "Could not publish message: " << status.getMessage();
+    WriteLock lock(statsMutex_);
+    stats_.failed++;
   }
 
   // Poll after every produce attempt.
@@ -276,15 +435,110 @@ Status KafkaProducerPlugin::logString(const std::string& payload) {
   return status;
 }
 
+rd_kafka_topic_t* KafkaProducerPlugin::resolveMsg(const std::string& payload,
+                                                  std::string& key) {
+  std::string name;
+  std::string host_identifier;
+  getMsgFields(payload, name, host_identifier);
+
+  // Messages of one host or query share a partition, keeping their order.
+  if (FLAGS_logger_kafka_partition_key == "host_identifier" &&
+      !host_identifier.empty()) {
+    key = host_identifier;
+  } else if (FLAGS_logger_kafka_partition_key == "query_name" &&
+             !name.empty()) {
+    key = name;
+  } else {
+    key = msgKey_;
+  }
+
+  auto it = queryToTopics_.find(name);
+  if (it != queryToTopics_.end()) {
+    return it->second;
+  }
+
+  it = queryToTopics_.find(kKafkaBaseTopic);
+  return (it != queryToTopics_.end()) ? it->second : nullptr;
+}
+
+Status KafkaProducerPlugin::produce(rd_kafka_topic_t* topic,
+                                    const std::string& payload,
+                                    const std::string& key) {
+  // Count the message first, its delivery may be reported on another thread.
+  auto in_flight = inFlight_.fetch_add(1);
+  if (FLAGS_logger_kafka_max_inflight > 0 &&
+      in_flight >= FLAGS_logger_kafka_max_inflight) {
+    inFlight_--;
+    return Status(3, "The Kafka in-flight window is full");
+  }
+
+  auto status = publishMsg(topic, payload, key);
+  if (!status.ok()) {
+    inFlight_--;
+  }
+  return status;
+}
+
+Status KafkaProducerPlugin::spoolMsg(const std::string& payload) {
+  auto status = spool_->append(payload);
+  if (status.ok()) {
+    WriteLock lock(statsMutex_);
+    stats_.spooled++;
+  }
+  return status;
+}
+
+void KafkaProducerPlugin::drainSpool() {
+  while (spool_ != nullptr && spool_->size() > 0 && running_.load() &&
+         !interrupted()) {
+    auto lines = kKafkaSpoolReadLines;
+    if (FLAGS_logger_kafka_max_inflight > 0) {
+      auto in_flight = inFlight_.load();
+      if (in_flight >= FLAGS_logger_kafka_max_inflight) {
+        return;
+      }
+      lines = std::min<uint64_t>(
+          lines, FLAGS_logger_kafka_max_inflight - in_flight);
+    }
+
+    std::vector<std::string> payloads;
+    auto status = spool_->read(lines, payloads);
+    if (!status.ok() || payloads.empty()) {
+      return;
+    }
+
+    // Acknowledge the messages produced or dropped, in spool order.
+    uint64_t handled = 0;
+    for (const auto& payload : payloads) {
+      std::string key;
+      auto topic = resolveMsg(payload, key);
+      if (topic == nullptr) {
+        WriteLock lock(statsMutex_);
+        stats_.failed++;
+      } else if (!produce(topic, payload, key).ok()) {
+        break;
+      }
+      handled++;
+    }
+
+    spool_->acknowledge(handled);
+    pollKafka();
+    if (handled < payloads.size()) {
+      return;
+    }
+  }
+}
+
 Status KafkaProducerPlugin::publishMsg(rd_kafka_topic_t* topic,
-                                       const std::string& payload) {
+                                       const std::string& payload,
+                                       const std::string& key) {
   if (rd_kafka_produce(topic,
                        RD_KAFKA_PARTITION_UA,
                        RD_KAFKA_MSG_F_COPY,
                        (char*)payload.c_str(),
                        payload.length(),
-                       msgKey_.c_str(), // Optional key
-                       msgKey_.length(), // key length
+                       key.c_str(), // Optional key
+                       key.length(), // key length
                        nullptr) == -1) {
     return Status(1,
                   "Failed to produce on Kafka topic " +
@@ -10,6 +10,7 @@
 #pragma once
 
 #include <atomic>
+#include <memory>
 #include <mutex>
 
 #include <librdkafka/rdkafka.h>
@@ -17,6 +18,7 @@
 #include <osquery/core/core.h>
 #include <osquery/core/plugins/logger.h>
 #include <osquery/dispatcher/dispatcher.h>
+#include <plugins/logger/log_spool.h>
 
 namespace osquery {
 
@@ -27,6 +29,27 @@ extern const std::string kKafkaBaseTopic;
 /// Retrieves log payload field "name".
 std::string getMsgName(const std::string& payload);
 
+/// Retrieves log payload fields "name" and "hostIdentifier" with one parse.
+void getMsgFields(const std::string& payload,
+                  std::string& name,
+                  std::string& host_identifier);
+
+/// Delivery counters of the Kafka producer since it started.
+struct KafkaDeliveryStats {
+  /// Messages acknowledged by the brokers.
+  uint64_t delivered{0};
+
+  /// Messages the brokers did not acknowledge or that could not be produced.
+  uint64_t failed{0};
+
+  /// Messages appended to the spool, including failed deliveries.
+  uint64_t spooled{0};
+
+  /// Sum and max of the delivery latency of the delivered messages.
+  uint64_t latency_us{0};
+  uint64_t max_latency_us{0};
+};
+
 class KafkaProducerPlugin : public LoggerPlugin, public InternalRunnable {
  public:
   /*
@@ -61,6 +84,26 @@ class KafkaProducerPlugin : public LoggerPlugin, public InternalRunnable {
    */
   void stop() override;
 
+  /**
+   * @brief Account for the delivery report of a message.
+   *
+   * Called by the delivery report callback while polling. A message the
+   * brokers did not acknowledge is appended to the spool, if there is one,
+   * unless the brokers would refuse it again.
+   *
+   * @param payload The message body.
+   * @param delivered True if the brokers acknowledged the message.
+   * @param retriable False if the message can never be delivered.
+   * @param latency_us Microseconds from produce to the report, -1 if unknown.
+   */
+  void onDelivery(const std::string& payload,
+                  bool delivered,
+                  bool retriable,
+                  int64_t latency_us);
+
+  /// The delivery counters.
+  KafkaDeliveryStats getDeliveryStats() const;
+
   KafkaProducerPlugin() : InternalRunnable("kafka_producer"), running_(false) {}
   ~KafkaProducerPlugin() {}
 
@@ -73,11 +116,13 @@ class KafkaProducerPlugin : public LoggerPlugin, public InternalRunnable {
    *
    * @param topic Kafka topic to publish to
    * @param msg message body
+   * @param key message key, the partitioner hashes it to choose a partition
    *
    * @return Status of publish attempt
    */
   virtual Status publishMsg(rd_kafka_topic_t* topic,
-                            const std::string& payload);
+                            const std::string& payload,
+                            const std::string& key);
 
   /**
    * @brief Flushes all buffered messages to Kafka, waiting for a maximum of 3
@@ -91,13 +136,44 @@ class KafkaProducerPlugin : public LoggerPlugin, public InternalRunnable {
    */
   virtual void pollKafka();
 
+  /**
+   * @brief Produce the spooled messages while the in-flight window has room.
+   *
+   * Messages without a configured topic are dropped from the spool.
+   */
+  void drainSpool();
+
   /// Boolean representing whether the logger is running.
   std::atomic<bool> running_;
 
   /// Map of query names to Kafka topic.
   std::map<std::string, rd_kafka_topic_t*> queryToTopics_;
 
+  /// Messages produced and not yet reported by a delivery callback.
+  std::atomic<uint64_t> inFlight_{0};
+
+  /// Holds messages while the window is full, see logger_kafka_spool_path.
+  std::unique_ptr<LogSpool> spool_;
+
  private:
+  /**
+   * @brief Find the topic and the key of a message.
+   *
+   * @return The topic, nullptr if no topic is configured for the message.
+   */
+  rd_kafka_topic_t* resolveMsg(const std::string& payload, std::string& key);
+
+  /// Count and publish a message, if the in-flight window has room.
+  Status produce(rd_kafka_topic_t* topic,
+                 const std::string& payload,
+                 const std::string& key);
+
+  /// Append a message to the spool.
+  Status spoolMsg(const std::string& payload);
+
+  /// Record the counters changed since the last call with numeric monitoring.
+  void recordStats();
+
   /// Configures Kafka topics accordingly.
   bool configureTopics();
 
@@ -118,6 +194,13 @@ class KafkaProducerPlugin : public LoggerPlugin, public InternalRunnable {
   /// Mutex for managing access to the producer_ pointer.
   Mutex producerMutex_;
 
+  /// Delivery counters and the counters recorded by recordStats.
+  KafkaDeliveryStats stats_;
+  KafkaDeliveryStats recordedStats_;
+
+  /// Mutex for the delivery counters.
+  mutable Mutex statsMutex_;
+
   /// Flag to ensure shutdown method is called only once
   static std::once_flag shutdownFlag_;
 };
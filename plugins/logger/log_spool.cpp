@@ -0,0 +1,338 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "log_spool.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include <boost/crc.hpp>
+#include <boost/filesystem.hpp>
+
+#include <osquery/filesystem/fileops.h>
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/logger/logger.h>
+#include <osquery/utils/conversions/split.h>
+#include <osquery/utils/conversions/tryto.h>
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+/// Bytes of the length and CRC-32 before each record.
+const size_t kLogSpoolHeaderSize = 8;
+
+/// Larger lengths can only be read from a corrupted record.
+const uint32_t kLogSpoolMaxRecordSize = 256 * 1024 * 1024;
+
+const std::string kLogSpoolSegmentExtension{".seg"};
+const std::string kLogSpoolCursorFile{"cursor"};
+
+namespace {
+
+enum class RecordRead { kRecord, kEnd, kCorrupt };
+
+uint32_t getChecksum(const std::string& payload) {
+  boost::crc_32_type crc;
+  crc.process_bytes(payload.data(), payload.size());
+  return crc.checksum();
+}
+
+void encodeUInt32(uint32_t value, char* bytes) {
+  for (size_t i = 0; i < 4; i++) {
+    bytes[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+  }
+}
+
+uint32_t decodeUInt32(const char* bytes) {
+  uint32_t value = 0;
+  for (size_t i = 0; i < 4; i++) {
+    value |= static_cast<uint32_t>(static_cast<unsigned char>(bytes[i]))
+             << (8 * i);
+  }
+  return value;
+}
+
+/// Read the next record, the offset is moved past complete records only.
+RecordRead readRecord(std::istream& in,
+                      uint64_t& offset,
+                      std::string& payload) {
+  char header[kLogSpoolHeaderSize];
+  in.read(header, sizeof(header));
+  if (in.gcount() == 0) {
+    return RecordRead::kEnd;
+  } else if (in.gcount() != sizeof(header)) {
+    return RecordRead::kCorrupt;
+  }
+
+  auto length = decodeUInt32(header);
+  if (length > kLogSpoolMaxRecordSize) {
+    return RecordRead::kCorrupt;
+  }
+
+  payload.resize(length);
+  in.read(&payload[0], length);
+  if (static_cast<uint32_t>(in.gcount()) != length ||
+      getChecksum(payload) != decodeUInt32(header + 4)) {
+    return RecordRead::kCorrupt;
+  }
+
+  offset += sizeof(header) + length;
+  return RecordRead::kRecord;
+}
+
+/// Count the complete records of a segment after an offset.
+uint64_t countRecords(const fs::path& path, uint64_t offset) {
+  std::ifstream in(path.string(), std::ios::in | std::ios::binary);
+  in.seekg(static_cast<std::streamoff>(offset));
+
+  uint64_t count = 0;
+  std::string payload;
+  while (readRecord(in, offset, payload) == RecordRead::kRecord) {
+    ++count;
+  }
+  return count;
+}
+
+} // namespace
+
+LogSpool::LogSpool(const fs::path& path, uint64_t segment_size)
+    : path_(path), segment_size_(segment_size) {}
+
+LogSpool::~LogSpool() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (writer_.is_open()) {
+    writer_.close();
+  }
+}
+
+fs::path LogSpool::segmentPath(uint64_t segment) const {
+  std::stringstream name;
+  name << std::setw(20) << std::setfill('0') << segment
+       << kLogSpoolSegmentExtension;
+  return path_ / name.str();
+}
+
+Status LogSpool::open() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto status = createDirectory(path_, true, true);
+  if (!status.ok()) {
+    return Status::failure("Cannot create log spool " + path_.string() +
+                           ": " + status.getMessage());
+  }
+
+  std::string content;
+  if (readFile(path_ / kLogSpoolCursorFile, content).ok()) {
+    auto fields = split(content, " ");
+    if (fields.size() == 2) {
+      cursor_.segment = tryTo<uint64_t>(fields[0]).takeOr(uint64_t{0});
+      cursor_.offset = tryTo<uint64_t>(fields[1]).takeOr(uint64_t{0});
+    }
+  }
+
+  boost::system::error_code ec;
+  for (fs::directory_iterator it(path_, ec), end; !ec && it != end;
+       it.increment(ec)) {
+    const auto& path = it->path();
+    if (path.extension().string() != kLogSpoolSegmentExtension) {
+      continue;
+    }
+
+    auto segment = tryTo<uint64_t>(path.stem().string());
+    if (segment.isError()) {
+      continue;
+    }
+
+    auto number = segment.take();
+    if (number < cursor_.segment) {
+      // Every record was acknowledged before the segment was deleted.
+      removePath(path);
+      continue;
+    }
+
+    auto offset = (number == cursor_.segment) ? cursor_.offset : 0;
+    auto count = countRecords(path, offset);
+    segments_[number] = count;
+    size_ += count;
+  }
+
+  // Never append to a segment a crash may have torn.
+  active_ = std::max(cursor_.segment,
+                     segments_.empty() ? 0 : segments_.rbegin()->first);
+  return rotate();
+}
+
+Status LogSpool::rotate() {
+  if (writer_.is_open()) {
+    writer_.close();
+  }
+
+  ++active_;
+  auto path = segmentPath(active_);
+  writer_.open(path.string(),
+               std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!writer_.is_open()) {
+    return Status::failure("Cannot open log segment " + path.string());
+  }
+
+  boost::system::error_code ec;
+  fs::permissions(path, fs::owner_read | fs::owner_write, ec);
+  segments_[active_] = 0;
+  return Status::success();
+}
+
+Status LogSpool::append(const std::string& line) {
+  if (line.size() > kLogSpoolMaxRecordSize) {
+    return Status::failure("Log line is too large to spool");
+  }
+
+  char header[kLogSpoolHeaderSize];
+  encodeUInt32(static_cast<uint32_t>(line.size()), header);
+  encodeUInt32(getChecksum(line), header + 4);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!writer_.is_open()) {
+    return Status::failure("Log spool is not open");
+  }
+
+  writer_.write(header, sizeof(header));
+  writer_.write(line.data(), line.size());
+  writer_.flush();
+  if (!writer_.good()) {
+    return Status::failure("Cannot write log segment " +
+                           segmentPath(active_).string());
+  }
+
+  segments_[active_]++;
+  size_++;
+
+  if (static_cast<uint64_t>(writer_.tellp()) >= segment_size_) {
+    auto status = rotate();
+    if (!status.ok()) {
+      LOG(ERROR) << status.getMessage();
+    }
+  }
+  return Status::success();
+}
+
+Status LogSpool::read(uint64_t max, std::vector<std::string>& lines) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  read_ends_.clear();
+
+  auto cursor = cursor_;
+  for (auto it = segments_.lower_bound(cursor.segment);
+       it != segments_.end() && lines.size() < max;
+       ++it) {
+    if (it->first != cursor.segment) {
+      cursor.segment = it->first;
+      cursor.offset = 0;
+    }
+
+    auto path = segmentPath(it->first);
+    std::ifstream in(path.string(), std::ios::in | std::ios::binary);
+    if (!in.is_open()) {
+      return Status::failure("Cannot read log segment " + path.string());
+    }
+    in.seekg(static_cast<std::streamoff>(cursor.offset));
+
+    std::string payload;
+    while (lines.size() < max) {
+      auto result = readRecord(in, cursor.offset, payload);
+      if (result == RecordRead::kRecord) {
+        lines.push_back(std::move(payload));
+        read_ends_.push_back(cursor);
+        continue;
+      }
+
+      if (result == RecordRead::kCorrupt && it->first != active_) {
+        LOG(WARNING) << "Skipping the corrupted end of log segment "
+                     << path.string();
+      }
+      break;
+    }
+  }
+
+  return Status::success();
+}
+
+Status LogSpool::acknowledge(uint64_t lines) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  lines = std::min<uint64_t>(lines, read_ends_.size());
+  if (lines == 0) {
+    return Status::success();
+  }
+
+  for (uint64_t i = 0; i < lines; ++i) {
+    auto it = segments_.find(read_ends_[i].segment);
+    if (it != segments_.end() && it->second > 0) {
+      it->second--;
+      size_--;
+    }
+  }
+  cursor_ = read_ends_[lines - 1];
+  read_ends_.clear();
+
+  // Segments are only deleted once every record is acknowledged.
+  for (auto it = segments_.begin(); it != segments_.end() &&
+                                    it->first != active_ && it->second == 0;) {
+    removePath(segmentPath(it->first));
+    it = segments_.erase(it);
+  }
+
+  return writeCursor();
+}
+
+Status LogSpool::dropOldestSegment(uint64_t& dropped) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  dropped = 0;
+  if (segments_.empty()) {
+    return Status::failure("Log spool is empty");
+  }
+
+  if (segments_.begin()->first == active_) {
+    auto status = rotate();
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  auto it = segments_.begin();
+  auto status = removePath(segmentPath(it->first));
+  if (!status.ok()) {
+    return status;
+  }
+
+  dropped = it->second;
+  size_ -= dropped;
+  segments_.erase(it);
+  return Status::success();
+}
+
+uint64_t LogSpool::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return size_;
+}
+
+Status LogSpool::writeCursor() {
+  auto content = std::to_string(cursor_.segment) + " " +
+                 std::to_string(cursor_.offset);
+
+  // Replace the cursor whole, a reader never sees half of it.
+  auto temporary = path_ / (kLogSpoolCursorFile + ".tmp");
+  auto status =
+      writeTextFile(temporary, content, 0600, PF_CREATE_ALWAYS | PF_WRITE);
+  if (!status.ok()) {
+    return status;
+  }
+  return movePath(temporary, path_ / kLogSpoolCursorFile);
+}
+
+} // namespace osquery
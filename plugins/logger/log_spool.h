@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// The position of the next unread record of a spool.
+struct LogSpoolCursor {
+  uint64_t segment{0};
+  uint64_t offset{0};
+};
+
+/**
+ * @brief An append-only spool of log lines, kept in size-rotated segments.
+ *
+ * Each line is a record of its length, its CRC-32 and its bytes, appended to
+ * the newest segment file. A segment is closed once it grows past the
+ * segment size, and the spool always opens a new segment for writing, so a
+ * record torn by a crash only ends a closed segment.
+ *
+ * A reader reads the records after the cursor, then acknowledges them once
+ * they are forwarded. The cursor is persisted on each acknowledgement, and
+ * segments are deleted whole once all of their records are acknowledged.
+ *
+ * One thread reads and acknowledges, any thread may append.
+ */
+class LogSpool : private boost::noncopyable {
+ public:
+  /**
+   * @param path The directory of the segments and the cursor.
+   * @param segment_size Bytes after which a segment is closed.
+   */
+  LogSpool(const boost::filesystem::path& path, uint64_t segment_size);
+
+  /// Closes the written segment.
+  ~LogSpool();
+
+  /// Read the cursor, count the unread records and start a new segment.
+  Status open();
+
+  /// Append a line to the newest segment.
+  Status append(const std::string& line);
+
+  /**
+   * @brief Read up to max lines after the cursor.
+   *
+   * The lines are read again by the next call until they are acknowledged.
+   */
+  Status read(uint64_t max, std::vector<std::string>& lines);
+
+  /**
+   * @brief Move the cursor past the leading lines of the last read.
+   *
+   * @param lines The number of lines acknowledged, the others are read again.
+   */
+  Status acknowledge(uint64_t lines);
+
+  /**
+   * @brief Delete the oldest segment, read or not.
+   *
+   * The written segment is closed first when it is the only one.
+   *
+   * @param dropped Set to the number of unread lines deleted.
+   */
+  Status dropOldestSegment(uint64_t& dropped);
+
+  /// The number of unread lines.
+  uint64_t size() const;
+
+ private:
+  /// The path of a segment file.
+  boost::filesystem::path segmentPath(uint64_t segment) const;
+
+  /// Start writing a new segment after the newest one.
+  Status rotate();
+
+  /// Write the cursor, replacing the previous one.
+  Status writeCursor();
+
+ private:
+  const boost::filesystem::path path_;
+
+  const uint64_t segment_size_;
+
+  /// Unread lines of each segment, oldest first.
+  std::map<uint64_t, uint64_t> segments_;
+
+  /// The unread lines.
+  uint64_t size_{0};
+
+  /// The segment written by append.
+  uint64_t active_{0};
+  std::ofstream writer_;
+
+  /// The position of the next unread record.
+  LogSpoolCursor cursor_;
+
+  /// The position after each line of the last read.
+  std::vector<LogSpoolCursor> read_ends_;
+
+  mutable std::mutex mutex_;
+};
+
+} // namespace osquery
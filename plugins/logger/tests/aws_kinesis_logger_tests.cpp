@@ -7,9 +7,12 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <vector>
 
 #include <aws/kinesis/KinesisClient.h>
@@ -41,6 +44,11 @@ class AwsLoggerTests : public testing::Test {
 
 class DummyOutcome final : public Aws::Kinesis::Model::PutRecordsOutcome {
  public:
+  DummyOutcome() = default;
+
+  explicit DummyOutcome(Aws::Kinesis::Model::PutRecordsResult result)
+      : Aws::Kinesis::Model::PutRecordsOutcome(std::move(result)) {}
+
   bool IsSuccess() {
     return true;
   }
@@ -186,4 +194,127 @@ TEST_F(AwsLoggerTests, test_send) {
             "test\":\"2\",\"log_type\":\"result\"}\n");
   EXPECT_EQ(third_batch[1], "{\"batch3\":\"3\",\"log_type\":\"result\"}\n");
 }
+
+class ThrottledLogForwarder final : public IDummyLogForwarder {
+ public:
+  ThrottledLogForwarder()
+      : IDummyLogForwarder("throttled", 10, 50, "http://example.com") {}
+
+ protected:
+  Status internalSetup() override {
+    return Status(0, "OK");
+  }
+
+  Outcome internalSend(const Batch& batch) override {
+    Aws::Vector<Aws::Kinesis::Model::PutRecordsResultEntry> entries;
+    int failed_record_count = 0;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    attempts_++;
+    for (const auto& record : batch) {
+      std::string buffer(
+          reinterpret_cast<const char*>(record.GetData().GetUnderlyingData()),
+          record.GetData().GetLength());
+
+      // The first attempt of each throttled record is rejected
+      Aws::Kinesis::Model::PutRecordsResultEntry entry;
+      if (buffer.find("throttled") != std::string::npos &&
+          throttled_records_.insert(buffer).second) {
+        entry.SetErrorCode("ProvisionedThroughputExceededException");
+        failed_record_count++;
+      } else {
+        sent_records_.push_back(buffer);
+      }
+      entries.push_back(entry);
+    }
+
+    Aws::Kinesis::Model::PutRecordsResult result;
+    result.SetRecords(entries);
+    result.SetFailedRecordCount(failed_record_count);
+    return Outcome(std::move(result));
+  }
+
+  void initializeRecord(Record& record,
+                        Aws::Utils::ByteBuffer& buffer) const override {
+    record.SetData(buffer);
+  }
+
+  std::size_t getMaxBytesPerRecord() const override {
+    return 80U;
+  }
+
+  std::size_t getMaxRecordsPerBatch() const override {
+    return 2U;
+  }
+
+  std::size_t getMaxBytesPerBatch() const override {
+    return 1024U;
+  }
+
+  std::size_t getMaxRetryCount() const override {
+    return 3U;
+  }
+
+  std::size_t getInitialRetryDelay() const override {
+    return 0U;
+  }
+
+  bool appendNewlineSeparators() const override {
+    return false;
+  }
+
+  std::size_t getFailedRecordCount(Outcome& outcome) const override {
+    return static_cast<size_t>(outcome.GetResult().GetFailedRecordCount());
+  }
+
+  Result getResult(Outcome& outcome) const override {
+    return outcome.GetResult().GetRecords();
+  }
+
+  std::size_t getMaxInflightBatches() const override {
+    return 2U;
+  }
+
+  bool isThrottlingError(const Aws::String& error_code) const override {
+    return error_code == "ProvisionedThroughputExceededException";
+  }
+
+ public:
+  std::mutex mutex_;
+  size_t attempts_{0};
+  std::set<std::string> throttled_records_;
+  std::vector<std::string> sent_records_;
+
+  FRIEND_TEST(AwsLoggerTests, test_send_lanes);
+};
+
+TEST_F(AwsLoggerTests, test_send_lanes) {
+  ThrottledLogForwarder log_forwarder;
+
+  // Records alternate between the two lanes, two records per batch
+  log_forwarder.logString("{ \"line\": \"1\" }");
+  log_forwarder.logString("{ \"line\": \"2\", \"throttled\": \"1\" }");
+  log_forwarder.logString("{ \"line\": \"3\" }");
+  log_forwarder.logString("{ \"line\": \"4\" }");
+  log_forwarder.logString("{ \"line\": \"5\", \"throttled\": \"1\" }");
+  log_forwarder.logString("{ \"line\": \"6\" }");
+  log_forwarder.check();
+
+  // Every record is sent once; only the throttled records were retried
+  auto sent_records = log_forwarder.sent_records_;
+  std::sort(sent_records.begin(), sent_records.end());
+  std::vector<std::string> expected_records;
+  for (size_t i = 1; i <= 6; i++) {
+    auto fields = "\"line\":\"" + std::to_string(i) + "\",";
+    if (i == 2 || i == 5) {
+      fields += "\"throttled\":\"1\",";
+    }
+    expected_records.push_back("{" + fields + "\"log_type\":\"result\"}");
+  }
+  EXPECT_EQ(expected_records, sent_records);
+  EXPECT_EQ(2U, log_forwarder.throttled_records_.size());
+
+  // Four batches across two lanes, plus one retry for each throttled record
+  EXPECT_EQ(6U, log_forwarder.attempts_);
+}
 }
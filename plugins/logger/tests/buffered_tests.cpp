@@ -8,11 +8,13 @@
  */
 
 #include <chrono>
+#include <fstream>
 #include <thread>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <boost/filesystem.hpp>
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
 
@@ -34,6 +36,8 @@ namespace pt = boost::property_tree;
 namespace osquery {
 
 DECLARE_uint64(buffered_log_max);
+DECLARE_string(buffered_log_spool_path);
+DECLARE_uint64(buffered_log_segment_size);
 
 // Check that the string matches the StatusLogLine
 MATCHER_P(MatchesStatus, expected, "") {
@@ -105,11 +109,29 @@ class MockBufferedLogForwarder : public BufferedLogForwarder {
   FRIEND_TEST(BufferedLogForwarderTests, test_split);
   FRIEND_TEST(BufferedLogForwarderTests, test_purge);
   FRIEND_TEST(BufferedLogForwarderTests, test_purge_max);
+  FRIEND_TEST(BufferedLogSpoolTests, test_spool);
+  FRIEND_TEST(BufferedLogSpoolTests, test_spool_purge);
 
  private:
   bool checked_{false};
 };
 
+// Confirms the first line of each send, as if later requests failed.
+class PartialBufferedLogForwarder : public MockBufferedLogForwarder {
+ public:
+  Status sendOrdered(std::vector<std::string>& log_data,
+                     const std::string& log_type,
+                     size_t& sent) override {
+    std::vector<std::string> first(log_data.begin(), log_data.begin() + 1);
+    auto status = send(first, log_type);
+    sent = status.ok() ? 1 : 0;
+    return Status(1, "Only the first line was sent");
+  }
+
+  FRIEND_TEST(BufferedLogForwarderTests, test_partial_send);
+  FRIEND_TEST(BufferedLogSpoolTests, test_spool_partial_send);
+};
+
 TEST_F(BufferedLogForwarderTests, test_index) {
   MockBufferedLogForwarder runner;
   if (!isPlatform(PlatformType::TYPE_WINDOWS)) {
@@ -300,6 +322,22 @@ TEST_F(BufferedLogForwarderTests, test_split) {
   runner2.check();
 }
 
+// Only the lines confirmed by sendOrdered are removed from the buffer.
+TEST_F(BufferedLogForwarderTests, test_partial_send) {
+  StrictMock<PartialBufferedLogForwarder> runner;
+  runner.logString("foo");
+  runner.logString("bar");
+
+  EXPECT_CALL(runner, send(ElementsAre("foo"), "result"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+
+  EXPECT_CALL(runner, send(ElementsAre("bar"), "result"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+  runner.check();
+}
+
 // Test the purge() function independently of check()
 TEST_F(BufferedLogForwarderTests, test_purge) {
   FLAGS_buffered_log_max = 3;
@@ -370,4 +408,122 @@ TEST_F(BufferedLogForwarderTests, test_purge_max) {
 
   runner.check();
 }
+
+class BufferedLogSpoolTests : public BufferedLogForwarderTests {
+ protected:
+  void SetUp() {
+    BufferedLogForwarderTests::SetUp();
+    spool_path_ = boost::filesystem::temp_directory_path() /
+                  boost::filesystem::unique_path(
+                      "osquery.test_spool.%%%%.%%%%.%%%%.%%%%");
+    FLAGS_buffered_log_spool_path = spool_path_.string();
+  }
+
+  void TearDown() {
+    FLAGS_buffered_log_spool_path = "";
+    FLAGS_buffered_log_segment_size = 4 * 1024 * 1024;
+    boost::filesystem::remove_all(spool_path_);
+  }
+
+  boost::filesystem::path spool_path_;
+};
+
+// Spooled logs are sent like database-buffered logs, and survive a restart.
+TEST_F(BufferedLogSpoolTests, test_spool) {
+  StatusLogLine log1 = makeStatusLogLine(O_INFO, "foo", 1, "foo status");
+  {
+    StrictMock<MockBufferedLogForwarder> runner;
+    ASSERT_TRUE(runner.setUp().ok());
+    runner.logString("foo");
+    EXPECT_CALL(runner, send(ElementsAre("foo"), "result"))
+        .WillOnce(Return(Status(0)));
+    runner.check();
+    runner.check();
+
+    runner.logStatus({log1});
+    runner.logString("bar");
+    EXPECT_CALL(runner, send(ElementsAre("bar"), "result"))
+        .WillOnce(Return(Status(0)));
+    EXPECT_CALL(runner, send(ElementsAre(MatchesStatus(log1)), "status"))
+        .WillOnce(Return(Status(1, "fail")));
+    runner.check();
+    runner.logString("baz");
+  }
+
+  // Only the logs that were not sent are read again.
+  StrictMock<MockBufferedLogForwarder> runner;
+  ASSERT_TRUE(runner.setUp().ok());
+  EXPECT_CALL(runner, send(ElementsAre("baz"), "result"))
+      .WillOnce(Return(Status(0)));
+  EXPECT_CALL(runner, send(ElementsAre(MatchesStatus(log1)), "status"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+  runner.check();
+}
+
+// Segments are dropped whole, oldest first, once the max is exceeded.
+TEST_F(BufferedLogSpoolTests, test_spool_purge) {
+  FLAGS_buffered_log_max = 3;
+  FLAGS_buffered_log_segment_size = 1;
+
+  StrictMock<MockBufferedLogForwarder> runner("mock", kLogPeriod, 100);
+  ASSERT_TRUE(runner.setUp().ok());
+  for (size_t i = 0; i < 10; ++i) {
+    runner.logString(std::to_string(i));
+  }
+  runner.purge();
+
+  EXPECT_CALL(runner, send(ElementsAre("7", "8", "9"), "result"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+  runner.check();
+}
+
+// A corrupted record ends its segment, the next segments are still read.
+TEST_F(BufferedLogSpoolTests, test_spool_corruption) {
+  auto path = spool_path_ / "spool";
+  {
+    LogSpool spool(path, 1);
+    ASSERT_TRUE(spool.open().ok());
+    EXPECT_TRUE(spool.append("first").ok());
+    EXPECT_TRUE(spool.append("second").ok());
+  }
+
+  // Flip a byte of the first record.
+  auto segment = path / "00000000000000000001.seg";
+  ASSERT_TRUE(boost::filesystem::exists(segment));
+  {
+    std::fstream file(segment.string(),
+                      std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(10);
+    file.put('X');
+  }
+
+  LogSpool spool(path, 1);
+  ASSERT_TRUE(spool.open().ok());
+  EXPECT_EQ(1U, spool.size());
+
+  std::vector<std::string> lines;
+  EXPECT_TRUE(spool.read(10, lines).ok());
+  EXPECT_EQ(std::vector<std::string>({"second"}), lines);
+  EXPECT_TRUE(spool.acknowledge(lines.size()).ok());
+  EXPECT_EQ(0U, spool.size());
+  EXPECT_FALSE(boost::filesystem::exists(segment));
+}
+
+TEST_F(BufferedLogSpoolTests, test_spool_partial_send) {
+  StrictMock<PartialBufferedLogForwarder> runner;
+  ASSERT_TRUE(runner.setUp().ok());
+  runner.logString("foo");
+  runner.logString("bar");
+
+  EXPECT_CALL(runner, send(ElementsAre("foo"), "result"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+
+  EXPECT_CALL(runner, send(ElementsAre("bar"), "result"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+  runner.check();
+}
 }
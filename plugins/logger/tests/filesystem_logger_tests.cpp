@@ -7,8 +7,11 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <plugins/logger/async_log_file.h>
 #include <plugins/logger/filesystem_logger.h>
 
+#include "../logrotate.h"
+
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/utils/conversions/split.h>
 #include <osquery/utils/info/platform_type.h>
@@ -24,6 +27,7 @@
 
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace fs = boost::filesystem;
@@ -33,6 +37,9 @@ namespace osquery {
 DECLARE_string(logger_path);
 DECLARE_bool(disable_logging);
 DECLARE_bool(logger_numerics);
+DECLARE_bool(logger_async);
+DECLARE_bool(logger_rotate);
+DECLARE_uint64(logger_rotate_size);
 
 class FilesystemLoggerTests : public testing::Test {
  public:
@@ -178,4 +185,88 @@ TEST_F(FilesystemLoggerTests, test_log_snapshot) {
       std::string(FLAGS_logger_numerics ? "true" : "false") + "}\n";
   EXPECT_EQ(content, expected);
 }
+TEST_F(FilesystemLoggerTests, test_async_log_file) {
+  auto path = (fs::path(FLAGS_logger_path) / "async.log").string();
+  AsyncLogFile file(path,
+                    0640,
+                    nullptr,
+                    LogSyncPolicy::kBatch,
+                    std::chrono::milliseconds(1000));
+  ASSERT_TRUE(file.start().ok());
+
+  // Lines of each thread keep their order.
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < 4; t++) {
+    threads.emplace_back([&file, t]() {
+      for (size_t i = 0; i < 100; i++) {
+        file.write(std::to_string(t) + ":" + std::to_string(i));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  file.flush();
+
+  std::string content;
+  ASSERT_TRUE(readFile(path, content));
+  auto lines = osquery::split(content, "\n");
+  ASSERT_EQ(400U, lines.size());
+
+  std::vector<size_t> next(4, 0);
+  for (const auto& line : lines) {
+    auto fields = osquery::split(line, ":");
+    ASSERT_EQ(2U, fields.size());
+    auto t = std::stoul(fields[0]);
+    EXPECT_EQ(next[t]++, std::stoul(fields[1]));
+  }
+}
+
+TEST_F(FilesystemLoggerTests, test_async_log_file_rotate) {
+  FLAGS_logger_rotate = true;
+  FLAGS_logger_rotate_size = 1024;
+
+  auto path = (fs::path(FLAGS_logger_path) / "async.log").string();
+  LogRotate rotate(path);
+  AsyncLogFile file(path,
+                    0640,
+                    &rotate,
+                    LogSyncPolicy::kNever,
+                    std::chrono::milliseconds(1000));
+  ASSERT_TRUE(file.start().ok());
+
+  // The log is rotated once it grows past 1024 bytes.
+  for (size_t i = 0; i < 20; i++) {
+    EXPECT_TRUE(file.write(std::string(63, 'a')).ok());
+  }
+  file.flush();
+  EXPECT_TRUE(file.write(std::string(63, 'b')).ok());
+  file.flush();
+
+  FLAGS_logger_rotate = false;
+  FLAGS_logger_rotate_size = 25 * 1024 * 1024;
+
+  std::string content;
+  std::string rotated;
+  EXPECT_TRUE(readFile(path, content));
+  ASSERT_TRUE(readFile(path + ".1", rotated));
+  EXPECT_EQ(21U * 64U, content.size() + rotated.size());
+  EXPECT_EQ('b', content[content.size() - 2]);
+}
+
+TEST_F(FilesystemLoggerTests, test_async_log_string) {
+  FLAGS_logger_async = true;
+  {
+    FilesystemLoggerPlugin plugin;
+    ASSERT_TRUE(plugin.setUp().ok());
+    EXPECT_TRUE(plugin.logString("{\"json\": true}").ok());
+
+    // The pending lines are written before the plugin is destroyed.
+  }
+  FLAGS_logger_async = false;
+
+  std::string content;
+  EXPECT_TRUE(readFile(results_path_, content));
+  EXPECT_EQ(content, "{\"json\": true}\n");
+}
 } // namespace osquery
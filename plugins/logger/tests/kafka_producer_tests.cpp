@@ -18,6 +18,7 @@
 
 #include "boost/date_time/posix_time/posix_time.hpp"
 #include <boost/chrono.hpp>
+#include <boost/filesystem.hpp>
 
 #include <osquery/core/core.h>
 #include <osquery/core/system.h>
@@ -29,6 +30,9 @@
 
 namespace osquery {
 
+DECLARE_string(logger_kafka_partition_key);
+DECLARE_uint64(logger_kafka_max_inflight);
+
 class MockKafkaProducerPlugin : public KafkaProducerPlugin {
  public:
   MockKafkaProducerPlugin() : timesFlushed_(0), timesPolled_(0) {
@@ -43,15 +47,34 @@ class MockKafkaProducerPlugin : public KafkaProducerPlugin {
     queryToTopics_ = m;
   }
 
+  Status openSpool(const boost::filesystem::path& path) {
+    spool_ = std::make_unique<LogSpool>(path, 4 * 1024 * 1024);
+    return spool_->open();
+  }
+
+  uint64_t spooled() const {
+    return spool_->size();
+  }
+
+  uint64_t inFlight() const {
+    return inFlight_.load();
+  }
+
+  void drain() {
+    drainSpool();
+  }
+
  protected:
   Status publishMsg(rd_kafka_topic_t* topic,
-                    const std::string& payload) override {
+                    const std::string& payload,
+                    const std::string& key) override {
     if (publishedMsgs_.find(topic) == publishedMsgs_.end()) {
       std::vector<std::string> msgs;
       publishedMsgs_[topic] = msgs;
     }
 
     publishedMsgs_[topic].push_back(payload);
+    publishedKeys_.push_back(key);
 
     return Status(0, "OK");
   }
@@ -67,6 +90,8 @@ class MockKafkaProducerPlugin : public KafkaProducerPlugin {
  public:
   std::map<rd_kafka_topic_t*, std::vector<std::string>> publishedMsgs_;
 
+  std::vector<std::string> publishedKeys_;
+
   std::atomic<int> timesFlushed_;
 
   std::atomic<int> timesPolled_;
@@ -78,7 +103,19 @@ class KafkaProducerPluginTest : public ::testing::Test {
     platformSetup();
     registryAndPluginInit();
     initDatabasePluginForTesting();
+
+    spool_path_ = boost::filesystem::temp_directory_path() /
+                  boost::filesystem::unique_path(
+                      "osquery.test_kafka_spool.%%%%.%%%%.%%%%.%%%%");
+  }
+
+  void TearDown() {
+    FLAGS_logger_kafka_partition_key = "";
+    FLAGS_logger_kafka_max_inflight = 0;
+    boost::filesystem::remove_all(spool_path_);
   }
+
+  boost::filesystem::path spool_path_;
 };
 
 TEST_F(KafkaProducerPluginTest, getMsgName_tests) {
@@ -367,4 +404,79 @@ TEST_F(KafkaProducerPluginTest, flush_on_stop) {
   EXPECT_TRUE(mkpp.timesFlushed_.load() == 1);
   EXPECT_FALSE(mkpp.isRunning());
 }
+TEST_F(KafkaProducerPluginTest, partition_keys) {
+  MockKafkaProducerPlugin mkpp;
+
+  rd_kafka_topic_t* topic = reinterpret_cast<rd_kafka_topic_t*>(0x692870);
+  mkpp.setQueryToTopics({{kKafkaBaseTopic, topic}});
+
+  std::string msg = "{\"name\": \"test1\", \"hostIdentifier\": \"host1\"}";
+
+  FLAGS_logger_kafka_partition_key = "host_identifier";
+  EXPECT_TRUE(mkpp.logString(msg).ok());
+
+  FLAGS_logger_kafka_partition_key = "query_name";
+  EXPECT_TRUE(mkpp.logString(msg).ok());
+
+  // Messages without the field fall back to the default key.
+  EXPECT_TRUE(mkpp.logString("{\"hostIdentifier\": \"host1\"}").ok());
+
+  ASSERT_EQ(3U, mkpp.publishedKeys_.size());
+  EXPECT_EQ("host1", mkpp.publishedKeys_[0]);
+  EXPECT_EQ("test1", mkpp.publishedKeys_[1]);
+  EXPECT_NE("test1", mkpp.publishedKeys_[2]);
+}
+
+TEST_F(KafkaProducerPluginTest, inflight_window_spools) {
+  MockKafkaProducerPlugin mkpp;
+  ASSERT_TRUE(mkpp.openSpool(spool_path_).ok());
+
+  rd_kafka_topic_t* topic = reinterpret_cast<rd_kafka_topic_t*>(0x692870);
+  mkpp.setQueryToTopics({{kKafkaBaseTopic, topic}});
+
+  FLAGS_logger_kafka_max_inflight = 2;
+  std::vector<std::string> msgs = {
+      "{\"name\": \"test1\"}",
+      "{\"name\": \"test2\"}",
+      "{\"name\": \"test3\"}",
+      "{\"name\": \"test4\"}",
+  };
+  for (auto& m : msgs) {
+    EXPECT_TRUE(mkpp.logString(m).ok());
+  }
+
+  // The window holds two messages, the others wait in the spool.
+  EXPECT_EQ(2U, mkpp.publishedMsgs_[topic].size());
+  EXPECT_EQ(2U, mkpp.inFlight());
+  EXPECT_EQ(2U, mkpp.spooled());
+
+  mkpp.drain();
+  EXPECT_EQ(2U, mkpp.publishedMsgs_[topic].size());
+
+  // A failed delivery is spooled again, behind the waiting messages.
+  mkpp.onDelivery(msgs[0], true, true, 2000);
+  mkpp.onDelivery(msgs[1], false, true, -1);
+  EXPECT_EQ(0U, mkpp.inFlight());
+  EXPECT_EQ(3U, mkpp.spooled());
+
+  mkpp.drain();
+  std::vector<std::string> expected = {msgs[0], msgs[1], msgs[2], msgs[3]};
+  EXPECT_EQ(expected, mkpp.publishedMsgs_[topic]);
+  EXPECT_EQ(1U, mkpp.spooled());
+
+  auto stats = mkpp.getDeliveryStats();
+  EXPECT_EQ(1U, stats.delivered);
+  EXPECT_EQ(1U, stats.failed);
+  EXPECT_EQ(3U, stats.spooled);
+  EXPECT_EQ(2000U, stats.latency_us);
+
+  // Messages the brokers would refuse again are not spooled.
+  mkpp.onDelivery(msgs[2], false, false, -1);
+  mkpp.onDelivery(msgs[3], true, true, 4000);
+  mkpp.drain();
+  expected.push_back(msgs[1]);
+  EXPECT_EQ(expected, mkpp.publishedMsgs_[topic]);
+  EXPECT_EQ(0U, mkpp.spooled());
+  EXPECT_EQ(4000U, mkpp.getDeliveryStats().max_latency_us);
+}
 } // namespace osquery
@@ -19,6 +19,8 @@
 
 namespace osquery {
 DECLARE_bool(disable_database);
+DECLARE_uint64(logger_tls_max_lines);
+DECLARE_uint64(logger_tls_max_inflight);
 
 class TLSLoggerTests : public testing::Test {
  protected:
@@ -83,4 +85,32 @@ TEST_F(TLSLoggerTests, test_send) {
   TLSServerRunner::unsetClientConfig();
   TLSServerRunner::stop();
 }
+
+TEST_F(TLSLoggerTests, test_send_concurrent) {
+  // Start a server.
+  ASSERT_TRUE(TLSServerRunner::start());
+  TLSServerRunner::setClientConfig();
+
+  // The lines are sent as 4 concurrent requests of 5 lines.
+  FLAGS_logger_tls_max_lines = 5;
+  FLAGS_logger_tls_max_inflight = 4;
+  auto forwarder = std::make_shared<TLSLogForwarder>();
+  FLAGS_logger_tls_max_lines = 1024;
+  FLAGS_logger_tls_max_inflight = 1;
+
+  for (size_t i = 0; i < 20; i++) {
+    forwarder->logString("{\"concurrent_json\": " + std::to_string(i) + "}");
+  }
+
+  runCheck(forwarder);
+
+  // Stop the server.
+  TLSServerRunner::unsetClientConfig();
+  TLSServerRunner::stop();
+
+  // Every request was confirmed, so every line was removed.
+  std::vector<std::string> indexes;
+  scanDatabaseKeys(kLogs, indexes, "tls_");
+  EXPECT_TRUE(indexes.empty());
+}
 } // namespace osquery
@@ -15,6 +15,9 @@
 
 #include "tls_logger.h"
 
+#include <algorithm>
+#include <iterator>
+
 #include <boost/property_tree/ptree.hpp>
 
 #include <osquery/remote/enroll/enroll.h>
@@ -51,16 +54,83 @@ FLAG(bool, tls_disable_status_log, false, "Disable sending status logs");
 // The flag name logger_tls_max is deprecated.
 FLAG_ALIAS(google::uint64, logger_tls_max, logger_tls_max_linesize);
 
-FLAG(bool, logger_tls_compress, false, "GZip compress TLS/HTTPS request body");
+FLAG(bool,
+     logger_tls_compress,
+     false,
+     "Compress TLS/HTTPS request body, see tls_compression");
+
+CLI_FLAG(uint64,
+         logger_tls_max_inflight,
+         1,
+         "Max number of concurrent TLS/HTTPS log requests per period");
 
 REGISTER(TLSLoggerPlugin, "logger", "tls");
 
+TLSRequestPool::TLSRequestPool(size_t threads) {
+  for (size_t i = 0; i < threads; ++i) {
+    threads_.emplace_back([this]() { work(); });
+  }
+}
+
+TLSRequestPool::~TLSRequestPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+std::vector<Status> TLSRequestPool::run(
+    const std::vector<std::function<Status()>>& requests) {
+  std::vector<std::future<Status>> futures;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& request : requests) {
+      queue_.emplace_back(request);
+      futures.push_back(queue_.back().get_future());
+    }
+  }
+  cv_.notify_all();
+
+  std::vector<Status> statuses;
+  for (auto& future : futures) {
+    statuses.push_back(future.get());
+  }
+  return statuses;
+}
+
+void TLSRequestPool::work() {
+  while (true) {
+    std::packaged_task<Status()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return;
+      }
+      task = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    task();
+  }
+}
+
 TLSLogForwarder::TLSLogForwarder()
-    : BufferedLogForwarder("TLSLogForwarder",
-                           "tls",
-                           std::chrono::seconds(FLAGS_logger_tls_period),
-                           FLAGS_logger_tls_max_lines) {
+    : BufferedLogForwarder(
+          "TLSLogForwarder",
+          "tls",
+          std::chrono::seconds(FLAGS_logger_tls_period),
+          FLAGS_logger_tls_max_lines *
+              std::max<uint64_t>(FLAGS_logger_tls_max_inflight, 1)) {
   uri_ = TLSRequestHelper::makeURI(FLAGS_logger_tls_endpoint);
+  if (FLAGS_logger_tls_max_inflight > 1) {
+    pool_ = std::make_unique<TLSRequestPool>(
+        static_cast<size_t>(FLAGS_logger_tls_max_inflight));
+  }
 }
 
 Status TLSLoggerPlugin::logString(const std::string& s) {
@@ -139,4 +209,37 @@ Status TLSLogForwarder::send(std::vector<std::string>& log_data,
   }
   return TLSRequestHelper::go<JSONSerializer>(uri_, params, response);
 }
+
+Status TLSLogForwarder::sendOrdered(std::vector<std::string>& log_data,
+                                    const std::string& log_type,
+                                    size_t& sent) {
+  auto batch_lines = std::max<uint64_t>(FLAGS_logger_tls_max_lines, 1);
+  if (pool_ == nullptr || log_data.size() <= batch_lines) {
+    return BufferedLogForwarder::sendOrdered(log_data, log_type, sent);
+  }
+
+  std::vector<std::vector<std::string>> batches;
+  for (size_t i = 0; i < log_data.size(); i += batch_lines) {
+    auto end = std::min<size_t>(log_data.size(), i + batch_lines);
+    batches.emplace_back(std::make_move_iterator(log_data.begin() + i),
+                         std::make_move_iterator(log_data.begin() + end));
+  }
+
+  std::vector<std::function<Status()>> requests;
+  for (auto& batch : batches) {
+    requests.push_back(
+        [this, &batch, &log_type]() { return send(batch, log_type); });
+  }
+  auto statuses = pool_->run(requests);
+
+  // The server may have stored later requests too, they are sent again.
+  sent = 0;
+  for (size_t i = 0; i < statuses.size(); ++i) {
+    if (!statuses[i].ok()) {
+      return statuses[i];
+    }
+    sent += batches[i].size();
+  }
+  return Status::success();
+}
 } // namespace osquery
@@ -9,6 +9,17 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
 #include "plugins/logger/buffered.h"
 
 #include <osquery/core/plugins/logger.h>
@@ -16,6 +27,38 @@
 
 namespace osquery {
 
+/**
+ * @brief Threads sending TLS log requests concurrently.
+ *
+ * The threads live as long as the pool. Each thread reuses its own TLS
+ * session (see tls_session_reuse), so its keep-alive connection stays open
+ * between the requests of consecutive periods.
+ */
+class TLSRequestPool : private boost::noncopyable {
+ public:
+  explicit TLSRequestPool(size_t threads);
+
+  /// Finishes the queued requests and joins the threads.
+  ~TLSRequestPool();
+
+  /// Run the requests concurrently, and wait for all of their statuses.
+  std::vector<Status> run(const std::vector<std::function<Status()>>& requests);
+
+ private:
+  /// The loop of each thread.
+  void work();
+
+ private:
+  std::vector<std::thread> threads_;
+
+  std::deque<std::packaged_task<Status()>> queue_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+
+  bool stopping_{false};
+};
+
 /**
  * @brief A log forwarder thread flushing database-buffered logs.
  *
@@ -31,9 +74,23 @@ class TLSLogForwarder : public BufferedLogForwarder {
   Status send(std::vector<std::string>& log_data,
               const std::string& log_type) override;
 
+  /**
+   * @brief Send up to logger_tls_max_inflight requests at once.
+   *
+   * The logs are split into requests of logger_tls_max_lines lines. The
+   * lines of the leading requests that succeeded are confirmed, the lines of
+   * a failed request and of the requests after it are sent again.
+   */
+  Status sendOrdered(std::vector<std::string>& log_data,
+                     const std::string& log_type,
+                     size_t& sent) override;
+
   /// Endpoint URI
   std::string uri_;
 
+  /// Sends the concurrent requests, when logger_tls_max_inflight is above 1.
+  std::unique_ptr<TLSRequestPool> pool_;
+
  private:
   friend class TLSLoggerTests;
 };
@@ -16,13 +16,146 @@
 
 namespace osquery {
 
+FLAG(bool,
+     windows_event_log_async,
+     false,
+     "Publish results to the Windows Event Log on a writer thread");
+
+FLAG(uint32,
+     windows_event_log_coalesce_bytes,
+     0,
+     "Coalesce queued result lines into records of up to this many bytes");
+
+/// Lines are refused while this many bytes wait for the writer thread.
+const size_t kWindowsEventLogMaxPendingBytes = 64 * 1024 * 1024;
+
 REGISTER(WindowsEventLoggerPlugin, "logger", "windows_event_log");
 
+WindowsEventLogWriter::WindowsEventLogWriter(REGHANDLE registration_handle,
+                                             size_t coalesce_bytes)
+    : registration_handle_(registration_handle),
+      coalesce_bytes_(coalesce_bytes) {}
+
+WindowsEventLogWriter::~WindowsEventLogWriter() {
+  if (thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+  }
+}
+
+void WindowsEventLogWriter::start() {
+  thread_ = std::thread([this]() { run(); });
+}
+
+Status WindowsEventLogWriter::write(const std::string& line) {
+  bool was_empty = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_bytes_ + line.size() > kWindowsEventLogMaxPendingBytes) {
+      return Status::failure(
+          "Too many log lines wait to be published to the Windows Event Log");
+    }
+    was_empty = pending_.empty();
+    pending_.push_back(line);
+    pending_bytes_ += line.size();
+    queued_++;
+  }
+
+  // Only the first line after the writer took the batch wakes it.
+  if (was_empty) {
+    wake_.notify_one();
+  }
+  return Status::success();
+}
+
+void WindowsEventLogWriter::flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto target = queued_;
+  written_cv_.wait(lock, [this, target]() {
+    return written_ >= target || !thread_.joinable();
+  });
+}
+
+void WindowsEventLogWriter::run() {
+  std::vector<std::string> lines;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this]() { return stopping_ || !pending_.empty(); });
+      if (pending_.empty()) {
+        // Stopping, and every queued line was published.
+        break;
+      }
+      lines.swap(pending_);
+      pending_bytes_ = 0;
+    }
+
+    auto failed = publish(lines);
+    if (failed > 0) {
+      LOG(ERROR) << "Failed to publish " << failed
+                 << " records to the Windows Event Log";
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      written_ += lines.size();
+    }
+    written_cv_.notify_all();
+    lines.clear();
+  }
+}
+
+size_t WindowsEventLogWriter::publish(const std::vector<std::string>& lines) {
+  size_t failed = 0;
+  auto emit = [this, &failed](const std::string& message) {
+    auto status =
+        WindowsEventLoggerPlugin::emitLogRecord(registration_handle_, message);
+    if (!status.ok()) {
+      failed++;
+    }
+  };
+
+  if (coalesce_bytes_ == 0) {
+    for (const auto& line : lines) {
+      emit(line);
+    }
+    return failed;
+  }
+
+  // Consecutive lines share a record, separated by newlines.
+  std::string record;
+  for (const auto& line : lines) {
+    if (!record.empty() && record.size() + 1 + line.size() > coalesce_bytes_) {
+      emit(record);
+      record.clear();
+    }
+
+    if (!record.empty()) {
+      record.push_back('\n');
+    }
+    record.append(line);
+  }
+
+  if (!record.empty()) {
+    emit(record);
+  }
+  return failed;
+}
+
 WindowsEventLoggerPlugin::~WindowsEventLoggerPlugin() {
+  // The writer publishes the queued lines with the handle.
+  writer_.reset();
   releaseHandle(registration_handle_);
 }
 
 Status WindowsEventLoggerPlugin::logString(const std::string& s) {
+  if (writer_ != nullptr) {
+    return writer_->write(s);
+  }
   return emitLogRecord(registration_handle_, s);
 }
 
@@ -64,6 +197,12 @@ void WindowsEventLoggerPlugin::init(const std::string& name,
     return;
   }
 
+  if (FLAGS_windows_event_log_async) {
+    writer_ = std::make_unique<WindowsEventLogWriter>(
+        registration_handle_, FLAGS_windows_event_log_coalesce_bytes);
+    writer_->start();
+  }
+
   logStatus(log);
 }
 
@@ -13,11 +13,86 @@
 #include <evntprov.h>
 // clang-format on
 
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
 #include <osquery/core/flags.h>
 #include <osquery/core/plugins/logger.h>
 
 namespace osquery {
 
+/**
+ * @brief Writes result lines to the Windows Event Log from a writer thread.
+ *
+ * Callers queue their line and return. The writer thread takes every queued
+ * line at once and publishes them, optionally coalescing consecutive lines
+ * into records of up to a maximum size, so a slow Event Log never stalls the
+ * scheduler.
+ */
+class WindowsEventLogWriter : private boost::noncopyable {
+ public:
+  /**
+   * @param registration_handle The provider handle, it must outlive the
+   * writer.
+   * @param coalesce_bytes The maximum size of a coalesced record, 0 publishes
+   * one record per line.
+   */
+  WindowsEventLogWriter(REGHANDLE registration_handle, size_t coalesce_bytes);
+
+  /// Publishes the queued lines and stops the writer thread.
+  ~WindowsEventLogWriter();
+
+  /// Start the writer thread.
+  void start();
+
+  /**
+   * @brief Queue a line.
+   *
+   * Lines are refused while too many bytes wait for the writer thread.
+   */
+  Status write(const std::string& line);
+
+  /// Wait for the lines queued before the call to be published.
+  void flush();
+
+ private:
+  /// The writer thread.
+  void run();
+
+  /// Publish a batch, returns the number of records that failed.
+  size_t publish(const std::vector<std::string>& lines);
+
+ private:
+  const REGHANDLE registration_handle_;
+  const size_t coalesce_bytes_;
+
+  /// Lines waiting for the writer thread, and their size.
+  std::vector<std::string> pending_;
+  size_t pending_bytes_{0};
+
+  /// Lines queued, and lines published or dropped by the writer thread.
+  uint64_t queued_{0};
+  uint64_t written_{0};
+
+  std::thread thread_;
+  bool stopping_{false};
+
+  /// Protects the pending lines, the counters and stopping_.
+  std::mutex mutex_;
+
+  /// Wakes the writer thread when lines are queued.
+  std::condition_variable wake_;
+
+  /// Wakes flush callers after a batch.
+  std::condition_variable written_cv_;
+};
+
 class WindowsEventLoggerPlugin : public LoggerPlugin {
  public:
   virtual ~WindowsEventLoggerPlugin();
@@ -49,5 +124,8 @@ class WindowsEventLoggerPlugin : public LoggerPlugin {
 
  private:
   REGHANDLE registration_handle_{0};
+
+  /// Publishes results, if windows_event_log_async is set.
+  std::unique_ptr<WindowsEventLogWriter> writer_;
 };
 }
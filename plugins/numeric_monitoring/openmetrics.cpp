@@ -0,0 +1,442 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <functional>
+#include <istream>
+#include <sstream>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/write.hpp>
+
+#include <osquery/core/flags.h>
+#include <osquery/database/database.h>
+#include <osquery/dispatcher/dispatcher.h>
+#include <osquery/dispatcher/scheduler_stats.h>
+#include <osquery/events/eventfactory.h>
+#include <osquery/logger/logger.h>
+#include <osquery/registry/registry_factory.h>
+#include <osquery/sql/table_stats.h>
+#include <osquery/utils/conversions/tryto.h>
+#include <plugins/numeric_monitoring/openmetrics.h>
+
+namespace asio = boost::asio;
+using asio::ip::tcp;
+
+namespace osquery {
+
+FLAG(uint64,
+     numeric_monitoring_openmetrics_port,
+     9469,
+     "Loopback port serving numeric monitoring as OpenMetrics on /metrics");
+
+REGISTER(NumericMonitoringOpenMetricsPlugin,
+         monitoring::registryName(),
+         "openmetrics");
+
+namespace {
+
+/// A scrape must be sent within this time, or it is dropped.
+const std::chrono::seconds kScrapeTimeout{5};
+
+/// Requests are small, anything larger is not a scrape.
+const size_t kMaxRequestSize{8192};
+
+std::string escapeLabel(const std::string& value) {
+  std::string escaped;
+  for (const auto& c : value) {
+    if (c == '\\' || c == '"') {
+      escaped.push_back('\\');
+      escaped.push_back(c);
+    } else if (c == '\n') {
+      escaped += "\\n";
+    } else {
+      escaped.push_back(c);
+    }
+  }
+  return escaped;
+}
+
+/// Write the statistics osquery keeps itself, rather than as points.
+class StatsWriter {
+ public:
+  explicit StatsWriter(std::ostringstream& out) : out_(out) {}
+
+  void family(const std::string& name,
+              const std::string& type,
+              const std::string& help) {
+    out_ << "# TYPE " << name << " " << type << "\n";
+    out_ << "# HELP " << name << " " << help << "\n";
+  }
+
+  void sample(const std::string& name,
+              const std::string& label,
+              const std::string& label_value,
+              std::uint64_t value,
+              const std::string& extra_labels = "") {
+    out_ << name << "{" << label << "=\"" << escapeLabel(label_value) << "\""
+         << extra_labels << "} " << value << "\n";
+  }
+
+ private:
+  std::ostringstream& out_;
+};
+
+void writeSchedulerStats(StatsWriter& writer) {
+  std::vector<std::pair<std::string, SchedulerStats>> packs;
+  getSchedulerStats([&packs](const std::string& pack,
+                             const SchedulerStats& stats) {
+    packs.emplace_back(pack, stats);
+  });
+  if (packs.empty()) {
+    return;
+  }
+
+  writer.family("osquery_scheduler_executions",
+                "gauge",
+                "Scheduled query executions in the last one to two hours.");
+  for (const auto& pack : packs) {
+    writer.sample("osquery_scheduler_executions",
+                  "pack",
+                  pack.first,
+                  pack.second.duration_ms.count());
+  }
+
+  auto histogram = [&writer, &packs](
+                       const std::string& name,
+                       const std::string& help,
+                       SchedulerHistogram SchedulerStats::*member) {
+    writer.family(name, "gauge", help);
+    for (const auto& pack : packs) {
+      const auto& values = pack.second.*member;
+      for (const auto& quantile : {"0.5", "0.95", "0.99"}) {
+        writer.sample(name,
+                      "pack",
+                      pack.first,
+                      values.quantile(std::stod(quantile)),
+                      std::string(",quantile=\"") + quantile + "\"");
+      }
+      writer.sample(name, "pack", pack.first, values.max(), ",quantile=\"1\"");
+    }
+  };
+  histogram("osquery_scheduler_lateness_ms",
+            "Delay of scheduled queries after their intended start.",
+            &SchedulerStats::lateness_ms);
+  histogram("osquery_scheduler_duration_ms",
+            "Time spent running scheduled queries.",
+            &SchedulerStats::duration_ms);
+  histogram("osquery_scheduler_rows",
+            "Rows returned by scheduled queries.",
+            &SchedulerStats::rows);
+}
+
+void writeEventStats(StatsWriter& writer) {
+  std::vector<EventPublisherRef> publishers;
+  for (const auto& type : EventFactory::publisherTypes()) {
+    auto publisher = EventFactory::getEventPublisher(type);
+    if (publisher != nullptr) {
+      publishers.push_back(publisher);
+    }
+  }
+  if (publishers.empty()) {
+    return;
+  }
+
+  auto counter = [&writer, &publishers](
+                     const std::string& name,
+                     const std::string& help,
+                     std::function<std::uint64_t(EventPublisherPlugin&)> get) {
+    writer.family(name, "counter", help);
+    for (const auto& publisher : publishers) {
+      writer.sample(
+          name + "_total", "publisher", publisher->type(), get(*publisher));
+    }
+  };
+  counter("osquery_events_received",
+          "Events received by the publisher.",
+          [](EventPublisherPlugin& p) { return p.numReceivedEvents(); });
+  counter("osquery_events_fired",
+          "Events fired to subscribers.",
+          [](EventPublisherPlugin& p) { return p.numEvents(); });
+  counter("osquery_events_dropped",
+          "Events dropped by the publisher queue.",
+          [](EventPublisherPlugin& p) { return p.numDroppedEvents(); });
+  counter("osquery_events_callback_time_us",
+          "Time spent in subscriber callbacks.",
+          [](EventPublisherPlugin& p) { return p.callbackTime(); });
+
+  writer.family("osquery_events_queue_depth",
+                "gauge",
+                "Events waiting in the publisher queue.");
+  for (const auto& publisher : publishers) {
+    writer.sample("osquery_events_queue_depth",
+                  "publisher",
+                  publisher->type(),
+                  publisher->queueDepth());
+  }
+}
+
+void writeTableStats(StatsWriter& writer) {
+  std::vector<std::pair<std::string, TableStats>> tables;
+  getTableStats([&tables](const std::string& table, const TableStats& stats) {
+    tables.emplace_back(table, stats);
+  });
+  if (tables.empty()) {
+    return;
+  }
+
+  auto counter = [&writer, &tables](const std::string& name,
+                                    const std::string& help,
+                                    std::uint64_t TableStats::*member) {
+    writer.family(name, "counter", help);
+    for (const auto& table : tables) {
+      writer.sample(
+          name + "_total", "table", table.first, table.second.*member);
+    }
+  };
+  counter("osquery_table_scans",
+          "Cursors opened over the table.",
+          &TableStats::scans);
+  counter("osquery_table_generate_time_us",
+          "Time spent generating the table.",
+          &TableStats::generate_time_us);
+  counter("osquery_table_rows_produced",
+          "Rows returned by the table implementation.",
+          &TableStats::rows_produced);
+  counter("osquery_table_bytes",
+          "Estimated bytes of the produced rows.",
+          &TableStats::bytes);
+}
+
+} // namespace
+
+/**
+ * @brief A minimal HTTP server answering scrapes, one request a connection.
+ *
+ * It runs an io_context on a dedicated Dispatcher thread, which is stopped
+ * with the other services.
+ */
+class OpenMetricsServer : public InternalRunnable {
+ public:
+  OpenMetricsServer(std::function<std::string()> render)
+      : InternalRunnable("numeric_monitoring_openmetrics"),
+        render_(std::move(render)),
+        acceptor_(io_context_) {}
+
+  Status bind(std::uint16_t port) {
+    boost::system::error_code ec;
+    tcp::endpoint endpoint(asio::ip::address_v4::loopback(), port);
+    acceptor_.open(endpoint.protocol(), ec);
+    if (!ec) {
+      acceptor_.set_option(tcp::acceptor::reuse_address(true), ec);
+    }
+    if (!ec) {
+      acceptor_.bind(endpoint, ec);
+    }
+    if (!ec) {
+      acceptor_.listen(asio::socket_base::max_listen_connections, ec);
+    }
+    if (ec) {
+      return Status::failure("Cannot listen on 127.0.0.1:" +
+                             std::to_string(port) + ": " + ec.message());
+    }
+
+    accept();
+    return Status::success();
+  }
+
+ protected:
+  void start() override {
+    io_context_.run();
+  }
+
+  void stop() override {
+    io_context_.stop();
+  }
+
+ private:
+  struct Connection {
+    explicit Connection(tcp::socket s)
+        : socket(std::move(s)),
+          request(kMaxRequestSize),
+          timer(socket.get_executor()) {}
+
+    tcp::socket socket;
+    asio::streambuf request;
+    asio::steady_timer timer;
+    std::string response;
+  };
+
+  void accept() {
+    acceptor_.async_accept(
+        [this](const boost::system::error_code& ec, tcp::socket socket) {
+          if (!ec) {
+            serve(std::make_shared<Connection>(std::move(socket)));
+          }
+          if (acceptor_.is_open()) {
+            accept();
+          }
+        });
+  }
+
+  void serve(std::shared_ptr<Connection> connection) {
+    connection->timer.expires_after(kScrapeTimeout);
+    connection->timer.async_wait(
+        [connection](const boost::system::error_code& ec) {
+          if (!ec) {
+            boost::system::error_code ignored;
+            connection->socket.close(ignored);
+          }
+        });
+
+    asio::async_read_until(
+        connection->socket,
+        connection->request,
+        "\r\n\r\n",
+        [this, connection](const boost::system::error_code& ec, size_t) {
+          if (ec) {
+            connection->timer.cancel();
+            return;
+          }
+
+          std::istream stream(&connection->request);
+          std::string method;
+          std::string target;
+          stream >> method >> target;
+          target = target.substr(0, target.find('?'));
+
+          if (method != "GET") {
+            connection->response = reply("405 Method Not Allowed", "");
+          } else if (target != "/metrics") {
+            connection->response = reply("404 Not Found", "");
+          } else {
+            connection->response = reply("200 OK", render_());
+          }
+
+          asio::async_write(
+              connection->socket,
+              asio::buffer(connection->response),
+              [connection](const boost::system::error_code&, size_t) {
+                connection->timer.cancel();
+                boost::system::error_code ignored;
+                connection->socket.shutdown(tcp::socket::shutdown_both,
+                                            ignored);
+                connection->socket.close(ignored);
+              });
+        });
+  }
+
+  static std::string reply(const std::string& status, const std::string& body) {
+    return "HTTP/1.1 " + status +
+           "\r\nContent-Type: application/openmetrics-text; version=1.0.0; "
+           "charset=utf-8\r\nContent-Length: " +
+           std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" +
+           body;
+  }
+
+ private:
+  std::function<std::string()> render_;
+  asio::io_context io_context_;
+  tcp::acceptor acceptor_;
+};
+
+std::string toOpenMetricsName(const std::string& path) {
+  std::string name = "osquery_";
+  for (const auto& c : path) {
+    auto allowed = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                   (c >= '0' && c <= '9') || c == '_';
+    name.push_back(allowed ? c : '_');
+  }
+  return name;
+}
+
+Status NumericMonitoringOpenMetricsPlugin::call(const PluginRequest& request,
+                                                PluginResponse& response) {
+  auto path = request.find(monitoring::recordKeys().path);
+  auto value = request.find(monitoring::recordKeys().value);
+  auto pre_aggregation = request.find(monitoring::recordKeys().pre_aggregation);
+  if (path == request.end() || value == request.end()) {
+    return Status::failure("Missing mandatory request field path or value");
+  }
+
+  auto number = tryTo<long long>(value->second);
+  if (number.isError()) {
+    return Status::failure("Invalid value for " + path->second);
+  }
+
+  auto counter = pre_aggregation != request.end() &&
+                 pre_aggregation->second ==
+                     to<std::string>(monitoring::PreAggregationType::Sum);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& sample = samples_[toOpenMetricsName(path->second)];
+  sample.counter = counter;
+  sample.value = (counter) ? sample.value + number.get() : number.get();
+  return Status::success();
+}
+
+Status NumericMonitoringOpenMetricsPlugin::setUp() {
+  if (server_ != nullptr) {
+    return Status::success();
+  }
+
+  if (FLAGS_numeric_monitoring_openmetrics_port == 0 ||
+      FLAGS_numeric_monitoring_openmetrics_port > 65535) {
+    return Status::failure("Invalid numeric_monitoring_openmetrics_port");
+  }
+
+  auto server =
+      std::make_shared<OpenMetricsServer>([this]() { return render(); });
+  auto status = server->bind(
+      static_cast<std::uint16_t>(FLAGS_numeric_monitoring_openmetrics_port));
+  if (!status.ok()) {
+    return status;
+  }
+
+  server_ = server;
+  return Dispatcher::addService(server);
+}
+
+std::string NumericMonitoringOpenMetricsPlugin::render() const {
+  std::ostringstream out;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& sample : samples_) {
+      const auto& name = sample.first;
+      if (sample.second.counter) {
+        out << "# TYPE " << name << " counter\n";
+        out << name << "_total " << sample.second.value << "\n";
+      } else {
+        out << "# TYPE " << name << " gauge\n";
+        out << name << " " << sample.second.value << "\n";
+      }
+    }
+  }
+
+  StatsWriter writer(out);
+  writeSchedulerStats(writer);
+  writeEventStats(writer);
+  writeTableStats(writer);
+
+  std::uint64_t database_memory = 0;
+  if (getDatabaseMemoryUsage(database_memory).ok()) {
+    out << "# TYPE osquery_database_memory_bytes gauge\n";
+    out << "# HELP osquery_database_memory_bytes Cache and write buffers used "
+           "by the database.\n";
+    out << "osquery_database_memory_bytes " << database_memory << "\n";
+  }
+
+  out << "# EOF\n";
+  return out.str();
+}
+
+} // namespace osquery
@@ -0,0 +1,68 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <osquery/numeric_monitoring/plugin_interface.h>
+
+namespace osquery {
+
+class OpenMetricsServer;
+
+/**
+ * @brief Serve the numeric monitoring points over HTTP for Prometheus.
+ *
+ * The plugin keeps the last value of each path, Sum points are added to a
+ * counter. A scrape of http://127.0.0.1:<port>/metrics returns them in the
+ * OpenMetrics text format, with the scheduler, event publisher, table and
+ * database statistics read at scrape time.
+ *
+ * The endpoint only listens on the loopback interface, the metrics are not
+ * authenticated.
+ */
+class NumericMonitoringOpenMetricsPlugin : public NumericMonitoringPlugin {
+ public:
+  Status call(const PluginRequest& request, PluginResponse& response) override;
+
+  /// Bind the endpoint and start serving.
+  Status setUp() override;
+
+  /// Render the points and statistics in the OpenMetrics text format.
+  std::string render() const;
+
+ private:
+  struct Sample {
+    /// Sum points are added to a counter, others replace a gauge.
+    bool counter{false};
+    long long value{0};
+  };
+
+  /// The samples of each metric, by their OpenMetrics name.
+  std::map<std::string, Sample> samples_;
+
+  /// Protection around the samples, scrapes run on the server thread.
+  mutable std::mutex mutex_;
+
+  std::shared_ptr<OpenMetricsServer> server_;
+};
+
+/**
+ * @brief Convert a numeric monitoring path to an OpenMetrics metric name.
+ *
+ * Names are prefixed with osquery_, characters that are not allowed are
+ * replaced with underscores.
+ */
+std::string toOpenMetricsName(const std::string& path);
+
+} // namespace osquery
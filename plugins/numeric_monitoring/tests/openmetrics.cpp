@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <gtest/gtest.h>
+
+#include <osquery/numeric_monitoring/numeric_monitoring.h>
+#include <osquery/utils/conversions/tryto.h>
+#include <plugins/numeric_monitoring/openmetrics.h>
+
+namespace osquery {
+
+class NumericMonitoringOpenMetricsPluginTests : public testing::Test {
+ protected:
+  PluginRequest point(const std::string& path,
+                      const std::string& value,
+                      monitoring::PreAggregationType type) {
+    return {
+        {monitoring::recordKeys().path, path},
+        {monitoring::recordKeys().value, value},
+        {monitoring::recordKeys().pre_aggregation, to<std::string>(type)},
+    };
+  }
+};
+
+TEST_F(NumericMonitoringOpenMetricsPluginTests, metric_names) {
+  EXPECT_EQ(toOpenMetricsName("query.total"), "osquery_query_total");
+  EXPECT_EQ(toOpenMetricsName("table.processes.rows-produced"),
+            "osquery_table_processes_rows_produced");
+  EXPECT_EQ(toOpenMetricsName("ok_name9"), "osquery_ok_name9");
+}
+
+TEST_F(NumericMonitoringOpenMetricsPluginTests, render_points) {
+  NumericMonitoringOpenMetricsPlugin plugin;
+  PluginResponse response;
+
+  auto status = plugin.call(
+      point("test.sum", "2", monitoring::PreAggregationType::Sum), response);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  status = plugin.call(
+      point("test.sum", "3", monitoring::PreAggregationType::Sum), response);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  status = plugin.call(
+      point("test.max", "7", monitoring::PreAggregationType::Max), response);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  status = plugin.call(
+      point("test.max", "4", monitoring::PreAggregationType::Max), response);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  auto text = plugin.render();
+  EXPECT_NE(text.find("# TYPE osquery_test_sum counter\n"
+                      "osquery_test_sum_total 5\n"),
+            std::string::npos);
+  EXPECT_NE(text.find("# TYPE osquery_test_max gauge\n"
+                      "osquery_test_max 4\n"),
+            std::string::npos);
+  ASSERT_GE(text.size(), 6U);
+  EXPECT_EQ(text.substr(text.size() - 6), "# EOF\n");
+}
+
+TEST_F(NumericMonitoringOpenMetricsPluginTests, invalid_points) {
+  NumericMonitoringOpenMetricsPlugin plugin;
+  PluginResponse response;
+
+  EXPECT_FALSE(
+      plugin.call({{monitoring::recordKeys().path, "test.path"}}, response)
+          .ok());
+  EXPECT_FALSE(
+      plugin
+          .call(point("test.path", "nan", monitoring::PreAggregationType::None),
+                response)
+          .ok());
+}
+
+} // namespace osquery
@@ -81,8 +81,7 @@ std::string TLSEnrollPlugin::enroll() {
   VLOG(1) << "TLSEnrollPlugin requesting a node enroll key from: " << uri;
 
   std::uint64_t attempt = 1;
-  std::uint64_t interval_step = 1;
-  std::uint64_t interval = 0;
+  std::uint64_t failures = 0;
 
   bool should_shutdown = false;
 
@@ -101,15 +100,9 @@ std::string TLSEnrollPlugin::enroll() {
     LOG(WARNING) << "Failed enrollment request to " << uri << " ("
                  << status.what() << ") retrying...";
 
-    interval =
-        std::min(interval_step * interval_step, FLAGS_tls_enroll_max_interval);
-
-    if (interval < FLAGS_tls_enroll_max_interval) {
-      ++interval_step;
-    }
-
-    should_shutdown =
-        waitTimeoutOrShutdown(std::chrono::milliseconds(interval * 1000));
+    // The delay is jittered, so hosts enrolling at once spread their retries.
+    should_shutdown = waitTimeoutOrShutdown(getRetryDelay(
+        ++failures, std::chrono::seconds(FLAGS_tls_enroll_max_interval)));
 
     if (should_shutdown) {
       LOG(WARNING)
@@ -162,6 +155,16 @@ Status TLSEnrollPlugin::requestKey(const std::string& uri,
   if (node_key.empty()) {
     return Status(1, "No node key returned from TLS enroll plugin");
   }
+
+  // The initial config may be returned with the node key.
+  it = recv.doc().FindMember("config");
+  if (it != recv.doc().MemberEnd()) {
+    if (it->value.IsString()) {
+      setEnrollConfig(it->value.GetString());
+    } else if (it->value.IsObject()) {
+      setEnrollConfig(JSON::valueToString(it->value));
+    }
+  }
   return Status::success();
 }
 } // namespace osquery
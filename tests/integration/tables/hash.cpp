@@ -69,5 +69,44 @@ TEST_F(Hash, test_sanity) {
   }
 }
 
+TEST_F(Hash, test_fast_hashes) {
+  // The hidden digests are only calculated when selected.
+  QueryData data = execute_query(
+      "select md5, xxh64, blake2b from hash where path = '" + path.string() +
+      "'");
+
+  ASSERT_EQ(data.size(), 1ul);
+  EXPECT_EQ(data[0]["md5"], "35899082e51edf667f14477ac000cbba");
+  EXPECT_EQ(data[0]["xxh64"], "61940b3f10b28ca7");
+  EXPECT_EQ(data[0]["blake2b"],
+            "d6a1c4f1083b7535f7314305ac77fc6525b13333554e6a43bc75ef21f7fffc26"
+            "3b23fe1b713aac41151c50a4793c02cd7fcf66adbbacef4c547e8271c3d35111");
+}
+
+TEST_F(Hash, test_directory) {
+  auto directory = path.parent_path() / fs::unique_path(
+                                            "osquery.tests.hashes.%%%%.%%%%");
+  ASSERT_TRUE(fs::create_directory(directory));
+  for (size_t i = 0; i < 8; ++i) {
+    ASSERT_TRUE(writeTextFile(directory / std::to_string(i),
+                              "Lorem ipsum dolor sit amet, consectetur "
+                              "adipiscing elit.")
+                    .ok());
+  }
+
+  QueryData data = execute_query("select * from hash where directory = '" +
+                                 directory.string() + "'");
+  fs::remove_all(directory);
+
+  // Every file is hashed, whichever thread hashed it.
+  ASSERT_EQ(data.size(), 8ul);
+  for (const auto& row : data) {
+    EXPECT_EQ(row.at("directory"), directory.string());
+    EXPECT_EQ(row.at("md5"), "35899082e51edf667f14477ac000cbba");
+    EXPECT_EQ(row.at("sha256"),
+              "a58dd8680234c1f8cc2ef2b325a43733605a7f16f288e072de8eae81fd8d6433");
+  }
+}
+
 } // namespace table_tests
 } // namespace osquery
@@ -0,0 +1,44 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+// Sanity check integration test for osquery_database_stats
+// Spec file: specs/utility/osquery_database_stats.table
+
+#include <osquery/tests/integration/tables/helper.h>
+
+namespace osquery {
+namespace table_tests {
+
+class osqueryDatabaseStats : public testing::Test {
+ protected:
+  void SetUp() override {
+    setUpEnvironment();
+  }
+};
+
+TEST_F(osqueryDatabaseStats, test_sanity) {
+  // Only the RocksDB database plugin reports statistics.
+  auto const data = execute_query("select * from osquery_database_stats");
+  ValidationMap row_map = {
+      {"domain", NonEmptyString},
+      {"keys", NonNegativeInt},
+      {"sst_files", NonNegativeInt},
+      {"sst_files_size", NonNegativeInt},
+      {"memtables_size", NonNegativeInt},
+      {"table_readers_size", NonNegativeInt},
+      {"pending_compaction_size", NonNegativeInt},
+      {"compaction", NonEmptyString},
+      {"compression", NonEmptyString},
+      {"prefix_bloom", IntMinMaxCheck(0, 1)},
+  };
+  validate_rows(data, row_map);
+}
+
+} // namespace table_tests
+} // namespace osquery
@@ -0,0 +1,39 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+// Sanity check integration test for osquery_discovery_stats
+// Spec file: specs/utility/osquery_discovery_stats.table
+
+#include <osquery/tests/integration/tables/helper.h>
+
+namespace osquery {
+namespace table_tests {
+
+class osqueryDiscoveryStats : public testing::Test {
+ protected:
+  void SetUp() override {
+    setUpEnvironment();
+  }
+};
+
+TEST_F(osqueryDiscoveryStats, test_sanity) {
+  // The table is empty until a pack with discovery queries was checked.
+  auto const data = execute_query("select * from osquery_discovery_stats");
+  ValidationMap row_map = {
+      {"query", NormalType},
+      {"executions", NonNegativeInt},
+      {"cache_hits", NonNegativeInt},
+      {"passed", Bool},
+      {"last_executed", NonNegativeInt},
+  };
+  validate_rows(data, row_map);
+}
+
+} // namespace table_tests
+} // namespace osquery
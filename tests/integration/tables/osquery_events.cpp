@@ -38,6 +38,10 @@ TEST_F(osqueryEvents, test_sanity) {
   //      {"type", NormalType}
   //      {"subscriptions", IntType}
   //      {"events", IntType}
+  //      {"received", IntType}
+  //      {"dropped", IntType}
+  //      {"queued", IntType}
+  //      {"callback_time_us", IntType}
   //      {"refreshes", IntType}
   //      {"active", IntType}
   //}
@@ -0,0 +1,41 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+// Sanity check integration test for osquery_logger_stats
+// Spec file: specs/utility/osquery_logger_stats.table
+
+#include <osquery/tests/integration/tables/helper.h>
+
+namespace osquery {
+namespace table_tests {
+
+class osqueryLoggerStats : public testing::Test {
+ protected:
+  void SetUp() override {
+    setUpEnvironment();
+  }
+};
+
+TEST_F(osqueryLoggerStats, test_sanity) {
+  // The table is empty until a result line is logged.
+  auto const data = execute_query("select * from osquery_logger_stats");
+  ValidationMap row_map = {
+      {"logger", NonEmptyString},
+      {"queued", NonNegativeInt},
+      {"delivered", NonNegativeInt},
+      {"failed", NonNegativeInt},
+      {"dropped", NonNegativeInt},
+      {"latency_avg_us", NonNegativeInt},
+      {"latency_max_us", NonNegativeInt},
+  };
+  validate_rows(data, row_map);
+}
+
+} // namespace table_tests
+} // namespace osquery
@@ -0,0 +1,49 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+// Sanity check integration test for osquery_profile
+// Spec file: specs/utility/osquery_profile.table
+
+#include <osquery/core/flags.h>
+#include <osquery/tests/integration/tables/helper.h>
+
+namespace osquery {
+
+DECLARE_bool(enable_profile);
+
+namespace table_tests {
+
+class osqueryProfile : public testing::Test {
+ protected:
+  void SetUp() override {
+    setUpEnvironment();
+  }
+};
+
+TEST_F(osqueryProfile, test_sanity) {
+  // Scan a table so that at least one table is profiled.
+  FLAGS_enable_profile = true;
+  execute_query("select * from time");
+  FLAGS_enable_profile = false;
+
+  auto const data = execute_query("select * from osquery_profile");
+  ASSERT_GE(data.size(), 1ul);
+  ValidationMap row_map = {
+      {"subsystem", NonEmptyString},
+      {"name", NonEmptyString},
+      {"calls", NonNegativeInt},
+      {"cpu_time_us", NonNegativeInt},
+      {"wall_time_us", NonNegativeInt},
+      {"max_wall_time_us", NonNegativeInt},
+  };
+  validate_rows(data, row_map);
+}
+
+} // namespace table_tests
+} // namespace osquery
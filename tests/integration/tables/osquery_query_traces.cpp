@@ -0,0 +1,56 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+// Sanity check integration test for osquery_query_traces
+// Spec file: specs/utility/osquery_query_traces.table
+
+#include <osquery/core/flags.h>
+#include <osquery/profiler/query_trace.h>
+#include <osquery/tests/integration/tables/helper.h>
+
+namespace osquery {
+
+DECLARE_uint64(query_trace_sample);
+
+namespace table_tests {
+
+class osqueryQueryTraces : public testing::Test {
+ protected:
+  void SetUp() override {
+    setUpEnvironment();
+  }
+};
+
+TEST_F(osqueryQueryTraces, test_sanity) {
+  // Trace an execution so that at least one trace exists.
+  FLAGS_query_trace_sample = 1;
+  {
+    ScopedQueryTrace trace("scheduled", "pack_test_time");
+    execute_query("select * from time");
+  }
+  FLAGS_query_trace_sample = 0;
+
+  auto const data = execute_query("select * from osquery_query_traces");
+  ASSERT_GE(data.size(), 2ul);
+  ValidationMap row_map = {
+      {"trace_id", NonEmptyString},
+      {"kind", NonEmptyString},
+      {"name", NonEmptyString},
+      {"start_time", NonNegativeInt},
+      {"stage", NonEmptyString},
+      {"detail", NormalType},
+      {"start_us", NonNegativeInt},
+      {"duration_us", NonNegativeInt},
+      {"rows", NonNegativeInt},
+  };
+  validate_rows(data, row_map);
+}
+
+} // namespace table_tests
+} // namespace osquery
@@ -0,0 +1,48 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+// Sanity check integration test for osquery_scheduler_stats
+// Spec file: specs/utility/osquery_scheduler_stats.table
+
+#include <osquery/tests/integration/tables/helper.h>
+
+namespace osquery {
+namespace table_tests {
+
+class osquerySchedulerStats : public testing::Test {
+ protected:
+  void SetUp() override {
+    setUpEnvironment();
+  }
+};
+
+TEST_F(osquerySchedulerStats, test_sanity) {
+  // The table is empty until the scheduler has run a query.
+  auto const data = execute_query("select * from osquery_scheduler_stats");
+  ValidationMap row_map = {
+      {"pack", NormalType},
+      {"executions", NonNegativeInt},
+      {"lateness_p50", NonNegativeInt},
+      {"lateness_p95", NonNegativeInt},
+      {"lateness_p99", NonNegativeInt},
+      {"lateness_max", NonNegativeInt},
+      {"duration_p50", NonNegativeInt},
+      {"duration_p95", NonNegativeInt},
+      {"duration_p99", NonNegativeInt},
+      {"duration_max", NonNegativeInt},
+      {"rows_p50", NonNegativeInt},
+      {"rows_p95", NonNegativeInt},
+      {"rows_p99", NonNegativeInt},
+      {"rows_max", NonNegativeInt},
+  };
+  validate_rows(data, row_map);
+}
+
+} // namespace table_tests
+} // namespace osquery
@@ -0,0 +1,43 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+// Sanity check integration test for osquery_table_stats
+// Spec file: specs/utility/osquery_table_stats.table
+
+#include <osquery/tests/integration/tables/helper.h>
+
+namespace osquery {
+namespace table_tests {
+
+class osqueryTableStats : public testing::Test {
+ protected:
+  void SetUp() override {
+    setUpEnvironment();
+  }
+};
+
+TEST_F(osqueryTableStats, test_sanity) {
+  // Scan a table so that at least one row of statistics exists.
+  execute_query("select * from time");
+  auto const data = execute_query("select * from osquery_table_stats");
+  ASSERT_GE(data.size(), 1ul);
+  ValidationMap row_map = {
+      {"name", NonEmptyString},
+      {"scans", NonNegativeInt},
+      {"filters", NonNegativeInt},
+      {"generate_time_us", NonNegativeInt},
+      {"rows_produced", NonNegativeInt},
+      {"rows_consumed", NonNegativeInt},
+      {"bytes", NonNegativeInt},
+  };
+  validate_rows(data, row_map);
+}
+
+} // namespace table_tests
+} // namespace osquery
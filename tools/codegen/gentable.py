@@ -87,6 +87,7 @@ TABLE_ATTRIBUTES = {
     "event_subscriber": "EVENT_BASED",
     "user_data": "USER_BASED",
     "cacheable": "CACHEABLE",
+    "boot_stable": "BOOT_STABLE",
     "utility": "UTILITY",
     "kernel_required": "KERNEL_REQUIRED", # Deprecated
 }
@@ -197,6 +198,8 @@ class TableState(Singleton):
         self.has_column_aliases = False
         self.strongly_typed_rows = False
         self.generator = False
+        self.estimates = {}
+        self.column_groups = {}
 
     def columns(self):
         return [i for i in self.schema if isinstance(i, Column)]
@@ -235,10 +238,33 @@ class TableState(Singleton):
                 print(lightred(
                     "Table cannot use a generator and be marked cacheable: %s" % (path)))
                 exit(1)
+        if "boot_stable" in self.attributes:
+            if self.generator:
+                print(lightred(
+                    "Table cannot use a generator and be marked boot_stable: %s" % (path)))
+                exit(1)
         if self.table_name == "" or self.function == "":
             print(lightred("Invalid table spec: %s" % (path)))
             exit(1)
 
+        # Collect the members of each declared column group
+        groups = {}
+        for column in self.columns():
+            if column.group == "":
+                continue
+            if column.group not in self.column_groups:
+                print(lightred(("Column %s in table: %s uses an undeclared "
+                                "column group: %s" % (
+                                    column.name, self.table_name,
+                                    column.group))))
+                exit(1)
+            groups.setdefault(column.group, []).append(column.name)
+        column_groups = [{
+            "name": name,
+            "description": self.column_groups[name],
+            "columns": ", ".join('"%s"' % c for c in groups[name]),
+        } for name in sorted(groups)]
+
         # Check for reserved column names
         for column in self.columns():
             if column.name in RESERVED:
@@ -275,6 +301,10 @@ class TableState(Singleton):
             has_column_aliases=self.has_column_aliases,
             generator=self.generator,
             strongly_typed_rows=self.strongly_typed_rows,
+            has_estimates=len(self.estimates) > 0,
+            estimated_rows=self.estimates.get("rows", 0),
+            estimated_cost=self.estimates.get("cost", 0.0),
+            column_groups=column_groups,
             attribute_set=[TABLE_ATTRIBUTES[attr] for attr in self.attributes if attr in TABLE_ATTRIBUTES],
         )
 
@@ -297,15 +327,20 @@ class Column(object):
     documentation generation and reference.
     """
 
-    def __init__(self, name, col_type, description="", aliases=[], platforms=[], notes="", **kwargs):
+    def __init__(self, name, col_type, description="", aliases=[], platforms=[], notes="", group="", **kwargs):
         self.name = name
         self.type = col_type
         self.description = description
         self.aliases = aliases
         self.platforms = platforms
         self.notes = notes
+        self.group = group
         self.options = kwargs
 
+    def available(self):
+        """The column is part of the schema of the generating platform."""
+        return len(self.platforms) == 0 or PLATFORM in self.platforms
+
 
 class ForeignKey(object):
 
@@ -329,6 +364,8 @@ def table_name(name, aliases=[]):
     table.examples = []
     table.notes = ""
     table.aliases = aliases
+    table.estimates = {}
+    table.column_groups = {}
 
 
 def schema(schema_list):
@@ -383,6 +420,24 @@ def attributes(**kwargs):
         table.attributes[attr] = kwargs[attr]
 
 
+def estimates(rows=0, cost=0):
+    """
+    define optional planner hints for a full scan of the table: the expected
+    number of rows and the relative cost, where an indexed lookup costs 1
+    """
+    table.estimates = {"rows": int(rows), "cost": float(cost)}
+
+
+def column_groups(**kwargs):
+    """
+    describe the costly source shared by a group of columns, for example
+    column_groups(io="Requires a read of /proc/<pid>/io"); columns join a
+    group with Column(..., group="io")
+    """
+    for group in kwargs:
+        table.column_groups[group] = kwargs[group]
+
+
 def fuzz_paths(paths):
     table.fuzz_paths = paths
 
@@ -9,6 +9,7 @@
 
 import argparse
 import base64
+import hashlib
 import json
 import os
 import random
@@ -173,12 +174,17 @@ class RealSimpleHandler(BaseHTTPRequestHandler):
     def do_POST(self):
         reset_timeout()
         debug("RealSimpleHandler::post %s" % self.path)
-        self._set_headers()
         content_len = int(self.headers.get('content-length', 0))
 
         body = self.rfile.read(content_len)
         request = json.loads(body)
 
+        # The conditional config sets its own status code.
+        if self.path == '/config_etag':
+            self.config_etag(request)
+            return
+        self._set_headers()
+
         # This contains a base64 encoded block of a file printing to the screen
         # slows down carving and makes scroll back a pain
         if (self.path != "/carve_block"):
@@ -250,6 +256,26 @@ class RealSimpleHandler(BaseHTTPRequestHandler):
             return
         self._reply(EXAMPLE_CONFIG)
 
+    def config_etag(self, request):
+        '''A config endpoint answering conditional requests'''
+
+        # The ETag is the hash of the config, a request with a matching
+        # If-None-Match header is answered with an empty 304.
+        self._push_request('config', request)
+        etag = '"%s"' % hashlib.sha1(
+            json.dumps(EXAMPLE_CONFIG).encode()).hexdigest()
+        self.protocol_version = self.request_version
+        if self.headers.get('If-None-Match') == etag:
+            self.send_response(304)
+            self.send_header('ETag', etag)
+            self.end_headers()
+            return
+
+        self.send_response(200)
+        self.send_header('Content-Type', 'application/json')
+        self.send_header('ETag', etag)
+        self._reply(EXAMPLE_CONFIG)
+
     def distributed_read(self, request):
         '''A basic distributed read endpoint'''
         if "node_key" not in request or request["node_key"] not in NODE_KEYS: